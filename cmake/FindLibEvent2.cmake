@@ -49,9 +49,12 @@ IF(WIN32)
   ## libevent-2.0.22 on windows is only 'event.lib' and 'event.dll'
   FIND_LIBRARY(LIBEVENT2_CORE NAMES event PATHS ${LIBEVENT2_LIB_PATHS} ${HOW_TO_FIND})
   SET(LIBEVENT2_EXTRA)
+  SET(LIBEVENT2_OPENSSL)
 ELSE()
   FIND_LIBRARY(LIBEVENT2_CORE NAMES event_core PATHS ${LIBEVENT2_LIB_PATHS} ${HOW_TO_FIND})
   FIND_LIBRARY(LIBEVENT2_EXTRA NAMES event_extra PATHS ${LIBEVENT2_LIB_PATHS} ${HOW_TO_FIND})
+  ## optional, bufferevent_openssl for the HTTPS server
+  FIND_LIBRARY(LIBEVENT2_OPENSSL NAMES event_openssl PATHS ${LIBEVENT2_LIB_PATHS} ${HOW_TO_FIND})
 ENDIF()
 
 IF (LIBEVENT2_INCLUDE_DIR AND LIBEVENT2_CORE)
@@ -135,5 +138,6 @@ MARK_AS_ADVANCED(
   LIBEVENT2_INCLUDE_DIR
   LIBEVENT2_CORE
   LIBEVENT2_EXTRA
+  LIBEVENT2_OPENSSL
   LIBEVENT2_VERSION
 )
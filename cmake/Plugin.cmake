@@ -23,7 +23,7 @@
 # add_harness_plugin - Add a new plugin target and set install
 #                      location
 #
-# add_harness_plugin(name [NO_INSTALL]
+# add_harness_plugin(name [NO_INSTALL] [BUILTIN]
 #                    LOG_DOMAIN domain
 #                    SOURCES file1 ...
 #                    INTERFACE directory
@@ -43,6 +43,12 @@
 # directory, you have to set the target property
 # LIBRARY_OUTPUT_DIRECTORY yourself.
 #
+# If BUILTIN is provided and WITH_STATIC_PLUGINS is enabled, the plugin
+# is built as a static library instead, which the executables calling
+# add_harness_builtin_plugins() link in and register with the Loader.
+# Plugins that require a built-in plugin resolve its symbols against
+# the executable then, to share its state instead of linking a copy.
+#
 # If LOG_DOMAIN is given, it will be used as the log domain for the
 # plugin. If no LOG_DOMAIN is given, the log domain will be the name
 # of the plugin.
@@ -61,7 +67,7 @@
 # changed after that.
 
 function(add_harness_plugin NAME)
-  set(_options NO_INSTALL)
+  set(_options NO_INSTALL BUILTIN)
   set(_single_value LOG_DOMAIN INTERFACE DESTINATION_SUFFIX OUTPUT_NAME)
   set(_multi_value SOURCES REQUIRES)
   cmake_parse_arguments(_option
@@ -83,19 +89,31 @@ function(add_harness_plugin NAME)
     set(_option_LOG_DOMAIN "\"${NAME}\"")
   endif()
 
+  set(_builtin NO)
+  if(_option_BUILTIN AND WITH_STATIC_PLUGINS)
+    set(_builtin YES)
+  endif()
+
   # Add the library and ensure that the name is good for the plugin
   # system (no "lib" before). We are using SHARED libraries since we
   # intend to link against it, which is something that MODULE does not
   # allow. On OSX, this means that the suffix for the library becomes
   # .dylib, which we do not want, so we reset it here.
-  add_library(${NAME} SHARED ${_option_SOURCES})
+  if(_builtin)
+    # position independent, as plugins loaded into the executable use it
+    add_library(${NAME} STATIC ${_option_SOURCES})
+    set_target_properties(${NAME} PROPERTIES POSITION_INDEPENDENT_CODE ON)
+    set_property(GLOBAL APPEND PROPERTY HARNESS_BUILTIN_PLUGINS ${NAME})
+  else()
+    add_library(${NAME} SHARED ${_option_SOURCES})
+  endif()
   if(_option_OUTPUT_NAME)
     set_target_properties(${NAME}
       PROPERTIES OUTPUT_NAME ${_option_OUTPUT_NAME})
   endif()
   target_compile_definitions(${NAME} PRIVATE
     MYSQL_ROUTER_LOG_DOMAIN=${_option_LOG_DOMAIN})
-  if(NOT WIN32)
+  if(NOT WIN32 AND NOT _builtin)
     set_target_properties(${NAME} PROPERTIES
       PREFIX ""
       SUFFIX ".so")
@@ -112,10 +130,22 @@ function(add_harness_plugin NAME)
   endif()
 
   # Add a dependencies on interfaces for other plugins this plugin
-  # requires.
+  # requires. A shared plugin only takes the interface of the built-in
+  # plugins, their code is in the executable that loads it.
+  get_property(_builtin_plugins GLOBAL PROPERTY HARNESS_BUILTIN_PLUGINS)
+  set(_requires)
+  foreach(_required ${_option_REQUIRES})
+    list(FIND _builtin_plugins ${_required} _required_builtin)
+    if(NOT _builtin AND NOT _required_builtin EQUAL -1)
+      target_include_directories(${NAME} PUBLIC
+        $<TARGET_PROPERTY:${_required},INTERFACE_INCLUDE_DIRECTORIES>)
+    else()
+      list(APPEND _requires ${_required})
+    endif()
+  endforeach()
   target_link_libraries(${NAME}
     PUBLIC harness-library
-    ${_option_REQUIRES})
+    ${_requires})
   # Need to be able to link plugins with each other
   if(CMAKE_SYSTEM_NAME STREQUAL "Darwin")
     set_target_properties(${NAME} PROPERTIES
@@ -141,7 +171,9 @@ function(add_harness_plugin NAME)
   # Add install rules to install the interface header files and the
   # plugin correctly.
   if(NOT _option_NO_INSTALL AND HARNESS_INSTALL_PLUGINS)
-    if(WIN32)
+    if(_builtin)
+      # linked into the executables, nothing to install
+    elseif(WIN32)
       install(TARGETS ${NAME}
         RUNTIME DESTINATION ${HARNESS_INSTALL_LIBRARY_DIR})
       install(FILES $<TARGET_PDB_FILE:${NAME}>
@@ -157,3 +189,49 @@ function(add_harness_plugin NAME)
     endif()
   endif()
 endfunction(add_harness_plugin)
+
+# add_harness_builtin_plugins - Link the built-in plugins into an
+#                               executable
+#
+# add_harness_builtin_plugins(target [plugin ...])
+#
+# Links the plugins added with BUILTIN into the executable target and
+# registers them with the Loader before main() runs, so that they are
+# not loaded from the plugin folder. Other plugins are still loaded
+# from there and may use the symbols of the built-in ones, which the
+# executable exports. Does nothing unless WITH_STATIC_PLUGINS is
+# enabled.
+#
+# Without a list of plugins, all built-in plugins are linked in, which
+# needs to be done after all of them were added.
+
+function(add_harness_builtin_plugins TARGET)
+  if(NOT WITH_STATIC_PLUGINS)
+    return()
+  endif()
+
+  set(_plugins ${ARGN})
+  if(NOT _plugins)
+    get_property(_plugins GLOBAL PROPERTY HARNESS_BUILTIN_PLUGINS)
+  endif()
+
+  set(BUILTIN_PLUGIN_DECLARATIONS)
+  set(BUILTIN_PLUGIN_REGISTRATIONS)
+  foreach(_plugin ${_plugins})
+    set(BUILTIN_PLUGIN_DECLARATIONS
+      "${BUILTIN_PLUGIN_DECLARATIONS}extern mysql_harness::Plugin harness_plugin_${_plugin};\n")
+    set(BUILTIN_PLUGIN_REGISTRATIONS
+      "${BUILTIN_PLUGIN_REGISTRATIONS}    Loader::add_builtin_plugin(\"${_plugin}\", &harness_plugin_${_plugin});\n")
+  endforeach()
+
+  set(_source ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_builtin_plugins.cc)
+  configure_file(${MySQLRouter_SOURCE_DIR}/cmake/builtin_plugins.cc.in ${_source} @ONLY)
+  add_library(${TARGET}_builtin_plugins STATIC ${_source})
+  target_link_libraries(${TARGET}_builtin_plugins harness-library)
+
+  # nothing in the executable refers to the registration or to what the
+  # dynamically loaded plugins use, keep all of it
+  target_link_libraries(${TARGET}
+    -Wl,--whole-archive ${TARGET}_builtin_plugins ${_plugins} -Wl,--no-whole-archive)
+  set_target_properties(${TARGET} PROPERTIES ENABLE_EXPORTS ON)
+endfunction(add_harness_builtin_plugins)
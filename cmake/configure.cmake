@@ -253,5 +253,12 @@ set(CMAKE_REQUIRED_FLAGS -D_GNU_SOURCE)
 check_symbol_exists(prlimit sys/resource.h HAVE_PRLIMIT)
 cmake_pop_check_state()
 
+# io_uring poller of the routing event engine, the kernel is checked at runtime
+check_symbol_exists(IORING_FEAT_EXT_ARG linux/io_uring.h HAVE_IO_URING)
+
+# static tracepoints, see mysql/harness/tracepoints.h
+include(CheckIncludeFile)
+check_include_file(sys/sdt.h HAVE_SYS_SDT_H)
+
 configure_file(config.h.in router_config.h @ONLY)
 include_directories(${PROJECT_BINARY_DIR})
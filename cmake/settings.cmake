@@ -33,6 +33,13 @@ set(MYSQL_ROUTER_INI "mysqlrouter.conf"
 # Command line options for CMake
 option(ENABLE_TESTS "Enable Tests" NO)
 option(WITH_STATIC "Enable static linkage of external libraries" NO)
+option(WITH_STATIC_PLUGINS "Link the core plugins into the executables instead of loading them" NO)
+if(WITH_STATIC_PLUGINS)
+  if(WIN32 OR APPLE)
+    message(FATAL_ERROR "WITH_STATIC_PLUGINS needs a linker that supports --whole-archive")
+  endif()
+  add_definitions(-DWITH_STATIC_PLUGINS)
+endif()
 option(GPL "Produce GNU GPLv2 source and binaries" YES)
 
 IF(MYSQL_SERVER_SUFFIX STREQUAL "-enterprise-commercial-advanced" OR DEB_PRODUCT STREQUAL "commercial")
@@ -28,6 +28,7 @@
 #include "harness_export.h"
 #include "unique_ptr.h"
 
+#include <atomic>
 #include <functional>
 #include <string>   // unfortunately, std::string is a typedef and therefore not easy to forward-declare
 #include <mutex>    // using fwd declaration + ptr-to-implementation gives build errors on BSD-based systems
@@ -351,6 +352,24 @@
  *     dim.get_Foo().do_something();
  * @endcode
  *
+ * # Lock-free Access
+ *
+ * get_external_generic() takes the lock of DIM on every call. Objects fetched on hot paths,
+ * like the logging registry for every log record, keep an atomic pointer next to the
+ * instance. Once the object got created, get_Foo() only loads that pointer:
+ *
+ * @code
+ *     UniquePtr<Foo>    instance_Foo_;
+ *     std::atomic<Foo*> cached_Foo_{nullptr}; // <---- new member
+ *
+ *     Foo& get_Foo() {
+ *       return get_external_generic(instance_Foo_, cached_Foo_,
+ *                                   factory_Foo_, deleter_Foo_);
+ *     }
+ *
+ *     void reset_Foo() { reset_generic(instance_Foo_, cached_Foo_); }
+ * @endcode
+ *
  */
 
 // forward declarations [step 1]
@@ -359,6 +378,7 @@ namespace mysqlrouter { class Ofstream; }
 namespace mysql_harness { class RandomGeneratorInterface; }
 namespace mysql_harness { namespace logging { class Registry; } }
 namespace mysql_harness { class LoaderConfig; }
+namespace mysql_harness { class Executor; }
 
 namespace mysql_harness {
 
@@ -382,7 +402,7 @@ class HARNESS_EXPORT DIM { // DIM = Dependency Injection Manager
   ////////////////////////////////////////////////////////////////////////////////
 
   // Logging Registry
-  void reset_LoggingRegistry() { reset_generic(instance_LoggingRegistry_); }
+  void reset_LoggingRegistry() { reset_generic(instance_LoggingRegistry_, cached_LoggingRegistry_); }
   void set_LoggingRegistry(const std::function<mysql_harness::logging::Registry*(void)>& factory,
                            const std::function<void(mysql_harness::logging::Registry*)>& deleter) {
     factory_LoggingRegistry_ = factory;
@@ -411,25 +431,36 @@ class HARNESS_EXPORT DIM { // DIM = Dependency Injection Manager
   }
 
   // LoaderConfig
-  void reset_Config() { reset_generic(instance_Config_); }
+  void reset_Config() { reset_generic(instance_Config_, cached_Config_); }
   void set_Config(const std::function<mysql_harness::LoaderConfig*(void)>& factory,
                   const std::function<void(mysql_harness::LoaderConfig*)>& deleter) {
     factory_Config_ = factory;
     deleter_Config_ = deleter;
   }
 
+  // Executor (defaults to one worker per hardware thread)
+  void reset_Executor() { reset_generic(instance_Executor_, cached_Executor_); }
+  void set_Executor(const std::function<mysql_harness::Executor*(void)>& factory,
+                    const std::function<void(mysql_harness::Executor*)>& deleter) {
+    factory_Executor_ = factory;
+    deleter_Executor_ = deleter;
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   // object getters [step 3] (used for singleton objects)
   ////////////////////////////////////////////////////////////////////////////////
 
   // Logging Registry
-  mysql_harness::logging::Registry& get_LoggingRegistry() { return get_external_generic(instance_LoggingRegistry_, factory_LoggingRegistry_, deleter_LoggingRegistry_); }
+  mysql_harness::logging::Registry& get_LoggingRegistry() { return get_external_generic(instance_LoggingRegistry_, cached_LoggingRegistry_, factory_LoggingRegistry_, deleter_LoggingRegistry_); }
 
   // RandomGenerator
   mysql_harness::RandomGeneratorInterface& get_RandomGenerator() const { return get_generic(factory_RandomGenerator_, deleter_RandomGenerator_); }
 
   // LoaderConfig
-  mysql_harness::LoaderConfig& get_Config() { return get_external_generic(instance_Config_, factory_Config_, deleter_Config_); }
+  mysql_harness::LoaderConfig& get_Config() { return get_external_generic(instance_Config_, cached_Config_, factory_Config_, deleter_Config_); }
+
+  // Executor
+  mysql_harness::Executor& get_Executor() { return get_external_generic(instance_Executor_, cached_Executor_, factory_Executor_, deleter_Executor_); }
 
   ////////////////////////////////////////////////////////////////////////////////
   // object creators [step 3] (used for non-singleton objects)
@@ -450,6 +481,7 @@ class HARNESS_EXPORT DIM { // DIM = Dependency Injection Manager
   std::function<mysql_harness::logging::Registry*(void)> factory_LoggingRegistry_;
   std::function<void(mysql_harness::logging::Registry*)> deleter_LoggingRegistry_;
   UniquePtr<mysql_harness::logging::Registry> instance_LoggingRegistry_;
+  std::atomic<mysql_harness::logging::Registry*> cached_LoggingRegistry_{nullptr};
 
   // MySQLSession
   std::function<mysqlrouter::MySQLSession*(void)> factory_MySQLSession_;
@@ -467,6 +499,13 @@ class HARNESS_EXPORT DIM { // DIM = Dependency Injection Manager
   std::function<mysql_harness::LoaderConfig*(void)> factory_Config_;
   std::function<void(mysql_harness::LoaderConfig*)> deleter_Config_;
   UniquePtr<mysql_harness::LoaderConfig> instance_Config_;
+  std::atomic<mysql_harness::LoaderConfig*> cached_Config_{nullptr};
+
+  // Executor
+  std::function<mysql_harness::Executor*(void)> factory_Executor_;
+  std::function<void(mysql_harness::Executor*)> deleter_Executor_;
+  UniquePtr<mysql_harness::Executor> instance_Executor_;
+  std::atomic<mysql_harness::Executor*> cached_Executor_{nullptr};
 
 
 
@@ -515,6 +554,21 @@ class HARNESS_EXPORT DIM { // DIM = Dependency Injection Manager
     return *object;
   }
 
+  // lock-free once the object got created: only the first calls take the lock
+  template <typename T>
+  T& get_external_generic(UniquePtr<T>& object, std::atomic<T*>& cached,
+                          const std::function<T*(void)>& factory, const std::function<void(T*)>& deleter) {
+    T* obj = cached.load(std::memory_order_acquire);
+    if (obj) return *obj;
+
+    std::lock_guard<std::recursive_mutex> lock(mtx_);
+    if (!object)
+      object = new_generic(factory, deleter);
+    cached.store(object.get(), std::memory_order_release);
+
+    return *object;
+  }
+
   template <typename T>
   void reset_generic(UniquePtr<T>& object) {
     mtx_.lock();
@@ -523,6 +577,14 @@ class HARNESS_EXPORT DIM { // DIM = Dependency Injection Manager
     object.reset();
   }
 
+  // like with get_external_generic() without cache, references taken before stay the caller's business
+  template <typename T>
+  void reset_generic(UniquePtr<T>& object, std::atomic<T*>& cached) {
+    std::lock_guard<std::recursive_mutex> lock(mtx_);
+    cached.store(nullptr, std::memory_order_release);
+    object.reset();
+  }
+
   mutable std::recursive_mutex mtx_;
 
 };  // class DIM
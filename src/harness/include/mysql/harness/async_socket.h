@@ -0,0 +1,313 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_ASYNC_SOCKET_INCLUDED
+#define MYSQL_HARNESS_ASYNC_SOCKET_INCLUDED
+
+#include "harness_export.h"
+#include "mysql/harness/async_task.h"
+#include "mysql/harness/loop_monitor.h"
+#include "mysql/harness/timer_wheel.h"
+#include "socket_operations.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace mysql_harness {
+
+/**
+ * Event loop the operations of AsyncSocket wait in.
+ *
+ * The thread calling run() runs the loop: it waits for the sockets to get
+ * ready, with epoll on Linux and poll() elsewhere, and calls the handlers
+ * of the waits, of the expired timers and the tasks posted from other
+ * threads. While it runs, the loop is watched by the LoopMonitor.
+ *
+ * Timers and the deadlines of the waits are kept in a TimerWheel with a
+ * tick of kTimerTick, adding and cancelling them costs O(1) however many
+ * there are.
+ *
+ * Apart from post() and stop(), it is only used by the thread running it.
+ * Handlers of waits still pending once it got destroyed aren't called.
+ */
+class HARNESS_EXPORT IoContext {
+ public:
+  using clock_type = std::chrono::steady_clock;
+  using Handler = std::function<void(std::error_code)>;
+  using TimerId = uint64_t;
+
+  /** @brief precision of the timers */
+  static constexpr std::chrono::milliseconds kTimerTick{1};
+  /** @brief slots of each level of the timer wheel */
+  static const size_t kTimerSlots = 256;
+
+  /** @brief event a socket is waited for */
+  enum Event : unsigned {
+    kRead = 0,
+    kWrite = 1,
+  };
+
+  /**
+   * @param name name of the loop for the LoopMonitor
+   *
+   * @throws std::system_error if the poller can't be created
+   */
+  explicit IoContext(const std::string& name = "IoContext");
+  ~IoContext();
+
+  IoContext(const IoContext&) = delete;
+  IoContext& operator=(const IoContext&) = delete;
+
+  /**
+   * Runs the loop until stop() gets called.
+   *
+   * @throws std::system_error if waiting for the sockets fails
+   */
+  void run();
+
+  /** @brief makes run() return, callable from any thread */
+  void stop();
+
+  /** @brief true once stop() got called */
+  bool is_stopped() const noexcept {
+    return stopped_;
+  }
+
+  /** @brief runs the task in the loop soon, callable from any thread */
+  void post(std::function<void()> task);
+
+  /**
+   * Waits once for a socket to get ready.
+   *
+   * A socket has at most one wait per event. The handler is called with
+   * no error once the socket got ready or has an error pending, with
+   * std::errc::timed_out once the deadline passed and with
+   * std::errc::operation_canceled if cancel() got called.
+   *
+   * @param fd socket to wait for
+   * @param event event to wait for
+   * @param deadline time the wait fails at, clock_type::time_point::max()
+   *        for none
+   * @param handler called once the wait is over
+   *
+   * @throws std::logic_error if the socket is waited for this event already
+   */
+  void async_wait(int fd, Event event, clock_type::time_point deadline, Handler handler);
+
+  /**
+   * Runs a handler in the loop once the delay passed.
+   *
+   * @return id of the timer for cancel_timer()
+   */
+  TimerId schedule(std::chrono::milliseconds delay, std::function<void()> handler);
+
+  /**
+   * Cancels a timer, its handler doesn't get called.
+   *
+   * @return false if the timer expired or got cancelled already
+   */
+  bool cancel_timer(TimerId id);
+
+  /**
+   * Stops waiting for a socket, before it gets closed.
+   *
+   * The handlers of its waits get posted with std::errc::operation_canceled.
+   */
+  void cancel(int fd);
+
+ private:
+  struct Wait {
+    Handler handler;
+    /** @brief timer of the deadline, 0 without deadline */
+    TimerId timer;
+  };
+
+  struct Watch {
+    Wait waits[2];
+    bool waiting[2]{false, false};
+    /** @brief events the poller watches the socket for */
+    unsigned polled{0};
+  };
+
+  /** @brief what a timer does once it expired, fd is -1 for schedule()d ones */
+  struct Timer {
+    int fd;
+    Event event;
+    std::function<void()> handler;
+  };
+
+  /** @brief takes the wait of an event and posts or calls its handler */
+  void complete(int fd, Event event, std::error_code ec, bool post_handler);
+
+  /** @brief tells the poller the events the socket is waited for now */
+  void update(int fd);
+
+  /** @brief fails the waits whose deadline passed and runs the due timers */
+  void expire_timers();
+
+  /** @brief waits for the sockets, returns the ready ones */
+  void poll_once(int timeout_ms, std::vector<std::pair<int, Event>>& ready);
+
+  void run_posted();
+  void wakeup() noexcept;
+
+  const std::string name_;
+  std::atomic<bool> stopped_{false};
+
+  std::unordered_map<int, Watch> watches_;
+  TimerWheel<TimerId> timer_wheel_{kTimerTick, kTimerSlots};
+  std::unordered_map<TimerId, Timer> timers_;
+  TimerId next_timer_id_{1};
+
+  std::mutex posted_mtx_;
+  std::vector<std::function<void()>> posted_;
+
+  /** @brief epoll instance, -1 if poll() is used */
+  int poll_fd_{-1};
+  /** @brief wakes up the wait of the loop, not used on Windows */
+  int wakeup_fds_[2]{-1, -1};
+};
+
+/**
+ * Non-blocking socket whose operations are Tasks completing in an IoContext.
+ *
+ * The operations try the socket right away and wait in the IoContext
+ * only if it would block. Their timeouts are the time the whole operation
+ * may take, a negative timeout lets it wait forever.
+ *
+ * Operations are started from the thread running the IoContext, one read
+ * and one write at a time. Their tasks refer to the socket, it has to
+ * outlive them; destroying or closing it cancels the pending ones, whose
+ * handlers don't use the socket anymore.
+ *
+ * Errors are the errno (std::generic_category()), respectively the
+ * WSAGetLastError() (std::system_category()) of the failed call.
+ */
+class HARNESS_EXPORT AsyncSocket {
+ public:
+  /**
+   * Takes over a socket and makes it non-blocking.
+   *
+   * @param io_ctx loop the operations wait in
+   * @param fd socket, -1 for none
+   * @param sock_ops socket operations the calls go through
+   */
+  AsyncSocket(IoContext& io_ctx, int fd,
+              SocketOperationsBase* sock_ops = SocketOperations::instance());
+
+  /** @brief calls close() */
+  ~AsyncSocket();
+
+  AsyncSocket(const AsyncSocket&) = delete;
+  AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+  int fd() const noexcept {
+    return fd_;
+  }
+
+  IoContext& io_context() const noexcept {
+    return io_ctx_;
+  }
+
+  /**
+   * Connects the socket.
+   *
+   * @param addr address to connect to, copied
+   * @param addr_len length of addr
+   * @param timeout time the connect may take
+   */
+  Task<Unit> connect(const struct sockaddr* addr, socklen_t addr_len,
+                     std::chrono::milliseconds timeout);
+
+  /**
+   * Accepts a connection on a listening socket.
+   *
+   * @return task completing with the socket of the connection, to be taken
+   *         over by an AsyncSocket
+   */
+  Task<int> accept(std::chrono::milliseconds timeout);
+
+  /**
+   * Reads the data available, waiting for some if there is none.
+   *
+   * @return task completing with the number of bytes read, 0 if the peer
+   *         closed the connection
+   */
+  Task<size_t> read(void* buffer, size_t size, std::chrono::milliseconds timeout);
+
+  /**
+   * Reads exactly size bytes.
+   *
+   * Fails with std::errc::connection_reset if the peer closed the connection
+   * before.
+   */
+  Task<size_t> read_exact(void* buffer, size_t size, std::chrono::milliseconds timeout);
+
+  /**
+   * Writes the whole buffer.
+   *
+   * @return task completing with size
+   */
+  Task<size_t> write(const void* buffer, size_t size, std::chrono::milliseconds timeout);
+
+  /** @brief cancels the pending operations and closes the socket */
+  void close();
+
+ private:
+  struct Transfer;
+
+  /** @brief accepts or waits until a connection can be accepted */
+  void accept_some(IoContext::clock_type::time_point deadline, Task<int>::Done done);
+
+  /** @brief reads or waits until there is data to read */
+  void read_some(void* buffer, size_t size, IoContext::clock_type::time_point deadline,
+                 Task<size_t>::Done done);
+
+  /** @brief continues a read_exact() or write() until done or it would block */
+  void transfer(std::shared_ptr<Transfer> op);
+
+  /** @brief error of the last failed call */
+  std::error_code last_error() const;
+
+  /** @brief true if the last failed call would have blocked */
+  bool would_block() const;
+
+  static IoContext::clock_type::time_point to_deadline(std::chrono::milliseconds timeout);
+
+  IoContext& io_ctx_;
+  int fd_;
+  SocketOperationsBase* sock_ops_;
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_ASYNC_SOCKET_INCLUDED
@@ -0,0 +1,198 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_ASYNC_TASK_INCLUDED
+#define MYSQL_HARNESS_ASYNC_TASK_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace mysql_harness {
+
+/** @brief value of a Task that only tells if it succeeded */
+struct Unit {};
+
+/**
+ * Asynchronous operation that completes with an error or a value.
+ *
+ * A Task does nothing until start() gets called, it is a recipe for the
+ * operation. then() chains a step that runs once the task succeeded and
+ * returns the task to continue with, which lets protocol logic be written
+ * as a sequence of steps instead of a state machine:
+ *
+ * @code
+ * sock.connect(addr, addr_len, timeout)
+ *     .then([&](Unit) { return sock.write(greeting, sizeof(greeting), timeout); })
+ *     .then([&](size_t) { return sock.read_exact(buf, 4, timeout); })
+ *     .start([](std::error_code ec, size_t) { ... });
+ * @endcode
+ *
+ * An error skips the steps chained with then() up to the next recover().
+ *
+ * The steps run on the thread completing the previous step, for the
+ * operations of AsyncSocket that is the thread running the IoContext.
+ * Exceptions thrown by a step aren't caught.
+ *
+ * @tparam T value of the task, default-constructible as failed tasks
+ *           complete with a default value
+ */
+template <class T>
+class Task {
+ public:
+  using value_type = T;
+  /** @brief called once the task completed */
+  using Done = std::function<void(std::error_code, T)>;
+  /** @brief starts the operation, which calls done once it completed */
+  using Start = std::function<void(Done)>;
+
+  explicit Task(Start start) : start_(std::move(start)) {}
+
+  /** @brief task that completes right away with a value */
+  static Task ready(T value) {
+    return Task([value](Done done) { done(std::error_code(), value); });
+  }
+
+  /** @brief task that completes right away with an error */
+  static Task failed(std::error_code ec) {
+    return Task([ec](Done done) { done(ec, T()); });
+  }
+
+  /**
+   * Continues with another task once this one succeeded.
+   *
+   * @param f called with the value of this task, returns the Task to
+   *          continue with
+   *
+   * @return task completing with the task returned by f
+   */
+  template <class F, class R = typename std::result_of<F(T)>::type>
+  R then(F f) const {
+    using U = typename R::value_type;
+
+    Start start = start_;
+    return R([start, f](typename R::Done done) {
+      start([f, done](std::error_code ec, T value) {
+        if (ec) {
+          done(ec, U());
+          return;
+        }
+        f(std::move(value)).start(done);
+      });
+    });
+  }
+
+  /**
+   * Continues with another task if this one failed.
+   *
+   * @param f called with the error of this task, returns the Task to
+   *          continue with, like Task<T>::failed() to pass the error on
+   *
+   * @return task completing with the value of this task or the one
+   *         returned by f
+   */
+  template <class F>
+  Task recover(F f) const {
+    Start start = start_;
+    return Task([start, f](Done done) {
+      start([f, done](std::error_code ec, T value) {
+        if (!ec) {
+          done(ec, std::move(value));
+          return;
+        }
+        f(ec).start(done);
+      });
+    });
+  }
+
+  /**
+   * Starts the task.
+   *
+   * A task may be started more than once, each start runs the operation
+   * again.
+   *
+   * @param done called once the task completed
+   */
+  void start(Done done) const {
+    start_(std::move(done));
+  }
+
+ private:
+  Start start_;
+};
+
+/**
+ * Runs a task again as long as it succeeds and pred returns true.
+ *
+ * Loops of protocol logic, like reading packets until the last one of a
+ * resultset, are written with it.
+ *
+ * @param make returns the task of the next round
+ * @param pred called with the value of each round, false ends the loop
+ *
+ * @return task completing with the value of the last round or the first
+ *         error
+ */
+template <class T>
+Task<T> repeat_while(std::function<Task<T>()> make, std::function<bool(const T&)> pred) {
+  return Task<T>([make, pred](typename Task<T>::Done done) {
+    struct Loop {
+      std::function<Task<T>()> make;
+      std::function<bool(const T&)> pred;
+      typename Task<T>::Done done;
+      /** @brief true while a round gets started */
+      bool starting;
+      /** @brief set if the round completed while it got started */
+      bool again;
+
+      // rounds completing right away continue in the loop instead of
+      // growing the stack, the others start the next round themselves
+      static void run(std::shared_ptr<Loop> loop) {
+        do {
+          loop->starting = true;
+          loop->again = false;
+          loop->make().start([loop](std::error_code ec, T value) {
+            if (ec || !loop->pred(value)) {
+              loop->done(ec, std::move(value));
+            } else if (loop->starting) {
+              loop->again = true;
+            } else {
+              run(loop);
+            }
+          });
+          loop->starting = false;
+        } while (loop->again);
+      }
+    };
+
+    std::shared_ptr<Loop> loop(new Loop{make, pred, done, false, false});
+    Loop::run(loop);
+  });
+}
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_ASYNC_TASK_INCLUDED
@@ -27,11 +27,14 @@
 
 #include <functional>
 #include <iterator>
+#include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "harness_export.h"
@@ -221,8 +224,53 @@ class HARNESS_EXPORT ConfigSection {
   std::pair<OptionMap::const_iterator, bool>
       do_locate(const std::string& option) const;
 
+  /** @brief hashes option names ignoring the case, to look them up without lowering */
+  struct OptionNameHash {
+    size_t operator()(const std::string& option) const noexcept;
+  };
+
+  /** @brief compares option names ignoring the case */
+  struct OptionNameEqual {
+    bool operator()(const std::string& a, const std::string& b) const noexcept;
+  };
+
+  /**
+   * Values of the options of the section and its defaults, interpolated.
+   *
+   * Options whose interpolation fails are left out, get() reports the error.
+   */
+  struct OptionTable {
+    std::unordered_map<std::string, std::string, OptionNameHash, OptionNameEqual> values;
+    uint64_t version;
+    uint64_t defaults_version;
+  };
+
+  /**
+   * Holds the OptionTable until the section or its defaults change.
+   *
+   * Not copied along with the section, the copy builds its own.
+   */
+  class OptionTableCache {
+   public:
+    OptionTableCache() = default;
+    OptionTableCache(const OptionTableCache&) {}
+    OptionTableCache& operator=(const OptionTableCache&) { return *this; }
+
+    /** @brief builds the table once for concurrent readers, accessed with std::atomic_load/store */
+    std::mutex mtx;
+    std::shared_ptr<const OptionTable> table;
+  };
+
+  /** @brief returns the table, building it if the section or the defaults changed */
+  std::shared_ptr<const OptionTable> get_option_table() const;
+
   const std::shared_ptr<const ConfigSection> defaults_;
   OptionMap options_;
+
+  /** @brief changed on every change of options_ */
+  uint64_t version_{0};
+
+  mutable OptionTableCache option_table_;
 };
 
 
@@ -446,6 +494,11 @@ class HARNESS_EXPORT Config {
   bool has_default(const std::string& option) const;
   void set_default(const std::string& option, const std::string& value);
 
+  /** Range for the options of the default section. */
+  ConfigSection::OptionRange get_default_options() const {
+    return defaults_->get_options();
+  }
+
   bool is_reserved(const std::string& word) const;
 
   std::list<Config::SectionKey> section_names() const {
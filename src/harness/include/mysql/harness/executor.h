@@ -0,0 +1,170 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_EXECUTOR_INCLUDED
+#define MYSQL_HARNESS_EXECUTOR_INCLUDED
+
+#include "harness_export.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mysql_harness {
+
+/**
+ * Pool of worker threads the harness and the plugins run short tasks on.
+ *
+ * Each worker has a deque of its own. Tasks submitted by a worker go to its
+ * own deque and it runs the newest first, while the data the submitting task
+ * touched is still in its cache. Tasks submitted by other threads are spread
+ * over the workers round-robin. Workers that run out of tasks steal the
+ * oldest tasks of the others.
+ *
+ * Timers run a task on the pool once their delay expired.
+ *
+ * The executor is available through DIM::get_Executor(), its number of
+ * workers is set by the `executor_threads` option in the [DEFAULT] section,
+ * the CPUs they run on by `executor_cpu_affinity`.
+ *
+ * Tasks should not block for long as that holds up the tasks queued behind
+ * them. Threads that block by design, like a thread serving a client
+ * connection or running the start() of a plugin, stay threads of their own.
+ */
+class HARNESS_EXPORT Executor {
+ public:
+  using Task = std::function<void()>;
+  using TimerId = uint64_t;
+
+  /**
+   * Starts the worker threads.
+   *
+   * @param num_threads number of workers, 0 for one per hardware thread
+   * @param cpus CPUs the workers get pinned to, all if empty
+   */
+  explicit Executor(size_t num_threads = 0, const std::vector<unsigned>& cpus = {});
+
+  /**
+   * Calls stop().
+   */
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  /**
+   * Number of worker threads.
+   */
+  size_t size() const noexcept {
+    return workers_.size();
+  }
+
+  /**
+   * Runs a task on one of the workers.
+   *
+   * @param task task to run
+   *
+   * @return future that is ready once the task ran and holds the exception
+   *         it threw
+   *
+   * @throws std::logic_error if the executor is stopped
+   */
+  std::future<void> submit(Task task);
+
+  /**
+   * Runs a task on one of the workers once delay expired.
+   *
+   * @param delay time to wait before submitting the task
+   * @param task task to run
+   *
+   * @return id of the timer for cancel()
+   *
+   * @throws std::logic_error if the executor is stopped
+   */
+  TimerId schedule(std::chrono::milliseconds delay, Task task);
+
+  /**
+   * Cancels a timer.
+   *
+   * @return true if the timer got cancelled before its task got submitted
+   */
+  bool cancel(TimerId id);
+
+  /**
+   * Runs the queued tasks, drops the pending timers and joins the threads.
+   *
+   * Calling it more than once is safe.
+   */
+  void stop();
+
+ private:
+  struct Worker {
+    std::mutex mtx;
+    std::deque<std::packaged_task<void()>> tasks;
+    std::thread thread;
+  };
+
+  void push(std::packaged_task<void()> task);
+  bool pop(size_t ndx, std::packaged_task<void()>& task);
+  bool steal(size_t ndx, std::packaged_task<void()>& task);
+
+  void worker_loop(size_t ndx);
+  void timer_loop();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  const std::vector<unsigned> cpus_;
+  std::atomic<size_t> next_worker_{0};
+
+  /** @brief tasks queued and not yet taken by a worker */
+  std::atomic<size_t> pending_{0};
+  std::mutex idle_mtx_;
+  std::condition_variable idle_cond_;
+  std::atomic<bool> stopping_{false};
+
+  using TimerKey = std::pair<std::chrono::steady_clock::time_point, TimerId>;
+
+  std::mutex timers_mtx_;
+  std::condition_variable timers_cond_;
+  /** @brief timers by expiry, the id makes timers expiring at the same time unique */
+  std::map<TimerKey, Task> timers_;
+  /** @brief expiry of the timers, by id */
+  std::map<TimerId, std::chrono::steady_clock::time_point> timer_expiry_;
+  TimerId next_timer_id_{1};
+  bool timers_stopping_{false};
+  std::thread timer_thread_;
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_EXECUTOR_INCLUDED
@@ -105,6 +105,11 @@
  * When one of these two events occurrs, harness progresses to the
  * next step.
  *
+ * On SIGHUP, the harness re-reads the configuration (if a reader got set
+ * with `set_config_reader()`) and stops, starts or restarts only the
+ * sections that got removed, added or changed. A section started this
+ * way exiting with error doesn't stop the others.
+ *
  *
  *
  * ### 5. Stopping ###
@@ -626,10 +631,12 @@ Actions taken for each plugin function are as follows:
 #include <csignal>
 #include <cstdarg>  // va_list
 #include <exception>
+#include <functional>
 #include <future>
 #include <istream>
 #include <list>
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
@@ -668,6 +675,8 @@ Actions taken for each plugin function are as follows:
   DECLARE_TEST(LifecycleTest, OneInstance_NothingPersists_StopFails);
   DECLARE_TEST(LifecycleTest, ThreeInstances_InitFails);
   DECLARE_TEST(LifecycleTest, BothLifecycles_InitFails);
+  DECLARE_TEST(LifecycleTest, BothLifecycles_InitOrder);
+  DECLARE_TEST(LifecycleTest, BothLifecycles_InitReturnsError);
   DECLARE_TEST(LifecycleTest, ThreeInstances_Start1Fails);
   DECLARE_TEST(LifecycleTest, ThreeInstances_Start2Fails);
   DECLARE_TEST(LifecycleTest, ThreeInstances_Start3Fails);
@@ -688,6 +697,7 @@ Actions taken for each plugin function are as follows:
   DECLARE_TEST(LifecycleTest, StartThrowsWeird);
   DECLARE_TEST(LifecycleTest, StopThrowsWeird);
   DECLARE_TEST(LifecycleTest, DeinitThrowsWeird);
+  DECLARE_TEST(LifecycleTest, Reload_InvalidSectionKeepsRunning);
   DECLARE_TEST(LoaderReadTest, Loading);
 #endif
 
@@ -815,6 +825,39 @@ class HARNESS_EXPORT Loader {
    */
   LoaderConfig &get_config() { return config_; }
 
+  /** @brief reads the configuration again from where the running one came from */
+  using ConfigReader = std::function<std::unique_ptr<LoaderConfig>()>;
+
+  /**
+   * Enables reloading the configuration on SIGHUP.
+   *
+   * The running plugin sections get compared against the newly read ones:
+   * removed sections get stopped, added ones started and changed ones
+   * restarted, unless the plugin takes the changes while running (see
+   * Reconfiguration). Unchanged sections keep running. Changes to the
+   * default section and sections of plugins that aren't loaded yet need
+   * a restart of the application.
+   *
+   * @param reader returns the new configuration, throws if it is invalid
+   */
+  void set_config_reader(ConfigReader reader) {
+    config_reader_ = std::move(reader);
+  }
+
+  /**
+   * Registers a plugin that is linked into the executable.
+   *
+   * Sections of the plugin that don't name another library are served by
+   * the registered plugin instead of loading it from the plugin folder.
+   * Called before the plugins get loaded, usually by the static
+   * initializers the build generates for the plugins it links in (see
+   * WITH_STATIC_PLUGINS).
+   *
+   * @param name name of the plugin, as in its harness_plugin_<name> symbol
+   * @param plugin the plugin structure
+   */
+  static void add_builtin_plugin(const std::string& name, Plugin* plugin);
+
  private:
   enum class Status {
     UNVISITED,
@@ -874,18 +917,45 @@ class HARNESS_EXPORT Loader {
   // IMPORTANT design note: start_all() will block until PluginFuncEnv objects
   // have been created for all plugins. This guarantees that the required
   // PluginFuncEnv will always exist when plugin stop() function is called.
+  //
+  // init_all() calls init() of one plugin after the other, in topological
+  // order. Plugins don't guard what init() sets up against each other, and
+  // the slow part of getting ready is done in start(), which start_all()
+  // runs for all sections at once.
 
   // start() calls these, indents reflect call hierarchy
   void               load_all();     // throws bad_plugin on load error
   void                 setup_info();
   std::exception_ptr run();          // returns first exception returned from below harness functions
   std::exception_ptr   init_all();   // returns first exception triggered by init()
+  std::exception_ptr     init_plugin(const std::string& plugin_name);  // returns exception triggered by its init()
   void                 start_all();  // forwards first exception triggered by start() to main_loop()
   std::exception_ptr   main_loop();  // returns first exception triggered by start() or stop()
   std::exception_ptr     stop_all(); // returns first exception triggered by stop()
+  void                   reload_config();  // on SIGHUP, errors get logged
   std::exception_ptr   deinit_all(); // returns first exception triggered by deinit()
   void               unload_all();
 
+  // start_all(), stop_all() and reload_config() call these for each section
+
+  /**
+   * Launches the thread running start() of the plugin for a section.
+   *
+   * @return future of the env object of the thread, invalid if the plugin
+   * doesn't implement start() and the env object got stored already
+   */
+  std::future<std::shared_ptr<PluginFuncEnv>> launch_section(const ConfigSection* section);
+
+  /**
+   * Flags start() of the section to exit and calls stop() of its plugin.
+   */
+  void stop_section(const ConfigSection* section, std::exception_ptr& first_eptr);
+
+  /**
+   * Stops the section and waits for its start() to exit.
+   */
+  void stop_and_join_section(const ConfigSection* section);
+
   /**
    * Topological sort of all plugins and their dependencies.
    *
@@ -893,6 +963,7 @@ class HARNESS_EXPORT Loader {
    * to "bottom".
    */
   bool topsort();
+
   bool visit(const std::string& name, std::map<std::string, Status>* seen,
              std::list<std::string>* order);
 
@@ -906,7 +977,7 @@ class HARNESS_EXPORT Loader {
     PluginInfo(const std::string& folder, const std::string& library); // throws bad_plugin
     PluginInfo(const PluginInfo&) = delete;
     PluginInfo(PluginInfo&&);
-    PluginInfo(void* h, Plugin* ext) : handle(h), plugin(ext) {}
+    PluginInfo(void* h, Plugin* ext) : handle(h), plugin(ext), impl_(nullptr) {}
     ~PluginInfo();
 
     void load_plugin(const std::string& name);  // throws bad_plugin
@@ -930,7 +1001,7 @@ class HARNESS_EXPORT Loader {
   };
 
   using PluginMap = std::map<std::string, PluginInfo>;
-  using SessionList = std::vector<std::future<std::exception_ptr>>;
+  using SessionList = std::map<const ConfigSection*, std::future<std::exception_ptr>>;
 
   // Init order is important, so keep config_ first.
 
@@ -956,10 +1027,25 @@ class HARNESS_EXPORT Loader {
   std::map<const ConfigSection*, std::shared_ptr<PluginFuncEnv>> plugin_start_env_;
 
   /**
-   * List of all active session.
+   * List of all active session, by section.
    */
   SessionList sessions_;
 
+  /**
+   * Sections started by reload_config(), their failures don't shut down the
+   * application.
+   */
+  std::set<const ConfigSection*> reloaded_sections_;
+
+  /**
+   * Options of the sections whose plugin took the changes of a reload while
+   * running. Their ConfigSection keeps the options they were started with,
+   * as the plugin may still read them.
+   */
+  std::map<Config::SectionKey, ConfigSection::OptionMap> applied_options_;
+
+  ConfigReader config_reader_;
+
   /**
    * Initialization order.
    */
@@ -992,6 +1078,8 @@ class HARNESS_EXPORT Loader {
   FRIEND_TEST(::LifecycleTest, OneInstance_NothingPersists_StopFails);
   FRIEND_TEST(::LifecycleTest, ThreeInstances_InitFails);
   FRIEND_TEST(::LifecycleTest, BothLifecycles_InitFails);
+  FRIEND_TEST(::LifecycleTest, BothLifecycles_InitOrder);
+  FRIEND_TEST(::LifecycleTest, BothLifecycles_InitReturnsError);
   FRIEND_TEST(::LifecycleTest, ThreeInstances_Start1Fails);
   FRIEND_TEST(::LifecycleTest, ThreeInstances_Start2Fails);
   FRIEND_TEST(::LifecycleTest, ThreeInstances_Start3Fails);
@@ -1012,6 +1100,7 @@ class HARNESS_EXPORT Loader {
   FRIEND_TEST(::LifecycleTest, StartThrowsWeird);
   FRIEND_TEST(::LifecycleTest, StopThrowsWeird);
   FRIEND_TEST(::LifecycleTest, DeinitThrowsWeird);
+  FRIEND_TEST(::LifecycleTest, Reload_InvalidSectionKeepsRunning);
   FRIEND_TEST(::LoaderReadTest, Loading);
 #endif
 
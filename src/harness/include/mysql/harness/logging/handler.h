@@ -26,12 +26,20 @@
 #define MYSQL_HARNESS_LOGGER_HANDLER_INCLUDED
 
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/ring_queue.h"
 #include "harness_export.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace mysql_harness {
 
@@ -71,6 +79,15 @@ class HARNESS_EXPORT Handler {
  protected:
   std::string format(const Record& record) const;
 
+  /**
+   * Format a record into a buffer.
+   *
+   * Same as format(const Record&), but replaces the content of `out`. A
+   * buffer that is reused across calls doesn't allocate once it has grown
+   * to the size of the messages.
+   */
+  void format(const Record& record, std::string& out) const;
+
   explicit Handler(bool format_messages, LogLevel level);
 
  private:
@@ -116,6 +133,14 @@ class HARNESS_EXPORT StreamHandler : public Handler {
                          LogLevel level = LogLevel::kNotSet);
 
  protected:
+  /**
+   * Called with stream_mutex_ locked, right before a formatted record is
+   * written to the stream.
+   *
+   * @param size size of the formatted record, including the newline
+   */
+  virtual void before_write(size_t size) { (void)size; }
+
   std::ostream& stream_;
   std::mutex stream_mutex_;
 
@@ -123,6 +148,26 @@ class HARNESS_EXPORT StreamHandler : public Handler {
   void do_log(const Record& record) override;
 };
 
+/**
+ * When FileHandler rotates its log file, and what becomes of the old ones.
+ *
+ * A rotated file is renamed to `<file>.<YYYYmmdd-HHMMSS>`. It is compressed
+ * to `<file>.<YYYYmmdd-HHMMSS>.gz` in the background, if requested and if
+ * the harness is built with zlib.
+ */
+struct LogRotation {
+  /** rotate before the file grows beyond this many bytes, 0 for no limit */
+  uint64_t max_size{0};
+  /** rotate once the file has been written to for this long, 0 for no limit */
+  std::chrono::seconds max_age{0};
+  /** number of rotated files to keep, 0 to keep all */
+  unsigned keep{0};
+  /** compress rotated files */
+  bool compress{true};
+
+  bool enabled() const { return max_size > 0 || max_age.count() > 0; }
+};
+
 /**
  * Handler that writes to a file.
  *
@@ -136,15 +181,255 @@ class HARNESS_EXPORT FileHandler : public StreamHandler {
  public:
   static constexpr const char* kDefaultName = "file";
 
+  /**
+   * @param path file to log to, appended to if it exists
+   * @param format_messages if true, records are prefixed with timestamp, etc
+   * @param level log level of the handler
+   * @param rotation when to rotate the file, never by default
+   *
+   * @throws std::system_error if the file can't be opened
+   */
   explicit FileHandler(const Path& path,
                        bool format_messages = true,
-                       LogLevel level = LogLevel::kNotSet);
+                       LogLevel level = LogLevel::kNotSet,
+                       const LogRotation& rotation = LogRotation());
   ~FileHandler();
 
  private:
+  void before_write(size_t size) override;
+
+  // renames the file and opens a new one; stream_mutex_ must be locked
+  void rotate();
+
+  // compresses and prunes rotated files, runs in housekeeper_
+  void housekeeping_loop();
+  void compress_rotated_file(const std::string& filename);
+  void prune_rotated_files();
+
+  const std::string path_;
+  const LogRotation rotation_;
   std::ofstream fstream_;
+
+  // protected by stream_mutex_
+  uint64_t file_size_{0};
+  std::chrono::steady_clock::time_point opened_at_;
+
+  std::mutex housekeeping_mtx_;
+  std::condition_variable housekeeping_cond_;
+  std::vector<std::string> rotated_files_;  // waiting for the housekeeper
+  bool stopping_{false};
+  std::thread housekeeper_;
 };
 
+/**
+ * Handler that writes records as JSON lines to an output stream.
+ *
+ * Each record becomes one JSON object on a line of its own, with the
+ * keys "time", "level", "domain", "thread" and "message", followed by the
+ * fields of the LogContext of the logging thread.
+ *
+ * @code
+ * {"time":"2018-04-12 14:05:31","level":"INFO","domain":"routing",...}
+ * @endcode
+ */
+class HARNESS_EXPORT JsonStreamHandler : public StreamHandler {
+ public:
+  static constexpr const char* kDefaultName = "json_stream";
+
+  explicit JsonStreamHandler(std::ostream& stream,
+                             LogLevel level = LogLevel::kNotSet);
+
+ protected:
+  /**
+   * Serialize a record and the current LogContext into a buffer as a JSON
+   * object (without newline).
+   */
+  static void format_json(const Record& record, std::string& out);
+
+ private:
+  void do_log(const Record& record) override;
+};
+
+/**
+ * Handler that writes records as JSON lines to a file.
+ *
+ * @see JsonStreamHandler
+ */
+class HARNESS_EXPORT JsonFileHandler : public JsonStreamHandler {
+ public:
+  static constexpr const char* kDefaultName = "json_file";
+
+  explicit JsonFileHandler(const Path& path,
+                           LogLevel level = LogLevel::kNotSet);
+  ~JsonFileHandler();
+
+ private:
+  std::ofstream fstream_;
+};
+
+/**
+ * Handler that writes records from a dedicated thread.
+ *
+ * Records are formatted in the calling thread and pushed into a bounded
+ * lock-free ring buffer. A writer thread drains the ring and passes the
+ * records in batches to write(), calling flush() at most once per flush
+ * interval, so the threads that log never wait for the output.
+ *
+ * If the ring is full, the record is either dropped (and counted) or the
+ * caller waits until the writer made room, depending on the overflow policy.
+ * The number of dropped records is reported in the log by the writer thread.
+ *
+ * Derived classes start the writer thread with start() once they are
+ * constructed and must call stop() in their destructor, as the writer
+ * thread calls their write() and flush().
+ */
+class HARNESS_EXPORT AsyncHandler : public Handler {
+ public:
+  static constexpr size_t kDefaultCapacity = 4096;
+  static constexpr std::chrono::milliseconds kDefaultFlushInterval{100};
+
+  /**
+   * What to do with a record if the ring buffer is full.
+   */
+  enum class OverflowPolicy {
+    kDrop,   ///< drop the record and count it
+    kBlock,  ///< wait until the writer thread made room
+  };
+
+  ~AsyncHandler();
+
+  /**
+   * Number of records dropped because the ring buffer was full.
+   */
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ protected:
+  /**
+   * @param format_messages if true, records are prefixed with timestamp, etc
+   * @param level log level of the handler
+   * @param policy overflow policy
+   * @param capacity number of records the ring buffer holds (rounded up to
+   *        a power of 2)
+   * @param flush_interval how often the writer thread calls flush()
+   */
+  AsyncHandler(bool format_messages, LogLevel level, OverflowPolicy policy,
+               size_t capacity, std::chrono::milliseconds flush_interval);
+
+  /**
+   * Start the writer thread. Does nothing if it is running already.
+   */
+  void start();
+
+  /**
+   * Write out all queued records and stop the writer thread.
+   *
+   * Records logged while the writer thread is stopped stay queued until it
+   * is started again. Calling it more than once is safe.
+   */
+  void stop();
+
+  /**
+   * Write a record, called by the writer thread.
+   *
+   * @param level log level of the record
+   * @param msg formatted record
+   */
+  virtual void write(LogLevel level, const std::string& msg) = 0;
+
+  /**
+   * Flush what write() wrote, called by the writer thread after a batch.
+   */
+  virtual void flush() {}
+
+ private:
+  void do_log(const Record& record) override;
+
+  void writer_loop();
+
+  /** @brief formatted record queued for the writer thread */
+  struct Entry {
+    LogLevel level;
+    std::string msg;
+  };
+
+  OverflowPolicy policy_;
+  std::chrono::milliseconds flush_interval_;
+
+  // only the writer thread pops
+  mpmc_queue<Entry> ring_;
+
+  std::atomic<uint64_t> dropped_{0};
+  uint64_t reported_dropped_{0};  // only touched by the writer thread
+
+  std::mutex wakeup_mtx_;
+  std::condition_variable wakeup_cond_;
+  std::atomic<bool> stopping_{false};
+  std::thread writer_;
+};
+
+/**
+ * Handler that writes to an output stream from a dedicated thread.
+ *
+ * @code
+ * registry.add_handler("async",
+ *     std::make_shared<AsyncStreamHandler>(std::clog));
+ * @endcode
+ *
+ * @see AsyncHandler
+ */
+class HARNESS_EXPORT AsyncStreamHandler : public AsyncHandler {
+ public:
+  static constexpr const char* kDefaultName = "async_stream";
+
+  /**
+   * @param stream stream to write to
+   * @param format_messages if true, records are prefixed with timestamp, etc
+   * @param level log level of the handler
+   * @param policy overflow policy
+   * @param capacity number of records the ring buffer holds (rounded up to
+   *        a power of 2)
+   * @param flush_interval how often the writer thread flushes the stream
+   */
+  explicit AsyncStreamHandler(std::ostream& stream,
+                              bool format_messages = true,
+                              LogLevel level = LogLevel::kNotSet,
+                              OverflowPolicy policy = OverflowPolicy::kDrop,
+                              size_t capacity = kDefaultCapacity,
+                              std::chrono::milliseconds flush_interval =
+                                  kDefaultFlushInterval);
+  ~AsyncStreamHandler();
+
+ protected:
+  std::ostream& stream_;
+
+ private:
+  void write(LogLevel level, const std::string& msg) override;
+  void flush() override;
+};
+
+/**
+ * Handler that writes to a file from a dedicated thread.
+ *
+ * @see AsyncStreamHandler
+ */
+class HARNESS_EXPORT AsyncFileHandler : public AsyncStreamHandler {
+ public:
+  static constexpr const char* kDefaultName = "async_file";
+
+  explicit AsyncFileHandler(const Path& path,
+                            bool format_messages = true,
+                            LogLevel level = LogLevel::kNotSet,
+                            OverflowPolicy policy = OverflowPolicy::kDrop,
+                            size_t capacity = kDefaultCapacity,
+                            std::chrono::milliseconds flush_interval =
+                                kDefaultFlushInterval);
+  ~AsyncFileHandler();
+
+ private:
+  std::ofstream fstream_;
+};
 
 }  // namespace logging
 
@@ -28,13 +28,16 @@
 #include "mysql/harness/logging/logging.h"
 #include "harness_export.h"
 
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace mysql_harness {
 
 namespace logging {
 
+class Handler;
 class Registry;
 
 /**
@@ -68,6 +71,29 @@ class HARNESS_EXPORT Logger {
   const Registry* registry_;  // owner backreference (we don't own Registry, Registry owns us)
 };
 
+/**
+ * Immutable snapshot of a Logger with its handlers already looked up.
+ *
+ * Obtained from Registry::get_resolved_logger(). Unlike Logger::handle(),
+ * handle() doesn't go through the Registry (and its mutex) for each handler,
+ * which allows callers to cache the snapshot for as long as
+ * Registry::generation() doesn't change.
+ */
+class HARNESS_EXPORT ResolvedLogger {
+ public:
+  ResolvedLogger(LogLevel level, std::vector<std::weak_ptr<Handler>> handlers)
+      : level_(level), handlers_(std::move(handlers)) {}
+
+  void handle(const Record& record) const;
+
+  LogLevel get_level() const { return level_; }
+
+ private:
+  const LogLevel level_;
+  // weak, so that removing a handler from the registry still releases it
+  const std::vector<std::weak_ptr<Handler>> handlers_;
+};
+
 } // namespace logging
 
 } // namespace mysql_harness
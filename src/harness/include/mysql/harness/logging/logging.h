@@ -34,11 +34,15 @@
 #include "mysql/harness/filesystem.h"
 #include "harness_export.h"
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <mutex>
 #include <list>
 #include <string>
+#include <vector>
 #include <cstdarg>
+#include <cstdint>
 
 #ifndef _WIN32
 #  include <sys/types.h>
@@ -85,6 +89,16 @@ const size_t kLogMessageMaxSize = 4096;
 constexpr char kConfigOptionLogLevel[] = "level";
 constexpr char kConfigSectionLogger[] = "logger";
 
+/**
+ * Options of the [logger] section controlling the rotation of the logfile
+ * (see LogRotation): maximum size in bytes, maximum age in seconds, number of
+ * rotated files to keep and whether to compress them (0 or 1).
+ */
+constexpr char kConfigOptionRotateMaxSize[] = "rotate_max_size";
+constexpr char kConfigOptionRotateMaxAge[] = "rotate_max_age";
+constexpr char kConfigOptionRotateKeep[] = "rotate_keep";
+constexpr char kConfigOptionRotateCompress[] = "rotate_compress";
+
 /**
  * Special names reserved for "main" program logger. It will use one of the
  * two handlers, depending on whether logging_folder is empty or not.
@@ -150,6 +164,118 @@ const char* const kDefaultLogLevelName = "warning";
  */
 const char* const kRawLogLevelName = "info";
 
+/**
+ * Key/value fields attached to log records.
+ *
+ * While a LogContext is alive, its fields (and those of the enclosing contexts
+ * of the same thread) belong to every record logged by the thread that created
+ * it. Handlers run in the logging thread, so the ones that produce structured
+ * output (like JsonStreamHandler) get them through LogContext::current(), the
+ * plain text handlers ignore them.
+ *
+ * Values are stored as they are, the cost of turning them into text is only
+ * paid by the handler that writes them:
+ *
+ * @code
+ * LogContext log_context;
+ * log_context.add("route", route_name).add("bytes", bytes);
+ * log_debug("[%s] connection closed", route_name.c_str());
+ * @endcode
+ */
+class HARNESS_EXPORT LogContext {
+ public:
+  struct Field {
+    const char* key;
+    bool is_number;
+    std::string str;
+    long long num;
+  };
+
+  /** Make this the current context of the calling thread. */
+  LogContext();
+
+  /** Restore the context that was current before this one. */
+  ~LogContext();
+
+  LogContext(const LogContext&) = delete;
+  LogContext& operator=(const LogContext&) = delete;
+
+  /**
+   * Add a text field.
+   *
+   * @param key name of the field, must outlive the context (usually a
+   *        string literal)
+   * @param value value of the field
+   */
+  LogContext& add(const char* key, std::string value);
+
+  /**
+   * Add a numeric field.
+   *
+   * @param key name of the field, must outlive the context (usually a
+   *        string literal)
+   * @param value value of the field
+   */
+  LogContext& add(const char* key, long long value);
+
+  const std::vector<Field>& fields() const { return fields_; }
+
+  /** Context that was current when this one was created, or nullptr. */
+  const LogContext* parent() const { return parent_; }
+
+  /** Current context of the calling thread, or nullptr. */
+  static const LogContext* current();
+
+ private:
+  std::vector<Field> fields_;
+  const LogContext* parent_;
+};
+
+/**
+ * Token bucket limiting how often a call site logs.
+ *
+ * Up to `burst` messages are let through at once, after that one message per
+ * `interval`. Messages beyond that are suppressed and counted, the count is
+ * handed out with the next message that is let through. Intended to be used
+ * as a function-local static at the call site, together with the
+ * log_*_limited() functions:
+ *
+ * @code
+ * static LogRateLimiter limiter;
+ * log_warning_limited(limiter, "No destinations currently available");
+ * @endcode
+ *
+ * Lock-free: the bucket is kept as the time at which it would be full again
+ * (GCRA).
+ */
+class HARNESS_EXPORT LogRateLimiter {
+ public:
+  static constexpr unsigned kDefaultBurst = 10;
+  static constexpr std::chrono::milliseconds kDefaultInterval{1000};
+
+  explicit LogRateLimiter(unsigned burst = kDefaultBurst,
+                          std::chrono::milliseconds interval =
+                              kDefaultInterval);
+
+  LogRateLimiter(const LogRateLimiter&) = delete;
+  LogRateLimiter& operator=(const LogRateLimiter&) = delete;
+
+  /**
+   * Take a token.
+   *
+   * @param[out] suppressed number of messages suppressed since the previous
+   *             successful call, only set if this call succeeds
+   * @returns true if the message may be logged
+   */
+  bool allow(uint64_t& suppressed);
+
+ private:
+  const int64_t interval_ns_;
+  const int64_t tolerance_ns_;
+  std::atomic<int64_t> full_at_ns_{0};
+  std::atomic<uint64_t> suppressed_{0};
+};
+
 /**
  * Log record containing information collected by the logging
  * system.
@@ -245,6 +371,78 @@ static inline void log_debug(const char* fmt, ...) {
 }
 #endif
 
+/**
+ * Log message for the domain, at most as often as `limiter` allows.
+ *
+ * Same as log_error(), log_warning(), etc but for messages that can be
+ * triggered at a high rate (for example, once per client connection while a
+ * backend is down). Suppressed messages are counted and reported after the
+ * next message that is let through.
+ *
+ * @param limiter Rate limiter of the call site.
+ * @param fmt `printf`-style format string, with arguments following.
+ */
+/** @{ */
+static inline void log_message_varg(LogLevel level, const char* fmt, ...) ATTRIBUTE_GCC_FORMAT(printf, 2, 3);
+
+// log_message() takes a va_list only
+static inline void log_message_varg(LogLevel level, const char* fmt, ...) {
+  extern void log_message(LogLevel level, const char* module, const char* fmt, va_list ap);
+  va_list ap;
+  va_start(ap, fmt);
+  log_message(level, MYSQL_ROUTER_LOG_DOMAIN, fmt, ap);
+  va_end(ap);
+}
+
+static inline void log_message_limited(LogLevel level, LogRateLimiter& limiter,
+                                       const char* fmt, va_list ap) {
+  extern void log_message(LogLevel level, const char* module, const char* fmt, va_list ap);
+  uint64_t suppressed;
+  if (!limiter.allow(suppressed))
+    return;
+
+  log_message(level, MYSQL_ROUTER_LOG_DOMAIN, fmt, ap);
+
+  if (suppressed > 0) {
+    log_message_varg(level, "%llu more messages like the previous one were suppressed",
+                     static_cast<unsigned long long>(suppressed));
+  }
+}
+
+static inline void log_error_limited(LogRateLimiter& limiter, const char *fmt, ...) ATTRIBUTE_GCC_FORMAT(printf, 2, 3);
+static inline void log_warning_limited(LogRateLimiter& limiter, const char *fmt, ...) ATTRIBUTE_GCC_FORMAT(printf, 2, 3);
+static inline void log_info_limited(LogRateLimiter& limiter, const char *fmt, ...) ATTRIBUTE_GCC_FORMAT(printf, 2, 3);
+static inline void log_debug_limited(LogRateLimiter& limiter, const char *fmt, ...) ATTRIBUTE_GCC_FORMAT(printf, 2, 3);
+
+static inline void log_error_limited(LogRateLimiter& limiter, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  log_message_limited(LogLevel::kError, limiter, fmt, ap);
+  va_end(ap);
+}
+
+static inline void log_warning_limited(LogRateLimiter& limiter, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  log_message_limited(LogLevel::kWarning, limiter, fmt, ap);
+  va_end(ap);
+}
+
+static inline void log_info_limited(LogRateLimiter& limiter, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  log_message_limited(LogLevel::kInfo, limiter, fmt, ap);
+  va_end(ap);
+}
+
+static inline void log_debug_limited(LogRateLimiter& limiter, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  log_message_limited(LogLevel::kDebug, limiter, fmt, ap);
+  va_end(ap);
+}
+/** @} */
+
 }  // namespace logging
 
 }  // namespace mysql_harness
@@ -256,6 +454,10 @@ static inline void log_debug(const char* fmt, ...) {
 using mysql_harness::logging::log_error;    \
 using mysql_harness::logging::log_warning;  \
 using mysql_harness::logging::log_info;     \
-using mysql_harness::logging::log_debug;
+using mysql_harness::logging::log_debug;    \
+using mysql_harness::logging::log_error_limited;    \
+using mysql_harness::logging::log_warning_limited;  \
+using mysql_harness::logging::log_info_limited;     \
+using mysql_harness::logging::log_debug_limited;
 
 #endif // MYSQL_HARNESS_LOGGING_INCLUDED
@@ -25,6 +25,7 @@
 #ifndef MYSQL_HARNESS_LOGGER_REGISTRY_INCLUDED
 #define MYSQL_HARNESS_LOGGER_REGISTRY_INCLUDED
 
+#include "mysql/harness/logging/handler.h"
 #include "mysql/harness/logging/logging.h"
 #include "mysql/harness/logging/logger.h"
 #include "mysql/harness/filesystem.h"
@@ -32,7 +33,9 @@
 #include "harness_export.h"
 
 #include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -110,6 +113,31 @@ class HARNESS_EXPORT Registry {
    */
   std::set<std::string> get_logger_names() const;
 
+  /**
+   * Return an immutable snapshot of a logger, with its handlers looked up
+   *
+   * The snapshot stays usable for as long as generation() returns the same
+   * value, which lets hot paths cache it instead of copying the Logger (and
+   * looking up each of its handlers) under the registry mutex per message.
+   *
+   * @param name Logger id (log domain it services)
+   *
+   * @throws std::logic_error if no logger is registered for given module name
+   */
+  std::shared_ptr<const ResolvedLogger> get_resolved_logger(const std::string& name) const;
+
+  /**
+   * Generation of the registry content
+   *
+   * Changes whenever a logger or handler is added, removed or updated.
+   * Generations are unique across all Registry objects of the process, so a
+   * (registry, generation) pair never gets reused, even if a Registry is
+   * replaced by another one at the same address.
+   */
+  uint64_t generation() const noexcept {
+    return generation_.load(std::memory_order_acquire);
+  }
+
 //----[ handler CRUD ]----------------------------------------------------------
 
   /**
@@ -165,11 +193,38 @@ class HARNESS_EXPORT Registry {
    */
   bool is_ready() const noexcept { return ready_; }
 
+  /**
+   * Check if any registered logger would accept a message of given level
+   *
+   * This is a lock-free, cheap test intended to be used before a message is
+   * formatted. It tracks the most verbose level among all registered loggers,
+   * which makes it a conservative filter: it may return true for messages
+   * that are further dropped by a particular logger or its handlers, but it
+   * never returns false for a message that some logger would handle.
+   *
+   * @param level Log level of the message
+   */
+  bool is_handled(LogLevel level) const noexcept {
+    return static_cast<int>(level) <=
+           max_log_level_.load(std::memory_order_relaxed);
+  }
+
  private:
+  // recalculates max_log_level_; must be called with mtx_ locked
+  void update_max_log_level();
+
+  // moves generation_ to a new, process-wide unique value; must be called
+  // with mtx_ locked, after the content changed
+  void bump_generation();
+
   mutable std::mutex mtx_;
   std::map<std::string, Logger> loggers_; // key = log domain
   std::map<std::string, std::shared_ptr<Handler>> handlers_; // key = handler id
   std::atomic<bool> ready_{false};
+  std::atomic<int> max_log_level_{static_cast<int>(LogLevel::kFatal)};
+  std::atomic<uint64_t> generation_{next_generation()};
+
+  static uint64_t next_generation();
 
 }; // class Registry
 
@@ -277,6 +332,7 @@ class HARNESS_EXPORT Registry {
    * @param logging_folder logging_folder provided in configuration file
    * @param format_messages If set to true, log messages will be formatted
    *        (prefixed with log level, timestamp, etc) before logging
+   * @param rotation When to rotate the logfile (not used for the console)
    *
    * @throws std::runtime_error if opening log file fails
    */
@@ -284,7 +340,8 @@ class HARNESS_EXPORT Registry {
   void create_main_logfile_handler(Registry& registry,
                                    const std::string& program,
                                    const std::string& logging_folder,
-                                   bool format_messages);
+                                   bool format_messages,
+                                   const LogRotation& rotation = LogRotation());
 
 
 
@@ -334,6 +391,17 @@ class HARNESS_EXPORT Registry {
   HARNESS_EXPORT
   void unregister_handler(std::string name);
 
+  /**
+   * Check if any registered logger would accept a message of given level.
+   *
+   * Lets callers skip preparing the arguments of messages that get dropped,
+   * like the text form of addresses for debug messages.
+   *
+   * @param level Log level of the message
+   */
+  HARNESS_EXPORT
+  bool log_level_is_handled(LogLevel level);
+
   /**
   * Returns pointer to the default logger sink stream.
   */
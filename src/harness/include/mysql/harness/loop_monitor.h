@@ -0,0 +1,172 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQL_HARNESS_LOOP_MONITOR_INCLUDED
+#define MYSQL_HARNESS_LOOP_MONITOR_INCLUDED
+
+#include "harness_export.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace mysql_harness {
+
+/**
+ * Measures how long the event loops of the router take to get to new work.
+ *
+ * Threads running an event loop, like the I/O threads of a route or the
+ * threads of the HTTP server, add themselves with a function that posts a
+ * task into their loop. post_heartbeats() posts a heartbeat into each loop
+ * and the lag until it runs tells how long the loop was busy with other
+ * work: a loop blocked by a slow handler shows a heartbeat that is pending
+ * for long.
+ *
+ * The keepalive plugin posts the heartbeats and reports the stalls.
+ */
+class HARNESS_EXPORT LoopMonitor {
+ public:
+  using clock_type = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+  /**
+   * Runs the task in the loop soon, callable from any thread.
+   *
+   * Called with the lock of the monitor held, must not block or call back
+   * into the monitor.
+   */
+  using Post = std::function<void(Task)>;
+  using LoopId = uint64_t;
+
+  struct LoopState {
+    LoopId id;
+    std::string name;
+    /** @brief lag of the last heartbeat that ran */
+    std::chrono::microseconds last_lag{0};
+    /** @brief longest lag since the loop got added */
+    std::chrono::microseconds max_lag{0};
+    /** @brief how long the outstanding heartbeat waits already, 0 if it ran */
+    std::chrono::microseconds pending{0};
+    /** @brief heartbeats that ran, tells if last_lag is the one of a new heartbeat */
+    uint64_t heartbeats{0};
+  };
+
+  static LoopMonitor& instance();
+
+  LoopMonitor(const LoopMonitor&) = delete;
+  LoopMonitor& operator=(const LoopMonitor&) = delete;
+
+  /**
+   * Adds the loop run by the calling thread.
+   *
+   * @param name name of the loop in the reports, like the name of its thread
+   * @param post posts a task into the loop
+   *
+   * @return id to remove the loop with
+   */
+  LoopId add(const std::string& name, Post post);
+
+  /**
+   * Removes a loop, its post function isn't called once this returns.
+   */
+  void remove(LoopId id);
+
+  /**
+   * Posts a heartbeat into each loop whose previous heartbeat ran.
+   */
+  void post_heartbeats();
+
+  /**
+   * Returns the state of the loops, ordered by the time they got added.
+   */
+  std::vector<LoopState> get_loops();
+
+  /** @brief true if dump_stack() can get the stack of a thread */
+  static bool is_stack_dump_supported() noexcept;
+
+  /**
+   * Returns the stack of the thread running the loop, one frame per line.
+   *
+   * Interrupts the thread with a signal whose handler records the stack.
+   *
+   * @param id loop to get the stack of
+   * @param timeout how long to wait for the thread to record its stack
+   *
+   * @return the frames, empty if the loop is unknown, the thread didn't
+   *         answer in time or dumping stacks isn't supported
+   */
+  std::string dump_stack(LoopId id, std::chrono::milliseconds timeout);
+
+  /**
+   * Removes all loops.
+   */
+  void clear();
+
+ private:
+  LoopMonitor() = default;
+
+  /** @brief shared with the heartbeat task, which may outlive its loop */
+  struct Heartbeat {
+    clock_type::time_point posted;
+    /** @brief written by the loop before it sets ran */
+    std::chrono::microseconds lag{0};
+    std::atomic<bool> ran{false};
+  };
+
+  struct Loop {
+    std::string name;
+    Post post;
+#ifndef _WIN32
+    pthread_t thread;
+#endif
+    std::shared_ptr<Heartbeat> heartbeat;
+    std::chrono::microseconds last_lag{0};
+    std::chrono::microseconds max_lag{0};
+    uint64_t heartbeats{0};
+  };
+
+  /** @brief takes the lag of the heartbeat if it ran, called with mtx_ held */
+  static void collect(Loop& loop);
+
+  std::mutex mtx_;
+  std::map<LoopId, Loop> loops_;
+  LoopId next_id_{1};
+
+  /** @brief one stack dump at a time, the signal handler has a single buffer */
+  std::mutex dump_mtx_;
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_LOOP_MONITOR_INCLUDED
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQL_HARNESS_MEMORY_ACCOUNTING_INCLUDED
+#define MYSQL_HARNESS_MEMORY_ACCOUNTING_INCLUDED
+
+#include "harness_export.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mysql_harness {
+
+/**
+ * Subsystem memory is accounted to.
+ */
+enum class MemoryTag {
+  /** @brief client connection objects of the routes */
+  kRoutingConnections,
+  /** @brief buffers forwarding the traffic of the routes, pooled or owned */
+  kRoutingBuffers,
+  /** @brief stacks of the threads, as reserved, not as touched */
+  kThreadStacks,
+  /** @brief topology cached by the metadata cache */
+  kMetadataCache,
+  /** @brief static files cached by the HTTP server */
+  kHttp,
+  /** @brief records queued by the asynchronous log handlers */
+  kLogging,
+};
+
+/**
+ * Bytes and objects held by the subsystems.
+ *
+ * Only the main allocation sites of each subsystem account what they
+ * allocate, the sums are estimates of what the subsystems hold rather than
+ * all they ever allocated. The counters are relaxed atomics, one cache line
+ * per tag.
+ */
+class HARNESS_EXPORT MemoryAccounting {
+ public:
+  /** @brief number of tags */
+  static constexpr size_t kTags = 6;
+
+  struct Usage {
+    uint64_t bytes;
+    uint64_t objects;
+  };
+
+  static void allocated(MemoryTag tag, size_t bytes, size_t objects = 1) noexcept;
+  static void freed(MemoryTag tag, size_t bytes, size_t objects = 1) noexcept;
+
+  /** @brief what the subsystem holds now */
+  static Usage get_usage(MemoryTag tag) noexcept;
+
+  /** @brief name of the tag, as shown by the REST API */
+  static const char* tag_name(MemoryTag tag) noexcept;
+};
+
+/**
+ * Accounts memory to a tag while it lives.
+ *
+ * Embedded into the objects owning the memory, set() follows the size of
+ * what they hold.
+ */
+class HARNESS_EXPORT AccountedMemory {
+ public:
+  explicit AccountedMemory(MemoryTag tag, size_t bytes = 0, size_t objects = 0) noexcept;
+
+  AccountedMemory(const AccountedMemory& other) noexcept;
+  AccountedMemory& operator=(const AccountedMemory& other) noexcept;
+
+  ~AccountedMemory();
+
+  /** @brief replaces what is accounted */
+  void set(size_t bytes, size_t objects) noexcept;
+
+  size_t bytes() const noexcept { return bytes_; }
+
+ private:
+  MemoryTag tag_;
+  size_t bytes_;
+  size_t objects_;
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_MEMORY_ACCOUNTING_INCLUDED
@@ -0,0 +1,180 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQL_HARNESS_NETWORKING_RESOLVER_CACHE_INCLUDED
+#define MYSQL_HARNESS_NETWORKING_RESOLVER_CACHE_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#else
+#  include <sys/socket.h>
+#endif
+
+#include "harness_export.h"
+
+namespace mysql_harness {
+
+class MySQLRouterThread;
+
+/**
+ * @brief ResolverCache caches the addresses getaddrinfo() returns for
+ *        host and port pairs.
+ *
+ * Failed lookups are cached too, for a shorter time. Once an entry expired
+ * the cached result is still returned while the name gets resolved again
+ * by a background thread, so callers only wait for the resolver on the
+ * first lookup of a name. A failed refresh keeps the addresses resolved
+ * last.
+ *
+ * One instance() is shared by all the plugins of the process.
+ */
+class HARNESS_EXPORT ResolverCache {
+ public:
+  /** @brief address to connect to, as returned in addrinfo */
+  struct Address {
+    int family;
+    int socktype;
+    int protocol;
+    sockaddr_storage addr;
+    socklen_t addrlen;
+  };
+
+  using Addresses = std::vector<Address>;
+
+  /**
+   * @brief Function resolving host and port.
+   *
+   * @return 0 on success, error code of getaddrinfo() otherwise
+   */
+  using ResolveFunction = std::function<int(const std::string& host, uint16_t port,
+                                            Addresses& addresses)>;
+
+  /** @brief time successful lookups are cached */
+  static const std::chrono::milliseconds kDefaultTTL;
+  /** @brief time failed lookups are cached */
+  static const std::chrono::milliseconds kDefaultNegativeTTL;
+  /** @brief max number of cached names, least recently used ones are dropped */
+  static const size_t kMaxEntries = 1024;
+
+  /**
+   * @param ttl time successful lookups are cached
+   * @param negative_ttl time failed lookups are cached
+   * @param resolve_function resolves the names, getaddrinfo() if not set
+   */
+  explicit ResolverCache(std::chrono::milliseconds ttl = kDefaultTTL,
+                         std::chrono::milliseconds negative_ttl = kDefaultNegativeTTL,
+                         ResolveFunction resolve_function = nullptr);
+
+  /**
+   * @brief Stops the refresh thread, waiting for a running lookup.
+   */
+  ~ResolverCache();
+
+  ResolverCache(const ResolverCache&) = delete;
+  ResolverCache& operator=(const ResolverCache&) = delete;
+
+  /**
+   * @brief Returns cache shared by the process
+   */
+  static ResolverCache& instance();
+
+  /**
+   * @brief Returns the addresses of host and port.
+   *
+   * Blocks only if the name is not cached yet.
+   *
+   * @param host host name or IP address
+   * @param port TCP port
+   * @param addresses set to the resolved addresses
+   *
+   * @return 0 on success, error code of getaddrinfo() otherwise
+   */
+  int resolve(const std::string& host, uint16_t port, Addresses& addresses);
+
+  /** @brief Returns number of cached names */
+  size_t size() const;
+
+  /**
+   * @brief Resolves host and port for TCP using getaddrinfo().
+   *
+   * @return 0 on success, error code of getaddrinfo() otherwise
+   */
+  static int getaddrinfo_resolve(const std::string& host, uint16_t port, Addresses& addresses);
+
+ private:
+  using clock_type = std::chrono::steady_clock;
+  using Key = std::pair<std::string, uint16_t>;
+
+  struct Entry {
+    Addresses addresses;
+    /** @brief error of the lookup, 0 while addresses are known */
+    int error{0};
+    clock_type::time_point expires;
+    clock_type::time_point last_used;
+    /** @brief true while queued for the refresh thread */
+    bool refreshing{false};
+  };
+
+  /** @brief stores result of a lookup, mtx_ has to be locked */
+  void store(const Key& key, int error, Addresses addresses);
+
+  /** @brief queues entry for the refresh thread, mtx_ has to be locked */
+  void schedule_refresh(const Key& key, Entry& entry);
+
+  static void* run_refresh_thread(void* context);
+  void run_refresh_thread();
+
+  const std::chrono::milliseconds ttl_;
+  const std::chrono::milliseconds negative_ttl_;
+  const ResolveFunction resolve_function_;
+
+  mutable std::mutex mtx_;
+  std::condition_variable refresh_cond_;
+  std::map<Key, Entry> entries_;
+  /** @brief names waiting to be resolved again */
+  std::deque<Key> refresh_queue_;
+  /** @brief started with the first refresh */
+  std::unique_ptr<MySQLRouterThread> refresh_thread_;
+  bool stop_{false};
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_NETWORKING_RESOLVER_CACHE_INCLUDED
@@ -0,0 +1,153 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQL_HARNESS_NETWORKING_SOCKET_ENDPOINT_INCLUDED
+#define MYSQL_HARNESS_NETWORKING_SOCKET_ENDPOINT_INCLUDED
+
+#include "harness_export.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#else
+#  define WIN32_LEAN_AND_MEAN
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#endif
+
+namespace mysql_harness {
+
+/**
+ * Address and port of one end of a connection, in binary form.
+ *
+ * Taken from the sockaddr that accept() or getpeername() return. Unlike
+ * IPAddress it isn't parsed from text: it compares and hashes on its bytes,
+ * and is only turned into text by str() and address_str() once a log
+ * message or a status report needs it.
+ *
+ * @code
+ * mysql_harness::SocketEndpoint client(client_addr);
+ * log_debug("connection from %s", client.str().c_str());
+ * @endcode
+ */
+class HARNESS_EXPORT SocketEndpoint {
+ public:
+  enum class Family : uint8_t {
+    kNone = 0,
+    kIPv4,
+    kIPv6,
+    /** Unix socket or Windows named pipe, no address */
+    kLocal,
+  };
+
+  /** IPv4 addresses use the first 4 bytes, the rest is zero. */
+  using Bytes = std::array<uint8_t, 16>;
+
+  /** Constructs an endpoint of Family::kNone */
+  SocketEndpoint() noexcept : family_(Family::kNone), port_(0), address_{{0}} {}
+
+  /**
+   * Constructs an endpoint from a sockaddr_in, sockaddr_in6 or
+   * sockaddr_un.
+   *
+   * Other address families result in Family::kNone.
+   */
+  explicit SocketEndpoint(const sockaddr_storage &addr) noexcept;
+
+  /**
+   * Returns the endpoint of the peer of a connected socket.
+   *
+   * Family::kNone if getpeername() fails.
+   */
+  static SocketEndpoint peer_of(int sock) noexcept;
+
+  Family family() const noexcept { return family_; }
+
+  bool is_ipv4() const noexcept { return family_ == Family::kIPv4; }
+  bool is_ipv6() const noexcept { return family_ == Family::kIPv6; }
+  bool is_local() const noexcept { return family_ == Family::kLocal; }
+
+  /** port in host byte order, 0 for local endpoints */
+  uint16_t port() const noexcept { return port_; }
+
+  /** address in network byte order */
+  const Bytes &address_bytes() const noexcept { return address_; }
+
+  /**
+   * Returns the address as text, like "127.0.0.1" or "::1".
+   *
+   * "unix socket" for local endpoints, empty for Family::kNone.
+   */
+  std::string address_str() const;
+
+  /**
+   * Returns address and port as text, like "127.0.0.1:3306" or "::1:3306".
+   *
+   * Same as address_str() for endpoints without a port.
+   */
+  std::string str() const;
+
+  size_t hash() const noexcept;
+
+  friend bool operator==(const SocketEndpoint &a, const SocketEndpoint &b) noexcept {
+    return a.family_ == b.family_ && a.port_ == b.port_ &&
+           std::memcmp(a.address_.data(), b.address_.data(), a.address_.size()) == 0;
+  }
+
+  friend bool operator!=(const SocketEndpoint &a, const SocketEndpoint &b) noexcept {
+    return !(a == b);
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const SocketEndpoint &endpoint) {
+    return out << endpoint.str();
+  }
+
+ private:
+  Family family_;
+  uint16_t port_;
+  Bytes address_;
+};
+
+} // namespace mysql_harness
+
+namespace std {
+
+template <>
+struct hash<mysql_harness::SocketEndpoint> {
+  size_t operator()(const mysql_harness::SocketEndpoint &endpoint) const noexcept {
+    return endpoint.hash();
+  }
+};
+
+} // namespace std
+
+#endif // MYSQL_HARNESS_NETWORKING_SOCKET_ENDPOINT_INCLUDED
@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_READINESS_INCLUDED
+#define MYSQL_HARNESS_READINESS_INCLUDED
+
+#include "harness_export.h"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mysql_harness {
+
+/**
+ * Tells if the router can serve traffic.
+ *
+ * Components that need time until they can serve, like a route waiting for
+ * its destinations, announce themselves with expect() before the plugins
+ * get started, and report() once they are ready. The router is ready once
+ * all expected components are.
+ *
+ * The loader expects itself until all plugins got started and reports not
+ * being ready once it shuts down. It notifies the service manager (systemd)
+ * when the router gets ready, the http_server plugin serves the state for
+ * load balancers and orchestrators.
+ */
+class HARNESS_EXPORT Readiness {
+ public:
+  /** @brief called with the new state when the readiness of the router changes */
+  using Listener = std::function<void(bool ready)>;
+
+  static Readiness& instance();
+
+  Readiness(const Readiness&) = delete;
+  Readiness& operator=(const Readiness&) = delete;
+
+  /**
+   * Adds a component the router waits for, not ready yet.
+   *
+   * Does nothing if the component is known already.
+   */
+  void expect(const std::string& component);
+
+  /**
+   * Sets the state of a component.
+   *
+   * Components not expected before get added.
+   */
+  void report(const std::string& component, bool ready);
+
+  /**
+   * Removes a component, the router doesn't wait for it anymore.
+   */
+  void forget(const std::string& component);
+
+  /**
+   * Returns true if all expected components are ready.
+   */
+  bool is_ready() const;
+
+  /**
+   * Returns the state of the components, by name.
+   */
+  std::map<std::string, bool> get_components() const;
+
+  /**
+   * Adds a listener, called by the thread that changed the readiness.
+   *
+   * Listeners must not call back into Readiness, they stay registered until
+   * clear().
+   */
+  void add_listener(Listener listener);
+
+  /**
+   * Removes all components and listeners.
+   */
+  void clear();
+
+ private:
+  Readiness() = default;
+
+  bool is_ready_locked() const;
+
+  /** @brief calls the listeners if the readiness changed since the last call */
+  void notify_if_changed();
+
+  mutable std::mutex mtx_;
+  std::map<std::string, bool> components_;
+  std::vector<Listener> listeners_;
+  bool notified_ready_{true};
+};
+
+/**
+ * Sends a state change like "READY=1" to the service manager.
+ *
+ * Does nothing unless the router got started by systemd with
+ * `Type=notify`, which passes the socket in NOTIFY_SOCKET.
+ *
+ * @return true if the state got sent
+ */
+HARNESS_EXPORT bool notify_service_manager(const std::string& state) noexcept;
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_READINESS_INCLUDED
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_RECONFIGURATION_INCLUDED
+#define MYSQL_HARNESS_RECONFIGURATION_INCLUDED
+
+#include "harness_export.h"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace mysql_harness {
+
+class ConfigSection;
+
+/**
+ * Lets running plugins take changes of their configuration section.
+ *
+ * When the configuration gets reloaded, the loader first checks each
+ * changed or added section with the validator of its plugin and keeps the
+ * running section if it is invalid. It then offers the changed section to
+ * the handler the plugin set for it. If there is none, or the handler
+ * can't apply the change while running, the loader restarts the plugin
+ * for that section.
+ */
+class HARNESS_EXPORT Reconfiguration {
+ public:
+  /**
+   * Applies the new section, called by the loader's main thread.
+   *
+   * @return true if the running plugin took the changes, false if it needs
+   *         a restart
+   */
+  using Handler = std::function<bool(const ConfigSection& section)>;
+
+  /**
+   * Checks a reloaded section without applying it, called by the loader's
+   * main thread.
+   *
+   * @throws std::exception if the section is invalid
+   */
+  using Validator = std::function<void(const ConfigSection& section)>;
+
+  static Reconfiguration& instance();
+
+  Reconfiguration(const Reconfiguration&) = delete;
+  Reconfiguration& operator=(const Reconfiguration&) = delete;
+
+  /**
+   * Sets the handler for a section, replacing an earlier one.
+   */
+  void set_handler(const std::string& section_name, const std::string& section_key,
+                   Handler handler);
+
+  /**
+   * Removes the handler of a section.
+   *
+   * Waits for a running call of the handler to finish.
+   */
+  void remove_handler(const std::string& section_name, const std::string& section_key);
+
+  /**
+   * Offers a changed section to its handler.
+   *
+   * @return false if there is no handler or it didn't take the changes
+   */
+  bool apply(const ConfigSection& section);
+
+  /**
+   * Sets the validator for the sections of a plugin, replacing an earlier one.
+   */
+  void set_validator(const std::string& section_name, Validator validator);
+
+  /**
+   * Removes the validator for the sections of a plugin.
+   */
+  void remove_validator(const std::string& section_name);
+
+  /**
+   * Checks a section with the validator of its plugin.
+   *
+   * @param section section to check
+   * @param error set to why the section is invalid
+   *
+   * @return false if the section is invalid, true if it is valid or its
+   *         plugin has no validator
+   */
+  bool validate(const ConfigSection& section, std::string& error);
+
+ private:
+  Reconfiguration() = default;
+
+  std::mutex mtx_;
+  std::map<std::pair<std::string, std::string>, Handler> handlers_;
+  std::map<std::string, Validator> validators_;
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_RECONFIGURATION_INCLUDED
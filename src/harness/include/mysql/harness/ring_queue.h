@@ -0,0 +1,425 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_RING_QUEUE_INCLUDED
+#define MYSQL_HARNESS_RING_QUEUE_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace mysql_harness {
+
+namespace detail {
+
+/** @brief keeps the positions of producers and consumers in cache lines of their own */
+static const size_t kRingCacheLineSize = 64;
+
+inline size_t ring_capacity(size_t capacity) noexcept {
+  size_t result = 2;
+  while (result < capacity)
+    result <<= 1;
+  return result;
+}
+
+/**
+ * Bounded ring any number of threads push to and pop from.
+ *
+ * Each cell has a sequence number telling producers and consumers whose
+ * turn it is to use it (bounded MPMC queue by Dmitry Vyukov). Claiming a
+ * cell is a CAS on the position, there are no locks and no allocations.
+ */
+template <class T>
+class mpmc_ring {
+ public:
+  explicit mpmc_ring(size_t capacity)
+      : mask_(ring_capacity(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i)
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  ~mpmc_ring() {
+    const size_t last = enqueue_pos_.load(std::memory_order_relaxed);
+    for (size_t pos = dequeue_pos_.load(std::memory_order_relaxed); pos != last; ++pos)
+      cells_[pos & mask_].get()->~T();
+  }
+
+  mpmc_ring(const mpmc_ring&) = delete;
+  mpmc_ring& operator=(const mpmc_ring&) = delete;
+
+  size_t capacity() const noexcept {
+    return mask_ + 1;
+  }
+
+  size_t size() const noexcept {
+    const size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+    const size_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  /** @brief moves val into the ring, leaves it alone if the ring is full */
+  bool try_push(T& val) noexcept {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const std::ptrdiff_t diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // the cell still holds an element of the previous round
+        return false;
+      } else {
+        // another producer claimed the cell
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    new (&cell->storage) T(std::move(val));
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T* result) noexcept {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->seq.load(std::memory_order_acquire);
+      const std::ptrdiff_t diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // the cell isn't written yet
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    *result = std::move(*cell->get());
+    cell->get()->~T();
+    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T* get() noexcept {
+      return reinterpret_cast<T*>(&storage);
+    }
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  char pad0_[kRingCacheLineSize];
+  std::atomic<size_t> enqueue_pos_{0};
+  char pad1_[kRingCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeue_pos_{0};
+  char pad2_[kRingCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+/**
+ * Bounded ring one thread pushes to and another one pops from.
+ *
+ * Producer and consumer only publish their positions, each keeps a copy of
+ * the other's position and only reloads it when the ring looks full or
+ * empty.
+ */
+template <class T>
+class spsc_ring {
+ public:
+  explicit spsc_ring(size_t capacity)
+      : mask_(ring_capacity(capacity) - 1), cells_(new Cell[mask_ + 1]) {}
+
+  ~spsc_ring() {
+    const size_t last = tail_.load(std::memory_order_relaxed);
+    for (size_t pos = head_.load(std::memory_order_relaxed); pos != last; ++pos)
+      cells_[pos & mask_].get()->~T();
+  }
+
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring& operator=(const spsc_ring&) = delete;
+
+  size_t capacity() const noexcept {
+    return mask_ + 1;
+  }
+
+  size_t size() const noexcept {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  /** @brief moves val into the ring, leaves it alone if the ring is full */
+  bool try_push(T& val) noexcept {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_)
+        return false;
+    }
+
+    new (&cells_[tail & mask_].storage) T(std::move(val));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T* result) noexcept {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_)
+        return false;
+    }
+
+    Cell& cell = cells_[head & mask_];
+    *result = std::move(*cell.get());
+    cell.get()->~T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T* get() noexcept {
+      return reinterpret_cast<T*>(&storage);
+    }
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  char pad0_[kRingCacheLineSize];
+  // written by the producer
+  std::atomic<size_t> tail_{0};
+  size_t head_cache_{0};
+  char pad1_[kRingCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  // written by the consumer
+  std::atomic<size_t> head_{0};
+  size_t tail_cache_{0};
+  char pad2_[kRingCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+}  // namespace detail
+
+/**
+ * Bounded thread-safe queue on a ring buffer.
+ *
+ * Unlike mysql_harness::queue, pushing and popping don't lock and don't
+ * allocate: the elements are moved into cells allocated once, when the
+ * queue is created. Only threads that wait in push() for a full queue or in
+ * pop() for an empty one block on a mutex and a condition variable, other
+ * threads only take the mutex to wake them.
+ *
+ * Use mpmc_queue or spsc_queue instead of naming Ring.
+ *
+ * @tparam T type of the elements, moving it must not throw
+ * @tparam Ring detail::mpmc_ring<T> or detail::spsc_ring<T>
+ */
+template <class T, class Ring>
+class ring_queue {
+  static_assert(std::is_nothrow_move_constructible<T>::value &&
+                std::is_nothrow_move_assignable<T>::value,
+                "elements are moved in and out of the ring and that can't fail");
+
+ public:
+  using size_type = std::size_t;
+
+  /**
+   * @param capacity number of elements the queue holds (rounded up to a
+   *        power of 2)
+   */
+  explicit ring_queue(size_type capacity) : ring_(capacity) {}
+
+  ring_queue(const ring_queue&) = delete;
+  ring_queue& operator=(const ring_queue&) = delete;
+
+  size_type capacity() const noexcept {
+    return ring_.capacity();
+  }
+
+  /**
+   * Get the number of elements in the queue.
+   *
+   * @note The number is a snapshot, elements may get pushed or popped by
+   * other threads meanwhile.
+   */
+  size_type size() const noexcept {
+    return ring_.size();
+  }
+
+  /** @overload */
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  /**
+   * Push an element if the queue isn't full.
+   *
+   * @return false if the queue is full, val is not moved from then
+   */
+  bool try_push(T&& val) {
+    if (!ring_.try_push(val))
+      return false;
+    notify(waiting_consumers_, not_empty_);
+    return true;
+  }
+
+  /** @overload */
+  bool try_push(const T& val) {
+    T copy(val);
+    return try_push(std::move(copy));
+  }
+
+  /**
+   * Push an element, waiting for a consumer to make room if the queue is
+   * full.
+   */
+  void push(T val) {
+    if (try_push(std::move(val)))
+      return;
+
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      waiting_producers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      not_full_.wait(lock, [this, &val] { return ring_.try_push(val); });
+      waiting_producers_.fetch_sub(1);
+    }
+    notify(waiting_consumers_, not_empty_);
+  }
+
+  /**
+   * Pop an element, waiting for one if the queue is empty.
+   */
+  bool pop(T* result) {
+    if (try_pop(result))
+      return true;
+
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      waiting_consumers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      not_empty_.wait(lock, [this, result] { return ring_.try_pop(result); });
+      waiting_consumers_.fetch_sub(1);
+    }
+    notify(waiting_producers_, not_full_);
+    return true;
+  }
+
+  /**
+   * Pop an element, waiting at most rel_time for one if the queue is empty.
+   *
+   * @return false if no element got pushed in time
+   */
+  template <class Rep, class Period>
+  bool pop(T* result, const std::chrono::duration<Rep, Period>& rel_time) {
+    if (try_pop(result))
+      return true;
+
+    bool popped;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      waiting_consumers_.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      popped = not_empty_.wait_for(lock, rel_time,
+                                   [this, result] { return ring_.try_pop(result); });
+      waiting_consumers_.fetch_sub(1);
+    }
+    if (popped)
+      notify(waiting_producers_, not_full_);
+    return popped;
+  }
+
+  /**
+   * Pop an element if the queue isn't empty.
+   */
+  bool try_pop(T* result) {
+    if (!ring_.try_pop(result))
+      return false;
+    notify(waiting_producers_, not_full_);
+    return true;
+  }
+
+ private:
+  /*
+   * wake a thread waiting on cond, if there is one
+   *
+   * The fences order the change of the ring against the check of the
+   * waiters here, and the registration of a waiter against its check of
+   * the ring there: either the waiter sees the change or it gets woken.
+   */
+  void notify(const std::atomic<size_t>& waiting, std::condition_variable& cond) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed) == 0)
+      return;
+
+    // the waiter is either waiting already or checks the ring again after we
+    // released the mutex
+    { std::lock_guard<std::mutex> lock(mtx_); }
+    cond.notify_one();
+  }
+
+  Ring ring_;
+
+  std::mutex mtx_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::atomic<size_t> waiting_consumers_{0};
+  std::atomic<size_t> waiting_producers_{0};
+};
+
+/**
+ * Bounded queue any number of threads push to and pop from.
+ */
+template <class T>
+using mpmc_queue = ring_queue<T, detail::mpmc_ring<T>>;
+
+/**
+ * Bounded queue a single thread pushes to and a single thread pops from.
+ */
+template <class T>
+using spsc_queue = ring_queue<T, detail::spsc_ring<T>>;
+
+}  // namespace mysql_harness
+
+#endif /* MYSQL_HARNESS_RING_QUEUE_INCLUDED */
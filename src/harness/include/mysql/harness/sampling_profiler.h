@@ -0,0 +1,132 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQL_HARNESS_SAMPLING_PROFILER_INCLUDED
+#define MYSQL_HARNESS_SAMPLING_PROFILER_INCLUDED
+
+#include "harness_export.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace mysql_harness {
+
+/**
+ * Samples the stacks of the threads burning CPU, without an external profiler.
+ *
+ * While running, SIGPROF interrupts the thread using CPU `frequency` times
+ * per second of CPU time of the process, and the signal handler records the
+ * stack of the interrupted thread into a buffer allocated up front. The
+ * samples are symbolized once profiling stopped and are returned as folded
+ * stacks, one line of `outer;inner count` per distinct stack, as taken by
+ * flamegraph.pl.
+ *
+ * Only supported on Linux with glibc, which unwinds the stacks with
+ * backtrace(). Functions are named by dladdr(), so functions not exported
+ * show up as the exported function before them unless the binary is linked
+ * with -rdynamic.
+ */
+class HARNESS_EXPORT SamplingProfiler {
+ public:
+  /** @brief frames recorded per sample, deeper stacks lose their outermost frames */
+  static constexpr size_t kMaxDepth = 64;
+  /** @brief highest sampling frequency in Hz */
+  static constexpr unsigned kMaxFrequency = 1000;
+  /** @brief longest profile */
+  static constexpr std::chrono::seconds kMaxDuration{300};
+
+  static SamplingProfiler& instance();
+
+  SamplingProfiler(const SamplingProfiler&) = delete;
+  SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+  ~SamplingProfiler();
+
+  /** @brief true if the platform lets the profiler sample */
+  static bool is_supported() noexcept;
+
+  /**
+   * Starts profiling, stopping by itself after duration.
+   *
+   * Drops the stacks of the previous profile.
+   *
+   * @param duration how long to profile, up to kMaxDuration
+   * @param frequency samples per second of CPU time, up to kMaxFrequency
+   *
+   * @throws std::invalid_argument if duration or frequency is out of range
+   * @throws std::logic_error if profiling already runs
+   * @throws std::runtime_error if not supported or the timer can't be set
+   */
+  void start(std::chrono::milliseconds duration, unsigned frequency);
+
+  /**
+   * Stops profiling before its duration is over.
+   *
+   * Does nothing if profiling doesn't run.
+   */
+  void stop();
+
+  /** @brief true while profiling runs */
+  bool is_running() const;
+
+  /** @brief true once a profile is finished and its stacks can be got */
+  bool has_profile() const;
+
+  /**
+   * Returns the folded stacks of the last finished profile.
+   *
+   * Empty while profiling runs or no profile was taken.
+   */
+  std::string get_folded_stacks() const;
+
+  /** @brief samples which didn't fit into the buffer of the last profile */
+  uint64_t get_lost_samples() const;
+
+ private:
+  SamplingProfiler() = default;
+
+  /** @brief disarms the timer and symbolizes the samples, called with mtx_ held */
+  void finish();
+
+  /** @brief serializes start() and stop(), which join stopper_ */
+  std::mutex control_mtx_;
+  mutable std::mutex mtx_;
+  /** @brief wakes up the thread ending the profile */
+  std::condition_variable stop_cond_;
+  /** @brief waits for the end of the duration and stops profiling */
+  std::thread stopper_;
+  bool running_{false};
+  bool has_profile_{false};
+  std::string folded_stacks_;
+  uint64_t lost_samples_{0};
+};
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_SAMPLING_PROFILER_INCLUDED
@@ -0,0 +1,295 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_TIMER_WHEEL_INCLUDED
+#define MYSQL_HARNESS_TIMER_WHEEL_INCLUDED
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mysql_harness {
+
+/**
+ * @brief Hierarchical timer wheel keeping a deadline per timer.
+ *
+ * The wheel has several levels of slots. A slot of the first level covers
+ * a tick, a slot of each further level covers a whole turn of the level
+ * below. Timers are kept in the lowest level whose turn reaches their
+ * deadline and move down a level each time the level below starts the
+ * turn of their slot, until they reach the slot of the tick they are due
+ * in.
+ *
+ * Scheduling, rescheduling and cancelling a timer cost O(1). expire()
+ * visits the ticks that passed since it was called last, ticks that have
+ * no timers in the levels below are skipped. A timer moves down at most
+ * once per level, deadlines beyond the turn of the top level wait there
+ * until they are due in its turn.
+ *
+ * Idle timeouts, connect deadlines or refresh schedules of many objects
+ * cost a slot entry each then, instead of a node of an ordered tree.
+ *
+ * Not thread-safe.
+ *
+ * @tparam T        timer, like a pointer to the object timing out
+ * @tparam Hash     hash function of T
+ */
+template<typename T, typename Hash = std::hash<T>>
+class TimerWheel {
+ public:
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief levels of a wheel by default */
+  static const std::size_t kDefaultLevels = 4;
+
+  /**
+   * @param tick     time covered by a slot of the first level, the
+   *                 precision of the deadlines
+   * @param slots    number of slots of each level
+   * @param levels   number of levels, a turn of the wheel is
+   *                 tick * slots^levels
+   * @param start    time of the first tick
+   */
+  TimerWheel(std::chrono::milliseconds tick, std::size_t slots,
+             std::size_t levels = kDefaultLevels,
+             clock_type::time_point start = clock_type::now())
+      : tick_(std::chrono::duration_cast<clock_type::duration>(tick)),
+        start_(start), num_slots_(std::max<std::size_t>(slots, 2)),
+        levels_(std::max<std::size_t>(levels, 1)) {
+    if (tick_.count() <= 0) tick_ = clock_type::duration(1);
+
+    uint64_t span = 1;
+    for (Level& level : levels_) {
+      level.slots.resize(num_slots_);
+      level.span = span;
+      span *= num_slots_;
+    }
+  }
+
+  /**
+   * @brief Sets the deadline of the timer, replacing the one it had.
+   *
+   * Timers expire with the first tick after their deadline, deadlines
+   * passed already with the next tick.
+   */
+  void schedule(const T& timer, clock_type::time_point deadline) {
+    cancel(timer);
+
+    // rounded up, the slot is only visited once the deadline passed
+    uint64_t tick = get_tick(deadline);
+    if (start_ + tick_ * static_cast<clock_type::rep>(tick) < deadline) ++tick;
+    if (tick < next_tick_) tick = next_tick_;
+
+    insert(timer, Entry{deadline, tick, 0, 0, 0});
+  }
+
+  /**
+   * @brief Removes the timer.
+   *
+   * @return false if the timer was not scheduled
+   */
+  bool cancel(const T& timer) {
+    auto it = entries_.find(timer);
+    if (it == entries_.end()) return false;
+
+    remove_from_slot(it->second);
+    entries_.erase(it);
+    return true;
+  }
+
+  /**
+   * @brief Removes the timers whose deadline passed.
+   *
+   * @param now current time
+   *
+   * @return removed timers, in no particular order
+   */
+  std::vector<T> expire(clock_type::time_point now = clock_type::now()) {
+    std::vector<T> expired;
+    if (now < start_) return expired;
+
+    const uint64_t now_tick = get_tick(now);
+    while (next_tick_ <= now_tick) {
+      if (entries_.empty()) {
+        next_tick_ = now_tick + 1;
+        break;
+      }
+
+      const uint64_t tick = next_tick_;
+      // the upper levels first, their timers may move down further
+      for (std::size_t lvl = levels_.size() - 1; lvl > 0; --lvl) {
+        if (tick % levels_[lvl].span == 0) cascade(lvl, tick);
+      }
+
+      std::vector<T>& slot = levels_[0].slots[tick % num_slots_];
+      for (std::size_t ndx = 0; ndx < slot.size();) {
+        auto it = entries_.find(slot[ndx]);
+        if (it->second.tick > tick) {
+          // due in a later turn of a wheel with a single level
+          ++ndx;
+          continue;
+        }
+
+        expired.push_back(slot[ndx]);
+        remove_from_slot(it->second);
+        entries_.erase(it);
+      }
+
+      next_tick_ = tick + 1;
+
+      // nothing happens before the next turn of the lowest level with timers
+      const uint64_t span = skippable_span();
+      const uint64_t next = (next_tick_ + span - 1) / span * span;
+      next_tick_ = std::min(next, now_tick + 1);
+    }
+
+    return expired;
+  }
+
+  /**
+   * @brief Returns the time expire() has work at the earliest.
+   *
+   * That is the deadline of the next timer or the start of the turn that
+   * moves timers down a level. Event loops wait until then.
+   *
+   * @return clock_type::time_point::max() if no timer is scheduled
+   */
+  clock_type::time_point next_expiry() const noexcept {
+    if (entries_.empty()) return clock_type::time_point::max();
+
+    // the timers of a level are in the turn ahead of it, first due are
+    // those of the first slot with timers
+    uint64_t next = UINT64_MAX;
+    for (const Level& level : levels_) {
+      if (level.size == 0) continue;
+
+      const uint64_t first = (next_tick_ + level.span - 1) / level.span;
+      for (uint64_t block = first; block < first + num_slots_; ++block) {
+        if (!level.slots[block % num_slots_].empty()) {
+          next = std::min(next, block * level.span);
+          break;
+        }
+      }
+    }
+
+    return start_ + tick_ * static_cast<clock_type::rep>(next);
+  }
+
+  /** @brief Returns number of scheduled timers */
+  std::size_t size() const noexcept {
+    return entries_.size();
+  }
+
+ private:
+  struct Entry {
+    clock_type::time_point deadline;
+    /** @brief tick the timer is due in */
+    uint64_t tick;
+    std::size_t level;
+    std::size_t slot;
+    /** @brief position in the slot */
+    std::size_t ndx;
+  };
+
+  struct Level {
+    std::vector<std::vector<T>> slots;
+    /** @brief ticks covered by a slot */
+    uint64_t span;
+    /** @brief number of timers in the slots */
+    std::size_t size{0};
+  };
+
+  uint64_t get_tick(clock_type::time_point tp) const noexcept {
+    return tp <= start_ ? 0 : static_cast<uint64_t>((tp - start_) / tick_);
+  }
+
+  /** @brief adds the timer to the lowest level whose turn reaches its tick */
+  void insert(const T& timer, Entry entry) {
+    std::size_t lvl = 0;
+    while (lvl + 1 < levels_.size() &&
+           entry.tick / levels_[lvl].span - next_tick_ / levels_[lvl].span >= num_slots_) {
+      ++lvl;
+    }
+
+    std::vector<T>& slot = levels_[lvl].slots[(entry.tick / levels_[lvl].span) % num_slots_];
+    entry.level = lvl;
+    entry.slot = (entry.tick / levels_[lvl].span) % num_slots_;
+    entry.ndx = slot.size();
+    entries_[timer] = entry;
+    slot.push_back(timer);
+    ++levels_[lvl].size;
+  }
+
+  /** @brief moves the timers of the slot starting its turn with tick down */
+  void cascade(std::size_t lvl, uint64_t tick) {
+    std::vector<T> slot;
+    slot.swap(levels_[lvl].slots[(tick / levels_[lvl].span) % num_slots_]);
+    levels_[lvl].size -= slot.size();
+
+    // timers beyond the turn of the top level may go back to the same slot
+    for (const T& timer : slot) {
+      insert(timer, entries_[timer]);
+    }
+  }
+
+  /** @brief ticks of the turn of the lowest level that has timers */
+  uint64_t skippable_span() const noexcept {
+    std::size_t lvl = 0;
+    while (lvl + 1 < levels_.size() && levels_[lvl].size == 0) ++lvl;
+
+    return levels_[lvl].span;
+  }
+
+  /** @brief takes the timer out of its slot, the last timer of the slot moves in */
+  void remove_from_slot(const Entry& entry) {
+    Level& level = levels_[entry.level];
+    std::vector<T>& slot = level.slots[entry.slot];
+    if (entry.ndx + 1 != slot.size()) {
+      slot[entry.ndx] = std::move(slot.back());
+      entries_[slot[entry.ndx]].ndx = entry.ndx;
+    }
+    slot.pop_back();
+    --level.size;
+  }
+
+  clock_type::duration tick_;
+  const clock_type::time_point start_;
+  const std::size_t num_slots_;
+  std::vector<Level> levels_;
+  std::unordered_map<T, Entry, Hash> entries_;
+  /** @brief first tick not visited by expire() yet */
+  uint64_t next_tick_{0};
+};
+
+template<typename T, typename Hash>
+const std::size_t TimerWheel<T, Hash>::kDefaultLevels;
+
+}  // namespace mysql_harness
+
+#endif  // MYSQL_HARNESS_TIMER_WHEEL_INCLUDED
@@ -0,0 +1,70 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQL_HARNESS_TRACEPOINTS_INCLUDED
+#define MYSQL_HARNESS_TRACEPOINTS_INCLUDED
+
+/**
+ * @file
+ * @brief Static tracepoints (USDT) of the router.
+ *
+ * With <sys/sdt.h> (systemtap-sdt-dev) at build time each tracepoint is a
+ * nop in the code and a note in the ELF file that tracers like bpftrace,
+ * perf or SystemTap patch into a breakpoint once they attach to it. The
+ * arguments are evaluated either way, only cheap ones are passed.
+ *
+ * The provider is `mysqlrouter`, the tracepoints are in the library or
+ * plugin of the code they trace, e.g.:
+ *
+ *     bpftrace -e 'usdt:/usr/lib/mysqlrouter/routing.so:mysqlrouter:connection__closed
+ *                  { @lifetime_us = hist(arg4); }'
+ *
+ * | tracepoint               | arguments                                                                      |
+ * |--------------------------|--------------------------------------------------------------------------------|
+ * | accept                   | route, client fd, struct sockaddr_storage * of the client                      |
+ * | destination__chosen      | server address, port                                                           |
+ * | backend__connected       | server address, port, server fd, connect time in us                            |
+ * | handshake__done          | route, client fd, time since the accept in us                                  |
+ * | forwarded                | route, client fd, bytes, 1 if from the server                                  |
+ * | connection__closed       | route, client fd, bytes from the client, bytes from the server, lifetime in us |
+ * | metadata__refresh__start | -                                                                              |
+ * | metadata__refresh__end   | refresh time in us, 1 if it failed                                             |
+ * | log__record              | level, domain, message                                                         |
+ *
+ * Without <sys/sdt.h> the tracepoints are left out.
+ */
+
+#include "router_config.h"
+
+#ifdef HAVE_SYS_SDT_H
+#  include <sys/sdt.h>
+#  define MYSQL_ROUTER_TRACE(name, ...) STAP_PROBEV(mysqlrouter, name, __VA_ARGS__)
+#  define MYSQL_ROUTER_TRACE0(name) STAP_PROBE(mysqlrouter, name)
+#else
+#  define MYSQL_ROUTER_TRACE(name, ...) do {} while (0)
+#  define MYSQL_ROUTER_TRACE0(name) do {} while (0)
+#endif
+
+#endif // MYSQL_HARNESS_TRACEPOINTS_INCLUDED
@@ -37,6 +37,9 @@
 #include <sched.h>    // IWYU pragma: export
 #include <stdexcept>
 #endif
+#include <cstdint>
+#include <string>
+#include <vector>
 #endif /* MYSQL_ABI_CHECK */
 
 
@@ -44,6 +47,14 @@ namespace mysql_harness {
 
 static const size_t kDefaultStackSizeInKiloBytes = 1024;
 
+/**
+ * @brief default stack of threads serving a single client connection.
+ *
+ * they only forward packets and need far less than the plugin threads, which
+ * keeps the address space and page tables small with many connections.
+ */
+static const size_t kDefaultConnectionStackSizeInKiloBytes = 256;
+
 #ifdef _WIN32
 typedef DWORD mysql_router_thread_t;
 typedef struct thread_attr {
@@ -91,6 +102,9 @@ public:
   /**
    * Execute run_thread function in thread of execution.
    *
+   * The stack is accounted to MemoryTag::kThreadStacks until run_thread
+   * returns.
+   *
    * @param run_thread the pointer to the function that is executed in thread. It has to be non-member void*(void*) function
    * @param args_ptr pointer to run_thread parameter
    * @param detach true if thread is detached, false if thread is joinable
@@ -119,7 +133,76 @@ private:
 
   /** @brief true if thread is joinable but join wasn't called, false otherwise */
   bool should_join_ = false;
+
+  /** @brief bytes of the stack of the thread */
+  size_t stack_size_;
+};
+
+#ifndef NDEBUG
+/**
+ * @brief Measures how deep the calling thread used its stack.
+ *
+ * Fills the unused part of the stack below the caller with a pattern and
+ * later looks for the lowest byte which got overwritten. Meant for debug
+ * builds, to check that the configured stack sizes fit, as filling commits
+ * the memory of the whole stack. Works on Linux for
+ * threads started by MySQLRouterThread, max_used() returns 0 elsewhere.
+ * Only compiled without NDEBUG.
+ */
+class HARNESS_EXPORT StackUsageProbe {
+public:
+  StackUsageProbe() noexcept;
+
+  /**
+   * @return bytes of the stack used at most since construction, counted from
+   *         its top
+   */
+  size_t max_used() const noexcept;
+
+  /** @return size of the stack in bytes, 0 if unknown */
+  size_t size() const noexcept {
+    return static_cast<size_t>(high_ - low_);
+  }
+
+private:
+  /** @brief lowest address which may be used, above the guard page */
+  uintptr_t low_{0};
+
+  /** @brief end of the stack, it grows down from here */
+  uintptr_t high_{0};
+
+  /** @brief lowest address filled with the pattern */
+  uintptr_t filled_{0};
 };
+#endif
+
+/**
+ * @brief Parses a list of CPUs like "0-3,8,10-11".
+ *
+ * @param cpu_list comma separated CPU numbers and ranges of them, may be empty
+ *
+ * @return the CPUs sorted, without duplicates
+ *
+ * @throw std::invalid_argument if the list is malformed or a CPU is
+ *        kMaxCpuAffinityCpu or above
+ */
+HARNESS_EXPORT std::vector<unsigned> parse_cpu_list(const std::string& cpu_list);
+
+/** @brief CPUs set_current_thread_cpu_affinity() can pin to are below this */
+static const unsigned kMaxCpuAffinityCpu = 1024;
+
+/**
+ * @brief Restricts the calling thread to run on the CPUs only.
+ *
+ * Memory the thread touches first afterwards gets allocated on the NUMA node
+ * of the CPUs by the OS.
+ *
+ * @param cpus CPUs to run on, as returned by parse_cpu_list()
+ *
+ * @return false if the platform doesn't support it or none of the CPUs is
+ *         available to the process
+ */
+HARNESS_EXPORT bool set_current_thread_cpu_affinity(const std::vector<unsigned>& cpus) noexcept;
 
 } // end of mysql_harness namespace
 
@@ -131,6 +131,11 @@ public:
     // the process-id we just moved
 
     rhs.is_alive = false;
+#ifndef _WIN32
+    pidfd_ = rhs.pidfd_;
+    output_eof_ = rhs.output_eof_;
+    rhs.pidfd_ = -1;
+#endif
   }
 
   ~ProcessLauncher();
@@ -150,6 +155,18 @@ public:
    */
   int read(char *buf, size_t count, unsigned timeout_ms);
 
+  /**
+   * Waits until the child process wrote to its stdout or exited.
+   *
+   * Lets callers waiting for a pattern in the output or for the exit
+   * sleep until there is something to check, instead of polling.
+   *
+   * @param timeout_ms time to wait at most, may return earlier where the
+   *        exit of the child can't be waited for
+   * @return true if there is output to read() or the child exited
+   */
+  bool wait_for_output_or_exit(unsigned timeout_ms);
+
   /**
    * Writes several butes into stdin of child process.
    * Returns an shcore::Exception in case of error when writing.
@@ -210,6 +227,12 @@ private:
   int close();
 
   bool is_alive;
+#ifndef _WIN32
+  /** @brief pidfd of the child, readable once it exited, -1 if not supported */
+  int pidfd_{-1};
+  /** @brief true once read() saw the end of the output of the child */
+  bool output_eof_{false};
+#endif
 };
 
 } // end of namespace mysql_harness
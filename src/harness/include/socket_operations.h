@@ -26,6 +26,7 @@
 #define MYSQL_HARNESS_SOCKETOPERATIONS_INCLUDED
 
 #include <chrono>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #ifdef _WIN32
@@ -115,13 +116,58 @@ class HARNESS_EXPORT SocketOperationsBase {
   virtual std::string get_local_hostname() = 0;
 };
 
+/**
+ * Counters of the calls done through SocketOperations.
+ *
+ * @see SocketOperations::get_stats()
+ */
+struct SocketOperationsStats {
+  struct Counters {
+    /** @brief calls, successful or not */
+    uint64_t calls;
+    /** @brief bytes transferred by read() and write() */
+    uint64_t bytes;
+    /** @brief calls failing with EAGAIN/EWOULDBLOCK */
+    uint64_t would_block;
+    /** @brief calls failing with EINTR */
+    uint64_t interrupted;
+    /** @brief calls failing with other errors */
+    uint64_t errors;
+    /** @brief poll() and connect_non_blocking_wait() calls running into their timeout */
+    uint64_t timeouts;
+  };
+
+  Counters read;
+  Counters write;
+  /** @brief includes the poll() of connect_non_blocking_wait() */
+  Counters poll;
+  Counters connect_wait;
+};
+
 /** @class SocketOperations
  * @brief This class provides a "real" (not mock) implementation
+ *
+ * Counts the calls of read(), write(), poll() and
+ * connect_non_blocking_wait() once set_stats_enabled() got called. The
+ * threads update their own shard of the counters, disabled the counting
+ * costs a relaxed load per call.
  */
 class HARNESS_EXPORT SocketOperations : public SocketOperationsBase {
  public:
   static SocketOperations* instance();
 
+  /** @brief starts or stops counting the calls */
+  static void set_stats_enabled(bool enabled) noexcept;
+
+  static bool is_stats_enabled() noexcept;
+
+  /**
+   * sums of the counters of all threads
+   *
+   * Counters stay when the counting gets stopped.
+   */
+  static SocketOperationsStats get_stats() noexcept;
+
   /** @brief Thin wrapper around socket library write() */
   ssize_t write(int fd, void *buffer, size_t nbyte) override;
 
@@ -0,0 +1,550 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/async_socket.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+#ifdef __linux__
+#  include <sys/epoll.h>
+#endif
+
+namespace mysql_harness {
+
+namespace {
+
+/** @brief max number of sockets fetched from epoll at once */
+const int kMaxEventsPerWait = 256;
+
+#ifdef _WIN32
+/** @brief longest wait on Windows, where posted tasks can't wake up WSAPoll() */
+const int kPostedPollIntervalMs = 10;
+#endif
+
+const unsigned kEventBits[2] = {1u, 2u};
+
+std::error_code errno_error(int err) {
+  return std::error_code(err, std::generic_category());
+}
+
+void set_non_blocking(int fd) {
+#ifdef _WIN32
+  u_long mode = 1;
+  ioctlsocket(static_cast<SOCKET>(fd), FIONBIO, &mode);
+#else
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+}  // namespace
+
+/*
+ * IoContext
+ */
+
+constexpr std::chrono::milliseconds IoContext::kTimerTick;
+
+IoContext::IoContext(const std::string& name) : name_(name) {
+#ifdef __linux__
+  poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (poll_fd_ == -1) throw std::system_error(errno_error(errno), "epoll_create1() failed");
+#endif
+#ifndef _WIN32
+  if (pipe(wakeup_fds_) == -1) {
+    const int last_errno = errno;
+    if (poll_fd_ != -1) ::close(poll_fd_);
+    throw std::system_error(errno_error(last_errno), "pipe() failed");
+  }
+  for (int fd : wakeup_fds_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+#ifdef __linux__
+  struct epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeup_fds_[0];
+  epoll_ctl(poll_fd_, EPOLL_CTL_ADD, wakeup_fds_[0], &ev);
+#endif
+}
+
+IoContext::~IoContext() {
+#ifndef _WIN32
+  ::close(wakeup_fds_[0]);
+  ::close(wakeup_fds_[1]);
+  if (poll_fd_ != -1) ::close(poll_fd_);
+#endif
+}
+
+void IoContext::stop() {
+  stopped_ = true;
+  wakeup();
+}
+
+void IoContext::post(std::function<void()> task) {
+  bool was_empty;
+  {
+    std::lock_guard<std::mutex> lock(posted_mtx_);
+    was_empty = posted_.empty();
+    posted_.push_back(std::move(task));
+  }
+  // a non-empty queue has a wakeup pending already
+  if (was_empty) wakeup();
+}
+
+void IoContext::wakeup() noexcept {
+#ifndef _WIN32
+  const char c = 0;
+  // a full pipe means the loop has a wakeup pending already
+  ssize_t res;
+  do {
+    res = ::write(wakeup_fds_[1], &c, 1);
+  } while (res == -1 && errno == EINTR);
+#endif
+}
+
+void IoContext::async_wait(int fd, Event event, clock_type::time_point deadline, Handler handler) {
+  Watch& watch = watches_[fd];
+  if (watch.waiting[event]) {
+    throw std::logic_error("socket is waited for the event already");
+  }
+
+  Wait& wait = watch.waits[event];
+  wait.handler = std::move(handler);
+  wait.timer = 0;
+  if (deadline != clock_type::time_point::max()) {
+    wait.timer = next_timer_id_++;
+    timers_.emplace(wait.timer, Timer{fd, event, nullptr});
+    timer_wheel_.schedule(wait.timer, deadline);
+  }
+  watch.waiting[event] = true;
+
+  update(fd);
+}
+
+IoContext::TimerId IoContext::schedule(std::chrono::milliseconds delay,
+                                       std::function<void()> handler) {
+  const TimerId id = next_timer_id_++;
+  timers_.emplace(id, Timer{-1, kRead, std::move(handler)});
+  timer_wheel_.schedule(id, clock_type::now() + delay);
+
+  return id;
+}
+
+bool IoContext::cancel_timer(TimerId id) {
+  if (timers_.erase(id) == 0) return false;
+
+  timer_wheel_.cancel(id);
+  return true;
+}
+
+void IoContext::expire_timers() {
+  for (TimerId id : timer_wheel_.expire()) {
+    auto it = timers_.find(id);
+    // cancelled by the handler of a timer that expired with it
+    if (it == timers_.end()) continue;
+
+    Timer timer = std::move(it->second);
+    timers_.erase(it);
+    if (timer.fd == -1) {
+      timer.handler();
+    } else {
+      complete(timer.fd, timer.event, std::make_error_code(std::errc::timed_out), false);
+    }
+  }
+}
+
+void IoContext::cancel(int fd) {
+  for (Event event : {kRead, kWrite}) {
+    complete(fd, event, std::make_error_code(std::errc::operation_canceled), true);
+  }
+}
+
+void IoContext::complete(int fd, Event event, std::error_code ec, bool post_handler) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end() || !it->second.waiting[event]) return;
+
+  Wait& wait = it->second.waits[event];
+  Handler handler = std::move(wait.handler);
+  if (wait.timer != 0) cancel_timer(wait.timer);
+  it->second.waiting[event] = false;
+
+  // the handler may wait again, the socket has to be up to date before
+  update(fd);
+
+  if (post_handler) {
+    post([handler, ec]() { handler(ec); });
+  } else {
+    handler(ec);
+  }
+}
+
+void IoContext::update(int fd) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end()) return;
+
+  Watch& watch = it->second;
+  unsigned wanted = 0;
+  for (Event event : {kRead, kWrite}) {
+    if (watch.waiting[event]) wanted |= kEventBits[event];
+  }
+
+#ifdef __linux__
+  if (wanted != watch.polled) {
+    struct epoll_event ev{};
+    ev.events = ((wanted & kEventBits[kRead]) ? EPOLLIN : 0u) |
+                ((wanted & kEventBits[kWrite]) ? EPOLLOUT : 0u);
+    ev.data.fd = fd;
+    if (wanted == 0) {
+      epoll_ctl(poll_fd_, EPOLL_CTL_DEL, fd, &ev);
+    } else {
+      epoll_ctl(poll_fd_, watch.polled == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+    }
+  }
+#endif
+  watch.polled = wanted;
+
+  // the socket may get closed and its fd reused once nothing waits for it
+  if (wanted == 0) watches_.erase(it);
+}
+
+void IoContext::poll_once(int timeout_ms, std::vector<std::pair<int, Event>>& ready) {
+  ready.clear();
+
+#ifdef __linux__
+  struct epoll_event events[kMaxEventsPerWait];
+  const int res = epoll_wait(poll_fd_, events, kMaxEventsPerWait, timeout_ms);
+  if (res == -1) {
+    if (errno == EINTR) return;
+    throw std::system_error(errno_error(errno), "epoll_wait() failed");
+  }
+
+  for (int i = 0; i < res; ++i) {
+    const int fd = events[i].data.fd;
+    if (fd == wakeup_fds_[0]) continue;
+
+    // errors and hangups wake up both, the operations see the error
+    const uint32_t err_events = EPOLLERR | EPOLLHUP;
+    if (events[i].events & (EPOLLIN | err_events)) ready.emplace_back(fd, kRead);
+    if (events[i].events & (EPOLLOUT | err_events)) ready.emplace_back(fd, kWrite);
+  }
+#else
+  std::vector<struct pollfd> fds;
+  fds.reserve(watches_.size() + 1);
+#  ifndef _WIN32
+  struct pollfd wakeup_fd{};
+  wakeup_fd.fd = wakeup_fds_[0];
+  wakeup_fd.events = POLLIN;
+  fds.push_back(wakeup_fd);
+#  else
+  if (timeout_ms < 0 || timeout_ms > kPostedPollIntervalMs) timeout_ms = kPostedPollIntervalMs;
+#  endif
+  for (const auto& it : watches_) {
+    struct pollfd fd{};
+    fd.fd = it.first;
+    fd.events = static_cast<short>(((it.second.polled & kEventBits[kRead]) ? POLLIN : 0) |
+                                   ((it.second.polled & kEventBits[kWrite]) ? POLLOUT : 0));
+    fds.push_back(fd);
+  }
+
+  const int res = SocketOperations::instance()->poll(fds.data(), static_cast<nfds_t>(fds.size()),
+                                                     std::chrono::milliseconds(timeout_ms));
+  if (res == -1) {
+    const int err = SocketOperations::instance()->get_errno();
+#  ifndef _WIN32
+    if (err == EINTR) return;
+    throw std::system_error(errno_error(err), "poll() failed");
+#  else
+    throw std::system_error(std::error_code(err, std::system_category()), "WSAPoll() failed");
+#  endif
+  }
+
+  for (const struct pollfd& fd : fds) {
+    if (fd.revents == 0 || fd.fd == wakeup_fds_[0]) continue;
+
+    const short err_events = POLLERR | POLLHUP | POLLNVAL;
+    if (fd.revents & (POLLIN | err_events)) ready.emplace_back(static_cast<int>(fd.fd), kRead);
+    if (fd.revents & (POLLOUT | err_events)) ready.emplace_back(static_cast<int>(fd.fd), kWrite);
+  }
+#endif
+
+#ifndef _WIN32
+  char buf[256];
+  while (::read(wakeup_fds_[0], buf, sizeof(buf)) > 0) {}
+#endif
+}
+
+void IoContext::run_posted() {
+  std::vector<std::function<void()>> posted;
+  {
+    std::lock_guard<std::mutex> lock(posted_mtx_);
+    posted.swap(posted_);
+  }
+  for (auto& task : posted) task();
+}
+
+void IoContext::run() {
+  LoopMonitor::LoopId loop_id = LoopMonitor::instance().add(
+      name_, [this](LoopMonitor::Task task) { post(std::move(task)); });
+
+  std::vector<std::pair<int, Event>> ready;
+  try {
+    while (!stopped_) {
+      run_posted();
+      if (stopped_) break;
+
+      int timeout_ms = -1;
+      {
+        std::lock_guard<std::mutex> lock(posted_mtx_);
+        if (!posted_.empty()) timeout_ms = 0;
+      }
+      const auto next_expiry = timer_wheel_.next_expiry();
+      if (timeout_ms != 0 && next_expiry != clock_type::time_point::max()) {
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            next_expiry - clock_type::now());
+        // rounded up, waking up before the tick would spin
+        timeout_ms = static_cast<int>(std::max<std::chrono::milliseconds::rep>(
+            std::min<std::chrono::milliseconds::rep>(wait.count() + 1, 24 * 3600 * 1000), 0));
+      }
+
+      poll_once(timeout_ms, ready);
+
+      // the handlers may cancel the waits of the other sockets
+      for (const auto& it : ready) {
+        complete(it.first, it.second, std::error_code(), false);
+      }
+
+      expire_timers();
+    }
+  } catch (...) {
+    LoopMonitor::instance().remove(loop_id);
+    throw;
+  }
+
+  LoopMonitor::instance().remove(loop_id);
+}
+
+/*
+ * AsyncSocket
+ */
+
+struct AsyncSocket::Transfer {
+  char* buffer;
+  size_t size;
+  size_t done;
+  bool is_read;
+  IoContext::clock_type::time_point deadline;
+  Task<size_t>::Done on_done;
+};
+
+AsyncSocket::AsyncSocket(IoContext& io_ctx, int fd, SocketOperationsBase* sock_ops)
+    : io_ctx_(io_ctx), fd_(fd), sock_ops_(sock_ops) {
+  if (fd_ != -1) set_non_blocking(fd_);
+}
+
+AsyncSocket::~AsyncSocket() {
+  close();
+}
+
+void AsyncSocket::close() {
+  if (fd_ == -1) return;
+
+  io_ctx_.cancel(fd_);
+  sock_ops_->close(fd_);
+  fd_ = -1;
+}
+
+std::error_code AsyncSocket::last_error() const {
+#ifdef _WIN32
+  return std::error_code(sock_ops_->get_errno(), std::system_category());
+#else
+  return errno_error(sock_ops_->get_errno());
+#endif
+}
+
+bool AsyncSocket::would_block() const {
+  const int err = sock_ops_->get_errno();
+#ifdef _WIN32
+  return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+  return err == EAGAIN || err == EWOULDBLOCK || err == EINPROGRESS || err == EINTR;
+#endif
+}
+
+/*static*/
+IoContext::clock_type::time_point AsyncSocket::to_deadline(std::chrono::milliseconds timeout) {
+  if (timeout.count() < 0) return IoContext::clock_type::time_point::max();
+
+  return IoContext::clock_type::now() + timeout;
+}
+
+Task<Unit> AsyncSocket::connect(const struct sockaddr* addr, socklen_t addr_len,
+                                std::chrono::milliseconds timeout) {
+  struct sockaddr_storage storage{};
+  std::memcpy(&storage, addr, std::min(static_cast<size_t>(addr_len), sizeof(storage)));
+
+  return Task<Unit>([this, storage, addr_len, timeout](Task<Unit>::Done done) {
+    if (::connect(fd_, reinterpret_cast<const struct sockaddr*>(&storage), addr_len) == 0) {
+      done(std::error_code(), Unit());
+      return;
+    }
+    if (!would_block()) {
+      done(last_error(), Unit());
+      return;
+    }
+
+    io_ctx_.async_wait(fd_, IoContext::kWrite, to_deadline(timeout),
+                       [this, done](std::error_code ec) {
+      if (ec) {
+        done(ec, Unit());
+        return;
+      }
+
+      int so_error = 0;
+      if (sock_ops_->connect_non_blocking_status(fd_, so_error) == -1) {
+#ifdef _WIN32
+        ec = std::error_code(so_error, std::system_category());
+#else
+        ec = errno_error(so_error);
+#endif
+      }
+      done(ec, Unit());
+    });
+  });
+}
+
+Task<int> AsyncSocket::accept(std::chrono::milliseconds timeout) {
+  return Task<int>([this, timeout](Task<int>::Done done) {
+    accept_some(to_deadline(timeout), done);
+  });
+}
+
+void AsyncSocket::accept_some(IoContext::clock_type::time_point deadline, Task<int>::Done done) {
+  const int fd = static_cast<int>(::accept(fd_, nullptr, nullptr));
+  if (fd != -1) {
+    done(std::error_code(), fd);
+    return;
+  }
+  if (!would_block()) {
+    done(last_error(), -1);
+    return;
+  }
+
+  // waits again if the connection got reset before it got accepted
+  io_ctx_.async_wait(fd_, IoContext::kRead, deadline, [this, deadline, done](std::error_code ec) {
+    if (ec) {
+      done(ec, -1);
+    } else {
+      accept_some(deadline, done);
+    }
+  });
+}
+
+Task<size_t> AsyncSocket::read(void* buffer, size_t size, std::chrono::milliseconds timeout) {
+  return Task<size_t>([this, buffer, size, timeout](Task<size_t>::Done done) {
+    read_some(buffer, size, to_deadline(timeout), done);
+  });
+}
+
+void AsyncSocket::read_some(void* buffer, size_t size,
+                            IoContext::clock_type::time_point deadline, Task<size_t>::Done done) {
+  const ssize_t res = sock_ops_->read(fd_, buffer, size);
+  if (res >= 0) {
+    done(std::error_code(), static_cast<size_t>(res));
+    return;
+  }
+  if (!would_block()) {
+    done(last_error(), 0);
+    return;
+  }
+
+  io_ctx_.async_wait(fd_, IoContext::kRead, deadline,
+                     [this, buffer, size, deadline, done](std::error_code ec) {
+    if (ec) {
+      done(ec, 0);
+    } else {
+      read_some(buffer, size, deadline, done);
+    }
+  });
+}
+
+Task<size_t> AsyncSocket::read_exact(void* buffer, size_t size, std::chrono::milliseconds timeout) {
+  return Task<size_t>([this, buffer, size, timeout](Task<size_t>::Done done) {
+    transfer(std::shared_ptr<Transfer>(new Transfer{static_cast<char*>(buffer), size, 0, true,
+                                                    to_deadline(timeout), done}));
+  });
+}
+
+Task<size_t> AsyncSocket::write(const void* buffer, size_t size, std::chrono::milliseconds timeout) {
+  return Task<size_t>([this, buffer, size, timeout](Task<size_t>::Done done) {
+    // only read from, SocketOperationsBase::write() takes a non-const buffer
+    transfer(std::shared_ptr<Transfer>(new Transfer{
+        const_cast<char*>(static_cast<const char*>(buffer)), size, 0, false,
+        to_deadline(timeout), done}));
+  });
+}
+
+void AsyncSocket::transfer(std::shared_ptr<Transfer> op) {
+  while (op->done < op->size) {
+    char* data = op->buffer + op->done;
+    const size_t left = op->size - op->done;
+    const ssize_t res = op->is_read ? sock_ops_->read(fd_, data, left)
+                                    : sock_ops_->write(fd_, data, left);
+    if (res > 0) {
+      op->done += static_cast<size_t>(res);
+      continue;
+    }
+    if (res == 0 && op->is_read) {
+      op->on_done(std::make_error_code(std::errc::connection_reset), op->done);
+      return;
+    }
+    if (res < 0 && !would_block()) {
+      op->on_done(last_error(), op->done);
+      return;
+    }
+
+    io_ctx_.async_wait(fd_, op->is_read ? IoContext::kRead : IoContext::kWrite, op->deadline,
+                       [this, op](std::error_code ec) {
+      if (ec) {
+        op->on_done(ec, op->done);
+      } else {
+        transfer(op);
+      }
+    });
+    return;
+  }
+
+  op->on_done(std::error_code(), op->done);
+}
+
+}  // namespace mysql_harness
@@ -40,8 +40,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <ios>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -92,6 +94,7 @@ ConfigSection::ConfigSection(const ConfigSection& other,
 
 void ConfigSection::clear() {
   options_.clear();
+  ++version_;
 }
 
 // throws bad_section
@@ -109,6 +112,7 @@ void ConfigSection::update(const ConfigSection& other) {
 
   for (auto& option : other.options_)
     options_[option.first] = option.second;
+  ++version_;
 
   assert(old_defaults == defaults_);
 }
@@ -159,8 +163,71 @@ ConfigSection::do_replace(const std::string& value, int depth) const {
   return result;
 }
 
+size_t ConfigSection::OptionNameHash::operator()(const std::string& option) const noexcept {
+  // FNV-1a
+  size_t hash = static_cast<size_t>(14695981039346656037ULL);
+  for (char ch : option) {
+    hash ^= static_cast<unsigned char>(::tolower(static_cast<unsigned char>(ch)));
+    hash *= static_cast<size_t>(1099511628211ULL);
+  }
+  return hash;
+}
+
+bool ConfigSection::OptionNameEqual::operator()(const std::string& a,
+                                                const std::string& b) const noexcept {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return ::tolower(static_cast<unsigned char>(x)) ==
+                  ::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+std::shared_ptr<const ConfigSection::OptionTable>
+ConfigSection::get_option_table() const {
+  const uint64_t defaults_version = defaults_ ? defaults_->version_ : 0;
+  auto is_current = [&](const std::shared_ptr<const OptionTable>& table) {
+    return table && table->version == version_ &&
+           table->defaults_version == defaults_version;
+  };
+
+  auto table = std::atomic_load(&option_table_.table);
+  if (is_current(table)) return table;
+
+  std::lock_guard<std::mutex> lock(option_table_.mtx);
+  table = std::atomic_load(&option_table_.table);
+  if (is_current(table)) return table;
+
+  auto fresh = std::make_shared<OptionTable>();
+  fresh->version = version_;
+  fresh->defaults_version = defaults_version;
+
+  auto add_resolved = [&](const OptionMap& options) {
+    for (const auto& option : options) {
+      if (fresh->values.count(option.first)) continue;  // overridden
+
+      try {
+        fresh->values.emplace(option.first, do_replace(option.second));
+      } catch (const syntax_error&) {
+        // reported by get() when the option is asked for
+      }
+    }
+  };
+  add_resolved(options_);
+  if (defaults_) add_resolved(defaults_->options_);
+
+  table = fresh;
+  std::atomic_store(&option_table_.table, table);
+  return table;
+}
+
 std::string ConfigSection::get(const std::string& option) const {
   check_option(option);
+
+  const auto table = get_option_table();
+  const auto it = table->values.find(option);
+  if (it != table->values.end())
+    return it->second;
+
   auto result = do_locate(option);
   if (std::get<1>(result))
     return do_replace(std::get<0>(result)->second);
@@ -183,6 +250,8 @@ std::string ConfigSection::get_section_name(const std::string& option) const {
 
 bool ConfigSection::has(const std::string& option) const {
   check_option(option);
+  if (get_option_table()->values.count(option)) return true;
+
   return std::get<1>(do_locate(option));
 }
 
@@ -202,12 +271,14 @@ ConfigSection::do_locate(const std::string& option) const {
 void ConfigSection::set(const std::string& option, const std::string& value) {
   check_option(option); // throws bad_option
   options_[lower(option)] = value;
+  ++version_;
 }
 
 void ConfigSection::add(const std::string& option, const std::string& value) {
   auto ret = options_.emplace(OptionMap::value_type(lower(option), value));
   if (!ret.second)
     throw bad_option("Option '" + option + "' already defined");
+  ++version_;
 }
 
 Config::Config(unsigned int flags) noexcept
@@ -24,6 +24,8 @@
 
 #include "dim.h"
 
+#include "mysql/harness/executor.h"
+
 namespace mysql_harness {
 
 /*static*/ DIM& DIM::instance() {
@@ -33,7 +35,9 @@ namespace mysql_harness {
 
 // we define them here to make sure they're not inlined
 // (that could be dangerous when called from other DLLs)
-DIM::DIM() {}
+DIM::DIM()
+    : factory_Executor_([]() { return new Executor(); }),
+      deleter_Executor_(std::default_delete<Executor>()) {}
 DIM::~DIM() {}
 
 } // namespace mysql_harness
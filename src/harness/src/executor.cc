@@ -0,0 +1,227 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/executor.h"
+
+#include "common.h"
+#include "mysql_router_thread.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace mysql_harness {
+
+// worker the calling thread is, to keep the tasks it submits local
+static thread_local const Executor* current_executor = nullptr;
+static thread_local size_t current_worker = 0;
+
+Executor::Executor(size_t num_threads, const std::vector<unsigned>& cpus)
+    : cpus_(cpus) {
+  if (num_threads == 0)
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (size_t i = 0; i < num_threads; ++i)
+    workers_.emplace_back(new Worker());
+
+  try {
+    for (size_t i = 0; i < num_threads; ++i)
+      workers_[i]->thread = std::thread(&Executor::worker_loop, this, i);
+    timer_thread_ = std::thread(&Executor::timer_loop, this);
+  } catch (...) {
+    stop();
+    throw;
+  }
+}
+
+Executor::~Executor() {
+  stop();
+}
+
+void Executor::stop() {
+  {
+    std::lock_guard<std::mutex> lock(timers_mtx_);
+    timers_stopping_ = true;
+    timers_.clear();
+    timer_expiry_.clear();
+  }
+  timers_cond_.notify_all();
+  if (timer_thread_.joinable())
+    timer_thread_.join();
+
+  {
+    std::lock_guard<std::mutex> lock(idle_mtx_);
+    stopping_ = true;
+  }
+  idle_cond_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable())
+      worker->thread.join();
+  }
+}
+
+std::future<void> Executor::submit(Task task) {
+  if (stopping_)
+    throw std::logic_error("executor is stopped");
+
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> result = packaged.get_future();
+  push(std::move(packaged));
+
+  return result;
+}
+
+void Executor::push(std::packaged_task<void()> task) {
+  const bool from_worker = current_executor == this;
+  const size_t ndx = from_worker
+      ? current_worker
+      : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+  // counted first, workers that see the count retry until the task is there
+  pending_.fetch_add(1);
+  {
+    Worker& worker = *workers_[ndx];
+    std::lock_guard<std::mutex> lock(worker.mtx);
+    if (from_worker)
+      worker.tasks.push_front(std::move(task));
+    else
+      worker.tasks.push_back(std::move(task));
+  }
+
+  // taking the lock makes sure an idle worker is either waiting already or
+  // sees pending_ before waiting
+  { std::lock_guard<std::mutex> lock(idle_mtx_); }
+  idle_cond_.notify_one();
+}
+
+bool Executor::pop(size_t ndx, std::packaged_task<void()>& task) {
+  Worker& worker = *workers_[ndx];
+  std::lock_guard<std::mutex> lock(worker.mtx);
+  if (worker.tasks.empty())
+    return false;
+
+  task = std::move(worker.tasks.front());
+  worker.tasks.pop_front();
+  pending_.fetch_sub(1);
+  return true;
+}
+
+bool Executor::steal(size_t ndx, std::packaged_task<void()>& task) {
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    Worker& victim = *workers_[(ndx + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mtx);
+    if (victim.tasks.empty())
+      continue;
+
+    // the oldest task, the victim works on the newest ones
+    task = std::move(victim.tasks.back());
+    victim.tasks.pop_back();
+    pending_.fetch_sub(1);
+    return true;
+  }
+
+  return false;
+}
+
+void Executor::worker_loop(size_t ndx) {
+  rename_thread(("Executor:" + std::to_string(ndx)).substr(0, 15).c_str());
+  current_executor = this;
+  current_worker = ndx;
+  // a worker that can't be pinned runs on any CPU
+  if (!cpus_.empty())
+    set_current_thread_cpu_affinity(cpus_);
+
+  for (;;) {
+    std::packaged_task<void()> task;
+    if (pop(ndx, task) || steal(ndx, task)) {
+      task();  // exceptions end up in the future
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(idle_mtx_);
+    // queued tasks are run before stopping
+    if (stopping_ && pending_ == 0)
+      return;
+    idle_cond_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+  }
+}
+
+Executor::TimerId Executor::schedule(std::chrono::milliseconds delay, Task task) {
+  const auto expiry = std::chrono::steady_clock::now() + delay;
+
+  std::lock_guard<std::mutex> lock(timers_mtx_);
+  if (timers_stopping_)
+    throw std::logic_error("executor is stopped");
+
+  const TimerId id = next_timer_id_++;
+  const bool is_first = timers_.empty() || TimerKey(expiry, id) < timers_.begin()->first;
+  timers_.emplace(TimerKey(expiry, id), std::move(task));
+  timer_expiry_.emplace(id, expiry);
+
+  // the timer thread only needs to wait less if this is the next timer
+  if (is_first)
+    timers_cond_.notify_one();
+
+  return id;
+}
+
+bool Executor::cancel(TimerId id) {
+  std::lock_guard<std::mutex> lock(timers_mtx_);
+  auto it = timer_expiry_.find(id);
+  if (it == timer_expiry_.end())
+    return false;
+
+  timers_.erase(TimerKey(it->second, id));
+  timer_expiry_.erase(it);
+  return true;
+}
+
+void Executor::timer_loop() {
+  rename_thread("Executor:timer");
+
+  std::unique_lock<std::mutex> lock(timers_mtx_);
+  while (!timers_stopping_) {
+    if (timers_.empty()) {
+      timers_cond_.wait(lock);
+      continue;
+    }
+
+    auto first = timers_.begin();
+    if (first->first.first > std::chrono::steady_clock::now()) {
+      timers_cond_.wait_until(lock, first->first.first);
+      continue;
+    }
+
+    std::packaged_task<void()> task(std::move(first->second));
+    timer_expiry_.erase(first->first.second);
+    timers_.erase(first);
+
+    // stop() joins the timer thread before it stops the workers
+    lock.unlock();
+    push(std::move(task));
+    lock.lock();
+  }
+}
+
+}  // namespace mysql_harness
@@ -24,15 +24,21 @@
 
 #include "keyring/keyring_file.h"
 #include "common.h"
+#include <cstdint>
 #include <fstream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string.h>
 #include <system_error>
 
+#include <sys/stat.h>
 #ifdef _WIN32
 #include <aclapi.h>
 #else
-#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 constexpr const char kKeyringFileSignature[] = {'M', 'R', 'K', 'R'};
@@ -230,6 +236,86 @@ static void check_file_access_rights(const std::string& file_name) {
 
 namespace mysql_harness {
 
+namespace {
+
+/** @brief tells versions of a keyring file apart */
+struct FileStamp {
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t size;
+
+  bool operator==(const FileStamp& other) const {
+    return mtime_sec == other.mtime_sec && mtime_nsec == other.mtime_nsec && size == other.size;
+  }
+};
+
+/** @brief a keyring file decrypted before */
+struct CachedKeyring {
+  FileStamp stamp;
+  std::string key;
+  std::string header;
+  mysql_harness::KeyringMemory keyring;
+};
+
+// loading the same keyring again, e.g. when plugins get initialized again,
+// doesn't decrypt it again unless the file changed
+std::mutex g_keyring_cache_mtx;
+std::map<std::string, CachedKeyring> g_keyring_cache;
+
+bool load_from_cache(const std::string& file_name, const std::string& key,
+                     const FileStamp& stamp, mysql_harness::KeyringMemory& keyring,
+                     std::string& header) {
+  std::lock_guard<std::mutex> lock(g_keyring_cache_mtx);
+  auto it = g_keyring_cache.find(file_name);
+  if (it == g_keyring_cache.end() || !(it->second.stamp == stamp) || it->second.key != key)
+    return false;
+
+  keyring = it->second.keyring;
+  header = it->second.header;
+  return true;
+}
+
+void store_in_cache(const std::string& file_name, const std::string& key,
+                    const FileStamp& stamp, const mysql_harness::KeyringMemory& keyring,
+                    const std::string& header) {
+  std::lock_guard<std::mutex> lock(g_keyring_cache_mtx);
+  g_keyring_cache[file_name] = CachedKeyring{stamp, key, header, keyring};
+}
+
+void forget_cached(const std::string& file_name) {
+  std::lock_guard<std::mutex> lock(g_keyring_cache_mtx);
+  g_keyring_cache.erase(file_name);
+}
+
+/**
+ * Checks the signature of keyring file contents and reads the header.
+ *
+ * @return offset of the encrypted keyring data
+ */
+std::size_t parse_file_contents(const std::string& file_name, const char* data, std::size_t size,
+                                std::string& header) {
+  // check signature
+  if (size < sizeof(kKeyringFileSignature))
+    throw std::runtime_error("Failure reading contents of keyring file " + file_name);
+  if (strncmp(data, kKeyringFileSignature, sizeof(kKeyringFileSignature)) != 0)
+    throw std::runtime_error("Invalid data found in keyring file " + file_name);
+
+  // read header, if there's one
+  uint32_t header_size;
+  std::size_t offset = sizeof(kKeyringFileSignature);
+  if (size - offset < sizeof(header_size))
+    throw std::runtime_error("Invalid data found in keyring file " + file_name);
+  memcpy(&header_size, data + offset, sizeof(header_size));
+  offset += sizeof(header_size);
+  if (header_size > size - offset)
+    throw std::runtime_error("Invalid data found in keyring file " + file_name);
+  header.assign(data + offset, header_size);
+
+  return offset + header_size;
+}
+
+}  // namespace
+
 void KeyringFile::set_header(const std::string &data) {
   header_ = data;
 }
@@ -239,6 +325,9 @@ void KeyringFile::save(const std::string& file_name,
   if (key.empty()) {
     throw std::runtime_error("Keyring encryption key must not be blank");
   }
+  // the file changes, even if its mtime may not
+  forget_cached(file_name);
+
   // Serialize keyring.
   auto buffer = serialize(key);
 
@@ -330,6 +419,50 @@ void KeyringFile::load(const std::string& file_name, const std::string& key) {
   // throws std::runtime_error with appropriate error message on verification failure
   verify_file_permissions(file_name);
 
+#ifndef _WIN32
+  // map the file instead of copying it through iostreams
+  int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Failed to load keyring file: ") +
+                             file_name + ": " + get_strerror(errno));
+  }
+  std::shared_ptr<void> fd_guard(nullptr, [fd](void*) { ::close(fd); });
+
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    throw std::runtime_error(std::string("Failed to load keyring file: ") +
+                             file_name + ": " + get_strerror(errno));
+  }
+#ifdef __APPLE__
+  const int64_t mtime_nsec = status.st_mtimespec.tv_nsec;
+#else
+  const int64_t mtime_nsec = status.st_mtim.tv_nsec;
+#endif
+  const FileStamp stamp{status.st_mtime, mtime_nsec, static_cast<uint64_t>(status.st_size)};
+  if (load_from_cache(file_name, key, stamp, *this, header_))
+    return;
+
+  const std::size_t file_size = static_cast<std::size_t>(status.st_size);
+  if (file_size == 0)
+    throw std::runtime_error("Failure reading contents of keyring file " + file_name);
+
+  void* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error(std::string("Failed to load keyring file: ") +
+                             file_name + ": " + get_strerror(errno));
+  }
+  std::shared_ptr<void> map_guard(nullptr, [mapped, file_size](void*) { munmap(mapped, file_size); });
+  const char* contents = static_cast<const char*>(mapped);
+#else
+  struct _stat64 status;
+  if (_stat64(file_name.c_str(), &status) != 0) {
+    throw std::runtime_error(std::string("Failed to load keyring file: ") +
+                             file_name + ": " + get_strerror(errno));
+  }
+  const FileStamp stamp{status.st_mtime, 0, static_cast<uint64_t>(status.st_size)};
+  if (load_from_cache(file_name, key, stamp, *this, header_))
+    return;
+
   // Read keyring data from file.
   std::ifstream file;
 
@@ -342,41 +475,23 @@ void KeyringFile::load(const std::string& file_name, const std::string& key) {
                              file_name + ": " + get_strerror(errno));
   }
 
-  file.seekg(0, file.end);
-  std::size_t file_size = static_cast<std::size_t>(file.tellg());
-
-  // read and check signature
+  const std::size_t file_size = static_cast<std::size_t>(file.tellg());
+  std::vector<char> buffer(file_size);
   file.seekg(0, file.beg);
-  {
-    char sig[sizeof(kKeyringFileSignature)];
-    try {
-      file.read(sig, sizeof(sig));
-    } catch (const std::ios_base::failure& e) {
-      throw std::runtime_error("Failure reading contents of keyring file " + file_name);
-    }
-    if (strncmp(sig, kKeyringFileSignature, sizeof(kKeyringFileSignature)) != 0)
-      throw std::runtime_error("Invalid data found in keyring file " + file_name);
-  }
-  // read header, if there's one
-  {
-    uint32_t header_size;
-    file.read(reinterpret_cast<char*>(&header_size), sizeof(header_size));
-    if (header_size > 0) {
-      if (header_size > file_size - sizeof(kKeyringFileSignature) - sizeof(header_size)) {
-        throw std::runtime_error("Invalid data found in keyring file " + file_name);
-      }
-      header_.resize(header_size);
-      file.read(&header_[0], static_cast<std::streamsize>(header_.size()));
-    }
+  try {
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  } catch (const std::ios_base::failure&) {
+    throw std::runtime_error("Failure reading contents of keyring file " + file_name);
   }
+  const char* contents = buffer.data();
+#endif
 
-  std::size_t data_size = file_size - static_cast<std::size_t>(file.tellg());
-
-  std::vector<char> buffer(static_cast<std::size_t>(data_size));
-  file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  const std::size_t offset = parse_file_contents(file_name, contents, file_size, header_);
 
   // Parse keyring data.
-  parse(key, buffer.data(), buffer.size());
+  parse(key, contents + offset, file_size - offset);
+
+  store_in_cache(file_name, key, stamp, *this, header_);
 }
 
 std::string KeyringFile::read_header(const std::string& file_name) {
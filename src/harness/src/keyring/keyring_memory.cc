@@ -26,6 +26,7 @@
 #include "mysqlrouter/my_aes.h"
 #include <cstdint>
 #include <cstring>
+#include <memory>
 
 
 constexpr auto kAesMode = myaes::my_aes_256_cbc;
@@ -200,6 +201,15 @@ static void parse(
 }
 
 
+// Overwrites decrypted data before the buffer gets freed, through volatile
+// so that the writes don't get optimized away.
+static void wipe(std::vector<char>& buffer) {
+  volatile char* p = buffer.data();
+  for (std::size_t i = 0; i < buffer.size(); ++i)
+    p[i] = 0;
+}
+
+
 namespace mysql_harness {
 
 
@@ -233,6 +243,7 @@ std::vector<char> KeyringMemory::serialize(const std::string& key) const {
   std::vector<char> buffer(buffer_size);
 
   ::serialize(buffer.data(), entries_);
+  std::shared_ptr<void> wipe_guard(nullptr, [&buffer](void*) { wipe(buffer); });
 
   // Encrypt buffer.
   auto aes_buffer_size = myaes::my_aes_get_size(
@@ -256,6 +267,7 @@ void KeyringMemory::parse(const std::string& key, const char* buffer,
                           std::size_t buffer_size) {
   // Decrypt buffer.
   std::vector<char> decrypted_buffer(buffer_size);
+  std::shared_ptr<void> wipe_guard(nullptr, [&decrypted_buffer](void*) { wipe(decrypted_buffer); });
 
   auto decrypted_size = my_aes_decrypt(
       reinterpret_cast<const unsigned char*>(buffer),
@@ -28,10 +28,15 @@
 ////////////////////////////////////////
 // Package include files
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/executor.h"
 #include "mysql/harness/filesystem.h"
 #include "mysql/harness/plugin.h"
+#include "mysql/harness/readiness.h"
+#include "mysql/harness/reconfiguration.h"
 #include "designator.h"
+#include "dim.h"
 #include "exception.h"
+#include "mysql_router_thread.h"
 #include "utilities.h"
 IMPORT_LOG_FUNCTIONS()
 
@@ -40,13 +45,16 @@ IMPORT_LOG_FUNCTIONS()
 #include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <system_error>
 #include <thread>
+#include <vector>
 
 #ifndef _WIN32
 #  include <dlfcn.h>
@@ -115,6 +123,9 @@ static_assert((std::is_same<sig_atomic_t, int>::value && (ATOMIC_INT_LOCK_FREE =
     (std::is_same<sig_atomic_t, long>::value && (ATOMIC_LONG_LOCK_FREE == 2)), "expected sig_atomic_t to lock-free");
 
 
+// when Router receives a signal to reload its configuration, this flag is set
+static volatile std::atomic<sig_atomic_t> g_reload_pending { 0 };
+
 // called from sig_handler() on Unix,
 //        from NTService class and Ctrl+C handler on Windows
 void request_application_shutdown() {
@@ -128,6 +139,9 @@ static void sig_handler(int signal) {
     case SIGTERM:
       request_application_shutdown();
       break;
+    case SIGHUP:
+      g_reload_pending = 1;
+      break;
     default:
       break;
   }
@@ -161,7 +175,8 @@ static void set_signal_handlers() {
                              // what we block - the handler is trivial
 
     if (sigaction(SIGINT,  &sa, nullptr) == -1 ||
-        sigaction(SIGTERM, &sa, nullptr) == -1) {
+        sigaction(SIGTERM, &sa, nullptr) == -1 ||
+        sigaction(SIGHUP,  &sa, nullptr) == -1) {
       throw std::runtime_error("sigaction() failed: "
                                + std::string(std::strerror(errno)));
     }
@@ -173,6 +188,7 @@ static void set_signal_handlers() {
     sigemptyset(&ss);
     sigaddset(&ss, SIGINT);
     sigaddset(&ss, SIGTERM);
+    sigaddset(&ss, SIGHUP);
     if (0 != pthread_sigmask(SIG_UNBLOCK, &ss, nullptr)) {
       throw std::runtime_error("pthread_sigmask() failed: "
                                + std::string(std::strerror(errno)));
@@ -370,6 +386,16 @@ std::tuple<std::string, std::exception_ptr> PluginFuncEnv::pop_error() noexcept
 Loader::~Loader() {
 }
 
+// plugins linked into the executable, by name
+static std::map<std::string, Plugin*>& builtin_plugins() {
+  static std::map<std::string, Plugin*> plugins;
+  return plugins;
+}
+
+void Loader::add_builtin_plugin(const std::string& name, Plugin* plugin) {
+  builtin_plugins()[name] = plugin;
+}
+
 Plugin* Loader::load_from(const std::string& plugin_name,
                           const std::string& library_name) {
   std::string error;
@@ -379,10 +405,18 @@ Plugin* Loader::load_from(const std::string& plugin_name,
   // honor potential dynamic library open/close reference counts. It
   // is up to the platform implementation to ensure that multiple
   // instances of a library can be handled.
+  //
+  // Plugins linked into the executable need no library, unless the
+  // section asks for another one than the plugin's own.
+  const auto builtin = builtin_plugins().find(plugin_name);
+  const bool is_builtin = builtin != builtin_plugins().end() && library_name == plugin_name;
 
-  PluginInfo info(plugin_folder_, library_name);  // throws bad_plugin
+  PluginInfo info = is_builtin
+      ? PluginInfo(nullptr, builtin->second)
+      : PluginInfo(plugin_folder_, library_name);  // throws bad_plugin
 
-  info.load_plugin(plugin_name);  // throws bad_plugin
+  if (!is_builtin)
+    info.load_plugin(plugin_name);  // throws bad_plugin
 
   // Check that ABI version and architecture match
   auto plugin = info.plugin;
@@ -424,7 +458,7 @@ Plugin* Loader::load_from(const std::string& plugin_name,
   // If all went well, we register the plugin and return a
   // pointer to it.
   plugins_.emplace(plugin_name, std::move(info));
-  log_debug("  plugin '%s' loaded ok", plugin_name.c_str());
+  log_debug("  plugin '%s' %s ok", plugin_name.c_str(), is_builtin ? "built in" : "loaded");
   return plugin;
 }
 
@@ -460,10 +494,68 @@ Plugin* Loader::load(const std::string& plugin_name) {
   return load_from(plugin_name, library_name);  // throws bad_plugin
 }
 
+// component the loader reports its readiness as
+static const char kReadinessComponent[] = "harness";
+
+// workers of the executor the plugins share, 0 for one per hardware thread
+static size_t get_executor_threads(const Config& config) {
+  if (!config.has_default("executor_threads"))
+    return 0;
+
+  const std::string value = config.get_default("executor_threads");
+  char* end = nullptr;
+  const unsigned long threads = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || !isdigit(static_cast<unsigned char>(value[0])) ||
+      *end != '\0' || threads > 1024) {
+    throw std::invalid_argument(
+        "option executor_threads in [DEFAULT] needs value between 0 and 1024 inclusive, was '" +
+        value + "'");
+  }
+
+  return threads;
+}
+
+// CPUs the workers of the executor are pinned to, empty for all
+static std::vector<unsigned> get_executor_cpu_affinity(const Config& config) {
+  if (!config.has_default("executor_cpu_affinity"))
+    return {};
+
+  const std::string value = config.get_default("executor_cpu_affinity");
+  try {
+    return parse_cpu_list(value);
+  } catch (const std::invalid_argument& e) {
+    throw std::invalid_argument(
+        "option executor_cpu_affinity in [DEFAULT] needs a list of CPUs like '0-3,8', was '" +
+        value + "': " + e.what());
+  }
+}
+
 void Loader::start() {
+  // both throw std::invalid_argument
+  const size_t executor_threads = get_executor_threads(config_);
+  const std::vector<unsigned> executor_cpus = get_executor_cpu_affinity(config_);
+  DIM::instance().set_Executor([executor_threads, executor_cpus]() {
+                                 return new Executor(executor_threads, executor_cpus);
+                               },
+                               std::default_delete<Executor>());
+
+  // not ready until all plugins got started
+  Readiness& readiness = Readiness::instance();
+  readiness.expect(kReadinessComponent);
+  readiness.add_listener([](bool ready) {
+    if (ready) {
+      log_info("Ready to serve.");
+      notify_service_manager("READY=1");
+    }
+  });
 
   // unload plugins on exit
-  std::shared_ptr<void> exit_guard(nullptr, [this](void*){ unload_all(); });
+  std::shared_ptr<void> exit_guard(nullptr, [this](void*){
+    unload_all();
+    // plugins are done with their tasks
+    DIM::instance().reset_Executor();
+    Readiness::instance().clear();
+  });
 
   // load plugins
   load_all(); // throws bad_plugin on load error, causing an early return
@@ -613,6 +705,24 @@ static void call_plugin_function(PluginFuncEnv* env,
   }
 }
 
+// returns exception triggered by init() of the plugin
+std::exception_ptr Loader::init_plugin(const std::string& plugin_name) {
+  PluginInfo &info = plugins_.at(plugin_name);
+
+  if (!info.plugin->init) {
+    log_debug("  plugin '%s' doesn't implement init()", plugin_name.c_str());
+    return nullptr;
+  }
+
+  log_info("  plugin '%s' initializing", plugin_name.c_str());
+  PluginFuncEnv env(&appinfo_, nullptr);
+
+  std::exception_ptr eptr;
+  call_plugin_function(&env, eptr, info.plugin->init, "init",
+                       plugin_name.c_str());
+  return eptr;
+}
+
 // returns first exception triggered by init()
 std::exception_ptr Loader::init_all() {
   log_info("Initializing all plugins.");
@@ -622,29 +732,14 @@ std::exception_ptr Loader::init_all() {
 
   order_.reverse(); // we need reverse-topo order
   for (auto it = order_.begin(); it != order_.end(); ++it) {
-
-    const std::string& plugin_name = *it;
-    PluginInfo &info = plugins_.at(plugin_name);
-
-    if (!info.plugin->init) {
-      log_debug("  plugin '%s' doesn't implement init()", plugin_name.c_str());
-      continue;
-    }
-
-    log_info("  plugin '%s' initializing", plugin_name.c_str());
-    PluginFuncEnv env(&appinfo_, nullptr);
-
-    std::exception_ptr eptr;
-    call_plugin_function(&env, eptr, info.plugin->init, "init",
-                         plugin_name.c_str());
+    std::exception_ptr eptr = init_plugin(*it);
     if (eptr) {
       // erase this and all remaining plugins from the list, so that
       // deinit_all() will not try to run deinit() on them
       order_.erase(it, order_.end());
       return eptr;
     }
-
-  } // for (auto it = order_.begin(); it != order_.end(); ++it)
+  }
 
   return nullptr;
 }
@@ -664,59 +759,76 @@ void Loader::start_all() {
   //   guaranteed to be passed on to the main thread.
   block_all_signals();
 
+  // plugins whose thread didn't initialize its env object yet
+  std::vector<std::pair<const ConfigSection*,
+                        std::future<std::shared_ptr<PluginFuncEnv>>>> pending_envs;
+
   // start all the plugins (call plugin's start() function)
   for (const ConfigSection* section : config_.sections()) {
+    std::future<std::shared_ptr<PluginFuncEnv>> env = launch_section(section);
+    if (env.valid())
+      pending_envs.emplace_back(section, std::move(env));
+  }
 
-    PluginInfo& plugin = plugins_.at(section->name);
-    void (*fptr)(PluginFuncEnv*) = plugin.plugin->start;
+  // block until all dispatch() initialized their plugin thread to a
+  // thread-safe state, then save the env objects for later. The threads
+  // got launched all first, so they don't wait for each other.
+  for (auto& pending_env : pending_envs) {
+    assert(plugin_start_env_.count(pending_env.first) == 0);
+    plugin_start_env_[pending_env.first] = pending_env.second.get();  // returns shared_ptr to PluginFuncEnv; PluginFuncEnv exists on heap
+  }
 
-    if (!fptr) {
-      log_debug("  plugin '%s:%s' doesn't implement start()",
-                section->name.c_str(), section->key.c_str());
+  // We wait with this until after we launch all plugin threads, to avoid
+  // a potential race if a signal was received while plugins were still
+  // launching.
+  set_signal_handlers();
 
-      // create a env object for later
-      assert(plugin_start_env_.count(section) == 0);
-      plugin_start_env_[section] = std::make_shared<PluginFuncEnv>(nullptr, section, false);
+  // the plugins that need time to become ready announced that in init()
+  Readiness::instance().report(kReadinessComponent, true);
+}
 
-      continue;
-    }
+std::future<std::shared_ptr<PluginFuncEnv>>
+Loader::launch_section(const ConfigSection* section) {
+  PluginInfo& plugin = plugins_.at(section->name);
+  void (*fptr)(PluginFuncEnv*) = plugin.plugin->start;
 
-    // future will remain valid even after promise is destructed
-    std::promise<std::shared_ptr<PluginFuncEnv>> env_promise;
+  if (!fptr) {
+    log_debug("  plugin '%s:%s' doesn't implement start()",
+              section->name.c_str(), section->key.c_str());
 
-    // plugin start() will run in this new thread
-    auto dispatch = [fptr, section, &env_promise]()
-        -> std::exception_ptr {
-      log_info("  plugin '%s:%s' starting",
-               section->name.c_str(), section->key.c_str());
+    // create a env object for later
+    assert(plugin_start_env_.count(section) == 0);
+    plugin_start_env_[section] = std::make_shared<PluginFuncEnv>(nullptr, section, false);
 
-      // init env object and unblock harness thread
-      std::shared_ptr<PluginFuncEnv> this_thread_env =
-          std::make_shared<PluginFuncEnv>(nullptr, section, true);
-      env_promise.set_value(this_thread_env); // shared_ptr gets copied here (future will own a copy)
+    return {};
+  }
 
-      std::exception_ptr eptr;
-      call_plugin_function(this_thread_env.get(), eptr, fptr, "start",
-                           section->name.c_str(), section->key.c_str());
-      return eptr;
-    };
+  // future will remain valid even after promise is destructed
+  auto env_promise = std::make_shared<std::promise<std::shared_ptr<PluginFuncEnv>>>();
+  std::future<std::shared_ptr<PluginFuncEnv>> env_future = env_promise->get_future();
 
-    // launch plugin and save the future for exit status retrieval later on
-    std::future<std::exception_ptr> fut =
-        std::async(std::launch::async, dispatch);
-    sessions_.push_back(std::move(fut));
+  // plugin start() will run in this new thread
+  auto dispatch = [fptr, section, env_promise]()
+      -> std::exception_ptr {
+    log_info("  plugin '%s:%s' starting",
+             section->name.c_str(), section->key.c_str());
 
-    // block until dispatch() initializes plugin thread to a thread-safe state,
-    // then save the env object for later
-    assert(plugin_start_env_.count(section) == 0);
-    plugin_start_env_[section] = env_promise.get_future().get();  // returns shared_ptr to PluginFuncEnv; PluginFuncEnv exists on heap
+    // init env object and unblock harness thread
+    std::shared_ptr<PluginFuncEnv> this_thread_env =
+        std::make_shared<PluginFuncEnv>(nullptr, section, true);
+    env_promise->set_value(this_thread_env); // shared_ptr gets copied here (future will own a copy)
+
+    std::exception_ptr eptr;
+    call_plugin_function(this_thread_env.get(), eptr, fptr, "start",
+                         section->name.c_str(), section->key.c_str());
+    return eptr;
+  };
 
-  } // for (const ConfigSection* section: config_.sections())
+  // launch plugin and save the future for exit status retrieval later on
+  assert(sessions_.count(section) == 0);
+  sessions_[section] = std::async(std::launch::async, dispatch);
 
-  // We wait with this until after we launch all plugin threads, to avoid
-  // a potential race if a signal was received while plugins were still
-  // launching.
-  set_signal_handlers();
+  return env_future;
 }
 
 // returns first exception triggered by start() or stop()
@@ -747,8 +859,16 @@ std::exception_ptr Loader::main_loop() {
       called_stop_all = true;
     }
 
+    // handle received reload signal, not once shutting down
+    if (g_reload_pending) {
+      g_reload_pending = 0;
+      if (!called_stop_all)
+        reload_config();
+    }
+
     // check all plugin instances for termination
-    for (std::future<std::exception_ptr>& fut : sessions_) {
+    for (auto& session : sessions_) {
+      std::future<std::exception_ptr>& fut = session.second;
 
       // handle this plugin no longer running
       if (!fut.valid()) {
@@ -766,6 +886,15 @@ std::exception_ptr Loader::main_loop() {
       if (fut.wait_until(timepoint) == std::future_status::ready) {
         std::exception_ptr tmp = fut.get();
 
+        // a section started by a reload failing leaves the others running,
+        // the error got logged already
+        if (tmp && reloaded_sections_.count(session.first)) {
+          log_error("  plugin '%s:%s' failed after reloading the configuration, "
+                    "the other plugins keep running",
+                    session.first->name.c_str(), session.first->key.c_str());
+          continue;
+        }
+
         // if plugin's start() threw, we save its exception and initiate shutdown
         if (tmp && !first_eptr) {
           first_eptr = tmp;
@@ -778,7 +907,7 @@ std::exception_ptr Loader::main_loop() {
         have_unsettled_futures = true;
       }
 
-    } // for (std::future<std::exception_ptr>& fut : sessions_)
+    } // for (auto& session : sessions_)
 
   } while (have_unsettled_futures);
 
@@ -808,36 +937,177 @@ std::exception_ptr Loader::stop_all() {
   // This function runs exactly once - it will be called even if all plugins
   // exit by themselves (thus there's nothing to stop).
   log_info("Shutting down. Stopping all plugins.");
+  Readiness::instance().report(kReadinessComponent, false);
+  notify_service_manager("STOPPING=1");
 
   // iterate over all plugin instances
   std::exception_ptr first_eptr;
   for (const ConfigSection* section : config_.sections()) {
+    stop_section(section, first_eptr);
+  }
+
+  return first_eptr;
+}
+
+void Loader::stop_section(const ConfigSection* section,
+                          std::exception_ptr& first_eptr) {
+  PluginInfo& plugin = plugins_.at(section->name);
+  void (*fptr)(PluginFuncEnv*) = plugin.plugin->stop;
 
-    PluginInfo& plugin = plugins_.at(section->name);
-    void (*fptr)(PluginFuncEnv*) = plugin.plugin->stop;
+  assert(plugin_start_env_.count(section));
+  assert(plugin_start_env_[section]->get_config_section() == section);
 
-    assert(plugin_start_env_.count(section));
-    assert(plugin_start_env_[section]->get_config_section() == section);
+  // flag plugin::start() to exit (if one exists and it's running)
+  plugin_start_env_[section]->clear_running();
 
-    // flag plugin::start() to exit (if one exists and it's running)
-    plugin_start_env_[section]->clear_running();
+  if (!fptr) {
+    log_debug("  plugin '%s:%s' doesn't implement stop()",
+              section->name.c_str(), section->key.c_str());
+    return;
+  }
+
+  log_info("  plugin '%s:%s' stopping",
+           section->name.c_str(), section->key.c_str());
+
+  PluginFuncEnv stop_env(nullptr, section);
+  call_plugin_function(&stop_env, first_eptr, fptr, "stop",
+                       section->name.c_str(), section->key.c_str());
+}
+
+void Loader::stop_and_join_section(const ConfigSection* section) {
+  std::exception_ptr eptr;
+  stop_section(section, eptr);  // errors got logged
+
+  auto it = sessions_.find(section);
+  if (it != sessions_.end()) {
+    if (it->second.valid())
+      it->second.get();  // errors got logged
+    sessions_.erase(it);
+  }
+  plugin_start_env_.erase(section);
+  reloaded_sections_.erase(section);
+  applied_options_.erase(make_pair(section->name, section->key));
+}
+
+// the options of the section itself, those of the default section are
+// shared by all sections
+static bool same_options(const ConfigSection::OptionRange& a,
+                         const ConfigSection::OptionMap& b) {
+  return static_cast<size_t>(a.size()) == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin());
+}
+
+void Loader::reload_config() {
+  if (!config_reader_) {
+    log_warning("Reloading the configuration is not supported, ignoring SIGHUP.");
+    return;
+  }
+
+  log_info("Reloading the configuration.");
+
+  std::unique_ptr<LoaderConfig> fresh;
+  try {
+    fresh = config_reader_();
+  } catch (const std::exception& e) {
+    log_error("Reading the configuration failed, keeping the running one: %s", e.what());
+    return;
+  }
+
+  {
+    const auto running = config_.get_default_options();
+    const auto reread = fresh->get_default_options();
+    if (!same_options(running, ConfigSection::OptionMap(reread.begin(), reread.end()))) {
+      log_warning("  changes of the [DEFAULT] section need a restart");
+    }
+  }
 
-    if (!fptr) {
-      log_debug("  plugin '%s:%s' doesn't implement stop()",
-                section->name.c_str(), section->key.c_str());
+  auto section_name = [](const Config::SectionKey& key) {
+    return key.second.empty() ? key.first : key.first + ":" + key.second;
+  };
+
+  // sections that got removed or changed
+  for (const Config::SectionKey& key : config_.section_names()) {
+    ConfigSection& section = config_.get(key.first, key.second);
+
+    ConfigSection::OptionMap running_options;
+    auto applied = applied_options_.find(key);
+    if (applied != applied_options_.end()) {
+      running_options = applied->second;
+    } else {
+      running_options.insert(section.get_options().begin(), section.get_options().end());
+    }
+
+    if (!fresh->has(key.first, key.second)) {
+      log_info("  section [%s] got removed", section_name(key).c_str());
+      stop_and_join_section(&section);
+      config_.remove(key);
+      // it won't report anymore
+      Readiness::instance().forget(section_name(key));
       continue;
     }
 
-    log_info("  plugin '%s:%s' stopping",
-             section->name.c_str(), section->key.c_str());
+    const ConfigSection& fresh_section = fresh->get(key.first, key.second);
+    if (same_options(fresh_section.get_options(), running_options))
+      continue;
 
-    PluginFuncEnv stop_env(nullptr, section);
-    call_plugin_function(&stop_env, first_eptr, fptr, "stop",
-                         section->name.c_str(), section->key.c_str());
+    std::string error;
+    if (!Reconfiguration::instance().validate(fresh_section, error)) {
+      log_error("  section [%s] is invalid, keeping the running one: %s",
+                section_name(key).c_str(), error.c_str());
+      continue;
+    }
 
-  } // for (const ConfigSection* section: config_.sections())
+    if (Reconfiguration::instance().apply(fresh_section)) {
+      log_info("  section [%s] got reconfigured", section_name(key).c_str());
+      applied_options_[key] = ConfigSection::OptionMap(fresh_section.get_options().begin(),
+                                                      fresh_section.get_options().end());
+      continue;
+    }
 
-  return first_eptr;
+    log_info("  section [%s] changed, restarting it", section_name(key).c_str());
+    stop_and_join_section(&section);
+
+    // a fresh section, so none of the old options stay behind
+    config_.remove(key);
+    ConfigSection& restarted = config_.add(key.first, key.second);
+    for (const auto& option : fresh_section.get_options())
+      restarted.set(option.first, option.second);
+
+    reloaded_sections_.insert(&restarted);
+    std::future<std::shared_ptr<PluginFuncEnv>> env = launch_section(&restarted);
+    if (env.valid())
+      plugin_start_env_[&restarted] = env.get();
+  }
+
+  // sections that got added
+  for (const Config::SectionKey& key : fresh->section_names()) {
+    if (config_.has(key.first, key.second))
+      continue;
+
+    if (std::find(order_.begin(), order_.end(), key.first) == order_.end()) {
+      log_warning("  section [%s] needs a restart, plugin '%s' isn't running",
+                  section_name(key).c_str(), key.first.c_str());
+      continue;
+    }
+
+    const ConfigSection& fresh_section = fresh->get(key.first, key.second);
+    std::string error;
+    if (!Reconfiguration::instance().validate(fresh_section, error)) {
+      log_error("  section [%s] is invalid, not starting it: %s",
+                section_name(key).c_str(), error.c_str());
+      continue;
+    }
+
+    log_info("  section [%s] got added", section_name(key).c_str());
+    ConfigSection& added = config_.add(key.first, key.second);
+    for (const auto& option : fresh_section.get_options())
+      added.set(option.first, option.second);
+
+    reloaded_sections_.insert(&added);
+    std::future<std::shared_ptr<PluginFuncEnv>> env = launch_section(&added);
+    if (env.valid())
+      plugin_start_env_[&added] = env.get();
+  }
 }
 
 // returns first exception triggered by deinit()
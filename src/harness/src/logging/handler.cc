@@ -32,10 +32,17 @@
 #include "common.h"
 #include "mysql/harness/config_parser.h"
 #include "mysql/harness/filesystem.h"
+#include "mysql/harness/memory_accounting.h"
 #include "mysql/harness/plugin.h"
 
 #include <algorithm>
+#include <cassert>
+#include <cctype>
 #include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 #include <cstring>
 #include <fstream>
 #include <sstream>
@@ -45,6 +52,9 @@
 #  include <sys/types.h>
 #  include <unistd.h>
 #endif
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
 
 using mysql_harness::Path;
 
@@ -72,33 +82,68 @@ namespace logging {
 Handler::Handler(bool format_messages, LogLevel level) :
     format_messages_(format_messages), level_(level) {}
 
+// Formatting a log record is on the hot path of every thread that logs, so
+// what doesn't change between records is cached per thread: the timestamp
+// (it changes once a second) and the thread id.
+
+// returns the timestamp of 'created' as "YYYY-MM-DD hh:mm:ss"
+static const char* cached_timestamp(time_t created) {
+  thread_local time_t cached_created = -1;
+  thread_local char time_buf[20];  // 19 characters + '\0'
+
+  if (created != cached_created) {
+    struct tm created_tm;
+#ifdef _WIN32
+    localtime_s(&created_tm, &created);
+#else
+    localtime_r(&created, &created_tm);
+#endif
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &created_tm);
+    cached_created = created;
+  }
+
+  return time_buf;
+}
+
+// returns the id of the calling thread in a printable format
+static const std::string& cached_thread_id() {
+  thread_local const std::string thread_id = [] {
+    std::stringstream ss;
+    ss << std::hex << std::this_thread::get_id();
+    return ss.str();
+  }();
+
+  return thread_id;
+}
+
 // Log format is:
 // <date> <time> <plugin> <level> [<thread>] <message>
 
-std::string Handler::format(const Record& record) const {
-  // Bypass formatting if disabled
-  if (!format_messages_)
-    return record.message;
+void Handler::format(const Record& record, std::string& out) const {
+  out.clear();
 
-  // Format the time (19 characters)
-  char time_buf[20];
-  strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S",
-           localtime(&record.created));
+  // Bypass formatting if disabled
+  if (!format_messages_) {
+    out.append(record.message);
+    return;
+  }
 
-  // Get the thread ID in a printable format
-  std::stringstream ss;
-  ss << std::hex << std::this_thread::get_id();
+  const char* level = level_str[static_cast<int>(record.level)];
+  const std::string& thread_id = cached_thread_id();
 
-  // We ignore the return value from snprintf, which means that the
-  // output is truncated if the total length exceeds the buffer size.
-  char buffer[512];
-  snprintf(buffer, sizeof(buffer), "%-19s %s %s [%s] %s",
-           time_buf, record.domain.c_str(),
-           level_str[static_cast<int>(record.level)],
-           ss.str().c_str(), record.message.c_str());
+  out.reserve(19 + 1 + record.domain.size() + 1 + strlen(level) + 2 +
+              thread_id.size() + 2 + record.message.size());
+  out.append(cached_timestamp(record.created));
+  out.append(1, ' ').append(record.domain);
+  out.append(1, ' ').append(level);
+  out.append(" [").append(thread_id).append("] ");
+  out.append(record.message);
+}
 
-  // Note: This copies the buffer into an std::string
-  return buffer;
+std::string Handler::format(const Record& record) const {
+  std::string out;
+  format(record, out);
+  return out;
 }
 
 void Handler::handle(const Record& record) {
@@ -117,19 +162,23 @@ StreamHandler::StreamHandler(std::ostream& out,
     : Handler(format_messages, level), stream_(out) {}
 
 void StreamHandler::do_log(const Record& record) {
+  // reused across calls, so that formatting doesn't allocate once the buffer
+  // has grown to the size of a typical message
+  thread_local std::string buffer;
+  format(record, buffer);
+
   std::lock_guard<std::mutex> lock(stream_mutex_);
-  stream_ << format(record) << std::endl;
+  before_write(buffer.size() + 1);
+  stream_ << buffer << std::endl;
 }
 
 ////////////////////////////////////////////////////////////////
 // class FileHandler
 
-FileHandler::FileHandler(const Path& path,
-                         bool format_messages,
-                         LogLevel level)
-    : StreamHandler(fstream_, format_messages, level),
-      fstream_(path.str(), ofstream::app) {
-  if (fstream_.fail()) {
+// throws std::system_error if opening the log file failed
+static void throw_if_open_failed(const std::ofstream& fstream,
+                                 const Path& path) {
+  if (fstream.fail()) {
     // get the last-error early as with VS2015 it has been seen
     // that something in std::system_error() called SetLastError(0)
     auto last_error =
@@ -148,10 +197,478 @@ FileHandler::FileHandler(const Path& path,
   }
 }
 
+FileHandler::FileHandler(const Path& path,
+                         bool format_messages,
+                         LogLevel level,
+                         const LogRotation& rotation)
+    : StreamHandler(fstream_, format_messages, level),
+      path_(path.str()), rotation_(rotation),
+      fstream_(path.str(), ofstream::app) {
+  throw_if_open_failed(fstream_, path);
+
+  if (rotation_.enabled()) {
+    // appending, the file may already have content
+    fstream_.seekp(0, std::ios::end);
+    const std::streamoff size = fstream_.tellp();
+    file_size_ = size > 0 ? static_cast<uint64_t>(size) : 0;
+    opened_at_ = std::chrono::steady_clock::now();
+
+    housekeeper_ = std::thread(&FileHandler::housekeeping_loop, this);
+  }
+}
+
 // satisfy ODR
 constexpr const char* FileHandler::kDefaultName;
 
-FileHandler::~FileHandler() {}
+FileHandler::~FileHandler() {
+  if (housekeeper_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(housekeeping_mtx_);
+      stopping_ = true;
+    }
+    housekeeping_cond_.notify_one();
+    housekeeper_.join();
+  }
+}
+
+void FileHandler::before_write(size_t size) {
+  if (!rotation_.enabled())
+    return;
+
+  // never rotate an empty file, not even if a single record is larger than
+  // max_size
+  if (file_size_ > 0) {
+    const bool too_large = rotation_.max_size > 0 &&
+                           file_size_ + size > rotation_.max_size;
+    const bool too_old = rotation_.max_age.count() > 0 &&
+                         std::chrono::steady_clock::now() - opened_at_ >= rotation_.max_age;
+    if (too_large || too_old)
+      rotate();
+  }
+
+  file_size_ += size;
+}
+
+// name of a rotated file, before it is compressed
+static std::string make_rotated_filename(const std::string& path) {
+  const time_t now = time(nullptr);
+  struct tm now_tm;
+#ifdef _WIN32
+  localtime_s(&now_tm, &now);
+#else
+  localtime_r(&now, &now_tm);
+#endif
+  char time_buf[16];
+  strftime(time_buf, sizeof(time_buf), "%Y%m%d-%H%M%S", &now_tm);
+
+  const std::string base = path + "." + time_buf;
+  std::string filename = base;
+  // more than one rotation per second
+  for (unsigned n = 1; Path(filename).exists() || Path(filename + ".gz").exists(); ++n)
+    filename = base + "." + std::to_string(n);
+
+  return filename;
+}
+
+void FileHandler::rotate() {
+  // only renaming happens here, compressing and pruning is left to the
+  // housekeeper to not stall the threads that log
+  fstream_.close();
+  const std::string rotated_filename = make_rotated_filename(path_);
+  const bool renamed = std::rename(path_.c_str(), rotated_filename.c_str()) == 0;
+
+  // if renaming failed, continue with the current file and try again once it
+  // reached the limits once more
+  fstream_.clear();
+  fstream_.open(path_, ofstream::app);
+  file_size_ = 0;
+  opened_at_ = std::chrono::steady_clock::now();
+
+  if (renamed) {
+    {
+      std::lock_guard<std::mutex> lock(housekeeping_mtx_);
+      rotated_files_.push_back(rotated_filename);
+    }
+    housekeeping_cond_.notify_one();
+  }
+}
+
+void FileHandler::housekeeping_loop() {
+  for (;;) {
+    std::vector<std::string> rotated_files;
+    {
+      std::unique_lock<std::mutex> lock(housekeeping_mtx_);
+      housekeeping_cond_.wait(lock, [this] {
+        return stopping_ || !rotated_files_.empty();
+      });
+      if (rotated_files_.empty())
+        return;  // stopping, and nothing left to do
+      rotated_files.swap(rotated_files_);
+    }
+
+    for (const std::string& filename : rotated_files) {
+      if (rotation_.compress)
+        compress_rotated_file(filename);
+    }
+    if (rotation_.keep > 0)
+      prune_rotated_files();
+  }
+}
+
+void FileHandler::compress_rotated_file(const std::string& filename) {
+#ifdef HAVE_ZLIB
+  // written to a temporary file first, so that a crash doesn't leave a
+  // truncated .gz file behind
+  const std::string tmp_filename = filename + ".gz.tmp";
+  std::ifstream in(filename, std::ios::binary);
+  gzFile out = gzopen(tmp_filename.c_str(), "wb");
+  if (!in || out == nullptr) {
+    if (out != nullptr) gzclose(out);
+    return;  // leave the file uncompressed
+  }
+
+  bool failed = false;
+  char buf[64 * 1024];
+  while (!failed && in) {
+    in.read(buf, sizeof(buf));
+    const std::streamsize n = in.gcount();
+    if (n > 0 &&
+        gzwrite(out, buf, static_cast<unsigned>(n)) != static_cast<int>(n))
+      failed = true;
+  }
+  if (gzclose(out) != Z_OK || in.bad())
+    failed = true;
+  in.close();
+
+  if (failed || std::rename(tmp_filename.c_str(), (filename + ".gz").c_str()) != 0) {
+    std::remove(tmp_filename.c_str());
+    return;
+  }
+  std::remove(filename.c_str());
+#else
+  // built without zlib, rotated files stay as they are
+  (void)filename;
+#endif
+}
+
+// position of the last directory separator in path
+//
+// Path::basename() and Path::dirname() don't handle paths like "./router.log"
+static std::string::size_type last_separator(const std::string& path) {
+#ifdef _WIN32
+  return path.find_last_of("\\/");
+#else
+  return path.find_last_of('/');
+#endif
+}
+
+void FileHandler::prune_rotated_files() {
+  const std::string::size_type sep = last_separator(path_);
+  const std::string dirname = sep == std::string::npos ? "." :
+                              sep == 0 ? path_.substr(0, 1) : path_.substr(0, sep);
+  const std::string prefix = path_.substr(sep == std::string::npos ? 0 : sep + 1) + ".";
+
+  // rotated files are named after the time of their rotation, plus a counter
+  // for rotations within the same second; their (time, counter) sorts them
+  // by age
+  struct RotatedFile {
+    std::string time;
+    unsigned long counter;
+    std::string path;
+
+    bool operator<(const RotatedFile& other) const {
+      return time < other.time || (time == other.time && counter < other.counter);
+    }
+  };
+  std::vector<RotatedFile> rotated;
+
+  Directory dir(dirname);
+  for (auto it = dir.glob(prefix + "*"); it != dir.end(); ++it) {
+    const std::string entry = (*it).str();
+    std::string name = entry.substr(last_separator(entry) + 1);
+    if (name.size() <= prefix.size() ||
+        !isdigit(static_cast<unsigned char>(name[prefix.size()])))
+      continue;  // not a rotated file
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0)
+      continue;
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0)
+      name.resize(name.size() - 3);
+
+    name.erase(0, prefix.size());
+    const std::string::size_type dot = name.find('.');
+    const unsigned long counter = dot == std::string::npos
+                                      ? 0 : std::strtoul(name.c_str() + dot + 1, nullptr, 10);
+    if (dot != std::string::npos)
+      name.resize(dot);
+
+    rotated.push_back(RotatedFile{name, counter, entry});
+  }
+
+  if (rotated.size() <= rotation_.keep)
+    return;
+
+  std::sort(rotated.begin(), rotated.end());
+  for (size_t i = 0; i < rotated.size() - rotation_.keep; ++i)
+    std::remove(rotated[i].path.c_str());
+}
+
+////////////////////////////////////////////////////////////////
+// class JsonStreamHandler
+
+// satisfy ODR
+constexpr const char* JsonStreamHandler::kDefaultName;
+
+// appends 'in' as a quoted JSON string
+static void append_json_string(std::string& out, const char* in, size_t len) {
+  static const char hex_digits[] = "0123456789abcdef";
+
+  out.append(1, '"');
+  for (size_t i = 0; i < len; ++i) {
+    const unsigned char c = static_cast<unsigned char>(in[i]);
+    switch (c) {
+      case '"': out.append("\\\""); break;
+      case '\\': out.append("\\\\"); break;
+      case '\n': out.append("\\n"); break;
+      case '\r': out.append("\\r"); break;
+      case '\t': out.append("\\t"); break;
+      default:
+        if (c < 0x20) {
+          out.append("\\u00");
+          out.append(1, hex_digits[c >> 4]);
+          out.append(1, hex_digits[c & 0xf]);
+        } else {
+          out.append(1, static_cast<char>(c));
+        }
+    }
+  }
+  out.append(1, '"');
+}
+
+static void append_json_string(std::string& out, const std::string& in) {
+  append_json_string(out, in.data(), in.size());
+}
+
+static void append_json_key(std::string& out, const char* key) {
+  out.append(1, ',');
+  append_json_string(out, key, strlen(key));
+  out.append(1, ':');
+}
+
+// appends the fields of 'context', outermost context first
+static void append_json_fields(std::string& out, const LogContext* context) {
+  if (context == nullptr)
+    return;
+
+  append_json_fields(out, context->parent());
+  for (const LogContext::Field& field : context->fields()) {
+    append_json_key(out, field.key);
+    if (field.is_number)
+      out.append(std::to_string(field.num));
+    else
+      append_json_string(out, field.str);
+  }
+}
+
+JsonStreamHandler::JsonStreamHandler(std::ostream& out, LogLevel level)
+    : StreamHandler(out, false, level) {}
+
+/*static*/
+void JsonStreamHandler::format_json(const Record& record, std::string& out) {
+  out.assign("{\"time\":\"");
+  out.append(cached_timestamp(record.created));
+  out.append("\",\"level\":\"");
+  out.append(level_str[static_cast<int>(record.level)]);
+  out.append(1, '"');
+  append_json_key(out, "domain");
+  append_json_string(out, record.domain);
+  append_json_key(out, "thread");
+  append_json_string(out, cached_thread_id());
+  append_json_key(out, "message");
+  append_json_string(out, record.message);
+  append_json_fields(out, LogContext::current());
+  out.append(1, '}');
+}
+
+void JsonStreamHandler::do_log(const Record& record) {
+  thread_local std::string buffer;
+  format_json(record, buffer);
+
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  before_write(buffer.size() + 1);
+  stream_ << buffer << std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+// class JsonFileHandler
+
+// satisfy ODR
+constexpr const char* JsonFileHandler::kDefaultName;
+
+JsonFileHandler::JsonFileHandler(const Path& path, LogLevel level)
+    : JsonStreamHandler(fstream_, level),
+      fstream_(path.str(), ofstream::app) {
+  throw_if_open_failed(fstream_, path);
+}
+
+JsonFileHandler::~JsonFileHandler() {}
+
+////////////////////////////////////////////////////////////////
+// class AsyncHandler
+
+// satisfy ODR
+constexpr size_t AsyncHandler::kDefaultCapacity;
+constexpr std::chrono::milliseconds AsyncHandler::kDefaultFlushInterval;
+
+AsyncHandler::AsyncHandler(bool format_messages,
+                           LogLevel level,
+                           OverflowPolicy policy,
+                           size_t capacity,
+                           std::chrono::milliseconds flush_interval)
+    : Handler(format_messages, level), policy_(policy),
+      flush_interval_(flush_interval), ring_(capacity) {}
+
+AsyncHandler::~AsyncHandler() {
+  // derived classes stopped the writer already, their write() is gone
+  assert(!writer_.joinable());
+}
+
+void AsyncHandler::start() {
+  if (writer_.joinable())
+    return;
+
+  stopping_ = false;
+  writer_ = std::thread(&AsyncHandler::writer_loop, this);
+}
+
+void AsyncHandler::stop() {
+  if (!writer_.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(wakeup_mtx_);
+    stopping_ = true;
+  }
+  wakeup_cond_.notify_one();
+  writer_.join();
+}
+
+void AsyncHandler::do_log(const Record& record) {
+  // the record is moved into the ring, so there is no buffer to reuse here
+  Entry entry{record.level, format(record)};
+
+  // accounted before the push, the writer may pop it right away
+  const size_t bytes = entry.msg.size();
+  MemoryAccounting::allocated(MemoryTag::kLogging, bytes);
+
+  while (!ring_.try_push(std::move(entry))) {
+    if (policy_ == OverflowPolicy::kDrop) {
+      MemoryAccounting::freed(MemoryTag::kLogging, bytes);
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    wakeup_cond_.notify_one();
+    std::this_thread::yield();
+  }
+
+  // don't wait for the flush interval if the ring fills up quickly
+  if (ring_.size() >= ring_.capacity() / 2)
+    wakeup_cond_.notify_one();
+}
+
+void AsyncHandler::writer_loop() {
+  Entry entry;
+  for (;;) {
+    const bool stopping = stopping_.load();
+
+    bool written = false;
+    while (ring_.try_pop(&entry)) {
+      MemoryAccounting::freed(MemoryTag::kLogging, entry.msg.size());
+      write(entry.level, entry.msg);
+      written = true;
+    }
+
+    const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+      std::string note = format(Record{
+          LogLevel::kWarning, getpid(), time(nullptr), "logger",
+          std::to_string(dropped - reported_dropped_) +
+              " log message(s) dropped, log writer could not keep up"});
+      write(LogLevel::kWarning, note);
+      reported_dropped_ = dropped;
+      written = true;
+    }
+
+    if (written)
+      flush();
+
+    // records pushed before stopping_ was set are all written by now
+    if (stopping)
+      return;
+
+    std::unique_lock<std::mutex> lock(wakeup_mtx_);
+    wakeup_cond_.wait_for(lock, flush_interval_, [this] {
+      return stopping_.load() || !ring_.empty();
+    });
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// class AsyncStreamHandler
+
+// satisfy ODR
+constexpr const char* AsyncStreamHandler::kDefaultName;
+
+AsyncStreamHandler::AsyncStreamHandler(std::ostream& out,
+                                       bool format_messages,
+                                       LogLevel level,
+                                       OverflowPolicy policy,
+                                       size_t capacity,
+                                       std::chrono::milliseconds flush_interval)
+    : AsyncHandler(format_messages, level, policy, capacity, flush_interval),
+      stream_(out) {
+  start();
+}
+
+AsyncStreamHandler::~AsyncStreamHandler() {
+  stop();
+}
+
+void AsyncStreamHandler::write(LogLevel, const std::string& msg) {
+  stream_ << msg << "\n";
+}
+
+void AsyncStreamHandler::flush() {
+  stream_.flush();
+}
+
+////////////////////////////////////////////////////////////////
+// class AsyncFileHandler
+
+// satisfy ODR
+constexpr const char* AsyncFileHandler::kDefaultName;
+
+AsyncFileHandler::AsyncFileHandler(const Path& path,
+                                   bool format_messages,
+                                   LogLevel level,
+                                   OverflowPolicy policy,
+                                   size_t capacity,
+                                   std::chrono::milliseconds flush_interval)
+    : AsyncStreamHandler(fstream_, format_messages, level, policy, capacity,
+                         flush_interval),
+      fstream_(path.str(), ofstream::app) {
+  try {
+    throw_if_open_failed(fstream_, path);
+  } catch (...) {
+    // the writer thread must not outlive fstream_
+    stop();
+    throw;
+  }
+}
+
+AsyncFileHandler::~AsyncFileHandler() {
+  // the writer thread must be gone before fstream_ is destroyed
+  stop();
+}
 
 } // namespace logging
 
@@ -67,6 +67,21 @@ void Logger::handle(const Record& record) {
   }
 }
 
+////////////////////////////////////////////////////////////////
+// class ResolvedLogger
+
+void ResolvedLogger::handle(const Record& record) const {
+  if (record.level <= level_) {
+    for (const std::weak_ptr<Handler>& weak_handler : handlers_) {
+      // handler may have been removed from the registry since the snapshot
+      // was taken, skip it like Logger::handle() does
+      std::shared_ptr<Handler> handler = weak_handler.lock();
+      if (handler && record.level <= handler->get_level())
+        handler->handle(record);
+    }
+  }
+}
+
 } // namespace logging
 
 } // namespace mysql_harness
@@ -26,11 +26,70 @@
 #include "mysql/harness/logging/registry.h"
 #include "dim.h"
 
+#include <algorithm>
+
 namespace mysql_harness {
 
 namespace logging {
 
+static thread_local const LogContext* g_current_log_context = nullptr;
+
+LogContext::LogContext() : parent_(g_current_log_context) {
+  g_current_log_context = this;
+}
+
+LogContext::~LogContext() {
+  g_current_log_context = parent_;
+}
+
+LogContext& LogContext::add(const char* key, std::string value) {
+  fields_.push_back(Field{key, false, std::move(value), 0});
+  return *this;
+}
+
+LogContext& LogContext::add(const char* key, long long value) {
+  fields_.push_back(Field{key, true, std::string(), value});
+  return *this;
+}
+
+/*static*/
+const LogContext* LogContext::current() {
+  return g_current_log_context;
+}
+
+// satisfy ODR
+constexpr unsigned LogRateLimiter::kDefaultBurst;
+constexpr std::chrono::milliseconds LogRateLimiter::kDefaultInterval;
+
+LogRateLimiter::LogRateLimiter(unsigned burst,
+                               std::chrono::milliseconds interval)
+    : interval_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          interval).count()),
+      tolerance_ns_(interval_ns_ * (burst > 0 ? burst - 1 : 0)) {}
+
+bool LogRateLimiter::allow(uint64_t& suppressed) {
+  const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+
+  // each message moves the "bucket is full again" time one interval into the
+  // future; more than 'burst' intervals ahead means the bucket is empty
+  int64_t full_at_ns = full_at_ns_.load(std::memory_order_relaxed);
+  for (;;) {
+    const int64_t base_ns = std::max(full_at_ns, now_ns);
+    if (base_ns - now_ns > tolerance_ns_) {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (full_at_ns_.compare_exchange_weak(full_at_ns, base_ns + interval_ns_,
+                                          std::memory_order_relaxed))
+      break;
+  }
+
+  suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
 }  // namespace logging
 
 }  // namespace mysql_harness
-// EMPTY NOW
@@ -32,6 +32,7 @@
 #include "mysql/harness/logging/handler.h"
 #include "mysql/harness/logging/logging.h"
 #include "mysql/harness/logging/registry.h"
+#include "mysql/harness/tracepoints.h"
 
 #include "dim.h"
 #include "utilities.h"
@@ -42,12 +43,15 @@
 #include <iostream>
 #include <sstream>
 #include <cstdarg>
+#include <memory>
+#include <vector>
 
 
 using mysql_harness::Path;
 using mysql_harness::logging::LogLevel;
 using mysql_harness::logging::Logger;
 using mysql_harness::logging::Record;
+using mysql_harness::logging::ResolvedLogger;
 using mysql_harness::serial_comma;
 
 // TODO one day we'll improve this and move it to a common spot
@@ -82,6 +86,9 @@ void Registry::create_logger(const std::string& name, LogLevel level) {
   auto result = loggers_.emplace(name, Logger(*this, level));
   if (result.second == false)
     throw std::logic_error("Duplicate logger '" + name + "'");
+
+  update_max_log_level();
+  bump_generation();
 }
 
 // throws std::logic_error
@@ -89,6 +96,9 @@ void Registry::remove_logger(const std::string& name) {
   std::lock_guard<std::mutex> lock(mtx_);
   if (loggers_.erase(name) == 0)
     throw std::logic_error("Removing non-existant logger '" + name + "'");
+
+  update_max_log_level();
+  bump_generation();
 }
 
 // throws std::logic_error
@@ -122,6 +132,47 @@ void Registry::update_logger(const std::string& name, const Logger& logger) {
       throw std::logic_error(std::string("Attaching unknown handler '") + s + "'");
 
   it->second = logger;
+
+  update_max_log_level();
+  bump_generation();
+}
+
+void Registry::update_max_log_level() {
+  int max_level = static_cast<int>(LogLevel::kFatal);
+  for (const auto& pair : loggers_)
+    max_level = std::max(max_level, static_cast<int>(pair.second.get_level()));
+
+  max_log_level_.store(max_level, std::memory_order_relaxed);
+}
+
+/*static*/
+uint64_t Registry::next_generation() {
+  static std::atomic<uint64_t> last_generation{0};
+  return last_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void Registry::bump_generation() {
+  generation_.store(next_generation(), std::memory_order_release);
+}
+
+// throws std::logic_error
+std::shared_ptr<const ResolvedLogger> Registry::get_resolved_logger(
+    const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  auto it = loggers_.find(name);
+  if (it == loggers_.end())
+    throw std::logic_error("Accessing non-existant logger '" + name + "'");
+
+  const Logger& logger = it->second;
+  std::vector<std::weak_ptr<Handler>> handlers;
+  for (const std::string& handler_name : logger.get_handler_names()) {
+    auto handler_it = handlers_.find(handler_name);
+    if (handler_it != handlers_.end())
+      handlers.emplace_back(handler_it->second);
+  }
+
+  return std::make_shared<const ResolvedLogger>(logger.get_level(), std::move(handlers));
 }
 
 std::set<std::string> Registry::get_logger_names() const {
@@ -147,6 +198,8 @@ void Registry::add_handler(std::string name, std::shared_ptr<Handler> handler) {
   auto result = handlers_.emplace(name, handler);
   if (!result.second)
     throw std::logic_error("Duplicate handler '" + name + "'");
+
+  bump_generation();
 }
 
 // throws std::logic_error
@@ -162,6 +215,8 @@ void Registry::remove_handler(std::string name) {
     pair.second.detach_handler(name, false);
 
   handlers_.erase(it);
+
+  bump_generation();
 }
 
 // throws std::logic_error
@@ -226,7 +281,8 @@ std::ostream *get_default_logger_stream() {
 void create_main_logfile_handler(Registry& registry,
                                  const std::string& program,
                                  const std::string& logging_folder,
-                                 bool format_messages) {
+                                 bool format_messages,
+                                 const LogRotation& rotation) {
   // Register the console as the handler if the logging folder is
   // undefined. Otherwise, register a file handler.
   if (logging_folder.empty()) {
@@ -239,7 +295,8 @@ void create_main_logfile_handler(Registry& registry,
 
     // throws std::runtime_error on failure to open file
     registry.add_handler(kMainLogHandler,
-                         std::make_shared<FileHandler>(log_file, format_messages));
+                         std::make_shared<FileHandler>(log_file, format_messages,
+                                                       LogLevel::kNotSet, rotation));
 
     attach_handler_to_all_loggers(registry, kMainLogHandler);
   }
@@ -329,6 +386,11 @@ void set_log_level_for_all_loggers(LogLevel level) {
   set_log_level_for_all_loggers(registry, level);
 }
 
+bool log_level_is_handled(LogLevel level) {
+  mysql_harness::logging::Registry& registry = mysql_harness::DIM::instance().get_LoggingRegistry();
+  return registry.is_handled(level);
+}
+
 
 
 }  // namespace logging
@@ -340,6 +402,43 @@ void set_log_level_for_all_loggers(LogLevel level) {
 ////////////////////////////////////////////////////////////////
 // Logging functions for use by plugins.
 
+// Loggers looked up by log_message() in the calling thread. Valid as long as
+// the registry and its generation don't change, which spares log_message()
+// from taking the registry mutex for every message.
+struct ThreadLoggerCache {
+  const mysql_harness::logging::Registry* registry{nullptr};
+  uint64_t generation{0};
+  std::vector<std::pair<std::string, std::shared_ptr<const ResolvedLogger>>> loggers;
+};
+
+// returns nullptr if no logger is registered for the module
+static std::shared_ptr<const ResolvedLogger> get_cached_logger(
+    const mysql_harness::logging::Registry& registry, const char* module) {
+  thread_local ThreadLoggerCache cache;
+
+  const uint64_t generation = registry.generation();
+  if (cache.registry != &registry || cache.generation != generation) {
+    cache.loggers.clear();
+    cache.registry = &registry;
+    cache.generation = generation;
+  }
+
+  for (const auto& entry : cache.loggers) {
+    if (entry.first == module)
+      return entry.second;
+  }
+
+  std::shared_ptr<const ResolvedLogger> logger;
+  try {
+    logger = registry.get_resolved_logger(module);
+  } catch (std::logic_error&) {
+    return nullptr;
+  }
+
+  cache.loggers.emplace_back(module, logger);
+  return logger;
+}
+
 // We want to hide log_message(), because instead we want plugins to call
 // log_error(), log_warning(), etc. However, those functions must be inline
 // and are therefore defined in the header file - which means log_message()
@@ -359,32 +458,32 @@ extern "C" void LOGGER_API log_message(LogLevel level, const char* module, const
 extern "C" void log_message(LogLevel level, const char* module, const char* fmt, va_list ap) {
   harness_assert(level <= LogLevel::kDebug);
 
-  // get timestamp
-  time_t now;
-  time(&now);
-
   mysql_harness::logging::Registry& registry = mysql_harness::DIM::instance().
                                                get_LoggingRegistry();
   harness_assert(registry.is_ready());
 
+  // bail out early if no logger is interested in this level, so that we
+  // don't pay for copying the logger and formatting the message for nothing
+  if (!registry.is_handled(level))
+    return;
+
+  // get timestamp
+  time_t now;
+  time(&now);
+
   // Find the logger for the module
-  // NOTE that we copy the logger. Even if some other thread removes this
-  //      logger from registry, our call will still be valid. As for the
-  //      case of handlers getting removed in the meantime, Logger::handle()
-  //      handles this properly.
-  Logger logger;
-  try {
-    logger = registry.get_logger(module);
-  } catch (std::logic_error&) {
+  // NOTE that we get an immutable snapshot of the logger. Even if some other
+  //      thread removes this logger from registry, our call will still be
+  //      valid. As for the case of handlers getting removed in the meantime,
+  //      ResolvedLogger::handle() handles this properly.
+  std::shared_ptr<const ResolvedLogger> logger = get_cached_logger(registry, module);
+  if (!logger) {
     // Logger is not registered for this module (log domain), so log as main
     // application domain instead (which should always be available)
     using mysql_harness::logging::g_main_app_log_domain;
     harness_assert(!g_main_app_log_domain.empty());
-    try {
-      logger = registry.get_logger(g_main_app_log_domain);
-    } catch (std::logic_error&) {
-      harness_assert(0);
-    }
+    logger = get_cached_logger(registry, g_main_app_log_domain.c_str());
+    harness_assert(logger);
 
     // Complain that we're logging this elsewhere
     char msg[mysql_harness::logging::kLogMessageMaxSize];
@@ -392,7 +491,7 @@ extern "C" void log_message(LogLevel level, const char* module, const char* fmt,
              "Module '%s' not registered with logger - "
              "logging the following message as '%s' instead",
              module, g_main_app_log_domain.c_str());
-    logger.handle({LogLevel::kError, getpid(), now, g_main_app_log_domain, msg});
+    logger->handle({LogLevel::kError, getpid(), now, g_main_app_log_domain, msg});
 
     // And switch log domain to main application domain for the original
     // log message
@@ -405,10 +504,11 @@ extern "C" void log_message(LogLevel level, const char* module, const char* fmt,
 
   // Build the record for the handler.
   Record record{level, getpid(), now, module, message};
+  MYSQL_ROUTER_TRACE(log__record, static_cast<int>(level), module, message);
 
   // Pass the record to the correct logger. The record should be
   // passed to only one logger since otherwise the handler can get
   // multiple calls, resulting in multiple log records.
-  logger.handle(record);
+  logger->handle(record);
 }
 
@@ -0,0 +1,248 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/loop_monitor.h"
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define HAVE_STACK_DUMP
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <execinfo.h>
+#endif
+
+namespace mysql_harness {
+
+namespace {
+
+#ifdef HAVE_STACK_DUMP
+// ignored by default and hardly used otherwise, a stray one does no harm
+constexpr int kStackDumpSignal = SIGURG;
+
+constexpr int kMaxDepth = 64;
+
+enum DumpState : int {
+  kDumpIdle,
+  kDumpRequested,
+  kDumpRecorded,
+};
+
+// written by the signal handler, which can't take locks or allocate
+void* g_frames[kMaxDepth];
+int g_depth{0};
+std::atomic<int> g_dump_state{kDumpIdle};
+
+void on_stack_dump_signal(int) {
+  const int saved_errno = errno;
+
+  int expected = kDumpRequested;
+  if (g_dump_state.load() == kDumpRequested) {
+    g_depth = backtrace(g_frames, kMaxDepth);
+    g_dump_state.compare_exchange_strong(expected, kDumpRecorded);
+  }
+
+  errno = saved_errno;
+}
+
+bool install_stack_dump_handler() {
+  static const bool installed = []() {
+    // the first call of backtrace() loads the unwinder, which isn't safe in
+    // the signal handler
+    void* frames[1];
+    backtrace(frames, 1);
+
+    struct sigaction action {};
+    action.sa_handler = on_stack_dump_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(kStackDumpSignal, &action, nullptr) == 0;
+  }();
+
+  return installed;
+}
+#endif
+
+}  // namespace
+
+LoopMonitor& LoopMonitor::instance() {
+  static LoopMonitor instance;
+
+  return instance;
+}
+
+LoopMonitor::LoopId LoopMonitor::add(const std::string& name, Post post) {
+#ifdef HAVE_STACK_DUMP
+  // the loader blocks all signals in the threads it starts
+  if (install_stack_dump_handler()) {
+    sigset_t ss;
+    sigemptyset(&ss);
+    sigaddset(&ss, kStackDumpSignal);
+    pthread_sigmask(SIG_UNBLOCK, &ss, nullptr);
+  }
+#endif
+
+  Loop loop;
+  loop.name = name;
+  loop.post = std::move(post);
+#ifndef _WIN32
+  loop.thread = pthread_self();
+#endif
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  const LoopId id = next_id_++;
+  loops_.emplace(id, std::move(loop));
+
+  return id;
+}
+
+void LoopMonitor::remove(LoopId id) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  loops_.erase(id);
+}
+
+void LoopMonitor::collect(Loop& loop) {
+  if (loop.heartbeat && loop.heartbeat->ran.load(std::memory_order_acquire)) {
+    loop.last_lag = loop.heartbeat->lag;
+    loop.max_lag = std::max(loop.max_lag, loop.last_lag);
+    ++loop.heartbeats;
+    loop.heartbeat.reset();
+  }
+}
+
+void LoopMonitor::post_heartbeats() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto& it : loops_) {
+    Loop& loop = it.second;
+    collect(loop);
+    if (loop.heartbeat) continue;
+
+    std::shared_ptr<Heartbeat> heartbeat = std::make_shared<Heartbeat>();
+    heartbeat->posted = clock_type::now();
+    loop.heartbeat = heartbeat;
+    loop.post([heartbeat]() {
+      heartbeat->lag = std::chrono::duration_cast<std::chrono::microseconds>(
+          clock_type::now() - heartbeat->posted);
+      heartbeat->ran.store(true, std::memory_order_release);
+    });
+  }
+}
+
+std::vector<LoopMonitor::LoopState> LoopMonitor::get_loops() {
+  const auto now = clock_type::now();
+
+  std::vector<LoopState> states;
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto& it : loops_) {
+    Loop& loop = it.second;
+    collect(loop);
+
+    LoopState state;
+    state.id = it.first;
+    state.name = loop.name;
+    state.last_lag = loop.last_lag;
+    state.max_lag = loop.max_lag;
+    state.heartbeats = loop.heartbeats;
+    if (loop.heartbeat) {
+      // never 0, which tells that the heartbeat ran
+      state.pending = std::max(std::chrono::microseconds(1),
+          std::chrono::duration_cast<std::chrono::microseconds>(now - loop.heartbeat->posted));
+    }
+    states.push_back(state);
+  }
+
+  return states;
+}
+
+bool LoopMonitor::is_stack_dump_supported() noexcept {
+#ifdef HAVE_STACK_DUMP
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string LoopMonitor::dump_stack(LoopId id, std::chrono::milliseconds timeout) {
+#ifdef HAVE_STACK_DUMP
+  if (!install_stack_dump_handler()) return "";
+
+  std::lock_guard<std::mutex> dump_lock(dump_mtx_);
+
+  // a thread that didn't answer the previous dump may still write the
+  // buffer, wait for it to be done with it
+  int expected = kDumpRecorded;
+  g_dump_state.compare_exchange_strong(expected, kDumpIdle);
+  expected = kDumpIdle;
+  if (!g_dump_state.compare_exchange_strong(expected, kDumpRequested)) return "";
+
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = loops_.find(id);
+    if (it == loops_.end() || pthread_kill(it->second.thread, kStackDumpSignal) != 0) {
+      g_dump_state.store(kDumpIdle);
+      return "";
+    }
+  }
+
+  const auto deadline = clock_type::now() + timeout;
+  while (g_dump_state.load() != kDumpRecorded) {
+    if (clock_type::now() >= deadline) return "";
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // leave out the frames of the signal handler
+  constexpr int kSkippedFrames = 2;
+  std::ostringstream os;
+  if (g_depth > kSkippedFrames) {
+    char** symbols = backtrace_symbols(g_frames + kSkippedFrames, g_depth - kSkippedFrames);
+    for (int ndx = 0; ndx < g_depth - kSkippedFrames; ++ndx) {
+      if (symbols != nullptr) {
+        os << symbols[ndx] << "\n";
+      } else {
+        os << g_frames[ndx + kSkippedFrames] << "\n";
+      }
+    }
+    free(symbols);
+  }
+  g_dump_state.store(kDumpIdle);
+
+  return os.str();
+#else
+  (void)id;
+  (void)timeout;
+
+  return "";
+#endif
+}
+
+void LoopMonitor::clear() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  loops_.clear();
+}
+
+}  // namespace mysql_harness
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/memory_accounting.h"
+
+#include <atomic>
+
+namespace mysql_harness {
+
+constexpr size_t MemoryAccounting::kTags;
+
+namespace {
+
+// a cache line per tag, subsystems don't share them
+struct alignas(64) Counters {
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> objects{0};
+};
+
+Counters g_counters[MemoryAccounting::kTags];
+
+Counters& counters(MemoryTag tag) noexcept {
+  return g_counters[static_cast<size_t>(tag)];
+}
+
+}  // namespace
+
+void MemoryAccounting::allocated(MemoryTag tag, size_t bytes, size_t objects) noexcept {
+  Counters& c = counters(tag);
+  c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  c.objects.fetch_add(objects, std::memory_order_relaxed);
+}
+
+void MemoryAccounting::freed(MemoryTag tag, size_t bytes, size_t objects) noexcept {
+  Counters& c = counters(tag);
+  c.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+  c.objects.fetch_sub(objects, std::memory_order_relaxed);
+}
+
+MemoryAccounting::Usage MemoryAccounting::get_usage(MemoryTag tag) noexcept {
+  const Counters& c = counters(tag);
+  return Usage{c.bytes.load(std::memory_order_relaxed),
+               c.objects.load(std::memory_order_relaxed)};
+}
+
+const char* MemoryAccounting::tag_name(MemoryTag tag) noexcept {
+  switch (tag) {
+    case MemoryTag::kRoutingConnections: return "routing_connections";
+    case MemoryTag::kRoutingBuffers: return "routing_buffers";
+    case MemoryTag::kThreadStacks: return "thread_stacks";
+    case MemoryTag::kMetadataCache: return "metadata_cache";
+    case MemoryTag::kHttp: return "http";
+    case MemoryTag::kLogging: return "logging";
+  }
+  return "unknown";
+}
+
+AccountedMemory::AccountedMemory(MemoryTag tag, size_t bytes, size_t objects) noexcept
+    : tag_(tag), bytes_(bytes), objects_(objects) {
+  MemoryAccounting::allocated(tag_, bytes_, objects_);
+}
+
+AccountedMemory::AccountedMemory(const AccountedMemory& other) noexcept
+    : AccountedMemory(other.tag_, other.bytes_, other.objects_) {}
+
+AccountedMemory& AccountedMemory::operator=(const AccountedMemory& other) noexcept {
+  if (this != &other) {
+    MemoryAccounting::freed(tag_, bytes_, objects_);
+    tag_ = other.tag_;
+    bytes_ = other.bytes_;
+    objects_ = other.objects_;
+    MemoryAccounting::allocated(tag_, bytes_, objects_);
+  }
+  return *this;
+}
+
+AccountedMemory::~AccountedMemory() {
+  MemoryAccounting::freed(tag_, bytes_, objects_);
+}
+
+void AccountedMemory::set(size_t bytes, size_t objects) noexcept {
+  MemoryAccounting::allocated(tag_, bytes, objects);
+  MemoryAccounting::freed(tag_, bytes_, objects_);
+  bytes_ = bytes;
+  objects_ = objects;
+}
+
+}  // namespace mysql_harness
@@ -24,6 +24,12 @@
 
 #include "mysql_router_thread.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 
@@ -32,8 +38,12 @@
 #include <process.h>
 #include <signal.h>
 #include <stdlib.h>
+#else
+#include <unistd.h>
 #endif
 
+#include "mysql/harness/memory_accounting.h"
+
 namespace mysql_harness {
 
 static inline int mysql_router_thread_attr_init(mysql_router_thread_attr_t *attr) {
@@ -172,12 +182,39 @@ int mysql_router_thread_join(mysql_router_thread_handle *thread, void **value_pt
 #endif
 }
 
-MySQLRouterThread::MySQLRouterThread(size_t thread_stack_size) {
+namespace {
+/** @brief what run_accounted() runs */
+struct AccountedThreadStart {
+  MySQLRouterThread::thread_function* run_thread;
+  void* args_ptr;
+  size_t stack_size;
+};
+
+// accounts the stack while the thread runs
+void* run_accounted(void* start_ptr) {
+  std::unique_ptr<AccountedThreadStart> start(static_cast<AccountedThreadStart*>(start_ptr));
+  void* result = start->run_thread(start->args_ptr);
+  MemoryAccounting::freed(MemoryTag::kThreadStacks, start->stack_size);
+
+  return result;
+}
+}  // namespace
+
+MySQLRouterThread::MySQLRouterThread(size_t thread_stack_size)
+    : stack_size_(thread_stack_size << 10) {
   mysql_router_thread_attr_init(&thread_attr_);
 
-  int res = mysql_router_thread_attr_setstacksize(&thread_attr_, thread_stack_size << 10);
+  int res = mysql_router_thread_attr_setstacksize(&thread_attr_, stack_size_);
   if (res)
     throw std::runtime_error("Failed to adjust stack size, result code=" + std::to_string(res));
+
+#ifndef _WIN32
+  // some platforms default to guards larger than a page, that adds up with
+  // small stacks. A single page still catches the overflows.
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (page_size > 0)
+    pthread_attr_setguardsize(&thread_attr_, static_cast<size_t>(page_size));
+#endif
 }
 
 void MySQLRouterThread::run(thread_function run_thread, void* args_ptr, bool detach) {
@@ -187,9 +224,16 @@ void MySQLRouterThread::run(thread_function run_thread, void* args_ptr, bool det
     should_join_ = true;
   }
 
-  int ret = mysql_router_thread_create(&thread_handle_, &thread_attr_, run_thread, args_ptr);
-  if (ret)
+  std::unique_ptr<AccountedThreadStart> start(
+      new AccountedThreadStart{run_thread, args_ptr, stack_size_});
+  MemoryAccounting::allocated(MemoryTag::kThreadStacks, stack_size_);
+  int ret = mysql_router_thread_create(&thread_handle_, &thread_attr_, run_accounted, start.get());
+  if (ret) {
+    MemoryAccounting::freed(MemoryTag::kThreadStacks, stack_size_);
     throw std::runtime_error("Cannot create Thread");
+  }
+  // owned by the thread now
+  start.release();
 }
 
 void MySQLRouterThread::join() {
@@ -205,4 +249,123 @@ MySQLRouterThread::~MySQLRouterThread() {
     join();
 }
 
+#ifndef NDEBUG
+namespace {
+const unsigned char kStackFillPattern = 0xa5;
+
+// left alone below the caller, for the red zone and the frames of the calls
+// the constructor makes
+const uintptr_t kStackProbeMargin = 4096;
+}
+
+StackUsageProbe::StackUsageProbe() noexcept {
+#ifdef __linux__
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0)
+    return;
+
+  void* stack_addr = nullptr;
+  size_t stack_size = 0;
+  size_t guard_size = 0;
+  const bool have_stack = pthread_attr_getstack(&attr, &stack_addr, &stack_size) == 0 &&
+                          pthread_attr_getguardsize(&attr, &guard_size) == 0;
+  pthread_attr_destroy(&attr);
+  if (!have_stack || stack_size <= guard_size)
+    return;
+
+  const uintptr_t low = reinterpret_cast<uintptr_t>(stack_addr) + guard_size;
+  const uintptr_t high = reinterpret_cast<uintptr_t>(stack_addr) + stack_size;
+
+  // the frame of the constructor, the caller's frame is above it
+  const uintptr_t current = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+  if (current < low + kStackProbeMargin || current >= high)
+    return;
+
+  // volatile, as the compiler sees no reads of the pattern
+  for (uintptr_t addr = low; addr < current - kStackProbeMargin; ++addr) {
+    *reinterpret_cast<volatile unsigned char*>(addr) = kStackFillPattern;
+  }
+
+  low_ = low;
+  high_ = high;
+  filled_ = current - kStackProbeMargin;
+#endif
+}
+
+size_t StackUsageProbe::max_used() const noexcept {
+  uintptr_t addr = low_;
+  while (addr < filled_ && *reinterpret_cast<const volatile unsigned char*>(addr) == kStackFillPattern)
+    ++addr;
+
+  return static_cast<size_t>(high_ - addr);
+}
+#endif
+
+static unsigned parse_cpu(const std::string& cpu, const std::string& part) {
+  char *rest;
+  errno = 0;
+  unsigned long value = std::strtoul(cpu.c_str(), &rest, 10);
+  if (cpu.empty() || errno > 0 || *rest != '\0' || cpu[0] == '-' || cpu[0] == '+' ||
+      value >= kMaxCpuAffinityCpu) {
+    throw std::invalid_argument("invalid CPU in '" + part + "', CPUs are between 0 and " +
+                                std::to_string(kMaxCpuAffinityCpu - 1));
+  }
+  return static_cast<unsigned>(value);
+}
+
+std::vector<unsigned> parse_cpu_list(const std::string& cpu_list) {
+  std::vector<unsigned> cpus;
+  if (cpu_list.find_first_not_of(" \t") == std::string::npos) return cpus;
+
+  std::stringstream ss(cpu_list);
+  std::string part;
+  while (std::getline(ss, part, ',')) {
+    part.erase(0, part.find_first_not_of(" \t"));
+    part.erase(part.find_last_not_of(" \t") + 1);
+
+    const size_t dash = part.find('-', 1);
+    const unsigned first = parse_cpu(part.substr(0, dash), part);
+    const unsigned last = dash == std::string::npos ? first : parse_cpu(part.substr(dash + 1), part);
+    if (last < first) {
+      throw std::invalid_argument("invalid CPU range '" + part + "'");
+    }
+    for (unsigned cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  // a trailing ',' leaves no part for getline()
+  if (cpu_list.back() == ',') {
+    throw std::invalid_argument("invalid CPU in '', CPUs are between 0 and " +
+                                std::to_string(kMaxCpuAffinityCpu - 1));
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+  return cpus;
+}
+
+bool set_current_thread_cpu_affinity(const std::vector<unsigned>& cpus) noexcept {
+  if (cpus.empty()) return false;
+
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (unsigned cpu : cpus) {
+    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpu_set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#elif defined(_WIN32)
+  // without processor groups only the first 64 CPUs can be addressed
+  DWORD_PTR mask = 0;
+  for (unsigned cpu : cpus) {
+    if (cpu < sizeof(mask) * 8) mask |= static_cast<DWORD_PTR>(1) << cpu;
+  }
+  return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+  // e.g. macOS only has affinity hints between threads
+  return false;
+#endif
+}
+
 } // end of harness namespace
@@ -0,0 +1,201 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/networking/resolver_cache.h"
+#include "mysql_router_thread.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#  include <netdb.h>
+#endif
+
+namespace mysql_harness {
+
+const std::chrono::milliseconds ResolverCache::kDefaultTTL{std::chrono::seconds(30)};
+const std::chrono::milliseconds ResolverCache::kDefaultNegativeTTL{std::chrono::seconds(5)};
+
+ResolverCache::ResolverCache(std::chrono::milliseconds ttl,
+                             std::chrono::milliseconds negative_ttl,
+                             ResolveFunction resolve_function)
+    : ttl_(ttl), negative_ttl_(negative_ttl),
+      resolve_function_(resolve_function ? resolve_function : &getaddrinfo_resolve) {
+}
+
+ResolverCache::~ResolverCache() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  refresh_cond_.notify_all();
+
+  if (refresh_thread_) refresh_thread_->join();
+}
+
+/*static*/
+ResolverCache& ResolverCache::instance() {
+  static ResolverCache cache;
+  return cache;
+}
+
+/*static*/
+int ResolverCache::getaddrinfo_resolve(const std::string& host, uint16_t port,
+                                       Addresses& addresses) {
+  struct addrinfo hints, *servinfo;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  int err = ::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &servinfo);
+  if (err != 0) return err;
+
+  addresses.clear();
+  for (struct addrinfo* info = servinfo; info != nullptr; info = info->ai_next) {
+    Address address;
+    memset(&address, 0, sizeof(address));
+    address.family = info->ai_family;
+    address.socktype = info->ai_socktype;
+    address.protocol = info->ai_protocol;
+    address.addrlen = static_cast<socklen_t>(std::min(static_cast<size_t>(info->ai_addrlen),
+                                                      sizeof(address.addr)));
+    memcpy(&address.addr, info->ai_addr, address.addrlen);
+    addresses.push_back(address);
+  }
+  freeaddrinfo(servinfo);
+
+  return 0;
+}
+
+int ResolverCache::resolve(const std::string& host, uint16_t port, Addresses& addresses) {
+  const Key key(host, port);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      Entry& entry = it->second;
+      entry.last_used = clock_type::now();
+      if (entry.expires <= entry.last_used && !entry.refreshing) {
+        schedule_refresh(key, entry);
+      }
+
+      addresses = entry.addresses;
+      return entry.error;
+    }
+  }
+
+  // first lookup of the name, resolve outside of the lock
+  Addresses resolved;
+  const int error = resolve_function_(host, port, resolved);
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  store(key, error, resolved);
+  addresses = std::move(resolved);
+
+  return error;
+}
+
+size_t ResolverCache::size() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return entries_.size();
+}
+
+void ResolverCache::store(const Key& key, int error, Addresses addresses) {
+  const auto now = clock_type::now();
+
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    if (entries_.size() >= kMaxEntries) {
+      auto lru = std::min_element(entries_.begin(), entries_.end(),
+          [](const std::pair<const Key, Entry>& a, const std::pair<const Key, Entry>& b) {
+            return a.second.last_used < b.second.last_used;
+          });
+      if (!lru->second.refreshing) entries_.erase(lru);
+    }
+
+    it = entries_.emplace(key, Entry()).first;
+    it->second.last_used = now;
+  }
+
+  Entry& entry = it->second;
+  entry.refreshing = false;
+  if (error == 0) {
+    entry.addresses = std::move(addresses);
+    entry.error = 0;
+    entry.expires = now + ttl_;
+  } else if (!entry.addresses.empty()) {
+    // keep the addresses resolved last, retry earlier
+    entry.expires = now + negative_ttl_;
+  } else {
+    entry.error = error;
+    entry.expires = now + negative_ttl_;
+  }
+}
+
+void ResolverCache::schedule_refresh(const Key& key, Entry& entry) {
+  if (!refresh_thread_) {
+    try {
+      std::unique_ptr<MySQLRouterThread> thread(new MySQLRouterThread());
+      thread->run(&run_refresh_thread, this);
+      refresh_thread_ = std::move(thread);
+    } catch (const std::runtime_error&) {
+      // the cached result is served until the next attempt
+      return;
+    }
+  }
+
+  entry.refreshing = true;
+  refresh_queue_.push_back(key);
+  refresh_cond_.notify_one();
+}
+
+void* ResolverCache::run_refresh_thread(void* context) {
+  static_cast<ResolverCache*>(context)->run_refresh_thread();
+  return nullptr;
+}
+
+void ResolverCache::run_refresh_thread() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!stop_) {
+    if (refresh_queue_.empty()) {
+      refresh_cond_.wait(lock);
+      continue;
+    }
+
+    const Key key = refresh_queue_.front();
+    refresh_queue_.pop_front();
+
+    lock.unlock();
+    Addresses resolved;
+    const int error = resolve_function_(key.first, key.second, resolved);
+    lock.lock();
+
+    if (entries_.count(key) > 0) store(key, error, std::move(resolved));
+  }
+}
+
+}  // namespace mysql_harness
@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/networking/socket_endpoint.h"
+
+#ifndef _WIN32
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#endif
+
+namespace mysql_harness {
+
+SocketEndpoint::SocketEndpoint(const sockaddr_storage &addr) noexcept
+    : SocketEndpoint() {
+  switch (addr.ss_family) {
+    case AF_INET: {
+      const auto *sin4 = reinterpret_cast<const sockaddr_in *>(&addr);
+      family_ = Family::kIPv4;
+      port_ = ntohs(sin4->sin_port);
+      std::memcpy(address_.data(), &sin4->sin_addr, sizeof(sin4->sin_addr));
+      break;
+    }
+    case AF_INET6: {
+      const auto *sin6 = reinterpret_cast<const sockaddr_in6 *>(&addr);
+      family_ = Family::kIPv6;
+      port_ = ntohs(sin6->sin6_port);
+      std::memcpy(address_.data(), &sin6->sin6_addr, sizeof(sin6->sin6_addr));
+      break;
+    }
+#ifdef AF_UNIX
+    case AF_UNIX:
+      family_ = Family::kLocal;
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+SocketEndpoint SocketEndpoint::peer_of(int sock) noexcept {
+  sockaddr_storage addr;
+  socklen_t addr_len = static_cast<socklen_t>(sizeof(addr));
+
+  if (getpeername(sock, reinterpret_cast<sockaddr *>(&addr), &addr_len) != 0) {
+    return SocketEndpoint();
+  }
+
+  return SocketEndpoint(addr);
+}
+
+std::string SocketEndpoint::address_str() const {
+  char tmp[INET6_ADDRSTRLEN];
+
+  switch (family_) {
+    case Family::kIPv4:
+      if (inet_ntop(AF_INET, const_cast<uint8_t *>(address_.data()), tmp,
+                    static_cast<socklen_t>(sizeof(tmp)))) {
+        return tmp;
+      }
+      break;
+    case Family::kIPv6:
+      if (inet_ntop(AF_INET6, const_cast<uint8_t *>(address_.data()), tmp,
+                    static_cast<socklen_t>(sizeof(tmp)))) {
+        return tmp;
+      }
+      break;
+    case Family::kLocal:
+      return "unix socket";
+    case Family::kNone:
+      break;
+  }
+
+  return {};
+}
+
+std::string SocketEndpoint::str() const {
+  std::string result = address_str();
+
+  if (family_ == Family::kIPv4 || family_ == Family::kIPv6) {
+    result += ':';
+    result += std::to_string(port_);
+  }
+
+  return result;
+}
+
+size_t SocketEndpoint::hash() const noexcept {
+  // FNV-1a over the bytes that make up the endpoint
+  uint64_t h = 14695981039346656037ULL;
+  auto mix = [&h](uint8_t b) {
+    h ^= b;
+    h *= 1099511628211ULL;
+  };
+
+  mix(static_cast<uint8_t>(family_));
+  mix(static_cast<uint8_t>(port_ >> 8));
+  mix(static_cast<uint8_t>(port_ & 0xff));
+  for (uint8_t b : address_) mix(b);
+
+  return static_cast<size_t>(h);
+}
+
+} // namespace mysql_harness
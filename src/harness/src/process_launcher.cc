@@ -47,9 +47,21 @@
 #  include <errno.h>
 #  include <signal.h>
 #  include <fcntl.h>
-#  include <sys/select.h>
+#  include <spawn.h>
+#  ifdef __APPLE__
+#    include <crt_externs.h>
+#  endif
+#  ifdef __linux__
+#    include <sys/syscall.h>
+#  endif
+#  if defined(__linux__) && defined(SYS_pidfd_open)
+#    define HAVE_PIDFD
+#  endif
 #endif
 
+#if !defined(_WIN32) && !defined(__APPLE__)
+extern char **environ;
+#endif
 
 namespace mysql_harness {
 
@@ -57,6 +69,19 @@ namespace mysql_harness {
 constexpr unsigned kWaitPidCheckInterval = 10;
 constexpr auto kTerminateWaitInterval = std::chrono::seconds(10);
 
+#ifndef _WIN32
+
+/** @brief environment the child processes get, the one of the router */
+static char **get_environ() {
+#  ifdef __APPLE__
+  // environ isn't available to shared libraries on macOS
+  return *_NSGetEnviron();
+#  else
+  return environ;
+#  endif
+}
+#endif
+
 ProcessLauncher::~ProcessLauncher() {
   if (is_alive) {
     try {
@@ -250,6 +275,23 @@ int ProcessLauncher::read(char *buf, size_t count, unsigned timeout_ms) {
   return dwBytesRead;
 }
 
+bool ProcessLauncher::wait_for_output_or_exit(unsigned timeout_ms) {
+  // anonymous pipes can't be waited for, only the process handle can
+  for (;;) {
+    DWORD dwBytesAvail = 0;
+    if (!PeekNamedPipe(child_out_rd, NULL, 0, NULL, &dwBytesAvail, NULL) || dwBytesAvail != 0)
+      return true;  // data or EOF
+
+    const auto interval_ms = std::min(timeout_ms, kWaitPidCheckInterval);
+    if (WaitForSingleObject(pi.hProcess, interval_ms) == WAIT_OBJECT_0)
+      return true;
+    if (timeout_ms == 0)
+      return false;
+
+    timeout_ms -= interval_ms;
+  }
+}
+
 int ProcessLauncher::write(const char *buf, size_t count) {
   DWORD dwBytesWritten;
   BOOL bSuccess = FALSE;
@@ -306,13 +348,27 @@ uint64_t ProcessLauncher::get_fd_read() const {
 
 #else
 
+/** @brief creates a pipe whose ends aren't inherited by the child processes */
+static int pipe_cloexec(int fds[2]) {
+#ifdef __linux__
+  return pipe2(fds, O_CLOEXEC);
+#else
+  if (pipe(fds) < 0) return -1;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return 0;
+#endif
+}
+
 void ProcessLauncher::start()
 {
-  if( pipe(fd_in) < 0 )
+  // close-on-exec, a child only keeps the ends it gets as its stdin/stdout,
+  // also when other threads start processes meanwhile
+  if (pipe_cloexec(fd_in) < 0)
   {
     report_error(NULL, "ProcessLauncher::start() pipe(fd_in)");
   }
-  if( pipe(fd_out) < 0 )
+  if (pipe_cloexec(fd_out) < 0)
   {
     report_error(NULL, "ProcessLauncher::start() pipe(fd_out)");
   }
@@ -320,66 +376,46 @@ void ProcessLauncher::start()
   // Ignore broken pipe signal
   signal(SIGPIPE, SIG_IGN);
 
-  childpid = fork();
-  if(childpid == -1)
-  {
-    report_error(NULL, "ProcessLauncher::start() fork()");
-  }
-
-  if(childpid == 0)
-  {
-#ifdef LINUX
-    prctl(PR_SET_PDEATHSIG, SIGHUP);
-#endif
-
-    ::close(fd_out[0]);
-    ::close(fd_in[1]);
-    while( dup2(fd_out[1], STDOUT_FILENO) == -1 )
-    {
-      if(errno == EINTR) continue;
-      else report_error(NULL, "ProcessLauncher::start() dup2()");
-    }
-
-    if(redirect_stderr)
-    {
-      while( dup2(fd_out[1], STDERR_FILENO) == -1 )
-      {
-        if(errno == EINTR) continue;
-        else report_error(NULL, "ProcessLauncher::start() dup2()");
-      }
-    }
-    while( dup2(fd_in[0], STDIN_FILENO) == -1 )
-    {
-      if(errno == EINTR) continue;
-      else report_error(NULL, "ProcessLauncher::start() dup2()");
-    }
+  // posix_spawn() doesn't copy the page tables of the parent like fork()
+  // does (it uses vfork() or clone(CLONE_VM) where available), which makes
+  // starting processes from a large test process cheap
+  posix_spawn_file_actions_t file_actions;
+  posix_spawn_file_actions_init(&file_actions);
+  posix_spawn_file_actions_adddup2(&file_actions, fd_out[1], STDOUT_FILENO);
+  if (redirect_stderr)
+    posix_spawn_file_actions_adddup2(&file_actions, fd_out[1], STDERR_FILENO);
+  posix_spawn_file_actions_adddup2(&file_actions, fd_in[0], STDIN_FILENO);
 
-    fcntl(fd_out[1], F_SETFD, FD_CLOEXEC);
-    fcntl(fd_in[0], F_SETFD, FD_CLOEXEC);
+  const int res = posix_spawnp(&childpid, cmd_line.c_str(), &file_actions, nullptr,
+                               const_cast<char * const *>(args), get_environ());
+  posix_spawn_file_actions_destroy(&file_actions);
 
-    execvp(cmd_line.c_str(), (char * const *)args);
-    // if exec returns, there is an error.
-    int my_errno = errno;
-    fprintf(stderr, "%s could not be executed: %s (errno %d)\n", cmd_line.c_str(), strerror(my_errno), my_errno);
+  ::close(fd_out[1]);
+  ::close(fd_in[0]);
 
-    // we need to identify an ENOENT and since some programs return 2 as exit-code
-    // we need to return a non-existent code, 128 is a general convention used to indicate
-    // a failure to execute another program in a subprocess
-    if (my_errno == 2)
-      my_errno = 128;
+  fd_out[1] = -1;
+  fd_in[0] = -1;
 
-    exit(my_errno);
-  }
-  else
+  if (res != 0)
   {
-    ::close(fd_out[1]);
-    ::close(fd_in[0]);
+    ::close(fd_out[0]);
+    ::close(fd_in[1]);
+    fd_out[0] = -1;
+    fd_in[1] = -1;
+    childpid = -1;
+    errno = res;
+    report_error(NULL, ("ProcessLauncher::start() posix_spawnp(" + cmd_line + ")").c_str());
+  }
 
-    fd_out[1] = -1;
-    fd_in[0] = -1;
+  // read() waits with poll()
+  fcntl(fd_out[0], F_SETFL, fcntl(fd_out[0], F_GETFL) | O_NONBLOCK);
 
-    is_alive = true;
-  }
+#ifdef HAVE_PIDFD
+  // wait() sleeps on it instead of polling waitpid(), -1 on older kernels
+  pidfd_ = static_cast<int>(syscall(SYS_pidfd_open, childpid, 0));
+#endif
+
+  is_alive = true;
 }
 
 int ProcessLauncher::close()
@@ -410,9 +446,11 @@ int ProcessLauncher::close()
 
   if (fd_out[0] != -1) ::close(fd_out[0]);
   if (fd_in[1] != -1) ::close(fd_in[1]);
+  if (pidfd_ != -1) ::close(pidfd_);
 
   fd_out[0] = -1;
   fd_in[1] = -1;
+  pidfd_ = -1;
   is_alive = false;
 
   return result;
@@ -425,27 +463,61 @@ void ProcessLauncher::end_of_write() {
 
 int ProcessLauncher::read(char *buf, size_t count, unsigned timeout_ms)
 {
-  int n;
-  fd_set set;
-  struct timeval timeout;
-  memset (&timeout, 0x0, sizeof(timeout));
-  timeout.tv_sec = static_cast<decltype(timeout.tv_sec)>(timeout_ms / 1000);
-  timeout.tv_usec = static_cast<decltype(timeout.tv_usec)>((timeout_ms % 1000) * 1000);
-
-  FD_ZERO(&set);
-  FD_SET(fd_out[0], &set);
-
-  int res = select(fd_out[0] + 1, &set, NULL, NULL, &timeout);
-  if (res < 0) report_error(nullptr, "select()");
+  // poll() instead of select(), the fds of a process running many children
+  // exceed FD_SETSIZE
+  struct pollfd fds[1];
+  fds[0].fd = fd_out[0];
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+
+  int res;
+  do {
+    res = ::poll(fds, 1, static_cast<int>(timeout_ms));
+  } while (res < 0 && errno == EINTR);
+  if (res < 0) report_error(nullptr, "poll()");
   if (res == 0) return 0;
 
-  if((n = (int)::read(fd_out[0], buf, count)) >= 0)
+  int n;
+  if((n = (int)::read(fd_out[0], buf, count)) >= 0) {
+    if (n == 0 && count > 0) output_eof_ = true;
     return n;
+  }
+  if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+    return 0;
 
   report_error(nullptr, "read");
   return -1;
 }
 
+bool ProcessLauncher::wait_for_output_or_exit(unsigned timeout_ms)
+{
+  struct pollfd fds[2];
+  nfds_t nfds = 0;
+  // a closed stdout stays readable, it would end the wait right away
+  if (!output_eof_) {
+    fds[nfds].fd = fd_out[0];
+    fds[nfds].events = POLLIN;
+    fds[nfds++].revents = 0;
+  }
+  if (pidfd_ != -1) {
+    fds[nfds].fd = pidfd_;
+    fds[nfds].events = POLLIN;
+    fds[nfds++].revents = 0;
+  } else {
+    // the exit of the child isn't signalled without pidfd, check for it
+    // every kWaitPidCheckInterval
+    timeout_ms = std::min(timeout_ms, kWaitPidCheckInterval);
+  }
+
+  int res;
+  do {
+    res = ::poll(fds, nfds, static_cast<int>(timeout_ms));
+  } while (res < 0 && errno == EINTR);
+  if (res < 0) report_error(nullptr, "poll()");
+
+  return res > 0;
+}
+
 int ProcessLauncher::write(const char *buf, size_t count)
 {
   int n;
@@ -493,21 +565,33 @@ uint64_t ProcessLauncher::get_pid() const
 
 int ProcessLauncher::wait(const unsigned int timeout_ms)
 {
-  unsigned int wait_time = timeout_ms;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
   do {
     int status;
 
     pid_t ret = ::waitpid(childpid, &status, WNOHANG);
 
     if (ret == 0) {
-      auto sleep_for = std::min(wait_time, kWaitPidCheckInterval);
-      if (sleep_for > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_for));
-        wait_time -= sleep_for;
-      } else {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
         throw std::system_error(ETIMEDOUT, std::generic_category(),
             std::string("Timed out waiting " + std::to_string(timeout_ms) + " ms for the process " + std::to_string(childpid) + " to exit"));
       }
+      // rounded up, waking up before the deadline would spin
+      const auto left_ms = static_cast<unsigned>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+
+      if (pidfd_ != -1) {
+        // readable once the child exited
+        struct pollfd fds[1];
+        fds[0].fd = pidfd_;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        if (::poll(fds, 1, static_cast<int>(left_ms)) < 0 && errno != EINTR)
+          report_error(nullptr, "poll()");
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(left_ms, kWaitPidCheckInterval)));
+      }
     } else if (ret == -1) {
       throw std::system_error(errno, std::generic_category(),
           std::string("waiting for process " + std::to_string(childpid) + " failed"));
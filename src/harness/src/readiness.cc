@@ -0,0 +1,139 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/readiness.h"
+
+#ifdef __linux__
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace mysql_harness {
+
+Readiness& Readiness::instance() {
+  static Readiness instance;
+
+  return instance;
+}
+
+void Readiness::expect(const std::string& component) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  components_.emplace(component, false);
+  notify_if_changed();
+}
+
+void Readiness::report(const std::string& component, bool ready) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  components_[component] = ready;
+  notify_if_changed();
+}
+
+void Readiness::forget(const std::string& component) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  components_.erase(component);
+  notify_if_changed();
+}
+
+bool Readiness::is_ready() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return is_ready_locked();
+}
+
+bool Readiness::is_ready_locked() const {
+  for (const auto& component : components_) {
+    if (!component.second)
+      return false;
+  }
+  return true;
+}
+
+std::map<std::string, bool> Readiness::get_components() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return components_;
+}
+
+void Readiness::add_listener(Listener listener) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  listeners_.push_back(std::move(listener));
+}
+
+void Readiness::clear() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  components_.clear();
+  listeners_.clear();
+  notified_ready_ = true;
+}
+
+void Readiness::notify_if_changed() {
+  const bool ready = is_ready_locked();
+  if (ready == notified_ready_)
+    return;
+
+  // called under the lock, so listeners see the changes in order
+  notified_ready_ = ready;
+  for (const auto& listener : listeners_)
+    listener(ready);
+}
+
+bool notify_service_manager(const std::string& state) noexcept {
+#ifdef __linux__
+  const char* socket_path = std::getenv("NOTIFY_SOCKET");
+  if (socket_path == nullptr)
+    return false;
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  // a path or '@' for the abstract namespace
+  const size_t path_len = strlen(socket_path);
+  if ((socket_path[0] != '/' && socket_path[0] != '@') ||
+      path_len >= sizeof(addr.sun_path))
+    return false;
+  memcpy(addr.sun_path, socket_path, path_len);
+  if (addr.sun_path[0] == '@')
+    addr.sun_path[0] = '\0';
+
+  int sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (sock == -1)
+    return false;
+
+  const ssize_t sent = sendto(
+      sock, state.data(), state.size(), MSG_NOSIGNAL,
+      reinterpret_cast<struct sockaddr*>(&addr),
+      static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path_len));
+  close(sock);
+
+  return sent == static_cast<ssize_t>(state.size());
+#else
+  (void)state;
+  return false;
+#endif
+}
+
+}  // namespace mysql_harness
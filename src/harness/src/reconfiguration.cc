@@ -0,0 +1,90 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/reconfiguration.h"
+
+#include "mysql/harness/config_parser.h"
+
+namespace mysql_harness {
+
+Reconfiguration& Reconfiguration::instance() {
+  static Reconfiguration instance;
+
+  return instance;
+}
+
+void Reconfiguration::set_handler(const std::string& section_name,
+                                  const std::string& section_key,
+                                  Handler handler) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  handlers_[std::make_pair(section_name, section_key)] = std::move(handler);
+}
+
+void Reconfiguration::remove_handler(const std::string& section_name,
+                                     const std::string& section_key) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  handlers_.erase(std::make_pair(section_name, section_key));
+}
+
+bool Reconfiguration::apply(const ConfigSection& section) {
+  // held while the handler runs, so the plugin can't remove it meanwhile
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = handlers_.find(std::make_pair(section.name, section.key));
+  if (it == handlers_.end())
+    return false;
+
+  try {
+    return it->second(section);
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+void Reconfiguration::set_validator(const std::string& section_name,
+                                    Validator validator) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  validators_[section_name] = std::move(validator);
+}
+
+void Reconfiguration::remove_validator(const std::string& section_name) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  validators_.erase(section_name);
+}
+
+bool Reconfiguration::validate(const ConfigSection& section, std::string& error) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = validators_.find(section.name);
+  if (it == validators_.end())
+    return true;
+
+  try {
+    it->second(section);
+  } catch (const std::exception& e) {
+    error = e.what();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace mysql_harness
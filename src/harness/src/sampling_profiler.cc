@@ -0,0 +1,299 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/sampling_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define HAVE_SAMPLING_PROFILER
+#include <cerrno>
+#include <csignal>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/time.h>
+#endif
+
+namespace mysql_harness {
+
+constexpr size_t SamplingProfiler::kMaxDepth;
+constexpr unsigned SamplingProfiler::kMaxFrequency;
+constexpr std::chrono::seconds SamplingProfiler::kMaxDuration;
+
+namespace {
+
+#ifdef HAVE_SAMPLING_PROFILER
+// the frames of the signal handler and the signal trampoline
+constexpr int kSkippedFrames = 2;
+
+// at most that many samples are kept per profile
+constexpr size_t kMaxSamples = 1 << 16;
+
+struct Sample {
+  int depth;
+  void* frames[SamplingProfiler::kMaxDepth + kSkippedFrames];
+};
+
+// written by the signal handler, which can't take locks or allocate
+Sample* g_samples{nullptr};
+size_t g_capacity{0};
+std::atomic<size_t> g_next_sample{0};
+std::atomic<bool> g_sampling{false};
+std::atomic<int> g_in_handler{0};
+
+struct sigaction g_previous_action;
+
+void on_sigprof(int, siginfo_t*, void*) {
+  const int saved_errno = errno;
+
+  // announced before g_sampling is checked, lets finish() wait for us
+  g_in_handler.fetch_add(1);
+  if (g_sampling.load()) {
+    const size_t ndx = g_next_sample.fetch_add(1, std::memory_order_relaxed);
+    if (ndx < g_capacity) {
+      Sample& sample = g_samples[ndx];
+      sample.depth = backtrace(sample.frames, static_cast<int>(SamplingProfiler::kMaxDepth + kSkippedFrames));
+    }
+  }
+  g_in_handler.fetch_sub(1);
+
+  errno = saved_errno;
+}
+
+bool set_timer(unsigned frequency) {
+  struct itimerval timer {};
+  if (frequency > 0) {
+    timer.it_interval.tv_usec = static_cast<suseconds_t>(1000000 / frequency);
+    timer.it_value = timer.it_interval;
+  }
+  return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+std::string symbolize(void* addr) {
+  Dl_info info;
+  if (dladdr(addr, &info) == 0) {
+    std::ostringstream os;
+    os << addr;
+    return os.str();
+  }
+
+  if (info.dli_sname != nullptr) {
+    int status = 0;
+    std::unique_ptr<char, decltype(&free)> demangled{
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), &free};
+    return status == 0 && demangled ? std::string(demangled.get()) : std::string(info.dli_sname);
+  }
+
+  // no symbol, name it by the object and the offset in it
+  std::string object = info.dli_fname != nullptr ? info.dli_fname : "?";
+  const size_t slash = object.rfind('/');
+  if (slash != std::string::npos) object.erase(0, slash + 1);
+  std::ostringstream os;
+  os << object << "+0x" << std::hex
+     << (reinterpret_cast<uintptr_t>(addr) - reinterpret_cast<uintptr_t>(info.dli_fbase));
+  return os.str();
+}
+
+std::string fold_samples(size_t samples) {
+  std::unordered_map<void*, std::string> names;
+  std::map<std::string, uint64_t> stacks;
+
+  for (size_t ndx = 0; ndx < samples; ++ndx) {
+    const Sample& sample = g_samples[ndx];
+    std::string stack;
+    // outermost frame first
+    for (int frame = sample.depth - 1; frame >= kSkippedFrames; --frame) {
+      // return addresses point after the call, look up the call itself
+      void* addr = static_cast<char*>(sample.frames[frame]) - 1;
+      auto it = names.find(addr);
+      if (it == names.end()) it = names.emplace(addr, symbolize(addr)).first;
+
+      if (!stack.empty()) stack += ';';
+      // ';' separates the frames and ' ' the count in folded stacks
+      for (char c : it->second) stack += (c == ';' || c == ' ') ? '_' : c;
+    }
+    if (!stack.empty()) ++stacks[stack];
+  }
+
+  std::string folded;
+  for (const auto& stack : stacks) {
+    folded += stack.first;
+    folded += ' ';
+    folded += std::to_string(stack.second);
+    folded += '\n';
+  }
+  return folded;
+}
+#endif
+
+}  // namespace
+
+SamplingProfiler& SamplingProfiler::instance() {
+  static SamplingProfiler instance;
+
+  return instance;
+}
+
+SamplingProfiler::~SamplingProfiler() {
+  stop();
+}
+
+bool SamplingProfiler::is_supported() noexcept {
+#ifdef HAVE_SAMPLING_PROFILER
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SamplingProfiler::start(std::chrono::milliseconds duration, unsigned frequency) {
+  if (duration <= std::chrono::milliseconds::zero() || duration > kMaxDuration) {
+    throw std::invalid_argument("duration needs to be between 1ms and " +
+                                std::to_string(kMaxDuration.count()) + "s");
+  }
+  if (frequency == 0 || frequency > kMaxFrequency) {
+    throw std::invalid_argument("frequency needs to be between 1 and " +
+                                std::to_string(kMaxFrequency) + "Hz");
+  }
+
+#ifdef HAVE_SAMPLING_PROFILER
+  std::lock_guard<std::mutex> control_lock(control_mtx_);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (running_) throw std::logic_error("profiling runs already");
+  }
+  // the previous profile stopped, its stopper ends without taking mtx_
+  if (stopper_.joinable()) stopper_.join();
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  has_profile_ = false;
+  folded_stacks_.clear();
+  lost_samples_ = 0;
+
+  // the first call of backtrace() loads the unwinder, which isn't safe in
+  // the signal handler
+  void* frames[1];
+  backtrace(frames, 1);
+
+  const uint64_t expected_samples =
+      static_cast<uint64_t>(duration.count()) * frequency / 1000 + 1;
+  g_capacity = static_cast<size_t>(std::min<uint64_t>(expected_samples, kMaxSamples));
+  g_samples = new Sample[g_capacity];
+  g_next_sample.store(0);
+  g_sampling.store(true);
+
+  struct sigaction action {};
+  action.sa_sigaction = on_sigprof;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &g_previous_action) != 0 || !set_timer(frequency)) {
+    const int err = errno;
+    g_sampling.store(false);
+    delete[] g_samples;
+    g_samples = nullptr;
+    g_capacity = 0;
+    throw std::runtime_error(std::string("starting the profiling timer failed: ") + strerror(err));
+  }
+
+  running_ = true;
+  stopper_ = std::thread([this, duration]() {
+    std::unique_lock<std::mutex> stopper_lock(mtx_);
+    if (!stop_cond_.wait_for(stopper_lock, duration, [this]() { return !running_; })) {
+      finish();
+    }
+  });
+#else
+  throw std::runtime_error("the sampling profiler is not supported on this platform");
+#endif
+}
+
+void SamplingProfiler::stop() {
+  std::lock_guard<std::mutex> control_lock(control_mtx_);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (running_) finish();
+  }
+  stop_cond_.notify_all();
+  if (stopper_.joinable()) stopper_.join();
+}
+
+void SamplingProfiler::finish() {
+#ifdef HAVE_SAMPLING_PROFILER
+  set_timer(0);
+  g_sampling.store(false);
+  // handlers which saw g_sampling set are done once they left
+  while (g_in_handler.load() != 0) std::this_thread::yield();
+
+  // a SIGPROF still pending would kill us with the default action
+  if (g_previous_action.sa_handler == SIG_DFL && !(g_previous_action.sa_flags & SA_SIGINFO)) {
+    signal(SIGPROF, SIG_IGN);
+  } else {
+    sigaction(SIGPROF, &g_previous_action, nullptr);
+  }
+
+  const size_t taken = g_next_sample.load();
+  const size_t samples = std::min(taken, g_capacity);
+  lost_samples_ = taken - samples;
+  folded_stacks_ = fold_samples(samples);
+
+  delete[] g_samples;
+  g_samples = nullptr;
+  g_capacity = 0;
+#endif
+  running_ = false;
+  has_profile_ = true;
+}
+
+bool SamplingProfiler::is_running() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return running_;
+}
+
+bool SamplingProfiler::has_profile() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return has_profile_;
+}
+
+std::string SamplingProfiler::get_folded_stacks() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return folded_stacks_;
+}
+
+uint64_t SamplingProfiler::get_lost_samples() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return lost_samples_;
+}
+
+}  // namespace mysql_harness
@@ -26,6 +26,7 @@
 #include "socket_operations.h"
 #include "common.h"
 
+#include <atomic>
 #include <memory>
 #ifndef _WIN32
 # include <arpa/inet.h>
@@ -52,17 +53,91 @@
 
 namespace mysql_harness {
 
+namespace {
+
+enum StatsOp { kStatsRead, kStatsWrite, kStatsPoll, kStatsConnectWait, kStatsOps };
+enum StatsCounter { kCalls, kBytes, kWouldBlock, kInterrupted, kErrors, kTimeouts, kStatsCounters };
+
+constexpr size_t kStatsShards = 16;
+
+// a cache line per shard at least, zero-initialized as static storage
+struct alignas(64) StatsShard {
+  std::atomic<uint64_t> counters[kStatsOps][kStatsCounters];
+};
+
+StatsShard g_stats_shards[kStatsShards];
+std::atomic<bool> g_stats_enabled{false};
+
+StatsShard &stats_shard() noexcept {
+  static std::atomic<size_t> next_shard{0};
+  // threads take the shards round-robin, in the order they first use one
+  thread_local const size_t ndx = next_shard.fetch_add(1, std::memory_order_relaxed) % kStatsShards;
+
+  return g_stats_shards[ndx];
+}
+
+void count_call(StatsOp op, long res, int err) noexcept {
+  std::atomic<uint64_t> *counters = stats_shard().counters[op];
+
+  counters[kCalls].fetch_add(1, std::memory_order_relaxed);
+  if (res > 0) {
+    if (op == kStatsRead || op == kStatsWrite)
+      counters[kBytes].fetch_add(static_cast<uint64_t>(res), std::memory_order_relaxed);
+  } else if (res == 0) {
+    // a read() returning 0 is the end of the stream
+    if (op == kStatsPoll || op == kStatsConnectWait)
+      counters[kTimeouts].fetch_add(1, std::memory_order_relaxed);
+  } else {
+#ifdef _WIN32
+    const bool would_block = err == WSAEWOULDBLOCK;
+    const bool interrupted = err == WSAEINTR;
+#else
+    const bool would_block = err == EAGAIN || err == EWOULDBLOCK;
+    const bool interrupted = err == EINTR;
+#endif
+    counters[would_block ? kWouldBlock : interrupted ? kInterrupted : kErrors].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+SocketOperationsStats::Counters sum_counters(StatsOp op) noexcept {
+  uint64_t sums[kStatsCounters]{};
+  for (const auto &shard: g_stats_shards) {
+    for (size_t i = 0; i < kStatsCounters; ++i)
+      sums[i] += shard.counters[op][i].load(std::memory_order_relaxed);
+  }
+
+  return {sums[kCalls], sums[kBytes], sums[kWouldBlock], sums[kInterrupted], sums[kErrors], sums[kTimeouts]};
+}
+
+}  // namespace
+
 SocketOperations* SocketOperations::instance() {
   static SocketOperations instance_;
   return &instance_;
 }
 
+void SocketOperations::set_stats_enabled(bool enabled) noexcept {
+  g_stats_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool SocketOperations::is_stats_enabled() noexcept {
+  return g_stats_enabled.load(std::memory_order_relaxed);
+}
+
+SocketOperationsStats SocketOperations::get_stats() noexcept {
+  return {sum_counters(kStatsRead), sum_counters(kStatsWrite),
+          sum_counters(kStatsPoll), sum_counters(kStatsConnectWait)};
+}
+
 int SocketOperations::poll(struct pollfd *fds, nfds_t nfds, std::chrono::milliseconds timeout_ms) {
 #ifdef _WIN32
-  return ::WSAPoll(fds, nfds, timeout_ms.count());
+  int res = ::WSAPoll(fds, nfds, timeout_ms.count());
 #else
-  return ::poll(fds, nfds, static_cast<int>(timeout_ms.count()));
+  int res = ::poll(fds, nfds, static_cast<int>(timeout_ms.count()));
 #endif
+  if (is_stats_enabled()) count_call(kStatsPoll, res, res < 0 ? get_errno() : 0);
+
+  return res;
 }
 
 int SocketOperations::connect_non_blocking_wait(int sock, std::chrono::milliseconds timeout_ms) {
@@ -72,6 +147,8 @@ int SocketOperations::connect_non_blocking_wait(int sock, std::chrono::milliseco
 
   int res = poll(fds, sizeof(fds) / sizeof(fds[0]), timeout_ms);
 
+  if (is_stats_enabled()) count_call(kStatsConnectWait, res, res < 0 ? get_errno() : 0);
+
   if (0 == res) {
     // timeout
     this->set_errno(ETIMEDOUT);
@@ -109,18 +186,24 @@ int SocketOperations::connect_non_blocking_status(int sock, int &so_error) {
 
 ssize_t SocketOperations::write(int fd, void *buffer, size_t nbyte) {
 #ifndef _WIN32
-  return ::write(fd, buffer, nbyte);
+  ssize_t res = ::write(fd, buffer, nbyte);
 #else
-  return ::send(fd, reinterpret_cast<const char *>(buffer), nbyte, 0);
+  ssize_t res = ::send(fd, reinterpret_cast<const char *>(buffer), nbyte, 0);
 #endif
+  if (is_stats_enabled()) count_call(kStatsWrite, static_cast<long>(res), res < 0 ? get_errno() : 0);
+
+  return res;
 }
 
 ssize_t SocketOperations::read(int fd, void *buffer, size_t nbyte) {
 #ifndef _WIN32
-  return ::read(fd, buffer, nbyte);
+  ssize_t res = ::read(fd, buffer, nbyte);
 #else
-  return ::recv(fd, reinterpret_cast<char *>(buffer), nbyte, 0);
+  ssize_t res = ::recv(fd, reinterpret_cast<char *>(buffer), nbyte, 0);
 #endif
+  if (is_stats_enabled()) count_call(kStatsRead, static_cast<long>(res), res < 0 ? get_errno() : 0);
+
+  return res;
 }
 
 void SocketOperations::close(int fd) {
@@ -42,7 +42,8 @@ void TCPAddress::detect_family() noexcept {
   // Function only run once by setting ip_family_ > Family::UNKNOWN
   ip_family_ = Family::INVALID;
 
-  if (addr.empty()) {
+  // paths of unix sockets aren't names to resolve
+  if (addr.empty() || addr[0] == '/') {
     return;
   }
 
@@ -0,0 +1,247 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/async_socket.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include <gtest/gtest.h>
+
+using mysql_harness::AsyncSocket;
+using mysql_harness::IoContext;
+using mysql_harness::Task;
+using mysql_harness::Unit;
+
+using namespace std::chrono;
+
+TEST(TestAsyncTask, ThenChainsValues) {
+  std::error_code result_ec;
+  std::string result;
+  Task<int>::ready(20)
+      .then([](int v) { return Task<int>::ready(v + 1); })
+      .then([](int v) { return Task<std::string>::ready(std::to_string(v * 2)); })
+      .start([&](std::error_code ec, std::string v) {
+        result_ec = ec;
+        result = v;
+      });
+
+  EXPECT_FALSE(result_ec);
+  EXPECT_EQ("42", result);
+}
+
+TEST(TestAsyncTask, ErrorSkipsStepsUntilRecover) {
+  bool step_ran = false;
+  int result = 0;
+  Task<int>::failed(std::make_error_code(std::errc::timed_out))
+      .then([&](int v) {
+        step_ran = true;
+        return Task<int>::ready(v);
+      })
+      .recover([](std::error_code ec) {
+        return Task<int>::ready(ec == std::errc::timed_out ? 7 : 0);
+      })
+      .start([&](std::error_code, int v) { result = v; });
+
+  EXPECT_FALSE(step_ran);
+  EXPECT_EQ(7, result);
+}
+
+TEST(TestAsyncTask, RepeatWhile) {
+  int rounds = 0;
+  int result = 0;
+  // rounds completing right away don't grow the stack
+  mysql_harness::repeat_while<int>([&]() { return Task<int>::ready(++rounds); },
+                                   [](const int& v) { return v < 100000; })
+      .start([&](std::error_code, int v) { result = v; });
+
+  EXPECT_EQ(100000, rounds);
+  EXPECT_EQ(100000, result);
+}
+
+#ifndef _WIN32
+
+class TestAsyncSocket : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, listener_);
+    addr_.sin_family = AF_INET;
+    addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr_);
+    ASSERT_EQ(0, ::bind(listener_, reinterpret_cast<sockaddr*>(&addr_), addr_len));
+    ASSERT_EQ(0, ::listen(listener_, 4));
+    ASSERT_EQ(0, ::getsockname(listener_, reinterpret_cast<sockaddr*>(&addr_), &addr_len));
+  }
+
+  void TearDown() override {
+    if (listener_ != -1) ::close(listener_);
+  }
+
+  /** @brief runs the context, fails if it doesn't get stopped in time */
+  void run() {
+    bool timed_out = false;
+    std::thread watchdog([&]() {
+      for (int i = 0; i < 500 && !io_ctx_.is_stopped(); ++i)
+        std::this_thread::sleep_for(milliseconds(10));
+      if (!io_ctx_.is_stopped()) {
+        timed_out = true;
+        io_ctx_.stop();
+      }
+    });
+    io_ctx_.run();
+    watchdog.join();
+    EXPECT_FALSE(timed_out);
+  }
+
+  IoContext io_ctx_{"test"};
+  int listener_{-1};
+  sockaddr_in addr_{};
+};
+
+/**
+ * @test
+ *       Verify that a connection can be accepted, connected and data
+ *       exchanged over it with the sequential steps of a task.
+ */
+TEST_F(TestAsyncSocket, ConnectAcceptReadWrite) {
+  AsyncSocket listener(io_ctx_, listener_);
+  listener_ = -1;
+  AsyncSocket client(io_ctx_, ::socket(AF_INET, SOCK_STREAM, 0));
+  std::unique_ptr<AsyncSocket> server;
+  char buf[5]{};
+  std::error_code client_ec, server_ec;
+
+  io_ctx_.post([&]() {
+    listener.accept(seconds(1))
+        .then([&](int fd) {
+          server.reset(new AsyncSocket(io_ctx_, fd));
+          return server->read_exact(buf, sizeof(buf), seconds(1));
+        })
+        .then([&](size_t) { return server->write("ok", 2, seconds(1)); })
+        .start([&](std::error_code ec, size_t) { server_ec = ec; });
+
+    client.connect(reinterpret_cast<sockaddr*>(&addr_), sizeof(addr_), seconds(1))
+        .then([&](Unit) { return client.write("hello", 5, seconds(1)); })
+        .then([&](size_t) {
+          static char reply[2];
+          return client.read_exact(reply, sizeof(reply), seconds(1));
+        })
+        .start([&](std::error_code ec, size_t) {
+          client_ec = ec;
+          io_ctx_.stop();
+        });
+  });
+  run();
+
+  EXPECT_FALSE(server_ec) << server_ec.message();
+  EXPECT_FALSE(client_ec) << client_ec.message();
+  EXPECT_EQ("hello", std::string(buf, sizeof(buf)));
+}
+
+/**
+ * @test
+ *       Verify that a read without data fails with a timeout and a closed
+ *       socket cancels its pending read.
+ */
+TEST_F(TestAsyncSocket, TimeoutAndCancel) {
+  AsyncSocket client(io_ctx_, ::socket(AF_INET, SOCK_STREAM, 0));
+  char buf[1];
+  std::error_code read_ec, cancel_ec;
+  steady_clock::time_point started;
+
+  io_ctx_.post([&]() {
+    client.connect(reinterpret_cast<sockaddr*>(&addr_), sizeof(addr_), seconds(1))
+        .then([&](Unit) {
+          started = steady_clock::now();
+          return client.read(buf, sizeof(buf), milliseconds(50));
+        })
+        .recover([&](std::error_code ec) {
+          read_ec = ec;
+          // runs once the read waits
+          io_ctx_.post([&]() { client.close(); });
+          return client.read(buf, sizeof(buf), seconds(10));
+        })
+        .start([&](std::error_code ec, size_t) {
+          cancel_ec = ec;
+          io_ctx_.stop();
+        });
+  });
+  run();
+
+  EXPECT_EQ(std::errc::timed_out, read_ec);
+  EXPECT_EQ(std::errc::operation_canceled, cancel_ec);
+  EXPECT_GE(steady_clock::now() - started, milliseconds(50));
+}
+
+/**
+ * @test
+ *       Verify that timers run once their delay passed, unless cancelled.
+ */
+TEST_F(TestAsyncSocket, Timers) {
+  std::vector<int> fired;
+  const auto started = steady_clock::now();
+
+  io_ctx_.schedule(milliseconds(30), [&]() {
+    fired.push_back(2);
+    io_ctx_.stop();
+  });
+  io_ctx_.schedule(milliseconds(10), [&]() { fired.push_back(1); });
+  const IoContext::TimerId cancelled = io_ctx_.schedule(milliseconds(20), [&]() { fired.push_back(3); });
+  EXPECT_TRUE(io_ctx_.cancel_timer(cancelled));
+  EXPECT_FALSE(io_ctx_.cancel_timer(cancelled));
+  run();
+
+  EXPECT_EQ(std::vector<int>({1, 2}), fired);
+  EXPECT_GE(steady_clock::now() - started, milliseconds(30));
+}
+
+/**
+ * @test
+ *       Verify that tasks posted from other threads run in the loop.
+ */
+TEST_F(TestAsyncSocket, PostFromOtherThread) {
+  std::thread::id loop_thread;
+  std::thread poster([&]() {
+    io_ctx_.post([&]() {
+      loop_thread = std::this_thread::get_id();
+      io_ctx_.stop();
+    });
+  });
+  run();
+  poster.join();
+
+  EXPECT_EQ(std::this_thread::get_id(), loop_thread);
+}
+
+#endif
@@ -367,6 +367,24 @@ TEST(TestConfig, RecursiveInterpolate) {
   EXPECT_THROW(section.get("rec"), syntax_error);
 }
 
+TEST(TestConfig, InterpolateFollowsChanges) {
+  Config config(Config::allow_keys);
+  config.set_default("datadir", "/one");
+  auto&& section = config.add("testing", "");
+  section.set("log", "{datadir}/router.log");
+  EXPECT_THAT(section.get("LOG"), Eq("/one/router.log"));
+
+  // the resolved values get recomputed if the defaults change ...
+  config.set_default("datadir", "/two");
+  EXPECT_THAT(section.get("log"), Eq("/two/router.log"));
+
+  // ... or the section itself
+  section.set("datadir", "/three");
+  EXPECT_THAT(section.get("log"), Eq("/three/router.log"));
+  EXPECT_TRUE(section.has("DataDir"));
+  EXPECT_FALSE(section.has("logdir"));
+}
+
 class BadParseTestForbidKey : public ::testing::TestWithParam<const char*> {
  protected:
   virtual void SetUp() {
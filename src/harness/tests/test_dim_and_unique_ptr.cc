@@ -29,7 +29,10 @@
 
 ////////////////////////////////////////
 // Standard include files
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
 ////////////////////////////////////////
 // Third-party include files
@@ -333,6 +336,8 @@ class TestDIM : public mysql_harness::DIM {
   void set_Baz(const std::function<Baz*(void)>& factory, const std::function<void(Baz*)>& deleter = std::default_delete<Baz>()) { factory_Baz_ = factory; deleter_Baz_ = deleter; }
   void set_Ext(const std::function<Ext*(void)>& factory, const std::function<void(Ext*)>& deleter = std::default_delete<Ext>()) { factory_Ext_ = factory; deleter_Ext_ = deleter; }
   void reset_Ext() { reset_generic(instance_Ext_); }
+  void set_Cached(const std::function<Ext*(void)>& factory, const std::function<void(Ext*)>& deleter = std::default_delete<Ext>()) { factory_Cached_ = factory; deleter_Cached_ = deleter; }
+  void reset_Cached() { reset_generic(instance_Cached_, cached_Cached_); }
 
   // NOTE: for convenience of not writing two separate test classes, we have both new_A() and get_A() here,
   //       but normally only one of those two methods would be implemented (we either want DIM to manage
@@ -344,6 +349,7 @@ class TestDIM : public mysql_harness::DIM {
   Bar& get_Bar() const { return get_generic<Bar>(factory_Bar_, deleter_Bar_); }
   Baz& get_Baz() const { return get_generic<Baz>(factory_Baz_, deleter_Baz_); }
   Ext& get_Ext() { return get_external_generic(instance_Ext_, factory_Ext_, deleter_Ext_); }
+  Ext& get_Cached() { return get_external_generic(instance_Cached_, cached_Cached_, factory_Cached_, deleter_Cached_); }
 
   // object creators [step 3]
   UniquePtr<A> new_A()                           const { return new_generic(factory_A_, deleter_A_); }
@@ -361,6 +367,8 @@ class TestDIM : public mysql_harness::DIM {
   std::function<Bar*(void)> factory_Bar_;  std::function<void(Bar*)> deleter_Bar_;
   std::function<Baz*(void)> factory_Baz_;  std::function<void(Baz*)> deleter_Baz_;
   std::function<Ext*(void)> factory_Ext_;  std::function<void(Ext*)> deleter_Ext_; UniquePtr<Ext> instance_Ext_;
+  std::function<Ext*(void)> factory_Cached_;  std::function<void(Ext*)> deleter_Cached_; UniquePtr<Ext> instance_Cached_;
+  std::atomic<Ext*> cached_Cached_{nullptr};
 };
 
 class DIMTest : public ::testing::Test {
@@ -621,6 +629,36 @@ TEST_F(DIMTest, object_reset) {
   EXPECT_EQ(dim.get_Ext().x, 555);            // now it gets called!
 }
 
+TEST_F(DIMTest, cached_object_reset) {
+  dim.set_Cached([]() { return new Ext(42); });
+  EXPECT_EQ(dim.get_Cached().x, 42);
+
+  dim.set_Cached([]() { return new Ext(555); });
+  EXPECT_EQ(dim.get_Cached().x, 42);          // the cached object is returned
+
+  dim.reset_Cached();
+  EXPECT_EQ(dim.get_Cached().x, 555);
+}
+
+TEST_F(DIMTest, cached_object_created_once) {
+  std::atomic<int> created{0};
+  dim.reset_Cached();
+  dim.set_Cached([&created]() { ++created; return new Ext(7); });
+
+  std::vector<std::thread> threads;
+  std::vector<Ext*> objects(8);
+  for (size_t i = 0; i < objects.size(); ++i) {
+    threads.emplace_back([this, &objects, i]() { objects[i] = &dim.get_Cached(); });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(1, created.load());
+  for (Ext* object : objects) EXPECT_EQ(&dim.get_Cached(), object);
+
+  // the factory refers to the counter of this test
+  dim.reset_Cached();
+}
+
 
 
 
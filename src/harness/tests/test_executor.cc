@@ -0,0 +1,116 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/executor.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::Executor;
+
+TEST(TestExecutor, RunsAllTasks) {
+  std::atomic<int> count{0};
+  {
+    Executor executor(4);
+    EXPECT_EQ(4u, executor.size());
+
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 1000; ++i)
+      results.push_back(executor.submit([&count]() { ++count; }));
+    for (auto& result : results)
+      result.wait();
+  }
+
+  EXPECT_EQ(1000, count);
+}
+
+TEST(TestExecutor, TasksSubmittedByTasks) {
+  std::atomic<int> count{0};
+  Executor executor(2);
+
+  // the nested tasks go to the deque of the worker, the other one steals them
+  std::promise<void> done;
+  executor.submit([&]() {
+    for (int i = 0; i < 100; ++i) {
+      executor.submit([&]() {
+        if (++count == 100)
+          done.set_value();
+      });
+    }
+  });
+
+  EXPECT_EQ(std::future_status::ready,
+            done.get_future().wait_for(std::chrono::seconds(10)));
+}
+
+TEST(TestExecutor, FutureHoldsException) {
+  Executor executor(1);
+
+  std::future<void> result = executor.submit([]() { throw std::runtime_error("boom"); });
+  EXPECT_THROW(result.get(), std::runtime_error);
+
+  // the worker survived
+  executor.submit([]() {}).get();
+}
+
+TEST(TestExecutor, StopRunsQueuedTasks) {
+  std::atomic<int> count{0};
+  Executor executor(1);
+
+  for (int i = 0; i < 100; ++i)
+    executor.submit([&count]() { ++count; });
+  executor.stop();
+
+  EXPECT_EQ(100, count);
+  EXPECT_THROW(executor.submit([]() {}), std::logic_error);
+}
+
+TEST(TestExecutor, Timers) {
+  Executor executor(2);
+
+  std::promise<void> fired;
+  const auto start = std::chrono::steady_clock::now();
+  executor.schedule(std::chrono::milliseconds(50), [&fired]() { fired.set_value(); });
+
+  std::atomic<bool> cancelled_ran{false};
+  const Executor::TimerId id = executor.schedule(std::chrono::milliseconds(20),
+                                                 [&cancelled_ran]() { cancelled_ran = true; });
+  EXPECT_TRUE(executor.cancel(id));
+  EXPECT_FALSE(executor.cancel(id));
+
+  ASSERT_EQ(std::future_status::ready,
+            fired.get_future().wait_for(std::chrono::seconds(10)));
+  EXPECT_LE(std::chrono::milliseconds(50), std::chrono::steady_clock::now() - start);
+  EXPECT_FALSE(cancelled_ran);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -139,6 +139,7 @@ TEST(TestFilesystem, TestDirectory) {
       g_here.join("data/tests-start-1.cfg"),
       g_here.join("data/magic-alt.cfg"),
       g_here.join("data/keepalive.cfg"),
+      g_here.join("data/keepalive_stalls.cfg"),
     };
 
     decltype(expect) result(directory.begin(), directory.end());
@@ -316,6 +316,44 @@ TEST_F(KeyringFileTest, LoadFromNonexistentFile) {
   EXPECT_THROW(keyring.load(kKeyringFileName, kAesKey), std::exception);
 }
 
+TEST_F(KeyringFileTest, LoadAgainAfterChange) {
+  {
+    mysql_harness::KeyringFile keyring;
+
+    fill_keyring(keyring);
+    keyring.save(kKeyringFileName, kAesKey);
+  }
+
+  // the second load of the unchanged file comes from the cache
+  for (int i = 0; i < 2; ++i) {
+    mysql_harness::KeyringFile keyring;
+
+    keyring.load(kKeyringFileName, kAesKey);
+    verify_keyring(keyring);
+  }
+
+  // but not with another key
+  {
+    mysql_harness::KeyringFile keyring;
+
+    EXPECT_THROW(keyring.load(kKeyringFileName, "invalid_key"), std::exception);
+  }
+
+  // and not once the file changed
+  {
+    mysql_harness::KeyringFile keyring;
+
+    keyring.load(kKeyringFileName, kAesKey);
+    keyring.store("NewEntry", "Attr", "Value");
+    keyring.save(kKeyringFileName, kAesKey);
+  }
+  mysql_harness::KeyringFile keyring;
+
+  keyring.load(kKeyringFileName, kAesKey);
+  verify_keyring(keyring);
+  EXPECT_EQ("Value", keyring.fetch("NewEntry", "Attr"));
+}
+
 int main(int argc, char *argv[]) {
 
   ::testing::InitGoogleTest(&argc, argv);
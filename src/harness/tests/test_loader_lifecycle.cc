@@ -58,6 +58,7 @@
 #include "filesystem.h"
 #include "lifecycle.h"
 #include "mysql/harness/plugin.h"
+#include "mysql/harness/reconfiguration.h"
 #include "test/helpers.h"
 #include "utilities.h"
 #include "mysql/harness/logging/registry.h"
@@ -1024,6 +1025,86 @@ TEST_F(LifecycleTest, BothLifecycles_InitFails) {
   EXPECT_EQ(1, count_in_log("  plugin 'magic' doesn't implement deinit()"));
 }
 
+TEST_F(LifecycleTest, BothLifecycles_InitOrder) {
+  config_text_ << "init   = exit           \n"
+               << "start  = exitonstop     \n"
+               << "stop   = exit           \n"
+               << "deinit = exit           \n"
+               << "                        \n"
+               << "[lifecycle2]            \n";
+  init_test(config_text_);
+
+  EXPECT_EQ(loader_.init_all(), nullptr);
+
+  const std::list<std::string> initialized = {"magic", "lifecycle3", "lifecycle", "lifecycle2"};
+  EXPECT_EQ(initialized, loader_.order_);
+
+  refresh_log();
+  auto find_line = [this](const std::string& needle) {
+    return std::find_if(log_lines_.begin(), log_lines_.end(), [&needle](const std::string& line) {
+      return line.find(needle) != line.npos;
+    });
+  };
+  auto thread_of = [](const std::string& line) {
+    return line.substr(line.find('['), line.find(']') - line.find('['));
+  };
+
+  // each init() returns before the next one begins, the required plugins first
+  auto magic_begin = find_line("  plugin 'magic' initializing");
+  auto magic_end = find_line("  plugin 'magic' init exit ok");
+  auto lifecycle3_begin = find_line("  plugin 'lifecycle3' initializing");
+  auto lifecycle3_end = find_line("  plugin 'lifecycle3' init exit ok");
+  auto lifecycle_begin = find_line("  plugin 'lifecycle' initializing");
+  auto lifecycle_end = find_line("  plugin 'lifecycle' init exit ok");
+  auto lifecycle2_begin = find_line("  plugin 'lifecycle2' initializing");
+  ASSERT_NE(log_lines_.end(), lifecycle2_begin);
+  EXPECT_LT(magic_begin, magic_end);
+  EXPECT_LT(magic_end, lifecycle3_begin);
+  EXPECT_LT(lifecycle3_begin, lifecycle3_end);
+  EXPECT_LT(lifecycle3_end, lifecycle_begin);
+  EXPECT_LT(lifecycle_begin, lifecycle_end);
+  EXPECT_LT(lifecycle_end, lifecycle2_begin);
+
+  // all of them on the loader's thread
+  const std::string loader_thread = thread_of(*find_line("Initializing all plugins."));
+  for (auto line : {magic_begin, lifecycle3_begin, lifecycle_begin, lifecycle2_begin})
+    EXPECT_EQ(loader_thread, thread_of(*line));
+
+  EXPECT_EQ(loader_.deinit_all(), nullptr);
+}
+
+TEST_F(LifecycleTest, BothLifecycles_InitReturnsError) {
+  config_text_ << "init   = error          \n"
+               << "start  = exitonstop     \n"
+               << "stop   = exit           \n"
+               << "deinit = exit           \n"
+               << "                        \n"
+               << "[lifecycle2]            \n";
+  init_test(config_text_);
+
+  // the error of init() is returned, the plugins requiring it don't get initialized
+  std::exception_ptr eptr = loader_.init_all();
+  ASSERT_NE(nullptr, eptr);
+  try {
+    std::rethrow_exception(eptr);
+  } catch (const std::runtime_error& e) {
+    EXPECT_STREQ("lifecycle:all init(): I'm returning error!", e.what());
+  } catch (...) {
+    FAIL() << "init() should throw std::runtime_error";
+  }
+
+  const std::list<std::string> initialized = {"magic", "lifecycle3"};
+  EXPECT_EQ(initialized, loader_.order_);
+
+  EXPECT_EQ(loader_.deinit_all(), nullptr);
+
+  refresh_log();
+  EXPECT_EQ(1, count_in_log("  plugin 'lifecycle' init failed: lifecycle:all init(): I'm returning error!"));
+  EXPECT_EQ(0, count_in_log("  plugin 'lifecycle2' initializing"));
+  EXPECT_EQ(0, count_in_log("  plugin 'lifecycle' deinitializing"));
+  EXPECT_EQ(1, count_in_log("  plugin 'lifecycle3' deinit exit ok"));
+}
+
 TEST_F(LifecycleTest, ThreeInstances_Start1Fails) {
   config_text_ << "init   = exit           \n"
                << "start  = error          \n"
@@ -1817,6 +1898,66 @@ TEST_F(LifecycleTest, DeinitThrowsWeird) {
 
 #endif // #ifdef NDEBUG
 
+TEST_F(LifecycleTest, Reload_InvalidSectionKeepsRunning) {
+  config_text_ << "start = exitonstop\n";
+  config_text_ << "stop  = exit\n";
+  const std::string running_text = config_text_.str();
+  init_test(config_text_, {false, true, true, false});
+  LifecyclePluginSyncBus& bus = msg_bus("instance1");
+
+  // rejects an unknown option, like the routing plugin rejects invalid ones
+  mysql_harness::Reconfiguration::instance().set_validator(
+      "lifecycle", [](const mysql_harness::ConfigSection& section) {
+        if (section.has("bogus"))
+          throw std::invalid_argument("option bogus is not supported");
+      });
+  loader_.set_config_reader([this, &running_text]() {
+    std::unique_ptr<mysql_harness::LoaderConfig> fresh(new mysql_harness::LoaderConfig(
+        params_, std::vector<std::string>(), mysql_harness::Config::allow_keys));
+    std::stringstream fresh_text;
+    fresh_text << running_text
+               << "bogus = 1               \n"
+               << "                        \n"
+               << "[lifecycle:instance2]   \n"
+               << "start  = exitonstop     \n"
+               << "bogus  = 1              \n";
+    fresh->Config::read(fresh_text);
+    fresh->fill_and_check();
+    return fresh;
+  });
+
+  EXPECT_EQ(loader_.init_all(), nullptr);
+  freeze_bus(bus);
+  loader_.start_all();
+  unfreeze_and_wait_for_msg(bus, "lifecycle:instance1 start():EXIT_ON_STOP:sleeping");
+  const mysql_harness::ConfigSection* running = &loader_.config_.get("lifecycle", "instance1");
+
+  loader_.reload_config();
+
+  // the running section is neither stopped nor replaced, the invalid one isn't added
+  EXPECT_EQ(running, &loader_.config_.get("lifecycle", "instance1"));
+  EXPECT_FALSE(running->has("bogus"));
+  EXPECT_EQ(std::future_status::timeout,
+            loader_.sessions_.at(running).wait_for(std::chrono::milliseconds(0)));
+  EXPECT_FALSE(loader_.config_.has("lifecycle", "instance2"));
+
+  refresh_log();
+  EXPECT_EQ(1, count_in_log("  section [lifecycle:instance1] is invalid, keeping the running one: "
+                            "option bogus is not supported"));
+  EXPECT_EQ(1, count_in_log("  section [lifecycle:instance2] is invalid, not starting it: "
+                            "option bogus is not supported"));
+  EXPECT_EQ(0, count_in_log("lifecycle:instance1 stop():begin"));
+  EXPECT_EQ(0, count_in_log("lifecycle:instance2 start():begin"));
+
+  // signal shutdown after 10ms, main_loop() should block until then
+  run_then_signal_shutdown([&](){ EXPECT_EQ(loader_.main_loop(), nullptr); });
+  EXPECT_EQ(loader_.deinit_all(), nullptr);
+  mysql_harness::Reconfiguration::instance().remove_validator("lifecycle");
+
+  refresh_log();
+  EXPECT_EQ(1, count_in_log("lifecycle:instance1 start():EXIT_ON_STOP:done"));
+}
+
 TEST_F(LifecycleTest, LoadingNonExistentPlugin) {
   clear_log();
 
@@ -50,17 +50,25 @@ MYSQL_HARNESS_ENABLE_WARNINGS()
 
 ////////////////////////////////////////
 // Standard include files
+#include <algorithm>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 #ifndef _WIN32
 #include <unistd.h> // unlink
 #endif
 
 using mysql_harness::Path;
+using mysql_harness::logging::AsyncStreamHandler;
 using mysql_harness::logging::FileHandler;
+using mysql_harness::logging::JsonStreamHandler;
+using mysql_harness::logging::LogContext;
+using mysql_harness::logging::LogRateLimiter;
 using mysql_harness::logging::LogLevel;
 using mysql_harness::logging::Logger;
 using mysql_harness::logging::Record;
+using mysql_harness::logging::ResolvedLogger;
 using mysql_harness::logging::StreamHandler;
 using mysql_harness::logging::log_debug;
 using mysql_harness::logging::log_error;
@@ -284,6 +292,66 @@ TEST_F(LoggingLowLevelTest, test_logger_update) {
   }
 }
 
+TEST_F(LoggingLowLevelTest, test_resolved_logger) {
+  std::stringstream buffer;
+  g_registry->add_handler("buffer", std::make_shared<StreamHandler>(buffer, false));
+
+  g_registry->create_logger("foo", LogLevel::kInfo);
+  {
+    Logger l = g_registry->get_logger("foo");
+    l.attach_handler("buffer");
+    g_registry->update_logger("foo", l);
+  }
+
+  const uint64_t generation = g_registry->generation();
+  std::shared_ptr<const ResolvedLogger> resolved = g_registry->get_resolved_logger("foo");
+  EXPECT_EQ(LogLevel::kInfo, resolved->get_level());
+  EXPECT_THROW_LIKE(
+    g_registry->get_resolved_logger("unicorn"),
+    std::logic_error, "Accessing non-existant logger 'unicorn'"
+  );
+
+  // lookups don't change the generation
+  EXPECT_EQ(generation, g_registry->generation());
+
+  resolved->handle(Record{LogLevel::kInfo, getpid(), 0, "foo", "Message"});
+  resolved->handle(Record{LogLevel::kDebug, getpid(), 0, "foo", "Filtered"});
+  EXPECT_EQ("Message\n", buffer.str());
+
+  // removing the handler invalidates snapshots, and the stale snapshot
+  // doesn't keep using the removed handler
+  g_registry->remove_handler("buffer");
+  EXPECT_NE(generation, g_registry->generation());
+  resolved->handle(Record{LogLevel::kInfo, getpid(), 0, "foo", "Dropped"});
+  EXPECT_EQ("Message\n", buffer.str());
+}
+
+TEST_F(LoggingLowLevelTest, test_is_handled) {
+
+  // no loggers: nothing beyond fatal can be handled
+  EXPECT_TRUE(g_registry->is_handled(LogLevel::kFatal));
+  EXPECT_FALSE(g_registry->is_handled(LogLevel::kError));
+
+  // most verbose logger determines the outcome
+  g_registry->create_logger("foo", LogLevel::kWarning);
+  g_registry->create_logger("bar", LogLevel::kError);
+  EXPECT_TRUE(g_registry->is_handled(LogLevel::kWarning));
+  EXPECT_FALSE(g_registry->is_handled(LogLevel::kInfo));
+
+  // update_logger() raises the level
+  {
+    Logger l = g_registry->get_logger("bar");
+    l.set_level(LogLevel::kDebug);
+    g_registry->update_logger("bar", l);
+  }
+  EXPECT_TRUE(g_registry->is_handled(LogLevel::kDebug));
+
+  // remove_logger() lowers it again
+  g_registry->remove_logger("bar");
+  EXPECT_TRUE(g_registry->is_handled(LogLevel::kWarning));
+  EXPECT_FALSE(g_registry->is_handled(LogLevel::kInfo));
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -402,6 +470,25 @@ TEST_F(LoggingTest, StreamHandler) {
   g_registry->remove_handler("TestStreamHandler");
 }
 
+TEST_F(LoggingTest, StreamHandlerLongMessage) {
+  std::stringstream buffer;
+
+  g_registry->add_handler("TestStreamHandler", std::make_shared<StreamHandler>(buffer));
+  logger.attach_handler("TestStreamHandler");
+
+  // formatted messages used to be truncated at 512 bytes
+  const std::string message(2000, 'x');
+  logger.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", message});
+  logger.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "Short"});
+
+  EXPECT_THAT(buffer.str(), HasSubstr(" my_module INFO "));
+  EXPECT_THAT(buffer.str(), HasSubstr("] " + message + "\n"));
+  EXPECT_THAT(buffer.str(), HasSubstr("] Short\n"));
+
+  // clean up
+  g_registry->remove_handler("TestStreamHandler");
+}
+
 TEST_F(LoggingTest, FileHandler) {
   // Check that an exception is thrown for a path that cannot be
   // opened.
@@ -441,6 +528,183 @@ TEST_F(LoggingTest, FileHandler) {
   g_registry->remove_handler("TestFileHandler");
 }
 
+TEST(LogRateLimiterTest, BurstThenSuppress) {
+  LogRateLimiter limiter(3, std::chrono::hours(1));
+  uint64_t suppressed = 42;
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(limiter.allow(suppressed));
+    EXPECT_EQ(0u, suppressed);
+  }
+
+  // bucket is empty, and won't refill during the test
+  for (int i = 0; i < 5; ++i)
+    EXPECT_FALSE(limiter.allow(suppressed));
+}
+
+TEST(LogRateLimiterTest, RefillReportsSuppressed) {
+  LogRateLimiter limiter(1, std::chrono::milliseconds(50));
+  uint64_t suppressed;
+
+  EXPECT_TRUE(limiter.allow(suppressed));
+  EXPECT_FALSE(limiter.allow(suppressed));
+  EXPECT_FALSE(limiter.allow(suppressed));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // the next message that is let through gets the count of suppressed ones
+  EXPECT_TRUE(limiter.allow(suppressed));
+  EXPECT_EQ(2u, suppressed);
+}
+
+TEST_F(LoggingTest, JsonStreamHandler) {
+  std::stringstream buffer;
+
+  g_registry->add_handler("TestJsonStreamHandler", std::make_shared<JsonStreamHandler>(buffer));
+  logger.attach_handler("TestJsonStreamHandler");
+
+  logger.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "Message"});
+  EXPECT_THAT(buffer.str(), StartsWith("{\"time\":\""));
+  EXPECT_THAT(buffer.str(), HasSubstr("\",\"level\":\"INFO\",\"domain\":\"my_module\",\"thread\":\""));
+  EXPECT_THAT(buffer.str(), EndsWith(",\"message\":\"Message\"}\n"));
+
+  // fields of the current contexts are appended, outermost first
+  buffer.str("");
+  {
+    LogContext outer;
+    outer.add("route", "my_route");
+    LogContext inner;
+    inner.add("bytes", 123LL);
+    logger.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "Message"});
+  }
+  EXPECT_THAT(buffer.str(), EndsWith(",\"message\":\"Message\",\"route\":\"my_route\",\"bytes\":123}\n"));
+
+  // contexts are gone, special characters are escaped
+  buffer.str("");
+  logger.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "a \"quoted\"\\path\n\x01"});
+  EXPECT_THAT(buffer.str(), EndsWith(",\"message\":\"a \\\"quoted\\\"\\\\path\\n\\u0001\"}\n"));
+
+  // clean up
+  g_registry->remove_handler("TestJsonStreamHandler");
+}
+
+TEST_F(LoggingTest, AsyncStreamHandler) {
+  std::stringstream buffer;
+
+  {
+    auto handler = std::make_shared<AsyncStreamHandler>(buffer);
+    g_registry->add_handler("TestAsyncStreamHandler", handler);
+    logger.attach_handler("TestAsyncStreamHandler");
+
+    logger.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "Message"});
+
+    // the writer thread flushes all queued records when the handler goes away
+    logger.detach_handler("TestAsyncStreamHandler");
+    g_registry->remove_handler("TestAsyncStreamHandler");
+  }
+
+  // message should be logged after applying format (timestamp, etc)
+  EXPECT_THAT(buffer.str(), ContainsRegex(kDateRegex + " my_module INFO.*Message\n"));
+}
+
+// collects what the writer thread of AsyncHandler writes
+class LevelCollectingHandler : public mysql_harness::logging::AsyncHandler {
+ public:
+  LevelCollectingHandler()
+      : AsyncHandler(false, LogLevel::kNotSet, OverflowPolicy::kBlock,
+                     kDefaultCapacity, kDefaultFlushInterval) {
+    start();
+  }
+  ~LevelCollectingHandler() { stop(); }
+
+  // writes what is queued, written can be read after that
+  void finish() { stop(); }
+
+  std::vector<std::pair<LogLevel, std::string>> written;
+  int flushes = 0;
+
+ private:
+  void write(LogLevel level, const std::string& msg) override {
+    written.emplace_back(level, msg);
+  }
+  void flush() override { ++flushes; }
+};
+
+TEST_F(LoggingTest, AsyncHandlerPassesLevels) {
+  LevelCollectingHandler handler;
+  handler.handle(Record{LogLevel::kError, getpid(), 0, "my_module", "first"});
+  handler.handle(Record{LogLevel::kDebug, getpid(), 0, "my_module", "second"});
+  handler.finish();
+
+  ASSERT_EQ(2u, handler.written.size());
+  EXPECT_EQ(LogLevel::kError, handler.written[0].first);
+  EXPECT_EQ("first", handler.written[0].second);
+  EXPECT_EQ(LogLevel::kDebug, handler.written[1].first);
+  EXPECT_EQ("second", handler.written[1].second);
+  EXPECT_LE(1, handler.flushes);
+}
+
+TEST_F(LoggingTest, AsyncStreamHandlerBlockLosesNothing) {
+  std::stringstream buffer;
+  constexpr int kThreads = 4;
+  constexpr int kMessagesPerThread = 1000;
+
+  {
+    // tiny ring to make producers wait for the writer
+    AsyncStreamHandler handler(buffer, false, LogLevel::kNotSet,
+                               AsyncStreamHandler::OverflowPolicy::kBlock, 4);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&handler]() {
+        for (int i = 0; i < kMessagesPerThread; ++i)
+          handler.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "Message"});
+      });
+    }
+    for (auto& thr : threads)
+      thr.join();
+
+    EXPECT_EQ(0u, handler.dropped());
+  }
+
+  std::string line;
+  int lines = 0;
+  while (std::getline(buffer, line)) {
+    EXPECT_EQ("Message", line);
+    ++lines;
+  }
+  EXPECT_EQ(kThreads * kMessagesPerThread, lines);
+}
+
+TEST_F(LoggingTest, AsyncStreamHandlerDropAccountsForAll) {
+  std::stringstream buffer;
+  constexpr int kMessages = 10000;
+  uint64_t dropped;
+
+  {
+    AsyncStreamHandler handler(buffer, false, LogLevel::kNotSet,
+                               AsyncStreamHandler::OverflowPolicy::kDrop, 4);
+
+    for (int i = 0; i < kMessages; ++i)
+      handler.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module", "Message"});
+
+    dropped = handler.dropped();
+  }
+
+  // every record is either written or counted as dropped
+  std::string line;
+  uint64_t written = 0;
+  while (std::getline(buffer, line)) {
+    if (line == "Message")
+      ++written;
+  }
+  EXPECT_EQ(static_cast<uint64_t>(kMessages), written + dropped);
+
+  if (dropped > 0) {
+    EXPECT_THAT(buffer.str(), HasSubstr("log message(s) dropped"));
+  }
+}
+
 /**
  * @test
  *      Verify if no exception is throw when file can be opened for writing.
@@ -468,6 +732,56 @@ TEST_F(LoggingTest, DontThrowIfOpenedLogFileForWriting) {
  * that uses file as a directory to veryfy scenario when file cannot
  * be created in directory.
  */
+// returns the names of the files in g_here that start with prefix
+static std::vector<std::string> files_with_prefix(const std::string& prefix) {
+  std::vector<std::string> result;
+  mysql_harness::Directory dir(g_here);
+  for (auto it = dir.glob(prefix + "*"); it != dir.end(); ++it) {
+    // Path::basename() doesn't handle "./name"
+    const std::string entry = (*it).str();
+    result.push_back(entry.substr(entry.find_last_of("/\\") + 1));
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST_F(LoggingTest, FileHandlerRotatesBySize) {
+  const std::string log_name = "log-rotate-" + std::to_string(getpid()) + ".log";
+  Path log_file(g_here.join(log_name));
+  std::shared_ptr<void> exit_guard(nullptr, [&](void*) {
+    for (const std::string& name : files_with_prefix(log_name))
+      unlink(g_here.join(name).c_str());
+  });
+
+  mysql_harness::logging::LogRotation rotation;
+  rotation.max_size = 100;
+  rotation.keep = 2;
+  rotation.compress = false;
+
+  {
+    FileHandler handler(log_file, false, LogLevel::kNotSet, rotation);
+
+    // 10 records of 40 bytes, 2 fit into a file
+    for (int i = 0; i < 10; ++i)
+      handler.handle(Record{LogLevel::kInfo, getpid(), 0, "my_module",
+                            std::string(39, static_cast<char>('a' + i))});
+  }  // waits for the housekeeper
+
+  // current file + the 2 most recent rotated ones
+  std::vector<std::string> files = files_with_prefix(log_name);
+  ASSERT_THAT(files.size(), Eq(3u));
+  EXPECT_THAT(files.at(0), Eq(log_name));
+
+  // the current file starts with the 9th record
+  std::ifstream ifs_log(log_file.str());
+  std::string line;
+  ASSERT_TRUE(static_cast<bool>(std::getline(ifs_log, line)));
+  EXPECT_THAT(line, Eq(std::string(39, 'i')));
+  ASSERT_TRUE(static_cast<bool>(std::getline(ifs_log, line)));
+  EXPECT_THAT(line, Eq(std::string(39, 'j')));
+  EXPECT_FALSE(static_cast<bool>(std::getline(ifs_log, line)));
+}
+
 TEST_F(LoggingTest, FileHandlerThrowsNoPermissionToCreateFileInDirectory) {
 
   std::string tmp_dir = mysql_harness::get_tmp_dir("logging");
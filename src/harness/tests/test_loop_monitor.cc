@@ -0,0 +1,180 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/loop_monitor.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::LoopMonitor;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+namespace {
+
+/**
+ * loop running the tasks posted to it, which adds itself to the monitor.
+ */
+class TaskLoop {
+ public:
+  TaskLoop() : thread_([this]() { run(); }) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_.wait(lock, [this]() { return id_ != 0; });
+  }
+
+  ~TaskLoop() {
+    post([this]() { stop_ = true; });
+    thread_.join();
+  }
+
+  void post(LoopMonitor::Task task) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    tasks_.push_back(std::move(task));
+    cond_.notify_all();
+  }
+
+  LoopMonitor::LoopId id() const { return id_; }
+
+ private:
+  void run() {
+    const auto id = LoopMonitor::instance().add("task loop", [this](LoopMonitor::Task task) {
+      post(std::move(task));
+    });
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      id_ = id;
+      cond_.notify_all();
+    }
+
+    while (!stop_) {
+      LoopMonitor::Task task;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, [this]() { return !tasks_.empty(); });
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+
+    LoopMonitor::instance().remove(id);
+  }
+
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  std::deque<LoopMonitor::Task> tasks_;
+  LoopMonitor::LoopId id_{0};
+  bool stop_{false};
+  std::thread thread_;
+};
+
+// waits until the heartbeat posted last ran
+LoopMonitor::LoopState wait_for_heartbeat(LoopMonitor::LoopId id) {
+  for (int i = 0; i < 1000; ++i) {
+    for (const auto& state : LoopMonitor::instance().get_loops()) {
+      if (state.id == id && state.pending == microseconds(0)) return state;
+    }
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+
+  return LoopMonitor::LoopState();
+}
+
+}  // namespace
+
+class TestLoopMonitor : public ::testing::Test {
+ protected:
+  void SetUp() override { LoopMonitor::instance().clear(); }
+  void TearDown() override { LoopMonitor::instance().clear(); }
+};
+
+TEST_F(TestLoopMonitor, LoopsAddAndRemoveThemselves) {
+  {
+    TaskLoop loop;
+
+    const auto loops = LoopMonitor::instance().get_loops();
+    ASSERT_EQ(1u, loops.size());
+    EXPECT_EQ(loop.id(), loops[0].id);
+    EXPECT_EQ("task loop", loops[0].name);
+    EXPECT_EQ(microseconds(0), loops[0].pending);
+  }
+
+  EXPECT_TRUE(LoopMonitor::instance().get_loops().empty());
+}
+
+TEST_F(TestLoopMonitor, StalledLoopHasPendingHeartbeat) {
+  TaskLoop loop;
+  auto& monitor = LoopMonitor::instance();
+
+  monitor.post_heartbeats();
+  wait_for_heartbeat(loop.id());
+
+  // the loop is busy with the task, the heartbeat waits behind it
+  std::mutex mtx;
+  std::unique_lock<std::mutex> stall(mtx);
+  loop.post([&mtx]() { std::lock_guard<std::mutex> lock(mtx); });
+  monitor.post_heartbeats();
+  std::this_thread::sleep_for(milliseconds(50));
+
+  // the pending heartbeat isn't posted again
+  monitor.post_heartbeats();
+  auto loops = monitor.get_loops();
+  ASSERT_EQ(1u, loops.size());
+  EXPECT_GE(loops[0].pending, milliseconds(50));
+
+  stall.unlock();
+  const auto state = wait_for_heartbeat(loop.id());
+  EXPECT_EQ(loop.id(), state.id);
+  EXPECT_GE(state.last_lag, milliseconds(50));
+  EXPECT_GE(state.max_lag, state.last_lag);
+  EXPECT_EQ(2u, state.heartbeats);
+
+  // the next heartbeat doesn't wait, the longest lag stays
+  monitor.post_heartbeats();
+  const auto next = wait_for_heartbeat(loop.id());
+  EXPECT_LT(next.last_lag, milliseconds(50));
+  EXPECT_EQ(state.max_lag, next.max_lag);
+  EXPECT_EQ(3u, next.heartbeats);
+}
+
+TEST_F(TestLoopMonitor, DumpStack) {
+  TaskLoop loop;
+  auto& monitor = LoopMonitor::instance();
+
+  EXPECT_EQ("", monitor.dump_stack(loop.id() + 1, std::chrono::seconds(1)));
+
+  const std::string stack = monitor.dump_stack(loop.id(), std::chrono::seconds(1));
+  if (!LoopMonitor::is_stack_dump_supported()) {
+    EXPECT_EQ("", stack);
+    return;
+  }
+  EXPECT_NE("", stack);
+
+  // and once more, the buffer is free again
+  EXPECT_NE("", monitor.dump_stack(loop.id(), std::chrono::seconds(1)));
+}
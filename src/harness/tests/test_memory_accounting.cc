@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/memory_accounting.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::AccountedMemory;
+using mysql_harness::MemoryAccounting;
+using mysql_harness::MemoryTag;
+
+TEST(TestMemoryAccounting, AllocatedAndFreed) {
+  const auto before = MemoryAccounting::get_usage(MemoryTag::kHttp);
+
+  MemoryAccounting::allocated(MemoryTag::kHttp, 100);
+  MemoryAccounting::allocated(MemoryTag::kHttp, 50, 2);
+
+  auto usage = MemoryAccounting::get_usage(MemoryTag::kHttp);
+  EXPECT_EQ(before.bytes + 150, usage.bytes);
+  EXPECT_EQ(before.objects + 3, usage.objects);
+
+  MemoryAccounting::freed(MemoryTag::kHttp, 50, 2);
+  MemoryAccounting::freed(MemoryTag::kHttp, 100);
+
+  usage = MemoryAccounting::get_usage(MemoryTag::kHttp);
+  EXPECT_EQ(before.bytes, usage.bytes);
+  EXPECT_EQ(before.objects, usage.objects);
+}
+
+TEST(TestMemoryAccounting, AccountedMemoryFollowsItsOwner) {
+  const auto before = MemoryAccounting::get_usage(MemoryTag::kMetadataCache);
+  {
+    std::vector<AccountedMemory> owners;
+    owners.emplace_back(MemoryTag::kMetadataCache, 10, 1);
+    owners.push_back(owners.front());  // copies get accounted too
+    EXPECT_EQ(before.bytes + 20, MemoryAccounting::get_usage(MemoryTag::kMetadataCache).bytes);
+
+    owners.back().set(100, 5);
+    EXPECT_EQ(100u, owners.back().bytes());
+    const auto usage = MemoryAccounting::get_usage(MemoryTag::kMetadataCache);
+    EXPECT_EQ(before.bytes + 110, usage.bytes);
+    EXPECT_EQ(before.objects + 6, usage.objects);
+
+    owners.front() = owners.back();
+    EXPECT_EQ(before.bytes + 200, MemoryAccounting::get_usage(MemoryTag::kMetadataCache).bytes);
+  }
+  const auto usage = MemoryAccounting::get_usage(MemoryTag::kMetadataCache);
+  EXPECT_EQ(before.bytes, usage.bytes);
+  EXPECT_EQ(before.objects, usage.objects);
+}
+
+TEST(TestMemoryAccounting, TagNames) {
+  EXPECT_EQ(std::string("routing_connections"),
+            MemoryAccounting::tag_name(MemoryTag::kRoutingConnections));
+  EXPECT_EQ(std::string("routing_buffers"),
+            MemoryAccounting::tag_name(MemoryTag::kRoutingBuffers));
+  EXPECT_EQ(std::string("thread_stacks"),
+            MemoryAccounting::tag_name(MemoryTag::kThreadStacks));
+  EXPECT_EQ(std::string("metadata_cache"),
+            MemoryAccounting::tag_name(MemoryTag::kMetadataCache));
+  EXPECT_EQ(std::string("http"), MemoryAccounting::tag_name(MemoryTag::kHttp));
+  EXPECT_EQ(std::string("logging"), MemoryAccounting::tag_name(MemoryTag::kLogging));
+}
@@ -0,0 +1,181 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysqlrouter/my_aes.h"
+#include "mysqlrouter/my_aes_hw.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using myaes::AesHw;
+
+static std::vector<unsigned char> from_hex(const std::string &hex) {
+  std::vector<unsigned char> bytes;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    bytes.push_back(
+        static_cast<unsigned char>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+  return bytes;
+}
+
+static std::string to_hex(const unsigned char *data, size_t len) {
+  std::string hex;
+  char buf[3];
+  for (size_t i = 0; i < len; ++i) {
+    snprintf(buf, sizeof(buf), "%02x", data[i]);
+    hex += buf;
+  }
+  return hex;
+}
+
+struct AesVector {
+  myaes::my_aes_opmode mode;
+  const char *key;
+  const char *iv;  // nullptr for ECB
+  const char *plaintext;
+  const char *ciphertext;
+};
+
+static const AesVector kAesVectors[] = {
+    // FIPS-197, Appendix C
+    {myaes::my_aes_128_ecb, "000102030405060708090a0b0c0d0e0f", nullptr,
+     "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a"},
+    {myaes::my_aes_192_ecb,
+     "000102030405060708090a0b0c0d0e0f1011121314151617", nullptr,
+     "00112233445566778899aabbccddeeff", "dda97ca4864cdfe06eaf70a0ec0d7191"},
+    {myaes::my_aes_256_ecb,
+     "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+     nullptr, "00112233445566778899aabbccddeeff",
+     "8ea2b7ca516745bfeafc49904b496089"},
+    // SP 800-38A, F.2.1, F.2.3 and F.2.5
+    {myaes::my_aes_128_cbc, "2b7e151628aed2a6abf7158809cf4f3c",
+     "000102030405060708090a0b0c0d0e0f",
+     "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+     "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+     "7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2"
+     "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7"},
+    {myaes::my_aes_192_cbc, "8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b",
+     "000102030405060708090a0b0c0d0e0f",
+     "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+     "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+     "4f021db243bc633d7178183a9fa071e8b4d9ada9ad7dedf4e5e738763f69145a"
+     "571b242012fb7ae07fa9baac3df102e008b0e27988598881d920a9e64f5615cd"},
+    {myaes::my_aes_256_cbc,
+     "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+     "000102030405060708090a0b0c0d0e0f",
+     "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+     "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+     "f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+     "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b"},
+};
+
+static bool is_cbc(myaes::my_aes_opmode mode) {
+  return mode == myaes::my_aes_128_cbc || mode == myaes::my_aes_192_cbc ||
+         mode == myaes::my_aes_256_cbc;
+}
+
+/**
+ * @test the instructions of the CPU, used by the YaSSL build
+ */
+TEST(AesHwTest, KnownAnswers) {
+  // nothing to test on CPUs without them
+  if (!AesHw::is_available()) return;
+
+  for (const AesVector &v : kAesVectors) {
+    SCOPED_TRACE(v.ciphertext);
+    const auto key = from_hex(v.key);
+    const auto plain = from_hex(v.plaintext);
+    const size_t num_blocks = plain.size() / MY_AES_BLOCK_SIZE;
+    std::vector<unsigned char> out(plain.size());
+
+    AesHw hw;
+    ASSERT_TRUE(hw.set_key(key.data(), static_cast<uint32_t>(key.size())));
+    if (is_cbc(v.mode)) {
+      auto iv = from_hex(v.iv);
+      hw.encrypt_cbc(out.data(), plain.data(), num_blocks, iv.data());
+      EXPECT_EQ(v.ciphertext, to_hex(out.data(), out.size()));
+
+      iv = from_hex(v.iv);
+      const auto cipher = from_hex(v.ciphertext);
+      hw.decrypt_cbc(out.data(), cipher.data(), num_blocks, iv.data());
+    } else {
+      hw.encrypt_ecb(out.data(), plain.data(), num_blocks);
+      EXPECT_EQ(v.ciphertext, to_hex(out.data(), out.size()));
+
+      const auto cipher = from_hex(v.ciphertext);
+      hw.decrypt_ecb(out.data(), cipher.data(), num_blocks);
+    }
+    EXPECT_EQ(v.plaintext, to_hex(out.data(), out.size()));
+  }
+}
+
+/**
+ * runs my_aes_encrypt() and my_aes_decrypt() with the instructions of the
+ * CPU enabled (if it has them) and with the software implementation.
+ */
+class MyAesTest : public ::testing::TestWithParam<bool> {
+ protected:
+  void SetUp() override { AesHw::set_enabled(GetParam()); }
+  void TearDown() override { AesHw::set_enabled(true); }
+};
+
+/**
+ * @test the keys have the size of the mode, they are used unchanged
+ */
+TEST_P(MyAesTest, KnownAnswers) {
+  for (const AesVector &v : kAesVectors) {
+    SCOPED_TRACE(v.ciphertext);
+    const auto key = from_hex(v.key);
+    const auto plain = from_hex(v.plaintext);
+    const auto cipher = from_hex(v.ciphertext);
+    const auto iv = v.iv ? from_hex(v.iv) : std::vector<unsigned char>();
+    std::vector<unsigned char> out(plain.size());
+
+    ASSERT_EQ(static_cast<int>(cipher.size()),
+              myaes::my_aes_encrypt(plain.data(),
+                                    static_cast<uint32_t>(plain.size()),
+                                    out.data(), key.data(),
+                                    static_cast<uint32_t>(key.size()), v.mode,
+                                    v.iv ? iv.data() : nullptr, false));
+    EXPECT_EQ(v.ciphertext, to_hex(out.data(), out.size()));
+
+    ASSERT_EQ(static_cast<int>(plain.size()),
+              myaes::my_aes_decrypt(cipher.data(),
+                                    static_cast<uint32_t>(cipher.size()),
+                                    out.data(), key.data(),
+                                    static_cast<uint32_t>(key.size()), v.mode,
+                                    v.iv ? iv.data() : nullptr, false));
+    EXPECT_EQ(v.plaintext, to_hex(out.data(), out.size()));
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Hardware, MyAesTest, ::testing::Values(true));
+INSTANTIATE_TEST_CASE_P(Software, MyAesTest, ::testing::Values(false));
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
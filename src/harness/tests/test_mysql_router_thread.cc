@@ -28,6 +28,10 @@
 
 #include "mysql_router_thread.h"
 
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 // this flag should be set to true by thread
 bool flag = false;
 
@@ -57,6 +61,78 @@ TEST_F(MySqlRouterThreadTest, DetachTreadCreated) {
   ASSERT_TRUE(flag);
 }
 
+TEST(CpuListTest, Parse) {
+  using mysql_harness::parse_cpu_list;
+
+  EXPECT_EQ(std::vector<unsigned>(), parse_cpu_list(""));
+  EXPECT_EQ(std::vector<unsigned>({0, 1, 2, 3, 8}), parse_cpu_list("0-3,8"));
+  EXPECT_EQ(std::vector<unsigned>({2, 3, 4}), parse_cpu_list(" 4, 2-3 ,3"));
+}
+
+TEST(CpuListTest, ParseInvalid) {
+  using mysql_harness::parse_cpu_list;
+
+  EXPECT_THROW(parse_cpu_list("a"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("-1"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("3-1"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("0-"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("0,,1"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("0,"), std::invalid_argument);
+  EXPECT_THROW(parse_cpu_list("1024"), std::invalid_argument);
+}
+
+#ifdef __linux__
+TEST(CpuListTest, PinsThread) {
+  cpu_set_t allowed;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  unsigned cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed)) ++cpu;
+
+  std::thread([cpu]() {
+    ASSERT_TRUE(mysql_harness::set_current_thread_cpu_affinity({cpu}));
+
+    cpu_set_t pinned;
+    ASSERT_EQ(0, pthread_getaffinity_np(pthread_self(), sizeof(pinned), &pinned));
+    EXPECT_EQ(1, CPU_COUNT(&pinned));
+    EXPECT_TRUE(CPU_ISSET(cpu, &pinned));
+  }).join();
+}
+
+#ifndef NDEBUG
+// fills 32KB of the stack, deeper than the margin the probe leaves
+static __attribute__((noinline)) void use_stack(volatile unsigned char *out) {
+  volatile unsigned char buf[32 * 1024];
+  for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = static_cast<unsigned char>(i);
+  *out = buf[sizeof(buf) / 2];
+}
+
+static size_t stack_used;
+static size_t stack_size;
+
+static void* measure_stack(void*) {
+  mysql_harness::StackUsageProbe probe;
+  stack_size = probe.size();
+  const size_t before = probe.max_used();
+
+  volatile unsigned char out;
+  use_stack(&out);
+  stack_used = probe.max_used();
+  // the probe leaves a margin below its caller unfilled
+  EXPECT_LE(before + 24 * 1024, stack_used);
+  return nullptr;
+}
+
+TEST(StackUsageProbeTest, MeasuresDepth) {
+  mysql_harness::MySQLRouterThread thread(mysql_harness::kDefaultConnectionStackSizeInKiloBytes);
+  thread.run(&measure_stack, nullptr);
+  thread.join();
+
+  EXPECT_LE(mysql_harness::kDefaultConnectionStackSizeInKiloBytes * 1024 / 2, stack_size);
+  EXPECT_LT(stack_used, stack_size);
+}
+#endif
+#endif
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
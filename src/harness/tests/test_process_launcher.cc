@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "process_launcher.h"
+
+#include <chrono>
+#include <string>
+#include <system_error>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::ProcessLauncher;
+
+#ifndef _WIN32
+
+/**
+ * @test
+ *       Verify that the output of a child can be read as it comes and its
+ *       exit code is returned once it exited.
+ */
+TEST(TestProcessLauncher, ReadsOutputAndExitCode) {
+  const char *args[] = {"sh", "-c", "echo hello; read line; echo \"$line\"; exit 3", nullptr};
+  ProcessLauncher launcher("sh", args);
+  launcher.start();
+
+  std::string output;
+  char buf[64];
+  while (output.find("hello\n") == std::string::npos) {
+    ASSERT_TRUE(launcher.wait_for_output_or_exit(5000));
+    const int n = launcher.read(buf, sizeof(buf), 0);
+    ASSERT_GE(n, 0);
+    output.append(buf, static_cast<size_t>(n));
+  }
+
+  launcher.write("world\n", 6);
+  EXPECT_EQ(3, launcher.wait(5000));
+
+  for (int n; (n = launcher.read(buf, sizeof(buf), 0)) > 0;)
+    output.append(buf, static_cast<size_t>(n));
+  EXPECT_EQ("hello\nworld\n", output);
+}
+
+/**
+ * @test
+ *       Verify that wait() times out while the child runs.
+ */
+TEST(TestProcessLauncher, WaitTimesOut) {
+  const char *args[] = {"sh", "-c", "sleep 10", nullptr};
+  ProcessLauncher launcher("sh", args);
+  launcher.start();
+
+  const auto started = std::chrono::steady_clock::now();
+  EXPECT_THROW(launcher.wait(50), std::system_error);
+  EXPECT_GE(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(50));
+}
+
+/**
+ * @test
+ *       Verify that starting a program that doesn't exist fails.
+ */
+TEST(TestProcessLauncher, StartFailsForMissingProgram) {
+  const char *args[] = {"mysqlrouter-does-not-exist", nullptr};
+  ProcessLauncher launcher("mysqlrouter-does-not-exist", args);
+
+  EXPECT_THROW(launcher.start(), std::system_error);
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/readiness.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::Readiness;
+
+class TestReadiness : public ::testing::Test {
+ protected:
+  void SetUp() override { Readiness::instance().clear(); }
+  void TearDown() override { Readiness::instance().clear(); }
+};
+
+TEST_F(TestReadiness, ReadyOnceAllReported) {
+  auto& readiness = Readiness::instance();
+  EXPECT_TRUE(readiness.is_ready());
+
+  readiness.expect("harness");
+  readiness.expect("routing:rw");
+  EXPECT_FALSE(readiness.is_ready());
+
+  readiness.report("harness", true);
+  EXPECT_FALSE(readiness.is_ready());
+
+  // expecting again doesn't reset the state
+  readiness.expect("harness");
+  readiness.report("routing:rw", true);
+  EXPECT_TRUE(readiness.is_ready());
+
+  const auto components = readiness.get_components();
+  ASSERT_EQ(2u, components.size());
+  EXPECT_TRUE(components.at("harness"));
+  EXPECT_TRUE(components.at("routing:rw"));
+
+  readiness.report("routing:rw", false);
+  EXPECT_FALSE(readiness.is_ready());
+
+  readiness.forget("routing:rw");
+  EXPECT_TRUE(readiness.is_ready());
+}
+
+TEST_F(TestReadiness, ListenersSeeChanges) {
+  auto& readiness = Readiness::instance();
+  std::vector<bool> changes;
+  readiness.add_listener([&changes](bool ready) { changes.push_back(ready); });
+
+  readiness.expect("a");
+  readiness.expect("b");
+  readiness.report("a", true);
+  readiness.report("b", true);
+  readiness.report("b", true);
+  readiness.report("a", false);
+
+  EXPECT_EQ(std::vector<bool>({false, true, false}), changes);
+
+  readiness.clear();
+  readiness.expect("a");
+  EXPECT_EQ(3u, changes.size());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
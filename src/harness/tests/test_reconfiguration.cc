@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/reconfiguration.h"
+#include "mysql/harness/config_parser.h"
+
+#include <memory>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::ConfigSection;
+using mysql_harness::Reconfiguration;
+
+TEST(TestReconfiguration, AppliesToHandlerOfSection) {
+  auto defaults = std::make_shared<ConfigSection>("default", "", nullptr);
+  ConfigSection section("routing", "ro", defaults);
+  section.add("max_connections", "100");
+  ConfigSection other("routing", "rw", defaults);
+
+  Reconfiguration& reconfiguration = Reconfiguration::instance();
+  EXPECT_FALSE(reconfiguration.apply(section));
+
+  std::string applied;
+  reconfiguration.set_handler("routing", "ro", [&applied](const ConfigSection& fresh) {
+    applied = fresh.get("max_connections");
+    return true;
+  });
+  EXPECT_TRUE(reconfiguration.apply(section));
+  EXPECT_EQ("100", applied);
+  EXPECT_FALSE(reconfiguration.apply(other));
+
+  reconfiguration.remove_handler("routing", "ro");
+  EXPECT_FALSE(reconfiguration.apply(section));
+}
+
+TEST(TestReconfiguration, HandlerDeclining) {
+  auto defaults = std::make_shared<ConfigSection>("default", "", nullptr);
+  ConfigSection section("routing", "", defaults);
+
+  Reconfiguration& reconfiguration = Reconfiguration::instance();
+  reconfiguration.set_handler("routing", "", [](const ConfigSection&) { return false; });
+  EXPECT_FALSE(reconfiguration.apply(section));
+
+  // a throwing handler means a restart too
+  reconfiguration.set_handler("routing", "", [](const ConfigSection&) -> bool {
+    throw std::invalid_argument("bad value");
+  });
+  EXPECT_FALSE(reconfiguration.apply(section));
+
+  reconfiguration.remove_handler("routing", "");
+}
+
+TEST(TestReconfiguration, ValidatesWithValidatorOfPlugin) {
+  auto defaults = std::make_shared<ConfigSection>("default", "", nullptr);
+  ConfigSection section("routing", "ro", defaults);
+  section.add("max_connections", "-1");
+  ConfigSection other("metadata_cache", "", defaults);
+
+  Reconfiguration& reconfiguration = Reconfiguration::instance();
+  std::string error;
+  EXPECT_TRUE(reconfiguration.validate(section, error));
+
+  reconfiguration.set_validator("routing", [](const ConfigSection& fresh) {
+    if (fresh.get("max_connections") == "-1")
+      throw std::invalid_argument("max_connections needs value between 0 and 65535");
+  });
+  EXPECT_FALSE(reconfiguration.validate(section, error));
+  EXPECT_EQ("max_connections needs value between 0 and 65535", error);
+  EXPECT_TRUE(reconfiguration.validate(other, error));
+
+  reconfiguration.remove_validator("routing");
+  EXPECT_TRUE(reconfiguration.validate(section, error));
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,188 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/networking/resolver_cache.h"
+
+////////////////////////////////////////
+// Third-party include files
+#include "gmock/gmock.h"
+
+////////////////////////////////////////
+// Standard include files
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#  include <arpa/inet.h>
+#  include <netdb.h>
+#  include <netinet/in.h>
+#endif
+
+using mysql_harness::ResolverCache;
+
+static ResolverCache::Address make_address(const char* ip, uint16_t port) {
+  ResolverCache::Address address;
+  memset(&address, 0, sizeof(address));
+
+  sockaddr_in* sin = reinterpret_cast<sockaddr_in*>(&address.addr);
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(port);
+  inet_pton(AF_INET, ip, &sin->sin_addr);
+
+  address.family = AF_INET;
+  address.socktype = SOCK_STREAM;
+  address.addrlen = static_cast<socklen_t>(sizeof(sockaddr_in));
+  return address;
+}
+
+static std::string get_ip(const ResolverCache::Addresses& addresses) {
+  if (addresses.empty()) return "";
+
+  char buf[INET_ADDRSTRLEN];
+  const sockaddr_in* sin = reinterpret_cast<const sockaddr_in*>(&addresses[0].addr);
+  return inet_ntop(AF_INET, &sin->sin_addr, buf, sizeof(buf));
+}
+
+class TestResolverCache : public ::testing::Test {
+ public:
+  // fake resolver returning result_ip_ or result_error_
+  ResolverCache::ResolveFunction get_resolve_function() {
+    return [this](const std::string&, uint16_t port, ResolverCache::Addresses& addresses) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      ++calls_;
+      if (result_error_ != 0) return result_error_;
+      addresses = { make_address(result_ip_.c_str(), port) };
+      return 0;
+    };
+  }
+
+  void set_result(const std::string& ip, int error) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    result_ip_ = ip;
+    result_error_ = error;
+  }
+
+  bool wait_for_calls(int calls) {
+    for (int i = 0; i < 500 && calls_ < calls; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return calls_ >= calls;
+  }
+
+  std::mutex mtx_;
+  std::atomic<int> calls_{0};
+  std::string result_ip_{"10.0.0.1"};
+  int result_error_{0};
+};
+
+TEST_F(TestResolverCache, CachesLookups) {
+  ResolverCache cache(std::chrono::seconds(60), std::chrono::seconds(60), get_resolve_function());
+
+  ResolverCache::Addresses addresses;
+  ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  EXPECT_EQ("10.0.0.1", get_ip(addresses));
+  ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  EXPECT_EQ("10.0.0.1", get_ip(addresses));
+  EXPECT_EQ(1, calls_);
+
+  // other port is another entry
+  ASSERT_EQ(0, cache.resolve("db1", 3307, addresses));
+  EXPECT_EQ(2, calls_);
+  EXPECT_EQ(2u, cache.size());
+}
+
+TEST_F(TestResolverCache, CachesFailures) {
+  ResolverCache cache(std::chrono::seconds(60), std::chrono::seconds(60), get_resolve_function());
+  set_result("", EAI_NONAME);
+
+  ResolverCache::Addresses addresses;
+  EXPECT_EQ(EAI_NONAME, cache.resolve("db1", 3306, addresses));
+  EXPECT_EQ(EAI_NONAME, cache.resolve("db1", 3306, addresses));
+  EXPECT_TRUE(addresses.empty());
+  EXPECT_EQ(1, calls_);
+}
+
+TEST_F(TestResolverCache, RefreshesExpiredInBackground) {
+  ResolverCache cache(std::chrono::milliseconds(20), std::chrono::milliseconds(20), get_resolve_function());
+
+  ResolverCache::Addresses addresses;
+  ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // the stale address is returned while the name is resolved again
+  set_result("10.0.0.2", 0);
+  ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  EXPECT_EQ("10.0.0.1", get_ip(addresses));
+  ASSERT_TRUE(wait_for_calls(2));
+
+  for (int i = 0; i < 500 && get_ip(addresses) != "10.0.0.2"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  }
+  EXPECT_EQ("10.0.0.2", get_ip(addresses));
+}
+
+TEST_F(TestResolverCache, KeepsAddressesIfRefreshFails) {
+  ResolverCache cache(std::chrono::milliseconds(20), std::chrono::seconds(60), get_resolve_function());
+
+  ResolverCache::Addresses addresses;
+  ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  set_result("", EAI_AGAIN);
+  ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+  ASSERT_TRUE(wait_for_calls(2));
+
+  // the failure is retried only after the negative TTL
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(0, cache.resolve("db1", 3306, addresses));
+    EXPECT_EQ("10.0.0.1", get_ip(addresses));
+  }
+  EXPECT_EQ(2, calls_);
+}
+
+TEST_F(TestResolverCache, GetaddrinfoResolve) {
+  ResolverCache::Addresses addresses;
+  ASSERT_EQ(0, ResolverCache::getaddrinfo_resolve("127.0.0.1", 3306, addresses));
+  ASSERT_FALSE(addresses.empty());
+  EXPECT_EQ(AF_INET, addresses[0].family);
+  EXPECT_EQ("127.0.0.1", get_ip(addresses));
+  EXPECT_EQ(htons(3306), reinterpret_cast<const sockaddr_in*>(&addresses[0].addr)->sin_port);
+}
+
+int main(int argc, char *argv[]) {
+#ifdef _WIN32
+  WSADATA wsaData;
+  int iResult;
+  iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
+  if (iResult != 0) {
+    std::cout << "WSAStartup() failed\n";
+    return 1;
+  }
+#endif
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/ring_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::mpmc_queue;
+using mysql_harness::spsc_queue;
+using std::chrono::milliseconds;
+
+template <class Queue>
+class TestRingQueue : public ::testing::Test {};
+
+using RingQueues = ::testing::Types<mpmc_queue<std::string>, spsc_queue<std::string>>;
+TYPED_TEST_CASE(TestRingQueue, RingQueues);
+
+TYPED_TEST(TestRingQueue, PushPop) {
+  TypeParam queue(3);
+  EXPECT_EQ(4u, queue.capacity());
+  EXPECT_TRUE(queue.empty());
+
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(queue.try_push(std::to_string(i)));
+
+    std::string rejected("4");
+    EXPECT_FALSE(queue.try_push(std::move(rejected)));
+    EXPECT_EQ("4", rejected);  // not moved from
+    EXPECT_EQ(4u, queue.size());
+
+    std::string value;
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(queue.try_pop(&value));
+      EXPECT_EQ(std::to_string(i), value);
+    }
+    EXPECT_FALSE(queue.try_pop(&value));
+    EXPECT_FALSE(queue.pop(&value, milliseconds(10)));
+  }
+}
+
+TYPED_TEST(TestRingQueue, PopWaitsForPush) {
+  TypeParam queue(4);
+
+  std::thread consumer([&queue]() {
+    std::string value;
+    EXPECT_TRUE(queue.pop(&value));
+    EXPECT_EQ("47", value);
+  });
+  std::this_thread::sleep_for(milliseconds(10));
+  queue.push("47");
+  consumer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+TYPED_TEST(TestRingQueue, PushWaitsForPop) {
+  TypeParam queue(2);
+  queue.push("0");
+  queue.push("1");
+
+  std::thread producer([&queue]() { queue.push("2"); });
+  std::this_thread::sleep_for(milliseconds(10));
+
+  std::string value;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(queue.pop(&value, milliseconds(10000)));
+    EXPECT_EQ(std::to_string(i), value);
+  }
+  producer.join();
+}
+
+TEST(TestMpmcQueue, DestroysQueuedElements) {
+  auto element = std::make_shared<int>(1);
+  {
+    mpmc_queue<std::shared_ptr<int>> queue(4);
+    queue.push(element);
+    queue.push(element);
+    EXPECT_EQ(3, element.use_count());
+  }
+  EXPECT_EQ(1, element.use_count());
+}
+
+TEST(TestSpscQueue, KeepsOrder) {
+  spsc_queue<int> queue(16);
+  const int kElements = 100000;
+
+  std::thread producer([&queue]() {
+    for (int i = 0; i < kElements; ++i)
+      queue.push(i);
+  });
+
+  int value;
+  for (int i = 0; i < kElements; ++i) {
+    ASSERT_TRUE(queue.pop(&value));
+    ASSERT_EQ(i, value);
+  }
+  producer.join();
+}
+
+TEST(TestMpmcQueue, ProducersConsumers) {
+  mpmc_queue<int> queue(64);
+  const int kProducers = 4;
+  const int kConsumers = 4;
+  const int kElementsPerProducer = 20000;
+
+  std::vector<std::atomic<int>> seen(kProducers * kElementsPerProducer);
+  for (auto& count : seen)
+    count = 0;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p) {
+    threads.emplace_back([&queue, p]() {
+      for (int i = 0; i < kElementsPerProducer; ++i)
+        queue.push(p * kElementsPerProducer + i);
+    });
+  }
+  for (int c = 0; c < kConsumers; ++c) {
+    threads.emplace_back([&queue, &seen]() {
+      int value;
+      for (int i = 0; i < kProducers * kElementsPerProducer / kConsumers; ++i) {
+        ASSERT_TRUE(queue.pop(&value));
+        ++seen[static_cast<size_t>(value)];
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (auto& count : seen)
+    ASSERT_EQ(1, count);
+  EXPECT_TRUE(queue.empty());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
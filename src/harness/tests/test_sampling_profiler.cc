@@ -0,0 +1,108 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/sampling_profiler.h"
+
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::SamplingProfiler;
+
+namespace {
+
+uint64_t burn_cpu(std::chrono::milliseconds duration) {
+  const auto until = std::chrono::steady_clock::now() + duration;
+  volatile uint64_t sum = 0;
+  while (std::chrono::steady_clock::now() < until) {
+    for (int i = 0; i < 1000; ++i) sum += static_cast<uint64_t>(i);
+  }
+  return sum;
+}
+
+}  // namespace
+
+TEST(TestSamplingProfiler, RejectsInvalidArguments) {
+  auto& profiler = SamplingProfiler::instance();
+
+  EXPECT_THROW(profiler.start(std::chrono::milliseconds(0), 99), std::invalid_argument);
+  EXPECT_THROW(profiler.start(SamplingProfiler::kMaxDuration + std::chrono::seconds(1), 99),
+               std::invalid_argument);
+  EXPECT_THROW(profiler.start(std::chrono::seconds(1), 0), std::invalid_argument);
+  EXPECT_THROW(profiler.start(std::chrono::seconds(1), SamplingProfiler::kMaxFrequency + 1),
+               std::invalid_argument);
+  EXPECT_FALSE(profiler.is_running());
+}
+
+TEST(TestSamplingProfiler, FoldsTheStacks) {
+  if (!SamplingProfiler::is_supported()) return;
+  auto& profiler = SamplingProfiler::instance();
+
+  profiler.start(std::chrono::seconds(10), 1000);
+  EXPECT_TRUE(profiler.is_running());
+  EXPECT_THROW(profiler.start(std::chrono::seconds(10), 1000), std::logic_error);
+
+  burn_cpu(std::chrono::milliseconds(200));
+  profiler.stop();
+  EXPECT_FALSE(profiler.is_running());
+  ASSERT_TRUE(profiler.has_profile());
+
+  const std::string folded = profiler.get_folded_stacks();
+  ASSERT_FALSE(folded.empty());
+  EXPECT_EQ(0u, profiler.get_lost_samples());
+
+  // "outer;inner count" per line
+  std::istringstream lines(folded);
+  std::string line;
+  uint64_t samples = 0;
+  while (std::getline(lines, line)) {
+    const size_t space = line.rfind(' ');
+    ASSERT_NE(std::string::npos, space) << line;
+    EXPECT_LT(0u, space) << line;
+    samples += std::stoull(line.substr(space + 1));
+  }
+  // 1000 Hz of 200ms CPU time, with a lot of slack for slow machines
+  EXPECT_LE(10u, samples);
+}
+
+TEST(TestSamplingProfiler, StopsAfterDuration) {
+  if (!SamplingProfiler::is_supported()) return;
+  auto& profiler = SamplingProfiler::instance();
+
+  profiler.start(std::chrono::milliseconds(50), 99);
+  const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (profiler.is_running() && std::chrono::steady_clock::now() < until) {
+    burn_cpu(std::chrono::milliseconds(10));
+  }
+  EXPECT_FALSE(profiler.is_running());
+  EXPECT_TRUE(profiler.has_profile());
+
+  // stopping a stopped profiler does nothing
+  profiler.stop();
+  EXPECT_TRUE(profiler.has_profile());
+}
@@ -0,0 +1,138 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/networking/socket_endpoint.h"
+
+#ifndef _WIN32
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include <cstring>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::SocketEndpoint;
+
+static sockaddr_storage make_ipv4(const char *addr, uint16_t port) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  auto *sin4 = reinterpret_cast<sockaddr_in *>(&ss);
+  sin4->sin_family = AF_INET;
+  sin4->sin_port = htons(port);
+  inet_pton(AF_INET, addr, &sin4->sin_addr);
+  return ss;
+}
+
+static sockaddr_storage make_ipv6(const char *addr, uint16_t port) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  auto *sin6 = reinterpret_cast<sockaddr_in6 *>(&ss);
+  sin6->sin6_family = AF_INET6;
+  sin6->sin6_port = htons(port);
+  inet_pton(AF_INET6, addr, &sin6->sin6_addr);
+  return ss;
+}
+
+TEST(TestSocketEndpoint, Default) {
+  SocketEndpoint endpoint;
+
+  EXPECT_EQ(SocketEndpoint::Family::kNone, endpoint.family());
+  EXPECT_EQ(0, endpoint.port());
+  EXPECT_EQ("", endpoint.str());
+}
+
+TEST(TestSocketEndpoint, IPv4) {
+  SocketEndpoint endpoint(make_ipv4("192.168.14.1", 3306));
+
+  EXPECT_TRUE(endpoint.is_ipv4());
+  EXPECT_EQ(3306, endpoint.port());
+  EXPECT_EQ("192.168.14.1", endpoint.address_str());
+  EXPECT_EQ("192.168.14.1:3306", endpoint.str());
+
+  const SocketEndpoint::Bytes expected{{192, 168, 14, 1}};
+  EXPECT_EQ(expected, endpoint.address_bytes());
+}
+
+TEST(TestSocketEndpoint, IPv6) {
+  SocketEndpoint endpoint(make_ipv6("fe80::6e40:8ff:fea2:5d7e", 13306));
+
+  EXPECT_TRUE(endpoint.is_ipv6());
+  EXPECT_EQ(13306, endpoint.port());
+  EXPECT_EQ("fe80::6e40:8ff:fea2:5d7e", endpoint.address_str());
+  EXPECT_EQ("fe80::6e40:8ff:fea2:5d7e:13306", endpoint.str());
+}
+
+#ifndef _WIN32
+TEST(TestSocketEndpoint, Local) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  ss.ss_family = AF_UNIX;
+  SocketEndpoint endpoint(ss);
+
+  EXPECT_TRUE(endpoint.is_local());
+  EXPECT_EQ(0, endpoint.port());
+  EXPECT_EQ("unix socket", endpoint.str());
+}
+#endif
+
+TEST(TestSocketEndpoint, CompareAndHash) {
+  SocketEndpoint a(make_ipv4("127.0.0.1", 3306));
+  SocketEndpoint b(make_ipv4("127.0.0.1", 3306));
+  SocketEndpoint other_port(make_ipv4("127.0.0.1", 3307));
+  SocketEndpoint other_addr(make_ipv4("127.0.0.2", 3306));
+  SocketEndpoint ipv6(make_ipv6("::1", 3306));
+
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_NE(a, other_port);
+  EXPECT_NE(a, other_addr);
+  EXPECT_NE(a, ipv6);
+
+  std::unordered_set<SocketEndpoint> endpoints{a, b, other_port, other_addr, ipv6};
+  EXPECT_EQ(4u, endpoints.size());
+}
+
+#ifndef _WIN32
+TEST(TestSocketEndpoint, PeerOf) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  EXPECT_TRUE(SocketEndpoint::peer_of(fds[0]).is_local());
+
+  close(fds[0]);
+  close(fds[1]);
+
+  EXPECT_EQ(SocketEndpoint::Family::kNone, SocketEndpoint::peer_of(-1).family());
+}
+#endif
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "socket_operations.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using mysql_harness::SocketOperations;
+using mysql_harness::SocketOperationsStats;
+
+#ifndef _WIN32
+class TestSocketOperationsStats : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+    ASSERT_EQ(0, fcntl(fds_[0], F_SETFL, fcntl(fds_[0], F_GETFL) | O_NONBLOCK));
+    SocketOperations::set_stats_enabled(true);
+  }
+
+  void TearDown() override {
+    SocketOperations::set_stats_enabled(false);
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+  SocketOperations *so_ = SocketOperations::instance();
+  int fds_[2];
+};
+
+TEST_F(TestSocketOperationsStats, CountsTransfers) {
+  const SocketOperationsStats before = SocketOperations::get_stats();
+
+  char buf[16] = "hello";
+  EXPECT_EQ(5, so_->write(fds_[1], buf, 5));
+  EXPECT_EQ(5, so_->read(fds_[0], buf, sizeof(buf)));
+  // nothing left to read
+  EXPECT_EQ(-1, so_->read(fds_[0], buf, sizeof(buf)));
+
+  const SocketOperationsStats after = SocketOperations::get_stats();
+  EXPECT_EQ(before.write.calls + 1, after.write.calls);
+  EXPECT_EQ(before.write.bytes + 5, after.write.bytes);
+  EXPECT_EQ(before.read.calls + 2, after.read.calls);
+  EXPECT_EQ(before.read.bytes + 5, after.read.bytes);
+  EXPECT_EQ(before.read.would_block + 1, after.read.would_block);
+  EXPECT_EQ(before.read.errors, after.read.errors);
+}
+
+TEST_F(TestSocketOperationsStats, CountsPollTimeouts) {
+  const SocketOperationsStats before = SocketOperations::get_stats();
+
+  struct pollfd fds[] = {
+    { fds_[0], POLLIN, 0 },
+  };
+  EXPECT_EQ(0, so_->poll(fds, 1, std::chrono::milliseconds(0)));
+
+  const SocketOperationsStats after = SocketOperations::get_stats();
+  EXPECT_EQ(before.poll.calls + 1, after.poll.calls);
+  EXPECT_EQ(before.poll.timeouts + 1, after.poll.timeouts);
+}
+
+TEST_F(TestSocketOperationsStats, SumsThreads) {
+  const SocketOperationsStats before = SocketOperations::get_stats();
+
+  char buf[1] = {'x'};
+  std::thread writer([&]() { so_->write(fds_[1], buf, 1); });
+  writer.join();
+  so_->write(fds_[1], buf, 1);
+
+  EXPECT_EQ(before.write.bytes + 2, SocketOperations::get_stats().write.bytes);
+}
+
+TEST_F(TestSocketOperationsStats, NothingCountedWhenDisabled) {
+  SocketOperations::set_stats_enabled(false);
+  const SocketOperationsStats before = SocketOperations::get_stats();
+
+  char buf[1] = {'x'};
+  EXPECT_EQ(1, so_->write(fds_[1], buf, 1));
+  EXPECT_EQ(1, so_->read(fds_[0], buf, 1));
+
+  const SocketOperationsStats after = SocketOperations::get_stats();
+  EXPECT_EQ(before.write.calls, after.write.calls);
+  EXPECT_EQ(before.read.calls, after.read.calls);
+}
+#endif
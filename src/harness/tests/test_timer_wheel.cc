@@ -0,0 +1,165 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysql/harness/timer_wheel.h"
+
+#include <algorithm>
+#include <random>
+
+#include "gtest/gtest.h"
+
+using mysql_harness::TimerWheel;
+using std::chrono::milliseconds;
+using clock_type = TimerWheel<int>::clock_type;
+
+static std::vector<int> sorted(std::vector<int> timers) {
+  std::sort(timers.begin(), timers.end());
+  return timers;
+}
+
+/**
+ * @test
+ *       Verify that timers expire with the first tick after their deadline,
+ *       not before.
+ */
+TEST(TestTimerWheel, Expires) {
+  const auto start = clock_type::now();
+  TimerWheel<int> wheel(milliseconds(10), 8, 2, start);
+
+  wheel.schedule(1, start + milliseconds(15));
+  wheel.schedule(2, start + milliseconds(20));
+  wheel.schedule(3, start + milliseconds(35));
+  EXPECT_EQ(3u, wheel.size());
+
+  EXPECT_TRUE(wheel.expire(start + milliseconds(14)).empty());
+  EXPECT_TRUE(wheel.expire(start + milliseconds(19)).empty());
+  EXPECT_EQ(std::vector<int>({1, 2}), sorted(wheel.expire(start + milliseconds(20))));
+  EXPECT_TRUE(wheel.expire(start + milliseconds(39)).empty());
+  EXPECT_EQ(std::vector<int>({3}), wheel.expire(start + milliseconds(40)));
+  EXPECT_EQ(0u, wheel.size());
+}
+
+/**
+ * @test
+ *       Verify that deadlines more than a turn ahead stay scheduled until
+ *       they are due, and skipped turns don't skip timers.
+ */
+TEST(TestTimerWheel, LongDeadlines) {
+  const auto start = clock_type::now();
+  // a single level, its turn is 40ms
+  TimerWheel<int> wheel(milliseconds(10), 4, 1, start);
+
+  wheel.schedule(1, start + milliseconds(95));
+  wheel.schedule(2, start + milliseconds(15));
+  EXPECT_TRUE(wheel.expire(start + milliseconds(10)).empty());
+  EXPECT_EQ(std::vector<int>({2}), wheel.expire(start + milliseconds(55)));
+  EXPECT_TRUE(wheel.expire(start + milliseconds(94)).empty());
+
+  // expire() not called for several turns
+  EXPECT_EQ(std::vector<int>({1}), wheel.expire(start + milliseconds(500)));
+
+  // deadlines passed already expire with the next tick
+  wheel.schedule(3, start);
+  EXPECT_TRUE(wheel.expire(start + milliseconds(505)).empty());
+  EXPECT_EQ(std::vector<int>({3}), wheel.expire(start + milliseconds(510)));
+}
+
+/**
+ * @test
+ *       Verify that cancelled timers don't expire and rescheduling replaces
+ *       the deadline.
+ */
+TEST(TestTimerWheel, CancelAndReschedule) {
+  const auto start = clock_type::now();
+  TimerWheel<int> wheel(milliseconds(10), 8, 2, start);
+
+  for (int timer = 0; timer < 5; ++timer) {
+    wheel.schedule(timer, start + milliseconds(20));
+  }
+  EXPECT_TRUE(wheel.cancel(1));
+  EXPECT_FALSE(wheel.cancel(1));
+  EXPECT_TRUE(wheel.cancel(4));
+  wheel.schedule(2, start + milliseconds(40));
+
+  EXPECT_EQ(std::vector<int>({0, 3}), sorted(wheel.expire(start + milliseconds(30))));
+  EXPECT_EQ(std::vector<int>({2}), wheel.expire(start + milliseconds(40)));
+  EXPECT_EQ(0u, wheel.size());
+}
+
+/**
+ * @test
+ *       Verify that timers in the upper levels move down and expire with
+ *       the tick of their deadline, like the ones scheduled in between.
+ */
+TEST(TestTimerWheel, Cascades) {
+  const auto start = clock_type::now();
+  // turns of 40ms, 160ms and 640ms
+  TimerWheel<int> wheel(milliseconds(10), 4, 3, start);
+
+  std::mt19937 rng(1);
+  std::vector<std::vector<int>> due(200);
+  for (int timer = 0; timer < 500; ++timer) {
+    const size_t tick = rng() % due.size();
+    wheel.schedule(timer, start + milliseconds(10 * static_cast<int>(tick)));
+    due[tick].push_back(timer);
+  }
+
+  for (size_t tick = 0; tick < due.size(); ++tick) {
+    const auto now = start + milliseconds(10 * static_cast<int>(tick));
+    if (tick == 100) {
+      // scheduled while the others move down
+      wheel.schedule(1000, now + milliseconds(455));
+      due[tick + 46].push_back(1000);
+    }
+    // the wheel is expected to be woken up no later than its timers are due
+    if (!due[tick].empty()) {
+      EXPECT_LE(wheel.next_expiry(), now) << tick;
+    }
+    EXPECT_EQ(sorted(due[tick]), sorted(wheel.expire(now))) << tick;
+  }
+  EXPECT_EQ(0u, wheel.size());
+  EXPECT_EQ(clock_type::time_point::max(), wheel.next_expiry());
+}
+
+/**
+ * @test
+ *       Verify that next_expiry() tells the first tick with a timer, or the
+ *       turn timers move down with.
+ */
+TEST(TestTimerWheel, NextExpiry) {
+  const auto start = clock_type::now();
+  TimerWheel<int> wheel(milliseconds(10), 4, 3, start);
+
+  wheel.schedule(1, start + milliseconds(25));
+  EXPECT_EQ(start + milliseconds(30), wheel.next_expiry());
+
+  // in the second level, moves down with the turn starting at 160ms
+  wheel.cancel(1);
+  wheel.schedule(2, start + milliseconds(175));
+  EXPECT_EQ(start + milliseconds(160), wheel.next_expiry());
+  EXPECT_TRUE(wheel.expire(start + milliseconds(165)).empty());
+  EXPECT_EQ(start + milliseconds(180), wheel.next_expiry());
+  EXPECT_EQ(std::vector<int>({2}), wheel.expire(start + milliseconds(180)));
+}
@@ -30,7 +30,9 @@
 #include <ctime>
 #include <memory>
 #include <functional>  // std::function
+#include <string>
 #include <vector>
+#include <stdexcept>
 #include <bitset>
 
 struct evhttp_uri;
@@ -207,6 +209,11 @@ public:
    * get path part of the URI.
    */
   std::string get_path() const;
+
+  /**
+   * get query part of the URI, empty if it has none.
+   */
+  std::string get_query() const;
 private:
   struct impl;
 
@@ -239,6 +246,11 @@ public:
    */
   void add_file(int file_fd, off_t offset, off_t size);
 
+  /**
+   * send files added later with sendfile() instead of mmap()ing them.
+   */
+  void set_drains_to_fd();
+
   /**
    * get length of buffer.
    */
@@ -342,6 +354,17 @@ public:
    * @throws  std::runtime_error on internal, unexpected error
    */
   bool dispatch();
+
+  /**
+   * wait for at least one event to fire and call its handlers.
+   *
+   * unlike dispatch() it returns even if events stay pending, like
+   * the reads of idle keep-alive connections.
+   *
+   * @returns false if no events were pending nor active, true otherwise
+   * @throws  std::runtime_error on internal, unexpected error
+   */
+  bool dispatch_once();
 private:
   class impl;
 
@@ -379,13 +402,54 @@ public:
     send_reply(status_code, HttpStatusCode::get_default_status_text(status_code));
   }
   void send_reply(int status_code, std::string status_text);
+  /**
+   * send a reply with a body.
+   *
+   * the body gets compressed if the client accepts gzip or deflate, the
+   * Content-Type is compressible and no Content-Encoding is set yet.
+   */
   void send_reply(int status_code, std::string status_text, HttpBuffer &buffer);
 
+  /**
+   * enable or disable compressing the reply.
+   *
+   * enabled by default. Disable it for bodies that shouldn't be copied
+   * into memory, like files sent with sendfile().
+   */
+  void set_reply_compression(bool enabled);
+
   void send_error(int status_code) {
     send_error(status_code, HttpStatusCode::get_default_status_text(status_code));
   }
   void send_error(int status_code, std::string status_text);
 
+  /**
+   * start a chunked reply.
+   *
+   * sends the status line and the output headers, the body follows with
+   * send_reply_chunk() and ends with send_reply_end().
+   *
+   * the chunks get compressed like the body of send_reply().
+   */
+  void send_reply_start(int status_code, std::string status_text);
+
+  /**
+   * send a chunk of a reply started with send_reply_start().
+   *
+   * moves the content out of the buffer.
+   */
+  void send_reply_chunk(HttpBuffer &chunk);
+
+  /**
+   * @overload
+   */
+  void send_reply_chunk(const char *data, size_t data_size);
+
+  /**
+   * end a reply started with send_reply_start().
+   */
+  void send_reply_end();
+
   static void sync_callback(HttpRequest *, void *);
 
   operator bool();
@@ -405,6 +469,40 @@ public:
    * add a Last-Modified-Since header to the response headers.
    */
   bool add_last_modified(time_t last_modified);
+
+  /**
+   * does the If-None-Match header not list 'etag'.
+   *
+   * weak and strong entity-tags compare the same, a '*' matches any.
+   *
+   * @param etag opaque entity-tag of the local content, without quotes
+   * @return true, if the client has no copy of the local content, false otherwise
+   */
+  bool is_none_match(const std::string &etag);
+
+  /**
+   * add an ETag header to the response headers.
+   *
+   * @param etag opaque entity-tag without quotes
+   */
+  void add_etag(const std::string &etag);
+
+  /**
+   * hold back partial TCP segments until the reply is sent.
+   *
+   * lets the headers and the start of a file sent with sendfile() share
+   * segments. Sets TCP_CORK on the connection until the request completes.
+   *
+   * @return false, if not supported on the platform or connection
+   */
+  bool cork_until_sent();
+
+  /**
+   * numeric address of the peer which sent the request.
+   *
+   * @return the address, empty if the request has no connection
+   */
+  std::string get_peer_address() const;
 private:
   class impl;
 
@@ -413,6 +511,50 @@ private:
   friend class HttpClient;
 };
 
+/**
+ * output stream of a chunked reply.
+ *
+ * collects the output until flush_size bytes are pending and sends them as
+ * one chunk. Has the interface of a rapidjson output stream, to let a
+ * rapidjson::Writer stream its JSON into the reply.
+ *
+ * the reply has to be started with HttpRequest::send_reply_start(), the
+ * caller ends it with HttpRequest::send_reply_end() after the last Flush().
+ */
+class HTTP_COMMON_EXPORT HttpChunkedStream {
+public:
+  using Ch = char;
+
+  static constexpr size_t kDefaultFlushSize = 16 * 1024;
+
+  HttpChunkedStream(HttpRequest &req, size_t flush_size = kDefaultFlushSize):
+    req_(req), flush_size_(flush_size)
+  {
+    buf_.reserve(flush_size_);
+  }
+
+  void Put(Ch c) {
+    buf_.push_back(c);
+    if (buf_.size() >= flush_size_) Flush();
+  }
+
+  /**
+   * send the pending output as chunk.
+   */
+  void Flush();
+private:
+  HttpRequest &req_;
+  const size_t flush_size_;
+  std::string buf_;
+};
+
+/**
+ * is the address a numeric loopback address, in 127.0.0.0/8 or ::1.
+ *
+ * IPv4-mapped IPv6 addresses are checked like their IPv4 address.
+ */
+HTTP_COMMON_EXPORT bool is_loopback_address(const std::string &address);
+
 // http_time.cc
 
 /**
@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQLROUTER_HTTP_COMPRESSION_INCLUDED
+#define MYSQLROUTER_HTTP_COMPRESSION_INCLUDED
+
+#include "mysqlrouter/http_common_export.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * content-codings of a HTTP message body.
+ */
+enum class HttpContentEncoding {
+  Identity,
+  Gzip,
+  Deflate,
+};
+
+/**
+ * streaming compressor of a HTTP message body.
+ *
+ * wraps zlib. Without zlib only Identity is negotiated and nothing gets
+ * compressed.
+ */
+class HTTP_COMMON_EXPORT HttpCompressor {
+public:
+  /**
+   * replies smaller than this aren't worth compressing.
+   */
+  static constexpr size_t kMinCompressSize = 256;
+
+  /**
+   * @throws std::invalid_argument if encoding isn't supported
+   */
+  explicit HttpCompressor(HttpContentEncoding encoding);
+  ~HttpCompressor();
+
+  /**
+   * compress data and append it to out.
+   *
+   * what got appended can be decompressed as it is, which allows to
+   * send it as chunk.
+   */
+  void update(const char *data, size_t data_size, std::string &out);
+
+  /**
+   * append the end of the compressed stream to out.
+   */
+  void finish(std::string &out);
+
+  /**
+   * compress a whole body.
+   */
+  static std::string compress(HttpContentEncoding encoding, const char *data, size_t data_size);
+
+  /**
+   * check if a content-coding is supported.
+   */
+  static bool is_supported(HttpContentEncoding encoding);
+
+  /**
+   * pick the content-coding from the value of a Accept-Encoding header.
+   *
+   * prefers gzip over deflate if both are accepted with the same q-value.
+   *
+   * @param accept_encoding value of the header, nullptr if not sent
+   * @returns supported content-coding accepted by the client, Identity if none
+   */
+  static HttpContentEncoding negotiate(const char *accept_encoding);
+
+  /**
+   * name of a content-coding as used in Content-Encoding.
+   */
+  static const char *content_coding_name(HttpContentEncoding encoding);
+
+  /**
+   * check if a Content-Type is worth compressing.
+   *
+   * images, archives, ... are already compressed.
+   */
+  static bool is_compressible_type(const char *content_type);
+private:
+  struct impl;
+
+  std::unique_ptr<impl> pImpl_;
+};
+
+#endif
@@ -39,6 +39,18 @@ public:
 
   virtual void handle_request(HttpRequest &req) = 0;
 
+  /**
+   * cheap version of the resource a GET or HEAD request is for.
+   *
+   * used as entity-tag: if the client's If-None-Match lists it, the server
+   * answers with 304 Not Modified without calling handle_request().
+   *
+   * @param req request
+   * @param etag entity-tag of the current content, without quotes
+   * @return false, if the resource has no cheap version, true otherwise
+   */
+  virtual bool get_etag(HttpRequest &req, std::string &etag);
+
   virtual ~BaseRequestHandler();
 };
 
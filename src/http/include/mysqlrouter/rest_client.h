@@ -26,12 +26,43 @@
 
 #include "mysqlrouter/http_client.h"
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * client of a REST API.
+ *
+ * requests go over keep-alive connections which stay open between the
+ * requests. Requests made with request() are spread over the connections
+ * and answered while the event loop of the IOContext runs, e.g. in
+ * wait_all().
+ */
 class HTTP_CLIENT_EXPORT RestClient {
 public:
-  RestClient(IOContext &io_ctx, const std::string &address, uint16_t port):
-    http_client_{io_ctx, address, port},
-    hostname_{address}
-  {}
+  /**
+   * called with the answered (or failed) request.
+   *
+   * the request is only valid while the handler runs. The handler is
+   * called from the event loop and must not throw.
+   */
+  using ResponseHandler = std::function<void(HttpRequest &)>;
+
+  /**
+   * @param io_ctx event loop of the connections
+   * @param address host to connect to
+   * @param port port to connect to
+   * @param connections number of connections the requests are spread over
+   */
+  RestClient(IOContext &io_ctx, const std::string &address, uint16_t port, size_t connections = 1);
+
+  /**
+   * destruct the client.
+   *
+   * requests still pending are dropped without calling their handlers.
+   */
+  ~RestClient();
 
   HttpRequest request_sync(
       HttpMethod::type method,
@@ -39,9 +70,51 @@ public:
       const std::string &request_body = {},
       const std::string &content_type = "application/json");
 
+  /**
+   * queue a request on the least busy connection.
+   *
+   * @param method HTTP method
+   * @param uri URI to request
+   * @param handler called once the request is answered or failed
+   * @param request_body body of the request
+   * @param content_type Content-Type of the request-body
+   */
+  void request(
+      HttpMethod::type method,
+      const std::string &uri,
+      ResponseHandler handler,
+      const std::string &request_body = {},
+      const std::string &content_type = "application/json");
+
+  /**
+   * run the event loop until all queued requests are answered.
+   *
+   * call before the RestClient gets destructed to get all handlers called.
+   */
+  void wait_all();
+
+  /**
+   * number of queued requests not answered yet.
+   */
+  size_t pending() const { return pending_; }
+
 private:
-  HttpClient http_client_;
+  struct PendingRequest;
+
+  static void on_response(HttpRequest *req, void *arg);
+
+  void prepare_request(HttpRequest &req, HttpMethod::type method,
+      const std::string &request_body, const std::string &content_type);
+
+  // connection with the fewest requests in flight
+  size_t select_connection() const;
+
+  IOContext &io_ctx_;
+  std::vector<std::unique_ptr<HttpClient>> http_clients_;
+  std::vector<size_t> in_flight_;
   std::string hostname_;
+  size_t pending_ { 0 };
+  std::vector<PendingRequest *> pending_requests_;
 };
 
 #endif
@@ -56,6 +56,17 @@ bool IOContext::dispatch() {
   return ret == 0;
 }
 
+bool IOContext::dispatch_once() {
+  int ret = event_base_loop(pImpl_->ev_base.get(), EVLOOP_ONCE);
+
+  if (ret == -1) {
+    // we don't have an better error here
+    throw std::runtime_error("event_base_loop() error");
+  }
+
+  return ret == 0;
+}
+
 IOContext::~IOContext() = default;
 
 
@@ -94,7 +105,10 @@ void HttpClient::make_request(HttpRequest *req, HttpMethod::type method, const s
 void HttpClient::make_request_sync(HttpRequest *req, HttpMethod::type method, const std::string &uri) {
   make_request(req, method, uri);
 
-  io_ctx_.dispatch();
+  // a keep-alive connection stays pending after the response, only
+  // wait for this request
+  while (!req->pImpl_->completed && io_ctx_.dispatch_once()) {
+  }
 }
 
 
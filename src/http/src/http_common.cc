@@ -26,9 +26,19 @@
  * API Facade around libevent's http interface
  */
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <new>  // std::bad_alloc
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
 
 #include <event2/buffer.h>
+#include <event2/bufferevent.h>
 #include <event2/event.h>
 #include <event2/http.h>
 #include <event2/util.h>
@@ -64,6 +74,12 @@ std::string HttpUri::get_path() const {
   return evhttp_uri_get_path(pImpl_->uri.get());
 }
 
+std::string HttpUri::get_query() const {
+  const char *query = evhttp_uri_get_query(pImpl_->uri.get());
+
+  return query == nullptr ? std::string() : query;
+}
+
 
 // wrap evbuffer
 
@@ -84,6 +100,10 @@ void HttpBuffer::add_file(int file_fd, off_t offset, off_t size) {
   evbuffer_add_file(pImpl_->buffer.get(), file_fd, offset, size);
 }
 
+void HttpBuffer::set_drains_to_fd() {
+  evbuffer_set_flags(pImpl_->buffer.get(), EVBUFFER_FLAG_DRAINS_TO_FD);
+}
+
 size_t HttpBuffer::length() const {
   return evbuffer_get_length(pImpl_->buffer.get());
 }
@@ -223,6 +243,7 @@ HttpRequest::HttpRequest(HttpRequest::RequestHandler cb, void *cb_arg) {
 
         ctx->req->pImpl_->req.release(); // the old request object may already be free()ed in case of error
         ctx->req->pImpl_->req.reset(req); // just update with what we have
+        ctx->req->pImpl_->completed = true;
         ctx->cb(ctx->req, ctx->cb_data);
 
         delete ctx;
@@ -249,13 +270,160 @@ void HttpRequest::send_error(int status_code, std::string status_text) {
 }
 
 void HttpRequest::send_reply(int status_code, std::string status_text, HttpBuffer &chunk) {
-  evhttp_send_reply(pImpl_->req.get(), status_code, status_text.c_str(), chunk.pImpl_->buffer.get());
+  auto *buf = chunk.pImpl_->buffer.get();
+  const size_t body_size = evbuffer_get_length(buf);
+
+  const auto encoding = pImpl_->reply_encoding(body_size);
+  if (encoding != HttpContentEncoding::Identity) {
+    const char *body = reinterpret_cast<const char *>(evbuffer_pullup(buf, -1));
+    std::string compressed = HttpCompressor::compress(encoding, body, body_size);
+
+    // not worth it, send it as it is
+    if (compressed.size() < body_size) {
+      evbuffer_drain(buf, body_size);
+      evbuffer_add(buf, compressed.data(), compressed.size());
+      evhttp_add_header(evhttp_request_get_output_headers(pImpl_->req.get()),
+          "Content-Encoding", HttpCompressor::content_coding_name(encoding));
+    }
+  }
+
+  evhttp_send_reply(pImpl_->req.get(), status_code, status_text.c_str(), buf);
+}
+
+void HttpRequest::set_reply_compression(bool enabled) {
+  pImpl_->compress_reply = enabled;
 }
 
 void HttpRequest::send_reply(int status_code, std::string status_text) {
   evhttp_send_reply(pImpl_->req.get(), status_code, status_text.c_str(), nullptr);
 }
 
+#if defined(TCP_CORK) && LIBEVENT_VERSION_NUMBER >= 0x02010800
+static int set_tcp_cork(evutil_socket_t sock, int on) {
+  return setsockopt(sock, IPPROTO_TCP, TCP_CORK, &on, static_cast<socklen_t>(sizeof(on)));
+}
+#endif
+
+bool HttpRequest::cork_until_sent() {
+#if defined(TCP_CORK) && LIBEVENT_VERSION_NUMBER >= 0x02010800
+  auto *ev_req = pImpl_->req.get();
+  auto *ev_conn = ev_req ? evhttp_request_get_connection(ev_req) : nullptr;
+  auto *ev_bev = ev_conn ? evhttp_connection_get_bufferevent(ev_conn) : nullptr;
+  if (nullptr == ev_bev) return false;
+
+  evutil_socket_t sock = bufferevent_getfd(ev_bev);
+  if (sock < 0 || 0 != set_tcp_cork(sock, 1)) return false;
+
+  // called once the reply is written to the socket
+  evhttp_request_set_on_complete_cb(ev_req, [](evhttp_request *, void *arg) {
+    set_tcp_cork(static_cast<evutil_socket_t>(reinterpret_cast<intptr_t>(arg)), 0);
+  }, reinterpret_cast<void *>(static_cast<intptr_t>(sock)));
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string HttpRequest::get_peer_address() const {
+  auto *ev_req = pImpl_->req.get();
+  auto *ev_conn = ev_req ? evhttp_request_get_connection(ev_req) : nullptr;
+  if (nullptr == ev_conn) return {};
+
+  char *address = nullptr;
+  ev_uint16_t port = 0;
+  evhttp_connection_get_peer(ev_conn, &address, &port);
+
+  return address ? address : "";
+}
+
+bool is_loopback_address(const std::string &address) {
+  uint8_t in4[4];
+  if (1 == evutil_inet_pton(AF_INET, address.c_str(), in4)) {
+    return in4[0] == 127;
+  }
+
+  uint8_t in6[16];
+  if (1 != evutil_inet_pton(AF_INET6, address.c_str(), in6)) return false;
+
+  static const uint8_t kMappedPrefix[12] { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+  static const uint8_t kLoopback6[16] { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+  if (0 == std::memcmp(in6, kMappedPrefix, sizeof(kMappedPrefix))) {
+    return in6[12] == 127;
+  }
+  return 0 == std::memcmp(in6, kLoopback6, sizeof(kLoopback6));
+}
+
+void HttpRequest::send_reply_start(int status_code, std::string status_text) {
+  // the size isn't known yet, compress if the client accepts it
+  const auto encoding = pImpl_->reply_encoding(SIZE_MAX);
+  if (encoding != HttpContentEncoding::Identity) {
+    pImpl_->compressor.reset(new HttpCompressor(encoding));
+    evhttp_add_header(evhttp_request_get_output_headers(pImpl_->req.get()),
+        "Content-Encoding", HttpCompressor::content_coding_name(encoding));
+  }
+
+  evhttp_send_reply_start(pImpl_->req.get(), status_code, status_text.c_str());
+}
+
+static void send_evbuffer_chunk(evhttp_request *req, const char *data, size_t data_size) {
+  std::unique_ptr<evbuffer, decltype(&evbuffer_free)> chunk(evbuffer_new(), &evbuffer_free);
+  if (!chunk) {
+    throw std::bad_alloc();
+  }
+  evbuffer_add(chunk.get(), data, data_size);
+  evhttp_send_reply_chunk(req, chunk.get());
+}
+
+void HttpRequest::send_reply_chunk(HttpBuffer &chunk) {
+  auto *buf = chunk.pImpl_->buffer.get();
+
+  if (pImpl_->compressor) {
+    const size_t data_size = evbuffer_get_length(buf);
+    send_reply_chunk(reinterpret_cast<const char *>(evbuffer_pullup(buf, -1)), data_size);
+    evbuffer_drain(buf, data_size);
+    return;
+  }
+
+  evhttp_send_reply_chunk(pImpl_->req.get(), buf);
+}
+
+void HttpRequest::send_reply_chunk(const char *data, size_t data_size) {
+  if (pImpl_->compressor) {
+    std::string compressed;
+    pImpl_->compressor->update(data, data_size, compressed);
+    if (!compressed.empty()) {
+      send_evbuffer_chunk(pImpl_->req.get(), compressed.data(), compressed.size());
+    }
+    return;
+  }
+
+  send_evbuffer_chunk(pImpl_->req.get(), data, data_size);
+}
+
+void HttpRequest::send_reply_end() {
+  if (pImpl_->compressor) {
+    std::string compressed;
+    pImpl_->compressor->finish(compressed);
+    pImpl_->compressor.reset();
+
+    send_evbuffer_chunk(pImpl_->req.get(), compressed.data(), compressed.size());
+  }
+
+  evhttp_send_reply_end(pImpl_->req.get());
+}
+
+// wrap the output of a chunked reply
+
+constexpr size_t HttpChunkedStream::kDefaultFlushSize;
+
+void HttpChunkedStream::Flush() {
+  if (buf_.empty()) return;
+
+  req_.send_reply_chunk(buf_.data(), buf_.size());
+  buf_.clear();
+}
+
 HttpRequest::operator bool() {
   return pImpl_->req.operator bool();
 }
@@ -382,6 +550,38 @@ bool HttpRequest::is_modified_since(time_t last_modified) {
   return true;
 }
 
+bool HttpRequest::is_none_match(const std::string &etag) {
+  auto req_hdrs = get_input_headers();
+
+  const char *if_none_match = req_hdrs.get("If-None-Match");
+  if (if_none_match == nullptr) return true;
+
+  // If-None-Match = "*" / 1#entity-tag
+  // entity-tag    = [ "W/" ] DQUOTE *etagc DQUOTE
+  const std::string hdr(if_none_match);
+  size_t pos = 0;
+  for (;;) {
+    pos = hdr.find_first_not_of(" \t,", pos);
+    if (pos == std::string::npos) return true;
+
+    if (hdr[pos] == '*') return false;
+    if (hdr.compare(pos, 2, "W/") == 0) pos += 2;
+    // malformed, send the content
+    if (pos >= hdr.size() || hdr[pos] != '"') return true;
+
+    const size_t end = hdr.find('"', pos + 1);
+    if (end == std::string::npos) return true;
+
+    if (hdr.compare(pos + 1, end - pos - 1, etag) == 0) return false;
+
+    pos = end + 1;
+  }
+}
+
+void HttpRequest::add_etag(const std::string &etag) {
+  get_output_headers().add("ETag", ("\"" + etag + "\"").c_str());
+}
+
 bool HttpRequest::add_last_modified(time_t last_modified) {
   auto out_hdrs = get_output_headers();
   char date_buf[50];
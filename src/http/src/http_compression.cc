@@ -0,0 +1,248 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysqlrouter/http_compression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+constexpr size_t HttpCompressor::kMinCompressSize;
+
+namespace {
+
+std::string trim_lower(const std::string &s) {
+  const auto first = s.find_first_not_of(" \t");
+  if (first == std::string::npos) return {};
+  const auto last = s.find_last_not_of(" \t");
+
+  std::string res = s.substr(first, last - first + 1);
+  std::transform(res.begin(), res.end(), res.begin(),
+      [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+  return res;
+}
+
+// q-value of a element of Accept-Encoding like "gzip;q=0.5"
+double parse_qvalue(const std::string &params) {
+  size_t pos = 0;
+  while (pos < params.size()) {
+    auto end = params.find(';', pos);
+    if (end == std::string::npos) end = params.size();
+
+    std::string param = trim_lower(params.substr(pos, end - pos));
+    if (param.size() > 2 && param[0] == 'q' && param[1] == '=') {
+      return std::strtod(param.c_str() + 2, nullptr);
+    }
+    pos = end + 1;
+  }
+
+  return 1.0;
+}
+
+} // namespace
+
+#ifdef HAVE_ZLIB
+
+struct HttpCompressor::impl {
+  z_stream strm {};
+};
+
+HttpCompressor::HttpCompressor(HttpContentEncoding encoding):
+  pImpl_{new impl()}
+{
+  // gzip adds 16 to the window-bits, deflate is the zlib format
+  int window_bits;
+  switch (encoding) {
+  case HttpContentEncoding::Gzip: window_bits = 15 + 16; break;
+  case HttpContentEncoding::Deflate: window_bits = 15; break;
+  default: throw std::invalid_argument("content-coding can't be compressed");
+  }
+
+  if (Z_OK != deflateInit2(&pImpl_->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+        window_bits, 8, Z_DEFAULT_STRATEGY)) {
+    throw std::runtime_error("deflateInit2() failed");
+  }
+}
+
+HttpCompressor::~HttpCompressor() {
+  deflateEnd(&pImpl_->strm);
+}
+
+static void deflate_to(z_stream &strm, int flush, std::string &out) {
+  int ret;
+  do {
+    const size_t pos = out.size();
+    // grows by at least the pending output of a sync-flush
+    const size_t avail = std::max<size_t>(strm.avail_in / 2, 4 * 1024);
+    out.resize(pos + avail);
+
+    strm.next_out = reinterpret_cast<Bytef *>(&out[pos]);
+    strm.avail_out = static_cast<uInt>(avail);
+
+    ret = deflate(&strm, flush);
+
+    out.resize(pos + avail - strm.avail_out);
+
+    if (ret == Z_STREAM_ERROR) {
+      throw std::runtime_error("deflate() failed");
+    }
+  } while (strm.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+}
+
+void HttpCompressor::update(const char *data, size_t data_size, std::string &out) {
+  if (data_size == 0) return;
+
+  auto &strm = pImpl_->strm;
+  strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  strm.avail_in = static_cast<uInt>(data_size);
+
+  deflate_to(strm, Z_SYNC_FLUSH, out);
+}
+
+void HttpCompressor::finish(std::string &out) {
+  auto &strm = pImpl_->strm;
+  strm.next_in = nullptr;
+  strm.avail_in = 0;
+
+  deflate_to(strm, Z_FINISH, out);
+}
+
+bool HttpCompressor::is_supported(HttpContentEncoding encoding) {
+  return encoding == HttpContentEncoding::Gzip ||
+         encoding == HttpContentEncoding::Deflate;
+}
+
+#else
+
+struct HttpCompressor::impl {
+};
+
+HttpCompressor::HttpCompressor(HttpContentEncoding) {
+  throw std::invalid_argument("built without zlib, content-coding can't be compressed");
+}
+
+HttpCompressor::~HttpCompressor() = default;
+
+void HttpCompressor::update(const char *, size_t, std::string &) {
+}
+
+void HttpCompressor::finish(std::string &) {
+}
+
+bool HttpCompressor::is_supported(HttpContentEncoding) {
+  return false;
+}
+
+#endif
+
+std::string HttpCompressor::compress(HttpContentEncoding encoding, const char *data, size_t data_size) {
+  HttpCompressor compressor(encoding);
+
+  std::string out;
+  compressor.update(data, data_size, out);
+  compressor.finish(out);
+
+  return out;
+}
+
+HttpContentEncoding HttpCompressor::negotiate(const char *accept_encoding) {
+  if (nullptr == accept_encoding) return HttpContentEncoding::Identity;
+
+  const std::string accepted(accept_encoding);
+
+  // -1: not mentioned
+  double gzip_q = -1;
+  double deflate_q = -1;
+  double any_q = -1;
+
+  size_t pos = 0;
+  while (pos < accepted.size()) {
+    auto end = accepted.find(',', pos);
+    if (end == std::string::npos) end = accepted.size();
+
+    std::string element = accepted.substr(pos, end - pos);
+    pos = end + 1;
+
+    const auto params_pos = element.find(';');
+    const std::string coding = trim_lower(element.substr(0, params_pos));
+    const double q = params_pos == std::string::npos ? 1.0 : parse_qvalue(element.substr(params_pos + 1));
+
+    if (coding == "gzip" || coding == "x-gzip") {
+      gzip_q = q;
+    } else if (coding == "deflate") {
+      deflate_q = q;
+    } else if (coding == "*") {
+      any_q = q;
+    }
+  }
+
+  if (gzip_q < 0) gzip_q = any_q;
+  if (deflate_q < 0) deflate_q = any_q;
+
+  if (gzip_q > 0 && gzip_q >= deflate_q && is_supported(HttpContentEncoding::Gzip)) {
+    return HttpContentEncoding::Gzip;
+  }
+  if (deflate_q > 0 && is_supported(HttpContentEncoding::Deflate)) {
+    return HttpContentEncoding::Deflate;
+  }
+
+  return HttpContentEncoding::Identity;
+}
+
+const char *HttpCompressor::content_coding_name(HttpContentEncoding encoding) {
+  switch (encoding) {
+  case HttpContentEncoding::Gzip: return "gzip";
+  case HttpContentEncoding::Deflate: return "deflate";
+  case HttpContentEncoding::Identity: break;
+  }
+
+  return "identity";
+}
+
+bool HttpCompressor::is_compressible_type(const char *content_type) {
+  if (nullptr == content_type) return false;
+
+  // strip the parameters like "; charset=utf-8"
+  std::string mime_type(content_type);
+  mime_type = trim_lower(mime_type.substr(0, mime_type.find(';')));
+
+  if (mime_type.compare(0, 5, "text/") == 0) return true;
+
+  const auto ends_with = [&mime_type](const std::string &suffix) {
+    return mime_type.size() >= suffix.size() &&
+           mime_type.compare(mime_type.size() - suffix.size(), suffix.size(), suffix) == 0;
+  };
+
+  return mime_type == "application/json" ||
+         mime_type == "application/javascript" ||
+         mime_type == "application/xml" ||
+         ends_with("+json") ||
+         ends_with("+xml");
+}
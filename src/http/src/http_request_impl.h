@@ -24,19 +24,58 @@
 
 #include <event2/http.h>
 
+#include "mysqlrouter/http_compression.h"
+
 class HttpRequest::impl {
 public:
   using evhttp_req_type = std::unique_ptr<evhttp_request, std::function<void(evhttp_request *)>>;
 
   int error_code {0};
 
+  // set once the request handler got called
+  bool completed {false};
+
   evhttp_req_type req;
 
+  // compress the reply if the client accepts it
+  bool compress_reply {true};
+
+  // compressor of a chunked reply
+  std::unique_ptr<HttpCompressor> compressor;
+
   impl(evhttp_req_type request):
     req{std::move(request)}
   {
   }
 
+  /**
+   * content-coding of a reply.
+   *
+   * @param body_size size of the reply body, SIZE_MAX if not known yet
+   */
+  HttpContentEncoding reply_encoding(size_t body_size) {
+    auto *out_hdrs = evhttp_request_get_output_headers(req.get());
+
+    // already encoded by the request-handler
+    if (!compress_reply || evhttp_find_header(out_hdrs, "Content-Encoding")) {
+      return HttpContentEncoding::Identity;
+    }
+
+    if (!HttpCompressor::is_compressible_type(evhttp_find_header(out_hdrs, "Content-Type"))) {
+      return HttpContentEncoding::Identity;
+    }
+
+    // caches have to look at Accept-Encoding, even if this reply isn't compressed
+    evhttp_add_header(out_hdrs, "Vary", "Accept-Encoding");
+
+    if (body_size < HttpCompressor::kMinCompressSize) {
+      return HttpContentEncoding::Identity;
+    }
+
+    return HttpCompressor::negotiate(
+        evhttp_find_header(evhttp_request_get_input_headers(req.get()), "Accept-Encoding"));
+  }
+
   void own() {
     owns_http_request = true;
   }
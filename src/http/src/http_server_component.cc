@@ -32,6 +32,10 @@
 // must be declared in .cc file as otherwise each plugin
 // gets its own class-instance of BaseRequestHandler which leads
 // to undefined behaviour (ubsan -> vptr)
+bool BaseRequestHandler::get_etag(HttpRequest &, std::string &) {
+  return false;
+}
+
 BaseRequestHandler::~BaseRequestHandler() = default;
 
 //
@@ -25,6 +25,7 @@
 /**
  */
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <thread>
@@ -41,6 +42,7 @@
 // Harness interface include files
 #include "mysql/harness/config_parser.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/loop_monitor.h"
 #include "mysql/harness/plugin.h"
 
 #include "mysqlrouter/plugin_config.h"
@@ -57,8 +59,6 @@ using mysql_harness::PluginFuncEnv;
 using mysql_harness::PLUGIN_ABI_VERSION;
 using mysql_harness::Plugin;
 
-std::atomic<int> g_shutdown_pending { 0 };
-
 /**
  * request router
  *
@@ -66,26 +66,52 @@ std::atomic<int> g_shutdown_pending { 0 };
  *
  * if no handler is found, reply with 404 not found
  */
+HttpRequestRouter::HttpRequestRouter():
+  routes_(std::make_shared<const Routes>())
+{}
+
+void HttpRequestRouter::publish(std::shared_ptr<Routes> routes) {
+  routes->url_prefixes = UrlPrefixTrie();
+  for (size_t ndx = 0; ndx < routes->request_handlers.size(); ++ndx) {
+    routes->url_prefixes.insert(routes->request_handlers[ndx]->url_prefix.prefix(), ndx);
+  }
+
+  auto previous = std::atomic_load(&routes_);
+  std::atomic_store(&routes_, std::shared_ptr<const Routes>(std::move(routes)));
+
+  // requests which still route with the previous snapshot hold a reference
+  // to it, wait for them before dropping the handlers it owns
+  while (previous.use_count() > 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
 void HttpRequestRouter::append(const std::string &url_regex_str, std::unique_ptr<BaseRequestHandler> cb) {
   std::lock_guard<std::mutex> lock(route_mtx_);
-  request_handlers_.emplace_back(RouterData { url_regex_str, PosixRE {url_regex_str}, std::move(cb) });
+  auto routes = std::make_shared<Routes>(*std::atomic_load(&routes_));
+  routes->request_handlers.emplace_back(std::make_shared<const RouterData>(
+      RouterData { url_regex_str, PosixRE {url_regex_str}, UrlRegexPrefix {url_regex_str}, std::move(cb) }));
+  publish(std::move(routes));
 }
 
 void HttpRequestRouter::remove(const std::string &url_regex_str) {
   std::lock_guard<std::mutex> lock(route_mtx_);
-  for (auto it = request_handlers_.begin(); it != request_handlers_.end(); ) {
-    if (it->url_regex_str == url_regex_str) {
-      it = request_handlers_.erase(it);
+  auto routes = std::make_shared<Routes>(*std::atomic_load(&routes_));
+  auto &handlers = routes->request_handlers;
+  for (auto it = handlers.begin(); it != handlers.end(); ) {
+    if ((*it)->url_regex_str == url_regex_str) {
+      it = handlers.erase(it);
     } else {
       it++;
     }
   }
+  publish(std::move(routes));
 }
 
 // if no routes are specified, return 404
-void HttpRequestRouter::route_default(HttpRequest &req) {
-  if (default_route_) {
-    default_route_->handle_request(req);
+void HttpRequestRouter::route_default(const Routes &routes, HttpRequest &req) {
+  if (routes.default_route) {
+    handle(*routes.default_route, req);
   } else {
     req.send_error(HttpStatusCode::NotFound, "Not Found");
   }
@@ -93,37 +119,119 @@ void HttpRequestRouter::route_default(HttpRequest &req) {
 
 void HttpRequestRouter::set_default_route(std::unique_ptr<BaseRequestHandler> cb) {
   std::lock_guard<std::mutex> lock(route_mtx_);
-  default_route_ = std::move(cb);
+  auto routes = std::make_shared<Routes>(*std::atomic_load(&routes_));
+  routes->default_route = std::move(cb);
+  publish(std::move(routes));
 }
 
 void HttpRequestRouter::clear_default_route() {
   std::lock_guard<std::mutex> lock(route_mtx_);
-  default_route_ = nullptr;
+  auto routes = std::make_shared<Routes>(*std::atomic_load(&routes_));
+  routes->default_route = nullptr;
+  publish(std::move(routes));
 }
 
 
+void HttpRequestRouter::handle(BaseRequestHandler &handler, HttpRequest &req) {
+  std::string etag;
+  if (((HttpMethod::Get | HttpMethod::Head) & req.get_method()) &&
+      handler.get_etag(req, etag)) {
+    req.add_etag(etag);
+
+    // the client has the current content, don't build it again
+    if (!req.is_none_match(etag)) {
+      req.send_reply(HttpStatusCode::NotModified);
+      return;
+    }
+  }
+
+  handler.handle_request(req);
+}
+
 void HttpRequestRouter::route(HttpRequest req) {
-  std::lock_guard<std::mutex> lock(route_mtx_);
+  // keeps the handlers alive while they run, without blocking other requests
+  const auto routes = std::atomic_load(&routes_);
 
   auto uri = req.get_uri();
 
-  for (auto &request_handler: request_handlers_) {
-    if (request_handler.url_regex.search(uri)) {
-      request_handler.handler->handle_request(req);
+  // routes whose prefix the URI starts with, the first added one that matches wins
+  std::vector<size_t> candidates;
+  routes->url_prefixes.find_prefixes(uri, candidates);
+  std::sort(candidates.begin(), candidates.end());
+
+  for (size_t ndx: candidates) {
+    auto &request_handler = routes->request_handlers[ndx];
+    const bool matches = request_handler->url_prefix.match() == UrlRegexPrefix::Match::kRegex ?
+        request_handler->url_regex.search(uri) : request_handler->url_prefix.matches(uri);
+    if (matches) {
+      handle(*request_handler->handler, req);
       return;
     }
   }
 
-  route_default(req);
+  route_default(*routes, req);
 }
 
 
 void stop_eventloop(evutil_socket_t, short, void *cb_arg) {
   auto *ev_base = static_cast<event_base *>(cb_arg);
 
-  if (g_shutdown_pending != 0) {
-    event_base_loopexit(ev_base, nullptr);
+  event_base_loopbreak(ev_base);
+}
+
+EventLoopWakeup::EventLoopWakeup() {
+#ifdef _WIN32
+  const int family = AF_INET;
+#else
+  const int family = AF_UNIX;
+#endif
+  if (0 != evutil_socketpair(family, SOCK_STREAM, 0, fds_)) {
+    throw std::runtime_error("creating socket-pair failed");
+  }
+
+  // notify() never blocks, one pending byte is enough to wake up
+  evutil_make_socket_nonblocking(fds_[0]);
+  evutil_make_socket_nonblocking(fds_[1]);
+}
+
+EventLoopWakeup::~EventLoopWakeup() {
+  for (auto fd: fds_) {
+    if (fd != -1) evutil_closesocket(fd);
+  }
+}
+
+void EventLoopWakeup::notify() {
+  const char c = 0;
+  // if it fails with EWOULDBLOCK, a wakeup is already pending
+  send(fds_[1], &c, 1, 0);
+}
+
+void EventLoopWakeup::drain() {
+  char buf[256];
+  while (recv(fds_[0], buf, sizeof(buf), 0) > 0) {}
+}
+
+void EventLoopTasks::post(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    tasks_.push_back(std::move(task));
   }
+  wakeup_.notify();
+}
+
+void EventLoopTasks::run() {
+  wakeup_.drain();
+
+  std::vector<Task> tasks;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    tasks.swap(tasks_);
+  }
+  for (auto &task: tasks) task();
+}
+
+void run_posted_tasks(evutil_socket_t, short, void *cb_arg) {
+  static_cast<EventLoopTasks *>(cb_arg)->run();
 }
 
 void HttpRequestThread::accept_socket() {
@@ -132,8 +240,54 @@ void HttpRequestThread::accept_socket() {
   evhttp_accept_socket_with_handle(ev_http.get(), accept_fd_);
 }
 
+bool HttpRequestThread::listen_reuse_port(const std::string &address, uint16_t port) {
+  // other platforms either don't have SO_REUSEPORT or don't balance the
+  // connections over the sockets
+#if defined(__linux__) && defined(SO_REUSEPORT) && defined(LEV_OPT_REUSEABLE_PORT)
+  evutil_addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = EVUTIL_AI_PASSIVE;
+
+  evutil_addrinfo *ai = nullptr;
+  if (0 != evutil_getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &ai)) {
+    return false;
+  }
+  std::unique_ptr<evutil_addrinfo, decltype(&evutil_freeaddrinfo)> ai_guard(ai, &evutil_freeaddrinfo);
+
+  // same backlog as evhttp_bind_socket()
+  auto *listener = evconnlistener_new_bind(ev_base.get(), nullptr, nullptr,
+      LEV_OPT_REUSEABLE | LEV_OPT_REUSEABLE_PORT | LEV_OPT_CLOSE_ON_FREE | LEV_OPT_CLOSE_ON_EXEC,
+      128, ai->ai_addr, static_cast<int>(ai->ai_addrlen));
+  if (nullptr == listener) {
+    return false;
+  }
+
+  // evhttp owns the listener from here on
+  if (nullptr == evhttp_bind_listener(ev_http.get(), listener)) {
+    evconnlistener_free(listener);
+    return false;
+  }
+  accept_fd_ = evconnlistener_get_fd(listener);
+
+  return true;
+#else
+  (void)address;
+  (void)port;
+
+  return false;
+#endif
+}
+
 void HttpRequestThread::set_request_router(HttpRequestRouter &router) {
+  // libevent refuses PATCH with 501 by default, the handlers check the
+  // methods themselves
+  evhttp_set_allowed_methods(ev_http.get(),
+      EVHTTP_REQ_GET | EVHTTP_REQ_POST | EVHTTP_REQ_HEAD | EVHTTP_REQ_PUT |
+      EVHTTP_REQ_DELETE | EVHTTP_REQ_OPTIONS | EVHTTP_REQ_PATCH);
   evhttp_set_gencb(ev_http.get(), [](evhttp_request * req, void * user_data) {
+      HttpServerTlsContext::shutdown_on_close(req);
+
       auto *rtr = static_cast<HttpRequestRouter *>(user_data);
       rtr->route(
           HttpRequest {
@@ -143,12 +297,25 @@ void HttpRequestThread::set_request_router(HttpRequestRouter &router) {
       }, &router);
 }
 
+void HttpRequestThread::set_tls_context(HttpServerTlsContext &tls_context) {
+  tls_context.attach(ev_http.get());
+}
+
 void HttpRequestThread::wait_and_dispatch() {
-  struct timeval tv { 0, 100 * 1000 };
-  event_add(ev_shutdown_timer.get(), &tv);
+  // if stop() was called already, the event is active right away
+  event_add(ev_shutdown.get(), nullptr);
+  event_add(ev_posted_tasks.get(), nullptr);
   event_base_dispatch(ev_base.get());
 }
 
+void HttpRequestThread::stop() {
+  shutdown_wakeup->notify();
+}
+
+void HttpRequestThread::post(EventLoopTasks::Task task) {
+  posted_tasks->post(std::move(task));
+}
+
 class HttpRequestMainThread : public HttpRequestThread
 {
 public:
@@ -183,22 +350,54 @@ void HttpServer::join_all() {
   }
 }
 
+void HttpServer::stop() {
+  for (auto &thr: thread_contexts) {
+    thr.stop();
+  }
+}
+
 void HttpServer::start(size_t max_threads) {
-  thread_contexts.emplace_back(HttpRequestMainThread(address_.c_str(), port_));
+  // a listener per thread if possible, a shared one otherwise
+  bool reuse_port = max_threads > 1;
+  if (reuse_port) {
+    thread_contexts.emplace_back();
+    reuse_port = thread_contexts[0].listen_reuse_port(address_, port_);
+    if (!reuse_port) {
+      thread_contexts.clear();
+    }
+  }
+
+  if (reuse_port) {
+    for (size_t ndx = 1; ndx < max_threads; ndx++) {
+      thread_contexts.emplace_back();
+      if (!thread_contexts[ndx].listen_reuse_port(address_, port_)) {
+        throw std::runtime_error("binding socket failed ...");
+      }
+    }
+  } else {
+    thread_contexts.emplace_back(HttpRequestMainThread(address_.c_str(), port_));
 
-  harness_socket_t accept_fd = thread_contexts[0].get_socket_fd();
-  for (size_t ndx = 1; ndx < max_threads; ndx++) {
-    thread_contexts.emplace_back(HttpRequestWorkerThread(accept_fd));
+    harness_socket_t accept_fd = thread_contexts[0].get_socket_fd();
+    for (size_t ndx = 1; ndx < max_threads; ndx++) {
+      thread_contexts.emplace_back(HttpRequestWorkerThread(accept_fd));
+    }
   }
 
   for (size_t ndx = 0; ndx < max_threads; ndx++) {
     auto &thr = thread_contexts[ndx];
 
     sys_threads.emplace_back(
-      [&]() {
+      [&, reuse_port, ndx]() {
         thr.set_request_router(request_router_);
-        thr.accept_socket();
+        if (tls_context_) thr.set_tls_context(*tls_context_);
+        if (!reuse_port) thr.accept_socket();
+
+        // heartbeats of the stall watchdog wait behind the requests being handled
+        auto &loop_monitor = mysql_harness::LoopMonitor::instance();
+        const auto loop_id = loop_monitor.add("http_server thread " + std::to_string(ndx),
+            [&thr](mysql_harness::LoopMonitor::Task task) { thr.post(std::move(task)); });
         thr.wait_and_dispatch();
+        loop_monitor.remove(loop_id);
       }
     );
   }
@@ -228,18 +427,33 @@ public:
   std::string static_basedir;
   std::string srv_address;
   uint16_t srv_port;
+  bool with_ssl;
+  std::string ssl_cert;
+  std::string ssl_key;
+  uint32_t ssl_session_timeout;
 
   explicit PluginConfig(const mysql_harness::ConfigSection *section):
     mysqlrouter::BasePluginConfig(section),
     static_basedir(get_option_string(section, "static_folder")),
     srv_address(get_option_string(section, "bind_address")),
-    srv_port(get_uint_option<uint16_t>(section, "port"))
-  {}
+    srv_port(get_uint_option<uint16_t>(section, "port")),
+    with_ssl(get_uint_option<uint16_t>(section, "ssl", 0, 1) != 0),
+    ssl_cert(get_option_string(section, "ssl_cert")),
+    ssl_key(get_option_string(section, "ssl_key")),
+    ssl_session_timeout(get_uint_option<uint32_t>(section, "ssl_session_timeout", 1))
+  {
+    if (with_ssl && (ssl_cert.empty() || ssl_key.empty())) {
+      throw std::invalid_argument("ssl=1 requires ssl_cert and ssl_key in [" +
+                                  std::string(kSectionName) + "]");
+    }
+  }
 
   std::string get_default(const std::string &option) const override {
     const std::map<std::string, std::string> defaults{
         {"bind_address", "0.0.0.0"},
         {"port", "5555"},
+        {"ssl", "0"},
+        {"ssl_session_timeout", "300"},
     };
 
     auto it = defaults.find(option);
@@ -280,19 +494,28 @@ static void init(PluginFuncEnv* env) {
 
       PluginConfig config {section};
 
-      log_info("listening on %s:%u", config.srv_address.c_str(), config.srv_port);
+      std::unique_ptr<HttpServerTlsContext> tls_context;
+      if (config.with_ssl) {
+        tls_context.reset(new HttpServerTlsContext(config.ssl_cert, config.ssl_key,
+            std::chrono::seconds(config.ssl_session_timeout)));
+      }
+
+      log_info("listening on %s:%u%s", config.srv_address.c_str(), config.srv_port,
+               config.with_ssl ? " (TLS)" : "");
 
       http_servers.emplace(
           std::make_pair(section->name,
           std::make_shared<HttpServer>(config.srv_address.c_str(), config.srv_port)));
 
       auto srv = http_servers.at(section->name);
+      srv->set_tls_context(std::move(tls_context));
       HttpServerComponent::getInstance().init(srv);
 
       if (!config.static_basedir.empty()) {
+        // TLS encrypts what is sent, files can't go to the socket directly
         srv->add_route("",
             std::unique_ptr<HttpStaticFolderHandler>(
-              new HttpStaticFolderHandler(config.static_basedir)));
+              new HttpStaticFolderHandler(config.static_basedir, !config.with_ssl)));
       }
     }
   } catch (const std::invalid_argument& exc) {
@@ -332,11 +555,9 @@ static void start(PluginFuncEnv* env) {
     srv->start(8);
 
     // we are supposed to block
-    while (is_running(env)) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-    g_shutdown_pending = 1;
+    wait_for_stop(env, 0);
 
+    srv->stop();
     srv->join_all();
   } catch (const std::invalid_argument& exc) {
     set_error(env, mysql_harness::kConfigInvalidArgument, "%s", exc.what());
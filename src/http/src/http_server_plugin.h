@@ -25,6 +25,8 @@
 #ifndef MYSQLROUTER_HTTP_SERVER_PLUGIN_INCLUDED
 #define MYSQLROUTER_HTTP_SERVER_PLUGIN_INCLUDED
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <thread>
@@ -37,21 +39,36 @@
 #include <event2/util.h>
 
 #include "mysqlrouter/http_server_component.h"
+#include "http_server_tls.h"
 #include "posix_re.h"
+#include "static_file_cache.h"
+#include "url_prefix_trie.h"
 
 using harness_socket_t = evutil_socket_t;
 
 void stop_eventloop(evutil_socket_t, short, void *cb_arg);
+void run_posted_tasks(evutil_socket_t, short, void *cb_arg);
 
+/**
+ * request router
+ *
+ * routes are found through a trie of the literal prefixes of their regexes,
+ * only routes whose regex isn't plain text up to a '$' run it.
+ *
+ * routes are published as an immutable snapshot which route() uses without
+ * taking a lock, so the handlers of all HTTP threads run concurrently.
+ * Changes copy the snapshot and wait until no request uses the old one
+ * anymore: once remove() returns, the removed handler doesn't run and is
+ * destroyed.
+ */
 class HttpRequestRouter
 {
 public:
+  HttpRequestRouter();
+
   void append(const std::string &url_regex_str, std::unique_ptr<BaseRequestHandler> cb);
   void remove(const std::string &url_regex_str);
 
-  // if no routes are specified, return 404
-  void route_default(HttpRequest &req);
-
   void set_default_route(std::unique_ptr<BaseRequestHandler> cb);
   void clear_default_route();
   void route(HttpRequest req);
@@ -59,12 +76,31 @@ private:
   struct RouterData {
     std::string url_regex_str;
     PosixRE url_regex;
+    UrlRegexPrefix url_prefix;
     std::unique_ptr<BaseRequestHandler> handler;
   };
-  std::vector<RouterData> request_handlers_;
 
-  std::unique_ptr<BaseRequestHandler> default_route_;
+  struct Routes {
+    std::vector<std::shared_ptr<const RouterData>> request_handlers;
+    std::shared_ptr<BaseRequestHandler> default_route;
+    // indexes of request_handlers by the prefix of their URL regex
+    UrlPrefixTrie url_prefixes;
+  };
+
+  // answers with 304 if the client has the version of the resource the handler
+  // tells, lets the handler build the response otherwise
+  static void handle(BaseRequestHandler &handler, HttpRequest &req);
+
+  // if no routes are specified, return 404
+  static void route_default(const Routes &routes, HttpRequest &req);
+
+  // replaces routes_ after indexing the prefixes, called with route_mtx_ held
+  void publish(std::shared_ptr<Routes> routes);
 
+  // accessed with std::atomic_load/store
+  std::shared_ptr<const Routes> routes_;
+
+  // serializes changes of the routes
   std::mutex route_mtx_;
 };
 
@@ -78,25 +114,119 @@ private:
  * As all threads can accept in parallel this may lead to a thundering herd problem
  * and quite likely it is better to let only one thread accept() and push the socket
  * handling into async-deque and let all workers steal from the queue
+ *
+ * On Linux each thread listens on a socket of its own instead, bound to the same
+ * address with SO_REUSEPORT: the kernel spreads the connections over the sockets
+ * and only wakes the thread it picked.
+ */
+/**
+ * socket-pair to wake up an event loop from another thread.
+ *
+ * libevent isn't set up for threads, event_active() and event_base_loopbreak()
+ * may only be called from the thread that runs the event loop. Writing to the
+ * socket-pair makes its read-end readable in the event loop instead.
  */
+class EventLoopWakeup
+{
+public:
+  /**
+   * @throws std::runtime_error if the socket-pair can't be created
+   */
+  EventLoopWakeup();
+  ~EventLoopWakeup();
+
+  EventLoopWakeup(const EventLoopWakeup&) = delete;
+  EventLoopWakeup &operator=(const EventLoopWakeup&) = delete;
+
+  /**
+   * the end to wait for EV_READ on.
+   */
+  harness_socket_t get_read_fd() const { return fds_[0]; }
+
+  /**
+   * wake up the event loop, callable from any thread.
+   */
+  void notify();
+
+  /**
+   * read the pending wakeups, in the event loop.
+   */
+  void drain();
+private:
+  harness_socket_t fds_[2] { -1, -1 };
+};
+
+/**
+ * tasks posted to an event loop from other threads.
+ */
+class EventLoopTasks
+{
+public:
+  using Task = std::function<void()>;
+
+  harness_socket_t get_read_fd() const { return wakeup_.get_read_fd(); }
+
+  /**
+   * queue the task and wake up the event loop, callable from any thread.
+   */
+  void post(Task task);
+
+  /**
+   * run the queued tasks, in the event loop.
+   */
+  void run();
+private:
+  EventLoopWakeup wakeup_;
+  std::mutex mtx_;
+  std::vector<Task> tasks_;
+};
+
 class HttpRequestThread
 {
 public:
   HttpRequestThread() :
     ev_base(event_base_new(), &event_base_free),
     ev_http(evhttp_new(ev_base.get()), &evhttp_free),
-    ev_shutdown_timer(event_new(ev_base.get(), -1, EV_PERSIST, stop_eventloop, ev_base.get()), &event_free)
+    shutdown_wakeup(new EventLoopWakeup()),
+    ev_shutdown(event_new(ev_base.get(), shutdown_wakeup->get_read_fd(), EV_READ, stop_eventloop, ev_base.get()), &event_free),
+    posted_tasks(new EventLoopTasks()),
+    ev_posted_tasks(event_new(ev_base.get(), posted_tasks->get_read_fd(), EV_READ | EV_PERSIST, run_posted_tasks, posted_tasks.get()), &event_free)
   {}
 
   harness_socket_t get_socket_fd() { return accept_fd_; }
 
   void accept_socket();
+
+  /**
+   * listen on a socket of its own which shares the address with other threads.
+   *
+   * @returns false if SO_REUSEPORT isn't supported or the socket can't be bound
+   */
+  bool listen_reuse_port(const std::string &address, uint16_t port);
   void set_request_router(HttpRequestRouter &router);
+
+  /**
+   * speak TLS on the connections accepted from now on.
+   */
+  void set_tls_context(HttpServerTlsContext &tls_context);
   void wait_and_dispatch();
+
+  /**
+   * make wait_and_dispatch() return, callable from any thread.
+   */
+  void stop();
+
+  /**
+   * run the task in the event loop, callable from any thread.
+   */
+  void post(EventLoopTasks::Task task);
 protected:
   std::unique_ptr<event_base, decltype(&event_base_free)> ev_base;
   std::unique_ptr<evhttp, decltype(&evhttp_free)> ev_http;
-  std::unique_ptr<event, decltype(&event_free)> ev_shutdown_timer;
+  std::unique_ptr<EventLoopWakeup> shutdown_wakeup;
+  std::unique_ptr<event, decltype(&event_free)> ev_shutdown;
+  std::unique_ptr<EventLoopTasks> posted_tasks;
+  std::unique_ptr<event, decltype(&event_free)> ev_posted_tasks;
 
   harness_socket_t accept_fd_ { -1 };
 };
@@ -117,10 +247,23 @@ public:
 
   void join_all();
 
+  /**
+   * stop the event loops of all threads.
+   */
+  void stop();
+
   ~HttpServer() {
+    stop();
     join_all();
   }
 
+  /**
+   * serve HTTPS with the context, before start().
+   */
+  void set_tls_context(std::unique_ptr<HttpServerTlsContext> tls_context) {
+    tls_context_ = std::move(tls_context);
+  }
+
   void start(size_t max_threads);
   void add_route(const std::string &url_regex, std::unique_ptr<BaseRequestHandler> cb);
   void remove_route(const std::string &url_regex);
@@ -129,18 +272,34 @@ private:
   std::string address_;
   uint16_t port_;
   HttpRequestRouter request_router_;
+  // shared by all threads, outlives them
+  std::unique_ptr<HttpServerTlsContext> tls_context_;
 
   std::vector<std::thread> sys_threads;
 };
 
+/**
+ * serves the files of a folder.
+ *
+ * files up to kInMemorySize are sent from memory with the headers in one
+ * write, larger ones with sendfile() and TCP_CORK. Without sendfile(), as
+ * TLS connections need to encrypt the files, they are mmap()ed.
+ */
 class HttpStaticFolderHandler: public BaseRequestHandler {
 public:
-  explicit HttpStaticFolderHandler(std::string static_basedir):
-    static_basedir_(std::move(static_basedir)) {}
+  static constexpr off_t kInMemorySize = 64 * 1024;
+  static constexpr size_t kMaxCachedFiles = 1024;
+
+  explicit HttpStaticFolderHandler(std::string static_basedir, bool use_sendfile = true):
+    static_basedir_(std::move(static_basedir)),
+    use_sendfile_(use_sendfile),
+    file_cache_(kMaxCachedFiles, kInMemorySize, std::chrono::seconds(1)) {}
 
   void handle_request(HttpRequest &req) override;
 private:
   std::string static_basedir_;
+  bool use_sendfile_;
+  StaticFileCache file_cache_;
 };
 
 #endif
@@ -0,0 +1,158 @@
+/*
+  Copyright (c) 2026, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "http_server_tls.h"
+
+#include <mutex>
+#include <stdexcept>
+
+#include <event2/event.h>
+
+#ifdef HAVE_EVENT_OPENSSL
+#  include <openssl/err.h>
+#  include <openssl/ssl.h>
+#  include <event2/bufferevent.h>
+#  include <event2/bufferevent_ssl.h>
+#endif
+
+// evhttp_set_bevcb() is new in libevent 2.1
+#if defined(HAVE_EVENT_OPENSSL) && LIBEVENT_VERSION_NUMBER >= 0x02010100
+#  define HTTP_SERVER_TLS
+#endif
+
+#ifdef HTTP_SERVER_TLS
+
+// ties cached sessions to the http server, any value will do
+static const unsigned char kSessionIdContext[] = "mysqlrouter-http";
+
+// called by evhttp for each connection it accepts
+static bufferevent *new_tls_bufferevent(event_base *base, void *arg) {
+  SSL *ssl = SSL_new(static_cast<ssl_ctx_st *>(arg));
+  if (nullptr == ssl) return nullptr;
+
+  // evhttp sets the socket once it is accepted, BEV_OPT_CLOSE_ON_FREE frees
+  // the SSL with the bufferevent (or if creating it fails)
+  auto *bev = bufferevent_openssl_socket_new(base, -1, ssl, BUFFEREVENT_SSL_ACCEPTING,
+      BEV_OPT_CLOSE_ON_FREE);
+  if (nullptr == bev) return nullptr;
+
+  // scrapers mostly close the connection without a close_notify
+  bufferevent_openssl_set_allow_dirty_shutdown(bev, 1);
+
+  return bev;
+}
+
+/*static*/
+void HttpServerTlsContext::info_callback(const SSL *ssl, int where, int) {
+  if (!(where & SSL_CB_HANDSHAKE_DONE)) return;
+
+  auto *self = static_cast<HttpServerTlsContext *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  ++self->handshakes_;
+  if (SSL_session_reused(const_cast<SSL *>(ssl)) == 1) ++self->resumed_;
+}
+
+HttpServerTlsContext::HttpServerTlsContext(const std::string &cert_file, const std::string &key_file,
+                                           std::chrono::seconds session_timeout) {
+  static std::once_flag init_flag;
+  std::call_once(init_flag, [] { SSL_library_init(); });
+
+  ctx_ = SSL_CTX_new(SSLv23_server_method());
+  if (nullptr == ctx_) throw std::runtime_error("creating TLS context failed");
+
+  SSL_CTX_set_options(ctx_, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_COMPRESSION);
+
+  if (SSL_CTX_use_certificate_chain_file(ctx_, cert_file.c_str()) != 1) {
+    SSL_CTX_free(ctx_);
+    throw std::runtime_error("loading certificate '" + cert_file + "' failed");
+  }
+  if (SSL_CTX_use_PrivateKey_file(ctx_, key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(ctx_) != 1) {
+    SSL_CTX_free(ctx_);
+    throw std::runtime_error("loading private key '" + key_file + "' failed");
+  }
+
+  // sessions are resumed from the cache by their id, or from tickets the
+  // clients present. Both are shared by all threads through the context.
+  SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context(ctx_, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+  SSL_CTX_set_timeout(ctx_, static_cast<long>(session_timeout.count()));
+  SSL_CTX_clear_options(ctx_, SSL_OP_NO_TICKET);
+
+  SSL_CTX_set_app_data(ctx_, this);
+  SSL_CTX_set_info_callback(ctx_, info_callback);
+}
+
+HttpServerTlsContext::~HttpServerTlsContext() {
+  SSL_CTX_free(ctx_);
+}
+
+/*static*/
+bool HttpServerTlsContext::is_supported() noexcept {
+  return true;
+}
+
+/*static*/
+void HttpServerTlsContext::shutdown_on_close(evhttp_request *req) {
+  auto *ev_conn = evhttp_request_get_connection(req);
+  auto *ev_bev = ev_conn ? evhttp_connection_get_bufferevent(ev_conn) : nullptr;
+  if (nullptr == ev_bev || nullptr == bufferevent_openssl_get_ssl(ev_bev)) return;
+
+  // called before evhttp frees the bufferevent, its output is written already
+  evhttp_connection_set_closecb(ev_conn, [](evhttp_connection *conn, void *) {
+    SSL *ssl = bufferevent_openssl_get_ssl(evhttp_connection_get_bufferevent(conn));
+    if (nullptr == ssl) return;
+
+    // best effort, the socket doesn't block
+    if (SSL_is_init_finished(ssl)) SSL_shutdown(ssl);
+    ERR_clear_error();
+  }, nullptr);
+}
+
+void HttpServerTlsContext::attach(evhttp *http) {
+  evhttp_set_bevcb(http, new_tls_bufferevent, ctx_);
+}
+
+#else
+
+HttpServerTlsContext::HttpServerTlsContext(const std::string &, const std::string &,
+                                           std::chrono::seconds) {
+  throw std::runtime_error("TLS is not supported by this build");
+}
+
+HttpServerTlsContext::~HttpServerTlsContext() = default;
+
+/*static*/
+bool HttpServerTlsContext::is_supported() noexcept {
+  return false;
+}
+
+void HttpServerTlsContext::attach(evhttp *) {}
+
+/*static*/
+void HttpServerTlsContext::shutdown_on_close(evhttp_request *) {}
+
+/*static*/
+void HttpServerTlsContext::info_callback(const ssl_st *, int, int) {}
+
+#endif // HTTP_SERVER_TLS
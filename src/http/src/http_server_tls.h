@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2026, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQLROUTER_HTTP_SERVER_TLS_INCLUDED
+#define MYSQLROUTER_HTTP_SERVER_TLS_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <event2/http.h>
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+/**
+ * TLS context of a HttpServer.
+ *
+ * One context serves the connections of all threads of the server: its
+ * session cache and the keys of its session tickets are shared, a client
+ * reconnecting to any thread resumes its session instead of doing a full
+ * handshake.
+ *
+ * Connections are encrypted by libevent's bufferevent_openssl, which needs
+ * OpenSSL (not yaSSL) and libevent 2.1 or later.
+ */
+class HttpServerTlsContext
+{
+public:
+  /**
+   * load certificate and key.
+   *
+   * @param cert_file PEM file of the certificate, may include the chain
+   * @param key_file PEM file of the private key
+   * @param session_timeout time cached sessions and tickets can be resumed
+   *
+   * @throws std::runtime_error if TLS isn't supported or certificate or
+   *         key can't be loaded
+   */
+  HttpServerTlsContext(const std::string &cert_file, const std::string &key_file,
+                       std::chrono::seconds session_timeout = std::chrono::seconds(300));
+  ~HttpServerTlsContext();
+
+  HttpServerTlsContext(const HttpServerTlsContext&) = delete;
+  HttpServerTlsContext &operator=(const HttpServerTlsContext&) = delete;
+
+  struct Stats {
+    /** handshakes done with clients */
+    uint64_t handshakes{0};
+    /** handshakes resuming a session, from the cache or a ticket */
+    uint64_t resumed{0};
+  };
+
+  Stats get_stats() const noexcept {
+    Stats stats;
+    stats.handshakes = handshakes_;
+    stats.resumed = resumed_;
+    return stats;
+  }
+
+  /**
+   * is the build able to serve HTTPS.
+   */
+  static bool is_supported() noexcept;
+
+  /**
+   * let the connections 'http' accepts from now on speak TLS.
+   *
+   * the context has to outlive 'http'.
+   */
+  void attach(evhttp *http);
+
+  /**
+   * send a close_notify once the connection of the request gets closed.
+   *
+   * Without it clients see an unexpected EOF, OpenSSL 3 then drops the
+   * session instead of resuming it. No-op for plain connections.
+   */
+  static void shutdown_on_close(evhttp_request *req);
+private:
+  // counts the handshakes of the connections
+  static void info_callback(const ssl_st *ssl, int where, int ret);
+
+  ssl_ctx_st *ctx_{nullptr};
+
+  std::atomic<uint64_t> handshakes_{0};
+  std::atomic<uint64_t> resumed_{0};
+};
+
+#endif
@@ -24,27 +24,119 @@
 
 #include "mysqlrouter/rest_client.h"
 
-HttpRequest RestClient::request_sync(
-    HttpMethod::type method,
-    const std::string &uri,
-    const std::string &request_body /* = {} */,
-    const std::string &content_type /* = "application/json" */) {
-  HttpRequest req {HttpRequest::sync_callback, nullptr};
+#include <algorithm>
+#include <stdexcept>
+#include <string>
 
+struct RestClient::PendingRequest {
+  RestClient *client;
+  size_t conn_ndx;
+  ResponseHandler handler;
+
+  // referenced by libevent's request callback, must not move
+  HttpRequest req {RestClient::on_response, this};
+
+  PendingRequest(RestClient *client_, size_t conn_ndx_, ResponseHandler handler_):
+    client{client_},
+    conn_ndx{conn_ndx_},
+    handler{std::move(handler_)}
+  {}
+};
+
+RestClient::RestClient(IOContext &io_ctx, const std::string &address, uint16_t port, size_t connections /* = 1 */):
+  // gcc-4.8 requires a () here, instead of {}
+  io_ctx_(io_ctx),
+  hostname_{address}
+{
+  if (connections == 0) {
+    throw std::invalid_argument("connections must be > 0");
+  }
+
+  for (size_t ndx = 0; ndx < connections; ++ndx) {
+    http_clients_.emplace_back(new HttpClient(io_ctx_, address, port));
+  }
+  in_flight_.resize(connections);
+}
+
+RestClient::~RestClient() {
+  // free the connections first, they drop their queued requests
+  // without calling the request-handlers
+  http_clients_.clear();
+
+  for (auto *pending_req: pending_requests_) {
+    delete pending_req;
+  }
+}
+
+void RestClient::prepare_request(HttpRequest &req, HttpMethod::type method,
+    const std::string &request_body, const std::string &content_type) {
   // TRACE forbids a request-body
   if (!request_body.empty()) {
     if (method == HttpMethod::Trace) {
       throw std::logic_error("TRACE can't have request-body");
     }
     req.get_output_headers().add("Content-Type", content_type.c_str());
+    // libevent only adds it for POST and PUT. Without it the server can't
+    // tell where the body of a PATCH ends on a kept-alive connection
+    req.get_output_headers().add("Content-Length", std::to_string(request_body.size()).c_str());
     auto out_buf = req.get_output_buffer();
     out_buf.add(request_body.data(), request_body.size());
   }
 
-  // ask the server to close the connection after this request
-  req.get_output_headers().add("Connection", "close");
+  // no "Connection: close", the connection is kept alive for the
+  // next request
   req.get_output_headers().add("Host", hostname_.c_str());
-  http_client_.make_request_sync(&req, method, uri);
+}
+
+size_t RestClient::select_connection() const {
+  return std::min_element(in_flight_.begin(), in_flight_.end()) - in_flight_.begin();
+}
+
+HttpRequest RestClient::request_sync(
+    HttpMethod::type method,
+    const std::string &uri,
+    const std::string &request_body /* = {} */,
+    const std::string &content_type /* = "application/json" */) {
+  HttpRequest req {HttpRequest::sync_callback, nullptr};
+
+  prepare_request(req, method, request_body, content_type);
+
+  http_clients_[select_connection()]->make_request_sync(&req, method, uri);
 
   return req;
 }
+
+void RestClient::request(
+    HttpMethod::type method,
+    const std::string &uri,
+    ResponseHandler handler,
+    const std::string &request_body /* = {} */,
+    const std::string &content_type /* = "application/json" */) {
+  size_t conn_ndx = select_connection();
+  std::unique_ptr<PendingRequest> pending_req(new PendingRequest(this, conn_ndx, std::move(handler)));
+
+  prepare_request(pending_req->req, method, request_body, content_type);
+
+  http_clients_[conn_ndx]->make_request(&pending_req->req, method, uri);
+
+  ++in_flight_[conn_ndx];
+  ++pending_;
+  pending_requests_.push_back(pending_req.release());
+}
+
+void RestClient::on_response(HttpRequest *req, void *arg) {
+  std::unique_ptr<PendingRequest> pending_req(static_cast<PendingRequest *>(arg));
+  auto *client = pending_req->client;
+
+  --client->in_flight_[pending_req->conn_ndx];
+  --client->pending_;
+  client->pending_requests_.erase(
+      std::find(client->pending_requests_.begin(), client->pending_requests_.end(), pending_req.get()));
+
+  pending_req->handler(*req);
+}
+
+void RestClient::wait_all() {
+  while (pending_ > 0 && io_ctx_.dispatch_once()) {
+  }
+}
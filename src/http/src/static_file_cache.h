@@ -0,0 +1,211 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQLROUTER_STATIC_FILE_CACHE_INCLUDED
+#define MYSQLROUTER_STATIC_FILE_CACHE_INCLUDED
+
+// metadata and content of the static files, to not stat() them for each
+// request
+
+#include <cerrno>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>  // close, read
+#else
+#include <unistd.h>  // close, read
+#endif
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "mysql/harness/memory_accounting.h"
+
+/**
+ * cache of static files by path.
+ *
+ * files up to in_memory_size are kept in memory, larger ones are opened by
+ * each request that sends them: a shared file descriptor would share its
+ * file offset between the requests too. An entry is used without looking at the file again until it
+ * is older than validity, then its path is stat()ed and the file gets
+ * reopened if its mtime, size or inode changed.
+ */
+class StaticFileCache {
+public:
+  struct Entry {
+    Entry() = default;
+    Entry(const Entry &) = delete;
+    Entry &operator=(const Entry &) = delete;
+
+    bool is_directory { false };
+    time_t mtime { 0 };
+    off_t size { 0 };
+    ino_t ino { 0 };
+    // false if the file is too large for content or a directory
+    bool in_memory { false };
+    // content of files up to in_memory_size
+    std::string content;
+
+    /**
+     * get the compressed content.
+     *
+     * compressed once per content-coding and cached with the entry, which
+     * gets replaced when the file changes.
+     *
+     * @param coding content-coding, key of the cached compressed content
+     * @param compress returns the compressed content
+     */
+    template<class Compress>
+    std::shared_ptr<const std::string> get_compressed(int coding, Compress compress) const {
+      std::lock_guard<std::mutex> lk(compressed_mtx_);
+      auto &compressed = compressed_[coding];
+      if (!compressed) {
+        compressed = std::make_shared<const std::string>(compress());
+        memory_.set(memory_.bytes() + compressed->size(), 1);
+      }
+
+      return compressed;
+    }
+
+    /** @brief accounts the content and the compressed copies */
+    void account_content() { memory_.set(content.size(), 1); }
+  private:
+    mutable std::mutex compressed_mtx_;
+    mutable std::map<int, std::shared_ptr<const std::string>> compressed_;
+    mutable mysql_harness::AccountedMemory memory_{mysql_harness::MemoryTag::kHttp};
+  };
+
+  StaticFileCache(size_t max_entries, off_t in_memory_size, std::chrono::milliseconds validity):
+    max_entries_(max_entries), in_memory_size_(in_memory_size), validity_(validity)
+  {}
+
+  /**
+   * get entry of a file or directory.
+   *
+   * @returns entry, nullptr with errno set if it can't be opened
+   */
+  std::shared_ptr<const Entry> get(const std::string &path) {
+    const auto now = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      auto it = entries_.find(path);
+      if (it != entries_.end() && now - it->second.validated < validity_) {
+        return it->second.entry;
+      }
+    }
+
+    struct stat st;
+    if (-1 == stat(path.c_str(), &st)) {
+      std::lock_guard<std::mutex> lk(mtx_);
+      entries_.erase(path);
+
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = entries_.find(path);
+    if (it != entries_.end() && it->second.entry->mtime == st.st_mtime &&
+        it->second.entry->size == st.st_size && it->second.entry->ino == st.st_ino) {
+      // unchanged
+      it->second.validated = now;
+      return it->second.entry;
+    }
+
+    auto entry = open_entry(path, st);
+    if (!entry) {
+      if (it != entries_.end()) entries_.erase(it);
+      return nullptr;
+    }
+
+    if (it != entries_.end()) {
+      it->second = Slot { entry, now };
+    } else {
+      // no LRU, dropping any entry keeps the cache bounded
+      if (entries_.size() >= max_entries_ && !entries_.empty()) entries_.erase(entries_.begin());
+      entries_.emplace(path, Slot { entry, now });
+    }
+
+    return entry;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return entries_.size();
+  }
+private:
+  struct Slot {
+    std::shared_ptr<const Entry> entry;
+    std::chrono::steady_clock::time_point validated;
+  };
+
+  std::shared_ptr<const Entry> open_entry(const std::string &path, const struct stat &st) const {
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->mtime = st.st_mtime;
+    entry->size = st.st_size;
+    entry->ino = st.st_ino;
+
+    if ((st.st_mode & S_IFMT) == S_IFDIR) {
+      entry->is_directory = true;
+      return entry;
+    }
+
+    if (st.st_size > in_memory_size_) return entry;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    entry->content.resize(static_cast<size_t>(st.st_size));
+    size_t pos = 0;
+    while (pos < entry->content.size()) {
+      auto bytes_read = read(fd, &entry->content[pos], static_cast<unsigned>(entry->content.size() - pos));
+      if (bytes_read < 0 && errno == EINTR) continue;
+      if (bytes_read <= 0) {
+        // file got shorter meanwhile, or failed
+        const int err = bytes_read < 0 ? errno : EIO;
+        close(fd);
+        errno = err;
+        return nullptr;
+      }
+      pos += static_cast<size_t>(bytes_read);
+    }
+    close(fd);
+    entry->in_memory = true;
+    entry->account_content();
+
+    return entry;
+  }
+
+  const size_t max_entries_;
+  const off_t in_memory_size_;
+  const std::chrono::milliseconds validity_;
+
+  mutable std::mutex mtx_;
+  std::map<std::string, Slot> entries_;
+};
+
+#endif
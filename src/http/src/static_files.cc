@@ -22,6 +22,7 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include <cerrno>
 #include <string>
 #include <memory>
 #include <map>
@@ -35,9 +36,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include "mysqlrouter/http_compression.h"
 #include "mysqlrouter/http_server_component.h"
 #include "http_server_plugin.h"
 
+constexpr off_t HttpStaticFolderHandler::kInMemorySize;
+constexpr size_t HttpStaticFolderHandler::kMaxCachedFiles;
+
 void HttpStaticFolderHandler::handle_request(HttpRequest &req) {
   HttpUri parsed_uri { HttpUri::parse( req.get_uri() ) };
 
@@ -51,6 +56,7 @@ void HttpStaticFolderHandler::handle_request(HttpRequest &req) {
 
   auto out_hdrs = req.get_output_headers();
 
+  std::string content_type;
   auto n = file_path.rfind('.');
   if (n != std::string::npos) {
     const std::map<std::string, std::string> mimetypes {
@@ -66,86 +72,91 @@ void HttpStaticFolderHandler::handle_request(HttpRequest &req) {
 
     if (it != mimetypes.end()) {
       // found
-      out_hdrs.add("Content-Type", it->second.c_str());
+      content_type = it->second.c_str();
     } else {
-      out_hdrs.add("Content-Type", "application/octet-stream");
+      content_type = "application/octet-stream";
     }
+    out_hdrs.add("Content-Type", content_type.c_str());
   }
 
-  struct stat st;
-  if (-1 == stat(file_path.c_str(), &st)) {
-    if (errno == ENOENT) {
-      // if it was a directory
-      req.send_error(HttpStatusCode::NotFound);
-
-      return;
-    } else {
-      req.send_error(HttpStatusCode::InternalError);
-
-      return;
-    }
-  }
+  auto entry = file_cache_.get(file_path);
 
   // if we have a directory, check if it contains a index.html file
-  if ((st.st_mode & S_IFMT) == S_IFDIR) {
+  if (entry && entry->is_directory) {
     file_path += "/index.html";
 
-    if (-1 == stat(file_path.c_str(), &st)) {
-      if (errno == ENOENT) {
-        // if it was a directory
-        req.send_error(HttpStatusCode::NotFound);
-
-        return;
-      } else {
-        req.send_error(HttpStatusCode::InternalError);
+    entry = file_cache_.get(file_path);
+  }
 
-        return;
-      }
+  if (!entry || entry->is_directory) {
+    if (!entry && errno != ENOENT) {
+      req.send_error(HttpStatusCode::InternalError);
+    } else {
+      req.send_error(HttpStatusCode::NotFound);
     }
+
+    return;
   }
 
   // file exists
 
-  int file_fd = open(file_path.c_str(), O_RDONLY);
+  if (!req.is_modified_since(entry->mtime)) {
+    req.send_error(HttpStatusCode::NotModified);
+    return;
+  }
+
+  req.add_last_modified(entry->mtime);
 
-  if (file_fd < 0) {
-    if (errno == ENOENT) {
-      // if it was a directory
-      req.send_error(HttpStatusCode::NotFound);
+  // the compressed content is cached, don't let send_reply() compress
+  // each reply again
+  req.set_reply_compression(false);
 
-      return;
-    } else {
-      req.send_error(HttpStatusCode::InternalError);
+  auto chunk = req.get_output_buffer();
+  if (entry->in_memory) {
+    std::shared_ptr<const std::string> compressed;
+    HttpContentEncoding encoding { HttpContentEncoding::Identity };
 
-      return;
+    if (HttpCompressor::is_compressible_type(content_type.c_str())) {
+      out_hdrs.add("Vary", "Accept-Encoding");
+
+      if (entry->content.size() >= HttpCompressor::kMinCompressSize) {
+        encoding = HttpCompressor::negotiate(req.get_input_headers().get("Accept-Encoding"));
+      }
     }
-  } else {
-    if (!req.is_modified_since(st.st_mtime)) {
-      req.send_error(HttpStatusCode::NotModified);
-      return;
+
+    if (encoding != HttpContentEncoding::Identity) {
+      compressed = entry->get_compressed(static_cast<int>(encoding), [&entry, encoding]() {
+        return HttpCompressor::compress(encoding, entry->content.data(), entry->content.size());
+      });
     }
 
-    req.add_last_modified(st.st_mtime);
-
-    auto chunk = req.get_output_buffer();
-    // if the file-size is 0, there is nothing to send ... and it triggers a mmap() error
-    if (st.st_size > 0) {
-      // only use sendfile if packet is large enough as it will be sent in sep TCP packet/syscall
-      //
-      // using TCP_CORK would help here
-      // if (st.st_size > 64 * 1024) {
-      //    evbuffer_set_flags(chunk, EVBUFFER_FLAG_DRAINS_TO_FD);
-      // }
-      chunk.add_file(file_fd, 0, st.st_size);
-      // file_fd is owned by evbuffer_add_file(), don't close it
+    // small file, sent with the headers in one write
+    if (compressed && compressed->size() < entry->content.size()) {
+      out_hdrs.add("Content-Encoding", HttpCompressor::content_coding_name(encoding));
+      chunk.add(compressed->data(), compressed->size());
     } else {
-      close(file_fd);
+      chunk.add(entry->content.data(), entry->content.size());
+    }
+  } else {
+    // opened per request, a fd shared by the requests would share the file
+    // offset too. evbuffer_add_file() closes it
+    int file_fd = open(file_path.c_str(), O_RDONLY);
+    struct stat st;
+    if (file_fd < 0 || -1 == fstat(file_fd, &st)) {
+      const int err = errno;
+      if (file_fd >= 0) close(file_fd);
+      req.send_error(err == ENOENT ? HttpStatusCode::NotFound : HttpStatusCode::InternalError);
+      return;
     }
 
-    req.send_reply(HttpStatusCode::Ok, HttpStatusCode::get_default_status_text(HttpStatusCode::Ok), chunk);
-
-    return;
+    if (use_sendfile_) {
+      // sendfile() puts the file in separate TCP segments, cork them with the headers
+      chunk.set_drains_to_fd();
+      req.cork_until_sent();
+    }
+    // the file may have changed since it was cached, send what got opened
+    chunk.add_file(file_fd, 0, st.st_size);
   }
-}
-
 
+  req.send_reply(HttpStatusCode::Ok, HttpStatusCode::get_default_status_text(HttpStatusCode::Ok), chunk);
+}
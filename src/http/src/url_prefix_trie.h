@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQLROUTER_URL_PREFIX_TRIE_INCLUDED
+#define MYSQLROUTER_URL_PREFIX_TRIE_INCLUDED
+
+// literal prefixes of URL regexes, to find the routes which may match a URL
+// without running every regex
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * how much of a (POSIX extended) URL regex is plain text.
+ */
+class UrlRegexPrefix {
+public:
+  enum class Match {
+    // regex matches all URLs starting with prefix
+    kPrefix,
+    // regex matches the URL which is prefix
+    kExact,
+    // URLs starting with prefix need to be checked with the regex
+    kRegex,
+  };
+
+  explicit UrlRegexPrefix(const std::string &regex) {
+    // alternatives don't share the anchor
+    if (regex.empty() || regex[0] != '^' || regex.find('|') != std::string::npos) return;
+
+    size_t pos = 1;
+    for (; pos < regex.size() && std::strchr(".[]()*+?{}\\^$", regex[pos]) == nullptr; ++pos) {
+      prefix_ += regex[pos];
+    }
+
+    if (pos < regex.size() && std::strchr("*+?{", regex[pos]) != nullptr) {
+      // quantifier of the last char
+      if (!prefix_.empty()) prefix_.pop_back();
+    } else if (pos == regex.size()) {
+      match_ = Match::kPrefix;
+    } else if (pos + 1 == regex.size() && regex[pos] == '$') {
+      match_ = Match::kExact;
+    }
+  }
+
+  const std::string &prefix() const { return prefix_; }
+  Match match() const { return match_; }
+
+  /**
+   * true if URL matches without running the regex, false if not.
+   *
+   * only for kPrefix and kExact, and URLs starting with prefix().
+   */
+  bool matches(const std::string &url) const {
+    return match_ == Match::kPrefix || url.size() == prefix_.size();
+  }
+private:
+  std::string prefix_;
+  Match match_ { Match::kRegex };
+};
+
+/**
+ * trie of URL prefixes.
+ *
+ * finding the values of all prefixes of a URL takes O(URL length),
+ * independent of the number of prefixes.
+ */
+class UrlPrefixTrie {
+public:
+  UrlPrefixTrie(): nodes_(1) {}
+
+  void insert(const std::string &prefix, size_t value) {
+    size_t node = 0;
+    for (char c: prefix) {
+      size_t child = find_child(node, c);
+      if (child == 0) {
+        child = nodes_.size();
+        nodes_[node].children.emplace_back(c, child);
+        nodes_.emplace_back();
+      }
+      node = child;
+    }
+    nodes_[node].values.push_back(value);
+  }
+
+  /**
+   * appends values of all prefixes of url to values, shortest prefix first.
+   */
+  void find_prefixes(const std::string &url, std::vector<size_t> &values) const {
+    size_t node = 0;
+    auto append = [&](size_t n) {
+      values.insert(values.end(), nodes_[n].values.begin(), nodes_[n].values.end());
+    };
+
+    append(node);
+    for (char c: url) {
+      node = find_child(node, c);
+      if (node == 0) return;
+      append(node);
+    }
+  }
+private:
+  struct Node {
+    // next char and node, root is never a child
+    std::vector<std::pair<char, size_t>> children;
+    std::vector<size_t> values;
+  };
+
+  size_t find_child(size_t node, char c) const {
+    for (const auto &child: nodes_[node].children) {
+      if (child.first == c) return child.second;
+    }
+    return 0;
+  }
+
+  std::vector<Node> nodes_;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+  Copyright (c) 2026, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "gmock/gmock.h"
+
+#include <string>
+
+#include "mysqlrouter/http_common.h"
+
+class ConditionalRequestTest: public ::testing::Test {
+protected:
+  HttpRequest req_{[](HttpRequest *, void *) {}};
+};
+
+/**
+ * @test without If-None-Match the client has no copy.
+ */
+TEST_F(ConditionalRequestTest, no_header) {
+  EXPECT_TRUE(req_.is_none_match("1-2"));
+}
+
+/**
+ * @test the entity-tag is found in a list, weak ones compare the same.
+ */
+TEST_F(ConditionalRequestTest, matches) {
+  req_.get_input_headers().add("If-None-Match", "\"0-1\", W/\"1-2\"");
+
+  EXPECT_FALSE(req_.is_none_match("1-2"));
+  EXPECT_FALSE(req_.is_none_match("0-1"));
+  EXPECT_TRUE(req_.is_none_match("1-3"));
+  EXPECT_TRUE(req_.is_none_match("1"));
+  EXPECT_TRUE(req_.is_none_match(""));
+}
+
+/**
+ * @test '*' matches any entity-tag.
+ */
+TEST_F(ConditionalRequestTest, any) {
+  req_.get_input_headers().add("If-None-Match", "*");
+
+  EXPECT_FALSE(req_.is_none_match("1-2"));
+}
+
+/**
+ * @test malformed headers never suppress the content.
+ */
+TEST_F(ConditionalRequestTest, malformed) {
+  req_.get_input_headers().add("If-None-Match", "1-2, \"1-2");
+
+  EXPECT_TRUE(req_.is_none_match("1-2"));
+}
+
+/**
+ * @test add_etag() quotes the entity-tag.
+ */
+TEST_F(ConditionalRequestTest, add_etag) {
+  req_.add_etag("1-2");
+
+  ASSERT_NE(nullptr, req_.get_output_headers().get("ETag"));
+  EXPECT_STREQ("\"1-2\"", req_.get_output_headers().get("ETag"));
+}
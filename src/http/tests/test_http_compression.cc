@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "gmock/gmock.h"
+
+#include <string>
+
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+#include "mysqlrouter/http_compression.h"
+
+#ifdef HAVE_ZLIB
+static std::string inflate_all(const std::string &compressed, int window_bits) {
+  z_stream strm {};
+  EXPECT_EQ(Z_OK, inflateInit2(&strm, window_bits));
+
+  std::string out(64 * 1024, '\0');
+  strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  strm.avail_in = static_cast<uInt>(compressed.size());
+  strm.next_out = reinterpret_cast<Bytef *>(&out[0]);
+  strm.avail_out = static_cast<uInt>(out.size());
+
+  EXPECT_EQ(Z_STREAM_END, inflate(&strm, Z_FINISH));
+  out.resize(strm.total_out);
+  inflateEnd(&strm);
+
+  return out;
+}
+
+TEST(HttpCompressionTest, negotiate) {
+  EXPECT_EQ(HttpContentEncoding::Identity, HttpCompressor::negotiate(nullptr));
+  EXPECT_EQ(HttpContentEncoding::Identity, HttpCompressor::negotiate(""));
+  EXPECT_EQ(HttpContentEncoding::Identity, HttpCompressor::negotiate("identity, br"));
+  EXPECT_EQ(HttpContentEncoding::Gzip, HttpCompressor::negotiate("gzip"));
+  EXPECT_EQ(HttpContentEncoding::Gzip, HttpCompressor::negotiate("deflate, GZIP"));
+  EXPECT_EQ(HttpContentEncoding::Gzip, HttpCompressor::negotiate("*"));
+  EXPECT_EQ(HttpContentEncoding::Deflate, HttpCompressor::negotiate("deflate"));
+  EXPECT_EQ(HttpContentEncoding::Deflate, HttpCompressor::negotiate("gzip;q=0.5, deflate"));
+  EXPECT_EQ(HttpContentEncoding::Deflate, HttpCompressor::negotiate("gzip;q=0, *"));
+  EXPECT_EQ(HttpContentEncoding::Identity, HttpCompressor::negotiate("gzip; q=0, deflate;q=0"));
+  EXPECT_EQ(HttpContentEncoding::Identity, HttpCompressor::negotiate("*;q=0"));
+}
+
+TEST(HttpCompressionTest, compress_gzip) {
+  const std::string body(4 * 1024, 'a');
+  std::string compressed = HttpCompressor::compress(HttpContentEncoding::Gzip, body.data(), body.size());
+
+  EXPECT_LT(compressed.size(), body.size());
+  EXPECT_EQ(body, inflate_all(compressed, 15 + 16));
+}
+
+TEST(HttpCompressionTest, compress_deflate) {
+  const std::string body(4 * 1024, 'a');
+  std::string compressed = HttpCompressor::compress(HttpContentEncoding::Deflate, body.data(), body.size());
+
+  EXPECT_LT(compressed.size(), body.size());
+  EXPECT_EQ(body, inflate_all(compressed, 15));
+}
+
+TEST(HttpCompressionTest, compress_streamed) {
+  HttpCompressor compressor(HttpContentEncoding::Gzip);
+
+  std::string compressed;
+  std::string body;
+  for (int i = 0; i < 100; i++) {
+    const std::string chunk = "{\"id\": " + std::to_string(i) + "},";
+    body += chunk;
+
+    const size_t before = compressed.size();
+    compressor.update(chunk.data(), chunk.size(), compressed);
+    // each chunk is flushed
+    EXPECT_GT(compressed.size(), before);
+  }
+  compressor.finish(compressed);
+
+  EXPECT_EQ(body, inflate_all(compressed, 15 + 16));
+}
+
+TEST(HttpCompressionTest, identity_not_compressible) {
+  EXPECT_THROW(HttpCompressor(HttpContentEncoding::Identity), std::invalid_argument);
+}
+#else
+TEST(HttpCompressionTest, negotiate_without_zlib) {
+  EXPECT_EQ(HttpContentEncoding::Identity, HttpCompressor::negotiate("gzip, deflate"));
+}
+#endif
+
+TEST(HttpCompressionTest, is_compressible_type) {
+  EXPECT_TRUE(HttpCompressor::is_compressible_type("application/json"));
+  EXPECT_TRUE(HttpCompressor::is_compressible_type("text/html; charset=utf-8"));
+  EXPECT_TRUE(HttpCompressor::is_compressible_type("image/svg+xml"));
+  EXPECT_TRUE(HttpCompressor::is_compressible_type("application/problem+json"));
+  EXPECT_FALSE(HttpCompressor::is_compressible_type("image/png"));
+  EXPECT_FALSE(HttpCompressor::is_compressible_type("application/octet-stream"));
+  EXPECT_FALSE(HttpCompressor::is_compressible_type(nullptr));
+}
+
+int main(int argc, char *argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
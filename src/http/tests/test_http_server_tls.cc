@@ -0,0 +1,192 @@
+/*
+  Copyright (c) 2026, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "gmock/gmock.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <event2/event.h>
+#include <event2/http.h>
+
+#ifdef HAVE_EVENT_OPENSSL
+#  include <openssl/ssl.h>
+#endif
+
+#ifndef _WIN32
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "http_server_tls.h"
+
+static const std::string kCertFile = std::string(HTTP_TEST_CERT_DIR) + "server-cert.pem";
+static const std::string kKeyFile = std::string(HTTP_TEST_CERT_DIR) + "server-key.pem";
+
+/**
+ * @test a missing certificate fails, whether TLS is supported or not.
+ */
+TEST(HttpServerTlsContext, MissingCertificate) {
+  ASSERT_THROW(HttpServerTlsContext("does-not-exist.pem", kKeyFile), std::runtime_error);
+}
+
+#if defined(HAVE_EVENT_OPENSSL) && !defined(_WIN32)
+
+/**
+ * evhttp server speaking TLS on a port of its own, in a thread.
+ */
+class HttpServerTlsTest: public ::testing::Test {
+protected:
+  void SetUp() override {
+    if (!HttpServerTlsContext::is_supported()) return;
+
+    tls_context_.reset(new HttpServerTlsContext(kCertFile, kKeyFile));
+
+    ev_base_ = event_base_new();
+    ev_http_ = evhttp_new(ev_base_);
+    tls_context_->attach(ev_http_);
+    evhttp_set_gencb(ev_http_, [](evhttp_request *req, void *) {
+      HttpServerTlsContext::shutdown_on_close(req);
+      evhttp_send_reply(req, 200, "OK", nullptr);
+    }, nullptr);
+
+    auto *handle = evhttp_bind_socket_with_handle(ev_http_, "127.0.0.1", 0);
+    ASSERT_NE(nullptr, handle);
+
+    sockaddr_in addr {};
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0, getsockname(evhttp_bound_socket_get_fd(handle),
+                             reinterpret_cast<sockaddr *>(&addr), &addr_len));
+    port_ = ntohs(addr.sin_port);
+
+    // libevent isn't set up for threads, the loop stops itself once woken up
+    ASSERT_EQ(0, evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, stop_fds_));
+    ev_stop_ = event_new(ev_base_, stop_fds_[0], EV_READ, [](evutil_socket_t, short, void *arg) {
+      event_base_loopbreak(static_cast<event_base *>(arg));
+    }, ev_base_);
+    event_add(ev_stop_, nullptr);
+
+    ev_thread_ = std::thread([this] { event_base_dispatch(ev_base_); });
+
+    client_ctx_ = SSL_CTX_new(SSLv23_client_method());
+    ASSERT_NE(nullptr, client_ctx_);
+  }
+
+  void TearDown() override {
+    if (ev_thread_.joinable()) {
+      const char c = 0;
+      EXPECT_EQ(1, send(stop_fds_[1], &c, 1, 0));
+      ev_thread_.join();
+    }
+    if (ev_stop_) event_free(ev_stop_);
+    for (auto fd: stop_fds_) {
+      if (fd != -1) evutil_closesocket(fd);
+    }
+    if (client_ctx_) SSL_CTX_free(client_ctx_);
+    if (ev_http_) evhttp_free(ev_http_);
+    if (ev_base_) event_base_free(ev_base_);
+  }
+
+  /**
+   * GET / over a new connection.
+   *
+   * @param session session to resume, replaced by the one the server issued
+   * @returns true if the handshake resumed the session
+   */
+  bool get(SSL_SESSION *&session, std::string &response) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_NE(-1, sock);
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port_);
+    EXPECT_EQ(0, connect(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)));
+
+    SSL *ssl = SSL_new(client_ctx_);
+    SSL_set_fd(ssl, sock);
+    if (session) SSL_set_session(ssl, session);
+    EXPECT_EQ(1, SSL_connect(ssl));
+    const bool resumed = SSL_session_reused(ssl) == 1;
+
+    const std::string request("GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    EXPECT_EQ(static_cast<int>(request.size()),
+              SSL_write(ssl, request.data(), static_cast<int>(request.size())));
+
+    response.clear();
+    char buf[1024];
+    int res;
+    while ((res = SSL_read(ssl, buf, sizeof(buf))) > 0) {
+      response.append(buf, static_cast<size_t>(res));
+    }
+
+    // with TLS 1.3 the tickets arrive after the handshake
+    if (session) SSL_SESSION_free(session);
+    session = SSL_get1_session(ssl);
+
+    // freeing it without a shutdown marks the session as not resumable
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(sock);
+
+    return resumed;
+  }
+
+  std::unique_ptr<HttpServerTlsContext> tls_context_;
+  event_base *ev_base_{nullptr};
+  evhttp *ev_http_{nullptr};
+  evutil_socket_t stop_fds_[2]{-1, -1};
+  event *ev_stop_{nullptr};
+  std::thread ev_thread_;
+  uint16_t port_{0};
+  SSL_CTX *client_ctx_{nullptr};
+};
+
+/**
+ * @test requests are served over TLS and reconnecting clients resume
+ * their session.
+ */
+TEST_F(HttpServerTlsTest, ResumesSession) {
+  if (!HttpServerTlsContext::is_supported()) return;
+
+  SSL_SESSION *session = nullptr;
+  std::string response;
+
+  EXPECT_FALSE(get(session, response));
+  EXPECT_THAT(response, ::testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(nullptr, session);
+
+  EXPECT_TRUE(get(session, response));
+  EXPECT_THAT(response, ::testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+
+  SSL_SESSION_free(session);
+
+  const auto stats = tls_context_->get_stats();
+  EXPECT_EQ(2u, stats.handshakes);
+  EXPECT_EQ(1u, stats.resumed);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+  Copyright (c) 2026, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "gmock/gmock.h"
+
+#include "mysqlrouter/http_common.h"
+
+/**
+ * @test IPv4 loopback addresses are all of 127.0.0.0/8.
+ */
+TEST(PeerAddressTest, ipv4_loopback) {
+  EXPECT_TRUE(is_loopback_address("127.0.0.1"));
+  EXPECT_TRUE(is_loopback_address("127.1.2.3"));
+  EXPECT_FALSE(is_loopback_address("128.0.0.1"));
+  EXPECT_FALSE(is_loopback_address("10.0.0.1"));
+  EXPECT_FALSE(is_loopback_address("0.0.0.0"));
+}
+
+/**
+ * @test IPv6 has only ::1, mapped IPv4 addresses count like IPv4 ones.
+ */
+TEST(PeerAddressTest, ipv6_loopback) {
+  EXPECT_TRUE(is_loopback_address("::1"));
+  EXPECT_TRUE(is_loopback_address("::ffff:127.0.0.1"));
+  EXPECT_FALSE(is_loopback_address("::ffff:192.168.0.1"));
+  EXPECT_FALSE(is_loopback_address("::"));
+  EXPECT_FALSE(is_loopback_address("fe80::1"));
+}
+
+/**
+ * @test names and malformed addresses are never loopback.
+ */
+TEST(PeerAddressTest, not_numeric) {
+  EXPECT_FALSE(is_loopback_address(""));
+  EXPECT_FALSE(is_loopback_address("localhost"));
+  EXPECT_FALSE(is_loopback_address("127.0.0.1.example.com"));
+}
+
+/**
+ * @test a request without connection has no peer.
+ */
+TEST(PeerAddressTest, no_connection) {
+  HttpRequest req{[](HttpRequest *, void *) {}};
+
+  EXPECT_EQ("", req.get_peer_address());
+  EXPECT_FALSE(is_loopback_address(req.get_peer_address()));
+}
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "gmock/gmock.h"
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include "static_file_cache.h"
+
+#ifndef _WIN32
+#include <unistd.h>  // getpid
+#endif
+
+class StaticFileCacheTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    path_ = "static_file_cache_test." + std::to_string(static_cast<long>(getpid()));
+  }
+
+  virtual void TearDown() {
+    std::remove(path_.c_str());
+  }
+
+  void write_file(const std::string &content) {
+    std::ofstream f(path_, std::ios::binary | std::ios::trunc);
+    f << content;
+  }
+
+  std::string path_;
+};
+
+TEST_F(StaticFileCacheTest, small_file_in_memory) {
+  write_file("hello");
+  StaticFileCache cache(10, 16, std::chrono::seconds(60));
+
+  auto entry = cache.get(path_);
+  ASSERT_NE(nullptr, entry);
+  EXPECT_FALSE(entry->is_directory);
+  EXPECT_TRUE(entry->in_memory);
+  EXPECT_EQ("hello", entry->content);
+  EXPECT_EQ(5, entry->size);
+
+  SCOPED_TRACE("// used again while valid");
+  EXPECT_EQ(entry, cache.get(path_));
+}
+
+TEST_F(StaticFileCacheTest, large_file_not_in_memory) {
+  write_file(std::string(100, 'x'));
+  StaticFileCache cache(10, 16, std::chrono::seconds(60));
+
+  auto entry = cache.get(path_);
+  ASSERT_NE(nullptr, entry);
+  EXPECT_FALSE(entry->in_memory);
+  EXPECT_TRUE(entry->content.empty());
+  EXPECT_EQ(100, entry->size);
+}
+
+TEST_F(StaticFileCacheTest, revalidates) {
+  write_file("hello");
+  StaticFileCache cache(10, 16, std::chrono::milliseconds(0));
+
+  auto entry = cache.get(path_);
+  ASSERT_NE(nullptr, entry);
+  EXPECT_EQ(entry, cache.get(path_));
+
+  SCOPED_TRACE("// changed size is noticed");
+  write_file("hello world");
+  auto changed = cache.get(path_);
+  ASSERT_NE(nullptr, changed);
+  EXPECT_EQ("hello world", changed->content);
+  EXPECT_EQ("hello", entry->content);
+
+  SCOPED_TRACE("// removed files drop out");
+  std::remove(path_.c_str());
+  EXPECT_EQ(nullptr, cache.get(path_));
+  EXPECT_EQ(ENOENT, errno);
+  EXPECT_EQ(0u, cache.size());
+}
+
+TEST_F(StaticFileCacheTest, directory) {
+  StaticFileCache cache(10, 16, std::chrono::seconds(60));
+
+  auto entry = cache.get(".");
+  ASSERT_NE(nullptr, entry);
+  EXPECT_TRUE(entry->is_directory);
+}
+
+TEST_F(StaticFileCacheTest, bounded) {
+  write_file("hello");
+  StaticFileCache cache(1, 16, std::chrono::seconds(60));
+
+  ASSERT_NE(nullptr, cache.get("."));
+  ASSERT_NE(nullptr, cache.get(path_));
+  EXPECT_EQ(1u, cache.size());
+}
+
+int main(int argc, char *argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
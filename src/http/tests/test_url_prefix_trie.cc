@@ -0,0 +1,99 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "gmock/gmock.h"
+
+
+#include "posix_re.h"
+#include "url_prefix_trie.h"
+
+class UrlPrefixTrieTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+  }
+};
+
+TEST_F(UrlPrefixTrieTest, regex_prefix) {
+  SCOPED_TRACE("// literal prefixes");
+
+  EXPECT_EQ(UrlRegexPrefix::Match::kExact, UrlRegexPrefix("^/api/v1/status$").match());
+  EXPECT_EQ("/api/v1/status", UrlRegexPrefix("^/api/v1/status$").prefix());
+  EXPECT_EQ(UrlRegexPrefix::Match::kPrefix, UrlRegexPrefix("^/static/").match());
+  EXPECT_EQ("/static/", UrlRegexPrefix("^/static/").prefix());
+
+  EXPECT_EQ(UrlRegexPrefix::Match::kRegex, UrlRegexPrefix("^/api/v1/routes/[^/]+/status$").match());
+  EXPECT_EQ("/api/v1/routes/", UrlRegexPrefix("^/api/v1/routes/[^/]+/status$").prefix());
+
+  SCOPED_TRACE("// quantifiers apply to the char before them");
+  EXPECT_EQ("/ap", UrlRegexPrefix("^/api?").prefix());
+  EXPECT_EQ(UrlRegexPrefix::Match::kRegex, UrlRegexPrefix("^/api?").match());
+
+  SCOPED_TRACE("// no anchor or alternatives, no prefix");
+  EXPECT_EQ("", UrlRegexPrefix("/status$").prefix());
+  EXPECT_EQ(UrlRegexPrefix::Match::kRegex, UrlRegexPrefix("/status$").match());
+  EXPECT_EQ("", UrlRegexPrefix("^/a$|^/b$").prefix());
+  EXPECT_EQ(UrlRegexPrefix::Match::kRegex, UrlRegexPrefix("^/a$|^/b$").match());
+}
+
+TEST_F(UrlPrefixTrieTest, matches_like_regex) {
+  SCOPED_TRACE("// plain text regexes match without running them");
+
+  for (const char *regex: { "^/api/v1/status$", "^/static/", "^/" }) {
+    UrlRegexPrefix prefix(regex);
+    PosixRE re(regex);
+    for (const char *url: { "/api/v1/status", "/api/v1/status/", "/static/a.css", "/" }) {
+      const std::string u(url);
+      const bool starts_with = u.compare(0, prefix.prefix().size(), prefix.prefix()) == 0;
+      EXPECT_EQ(re.search(u), starts_with && prefix.matches(u)) << regex << " " << url;
+    }
+  }
+}
+
+TEST_F(UrlPrefixTrieTest, find_prefixes) {
+  UrlPrefixTrie trie;
+  trie.insert("", 0);
+  trie.insert("/api/v1/", 1);
+  trie.insert("/api/", 2);
+  trie.insert("/static/", 3);
+  trie.insert("/api/v1/", 4);
+
+  std::vector<size_t> values;
+  trie.find_prefixes("/api/v1/status", values);
+  EXPECT_THAT(values, ::testing::ElementsAre(0, 2, 1, 4));
+
+  values.clear();
+  trie.find_prefixes("/apx", values);
+  EXPECT_THAT(values, ::testing::ElementsAre(0));
+
+  values.clear();
+  trie.find_prefixes("/api/", values);
+  EXPECT_THAT(values, ::testing::ElementsAre(0, 2));
+}
+
+
+int main(int argc, char *argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
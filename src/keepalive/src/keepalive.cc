@@ -31,23 +31,40 @@
  * [keepalive]
  * interval = 2
  * runs = 3
+ *
+ * With stall_threshold set, it also watches the event loops added to the
+ * LoopMonitor, like the I/O threads of the routes and the threads of the
+ * HTTP server: every half of the threshold it posts a heartbeat into each
+ * loop and warns about the loops whose heartbeat didn't run within the
+ * threshold, naming the loop and, with stack_dumps, logging the stack of
+ * its thread.
+ *
+ * [keepalive]
+ * stall_threshold = 500
+ * stack_dumps = 1
  */
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <map>
 #include <thread>
 
 // Harness interface include files
 #include "mysql/harness/config_parser.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/loop_monitor.h"
 #include "mysql/harness/plugin.h"
 
 using mysql_harness::ARCHITECTURE_DESCRIPTOR;
 using mysql_harness::ConfigSection;
+using mysql_harness::LoopMonitor;
 using mysql_harness::PluginFuncEnv;
 using mysql_harness::PLUGIN_ABI_VERSION;
 using mysql_harness::Plugin;
 using mysql_harness::logging::log_info;
+using mysql_harness::logging::log_warning;
 
 // Keep symbols with external linkage away from global scope so that
 // they do not clash with other symbols.
@@ -55,6 +72,91 @@ namespace {
 
 const int kInterval = 60;  // in seconds
 const int kRuns = 0;  // 0 means for ever
+const int kStallThreshold = 0;  // in milliseconds, 0 means not watching the loops
+
+// how long a stalled thread gets to record its stack
+const std::chrono::milliseconds kStackDumpTimeout{100};
+
+/**
+ * Reports the loops whose heartbeats wait longer than the threshold.
+ */
+class StallWatchdog {
+ public:
+  StallWatchdog(const std::string& name, std::chrono::milliseconds threshold,
+                bool stack_dumps)
+      : name_(name), threshold_(threshold), stack_dumps_(stack_dumps) {}
+
+  /**
+   * Reports the heartbeats posted by the previous check and posts new ones.
+   */
+  void check() {
+    auto& monitor = LoopMonitor::instance();
+
+    std::map<LoopMonitor::LoopId, Watched> watched;
+    for (const auto& loop : monitor.get_loops()) {
+      Watched state;
+      auto it = watched_.find(loop.id);
+      if (it != watched_.end()) state = it->second;
+
+      if (loop.pending >= threshold_ && !state.stalled) {
+        state.stalled = true;
+        log_warning("%s: '%s' stalled, its heartbeat waits for %lld ms",
+                    name_.c_str(), loop.name.c_str(), to_ms(loop.pending));
+        if (stack_dumps_) log_stack(loop);
+      }
+
+      if (loop.heartbeats != state.heartbeats) {
+        // a heartbeat ran since the last check
+        if (state.stalled) {
+          log_info("%s: '%s' recovered after %lld ms",
+                   name_.c_str(), loop.name.c_str(), to_ms(loop.last_lag));
+        } else if (loop.last_lag >= threshold_ && state.heartbeats != kUnseen) {
+          log_warning("%s: '%s' stalled for %lld ms",
+                      name_.c_str(), loop.name.c_str(), to_ms(loop.last_lag));
+        }
+        state.stalled = loop.pending >= threshold_;
+        state.heartbeats = loop.heartbeats;
+      }
+
+      watched.emplace(loop.id, state);
+    }
+    // forgets the loops removed since
+    watched_.swap(watched);
+
+    monitor.post_heartbeats();
+  }
+
+ private:
+  // loops seen for the first time may have run heartbeats of other watchdogs
+  static constexpr uint64_t kUnseen = UINT64_MAX;
+
+  struct Watched {
+    uint64_t heartbeats{kUnseen};
+    bool stalled{false};
+  };
+
+  static long long to_ms(std::chrono::microseconds us) {
+    return static_cast<long long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(us).count());
+  }
+
+  void log_stack(const LoopMonitor::LoopState& loop) {
+    std::string stack = LoopMonitor::instance().dump_stack(loop.id, kStackDumpTimeout);
+    if (!stack.empty() && stack.back() == '\n') stack.pop_back();
+    if (stack.empty()) {
+      log_warning("%s: stack of '%s' not available", name_.c_str(), loop.name.c_str());
+    } else {
+      log_warning("%s: stack of '%s':\n%s", name_.c_str(), loop.name.c_str(), stack.c_str());
+    }
+  }
+
+  const std::string name_;
+  const std::chrono::milliseconds threshold_;
+  const bool stack_dumps_;
+  std::map<LoopMonitor::LoopId, Watched> watched_;
+};
+
+constexpr uint64_t StallWatchdog::kUnseen;
 
 }
 
@@ -77,6 +179,20 @@ static void start(PluginFuncEnv* env) {
     // Anything in valid will result in using the default.
   }
 
+  int stall_threshold = kStallThreshold;
+  try {
+    stall_threshold = std::max(0, std::stoi(section->get("stall_threshold")));
+  } catch (...) {
+    // Anything in valid will result in using the default.
+  }
+
+  bool stack_dumps = false;
+  try {
+    stack_dumps = std::stoi(section->get("stack_dumps")) != 0;
+  } catch (...) {
+    // Anything in valid will result in using the default.
+  }
+
   std::string name = section->name;
   if (!section->key.empty()) {
     name += " " + section->key;
@@ -87,9 +203,36 @@ static void start(PluginFuncEnv* env) {
     log_info("%s will run %d time(s)", name.c_str(), runs);
   }
 
-  for (int total_runs = 0 ; runs == 0 || total_runs < runs ; ++total_runs) {
-    log_info("%s", name.c_str());
-    if (wait_for_stop(env, static_cast<uint32_t>(interval * 1000)))
+  if (stall_threshold == 0) {
+    for (int total_runs = 0 ; runs == 0 || total_runs < runs ; ++total_runs) {
+      log_info("%s", name.c_str());
+      if (wait_for_stop(env, static_cast<uint32_t>(interval * 1000)))
+        break;
+    }
+    return;
+  }
+
+  log_info("%s watches the event loops for stalls of %d ms%s", name.c_str(),
+           stall_threshold, stack_dumps ? ", dumping their stacks" : "");
+  StallWatchdog watchdog(name, std::chrono::milliseconds(stall_threshold), stack_dumps);
+  const auto check_interval = std::chrono::milliseconds(std::max(1, stall_threshold / 2));
+
+  using clock_type = std::chrono::steady_clock;
+  auto next_keepalive = clock_type::now();
+  for (int total_runs = 0 ; runs == 0 || total_runs < runs ; ) {
+    auto now = clock_type::now();
+    if (now >= next_keepalive) {
+      log_info("%s", name.c_str());
+      ++total_runs;
+      next_keepalive += std::chrono::seconds(interval);
+    }
+
+    watchdog.check();
+
+    // 0 would wait for ever
+    const auto wait = std::max(std::chrono::milliseconds(1), std::min(check_interval,
+        std::chrono::duration_cast<std::chrono::milliseconds>(next_keepalive - clock_type::now())));
+    if (wait_for_stop(env, static_cast<uint32_t>(wait.count())))
       break;
   }
 }
@@ -27,6 +27,7 @@
 #include "mysql/harness/filesystem.h"
 #include "mysql/harness/loader.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/loop_monitor.h"
 #include "mysql/harness/plugin.h"
 
 ////////////////////////////////////////
@@ -42,6 +43,9 @@
 #include <iostream>
 #include <fstream>
 #include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 using std::cout;
 using std::endl;
@@ -125,6 +129,64 @@ TEST_F(KeepalivePluginTest, CheckLog) {
   EXPECT_NE(UINT_MAX, start_line = find_line(start_line, "keepalive"));
 }
 
+TEST_F(KeepalivePluginTest, ReportsStalledLoop) {
+  std::map<std::string, std::string> params;
+  params["program"] = "harness";
+  params["prefix"] = g_here.c_str();
+  params["log_level"] = "info";
+  mysql_harness::LoaderConfig config(params, std::vector<std::string>(),
+                                     mysql_harness::Config::allow_keys);
+  config.read(g_here.join("data/keepalive_stalls.cfg"));
+  Loader stalls_loader("harness", config);
+
+  auto logging_folder = g_here.join("/var/log/keepalive");
+  const auto log_file = Path::make_path(logging_folder, "harness", "log");
+  init_test_logger({"keepalive"}, stalls_loader.get_config().get_default("logging_folder"), "harness");
+
+  std::fstream fs;
+  fs.open(log_file.str(), std::fstream::trunc | std::ofstream::out);
+  fs.close();
+
+  // a loop that never gets to its heartbeats
+  std::mutex mtx;
+  std::condition_variable cond;
+  bool stop = false;
+  mysql_harness::LoopMonitor::LoopId id = 0;
+  std::thread stalled([&]() {
+    auto loop_id = mysql_harness::LoopMonitor::instance().add(
+        "stalled loop", [](mysql_harness::LoopMonitor::Task) {});
+    std::unique_lock<std::mutex> lock(mtx);
+    id = loop_id;
+    cond.notify_all();
+    cond.wait(lock, [&stop]() { return stop; });
+  });
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [&id]() { return id != 0; });
+  }
+
+  ASSERT_NO_THROW(stalls_loader.start());
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+    cond.notify_all();
+  }
+  stalled.join();
+  mysql_harness::LoopMonitor::instance().remove(id);
+
+  std::ifstream ifs_log(log_file.str());
+  std::string log((std::istreambuf_iterator<char>(ifs_log)), std::istreambuf_iterator<char>());
+
+  EXPECT_NE(std::string::npos, log.find("watches the event loops for stalls of 100 ms"));
+  EXPECT_NE(std::string::npos, log.find("'stalled loop' stalled, its heartbeat waits for"));
+  // reported once, not on every check
+  EXPECT_EQ(log.find("'stalled loop' stalled"), log.rfind("'stalled loop' stalled"));
+  if (mysql_harness::LoopMonitor::is_stack_dump_supported()) {
+    EXPECT_NE(std::string::npos, log.find("stack of 'stalled loop':"));
+  }
+}
+
 int main(int argc, char *argv[]) {
   g_here = Path(argv[0]).dirname().str();
 
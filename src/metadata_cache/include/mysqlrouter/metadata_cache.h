@@ -26,12 +26,15 @@
 #define MYSQLROUTER_METADATA_CACHE_INCLUDED
 
 #include <chrono>
+#include <cstdint>
 #include <stdexcept>
 #include <exception>
 #include <vector>
 #include <map>
+#include <memory>
 #include <list>
 #include <string>
+#include <utility>
 
 #include "mysqlrouter/utils.h"
 #include "mysqlrouter/datatypes.h"
@@ -59,6 +62,9 @@ extern const std::string kDefaultMetadataAddress;
 extern const std::string kDefaultMetadataUser;
 extern const std::string kDefaultMetadataPassword;
 extern const std::chrono::milliseconds kDefaultMetadataTTL;
+extern const std::chrono::milliseconds kDefaultMembershipPollInterval;
+extern const std::chrono::milliseconds kDefaultMetadataMaxTTL;
+extern const unsigned int kDefaultRefreshJitter;
 extern const std::string kDefaultMetadataCluster;
 extern const unsigned int kDefaultConnectTimeout;
 extern const unsigned int kDefaultReadTimeout;
@@ -76,6 +82,13 @@ enum class METADATA_API ServerMode {
   Unavailable
 };
 
+/** @brief Role of a server in the metadata, see role_from_string() */
+enum class METADATA_API InstanceRole {
+  HA,
+  ReadScaleOut,
+  Unknown
+};
+
 enum class METADATA_API InstanceStatus {
   Reachable,
   InvalidHost, // Network connection cannot even be attempted (ie bad IP)
@@ -96,7 +109,7 @@ public:
   /** @brief The uuid of the MySQL server */
   std::string mysql_server_uuid;
   /** @brief The role of the server */
-  std::string role;
+  InstanceRole role;
   /** @brief The mode of the server */
   ServerMode mode;
   /** @brief The server weight */
@@ -111,6 +124,10 @@ public:
   unsigned int port;
   /** The X protocol port number in which the server is running */
   unsigned int xport;
+  /** @brief Transactions waiting in the applier queue of the server, 0 if unknown
+   *
+   * Changes with every refresh, not compared by operator==. */
+  uint64_t applier_queue_size;
 };
 
 /** @class ManagedReplicaSet
@@ -156,18 +173,133 @@ public:
     what_arg) { }
 };
 
+/** @brief Immutable list of the members of a replicaset
+ *
+ * Published by the metadata cache on every refresh that changes the topology.
+ * Holders keep the list they pinned alive even if a newer one is published.
+ */
+using InstancesSnapshot = std::shared_ptr<const std::vector<ManagedInstance>>;
+
 /** @class LookupResult
  *
  * Class holding result after looking up data in the cache.
  */
 class METADATA_API LookupResult {
+  /** @brief Snapshot the instance_vector refers to */
+  const InstancesSnapshot snapshot_;
+
 public:
   /** @brief Constructor */
   LookupResult(const std::vector<ManagedInstance> &instance_vector_) :
-  instance_vector(instance_vector_) { }
+  snapshot_(std::make_shared<const std::vector<ManagedInstance>>(instance_vector_)),
+  instance_vector(*snapshot_) { }
+
+  /** @brief Constructor sharing a published snapshot without copying it
+   *
+   * @param snapshot snapshot to share; nullptr is treated as an empty list
+   */
+  LookupResult(InstancesSnapshot snapshot) :
+  snapshot_(snapshot ? std::move(snapshot) : std::make_shared<const std::vector<ManagedInstance>>()),
+  instance_vector(*snapshot_) { }
+
+  LookupResult(const LookupResult &other) :
+  snapshot_(other.snapshot_), instance_vector(*snapshot_) { }
+
+  /** @brief Returns the snapshot backing instance_vector
+   *
+   * Two results returning the same snapshot describe the same topology,
+   * which lets callers cache whatever they derive from it.
+   */
+  const InstancesSnapshot &snapshot() const noexcept { return snapshot_; }
 
   /** @brief List of ManagedInstance objects */
-  const std::vector<metadata_cache::ManagedInstance> instance_vector;
+  const std::vector<metadata_cache::ManagedInstance> &instance_vector;
+};
+
+/** @class InstancesDiff
+ *
+ * Changes between two consecutive lists of the members of a replicaset,
+ * matched by mysql_server_uuid.
+ */
+class METADATA_API InstancesDiff {
+public:
+  /** @brief Members that were not in the previous list */
+  std::vector<ManagedInstance> added;
+  /** @brief Members of the previous list that are gone */
+  std::vector<ManagedInstance> removed;
+  /** @brief Members in both lists that changed (mode, address, ...), as (before, after) */
+  std::vector<std::pair<ManagedInstance, ManagedInstance>> changed;
+
+  /** @brief Returns whether both lists were the same */
+  bool empty() const noexcept {
+    return added.empty() && removed.empty() && changed.empty();
+  }
+};
+
+/** @brief Computes the changes between two lists of replicaset members
+ *
+ * @param before previous list of members
+ * @param after current list of members
+ */
+METADATA_API InstancesDiff diff_instances(const std::vector<ManagedInstance> &before,
+                                          const std::vector<ManagedInstance> &after);
+
+/** @brief Returns the role for its name in the metadata ("HA", "readScaleOut"),
+ *         InstanceRole::Unknown for any other name */
+METADATA_API InstanceRole role_from_string(const std::string &role);
+
+/** @brief Returns the name of the role in the metadata, "" for InstanceRole::Unknown */
+METADATA_API const char *role_to_string(InstanceRole role);
+
+/** @brief Name a replicaset is looked up by in a cache serving several clusters
+ *
+ * A metadata cache that serves a single cluster keys its replicasets by their
+ * name alone, one that serves several by "<cluster>/<replicaset>", which is
+ * what this returns.
+ *
+ * @param cluster_name name of the cluster the replicaset belongs to
+ * @param replicaset_name name of the replicaset in the metadata
+ */
+METADATA_API std::string qualified_replicaset_name(const std::string &cluster_name,
+                                                   const std::string &replicaset_name);
+
+/** @class RefreshStats
+ *
+ * Counters and timings of the refreshes of the metadata.
+ */
+class METADATA_API RefreshStats {
+public:
+  /** @brief Refreshes that fetched the metadata */
+  uint64_t refreshes{0};
+  /** @brief Refreshes that failed to fetch it from any metadata server */
+  uint64_t refresh_failures{0};
+  /** @brief Duration of the last refresh */
+  std::chrono::microseconds last_refresh_duration{0};
+  /** @brief Durations of all refreshes */
+  std::chrono::microseconds refresh_duration_sum{0};
+  /** @brief Times the refresh thread locked the cache, blocking lookups */
+  uint64_t lock_holds{0};
+  /** @brief Longest time the refresh thread held the lock */
+  std::chrono::microseconds max_lock_hold{0};
+  /** @brief Time the refresh thread held the lock, all holds together */
+  std::chrono::microseconds lock_hold_sum{0};
+  /** @brief Times the listeners got told about changes */
+  uint64_t notifications{0};
+  /** @brief Time telling the listeners took, all notifications together */
+  std::chrono::microseconds notify_duration_sum{0};
+};
+
+/** @class TopologySnapshot
+ *
+ * The members of all replicasets of the cache, as one version of the
+ * topology.
+ */
+class METADATA_API TopologySnapshot {
+public:
+  /** @brief Counts the changes of the topology, 0 until the first one was fetched */
+  uint64_t version{0};
+  /** @brief The members of each replicaset, by the name it is looked up by */
+  std::map<std::string, InstancesSnapshot> replicasets;
 };
 
 /**
@@ -186,6 +318,24 @@ public:
    * @param md_servers_reachable true if metadata changed, false if metadata unavailable
    */
   virtual void notify(const LookupResult& instances, const bool md_servers_reachable) noexcept = 0;
+
+  /**
+   * @brief Callback function that is called when state of replicaset is changed,
+   *        together with what changed since the previous notification.
+   *
+   * Listeners that can tell from the diff that the change doesn't concern
+   * them can skip recomputing their state. The default implementation ignores
+   * the diff.
+   *
+   * @param instances allowed nodes
+   * @param diff changes of the replicaset members since the previous notification
+   * @param md_servers_reachable true if metadata changed, false if metadata unavailable
+   */
+  virtual void notify(const LookupResult& instances, const InstancesDiff& /*diff*/,
+                      const bool md_servers_reachable) noexcept {
+    notify(instances, md_servers_reachable);
+  }
+
   virtual ~ReplicasetStateListenerInterface();
 };
 
@@ -252,13 +402,37 @@ METADATA_API class MetadataCacheAPIBase : public ReplicasetStateNotifierInterfac
    * @param read_timeout The time in seconds after which read from metadata
    *                     server should time out.
    * @param thread_stack_size memory in kilobytes allocated for thread's stack
+   * @param membership_poll_interval how often the Group Replication status of
+   *                                 the replicasets is polled between TTL
+   *                                 refreshes, 0 disables polling
+   * @param topology_cache_file file the last known topology is persisted to
+   *                            and routing starts from after a restart, empty
+   *                            disables the topology cache
+   * @param shared_topology if true, only one of the router processes using
+   *                        the same topology_cache_file refreshes the
+   *                        topology, the others read it from that file
+   * @param max_ttl if greater than ttl, the refresh interval backs off
+   *                exponentially up to max_ttl while the topology stays
+   *                unchanged and returns to ttl after any change or failure
+   * @param refresh_jitter percentage by which each wait between refreshes is
+   *                       randomly lengthened or shortened, 0 refreshes at
+   *                       fixed intervals
+   * @param order_metadata_servers if true, the metadata servers are tried
+   *                               fastest first by the duration of the past
+   *                               refreshes, servers that failed last
    */
   virtual void cache_init(const std::vector<mysql_harness::TCPAddress> &bootstrap_servers,
                           const std::string &user, const std::string &password,
                           std::chrono::milliseconds ttl, const mysqlrouter::SSLOptions &ssl_options,
                           const std::string &cluster_name,
                           int connect_timeout, int read_timeout,
-                          size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes) = 0;
+                          size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes,
+                          std::chrono::milliseconds membership_poll_interval = kDefaultMembershipPollInterval,
+                          const std::string &topology_cache_file = "",
+                          bool shared_topology = false,
+                          std::chrono::milliseconds max_ttl = kDefaultMetadataMaxTTL,
+                          unsigned int refresh_jitter = kDefaultRefreshJitter,
+                          bool order_metadata_servers = false) = 0;
 
   /**
    * @brief Teardown the metadata cache
@@ -318,6 +492,40 @@ METADATA_API class MetadataCacheAPIBase : public ReplicasetStateNotifierInterfac
    */
   virtual void remove_listener(const std::string& replicaset_name, ReplicasetStateListenerInterface* listener) = 0;
 
+  /**
+   * @brief Returns counters and timings of the refreshes of the metadata.
+   */
+  virtual RefreshStats get_refresh_stats() = 0;
+
+  /**
+   * @brief Returns the members of all replicasets with the version of the
+   *        topology they belong to.
+   */
+  virtual TopologySnapshot get_topology() = 0;
+
+  /**
+   * @brief Returns a counter of the changes of the published members,
+   *        applier queues included, without copying them.
+   *
+   * Unlike the version of the topology, it also changes if only the
+   * applier queue of a member does.
+   */
+  virtual uint64_t get_topology_generation() = 0;
+
+  /**
+   * @brief Waits until the topology changes from the given version.
+   *
+   * Returns right away if the topology already has another version. Doesn't
+   * block lookups while waiting.
+   *
+   * @param version version of the topology the caller knows
+   * @param timeout longest time to wait for a change
+   * @return the current topology, still of the given version if it didn't
+   *         change before the timeout or the cache got stopped
+   */
+  virtual TopologySnapshot wait_topology_change(uint64_t version,
+                                                std::chrono::milliseconds timeout) = 0;
+
   virtual  ~MetadataCacheAPIBase() {}
 };
 
@@ -329,7 +537,13 @@ METADATA_API class MetadataCacheAPI: public MetadataCacheAPIBase {
                   const std::string &user, const std::string &password,
                   std::chrono::milliseconds ttl, const mysqlrouter::SSLOptions &ssl_options,
                   const std::string &cluster_name,
-                  int connect_timeout, int read_timeout, size_t thread_stack_size) override;
+                  int connect_timeout, int read_timeout, size_t thread_stack_size,
+                  std::chrono::milliseconds membership_poll_interval,
+                  const std::string &topology_cache_file,
+                  bool shared_topology,
+                  std::chrono::milliseconds max_ttl,
+                  unsigned int refresh_jitter,
+                  bool order_metadata_servers) override;
 
   void cache_stop() noexcept override;
 
@@ -344,6 +558,13 @@ METADATA_API class MetadataCacheAPI: public MetadataCacheAPIBase {
   void add_listener(const std::string& replicaset_name, ReplicasetStateListenerInterface* listener) override;
   void remove_listener(const std::string& replicaset_name, ReplicasetStateListenerInterface* listener) override;
 
+  RefreshStats get_refresh_stats() override;
+
+  TopologySnapshot get_topology() override;
+  uint64_t get_topology_generation() override;
+  TopologySnapshot wait_topology_change(uint64_t version,
+                                        std::chrono::milliseconds timeout) override;
+
  private:
   MetadataCacheAPI() {}
   MetadataCacheAPI(const MetadataCacheAPI&) = delete;
@@ -40,6 +40,9 @@ namespace metadata_cache {
 
 const uint16_t kDefaultMetadataPort = 32275;
 const std::chrono::milliseconds kDefaultMetadataTTL = std::chrono::milliseconds(500);
+const std::chrono::milliseconds kDefaultMembershipPollInterval = std::chrono::milliseconds(0);
+const std::chrono::milliseconds kDefaultMetadataMaxTTL = std::chrono::milliseconds(0);
+const unsigned int kDefaultRefreshJitter = 0;
 const std::string kDefaultMetadataAddress{"127.0.0.1:" + mysqlrouter::to_string(
     kDefaultMetadataPort)};
 const std::string kDefaultMetadataUser = "";
@@ -48,6 +51,26 @@ const std::string kDefaultMetadataCluster = ""; // blank cluster name means pick
 const unsigned int kDefaultConnectTimeout = 30;
 const unsigned int kDefaultReadTimeout = 30;
 
+InstanceRole role_from_string(const std::string &role) {
+  if (role == "HA") return InstanceRole::HA;
+  if (role == "readScaleOut") return InstanceRole::ReadScaleOut;
+  return InstanceRole::Unknown;
+}
+
+const char *role_to_string(InstanceRole role) {
+  switch (role) {
+    case InstanceRole::HA: return "HA";
+    case InstanceRole::ReadScaleOut: return "readScaleOut";
+    case InstanceRole::Unknown: break;
+  }
+  return "";
+}
+
+std::string qualified_replicaset_name(const std::string &cluster_name,
+                                      const std::string &replicaset_name) {
+  return cluster_name + "/" + replicaset_name;
+}
+
 ReplicasetStateListenerInterface::~ReplicasetStateListenerInterface() = default;
 ReplicasetStateNotifierInterface::~ReplicasetStateNotifierInterface() = default;
 
@@ -78,6 +101,18 @@ MetadataCacheAPIBase* MetadataCacheAPI::instance() {
  * @param read_timeout The time in seconds after which read from metadata
  *                     server should timeout.
  * @param thread_stack_size memory in kilobytes allocated for thread's stack
+ * @param membership_poll_interval how often the Group Replication status is
+ *                                 polled between TTL refreshes (0 = never)
+ * @param topology_cache_file file the last known topology is persisted to,
+ *                            empty disables it
+ * @param shared_topology whether the router processes sharing the
+ *                        topology_cache_file let one of them refresh it
+ * @param max_ttl upper bound the refresh interval backs off to while the
+ *                topology doesn't change, not adaptive if not above ttl
+ * @param refresh_jitter percentage the waits between refreshes randomly
+ *                       deviate by, 0 disables the jitter
+ * @param order_metadata_servers whether the metadata servers are tried by
+ *                               their observed latency and failures
  */
 void MetadataCacheAPI::cache_init(const std::vector<mysql_harness::TCPAddress> &bootstrap_servers,
                   const std::string &user,
@@ -87,12 +122,20 @@ void MetadataCacheAPI::cache_init(const std::vector<mysql_harness::TCPAddress> &
                   const std::string &cluster_name,
                   int connect_timeout,
                   int read_timeout,
-                  size_t thread_stack_size) {
+                  size_t thread_stack_size,
+                  std::chrono::milliseconds membership_poll_interval,
+                  const std::string &topology_cache_file,
+                  bool shared_topology,
+                  std::chrono::milliseconds max_ttl,
+                  unsigned int refresh_jitter,
+                  bool order_metadata_servers) {
   std::lock_guard<std::mutex> lock(g_metadata_cache_m);
 
   g_metadata_cache.reset(new MetadataCache(bootstrap_servers,
     get_instance(user, password, connect_timeout, read_timeout, 1, ttl, ssl_options), ttl,
-                 ssl_options, cluster_name, thread_stack_size));
+                 ssl_options, cluster_name, thread_stack_size, membership_poll_interval,
+                 topology_cache_file, shared_topology, max_ttl,
+                 refresh_jitter, order_metadata_servers));
   g_metadata_cache->start();
 }
 
@@ -118,7 +161,7 @@ void MetadataCacheAPI::cache_stop() noexcept {
 LookupResult MetadataCacheAPI::lookup_replicaset(const std::string &replicaset_name) {
   LOCK_METADATA_AND_CHECK_INITIALIZED();
 
-  return LookupResult(g_metadata_cache->replicaset_lookup(replicaset_name));
+  return LookupResult(g_metadata_cache->replicaset_snapshot(replicaset_name));
 }
 
 
@@ -144,4 +187,31 @@ void MetadataCacheAPI::remove_listener(const std::string& replicaset_name, Repli
   g_metadata_cache->remove_listener(replicaset_name, listener);
 }
 
+RefreshStats MetadataCacheAPI::get_refresh_stats() {
+  LOCK_METADATA_AND_CHECK_INITIALIZED();
+  return g_metadata_cache->get_refresh_stats();
+}
+
+TopologySnapshot MetadataCacheAPI::get_topology() {
+  LOCK_METADATA_AND_CHECK_INITIALIZED();
+  return g_metadata_cache->get_topology();
+}
+
+uint64_t MetadataCacheAPI::get_topology_generation() {
+  LOCK_METADATA_AND_CHECK_INITIALIZED();
+  return g_metadata_cache->get_topology_generation();
+}
+
+TopologySnapshot MetadataCacheAPI::wait_topology_change(uint64_t version,
+                                                        std::chrono::milliseconds timeout) {
+  MetadataCache *cache;
+  {
+    LOCK_METADATA_AND_CHECK_INITIALIZED();
+    cache = g_metadata_cache.get();
+  }
+  // waits without holding g_metadata_cache_m, which would block the lookups.
+  // The cache is only replaced by cache_init(), stopping it wakes the waiters.
+  return cache->wait_topology_change(version, timeout);
+}
+
 } // namespace metadata_cache
@@ -25,6 +25,7 @@
 #include "cluster_metadata.h"
 #include "dim.h"
 #include "group_replication_metadata.h"
+#include "mysql/harness/executor.h"
 #include "mysql/harness/logging/logging.h"
 #include "mysqlrouter/mysql_session.h"
 #include "mysqlrouter/uri.h"
@@ -32,9 +33,13 @@
 #include "tcp_address.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstdlib>
+#include <exception>
+#include <future>
+#include <stdexcept>
 #include <vector>
 #include <sstream>
 #include <stdio.h>
@@ -48,6 +53,9 @@ using mysqlrouter::MySQLSession;
 using mysqlrouter::strtoi_checked;
 IMPORT_LOG_FUNCTIONS()
 
+// upper bound of replicasets whose status is updated at the same time
+static const size_t kMaxConcurrentReplicasetUpdates = 4;
+
 /**
  * Return a string representation of the input character string.
  *
@@ -121,6 +129,15 @@ bool ClusterMetadata::do_connect(MySQLSession& connection, const metadata_cache:
 
 bool ClusterMetadata::connect(const metadata_cache::ManagedInstance &metadata_server) noexcept {
 
+  // keep using the connection from the previous refresh, unless it failed
+  std::string host = (metadata_server.host == "localhost" ? "127.0.0.1" : metadata_server.host);
+  if (metadata_connection_ && metadata_connection_->is_connected() &&
+      metadata_connection_->get_address() == host + ":" + std::to_string(metadata_server.port)) {
+    log_debug("Reusing connection to metadata server running on %s:%i",
+              metadata_server.host.c_str(), metadata_server.port);
+    return true;
+  }
+
   // Get a clean metadata server connection object
   // (RAII will close the old one if needed).
   try {
@@ -164,18 +181,35 @@ void ClusterMetadata::update_replicaset_status(const std::string &name,
     if (mi_addr == metadata_connection_->get_address()) { // optimisation: if node is the same as metadata server,
       gr_member_connection = metadata_connection_;        //               share the established connection
     } else {
-      try {
-        gr_member_connection = mysql_harness::DIM::instance().new_MySQLSession();
-      } catch (const std::logic_error& e) {
-        // defensive programming, shouldn't really happen. If it does, there's nothing we can do really, we give up
-        log_error("While updating metadata, could not initialise MySQL connetion structure");
-        throw metadata_cache::metadata_error(e.what());
+      {
+        // reuse the connection from a previous refresh if there is one
+        std::lock_guard<std::mutex> lock(connections_mtx_);
+        auto it = member_connections_.find(mi_addr);
+        if (it != member_connections_.end() && it->second->is_connected())
+          gr_member_connection = it->second;
+        else
+          gr_member_connection.reset();
       }
 
-      if (!do_connect(*gr_member_connection, mi)) {
-        log_warning("While updating metadata, could not establish a connection to replicaset '%s' through %s",
-                  name.c_str(), mi_addr.c_str());
-        continue; // server down, next!
+      if (!gr_member_connection) {
+        try {
+          gr_member_connection = mysql_harness::DIM::instance().new_MySQLSession();
+        } catch (const std::logic_error& e) {
+          // defensive programming, shouldn't really happen. If it does, there's nothing we can do really, we give up
+          log_error("While updating metadata, could not initialise MySQL connetion structure");
+          throw metadata_cache::metadata_error(e.what());
+        }
+
+        if (!do_connect(*gr_member_connection, mi)) {
+          log_warning("While updating metadata, could not establish a connection to replicaset '%s' through %s",
+                    name.c_str(), mi_addr.c_str());
+          std::lock_guard<std::mutex> lock(connections_mtx_);
+          member_connections_.erase(mi_addr);
+          continue; // server down, next!
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mtx_);
+        member_connections_[mi_addr] = gr_member_connection;
       }
     }
 
@@ -213,12 +247,27 @@ void ClusterMetadata::update_replicaset_status(const std::string &name,
 
       if (found_quorum) {
         replicaset.single_primary_mode = single_primary_mode;
+
+        // how far the members are behind, for the routes that limit it
+        const auto applier_queues = fetch_group_replication_applier_queues(*gr_member_connection);
+        for (auto &member : replicaset.members) {
+          auto queue = applier_queues.find(member.mysql_server_uuid);
+          member.applier_queue_size = queue != applier_queues.end() ? queue->second : 0;
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mtx_);
+        quorum_connections_[name] = gr_member_connection;
         break; // break out of the member iteration loop
       }
 
     } catch (const metadata_cache::metadata_error& e) {
       log_warning("Unable to fetch live group_replication member data from %s from replicaset '%s': %s",
                   mi_addr.c_str(), name.c_str(), e.what());
+      // reconnect next time, the connection may be what is broken
+      if (gr_member_connection != metadata_connection_) {
+        std::lock_guard<std::mutex> lock(connections_mtx_);
+        member_connections_.erase(mi_addr);
+      }
       continue; // faulty server, next!
     } catch (...) {
       assert(0);  // unexpected exception
@@ -231,6 +280,11 @@ void ClusterMetadata::update_replicaset_status(const std::string &name,
   log_debug("End updating replicaset for '%s'", name.c_str());
 
   if (!found_quorum) {
+    {
+      std::lock_guard<std::mutex> lock(connections_mtx_);
+      quorum_connections_.erase(name);
+    }
+
     std::string msg("Unable to fetch live group_replication member data from any server in replicaset '");
     msg += name + "'";
     log_error("%s", msg.c_str());
@@ -343,25 +397,159 @@ metadata_cache::ReplicasetStatus ClusterMetadata::check_replicaset_status(
 // throws metadata_cache::metadata_error
 ClusterMetadata::ReplicaSetsByName ClusterMetadata::fetch_instances(
     const std::string &cluster_name) {
-  log_debug("Updating metadata information for cluster '%s'", cluster_name.c_str());
+  return fetch_clusters_instances({cluster_name});
+}
 
+// throws metadata_cache::metadata_error
+ClusterMetadata::ReplicaSetsByName ClusterMetadata::fetch_clusters_instances(
+    const std::vector<std::string> &cluster_names) {
   assert(metadata_connection_->is_connected());
 
-  // fetch existing replicasets in the cluster from the metadata server (this is the topology that was configured,
+  // fetch existing replicasets in the clusters from the metadata server (this is the topology that was configured,
   // it will be compared later against current topology reported by (a server in) replicaset)
-  ReplicaSetsByName replicasets(fetch_instances_from_metadata_server(cluster_name)); // throws metadata_cache::metadata_error
-  if (replicasets.empty())
-    log_warning("No replicasets defined for cluster '%s'", cluster_name.c_str());
+  ReplicaSetsByName replicasets;
+  for (const auto &cluster_name : cluster_names) {
+    log_debug("Updating metadata information for cluster '%s'", cluster_name.c_str());
+
+    ReplicaSetsByName cluster_replicasets;
+    try {
+      cluster_replicasets = fetch_instances_from_metadata_server(cluster_name); // throws metadata_cache::metadata_error
+    } catch (const metadata_cache::metadata_error&) {
+      // don't reuse the connection on the next refresh, the connection may be what is broken
+      metadata_connection_.reset();
+      throw;
+    }
+    if (cluster_replicasets.empty())
+      log_warning("No replicasets defined for cluster '%s'", cluster_name.c_str());
+
+    if (cluster_names.size() == 1) {
+      replicasets = std::move(cluster_replicasets);
+      break;
+    }
+    for (auto &&rs : cluster_replicasets) {
+      replicasets.emplace(metadata_cache::qualified_replicaset_name(cluster_name, rs.first),
+                          std::move(rs.second));
+    }
+  }
 
   // now connect to each replicaset and query it for the list and status of its members.
   // (more precisely, foreach replicaset: search and connect to a member which is part of quorum to retrieve this data)
+  //
+  // Replicasets are independent of each other (and each has its own connections,
+  // a server is member of one replicaset only), so they get updated concurrently
+  // to not let a slow or partitioned one delay the others, whichever cluster
+  // they belong to.
+  std::vector<ReplicaSetsByName::value_type*> pending;
   for (auto &&rs : replicasets) {
-    update_replicaset_status(rs.first, rs.second);  // throws metadata_cache::metadata_error
+    pending.push_back(&rs);
+  }
+  std::vector<std::exception_ptr> errors(pending.size());
+  std::atomic<size_t> next_pending{0};
+  auto update_pending = [&]() {
+    for (size_t i; (i = next_pending.fetch_add(1)) < pending.size();) {
+      try {
+        update_replicaset_status(pending[i]->first, pending[i]->second);  // throws metadata_cache::metadata_error
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  // helpers run on the executor shared by the plugins, this thread takes part
+  // too, so the update doesn't depend on workers being free
+  mysql_harness::Executor &executor = mysql_harness::DIM::instance().get_Executor();
+  std::vector<std::future<void>> helpers;
+  const size_t num_workers = std::min({pending.size(), kMaxConcurrentReplicasetUpdates,
+                                       executor.size() + 1});
+  for (size_t i = 1; i < num_workers; ++i) {
+    try {
+      helpers.push_back(executor.submit(update_pending));
+    } catch (const std::logic_error &e) {
+      log_warning("Could not submit task to update replicasets: %s", e.what());
+      break;  // this thread updates whatever is left
+    }
+  }
+  update_pending();
+  // helpers that start late find nothing left to update
+  for (auto &helper : helpers) {
+    helper.wait();
+  }
+  for (auto &error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+
+  // forget the connections to replicasets and members that are gone
+  std::lock_guard<std::mutex> lock(connections_mtx_);
+  for (auto it = quorum_connections_.begin(); it != quorum_connections_.end();) {
+    if (replicasets.count(it->first) == 0)
+      it = quorum_connections_.erase(it);
+    else
+      ++it;
+  }
+  for (auto it = member_connections_.begin(); it != member_connections_.end();) {
+    bool is_member = false;
+    for (const auto &rs : replicasets) {
+      for (const auto &mi : rs.second.members) {
+        if ((mi.host == "localhost" ? "127.0.0.1" : mi.host) + ":" + std::to_string(mi.port) == it->first)
+          is_member = true;
+      }
+    }
+    if (!is_member)
+      it = member_connections_.erase(it);
+    else
+      ++it;
   }
 
   return replicasets;
 }
 
+bool ClusterMetadata::fetch_replicaset_status(const std::string &name,
+    metadata_cache::ManagedReplicaSet &replicaset) { // throws metadata_cache::metadata_error
+  std::shared_ptr<MySQLSession> quorum_connection;
+  {
+    std::lock_guard<std::mutex> lock(connections_mtx_);
+    auto it = quorum_connections_.find(name);
+    if (it != quorum_connections_.end()) {
+      quorum_connection = it->second;
+    }
+  }
+  if (quorum_connection) {
+    MySQLSession &connection = *quorum_connection;
+    if (connection.is_connected()) {
+      try {
+        bool single_primary_mode = true;
+        std::map<std::string, GroupReplicationMember> member_status =
+            fetch_group_replication_members(connection, single_primary_mode); // throws metadata_cache::metadata_error
+
+        if (check_replicaset_status(replicaset.members, member_status) !=
+            metadata_cache::ReplicasetStatus::Unavailable) {
+          replicaset.single_primary_mode = single_primary_mode;
+          return true;
+        }
+        log_warning("%s is no longer part of quorum for replicaset '%s'",
+                    connection.get_address().c_str(), name.c_str());
+      } catch (const metadata_cache::metadata_error& e) {
+        log_warning("Unable to fetch live group_replication member data from %s from replicaset '%s': %s",
+                    connection.get_address().c_str(), name.c_str(), e.what());
+        if (quorum_connection != metadata_connection_) {
+          std::lock_guard<std::mutex> lock(connections_mtx_);
+          member_connections_.erase(connection.get_address());
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(connections_mtx_);
+    quorum_connections_.erase(name);
+  }
+
+  // look for another member that is part of quorum; this needs the metadata
+  // server connection, so leave it to the next full refresh if that is gone
+  if (!metadata_connection_ || !metadata_connection_->is_connected())
+    return false;
+
+  update_replicaset_status(name, replicaset);  // throws metadata_cache::metadata_error
+  return true;
+}
+
 // throws metadata_cache::metadata_error
 ClusterMetadata::ReplicaSetsByName ClusterMetadata::fetch_instances_from_metadata_server(
     const std::string &cluster_name) {
@@ -418,9 +606,10 @@ ClusterMetadata::ReplicaSetsByName ClusterMetadata::fetch_instances_from_metadat
     }
 
     metadata_cache::ManagedInstance s;
+    s.applier_queue_size = 0;
     s.replicaset_name = get_string(row[0]);
     s.mysql_server_uuid = get_string(row[1]);
-    s.role = get_string(row[2]);
+    s.role = metadata_cache::role_from_string(get_string(row[2]));
     s.weight = row[3] ? std::strtof(row[3], nullptr) : 0;
     s.version_token = row[4] ? static_cast<unsigned int>(strtoi_checked(row[4])) : 0;
     s.location = get_string(row[5]);
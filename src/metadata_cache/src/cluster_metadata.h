@@ -34,6 +34,7 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <mutex>
 #include <string>
 #include <string.h>
 
@@ -86,6 +87,33 @@ class METADATA_API ClusterMetadata : public MetaData {
    */
   ReplicaSetsByName fetch_instances(const std::string &cluster_name) override; // throws metadata_cache::metadata_error
 
+  /** @brief Returns the replicasets of several clusters
+   *
+   * The topologies of all clusters are read over the one metadata server
+   * connection, then the status of the replicasets of all of them is
+   * updated in one concurrent pass.
+   *
+   * @param cluster_names the names of the clusters to query
+   * @return Map of replicaset ID, server list pairs, see
+   *         MetaData::fetch_clusters_instances() for the IDs
+   * @throws metadata_cache::metadata_error
+   */
+  ReplicaSetsByName fetch_clusters_instances(const std::vector<std::string> &cluster_names) override;
+
+  /** @brief Refreshes the Group Replication status of one replicaset
+   *
+   * Queries the quorum member the replicaset was last read from over the
+   * connection that is kept open to it, and only searches the members for a
+   * new quorum member if that one fails.
+   *
+   * @param name name of the replicaset
+   * @param replicaset replicaset whose members get updated
+   * @return false if there is no connection to the metadata server
+   * @throws metadata_cache::metadata_error
+   */
+  bool fetch_replicaset_status(const std::string &name,
+                               metadata_cache::ManagedReplicaSet &replicaset) override;
+
 #if 0 // not used so far
   /** @brief Returns the refresh interval provided by the metadata server.
    *
@@ -180,6 +208,14 @@ class METADATA_API ClusterMetadata : public MetaData {
   // connection to metadata server (it may also be shared with GR status queries for optimisation purposes)
   std::shared_ptr<mysqlrouter::MySQLSession> metadata_connection_;
 
+  // connections to the members the status of each replicaset was last successfully read from
+  std::map<std::string, std::shared_ptr<mysqlrouter::MySQLSession>> quorum_connections_;
+  // authenticated connections to replicaset members, keyed by "host:port",
+  // kept across refreshes and only dropped when they fail
+  std::map<std::string, std::shared_ptr<mysqlrouter::MySQLSession>> member_connections_;
+  // replicasets are updated concurrently by fetch_instances()
+  std::mutex connections_mtx_;
+
 #if 0 // not used so far
   // How many times we tried to reconnected (for logging purposes)
   size_t reconnect_tries_;
@@ -204,6 +240,10 @@ class METADATA_API ClusterMetadata : public MetaData {
   FRIEND_TEST(MetadataTest, CheckReplicasetStatus_Cornercase2of5Alive);
   FRIEND_TEST(MetadataTest, CheckReplicasetStatus_Cornercase3of5Alive);
   FRIEND_TEST(MetadataTest, CheckReplicasetStatus_Cornercase1Common);
+  FRIEND_TEST(MetadataTest, UpdateReplicasetStatus_CombinedQuery);
+  FRIEND_TEST(MetadataTest, UpdateReplicasetStatus_CombinedQueryRejected);
+  FRIEND_TEST(MetadataTest, UpdateReplicasetStatus_ReusesMemberConnection);
+  FRIEND_TEST(MetadataTest, FetchReplicasetStatus_ReusesQuorumConnection);
 #endif
 };
 
@@ -30,12 +30,56 @@
 #include <cstdlib>
 #include <cstring>
 #include <assert.h> // <cassert> is flawed: assert() lands in global namespace on Ubuntu 14.04, not std::
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 
 using mysqlrouter::MySQLSession;
 IMPORT_LOG_FUNCTIONS()
 
+// Topology query that also returns the primary member (as seen by the node)
+// in the last column, saving the round trip of
+// find_group_replication_primary_member(). Needs
+// performance_schema.global_status, which exists since MySQL 5.7.6.
+static const char *kQueryMembersWithPrimaryMember =
+  "SELECT member_id, member_host, member_port, member_state, @@group_replication_single_primary_mode, "
+  "(SELECT variable_value FROM performance_schema.global_status"
+  " WHERE variable_name = 'group_replication_primary_member')"
+  " FROM performance_schema.replication_group_members"
+  " WHERE channel_name = 'group_replication_applier'";
+static const unsigned long kMinServerVersionWithGlobalStatusTable = 50706;
+
+// applier queue of all members, as broadcast in the group. The column exists
+// since MySQL 8.0.2, before the table only had the certification queue of
+// the local member.
+static const char *kQueryMemberApplierQueues =
+  "SELECT member_id, count_transactions_remote_in_applier_queue"
+  " FROM performance_schema.replication_group_member_stats"
+  " WHERE channel_name = 'group_replication_applier'";
+static const unsigned long kMinServerVersionWithApplierQueueStats = 80002;
+
+// server errors of kQueryMembersWithPrimaryMember telling that the server
+// lacks the table or column, ER_NO_SUCH_TABLE and ER_BAD_FIELD_ERROR
+static const unsigned int kErNoSuchTable = 1146;
+static const unsigned int kErBadFieldError = 1054;
+
+// servers which rejected kQueryMembersWithPrimaryMember, by address, with
+// the version they had then. The separate queries are used for them until
+// they run another version.
+static std::mutex combined_members_query_unsupported_mtx;
+static std::map<std::string, unsigned long> combined_members_query_unsupported;
+
+static bool supports_combined_members_query(MySQLSession& connection) {
+  const unsigned long version = connection.server_version();
+  if (version < kMinServerVersionWithGlobalStatusTable)
+    return false;
+
+  std::lock_guard<std::mutex> lock(combined_members_query_unsupported_mtx);
+  auto it = combined_members_query_unsupported.find(connection.get_address());
+  return it == combined_members_query_unsupported.end() || it->second != version;
+}
+
 // throws metadata_cache::metadata_error
 static std::string find_group_replication_primary_member(MySQLSession& connection) {
 
@@ -88,12 +132,18 @@ std::map<std::string, GroupReplicationMember> fetch_group_replication_members(
     MySQLSession& connection, bool &single_master) {
 
   std::map<std::string, GroupReplicationMember> members;
+  std::string primary_member;
 
-  // who's the primary node? (throws metadata_cache::metadata_error)
-  std::string primary_member = find_group_replication_primary_member(connection);
-
+  // if the primary member column is not part of the topology query, the
+  // primary needs to be fetched separately beforehand
+  const bool combined_query = supports_combined_members_query(connection);
+  if (!combined_query) {
+    // who's the primary node? (throws metadata_cache::metadata_error)
+    primary_member = find_group_replication_primary_member(connection);
+  }
 
-  auto result_processor = [&members, &primary_member, &single_master](const MySQLSession::Row& row) -> bool {
+  size_t expected_fields = combined_query ? 6 : 5;
+  auto result_processor = [&members, &primary_member, &single_master, &expected_fields](const MySQLSession::Row& row) -> bool {
 
     // example response from node that left GR (sees only itself):
     // +--------------------------------------+-------------+-------------+--------------+-----------------------------------------+
@@ -110,9 +160,13 @@ std::map<std::string, GroupReplicationMember> fetch_group_replication_members(
     // | 4c08b4a2-861d-11e6-a256-08002741aeb6 | ubuntu      |        3330 | ONLINE       |                                       1 |
     // +--------------------------------------+-------------+-------------+--------------+-----------------------------------------+
 
-    if (row.size() != 5) {  // TODO write a testcase for this
+    if (row.size() != expected_fields) {  // TODO write a testcase for this
       throw metadata_cache::metadata_error("Unexpected number of fields in resultset from group_replication query. "
-                                           "Expected = 5, got = " + std::to_string(row.size()));
+                                           "Expected = " + std::to_string(expected_fields) +
+                                           ", got = " + std::to_string(row.size()));
+    }
+    if (expected_fields == 6) {
+      primary_member = row[5] ? row[5] : "";
     }
 
     // read fields from row
@@ -163,11 +217,25 @@ std::map<std::string, GroupReplicationMember> fetch_group_replication_members(
     return true;  // false = I don't want more rows
   };
 
-  // TODO optimisation some day:
-  // Query executed in find_group_replication_primary_member() can be optimised away
-  // by blending into the following query.  Unit tests will also have to be updated.
-
   // get current topology (as seen by this node)
+  if (combined_query) {
+    try {
+      connection.query(kQueryMembersWithPrimaryMember, result_processor);
+      return members;
+    } catch (const MySQLSession::Error& e) {
+      // other errors (lost connection, ...) are not the query's fault
+      if (e.code() != kErNoSuchTable && e.code() != kErBadFieldError)
+        throw metadata_cache::metadata_error(e.what());
+      log_info("%s rejected combined group_replication query (%s), falling back to separate queries",
+               connection.get_address().c_str(), e.what());
+      std::lock_guard<std::mutex> lock(combined_members_query_unsupported_mtx);
+      combined_members_query_unsupported[connection.get_address()] = connection.server_version();
+    }
+    members.clear();
+    expected_fields = 5;
+    primary_member = find_group_replication_primary_member(connection);
+  }
+
   try {
     connection.query(
       "SELECT member_id, member_host, member_port, member_state, @@group_replication_single_primary_mode"
@@ -186,3 +254,26 @@ std::map<std::string, GroupReplicationMember> fetch_group_replication_members(
 
   return members;
 }
+
+std::map<std::string, uint64_t> fetch_group_replication_applier_queues(
+    MySQLSession& connection) noexcept {
+  std::map<std::string, uint64_t> queues;
+  if (connection.server_version() < kMinServerVersionWithApplierQueueStats)
+    return queues;
+
+  auto result_processor = [&queues](const MySQLSession::Row& row) -> bool {
+    if (row.size() == 2 && row[0] && row[1])
+      queues[row[0]] = std::strtoull(row[1], nullptr, 10);
+    return true;  // false = I don't want more rows
+  };
+
+  try {
+    connection.query(kQueryMemberApplierQueues, result_processor);
+  } catch (const std::exception& e) {
+    // the members count as not lagging
+    log_debug("Fetching the applier queues of the group members failed: %s", e.what());
+    queues.clear();
+  }
+
+  return queues;
+}
@@ -25,6 +25,7 @@
 #ifndef GROUP_REPLICATION_METADATA_INCLUDED
 #define GROUP_REPLICATION_METADATA_INCLUDED
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -59,4 +60,13 @@ struct GroupReplicationMember {
 std::map<std::string, GroupReplicationMember>
 fetch_group_replication_members(mysqlrouter::MySQLSession& connection, bool &single_master);
 
+/** Fetches the number of transactions waiting in the applier queue of the
+ * group replication members, by member_id.
+ *
+ * Needs MySQL 8.0.2 or later, returns no members for older servers or if
+ * the query fails.
+ */
+std::map<std::string, uint64_t>
+fetch_group_replication_applier_queues(mysqlrouter::MySQLSession& connection) noexcept;
+
 #endif
@@ -30,6 +30,7 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <utility>
 
 /**
  * The metadata class is used to create a pluggable transport layer
@@ -40,6 +41,40 @@ public:
   using ReplicaSetsByName = std::map<std::string, metadata_cache::ManagedReplicaSet>;
   virtual ReplicaSetsByName fetch_instances(const std::string &cluster_name) = 0;
 
+  /** @brief Fetches the replicasets of several clusters of the same metadata
+   *
+   * A single cluster is fetched with fetch_instances(). With more than one
+   * the replicasets are keyed by metadata_cache::qualified_replicaset_name(),
+   * so that the replicasets of different clusters don't clash. The default
+   * fetches the clusters one after the other.
+   */
+  virtual ReplicaSetsByName fetch_clusters_instances(const std::vector<std::string> &cluster_names) {
+    if (cluster_names.size() == 1)
+      return fetch_instances(cluster_names.front());
+
+    ReplicaSetsByName replicasets;
+    for (const auto &cluster_name : cluster_names) {
+      for (auto &&rs : fetch_instances(cluster_name)) {
+        replicasets.emplace(metadata_cache::qualified_replicaset_name(cluster_name, rs.first),
+                            std::move(rs.second));
+      }
+    }
+    return replicasets;
+  }
+
+  /** @brief Refreshes the live status of the members of one replicaset
+   *
+   * Unlike fetch_instances() the configured members are taken from
+   * `replicaset` as they are, only their current state is queried.
+   *
+   * @return false if the transport can't refresh the status on its own and
+   *         a full fetch_instances() is needed instead
+   */
+  virtual bool fetch_replicaset_status(const std::string &/*name*/,
+                                       metadata_cache::ManagedReplicaSet &/*replicaset*/) {
+    return false;
+  }
+
   virtual bool connect(const metadata_cache::ManagedInstance &metadata_server) = 0;
   virtual void disconnect() = 0;
   virtual ~MetaData() { }
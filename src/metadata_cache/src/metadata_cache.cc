@@ -477,8 +477,12 @@
 
 #include "common.h"
 #include "metadata_cache.h"
+#include "topology_cache.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/tracepoints.h"
+#include "mysqlrouter/utils.h"
 
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include <memory>
@@ -492,21 +496,46 @@ MetadataCache::MetadataCache(
   std::chrono::milliseconds ttl,
   const mysqlrouter::SSLOptions &ssl_options,
   const std::string &cluster,
-  size_t thread_stack_size) : refresh_thread_(thread_stack_size) {
+  size_t thread_stack_size,
+  std::chrono::milliseconds membership_poll_interval,
+  const std::string &topology_cache_file,
+  bool shared_topology,
+  std::chrono::milliseconds max_ttl,
+  unsigned int refresh_jitter,
+  bool order_metadata_servers) :
+  order_metadata_servers_(order_metadata_servers),
+  max_ttl_(max_ttl), refresh_jitter_(refresh_jitter),
+  jitter_rng_(std::random_device()()),
+  membership_poll_interval_(membership_poll_interval),
+  topology_cache_file_(topology_cache_file), refresh_thread_(thread_stack_size) {
+  if (shared_topology && !topology_cache_file_.empty())
+    topology_cache_lock_.reset(new TopologyCacheLock(topology_cache_file_ + ".lock"));
+
   std::string host;
   for (auto s : bootstrap_servers) {
     metadata_cache::ManagedInstance bootstrap_server_instance;
     host = (s.addr == "localhost" ? "127.0.0.1" : s.addr);
     bootstrap_server_instance.host = host;
     bootstrap_server_instance.port = s.port;
+    bootstrap_server_instance.applier_queue_size = 0;
     metadata_servers_.push_back(bootstrap_server_instance);
   }
+  metadata_server_stats_.resize(metadata_servers_.size());
   ttl_ = ttl;
   cluster_name_ = cluster;
+  for (auto name : mysqlrouter::split_string(cluster, ',')) {
+    mysqlrouter::trim(name);
+    cluster_names_.push_back(name);
+  }
+  if (cluster_names_.empty())
+    cluster_names_.push_back(cluster);
   terminate_ = false;
   meta_data_ = cluster_metadata;
   ssl_options_ = ssl_options;
-  refresh();
+  // with a cached topology the routes don't have to wait for the metadata
+  // servers, the refresh thread reconciles it right after start()
+  if (!load_topology_from_cache())
+    refresh();
 }
 
 void* MetadataCache::run_thread(void* context) {
@@ -521,19 +550,75 @@ void MetadataCache::refresh_thread() {
   // this will be only useful if the TTL is set to some value that is more than 1 second
   const std::chrono::milliseconds kTerminateOrForcedRefreshCheckInterval = std::chrono::seconds(1);
 
+  const bool polling = membership_poll_interval_ > std::chrono::milliseconds(0);
+  const auto check_interval = polling ?
+      std::min(membership_poll_interval_, kTerminateOrForcedRefreshCheckInterval) :
+      kTerminateOrForcedRefreshCheckInterval;
+
+  // polls wait for the poll interval across the checks and refreshes
+  std::chrono::milliseconds poll_left = membership_poll_interval_;
+  auto refresh_interval = ttl_;
+  // the constructor just refreshed: with jitter, routers started together
+  // spread their next refresh over the first TTL rather than all refreshing
+  // again right away. A cached topology is reconciled without delay.
+  bool delay_first_refresh = refresh_jitter_ > 0 && !serving_cached_topology_;
   while (!terminate_) {
-    refresh();
+    std::chrono::milliseconds ttl_left;
+    if (delay_first_refresh) {
+      delay_first_refresh = false;
+      ttl_left = std::chrono::milliseconds(
+          std::uniform_int_distribution<std::chrono::milliseconds::rep>(
+              0, ttl_.count())(jitter_rng_));
+    } else {
+      refresh();
 
-    auto ttl_left = ttl_;
+      {
+        std::lock_guard<std::mutex> lock(replicasets_with_unreachable_nodes_mtx_);
+        refresh_interval = next_refresh_interval(refresh_interval,
+            refresh_found_changes_ || !replicasets_with_unreachable_nodes_.empty());
+      }
+      ttl_left = jittered(refresh_interval);
+    }
     // wait for up to TTL until next refresh, unless some replicaset loses an
     // online (primary or secondary) server - in that case, "emergency mode" is
     // enabled and we refresh every 1s until "emergency mode" is called off.
+    // Both waits deviate randomly by up to refresh_jitter_ percent.
+    //
+    // When polling the GR status, the poll notices such changes faster than
+    // the emergency refresh would, so the refresh waits for the TTL.
     while (ttl_left > std::chrono::milliseconds(0)) {
       if (terminate_) return;
 
-      auto sleep_for = std::min(ttl_left, kTerminateOrForcedRefreshCheckInterval);
+      auto sleep_for = std::min(ttl_left, jittered(check_interval));
+      if (polling) sleep_for = std::min(sleep_for, poll_left);
       std::this_thread::sleep_for(sleep_for);
       ttl_left -= sleep_for;
+      poll_left -= sleep_for;
+
+      if (following_shared_topology()) {
+        if (terminate_) return;
+        refresh_from_topology_cache();
+        continue;
+      }
+
+      if (polling) {
+        if (poll_left > std::chrono::milliseconds(0)) continue;
+        poll_left = membership_poll_interval_;
+
+        if (terminate_) return;
+        const PollResult polled = poll_replicasets_status();
+        if (polled == PollResult::kFailed) {
+          // like in "emergency mode", the status is unknown until refreshed
+          refresh_interval = ttl_;
+          break;
+        }
+        if (polled == PollResult::kChanged) {
+          // the topology moves, bring the next refresh forward
+          refresh_interval = ttl_;
+          ttl_left = std::min(ttl_left, ttl_);
+        }
+        continue;
+      }
 
       {
         std::lock_guard<std::mutex> lock(replicasets_with_unreachable_nodes_mtx_);
@@ -553,11 +638,54 @@ void MetadataCache::start() {
   refresh_thread_.run(&run_thread, this);
 }
 
+metadata_cache::RefreshStats MetadataCache::get_refresh_stats() const {
+  metadata_cache::RefreshStats stats;
+  stats.refreshes = refreshes_.load(std::memory_order_relaxed);
+  stats.refresh_failures = refresh_failures_.load(std::memory_order_relaxed);
+  stats.last_refresh_duration = std::chrono::microseconds(
+      last_refresh_duration_us_.load(std::memory_order_relaxed));
+  stats.refresh_duration_sum = std::chrono::microseconds(
+      refresh_duration_sum_us_.load(std::memory_order_relaxed));
+  stats.lock_holds = lock_holds_.load(std::memory_order_relaxed);
+  stats.max_lock_hold = std::chrono::microseconds(
+      max_lock_hold_us_.load(std::memory_order_relaxed));
+  stats.lock_hold_sum = std::chrono::microseconds(
+      lock_hold_sum_us_.load(std::memory_order_relaxed));
+  stats.notifications = notifications_.load(std::memory_order_relaxed);
+  stats.notify_duration_sum = std::chrono::microseconds(
+      notify_duration_sum_us_.load(std::memory_order_relaxed));
+  return stats;
+}
+
+MetadataCache::RefreshLock::RefreshLock(MetadataCache &cache)
+  : cache_(cache), lock_(cache.cache_refreshing_mutex_),
+    locked_(std::chrono::steady_clock::now()) {}
+
+MetadataCache::RefreshLock::~RefreshLock() {
+  const uint64_t held_us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - locked_).count());
+  // only the refresh thread writes them
+  if (held_us > cache_.max_lock_hold_us_.load(std::memory_order_relaxed))
+    cache_.max_lock_hold_us_.store(held_us, std::memory_order_relaxed);
+  cache_.lock_hold_sum_us_.fetch_add(held_us, std::memory_order_relaxed);
+  cache_.lock_holds_.fetch_add(1, std::memory_order_relaxed);
+}
+
 /**
  * Stop the refresh thread.
  */
 void MetadataCache::stop() noexcept {
   terminate_ = true;
+  {
+    // the waiters check terminate_ with the mutex held
+    std::lock_guard<std::mutex> lock(replicasets_with_unreachable_nodes_mtx_);
+  }
+  replicasets_with_unreachable_nodes_cond_.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(topology_version_mtx_);
+  }
+  topology_version_cond_.notify_all();
   refresh_thread_.join();
 }
 
@@ -568,14 +696,69 @@ void MetadataCache::stop() noexcept {
  */
 std::vector<metadata_cache::ManagedInstance> MetadataCache::replicaset_lookup(
   const std::string &replicaset_name) {
-  std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
-  auto replicaset = replicaset_data_.find(replicaset_name);
+  return *replicaset_snapshot(replicaset_name);
+}
 
-  if (replicaset == replicaset_data_.end()) {
+/**
+ * Return the published snapshot of the servers that are part of a replicaset.
+ *
+ * @param replicaset_name The replicaset that is being looked up.
+ */
+metadata_cache::InstancesSnapshot MetadataCache::replicaset_snapshot(
+  const std::string &replicaset_name) {
+  auto snapshots = std::atomic_load(&snapshots_);
+  auto replicaset = snapshots->find(replicaset_name);
+
+  if (replicaset == snapshots->end()) {
     log_warning("Replicaset '%s' not available", replicaset_name.c_str());
-    return {};
+    return std::make_shared<const std::vector<metadata_cache::ManagedInstance>>();
+  }
+  return replicaset->second;
+}
+
+void MetadataCache::publish_snapshots() {
+  auto snapshots = std::make_shared<ReplicasetSnapshots>();
+  size_t bytes = 0;
+  size_t instances = 0;
+  for (const auto &rs : replicaset_data_) {
+    (*snapshots)[rs.first] =
+      std::make_shared<const std::vector<metadata_cache::ManagedInstance>>(rs.second.members);
+    bytes += sizeof(rs) + rs.first.capacity() + rs.second.name.capacity();
+    for (const auto &instance : rs.second.members) {
+      bytes += sizeof(instance) + instance.replicaset_name.capacity() +
+               instance.mysql_server_uuid.capacity() + instance.location.capacity() +
+               instance.host.capacity();
+    }
+    instances += rs.second.members.size();
   }
-  return replicaset_data_[replicaset_name].members;
+
+  // refreshes mostly publish the same members again, that is no new version
+  bool changed;
+  {
+    std::lock_guard<std::mutex> lock(topology_version_mtx_);
+    auto previous = std::atomic_load(&snapshots_);
+    changed = snapshots->size() != previous->size() || !std::equal(
+        snapshots->begin(), snapshots->end(), previous->begin(),
+        [](const ReplicasetSnapshots::value_type &a, const ReplicasetSnapshots::value_type &b) {
+          return a.first == b.first && *a.second == *b.second;
+        });
+    // same members, only the applier queues may differ
+    const bool queues_changed = !changed && !std::equal(
+        snapshots->begin(), snapshots->end(), previous->begin(),
+        [](const ReplicasetSnapshots::value_type &a, const ReplicasetSnapshots::value_type &b) {
+          return std::equal(a.second->begin(), a.second->end(), b.second->begin(),
+              [](const metadata_cache::ManagedInstance &x, const metadata_cache::ManagedInstance &y) {
+                return x.applier_queue_size == y.applier_queue_size;
+              });
+        });
+    std::atomic_store(&snapshots_, std::shared_ptr<const ReplicasetSnapshots>(std::move(snapshots)));
+    if (changed) ++topology_version_;
+    if (changed || queues_changed) ++topology_generation_;
+  }
+  if (changed) topology_version_cond_.notify_all();
+
+  // the snapshot copies the members of replicaset_data_
+  topology_memory_.set(2 * bytes, instances);
 }
 
 bool metadata_cache::ManagedInstance::operator==(const ManagedInstance& other) const {
@@ -591,6 +774,31 @@ bool metadata_cache::ManagedInstance::operator==(const ManagedInstance& other) c
          xport == other.xport;
 }
 
+metadata_cache::InstancesDiff metadata_cache::diff_instances(
+    const std::vector<ManagedInstance> &before,
+    const std::vector<ManagedInstance> &after) {
+  InstancesDiff diff;
+
+  for (const auto &b : before) {
+    auto a = std::find_if(after.begin(), after.end(), [&b](const ManagedInstance &i) {
+      return i.mysql_server_uuid == b.mysql_server_uuid;
+    });
+    if (a == after.end())
+      diff.removed.push_back(b);
+    else if (!(*a == b))
+      diff.changed.emplace_back(b, *a);
+  }
+  for (const auto &a : after) {
+    auto b = std::find_if(before.begin(), before.end(), [&a](const ManagedInstance &i) {
+      return i.mysql_server_uuid == a.mysql_server_uuid;
+    });
+    if (b == before.end())
+      diff.added.push_back(a);
+  }
+
+  return diff;
+}
+
 inline bool compare_instance_lists(const MetaData::ReplicaSetsByName &map_a,
                                    const MetaData::ReplicaSetsByName &map_b) {
   if (map_a.size() != map_b.size())
@@ -610,6 +818,22 @@ inline bool compare_instance_lists(const MetaData::ReplicaSetsByName &map_a,
   return true;
 }
 
+// compares the applier queues of instance lists that compare equal otherwise
+inline bool compare_applier_queues(const MetaData::ReplicaSetsByName &map_a,
+                                   const MetaData::ReplicaSetsByName &map_b) {
+  auto ai = map_a.begin();
+  auto bi = map_b.begin();
+  for (; ai != map_a.end(); ++ai, ++bi) {
+    auto a = ai->second.members.begin();
+    auto b = bi->second.members.begin();
+    for (; a != ai->second.members.end(); ++a, ++b) {
+      if (a->applier_queue_size != b->applier_queue_size)
+        return false;
+    }
+  }
+  return true;
+}
+
 static const char *str_mode(metadata_cache::ServerMode mode) {
   switch (mode) {
     case metadata_cache::ServerMode::ReadWrite: return "RW";
@@ -623,26 +847,64 @@ static const char *str_mode(metadata_cache::ServerMode mode) {
  * Refresh the metadata information in the cache.
  */
 void MetadataCache::refresh() {
+  refresh_found_changes_ = false;
+
+  if (following_shared_topology()) {
+    // another router on this host refreshes the topology, follow its cache
+    refresh_from_topology_cache();
+    return;
+  }
+
+  MYSQL_ROUTER_TRACE0(metadata__refresh__start);
+  const auto started = std::chrono::steady_clock::now();
+  bool refreshed = false;
+  std::shared_ptr<void> exit_guard(nullptr, [&](void*) {
+    const uint64_t duration_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count());
+    MYSQL_ROUTER_TRACE(metadata__refresh__end, duration_us, refreshed ? 0 : 1);
+    last_refresh_duration_us_.store(duration_us, std::memory_order_relaxed);
+    refresh_duration_sum_us_.fetch_add(duration_us, std::memory_order_relaxed);
+    refreshes_.fetch_add(1, std::memory_order_relaxed);
+  });
+
   // fetch metadata
-  for (auto &metadata_server: metadata_servers_) {
+  ++refresh_seq_;
+  for (size_t i : metadata_server_order()) {
+    auto &metadata_server = metadata_servers_[i];
+    const auto server_started = std::chrono::steady_clock::now();
     if (!meta_data_->connect(metadata_server)) {
       log_error("Failed to connect to metadata server %s", metadata_server.mysql_server_uuid.c_str());
+      account_metadata_server(i, false, std::chrono::microseconds(0));
       continue;
      }
-     bool result = fetch_metadata_from_connected_instance();
-     if (result) return; // successfully updated metadata
+     refreshed = fetch_metadata_from_connected_instance();
+     account_metadata_server(i, refreshed,
+         std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - server_started));
+     if (refreshed) return; // successfully updated metadata
   }
 
   // we failed to fetch metadata from any of the metadata servers
   log_error("Failed connecting with any of the metadata servers");
+  refresh_found_changes_ = true;
+  refresh_failures_.fetch_add(1, std::memory_order_relaxed);
+  if (serving_cached_topology_) {
+    // the cached topology is all we have, clearing it wouldn't make the
+    // routing any safer than it was before the restart
+    log_info("... keeping the topology from the cache until a refresh succeeds");
+    return;
+  }
   // clearing metadata
   {
     bool clearing;
     {
-      std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+      RefreshLock lock(*this);
       clearing = !replicaset_data_.empty();
-      if (clearing)
+      if (clearing) {
         replicaset_data_.clear();
+        publish_snapshots();
+      }
     }
     if (clearing) {
       log_info("... cleared current routing table as a precaution");
@@ -655,16 +917,26 @@ bool MetadataCache::fetch_metadata_from_connected_instance() {
   try {
     // Fetch the metadata and store it in a temporary variable.
     std::map<std::string, metadata_cache::ManagedReplicaSet>
-      replicaset_data_temp = meta_data_->fetch_instances(cluster_name_);
+      replicaset_data_temp = meta_data_->fetch_clusters_instances(cluster_names_);
     bool changed = false;
+    if (serving_cached_topology_) {
+      log_info("Metadata servers reachable, replacing the topology from the cache");
+      serving_cached_topology_ = false;
+    }
 
     {
       // Ensure that the refresh does not result in an inconsistency during the
       // lookup.
-      std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+      RefreshLock lock(*this);
       if (!compare_instance_lists(replicaset_data_, replicaset_data_temp)) {
         replicaset_data_ = replicaset_data_temp;
+        publish_snapshots();
         changed = true;
+      } else if (!compare_applier_queues(replicaset_data_, replicaset_data_temp)) {
+        // only the replication lag moved: the routes pick it up with their
+        // next lookup, nothing to notify
+        replicaset_data_ = replicaset_data_temp;
+        publish_snapshots();
       }
     }
 
@@ -673,6 +945,7 @@ bool MetadataCache::fetch_metadata_from_connected_instance() {
     // triggered the refresh so that we werified if this wasn't false alarm
     // and turn it off if it was
     if (changed) {
+      refresh_found_changes_ = true;
       log_info("Potential changes detected in cluster '%s' after metadata refresh",
           cluster_name_.c_str());
       // dump some informational/debugging information about the replicasets
@@ -687,7 +960,7 @@ bool MetadataCache::fetch_metadata_from_connected_instance() {
                     rs.second.single_primary_mode ? "single-master" : "multi-master");
           for (auto &mi : rs.second.members) {
             log_info("    %s:%i / %i - role=%s mode=%s", mi.host.c_str(),
-                mi.port, mi.xport, mi.role.c_str(), str_mode(mi.mode));
+                mi.port, mi.xport, metadata_cache::role_to_string(mi.role), str_mode(mi.mode));
 
             if (mi.mode == metadata_cache::ServerMode::ReadWrite) {
               // If we were running with a primary or secondary node gone
@@ -700,6 +973,7 @@ bool MetadataCache::fetch_metadata_from_connected_instance() {
               if (rs_with_unreachable_node != replicasets_with_unreachable_nodes_.end()) {
                 // disable "emergency mode" for this replicaset
                 replicasets_with_unreachable_nodes_.erase(rs_with_unreachable_node);
+                replicasets_with_unreachable_nodes_cond_.notify_all();
               }
             }
           }
@@ -707,6 +981,7 @@ bool MetadataCache::fetch_metadata_from_connected_instance() {
       }
 
       on_instances_changed(/*md_servers_reachable=*/true);
+      save_topology_to_cache();
     }
 
     /* Not sure about this, the metadata server could be stored elsewhere
@@ -730,15 +1005,251 @@ bool MetadataCache::fetch_metadata_from_connected_instance() {
   return true;
 }
 
+MetadataCache::PollResult MetadataCache::poll_replicasets_status() {
+  // the refresh thread is the only writer, no need to keep the lock while querying
+  std::map<std::string, metadata_cache::ManagedReplicaSet> replicasets;
+  {
+    RefreshLock lock(*this);
+    replicasets = replicaset_data_;
+  }
+
+  bool changed = false;
+  bool failed = false;
+  for (auto &rs : replicasets) {
+    metadata_cache::ManagedReplicaSet replicaset = rs.second;
+    try {
+      if (!meta_data_->fetch_replicaset_status(rs.first, replicaset)) {
+        failed = true; // needs a full refresh
+        break;
+      }
+    } catch (const metadata_cache::metadata_error &exc) {
+      log_warning("Failed polling status of replicaset '%s': %s",
+                  rs.first.c_str(), exc.what());
+      failed = true;
+      continue;
+    }
+
+    if (replicaset.single_primary_mode == rs.second.single_primary_mode &&
+        replicaset.members == rs.second.members)
+      continue;
+
+    log_info("Status of replicaset '%s' changed (%i members, %s)", rs.first.c_str(),
+             (int)replicaset.members.size(),
+             replicaset.single_primary_mode ? "single-master" : "multi-master");
+    for (auto &mi : replicaset.members) {
+      log_info("    %s:%i / %i - role=%s mode=%s", mi.host.c_str(),
+               mi.port, mi.xport, metadata_cache::role_to_string(mi.role), str_mode(mi.mode));
+
+      if (mi.mode == metadata_cache::ServerMode::ReadWrite) {
+        // same as after a refresh: trust the change to fix the unreachable node
+        std::lock_guard<std::mutex> lock(replicasets_with_unreachable_nodes_mtx_);
+        if (replicasets_with_unreachable_nodes_.erase(rs.first) > 0)
+          replicasets_with_unreachable_nodes_cond_.notify_all();
+      }
+    }
+
+    {
+      RefreshLock lock(*this);
+      replicaset_data_[rs.first] = replicaset;
+      publish_snapshots();
+    }
+    changed = true;
+  }
+
+  if (changed) {
+    on_instances_changed(/*md_servers_reachable=*/true);
+    save_topology_to_cache();
+  }
+
+  if (failed) return PollResult::kFailed;
+  return changed ? PollResult::kChanged : PollResult::kUnchanged;
+}
+
+bool MetadataCache::load_topology_from_cache() {
+  if (topology_cache_file_.empty())
+    return false;
+
+  MetaData::ReplicaSetsByName replicasets;
+  try {
+    replicasets = load_topology_cache(topology_cache_file_, cluster_name_, topology_view_id_);
+  } catch (const std::runtime_error &exc) {
+    log_info("Not using the topology cache: %s", exc.what());
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+    replicaset_data_ = replicasets;
+    publish_snapshots();
+  }
+  serving_cached_topology_ = true;
+  log_info("Using the topology of cluster '%s' from the cache '%s' (view %llu, %i replicasets)",
+           cluster_name_.c_str(), topology_cache_file_.c_str(),
+           static_cast<unsigned long long>(topology_view_id_), (int)replicasets.size());
+
+  return true;
+}
+
+void MetadataCache::save_topology_to_cache() {
+  if (topology_cache_file_.empty())
+    return;
+
+  MetaData::ReplicaSetsByName replicasets;
+  {
+    RefreshLock lock(*this);
+    replicasets = replicaset_data_;
+  }
+  try {
+    save_topology_cache(topology_cache_file_, cluster_name_, topology_view_id_ + 1, replicasets);
+    ++topology_view_id_;
+  } catch (const std::runtime_error &exc) {
+    log_warning("Failed updating the topology cache: %s", exc.what());
+  }
+}
+
+std::chrono::milliseconds MetadataCache::next_refresh_interval(
+    std::chrono::milliseconds current, bool unsettled) const {
+  if (max_ttl_ <= ttl_ || unsettled)
+    return ttl_;
+
+  // the topology held still since the last refresh, back off
+  return std::min(std::max(current, std::chrono::milliseconds(1)) * 2, max_ttl_);
+}
+
+std::vector<size_t> MetadataCache::metadata_server_order() const {
+  std::vector<size_t> order(metadata_servers_.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  if (!order_metadata_servers_)
+    return order;
+
+  // servers that failed lately go last, the earliest to be retried first;
+  // servers not tried yet go first, so that their duration gets known
+  auto key = [this](size_t i) {
+    const MetadataServerStats &stats = metadata_server_stats_[i];
+    const bool failed = stats.failures > 0 && refresh_seq_ < stats.retry_at;
+    return std::make_pair(failed, failed ? stats.retry_at
+                                         : static_cast<uint64_t>(stats.duration.count()));
+  };
+  std::stable_sort(order.begin(), order.end(),
+                   [&key](size_t a, size_t b) { return key(a) < key(b); });
+  return order;
+}
+
+void MetadataCache::account_metadata_server(size_t index, bool succeeded,
+                                            std::chrono::microseconds duration) {
+  // how many refreshes at most a failed server is tried last, as 2^n
+  const unsigned int kMaxRetryBackoffShift = 6;
+
+  MetadataServerStats &stats = metadata_server_stats_[index];
+  if (!succeeded) {
+    ++stats.failures;
+    stats.retry_at = refresh_seq_ + (uint64_t{1} << std::min(stats.failures, kMaxRetryBackoffShift));
+    return;
+  }
+
+  stats.failures = 0;
+  // smooth out the outliers, like the refreshes that had to connect first
+  stats.duration = stats.duration.count() == 0 ? duration : (stats.duration * 3 + duration) / 4;
+}
+
+std::chrono::milliseconds MetadataCache::jittered(std::chrono::milliseconds interval) {
+  if (refresh_jitter_ == 0 || interval.count() <= 0)
+    return interval;
+
+  const auto max_deviation = interval.count() * refresh_jitter_ / 100;
+  return interval + std::chrono::milliseconds(
+      std::uniform_int_distribution<std::chrono::milliseconds::rep>(
+          -max_deviation, max_deviation)(jitter_rng_));
+}
+
+bool MetadataCache::following_shared_topology() {
+  if (!topology_cache_lock_ || topology_cache_lock_->is_locked())
+    return false;
+  if (!topology_cache_lock_->try_lock())
+    return true;
+
+  log_info("Refreshing the topology of cluster '%s' for the routers sharing '%s'",
+           cluster_name_.c_str(), topology_cache_file_.c_str());
+  return false;
+}
+
+void MetadataCache::refresh_from_topology_cache() {
+  uint64_t view_id = 0;
+  MetaData::ReplicaSetsByName replicasets;
+  try {
+    replicasets = load_topology_cache(topology_cache_file_, cluster_name_, view_id);
+  } catch (const std::runtime_error &exc) {
+    // checked every second, the refreshing router may not have written it yet
+    log_debug("Shared topology not available: %s", exc.what());
+    return;
+  }
+  if (view_id == topology_view_id_)
+    return; // nothing new
+  topology_view_id_ = view_id;
+  serving_cached_topology_ = true;
+
+  bool changed;
+  {
+    RefreshLock lock(*this);
+    changed = !compare_instance_lists(replicaset_data_, replicasets);
+    if (changed) {
+      replicaset_data_ = replicasets;
+      publish_snapshots();
+    }
+  }
+  if (!changed)
+    return;
+
+  refresh_found_changes_ = true;
+  log_info("Topology of cluster '%s' updated from the shared cache (view %llu, %i replicasets)",
+           cluster_name_.c_str(), static_cast<unsigned long long>(view_id),
+           (int)replicasets.size());
+  for (auto &rs : replicasets) {
+    for (auto &mi : rs.second.members) {
+      if (mi.mode == metadata_cache::ServerMode::ReadWrite) {
+        // same as after a refresh: trust the change to fix the unreachable node
+        std::lock_guard<std::mutex> lock(replicasets_with_unreachable_nodes_mtx_);
+        if (replicasets_with_unreachable_nodes_.erase(rs.first) > 0)
+          replicasets_with_unreachable_nodes_cond_.notify_all();
+      }
+    }
+  }
+
+  on_instances_changed(/*md_servers_reachable=*/true);
+}
+
 void MetadataCache::on_instances_changed(const bool md_servers_reachable) {
+  const auto started = std::chrono::steady_clock::now();
+  std::shared_ptr<void> exit_guard(nullptr, [&](void*) {
+    notify_duration_sum_us_.fetch_add(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count()),
+        std::memory_order_relaxed);
+    notifications_.fetch_add(1, std::memory_order_relaxed);
+  });
+
   std::lock_guard<std::mutex> lock(replicaset_instances_change_callbacks_mtx_);
 
+  static const std::vector<metadata_cache::ManagedInstance> kNoInstances;
+
   for (auto& replicaset_clb: listeners_) {
     const std::string replicaset_name = replicaset_clb.first;
-    auto res = replicaset_lookup(replicaset_name);
+    metadata_cache::LookupResult res(replicaset_snapshot(replicaset_name));
+
+    auto previous = notified_snapshots_.find(replicaset_name);
+    metadata_cache::InstancesDiff diff = metadata_cache::diff_instances(
+        previous != notified_snapshots_.end() ? *previous->second : kNoInstances,
+        res.instance_vector);
 
-    for(auto each : listeners_[replicaset_name]) {
-      each->notify(res, md_servers_reachable);
+    // losing the metadata servers is always worth telling, even if the
+    // members didn't change
+    if (diff.empty() && md_servers_reachable)
+      continue;
+    notified_snapshots_[replicaset_name] = res.snapshot();
+
+    for(auto each : replicaset_clb.second) {
+      each->notify(res, diff, md_servers_reachable);
     }
   }
 }
@@ -793,26 +1304,49 @@ void MetadataCache::mark_instance_reachability(const std::string &instance_id,
   }
 }
 
+metadata_cache::TopologySnapshot MetadataCache::get_topology() {
+  metadata_cache::TopologySnapshot topology;
+  std::lock_guard<std::mutex> lock(topology_version_mtx_);
+  topology.version = topology_version_;
+  topology.replicasets = *std::atomic_load(&snapshots_);
+  return topology;
+}
+
+uint64_t MetadataCache::get_topology_generation() {
+  std::lock_guard<std::mutex> lock(topology_version_mtx_);
+  return topology_generation_;
+}
+
+metadata_cache::TopologySnapshot MetadataCache::wait_topology_change(
+    uint64_t version, std::chrono::milliseconds timeout) {
+  {
+    std::unique_lock<std::mutex> lock(topology_version_mtx_);
+    topology_version_cond_.wait_for(lock, timeout, [&] {
+      return topology_version_ != version || terminate_;
+    });
+  }
+  return get_topology();
+}
+
 bool MetadataCache::wait_primary_failover(const std::string &replicaset_name,
                                           int timeout) {
   log_debug("Waiting for failover to happen in '%s' for %is",
             replicaset_name.c_str(), timeout);
-  time_t stime = std::time(NULL);
-  while (std::time(NULL) - stime <= timeout) {
-    {
-      std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
-      if (replicasets_with_unreachable_nodes_.count(replicaset_name) == 0) {
-        return true;
-      }
-    }
-    std::this_thread::sleep_for(metadata_cache::kDefaultMetadataTTL);
-  }
-  return false;
+  // woken up as soon as a refresh or poll ends the emergency mode of the
+  // replicaset, or the cache is stopped
+  std::unique_lock<std::mutex> lock(replicasets_with_unreachable_nodes_mtx_);
+  replicasets_with_unreachable_nodes_cond_.wait_for(lock, std::chrono::seconds(timeout), [&] {
+    return replicasets_with_unreachable_nodes_.count(replicaset_name) == 0 || terminate_;
+  });
+  return replicasets_with_unreachable_nodes_.count(replicaset_name) == 0;
 }
 
 void MetadataCache::add_listener(const std::string& replicaset_name, metadata_cache::ReplicasetStateListenerInterface* listener) {
   std::lock_guard<std::mutex> lock(replicaset_instances_change_callbacks_mtx_);
   listeners_[replicaset_name].insert(listener);
+  // the new listener hasn't seen the last notified state, next notification
+  // reports the whole replicaset as changed
+  notified_snapshots_.erase(replicaset_name);
 }
 
 void MetadataCache::remove_listener(const std::string& replicaset_name, metadata_cache::ReplicasetStateListenerInterface* listener) {
@@ -28,18 +28,23 @@
 #include "mysqlrouter/metadata_cache.h"
 #include "metadata.h"
 #include "mysql_router_thread.h"
+#include "topology_cache.h"
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <ctime>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <string>
 #include <thread>
 #include <set>
 #include <atomic>
 
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/memory_accounting.h"
 
 class ClusterMetadata;
 
@@ -60,14 +65,42 @@ public:
    * @param cluster_metadata metadata of the cluster
    * @param ttl The TTL of the cached data.
    * @param ssl_options SSL related options for connection
-   * @param cluster_name The name of the desired cluster in the metadata server
+   * @param cluster_name The name of the desired cluster in the metadata server,
+   *        or a comma separated list of clusters of the same metadata, whose
+   *        replicasets are then looked up by
+   *        metadata_cache::qualified_replicaset_name()
    * @param thread_stack_size The maximum memory allocated for thread's stack
+   * @param membership_poll_interval How often the Group Replication status of
+   *        the replicasets is polled between TTL refreshes, 0 disables polling
+   * @param topology_cache_file File the last known topology is kept in and
+   *        initially loaded from, empty disables the topology cache
+   * @param shared_topology If true, only one of the router processes sharing
+   *        the topology_cache_file queries the metadata servers, the others
+   *        follow the topology it writes there
+   * @param max_ttl If greater than ttl, the refresh interval doubles with
+   *        every refresh that finds the topology unchanged, up to max_ttl,
+   *        and drops back to ttl once it changes or the refresh fails
+   * @param refresh_jitter Percentage by which each wait between refreshes,
+   *        including the 1 second waits of the emergency mode, is randomly
+   *        shortened or lengthened. Unless a cached topology is to be
+   *        reconciled, the first refresh of the refresh thread also starts
+   *        at a random point of the first TTL. 0 disables both
+   * @param order_metadata_servers If true, refresh() tries the metadata
+   *        servers by the smoothed duration of their past refreshes, fastest
+   *        first. Servers that failed are tried last, for a number of
+   *        refreshes that doubles with every further failure
    */
   MetadataCache(const std::vector<mysql_harness::TCPAddress> &bootstrap_servers,
                 std::shared_ptr<MetaData> cluster_metadata,
                 std::chrono::milliseconds ttl, const mysqlrouter::SSLOptions &ssl_options,
                 const std::string &cluster_name,
-                size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes);
+                size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes,
+                std::chrono::milliseconds membership_poll_interval = metadata_cache::kDefaultMembershipPollInterval,
+                const std::string &topology_cache_file = "",
+                bool shared_topology = false,
+                std::chrono::milliseconds max_ttl = metadata_cache::kDefaultMetadataMaxTTL,
+                unsigned int refresh_jitter = metadata_cache::kDefaultRefreshJitter,
+                bool order_metadata_servers = false);
 
   /** @brief Starts the Metadata Cache
    *
@@ -91,6 +124,19 @@ public:
   std::vector<metadata_cache::ManagedInstance> replicaset_lookup(
     const std::string &replicaset_name);
 
+  /** @brief Returns the published snapshot of the servers in a replicaset
+   *
+   * Unlike replicaset_lookup() this neither takes the refresh lock nor copies
+   * the servers: the snapshot that was current at the time of the call is
+   * shared with the caller and stays valid after later refreshes.
+   *
+   * @param replicaset_name The ID of the replicaset being looked up
+   * @return snapshot of the replicaset members, empty if the replicaset is
+   *         not known
+   */
+  metadata_cache::InstancesSnapshot replicaset_snapshot(
+    const std::string &replicaset_name);
+
   /** @brief Update the status of the instance
    *
    * Called when an instance from a replicaset cannot be reached for one reason
@@ -116,6 +162,25 @@ public:
    */
   bool wait_primary_failover(const std::string &replicaset_name, int timeout);
 
+  /** @brief Returns counters and timings of the refreshes */
+  metadata_cache::RefreshStats get_refresh_stats() const;
+
+  /** @brief Returns the published snapshots of all replicasets with their version */
+  metadata_cache::TopologySnapshot get_topology();
+
+  /** @brief Returns the count of changes of the published members, applier queues included */
+  uint64_t get_topology_generation();
+
+  /** @brief Waits until a topology of another version than the given one gets published
+   *
+   * @param version version of the topology the caller knows
+   * @param timeout longest time to wait
+   * @return the current topology, of the given version if it didn't change
+   *         before the timeout or the cache got stopped
+   */
+  metadata_cache::TopologySnapshot wait_topology_change(uint64_t version,
+                                                        std::chrono::milliseconds timeout);
+
   /** @brief refresh replicaset information */
   void refresh_thread();
 
@@ -153,24 +218,172 @@ private:
    */
   bool fetch_metadata_from_connected_instance();
 
+  enum class PollResult {
+    kUnchanged,
+    kChanged,
+    /** @brief a full refresh() is needed to know the status */
+    kFailed,
+  };
+
+  /** @brief Polls the Group Replication status of the cached replicasets
+   *
+   * Only the live status of the members is queried, the configured topology
+   * is left to the next refresh(). Replicasets whose status changed are
+   * replaced in the cache and the observers are notified.
+   *
+   * @return kFailed if the status of any replicaset couldn't be polled,
+   *         kChanged if the status of any replicaset changed
+   */
+  PollResult poll_replicasets_status();
+
   // Called each time the metadata has changed and we need to notify
-  // the subscribed observers
+  // the subscribed observers. Observers of replicasets that didn't change
+  // since they were last notified are left alone.
   void on_instances_changed(const bool md_servers_reachable);
 
+  // Loads replicaset_data_ from the topology cache file.
+  // Returns false if there is no usable cache.
+  bool load_topology_from_cache();
+
+  // Writes replicaset_data_ to the topology cache file, if enabled.
+  void save_topology_to_cache();
+
+  // Returns the interval until the refresh after the one that was just made.
+  // unsettled tells if that refresh found changes, failed or left some
+  // replicaset in emergency mode.
+  std::chrono::milliseconds next_refresh_interval(std::chrono::milliseconds current,
+                                                  bool unsettled) const;
+
+  // Returns interval randomly shortened or lengthened by up to
+  // refresh_jitter_ percent. Only called by the refresh thread.
+  std::chrono::milliseconds jittered(std::chrono::milliseconds interval);
+
+  // Returns the indexes of metadata_servers_ in the order refresh() tries
+  // them.
+  std::vector<size_t> metadata_server_order() const;
+
+  // Accounts a refresh from metadata_servers_[index] that took duration.
+  void account_metadata_server(size_t index, bool succeeded,
+                               std::chrono::microseconds duration);
+
+  // Returns true if the topology is shared with other router processes and
+  // one of them refreshes it. Takes over refreshing it if none does.
+  bool following_shared_topology();
+
+  // Replaces replicaset_data_ with the topology the refreshing router
+  // process wrote to the topology cache file, if it changed.
+  void refresh_from_topology_cache();
+
+  // Publishes a new set of snapshots built from replicaset_data_.
+  // Needs to be called with cache_refreshing_mutex_ locked.
+  void publish_snapshots();
+
+  // Locks cache_refreshing_mutex_ for the refresh thread, accounting the time
+  // it is held in the refresh stats.
+  class RefreshLock {
+   public:
+    explicit RefreshLock(MetadataCache &cache);
+    ~RefreshLock();
+
+    RefreshLock(const RefreshLock&) = delete;
+    RefreshLock& operator=(const RefreshLock&) = delete;
+
+   private:
+    MetadataCache &cache_;
+    std::lock_guard<std::mutex> lock_;
+    std::chrono::steady_clock::time_point locked_;
+  };
+
   // Stores the list replicasets and their server instances.
   // Keyed by replicaset name
   std::map<std::string, metadata_cache::ManagedReplicaSet> replicaset_data_;
 
-  // The name of the cluster in the topology.
+  // Immutable copy of the members of each replicaset in replicaset_data_,
+  // replaced as a whole (std::atomic_store) every time replicaset_data_
+  // changes so that lookups can read it (std::atomic_load) without locking.
+  using ReplicasetSnapshots = std::map<std::string, metadata_cache::InstancesSnapshot>;
+  std::shared_ptr<const ReplicasetSnapshots> snapshots_{std::make_shared<const ReplicasetSnapshots>()};
+
+  // Counts the publish_snapshots() that changed the members of any
+  // replicaset. Replaced together with snapshots_ under topology_version_mtx_,
+  // waiters on topology_version_cond_ are woken up by each change.
+  uint64_t topology_version_{0};
+  // Like topology_version_, but also counts the changes of applier queues only
+  uint64_t topology_generation_{0};
+  std::mutex topology_version_mtx_;
+  std::condition_variable topology_version_cond_;
+
+  // Accounts replicaset_data_ and snapshots_, set by publish_snapshots().
+  // Older snapshots still held by lookups are not accounted.
+  mysql_harness::AccountedMemory topology_memory_{mysql_harness::MemoryTag::kMetadataCache};
+
+  // The name of the cluster in the topology, as configured: a comma
+  // separated list if the cache serves several clusters.
   std::string cluster_name_;
 
+  // The clusters cluster_name_ lists, all refreshed together over the same
+  // metadata server connection.
+  std::vector<std::string> cluster_names_;
+
   // The list of servers that contain the metadata about the managed
   // topology.
   std::vector<metadata_cache::ManagedInstance> metadata_servers_;
 
+  // What the refreshes from one of metadata_servers_ showed so far.
+  struct MetadataServerStats {
+    // smoothed duration of the successful refreshes, 0 until one succeeded
+    std::chrono::microseconds duration{0};
+    // failed refreshes since the last successful one
+    unsigned int failures{0};
+    // refresh_seq_ from which a failed server is tried in order again
+    uint64_t retry_at{0};
+  };
+
+  // Whether refresh() orders metadata_servers_ by metadata_server_stats_.
+  bool order_metadata_servers_;
+
+  // Same index as metadata_servers_. Only accessed by the refresh thread (and
+  // the constructor).
+  std::vector<MetadataServerStats> metadata_server_stats_;
+
+  // Number of refreshes from the metadata servers made so far. Only accessed
+  // by the refresh thread (and the constructor).
+  uint64_t refresh_seq_{0};
+
   // The time to live of the metadata cache.
   std::chrono::milliseconds ttl_;
 
+  // Upper bound of the adaptive refresh interval (<= ttl_ = not adaptive).
+  std::chrono::milliseconds max_ttl_;
+
+  // Percentage the waits between refreshes randomly deviate by (0 = none).
+  unsigned int refresh_jitter_;
+
+  // Drives the jitter. Only accessed by the refresh thread (and the
+  // constructor, which seeds it).
+  std::minstd_rand jitter_rng_;
+
+  // Whether the last refresh() changed the topology or failed. Only accessed
+  // by the refresh thread (and the constructor).
+  bool refresh_found_changes_{false};
+
+  // How often the Group Replication status is polled between refreshes (0 = never).
+  std::chrono::milliseconds membership_poll_interval_;
+
+  // File the last known topology is persisted to (empty = disabled).
+  std::string topology_cache_file_;
+
+  // View id of the topology last written to (or read from) the cache file.
+  uint64_t topology_view_id_{0};
+
+  // Whether replicaset_data_ still comes from the cache file as no refresh
+  // succeeded yet. Only accessed by the refresh thread (and the constructor).
+  bool serving_cached_topology_{false};
+
+  // Held while this process refreshes the topology shared with other router
+  // processes, nullptr if the topology isn't shared.
+  std::unique_ptr<TopologyCacheLock> topology_cache_lock_;
+
   // SSL options for MySQL connections
   mysqlrouter::SSLOptions ssl_options_;
 
@@ -198,20 +411,46 @@ private:
 
   std::mutex replicasets_with_unreachable_nodes_mtx_;
 
+  // notified when a replicaset leaves the emergency mode, see
+  // wait_primary_failover()
+  std::condition_variable replicasets_with_unreachable_nodes_cond_;
+
   // Flag used to terminate the refresh thread.
   std::atomic_bool terminate_;
 
+  // Counters of refresh(), written by the refresh thread, read by
+  // get_refresh_stats().
+  std::atomic<uint64_t> refreshes_{0};
+  std::atomic<uint64_t> refresh_failures_{0};
+  std::atomic<uint64_t> last_refresh_duration_us_{0};
+  std::atomic<uint64_t> refresh_duration_sum_us_{0};
+  std::atomic<uint64_t> lock_holds_{0};
+  std::atomic<uint64_t> max_lock_hold_us_{0};
+  std::atomic<uint64_t> lock_hold_sum_us_{0};
+  std::atomic<uint64_t> notifications_{0};
+  std::atomic<uint64_t> notify_duration_sum_us_{0};
+
   // map of lists (per each replicaset name) of registered callbacks to be called
   // on selected replicaset instances change event
   std::mutex replicaset_instances_change_callbacks_mtx_;
 
   std::map<std::string, std::set<metadata_cache::ReplicasetStateListenerInterface*>> listeners_;
 
+  // per replicaset, the members the listeners were last notified about
+  std::map<std::string, metadata_cache::InstancesSnapshot> notified_snapshots_;
+
 #ifdef FRIEND_TEST
   FRIEND_TEST(FailoverTest, basics);
   FRIEND_TEST(FailoverTest, primary_failover);
   FRIEND_TEST(MetadataCacheTest2, basic_test);
   FRIEND_TEST(MetadataCacheTest2, metadata_server_connection_failures);
+  FRIEND_TEST(MetadataCacheTest, TopologyCacheUsedOnRestart);
+  FRIEND_TEST(MetadataCacheTest, SharedTopology);
+  FRIEND_TEST(MetadataCacheTest, AdaptiveTTL);
+  FRIEND_TEST(MetadataCacheTest, RefreshJitter);
+  FRIEND_TEST(MetadataCacheTest, MetadataServerOrder);
+  FRIEND_TEST(MetadataCacheTest, WaitPrimaryFailoverWakesUp);
+  FRIEND_TEST(MetadataCacheTest, TopologyVersion);
 #endif
 };
 
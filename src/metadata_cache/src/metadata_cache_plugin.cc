@@ -125,7 +125,13 @@ static void start(mysql_harness::PluginFuncEnv* env) {
                                metadata_cluster,
                                config.connect_timeout,
                                config.read_timeout,
-                               config.thread_stack_size);
+                               config.thread_stack_size,
+                               config.membership_poll_interval,
+                               config.topology_cache_file,
+                               config.shared_topology,
+                               config.max_ttl,
+                               config.refresh_jitter,
+                               config.order_metadata_servers);
   } catch (const std::runtime_error &exc) { // metadata_cache::metadata_error inherits from runtime_error
     log_error("%s", exc.what());  // TODO remove after Loader starts logging
     set_error(env, mysql_harness::kRuntimeError, "%s", exc.what());
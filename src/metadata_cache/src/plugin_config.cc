@@ -48,7 +48,12 @@ std::string MetadataCachePluginConfig::get_default(const std::string &option) co
       {"ttl", ms_to_seconds_string(metadata_cache::kDefaultMetadataTTL)},
       {"connect_timeout", to_string(metadata_cache::kDefaultConnectTimeout)},
       {"read_timeout", to_string(metadata_cache::kDefaultReadTimeout)},
-      {"thread_stack_size", to_string(mysql_harness::kDefaultStackSizeInKiloBytes)}
+      {"thread_stack_size", to_string(mysql_harness::kDefaultStackSizeInKiloBytes)},
+      {"membership_poll_interval", ms_to_seconds_string(metadata_cache::kDefaultMembershipPollInterval)},
+      {"shared_topology", "0"},
+      {"max_ttl", ms_to_seconds_string(metadata_cache::kDefaultMetadataMaxTTL)},
+      {"refresh_jitter", to_string(metadata_cache::kDefaultRefreshJitter)},
+      {"order_metadata_servers", "0"}
   };
   auto it = defaults.find(option);
   if (it == defaults.end()) {
@@ -28,6 +28,7 @@
 #include "mysqlrouter/metadata_cache.h"
 
 #include <chrono>
+#include <stdexcept>
 #include <map>
 #include <string>
 #include <vector>
@@ -35,6 +36,7 @@
 #include "mysql/harness/config_parser.h"
 #include "mysql/harness/plugin.h"
 #include <mysqlrouter/plugin_config.h>
+#include "mysqlrouter/utils.h"
 #include "tcp_address.h"
 
 
@@ -59,8 +61,31 @@ public:
         metadata_cluster(get_option_string(section, "metadata_cluster")),
         connect_timeout(get_uint_option<uint16_t>(section, "connect_timeout", 1)),
         read_timeout(get_uint_option<uint16_t>(section, "read_timeout", 1)),
-        thread_stack_size(get_uint_option<uint32_t>(section, "thread_stack_size", 1, 65535))
-  { }
+        thread_stack_size(get_uint_option<uint32_t>(section, "thread_stack_size", 1, 65535)),
+        membership_poll_interval(get_option_milliseconds(section, "membership_poll_interval", 0.0, 60.0)),
+        topology_cache_file(get_option_string(section, "topology_cache_file")),
+        shared_topology(get_uint_option<uint16_t>(section, "shared_topology", 0, 1) == 1),
+        max_ttl(get_option_milliseconds(section, "max_ttl", 0.0, 3600.0)),
+        refresh_jitter(get_uint_option<uint16_t>(section, "refresh_jitter", 0, 50)),
+        order_metadata_servers(get_uint_option<uint16_t>(section, "order_metadata_servers", 0, 1) == 1) {
+    if (shared_topology && topology_cache_file.empty()) {
+      throw std::invalid_argument(get_log_prefix("shared_topology") +
+                                  " requires topology_cache_file to be set");
+    }
+    if (metadata_cluster.find(',') != std::string::npos) {
+      for (auto name : mysqlrouter::split_string(metadata_cluster, ',')) {
+        mysqlrouter::trim(name);
+        if (name.empty()) {
+          throw std::invalid_argument(get_log_prefix("metadata_cluster") +
+                                      " needs to be a comma separated list of cluster names");
+        }
+      }
+    }
+    if (max_ttl.count() > 0 && max_ttl < ttl) {
+      throw std::invalid_argument(get_log_prefix("max_ttl") +
+                                  " needs to be 0 or not smaller than ttl");
+    }
+  }
 
   /**
    * @param option name of the option
@@ -74,7 +99,8 @@ public:
   const std::string user;
   /** @brief TTL used for storing data in the cache */
   const std::chrono::milliseconds ttl;
-  /** @brief Cluster in the metadata */
+  /** @brief Cluster in the metadata, or a comma separated list of clusters
+   * of the same metadata that share the refreshes */
   const std::string metadata_cluster;
   /** @brief connect_timeout The time in seconds after which trying to connect
    * to metadata server timeouts */
@@ -84,6 +110,24 @@ public:
   const unsigned int read_timeout;
   /** @brief memory in kilobytes allocated for thread's stack */
   const unsigned int thread_stack_size;
+  /** @brief How often the Group Replication status is polled between TTL
+   * refreshes, 0 disables polling */
+  const std::chrono::milliseconds membership_poll_interval;
+  /** @brief File the last known topology is persisted to, so that routing
+   * can start before the metadata servers are reachable. Empty disables it */
+  const std::string topology_cache_file;
+  /** @brief Whether only one of the routers sharing topology_cache_file on
+   * this host refreshes the topology while the others follow that file */
+  const bool shared_topology;
+  /** @brief Upper bound the refresh interval backs off to while the topology
+   * stays unchanged, 0 keeps refreshing every ttl */
+  const std::chrono::milliseconds max_ttl;
+  /** @brief Percentage by which each wait between refreshes randomly deviates,
+   * so that routers started together don't refresh in step. 0 disables it */
+  const unsigned int refresh_jitter;
+  /** @brief Whether the metadata servers are tried fastest first, by the
+   * duration of the past refreshes, rather than in the configured order */
+  const bool order_metadata_servers;
 
 private:
   /** @brief Gets a list of metadata servers.
@@ -0,0 +1,276 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "topology_cache.h"
+
+#ifdef RAPIDJSON_NO_SIZETYPEDEFINE
+// if we build within the server, it will set RAPIDJSON_NO_SIZETYPEDEFINE globally
+// and require to include my_rapidjson_size_t.h
+#include "my_rapidjson_size_t.h"
+#endif
+
+#include "rapidjson/document.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/file.h>
+#  include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// default allocator for rapidJson (MemoryPoolAllocator) is broken for SparcSolaris
+using JsonDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
+using JsonValue = rapidjson::GenericValue<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
+
+const char *mode_to_string(metadata_cache::ServerMode mode) {
+  switch (mode) {
+    case metadata_cache::ServerMode::ReadWrite: return "RW";
+    case metadata_cache::ServerMode::ReadOnly: return "RO";
+    case metadata_cache::ServerMode::Unavailable: break;
+  }
+  return "n/a";
+}
+
+metadata_cache::ServerMode mode_from_string(const std::string &mode) {
+  if (mode == "RW") return metadata_cache::ServerMode::ReadWrite;
+  if (mode == "RO") return metadata_cache::ServerMode::ReadOnly;
+  return metadata_cache::ServerMode::Unavailable;
+}
+
+const JsonValue &get_member(const JsonValue &object, const char *name) {
+  if (!object.IsObject())
+    throw std::runtime_error("expected an object");
+  auto it = object.FindMember(name);
+  if (it == object.MemberEnd())
+    throw std::runtime_error(std::string("missing '") + name + "'");
+  return it->value;
+}
+
+std::string get_string(const JsonValue &object, const char *name) {
+  const JsonValue &value = get_member(object, name);
+  if (!value.IsString())
+    throw std::runtime_error(std::string("'") + name + "' is not a string");
+  return std::string(value.GetString(), value.GetStringLength());
+}
+
+uint64_t get_uint(const JsonValue &object, const char *name) {
+  const JsonValue &value = get_member(object, name);
+  if (!value.IsUint64())
+    throw std::runtime_error(std::string("'") + name + "' is not an unsigned number");
+  return value.GetUint64();
+}
+
+} // namespace
+
+void save_topology_cache(const std::string &path, const std::string &cluster_name,
+                         uint64_t view_id, const MetaData::ReplicaSetsByName &replicasets) {
+  rapidjson::StringBuffer buff;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buff);
+
+  writer.StartObject();
+  writer.Key("format_version");
+  writer.Uint(kTopologyCacheFormatVersion);
+  writer.Key("cluster_name");
+  writer.String(cluster_name.c_str());
+  writer.Key("view_id");
+  writer.Uint64(view_id);
+  writer.Key("replicasets");
+  writer.StartArray();
+  for (const auto &rs : replicasets) {
+    writer.StartObject();
+    writer.Key("name");
+    writer.String(rs.second.name.c_str());
+    writer.Key("single_primary_mode");
+    writer.Bool(rs.second.single_primary_mode);
+    writer.Key("members");
+    writer.StartArray();
+    for (const auto &member : rs.second.members) {
+      writer.StartObject();
+      writer.Key("uuid");
+      writer.String(member.mysql_server_uuid.c_str());
+      writer.Key("role");
+      writer.String(metadata_cache::role_to_string(member.role));
+      writer.Key("mode");
+      writer.String(mode_to_string(member.mode));
+      writer.Key("weight");
+      writer.Double(member.weight);
+      writer.Key("version_token");
+      writer.Uint(member.version_token);
+      writer.Key("location");
+      writer.String(member.location.c_str());
+      writer.Key("host");
+      writer.String(member.host.c_str());
+      writer.Key("port");
+      writer.Uint(member.port);
+      writer.Key("xport");
+      writer.Uint(member.xport);
+      writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+      throw std::runtime_error("Could not open '" + tmp_path + "' for writing: " + std::strerror(errno));
+    out.write(buff.GetString(), static_cast<std::streamsize>(buff.GetSize()));
+    out.close();
+    if (!out) {
+      std::remove(tmp_path.c_str());
+      throw std::runtime_error("Could not write '" + tmp_path + "'");
+    }
+  }
+#ifdef _WIN32
+  // rename() doesn't replace existing files on Windows
+  std::remove(path.c_str());
+#endif
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    const int err = errno;
+    std::remove(tmp_path.c_str());
+    throw std::runtime_error("Could not rename '" + tmp_path + "' to '" + path + "': " + std::strerror(err));
+  }
+}
+
+MetaData::ReplicaSetsByName load_topology_cache(const std::string &path,
+                                                const std::string &cluster_name,
+                                                uint64_t &view_id) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Could not open '" + path + "': " + std::strerror(errno));
+  std::stringstream content;
+  content << in.rdbuf();
+
+  JsonDocument doc;
+  if (doc.Parse(content.str().c_str()).HasParseError())
+    throw std::runtime_error("Parsing '" + path + "' failed at offset "
+                             + std::to_string(doc.GetErrorOffset()) + ": "
+                             + rapidjson::GetParseError_En(doc.GetParseError()));
+
+  MetaData::ReplicaSetsByName replicasets;
+  try {
+    if (get_uint(doc, "format_version") != kTopologyCacheFormatVersion)
+      throw std::runtime_error("unsupported format version");
+    if (get_string(doc, "cluster_name") != cluster_name)
+      throw std::runtime_error("written for another cluster");
+    const uint64_t stored_view_id = get_uint(doc, "view_id");
+
+    const JsonValue &rs_array = get_member(doc, "replicasets");
+    if (!rs_array.IsArray())
+      throw std::runtime_error("'replicasets' is not an array");
+    for (const auto &rs_value : rs_array.GetArray()) {
+      metadata_cache::ManagedReplicaSet rs;
+      rs.name = get_string(rs_value, "name");
+      const JsonValue &single_primary_mode = get_member(rs_value, "single_primary_mode");
+      if (!single_primary_mode.IsBool())
+        throw std::runtime_error("'single_primary_mode' is not a boolean");
+      rs.single_primary_mode = single_primary_mode.GetBool();
+
+      const JsonValue &members = get_member(rs_value, "members");
+      if (!members.IsArray())
+        throw std::runtime_error("'members' is not an array");
+      for (const auto &member_value : members.GetArray()) {
+        metadata_cache::ManagedInstance member;
+        member.replicaset_name = rs.name;
+        member.mysql_server_uuid = get_string(member_value, "uuid");
+        member.role = metadata_cache::role_from_string(get_string(member_value, "role"));
+        member.mode = mode_from_string(get_string(member_value, "mode"));
+        const JsonValue &weight = get_member(member_value, "weight");
+        if (!weight.IsNumber())
+          throw std::runtime_error("'weight' is not a number");
+        member.weight = static_cast<float>(weight.GetDouble());
+        member.version_token = static_cast<unsigned int>(get_uint(member_value, "version_token"));
+        member.location = get_string(member_value, "location");
+        member.host = get_string(member_value, "host");
+        member.port = static_cast<unsigned int>(get_uint(member_value, "port"));
+        member.xport = static_cast<unsigned int>(get_uint(member_value, "xport"));
+        member.applier_queue_size = 0;
+        rs.members.push_back(member);
+      }
+      replicasets[rs.name] = rs;
+    }
+    view_id = stored_view_id;
+  } catch (const std::runtime_error &exc) {
+    throw std::runtime_error("Invalid topology cache '" + path + "': " + exc.what());
+  }
+
+  return replicasets;
+}
+
+TopologyCacheLock::TopologyCacheLock(const std::string &path) : path_(path) {}
+
+TopologyCacheLock::~TopologyCacheLock() {
+#ifdef _WIN32
+  if (handle_ != nullptr)
+    CloseHandle(handle_);
+#else
+  if (fd_ >= 0)
+    close(fd_);  // releases the lock too
+#endif
+}
+
+bool TopologyCacheLock::try_lock() noexcept {
+  if (locked_)
+    return true;
+
+#ifdef _WIN32
+  if (handle_ == nullptr) {
+    HANDLE h = CreateFileA(path_.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+      return false;
+    handle_ = h;
+  }
+  OVERLAPPED overlapped{};
+  locked_ = LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                       0, 1, 0, &overlapped) != 0;
+#else
+  if (fd_ < 0) {
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0)
+      return false;
+  }
+  locked_ = flock(fd_, LOCK_EX | LOCK_NB) == 0;
+#endif
+
+  return locked_;
+}
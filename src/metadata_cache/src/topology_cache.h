@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef METADATA_CACHE_TOPOLOGY_CACHE_INCLUDED
+#define METADATA_CACHE_TOPOLOGY_CACHE_INCLUDED
+
+#include "metadata.h"
+
+#include <cstdint>
+#include <string>
+
+/** Version of the format of the topology cache file, bumped on incompatible
+ * changes. Files of other versions are ignored. */
+constexpr unsigned kTopologyCacheFormatVersion = 1;
+
+/** Writes the replicasets of the cluster to the topology cache file.
+ *
+ * The file is written next to the given path first and then renamed over it,
+ * so that readers never see a partially written file.
+ *
+ * throws std::runtime_error
+ *
+ * @param path path of the topology cache file
+ * @param cluster_name name of the cluster the replicasets belong to
+ * @param view_id number identifying this version of the topology, expected
+ *                to grow with every write
+ * @param replicasets replicasets to store
+ */
+void save_topology_cache(const std::string &path, const std::string &cluster_name,
+                         uint64_t view_id, const MetaData::ReplicaSetsByName &replicasets);
+
+/** Reads the replicasets stored by save_topology_cache().
+ *
+ * throws std::runtime_error if the file can't be read, isn't valid, is of
+ * another format version or belongs to another cluster
+ *
+ * @param path path of the topology cache file
+ * @param cluster_name name of the cluster the replicasets should belong to
+ * @param[out] view_id the view id the file was written with
+ * @return the stored replicasets
+ */
+MetaData::ReplicaSetsByName load_topology_cache(const std::string &path,
+                                                const std::string &cluster_name,
+                                                uint64_t &view_id);
+
+/** @class TopologyCacheLock
+ *
+ * Exclusive, non-blocking lock on a file that the router processes sharing
+ * a topology cache file use to agree on which one of them refreshes it from
+ * the metadata servers. The lock is released when the object is destroyed or
+ * the process holding it exits, letting another process take over.
+ */
+class TopologyCacheLock {
+ public:
+  /** @param path path of the lock file, created if it doesn't exist */
+  explicit TopologyCacheLock(const std::string &path);
+  ~TopologyCacheLock();
+
+  TopologyCacheLock(const TopologyCacheLock &) = delete;
+  TopologyCacheLock &operator=(const TopologyCacheLock &) = delete;
+
+  /** Takes the lock unless another process holds it, without waiting.
+   *
+   * @return true if the lock is held by this object
+   */
+  bool try_lock() noexcept;
+
+  /** @return true if the lock is held by this object */
+  bool is_locked() const noexcept { return locked_; }
+
+ private:
+  std::string path_;
+#ifdef _WIN32
+  void *handle_{nullptr};
+#else
+  int fd_{-1};
+#endif
+  bool locked_{false};
+};
+
+#endif // METADATA_CACHE_TOPOLOGY_CACHE_INCLUDED
@@ -58,7 +58,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms1.port = 3306;
   ms1.xport = 33060;
   ms1.mode = metadata_cache::ServerMode::ReadWrite;
-  ms1.role = "master";
+  ms1.role = metadata_cache::InstanceRole::HA;
   ms1.weight = 1;
   ms1.version_token = 0;
 
@@ -69,7 +69,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms2.port = 3306;
   ms2.xport = 33060;
   ms2.mode = metadata_cache::ServerMode::ReadOnly;
-  ms2.role = "master";
+  ms2.role = metadata_cache::InstanceRole::HA;
   ms2.weight = 1;
   ms2.version_token = 0;
 
@@ -80,7 +80,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms3.port = 3306;
   ms3.xport = 33060;
   ms3.mode = metadata_cache::ServerMode::ReadOnly;
-  ms3.role = "scale-out";
+  ms3.role = metadata_cache::InstanceRole::ReadScaleOut;
   ms3.weight = 1;
   ms3.version_token = 0;
 
@@ -91,7 +91,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms4.port = 3306;
   ms4.xport = 33060;
   ms4.mode = metadata_cache::ServerMode::ReadWrite;
-  ms4.role = "master";
+  ms4.role = metadata_cache::InstanceRole::HA;
   ms4.weight = 1;
   ms4.version_token = 0;
 
@@ -102,7 +102,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms5.port = 3306;
   ms5.xport = 33060;
   ms5.mode = metadata_cache::ServerMode::ReadOnly;
-  ms5.role = "master";
+  ms5.role = metadata_cache::InstanceRole::HA;
   ms5.weight = 1;
   ms5.version_token = 0;
 
@@ -113,7 +113,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms6.port = 3306;
   ms6.xport = 33060;
   ms6.mode = metadata_cache::ServerMode::ReadOnly;
-  ms6.role = "scale-out";
+  ms6.role = metadata_cache::InstanceRole::ReadScaleOut;
   ms6.weight = 1;
   ms6.version_token = 0;
 
@@ -124,7 +124,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms7.port = 3306;
   ms7.xport = 33060;
   ms7.mode = metadata_cache::ServerMode::ReadWrite;
-  ms7.role = "master";
+  ms7.role = metadata_cache::InstanceRole::HA;
   ms7.weight = 1;
   ms7.version_token = 0;
 
@@ -135,7 +135,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms8.port = 3306;
   ms8.xport = 33060;
   ms8.mode = metadata_cache::ServerMode::ReadWrite;
-  ms8.role = "master";
+  ms8.role = metadata_cache::InstanceRole::HA;
   ms8.weight = 1;
   ms8.version_token = 0;
 
@@ -146,7 +146,7 @@ MockNG::MockNG(const std::string &user, const std::string &password,
   ms9.port = 3306;
   ms9.xport = 33060;
   ms9.mode = metadata_cache::ServerMode::ReadWrite;
-  ms9.role = "scale-out";
+  ms9.role = metadata_cache::InstanceRole::ReadScaleOut;
   ms9.weight = 1;
   ms9.version_token = 0;
 
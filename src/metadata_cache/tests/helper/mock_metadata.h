@@ -126,6 +126,14 @@ public:
    */
   ReplicaSetsByName fetch_instances(const std::string &farm_name) override;
 
+  /**
+   * Fetches each cluster with the mocked fetch_instances(), rather than
+   * querying the metadata like ClusterMetadata does.
+   */
+  ReplicaSetsByName fetch_clusters_instances(const std::vector<std::string> &cluster_names) override {
+    return MetaData::fetch_clusters_instances(cluster_names);
+  }
+
 
 
 #if 0 // not used so far
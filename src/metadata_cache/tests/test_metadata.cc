@@ -69,6 +69,7 @@ using mysqlrouter::MySQLSession;
 using metadata_cache::ManagedInstance;
 using metadata_cache::ManagedReplicaSet;
 using metadata_cache::ServerMode;
+using metadata_cache::InstanceRole;
 
 using State = GroupReplicationMember::State;
 using Role  = GroupReplicationMember::Role;
@@ -121,6 +122,14 @@ std::string query_status = "SELECT "
     "FROM performance_schema.replication_group_members "
     "WHERE channel_name = 'group_replication_applier'";
 
+// query #2 and #3 combined - used instead of them by servers that support it
+std::string query_status_with_primary_member = "SELECT "
+    "member_id, member_host, member_port, member_state, @@group_replication_single_primary_mode, "
+    "(SELECT variable_value FROM performance_schema.global_status "
+    "WHERE variable_name = 'group_replication_primary_member') "
+    "FROM performance_schema.replication_group_members "
+    "WHERE channel_name = 'group_replication_applier'";
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -156,6 +165,14 @@ class MockMySQLSession: public MySQLSession {
     good_conns_ = std::move(conns);
   }
 
+  unsigned long server_version() noexcept override {
+    return server_version_;
+  }
+
+  void set_server_version(unsigned long version) {
+    server_version_ = version;
+  }
+
   void query_impl(const RowProcessor &processor,
                   const std::vector<Row>& resultset,
                   bool should_succeed = true) const {
@@ -194,6 +211,7 @@ class MockMySQLSession: public MySQLSession {
 
   int connect_cnt_ = 0;
   std::set<std::string> good_conns_;
+  unsigned long server_version_ = 0;  // not known, like before connecting
 };
 
 class MockMySQLSessionFactory {
@@ -251,7 +269,7 @@ static bool cmp_mi_FI(const ManagedInstance& lhs, const ManagedInstance& rhs) {
 
   // This function compares fields set by Metadata::fetch_instances().
   // Ignored fields (they're not being set at the time of writing):
-  //   std::string role;
+  //   InstanceRole role;
   //   float weight;
   //   unsigned int version_token;
   //   std::string location;
@@ -300,7 +318,7 @@ class MetadataTest : public ::testing::Test {
   void connect_to_first_metadata_server() {
 
     std::vector<ManagedInstance> metadata_servers {
-      {"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100},
+      {"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0},
     };
     session_factory.get(0).set_good_conns({"127.0.0.1:3310", "127.0.0.1:3320", "127.0.0.1:3330"});
 
@@ -363,9 +381,9 @@ class MetadataTest : public ::testing::Test {
   const ManagedReplicaSet typical_replicaset {
     "replicaset-1", {
       // will be set ----------------------vvvvvvvvvvvvvvvvvvvvvvv  v--v--vv--- ignored at the time of writing
-      {"replicaset-1", "instance-1", "HA", ServerMode::Unavailable, 0, 0, "", "localhost", 3310, 33100},
-      {"replicaset-1", "instance-2", "HA", ServerMode::Unavailable, 0, 0, "", "localhost", 3320, 33200},
-      {"replicaset-1", "instance-3", "HA", ServerMode::Unavailable, 0, 0, "", "localhost", 3330, 33300},
+      {"replicaset-1", "instance-1", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost", 3310, 33100, 0},
+      {"replicaset-1", "instance-2", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost", 3320, 33200, 0},
+      {"replicaset-1", "instance-3", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost", 3330, 33300, 0},
       // ignored at time of writing -^^^^--------------------------------------------------------^^^^^
       // TODO: ok to ignore xport?
     },
@@ -383,7 +401,7 @@ class MetadataTest : public ::testing::Test {
 
 TEST_F(MetadataTest, ConnectToMetadataServer_Succeed) {
 
-  ManagedInstance metadata_server{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100};
+  ManagedInstance metadata_server{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0};
   session_factory.get(0).set_good_conns({"127.0.0.1:3310"});
 
   // should connect successfully
@@ -393,7 +411,7 @@ TEST_F(MetadataTest, ConnectToMetadataServer_Succeed) {
 
 TEST_F(MetadataTest, ConnectToMetadataServer_Failed) {
 
-  ManagedInstance metadata_server{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100};
+  ManagedInstance metadata_server{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0};
 
   // connetion attempt should fail
   EXPECT_CALL(session_factory.get(0), flag_fail(_, 3310)).Times(1);
@@ -439,10 +457,10 @@ TEST_F(MetadataTest, FetchInstancesFromMetadataServer) {
 
     EXPECT_EQ(1u, rs.size());
     EXPECT_EQ(4u, rs.at("replicaset-1").members.size()); // not set/checked -------------------vvvvvvvvvvvvvvvvvvvvvvv
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-1", "HA",               ServerMode::Unavailable, 0.2f, 0, "location1", "localhost", 3310, 33100}, rs.at("replicaset-1").members.at(0)));
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-2", "arbitrary_string", ServerMode::Unavailable, 1.5f, 1, "s.o_loc",   "localhost", 3320, 33200}, rs.at("replicaset-1").members.at(1)));
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-3", "",                 ServerMode::Unavailable, 0.0f, 99, "",         "localhost", 3306, 33060}, rs.at("replicaset-1").members.at(2)));
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-4", "",                 ServerMode::Unavailable, 0.0f, 0, "",          "", 3306, 33060}, rs.at("replicaset-1").members.at(3)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::HA,               ServerMode::Unavailable, 0.2f, 0, "location1", "localhost", 3310, 33100, 0}, rs.at("replicaset-1").members.at(0)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 1.5f, 1, "s.o_loc",   "localhost", 3320, 33200, 0}, rs.at("replicaset-1").members.at(1)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown,                 ServerMode::Unavailable, 0.0f, 99, "",         "localhost", 3306, 33060, 0}, rs.at("replicaset-1").members.at(2)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-4", InstanceRole::Unknown,                 ServerMode::Unavailable, 0.0f, 0, "",          "", 3306, 33060, 0}, rs.at("replicaset-1").members.at(3)));
     // TODO is this really right behavior? ---------------------------------------------------------------------------------------------------^^
   }
 
@@ -477,14 +495,14 @@ TEST_F(MetadataTest, FetchInstancesFromMetadataServer) {
 
     EXPECT_EQ(3u, rs.size());
     EXPECT_EQ(3u, rs.at("replicaset-1").members.size());
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-1", "HA", ServerMode::Unavailable, 0, 0, "", "localhost1", 1111, 11110}, rs.at("replicaset-1").members.at(0)));
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-2", "HA", ServerMode::Unavailable, 0, 0, "", "localhost1", 2222, 22220}, rs.at("replicaset-1").members.at(1)));
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-3", "HA", ServerMode::Unavailable, 0, 0, "", "localhost1", 3333, 33330}, rs.at("replicaset-1").members.at(2)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost1", 1111, 11110, 0}, rs.at("replicaset-1").members.at(0)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost1", 2222, 22220, 0}, rs.at("replicaset-1").members.at(1)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost1", 3333, 33330, 0}, rs.at("replicaset-1").members.at(2)));
     EXPECT_EQ(1u, rs.at("replicaset-2").members.size());
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-2", "instance-4", "HA", ServerMode::Unavailable, 0, 0, "", "localhost2", 3333, 33330}, rs.at("replicaset-2").members.at(0)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-2", "instance-4", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost2", 3333, 33330, 0}, rs.at("replicaset-2").members.at(0)));
     EXPECT_EQ(2u, rs.at("replicaset-3").members.size());
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-3", "instance-5", "HA", ServerMode::Unavailable, 0, 0, "", "localhost3", 3333, 33330}, rs.at("replicaset-3").members.at(0)));
-    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-3", "instance-6", "HA", ServerMode::Unavailable, 0, 0, "", "localhost3", 3333, 33330}, rs.at("replicaset-3").members.at(1)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-3", "instance-5", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost3", 3333, 33330, 0}, rs.at("replicaset-3").members.at(0)));
+    EXPECT_TRUE(cmp_mi_FIFMS(ManagedInstance{"replicaset-3", "instance-6", InstanceRole::HA, ServerMode::Unavailable, 0, 0, "", "localhost3", 3333, 33330, 0}, rs.at("replicaset-3").members.at(1)));
   }
 
   // query fails
@@ -530,9 +548,9 @@ TEST_F(MetadataTest, CheckReplicasetStatus_3NodeSetup) {
 
   std::vector<ManagedInstance> servers_in_metadata {
     // ServerMode doesn't matter ------vvvvvvvvvvv
-    {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "instance-2", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "instance-3", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+    {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "instance-3", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
   };
 
   // typical
@@ -764,13 +782,13 @@ TEST_F(MetadataTest, CheckReplicasetStatus_VariableNodeSetup) {
   {
     std::vector<ManagedInstance> servers_in_metadata {
       // ServerMode doesn't matter ------vvvvvvvvvvv
-      {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-2", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-3", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-4", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-5", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-6", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-7", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+      {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-3", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-4", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-5", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-6", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-7", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
     };
     EXPECT_EQ(RS::AvailableWritable, metadata.check_replicaset_status(servers_in_metadata, server_status));
     EXPECT_EQ(ServerMode::ReadWrite,   servers_in_metadata.at(0).mode);
@@ -783,10 +801,10 @@ TEST_F(MetadataTest, CheckReplicasetStatus_VariableNodeSetup) {
   // 4-node setup according to metadata
   {
     std::vector<ManagedInstance> servers_in_metadata {
-      {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-2", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-3", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-4", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+      {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-3", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-4", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
     };
     EXPECT_EQ(RS::AvailableWritable, metadata.check_replicaset_status(servers_in_metadata, server_status));
     EXPECT_EQ(ServerMode::ReadWrite,   servers_in_metadata.at(0).mode);
@@ -808,8 +826,8 @@ TEST_F(MetadataTest, CheckReplicasetStatus_VariableNodeSetup) {
   // 2-node setup according to metadata -> quorum requires 3 nodes, 2 nodes count
   {
     std::vector<ManagedInstance> servers_in_metadata {
-      {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-      {"", "instance-2", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+      {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+      {"", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
     };
     EXPECT_EQ(RS::AvailableWritable, metadata.check_replicaset_status(servers_in_metadata, server_status));
     EXPECT_EQ(ServerMode::ReadWrite,   servers_in_metadata.at(0).mode);
@@ -820,7 +838,7 @@ TEST_F(MetadataTest, CheckReplicasetStatus_VariableNodeSetup) {
   // 1-node setup according to metadata -> quorum requires 3 nodes, 1 node counts
   {
     std::vector<ManagedInstance> servers_in_metadata {
-      {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+      {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
     };
     EXPECT_EQ(RS::Unavailable, metadata.check_replicaset_status(servers_in_metadata, server_status));
     EXPECT_EQ(ServerMode::ReadWrite,   servers_in_metadata.at(0).mode);
@@ -852,9 +870,9 @@ TEST_F(MetadataTest, CheckReplicasetStatus_VariousStatuses) {
 
   std::vector<ManagedInstance> servers_in_metadata {
     // ServerMode doesn't matter ------vvvvvvvvvvv
-    {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "instance-2", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "instance-3", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+    {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "instance-3", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
   };
 
   for (State state : {State::Offline, State::Error, State::Unreachable, State::Other}) {
@@ -915,9 +933,9 @@ TEST_F(MetadataTest, CheckReplicasetStatus_Recovering) {
 
   std::vector<ManagedInstance> servers_in_metadata {
     // ServerMode doesn't matter ------vvvvvvvvvvv
-    {"", "instance-1", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "instance-2", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "instance-3", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+    {"", "instance-1", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "instance-2", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "instance-3", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
   };
 
 
@@ -1082,9 +1100,9 @@ TEST_F(MetadataTest, CheckReplicasetStatus_Cornercase2of5Alive) {
 
   // MD defines 3 nodes
   std::vector<ManagedInstance> servers_in_metadata {
-    {"", "node-A", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "node-B", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "node-C", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+    {"", "node-A", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "node-B", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "node-C", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
   };
 
   // GR reports 5 nodes, of which only 2 are alive (no qourum), BUT from
@@ -1150,9 +1168,9 @@ TEST_F(MetadataTest, CheckReplicasetStatus_Cornercase3of5Alive) {
 
   // MD defines 3 nodes
   std::vector<ManagedInstance> servers_in_metadata {
-    {"", "node-A", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "node-B", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "node-C", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+    {"", "node-A", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "node-B", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "node-C", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
   };
 
   // GR reports 5 nodes, of which 3 are alive (have qourum), BUT from
@@ -1217,9 +1235,9 @@ TEST_F(MetadataTest, CheckReplicasetStatus_Cornercase1Common) {
 
   // MD defines 3 nodes
   std::vector<ManagedInstance> servers_in_metadata {
-    {"", "node-A", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "node-B", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
-    {"", "node-C", "", ServerMode::Unavailable, 0, 0, "", "", 0, 0},
+    {"", "node-A", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "node-B", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
+    {"", "node-C", InstanceRole::Unknown, ServerMode::Unavailable, 0, 0, "", "", 0, 0, 0},
   };
 
   // GR reports 3 nodes, of which 3 are alive (have qourum), BUT from
@@ -1306,9 +1324,9 @@ TEST_F(MetadataTest, UpdateReplicasetStatus_PrimaryMember_FailConnectOnNode2) {
   metadata.update_replicaset_status("replicaset-1", replicaset);
 
   EXPECT_EQ(3u, replicaset.members.size());
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100}, replicaset.members.at(0)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200}, replicaset.members.at(1)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300}, replicaset.members.at(2)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, replicaset.members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200, 0}, replicaset.members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300, 0}, replicaset.members.at(2)));
 
   EXPECT_EQ(3, session_factory.create_cnt());          // +2 from new connections to localhost:3320 and :3330
 }
@@ -1402,9 +1420,9 @@ TEST_F(MetadataTest, UpdateReplicasetStatus_PrimaryMember_FailQueryOnNode1) {
 
   // query_status reported back from instance-2
   EXPECT_EQ(3u, replicaset.members.size());
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100}, replicaset.members.at(0)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200}, replicaset.members.at(1)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300}, replicaset.members.at(2)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, replicaset.members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200, 0}, replicaset.members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300, 0}, replicaset.members.at(2)));
 }
 
 /**
@@ -1510,9 +1528,9 @@ TEST_F(MetadataTest, UpdateReplicasetStatus_Status_FailQueryOnNode1) {
 
   // query_status reported back from instance-1
   EXPECT_EQ(3u, replicaset.members.size());
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100}, replicaset.members.at(0)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200}, replicaset.members.at(1)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300}, replicaset.members.at(2)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, replicaset.members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200, 0}, replicaset.members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300, 0}, replicaset.members.at(2)));
 }
 
 /**
@@ -1615,9 +1633,147 @@ TEST_F(MetadataTest, UpdateReplicasetStatus_SimpleSunnyDayScenario) {
 
   // query_status reported back from instance-1
   EXPECT_EQ(3u, replicaset.members.size());
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100}, replicaset.members.at(0)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200}, replicaset.members.at(1)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", "", ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300}, replicaset.members.at(2)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, replicaset.members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200, 0}, replicaset.members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300, 0}, replicaset.members.at(2)));
+}
+
+
+/**
+ * @test
+ * Verify `ClusterMetadata::update_replicaset_status()` fetches the primary
+ * member together with the status of the members, in one query, from servers
+ * that support it.
+ *
+ *     Scenario details:
+ *     iteration 1 (instance-1): query_status_with_primary_member OK
+ */
+TEST_F(MetadataTest, UpdateReplicasetStatus_CombinedQuery) {
+  connect_to_first_metadata_server();
+
+  unsigned session = 0;
+  session_factory.get(session).set_server_version(50720);
+
+  EXPECT_CALL(session_factory.get(session), query(StartsWith(query_primary_member), _)).Times(0);
+  EXPECT_CALL(session_factory.get(session), query(StartsWith(query_status_with_primary_member), _)).Times(1)
+    .WillOnce(Invoke([this, session](const std::string&, const MySQLSession::RowProcessor& processor) {
+      session_factory.get(session).query_impl(processor, {
+        {"instance-1", "ubuntu", "3310", "ONLINE", "1", "instance-1"},
+        {"instance-2", "ubuntu", "3320", "ONLINE", "1", "instance-1"},
+        {"instance-3", "ubuntu", "3330", "ONLINE", "1", "instance-1"},
+      });
+    }));
+
+  ManagedReplicaSet replicaset = typical_replicaset;
+  metadata.update_replicaset_status("replicaset-1", replicaset);
+
+  EXPECT_EQ(3u, replicaset.members.size());
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, replicaset.members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200, 0}, replicaset.members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300, 0}, replicaset.members.at(2)));
+}
+
+/**
+ * @test
+ * Verify `ClusterMetadata::update_replicaset_status()` falls back to the
+ * separate queries for a server which lacks the table of the combined query,
+ * and keeps using them for that server.
+ *
+ *     Scenario details (both updates):
+ *     iteration 1 (instance-1): query_status_with_primary_member FAILS (1146),
+ *                               query_primary_member OK, query_status OK
+ */
+TEST_F(MetadataTest, UpdateReplicasetStatus_CombinedQueryRejected) {
+  connect_to_first_metadata_server();
+
+  unsigned session = 0;
+  // the rejection is remembered per server and version, a version of its
+  // own keeps it from affecting the other tests
+  session_factory.get(session).set_server_version(50721);
+
+  EXPECT_CALL(session_factory.get(session), query(StartsWith(query_status_with_primary_member), _)).Times(1)
+    .WillOnce(Invoke([](const std::string&, const MySQLSession::RowProcessor&) {
+      throw MySQLSession::Error("Table 'performance_schema.global_status' doesn't exist", 1146);
+    }));
+  EXPECT_CALL(session_factory.get(session), query(StartsWith(query_primary_member), _)).Times(2)
+    .WillRepeatedly(Invoke(query_primary_member_ok(session)));
+  EXPECT_CALL(session_factory.get(session), query(StartsWith(query_status), _)).Times(2)
+    .WillRepeatedly(Invoke(query_status_ok(session)));
+
+  for (int update = 0; update < 2; ++update) {
+    ManagedReplicaSet replicaset = typical_replicaset;
+    metadata.update_replicaset_status("replicaset-1", replicaset);
+    EXPECT_EQ(3u, replicaset.members.size());
+  }
+}
+
+/**
+ * @test
+ * Verify `ClusterMetadata::update_replicaset_status()` keeps the connections
+ * it opened to replicaset members and reuses them on the next update.
+ *
+ *     Scenario details (both updates):
+ *     iteration 1 (instance-1): query_primary_member FAILS
+ *     iteration 2 (instance-2): query_primary_member OK, query_status OK
+ */
+TEST_F(MetadataTest, UpdateReplicasetStatus_ReusesMemberConnection) {
+  connect_to_first_metadata_server();
+
+  EXPECT_CALL(session_factory.get(0), query(StartsWith(query_primary_member), _)).Times(2)
+    .WillRepeatedly(Invoke(query_primary_member_fail(0)));
+
+  enable_connection(1, 3320);
+  EXPECT_CALL(session_factory.get(1), query(StartsWith(query_primary_member), _)).Times(2)
+    .WillRepeatedly(Invoke(query_primary_member_ok(1)));
+  EXPECT_CALL(session_factory.get(1), query(StartsWith(query_status), _)).Times(2)
+    .WillRepeatedly(Invoke(query_status_ok(1)));
+
+  ManagedReplicaSet replicaset = typical_replicaset;
+  metadata.update_replicaset_status("replicaset-1", replicaset);
+  EXPECT_EQ(2, session_factory.create_cnt());
+
+  replicaset = typical_replicaset;
+  metadata.update_replicaset_status("replicaset-1", replicaset);
+  EXPECT_EQ(2, session_factory.create_cnt());          // localhost:3320 connection reused
+
+  // connecting to the same metadata server again keeps its connection too
+  EXPECT_TRUE(metadata.connect(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}));
+  EXPECT_EQ(2, session_factory.create_cnt());
+}
+/**
+ * @test
+ * Verify `ClusterMetadata::fetch_replicaset_status()` polls the member found to
+ * be part of quorum by the previous update over the connection kept open to it.
+ *
+ *     Scenario details:
+ *     update (instance-1): query_primary_member FAILS
+ *     update (instance-2): query_primary_member OK, query_status OK
+ *     poll   (instance-2): query_primary_member OK, query_status OK
+ */
+TEST_F(MetadataTest, FetchReplicasetStatus_ReusesQuorumConnection) {
+  connect_to_first_metadata_server();
+
+  EXPECT_CALL(session_factory.get(0), query(StartsWith(query_primary_member), _)).Times(1)
+    .WillOnce(Invoke(query_primary_member_fail(0)));
+
+  enable_connection(1, 3320);
+  EXPECT_CALL(session_factory.get(1), query(StartsWith(query_primary_member), _)).Times(2)
+    .WillRepeatedly(Invoke(query_primary_member_ok(1)));
+  EXPECT_CALL(session_factory.get(1), query(StartsWith(query_status), _)).Times(2)
+    .WillRepeatedly(Invoke(query_status_ok(1)));
+
+  ManagedReplicaSet replicaset = typical_replicaset;
+  metadata.update_replicaset_status("replicaset-1", replicaset);
+  EXPECT_EQ(2, session_factory.create_cnt());
+
+  ManagedReplicaSet polled = typical_replicaset;
+  EXPECT_TRUE(metadata.fetch_replicaset_status("replicaset-1", polled));
+
+  EXPECT_EQ(2, session_factory.create_cnt());          // no new connection
+  ASSERT_EQ(3u, polled.members.size());
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, polled.members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3320, 33200, 0}, polled.members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly,  0, 0, "", "localhost", 3330, 33300, 0}, polled.members.at(2)));
 }
 
 
@@ -1662,9 +1818,9 @@ TEST_F(MetadataTest, FetchInstances_1Replicaset_ok) {
 
   EXPECT_EQ(1u, rs.size());
   EXPECT_EQ(3u, rs.at("replicaset-1").members.size());
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", "", ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100}, rs.at("replicaset-1").members.at(0)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", "", ServerMode::ReadOnly, 0, 0, "", "localhost", 3320, 33200}, rs.at("replicaset-1").members.at(1)));
-  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", "", ServerMode::ReadOnly, 0, 0, "", "localhost", 3330, 33300}, rs.at("replicaset-1").members.at(2)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-1", InstanceRole::Unknown, ServerMode::ReadWrite, 0, 0, "", "localhost", 3310, 33100, 0}, rs.at("replicaset-1").members.at(0)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-2", InstanceRole::Unknown, ServerMode::ReadOnly, 0, 0, "", "localhost", 3320, 33200, 0}, rs.at("replicaset-1").members.at(1)));
+  EXPECT_TRUE(cmp_mi_FI(ManagedInstance{"replicaset-1", "instance-3", InstanceRole::Unknown, ServerMode::ReadOnly, 0, 0, "", "localhost", 3330, 33300, 0}, rs.at("replicaset-1").members.at(2)));
 }
 
 /**
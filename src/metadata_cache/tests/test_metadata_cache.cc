@@ -38,6 +38,8 @@
 #include "tcp_address.h"
 #include "test/helpers.h"
 
+#include <thread>
+
 using metadata_cache::ManagedInstance;
 using mysql_harness::TCPAddress;
 
@@ -66,6 +68,28 @@ TEST_F(MetadataCacheTest, ValidReplicasetTest_1) {
   EXPECT_EQ(instance_vector_1[2], mf.ms3);
 }
 
+/**
+ * Test that a cache serving several clusters keys their replicasets by
+ * cluster and replicaset name.
+ */
+TEST_F(MetadataCacheTest, MultipleClusters) {
+  MetadataCache clusters({TCPAddress("localhost", 32275)},
+                         get_instance("admin", "admin", 1, 1, 1, std::chrono::seconds(10),
+                                      mysqlrouter::SSLOptions()),
+                         std::chrono::seconds(10), mysqlrouter::SSLOptions(),
+                         "cluster-1, cluster-2");
+
+  for (const char *cluster : {"cluster-1", "cluster-2"}) {
+    std::vector<ManagedInstance> instances = clusters.replicaset_lookup(
+        metadata_cache::qualified_replicaset_name(cluster, "replicaset-1"));
+    ASSERT_EQ(3U, instances.size());
+    EXPECT_EQ(mf.ms1, instances[0]);
+    EXPECT_EQ(mf.ms2, instances[1]);
+    EXPECT_EQ(mf.ms3, instances[2]);
+  }
+  EXPECT_TRUE(clusters.replicaset_lookup("replicaset-1").empty());
+}
+
 /**
  * Test that looking up an invalid replicaset returns a empty list.
  */
@@ -77,6 +101,291 @@ TEST_F(MetadataCacheTest, InvalidReplicasetTest) {
   EXPECT_TRUE(instance_vector.empty());
 }
 
+/**
+ * Test that lookups share the published snapshot instead of copying it.
+ */
+TEST_F(MetadataCacheTest, SnapshotIsShared) {
+  metadata_cache::InstancesSnapshot snapshot = cache.replicaset_snapshot("replicaset-1");
+
+  ASSERT_NE(nullptr, snapshot);
+  EXPECT_EQ(snapshot, cache.replicaset_snapshot("replicaset-1"));
+  EXPECT_EQ(*snapshot, cache.replicaset_lookup("replicaset-1"));
+
+  metadata_cache::LookupResult result(snapshot);
+  EXPECT_EQ(snapshot, result.snapshot());
+  EXPECT_EQ(&result.instance_vector, snapshot.get());
+
+  ASSERT_NE(nullptr, cache.replicaset_snapshot("InvalidReplicasetTest"));
+  EXPECT_TRUE(cache.replicaset_snapshot("InvalidReplicasetTest")->empty());
+}
+
+/**
+ * Test that the diff between two member lists reports added, removed and
+ * changed members.
+ */
+TEST_F(MetadataCacheTest, DiffInstances) {
+  EXPECT_TRUE(metadata_cache::diff_instances({mf.ms1, mf.ms2}, {mf.ms1, mf.ms2}).empty());
+
+  ManagedInstance ms2_ro = mf.ms2;
+  ms2_ro.mode = mf.ms2.mode == metadata_cache::ServerMode::ReadOnly
+      ? metadata_cache::ServerMode::ReadWrite : metadata_cache::ServerMode::ReadOnly;
+
+  metadata_cache::InstancesDiff diff =
+      metadata_cache::diff_instances({mf.ms1, mf.ms2}, {ms2_ro, mf.ms3});
+  ASSERT_EQ(1U, diff.added.size());
+  EXPECT_EQ(mf.ms3, diff.added[0]);
+  ASSERT_EQ(1U, diff.removed.size());
+  EXPECT_EQ(mf.ms1, diff.removed[0]);
+  ASSERT_EQ(1U, diff.changed.size());
+  EXPECT_EQ(mf.ms2, diff.changed[0].first);
+  EXPECT_EQ(ms2_ro, diff.changed[0].second);
+}
+
+class UnreachableMetadata : public MockNG {
+ public:
+  UnreachableMetadata() : MockNG("admin", "admin", 1, 1, 1, std::chrono::seconds(10)) {}
+
+  bool connect(const metadata_cache::ManagedInstance &) noexcept override {
+    return false;
+  }
+};
+
+/**
+ * Test that a restarted cache routes from the persisted topology while the
+ * metadata servers are unreachable.
+ */
+TEST_F(MetadataCacheTest, TopologyCacheUsedOnRestart) {
+  TmpDir tmp_dir;
+  const std::string cache_file = tmp_dir.file("topology.json");
+
+  {
+    // populated from the metadata servers and persisted
+    MetadataCache live({TCPAddress("localhost", 32275)},
+                       get_instance("admin", "admin", 1, 1, 1, std::chrono::seconds(10),
+                                    mysqlrouter::SSLOptions()),
+                       std::chrono::seconds(10), mysqlrouter::SSLOptions(), "replicaset-1",
+                       mysql_harness::kDefaultStackSizeInKiloBytes,
+                       std::chrono::milliseconds(0), cache_file);
+    ASSERT_EQ(3U, live.replicaset_lookup("replicaset-1").size());
+  }
+
+  MetadataCache restarted({TCPAddress("localhost", 32275)},
+                          std::make_shared<UnreachableMetadata>(),
+                          std::chrono::seconds(10), mysqlrouter::SSLOptions(), "replicaset-1",
+                          mysql_harness::kDefaultStackSizeInKiloBytes,
+                          std::chrono::milliseconds(0), cache_file);
+  std::vector<ManagedInstance> instances = restarted.replicaset_lookup("replicaset-1");
+  ASSERT_EQ(3U, instances.size());
+  EXPECT_EQ(mf.ms1, instances[0]);
+  EXPECT_EQ(mf.ms2, instances[1]);
+  EXPECT_EQ(mf.ms3, instances[2]);
+
+  // a failed refresh doesn't throw the cached topology away
+  restarted.refresh();
+  EXPECT_EQ(instances, restarted.replicaset_lookup("replicaset-1"));
+}
+
+/**
+ * Test that the refresh interval backs off while the topology is stable and
+ * is reset by changes.
+ */
+TEST_F(MetadataCacheTest, AdaptiveTTL) {
+  using std::chrono::seconds;
+  MetadataCache adaptive({TCPAddress("localhost", 32275)},
+                         get_instance("admin", "admin", 1, 1, 1, seconds(1),
+                                      mysqlrouter::SSLOptions()),
+                         seconds(1), mysqlrouter::SSLOptions(), "replicaset-1",
+                         mysql_harness::kDefaultStackSizeInKiloBytes,
+                         std::chrono::milliseconds(0), "", false, seconds(5));
+
+  EXPECT_EQ(seconds(2), adaptive.next_refresh_interval(seconds(1), false));
+  EXPECT_EQ(seconds(4), adaptive.next_refresh_interval(seconds(2), false));
+  EXPECT_EQ(seconds(5), adaptive.next_refresh_interval(seconds(4), false));
+  EXPECT_EQ(seconds(5), adaptive.next_refresh_interval(seconds(5), false));
+  EXPECT_EQ(seconds(1), adaptive.next_refresh_interval(seconds(5), true));
+
+  // the constructor's refresh found the initial topology
+  EXPECT_TRUE(adaptive.refresh_found_changes_);
+  adaptive.refresh();
+  EXPECT_FALSE(adaptive.refresh_found_changes_);
+
+  // not adaptive without max_ttl
+  EXPECT_EQ(seconds(10), cache.next_refresh_interval(seconds(10), false));
+}
+
+/**
+ * Test that the waits between refreshes deviate by up to refresh_jitter
+ * percent.
+ */
+TEST_F(MetadataCacheTest, RefreshJitter) {
+  using std::chrono::milliseconds;
+  MetadataCache jittered({TCPAddress("localhost", 32275)},
+                         get_instance("admin", "admin", 1, 1, 1, milliseconds(1000),
+                                      mysqlrouter::SSLOptions()),
+                         milliseconds(1000), mysqlrouter::SSLOptions(), "replicaset-1",
+                         mysql_harness::kDefaultStackSizeInKiloBytes,
+                         milliseconds(0), "", false, milliseconds(0), 20);
+
+  bool deviated = false;
+  for (int i = 0; i < 100; ++i) {
+    const milliseconds interval = jittered.jittered(milliseconds(1000));
+    EXPECT_GE(interval, milliseconds(800));
+    EXPECT_LE(interval, milliseconds(1200));
+    if (interval != milliseconds(1000)) deviated = true;
+  }
+  EXPECT_TRUE(deviated);
+  EXPECT_EQ(milliseconds(0), jittered.jittered(milliseconds(0)));
+
+  // no jitter by default
+  EXPECT_EQ(milliseconds(1000), cache.jittered(milliseconds(1000)));
+}
+
+/**
+ * Test that the metadata servers are tried fastest first and servers that
+ * failed last.
+ */
+TEST_F(MetadataCacheTest, MetadataServerOrder) {
+  using std::chrono::microseconds;
+  MetadataCache ordered({TCPAddress("localhost", 32275), TCPAddress("localhost", 32276),
+                         TCPAddress("localhost", 32277)},
+                        get_instance("admin", "admin", 1, 1, 1, std::chrono::seconds(10),
+                                     mysqlrouter::SSLOptions()),
+                        std::chrono::seconds(10), mysqlrouter::SSLOptions(), "replicaset-1",
+                        mysql_harness::kDefaultStackSizeInKiloBytes,
+                        std::chrono::milliseconds(0), "", false, std::chrono::milliseconds(0),
+                        0, true);
+
+  // forget the refresh of the constructor
+  ordered.metadata_server_stats_.assign(3, MetadataCache::MetadataServerStats());
+
+  // servers not tried yet keep the configured order
+  EXPECT_EQ(std::vector<size_t>({0, 1, 2}), ordered.metadata_server_order());
+
+  ordered.account_metadata_server(0, true, microseconds(3000));
+  ordered.account_metadata_server(1, true, microseconds(1000));
+  ordered.account_metadata_server(2, true, microseconds(2000));
+  EXPECT_EQ(std::vector<size_t>({1, 2, 0}), ordered.metadata_server_order());
+
+  // a failed server goes last until its retry is due
+  ordered.account_metadata_server(1, false, microseconds(0));
+  EXPECT_EQ(std::vector<size_t>({2, 0, 1}), ordered.metadata_server_order());
+  ordered.refresh_seq_ += 2;
+  EXPECT_EQ(std::vector<size_t>({1, 2, 0}), ordered.metadata_server_order());
+
+  // the fastest failing again is retried after twice as many refreshes
+  ordered.account_metadata_server(1, false, microseconds(0));
+  ordered.refresh_seq_ += 2;
+  EXPECT_EQ(std::vector<size_t>({2, 0, 1}), ordered.metadata_server_order());
+  ordered.refresh_seq_ += 2;
+  EXPECT_EQ(std::vector<size_t>({1, 2, 0}), ordered.metadata_server_order());
+
+  // the configured order is kept unless ordering is enabled
+  cache.account_metadata_server(0, false, microseconds(0));
+  EXPECT_EQ(std::vector<size_t>({0}), cache.metadata_server_order());
+}
+
+/**
+ * Test that wait_primary_failover() returns as soon as a refresh brings a
+ * topology with a primary, not in TTL steps.
+ */
+TEST_F(MetadataCacheTest, WaitPrimaryFailoverWakesUp) {
+  cache.mark_instance_reachability(mf.ms1.mysql_server_uuid,
+                                   metadata_cache::InstanceStatus::Unreachable);
+  EXPECT_FALSE(cache.wait_primary_failover("replicaset-1", 0));
+
+  // let the next refresh see a change
+  cache.replicaset_data_["replicaset-1"].members[2].weight = 2;
+
+  const auto start = std::chrono::steady_clock::now();
+  bool failover = false;
+  std::thread waiter([&] {
+    failover = cache.wait_primary_failover("replicaset-1", 30);
+  });
+  cache.refresh();
+  waiter.join();
+
+  EXPECT_TRUE(failover);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+/**
+ * Test that the topology version only counts refreshes that change the
+ * members and that wait_topology_change() returns as soon as one does.
+ */
+TEST_F(MetadataCacheTest, TopologyVersion) {
+  const auto topology = cache.get_topology();
+  EXPECT_LT(0U, topology.version);
+  ASSERT_EQ(1U, topology.replicasets.count("replicaset-1"));
+  EXPECT_EQ(3U, topology.replicasets.at("replicaset-1")->size());
+
+  // no change, no new version
+  cache.refresh();
+  EXPECT_EQ(topology.version, cache.get_topology().version);
+  EXPECT_EQ(topology.version,
+            cache.wait_topology_change(topology.version, std::chrono::milliseconds(0)).version);
+
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t version = 0;
+  std::thread waiter([&] {
+    version = cache.wait_topology_change(topology.version, std::chrono::seconds(30)).version;
+  });
+  {
+    std::lock_guard<std::mutex> lock(cache.cache_refreshing_mutex_);
+    cache.replicaset_data_["replicaset-1"].members[2].weight = 2;
+    cache.publish_snapshots();
+  }
+  waiter.join();
+
+  EXPECT_EQ(topology.version + 1, version);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  // the refresh brings back the members of the metadata
+  cache.refresh();
+  EXPECT_EQ(topology.version + 2, cache.get_topology().version);
+
+  // a version the caller doesn't know is returned right away
+  EXPECT_EQ(version + 1, cache.wait_topology_change(0, std::chrono::seconds(30)).version);
+}
+
+/**
+ * Test that of the caches sharing a topology only one queries the metadata
+ * servers and the others follow the topology it writes.
+ */
+TEST_F(MetadataCacheTest, SharedTopology) {
+  TmpDir tmp_dir;
+  const std::string cache_file = tmp_dir.file("topology.json");
+
+  std::unique_ptr<MetadataCache> refreshing(new MetadataCache(
+      {TCPAddress("localhost", 32275)},
+      get_instance("admin", "admin", 1, 1, 1, std::chrono::seconds(10),
+                   mysqlrouter::SSLOptions()),
+      std::chrono::seconds(10), mysqlrouter::SSLOptions(), "replicaset-1",
+      mysql_harness::kDefaultStackSizeInKiloBytes,
+      std::chrono::milliseconds(0), cache_file, /*shared_topology=*/true));
+  ASSERT_EQ(3U, refreshing->replicaset_lookup("replicaset-1").size());
+
+  // can't reach the metadata servers, but doesn't need to
+  MetadataCache following({TCPAddress("localhost", 32275)},
+                          std::make_shared<UnreachableMetadata>(),
+                          std::chrono::seconds(10), mysqlrouter::SSLOptions(), "replicaset-1",
+                          mysql_harness::kDefaultStackSizeInKiloBytes,
+                          std::chrono::milliseconds(0), cache_file, /*shared_topology=*/true);
+  ASSERT_EQ(3U, following.replicaset_lookup("replicaset-1").size());
+
+  // the refreshing cache publishes a new topology
+  MetaData::ReplicaSetsByName replicasets = mf.replicaset_map;
+  replicasets["replicaset-1"].members.pop_back();
+  save_topology_cache(cache_file, "replicaset-1", 100, replicasets);
+  following.refresh();
+  EXPECT_EQ(replicasets["replicaset-1"].members, following.replicaset_lookup("replicaset-1"));
+
+  // once the refreshing cache is gone, the other one takes over and keeps
+  // the shared topology while the metadata servers are unreachable
+  refreshing.reset();
+  following.refresh();
+  EXPECT_EQ(replicasets["replicaset-1"].members, following.replicaset_lookup("replicaset-1"));
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -206,6 +515,16 @@ TEST_F(MetadataCacheTest2, metadata_server_connection_failures) {
   mc.refresh();
   expect_cluster_not_routable(mc); // lookup should return nothing (all route paths should have been cleared)
 
+  // the failed refresh is counted and timed like the others
+  metadata_cache::RefreshStats stats = mc.get_refresh_stats();
+  EXPECT_EQ(3U, stats.refreshes);
+  EXPECT_EQ(1U, stats.refresh_failures);
+  EXPECT_LE(stats.last_refresh_duration, stats.refresh_duration_sum);
+  // the failed one cleared the cache, telling the listeners
+  EXPECT_LE(1U, stats.lock_holds);
+  EXPECT_LE(stats.max_lock_hold, stats.lock_hold_sum);
+  EXPECT_LE(1U, stats.notifications);
+
   // refresh: fail connecting to first 2 metadata servers
   m.expect_connect("127.0.0.1", 3000, "admin", "admin", "").then_error("some fake bad connection message", 66);
   m.expect_connect("127.0.0.1", 3001, "admin", "admin", "").then_error("some fake bad connection message", 66);
@@ -338,6 +338,72 @@ INSTANTIATE_TEST_CASE_P(SomethingUseful, MetadataCachePluginConfigBadTest,
         "option ttl in [metadata_cache] needs value between 0 and 3600 inclusive, was '-0.1'",
       }
     },
+    // membership_poll_interval is too big
+    {
+      {
+        std::map<std::string, std::string>({
+          { "user", "foo" }, // required
+          { "membership_poll_interval", "60.1" },
+        }),
+      },
+      {
+        typeid(std::invalid_argument),
+        "option membership_poll_interval in [metadata_cache] needs value between 0 and 60 inclusive, was '60.1'",
+      }
+    },
+    // max_ttl below ttl
+    {
+      {
+        std::map<std::string, std::string>({
+          { "user", "foo" }, // required
+          { "ttl", "10" },
+          { "max_ttl", "5" },
+        }),
+      },
+      {
+        typeid(std::invalid_argument),
+        "option max_ttl in [metadata_cache] needs to be 0 or not smaller than ttl",
+      }
+    },
+    // shared_topology without topology_cache_file
+    {
+      {
+        std::map<std::string, std::string>({
+          { "user", "foo" }, // required
+          { "shared_topology", "1" },
+        }),
+      },
+      {
+        typeid(std::invalid_argument),
+        "option shared_topology in [metadata_cache] requires topology_cache_file to be set",
+      }
+    },
+    // empty name in a list of clusters
+    {
+      {
+        std::map<std::string, std::string>({
+          { "user", "foo" }, // required
+          { "metadata_cluster", "cluster-1,,cluster-2" },
+        }),
+      },
+      {
+        typeid(std::invalid_argument),
+        "option metadata_cluster in [metadata_cache] needs to be a comma separated list of cluster names",
+      }
+    },
+    // refresh_jitter is too big
+    {
+      {
+        std::map<std::string, std::string>({
+          { "user", "foo" }, // required
+          { "refresh_jitter", "51" },
+        }),
+      },
+      {
+        typeid(std::invalid_argument),
+        "option refresh_jitter in [metadata_cache] needs value between 0 and 50 inclusive, was '51'",
+      }
+    },
   })));
 
 using mysqlrouter::BasePluginConfig;
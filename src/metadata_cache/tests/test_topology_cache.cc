@@ -0,0 +1,157 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "topology_cache.h"
+#include "test/helpers.h"
+
+#include <fstream>
+#include <memory>
+
+#include "gtest/gtest.h"
+
+using metadata_cache::ManagedInstance;
+
+class TopologyCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ManagedInstance primary;
+    primary.replicaset_name = "default";
+    primary.mysql_server_uuid = "uuid-1";
+    primary.role = metadata_cache::InstanceRole::HA;
+    primary.mode = metadata_cache::ServerMode::ReadWrite;
+    primary.weight = 1;
+    primary.version_token = 0;
+    primary.location = "";
+    primary.host = "host-1";
+    primary.port = 3306;
+    primary.xport = 33060;
+
+    ManagedInstance secondary = primary;
+    secondary.mysql_server_uuid = "uuid-2";
+    secondary.mode = metadata_cache::ServerMode::ReadOnly;
+    secondary.host = "host-2";
+
+    metadata_cache::ManagedReplicaSet rs;
+    rs.name = "default";
+    rs.single_primary_mode = true;
+    rs.members = {primary, secondary};
+    replicasets_["default"] = rs;
+  }
+
+  TmpDir tmp_dir_;
+  MetaData::ReplicaSetsByName replicasets_;
+};
+
+/**
+ * @test verifies that the stored topology is read back as it was written
+ */
+TEST_F(TopologyCacheTest, SaveAndLoad) {
+  const std::string path = tmp_dir_.file("topology.json");
+  save_topology_cache(path, "cluster", 7, replicasets_);
+
+  uint64_t view_id = 0;
+  MetaData::ReplicaSetsByName loaded = load_topology_cache(path, "cluster", view_id);
+
+  EXPECT_EQ(7u, view_id);
+  ASSERT_EQ(1u, loaded.size());
+  const metadata_cache::ManagedReplicaSet &rs = loaded["default"];
+  EXPECT_EQ("default", rs.name);
+  EXPECT_TRUE(rs.single_primary_mode);
+  EXPECT_EQ(replicasets_["default"].members, rs.members);
+}
+
+/**
+ * @test verifies that writing again replaces the stored topology
+ */
+TEST_F(TopologyCacheTest, SaveReplaces) {
+  const std::string path = tmp_dir_.file("topology.json");
+  save_topology_cache(path, "cluster", 1, replicasets_);
+
+  replicasets_["default"].members.pop_back();
+  save_topology_cache(path, "cluster", 2, replicasets_);
+
+  uint64_t view_id = 0;
+  MetaData::ReplicaSetsByName loaded = load_topology_cache(path, "cluster", view_id);
+  EXPECT_EQ(2u, view_id);
+  EXPECT_EQ(1u, loaded["default"].members.size());
+}
+
+/**
+ * @test verifies that a topology stored for another cluster is rejected
+ */
+TEST_F(TopologyCacheTest, OtherCluster) {
+  const std::string path = tmp_dir_.file("topology.json");
+  save_topology_cache(path, "cluster", 1, replicasets_);
+
+  uint64_t view_id = 0;
+  EXPECT_THROW(load_topology_cache(path, "other-cluster", view_id), std::runtime_error);
+  EXPECT_EQ(0u, view_id);
+}
+
+/**
+ * @test verifies that missing and malformed files are rejected
+ */
+TEST_F(TopologyCacheTest, InvalidFile) {
+  uint64_t view_id = 0;
+  EXPECT_THROW(load_topology_cache(tmp_dir_.file("missing.json"), "cluster", view_id),
+               std::runtime_error);
+
+  const std::string path = tmp_dir_.file("topology.json");
+  {
+    std::ofstream out(path);
+    out << "{\"format_version\": 1, \"cluster_name\": \"cluster\"";
+  }
+  EXPECT_THROW(load_topology_cache(path, "cluster", view_id), std::runtime_error);
+
+  {
+    std::ofstream out(path);
+    out << "{\"format_version\": 1, \"cluster_name\": \"cluster\", \"view_id\": 1, "
+           "\"replicasets\": [{\"name\": \"default\"}]}";
+  }
+  EXPECT_THROW(load_topology_cache(path, "cluster", view_id), std::runtime_error);
+}
+
+/**
+ * @test verifies that the refresh lock has only one holder at a time and that
+ *       it is released on destruction
+ */
+TEST_F(TopologyCacheTest, Lock) {
+  const std::string path = tmp_dir_.file("topology.json.lock");
+  std::unique_ptr<TopologyCacheLock> first(new TopologyCacheLock(path));
+  TopologyCacheLock second(path);
+
+  ASSERT_TRUE(first->try_lock());
+  EXPECT_TRUE(first->is_locked());
+  EXPECT_TRUE(first->try_lock());
+  EXPECT_FALSE(second.try_lock());
+  EXPECT_FALSE(second.is_locked());
+
+  first.reset();
+  EXPECT_TRUE(second.try_lock());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
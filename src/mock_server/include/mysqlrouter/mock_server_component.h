@@ -25,9 +25,12 @@
 #ifndef MYSQLROUTER_MOCK_SERVER_COMPONENT_INCLUDED
 #define MYSQLROUTER_MOCK_SERVER_COMPONENT_INCLUDED
 
+#include <map>
 #include <memory>
+#include <mutex>
 
 #include "mysqlrouter/mock_server_export.h"
+#include "mysqlrouter/mock_server_faults.h"
 #include "mysqlrouter/mock_server_global_scope.h"
 
 namespace server_mock {
@@ -41,6 +44,10 @@ class MOCK_SERVER_EXPORT MockServerComponent {
 
   std::weak_ptr<server_mock::MySQLServerMock> srv_;
 
+  // all mock servers, by port
+  std::map<unsigned, std::weak_ptr<server_mock::MySQLServerMock>> srvs_;
+  std::mutex srvs_mtx_;
+
   MockServerComponent() = default;
 public:
   static MockServerComponent& getInstance();
@@ -49,6 +56,13 @@ public:
 
   std::shared_ptr<MockServerGlobalScope> getGlobalScope();
   void close_all_connections();
+
+  /**
+   * faults of the mock server on a port.
+   *
+   * @returns nullptr if no mock server listens on the port
+   */
+  std::shared_ptr<MockServerFaultInjector> get_fault_injector(unsigned port);
 };
 
 #endif
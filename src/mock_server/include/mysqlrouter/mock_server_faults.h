@@ -0,0 +1,171 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_MOCK_SERVER_FAULTS_INCLUDED
+#define MYSQLROUTER_MOCK_SERVER_FAULTS_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+
+#include "mysqlrouter/mock_server_global_scope.h"
+
+/**
+ * Faults a mock server injects, to benchmark how clients react to failing
+ * backends.
+ *
+ * The faults are active from start until end, which allows to schedule
+ * them. Probabilities are between 0 and 1.
+ */
+struct MockServerFaults {
+  using clock = std::chrono::steady_clock;
+
+  /** @brief probability that a new connection gets closed right away */
+  double refuse_probability{0};
+  /** @brief probability that the connection gets closed instead of answering a statement */
+  double drop_probability{0};
+  /** @brief probability that the response of a statement stalls */
+  double stall_probability{0};
+  /** @brief how long a stalled response is held back */
+  std::chrono::milliseconds stall_duration{0};
+  /** @brief bytes per second the responses get sent with, 0 for no limit */
+  uint64_t bandwidth{0};
+
+  clock::time_point start{};
+  clock::time_point end{clock::time_point::max()};
+
+  /** @brief seed of the random decisions, 0 for a random seed */
+  uint64_t seed{0};
+
+  /** @brief globals that get set once the faults start, like a changed group membership */
+  MockServerGlobalScope::type globals;
+
+  bool is_active(clock::time_point now) const {
+    return now >= start && now < end;
+  }
+};
+
+/**
+ * Faults of a mock server, shared by its sessions and its REST API.
+ *
+ * Sessions check the faults for each statement, which doesn't lock as long
+ * as no faults are set.
+ */
+class MockServerFaultInjector {
+public:
+  using clock = MockServerFaults::clock;
+  using snapshot_type = std::shared_ptr<const MockServerFaults>;
+
+  explicit MockServerFaultInjector(std::shared_ptr<MockServerGlobalScope> globals):
+    globals_{std::move(globals)} {}
+
+  /**
+   * faults as they got set, active or not.
+   */
+  snapshot_type get_config() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return faults_;
+  }
+
+  /**
+   * the active faults, nullptr if there are none.
+   *
+   * sets the globals of the faults once they started.
+   */
+  snapshot_type get_active() {
+    if (!enabled_.load(std::memory_order_acquire)) return {};
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!faults_) return {};
+
+    const auto now = clock::now();
+    if (!globals_applied_ && now >= faults_->start) {
+      for (const auto &global: faults_->globals) {
+        globals_->set(global.first, global.second);
+      }
+      globals_applied_ = true;
+    }
+    if (now >= faults_->end) {
+      // over, back to the fast path
+      enabled_.store(false, std::memory_order_release);
+      return {};
+    }
+
+    return faults_->is_active(now) ? faults_ : snapshot_type{};
+  }
+
+  void set(MockServerFaults faults) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    faults_ = std::make_shared<const MockServerFaults>(std::move(faults));
+    globals_applied_ = false;
+    sessions_ = 0;
+    rng_.seed(faults_->seed != 0 ? faults_->seed : std::random_device()());
+    enabled_.store(true, std::memory_order_release);
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    faults_.reset();
+    enabled_.store(false, std::memory_order_release);
+  }
+
+  /**
+   * true if a new connection shall be closed right away.
+   */
+  bool refuse_connection() {
+    snapshot_type faults = get_active();
+    if (!faults || faults->refuse_probability <= 0) return false;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    return std::uniform_real_distribution<double>()(rng_) < faults->refuse_probability;
+  }
+
+  /**
+   * seed for the random decisions of a new session.
+   *
+   * with a seed set, the n-th session after the faults got set always
+   * gets the same seed.
+   */
+  uint64_t session_seed() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (faults_ && faults_->seed != 0) return faults_->seed + ++sessions_;
+
+    return std::random_device()();
+  }
+
+private:
+  std::shared_ptr<MockServerGlobalScope> globals_;
+  snapshot_type faults_;
+  std::atomic<bool> enabled_{false};
+  bool globals_applied_{false};
+  uint64_t sessions_{0};
+  std::mt19937_64 rng_;
+  mutable std::mutex mtx_;
+};
+
+#endif
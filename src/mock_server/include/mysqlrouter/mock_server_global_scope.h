@@ -25,35 +25,74 @@
 #ifndef MYSQLROUTER_MOCK_SERVER_GLOBAL_SCOPE_INCLUDED
 #define MYSQLROUTER_MOCK_SERVER_GLOBAL_SCOPE_INCLUDED
 
-#include <string>
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 
+/**
+ * Globals shared by the sessions of the mock server and its REST API.
+ *
+ * Values are JSON texts. Writers replace the whole map (copy-on-write) and
+ * bump the version. Readers keep the snapshot they got and only need the
+ * lock again once the version changed.
+ */
 class MockServerGlobalScope {
 public:
   using key_type = std::string;
   using value_type = std::string;
   using type = std::map<key_type, value_type>;
+  using snapshot_type = std::shared_ptr<const type>;
 
-  type get_all() {
-    std::lock_guard<std::mutex> foo(global_mutex_);
+  /**
+   * version of the globals, changes with each update.
+   *
+   * doesn't lock.
+   */
+  uint64_t version() const {
+    return version_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * current globals.
+   *
+   * @param version set to the version of the returned globals if not null
+   */
+  snapshot_type get_snapshot(uint64_t *version = nullptr) const {
+    std::lock_guard<std::mutex> lock(global_mutex_);
+    if (version) *version = version_.load(std::memory_order_relaxed);
     return global_;
   }
 
+  type get_all() {
+    return *get_snapshot();
+  }
+
   void set(const key_type &key, const value_type &value) {
-    std::lock_guard<std::mutex> foo(global_mutex_);
+    std::lock_guard<std::mutex> lock(global_mutex_);
 
-    global_[key] = value;
+    std::shared_ptr<type> globals = std::make_shared<type>(*global_);
+    (*globals)[key] = value;
+    publish(std::move(globals));
   }
 
   void reset(type globals) {
-    std::lock_guard<std::mutex> foo(global_mutex_);
-    global_ = globals;
+    std::lock_guard<std::mutex> lock(global_mutex_);
+    publish(std::make_shared<type>(std::move(globals)));
   }
 
 private:
-  type global_;
-  std::mutex global_mutex_;
+  // called with the lock held
+  void publish(std::shared_ptr<type> globals) {
+    global_ = std::move(globals);
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
+  snapshot_type global_{std::make_shared<type>()};
+  std::atomic<uint64_t> version_{0};
+  mutable std::mutex global_mutex_;
 };
 
 #endif
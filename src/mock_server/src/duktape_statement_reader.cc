@@ -27,6 +27,7 @@
 #define NOMINMAX
 #endif
 
+#include <algorithm>
 #include <string>
 #include <map>
 #include <functional>
@@ -36,6 +37,8 @@
 #include "duk_module_shim.h"
 #include "duktape_statement_reader.h"
 #include "duk_node_fs.h"
+#include "file_cache.h"
+#include "row_generator.h"
 #include "mysql/harness/logging/logging.h"
 
 IMPORT_LOG_FUNCTIONS()
@@ -127,6 +130,36 @@ public:
 };
 
 
+/**
+ * snapshot of the shared globals, kept until they change.
+ *
+ * lets the sessions read mysqld.global without taking the lock of the
+ * globals each time.
+ */
+struct SharedGlobalsView {
+  explicit SharedGlobalsView(MockServerGlobalScope *the_globals):
+    globals{the_globals} {}
+
+  /**
+   * gets the current snapshot if the globals changed.
+   *
+   * @returns true if the snapshot got replaced
+   */
+  bool refresh() {
+    if (snapshot && globals->version() == version) return false;
+
+    snapshot = globals->get_snapshot(&version);
+    return true;
+  }
+
+  MockServerGlobalScope *globals;
+  MockServerGlobalScope::snapshot_type snapshot;
+  uint64_t version{0};
+};
+
+// key of the "generate.row" function in the global stash
+static const char kGenerateRowKey[] = "mysql_server_mock.generate_row";
+
 struct DuktapeStatementReader::Pimpl {
   std::string get_object_string_value(duk_idx_t idx,
       const std::string &field,
@@ -257,57 +290,176 @@ struct DuktapeStatementReader::Pimpl {
 
     // object|undefined
     if (duk_is_object(ctx, -1)) {
-      // no rows
-
-      duk_enum(ctx, -1, DUK_ENUM_ARRAY_INDICES_ONLY);
-      while (duk_next(ctx, -1, 1)) {
-        // @-2 row-ndx
-        // @-1 row
-        RowValueType row_values;
-
-        duk_enum(ctx, -1, DUK_ENUM_ARRAY_INDICES_ONLY);
-        while (duk_next(ctx, -1, 1)) {
-          if (duk_is_null(ctx, -1)) {
-            row_values.push_back(std::make_pair(false, ""));
-          } else {
-            row_values.push_back(std::make_pair(true, duk_to_string(ctx, -1)));
-          }
-          duk_pop(ctx); // field
-          duk_pop(ctx); // field-ndx
-        }
-        duk_pop(ctx); // field-enum
-        response->rows.push_back(row_values);
-
-        duk_pop(ctx); // row
-        duk_pop(ctx); // row-ndx
-      }
-      duk_pop(ctx); // rows-enum
+      get_rows(response->rows);
     } else if (!duk_is_undefined(ctx, -1)) {
       throw std::runtime_error("rows: expected array or undefined, get " + duk_get_type_names(ctx, -1));
     }
 
     duk_pop(ctx); // "rows"
+    duk_get_prop_string(ctx, idx, "generate");
+
+    // object|undefined
+    if (duk_is_object(ctx, -1)) {
+      get_generated_rows(*response);
+    } else if (!duk_is_undefined(ctx, -1)) {
+      throw std::runtime_error("generate: expected object or undefined, get " + duk_get_type_names(ctx, -1));
+    }
+
+    duk_pop(ctx); // "generate"
 
     // gcc-4.8 needs a std::move, other's don't
     return std::move(response);
   }
+
+  /** @brief reads the row array at the top of the stack */
+  void get_row(RowValueType &row_values) {
+    row_values.clear();
+
+    duk_enum(ctx, -1, DUK_ENUM_ARRAY_INDICES_ONLY);
+    while (duk_next(ctx, -1, 1)) {
+      if (duk_is_null(ctx, -1)) {
+        row_values.push_back(std::make_pair(false, ""));
+      } else {
+        row_values.push_back(std::make_pair(true, duk_to_string(ctx, -1)));
+      }
+      duk_pop(ctx); // field
+      duk_pop(ctx); // field-ndx
+    }
+    duk_pop(ctx); // field-enum
+  }
+
+  /** @brief reads the array of rows at the top of the stack */
+  void get_rows(std::vector<RowValueType> &rows) {
+    duk_enum(ctx, -1, DUK_ENUM_ARRAY_INDICES_ONLY);
+    while (duk_next(ctx, -1, 1)) {
+      // @-2 row-ndx
+      // @-1 row
+      RowValueType row_values;
+      get_row(row_values);
+      rows.push_back(row_values);
+
+      duk_pop(ctx); // row
+      duk_pop(ctx); // row-ndx
+    }
+    duk_pop(ctx); // rows-enum
+  }
+
+  /** @brief reads the "generate" object at the top of the stack
+   *
+   * The rows come from the "row" function called with the index of the
+   * row, the "template" rows or random values seeded with "random_seed".
+   */
+  void get_generated_rows(ResultsetResponse &response) {
+    response.generated_rows = get_object_integer_value<uint32_t>(-1, "rows", 0, true);
+
+    duk_get_prop_string(ctx, -1, "row");
+    if (duk_is_callable(ctx, -1)) {
+      // keep the function until the rows got sent, only one resultset is sent at a time
+      duk_push_global_stash(ctx);
+      duk_dup(ctx, -2);
+      duk_put_prop_string(ctx, -2, kGenerateRowKey);
+      duk_pop(ctx); // stash
+
+      const size_t columns_size = response.columns.size();
+      response.generate_row = [this, columns_size](size_t ndx, RowValueType &row) {
+        duk_push_global_stash(ctx);
+        duk_get_prop_string(ctx, -1, kGenerateRowKey);
+        duk_push_number(ctx, static_cast<duk_double_t>(ndx));
+        if (DUK_EXEC_SUCCESS != duk_pcall(ctx, 1)) {
+          DuktapeRuntimeError err(ctx, -1);
+          duk_pop(ctx); // stash
+          throw err;
+        }
+        if (!duk_is_array(ctx, -1)) {
+          const std::string type_names = duk_get_type_names(ctx, -1);
+          duk_pop_2(ctx); // row, stash
+          throw std::runtime_error("generate.row: expected array, got " + type_names);
+        }
+        get_row(row);
+        duk_pop_2(ctx); // row, stash
+
+        if (row.size() != columns_size) {
+          throw std::runtime_error("generate.row: number of row fields different than number of columns " +
+              std::to_string(row.size()) + " != " + std::to_string(columns_size));
+        }
+      };
+    } else if (!duk_is_undefined(ctx, -1)) {
+      throw std::runtime_error("generate.row: expected function or undefined, get " + duk_get_type_names(ctx, -1));
+    }
+    duk_pop(ctx); // "row"
+
+    if (response.generate_row) return;
+
+    duk_get_prop_string(ctx, -1, "template");
+    if (duk_is_array(ctx, -1)) {
+      std::vector<RowValueType> templates;
+      get_rows(templates);
+      response.generate_row = make_repeat_row_generator(std::move(templates));
+    } else if (!duk_is_undefined(ctx, -1)) {
+      throw std::runtime_error("generate.template: expected array or undefined, get " + duk_get_type_names(ctx, -1));
+    }
+    duk_pop(ctx); // "template"
+
+    if (response.generate_row) return;
+
+    response.generate_row = make_random_row_generator(response.columns,
+        get_object_integer_value<uint32_t>(-1, "random_seed", 0));
+  }
+
   duk_context *ctx {nullptr};
+  std::unique_ptr<SharedGlobalsView> shared_view;
 };
 
-duk_int_t duk_peval_file(duk_context *ctx, const char *path) {
+/*
+ * compiles a file to bytecode.
+ *
+ * throws DuktapeRuntimeError if the file can't be read or compiled
+ */
+static
+std::string duk_compile_file(duk_context *ctx, const std::string &path) {
   duk_push_c_function(ctx, duk_node_fs_read_file_sync, 1);
-  duk_push_string(ctx, path);
-  if (duk_int_t rc = duk_pcall(ctx, 1)) {
-    return rc;
+  duk_push_string(ctx, path.c_str());
+  if (DUK_EXEC_SUCCESS != duk_pcall(ctx, 1)) {
+    throw DuktapeRuntimeError(ctx, -1);
   }
 
   duk_buffer_to_string(ctx, -1);
-  duk_push_string(ctx, path);
-  if (duk_int_t rc = duk_pcompile(ctx, DUK_COMPILE_EVAL)) {
-    return rc;
+  duk_push_string(ctx, path.c_str());
+  if (DUK_EXEC_SUCCESS != duk_pcompile(ctx, DUK_COMPILE_EVAL)) {
+    throw DuktapeRuntimeError(ctx, -1);
   }
+
+  duk_dump_function(ctx);
+  duk_size_t bytecode_size;
+  const char *bytecode = static_cast<const char *>(duk_get_buffer(ctx, -1, &bytecode_size));
+  std::string dumped(bytecode, bytecode_size);
+  duk_pop(ctx); // bytecode
+
+  return dumped;
+}
+
+/*
+ * runs a file like eval() does, leaves the result on the stack.
+ *
+ * the file gets compiled once, all sessions load the cached bytecode
+ * into their heap.
+ */
+static
+void duk_eval_file(duk_context *ctx, const std::string &path) {
+  static FileCache<std::string> bytecode_cache;
+
+  auto bytecode = bytecode_cache.get(path, [ctx](const std::string &filename) {
+    return duk_compile_file(ctx, filename);
+  });
+
+  void *buf = duk_push_fixed_buffer(ctx, bytecode->size());
+  std::copy(bytecode->begin(), bytecode->end(), static_cast<char *>(buf));
+  duk_load_function(ctx);
+
   duk_push_global_object(ctx);
-  return duk_pcall_method(ctx, 0);
+  if (DUK_EXEC_SUCCESS != duk_pcall_method(ctx, 0)) {
+    throw DuktapeRuntimeError(ctx, -1);
+  }
 }
 
 static
@@ -316,20 +468,38 @@ duk_int_t process_get_shared(duk_context *ctx) {
 
   duk_push_global_stash(ctx);
   duk_get_prop_string(ctx, -1, "shared");
-  auto *shared_globals = static_cast<MockServerGlobalScope *>(duk_get_pointer(ctx, -1));
+  auto *shared_view = static_cast<SharedGlobalsView *>(duk_get_pointer(ctx, -1));
+  duk_pop(ctx); // 'shared' pointer
 
-  auto v = shared_globals->get_all();
+  // the decoded values are only valid for their snapshot
+  if (shared_view->refresh()) {
+    duk_push_object(ctx);
+    duk_put_prop_string(ctx, -2, "shared_values");
+  }
+  duk_get_prop_string(ctx, -1, "shared_values");
 
-  auto it = v.find(key);
-  if (it == v.end()) {
-    duk_push_undefined(ctx);
-  } else {
-    auto value = (*it).second;
-    duk_push_lstring(ctx, value.c_str(), value.size());
-    duk_json_decode(ctx, -1);
+  if (!duk_get_prop_string(ctx, -1, key)) {
+    duk_pop(ctx); // undefined
+
+    const auto &v = *shared_view->snapshot;
+    auto it = v.find(key);
+    if (it == v.end()) {
+      duk_push_undefined(ctx);
+    } else {
+      auto &value = (*it).second;
+      duk_push_lstring(ctx, value.c_str(), value.size());
+      duk_json_decode(ctx, -1);
+
+      // objects and arrays get decoded on each access to not share changes
+      // to them between the accesses
+      if (!duk_is_object(ctx, -1)) {
+        duk_dup(ctx, -1);
+        duk_put_prop_string(ctx, -3, key);
+      }
+    }
   }
 
-  duk_remove(ctx, -2); // 'shared' pointer
+  duk_remove(ctx, -2); // decoded values
   duk_remove(ctx, -2); // global stash
 
   return 1;
@@ -342,14 +512,14 @@ duk_int_t process_set_shared(duk_context *ctx) {
 
   duk_push_global_stash(ctx);
   duk_get_prop_string(ctx, -1, "shared");
-  auto *shared_globals = static_cast<MockServerGlobalScope *>(duk_get_pointer(ctx, -1));
+  auto *shared_view = static_cast<SharedGlobalsView *>(duk_get_pointer(ctx, -1));
 
-  if (nullptr == shared_globals) {
+  if (nullptr == shared_view) {
     return duk_generic_error(ctx, "shared is null");
   }
 
   duk_dup(ctx, 1);
-  shared_globals->set(key, duk_json_encode(ctx, -1));
+  shared_view->globals->set(key, duk_json_encode(ctx, -1));
 
   duk_pop(ctx); // the dup
   duk_pop(ctx); // 'shared' pointer
@@ -408,7 +578,8 @@ DuktapeStatementReader::DuktapeStatementReader(
     throw std::logic_error("expected shared global variable object to be set, but it isn't.");
   }
 
-  duk_push_pointer(ctx, shared_.get());
+  pimpl_->shared_view.reset(new SharedGlobalsView(shared_.get()));
+  duk_push_pointer(ctx, pimpl_->shared_view.get());
   duk_put_prop_string(ctx, -2, "shared");
   duk_pop(ctx); // stash
 
@@ -461,9 +632,7 @@ DuktapeStatementReader::DuktapeStatementReader(
 
   duk_put_prop_string(ctx, -2, "mysqld");
 
-  if (DUK_EXEC_SUCCESS != duk_peval_file(ctx, filename.c_str())) {
-    throw DuktapeRuntimeError(ctx, -1);
-  }
+  duk_eval_file(ctx, filename);
 
   if (!duk_is_object(ctx, -1)) {
     throw std::runtime_error(filename + ": expected statement handler to return an object, got " + duk_get_type_names(ctx, -1));
@@ -0,0 +1,52 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "file_cache.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace server_mock {
+
+bool get_file_stamp(const std::string &filename, FileStamp &stamp) {
+#ifndef _WIN32
+  struct stat status;
+  if (stat(filename.c_str(), &status) != 0) return false;
+#ifdef __APPLE__
+  const int64_t mtime_nsec = status.st_mtimespec.tv_nsec;
+#else
+  const int64_t mtime_nsec = status.st_mtim.tv_nsec;
+#endif
+  stamp = FileStamp{status.st_mtime, mtime_nsec, static_cast<uint64_t>(status.st_size)};
+#else
+  struct _stat64 status;
+  if (_stat64(filename.c_str(), &status) != 0) return false;
+  stamp = FileStamp{status.st_mtime, 0, static_cast<uint64_t>(status.st_size)};
+#endif
+
+  return true;
+}
+
+} // namespace server_mock
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLD_MOCK_FILE_CACHE_INCLUDED
+#define MYSQLD_MOCK_FILE_CACHE_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace server_mock {
+
+/** @brief tells versions of a file apart */
+struct FileStamp {
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t size;
+
+  bool operator==(const FileStamp &other) const {
+    return mtime_sec == other.mtime_sec && mtime_nsec == other.mtime_nsec && size == other.size;
+  }
+};
+
+/** @brief gets the stamp of a file
+ *
+ * @returns false if the file can't be stat()ed
+ */
+bool get_file_stamp(const std::string &filename, FileStamp &stamp);
+
+/** @class FileCache
+ *
+ * @brief Keeps what got loaded from a file until the file changes.
+ *
+ * Lets all sessions share the parsed statement files instead of each
+ * session parsing them again. Loaded objects are shared read-only.
+ **/
+template <class T>
+class FileCache {
+ public:
+  using Loader = std::function<T(const std::string &filename)>;
+
+  /** @brief returns what got loaded from the file, loads it if it
+   *         isn't cached or changed since
+   *
+   * Files that can't be stat()ed are loaded without being cached, to let
+   * the loader report the error.
+   *
+   * @throws what the loader throws
+   */
+  std::shared_ptr<const T> get(const std::string &filename, const Loader &loader) {
+    FileStamp stamp;
+    if (!get_file_stamp(filename, stamp)) {
+      return std::make_shared<const T>(loader(filename));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      auto it = entries_.find(filename);
+      if (it != entries_.end() && it->second.stamp == stamp) {
+        return it->second.value;
+      }
+    }
+
+    // load without the lock, concurrent loads of a changed file are fine
+    std::shared_ptr<const T> value = std::make_shared<const T>(loader(filename));
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    entries_[filename] = Entry{stamp, value};
+
+    return value;
+  }
+
+ private:
+  struct Entry {
+    FileStamp stamp;
+    std::shared_ptr<const T> value;
+  };
+
+  std::mutex mtx_;
+  std::map<std::string, Entry> entries_;
+};
+
+} // namespace server_mock
+
+#endif // MYSQLD_MOCK_FILE_CACHE_INCLUDED
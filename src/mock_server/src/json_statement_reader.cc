@@ -39,8 +39,12 @@
 #include <cerrno>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "file_cache.h"
 #include "mysql_server_mock_schema.h"
+#include "row_generator.h"
 
 #ifdef _WIN32
 #  include <regex>
@@ -129,14 +133,76 @@ INT_TYPE get_json_integer_field(const JsonValue& parent,
 
 namespace server_mock {
 
+/** @class StatementPattern
+ *
+ * @brief A "stmt.regex" compiled once when the file gets loaded.
+ *
+ * Matching doesn't change the compiled pattern, sessions share it.
+ **/
+class StatementPattern {
+ public:
+  explicit StatementPattern(const std::string &pattern): pattern_(pattern) {
+#ifndef _WIN32
+    compiled_ = (0 == regcomp(&regex_, pattern.c_str(), REG_EXTENDED | REG_NOSUB));
+#else
+    try {
+      regex_ = std::regex(pattern);
+      compiled_ = true;
+    } catch (const std::regex_error &) {
+      compiled_ = false;
+    }
+#endif
+  }
+
+  StatementPattern(const StatementPattern &) = delete;
+  StatementPattern &operator=(const StatementPattern &) = delete;
+
+  ~StatementPattern() {
+#ifndef _WIN32
+    if (compiled_) regfree(&regex_);
+#endif
+  }
+
+  // throws std::runtime_error if the pattern didn't compile, when the
+  // statement gets replayed like before
+  bool matches(const std::string &s) const {
+    if (!compiled_) {
+      throw std::runtime_error("Error compiling regex pattern: " + pattern_);
+    }
+#ifndef _WIN32
+    return 0 == regexec(&regex_, s.c_str(), 0, NULL, 0);
+#else
+    return std::regex_match(s, regex_);
+#endif
+  }
+
+ private:
+  std::string pattern_;
+  bool compiled_{false};
+#ifndef _WIN32
+  regex_t regex_;
+#else
+  std::regex regex_;
+#endif
+};
+
+/** @brief a statements file as all sessions share it */
+struct QueriesFile {
+  JsonDocument json_document;
+  // by statement, nullptr for the statements that match exactly
+  std::vector<std::unique_ptr<StatementPattern>> patterns;
+};
+
 struct QueriesJsonReader::Pimpl {
 
-  JsonDocument json_document_;
+  // parsed, validated and compiled once per file, shared by all sessions
+  std::shared_ptr<const QueriesFile> queries_;
   size_t current_stmt_{0u};
 
-  // load queries JSON; throws std::runtime_error on invalid JSON file
-  Pimpl(const std::string& json_filename): json_document_(load_json_from_file(json_filename)) {}
+  // throws std::runtime_error on invalid JSON file
+  Pimpl(const std::string& json_filename): queries_(load_queries(json_filename)) {}
 
+  static std::shared_ptr<const QueriesFile> load_queries(const std::string& filename);
   static JsonDocument load_json_from_file(const std::string& filename);
   static void validate_json_against_schema(const JsonSchemaDocument& schema, const JsonDocument& json);
 
@@ -146,33 +212,51 @@ struct QueriesJsonReader::Pimpl {
 };
 
 QueriesJsonReader::QueriesJsonReader(const std::string &json_filename):
-              pimpl_(new Pimpl(json_filename)) {
-
-  // construct schema JSON; throws std::runtime_error on invalid JSON, but note
-  // that invalid schema will slip by without throwing (but it will cause
-  // validate_json_against_schema() to fail later on)
-  JsonDocument schema_json;
-  if(schema_json.Parse<rapidjson::kParseCommentsFlag>(kSqlQueryJsonSchema).HasParseError())
-    throw std::runtime_error("Parsing JSON schema failed at offset "
-                             + std::to_string(schema_json.GetErrorOffset()) + ": "
-                             + rapidjson::GetParseError_En(schema_json.GetParseError()));
-  JsonSchemaDocument schema(schema_json);
-
-  // validate JSON against schema; throws std::runtime if validation fails
-  try {
-    pimpl_->validate_json_against_schema(schema, pimpl_->json_document_);
-  } catch (const std::runtime_error& e) {
-    // TODO: we could also get here if schema itself is not valid. To diagnose that,
-    //       another validate_json_against_schema() could be ran here to validate our
-    //       schema against schema spec (http://json-schema.org/draft-04/schema#)
-
-    throw std::runtime_error("JSON file '" + json_filename +
-                             "' failed validation against JSON schema:\n" + e.what());
-  }
+              pimpl_(new Pimpl(json_filename)) {}
+
+/*static*/ std::shared_ptr<const QueriesFile>
+QueriesJsonReader::Pimpl::load_queries(const std::string& filename) {
+  static FileCache<QueriesFile> cache;
+
+  return cache.get(filename, [](const std::string& json_filename) {
+    QueriesFile queries;
+    JsonDocument& json_document = queries.json_document;
+    json_document = load_json_from_file(json_filename);
+
+    // construct schema JSON; throws std::runtime_error on invalid JSON, but note
+    // that invalid schema will slip by without throwing (but it will cause
+    // validate_json_against_schema() to fail later on)
+    JsonDocument schema_json;
+    if(schema_json.Parse<rapidjson::kParseCommentsFlag>(kSqlQueryJsonSchema).HasParseError())
+      throw std::runtime_error("Parsing JSON schema failed at offset "
+                               + std::to_string(schema_json.GetErrorOffset()) + ": "
+                               + rapidjson::GetParseError_En(schema_json.GetParseError()));
+    JsonSchemaDocument schema(schema_json);
+
+    // validate JSON against schema; throws std::runtime if validation fails
+    try {
+      validate_json_against_schema(schema, json_document);
+    } catch (const std::runtime_error& e) {
+      // TODO: we could also get here if schema itself is not valid. To diagnose that,
+      //       another validate_json_against_schema() could be ran here to validate our
+      //       schema against schema spec (http://json-schema.org/draft-04/schema#)
+
+      throw std::runtime_error("JSON file '" + json_filename +
+                               "' failed validation against JSON schema:\n" + e.what());
+    }
+
+    // schema should have caught these
+    harness_assert(json_document.HasMember("stmts"));
+    harness_assert(json_document["stmts"].IsArray());
+
+    for (const auto& stmt : json_document["stmts"].GetArray()) {
+      queries.patterns.emplace_back(stmt.HasMember("stmt.regex")
+          ? new StatementPattern(stmt["stmt.regex"].GetString())
+          : nullptr);
+    }
 
-  // schema should have caught these
-  harness_assert(pimpl_->json_document_.HasMember("stmts"));
-  harness_assert(pimpl_->json_document_["stmts"].IsArray());
+    return queries;
+  });
 }
 
 // this is needed for pimpl, otherwise compiler complains
@@ -236,34 +320,15 @@ void QueriesJsonReader::Pimpl::validate_json_against_schema(const JsonSchemaDocu
   }
 }
 
-namespace {
-
-bool pattern_matching(const std::string &s,
-                      const std::string &pattern) {
-#ifndef _WIN32
-  regex_t regex;
-  auto r = regcomp(&regex, pattern.c_str(), REG_EXTENDED);
-  if (r) {
-    throw std::runtime_error("Error compiling regex pattern: " + pattern);
-  }
-  r = regexec(&regex, s.c_str(), 0, NULL, 0);
-  regfree(&regex);
-  return (r == 0);
-#else
-  std::regex regex(pattern);
-  return std::regex_match(s, regex);
-#endif
-}
-
-} // unnamed namespace
 
 
 StatementAndResponse QueriesJsonReader::handle_statement(const std::string &statement_received) {
   StatementAndResponse response;
 
-  const JsonValue& stmts = pimpl_->json_document_["stmts"];
+  const JsonValue& stmts = pimpl_->queries_->json_document["stmts"];
   if (pimpl_->current_stmt_ >= stmts.Size()) return response;
 
+  const StatementPattern *pattern = pimpl_->queries_->patterns[pimpl_->current_stmt_].get();
   auto& stmt = stmts[pimpl_->current_stmt_++];
   harness_assert(stmt.HasMember("stmt") || stmt.HasMember("stmt.regex"));  // schema should have caught this
 
@@ -275,30 +340,27 @@ StatementAndResponse QueriesJsonReader::handle_statement(const std::string &stat
     response.exec_time = get_default_exec_time();
   }
 
-  bool statement_is_regex = false;
-  std::string name{"stmt"};
-  if (stmt.HasMember("stmt.regex")) {
-    name = "stmt.regex";
-    statement_is_regex = true;
-  }
+  const char *name = (pattern == nullptr) ? "stmt" : "stmt.regex";
 
-  harness_assert(stmt[name.c_str()].IsString());  // schema should have caught this
+  harness_assert(stmt[name].IsString());  // schema should have caught this
 
-  std::string statement = stmt[name.c_str()].GetString();
+  const JsonValue& statement = stmt[name];
 
   bool statement_matching{false};
-  if (!statement_is_regex) { // not regex
-    statement_matching = (statement_received == statement);
+  if (pattern == nullptr) { // not regex
+    statement_matching = (statement_received.size() == statement.GetStringLength() &&
+                          0 == statement_received.compare(0, std::string::npos,
+                                                          statement.GetString(),
+                                                          statement.GetStringLength()));
   } else { // regex
-    statement_matching = pattern_matching(statement_received,
-                                          statement);
+    statement_matching = pattern->matches(statement_received);
   }
 
   if (!statement_matching) {
     response.response_type = StatementAndResponse::StatementResponseType::STMT_RES_ERROR;
     response.response.reset(new ErrorResponse(MYSQL_PARSE_ERROR,
         std::string("Unexpected stmt, got: \"") + statement_received +
-        "\"; expected: \"" + statement + "\""));
+        "\"; expected: \"" + statement.GetString() + "\""));
   } else if (stmt.HasMember("ok")) {
     response.response_type = StatementAndResponse::StatementResponseType::STMT_RES_OK;
     response.response = pimpl_->read_ok_info(stmt);
@@ -317,8 +379,9 @@ StatementAndResponse QueriesJsonReader::handle_statement(const std::string &stat
 
 std::chrono::microseconds QueriesJsonReader::get_default_exec_time() {
 
-  if (pimpl_->json_document_.HasMember("defaults")) {
-    auto& defaults = pimpl_->json_document_["defaults"];
+  const JsonDocument& json_document = pimpl_->queries_->json_document;
+  if (json_document.HasMember("defaults")) {
+    auto& defaults = json_document["defaults"];
     if (defaults.HasMember("exec_time")) {
       double exec_time = get_json_double_field(defaults, "exec_time", 0.0);
       return std::chrono::microseconds(static_cast<long>(exec_time * 1000));
@@ -361,9 +424,7 @@ std::unique_ptr<Response> QueriesJsonReader::Pimpl::read_result_info(const JsonV
     }
   }
 
-  // read rows
-  if (result.HasMember("rows")) {
-    const auto& rows = result["rows"];
+  auto read_rows = [&response](const JsonValue &rows, std::vector<RowValueType> &out) {
     harness_assert(rows.IsArray());  // schema should have caught this
 
     auto columns_size = response->columns.size();
@@ -390,7 +451,29 @@ std::unique_ptr<Response> QueriesJsonReader::Pimpl::read_result_info(const JsonV
         }
       }
 
-      response->rows.push_back(row_values);
+      out.push_back(row_values);
+    }
+  };
+
+  // read rows
+  if (result.HasMember("rows")) {
+    read_rows(result["rows"], response->rows);
+  }
+
+  // rows generated while they get sent
+  if (result.HasMember("generate")) {
+    const auto& generate = result["generate"];
+    harness_assert(generate["rows"].IsUint64());  // schema should have caught this
+
+    response->generated_rows = static_cast<size_t>(generate["rows"].GetUint64());
+    if (generate.HasMember("template")) {
+      std::vector<RowValueType> templates;
+      read_rows(generate["template"], templates);
+      response->generate_row = make_repeat_row_generator(std::move(templates));
+    } else {
+      const uint64_t seed = generate.HasMember("random_seed")
+          ? generate["random_seed"].GetUint64() : 0;
+      response->generate_row = make_random_row_generator(response->columns, seed);
     }
   }
 
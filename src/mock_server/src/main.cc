@@ -54,6 +54,10 @@ struct MysqlServerMockConfig {
   std::string module_prefix;
   unsigned port { 3306 };
   unsigned http_port { 0 };
+  unsigned worker_threads { 4 };
+  std::string io_mode { "blocking" };
+  std::string replay_time_scale { "1" };
+  std::string protocol { "classic" };
   bool verbose { false };
 };
 
@@ -175,6 +179,10 @@ public:
     mock_server_config.set("port", std::to_string(config_.port));
     mock_server_config.set("filename", config_.queries_filename);
     mock_server_config.set("module_prefix", config_.module_prefix);
+    mock_server_config.set("worker_threads", std::to_string(config_.worker_threads));
+    mock_server_config.set("io_mode", config_.io_mode);
+    mock_server_config.set("replay_time_scale", config_.replay_time_scale);
+    mock_server_config.set("protocol", config_.protocol);
 
     try {
       loader_.reset(new mysql_harness::Loader("server-mock", loader_config));
@@ -222,6 +230,30 @@ private:
         [this](const std::string &module_prefix) {
           config_.module_prefix = module_prefix;
        });
+    arg_handler_.add_option(
+        CmdOption::OptionNames({"--worker-threads"}), "threads handling the classic protocol connections (default 4).",
+        CmdOptionValueReq::required, "int",
+        [this](const std::string &worker_threads) {
+          config_.worker_threads = static_cast<unsigned>(std::stoul(worker_threads));
+       });
+    arg_handler_.add_option(
+        CmdOption::OptionNames({"--io-mode"}), "'blocking' runs one connection per thread at a time, 'event' many connections per thread (default blocking).",
+        CmdOptionValueReq::required, "blocking|event",
+        [this](const std::string &io_mode) {
+          config_.io_mode = io_mode;
+       });
+    arg_handler_.add_option(
+        CmdOption::OptionNames({"--replay-time-scale"}), "factor for the latencies of a replayed workload, 0.5 replays twice as fast (default 1).",
+        CmdOptionValueReq::required, "factor",
+        [this](const std::string &replay_time_scale) {
+          config_.replay_time_scale = replay_time_scale;
+       });
+    arg_handler_.add_option(
+        CmdOption::OptionNames({"--protocol"}), "protocol the clients speak, 'classic' or 'x' (default classic).",
+        CmdOptionValueReq::required, "classic|x",
+        [this](const std::string &protocol) {
+          config_.protocol = protocol;
+       });
     arg_handler_.add_option(
         CmdOption::OptionNames({"--verbose"}), "verbose",
         CmdOptionValueReq::none, "",
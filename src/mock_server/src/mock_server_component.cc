@@ -40,6 +40,9 @@ std::shared_ptr<MockServerGlobalScope> MockServerComponent::getGlobalScope()
 
 void MockServerComponent::init(std::shared_ptr<server_mock::MySQLServerMock> srv) {
   srv_ = srv;
+
+  std::lock_guard<std::mutex> lock(srvs_mtx_);
+  srvs_[srv->bind_port()] = srv;
 }
 
 
@@ -55,3 +58,15 @@ void MockServerComponent::close_all_connections() {
     srv->close_all_connections();
   }
 }
+
+std::shared_ptr<MockServerFaultInjector> MockServerComponent::get_fault_injector(unsigned port) {
+  std::lock_guard<std::mutex> lock(srvs_mtx_);
+
+  auto it = srvs_.find(port);
+  if (it == srvs_.end()) return {};
+
+  if (auto srv = it->second.lock()) {
+    return srv->get_fault_injector();
+  }
+  return {};
+}
@@ -35,6 +35,8 @@
 #include "mysql_server_mock.h"
 #include "mysqlrouter/plugin_config.h"
 
+#include <sstream>
+
 IMPORT_LOG_FUNCTIONS()
 
 #ifndef PATH_MAX
@@ -53,13 +55,21 @@ public:
   std::string module_prefix;
   std::string srv_address;
   uint16_t srv_port;
+  unsigned worker_threads;
+  server_mock::MySQLServerMock::IoMode io_mode;
+  double replay_time_scale;
+  server_mock::MySQLServerMock::Protocol protocol;
 
   explicit PluginConfig(const mysql_harness::ConfigSection *section):
     mysqlrouter::BasePluginConfig(section),
     trace_filename(get_option_string(section, "filename")),
     module_prefix(get_option_string(section, "module_prefix")),
     srv_address(get_option_string(section, "bind_address")),
-    srv_port(get_uint_option<uint16_t>(section, "port"))
+    srv_port(get_uint_option<uint16_t>(section, "port")),
+    worker_threads(get_uint_option<unsigned>(section, "worker_threads", 1)),
+    io_mode(server_mock::MySQLServerMock::io_mode_from_string(get_option_string(section, "io_mode"))),
+    replay_time_scale(get_double_option(section, "replay_time_scale")),
+    protocol(server_mock::MySQLServerMock::protocol_from_string(get_option_string(section, "protocol")))
   {}
 
   std::string get_default(const std::string &option) const override {
@@ -73,6 +83,10 @@ public:
         {"bind_address", "0.0.0.0"},
         {"module_prefix", cwd},
         {"port", "3306"},
+        {"worker_threads", "4"},
+        {"io_mode", "blocking"},
+        {"replay_time_scale", "1"},
+        {"protocol", "classic"},
     };
 
     auto it = defaults.find(option);
@@ -82,6 +96,16 @@ public:
     return it->second;
   }
 
+  double get_double_option(const mysql_harness::ConfigSection *section, const std::string &option) {
+    const std::string value = get_option_string(section, option);
+    std::istringstream ss(value);
+    double result;
+    if (!(ss >> result) || !ss.eof() || result < 0) {
+      throw std::invalid_argument(get_log_prefix(option, section) + " needs a non-negative number, got '" + value + "'");
+    }
+    return result;
+  }
+
   bool is_required(const std::string &option) const override {
     if (option == "filename") return true;
     return false;
@@ -114,7 +138,11 @@ static void init(mysql_harness::PluginFuncEnv* env) {
                 config.trace_filename,
                 config.module_prefix,
                 config.srv_port,
-                0)));
+                0,
+                config.worker_threads,
+                config.io_mode,
+                config.replay_time_scale,
+                config.protocol)));
 
         MockServerComponent::getInstance().init(mock_servers.at(section->name));
       }
@@ -270,6 +270,15 @@ MySQLProtocolEncoder::encode_row_message(uint8_t seq_no,
                                          const std::vector<column_info_type> &columns_info,
                                          const RowValueType &row_values) {
   MsgBuffer out_buffer;
+  append_row_message(out_buffer, seq_no, columns_info, row_values);
+  return out_buffer;
+}
+
+void MySQLProtocolEncoder::append_row_message(MsgBuffer &out_buffer,
+                                              uint8_t seq_no,
+                                              const std::vector<column_info_type> &columns_info,
+                                              const RowValueType &row_values) {
+  const size_t msg_start = out_buffer.size();
   encode_msg_begin(out_buffer);
 
   if (columns_info.size() != row_values.size()) {
@@ -286,8 +295,7 @@ MySQLProtocolEncoder::encode_row_message(uint8_t seq_no,
     }
   }
 
-  encode_msg_end(out_buffer, seq_no);
-  return out_buffer;
+  encode_msg_end(out_buffer, seq_no, msg_start);
 }
 
 MySQLProtocolEncoder::MsgBuffer
@@ -309,18 +317,19 @@ void MySQLProtocolEncoder::encode_msg_begin(MsgBuffer &out_buffer) {
   append_int(out_buffer, static_cast<uint32_t>(0x0));
 }
 
-void MySQLProtocolEncoder::encode_msg_end(MsgBuffer &out_buffer, uint8_t seq_no) {
-  assert(out_buffer.size() >= 4);
+void MySQLProtocolEncoder::encode_msg_end(MsgBuffer &out_buffer, uint8_t seq_no, size_t msg_start) {
+  assert(out_buffer.size() >= msg_start + 4);
   // fill the header
-  uint32_t msg_len = static_cast<uint32_t>(out_buffer.size()) - 4;
-  if (msg_len > 0xffffff) {
-    throw std::runtime_error("Invalid message length: " + std::to_string(msg_len));
+  const size_t payload_len = out_buffer.size() - msg_start - 4;
+  if (payload_len > 0xffffff) {
+    throw std::runtime_error("Invalid message length: " + std::to_string(payload_len));
   }
+  uint32_t msg_len = static_cast<uint32_t>(payload_len);
   uint32_t header = msg_len | static_cast<uint32_t>(seq_no << 24);
 
   auto len = sizeof(header);
   for (size_t i = 0; len > 0; ++i, --len) {
-    out_buffer[i] = static_cast<byte>(header);
+    out_buffer[msg_start + i] = static_cast<byte>(header);
     header = static_cast<decltype(header)>(header >> 8);
   }
 }
@@ -147,6 +147,22 @@ public:
                                 const std::vector<column_info_type> &columns_info,
                                 const RowValueType &row_values);
 
+  /** @brief Encodes message containing single row in the resultset at the
+   *         end of a buffer.
+   *
+   * Lets many rows get encoded into a buffer that gets reused, instead of
+   * a buffer per row.
+   *
+   * @param out_buffer    buffer the message gets appended to
+   * @param seq_no        protocol packet sequence number to use
+   * @param columns_info  vector with column metadata for consecutive row fields
+   * @param row_values    vector with values (as string) for the consecutive row fields
+   **/
+  void append_row_message(MsgBuffer &out_buffer,
+                          uint8_t seq_no,
+                          const std::vector<column_info_type> &columns_info,
+                          const RowValueType &row_values);
+
   /** @brief Encodes EOF message used to mark the end of columns metadata and rows
    *         when sending the resultset to the client.
    *
@@ -162,7 +178,7 @@ public:
 
  protected:
   void encode_msg_begin(MsgBuffer &out_buffer);
-  void encode_msg_end(MsgBuffer &out_buffer, uint8_t seq_no);
+  void encode_msg_end(MsgBuffer &out_buffer, uint8_t seq_no, size_t msg_start = 0);
   void append_byte(MsgBuffer& buffer, byte value);
 
   template<class T, typename = std::enable_if<std::is_integral<T>::value>>
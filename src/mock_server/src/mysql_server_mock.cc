@@ -26,10 +26,13 @@
 #include "mysql_protocol_utils.h"
 #include "json_statement_reader.h"
 #include "duktape_statement_reader.h"
+#include "replay_statement_reader.h"
+#include "x_protocol_session.h"
 
 #include "mysql/harness/logging/logging.h"
 IMPORT_LOG_FUNCTIONS()
 
+#include <algorithm>
 #include <cstring>
 #include <functional>
 #include <iostream>
@@ -38,8 +41,12 @@ IMPORT_LOG_FUNCTIONS()
 #include <condition_variable>
 #include <system_error>
 #include <deque>
+#include <map>
 #include <queue>
 #include <set>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
 
 #ifndef _WIN32
 #  include <netdb.h>
@@ -51,6 +58,7 @@ IMPORT_LOG_FUNCTIONS()
 #  include <sys/socket.h>
 #  include <sys/types.h>
 #  include <netinet/tcp.h>
+#  include <poll.h>
 #  include <unistd.h>
 #else
 #  define WIN32_LEAN_AND_MEAN
@@ -61,8 +69,17 @@ IMPORT_LOG_FUNCTIONS()
 
 #ifdef _WIN32
 constexpr socket_t kInvalidSocket = INVALID_SOCKET;
+using pollfd_t = WSAPOLLFD;
 #else
 constexpr socket_t kInvalidSocket = -1;
+using pollfd_t = struct pollfd;
+#endif
+
+#ifdef MSG_NOSIGNAL
+// a client that went away mustn't take down the other sessions of the event loop
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
 #endif
 
 
@@ -73,16 +90,76 @@ namespace server_mock {
 constexpr char kAuthCachingSha2Password[] = "caching_sha2_password";
 constexpr char kAuthNativePassword[] = "mysql_native_password";
 constexpr size_t kReadBufSize = 16 * 1024;  // size big enough to contain any packet we're likely to read
+constexpr size_t kRowBatchSize = 16 * 1024;  // generated rows get sent in batches of about this size
+constexpr size_t kMaxAcceptsPerWakeup = 256;  // connections an event loop accepts before it serves its sessions
+
+constexpr mysql_protocol::Capabilities::Flags kOurCapabilities = mysql_protocol::Capabilities::PROTOCOL_41
+                                                              | mysql_protocol::Capabilities::PLUGIN_AUTH
+                                                              | mysql_protocol::Capabilities::SECURE_CONNECTION;
+
+void non_blocking(socket_t handle_, bool mode);
+
+static bool would_block(int err) {
+#ifdef _WIN32
+  return err == WSAEWOULDBLOCK;
+#else
+  return err == EAGAIN || err == EWOULDBLOCK;
+#endif
+}
+
+static int poll_sockets(pollfd_t *fds, size_t nfds, std::chrono::microseconds timeout) {
+#if defined(__linux__)
+  // ppoll() doesn't round the timeout up to milliseconds
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+  ts.tv_nsec = static_cast<long>((timeout.count() % 1000000) * 1000);
+  return ::ppoll(fds, static_cast<nfds_t>(nfds), &ts, nullptr);
+#else
+  const int timeout_ms = static_cast<int>((timeout.count() + 999) / 1000);
+# ifdef _WIN32
+  return ::WSAPoll(fds, static_cast<ULONG>(nfds), timeout_ms);
+# else
+  return ::poll(fds, static_cast<nfds_t>(nfds), timeout_ms);
+# endif
+#endif
+}
+
+MySQLServerMock::IoMode MySQLServerMock::io_mode_from_string(const std::string &name) {
+  if (name == "blocking") return IoMode::kBlocking;
+  if (name == "event") return IoMode::kEvent;
+
+  throw std::invalid_argument("io-mode must be 'blocking' or 'event', got '" + name + "'");
+}
+
+MySQLServerMock::Protocol MySQLServerMock::protocol_from_string(const std::string &name) {
+  if (name == "classic") return Protocol::kClassic;
+  if (name == "x") return Protocol::kX;
+
+  throw std::invalid_argument("protocol must be 'classic' or 'x', got '" + name + "'");
+}
 
 MySQLServerMock::MySQLServerMock(
     const std::string &expected_queries_file,
     const std::string &module_prefix,
-    unsigned bind_port, bool debug_mode):
+    unsigned bind_port, bool debug_mode,
+    size_t worker_threads, IoMode io_mode,
+    double replay_time_scale, Protocol protocol):
   bind_port_{bind_port},
   debug_mode_{debug_mode},
+  worker_threads_{worker_threads},
+  io_mode_{io_mode},
+  replay_time_scale_{replay_time_scale},
+  protocol_{protocol},
   expected_queries_file_{expected_queries_file},
   module_prefix_{module_prefix}
   {
+  if (worker_threads_ == 0) {
+    throw std::invalid_argument("worker-threads must be greater than 0");
+  }
+  if (!(replay_time_scale_ >= 0)) {
+    throw std::invalid_argument("replay-time-scale must not be negative");
+  }
+
   if (debug_mode_)
     std::cout << "\n\nExpected SQL queries come from file '"
               << expected_queries_file << "'\n\n" << std::flush;
@@ -92,11 +169,27 @@ MySQLServerMock::~MySQLServerMock() {
   if (listener_ > 0) {
     close_socket(listener_);
   }
+  for (auto listener : loop_listeners_) {
+    close_socket(listener);
+  }
 }
 
 // close all active connections
 void MySQLServerMock::close_all_connections() {
   std::lock_guard<std::mutex> active_fd_lock(active_fds_mutex_);
+  if (io_mode_ == IoMode::kEvent) {
+    // the event loops close the sockets once they see them shut down.
+    // Closing them here could let a new connection reuse a handle that
+    // is still polled for the old session.
+    for (auto fd : active_fds_) {
+#ifdef _WIN32
+      shutdown(fd, SD_BOTH);
+#else
+      shutdown(fd, SHUT_RDWR);
+#endif
+    }
+    return;
+  }
   for (auto it = active_fds_.begin(); it != active_fds_.end(); ) {
     close_socket(*it);
     it = active_fds_.erase(it);
@@ -105,10 +198,50 @@ void MySQLServerMock::close_all_connections() {
 
 void MySQLServerMock::run(mysql_harness::PluginFuncEnv* env) {
   setup_service();
-  handle_connections(env);
+
+  if (io_mode_ == IoMode::kEvent) {
+    log_info("Starting to handle connections on port: %d with %u event loops", bind_port_,
+             static_cast<unsigned>(worker_threads_));
+
+    non_blocking(listener_, true);
+    for (auto listener : loop_listeners_) {
+      non_blocking(listener, true);
+    }
+
+    // each loop accepts from its own listener where the kernel spreads the
+    // connections, otherwise all loops accept from the same listener and
+    // whichever is idle gets the new connection
+    std::vector<std::thread> loops;
+    for (size_t ndx = 1; ndx < worker_threads_; ndx++) {
+      loops.emplace_back(&MySQLServerMock::run_event_loop, this, env,
+                         loop_listeners_.empty() ? listener_ : loop_listeners_[ndx - 1]);
+    }
+    run_event_loop(env, listener_);
+    for (auto &loop : loops) {
+      loop.join();
+    }
+  } else {
+    handle_connections(env);
+  }
 }
 
 void MySQLServerMock::setup_service() {
+#if defined(__linux__) && defined(SO_REUSEPORT)
+  // Linux balances the connections over listeners sharing a port
+  const bool reuse_port = io_mode_ == IoMode::kEvent && worker_threads_ > 1;
+#else
+  const bool reuse_port = false;
+#endif
+
+  listener_ = create_listener(reuse_port);
+  if (reuse_port) {
+    for (size_t ndx = 1; ndx < worker_threads_; ndx++) {
+      loop_listeners_.push_back(create_listener(true));
+    }
+  }
+}
+
+socket_t MySQLServerMock::create_listener(bool reuse_port) {
   int err;
   struct addrinfo hints, *ainfo;
 
@@ -124,29 +257,44 @@ void MySQLServerMock::setup_service() {
 
   std::shared_ptr<void> exit_guard(nullptr, [&](void*){freeaddrinfo(ainfo);});
 
-  listener_ = socket(ainfo->ai_family, ainfo->ai_socktype, ainfo->ai_protocol);
-  if (listener_ < 0) {
+  socket_t listener = socket(ainfo->ai_family, ainfo->ai_socktype, ainfo->ai_protocol);
+  if (listener < 0) {
     throw std::runtime_error("socket() failed: " + get_socket_errno_str());
   }
 
+  std::shared_ptr<void> close_guard(nullptr, [&](void*){ if (listener != kInvalidSocket) close_socket(listener); });
+
   int option_value = 1;
-  if (setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&option_value),
+  if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&option_value),
         static_cast<socklen_t>(sizeof(int))) == -1) {
     throw std::runtime_error("setsockopt() failed: " + get_socket_errno_str());
   }
+#ifdef SO_REUSEPORT
+  if (reuse_port &&
+      setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&option_value),
+        static_cast<socklen_t>(sizeof(int))) == -1) {
+    throw std::runtime_error("setsockopt(SO_REUSEPORT) failed: " + get_socket_errno_str());
+  }
+#else
+  (void)reuse_port;
+#endif
 
-  err = bind(listener_, ainfo->ai_addr, ainfo->ai_addrlen);
+  err = bind(listener, ainfo->ai_addr, ainfo->ai_addrlen);
   if (err < 0) {
     throw std::runtime_error("bind('0.0.0.0', " + std::to_string(bind_port_)+ ") failed: " + strerror(get_socket_errno()) + " (" + get_socket_errno_str() + ")");
   }
 
-  err = listen(listener_, kListenQueueSize);
+  err = listen(listener, kListenQueueSize);
   if (err < 0) {
     throw std::runtime_error("listen() failed: " + get_socket_errno_str());
   }
+
+  const socket_t result = listener;
+  listener = kInvalidSocket;  // keep it open
+  return result;
 }
 
-void MySQLServerMockSession::send_handshake(
+void MySQLServerMockSessionClassic::send_handshake(
     socket_t client_socket,
     mysql_protocol::Capabilities::Flags our_capabilities) {
 
@@ -158,7 +306,7 @@ void MySQLServerMockSession::send_handshake(
   send_packet(client_socket, buf);
 }
 
-mysql_protocol::HandshakeResponsePacket MySQLServerMockSession::handle_handshake_response(
+mysql_protocol::HandshakeResponsePacket MySQLServerMockSessionClassic::handle_handshake_response(
     socket_t client_socket,
     mysql_protocol::Capabilities::Flags our_capabilities) {
 
@@ -209,18 +357,24 @@ mysql_protocol::HandshakeResponsePacket MySQLServerMockSession::handle_handshake
   }
 }
 
-void MySQLServerMockSession::handle_auth_switch(socket_t client_socket) {
+constexpr uint8_t kAuthSwitchSeqNr = 2;
 
-  constexpr uint8_t seq_nr = 2;
+void MySQLServerMockSessionClassic::handle_auth_switch(socket_t client_socket) {
+  send_auth_switch(client_socket);
+  read_auth_switch_response(client_socket);
+}
 
+void MySQLServerMockSessionClassic::send_auth_switch(socket_t client_socket) {
   // send switch-auth request packet
-  {
-    constexpr const char* plugin_data = "123456789|ABCDEFGHI|";
+  constexpr const char* plugin_data = "123456789|ABCDEFGHI|";
 
-    auto buf = protocol_encoder_.encode_auth_switch_message(
-                   seq_nr, kAuthCachingSha2Password, plugin_data);
-    send_packet(client_socket, buf);
-  }
+  auto buf = protocol_encoder_.encode_auth_switch_message(
+                 kAuthSwitchSeqNr, kAuthCachingSha2Password, plugin_data);
+  send_packet(client_socket, buf);
+}
+
+void MySQLServerMockSessionClassic::read_auth_switch_response(socket_t client_socket) {
+  constexpr uint8_t seq_nr = kAuthSwitchSeqNr;
 
   // receive auth-data packet
   {
@@ -248,7 +402,7 @@ void MySQLServerMockSession::handle_auth_switch(socket_t client_socket) {
 
 }
 
-void MySQLServerMockSession::send_fast_auth(socket_t client_socket) {
+void MySQLServerMockSessionClassic::send_fast_auth(socket_t client_socket) {
   // a mysql-8 client will send us a cache-256-password-scramble
   // and expects a \x03 back (fast-auth) + a OK packet
   // Here we send the 1st of the two.
@@ -278,9 +432,12 @@ public:
   static StatementReaderBase *create(const std::string &filename,
       std::string &module_prefix,
       std::map<std::string, std::string> session_data,
-      std::shared_ptr<MockServerGlobalScope> shared_globals) {
+      std::shared_ptr<MockServerGlobalScope> shared_globals,
+      double replay_time_scale) {
     if (filename.substr(filename.size() - 3) == ".js") {
       return new DuktapeStatementReader(filename, module_prefix, session_data, shared_globals);
+    } else if (filename.size() >= 12 && filename.substr(filename.size() - 12) == ".replay.json") {
+      return new ReplayStatementReader(filename, replay_time_scale);
     } else if (filename.substr(filename.size() - 5) == ".json") {
       return new QueriesJsonReader(filename);
     } else {
@@ -292,24 +449,35 @@ public:
 MySQLServerMockSession::MySQLServerMockSession(
     socket_t client_sock,
     std::unique_ptr<StatementReaderBase> statement_processor,
-    bool debug_mode):
+    bool debug_mode, bool event_driven):
   client_socket_{client_sock},
-  protocol_decoder_{&read_packet},
   json_reader_{std::move(statement_processor)},
-  debug_mode_{debug_mode}
+  debug_mode_{debug_mode},
+  event_driven_{event_driven}
 {
   // if it doesn't work, no problem.
   int one = 1;
   setsockopt(client_socket_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
 
-  non_blocking(client_socket_, false);
+  non_blocking(client_socket_, event_driven_);
 
 }
 
+MySQLServerMockSessionClassic::MySQLServerMockSessionClassic(
+    socket_t client_sock,
+    std::unique_ptr<StatementReaderBase> statement_processor,
+    bool debug_mode, bool event_driven):
+  MySQLServerMockSession(client_sock, std::move(statement_processor), debug_mode, event_driven),
+  protocol_decoder_{[this](int sock, uint8_t *data, size_t size, int) {
+    read_packet(sock, data, size);
+  }}
+{
+}
+
 MySQLServerMockSession::~MySQLServerMockSession() {
 }
 
-void MySQLServerMockSession::run() {
+void MySQLServerMockSessionClassic::run() {
   try {
     ////////////////////////////////////////////////////////////////////////////////
     //
@@ -334,13 +502,9 @@ void MySQLServerMockSession::run() {
 
     using namespace mysql_protocol;
 
-    constexpr Capabilities::Flags our_capabilities = Capabilities::PROTOCOL_41
-                                                   | Capabilities::PLUGIN_AUTH
-                                                   | Capabilities::SECURE_CONNECTION;
-
-    send_handshake(client_socket_, our_capabilities);
+    send_handshake(client_socket_, kOurCapabilities);
     HandshakeResponsePacket handshake_response = handle_handshake_response(
-                                                     client_socket_, our_capabilities);
+                                                     client_socket_, kOurCapabilities);
 
     uint8_t packet_seq = 2u;
     if (handshake_response.get_auth_plugin() == kAuthCachingSha2Password) {
@@ -371,8 +535,6 @@ void MySQLServerMockSession::run() {
 
 struct Work {
   socket_t client_socket;
-  std::string expected_queries_file;
-  std::string module_prefix;
   bool debug_mode;
 };
 
@@ -400,12 +562,81 @@ public:
     cond_.notify_one();
   }
 
+  // pushes a batch with one lock
+  void push_all(std::vector<Data> &items) {
+    if (items.empty()) return;
+
+    std::unique_lock<std::mutex> mlock(mutex_);
+
+    for (auto &item: items) {
+      queue_.push(std::move(item));
+    }
+
+    mlock.unlock();
+    if (items.size() == 1) {
+      cond_.notify_one();
+    } else {
+      cond_.notify_all();
+    }
+    items.clear();
+  }
+
 private:
   std::queue<Data> queue_;
   std::mutex mutex_;
   std::condition_variable cond_;
 };
 
+std::unique_ptr<StatementReaderBase> MySQLServerMock::create_statement_reader(socket_t client_socket) {
+  sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  if (-1 == getsockname(client_socket, reinterpret_cast<sockaddr *>(&addr), &addr_len)) {
+    throw std::system_error(get_socket_errno(), std::system_category(), "getsockname() failed");
+  }
+
+  return std::unique_ptr<StatementReaderBase>{
+    StatementReaderFactory::create(
+        expected_queries_file_,
+        module_prefix_,
+        // expose session data json-encoded string
+        {
+          { "port", std::to_string(ntohs(addr.sin_port)) },
+        },
+        shared_globals_,
+        replay_time_scale_)};
+}
+
+std::unique_ptr<MySQLServerMockSession> MySQLServerMock::create_session(
+    socket_t client_socket, bool event_driven) {
+  auto reader = create_statement_reader(client_socket);
+
+  std::unique_ptr<MySQLServerMockSession> session;
+  if (protocol_ == Protocol::kX) {
+    session.reset(new MySQLServerMockSessionX(
+        client_socket, std::move(reader), debug_mode_, event_driven));
+  } else {
+    session.reset(new MySQLServerMockSessionClassic(
+        client_socket, std::move(reader), debug_mode_, event_driven));
+  }
+  session->set_fault_injector(faults_);
+
+  return session;
+}
+
+void MySQLServerMock::send_reader_error(socket_t client_socket, const std::string &msg, int flags) {
+  const std::string error_msg = "reader error: " + msg;
+
+  if (protocol_ == Protocol::kX) {
+    send_packet(client_socket,
+        XProtocolEncoder().encode_error_message(1064, "HY000", error_msg, true),
+        flags);
+  } else {
+    send_packet(client_socket,
+        MySQLProtocolEncoder().encode_error_message(0, 1064, "", error_msg),
+        flags);
+  }
+}
+
 void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
   struct sockaddr_storage client_addr;
   socklen_t addr_size = sizeof(client_addr);
@@ -423,36 +654,15 @@ void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
       if (work.client_socket == kInvalidSocket) break;
 
       try {
-        sockaddr_in addr;
-        socklen_t addr_len = sizeof(addr);
-        if (-1 == getsockname(work.client_socket, reinterpret_cast<sockaddr *>(&addr), &addr_len)) {
-          throw std::system_error(get_socket_errno(), std::system_category(), "getsockname() failed");
-        }
-        std::unique_ptr<StatementReaderBase> statement_reader {
-          StatementReaderFactory::create(
-              work.expected_queries_file,
-              work.module_prefix,
-              // expose session data json-encoded string
-              {
-                { "port", std::to_string(ntohs(addr.sin_port)) },
-              },
-              shared_globals_)};
-
-        MySQLServerMockSession session(
-            work.client_socket,
-            std::move(statement_reader),
-            work.debug_mode);
+        auto session = create_session(work.client_socket, false);
         try {
-          session.run();
+          session->run();
         } catch (const std::exception &e) {
           log_error("%s", e.what());
         }
       } catch (const std::exception &e) {
         // close the connection before Session took over.
-        send_packet(work.client_socket,
-            MySQLProtocolEncoder().encode_error_message(
-              0, 1064, "", "reader error: " + std::string(e.what())),
-            0);
+        send_reader_error(work.client_socket, e.what(), 0);
         log_error("%s", e.what());
       }
 
@@ -474,31 +684,31 @@ void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
   non_blocking(listener_, true);
 
   std::deque<std::thread> worker_threads;
-  for (size_t ndx = 0; ndx < 4; ndx++) {
+  for (size_t ndx = 0; ndx < worker_threads_; ndx++) {
     worker_threads.emplace_back(connection_handler);
   }
 
+  std::vector<Work> accepted;
   while (is_running(env)) {
-    fd_set fds;
-    FD_ZERO (&fds);
-    FD_SET (listener_, &fds);
-
-    // timeval is initialized in loop because value of timeval may be overriden by calling select.
-    timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 10000;
+    pollfd_t fds[1];
+    fds[0].fd = listener_;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
 
-    int err = select (listener_ + 1, &fds, NULL, NULL, &tv);
+    // wake up at least every 10ms to check if we should stop
+    int err = poll_sockets(fds, 1, std::chrono::milliseconds(10));
 
     if (err < 0) {
-      std::cerr << "select() failed: " << strerror(errno) << "\n";
+      if (get_socket_errno() == EINTR) continue;
+      std::cerr << "poll() failed: " << get_socket_errno_str() << "\n";
       break;
     } else if (err == 0) {
       // timeout
       continue;
     }
 
-    if (FD_ISSET(listener_, &fds)) {
+    if (fds[0].revents & POLLIN) {
+      // accept all pending connections, then hand them to the workers at once
       while (true) {
         socket_t client_socket = accept(listener_, (struct sockaddr*)&client_addr, &addr_size);
         if (client_socket == kInvalidSocket) {
@@ -507,18 +717,22 @@ void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
           // if we got interrupted at shutdown, just leave
           if (!is_running(env)) break;
 
-          if (accept_errno == EAGAIN) break;
-          if (accept_errno == EWOULDBLOCK) break;
+          if (would_block(accept_errno)) break;
 #ifdef _WIN32
-          if (accept_errno == WSAEWOULDBLOCK) break;
           if (accept_errno == WSAEINTR) continue;
 #endif
           if (accept_errno == EINTR) continue;
 
           std::cerr << "accept() failed: errno=" << accept_errno << std::endl;
+          work_queue.push_all(accepted);
           return;
         }
 
+        if (faults_->refuse_connection()) {
+          close_socket(client_socket);
+          continue;
+        }
+
         {
           // socket is new, register it
           std::lock_guard<std::mutex> active_fd_lock(active_fds_mutex_);
@@ -526,8 +740,9 @@ void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
         }
 
         // std::cout << "Accepted client " << client_socket << std::endl;
-        work_queue.push(Work {client_socket, expected_queries_file_, module_prefix_, debug_mode_});
+        accepted.push_back(Work {client_socket, debug_mode_});
       }
+      work_queue.push_all(accepted);
     }
   }
 
@@ -538,7 +753,7 @@ void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
 
   // std::cerr << "sending death-signal to threads" << std::endl;
   for (size_t ndx = 0; ndx < worker_threads.size(); ndx++) {
-    work_queue.push(Work { kInvalidSocket, "", "", 0});
+    work_queue.push(Work { kInvalidSocket, false });
   }
   // std::cerr << "joining threads" << std::endl;
   for (size_t ndx = 0; ndx < worker_threads.size(); ndx++) {
@@ -547,41 +762,50 @@ void MySQLServerMock::handle_connections(mysql_harness::PluginFuncEnv* env) {
   // std::cerr << "done" << std::endl;
 }
 
-bool MySQLServerMockSession::process_statements(socket_t client_socket) {
-  using mysql_protocol::Command;
-
+bool MySQLServerMockSessionClassic::process_statements(socket_t client_socket) {
   while (!killed_) {
     protocol_decoder_.read_message(client_socket);
-    auto cmd = protocol_decoder_.get_command_type();
-    switch (cmd) {
-    case Command::QUERY: {
-      std::string statement_received = protocol_decoder_.get_statement();
+    if (!handle_command(client_socket)) break;
+  }
 
-      try {
-        handle_statement(client_socket, protocol_decoder_.packet_seq(),
-            json_reader_->handle_statement(statement_received));
-      } catch (const std::exception &e) {
-        // handling statement failed. Return the error to the client
-        uint8_t packet_seq = protocol_decoder_.packet_seq() + 1;   // rollover to 0 is ok
-        std::this_thread::sleep_for(json_reader_->get_default_exec_time());
-        send_error(client_socket, packet_seq, 1064, std::string("executing statement failed: ") + e.what());
+  return true;
+}
 
-        // assume the connection is broken
-        return true;
-      }
-    }
-    break;
-    case Command::QUIT:
-      // std::cout << "received QUIT command from the client" << std::endl;
-      return true;
-    default:
-      std::cerr << "received unsupported command from the client: "
-                << static_cast<int>(cmd) << "\n";
+bool MySQLServerMockSessionClassic::handle_command(socket_t client_socket) {
+  using mysql_protocol::Command;
+
+  auto cmd = protocol_decoder_.get_command_type();
+  switch (cmd) {
+  case Command::QUERY: {
+    std::string statement_received = protocol_decoder_.get_statement();
+
+    if (!inject_faults()) return false;
+
+    try {
+      handle_statement(client_socket, protocol_decoder_.packet_seq(),
+          json_reader_->handle_statement(statement_received));
+    } catch (const std::exception &e) {
+      // handling statement failed. Return the error to the client
+      pending_resultset_.reset();
       uint8_t packet_seq = protocol_decoder_.packet_seq() + 1;   // rollover to 0 is ok
-      std::this_thread::sleep_for(json_reader_->get_default_exec_time());
-      send_error(client_socket, packet_seq, 1064, "Unsupported command: " + std::to_string(cmd));
+      wait_exec_time(json_reader_->get_default_exec_time());
+      send_error(client_socket, packet_seq, 1064, std::string("executing statement failed: ") + e.what());
+
+      // assume the connection is broken
+      return false;
     }
   }
+  break;
+  case Command::QUIT:
+    // std::cout << "received QUIT command from the client" << std::endl;
+    return false;
+  default:
+    std::cerr << "received unsupported command from the client: "
+              << static_cast<int>(cmd) << "\n";
+    uint8_t packet_seq = protocol_decoder_.packet_seq() + 1;   // rollover to 0 is ok
+    wait_exec_time(json_reader_->get_default_exec_time());
+    send_error(client_socket, packet_seq, 1064, "Unsupported command: " + std::to_string(cmd));
+  }
 
   return true;
 }
@@ -593,18 +817,21 @@ static void debug_trace_result(const ResultsetResponse *resultset) {
       std::cout << "  |  " << (cell.first ? cell.second : "NULL");
     std::cout << "  |\n";
   }
+  if (resultset->generated_rows > 0) {
+    std::cout << "  (" << resultset->generated_rows << " generated rows)\n";
+  }
   std::cout << "\n\n\n" << std::flush;
 }
 
-void MySQLServerMockSession::handle_statement(socket_t client_socket, uint8_t seq_no,
-                    const StatementAndResponse& statement) {
+void MySQLServerMockSessionClassic::handle_statement(socket_t client_socket, uint8_t seq_no,
+                    StatementAndResponse statement) {
   using StatementResponseType = StatementAndResponse::StatementResponseType;
 
   switch (statement.response_type) {
   case StatementResponseType::STMT_RES_OK: {
     if (debug_mode_) std::cout << std::endl;  // visual separator
     OkResponse *response = dynamic_cast<OkResponse *>(statement.response.get());
-    std::this_thread::sleep_for(statement.exec_time);
+    wait_exec_time(statement.exec_time);
     send_ok(client_socket, static_cast<uint8_t>(seq_no+1), 0, response->last_insert_id, 0, response->warning_count);
   }
   break;
@@ -615,7 +842,7 @@ void MySQLServerMockSession::handle_statement(socket_t client_socket, uint8_t se
     }
     seq_no = static_cast<uint8_t>(seq_no + 1);
     auto buf = protocol_encoder_.encode_columns_number_message(seq_no++, response->columns.size());
-    std::this_thread::sleep_for(statement.exec_time);
+    wait_exec_time(statement.exec_time);
     send_packet(client_socket, buf);
     for (const auto& column: response->columns) {
       auto col_buf = protocol_encoder_.encode_column_meta_message(seq_no++, column);
@@ -628,8 +855,15 @@ void MySQLServerMockSession::handle_statement(socket_t client_socket, uint8_t se
       auto res_buf = protocol_encoder_.encode_row_message(seq_no++, response->columns, response->rows[i]);
       send_packet(client_socket, res_buf);
     }
-    buf = protocol_encoder_.encode_eof_message(seq_no++);
-    send_packet(client_socket, buf);
+    if (response->generated_rows > 0) {
+      pending_resultset_ = std::move(statement.response);
+      pending_row_ = 0;
+      pending_seq_no_ = seq_no;
+      send_generated_rows(client_socket);
+    } else {
+      buf = protocol_encoder_.encode_eof_message(seq_no++);
+      send_packet(client_socket, buf);
+    }
   }
   break;
   case StatementResponseType::STMT_RES_ERROR: {
@@ -644,7 +878,37 @@ void MySQLServerMockSession::handle_statement(socket_t client_socket, uint8_t se
   }
 }
 
-void MySQLServerMockSession::send_error(socket_t client_socket, uint8_t seq_no,
+void MySQLServerMockSession::send_generated_rows(socket_t client_socket) {
+  ResultsetResponse *response = dynamic_cast<ResultsetResponse *>(pending_resultset_.get());
+
+  while (pending_row_ < response->generated_rows) {
+    row_buf_.clear();
+    while (pending_row_ < response->generated_rows && row_buf_.size() < kRowBatchSize) {
+      response->generate_row(pending_row_++, row_);
+      append_row(row_buf_, response->columns, row_);
+    }
+    send_packet(client_socket, row_buf_);
+
+    // continued by on_writable() once the batch got sent
+    if (event_driven_ && pending_row_ < response->generated_rows) return;
+  }
+
+  send_resultset_end(client_socket);
+  pending_resultset_.reset();
+}
+
+void MySQLServerMockSessionClassic::append_row(std::vector<uint8_t> &buf,
+    const std::vector<column_info_type> &columns,
+    const RowValueType &row) {
+  protocol_encoder_.append_row_message(buf, pending_seq_no_++, columns, row);
+}
+
+void MySQLServerMockSessionClassic::send_resultset_end(socket_t client_socket) {
+  auto buf = protocol_encoder_.encode_eof_message(pending_seq_no_);
+  send_packet(client_socket, buf);
+}
+
+void MySQLServerMockSessionClassic::send_error(socket_t client_socket, uint8_t seq_no,
                                  uint16_t error_code,
                                  const std::string &error_msg,
                                  const std::string &sql_state) {
@@ -653,7 +917,7 @@ void MySQLServerMockSession::send_error(socket_t client_socket, uint8_t seq_no,
   send_packet(client_socket, buf);
 }
 
-void MySQLServerMockSession::send_ok(socket_t client_socket, uint8_t seq_no,
+void MySQLServerMockSessionClassic::send_ok(socket_t client_socket, uint8_t seq_no,
     uint64_t affected_rows,
     uint64_t last_insert_id,
     uint16_t server_status,
@@ -662,4 +926,402 @@ void MySQLServerMockSession::send_ok(socket_t client_socket, uint8_t seq_no,
   send_packet(client_socket, buf);
 }
 
+void MySQLServerMockSession::send_packet(socket_t client_socket, const uint8_t *data, size_t size) {
+  if (bandwidth_ > 0) {
+    // the time the data takes on a link of that bandwidth
+    wait_exec_time(std::chrono::microseconds(
+        static_cast<int64_t>(static_cast<double>(size) * 1000000.0 / static_cast<double>(bandwidth_))));
+  }
+
+  if (!event_driven_) {
+    ::send_packet(client_socket, data, size);
+    return;
+  }
+
+  send_buf_.insert(send_buf_.end(), data, data + size);
+}
+
+void MySQLServerMockSession::send_packet(socket_t client_socket, const std::vector<uint8_t> &buffer) {
+  send_packet(client_socket, buffer.data(), buffer.size());
+}
+
+void MySQLServerMockSession::read_packet(socket_t client_socket, uint8_t *data, size_t size) {
+  if (!event_driven_) {
+    ::read_packet(client_socket, data, size);
+    return;
+  }
+
+  // only called once has_packet() is true
+  if (recv_buf_.size() - recv_pos_ < size) {
+    throw std::runtime_error("short packet");
+  }
+  std::copy(recv_buf_.begin() + static_cast<std::ptrdiff_t>(recv_pos_),
+            recv_buf_.begin() + static_cast<std::ptrdiff_t>(recv_pos_ + size), data);
+  recv_pos_ += size;
+}
+
+void MySQLServerMockSession::wait_exec_time(std::chrono::microseconds exec_time) {
+  if (!event_driven_) {
+    std::this_thread::sleep_for(exec_time);
+    return;
+  }
+
+  // hold back what follows, the event loop keeps serving the other sessions
+  if (exec_time.count() <= 0) return;
+
+  if (delayed_from_ == kNotDelayed) {
+    delayed_from_ = send_buf_.size();
+    delayed_until_ = std::chrono::steady_clock::now() + exec_time;
+  } else {
+    delayed_until_ += exec_time;
+  }
+}
+
+void MySQLServerMockSession::set_fault_injector(std::shared_ptr<MockServerFaultInjector> faults) {
+  faults_ = std::move(faults);
+  fault_rng_.seed(faults_->session_seed());
+}
+
+bool MySQLServerMockSession::inject_faults() {
+  if (!faults_) return true;
+
+  auto faults = faults_->get_active();
+  if (!faults) {
+    bandwidth_ = 0;
+    return true;
+  }
+
+  bandwidth_ = faults->bandwidth;
+
+  std::uniform_real_distribution<double> chance;
+  if (faults->drop_probability > 0 && chance(fault_rng_) < faults->drop_probability) {
+    log_info("dropping connection %d (injected fault)", static_cast<int>(client_socket_));
+    return false;
+  }
+  if (faults->stall_probability > 0 && chance(fault_rng_) < faults->stall_probability) {
+    wait_exec_time(faults->stall_duration);
+  }
+
+  return true;
+}
+
+bool MySQLServerMockSessionClassic::has_packet() const {
+  const size_t available = recv_buf_.size() - recv_pos_;
+  if (available < 4) return false;
+
+  const uint8_t *hdr = recv_buf_.data() + recv_pos_;
+  const size_t payload_size = static_cast<size_t>(hdr[0]) |
+                              (static_cast<size_t>(hdr[1]) << 8) |
+                              (static_cast<size_t>(hdr[2]) << 16);
+
+  return available >= 4 + payload_size;
+}
+
+void MySQLServerMockSessionClassic::start() {
+  send_handshake(client_socket_, kOurCapabilities);
+  state_ = State::kHandshakeResponse;
+}
+
+bool MySQLServerMockSessionClassic::handle_packet() {
+  switch (state_) {
+  case State::kHandshakeResponse: {
+    auto handshake_response = handle_handshake_response(client_socket_, kOurCapabilities);
+
+    if (handshake_response.get_auth_plugin() == kAuthCachingSha2Password) {
+      send_auth_switch(client_socket_);
+      state_ = State::kAuthSwitchResponse;
+    } else {
+      send_ok(client_socket_, 2);
+      state_ = State::kStatements;
+    }
+    break;
+  }
+  case State::kAuthSwitchResponse:
+    read_auth_switch_response(client_socket_);
+    send_fast_auth(client_socket_);
+    send_ok(client_socket_, 2 + 3);  // 2 from auth-switch + 1 from fast-auth
+    state_ = State::kStatements;
+    break;
+  case State::kStatements:
+    protocol_decoder_.read_message(client_socket_);
+    return handle_command(client_socket_);
+  }
+
+  return true;
+}
+
+bool MySQLServerMockSession::handle_packets() {
+  try {
+    while (!done_ && !killed_ && !is_delayed() &&
+           !pending_resultset_ && has_packet()) {
+      if (!handle_packet()) {
+        done_ = true;
+      }
+    }
+  } catch (const std::exception &e) {
+    log_warning("Exception caught in connection loop: %s", e.what());
+    done_ = true;
+  }
+
+  // drop what got handled
+  if (recv_pos_ == recv_buf_.size()) {
+    recv_buf_.clear();
+    recv_pos_ = 0;
+  }
+
+  if (!on_writable()) return false;
+
+  // the error of a failed statement and the OK of a QUIT still go out
+  return !done_ || wants_write() || is_delayed();
+}
+
+bool MySQLServerMockSession::on_readable() {
+  if (done_) return false;
+
+  uint8_t buf[kReadBufSize];
+  while (true) {
+    const auto received = recv(client_socket_, reinterpret_cast<char *>(buf), sizeof(buf), 0);
+    if (received > 0) {
+      recv_buf_.insert(recv_buf_.end(), buf, buf + received);
+      continue;
+    }
+    if (received == 0) {
+      // connection closed by client
+      return false;
+    }
+
+    const int err = get_socket_errno();
+    if (would_block(err)) break;
+#ifndef _WIN32
+    if (err == EINTR) continue;
+#endif
+    return false;
+  }
+
+  return handle_packets();
+}
+
+bool MySQLServerMockSession::wants_write() const {
+  const size_t due = is_delayed() ? delayed_from_ : send_buf_.size();
+
+  return send_pos_ < due || (pending_resultset_ && !is_delayed());
+}
+
+bool MySQLServerMockSession::on_writable() {
+  const size_t due = is_delayed() ? delayed_from_ : send_buf_.size();
+
+  while (send_pos_ < due) {
+    const auto sent = send(client_socket_, reinterpret_cast<const char *>(send_buf_.data() + send_pos_),
+                           due - send_pos_, kSendFlags);
+    if (sent < 0) {
+      const int err = get_socket_errno();
+      if (would_block(err)) break;
+#ifndef _WIN32
+      if (err == EINTR) continue;
+#endif
+      return false;
+    }
+    send_pos_ += static_cast<size_t>(sent);
+  }
+
+  if (send_pos_ == send_buf_.size()) {
+    send_buf_.clear();
+    send_pos_ = 0;
+
+    if (!is_delayed()) {
+      if (pending_resultset_) {
+        try {
+          send_generated_rows(client_socket_);
+        } catch (const std::exception &e) {
+          log_warning("Exception caught generating rows: %s", e.what());
+          return false;
+        }
+      } else if (!done_ && has_packet()) {
+        // the packets that came in while the rows got sent
+        return handle_packets();
+      }
+    }
+  }
+
+  return !done_ || wants_write() || is_delayed();
+}
+
+bool MySQLServerMockSession::on_timer(std::chrono::steady_clock::time_point now) {
+  if (!is_delayed() || now < delayed_until_) return true;
+
+  delayed_from_ = kNotDelayed;
+
+  return handle_packets();
+}
+
+void MySQLServerMock::run_event_loop(mysql_harness::PluginFuncEnv* env, socket_t listener) {
+  using clock = std::chrono::steady_clock;
+
+  std::vector<std::unique_ptr<MySQLServerMockSession>> sessions;
+  std::vector<pollfd_t> fds;
+
+  // delayed sessions by due time: poll() wakes up when the first one is due,
+  // and only the due ones get looked at
+  using TimerKey = std::pair<clock::time_point, MySQLServerMockSession *>;
+  std::set<TimerKey> timers;
+  std::map<MySQLServerMockSession *, clock::time_point> timer_due;
+
+  // sessions that ended, removed after the pass
+  std::unordered_set<MySQLServerMockSession *> ended;
+
+  // re-arms the timer of a session after it handled an event
+  auto update_timer = [&timers, &timer_due](MySQLServerMockSession *session, bool keep) {
+    auto it = timer_due.find(session);
+    if (it != timer_due.end()) {
+      if (keep && session->is_delayed() && session->delayed_until() == it->second) return;
+
+      timers.erase(TimerKey(it->second, session));
+      timer_due.erase(it);
+    }
+    if (keep && session->is_delayed()) {
+      timers.emplace(session->delayed_until(), session);
+      timer_due.emplace(session, session->delayed_until());
+    }
+  };
+
+  // first remove the book-keeping, then close the socket,
+  // unless close_all_connections() closed it already
+  auto close_session = [this](socket_t client_socket) {
+    std::lock_guard<std::mutex> active_fd_lock(active_fds_mutex_);
+    auto it = active_fds_.find(client_socket);
+    if (it != active_fds_.end()) {
+      active_fds_.erase(it);
+    }
+    close_socket(client_socket);
+  };
+
+  auto end_session = [&](MySQLServerMockSession *session) {
+    update_timer(session, false);
+    close_session(session->client_socket());
+    ended.insert(session);
+  };
+
+  while (is_running(env)) {
+    fds.resize(sessions.size() + 1);
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+
+    for (size_t ndx = 0; ndx < sessions.size(); ++ndx) {
+      auto &session = sessions[ndx];
+      fds[ndx + 1].fd = session->client_socket();
+      fds[ndx + 1].events = static_cast<short>(session->is_delayed() ? 0 : POLLIN);
+      if (session->wants_write()) fds[ndx + 1].events |= POLLOUT;
+      fds[ndx + 1].revents = 0;
+    }
+
+    // wake up at least every 10ms to check if we should stop
+    std::chrono::microseconds timeout = std::chrono::milliseconds(10);
+    if (!timers.empty()) {
+      const auto due_in = std::chrono::duration_cast<std::chrono::microseconds>(
+          timers.begin()->first - clock::now());
+      timeout = std::max(std::min(due_in, timeout), std::chrono::microseconds(0));
+    }
+
+    int err = poll_sockets(fds.data(), fds.size(), timeout);
+    if (err < 0) {
+      if (get_socket_errno() == EINTR) continue;
+      log_error("poll() failed: %s", get_socket_errno_str().c_str());
+      break;
+    }
+
+    // release the delayed output first, it is late already
+    const auto after_poll = clock::now();
+    while (!timers.empty() && timers.begin()->first <= after_poll) {
+      MySQLServerMockSession *session = timers.begin()->second;
+      timers.erase(timers.begin());
+      timer_due.erase(session);
+
+      if (session->on_timer(after_poll)) {
+        update_timer(session, true);
+      } else {
+        end_session(session);
+      }
+    }
+
+    for (size_t ndx = 0; ndx < sessions.size(); ++ndx) {
+      MySQLServerMockSession *session = sessions[ndx].get();
+      const auto revents = fds[ndx + 1].revents;
+
+      if (revents == 0 || ended.count(session)) continue;
+
+      bool keep = true;
+      if (revents & POLLNVAL) {
+        keep = false;
+      } else {
+        if (keep && (revents & POLLOUT)) keep = session->on_writable();
+        if (keep && (revents & (POLLIN | POLLHUP | POLLERR))) keep = session->on_readable();
+      }
+
+      if (keep) {
+        update_timer(session, true);
+      } else {
+        end_session(session);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      // a batch per wakeup, the sessions of the loop still get served in a connection storm
+      for (size_t accepted = 0; accepted < kMaxAcceptsPerWakeup; ++accepted) {
+        socket_t client_socket = accept(listener, nullptr, nullptr);
+        if (client_socket == kInvalidSocket) {
+          auto accept_errno = get_socket_errno();
+          if (would_block(accept_errno)) break;
+          if (accept_errno == EINTR) continue;
+
+          log_error("accept() failed: errno=%d", accept_errno);
+          break;
+        }
+
+        if (faults_->refuse_connection()) {
+          close_socket(client_socket);
+          continue;
+        }
+
+        {
+          // socket is new, register it
+          std::lock_guard<std::mutex> active_fd_lock(active_fds_mutex_);
+          active_fds_.emplace(client_socket);
+        }
+
+        std::unique_ptr<MySQLServerMockSession> session;
+        try {
+          session = create_session(client_socket, true);
+        } catch (const std::exception &e) {
+          // close the connection before Session took over.
+          send_reader_error(client_socket, e.what(), kSendFlags);
+          log_error("%s", e.what());
+          close_session(client_socket);
+          continue;
+        }
+
+        session->start();
+        if (!session->on_writable()) {
+          close_session(client_socket);
+          continue;
+        }
+        sessions.push_back(std::move(session));
+      }
+    }
+
+    if (!ended.empty()) {
+      size_t kept = 0;
+      for (size_t ndx = 0; ndx < sessions.size(); ++ndx) {
+        if (!ended.count(sessions[ndx].get())) sessions[kept++] = std::move(sessions[ndx]);
+      }
+      sessions.resize(kept);
+      ended.clear();
+    }
+  }
+
+  for (auto &session : sessions) {
+    close_session(session->client_socket());
+  }
+}
+
 } // namespace server_mock
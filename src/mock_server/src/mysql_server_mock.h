@@ -25,25 +25,174 @@
 #ifndef MYSQLD_MOCK_MYSQL_SERVER_MOCK_INCLUDED
 #define MYSQLD_MOCK_MYSQL_SERVER_MOCK_INCLUDED
 
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "statement_reader.h"
 #include "mysql_protocol_decoder.h"
 #include "mysql_protocol_encoder.h"
 #include "mysqlrouter/mock_server_component.h"
+#include "mysqlrouter/mock_server_faults.h"
 #include "mysql/harness/plugin.h"
 
 namespace server_mock {
 
+/** @class MySQLServerMockSession
+ *
+ * @brief Session of a client, independent of the protocol.
+ *
+ * Does the socket I/O of event-driven sessions, holds back the output for
+ * the execution time of the statements and streams generated rows.
+ **/
 class MySQLServerMockSession {
 public:
+  /** @brief Constructor.
+   *
+   * @param client_sock socket of the client connection
+   * @param statement_processor reader of the expected statements
+   * @param debug_mode print the handled queries to standard output
+   * @param event_driven run the session from an event loop with start(),
+   *        on_readable() and on_writable() instead of a blocking run()
+   */
   MySQLServerMockSession(socket_t client_sock,
       std::unique_ptr<StatementReaderBase> statement_processor,
-      bool debug_mode);
+      bool debug_mode, bool event_driven = false);
+
+  virtual ~MySQLServerMockSession();
+
+  /** @brief runs the session until the client leaves, blocking sessions only */
+  virtual void run() = 0;
+
+  void kill() {
+    killed_ = true;
+  }
+
+  socket_t client_socket() const { return client_socket_; }
+
+  /** @brief sets the faults the session injects */
+  void set_fault_injector(std::shared_ptr<MockServerFaultInjector> faults);
+
+  /** @brief sends the greeting, event-driven sessions only */
+  virtual void start() = 0;
+
+  /** @brief reads what the client sent and handles complete packets
+   *
+   * @returns false if the session ends
+   */
+  bool on_readable();
+
+  /** @brief sends the pending output that is due
+   *
+   * @returns false if the session ends
+   */
+  bool on_writable();
+
+  /** @brief true if output is due and waits for the socket to be writable */
+  bool wants_write() const;
 
-  ~MySQLServerMockSession();
+  /** @brief true if output is held back to simulate the execution time */
+  bool is_delayed() const { return delayed_from_ != kNotDelayed; }
+
+  /** @brief when the delayed output is due */
+  std::chrono::steady_clock::time_point delayed_until() const { return delayed_until_; }
+
+  /** @brief releases the delayed output once it is due, and handles
+   *         the packets that came in meanwhile
+   *
+   * @returns false if the session ends
+   */
+  bool on_timer(std::chrono::steady_clock::time_point now);
+
+protected:
+  static constexpr size_t kNotDelayed = static_cast<size_t>(-1);
+
+  // shadow the blocking socket functions, event-driven sessions buffer
+  void send_packet(socket_t client_socket, const uint8_t *data, size_t size);
+  void send_packet(socket_t client_socket, const std::vector<uint8_t> &buffer);
+  void read_packet(socket_t client_socket, uint8_t *data, size_t size);
+
+  /** @brief waits the execution time of a statement before the following
+   *         output is sent */
+  void wait_exec_time(std::chrono::microseconds exec_time);
+
+  /** @brief injects the active faults before a statement gets handled
+   *
+   * Stalls the response and limits the bandwidth of the following output.
+   *
+   * @returns false if the connection shall be dropped instead
+   */
+  bool inject_faults();
+
+  /** @brief true if a complete packet is buffered */
+  virtual bool has_packet() const = 0;
+
+  /** @brief handles the first buffered packet
+   *
+   * @returns false if the session ends
+   */
+  virtual bool handle_packet() = 0;
+
+  /** @brief handles the buffered packets until the output gets delayed */
+  bool handle_packets();
+
+  /** @brief sends the generated rows of pending_resultset_, and the end of
+   *         the resultset after the last one
+   *
+   * Rows get encoded in batches into a buffer that gets reused, to not
+   * hold the whole resultset in memory. Event-driven sessions send one
+   * batch per call and continue once it got sent.
+   */
+  void send_generated_rows(socket_t client_socket);
+
+  /** @brief encodes a generated row at the end of the buffer */
+  virtual void append_row(std::vector<uint8_t> &buf,
+                          const std::vector<column_info_type> &columns,
+                          const RowValueType &row) = 0;
+
+  /** @brief sends what follows the rows of a resultset */
+  virtual void send_resultset_end(socket_t client_socket) = 0;
+
+  bool killed_ { false };
+  socket_t client_socket_;
+  std::unique_ptr<StatementReaderBase> json_reader_;
+  bool debug_mode_;
+
+  bool event_driven_;
+  bool done_{false};
+  std::vector<uint8_t> recv_buf_;
+  size_t recv_pos_{0};
+  std::vector<uint8_t> send_buf_;
+  size_t send_pos_{0};
+  /** @brief start of the output in send_buf_ held back until delayed_until_ */
+  size_t delayed_from_{kNotDelayed};
+  std::chrono::steady_clock::time_point delayed_until_;
+
+  /** @brief resultset whose generated rows are still to be sent */
+  std::unique_ptr<Response> pending_resultset_;
+  size_t pending_row_{0};
+  std::vector<uint8_t> row_buf_;
+  RowValueType row_;
+
+  std::shared_ptr<MockServerFaultInjector> faults_;
+  std::mt19937_64 fault_rng_;
+  /** @brief bytes per second of the output, 0 for no limit */
+  uint64_t bandwidth_{0};
+};
+
+/** @class MySQLServerMockSessionClassic
+ *
+ * @brief Session of a classic protocol client.
+ **/
+class MySQLServerMockSessionClassic : public MySQLServerMockSession {
+public:
+  MySQLServerMockSessionClassic(socket_t client_sock,
+      std::unique_ptr<StatementReaderBase> statement_processor,
+      bool debug_mode, bool event_driven = false);
 
   void send_handshake(socket_t client_socket,
                       mysql_protocol::Capabilities::Flags our_capabilities);
@@ -54,12 +203,22 @@ public:
 
   void handle_auth_switch(socket_t client_socket);
 
+  void send_auth_switch(socket_t client_socket);
+
+  void read_auth_switch_response(socket_t client_socket);
+
   void send_fast_auth(socket_t client_socket);
 
   bool process_statements(socket_t client_socket);
 
+  /** @brief handles the command read by the protocol decoder
+   *
+   * @returns false if the session ends
+   */
+  bool handle_command(socket_t client_socket);
+
   void handle_statement(socket_t client_socket, uint8_t seq_no,
-                        const StatementAndResponse& statement);
+                        StatementAndResponse statement);
 
   void send_error(socket_t client_socket, uint8_t seq_no,
                   uint16_t error_code,
@@ -72,18 +231,29 @@ public:
       uint16_t server_status=0,
       uint16_t warning_count=0);
 
-  void run();
+  void run() override;
+
+  void start() override;
 
-  void kill() {
-    killed_ = true;
-  }
 private:
-  bool killed_ { false };
-  socket_t client_socket_;
+  enum class State {
+    kHandshakeResponse,
+    kAuthSwitchResponse,
+    kStatements,
+  };
+
+  bool has_packet() const override;
+  bool handle_packet() override;
+  void append_row(std::vector<uint8_t> &buf,
+                  const std::vector<column_info_type> &columns,
+                  const RowValueType &row) override;
+  void send_resultset_end(socket_t client_socket) override;
+
   MySQLProtocolEncoder protocol_encoder_;
   MySQLProtocolDecoder protocol_decoder_;
-  std::unique_ptr<StatementReaderBase> json_reader_;
-  bool debug_mode_;
+
+  State state_{State::kHandshakeResponse};
+  uint8_t pending_seq_no_{0};
 };
 
 /** @class MySQLServerMock
@@ -93,6 +263,33 @@ private:
  **/
 class MySQLServerMock {
  public:
+  /** @brief How the worker threads handle the client connections */
+  enum class IoMode {
+    /** each worker runs one session at a time until the client leaves */
+    kBlocking,
+    /** each worker runs an event loop over many sessions */
+    kEvent,
+  };
+
+  /** @brief Protocol the clients speak */
+  enum class Protocol {
+    kClassic,
+    kX,
+  };
+
+  static constexpr size_t kDefaultWorkerThreads = 4;
+
+  /** @brief parses "blocking" or "event"
+   *
+   * @throws std::invalid_argument on other values
+   */
+  static IoMode io_mode_from_string(const std::string &name);
+
+  /** @brief parses "classic" or "x"
+   *
+   * @throws std::invalid_argument on other values
+   */
+  static Protocol protocol_from_string(const std::string &name);
 
   /** @brief Constructor.
    *
@@ -103,12 +300,20 @@ class MySQLServerMock {
    *                        connections
    * @param debug_mode Flag indicating if the handled queries should be printed to
    *                   the standard output
+   * @param worker_threads Number of threads handling the client connections
+   * @param io_mode How the worker threads handle the client connections
+   * @param replay_time_scale Factor for the latencies of a replayed workload
+   * @param protocol Protocol the clients speak
    */
   MySQLServerMock(
       const std::string &expected_queries_file,
       const std::string &module_prefix,
       unsigned bind_port,
-      bool debug_mode);
+      bool debug_mode,
+      size_t worker_threads = kDefaultWorkerThreads,
+      IoMode io_mode = IoMode::kBlocking,
+      double replay_time_scale = 1.0,
+      Protocol protocol = Protocol::kClassic);
 
   /** @brief Starts handling the clients connections in infinite loop.
    *         Will return only in case of an exception (error).
@@ -119,6 +324,12 @@ class MySQLServerMock {
     return shared_globals_;
   }
 
+  std::shared_ptr<MockServerFaultInjector> get_fault_injector() {
+    return faults_;
+  }
+
+  unsigned bind_port() const { return bind_port_; }
+
   void close_all_connections();
 
   ~MySQLServerMock();
@@ -126,16 +337,45 @@ class MySQLServerMock {
  private:
   void setup_service();
 
+  /** @brief creates a socket listening on the port
+   *
+   * @param reuse_port allow more listeners on the port, the kernel spreads
+   *        the new connections over them
+   */
+  socket_t create_listener(bool reuse_port);
+
   void handle_connections(mysql_harness::PluginFuncEnv* env);
 
-  static constexpr int kListenQueueSize = 128;
+  /** @brief accepts and runs event-driven sessions until the plugin stops
+   *
+   * @param listener socket the loop accepts new connections from
+   */
+  void run_event_loop(mysql_harness::PluginFuncEnv* env, socket_t listener);
+
+  std::unique_ptr<StatementReaderBase> create_statement_reader(socket_t client_socket);
+
+  /** @brief creates the session of a client in the protocol of the server */
+  std::unique_ptr<MySQLServerMockSession> create_session(socket_t client_socket, bool event_driven);
+
+  /** @brief sends the error of a session that couldn't be created */
+  void send_reader_error(socket_t client_socket, const std::string &msg, int flags);
+
+  // connection storms overflow small backlogs, the kernel caps it to its maximum
+  static constexpr int kListenQueueSize = 4096;
   unsigned bind_port_;
   bool debug_mode_;
+  size_t worker_threads_;
+  IoMode io_mode_;
+  double replay_time_scale_;
+  Protocol protocol_;
   socket_t listener_{socket_t(-1)};
+  /** @brief listeners of the other event loops, if the platform spreads connections */
+  std::vector<socket_t> loop_listeners_;
   std::string expected_queries_file_;
   std::string module_prefix_;
 
   std::shared_ptr<MockServerGlobalScope> shared_globals_ {new MockServerGlobalScope};
+  std::shared_ptr<MockServerFaultInjector> faults_ {new MockServerFaultInjector(shared_globals_)};
 
   std::mutex active_fds_mutex_;
   std::set<socket_t> active_fds_;
@@ -189,11 +189,42 @@
           "items": {
             "$ref": "#/definitions/ResultsetRow"
           }
+        },
+        "generate": {
+          "$ref": "#/definitions/GeneratedRows"
         }
       },
       "required": ["columns"]
     },
 
+    "GeneratedRows": {
+      "description": "rows generated while they get sent, after the 'rows'. Repeats the 'template' rows if given, random values of the column types otherwise",
+      "type": "object",
+      "additionalProperties": false,
+
+      "properties": {
+        "rows": {
+          "description": "number of rows to generate",
+          "type": "integer",
+          "minimum": 0
+        },
+        "template": {
+          "description": "rows to repeat",
+          "type": "array",
+          "minItems": 1,
+          "items": {
+            "$ref": "#/definitions/ResultsetRow"
+          }
+        },
+        "random_seed": {
+          "description": "seed of the random values, the same seed generates the same rows",
+          "type": "integer",
+          "minimum": 0
+        }
+      },
+      "required": ["rows"]
+    },
+
     "RPC": {
       "description": "statement and its response",
       "type": "object",
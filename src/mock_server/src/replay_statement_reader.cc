@@ -0,0 +1,283 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "replay_statement_reader.h"
+
+#ifdef RAPIDJSON_NO_SIZETYPEDEFINE
+// if we build within the server, it will set RAPIDJSON_NO_SIZETYPEDEFINE globally
+// and require to include my_rapidjson_size_t.h
+#include "my_rapidjson_size_t.h"
+#endif
+
+#include "rapidjson/document.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/filereadstream.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "file_cache.h"
+#include "mysqlrouter/query_digest_stats.h"
+
+namespace {
+
+// default allocator for rapidJson (MemoryPoolAllocator) is broken for SparcSolaris
+using JsonDocument = rapidjson::GenericDocument<rapidjson::UTF8<>,  rapidjson::CrtAllocator>;
+using JsonValue = rapidjson::GenericValue<rapidjson::UTF8<>,  rapidjson::CrtAllocator>;
+
+constexpr size_t kLatencyBuckets = QueryDigestStats::kLatencyBuckets;
+
+// bytes of a result set with one column, besides its rows: column count,
+// column definition and the two EOF packets
+constexpr uint64_t kResultsetOverhead = 4 + 1 + 4 + 22 + 4 + 5 + 4 + 5;
+
+// bytes of a row besides its value: packet header and length of the value
+constexpr uint64_t kRowOverhead = 4 + 3;
+
+// values are kept below the size of a packet
+constexpr uint64_t kMaxValueSize = 0xffffff - 16;
+
+/** @brief the recorded responses to the statements of one digest */
+struct DigestProfile {
+  uint64_t count{0};
+  uint64_t rows{0};
+  uint64_t bytes{0};
+  std::array<uint64_t, kLatencyBuckets> latency_histogram{};
+  uint64_t latency_samples{0};
+  bool returns_rows{false};
+};
+
+using Workload = std::unordered_map<std::string, DigestProfile>;
+
+// statements that answer with a result set, even without rows
+bool digest_returns_rows(const std::string &digest) {
+  const std::string first_word = digest.substr(0, digest.find_first_of(" ("));
+  for (const char *word: {"SELECT", "SHOW", "WITH", "DESC", "DESCRIBE", "EXPLAIN", "TABLE", "VALUES"}) {
+    if (first_word == word) return true;
+  }
+  return false;
+}
+
+uint64_t get_uint_field(const JsonValue &digest, const char *field, const std::string &filename) {
+  if (!digest.HasMember(field)) return 0;
+  if (!digest[field].IsUint64()) {
+    throw std::runtime_error(filename + ": expected '" + field + "' to be an unsigned number");
+  }
+  return digest[field].GetUint64();
+}
+
+// throws std::runtime_error on
+// - file read error
+// - JSON parse error
+// - unexpected document structure
+Workload load_workload(const std::string &filename) {
+  // This DOES NOT have to be big enough to contain the entire file.
+  constexpr size_t kReadBufferSize = 64 * 1024;
+
+#ifndef _WIN32
+  FILE* fp = fopen(filename.c_str(), "rb");
+#else
+  FILE* fp = fopen(filename.c_str(), "r");
+#endif
+  if (!fp) {
+    throw std::runtime_error("Could not open replay file '" + filename
+                             + "' for reading: " + strerror(errno));
+  }
+  std::shared_ptr<void> exit_guard(nullptr, [&](void*){fclose(fp);});
+
+  char read_buffer[kReadBufferSize];
+  rapidjson::FileReadStream is(fp, read_buffer, sizeof(read_buffer));
+
+  JsonDocument json;
+  if (json.ParseStream(is).HasParseError()) {
+    throw std::runtime_error("Parsing replay file '" + filename + "' failed at offset "
+                             + std::to_string(json.GetErrorOffset()) + ": "
+                             + rapidjson::GetParseError_En(json.GetParseError()));
+  }
+
+  if (!json.IsObject() || !json.HasMember("routes") || !json["routes"].IsArray()) {
+    throw std::runtime_error(filename + ": expected an object with a 'routes' array");
+  }
+
+  // the digests of all routes make up the workload
+  Workload workload;
+  for (const auto &route: json["routes"].GetArray()) {
+    if (!route.IsObject() || !route.HasMember("digests") || !route["digests"].IsArray()) {
+      throw std::runtime_error(filename + ": expected each route to have a 'digests' array");
+    }
+
+    for (const auto &digest: route["digests"].GetArray()) {
+      if (!digest.IsObject() || !digest.HasMember("digest") || !digest["digest"].IsString()) {
+        throw std::runtime_error(filename + ": expected each digest to have a 'digest' string");
+      }
+
+      const std::string name(digest["digest"].GetString(), digest["digest"].GetStringLength());
+      DigestProfile &profile = workload[name];
+      profile.count += get_uint_field(digest, "count", filename);
+      profile.rows += get_uint_field(digest, "rows", filename);
+      profile.bytes += get_uint_field(digest, "bytes", filename);
+      profile.returns_rows = digest_returns_rows(name);
+
+      if (digest.HasMember("latencyHistogram")) {
+        const auto &histogram = digest["latencyHistogram"];
+        if (!histogram.IsArray()) {
+          throw std::runtime_error(filename + ": expected 'latencyHistogram' to be an array");
+        }
+        for (rapidjson::SizeType i = 0; i < histogram.Size(); ++i) {
+          if (!histogram[i].IsUint64()) {
+            throw std::runtime_error(filename + ": expected 'latencyHistogram' to hold unsigned numbers");
+          }
+          // a longer histogram adds its larger latencies to the last bucket
+          const size_t bucket = std::min(static_cast<size_t>(i), kLatencyBuckets - 1);
+          profile.latency_histogram[bucket] += histogram[i].GetUint64();
+          profile.latency_samples += histogram[i].GetUint64();
+        }
+      }
+    }
+  }
+
+  return workload;
+}
+
+} // namespace
+
+namespace server_mock {
+
+struct ReplayStatementReader::Pimpl {
+  std::shared_ptr<const Workload> workload_;
+  double time_scale_;
+  std::minstd_rand rng_{std::random_device{}()};
+  std::string digest_;
+
+  Pimpl(const std::string &filename, double time_scale):
+    workload_(load(filename)),
+    time_scale_(time_scale) {}
+
+  static std::shared_ptr<const Workload> load(const std::string &filename) {
+    static FileCache<Workload> cache;
+
+    return cache.get(filename, load_workload);
+  }
+
+  // number of rows of a response, the recorded average
+  uint64_t draw_rows(const DigestProfile &profile) {
+    if (profile.count == 0) return 0;
+
+    const uint64_t rows = profile.rows / profile.count;
+    const uint64_t remainder = profile.rows % profile.count;
+
+    // the fraction decides if a response gets one more row
+    return rows + (std::uniform_int_distribution<uint64_t>(0, profile.count - 1)(rng_) < remainder ? 1 : 0);
+  }
+
+  // a latency of the histogram: a bucket as often as it was hit, any
+  // latency within the bucket
+  std::chrono::microseconds draw_latency(const DigestProfile &profile) {
+    if (profile.latency_samples == 0) return std::chrono::microseconds(0);
+
+    uint64_t sample = std::uniform_int_distribution<uint64_t>(0, profile.latency_samples - 1)(rng_);
+    size_t bucket = 0;
+    while (sample >= profile.latency_histogram[bucket]) {
+      sample -= profile.latency_histogram[bucket];
+      ++bucket;
+    }
+
+    // bucket i holds latencies from 2^(i-1) to below 2^i, bucket 0 those below 1
+    if (bucket == 0) return std::chrono::microseconds(0);
+
+    const double low = static_cast<double>(uint64_t{1} << (bucket - 1));
+    const double latency_us = std::uniform_real_distribution<double>(low, 2 * low)(rng_);
+
+    return std::chrono::microseconds(static_cast<long>(latency_us * time_scale_));
+  }
+};
+
+ReplayStatementReader::ReplayStatementReader(const std::string &filename, double time_scale):
+  pimpl_(new Pimpl(filename, time_scale)) {}
+
+// this is needed for pimpl, otherwise compiler complains
+// about pimpl unknown size in std::unique_ptr
+ReplayStatementReader::~ReplayStatementReader() = default;
+
+StatementAndResponse ReplayStatementReader::handle_statement(const std::string &statement) {
+  StatementAndResponse response;
+
+  make_query_digest(reinterpret_cast<const uint8_t *>(statement.data()), statement.size(),
+                    pimpl_->digest_);
+
+  auto it = pimpl_->workload_->find(pimpl_->digest_);
+  if (it == pimpl_->workload_->end()) {
+    // not part of the workload, like the statements of the connectors
+    response.response_type = StatementAndResponse::StatementResponseType::STMT_RES_OK;
+    response.response.reset(new OkResponse());
+    return response;
+  }
+
+  const DigestProfile &profile = it->second;
+  response.exec_time = pimpl_->draw_latency(profile);
+
+  if (!profile.returns_rows) {
+    response.response_type = StatementAndResponse::StatementResponseType::STMT_RES_OK;
+    response.response.reset(new OkResponse());
+    return response;
+  }
+
+  // one column, the rows make up the recorded size of the responses
+  const uint64_t rows = pimpl_->draw_rows(profile);
+  uint64_t value_size = 0;
+  if (rows > 0) {
+    const uint64_t bytes = profile.bytes / profile.count;
+    if (bytes > kResultsetOverhead + rows * kRowOverhead) {
+      value_size = std::min((bytes - kResultsetOverhead) / rows - kRowOverhead, kMaxValueSize);
+    }
+  }
+
+  std::unique_ptr<ResultsetResponse> resultset(new ResultsetResponse);
+  resultset->columns.push_back(column_info_type{
+      "c", MySQLColumnType::VAR_STRING, "c", "", "", "", "def",
+      0, 0, static_cast<uint32_t>(value_size), 63, 1});
+  resultset->generated_rows = static_cast<size_t>(rows);
+  resultset->generate_row = [value_size](size_t, RowValueType &row) {
+    // all rows are alike, make the value once
+    if (row.empty()) row.emplace_back(true, std::string(static_cast<size_t>(value_size), 'x'));
+  };
+
+  response.response_type = StatementAndResponse::StatementResponseType::STMT_RES_RESULT;
+  response.response = std::move(resultset);
+
+  return response;
+}
+
+std::chrono::microseconds ReplayStatementReader::get_default_exec_time() {
+  return std::chrono::microseconds(0);
+}
+
+} // namespace server_mock
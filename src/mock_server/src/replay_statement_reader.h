@@ -0,0 +1,75 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLD_MOCK_REPLAY_STATEMENT_READER_INCLUDED
+#define MYSQLD_MOCK_REPLAY_STATEMENT_READER_INCLUDED
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "statement_reader.h"
+
+namespace server_mock {
+
+/** @class ReplayStatementReader
+ *
+ * @brief Answers statements like the recorded workload of a route did.
+ *
+ * The workload is the document served by the REST API of the router at
+ * `/api/v1/routing/query_digests/`: per statement digest the number of
+ * sampled statements, their rows, response bytes and latency histogram.
+ *
+ * A received statement gets normalized into its digest. Its response is
+ * a result set, or an OK for statements that don't return rows, like
+ * the recorded ones on average, with an execution time drawn from the
+ * latency histogram. Rows are generated while they get sent. Statements
+ * without a recorded digest get an OK right away.
+ **/
+class ReplayStatementReader: public StatementReaderBase {
+ public:
+  /** @brief Constructor.
+   *
+   * @param filename Path to the recorded workload
+   * @param time_scale factor for the recorded latencies, 0.5 replays
+   *        them twice as fast
+   *
+   * @throws std::runtime_error if the file can't be read or parsed
+   **/
+  ReplayStatementReader(const std::string &filename, double time_scale);
+
+  StatementAndResponse handle_statement(const std::string &statement) override;
+
+  std::chrono::microseconds get_default_exec_time() override;
+
+  ~ReplayStatementReader();
+ private:
+  struct Pimpl;
+  std::unique_ptr<Pimpl> pimpl_;
+};
+
+} // namespace server_mock
+
+#endif // MYSQLD_MOCK_REPLAY_STATEMENT_READER_INCLUDED
@@ -27,6 +27,8 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
+#include <string>
 
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
@@ -57,6 +59,7 @@ IMPORT_LOG_FUNCTIONS()
 static constexpr const char kSectionName[] { "rest_mock_server" };
 static constexpr const char kRestGlobalsUri[] { "^/api/v1/mock_server/globals/$" };
 static constexpr const char kRestConnectionsUri[] { "^/api/v1/mock_server/connections/$" };
+static constexpr const char kRestFaultsUri[] { "^/api/v1/mock_server/faults/[0-9]+$" };
 
 // AddressSanitizer gets confused by the default, MemoryPoolAllocator
 // Solaris sparc also gets crashes
@@ -234,6 +237,181 @@ private:
 
 };
 
+/**
+ * faults injected by the mock server on a port.
+ *
+ * PUT replaces the faults, all members are optional:
+ *
+ *     {"refuseProbability": 0.1, "dropProbability": 0.01,
+ *      "stallProbability": 0.5, "stallMs": 2000, "bandwidth": 1048576,
+ *      "delayMs": 1000, "durationMs": 5000, "seed": 1,
+ *      "globals": {"primary_id": 1}}
+ *
+ * The faults start after delayMs and end after durationMs (never, if not
+ * set), globals get set once they start.
+ */
+class RestApiV1MockServerFaults: public BaseRequestHandler {
+public:
+  // allow methods: GET, PUT, DELETE
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!((HttpMethod::Get|HttpMethod::Put|HttpMethod::Delete) & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET, PUT, DELETE");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    if (req.get_input_headers().get("Content-Range")) {
+      req.send_reply(HttpStatusCode::NotImplemented);
+      return;
+    }
+
+    // the route only matches if the path ends with the port
+    const std::string path = HttpUri::parse(req.get_uri()).get_path();
+    const unsigned long port = std::strtoul(path.substr(path.rfind('/') + 1).c_str(), nullptr, 10);
+
+    auto faults = MockServerComponent::getInstance().get_fault_injector(static_cast<unsigned>(port));
+    if (!faults) {
+      req.send_reply(HttpStatusCode::NotFound);
+      return;
+    }
+
+    if (HttpMethod::Get & req.get_method()) {
+      handle_faults_get(req, *faults);
+    } else if (HttpMethod::Put & req.get_method()) {
+      handle_faults_put(req, *faults);
+    } else {
+      faults->reset();
+      req.send_reply(HttpStatusCode::Ok);
+    }
+  }
+private:
+  static void send_unprocessable(HttpRequest &req, const std::string &msg) {
+    auto out_hdrs = req.get_output_headers();
+    auto out_buf = req.get_output_buffer();
+    out_hdrs.add("Content-Type", "text/plain");
+
+    out_buf.add(msg.data(), msg.size());
+
+    req.send_reply(HttpStatusCode::UnprocessableEntity, "Unprocessable Entity", out_buf);
+  }
+
+  void handle_faults_put(HttpRequest &req, MockServerFaultInjector &injector) {
+    const char *content_type = req.get_input_headers().get("Content-Type");
+    // required content-type: application/json
+    if (nullptr == content_type || std::string(content_type) != "application/json") {
+      req.send_reply(HttpStatusCode::UnsupportedMediaType);
+      return;
+    }
+    auto body = req.get_input_buffer();
+    auto data = body.pop_front(body.length());
+    std::string str_data(data.begin(), data.end());
+
+    JsonDocument body_doc;
+    body_doc.Parse(str_data.c_str());
+
+    if (body_doc.HasParseError()) {
+      send_unprocessable(req, rapidjson::GetParseError_En(body_doc.GetParseError()));
+      return;
+    }
+    if (!body_doc.IsObject()) {
+      send_unprocessable(req, "expected an object");
+      return;
+    }
+
+    MockServerFaults faults;
+    const auto now = MockServerFaults::clock::now();
+    uint64_t delay_ms = 0;
+    uint64_t duration_ms = 0;
+
+    for (auto &m : body_doc.GetObject()) {
+      const std::string name(m.name.GetString(), m.name.GetStringLength());
+
+      if (name == "refuseProbability" || name == "dropProbability" || name == "stallProbability") {
+        if (!m.value.IsNumber() || m.value.GetDouble() < 0 || m.value.GetDouble() > 1) {
+          send_unprocessable(req, name + " must be a number between 0 and 1");
+          return;
+        }
+        const double p = m.value.GetDouble();
+        if (name == "refuseProbability") faults.refuse_probability = p;
+        else if (name == "dropProbability") faults.drop_probability = p;
+        else faults.stall_probability = p;
+      } else if (name == "stallMs" || name == "bandwidth" || name == "delayMs" ||
+                 name == "durationMs" || name == "seed") {
+        if (!m.value.IsUint64()) {
+          send_unprocessable(req, name + " must be an unsigned integer");
+          return;
+        }
+        const uint64_t v = m.value.GetUint64();
+        if (name == "stallMs") faults.stall_duration = std::chrono::milliseconds(v);
+        else if (name == "bandwidth") faults.bandwidth = v;
+        else if (name == "delayMs") delay_ms = v;
+        else if (name == "durationMs") duration_ms = v;
+        else faults.seed = v;
+      } else if (name == "globals") {
+        if (!m.value.IsObject()) {
+          send_unprocessable(req, "globals must be an object");
+          return;
+        }
+        for (auto &g : m.value.GetObject()) {
+          rapidjson::StringBuffer json_buf;
+          rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+          g.value.Accept(json_writer);
+
+          faults.globals[g.name.GetString()] = std::string(json_buf.GetString(), json_buf.GetSize());
+        }
+      } else {
+        send_unprocessable(req, "unknown member: " + name);
+        return;
+      }
+    }
+
+    faults.start = now + std::chrono::milliseconds(delay_ms);
+    if (duration_ms > 0) {
+      faults.end = faults.start + std::chrono::milliseconds(duration_ms);
+    }
+
+    injector.set(std::move(faults));
+
+    req.send_reply(HttpStatusCode::NoContent);
+  }
+
+  void handle_faults_get(HttpRequest &req, MockServerFaultInjector &injector) {
+    auto faults = injector.get_config();
+    const auto now = MockServerFaults::clock::now();
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      if (faults) {
+        json_writer.Key("refuseProbability");
+        json_writer.Double(faults->refuse_probability);
+        json_writer.Key("dropProbability");
+        json_writer.Double(faults->drop_probability);
+        json_writer.Key("stallProbability");
+        json_writer.Double(faults->stall_probability);
+        json_writer.Key("stallMs");
+        json_writer.Uint64(static_cast<uint64_t>(faults->stall_duration.count()));
+        json_writer.Key("bandwidth");
+        json_writer.Uint64(faults->bandwidth);
+      }
+      json_writer.Key("active");
+      json_writer.Bool(faults && faults->is_active(now));
+      json_writer.EndObject();
+    }
+
+    auto chunk = req.get_output_buffer();
+    chunk.add(json_buf.GetString(), json_buf.GetSize());
+
+    auto out_hdrs = req.get_output_headers();
+    out_hdrs.add("Content-Type", "application/json");
+
+    req.send_reply(HttpStatusCode::Ok, "Ok", chunk);
+  }
+};
+
 
 static void init(PluginFuncEnv* env) {
   const mysql_harness::AppInfo* info = get_app_info(env);
@@ -256,11 +434,13 @@ static void start(PluginFuncEnv*) {
 
   srv.add_route(kRestGlobalsUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1MockServerGlobals()));
   srv.add_route(kRestConnectionsUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1MockServerConnections()));
+  srv.add_route(kRestFaultsUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1MockServerFaults()));
 }
 
 static void stop(PluginFuncEnv*) {
   auto &srv = HttpServerComponent::getInstance();
 
+  srv.remove_route(kRestFaultsUri);
   srv.remove_route(kRestConnectionsUri);
   srv.remove_route(kRestGlobalsUri);
 }
@@ -0,0 +1,154 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "row_generator.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace server_mock {
+
+namespace {
+
+constexpr uint32_t kMaxRandomStringLength = 256;
+constexpr uint32_t kDefaultRandomStringLength = 16;
+
+/** @brief splitmix64, a cheap hash that gives every cell its own value */
+uint64_t mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+std::string random_integer(uint64_t value, uint64_t max) {
+  return std::to_string(value % (max + 1));
+}
+
+std::string random_number(uint64_t value, uint8_t decimals) {
+  std::string s = std::to_string(value % 1000000);
+  // the server sends 31 for "not fixed" decimals of FLOAT and DOUBLE
+  if (decimals > 0 && decimals < 31) {
+    s += '.';
+    for (uint8_t i = 0; i < decimals; ++i) {
+      value = mix(value);
+      s += static_cast<char>('0' + value % 10);
+    }
+  }
+  return s;
+}
+
+std::string random_date(uint64_t value) {
+  char buf[sizeof("YYYY-MM-DD")];
+  snprintf(buf, sizeof(buf), "%04u-%02u-%02u",
+           static_cast<unsigned>(1970 + value % 100),
+           static_cast<unsigned>(1 + (value >> 8) % 12),
+           static_cast<unsigned>(1 + (value >> 16) % 28));
+  return buf;
+}
+
+std::string random_time(uint64_t value) {
+  char buf[sizeof("hh:mm:ss")];
+  snprintf(buf, sizeof(buf), "%02u:%02u:%02u",
+           static_cast<unsigned>(value % 24),
+           static_cast<unsigned>((value >> 8) % 60),
+           static_cast<unsigned>((value >> 16) % 60));
+  return buf;
+}
+
+std::string random_string(uint64_t value, uint32_t length) {
+  static const char kChars[] =
+      "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+  if (length == 0) length = kDefaultRandomStringLength;
+  if (length > kMaxRandomStringLength) length = kMaxRandomStringLength;
+
+  std::string s(length, ' ');
+  for (auto &c : s) {
+    value = mix(value);
+    c = kChars[value % (sizeof(kChars) - 1)];
+  }
+  return s;
+}
+
+std::pair<bool, std::string> random_value(const column_info_type &column, uint64_t value) {
+  switch (column.type) {
+  case MySQLColumnType::NULL_:
+    return {false, ""};
+  case MySQLColumnType::TINY:
+    return {true, random_integer(value, 127)};
+  case MySQLColumnType::SHORT:
+    return {true, random_integer(value, 32767)};
+  case MySQLColumnType::INT24:
+    return {true, random_integer(value, 8388607)};
+  case MySQLColumnType::LONG:
+    return {true, random_integer(value, 2147483647)};
+  case MySQLColumnType::LONGLONG:
+    return {true, random_integer(value, 9223372036854775807ULL)};
+  case MySQLColumnType::YEAR:
+    return {true, std::to_string(1970 + value % 100)};
+  case MySQLColumnType::DECIMAL:
+  case MySQLColumnType::NEWDECIMAL:
+  case MySQLColumnType::FLOAT:
+  case MySQLColumnType::DOUBLE:
+    return {true, random_number(value, column.decimals)};
+  case MySQLColumnType::DATE:
+  case MySQLColumnType::NEWDATE:
+    return {true, random_date(value)};
+  case MySQLColumnType::TIME:
+    return {true, random_time(value)};
+  case MySQLColumnType::DATETIME:
+  case MySQLColumnType::TIMESTAMP:
+    return {true, random_date(value) + " " + random_time(value >> 24)};
+  default:
+    return {true, random_string(value, column.length)};
+  }
+}
+
+} // namespace
+
+RowGenerator make_repeat_row_generator(std::vector<RowValueType> templates) {
+  if (templates.empty()) {
+    throw std::invalid_argument("no rows to repeat");
+  }
+
+  return [templates](size_t ndx, RowValueType &row) {
+    row = templates[ndx % templates.size()];
+  };
+}
+
+RowGenerator make_random_row_generator(const std::vector<column_info_type> &columns,
+                                       uint64_t seed) {
+  return [columns, seed](size_t ndx, RowValueType &row) {
+    row.resize(columns.size());
+    const uint64_t row_seed = mix(seed ^ mix(static_cast<uint64_t>(ndx)));
+    for (size_t i = 0; i < columns.size(); ++i) {
+      row[i] = random_value(columns[i], mix(row_seed + i));
+    }
+  };
+}
+
+} // namespace server_mock
@@ -0,0 +1,60 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLD_MOCK_ROW_GENERATOR_INCLUDED
+#define MYSQLD_MOCK_ROW_GENERATOR_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "mysql_protocol_common.h"
+
+namespace server_mock {
+
+/** @brief fills in the row of the given index */
+using RowGenerator = std::function<void(size_t ndx, RowValueType &row)>;
+
+/** @brief makes a generator that repeats the template rows
+ *
+ * Row ndx is a copy of template row ndx modulo the number of templates.
+ *
+ * @throws std::invalid_argument if there are no templates
+ */
+RowGenerator make_repeat_row_generator(std::vector<RowValueType> templates);
+
+/** @brief makes a generator of random values that fit the column types
+ *
+ * The same seed makes the same rows, whatever order they get generated in.
+ * Numbers and dates get formatted as the server would, strings are
+ * alphanumeric and as long as the column (at most 256 characters, 16 if
+ * the column has no length).
+ */
+RowGenerator make_random_row_generator(const std::vector<column_info_type> &columns,
+                                       uint64_t seed);
+
+} // namespace server_mock
+
+#endif // MYSQLD_MOCK_ROW_GENERATOR_INCLUDED
@@ -26,6 +26,7 @@
 #define MYSQLD_MOCK_STATEMENT_READER_INCLUDED
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -44,6 +45,13 @@ struct Response {
 struct ResultsetResponse : public Response {
   std::vector<column_info_type> columns;
   std::vector<RowValueType> rows;
+
+  /** @brief number of rows made by generate_row(), sent after rows */
+  size_t generated_rows{0};
+
+  /** @brief fills in the row of the given index, the row is reused
+   *         for all generated rows to not keep them in memory */
+  std::function<void(size_t ndx, RowValueType &row)> generate_row;
 };
 
 struct OkResponse : public Response {
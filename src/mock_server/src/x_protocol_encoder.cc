@@ -0,0 +1,305 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "x_protocol_encoder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __GNUC__
+// disable -Wconversion for protobuf 2.6.
+// this can be removed with protobuf 3.0.x and later
+#pragma GCC diagnostic push
+#pragma GCC diagnostic warning "-Wconversion"
+#endif
+#include "mysqlx.pb.h"
+#include "mysqlx_connection.pb.h"
+#include "mysqlx_datatypes.pb.h"
+#include "mysqlx_notice.pb.h"
+#include "mysqlx_resultset.pb.h"
+#include "mysqlx_session.pb.h"
+#include "mysqlx_sql.pb.h"
+#include <google/protobuf/io/coded_stream.h>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+namespace server_mock {
+
+using google::protobuf::io::CodedOutputStream;
+using FieldType = Mysqlx::Resultset::ColumnMetaData::FieldType;
+
+namespace {
+
+constexpr uint16_t kUnsignedFlag = 0x20;
+constexpr size_t kHeaderSize = 5;  // length and type
+constexpr size_t kMaxVarintSize = 10;
+
+FieldType x_field_type(const column_info_type &column) {
+  switch (column.type) {
+  case MySQLColumnType::TINY:
+  case MySQLColumnType::SHORT:
+  case MySQLColumnType::INT24:
+  case MySQLColumnType::LONG:
+  case MySQLColumnType::LONGLONG:
+  case MySQLColumnType::YEAR:
+    return (column.flags & kUnsignedFlag) ? Mysqlx::Resultset::ColumnMetaData::UINT
+                                          : Mysqlx::Resultset::ColumnMetaData::SINT;
+  case MySQLColumnType::FLOAT:
+    return Mysqlx::Resultset::ColumnMetaData::FLOAT;
+  case MySQLColumnType::DOUBLE:
+    return Mysqlx::Resultset::ColumnMetaData::DOUBLE;
+  default:
+    return Mysqlx::Resultset::ColumnMetaData::BYTES;
+  }
+}
+
+void append_varint(std::string &out, uint64_t value) {
+  uint8_t buf[kMaxVarintSize];
+  uint8_t *end = CodedOutputStream::WriteVarint64ToArray(value, buf);
+  out.append(reinterpret_cast<char *>(buf), static_cast<size_t>(end - buf));
+}
+
+void append_varint(XProtocolEncoder::MsgBuffer &out, uint64_t value) {
+  uint8_t buf[kMaxVarintSize];
+  uint8_t *end = CodedOutputStream::WriteVarint64ToArray(value, buf);
+  out.insert(out.end(), buf, end);
+}
+
+/** @brief the value of a Row field, as the X protocol encodes its type */
+void encode_field(std::string &out, const column_info_type &column, const std::string &value) {
+  out.clear();
+
+  try {
+    switch (x_field_type(column)) {
+    case Mysqlx::Resultset::ColumnMetaData::SINT: {
+      const int64_t v = std::stoll(value);
+      // zigzag
+      append_varint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+      break;
+    }
+    case Mysqlx::Resultset::ColumnMetaData::UINT:
+      append_varint(out, std::stoull(value));
+      break;
+    case Mysqlx::Resultset::ColumnMetaData::DOUBLE: {
+      const double v = std::stod(value);
+      uint64_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      uint8_t buf[sizeof(bits)];
+      CodedOutputStream::WriteLittleEndian64ToArray(bits, buf);
+      out.append(reinterpret_cast<char *>(buf), sizeof(buf));
+      break;
+    }
+    case Mysqlx::Resultset::ColumnMetaData::FLOAT: {
+      const float v = std::stof(value);
+      uint32_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      uint8_t buf[sizeof(bits)];
+      CodedOutputStream::WriteLittleEndian32ToArray(bits, buf);
+      out.append(reinterpret_cast<char *>(buf), sizeof(buf));
+      break;
+    }
+    default:
+      // bytes get a trailing \0 to tell them from NULL, which is empty
+      out.append(value);
+      out.push_back('\0');
+    }
+  } catch (const std::logic_error &) {
+    // std::invalid_argument and std::out_of_range of the conversions
+    throw std::runtime_error("value '" + value + "' of column '" + column.name + "' is not a number");
+  }
+}
+
+} // namespace
+
+void XProtocolEncoder::append_message(MsgBuffer &out_buffer, uint8_t type,
+                                      const google::protobuf::MessageLite &msg) {
+  const size_t msg_size = static_cast<size_t>(msg.ByteSize());
+  const size_t msg_start = out_buffer.size();
+
+  out_buffer.resize(msg_start + kHeaderSize + msg_size);
+  // the length covers the type, but not itself
+  CodedOutputStream::WriteLittleEndian32ToArray(static_cast<uint32_t>(msg_size + 1),
+                                                &out_buffer[msg_start]);
+  out_buffer[msg_start + 4] = type;
+  if (msg_size > 0) {
+    msg.SerializeWithCachedSizesToArray(&out_buffer[msg_start + kHeaderSize]);
+  }
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_ok_message(const std::string &msg) {
+  Mysqlx::Ok ok;
+  if (!msg.empty()) ok.set_msg(msg);
+
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::OK, ok);
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_error_message(uint16_t error_code,
+    const std::string &sql_state,
+    const std::string &error_msg,
+    bool fatal) {
+  Mysqlx::Error error;
+  error.set_severity(fatal ? Mysqlx::Error::FATAL : Mysqlx::Error::ERROR);
+  error.set_code(error_code);
+  error.set_sql_state(sql_state);
+  error.set_msg(error_msg);
+
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::ERROR, error);
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_capabilities_message() {
+  Mysqlx::Connection::Capabilities capabilities;
+
+  auto add_string = [&capabilities](const std::string &name, const std::string &value) {
+    auto *cap = capabilities.add_capabilities();
+    cap->set_name(name);
+    auto *any = cap->mutable_value();
+    any->set_type(Mysqlx::Datatypes::Any::SCALAR);
+    any->mutable_scalar()->set_type(Mysqlx::Datatypes::Scalar::V_STRING);
+    any->mutable_scalar()->mutable_v_string()->set_value(value);
+    return cap;
+  };
+
+  auto *mechanisms = capabilities.add_capabilities();
+  mechanisms->set_name("authentication.mechanisms");
+  mechanisms->mutable_value()->set_type(Mysqlx::Datatypes::Any::ARRAY);
+  for (const char *mech : {"MYSQL41", "PLAIN"}) {
+    auto *value = mechanisms->mutable_value()->mutable_array()->add_value();
+    value->set_type(Mysqlx::Datatypes::Any::SCALAR);
+    value->mutable_scalar()->set_type(Mysqlx::Datatypes::Scalar::V_STRING);
+    value->mutable_scalar()->mutable_v_string()->set_value(mech);
+  }
+  add_string("doc.formats", "text");
+  add_string("node_type", "mysql");
+
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::CONN_CAPABILITIES, capabilities);
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_auth_continue_message(const std::string &auth_data) {
+  Mysqlx::Session::AuthenticateContinue auth_continue;
+  auth_continue.set_auth_data(auth_data);
+
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::SESS_AUTHENTICATE_CONTINUE, auth_continue);
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_auth_ok_message() {
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::SESS_AUTHENTICATE_OK,
+                 Mysqlx::Session::AuthenticateOk());
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_generated_insert_id_notice(uint64_t last_insert_id) {
+  Mysqlx::Notice::SessionStateChanged state_changed;
+  state_changed.set_param(Mysqlx::Notice::SessionStateChanged::GENERATED_INSERT_ID);
+  state_changed.mutable_value()->set_type(Mysqlx::Datatypes::Scalar::V_UINT);
+  state_changed.mutable_value()->set_v_unsigned_int(last_insert_id);
+
+  Mysqlx::Notice::Frame frame;
+  frame.set_type(3);  // SessionStateChanged
+  frame.set_scope(Mysqlx::Notice::Frame::LOCAL);
+  frame.set_payload(state_changed.SerializeAsString());
+
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::NOTICE, frame);
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_column_meta_message(const column_info_type &column) {
+  Mysqlx::Resultset::ColumnMetaData meta;
+  meta.set_type(x_field_type(column));
+  meta.set_name(column.name);
+  meta.set_original_name(column.orig_name);
+  meta.set_table(column.table);
+  meta.set_original_table(column.orig_table);
+  meta.set_schema(column.schema);
+  meta.set_catalog(column.catalog);
+  if (meta.type() == Mysqlx::Resultset::ColumnMetaData::BYTES) {
+    meta.set_collation(column.character_set);
+  }
+  meta.set_fractional_digits(column.decimals);
+  meta.set_length(column.length);
+  meta.set_flags(column.flags);
+
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::RESULTSET_COLUMN_META_DATA, meta);
+  return out_buffer;
+}
+
+void XProtocolEncoder::append_row_message(MsgBuffer &out_buffer,
+    const std::vector<column_info_type> &columns_info,
+    const RowValueType &row_values) {
+  if (columns_info.size() != row_values.size()) {
+    throw std::runtime_error(std::string("columns_info.size() != row_values.size() ")
+              + std::to_string(columns_info.size())
+              + std::string("!=") +  std::to_string(row_values.size()));
+  }
+
+  // Row is a "repeated bytes field = 1", encoded in place instead of
+  // through a Mysqlx::Resultset::Row to not allocate for each row
+  const size_t msg_start = out_buffer.size();
+  out_buffer.resize(msg_start + kHeaderSize);
+
+  for (size_t i = 0; i < row_values.size(); ++i) {
+    if (row_values[i].first) {
+      encode_field(field_, columns_info[i], row_values[i].second);
+    } else {
+      field_.clear();  // NULL
+    }
+
+    out_buffer.push_back(0x0a);  // field 1, length-delimited
+    append_varint(out_buffer, field_.size());
+    out_buffer.insert(out_buffer.end(), field_.begin(), field_.end());
+  }
+
+  const size_t msg_size = out_buffer.size() - msg_start - kHeaderSize;
+  CodedOutputStream::WriteLittleEndian32ToArray(static_cast<uint32_t>(msg_size + 1),
+                                                &out_buffer[msg_start]);
+  out_buffer[msg_start + 4] = Mysqlx::ServerMessages::RESULTSET_ROW;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_fetch_done_message() {
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::RESULTSET_FETCH_DONE,
+                 Mysqlx::Resultset::FetchDone());
+  return out_buffer;
+}
+
+XProtocolEncoder::MsgBuffer XProtocolEncoder::encode_stmt_execute_ok_message() {
+  MsgBuffer out_buffer;
+  append_message(out_buffer, Mysqlx::ServerMessages::SQL_STMT_EXECUTE_OK,
+                 Mysqlx::Sql::StmtExecuteOk());
+  return out_buffer;
+}
+
+} // namespace server_mock
@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLD_MOCK_X_PROTOCOL_ENCODER_INCLUDED
+#define MYSQLD_MOCK_X_PROTOCOL_ENCODER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "mysql_protocol_common.h"
+
+namespace google { namespace protobuf { class MessageLite; } }
+
+namespace server_mock {
+
+/** @class XProtocolEncoder
+ *
+ * @brief Encodes the X protocol messages the mock server sends.
+ *
+ * Each message is framed with its 4 byte length and its type.
+ **/
+class XProtocolEncoder {
+public:
+  using MsgBuffer = std::vector<byte>;
+
+  /** @brief Encodes Mysqlx.Ok */
+  MsgBuffer encode_ok_message(const std::string &msg = "");
+
+  /** @brief Encodes Mysqlx.Error
+   *
+   * @param error_code  code of the reported error
+   * @param sql_state   SQL state to report
+   * @param error_msg   error message
+   * @param fatal       the server closes the connection after the error
+   **/
+  MsgBuffer encode_error_message(uint16_t error_code,
+                                 const std::string &sql_state,
+                                 const std::string &error_msg,
+                                 bool fatal = false);
+
+  /** @brief Encodes Mysqlx.Connection.Capabilities, the capabilities of
+   *         the mock server */
+  MsgBuffer encode_capabilities_message();
+
+  /** @brief Encodes Mysqlx.Session.AuthenticateContinue */
+  MsgBuffer encode_auth_continue_message(const std::string &auth_data);
+
+  /** @brief Encodes Mysqlx.Session.AuthenticateOk */
+  MsgBuffer encode_auth_ok_message();
+
+  /** @brief Encodes the Mysqlx.Notice.Frame of a GENERATED_INSERT_ID */
+  MsgBuffer encode_generated_insert_id_notice(uint64_t last_insert_id);
+
+  /** @brief Encodes Mysqlx.Resultset.ColumnMetaData
+   *
+   * Integer columns are sent as SINT (UINT with the UNSIGNED flag), FLOAT
+   * and DOUBLE columns as such, all other columns as BYTES.
+   **/
+  MsgBuffer encode_column_meta_message(const column_info_type &column);
+
+  /** @brief Encodes Mysqlx.Resultset.Row at the end of a buffer
+   *
+   * @param out_buffer    buffer the message gets appended to
+   * @param columns_info  vector with column metadata for consecutive row fields
+   * @param row_values    vector with values (as string) for the consecutive row fields
+   *
+   * @throws std::runtime_error if a value doesn't fit its column type
+   **/
+  void append_row_message(MsgBuffer &out_buffer,
+                          const std::vector<column_info_type> &columns_info,
+                          const RowValueType &row_values);
+
+  /** @brief Encodes Mysqlx.Resultset.FetchDone */
+  MsgBuffer encode_fetch_done_message();
+
+  /** @brief Encodes Mysqlx.Sql.StmtExecuteOk */
+  MsgBuffer encode_stmt_execute_ok_message();
+
+private:
+  /** @brief appends a message with its frame header */
+  void append_message(MsgBuffer &out_buffer, uint8_t type,
+                      const google::protobuf::MessageLite &msg);
+
+  std::string field_;
+};
+
+} // namespace server_mock
+
+#endif // MYSQLD_MOCK_X_PROTOCOL_ENCODER_INCLUDED
@@ -0,0 +1,275 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "x_protocol_session.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include "mysql_protocol_utils.h"
+#include "mysql/harness/logging/logging.h"
+IMPORT_LOG_FUNCTIONS()
+
+#ifdef __GNUC__
+// disable -Wconversion for protobuf 2.6.
+// this can be removed with protobuf 3.0.x and later
+#pragma GCC diagnostic push
+#pragma GCC diagnostic warning "-Wconversion"
+#endif
+#include "mysqlx.pb.h"
+#include "mysqlx_connection.pb.h"
+#include "mysqlx_session.pb.h"
+#include "mysqlx_sql.pb.h"
+#include <google/protobuf/io/coded_stream.h>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+namespace server_mock {
+
+// error codes of the X plugin
+constexpr uint16_t kErXBadMessage = 5000;
+constexpr uint16_t kErXCapabilitiesPrepareFailed = 5001;
+constexpr uint16_t kErNotSupportedAuthMode = 1251;
+
+constexpr size_t kFrameHeaderSize = 5;  // length and type
+constexpr char kAuthSalt[] = "mock-server-salt-x20";  // 20 bytes, as MYSQL41 expects
+
+static uint32_t frame_size(const uint8_t *data) {
+  uint32_t size;
+  google::protobuf::io::CodedInputStream::ReadLittleEndian32FromArray(data, &size);
+  return size;
+}
+
+MySQLServerMockSessionX::MySQLServerMockSessionX(
+    socket_t client_sock,
+    std::unique_ptr<StatementReaderBase> statement_processor,
+    bool debug_mode, bool event_driven):
+  MySQLServerMockSession(client_sock, std::move(statement_processor), debug_mode, event_driven)
+{
+}
+
+void MySQLServerMockSessionX::run() {
+  try {
+    while (!killed_ && !done_) {
+      // one frame at a time, handle_packet() finds it at recv_pos_
+      recv_buf_.resize(4);
+      recv_pos_ = 0;
+      read_packet(client_socket_, recv_buf_.data(), 4);
+      recv_buf_.resize(4 + frame_size(recv_buf_.data()));
+      read_packet(client_socket_, recv_buf_.data() + 4, recv_buf_.size() - 4);
+
+      if (!handle_packet()) done_ = true;
+    }
+  }
+  catch (const std::exception &e) {
+    log_warning("Exception caught in connection loop: %s", e.what());
+  }
+}
+
+void MySQLServerMockSessionX::start() {
+}
+
+bool MySQLServerMockSessionX::has_packet() const {
+  const size_t available = recv_buf_.size() - recv_pos_;
+  if (available < 4) return false;
+
+  return available >= 4 + static_cast<size_t>(frame_size(recv_buf_.data() + recv_pos_));
+}
+
+bool MySQLServerMockSessionX::handle_packet() {
+  const uint8_t *frame = recv_buf_.data() + recv_pos_;
+  const size_t size = frame_size(frame);
+  if (size == 0) {
+    throw std::runtime_error("X protocol frame without message type");
+  }
+  recv_pos_ += 4 + size;
+
+  return handle_message(frame[4], frame + kFrameHeaderSize, size - 1);
+}
+
+bool MySQLServerMockSessionX::handle_message(uint8_t msg_type, const uint8_t *payload,
+                                             size_t payload_size) {
+  const int size = static_cast<int>(payload_size);
+
+  switch (msg_type) {
+  case Mysqlx::ClientMessages::CON_CAPABILITIES_GET:
+    send_packet(client_socket_, protocol_encoder_.encode_capabilities_message());
+    break;
+  case Mysqlx::ClientMessages::CON_CAPABILITIES_SET: {
+    Mysqlx::Connection::CapabilitiesSet capabilities_set;
+    if (!capabilities_set.ParseFromArray(payload, size)) {
+      send_error(kErXBadMessage, "Invalid message");
+      return false;
+    }
+    for (const auto &cap: capabilities_set.capabilities().capabilities()) {
+      if (cap.name() == "tls") {
+        // the mock server doesn't do TLS
+        send_error(kErXCapabilitiesPrepareFailed, "Capability prepare failed for 'tls'");
+        return true;
+      }
+    }
+    send_packet(client_socket_, protocol_encoder_.encode_ok_message());
+    break;
+  }
+  case Mysqlx::ClientMessages::SESS_AUTHENTICATE_START: {
+    Mysqlx::Session::AuthenticateStart auth_start;
+    if (!auth_start.ParseFromArray(payload, size)) {
+      send_error(kErXBadMessage, "Invalid message");
+      return false;
+    }
+    // any credentials are fine
+    if (auth_start.mech_name() == "MYSQL41" || auth_start.mech_name() == "SHA256_MEMORY") {
+      send_packet(client_socket_, protocol_encoder_.encode_auth_continue_message(
+          std::string(kAuthSalt, sizeof(kAuthSalt) - 1)));
+    } else if (auth_start.mech_name() == "PLAIN") {
+      send_packet(client_socket_, protocol_encoder_.encode_auth_ok_message());
+    } else {
+      send_error(kErNotSupportedAuthMode, "Invalid authentication method " + auth_start.mech_name());
+    }
+    break;
+  }
+  case Mysqlx::ClientMessages::SESS_AUTHENTICATE_CONTINUE:
+    send_packet(client_socket_, protocol_encoder_.encode_auth_ok_message());
+    break;
+  case Mysqlx::ClientMessages::SQL_STMT_EXECUTE: {
+    Mysqlx::Sql::StmtExecute stmt_execute;
+    if (!stmt_execute.ParseFromArray(payload, size)) {
+      send_error(kErXBadMessage, "Invalid message");
+      return false;
+    }
+
+    if (stmt_execute.namespace_() != "sql") {
+      // admin commands like "ping" of the "mysqlx" namespace
+      send_packet(client_socket_, protocol_encoder_.encode_stmt_execute_ok_message());
+      break;
+    }
+
+    if (!inject_faults()) return false;
+
+    try {
+      handle_statement(stmt_execute.stmt());
+    } catch (const std::exception &e) {
+      // handling statement failed. Return the error to the client
+      pending_resultset_.reset();
+      wait_exec_time(json_reader_->get_default_exec_time());
+      send_error(1064, std::string("executing statement failed: ") + e.what());
+
+      // assume the connection is broken
+      return false;
+    }
+    break;
+  }
+  case Mysqlx::ClientMessages::SESS_RESET:
+  case Mysqlx::ClientMessages::SESS_CLOSE:
+  case Mysqlx::ClientMessages::EXPECT_OPEN:
+  case Mysqlx::ClientMessages::EXPECT_CLOSE:
+    send_packet(client_socket_, protocol_encoder_.encode_ok_message());
+    break;
+  case Mysqlx::ClientMessages::CON_CLOSE:
+    send_packet(client_socket_, protocol_encoder_.encode_ok_message("bye!"));
+    return false;
+  default:
+    std::cerr << "received unsupported message from the client: "
+              << static_cast<int>(msg_type) << "\n";
+    send_error(kErXBadMessage, "Unexpected message received");
+  }
+
+  return true;
+}
+
+void MySQLServerMockSessionX::handle_statement(const std::string &statement) {
+  using StatementResponseType = StatementAndResponse::StatementResponseType;
+
+  StatementAndResponse stmt = json_reader_->handle_statement(statement);
+
+  switch (stmt.response_type) {
+  case StatementResponseType::STMT_RES_OK: {
+    if (debug_mode_) std::cout << std::endl;  // visual separator
+    OkResponse *response = dynamic_cast<OkResponse *>(stmt.response.get());
+    wait_exec_time(stmt.exec_time);
+    if (response->last_insert_id != 0) {
+      send_packet(client_socket_,
+          protocol_encoder_.encode_generated_insert_id_notice(response->last_insert_id));
+    }
+    send_packet(client_socket_, protocol_encoder_.encode_stmt_execute_ok_message());
+  }
+  break;
+  case StatementResponseType::STMT_RES_RESULT: {
+    ResultsetResponse *response = dynamic_cast<ResultsetResponse *>(stmt.response.get());
+    if (debug_mode_) {
+      std::cout << "QUERY RESULT: " << response->rows.size() + response->generated_rows
+                << " rows\n\n\n" << std::flush;
+    }
+    wait_exec_time(stmt.exec_time);
+    for (const auto& column: response->columns) {
+      send_packet(client_socket_, protocol_encoder_.encode_column_meta_message(column));
+    }
+
+    row_buf_.clear();
+    for (const auto &row: response->rows) {
+      protocol_encoder_.append_row_message(row_buf_, response->columns, row);
+    }
+    send_packet(client_socket_, row_buf_);
+
+    if (response->generated_rows > 0) {
+      pending_resultset_ = std::move(stmt.response);
+      pending_row_ = 0;
+      send_generated_rows(client_socket_);
+    } else {
+      send_resultset_end(client_socket_);
+    }
+  }
+  break;
+  case StatementResponseType::STMT_RES_ERROR: {
+    if (debug_mode_) std::cout << std::endl;  // visual separator
+    ErrorResponse *response = dynamic_cast<ErrorResponse *>(stmt.response.get());
+    send_error(static_cast<uint16_t>(response->code), response->msg, response->sql_state);
+  }
+  break;
+  default:;
+    throw std::runtime_error("Unsupported command in handle_statement(): " +
+      std::to_string((int)stmt.response_type));
+  }
+}
+
+void MySQLServerMockSessionX::append_row(std::vector<uint8_t> &buf,
+    const std::vector<column_info_type> &columns,
+    const RowValueType &row) {
+  protocol_encoder_.append_row_message(buf, columns, row);
+}
+
+void MySQLServerMockSessionX::send_resultset_end(socket_t client_socket) {
+  send_packet(client_socket, protocol_encoder_.encode_fetch_done_message());
+  send_packet(client_socket, protocol_encoder_.encode_stmt_execute_ok_message());
+}
+
+void MySQLServerMockSessionX::send_error(uint16_t error_code,
+                                         const std::string &error_msg,
+                                         const std::string &sql_state) {
+  send_packet(client_socket_, protocol_encoder_.encode_error_message(error_code, sql_state, error_msg));
+}
+
+} // namespace server_mock
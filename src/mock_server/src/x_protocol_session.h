@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLD_MOCK_X_PROTOCOL_SESSION_INCLUDED
+#define MYSQLD_MOCK_X_PROTOCOL_SESSION_INCLUDED
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mysql_server_mock.h"
+#include "x_protocol_encoder.h"
+
+namespace server_mock {
+
+/** @class MySQLServerMockSessionX
+ *
+ * @brief Session of a X protocol client.
+ *
+ * Negotiates the capabilities, accepts any credentials of the MYSQL41,
+ * SHA256_MEMORY and PLAIN authentication and answers the SQL statements
+ * from the statement reader, like the classic session does.
+ **/
+class MySQLServerMockSessionX : public MySQLServerMockSession {
+public:
+  MySQLServerMockSessionX(socket_t client_sock,
+      std::unique_ptr<StatementReaderBase> statement_processor,
+      bool debug_mode, bool event_driven = false);
+
+  void run() override;
+
+  /** @brief the client speaks first, nothing to send */
+  void start() override;
+
+private:
+  bool has_packet() const override;
+  bool handle_packet() override;
+  void append_row(std::vector<uint8_t> &buf,
+                  const std::vector<column_info_type> &columns,
+                  const RowValueType &row) override;
+  void send_resultset_end(socket_t client_socket) override;
+
+  /** @brief handles a message of the client
+   *
+   * @returns false if the session ends
+   */
+  bool handle_message(uint8_t msg_type, const uint8_t *payload, size_t payload_size);
+
+  void handle_statement(const std::string &statement);
+
+  void send_error(uint16_t error_code, const std::string &error_msg,
+                  const std::string &sql_state = "HY000");
+
+  XProtocolEncoder protocol_encoder_;
+};
+
+} // namespace server_mock
+
+#endif // MYSQLD_MOCK_X_PROTOCOL_SESSION_INCLUDED
@@ -44,8 +44,12 @@
 
 #include "mysql_protocol/constants.h" // comes first
 #include "mysql_protocol/base_packet.h"
+#include "mysql_protocol/packet_view.h"
+#include "mysql_protocol/packet_writer.h"
+#include "mysql_protocol/text_row_scanner.h"
 #include "mysql_protocol/error_packet.h"
 #include "mysql_protocol/handshake_packet.h"
+#include "mysql_protocol/change_user_packet.h"
 
 namespace mysql_protocol {
 
@@ -0,0 +1,95 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_MYSQL_PROTOCOL_CHANGE_USER_PACKET_INCLUDED
+#define MYSQLROUTER_MYSQL_PROTOCOL_CHANGE_USER_PACKET_INCLUDED
+
+#include "base_packet.h"
+
+namespace mysql_protocol {
+
+/** @class ChangeUserPacket
+ * @brief Creates a MySQL COM_CHANGE_USER packet
+ *
+ * This class creates a COM_CHANGE_USER command which re-authenticates an
+ * established session as another user and resets its state.
+ *
+ * The layout of the packet depends on the capabilities negotiated when the
+ * session was established, which have to be passed to the constructor.
+ */
+class MYSQL_PROTOCOL_API ChangeUserPacket final : public Packet {
+ public:
+  /** @brief COM_CHANGE_USER command byte */
+  static constexpr uint8_t kCommand = 0x11;
+
+  /** @brief Constructor
+   *
+   * @param sequence_id MySQL Packet number
+   * @param username user to authenticate as
+   * @param auth_response authentication data computed by the client
+   * @param database default schema, can be empty
+   * @param char_set character set of the session
+   * @param auth_plugin authentication plugin auth_response was computed with
+   * @param connection_attrs serialized connection attributes including their
+   *        length-encoded total length; sent only if CONNECT_ATTRS capability is set
+   * @param capabilities capability flags of the session
+   */
+  ChangeUserPacket(uint8_t sequence_id, const std::string &username,
+                   const std::vector<uint8_t> &auth_response,
+                   const std::string &database, uint16_t char_set,
+                   const std::string &auth_plugin,
+                   const std::vector<uint8_t> &connection_attrs,
+                   Capabilities::Flags capabilities);
+
+ private:
+  /** @brief Prepares the packet
+   *
+   * Prepares the actual MySQL COM_CHANGE_USER packet and stores it. The header
+   * is created using the sequence id and the size of the payload.
+   */
+  void prepare_packet();
+
+  /** @brief MySQL username */
+  std::string username_;
+
+  /** @brief authentication data */
+  std::vector<uint8_t> auth_response_;
+
+  /** @brief default schema */
+  std::string database_;
+
+  /** @brief character set */
+  uint16_t char_set_;
+
+  /** @brief authentication plugin name */
+  std::string auth_plugin_;
+
+  /** @brief serialized connection attributes */
+  std::vector<uint8_t> connection_attrs_;
+};
+
+} // namespace mysql_protocol
+
+#endif // MYSQLROUTER_MYSQL_PROTOCOL_CHANGE_USER_PACKET_INCLUDED
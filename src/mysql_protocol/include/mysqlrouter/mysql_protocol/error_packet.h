@@ -96,6 +96,31 @@ class MYSQL_PROTOCOL_API ErrorPacket final : public Packet {
     return sql_state_;
   }
 
+  /** @brief Gets the payload size of an error packet
+   *
+   * @param err_msg Error message provided to MySQL client
+   * @param capabilities Server/Client capability flags (default 0)
+   */
+  static size_t payload_size(const std::string &err_msg,
+                             Capabilities::Flags capabilities = Capabilities::ALL_ZEROS) noexcept;
+
+  /** @brief Writes an error packet without creating an ErrorPacket
+   *
+   * Writes the same bytes the constructor creates.
+   *
+   * @param writer where to write the packet
+   * @param sequence_id MySQL Packet number
+   * @param err_code Error code provided to MySQL client
+   * @param err_msg Error message provided to MySQL client
+   * @param sql_state SQL State used in error message
+   * @param capabilities Server/Client capability flags (default 0)
+   *
+   * @throws std::range_error if the buffer of the writer is too small
+   */
+  static void write(PacketWriter &writer, uint8_t sequence_id, uint16_t err_code,
+                    const std::string &err_msg, const std::string &sql_state,
+                    Capabilities::Flags capabilities = Capabilities::ALL_ZEROS);
+
  private:
   /** @brief Prepares the packet
    *
@@ -0,0 +1,231 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_MYSQL_PROTOCOL_PACKET_VIEW_INCLUDED
+#define MYSQLROUTER_MYSQL_PROTOCOL_PACKET_VIEW_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "harness_assert.h"
+
+namespace mysql_protocol {
+
+/** @class BytesView
+ * @brief Borrowed bytes, e.g. a field of a packet
+ *
+ * The memory has to outlive the view.
+ */
+class BytesView {
+ public:
+  BytesView() = default;
+  BytesView(const uint8_t *data, size_t size) noexcept : data_(data), size_(size) { }
+
+  const uint8_t *data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  const uint8_t *begin() const noexcept { return data_; }
+  const uint8_t *end() const noexcept { return data_ + size_; }
+
+  uint8_t operator[](size_t pos) const noexcept { return data_[pos]; }
+
+  /** @brief Returns a copy of the bytes */
+  std::vector<uint8_t> to_vector() const { return std::vector<uint8_t>(begin(), end()); }
+
+  /** @brief Returns a copy of the bytes as string */
+  std::string to_string() const { return std::string(reinterpret_cast<const char*>(data_), size_); }
+
+ private:
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+};
+
+/** @class PacketView
+ * @brief Reads a MySQL packet in place
+ *
+ * Counterpart of Packet for inspecting packets without copying them: the
+ * buffer is borrowed, not owned, and the byte fields are returned as views
+ * into it. Offers the same read_*() and read_*_from() functions as Packet,
+ * with the same positions (the header counts) and the same exceptions.
+ *
+ * The buffer has to outlive the view and the views it returned.
+ */
+class MYSQL_PROTOCOL_API PacketView {
+ public:
+  /** @brief Header length of packets */
+  static const unsigned int kHeaderSize{4};
+
+  PacketView() = default;
+
+  /**
+   * When size is 4 or bigger, the payload size and sequence ID of the packet
+   * are read from the packet header.
+   *
+   * @param data buffer starting with the packet header
+   * @param size number of bytes in buffer
+   * @param allow_partial whether to allow buffers which have incomplete payload
+   *
+   * @throws packet_error if allow_partial is false and the payload is incomplete
+   */
+  PacketView(const uint8_t *data, size_t size, bool allow_partial = false);
+
+  /** @overload */
+  explicit PacketView(const std::vector<uint8_t> &buffer, bool allow_partial = false)
+      : PacketView(buffer.data(), buffer.size(), allow_partial) { }
+
+  /** @brief Returns the viewed buffer */
+  const uint8_t *data() const noexcept { return data_; }
+
+  /** @brief Returns the number of viewed bytes */
+  size_t size() const noexcept { return size_; }
+
+  /** @brief Gets the packet sequence ID */
+  uint8_t get_sequence_id() const noexcept { return sequence_id_; }
+
+  /** @brief Gets the payload size from the packet header */
+  uint32_t get_payload_size() const noexcept { return payload_size_; }
+
+  /** @brief Returns the payload, shorter than get_payload_size() if partial */
+  BytesView payload() const noexcept {
+    if (size_ < kHeaderSize) return BytesView();
+    const size_t available = size_ - kHeaderSize;
+    return BytesView(data_ + kHeaderSize, available < payload_size_ ? available : payload_size_);
+  }
+
+  /** @brief Sets current read position used by read_*() calls */
+  void seek(size_t position) {
+    if (position > size_)
+      throw std::range_error("seek past EOF");
+    position_ = position;
+  }
+
+  /** @brief Returns current read position used by read_*() calls */
+  size_t tell() const noexcept { return position_; }
+
+  /** @brief Gets an integral at the current position and advances it, see Packet::read_int() */
+  template<typename Type, typename = std::enable_if<std::is_integral<Type>::value>>
+  Type read_int(size_t length = sizeof(Type)) {
+    Type res = read_int_from<Type>(position_, length);  // throws range_error
+    position_ += length;
+    return res;
+  }
+
+  /** @brief Gets a length encoded integer and advances the position, see Packet::read_lenenc_uint() */
+  uint64_t read_lenenc_uint() {
+    auto pr = read_lenenc_uint_from(position_);  // throws range_error/runtime_error
+    position_ += pr.second;
+    return pr.first;
+  }
+
+  /** @brief Gets raw bytes and advances the position, see Packet::read_bytes() */
+  BytesView read_bytes(size_t length) {
+    BytesView res = read_bytes_from(position_, length);  // throws range_error
+    position_ += length;
+    return res;
+  }
+
+  /** @brief Gets raw bytes with length encoded size and advances the position,
+   *         see Packet::read_lenenc_bytes() */
+  BytesView read_lenenc_bytes() {
+    auto pr = read_lenenc_bytes_from(position_);  // throws range_error/runtime_error
+    position_ += pr.second;
+    return pr.first;
+  }
+
+  /** @brief Gets zero-terminated string without its terminator and advances the
+   *         position past it, see Packet::read_string_nul() */
+  BytesView read_string_nul() {
+    BytesView res = read_string_nul_from(position_);  // throws range_error/runtime_error
+    position_ += res.size() + 1;  // +1 for zero-terminator
+    return res;
+  }
+
+  /** @brief Gets raw bytes until EOF and advances the position, see Packet::read_bytes_eof() */
+  BytesView read_bytes_eof() {
+    BytesView res = read_bytes_eof_from(position_);  // throws range_error
+    position_ += res.size();
+    return res;
+  }
+
+  /** @brief Gets a little-endian integral of 1, 2, 3, 4 or 8 bytes at position
+   *
+   * @throws std::range_error (std::runtime_error) on start or end beyond EOF
+   */
+  template<typename Type, typename = std::enable_if<std::is_integral<Type>::value>>
+  Type read_int_from(size_t position, size_t length = sizeof(Type)) const {
+    harness_assert((length >= 1 && length <= 4) || length == 8);
+    if (position + length > size_)
+      throw std::range_error("start or end beyond EOF");
+
+    uint64_t result = 0;
+    for (size_t i = length; i-- > 0;) {
+      result = (result << 8) | data_[position + i];
+    }
+    return static_cast<Type>(result);
+  }
+
+  /** @brief Gets a length encoded integer and the length of its token,
+   *         see Packet::read_lenenc_uint_from() */
+  std::pair<uint64_t, size_t> read_lenenc_uint_from(size_t position) const;
+
+  /** @brief Gets a zero-terminated string without its terminator,
+   *         see Packet::read_string_nul_from() */
+  BytesView read_string_nul_from(size_t position) const;
+
+  /** @brief Gets raw bytes, see Packet::read_bytes_from() */
+  BytesView read_bytes_from(size_t position, size_t length) const {
+    if (position + length > size_)
+      throw std::range_error("start or end beyond EOF");
+    return BytesView(data_ + position, length);
+  }
+
+  /** @brief Gets raw bytes with length encoded size and the length of the token,
+   *         see Packet::read_lenenc_bytes_from() */
+  std::pair<BytesView, size_t> read_lenenc_bytes_from(size_t position) const;
+
+  /** @brief Gets raw bytes until EOF, see Packet::read_bytes_eof_from() */
+  BytesView read_bytes_eof_from(size_t position) const {
+    if (position >= size_)
+      throw std::range_error("start beyond EOF");
+    return BytesView(data_ + position, size_ - position);
+  }
+
+ private:
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+  uint8_t sequence_id_{0};
+  uint32_t payload_size_{0};
+  size_t position_{0};
+};
+
+} // namespace mysql_protocol
+
+#endif // MYSQLROUTER_MYSQL_PROTOCOL_PACKET_VIEW_INCLUDED
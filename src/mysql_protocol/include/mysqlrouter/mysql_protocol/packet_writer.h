@@ -0,0 +1,159 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_MYSQL_PROTOCOL_PACKET_WRITER_INCLUDED
+#define MYSQLROUTER_MYSQL_PROTOCOL_PACKET_WRITER_INCLUDED
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace mysql_protocol {
+
+/** @class PacketWriter
+ * @brief Serializes MySQL packets into a caller-provided buffer
+ *
+ * Counterpart of the write_*() functions of Packet which doesn't allocate:
+ * the payload gets written straight into the buffer, the headers get filled
+ * by finish(). Payloads of 16MB or more get split into several packets with
+ * consecutive sequence IDs, ending with a shorter (maybe empty) one, as the
+ * protocol requires.
+ *
+ * Use framed_size() and lenenc_uint_size() to size the buffer, they are
+ * constexpr for payloads known at compile time:
+ *
+ *     uint8_t buf[PacketWriter::framed_size(1)];
+ *     PacketWriter writer(buf, sizeof(buf));
+ *     writer.begin(1);
+ *     writer.write_int<uint8_t>(0x0e);  // COM_PING
+ *     so->write_all(fd, buf, writer.finish());
+ *
+ * Writes fail with std::range_error once the buffer is full; what got
+ * written until then is not usable.
+ */
+class MYSQL_PROTOCOL_API PacketWriter {
+ public:
+  /** @brief Header length of packets */
+  static constexpr size_t kHeaderSize{4};
+
+  /** @brief Biggest payload of a single packet, bigger ones get split */
+  static constexpr size_t kMaxPayloadSize{0xffffff};
+
+  /**
+   * @param buffer where to write the packets
+   * @param capacity size of buffer
+   */
+  PacketWriter(uint8_t *buffer, size_t capacity) noexcept
+      : buffer_(buffer), capacity_(capacity) { }
+
+  /** @brief Returns the number of bytes the packets of a payload take, headers included */
+  static constexpr size_t framed_size(size_t payload_size) noexcept {
+    return payload_size + kHeaderSize * (payload_size / kMaxPayloadSize + 1);
+  }
+
+  /** @brief Returns the number of bytes of a length-encoded integer (1, 3, 4 or 9) */
+  static constexpr size_t lenenc_uint_size(uint64_t value) noexcept {
+    return value < 251 ? 1 : value < (1 << 16) ? 3 : value < (1 << 24) ? 4 : 9;
+  }
+
+  /** @brief Starts a packet at the current end of the buffer
+   *
+   * @param sequence_id sequence ID of the (first) packet
+   *
+   * @throws std::range_error if there is no room for the header
+   */
+  void begin(uint8_t sequence_id);
+
+  /** @brief Fills the headers of the packet started by begin()
+   *
+   * Several packets can be written into one buffer by calling begin() again.
+   *
+   * @return bytes written into the buffer so far
+   *
+   * @throws std::range_error if there is no room for the closing empty packet
+   */
+  size_t finish();
+
+  /** @brief Writes a little-endian integral of 1 to 8 bytes, see Packet::write_int() */
+  template<class T, typename = std::enable_if<std::is_integral<T>::value>>
+  void write_int(T value, size_t length = sizeof(T)) {
+    while (length-- > 0) {
+      write_byte(static_cast<uint8_t>(value));
+      value = static_cast<T>(value >> CHAR_BIT);
+    }
+  }
+
+  /** @brief Writes a length-encoded integral, see Packet::write_lenenc_uint()
+   *
+   * @return size of the encoded integral (one of: 1, 3, 4 or 9 bytes)
+   */
+  size_t write_lenenc_uint(uint64_t value);
+
+  /** @brief Writes raw bytes */
+  void write_bytes(const uint8_t *bytes, size_t length);
+
+  /** @brief Writes a string without zero-terminator */
+  void write_string(const std::string &str) {
+    write_bytes(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+  }
+
+  /** @brief Writes a byte count times */
+  void append_bytes(size_t count, uint8_t byte);
+
+  /** @brief Returns bytes written into the buffer so far */
+  size_t size() const noexcept { return size_; }
+
+  /** @brief Returns the sequence ID following the packets written so far */
+  uint8_t get_next_sequence_id() const noexcept { return sequence_id_; }
+
+ private:
+  void write_byte(uint8_t byte) {
+    if (frame_payload_ == kMaxPayloadSize) next_frame();
+    if (size_ == capacity_) throw_full();
+    buffer_[size_++] = byte;
+    ++frame_payload_;
+  }
+
+  /** @brief closes the current full packet and starts the next one */
+  void next_frame();
+
+  /** @brief writes the header of the current packet */
+  void close_frame() noexcept;
+
+  [[noreturn]] static void throw_full();
+
+  uint8_t *buffer_;
+  size_t capacity_;
+  size_t size_{0};
+  size_t frame_start_{0};
+  size_t frame_payload_{0};
+  uint8_t sequence_id_{0};
+};
+
+} // namespace mysql_protocol
+
+#endif // MYSQLROUTER_MYSQL_PROTOCOL_PACKET_WRITER_INCLUDED
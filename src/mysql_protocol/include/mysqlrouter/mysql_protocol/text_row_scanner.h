@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_MYSQL_PROTOCOL_TEXT_ROW_SCANNER_INCLUDED
+#define MYSQLROUTER_MYSQL_PROTOCOL_TEXT_ROW_SCANNER_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mysql_protocol {
+
+/** @brief Field of a text protocol result row */
+struct TextField {
+  /** @brief offset of the value from the start of the scanned buffer */
+  size_t offset;
+  /** @brief length of the value, 0 for NULL */
+  size_t length;
+  bool is_null;
+};
+
+/** @class TextRowScanner
+ * @brief Finds the fields of text protocol result rows
+ *
+ * The rows of a COM_QUERY result set are a length-encoded string (or 0xfb
+ * for NULL) per column. The scanner finds the fields without copying or
+ * throwing, for inspecting many rows in a row: scan_rows() walks a
+ * buffer of packets until the first one which is not a row.
+ */
+class MYSQL_PROTOCOL_API TextRowScanner {
+ public:
+  /** @param columns number of columns of the result set */
+  explicit TextRowScanner(size_t columns) noexcept : columns_(columns) { }
+
+  size_t get_columns() const noexcept { return columns_; }
+
+  /** @brief Finds the fields of the payload of one row
+   *
+   * @param payload payload of the row packet
+   * @param size size of the payload
+   * @param fields where to store get_columns() fields, offsets relative to payload
+   *
+   * @return false if the payload is not a row of get_columns() fields
+   */
+  bool scan_row(const uint8_t *payload, size_t size, TextField *fields) const noexcept;
+
+  /** @brief Finds the fields of the rows at the start of a buffer
+   *
+   * Stops at the first packet which is incomplete or not a row, like the
+   * EOF, OK or error packet ending the result set.
+   *
+   * @param data packets, starting with a header
+   * @param size size of data
+   * @param fields get_columns() fields per row get appended, offsets relative to data
+   *
+   * @return bytes of the scanned rows
+   */
+  size_t scan_rows(const uint8_t *data, size_t size, std::vector<TextField> &fields) const;
+
+ private:
+  size_t columns_;
+};
+
+} // namespace mysql_protocol
+
+#endif // MYSQLROUTER_MYSQL_PROTOCOL_TEXT_ROW_SCANNER_INCLUDED
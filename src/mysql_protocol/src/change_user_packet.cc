@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/mysql_protocol.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mysql_protocol {
+
+// required by C++11, deprecated in C++17
+constexpr uint8_t ChangeUserPacket::kCommand;
+
+ChangeUserPacket::ChangeUserPacket(uint8_t sequence_id, const std::string &username,
+                                   const std::vector<uint8_t> &auth_response,
+                                   const std::string &database, uint16_t char_set,
+                                   const std::string &auth_plugin,
+                                   const std::vector<uint8_t> &connection_attrs,
+                                   Capabilities::Flags capabilities)
+    : Packet(sequence_id, capabilities), username_(username), auth_response_(auth_response),
+      database_(database), char_set_(char_set), auth_plugin_(auth_plugin),
+      connection_attrs_(connection_attrs) {
+  prepare_packet();
+}
+
+void ChangeUserPacket::prepare_packet() {
+  if (capability_flags_.test(Capabilities::SECURE_CONNECTION) && auth_response_.size() > 255) {
+    throw packet_error("COM_CHANGE_USER auth-response longer than 255 bytes");
+  }
+
+  reset();
+  position_ = size();
+
+  reserve(size() +
+    sizeof(uint8_t) +             // command
+    username_.size() + 1 +        // username + nul-terminator
+    sizeof(uint8_t) +             // auth-response-len
+    auth_response_.size() +       // auth-response
+    database_.size() + 1 +        // database + nul-terminator
+    sizeof(uint16_t) +            // character set
+    auth_plugin_.size() + 1 +     // auth-plugin + nul-terminator
+    connection_attrs_.size()      // connection attributes
+  );
+
+  // Command
+  write_int<uint8_t>(kCommand);
+
+  // Username
+  write_string(username_);
+  write_int<uint8_t>(0);
+
+  // Auth Data
+  if (capability_flags_.test(Capabilities::SECURE_CONNECTION)) {
+    write_int<uint8_t>(static_cast<uint8_t>(auth_response_.size()));
+    write_bytes(auth_response_);
+  } else {
+    write_bytes(auth_response_);
+    write_int<uint8_t>(0);
+  }
+
+  // Database
+  write_string(database_);
+  write_int<uint8_t>(0);
+
+  // Character set
+  write_int<uint16_t>(char_set_);
+
+  // Authentication plugin name
+  if (capability_flags_.test(Capabilities::PLUGIN_AUTH)) {
+    write_string(auth_plugin_);
+    write_int<uint8_t>(0);
+  }
+
+  // Connection attributes
+  if (capability_flags_.test(Capabilities::CONNECT_ATTRS)) {
+    write_bytes(connection_attrs_);
+  }
+
+  update_packet_size();
+}
+
+} // namespace mysql_protocol
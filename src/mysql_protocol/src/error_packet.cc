@@ -87,6 +87,28 @@ void ErrorPacket::prepare_packet() {
   update_packet_size();
 }
 
+size_t ErrorPacket::payload_size(const std::string &err_msg,
+                                 Capabilities::Flags capabilities) noexcept {
+  return sizeof(uint8_t) +    // error identifier byte
+         sizeof(uint16_t) +   // error code
+         (capabilities.test(Capabilities::PROTOCOL_41) ? 6 : 0) +  // '#' and SQL state
+         err_msg.size();      // the message
+}
+
+void ErrorPacket::write(PacketWriter &writer, uint8_t sequence_id, uint16_t err_code,
+                        const std::string &err_msg, const std::string &sql_state,
+                        Capabilities::Flags capabilities) {
+  writer.begin(sequence_id);
+  writer.write_int<uint8_t>(0xff);
+  writer.write_int<uint16_t>(err_code);
+  if (capabilities.test(Capabilities::PROTOCOL_41)) {
+    writer.write_int<uint8_t>(kHashChar);
+    writer.write_string(sql_state.size() != 5 ? "HY000" : sql_state);
+  }
+  writer.write_string(err_msg);
+  writer.finish();
+}
+
 void ErrorPacket::parse_payload() {
   bool prot41 = capability_flags_.test(Capabilities::PROTOCOL_41);
   // Sanity checks
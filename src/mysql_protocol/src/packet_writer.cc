@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/mysql_protocol.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace mysql_protocol {
+
+constexpr size_t PacketWriter::kHeaderSize;
+constexpr size_t PacketWriter::kMaxPayloadSize;
+
+void PacketWriter::throw_full() {
+  throw std::range_error("buffer too small");
+}
+
+void PacketWriter::begin(uint8_t sequence_id) {
+  if (capacity_ - size_ < kHeaderSize) throw_full();
+
+  sequence_id_ = sequence_id;
+  frame_start_ = size_;
+  frame_payload_ = 0;
+  size_ += kHeaderSize;
+}
+
+void PacketWriter::close_frame() noexcept {
+  uint8_t *header = buffer_ + frame_start_;
+  header[0] = static_cast<uint8_t>(frame_payload_);
+  header[1] = static_cast<uint8_t>(frame_payload_ >> 8);
+  header[2] = static_cast<uint8_t>(frame_payload_ >> 16);
+  header[3] = sequence_id_++;
+}
+
+void PacketWriter::next_frame() {
+  if (capacity_ - size_ < kHeaderSize) throw_full();
+
+  close_frame();
+  frame_start_ = size_;
+  frame_payload_ = 0;
+  size_ += kHeaderSize;
+}
+
+size_t PacketWriter::finish() {
+  // a payload of a multiple of 16MB ends with an empty packet
+  if (frame_payload_ == kMaxPayloadSize) next_frame();
+  close_frame();
+  frame_payload_ = 0;
+
+  return size_;
+}
+
+size_t PacketWriter::write_lenenc_uint(uint64_t value) {
+  if (value < 251) {
+    write_byte(static_cast<uint8_t>(value));
+    return 1;
+  } else if (value < (1 << 16)) {
+    write_byte(0xfc);
+    write_int<uint16_t>(static_cast<uint16_t>(value));
+    return 3;
+  } else if (value < (1 << 24)) {
+    write_byte(0xfd);
+    write_int(value, 3);
+    return 4;
+  } else {
+    write_byte(0xfe);
+    write_int<uint64_t>(value);
+    return 9;
+  }
+}
+
+void PacketWriter::write_bytes(const uint8_t *bytes, size_t length) {
+  while (length > 0) {
+    if (frame_payload_ == kMaxPayloadSize) next_frame();
+
+    const size_t chunk = std::min(length, kMaxPayloadSize - frame_payload_);
+    if (capacity_ - size_ < chunk) throw_full();
+
+    std::memcpy(buffer_ + size_, bytes, chunk);
+    size_ += chunk;
+    frame_payload_ += chunk;
+    bytes += chunk;
+    length -= chunk;
+  }
+}
+
+void PacketWriter::append_bytes(size_t count, uint8_t byte) {
+  while (count > 0) {
+    if (frame_payload_ == kMaxPayloadSize) next_frame();
+
+    const size_t chunk = std::min(count, kMaxPayloadSize - frame_payload_);
+    if (capacity_ - size_ < chunk) throw_full();
+
+    std::memset(buffer_ + size_, byte, chunk);
+    size_ += chunk;
+    frame_payload_ += chunk;
+    count -= chunk;
+  }
+}
+
+} // namespace mysql_protocol
@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/mysql_protocol.h"
+
+namespace mysql_protocol {
+
+static constexpr uint8_t kNullField = 0xfb;
+
+bool TextRowScanner::scan_row(const uint8_t *payload, size_t size, TextField *fields) const noexcept {
+  size_t pos = 0;
+  for (size_t i = 0; i < columns_; ++i) {
+    if (pos >= size) return false;
+
+    // most fields are short, their length is the first byte
+    const uint8_t first = payload[pos++];
+    uint64_t length = first;
+    if (first == kNullField) {
+      fields[i] = TextField{pos, 0, true};
+      continue;
+    } else if (first >= 0xfc) {
+      size_t bytes;
+      switch (first) {
+        case 0xfc: bytes = 2; break;
+        case 0xfd: bytes = 3; break;
+        case 0xfe: bytes = 8; break;
+        default: return false;  // 0xff is no length
+      }
+      if (size - pos < bytes) return false;
+
+      length = 0;
+      for (size_t b = bytes; b-- > 0;) {
+        length = (length << 8) | payload[pos + b];
+      }
+      pos += bytes;
+    }
+
+    if (length > size - pos) return false;
+    fields[i] = TextField{pos, static_cast<size_t>(length), false};
+    pos += static_cast<size_t>(length);
+  }
+
+  return pos == size;
+}
+
+size_t TextRowScanner::scan_rows(const uint8_t *data, size_t size, std::vector<TextField> &fields) const {
+  const size_t kHeaderSize = 4;
+
+  size_t pos = 0;
+  while (size - pos >= kHeaderSize) {
+    const size_t payload_size = static_cast<size_t>(data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16);
+    if (size - pos - kHeaderSize < payload_size) break;
+
+    const size_t payload = pos + kHeaderSize;
+    // a row can only start with 0xfe if it has a field of 16MB or more
+    if (payload_size == 0 || data[payload] == 0xff ||
+        (data[payload] == 0xfe && payload_size < 0xffffff)) break;
+
+    const size_t first_field = fields.size();
+    fields.resize(first_field + columns_);
+    if (!scan_row(data + payload, payload_size, fields.data() + first_field)) {
+      fields.resize(first_field);
+      break;
+    }
+    for (size_t i = first_field; i < fields.size(); ++i) {
+      fields[i].offset += payload;
+    }
+
+    pos = payload + payload_size;
+  }
+
+  return pos;
+}
+
+} // namespace mysql_protocol
@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <gmock/gmock.h>
+
+#include "mysqlrouter/mysql_protocol.h"
+
+using ::testing::ContainerEq;
+
+using namespace mysql_protocol;
+
+TEST(ChangeUserPacketTest, ProtocolWithPluginAuth) {
+  auto packet = ChangeUserPacket(0, "ab", {0x01, 0x02}, "db", 0x21,
+                                 "p", {}, Capabilities::PROTOCOL_41 |
+                                          Capabilities::SECURE_CONNECTION |
+                                          Capabilities::PLUGIN_AUTH);
+
+  Packet::vector_t expected = {
+      0x0e, 0x00, 0x00, 0x00,
+      0x11,                      // COM_CHANGE_USER
+      'a', 'b', 0x00,            // username
+      0x02, 0x01, 0x02,          // auth-response
+      'd', 'b', 0x00,            // database
+      0x21, 0x00,                // character set
+      'p', 0x00,                 // auth plugin
+  };
+  ASSERT_THAT(packet, ContainerEq(expected));
+}
+
+TEST(ChangeUserPacketTest, ConnectionAttributes) {
+  auto packet = ChangeUserPacket(0, "a", {}, "", 0x08, "",
+                                 {0x02, 'k', 'v'},
+                                 Capabilities::SECURE_CONNECTION |
+                                 Capabilities::CONNECT_ATTRS);
+
+  Packet::vector_t expected = {
+      0x0a, 0x00, 0x00, 0x00,
+      0x11,                      // COM_CHANGE_USER
+      'a', 0x00,                 // username
+      0x00,                      // auth-response
+      0x00,                      // database
+      0x08, 0x00,                // character set
+      0x02, 'k', 'v',            // connection attributes
+  };
+  ASSERT_THAT(packet, ContainerEq(expected));
+}
+
+TEST(ChangeUserPacketTest, AuthResponseTooLong) {
+  ASSERT_THROW(ChangeUserPacket(0, "a", std::vector<uint8_t>(256, 0x01), "", 0x08, "", {},
+                                Capabilities::SECURE_CONNECTION),
+               packet_error);
+}
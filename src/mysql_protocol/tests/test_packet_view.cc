@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+#include "mysqlrouter/mysql_protocol.h"
+
+using mysql_protocol::BytesView;
+using mysql_protocol::Packet;
+using mysql_protocol::PacketView;
+using mysql_protocol::packet_error;
+
+class PacketViewTest : public ::testing::Test {
+ public:
+  Packet::vector_t case1 = {0x04, 0x0, 0x0, 0x01, 't', 'e', 's', 't'};
+};
+
+TEST_F(PacketViewTest, Header) {
+  PacketView view(case1);
+  EXPECT_EQ(case1.data(), view.data());
+  EXPECT_EQ(8u, view.size());
+  EXPECT_EQ(4u, view.get_payload_size());
+  EXPECT_EQ(1, view.get_sequence_id());
+  EXPECT_EQ("test", view.payload().to_string());
+}
+
+TEST_F(PacketViewTest, IncompletePayload) {
+  Packet::vector_t partial(case1.begin(), case1.end() - 1);
+  EXPECT_THROW(PacketView view(partial), packet_error);
+
+  PacketView view(partial, true);
+  EXPECT_EQ(4u, view.get_payload_size());
+  EXPECT_EQ("tes", view.payload().to_string());
+}
+
+TEST_F(PacketViewTest, ReadsLikePacket) {
+  Packet::vector_t buffer = {
+    0x00, 0x0, 0x0, 0x0,
+    0x01, 0x34, 0x12,          // int<1>, int<2>
+    0xfc, 0x00, 0x01,          // lenenc 256
+    0x03, 'a', 'b', 'c',       // lenenc bytes
+    'n', 'u', 'l', 0x00,       // nul-terminated
+    'e', 'o', 'f',
+  };
+  buffer[0] = static_cast<uint8_t>(buffer.size() - 4);
+
+  Packet packet(buffer);
+  PacketView view(buffer);
+  packet.seek(4);
+  view.seek(4);
+
+  EXPECT_EQ(packet.read_int<uint8_t>(), view.read_int<uint8_t>());
+  EXPECT_EQ(packet.read_int<uint16_t>(), view.read_int<uint16_t>());
+  EXPECT_EQ(packet.read_lenenc_uint(), view.read_lenenc_uint());
+  EXPECT_EQ(packet.read_lenenc_bytes(), view.read_lenenc_bytes().to_vector());
+  EXPECT_EQ(packet.read_string_nul(), view.read_string_nul().to_string());
+  EXPECT_EQ(packet.tell(), view.tell());
+
+  BytesView rest = view.read_bytes_eof();
+  EXPECT_EQ(packet.read_bytes_eof(), rest.to_vector());
+  EXPECT_EQ(buffer.data() + 18, rest.data());  // not a copy
+  EXPECT_EQ(buffer.size(), view.tell());
+}
+
+TEST_F(PacketViewTest, ReadsPastEnd) {
+  PacketView view(case1);
+  EXPECT_THROW(view.read_int_from<uint32_t>(6), std::range_error);
+  EXPECT_THROW(view.read_bytes_from(5, 4), std::range_error);
+  EXPECT_THROW(view.read_bytes_eof_from(8), std::range_error);
+  EXPECT_THROW(view.read_string_nul_from(4), std::runtime_error);
+  EXPECT_THROW(view.seek(9), std::range_error);
+
+  Packet::vector_t lenenc = {0x03, 0x0, 0x0, 0x0, 0x05, 'a', 'b'};
+  PacketView lenenc_view(lenenc);
+  EXPECT_THROW(lenenc_view.read_lenenc_bytes_from(4), std::range_error);
+
+  Packet::vector_t illegal = {0x01, 0x0, 0x0, 0x0, 0xfb};
+  PacketView illegal_view(illegal);
+  EXPECT_THROW(illegal_view.read_lenenc_uint_from(4), std::runtime_error);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
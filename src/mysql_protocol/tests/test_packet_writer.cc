@@ -0,0 +1,130 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <gmock/gmock.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mysqlrouter/mysql_protocol.h"
+
+using mysql_protocol::ErrorPacket;
+using mysql_protocol::Packet;
+using mysql_protocol::PacketWriter;
+
+static_assert(PacketWriter::framed_size(0) == 4, "empty packet is a header");
+static_assert(PacketWriter::framed_size(PacketWriter::kMaxPayloadSize) == PacketWriter::kMaxPayloadSize + 8,
+              "16MB payload ends with an empty packet");
+static_assert(PacketWriter::lenenc_uint_size(250) == 1 &&
+              PacketWriter::lenenc_uint_size(251) == 3 &&
+              PacketWriter::lenenc_uint_size(1 << 16) == 4 &&
+              PacketWriter::lenenc_uint_size(1 << 24) == 9, "lenenc sizes");
+
+TEST(PacketWriterTest, WritesLikePacket) {
+  Packet packet(3);
+  packet.write_int<uint16_t>(0x1234);
+  packet.write_int<uint32_t>(0x123456, 3);
+  packet.write_lenenc_uint(300);
+  packet.write_lenenc_uint(1 << 20);
+  packet.write_string("abc");
+  packet.append_bytes(3, 0x00);
+  // a Packet created by sequence ID has no header yet
+  std::vector<uint8_t> expected = {static_cast<uint8_t>(packet.size()), 0x0, 0x0, 0x03};
+  expected.insert(expected.end(), packet.begin(), packet.end());
+
+  std::vector<uint8_t> buffer(expected.size());
+  PacketWriter writer(buffer.data(), buffer.size());
+  writer.begin(3);
+  writer.write_int<uint16_t>(0x1234);
+  writer.write_int<uint32_t>(0x123456, 3);
+  EXPECT_EQ(3u, writer.write_lenenc_uint(300));
+  EXPECT_EQ(4u, writer.write_lenenc_uint(1 << 20));
+  writer.write_string("abc");
+  writer.append_bytes(3, 0x00);
+  EXPECT_EQ(expected.size(), writer.finish());
+  EXPECT_EQ(4, writer.get_next_sequence_id());
+
+  EXPECT_THAT(buffer, ::testing::ContainerEq(expected));
+}
+
+static size_t payload_size_at(const std::vector<uint8_t> &buffer, size_t header) {
+  return buffer[header] | buffer[header + 1] << 8 | buffer[header + 2] << 16;
+}
+
+TEST(PacketWriterTest, SplitsBigPayloads) {
+  const size_t kMax = PacketWriter::kMaxPayloadSize;
+
+  for (size_t payload_size : {kMax - 1, kMax, kMax + 1}) {
+    std::vector<uint8_t> payload(payload_size, 'x');
+    std::vector<uint8_t> buffer(PacketWriter::framed_size(payload_size));
+    PacketWriter writer(buffer.data(), buffer.size());
+    writer.begin(0);
+    writer.write_bytes(payload.data(), payload.size());
+    ASSERT_EQ(buffer.size(), writer.finish());
+
+    if (payload_size < kMax) {
+      EXPECT_EQ(payload_size, payload_size_at(buffer, 0));
+      EXPECT_EQ(1, writer.get_next_sequence_id());
+      continue;
+    }
+
+    // a full packet followed by the rest
+    EXPECT_EQ(kMax, payload_size_at(buffer, 0));
+    EXPECT_EQ(0, buffer[3]);
+    EXPECT_EQ(payload_size - kMax, payload_size_at(buffer, 4 + kMax));
+    EXPECT_EQ(1, buffer[4 + kMax + 3]);
+    EXPECT_EQ(2, writer.get_next_sequence_id());
+  }
+}
+
+TEST(PacketWriterTest, BufferTooSmall) {
+  uint8_t buffer[6];
+  PacketWriter writer(buffer, sizeof(buffer));
+  EXPECT_THROW(writer.begin(0); writer.write_string("abc"), std::range_error);
+
+  PacketWriter no_header(buffer, 3);
+  EXPECT_THROW(no_header.begin(0), std::range_error);
+}
+
+TEST(PacketWriterTest, ErrorPacket) {
+  for (auto capabilities : {mysql_protocol::Capabilities::ALL_ZEROS, mysql_protocol::Capabilities::PROTOCOL_41}) {
+    ErrorPacket packet(2, 2003, "Can't connect", "HY000", capabilities);
+
+    uint8_t buffer[64];
+    const size_t size = PacketWriter::framed_size(ErrorPacket::payload_size("Can't connect", capabilities));
+    ASSERT_EQ(packet.size(), size);
+
+    PacketWriter writer(buffer, sizeof(buffer));
+    ErrorPacket::write(writer, 2, 2003, "Can't connect", "HY000", capabilities);
+    EXPECT_THAT(std::vector<uint8_t>(buffer, buffer + writer.size()),
+                ::testing::ContainerEq(static_cast<std::vector<uint8_t>&>(packet)));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+#include "mysqlrouter/mysql_protocol.h"
+
+using mysql_protocol::TextField;
+using mysql_protocol::TextRowScanner;
+
+static std::string field_value(const std::vector<uint8_t> &data, const TextField &field) {
+  return std::string(data.begin() + static_cast<long>(field.offset),
+                     data.begin() + static_cast<long>(field.offset + field.length));
+}
+
+TEST(TextRowScannerTest, ScanRow) {
+  std::vector<uint8_t> payload = {0x02, 'a', 'b', 0xfb, 0x00};
+  std::string long_value(300, 'x');
+  payload.push_back(0xfc);
+  payload.push_back(300 & 0xff);
+  payload.push_back(300 >> 8);
+  payload.insert(payload.end(), long_value.begin(), long_value.end());
+
+  TextRowScanner scanner(4);
+  TextField fields[4];
+  ASSERT_TRUE(scanner.scan_row(payload.data(), payload.size(), fields));
+  EXPECT_EQ("ab", field_value(payload, fields[0]));
+  EXPECT_TRUE(fields[1].is_null);
+  EXPECT_FALSE(fields[2].is_null);
+  EXPECT_EQ(0u, fields[2].length);
+  EXPECT_EQ(long_value, field_value(payload, fields[3]));
+
+  // too few, too many or truncated fields
+  EXPECT_FALSE(TextRowScanner(5).scan_row(payload.data(), payload.size(), fields));
+  EXPECT_FALSE(TextRowScanner(3).scan_row(payload.data(), payload.size(), fields));
+  EXPECT_FALSE(scanner.scan_row(payload.data(), payload.size() - 1, fields));
+}
+
+TEST(TextRowScannerTest, ScanRowsUntilEof) {
+  std::vector<uint8_t> data = {
+    0x04, 0x0, 0x0, 0x02, 0x01, '1', 0x01, 'a',
+    0x03, 0x0, 0x0, 0x03, 0xfb, 0x01, 'b',
+    0x05, 0x0, 0x0, 0x04, 0xfe, 0x00, 0x00, 0x02, 0x00,  // EOF
+  };
+
+  TextRowScanner scanner(2);
+  std::vector<TextField> fields;
+  EXPECT_EQ(15u, scanner.scan_rows(data.data(), data.size(), fields));
+  ASSERT_EQ(4u, fields.size());
+  EXPECT_EQ("1", field_value(data, fields[0]));
+  EXPECT_EQ("a", field_value(data, fields[1]));
+  EXPECT_TRUE(fields[2].is_null);
+  EXPECT_EQ("b", field_value(data, fields[3]));
+
+  // incomplete second row
+  fields.clear();
+  EXPECT_EQ(8u, scanner.scan_rows(data.data(), 14, fields));
+  EXPECT_EQ(2u, fields.size());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,151 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+  @file
+  Detection of the crypto instructions of the CPU, AES-NI and SHA on x86,
+  the crypto extension on ARMv8.
+
+  The ARMv8 code isn't verified on hardware yet and only gets compiled
+  with -DMYSQLROUTER_WITH_ARM_CRYPTO, by default ARM uses the software
+  implementations.
+
+  The functions using them are compiled for the instruction set with
+  MYSQLROUTER_TARGET_AES and MYSQLROUTER_TARGET_SHA, the rest of the
+  binary stays runnable on CPUs without them.
+*/
+
+#ifndef MYSQLROUTER_CPU_CRYPTO_INCLUDED
+#define MYSQLROUTER_CPU_CRYPTO_INCLUDED
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+# if defined(_MSC_VER)
+#  define MYSQLROUTER_HAVE_X86_CRYPTO 1
+#  define MYSQLROUTER_TARGET_AES
+#  define MYSQLROUTER_TARGET_SHA
+# elif defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#  define MYSQLROUTER_HAVE_X86_CRYPTO 1
+#  define MYSQLROUTER_TARGET_AES __attribute__((target("sse2,aes")))
+#  define MYSQLROUTER_TARGET_SHA __attribute__((target("sse4.1,sha")))
+# endif
+#elif defined(__aarch64__) && (defined(__linux__) || defined(__APPLE__)) && \
+    defined(MYSQLROUTER_WITH_ARM_CRYPTO)
+# if defined(__ARM_FEATURE_CRYPTO)
+#  define MYSQLROUTER_HAVE_ARM_CRYPTO 1
+#  define MYSQLROUTER_TARGET_AES
+#  define MYSQLROUTER_TARGET_SHA
+# elif defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6
+#  define MYSQLROUTER_HAVE_ARM_CRYPTO 1
+#  define MYSQLROUTER_TARGET_AES __attribute__((target("+crypto")))
+#  define MYSQLROUTER_TARGET_SHA __attribute__((target("+crypto")))
+# endif
+#endif
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO)
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# else
+#  include <cpuid.h>
+# endif
+#elif defined(MYSQLROUTER_HAVE_ARM_CRYPTO) && defined(__linux__)
+# include <sys/auxv.h>
+#endif
+
+namespace mysqlrouter {
+
+namespace cpu_detail {
+
+enum CryptoFeature {
+  kCpuAes = 1 << 0,
+  kCpuSha1 = 1 << 1,
+};
+
+inline unsigned detect_crypto_features() {
+  unsigned features = 0;
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO)
+  unsigned leaf1[4] = {0, 0, 0, 0};
+  unsigned leaf7[4] = {0, 0, 0, 0};
+# if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  const unsigned max_leaf = static_cast<unsigned>(regs[0]);
+  __cpuid(regs, 1);
+  for (int i = 0; i < 4; ++i) leaf1[i] = static_cast<unsigned>(regs[i]);
+  if (max_leaf >= 7) {
+    __cpuidex(regs, 7, 0);
+    for (int i = 0; i < 4; ++i) leaf7[i] = static_cast<unsigned>(regs[i]);
+  }
+# else
+  const unsigned max_leaf = __get_cpuid_max(0, nullptr);
+  if (max_leaf >= 1)
+    __cpuid(1, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+  if (max_leaf >= 7)
+    __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+# endif
+  const bool sse2 = leaf1[3] & (1u << 26);
+  const bool ssse3 = leaf1[2] & (1u << 9);
+  const bool sse41 = leaf1[2] & (1u << 19);
+  if (sse2 && (leaf1[2] & (1u << 25)))
+    features |= kCpuAes;
+  if (ssse3 && sse41 && (leaf7[1] & (1u << 29)))
+    features |= kCpuSha1;
+#elif defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+# if defined(__linux__)
+  // HWCAP_AES and HWCAP_SHA1 of <asm/hwcap.h>
+  const unsigned long hwcaps = getauxval(AT_HWCAP);
+  if (hwcaps & (1ul << 3))
+    features |= kCpuAes;
+  if (hwcaps & (1ul << 5))
+    features |= kCpuSha1;
+# else
+  // all 64-bit Apple CPUs have the crypto extension
+  features = kCpuAes | kCpuSha1;
+# endif
+#endif
+  return features;
+}
+
+inline unsigned crypto_features() {
+  static const unsigned features = detect_crypto_features();
+  return features;
+}
+
+}  // namespace cpu_detail
+
+/** @brief true if AES can be computed with the instructions of the CPU */
+inline bool cpu_has_aes() {
+  return (cpu_detail::crypto_features() & cpu_detail::kCpuAes) != 0;
+}
+
+/** @brief true if SHA1 can be computed with the instructions of the CPU */
+inline bool cpu_has_sha1() {
+  return (cpu_detail::crypto_features() & cpu_detail::kCpuSha1) != 0;
+}
+
+}  // namespace mysqlrouter
+
+#endif  // MYSQLROUTER_CPU_CRYPTO_INCLUDED
@@ -0,0 +1,97 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+  @file
+  AES block cipher using the crypto instructions of the CPU.
+
+  Used by the YaSSL build of the AES wrapper, OpenSSL picks them by itself.
+*/
+
+#ifndef MYSQLROUTER_MY_AES_HW_INCLUDED
+#define MYSQLROUTER_MY_AES_HW_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+namespace myaes {
+
+/**
+  AES-128/192/256 in ECB and CBC mode with AES-NI (x86) or the ARMv8
+  crypto extension.
+
+  Only usable if is_available() returns true.
+*/
+class AesHw {
+ public:
+  /** @brief true if the CPU has the instructions and they are enabled */
+  static bool is_available();
+
+  /**
+    Enables or disables the use of the instructions, process-wide.
+
+    Lets the tests run the software implementation on CPUs with them.
+  */
+  static void set_enabled(bool enabled);
+
+  /**
+    Expands the key for encryption and decryption.
+
+    @param key      the key
+    @param key_size 16, 24 or 32 bytes
+
+    @retval false if the key size isn't supported
+  */
+  bool set_key(const unsigned char *key, uint32_t key_size);
+
+  /**
+    En-/decrypts complete 16 byte blocks.
+
+    For CBC, iv is the initialisation vector of the first block and gets
+    set to the one of the block after the last.
+  */
+  void encrypt_ecb(unsigned char *dest, const unsigned char *source,
+                   size_t num_blocks) const;
+  void decrypt_ecb(unsigned char *dest, const unsigned char *source,
+                   size_t num_blocks) const;
+  void encrypt_cbc(unsigned char *dest, const unsigned char *source,
+                   size_t num_blocks, unsigned char *iv) const;
+  void decrypt_cbc(unsigned char *dest, const unsigned char *source,
+                   size_t num_blocks, unsigned char *iv) const;
+
+ private:
+  static const int kMaxRounds = 14;
+
+  // round keys in the byte order of FIPS-197, the decryption keys in the
+  // order they get applied, with InvMixColumns applied for the equivalent
+  // inverse cipher
+  alignas(16) uint8_t enc_keys_[kMaxRounds + 1][16];
+  alignas(16) uint8_t dec_keys_[kMaxRounds + 1][16];
+  int rounds_{0};
+};
+
+}  // namespace myaes
+
+#endif  // MYSQLROUTER_MY_AES_HW_INCLUDED
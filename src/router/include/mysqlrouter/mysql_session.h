@@ -143,6 +143,9 @@ class MySQLSession {
   virtual const char *last_error();
   virtual unsigned int last_errno();
 
+  /** @brief Version of the connected server as major*10000 + minor*100 + patch, 0 if not connected */
+  virtual unsigned long server_version() noexcept;
+
 private:
   MYSQL *connection_;
   bool connected_;
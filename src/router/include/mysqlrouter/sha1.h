@@ -35,6 +35,14 @@ void compute_sha1_hash(uint8_t *digest, const char *buf, size_t len);
 void compute_sha1_hash_multi(uint8_t *digest, const char *buf1, int len1,
                              const char *buf2, int len2);
 
+/**
+  Enables or disables computing the digests with the SHA instructions of the
+  CPU, process-wide.
+
+  Lets the tests run the software implementation on CPUs with them.
+*/
+void set_hw_enabled(bool enabled);
+
 }
 
 #endif /* SHA1_INCLUDED */
@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_STRING_VIEW_INCLUDED
+#define MYSQLROUTER_STRING_VIEW_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace mysqlrouter {
+
+/**
+ * Non-owning reference to a sequence of chars.
+ *
+ * The subset of C++17's std::string_view the router needs, the referenced
+ * string has to outlive the view.
+ */
+class string_view {
+ public:
+  using const_iterator = const char *;
+  static constexpr size_t npos = std::string::npos;
+
+  constexpr string_view() noexcept : data_(nullptr), size_(0) {}
+  constexpr string_view(const char *data, size_t size) noexcept
+      : data_(data), size_(size) {}
+  string_view(const char *str) noexcept : data_(str), size_(strlen(str)) {}
+  string_view(const std::string &str) noexcept
+      : data_(str.data()), size_(str.size()) {}
+
+  constexpr const char *data() const noexcept { return data_; }
+  constexpr size_t size() const noexcept { return size_; }
+  constexpr size_t length() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+
+  constexpr const_iterator begin() const noexcept { return data_; }
+  constexpr const_iterator end() const noexcept { return data_ + size_; }
+
+  constexpr char operator[](size_t pos) const { return data_[pos]; }
+
+  char at(size_t pos) const {
+    if (pos >= size_) throw std::out_of_range("string_view::at");
+    return data_[pos];
+  }
+
+  char back() const { return data_[size_ - 1]; }
+
+  string_view substr(size_t pos, size_t count = npos) const {
+    if (pos > size_) throw std::out_of_range("string_view::substr");
+    return string_view(data_ + pos, std::min(count, size_ - pos));
+  }
+
+  size_t find(char c, size_t pos = 0) const noexcept {
+    if (pos >= size_) return npos;
+    const void *found = memchr(data_ + pos, c, size_ - pos);
+    return found ? static_cast<size_t>(static_cast<const char *>(found) - data_)
+                 : npos;
+  }
+
+  size_t find_first_not_of(string_view chars, size_t pos = 0) const noexcept {
+    for (; pos < size_; ++pos) {
+      if (chars.find(data_[pos]) == npos) return pos;
+    }
+    return npos;
+  }
+
+  int compare(string_view other) const noexcept {
+    const int r = size_ && other.size_
+                      ? memcmp(data_, other.data_, std::min(size_, other.size_))
+                      : 0;
+    if (r != 0) return r;
+    return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+  }
+
+  int compare(size_t pos, size_t count, string_view other) const {
+    return substr(pos, count).compare(other);
+  }
+
+  std::string to_string() const { return std::string(data_, size_); }
+
+  explicit operator std::string() const { return to_string(); }
+
+ private:
+  const char *data_;
+  size_t size_;
+};
+
+inline bool operator==(string_view a, string_view b) noexcept {
+  return a.size() == b.size() && a.compare(b) == 0;
+}
+
+inline bool operator!=(string_view a, string_view b) noexcept {
+  return !(a == b);
+}
+
+inline bool operator<(string_view a, string_view b) noexcept {
+  return a.compare(b) < 0;
+}
+
+inline std::ostream &operator<<(std::ostream &os, string_view s) {
+  return os.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+}  // namespace mysqlrouter
+
+#endif  // MYSQLROUTER_STRING_VIEW_INCLUDED
@@ -26,12 +26,14 @@
 #define URI_ROUTING_INCLUDED
 
 #include "router_config.h"
+#include "mysqlrouter/string_view.h"
 
 #include <cstdint>
 #include <exception>
 #include <map>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 #ifndef _WIN32
 #  include <unistd.h>
@@ -49,7 +51,7 @@ using URIQuery = std::map<std::string, std::string>;
  */
 class URIError : public std::runtime_error {
 public:
-  URIError(const char *msg, const std::string &uri, size_t position);
+  URIError(const char *msg, string_view uri, size_t position);
   explicit URIError(const std::string &what_arg) : std::runtime_error(what_arg) { }
 };
 
@@ -137,9 +139,112 @@ private:
 
 std::ostream& operator<<(std::ostream &strm, const URI &uri);
 
+/** @class URIQueryView
+ * @brief Key-value pairs of a query-string, not decoded
+ *
+ * Walks the query-string on iteration instead of building a map. Like
+ * URIQuery, parts are separated by '&', empty parts and parts without a '='
+ * are skipped.
+ */
+class URIQueryView {
+public:
+  using value_type = std::pair<string_view, string_view>;
+
+  class const_iterator {
+  public:
+    const_iterator(string_view query, size_t pos) : query_(query), pos_(pos), next_(pos) {
+      find_part();
+    }
+
+    const value_type &operator*() const { return current_; }
+    const value_type *operator->() const { return &current_; }
+
+    const_iterator &operator++() {
+      pos_ = next_;
+      find_part();
+      return *this;
+    }
+
+    bool operator==(const const_iterator &other) const { return pos_ == other.pos_; }
+    bool operator!=(const const_iterator &other) const { return pos_ != other.pos_; }
+
+  private:
+    /** @brief moves to the next part with a '=', starting at pos_ */
+    void find_part();
+
+    string_view query_;
+    size_t pos_;
+    size_t next_;
+    value_type current_;
+  };
+
+  explicit URIQueryView(string_view query) : query_(query) { }
+
+  const_iterator begin() const { return const_iterator(query_, 0); }
+  const_iterator end() const { return const_iterator(query_, query_.length()); }
+
+  /** @brief finds the value of a key
+   *
+   * Compares the pct-decoded keys without allocating. If the key appears
+   * more than once, the last value wins.
+   *
+   * @param key decoded key
+   * @param value the value of the key, still pct-encoded
+   * @returns true if the key was found
+   */
+  bool find(string_view key, string_view &value) const;
+
+private:
+  string_view query_;
+};
+
+/** @class URIView
+ * @brief Parts of a URI as views into the parsed string
+ *
+ * Returned by URIParser::parse_view() for callers that only look at some
+ * of the parts of a URI. Nothing is decoded, the parsed string has to outlive
+ * the view.
+ */
+struct URIView {
+  /** @brief Scheme, not lowercased */
+  string_view scheme;
+  /** @brief Host, pct-encoded */
+  string_view host;
+  /** @brief Port, 0 if not set */
+  uint16_t port{0};
+  /** @brief Username, pct-encoded */
+  string_view username;
+  /** @brief Password, pct-encoded */
+  string_view password;
+  /** @brief Path without the leading '/', pct-encoded */
+  string_view path;
+  /** @brief Query-string without the '?' */
+  string_view query;
+  /** @brief Fragment without the '#', pct-encoded */
+  string_view fragment;
+
+  URIQueryView query_params() const { return URIQueryView(query); }
+
+  /** @brief compares the scheme case-insensitive
+   *
+   * @param lower_case_scheme scheme in lowercase
+   */
+  bool has_scheme(string_view lower_case_scheme) const;
+};
+
 class URIParser {
 public:
   static URI parse(const std::string &uri, bool allow_path_rootless = true);
+
+  /** @brief validates a URI like parse() without copying its parts
+   *
+   * Throws URIError on the same URIs as parse().
+   */
+  static URIView parse_view(string_view uri, bool allow_path_rootless = true);
+
+  /** @brief decodes the pct-encoding of a part of a URIView */
+  static std::string pct_decode(string_view s);
+
   static URI parse_shorthand_uri(const std::string &uri, bool allow_path_rootless = true,
       const std::string &default_scheme = "mysql");
 };
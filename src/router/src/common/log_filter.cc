@@ -30,6 +30,7 @@
 #endif
 
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <iterator>
 
@@ -147,8 +148,55 @@ LogFilter::~LogFilter() {
 }
 
 void SQLLogFilter::add_default_sql_patterns() {
-  add_pattern("^CREATE USER ([[:graph:]]+) IDENTIFIED WITH mysql_native_password AS ([[:graph:]]*)", 2);
-  add_pattern("^CREATE USER ([[:graph:]]+) IDENTIFIED BY ([[:graph:]]*)", 2);
+  default_sql_patterns_ = true;
+}
+
+namespace {
+// [[:graph:]] of the "C" locale
+bool is_graph(char c) {
+  const unsigned char uc = static_cast<unsigned char>(c);
+  return uc > 0x20 && uc < 0x7f;
+}
+
+// length of the run of [[:graph:]] characters starting at pos
+size_t graph_run_length(const std::string& s, size_t pos) {
+  size_t end = pos;
+  while (end < s.size() && is_graph(s[end]))
+    ++end;
+  return end - pos;
+}
+
+bool has_at(const std::string& s, size_t pos, const char* literal) {
+  return s.compare(pos, std::strlen(literal), literal) == 0;
+}
+}
+
+std::string SQLLogFilter::filter(const std::string& statement) const {
+  if (default_sql_patterns_) {
+    static const char kCreateUser[] = "CREATE USER ";
+
+    if (has_at(statement, 0, kCreateUser)) {
+      // the user name is a single token, the regex's "([[:graph:]]+) " can't
+      // match anything else
+      size_t pos = sizeof(kCreateUser) - 1;
+      const size_t user_length = graph_run_length(statement, pos);
+      if (user_length > 0) {
+        pos += user_length;
+        for (const char* secret_prefix : {" IDENTIFIED WITH mysql_native_password AS ",
+                                          " IDENTIFIED BY "}) {
+          if (has_at(statement, pos, secret_prefix)) {
+            const size_t secret_pos = pos + std::strlen(secret_prefix);
+            std::string result(statement);
+            result.replace(secret_pos, graph_run_length(statement, secret_pos),
+                           LogFilter::kFillSize, LogFilter::kFillCharacter);
+            return result;
+          }
+        }
+      }
+    }
+  }
+
+  return LogFilter::filter(statement);
 }
 
 } // end of mysqlrouter namespace
@@ -0,0 +1,315 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/my_aes_hw.h"
+#include "mysqlrouter/cpu_crypto.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO)
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#elif defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+#include <arm_neon.h>
+#endif
+
+namespace myaes {
+
+namespace {
+std::atomic<bool> hw_enabled{true};
+}  // namespace
+
+void AesHw::set_enabled(bool enabled) {
+  hw_enabled = enabled;
+}
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO) || defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+namespace {
+
+typedef uint8_t RoundKey[16];
+
+// blocks en-/decrypted in parallel, hiding the latency of the rounds
+const size_t kInterleave = 4;
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO)
+typedef __m128i Block;
+
+MYSQLROUTER_TARGET_AES inline Block load(const uint8_t *p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+MYSQLROUTER_TARGET_AES inline void store(uint8_t *p, Block b) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), b);
+}
+
+MYSQLROUTER_TARGET_AES inline Block xor_block(Block a, Block b) {
+  return _mm_xor_si128(a, b);
+}
+
+// SubWord() of FIPS-197, AESKEYGENASSIST returns it for the 2nd word in the
+// 1st word
+MYSQLROUTER_TARGET_AES uint32_t sub_word(uint32_t w) {
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_aeskeygenassist_si128(
+      _mm_set_epi32(0, 0, static_cast<int>(w), 0), 0)));
+}
+
+MYSQLROUTER_TARGET_AES void inv_mix_columns(uint8_t *dest, const uint8_t *source) {
+  store(dest, _mm_aesimc_si128(load(source)));
+}
+
+template <size_t N>
+MYSQLROUTER_TARGET_AES inline void encrypt_blocks(Block (&b)[N],
+                                                  const RoundKey *keys, int rounds) {
+  for (size_t i = 0; i < N; ++i) b[i] = _mm_xor_si128(b[i], load(keys[0]));
+  for (int r = 1; r < rounds; ++r) {
+    const Block k = load(keys[r]);
+    for (size_t i = 0; i < N; ++i) b[i] = _mm_aesenc_si128(b[i], k);
+  }
+  const Block k = load(keys[rounds]);
+  for (size_t i = 0; i < N; ++i) b[i] = _mm_aesenclast_si128(b[i], k);
+}
+
+template <size_t N>
+MYSQLROUTER_TARGET_AES inline void decrypt_blocks(Block (&b)[N],
+                                                  const RoundKey *keys, int rounds) {
+  for (size_t i = 0; i < N; ++i) b[i] = _mm_xor_si128(b[i], load(keys[0]));
+  for (int r = 1; r < rounds; ++r) {
+    const Block k = load(keys[r]);
+    for (size_t i = 0; i < N; ++i) b[i] = _mm_aesdec_si128(b[i], k);
+  }
+  const Block k = load(keys[rounds]);
+  for (size_t i = 0; i < N; ++i) b[i] = _mm_aesdeclast_si128(b[i], k);
+}
+#else
+typedef uint8x16_t Block;
+
+MYSQLROUTER_TARGET_AES inline Block load(const uint8_t *p) {
+  return vld1q_u8(p);
+}
+
+MYSQLROUTER_TARGET_AES inline void store(uint8_t *p, Block b) {
+  vst1q_u8(p, b);
+}
+
+MYSQLROUTER_TARGET_AES inline Block xor_block(Block a, Block b) {
+  return veorq_u8(a, b);
+}
+
+// SubWord() of FIPS-197: with the word in all columns, AESE with a zero key
+// is SubBytes() only as ShiftRows() has nothing to move
+MYSQLROUTER_TARGET_AES uint32_t sub_word(uint32_t w) {
+  return vgetq_lane_u32(vreinterpretq_u32_u8(vaeseq_u8(
+      vreinterpretq_u8_u32(vdupq_n_u32(w)), vdupq_n_u8(0))), 0);
+}
+
+MYSQLROUTER_TARGET_AES void inv_mix_columns(uint8_t *dest, const uint8_t *source) {
+  store(dest, vaesimcq_u8(load(source)));
+}
+
+// AESE/AESD add the round key before the substitution, the last key gets
+// added separately
+template <size_t N>
+MYSQLROUTER_TARGET_AES inline void encrypt_blocks(Block (&b)[N],
+                                                  const RoundKey *keys, int rounds) {
+  for (int r = 0; r < rounds - 1; ++r) {
+    const Block k = load(keys[r]);
+    for (size_t i = 0; i < N; ++i) b[i] = vaesmcq_u8(vaeseq_u8(b[i], k));
+  }
+  const Block k = load(keys[rounds - 1]);
+  const Block last = load(keys[rounds]);
+  for (size_t i = 0; i < N; ++i) b[i] = veorq_u8(vaeseq_u8(b[i], k), last);
+}
+
+template <size_t N>
+MYSQLROUTER_TARGET_AES inline void decrypt_blocks(Block (&b)[N],
+                                                  const RoundKey *keys, int rounds) {
+  for (int r = 0; r < rounds - 1; ++r) {
+    const Block k = load(keys[r]);
+    for (size_t i = 0; i < N; ++i) b[i] = vaesimcq_u8(vaesdq_u8(b[i], k));
+  }
+  const Block k = load(keys[rounds - 1]);
+  const Block last = load(keys[rounds]);
+  for (size_t i = 0; i < N; ++i) b[i] = veorq_u8(vaesdq_u8(b[i], k), last);
+}
+#endif
+
+MYSQLROUTER_TARGET_AES void ecb(uint8_t *dest, const uint8_t *source,
+                                size_t num_blocks, const RoundKey *keys,
+                                int rounds, bool encrypt) {
+  for (; num_blocks >= kInterleave; num_blocks -= kInterleave) {
+    Block b[kInterleave];
+    for (size_t i = 0; i < kInterleave; ++i) b[i] = load(source + 16 * i);
+    if (encrypt)
+      encrypt_blocks(b, keys, rounds);
+    else
+      decrypt_blocks(b, keys, rounds);
+    for (size_t i = 0; i < kInterleave; ++i) store(dest + 16 * i, b[i]);
+    source += 16 * kInterleave;
+    dest += 16 * kInterleave;
+  }
+  for (; num_blocks > 0; --num_blocks, source += 16, dest += 16) {
+    Block b[1] = {load(source)};
+    if (encrypt)
+      encrypt_blocks(b, keys, rounds);
+    else
+      decrypt_blocks(b, keys, rounds);
+    store(dest, b[0]);
+  }
+}
+
+// each block depends on the previous one, no interleaving
+MYSQLROUTER_TARGET_AES void cbc_encrypt(uint8_t *dest, const uint8_t *source,
+                                        size_t num_blocks, const RoundKey *keys,
+                                        int rounds, uint8_t *iv) {
+  Block b[1] = {load(iv)};
+  for (; num_blocks > 0; --num_blocks, source += 16, dest += 16) {
+    b[0] = xor_block(b[0], load(source));
+    encrypt_blocks(b, keys, rounds);
+    store(dest, b[0]);
+  }
+  store(iv, b[0]);
+}
+
+MYSQLROUTER_TARGET_AES void cbc_decrypt(uint8_t *dest, const uint8_t *source,
+                                        size_t num_blocks, const RoundKey *keys,
+                                        int rounds, uint8_t *iv) {
+  Block prev = load(iv);
+  for (; num_blocks >= kInterleave; num_blocks -= kInterleave) {
+    Block c[kInterleave];
+    Block b[kInterleave];
+    for (size_t i = 0; i < kInterleave; ++i) b[i] = c[i] = load(source + 16 * i);
+    decrypt_blocks(b, keys, rounds);
+    store(dest, xor_block(b[0], prev));
+    for (size_t i = 1; i < kInterleave; ++i)
+      store(dest + 16 * i, xor_block(b[i], c[i - 1]));
+    prev = c[kInterleave - 1];
+    source += 16 * kInterleave;
+    dest += 16 * kInterleave;
+  }
+  for (; num_blocks > 0; --num_blocks, source += 16, dest += 16) {
+    const Block c = load(source);
+    Block b[1] = {c};
+    decrypt_blocks(b, keys, rounds);
+    store(dest, xor_block(b[0], prev));
+    prev = c;
+  }
+  store(iv, prev);
+}
+
+}  // namespace
+
+bool AesHw::is_available() {
+  return hw_enabled && mysqlrouter::cpu_has_aes();
+}
+
+bool AesHw::set_key(const unsigned char *key, uint32_t key_size) {
+  if (key_size != 16 && key_size != 24 && key_size != 32)
+    return false;
+
+  // KeyExpansion() of FIPS-197, the words in the byte order of the key
+  const uint32_t nk = key_size / 4;
+  rounds_ = static_cast<int>(nk) + 6;
+  const uint32_t num_words = 4 * (static_cast<uint32_t>(rounds_) + 1);
+  uint32_t w[4 * (kMaxRounds + 1)];
+  memcpy(w, key, key_size);
+
+  uint32_t rcon = 0x01;
+  for (uint32_t i = nk; i < num_words; ++i) {
+    uint32_t temp = w[i - 1];
+    if (i % nk == 0) {
+      // RotWord(), the first byte is the lowest one in memory
+      uint32_t rotated = 0;
+      uint8_t bytes[4];
+      memcpy(bytes, &temp, 4);
+      const uint8_t rot[4] = {bytes[1], bytes[2], bytes[3], bytes[0]};
+      memcpy(&rotated, rot, 4);
+      temp = sub_word(rotated);
+
+      uint8_t first;
+      memcpy(&first, &temp, 1);
+      first = static_cast<uint8_t>(first ^ rcon);
+      memcpy(&temp, &first, 1);
+      rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x11b : 0);
+    } else if (nk > 6 && i % nk == 4) {
+      temp = sub_word(temp);
+    }
+    w[i] = w[i - nk] ^ temp;
+  }
+  memcpy(enc_keys_, w, num_words * 4);
+
+  // the equivalent inverse cipher uses the keys backwards
+  memcpy(dec_keys_[0], enc_keys_[rounds_], 16);
+  for (int r = 1; r < rounds_; ++r)
+    inv_mix_columns(dec_keys_[r], enc_keys_[rounds_ - r]);
+  memcpy(dec_keys_[rounds_], enc_keys_[0], 16);
+
+  // the expanded key stays in the object only
+  volatile uint32_t *wipe = w;
+  for (uint32_t i = 0; i < num_words; ++i) wipe[i] = 0;
+
+  return true;
+}
+
+void AesHw::encrypt_ecb(unsigned char *dest, const unsigned char *source,
+                        size_t num_blocks) const {
+  ecb(dest, source, num_blocks, enc_keys_, rounds_, true);
+}
+
+void AesHw::decrypt_ecb(unsigned char *dest, const unsigned char *source,
+                        size_t num_blocks) const {
+  ecb(dest, source, num_blocks, dec_keys_, rounds_, false);
+}
+
+void AesHw::encrypt_cbc(unsigned char *dest, const unsigned char *source,
+                        size_t num_blocks, unsigned char *iv) const {
+  cbc_encrypt(dest, source, num_blocks, enc_keys_, rounds_, iv);
+}
+
+void AesHw::decrypt_cbc(unsigned char *dest, const unsigned char *source,
+                        size_t num_blocks, unsigned char *iv) const {
+  cbc_decrypt(dest, source, num_blocks, dec_keys_, rounds_, iv);
+}
+
+#else
+
+bool AesHw::is_available() {
+  return false;
+}
+
+bool AesHw::set_key(const unsigned char *, uint32_t) {
+  return false;
+}
+
+void AesHw::encrypt_ecb(unsigned char *, const unsigned char *, size_t) const {}
+void AesHw::decrypt_ecb(unsigned char *, const unsigned char *, size_t) const {}
+void AesHw::encrypt_cbc(unsigned char *, const unsigned char *, size_t,
+                        unsigned char *) const {}
+void AesHw::decrypt_cbc(unsigned char *, const unsigned char *, size_t,
+                        unsigned char *) const {}
+
+#endif
+
+}  // namespace myaes
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA */
 #include "router_config.h"
 #include "mysqlrouter/my_aes.h"
 #include "mysqlrouter/my_aes_impl.h"
+#include "mysqlrouter/my_aes_hw.h"
 #include <string.h>
 #include <stdint.h>
 
@@ -62,7 +63,7 @@ template <TaoCrypt::CipherDir DIR>
 class MyCipherCtx
 {
 public:
-  MyCipherCtx(enum my_aes_opmode mode) : m_mode(mode)
+  MyCipherCtx(enum my_aes_opmode mode) : m_mode(mode), m_use_hw(false)
   {
     switch (m_mode)
     {
@@ -80,24 +81,35 @@ public:
   bool SetKey(const unsigned char *key, uint32_t block_size,
               const unsigned char *iv)
   {
-    if (m_need_iv)
+    if (m_need_iv && !iv)
+      return true;
+
+    /* use the AES instructions of the CPU if it has them */
+    if (AesHw::is_available() && hw.set_key(key, block_size))
     {
-      if (!iv)
-        return true;
-      cbc.SetKey(key, block_size, iv);
+      m_use_hw= true;
+      if (m_need_iv)
+        memcpy(m_iv, iv, MY_AES_BLOCK_SIZE);
+      return false;
     }
+
+    if (m_need_iv)
+      cbc.SetKey(key, block_size, iv);
     else
       ecb.SetKey(key, block_size);
     return false;
   }
 
+  /* length must be a multiple of MY_AES_BLOCK_SIZE */
   void Process(unsigned char *dest, const unsigned char * source,
-               uint32_t block_size)
+               uint32_t length)
   {
-    if (m_need_iv)
-      cbc.Process(dest, source, block_size);
+    if (m_use_hw)
+      ProcessHw(dest, source, length / MY_AES_BLOCK_SIZE);
+    else if (m_need_iv)
+      cbc.Process(dest, source, length);
     else
-      ecb.Process(dest, source, block_size);
+      ecb.Process(dest, source, length);
   }
 
   bool needs_iv() const
@@ -106,11 +118,33 @@ public:
   }
 
 private:
+  void ProcessHw(unsigned char *dest, const unsigned char * source,
+                 size_t num_blocks)
+  {
+    if (DIR == TaoCrypt::ENCRYPTION)
+    {
+      if (m_need_iv)
+        hw.encrypt_cbc(dest, source, num_blocks, m_iv);
+      else
+        hw.encrypt_ecb(dest, source, num_blocks);
+    }
+    else
+    {
+      if (m_need_iv)
+        hw.decrypt_cbc(dest, source, num_blocks, m_iv);
+      else
+        hw.decrypt_ecb(dest, source, num_blocks);
+    }
+  }
+
+  AesHw hw;
+  unsigned char m_iv[MY_AES_BLOCK_SIZE];
   /* we initialize the two classes to avoid dynamic allocation */
   TaoCrypt::BlockCipher<DIR, TaoCrypt::AES, TaoCrypt::ECB> ecb;
   TaoCrypt::BlockCipher<DIR, TaoCrypt::AES, TaoCrypt::CBC> cbc;
   enum my_aes_opmode m_mode;
   bool m_need_iv;
+  bool m_use_hw;
 };
 
 
@@ -125,7 +159,6 @@ int my_aes_encrypt(const unsigned char *source, uint32_t source_length,
   /* 128 bit block used for padding */
   unsigned char block[MY_AES_BLOCK_SIZE];
   uint32_t num_blocks;                               /* number of complete blocks */
-  uint32_t i;
   /* predicted real key size */
   const uint32_t key_size= my_aes_opmode_key_sizes[mode] / 8;
   /* The real key to be used for encryption */
@@ -139,9 +172,9 @@ int my_aes_encrypt(const unsigned char *source, uint32_t source_length,
   num_blocks= source_length / MY_AES_BLOCK_SIZE;
 
   /* Encode all complete blocks */
-  for (i = num_blocks; i > 0;
-       i--, source+= MY_AES_BLOCK_SIZE, dest+= MY_AES_BLOCK_SIZE)
-       enc.Process(dest, source, MY_AES_BLOCK_SIZE);
+  enc.Process(dest, source, MY_AES_BLOCK_SIZE * num_blocks);
+  source+= MY_AES_BLOCK_SIZE * num_blocks;
+  dest+= MY_AES_BLOCK_SIZE * num_blocks;
 
   /* If no padding, return here */
   if (!padding)
@@ -177,7 +210,6 @@ int my_aes_decrypt(const unsigned char *source, uint32_t source_length,
   /* 128 bit block used for padding */
   uint8_t block[MY_AES_BLOCK_SIZE];
   uint32_t num_blocks;                               /* Number of complete blocks */
-  int i;
   /* predicted real key size */
   const uint32_t key_size= my_aes_opmode_key_sizes[mode] / 8;
   /* The real key to be used for decryption */
@@ -196,9 +228,10 @@ int my_aes_decrypt(const unsigned char *source, uint32_t source_length,
     return MY_AES_BAD_DATA;
 
   /* Decode all but the last block */
-  for (i= padding? num_blocks - 1: num_blocks; i > 0;
-       i--, source+= MY_AES_BLOCK_SIZE, dest+= MY_AES_BLOCK_SIZE)
-       dec.Process(dest, source, MY_AES_BLOCK_SIZE);
+  const uint32_t full_blocks= padding? num_blocks - 1: num_blocks;
+  dec.Process(dest, source, MY_AES_BLOCK_SIZE * full_blocks);
+  source+= MY_AES_BLOCK_SIZE * full_blocks;
+  dest+= MY_AES_BLOCK_SIZE * full_blocks;
 
   /* If no padding, return here. */
   if (!padding)
@@ -97,8 +97,237 @@ int mysql_sha1_result(SHA_CTX *context,
 
 #endif /* HAVE_YASSL */
 
+#include "mysqlrouter/cpu_crypto.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO)
+#include <immintrin.h>
+#elif defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+#include <arm_neon.h>
+#endif
+
+namespace my_sha1 {
+namespace {
+std::atomic<bool> hw_enabled{true};
+}
+}
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO) || defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+namespace my_sha1 {
+namespace {
+
+const size_t kSha1BlockSize= 64;
+
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO)
+
+/* SHA1RNDS4 takes the round function as immediate */
+MYSQLROUTER_TARGET_SHA inline __m128i sha1_rounds4(__m128i abcd, __m128i e,
+                                                   int group)
+{
+  switch (group / 5)
+  {
+  case 0: return _mm_sha1rnds4_epu32(abcd, e, 0);
+  case 1: return _mm_sha1rnds4_epu32(abcd, e, 1);
+  case 2: return _mm_sha1rnds4_epu32(abcd, e, 2);
+  default: return _mm_sha1rnds4_epu32(abcd, e, 3);
+  }
+}
+
+/**
+  Process complete blocks with the SHA extension of x86.
+
+  Each of the 20 groups does 4 rounds and computes the message words of a
+  later group.
+*/
+MYSQLROUTER_TARGET_SHA void sha1_blocks(uint32_t state[5], const uint8_t *data,
+                                        size_t num_blocks)
+{
+  const __m128i byte_swap= _mm_set_epi64x(0x0001020304050607LL,
+                                          0x08090a0b0c0d0e0fLL);
+  __m128i abcd= _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1b);
+  __m128i e0= _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+  for (; num_blocks > 0; --num_blocks, data+= kSha1BlockSize)
+  {
+    const __m128i abcd_saved= abcd;
+    const __m128i e0_saved= e0;
+    __m128i msg[4];
+    __m128i e[2]= {e0, e0};
+
+    for (int i= 0; i < 4; ++i)
+      msg[i]= _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i)),
+          byte_swap);
+
+    for (int g= 0; g < 20; ++g)
+    {
+      __m128i &cur= e[g % 2];
+      if (g == 0)
+        cur= _mm_add_epi32(cur, msg[0]);
+      else
+        cur= _mm_sha1nexte_epu32(cur, msg[g % 4]);
+      e[(g + 1) % 2]= abcd;
+      abcd= sha1_rounds4(abcd, cur, g);
+
+      if (g >= 1 && g <= 16)
+        msg[(g + 3) % 4]= _mm_sha1msg1_epu32(msg[(g + 3) % 4], msg[g % 4]);
+      if (g >= 2 && g <= 17)
+        msg[(g + 2) % 4]= _mm_xor_si128(msg[(g + 2) % 4], msg[g % 4]);
+      if (g >= 3 && g <= 18)
+        msg[(g + 1) % 4]= _mm_sha1msg2_epu32(msg[(g + 1) % 4], msg[g % 4]);
+    }
+
+    e0= _mm_sha1nexte_epu32(e[0], e0_saved);
+    abcd= _mm_add_epi32(abcd, abcd_saved);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state),
+                   _mm_shuffle_epi32(abcd, 0x1b));
+  state[4]= static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+#else
+
+/* the round functions change every 20 rounds */
+MYSQLROUTER_TARGET_SHA inline uint32x4_t sha1_rounds4(uint32x4_t abcd,
+                                                      uint32_t e,
+                                                      uint32x4_t wk, int group)
+{
+  switch (group / 5)
+  {
+  case 0: return vsha1cq_u32(abcd, e, wk);
+  case 2: return vsha1mq_u32(abcd, e, wk);
+  default: return vsha1pq_u32(abcd, e, wk);
+  }
+}
+
+/**
+  Process complete blocks with the crypto extension of ARMv8.
+
+  Each of the 20 groups does 4 rounds and computes the message words of
+  the group 4 groups later.
+*/
+MYSQLROUTER_TARGET_SHA void sha1_blocks(uint32_t state[5], const uint8_t *data,
+                                        size_t num_blocks)
+{
+  static const uint32_t k[4]= {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+  uint32x4_t abcd= vld1q_u32(state);
+  uint32_t e= state[4];
+
+  for (; num_blocks > 0; --num_blocks, data+= kSha1BlockSize)
+  {
+    const uint32x4_t abcd_saved= abcd;
+    const uint32_t e_saved= e;
+    uint32x4_t msg[4];
+
+    for (int i= 0; i < 4; ++i)
+      msg[i]= vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+    for (int g= 0; g < 20; ++g)
+    {
+      const uint32x4_t wk= vaddq_u32(msg[g % 4], vdupq_n_u32(k[g / 5]));
+      const uint32_t e_next= vsha1h_u32(vgetq_lane_u32(abcd, 0));
+      abcd= sha1_rounds4(abcd, e, wk, g);
+      e= e_next;
+
+      if (g < 16)
+        msg[g % 4]= vsha1su1q_u32(
+            vsha1su0q_u32(msg[g % 4], msg[(g + 1) % 4], msg[(g + 2) % 4]),
+            msg[(g + 3) % 4]);
+    }
+
+    e+= e_saved;
+    abcd= vaddq_u32(abcd, abcd_saved);
+  }
+
+  vst1q_u32(state, abcd);
+  state[4]= e;
+}
+
+#endif
+
+/**
+  SHA1 message digest computed with the instructions of the CPU.
+*/
+class Sha1Hw
+{
+public:
+  Sha1Hw()
+  {
+    static const uint32_t initial[5]=
+      {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    memcpy(m_state, initial, sizeof(m_state));
+  }
+
+  static bool is_available()
+  {
+    return hw_enabled && mysqlrouter::cpu_has_sha1();
+  }
+
+  void update(const uint8_t *data, size_t len)
+  {
+    m_length+= len;
+    if (m_buffered > 0)
+    {
+      const size_t n= std::min(len, kSha1BlockSize - m_buffered);
+      memcpy(m_buffer + m_buffered, data, n);
+      m_buffered+= n;
+      data+= n;
+      len-= n;
+      if (m_buffered < kSha1BlockSize)
+        return;
+      sha1_blocks(m_state, m_buffer, 1);
+      m_buffered= 0;
+    }
+    sha1_blocks(m_state, data, len / kSha1BlockSize);
+    data+= len / kSha1BlockSize * kSha1BlockSize;
+    m_buffered= len % kSha1BlockSize;
+    memcpy(m_buffer, data, m_buffered);
+  }
+
+  void final(uint8_t *digest)
+  {
+    /* append 0x80, pad with zeros and the message length in bits */
+    const uint64_t bits= static_cast<uint64_t>(m_length) * 8;
+    m_buffer[m_buffered++]= 0x80;
+    if (m_buffered > kSha1BlockSize - 8)
+    {
+      memset(m_buffer + m_buffered, 0, kSha1BlockSize - m_buffered);
+      sha1_blocks(m_state, m_buffer, 1);
+      m_buffered= 0;
+    }
+    memset(m_buffer + m_buffered, 0, kSha1BlockSize - 8 - m_buffered);
+    for (int i= 0; i < 8; ++i)
+      m_buffer[kSha1BlockSize - 1 - i]= static_cast<uint8_t>(bits >> (8 * i));
+    sha1_blocks(m_state, m_buffer, 1);
+
+    for (int i= 0; i < 5; ++i)
+      for (int j= 0; j < 4; ++j)
+        digest[4 * i + j]= static_cast<uint8_t>(m_state[i] >> (24 - 8 * j));
+  }
+
+private:
+  uint32_t m_state[5];
+  uint8_t m_buffer[kSha1BlockSize];
+  size_t m_buffered= 0;
+  size_t m_length= 0;
+};
+
+}
+}
+#endif
+
 namespace my_sha1 {
 
+void set_hw_enabled(bool enabled)
+{
+  hw_enabled= enabled;
+}
+
 /**
   Wrapper function to compute SHA1 message digest.
 
@@ -108,6 +337,15 @@ namespace my_sha1 {
 */
 void compute_sha1_hash(uint8_t *digest, const char *buf, size_t len)
 {
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO) || defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+  if (Sha1Hw::is_available())
+  {
+    Sha1Hw hasher;
+    hasher.update(reinterpret_cast<const uint8_t *>(buf), len);
+    hasher.final(digest);
+    return;
+  }
+#endif
 #if defined(HAVE_YASSL)
   mysql_sha1_yassl(digest, buf, len);
 #elif defined(HAVE_OPENSSL)
@@ -133,6 +371,18 @@ void compute_sha1_hash(uint8_t *digest, const char *buf, size_t len)
 void compute_sha1_hash_multi(uint8_t *digest, const char *buf1, int len1,
                              const char *buf2, int len2)
 {
+#if defined(MYSQLROUTER_HAVE_X86_CRYPTO) || defined(MYSQLROUTER_HAVE_ARM_CRYPTO)
+  if (Sha1Hw::is_available())
+  {
+    Sha1Hw hasher;
+    hasher.update(reinterpret_cast<const uint8_t *>(buf1),
+                  static_cast<size_t>(len1));
+    hasher.update(reinterpret_cast<const uint8_t *>(buf2),
+                  static_cast<size_t>(len2));
+    hasher.final(digest);
+    return;
+  }
+#endif
 #if defined(HAVE_YASSL)
   mysql_sha1_multi_yassl(digest, buf1, len1, buf2, len2);
 #elif defined(HAVE_OPENSSL)
@@ -749,3 +749,7 @@ const char *MySQLSession::last_error() {
 unsigned int MySQLSession::last_errno() {
   return connection_ ? mysql_errno(connection_) : 0;
 }
+
+unsigned long MySQLSession::server_version() noexcept {
+  return is_connected() ? mysql_get_server_version(connection_) : 0;
+}
@@ -30,6 +30,7 @@
 #include "common.h"
 #include "dim.h"
 #include "harness_assert.h"
+#include "hostname_validator.h"
 #include "mysql/harness/config_parser.h"
 #include "mysql/harness/filesystem.h"
 #include "mysql/harness/logging/logging.h"
@@ -699,6 +700,91 @@ void ConfigGenerator::bootstrap_directory_deployment(const std::string &director
   auto_clean.clear();
 }
 
+std::vector<ConfigGenerator::FleetEntry>
+ConfigGenerator::read_fleet_file(std::istream &fleet_file) {
+  std::vector<FleetEntry> entries;
+  std::string line;
+  size_t line_number = 0;
+
+  while (std::getline(fleet_file, line)) {
+    ++line_number;
+    std::istringstream fields(line);
+    FleetEntry entry;
+    if (!(fields >> entry.name) || entry.name[0] == '#')
+      continue;
+
+    std::string extra;
+    if (!(fields >> entry.directory) ||
+        ((fields >> entry.report_host) && (fields >> extra))) {
+      throw std::runtime_error("Invalid fleet entry in line "
+          + std::to_string(line_number)
+          + ", expected: <name> <directory> [<report-host>]");
+    }
+    if (!entry.report_host.empty() &&
+        !mysql_harness::is_valid_hostname(entry.report_host.c_str())) {
+      throw std::runtime_error("Invalid report host '"
+          + truncate_string(entry.report_host) + "' in line "
+          + std::to_string(line_number));
+    }
+    for (const auto &other : entries) {
+      if (other.name == entry.name || other.directory == entry.directory)
+        throw std::runtime_error("Duplicate fleet entry in line "
+            + std::to_string(line_number));
+    }
+    entries.push_back(entry);
+  }
+  if (entries.empty())
+    throw std::runtime_error("Fleet file doesn't list any router");
+
+  return entries;
+}
+
+/**
+ * Create self-contained deployments of many Routers, one directory each.
+ */
+void ConfigGenerator::bootstrap_fleet_deployment(const std::string &fleet_file,
+    const std::map<std::string, std::string> &user_options,
+    const std::map<std::string, std::vector<std::string>> &multivalue_options,
+    const std::map<std::string, std::string> &default_paths) {
+  std::vector<FleetEntry> entries;
+  {
+    std::ifstream f(fleet_file);
+    if (!f)
+      throw std::runtime_error("Could not open fleet file '" + fleet_file
+                               + "': " + get_strerror(errno));
+    entries = read_fleet_file(f);
+  }
+
+  // all routers share the metadata, fetch it once
+  fetch_bootstrap_servers(cached_bootstrap_servers_, cached_metadata_cluster_,
+                          cached_metadata_replicaset_, cached_multi_master_);
+  use_cached_bootstrap_servers_ = true;
+
+  // the paths get resolved against the directory of each router
+  const KeyringInfo keyring_info(keyring_info_);
+
+  for (const auto &entry : entries) {
+    std::map<std::string, std::string> options(user_options);
+    options["name"] = entry.name;
+    if (!entry.report_host.empty())
+      options["report-host"] = entry.report_host;
+
+    keyring_info_ = keyring_info;
+    try {
+      bootstrap_directory_deployment(entry.directory, options,
+                                     multivalue_options, default_paths);
+    } catch (const std::exception &e) {
+      use_cached_bootstrap_servers_ = false;
+      mysql_harness::reset_keyring();
+      throw std::runtime_error("Bootstrapping router '" + entry.name
+                               + "' failed: " + e.what());
+    }
+    // each router has a keyring of its own
+    mysql_harness::reset_keyring();
+  }
+  use_cached_bootstrap_servers_ = false;
+}
+
 ConfigGenerator::Options ConfigGenerator::fill_options(
     bool multi_master,
     const std::map<std::string, std::string> &user_options) {
@@ -1034,10 +1120,17 @@ void ConfigGenerator::bootstrap_deployment(std::ostream &config_file,
   using RandomGen = mysql_harness::RandomGeneratorInterface;
   RandomGen& rg = mysql_harness::DIM::instance().get_RandomGenerator();
 
-  fetch_bootstrap_servers(
-    primary_replicaset_servers,
-    primary_cluster_name, primary_replicaset_name,
-    multi_master);
+  if (use_cached_bootstrap_servers_) {
+    primary_replicaset_servers = cached_bootstrap_servers_;
+    primary_cluster_name = cached_metadata_cluster_;
+    primary_replicaset_name = cached_metadata_replicaset_;
+    multi_master = cached_multi_master_;
+  } else {
+    fetch_bootstrap_servers(
+      primary_replicaset_servers,
+      primary_cluster_name, primary_replicaset_name,
+      multi_master);
+  }
 
   if (config_file_path.exists()) {
     std::tie(router_id, username) = get_router_id_and_name_from_config(config_file_path.str(),
@@ -1651,11 +1744,13 @@ std::string ConfigGenerator::create_router_accounts(const std::map<std::string,
   std::pair<std::string, bool> password_and_is_hashed =
       create_account_with_compliant_password(user_options, username, hostnames.front());
 
-  // and now we use that password info for creation of remaining accounts
-  for (auto it = hostnames.begin() + 1; it != hostnames.end(); ++it) {
+  // and now we use that password info for creation of remaining accounts,
+  // all at once
+  if (hostnames.size() > 1) {
     try {
-      create_account(username, *it, password_and_is_hashed.first /*password*/,
-                     password_and_is_hashed.second /*hash password*/);
+      create_accounts(username, std::vector<std::string>(hostnames.begin() + 1, hostnames.end()),
+                      password_and_is_hashed.first /*password*/,
+                      password_and_is_hashed.second /*hash password*/);
     }
 
     // create_account_with_compliant_password() should have caught these (and
@@ -1746,20 +1841,41 @@ void ConfigGenerator::create_account(const std::string &username,
                                      const std::string &hostname,
                                      const std::string &password,
                                      bool hash_password) {
+  create_accounts(username, {hostname}, password, hash_password);
+}
 
-  const std::string account = username + "@" + mysql_->quote(hostname);
-  log_info("Creating account %s", account.c_str());
+void ConfigGenerator::create_accounts(const std::string &username,
+                                      const std::vector<std::string> &hostnames,
+                                      const std::string &password,
+                                      bool hash_password) {
+  harness_assert(!hostnames.empty());
 
-  const std::string create_user = "CREATE USER " + account + " IDENTIFIED "
+  const std::string identified = std::string(" IDENTIFIED ")
       + (hash_password ? "WITH mysql_native_password AS " : "BY ")
       + mysql_->quote(hash_password ? compute_password_hash(password) : password);
 //    + mysql_->quote(password) + " REQUIRE X509";
 
+  // one statement for all accounts, multiple users are allowed by
+  // CREATE USER and GRANT
+  std::string accounts;
+  std::string create_user = "CREATE USER ";
+  for (const std::string &hostname : hostnames) {
+    const std::string account = username + "@" + mysql_->quote(hostname);
+    log_info("Creating account %s", account.c_str());
+
+    if (!accounts.empty()) {
+      accounts += ", ";
+      create_user += ", ";
+    }
+    accounts += account;
+    create_user += account + identified;
+  }
+
   const std::vector<std::string> queries{
     create_user,
-    "GRANT SELECT ON mysql_innodb_cluster_metadata.* TO " + account,
-    "GRANT SELECT ON performance_schema.replication_group_members TO " + account,
-    "GRANT SELECT ON performance_schema.replication_group_member_stats TO " + account
+    "GRANT SELECT ON mysql_innodb_cluster_metadata.* TO " + accounts,
+    "GRANT SELECT ON performance_schema.replication_group_members TO " + accounts,
+    "GRANT SELECT ON performance_schema.replication_group_member_stats TO " + accounts
   };
 
   for (auto &q : queries) {
@@ -29,6 +29,7 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <istream>
 #include <ostream>
 #include "mysqlrouter/datatypes.h"
 #include "mysqlrouter/utils.h"
@@ -50,6 +51,7 @@ DECLARE_TEST(ConfigGeneratorTest, fetch_bootstrap_servers_one);
 DECLARE_TEST(ConfigGeneratorTest, fetch_bootstrap_servers_three);
 DECLARE_TEST(ConfigGeneratorTest, fetch_bootstrap_servers_multiple_replicasets);
 DECLARE_TEST(ConfigGeneratorTest, fetch_bootstrap_servers_invalid);
+DECLARE_TEST(ConfigGeneratorTest, read_fleet_file);
 DECLARE_TEST(ConfigGeneratorTest, create_config_single_master);
 DECLARE_TEST(ConfigGeneratorTest, create_config_multi_master);
 DECLARE_TEST(ConfigGeneratorTest, delete_account_for_all_hosts);
@@ -100,6 +102,21 @@ public:
       const std::map<std::string, std::vector<std::string>> &multivalue_options,
       const std::map<std::string, std::string> &default_paths);
 
+  /**
+   * Create self-contained deployments of many Routers in one run.
+   *
+   * The fleet file has one router per line: its name, the directory to
+   * deploy it to and optionally the host name to report for it
+   * (--report-host). Empty lines and lines starting with '#' are ignored.
+   *
+   * All routers are bootstrapped over the connection opened by init(), the
+   * metadata of the cluster is fetched only once.
+   */
+  void bootstrap_fleet_deployment(const std::string &fleet_file,
+      const std::map<std::string, std::string> &options,
+      const std::map<std::string, std::vector<std::string>> &multivalue_options,
+      const std::map<std::string, std::string> &default_paths);
+
   void set_keyring_info(const KeyringInfo &keyring_info) {
     keyring_info_ = keyring_info;
   }
@@ -180,6 +197,14 @@ private:
 
   void init_keyring_file(uint32_t router_id);
 
+  struct FleetEntry {
+    std::string name;
+    std::string directory;
+    std::string report_host;
+  };
+
+  static std::vector<FleetEntry> read_fleet_file(std::istream &fleet_file);
+
   void fetch_bootstrap_servers(std::string &bootstrap_servers,
                                std::string &metadata_cluster,
                                std::string &metadata_replicaset,
@@ -284,6 +309,24 @@ private:
                       const std::string &password,
                       bool hash_password = false);
 
+  /** @brief Creates Router accounts for many hostnames at once (low-level function)
+   *
+   * Like create_account(), but creates the accounts of all hostnames with one
+   * CREATE USER and gives them GRANTs with one statement per GRANT, so the
+   * number of round trips doesn't depend on the number of hostnames.
+   *
+   * @param username Router accounts to be created - the username part
+   * @param hostnames Router accounts to be created - the hostname parts
+   * @param password Password for the accounts
+   * @param hash_password CREATE USER method, see create_account()
+   *
+   * @throws see create_account()
+   */
+  void create_accounts(const std::string &username,
+                       const std::vector<std::string> &hostnames,
+                       const std::string &password,
+                       bool hash_password = false);
+
   std::pair<uint32_t, std::string> get_router_id_and_name_from_config(const std::string &config_file_path,
                                           const std::string &cluster_name,
                                           bool forcing_overwrite);
@@ -330,6 +373,13 @@ private:
 
   KeyringInfo keyring_info_;
 
+  // metadata of the cluster, fetched once for all routers of a fleet
+  bool use_cached_bootstrap_servers_{false};
+  std::string cached_bootstrap_servers_;
+  std::string cached_metadata_cluster_;
+  std::string cached_metadata_replicaset_;
+  bool cached_multi_master_{false};
+
 #ifndef _WIN32
   SysUserOperationsBase* sys_user_operations_;
 #endif
@@ -339,6 +389,7 @@ private:
   FRIEND_TEST(::ConfigGeneratorTest, fetch_bootstrap_servers_three);
   FRIEND_TEST(::ConfigGeneratorTest, fetch_bootstrap_servers_multiple_replicasets);
   FRIEND_TEST(::ConfigGeneratorTest, fetch_bootstrap_servers_invalid);
+  FRIEND_TEST(::ConfigGeneratorTest, read_fleet_file);
   FRIEND_TEST(::ConfigGeneratorTest, create_config_single_master);
   FRIEND_TEST(::ConfigGeneratorTest, create_config_multi_master);
   FRIEND_TEST(::ConfigGeneratorTest, delete_account_for_all_hosts);
@@ -29,6 +29,7 @@
 #include "hostname_validator.h"
 #include "mysql/harness/config_parser.h"
 #include "mysql/harness/filesystem.h"
+#include "mysql/harness/logging/handler.h"
 #include "mysql/harness/logging/logging.h"
 #include "mysql/harness/logging/registry.h"
 #include "harness_assert.h"
@@ -39,12 +40,14 @@
 #include "config_files.h"
 
 #include <algorithm>
+#include <cctype>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -433,6 +436,45 @@ static void set_default_log_level(mysql_harness::LoaderConfig& config, bool raw_
   }
 }
 
+// reads the logfile rotation options of the [logger] section, see
+// set_default_log_level() for why they are read from there
+static mysql_harness::logging::LogRotation get_log_rotation(const mysql_harness::LoaderConfig& config) {
+  using mysql_harness::logging::kConfigSectionLogger;
+
+  mysql_harness::logging::LogRotation rotation;
+  if (!config.has(kConfigSectionLogger))
+    return rotation;
+  const mysql_harness::ConfigSection& section = config.get(kConfigSectionLogger, "");
+
+  auto get_number = [&section](const char* option, uint64_t max_value) -> uint64_t {
+    const std::string value = section.get(option);
+    char* rest;
+    errno = 0;
+    const unsigned long long result = std::strtoull(value.c_str(), &rest, 10);
+    if (value.empty() || !isdigit(static_cast<unsigned char>(value[0])) || *rest != '\0' ||
+        errno > 0 || result > max_value)
+      throw std::invalid_argument(std::string("[") + kConfigSectionLogger + "] option '" +
+                                  option + "' needs a value between 0 and " +
+                                  std::to_string(max_value) + ", got '" + value + "'");
+    return result;
+  };
+
+  using mysql_harness::logging::kConfigOptionRotateMaxSize;
+  using mysql_harness::logging::kConfigOptionRotateMaxAge;
+  using mysql_harness::logging::kConfigOptionRotateKeep;
+  using mysql_harness::logging::kConfigOptionRotateCompress;
+  if (section.has(kConfigOptionRotateMaxSize))
+    rotation.max_size = get_number(kConfigOptionRotateMaxSize, std::numeric_limits<uint64_t>::max());
+  if (section.has(kConfigOptionRotateMaxAge))
+    rotation.max_age = std::chrono::seconds(get_number(kConfigOptionRotateMaxAge, std::numeric_limits<uint32_t>::max()));
+  if (section.has(kConfigOptionRotateKeep))
+    rotation.keep = static_cast<unsigned>(get_number(kConfigOptionRotateKeep, std::numeric_limits<unsigned>::max()));
+  if (section.has(kConfigOptionRotateCompress))
+    rotation.compress = get_number(kConfigOptionRotateCompress, 1) == 1;
+
+  return rotation;
+}
+
 std::exception_ptr detect_and_fix_nonfatal_problems(mysql_harness::LoaderConfig& config) {
   // This function checks (and fixes) certain logging-related problems, which can be fixed well
   // enough to enable the logger to initialize, and therefore log the actual problem, before the
@@ -458,6 +500,9 @@ std::exception_ptr detect_and_fix_nonfatal_problems(mysql_harness::LoaderConfig&
 /*static*/
 void MySQLRouter::init_main_logger(mysql_harness::LoaderConfig& config, bool raw_mode /*= false*/) {
 
+  // read before set_default_log_level() erases the [logger] section
+  const mysql_harness::logging::LogRotation rotation = get_log_rotation(config);  // throws std::invalid_argument
+
   // set defaults if they're not defined
   set_default_log_level(config, raw_mode);  // throws std::runtime_error on [logger:some_key] section
   if (!config.has_default("logging_folder"))
@@ -489,7 +534,8 @@ void MySQLRouter::init_main_logger(mysql_harness::LoaderConfig& config, bool raw
 
     // attach all loggers to main handler (throws std::runtime_error)
     mysql_harness::logging::create_main_logfile_handler(*registry, kProgramName,
-                                                        logging_folder, !raw_mode);
+                                                        logging_folder, !raw_mode,
+                                                        rotation);
 
     // nothing threw - we're good. Now let's replace the new registry with the old one
     DIM::instance().set_LoggingRegistry([&registry](){ return registry.release(); },
@@ -639,6 +685,15 @@ void MySQLRouter::start() {
 
   init_loader(config);  // throws std::runtime_error
 
+  // SIGHUP re-reads the same files, the [logger] section only takes effect
+  // at startup
+  loader_->set_config_reader([this]() {
+    ConfigFiles reload_files(default_config_files_, config_files_, extra_config_files_);
+    std::unique_ptr<mysql_harness::LoaderConfig> fresh(make_config(get_default_paths(), reload_files));
+    fresh->remove(mysql_harness::logging::kConfigSectionLogger);
+    return fresh;
+  });
+
   if (!pid_file_path_.empty()) {
     auto pid = getpid();
     std::ofstream pidfile(pid_file_path_);
@@ -783,6 +838,24 @@ void MySQLRouter::prepare_command_options() noexcept {
         this->bootstrap_directory_ = path;
       }, [this] { this->assert_bootstrap_mode("-d/--directory"); });
 
+  arg_handler_.add_option(OptionNames({"--bootstrap-fleet"}),
+                          "Creates a self-contained directory for each Router listed in the file, "
+                          "one per line as '<name> <directory> [<report-host>]'. (bootstrap)",
+                          CmdOptionValueReq::required, "fleet_file",
+                          [this](const string &path) {
+        if (path.empty()) {
+          throw std::runtime_error("Invalid value for --bootstrap-fleet option");
+        }
+        this->bootstrap_fleet_file_ = path;
+      },
+      [this] {
+        this->assert_bootstrap_mode("--bootstrap-fleet");
+        if (!this->bootstrap_directory_.empty())
+          throw std::runtime_error("Option --bootstrap-fleet can not be used together with -d/--directory.");
+        if (this->bootstrap_options_.count("name") || this->bootstrap_options_.count("report-host"))
+          throw std::runtime_error("Option --bootstrap-fleet can not be used together with --name or --report-host.");
+      });
+
 #ifndef _WIN32
   arg_handler_.add_option(OptionNames({"--conf-use-sockets"}),
                           "Whether to use Unix domain sockets. (bootstrap)",
@@ -1082,7 +1155,13 @@ void MySQLRouter::bootstrap(const std::string &server_url) {
 
   auto default_paths = get_default_paths();
 
-  if (bootstrap_directory_.empty()) {
+  if (!bootstrap_fleet_file_.empty()) {
+    keyring_info_.set_keyring_file(kDefaultKeyringFileName);
+    keyring_info_.set_master_key_file("mysqlrouter.key");
+    config_gen.set_keyring_info(keyring_info_);
+    config_gen.bootstrap_fleet_deployment(bootstrap_fleet_file_,
+        bootstrap_options_, bootstrap_multivalue_options_, default_paths);
+  } else if (bootstrap_directory_.empty()) {
     std::string config_file_path =
         mysqlrouter::substitute_variable(MYSQL_ROUTER_CONFIG_FOLDER"/mysqlrouter.conf",
                                          "{origin}", origin_.str());
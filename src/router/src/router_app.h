@@ -455,6 +455,10 @@ private:
    * @brief Valueof the argument passed to the --directory command line option
    */
   std::string bootstrap_directory_;
+  /**
+   * @brief Value of the argument passed to the --bootstrap-fleet command line option
+   */
+  std::string bootstrap_fleet_file_;
   /**
    * @brief key/value map of additional configuration options for bootstrap
    */
@@ -23,15 +23,13 @@
 */
 
 #include "mysqlrouter/uri.h"
-#include "mysqlrouter/utils.h"
-#include "utils.h"
-
 
 #include <algorithm>
 #include <cctype>
 #include <climits>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 
 using std::string;
@@ -40,6 +38,9 @@ using std::string;
 //
 // recursive decent parser
 //
+// the matchers return views into the parsed string, nothing gets copied
+// until the values get decoded.
+//
 // TODO(jan): add IPvFuture
 
 const string kDigit = "0123456789";
@@ -55,11 +56,14 @@ const string kSubDelims = "!$&'()*+,;=";
 const string kReserved = kGenDelims + kSubDelims;
 const string kPathCharNoPctEncoded = kUnreserved + kSubDelims + ":" + "@";
 const string kFragmentOrQuery = "/?";
+const string kSchemeChars = kAlpha + kDigit + "+-.";
+const string kRegNameChars = kUnreserved + kSubDelims;
+const string kUserInfoChars = kUnreserved + kSubDelims + ":";
 
 namespace mysqlrouter {
 
-URIError::URIError(const char *msg, const std::string &uri, size_t position) :
-    std::runtime_error(std::string("invalid URI: ") + msg + " at position " + std::to_string(position) + " for: " + uri) {}
+URIError::URIError(const char *msg, string_view uri, size_t position) :
+    std::runtime_error(std::string("invalid URI: ") + msg + " at position " + std::to_string(position) + " for: " + uri.to_string()) {}
 
 /*
  * match zero-or-more of group of characters
@@ -67,10 +71,10 @@ URIError::URIError(const char *msg, const std::string &uri, size_t position) :
  * @returns matched length
  */
 static size_t
-match_zero_or_more(const string &s, const string &pat, size_t pos_start = 0) {
+match_zero_or_more(string_view s, string_view pat, size_t pos_start = 0) {
   size_t pos_matched = s.find_first_not_of(pat, pos_start);
 
-  if (pos_matched == string::npos) {
+  if (pos_matched == string_view::npos) {
     pos_matched = s.length();
   }
 
@@ -82,21 +86,21 @@ skip(size_t pos_start, size_t match_len) {
   return pos_start + match_len;
 }
 
-static string
-capture(const string &s, size_t pos_start, size_t match_len, size_t &pos_end) {
+static string_view
+capture(string_view s, size_t pos_start, size_t match_len, size_t &pos_end) {
   pos_end = skip(pos_start, match_len);
 
   return s.substr(pos_start, match_len);
 }
 
 static bool
-is_eol(const string &s, size_t pos_start) {
+is_eol(string_view s, size_t pos_start) {
   return pos_start == s.length();
 }
 
 
 static bool
-match_pct_encoded(const string &s, size_t pos_start, size_t &pos_end, string &pct_enc) {
+match_pct_encoded(string_view s, size_t pos_start, size_t &pos_end, string_view &pct_enc) {
   // pct-encoded = "%" HEXDIG HEXDIG
   if (s.length() - pos_start < 3) {
     return false;
@@ -112,11 +116,10 @@ match_pct_encoded(const string &s, size_t pos_start, size_t &pos_end, string &pc
 }
 
 static bool
-match_path_chars(const string &s, size_t pos_start, size_t &pos_end, string &path_chars) {
+match_path_chars(string_view s, size_t pos_start, size_t &pos_end, string_view &path_chars) {
   // pchar       = unreserved / pct-encoded / sub-delims / ":" / "@"
 
   bool made_progress;
-  string tmp;
   size_t pos_matched = pos_start;
 
   do {
@@ -127,25 +130,22 @@ match_path_chars(const string &s, size_t pos_start, size_t &pos_end, string &pat
     if (match_len > 0) {
       made_progress = true;
 
-      tmp.append(capture(s, pos_matched, match_len, pos_matched));
+      pos_matched = skip(pos_matched, match_len);
     }
 
-    string pct_enc;
+    string_view pct_enc;
     if (match_pct_encoded(s, pos_matched, pos_matched, pct_enc)) {
-      tmp.append(pct_enc);
-
       made_progress = true;
     }
   } while(made_progress);
 
-  path_chars = std::move(tmp);
-  pos_end = pos_matched;
+  path_chars = capture(s, pos_start, pos_matched - pos_start, pos_end);
 
   return true;
 }
 
 static bool
-match_scheme(const string &s, size_t pos_start, size_t &pos_end, string &scheme) {
+match_scheme(string_view s, size_t pos_start, size_t &pos_end, string_view &scheme) {
   // scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
   //
   size_t match_len = match_zero_or_more(s, kAlpha, pos_start);
@@ -154,7 +154,7 @@ match_scheme(const string &s, size_t pos_start, size_t &pos_end, string &scheme)
     // no ALPHA
     return false;
   }
-  match_len += match_zero_or_more(s, kAlpha + kDigit + "+-.", pos_start + match_len);
+  match_len += match_zero_or_more(s, kSchemeChars, pos_start + match_len);
 
   scheme = capture(s, pos_start, match_len, pos_end);
 
@@ -162,7 +162,7 @@ match_scheme(const string &s, size_t pos_start, size_t &pos_end, string &scheme)
 }
 
 static bool
-match_colon(const string &s, size_t pos_start, size_t &pos_end) {
+match_colon(string_view s, size_t pos_start, size_t &pos_end) {
   if (is_eol(s, pos_start)) {
     return false;
   }
@@ -176,7 +176,7 @@ match_colon(const string &s, size_t pos_start, size_t &pos_end) {
 }
 
 static bool
-match_double_colon(const string &s, size_t pos_start, size_t &pos_end) {
+match_double_colon(string_view s, size_t pos_start, size_t &pos_end) {
   if (s.length() - pos_start < 2) {
     return false;
   }
@@ -191,28 +191,25 @@ match_double_colon(const string &s, size_t pos_start, size_t &pos_end) {
 
 
 static bool
-match_userinfo(const string &s, size_t pos_start, size_t &pos_end, string &user_info) {
+match_userinfo(string_view s, size_t pos_start, size_t &pos_end, string_view &user_info) {
   // userinfo    = *( unreserved / pct-encoded / sub-delims / ":" )
 
   bool made_progress;
-  string tmp;
   size_t pos_matched = pos_start;
 
   do {
     made_progress = false;
 
-    size_t match_len = match_zero_or_more(s, kUnreserved + kSubDelims + ":", pos_matched);
+    size_t match_len = match_zero_or_more(s, kUserInfoChars, pos_matched);
 
     if (match_len > 0) {
       made_progress = true;
 
-      tmp.append(capture(s, pos_matched, match_len, pos_matched));
+      pos_matched = skip(pos_matched, match_len);
     }
 
-    string pct_enc;
+    string_view pct_enc;
     if (match_pct_encoded(s, pos_matched, pos_matched, pct_enc)) {
-      tmp.append(pct_enc);
-
       made_progress = true;
     }
   } while(made_progress);
@@ -226,7 +223,7 @@ match_userinfo(const string &s, size_t pos_start, size_t &pos_end, string &user_
     return false;
   }
 
-  user_info = std::move(tmp);
+  user_info = s.substr(pos_start, pos_matched - pos_start);
 
   // skip the @
   pos_end = pos_matched + 1;
@@ -235,20 +232,20 @@ match_userinfo(const string &s, size_t pos_start, size_t &pos_end, string &user_
 }
 
 static void
-split_userinfo(const string &user_info, string &username, string &password) {
+split_userinfo(string_view user_info, string_view &username, string_view &password) {
   size_t pos = user_info.find(':');
-  if (pos != string::npos) {
+  if (pos != string_view::npos) {
     username = user_info.substr(0, pos);
-    password = user_info.substr(pos + 1, user_info.size() - (pos + 1));
+    password = user_info.substr(pos + 1);
   } else {
     // No password
     username = user_info;
-    password = "";
+    password = string_view();
   }
 }
 
 static bool
-match_port(const string &s, size_t pos_start, size_t &pos_end, string &port) {
+match_port(string_view s, size_t pos_start, size_t &pos_end, string_view &port) {
   /* port        = *DIGIT
    */
   size_t match_len = match_zero_or_more(s, kDigit, pos_start);
@@ -259,7 +256,7 @@ match_port(const string &s, size_t pos_start, size_t &pos_end, string &port) {
 }
 
 static bool
-match_reg_name(const string &s, size_t pos_start, size_t &pos_end, string &reg_name, bool with_pct_encoded) {
+match_reg_name(string_view s, size_t pos_start, size_t &pos_end, string_view &reg_name, bool with_pct_encoded) {
   /* reg-name    = *( unreserved / pct-encoded / sub-delims )
    */
   bool made_progress;
@@ -268,34 +265,31 @@ match_reg_name(const string &s, size_t pos_start, size_t &pos_end, string &reg_n
   do {
     made_progress = false;
 
-    size_t match_len = match_zero_or_more(s, kUnreserved + kSubDelims, pos_matched);
+    size_t match_len = match_zero_or_more(s, kRegNameChars, pos_matched);
 
     if (match_len > 0) {
-      reg_name.append(capture(s, pos_matched, match_len, pos_matched));
+      pos_matched = skip(pos_matched, match_len);
       made_progress = true;
     }
 
     if (with_pct_encoded) {
-      string pct_enc;
+      string_view pct_enc;
       if (match_pct_encoded(s, pos_matched, pos_matched, pct_enc)) {
-        reg_name.append(pct_enc);
-
         made_progress = true;
       }
     } else if (pos_matched < s.length() && s.at(pos_matched) == '%') {
-      reg_name += '%';
       made_progress = true;
       pos_matched += 1;
     }
   } while (made_progress);
 
-  pos_end = pos_matched;
+  reg_name = capture(s, pos_start, pos_matched - pos_start, pos_end);
 
   return true;
 }
 
 static bool
-match_dec_octet(const string &s, size_t pos_start, size_t &pos_end, string &dec_octet) {
+match_dec_octet(string_view s, size_t pos_start, size_t &pos_end, string_view &dec_octet) {
   size_t match_len = match_zero_or_more(s, kDigit, pos_start);
 
   if (match_len == 0 || match_len > 3) {
@@ -309,8 +303,8 @@ match_dec_octet(const string &s, size_t pos_start, size_t &pos_end, string &dec_
 }
 
 static bool
-match_ipv4(const string &s, size_t pos_start, size_t &pos_end, string &ipv4_addr) {
-  string dec_octet;
+match_ipv4(string_view s, size_t pos_start, size_t &pos_end, string_view &ipv4_addr) {
+  string_view dec_octet;
   size_t pos_matched;
 
   if (!match_dec_octet(s, pos_start, pos_matched, dec_octet)) {
@@ -335,7 +329,7 @@ match_ipv4(const string &s, size_t pos_start, size_t &pos_end, string &ipv4_addr
 }
 
 static bool
-match_ipv6_h16(const string &s, size_t pos_start, size_t &pos_end, string &h16) {
+match_ipv6_h16(string_view s, size_t pos_start, size_t &pos_end, string_view &h16) {
   // 1*4HEXDIG
   size_t match_len = match_zero_or_more(s, kHexDigit, pos_start);
 
@@ -353,11 +347,11 @@ match_ipv6_h16(const string &s, size_t pos_start, size_t &pos_end, string &h16)
 }
 
 static bool
-match_ipv6_ls32(const string &s, size_t pos_start, size_t &pos_end, string &ls32) {
+match_ipv6_ls32(string_view s, size_t pos_start, size_t &pos_end, string_view &ls32) {
   // ( h16 ":" h16 ) / IPv4address
   //
   size_t pos_matched;
-  string tmp;
+  string_view tmp;
 
   if (!(match_ipv6_h16(s, pos_start, pos_matched, tmp) &&
         match_colon(s, pos_matched, pos_matched) &&
@@ -372,12 +366,12 @@ match_ipv6_ls32(const string &s, size_t pos_start, size_t &pos_end, string &ls32
 }
 
 static bool
-match_ipv6_h16_colon(const string &s, size_t pos_start, size_t &pos_end, string &h16_colon) {
+match_ipv6_h16_colon(string_view s, size_t pos_start, size_t &pos_end, string_view &h16_colon) {
   // h16 ":"
   //
   // ensure that we don't make h16 "::"
   size_t pos_matched;
-  string tmp;
+  string_view tmp;
 
   if (!match_ipv6_h16(s, pos_start, pos_matched, tmp)) {
     return false;
@@ -397,10 +391,10 @@ match_ipv6_h16_colon(const string &s, size_t pos_start, size_t &pos_end, string
 }
 
 static bool
-match_ipv6_1(const string &s, size_t pos_start, size_t &pos_end, string &ipv6_addr) {
+match_ipv6_1(string_view s, size_t pos_start, size_t &pos_end, string_view &ipv6_addr) {
   // 1st line in the IPv6Address line in the RFC
   size_t pos_matched = pos_start;
-  string tmp;
+  string_view tmp;
   size_t sections;
 
   for (sections = 0; sections < 6; sections++) {
@@ -423,10 +417,10 @@ match_ipv6_1(const string &s, size_t pos_start, size_t &pos_end, string &ipv6_ad
 }
 
 static bool
-match_ipv6_2(const string &s, size_t pos_start, size_t &pos_end, string &ipv6_addr) {
+match_ipv6_2(string_view s, size_t pos_start, size_t &pos_end, string_view &ipv6_addr) {
   // 2nd line in the IPv6Address line in the RFC
   size_t pos_matched = pos_start;
-  string tmp;
+  string_view tmp;
   size_t sections;
 
   if (!match_double_colon(s, pos_matched, pos_matched)) {
@@ -453,11 +447,11 @@ match_ipv6_2(const string &s, size_t pos_start, size_t &pos_end, string &ipv6_ad
 }
 
 static bool
-match_ipv6_h16_colon_prefix(const string &s, size_t pos_start,
+match_ipv6_h16_colon_prefix(string_view s, size_t pos_start,
     size_t max_pre_double_colon,
-    size_t &pos_end, string &ipv6_addr) {
+    size_t &pos_end, string_view &ipv6_addr) {
   size_t pos_matched = pos_start;
-  string tmp;
+  string_view tmp;
   size_t sections;
 
   for (sections = 0; sections < max_pre_double_colon; sections++) {
@@ -476,12 +470,12 @@ match_ipv6_h16_colon_prefix(const string &s, size_t pos_start,
 }
 
 static bool
-match_ipv6_3(const string &s, size_t pos_start,
+match_ipv6_3(string_view s, size_t pos_start,
     size_t max_pre_double_colon,
-    size_t &pos_end, string &ipv6_addr) {
+    size_t &pos_end, string_view &ipv6_addr) {
   // 3rd-7th line in the IPv6Address line in the RFC
   size_t pos_matched = pos_start;
-  string tmp;
+  string_view tmp;
   size_t sections;
 
   size_t post_double_colon = 4 - max_pre_double_colon;
@@ -512,12 +506,12 @@ match_ipv6_3(const string &s, size_t pos_start,
 }
 
 static bool
-match_ipv6_8(const string &s, size_t pos_start,
+match_ipv6_8(string_view s, size_t pos_start,
     size_t max_pre_double_colon,
-    size_t &pos_end, string &ipv6_addr) {
+    size_t &pos_end, string_view &ipv6_addr) {
   // 8th-9th line in the IPv6Address line in the RFC
   size_t pos_matched = pos_start;
-  string tmp;
+  string_view tmp;
 
   match_ipv6_h16_colon_prefix(s, pos_matched, max_pre_double_colon, pos_matched, tmp);
 
@@ -538,11 +532,10 @@ match_ipv6_8(const string &s, size_t pos_start,
 
 
 static bool
-match_ipv6_zoneid(const string &s, size_t pos_start, size_t &pos_end, string &zoneid, bool with_pct_encoded) {
+match_ipv6_zoneid(string_view s, size_t pos_start, size_t &pos_end, string_view &zoneid, bool with_pct_encoded) {
   // zoneid       = unreserved / pct-encoded
 
   bool made_progress;
-  string tmp;
   size_t pos_matched = pos_start;
 
   do {
@@ -553,36 +546,31 @@ match_ipv6_zoneid(const string &s, size_t pos_start, size_t &pos_end, string &zo
     if (match_len > 0) {
       made_progress = true;
 
-      tmp.append(capture(s, pos_matched, match_len, pos_matched));
+      pos_matched = skip(pos_matched, match_len);
     }
 
     if (with_pct_encoded) {
-      string pct_enc;
+      string_view pct_enc;
       if (match_pct_encoded(s, pos_matched, pos_matched, pct_enc)) {
-        tmp.append(pct_enc);
-
         made_progress = true;
       }
     } else if (s.at(pos_matched) == '%') {
-        tmp += '%';
-
         made_progress = true;
         pos_matched += 1;
     }
   } while(made_progress);
 
-  if (tmp.length() == 0) {
+  if (pos_matched == pos_start) {
     return false;
   }
 
-  zoneid = std::move(tmp);
-  pos_end = pos_matched;
+  zoneid = capture(s, pos_start, pos_matched - pos_start, pos_end);
 
   return true;
 }
 
 static bool
-match_ipv6(const string &s, size_t pos_start, size_t &pos_end, string &ipv6_addr) {
+match_ipv6(string_view s, size_t pos_start, size_t &pos_end, string_view &ipv6_addr) {
   // we can have max 8 sections.
   // sections of all zeros may be compressed with :: once
   // the last two sections may be IPv4 notation
@@ -601,7 +589,7 @@ match_ipv6(const string &s, size_t pos_start, size_t &pos_end, string &ipv6_addr
 }
 
 static bool
-match_ip_literal(const string &s, size_t pos_start, size_t &pos_end, string &ip_literal, bool with_pct_encoded) {
+match_ip_literal(string_view s, size_t pos_start, size_t &pos_end, string_view &ip_literal, bool with_pct_encoded) {
   // IP-literal = "[" ( IPv6address / IPv6addrz / IPvFuture ) "]"
   //
   // RFC 4291
@@ -618,7 +606,7 @@ match_ip_literal(const string &s, size_t pos_start, size_t &pos_end, string &ip_
 
   pos_start += 1;
 
-  string tmp;
+  string_view tmp;
   size_t pos_matched;
 
   if (!match_ipv6(s, pos_start, pos_matched, tmp)) {
@@ -627,7 +615,7 @@ match_ip_literal(const string &s, size_t pos_start, size_t &pos_end, string &ip_
 
   if (with_pct_encoded) {
     if (match_pct_encoded(s, pos_matched, pos_matched, tmp)) {
-      if (tmp.compare("%25") == 0) {
+      if (tmp == "%25") {
         if (!match_ipv6_zoneid(s, pos_matched, pos_matched, tmp, with_pct_encoded)) {
           throw URIError("invalid zoneid", s, pos_matched);
         }
@@ -650,7 +638,7 @@ match_ip_literal(const string &s, size_t pos_start, size_t &pos_end, string &ip_
 }
 
 static bool
-match_host(const string &s, size_t pos_start, size_t &pos_end, string &host, bool with_pct_encoded) {
+match_host(string_view s, size_t pos_start, size_t &pos_end, string_view &host, bool with_pct_encoded) {
   // host        = IP-literal / IPv4address / reg-name
   //
   // match_reg_name has to be last as it accepts the 'empty host'
@@ -661,8 +649,8 @@ match_host(const string &s, size_t pos_start, size_t &pos_end, string &host, boo
 }
 
 static bool
-match_authority(const string &s, size_t pos_start, size_t &pos_end,
-    string &tmp_host, string &tmp_port, string &tmp_username, string &tmp_password) {
+match_authority(string_view s, size_t pos_start, size_t &pos_end,
+    string_view &tmp_host, string_view &tmp_port, string_view &tmp_username, string_view &tmp_password) {
    /* RFC 2234 defines:
    *
    * - HEXDIG
@@ -704,7 +692,7 @@ match_authority(const string &s, size_t pos_start, size_t &pos_end,
   }
 
   size_t pos_matched = pos_start + 2;
-  string user_info;
+  string_view user_info;
 
   if (match_userinfo(s, pos_matched, pos_matched, user_info)) {
     split_userinfo(user_info, tmp_username, tmp_password);
@@ -726,21 +714,21 @@ match_authority(const string &s, size_t pos_start, size_t &pos_end,
 }
 
 static bool
-match_path_segment(const string &s, size_t pos_start, size_t &pos_end, string &segment) {
+match_path_segment(string_view s, size_t pos_start, size_t &pos_end, string_view &segment) {
   return match_path_chars(s, pos_start, pos_end, segment);
 }
 
 static bool
-match_path_empty(const string &s, size_t pos_start, size_t &pos_end, string &path) {
-  string segment;
+match_path_empty(string_view s, size_t pos_start, size_t &pos_end, string_view &path) {
+  string_view segment;
 
   if (!match_path_chars(s, pos_start, pos_end, segment)) {
-    path = "";
+    path = string_view();
     return true;
   }
 
   if (segment.length() == 0) {
-    path = "";
+    path = string_view();
     return true;
   }
 
@@ -748,7 +736,7 @@ match_path_empty(const string &s, size_t pos_start, size_t &pos_end, string &pat
 }
 
 static bool
-match_path_absolute(const string &s, size_t pos_start, size_t &pos_end, string &path) {
+match_path_absolute(string_view s, size_t pos_start, size_t &pos_end, string_view &path) {
   // we rely on match_path_absolute being called after match_authority.
   // it allows us to simplify:
   //
@@ -770,13 +758,10 @@ match_path_absolute(const string &s, size_t pos_start, size_t &pos_end, string &
 
   size_t pos_matched = pos_start + 1;
 
-  string tmp;
   do {
-    string segment;
+    string_view segment;
 
-    if (match_path_segment(s, pos_matched, pos_matched, segment)) {
-      tmp.append(segment);
-    }
+    match_path_segment(s, pos_matched, pos_matched, segment);
 
     if (is_eol(s, pos_matched)) {
       break;
@@ -786,91 +771,85 @@ match_path_absolute(const string &s, size_t pos_start, size_t &pos_end, string &
       break;
     }
 
-    tmp.append(capture(s, pos_matched, 1, pos_matched));
+    pos_matched = skip(pos_matched, 1);
   } while (true);
 
-  path = std::move(tmp);
-  pos_end = pos_matched;
+  // the path without the leading '/'
+  path = capture(s, pos_start + 1, pos_matched - (pos_start + 1), pos_end);
 
   return true;
 }
 
 static bool
-match_path_absolute_or_empty(const string &s, size_t pos_start, size_t &pos_end, string &path) {
+match_path_absolute_or_empty(string_view s, size_t pos_start, size_t &pos_end, string_view &path) {
   return match_path_absolute(s, pos_start, pos_end, path) || match_path_empty(s, pos_start, pos_end, path);
 }
 
 static bool
-match_path_rootless(const string &s, size_t pos_start, size_t &pos_end, string &path) {
+match_path_rootless(string_view s, size_t pos_start, size_t &pos_end, string_view &path) {
   // path-rootless = segment-nz *( "/" segment )
   if (is_eol(s, pos_start)) {
     return false;
   }
 
-  string tmp;
+  string_view segment_nz;
   size_t pos_matched;
 
-  if (!match_path_segment(s, pos_start, pos_matched, tmp)) {
+  if (!match_path_segment(s, pos_start, pos_matched, segment_nz)) {
     return false;
   }
 
-  if (tmp.length() == 0) {
+  if (segment_nz.length() == 0) {
     // we need at least one path-char
     return false;
   }
 
   while (!is_eol(s, pos_matched) && s.at(pos_matched) == '/') {
-    string segment;
+    string_view segment;
 
-    tmp.append(capture(s, pos_matched, 1, pos_matched));
+    pos_matched = skip(pos_matched, 1);
 
-    if (match_path_segment(s, pos_matched, pos_matched, segment)) {
-      tmp.append(segment);
-    }
+    match_path_segment(s, pos_matched, pos_matched, segment);
   }
 
-  path = std::move(tmp);
-  pos_end = pos_matched;
+  path = capture(s, pos_start, pos_matched - pos_start, pos_end);
 
   return true;
 }
 
 static bool
-match_fragment_query_chars(const string &s, size_t pos_start, size_t &pos_end, string &chars) {
+match_fragment_query_chars(string_view s, size_t pos_start, size_t &pos_end, string_view &chars) {
   // fragment and query matcher both share the same allowed chars after the initial char
   //
   // *( pchar / "/" / "?" )
-  string tmp;
   size_t pos_matched = pos_start;
   bool made_progress;
 
   do {
-    string segment;
+    string_view segment;
 
     made_progress = false;
 
     if (match_path_chars(s, pos_matched, pos_matched, segment) && segment.length() > 0) {
-      tmp.append(segment);
       made_progress = true;
     }
 
     size_t match_len = match_zero_or_more(s, kFragmentOrQuery, pos_matched);
 
     if (match_len > 0) {
-      tmp.append(capture(s, pos_matched, match_len, pos_matched));
+      pos_matched = skip(pos_matched, match_len);
       made_progress = true;
     }
   } while(made_progress);
 
-  chars = std::move(tmp);
-  pos_end = pos_matched;
+  chars = capture(s, pos_start, pos_matched - pos_start, pos_end);
 
   return true;
 }
 
 
 static bool
-match_fragment(const string &s, size_t pos_start, size_t &pos_end, string &fragment) {
+match_fragment(string_view s, size_t pos_start, size_t &pos_end, string_view &fragment) {
   //
   // fragment    = *( pchar / "/" / "?" )
   //
@@ -889,7 +868,7 @@ match_fragment(const string &s, size_t pos_start, size_t &pos_end, string &fragm
 
 
 static bool
-match_query(const string &s, size_t pos_start, size_t &pos_end, string &query) {
+match_query(string_view s, size_t pos_start, size_t &pos_end, string_view &query) {
   if (is_eol(s, pos_start)) {
     // already at EOL, we need to match at least ?
     return false;
@@ -904,9 +883,21 @@ match_query(const string &s, size_t pos_start, size_t &pos_end, string &query) {
   return match_fragment_query_chars(s, pos_start, pos_end, query);
 }
 
+static int
+hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return c - 'A' + 10;
+}
+
+static bool
+is_pct_encoded_at(string_view s, size_t ndx) {
+  return s[ndx] == '%' && s.length() - ndx > 2 && 0 != isxdigit(s[ndx + 1]) && 0 != isxdigit(s[ndx + 2]);
+}
+
 // decode a string with pct-encoding
-static string
-pct_decode(const string &s) {
+std::string
+URIParser::pct_decode(string_view s) {
   size_t s_len = s.length();
   string decoded;
 
@@ -914,27 +905,119 @@ pct_decode(const string &s) {
   decoded.reserve(s_len);
 
   for (size_t ndx = 0; ndx < s_len; ndx++) {
-    if (s.at(ndx) == '%' && s_len - ndx > 2 && 0 != isxdigit(s.at(ndx + 1)) && 0 != isxdigit(s.at(ndx + 2))) {
-      decoded.append(1, static_cast<char>(std::stol(s.substr(ndx + 1, 2), nullptr, 16)));
+    if (is_pct_encoded_at(s, ndx)) {
+      decoded.append(1, static_cast<char>(hex_value(s[ndx + 1]) * 16 + hex_value(s[ndx + 2])));
       ndx += 2;
     } else {
-      decoded.append(1, s.at(ndx));
+      decoded.append(1, s[ndx]);
     }
   }
   return decoded;
 }
 
+// compares the pct-decoded 'encoded' with 'plain' without decoding into a
+// string
+static bool
+pct_decoded_equals(string_view encoded, string_view plain) {
+  size_t ndx = 0;
+  size_t plain_ndx = 0;
+
+  for (; ndx < encoded.length(); ndx++, plain_ndx++) {
+    if (plain_ndx == plain.length()) {
+      return false;
+    }
+    char c = encoded[ndx];
+    if (is_pct_encoded_at(encoded, ndx)) {
+      c = static_cast<char>(hex_value(encoded[ndx + 1]) * 16 + hex_value(encoded[ndx + 2]));
+      ndx += 2;
+    }
+    if (c != plain[plain_ndx]) {
+      return false;
+    }
+  }
+  return plain_ndx == plain.length();
+}
+
+void
+URIQueryView::const_iterator::find_part() {
+  // the parts are separated by '&' and skipped if empty. A part is split at
+  // the '=', the value doesn't contain a 2nd '='.
+  while (pos_ < query_.length()) {
+    size_t part_end = query_.find(URI::query_delimiter, pos_);
+    if (part_end == string_view::npos) {
+      part_end = query_.length();
+    }
+
+    string_view part = query_.substr(pos_, part_end - pos_);
+    next_ = part_end == query_.length() ? part_end : part_end + 1;
+
+    const size_t eq = part.find('=');
+    if (eq != string_view::npos) {
+      size_t value_end = part.find('=', eq + 1);
+      if (value_end == string_view::npos) {
+        value_end = part.length();
+      }
+      current_.first = part.substr(0, eq);
+      current_.second = part.substr(eq + 1, value_end - (eq + 1));
+      return;
+    }
+    pos_ = next_;
+  }
+  pos_ = query_.length();
+}
+
+bool
+URIQueryView::find(string_view key, string_view &value) const {
+  bool found = false;
+
+  // like URIQuery, the last value of a key wins
+  for (const auto &k_v : *this) {
+    if (pct_decoded_equals(k_v.first, key)) {
+      value = k_v.second;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+bool
+URIView::has_scheme(string_view lower_case_scheme) const {
+  if (scheme.length() != lower_case_scheme.length()) {
+    return false;
+  }
+  for (size_t ndx = 0; ndx < scheme.length(); ndx++) {
+    if (::tolower(scheme[ndx]) != lower_case_scheme[ndx]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the URI class only has 'uint16' for the port, even though the RFC allows
+// arbit' large numbers.
+static uint16_t
+parse_port(string_view port, string_view uri) {
+  uint64_t parsed_port = 0;
+
+  for (char c : port) {
+    parsed_port = parsed_port * 10 + static_cast<uint64_t>(c - '0');
+
+    if (parsed_port > USHRT_MAX) {
+      throw URIError("invalid URI: invalid port: impossible port number for: " + uri.to_string());
+    }
+  }
+
+  return static_cast<uint16_t>(parsed_port);
+}
+
 static URIQuery
-split_query(const string &s) {
+split_query(string_view s) {
   URIQuery query;
 
-  for (auto& part: split_string(s, '&', false)) {
-    auto key_value = split_string(part, '=');
-    if (key_value.size() < 2) {
-      throw URIError("invalid URI: query-string part doesn't contain '='");
-    }
-    if (!key_value[0].empty()) {
-      query[pct_decode(key_value[0])] = pct_decode(key_value[1]);
+  for (const auto &k_v : URIQueryView(s)) {
+    if (!k_v.first.empty()) {
+      query[URIParser::pct_decode(k_v.first)] = URIParser::pct_decode(k_v.second);
     }
   }
 
@@ -949,8 +1032,8 @@ split_query(const string &s) {
  */
 URI URIParser::parse_shorthand_uri(const std::string &uri, bool allow_path_rootless, const std::string &default_scheme) {
   size_t pos_matched = 0;
-  std::string host;
-  std::string port;
+  string_view host;
+  string_view port;
 
   if (uri.length() > 0 && (uri.at(0) == '/' || uri.at(0) == '\\')) {
     URI u;
@@ -970,28 +1053,13 @@ URI URIParser::parse_shorthand_uri(const std::string &uri, bool allow_path_rootl
     }
 
     if (pos_matched == uri.size()) {
-      uint64_t parsed_port = 0;
-      if (port.length() > 0) {
-        try {
-          parsed_port = std::stoul(port);
-        } catch (const std::out_of_range &) {
-          throw URIError("invalid URI: invalid port: impossible port number for: " + uri);
-        }
-
-        if (parsed_port > USHRT_MAX) {
-          // the URI class only has 'uint16' for the port, even though
-          // the RFC allows arbit' large numbers.
-          throw URIError("invalid URI: invalid port: impossible port number for: " + uri);
-        }
-      }
+      uint16_t parsed_port = parse_port(port, uri);
 
       URI u;
-      URIQuery query;
 
-      query["socket"] = uri;
       u.scheme = default_scheme;
-      u.host = host;
-      u.port = static_cast<uint16_t>(parsed_port);
+      u.host = host.to_string();
+      u.port = parsed_port;
 
       return u;
     }
@@ -1001,14 +1069,14 @@ URI URIParser::parse_shorthand_uri(const std::string &uri, bool allow_path_rootl
 }
 
 
-URI
-URIParser::parse(const string &uri, bool allow_path_rootless) {
+URIView
+URIParser::parse_view(string_view uri, bool allow_path_rootless) {
   size_t pos = 0;
+  URIView v;
 
   // stage: match and extract fields
   //
-  string tmp_scheme;
-  if (!match_scheme(uri, pos, pos, tmp_scheme)) {
+  if (!match_scheme(uri, pos, pos, v.scheme)) {
     throw URIError("no scheme", uri, pos);
   }
 
@@ -1016,26 +1084,20 @@ URIParser::parse(const string &uri, bool allow_path_rootless) {
     throw URIError("expected colon after scheme", uri, pos);
   }
 
-  string tmp_path;
-  string tmp_host;
-  string tmp_username;
-  string tmp_password;
-  string tmp_port;
+  string_view tmp_port;
 
-  if (match_authority(uri, pos, pos, tmp_host, tmp_port, tmp_username, tmp_password)) {
-    match_path_absolute_or_empty(uri, pos, pos, tmp_path);
-  } else if (match_path_absolute(uri, pos, pos, tmp_path)) {
-  } else if (allow_path_rootless && match_path_rootless(uri, pos, pos, tmp_path)) {
-  } else if (match_path_empty(uri, pos, pos, tmp_path)) {
+  if (match_authority(uri, pos, pos, v.host, tmp_port, v.username, v.password)) {
+    match_path_absolute_or_empty(uri, pos, pos, v.path);
+  } else if (match_path_absolute(uri, pos, pos, v.path)) {
+  } else if (allow_path_rootless && match_path_rootless(uri, pos, pos, v.path)) {
+  } else if (match_path_empty(uri, pos, pos, v.path)) {
   } else {
     throw URIError("neither authority nor path", uri, pos);
   }
 
-  string tmp_query;
-  match_query(uri, pos, pos, tmp_query);
+  match_query(uri, pos, pos, v.query);
 
-  string tmp_fragment;
-  match_fragment(uri, pos, pos, tmp_fragment);
+  match_fragment(uri, pos, pos, v.fragment);
 
   // did we match the whole string?
   if (pos != uri.length()) {
@@ -1043,54 +1105,67 @@ URIParser::parse(const string &uri, bool allow_path_rootless) {
   }
 
   // stage: URI is valid, check values
-  //
+  v.port = parse_port(tmp_port, uri);
+
+  size_t part_start = 0;
+  while (part_start < v.query.length()) {
+    size_t part_end = v.query.find(URI::query_delimiter, part_start);
+    if (part_end == string_view::npos) {
+      part_end = v.query.length();
+    }
+    if (part_end != part_start &&
+        v.query.substr(part_start, part_end - part_start).find('=') == string_view::npos) {
+      throw URIError("invalid URI: query-string part doesn't contain '='");
+    }
+    part_start = part_end + 1;
+  }
+
+  return v;
+}
+
+URI
+URIParser::parse(const string &uri, bool allow_path_rootless) {
+  const URIView v = parse_view(uri, allow_path_rootless);
+
   // post-process the values
   //
   // * split
   //
-  //   * user-info
   //   * paths
   //   * query-stringa
   //
   // * decode the pct-encoding
-  // * convert strings to numbers
   // * lowercase scheme
+  URI u;
 
-  std::transform(tmp_scheme.begin(), tmp_scheme.end(), tmp_scheme.begin(), ::tolower);
-
-  uint64_t parsed_port = 0;
-  if (tmp_port.length() > 0) {
-    try {
-      parsed_port = std::stoul(tmp_port);
-    } catch (const std::out_of_range &) {
-      throw URIError("invalid URI: invalid port: impossible port number for: " + uri);
+  u.scheme = v.scheme.to_string();
+  std::transform(u.scheme.begin(), u.scheme.end(), u.scheme.begin(), ::tolower);
+  u.host = pct_decode(v.host);
+  u.port = v.port;
+  u.username = pct_decode(v.username);
+  u.password = pct_decode(v.password);
+
+  size_t segment_start = 0;
+  while (segment_start < v.path.length()) {
+    size_t segment_end = v.path.find('/', segment_start);
+    if (segment_end == string_view::npos) {
+      segment_end = v.path.length();
     }
-
-    if (parsed_port > USHRT_MAX) {
-      // the URI class only has 'uint16' for the port, even though
-      // the RFC allows arbit' large numbers.
-      throw URIError("invalid URI: invalid port: impossible port number for: " + uri);
+    if (segment_end != segment_start) {
+      u.path.push_back(pct_decode(v.path.substr(segment_start, segment_end - segment_start)));
     }
+    segment_start = segment_end + 1;
   }
 
-  URI u;
-
-  u.scheme = tmp_scheme;
-  u.host = pct_decode(tmp_host);
-  u.port = static_cast<uint16_t>(parsed_port);
-  u.username = pct_decode(tmp_username);
-  u.password = pct_decode(tmp_password);
-  u.path = split_string(tmp_path, '/', false);
-  std::transform(u.path.begin(), u.path.end(), u.path.begin(), pct_decode);
-  u.query = split_query(tmp_query);
-  u.fragment = pct_decode(tmp_fragment);
+  u.query = split_query(v.query);
+  u.fragment = pct_decode(v.fragment);
 
   return u;
 }
 
 static bool
 is_ipv6(const string &s) {
-  string ipv6_addr;
+  string_view ipv6_addr;
   size_t pos_end;
 
   if (!match_ipv6(s, 0, pos_end, ipv6_addr)) {
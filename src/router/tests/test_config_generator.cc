@@ -347,6 +347,52 @@ TEST_F(ConfigGeneratorTest, fetch_bootstrap_servers_invalid) {
   }
 }
 
+TEST_F(ConfigGeneratorTest, read_fleet_file) {
+  {
+    std::istringstream fleet(
+      "# name directory [report-host]\n"
+      "app1 /srv/router/app1 app1.example.com\n"
+      "\n"
+      "  app2\t/srv/router/app2\n");
+    auto entries = ConfigGenerator::read_fleet_file(fleet);
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ("app1", entries[0].name);
+    EXPECT_EQ("/srv/router/app1", entries[0].directory);
+    EXPECT_EQ("app1.example.com", entries[0].report_host);
+    EXPECT_EQ("app2", entries[1].name);
+    EXPECT_EQ("/srv/router/app2", entries[1].directory);
+    EXPECT_EQ("", entries[1].report_host);
+  }
+
+  {
+    std::istringstream fleet("app1\n");
+    ASSERT_THROW_LIKE(ConfigGenerator::read_fleet_file(fleet),
+      std::runtime_error,
+      "Invalid fleet entry in line 1, expected: <name> <directory> [<report-host>]");
+  }
+
+  {
+    std::istringstream fleet("app1 /srv/app1 host1 extra\n");
+    ASSERT_THROW_LIKE(ConfigGenerator::read_fleet_file(fleet),
+      std::runtime_error,
+      "Invalid fleet entry in line 1");
+  }
+
+  {
+    std::istringstream fleet("app1 /srv/app1\napp1 /srv/app2\n");
+    ASSERT_THROW_LIKE(ConfigGenerator::read_fleet_file(fleet),
+      std::runtime_error,
+      "Duplicate fleet entry in line 2");
+  }
+
+  {
+    std::istringstream fleet("# nothing\n");
+    ASSERT_THROW_LIKE(ConfigGenerator::read_fleet_file(fleet),
+      std::runtime_error,
+      "Fleet file doesn't list any router");
+  }
+}
+
 TEST_F(ConfigGeneratorTest, metadata_checks_invalid_data) {
   // invalid number of values returned from schema_version table
   {
@@ -580,35 +626,44 @@ TEST_F(ConfigGeneratorTest, create_router_accounts) {
   for (TestType tt : {NATIVE, FALLBACK}) {
 
     constexpr unsigned kDontFail = 99;
-    auto generate_expected_SQL = [&](const std::string& host,
+    // accounts of all hosts get created by the same statements
+    auto generate_expected_SQL = [&](const std::vector<std::string>& hosts,
                                      bool first_create_user,
                                      unsigned fail_on) {
 
       // kDontFail => don't fail, 1..4 => fail on 1..4
       assert((1 <= fail_on && fail_on <= 4) || fail_on == kDontFail);
 
+      auto join = [&hosts](const std::string& suffix) {
+        std::string res;
+        for (const std::string& host : hosts)
+          res += (res.empty() ? "" : ", ") + std::string("cluster_user@'") + host + "'" + suffix;
+        return res;
+      };
+      const std::string accounts = join("");
+
       if (tt == NATIVE) {
         // CREATE USER using mysql_native_password and hashed password
         if (fail_on > 0) mock_mysql->expect_execute(
-            "CREATE USER cluster_user@'" + host +
-            "' IDENTIFIED WITH mysql_native_password AS '*BDF9890F9606F18B2E92EF0CA972006F1DBC44DF'").then_ok();
+            "CREATE USER " +
+            join(" IDENTIFIED WITH mysql_native_password AS '*BDF9890F9606F18B2E92EF0CA972006F1DBC44DF'")).then_ok();
       } else {
         // fail mysql_native_password method to induce fallback to plaintext method.
         // Should be called only as the first CREATE USER, after this fallback should
         // be used on all subsequent CREATE USER calls
-        if (first_create_user) mock_mysql->expect_execute("CREATE USER cluster_user@'" + host +
-            "' IDENTIFIED WITH mysql_native_password AS '*BDF9890F9606F18B2E92EF0CA972006F1DBC44DF'").then_error("no such plugin", 1524);
+        if (first_create_user) mock_mysql->expect_execute("CREATE USER " +
+            join(" IDENTIFIED WITH mysql_native_password AS '*BDF9890F9606F18B2E92EF0CA972006F1DBC44DF'")).then_error("no such plugin", 1524);
 
         // CREATE USER using fallback method with plaintext password
         if (fail_on > 0) mock_mysql->expect_execute(
-            "CREATE USER cluster_user@'" + host + "' IDENTIFIED BY '0123456789012345'").then_ok();
+            "CREATE USER " + join(" IDENTIFIED BY '0123456789012345'")).then_ok();
       }
       if (fail_on > 1) mock_mysql->expect_execute(
-          "GRANT SELECT ON mysql_innodb_cluster_metadata.* TO cluster_user@'" + host + "'").then_ok();
+          "GRANT SELECT ON mysql_innodb_cluster_metadata.* TO " + accounts).then_ok();
       if (fail_on > 2) mock_mysql->expect_execute(
-          "GRANT SELECT ON performance_schema.replication_group_members TO cluster_user@'" + host + "'").then_ok();
+          "GRANT SELECT ON performance_schema.replication_group_members TO " + accounts).then_ok();
       if (fail_on > 3) mock_mysql->expect_execute(
-          "GRANT SELECT ON performance_schema.replication_group_member_stats TO cluster_user@'" + host + "'").then_ok();
+          "GRANT SELECT ON performance_schema.replication_group_member_stats TO " + accounts).then_ok();
 
       if (fail_on != kDontFail)
         mock_mysql->then_error("some error", 1234); // i-th statement will return this error
@@ -618,7 +673,7 @@ TEST_F(ConfigGeneratorTest, create_router_accounts) {
     {
       ::testing::InSequence s;
       common_pass_metadata_checks(mock_mysql.get());
-      generate_expected_SQL("%", true, kDontFail);
+      generate_expected_SQL({"%"}, true, kDontFail);
 
       ConfigGenerator config_gen;
       config_gen.init(kServerUrl, {});
@@ -629,7 +684,7 @@ TEST_F(ConfigGeneratorTest, create_router_accounts) {
     {
       ::testing::InSequence s;
       common_pass_metadata_checks(mock_mysql.get());
-      generate_expected_SQL("host1", true, kDontFail);
+      generate_expected_SQL({"host1"}, true, kDontFail);
 
       ConfigGenerator config_gen;
       config_gen.init(kServerUrl, {});
@@ -648,9 +703,8 @@ TEST_F(ConfigGeneratorTest, create_router_accounts) {
       ::testing::InSequence s;
       common_pass_metadata_checks(mock_mysql.get());
 
-      generate_expected_SQL("host1", true, kDontFail);
-      generate_expected_SQL("%", false, kDontFail);
-      generate_expected_SQL("host3%", false, kDontFail);
+      generate_expected_SQL({"host1"}, true, kDontFail);
+      generate_expected_SQL({"%", "host3%"}, false, kDontFail);
 
       ConfigGenerator config_gen;
       config_gen.init(kServerUrl, {});
@@ -666,16 +720,11 @@ TEST_F(ConfigGeneratorTest, create_router_accounts) {
         common_pass_metadata_checks(mock_mysql.get());
         switch (fail_host) {
           case 1:
-            generate_expected_SQL("host1", true, fail_sql);
+            generate_expected_SQL({"host1"}, true, fail_sql);
           break;
           case 2:
-            generate_expected_SQL("host1", true, kDontFail);
-            generate_expected_SQL("host2", false, fail_sql);
-          break;
-          case 3:
-            generate_expected_SQL("host1", true, kDontFail);
-            generate_expected_SQL("host2", false, kDontFail);
-            generate_expected_SQL("host3", false, fail_sql);
+            generate_expected_SQL({"host1"}, true, kDontFail);
+            generate_expected_SQL({"host2", "host3"}, false, fail_sql);
           break;
         }
 
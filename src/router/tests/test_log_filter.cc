@@ -83,4 +83,48 @@ TEST_F(LogFilterTest, IsMoreThenOneGroupHidden) {
   ASSERT_THAT(log_filter.filter(statement), testing::Eq(expected_result));
 }
 
+class SQLLogFilterTest: public testing::Test {
+ public:
+  void SetUp() override {
+    log_filter.add_default_sql_patterns();
+  }
+
+  SQLLogFilter log_filter;
+};
+
+TEST_F(SQLLogFilterTest, IsNativePasswordHidden) {
+  ASSERT_THAT(log_filter.filter(
+      "CREATE USER router_xxxx@'%' IDENTIFIED WITH mysql_native_password AS '*abcdef'"),
+      testing::Eq("CREATE USER router_xxxx@'%' IDENTIFIED WITH mysql_native_password AS ***"));
+}
+
+TEST_F(SQLLogFilterTest, IsIdentifiedByPasswordHidden) {
+  ASSERT_THAT(log_filter.filter(
+      "CREATE USER router_xxxx@'%' IDENTIFIED BY 'password123' WITH MAX_USER_CONNECTIONS 1"),
+      testing::Eq("CREATE USER router_xxxx@'%' IDENTIFIED BY *** WITH MAX_USER_CONNECTIONS 1"));
+}
+
+TEST_F(SQLLogFilterTest, IsEmptyPasswordHidden) {
+  ASSERT_THAT(log_filter.filter("CREATE USER router_xxxx IDENTIFIED BY "),
+      testing::Eq("CREATE USER router_xxxx IDENTIFIED BY ***"));
+}
+
+TEST_F(SQLLogFilterTest, IsStatementNotChangedWhenNoPatternMatched) {
+  for (const std::string statement : {
+      "SELECT 'CREATE USER a IDENTIFIED BY b'",
+      "CREATE USER  a IDENTIFIED BY 'b'",  // two spaces
+      "CREATE USER a IDENTIFIED WITH sha256_password BY 'b'",
+      "create user a identified by 'b'",
+      "CREATE USER ",
+      ""}) {
+    EXPECT_THAT(log_filter.filter(statement), testing::Eq(statement));
+  }
+}
+
+TEST_F(SQLLogFilterTest, AddedPatternsAreApplied) {
+  log_filter.add_pattern("^SET PASSWORD = ([[:graph:]]*)", 1);
+  ASSERT_THAT(log_filter.filter("SET PASSWORD = 'secret'"),
+      testing::Eq("SET PASSWORD = ***"));
+}
+
 } // end of mysqlrouter namespace
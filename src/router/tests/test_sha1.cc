@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/sha1.h"
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+static std::string to_hex(const uint8_t *digest) {
+  std::string hex;
+  char buf[3];
+  for (size_t i = 0; i < SHA1_HASH_SIZE; ++i) {
+    snprintf(buf, sizeof(buf), "%02x", digest[i]);
+    hex += buf;
+  }
+  return hex;
+}
+
+static std::string sha1(const std::string &msg) {
+  uint8_t digest[SHA1_HASH_SIZE];
+  my_sha1::compute_sha1_hash(digest, msg.data(), msg.size());
+  return to_hex(digest);
+}
+
+// runs the tests with the SHA instructions of the CPU enabled (if it has
+// them) and with the software implementation
+class TestSha1 : public ::testing::TestWithParam<bool> {
+ protected:
+  void SetUp() override { my_sha1::set_hw_enabled(GetParam()); }
+  void TearDown() override { my_sha1::set_hw_enabled(true); }
+};
+
+// FIPS 180-2 test vectors, they cover messages whose padding needs a
+// block of its own
+TEST_P(TestSha1, KnownDigests) {
+  EXPECT_EQ("da39a3ee5e6b4b0d3255bfef95601890afd80709", sha1(""));
+  EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", sha1("abc"));
+  EXPECT_EQ("84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+            sha1("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+  EXPECT_EQ("34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+            sha1(std::string(1000000, 'a')));
+}
+
+TEST_P(TestSha1, MultiEqualsConcatenation) {
+  std::string msg;
+  for (int i = 0; i < 200; ++i)
+    msg += static_cast<char>(i * 7);
+
+  for (size_t split = 0; split <= msg.size(); split += 13) {
+    uint8_t digest[SHA1_HASH_SIZE];
+    my_sha1::compute_sha1_hash_multi(digest, msg.data(), static_cast<int>(split),
+                                     msg.data() + split,
+                                     static_cast<int>(msg.size() - split));
+    EXPECT_EQ(sha1(msg), to_hex(digest)) << "split at " << split;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Hardware, TestSha1, ::testing::Values(true));
+INSTANTIATE_TEST_CASE_P(Software, TestSha1, ::testing::Values(false));
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -34,6 +34,8 @@ using ::testing::StrEq;
 using mysqlrouter::URI;
 using mysqlrouter::URIError;
 using mysqlrouter::URIQuery;
+using mysqlrouter::URIParser;
+using mysqlrouter::URIView;
 using mysqlrouter::URIAuthority;
 using mysqlrouter::URIPath;
 using mysqlrouter::URIQuery;
@@ -118,6 +120,27 @@ TEST_P(URIParseGoodTests, ParseURIseturi) {
   EXPECT_THAT(u.fragment, StrEq(test_param.expected.fragment));
 }
 
+TEST_P(URIParseGoodTests, ParseURIview) {
+  auto test_param = GetParam();
+  const std::string uri(test_param.input.uri);
+  URIView v;
+
+  ASSERT_NO_THROW(v = URIParser::parse_view(uri));
+
+  EXPECT_TRUE(v.has_scheme(test_param.expected.scheme));
+  EXPECT_THAT(URIParser::pct_decode(v.host), StrEq(test_param.expected.host));
+  EXPECT_EQ(v.port, test_param.expected.port);
+  EXPECT_THAT(URIParser::pct_decode(v.username), StrEq(test_param.expected.username));
+  EXPECT_THAT(URIParser::pct_decode(v.password), StrEq(test_param.expected.password));
+  for (const auto &k_v : test_param.expected.query) {
+    mysqlrouter::string_view value;
+
+    EXPECT_TRUE(v.query_params().find(k_v.first, value)) << k_v.first;
+    EXPECT_EQ(URIParser::pct_decode(value), k_v.second);
+  }
+  EXPECT_THAT(URIParser::pct_decode(v.fragment), StrEq(test_param.expected.fragment));
+}
+
 
 URIParseGoodTestData uri_test_data[] = {
   // just a scheme, everything else is empty
@@ -513,6 +536,20 @@ TEST_P(URIParseThrowingTests, FailsParseURI) {
   }
 }
 
+TEST_P(URIParseThrowingTests, FailsParseURIview) {
+  URITestFailData test_data = GetParam();
+
+  try {
+    URIParser::parse_view(test_data.input.uri);
+
+    FAIL() << "should have failed";
+  } catch(URIError &e) {
+    EXPECT_THAT(e.what(), StrEq(test_data.expected.exception_text));
+  } catch(...) {
+    FAIL() << "expected to throw URIError, got unexpected exception";
+  }
+}
+
 URITestFailData uri_test_fail_data[] = {
   {
     // no trailing :
@@ -821,3 +858,56 @@ URIRootlessTestFailData uri_rootless_test_fail_data[] = {
 INSTANTIATE_TEST_CASE_P(
     URITests, URIRootlessThrowingTests,
     ::testing::ValuesIn(uri_rootless_test_fail_data));
+
+// views
+
+TEST_F(URISimpleTests, ViewDoesntDecode) {
+  const std::string uri("MySQL://us%65r@h%6Fst:3306/a/%62?k%65y=v%61lue#fr%61g");
+  URIView v = URIParser::parse_view(uri);
+
+  EXPECT_EQ(v.scheme, "MySQL");
+  EXPECT_TRUE(v.has_scheme("mysql"));
+  EXPECT_FALSE(v.has_scheme("mysqlx"));
+  EXPECT_EQ(v.username, "us%65r");
+  EXPECT_EQ(v.host, "h%6Fst");
+  EXPECT_EQ(v.port, 3306);
+  EXPECT_EQ(v.path, "a/%62");
+  EXPECT_EQ(v.query, "k%65y=v%61lue");
+  EXPECT_EQ(v.fragment, "fr%61g");
+
+  // the view points into the parsed string
+  EXPECT_EQ(v.host.data(), uri.data() + uri.find('@') + 1);
+}
+
+TEST_F(URISimpleTests, ViewQueryParams) {
+  const std::string uri("ham://host?a=1&&b=&=3&c=4=5&a=6");
+  URIView v = URIParser::parse_view(uri);
+
+  std::vector<std::pair<std::string, std::string>> params;
+  for (const auto &k_v : v.query_params()) {
+    params.emplace_back(k_v.first.to_string(), k_v.second.to_string());
+  }
+
+  std::vector<std::pair<std::string, std::string>> expected{
+    {"a", "1"}, {"b", ""}, {"", "3"}, {"c", "4"}, {"a", "6"}
+  };
+  EXPECT_EQ(params, expected);
+
+  mysqlrouter::string_view value;
+  EXPECT_TRUE(v.query_params().find("a", value));
+  EXPECT_EQ(value, "6");
+  EXPECT_TRUE(v.query_params().find("b", value));
+  EXPECT_EQ(value, "");
+  EXPECT_FALSE(v.query_params().find("d", value));
+}
+
+TEST_F(URISimpleTests, ViewQueryFindDecodesKeys) {
+  const std::string uri("ham://host?%61b=1&a%62=2&abc=3");
+  URIView v = URIParser::parse_view(uri);
+
+  // like in URI::query, the last one wins
+  mysqlrouter::string_view value;
+  EXPECT_TRUE(v.query_params().find("ab", value));
+  EXPECT_EQ(value, "2");
+  EXPECT_FALSE(v.query_params().find("a", value));
+}
@@ -0,0 +1,136 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_CONNECTION_TRACE_INCLUDED
+#define MYSQLROUTER_CONNECTION_TRACE_INCLUDED
+
+#include "mysqlrouter/routing_export.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** @class ConnectionTrace
+ *
+ * Timeline of the phases of client connections, for routes with
+ * `connection_trace` enabled.
+ *
+ * Each thread writes fixed-size events to a ring buffer of its own, without
+ * locks or allocations. Once a ring is full the oldest events get
+ * overwritten. The rings of threads that exited are reused by new threads,
+ * so the number of rings stays at the number of threads that recorded at the
+ * same time.
+ *
+ * get_snapshot() copies the events of all rings while they are written,
+ * skipping events that get overwritten meanwhile.
+ */
+class ROUTING_EXPORT ConnectionTrace {
+ public:
+  /** @brief events kept per thread */
+  static constexpr size_t kEventsPerThread = 1024;
+
+  enum class Event : uint16_t {
+    /** @brief client connection got accepted */
+    kAccepted,
+    /** @brief picking and connecting to a destination started */
+    kConnectStarted,
+    /** @brief connected to a server */
+    kServerConnected,
+    /** @brief no server could be connected to */
+    kServerConnectFailed,
+    /** @brief client got authenticated */
+    kHandshakeDone,
+    kFirstByteFromClient,
+    kFirstByteFromServer,
+    kLastByteFromClient,
+    kLastByteFromServer,
+    /** @brief client connection got closed */
+    kClosed,
+  };
+
+  struct Record {
+    /** @brief nanoseconds of the steady clock, see now() */
+    uint64_t timestamp;
+    uint64_t connection_id;
+    Event event;
+  };
+
+  static ConnectionTrace &getInstance();
+
+  /** @brief nanoseconds of the steady clock, the timestamps of the events */
+  static uint64_t now() noexcept;
+
+  /** @brief name of an event, like "accepted" */
+  static const char *event_name(Event event) noexcept;
+
+  /** @brief id of a new connection, never 0 */
+  uint64_t next_connection_id() noexcept {
+    return next_connection_id_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief adds an event to the ring buffer of the calling thread.
+   *
+   * @param connection_id id of the connection, as returned by next_connection_id()
+   * @param event event to add
+   * @param timestamp when the event happened
+   */
+  void record(uint64_t connection_id, Event event, uint64_t timestamp) noexcept;
+
+  void record(uint64_t connection_id, Event event) noexcept {
+    record(connection_id, event, now());
+  }
+
+  /** @brief events of all threads, sorted by connection and time */
+  std::vector<Record> get_snapshot() const;
+
+ private:
+  struct Buffer;
+  class ThreadBuffer;
+
+  // disable copy, as we are a single-instance
+  ConnectionTrace(ConnectionTrace const &) = delete;
+  void operator=(ConnectionTrace const &) = delete;
+
+  ConnectionTrace();
+  ~ConnectionTrace();
+
+  /** @brief takes a free ring buffer, or allocates one */
+  Buffer *acquire_buffer();
+
+  /** @brief makes a ring buffer of an exited thread available again */
+  void release_buffer(Buffer *buffer);
+
+  std::atomic<uint64_t> next_connection_id_{1};
+
+  mutable std::mutex buffers_mtx_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  std::vector<Buffer *> free_buffers_;
+};
+
+#endif // MYSQLROUTER_CONNECTION_TRACE_INCLUDED
@@ -0,0 +1,150 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQLROUTER_QUERY_DIGEST_STATS_INCLUDED
+#define MYSQLROUTER_QUERY_DIGEST_STATS_INCLUDED
+
+#include "mysqlrouter/routing_export.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Normalizes a statement into its digest.
+ *
+ * Literals become '?', lists of literals a single '?', comments are
+ * dropped, words upper-cased and tokens separated by single blanks, so
+ * statements differing only in their values share the digest. The digest
+ * is truncated to QueryDigestStats::kMaxDigestLength.
+ *
+ * @param sql statement, as sent with COM_QUERY
+ * @param size number of bytes at sql
+ * @param digest set to the digest, its memory is reused
+ */
+ROUTING_EXPORT void make_query_digest(const uint8_t *sql, size_t size, std::string &digest);
+
+/** @class QueryDigestStats
+ *
+ * Statistics of the sampled statements of a route, per statement digest.
+ *
+ * The digests live in a table of fixed size that is allocated up front.
+ * Adding a sample claims the slot of a new digest with a compare-and-swap
+ * and updates the counters of an existing one with atomic increments, so
+ * connection threads never wait for each other or for readers. Samples of
+ * new digests are only counted as lost once the table is full.
+ */
+class ROUTING_EXPORT QueryDigestStats {
+ public:
+  /** @brief buckets of the latency histogram, bucket i counts latencies below 2^i microseconds */
+  static constexpr size_t kLatencyBuckets = 24;
+
+  /** @brief digests are truncated to this length */
+  static constexpr size_t kMaxDigestLength = 1024;
+
+  /** @brief statistics of one digest, as returned by get_snapshot() */
+  struct Digest {
+    std::string digest;
+    uint64_t count;
+    uint64_t latency_sum_us;
+    uint64_t latency_max_us;
+    uint64_t rows;
+    uint64_t bytes;
+    /** @brief the last bucket counts all larger latencies too */
+    std::array<uint64_t, kLatencyBuckets> latency_histogram;
+  };
+
+  /** @param max_digests number of different digests that are kept */
+  explicit QueryDigestStats(size_t max_digests);
+
+  ~QueryDigestStats();
+
+  QueryDigestStats(const QueryDigestStats &) = delete;
+  QueryDigestStats &operator=(const QueryDigestStats &) = delete;
+
+  /**
+   * @brief Adds a sampled statement.
+   *
+   * @param digest normalized statement, see make_query_digest()
+   * @param latency_us time from the command until the end of its response
+   * @param rows rows of the result sets and affected rows
+   * @param bytes size of the response
+   */
+  void add(const std::string &digest, uint64_t latency_us, uint64_t rows, uint64_t bytes) noexcept;
+
+  /** @brief statistics of all digests seen so far */
+  std::vector<Digest> get_snapshot() const;
+
+  /** @brief samples not counted as their digest didn't fit the table anymore */
+  uint64_t get_lost_samples() const noexcept {
+    return lost_samples_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Entry;
+
+  /** @brief returns entry of the digest, claims a free one for new digests */
+  Entry *find_or_claim(const std::string &digest) noexcept;
+
+  const size_t max_digests_;
+  std::unique_ptr<Entry[]> entries_;
+  std::atomic<uint64_t> lost_samples_{0};
+};
+
+/** @class QueryDigestComponent
+ *
+ * Statistics of the routes sampling statements, to expose them to other
+ * plugins like the REST API.
+ */
+class ROUTING_EXPORT QueryDigestComponent {
+ public:
+  static QueryDigestComponent &getInstance();
+
+  /** @brief makes the statistics of a route known */
+  void register_route(const std::string &name, std::shared_ptr<QueryDigestStats> stats);
+
+  /** @brief forgets about the statistics of a route */
+  void unregister_route(const std::string &name);
+
+  /** @brief statistics of the routes, by name of the route */
+  std::map<std::string, std::shared_ptr<QueryDigestStats>> get_routes();
+
+ private:
+  // disable copy, as we are a single-instance
+  QueryDigestComponent(QueryDigestComponent const &) = delete;
+  void operator=(QueryDigestComponent const &) = delete;
+
+  QueryDigestComponent() = default;
+
+  std::mutex routes_mtx_;
+  std::map<std::string, std::shared_ptr<QueryDigestStats>> routes_;
+};
+
+#endif // MYSQLROUTER_QUERY_DIGEST_STATS_INCLUDED
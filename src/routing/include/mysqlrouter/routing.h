@@ -28,9 +28,13 @@
 #include "socket_operations.h"
 #include "tcp_address.h"
 #include "mysqlrouter/plugin_config.h"
+#include "mysql/harness/networking/resolver_cache.h"
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #ifdef _WIN32
 # define WIN32_LEAN_AND_MEAN
@@ -49,6 +53,11 @@ typedef long ssize_t;
 #  include <ws2tcpip.h>
 #endif
 
+#if defined(__linux__) && !defined(IP_LOCAL_PORT_RANGE)
+// older C libraries don't know it yet, kernels before 6.3 reject it
+#  define IP_LOCAL_PORT_RANGE 51
+#endif
+
 namespace routing {
 
 /** @brief Timeout for idling clients (in seconds)
@@ -98,6 +107,72 @@ extern const std::string kDefaultBindAddress;
  */
 extern const unsigned int kDefaultNetBufferLength;
 
+/** @brief Default number of idle buffers kept by a buffer pool
+ *
+ * Each pool lends net_buffer_length sized buffers to the connections
+ * forwarding data and keeps up to this many of them for reuse.
+ */
+extern const unsigned int kDefaultBufferPoolSize;
+
+/** @brief Default bytes a connection of the event engine forwards per round, see FairScheduler */
+extern const unsigned int kDefaultFairShareQuantum;
+
+/** @brief Timeout after which idle pooled server connections are closed */
+extern const std::chrono::seconds kDefaultConnectionPoolIdleTimeout;
+
+/** @brief Number of different statement digests kept per route sampling statements */
+extern const unsigned int kDefaultMaxQueryDigests;
+
+/** @brief Time a response stays in the result cache of a route */
+extern const std::chrono::milliseconds kDefaultResultCacheTtl;
+
+/** @brief Pause before quarantined servers are probed again
+ *
+ * The pause doubles every time none of the quarantined servers recovered,
+ * up to kDefaultQuarantineMaxInterval.
+ */
+extern const std::chrono::milliseconds kDefaultQuarantineInterval;
+
+/** @brief Longest pause before quarantined servers are probed again */
+extern const std::chrono::milliseconds kDefaultQuarantineMaxInterval;
+
+/** @brief Time clients accepted at max_connections wait for a slot
+ *
+ * Well below the connect timeouts of the clients, which wait for the
+ * greeting meanwhile.
+ */
+extern const std::chrono::milliseconds kDefaultAdmissionQueueTimeout;
+
+/** @brief Default time after which sockets connected ahead to servers get closed unused
+ *
+ * Well below the default connect_timeout of the MySQL Server of 10 seconds,
+ * which the client handshake has to finish in.
+ */
+extern const std::chrono::milliseconds kDefaultWarmConnectionMaxAge;
+
+/** @brief How much slower than the fastest server a server may be
+ *         to still get connections with the lowest-latency strategy */
+extern const std::chrono::milliseconds kDefaultLatencyTolerance;
+
+/** @brief Delay before a hedged connect tries a second server
+ *
+ * Until enough connects were timed to know the percentile, see
+ * RouteDestination::set_connect_hedging().
+ */
+extern const std::chrono::milliseconds kDefaultHedgeDelay;
+
+/** @brief Time the circuit of a server failing its handshakes stays open */
+extern const std::chrono::milliseconds kDefaultCircuitBreakerOpenInterval;
+
+/** @brief Time the PROXY protocol header of a client has to arrive in */
+extern const std::chrono::milliseconds kDefaultProxyProtocolTimeout;
+
+/** @brief Connections that need to finish the handshake to close a half-open circuit */
+extern const unsigned int kDefaultCircuitBreakerHalfOpenConnections;
+
+/** @brief Bytes of client traffic of a connection waiting to be sent to the mirror destination */
+extern const unsigned int kDefaultMirrorBufferSize;
+
 /** @brief Timeout waiting for handshake response from client
  *
  * The number of seconds that MySQL Router waits for a handshake response.
@@ -127,8 +202,129 @@ enum class RoutingStrategy {
   kNextAvailable = 2,
   kRoundRobin = 3,
   kRoundRobinWithFallback = 4,
+  kLeastConnections = 5,
+  kWeightedRoundRobin = 6,
+  kLowestLatency = 7,
+  kConsistentHash = 8,
+};
+
+/** @brief I/O engines serving the connections of a route */
+enum class IOEngine {
+  kUndefined = 0,
+  kThread = 1,
+  kEvent = 2,
 };
 
+/** @brief Default I/O engine */
+extern const IOEngine kDefaultIOEngine;
+
+/** @brief Default number of I/O threads of the event engine
+ *
+ * 0 means one I/O thread per CPU.
+ */
+extern const unsigned int kDefaultIOThreads;
+
+/** @brief Default number of threads accepting the TCP connections of a route */
+extern const unsigned int kDefaultAcceptorThreads;
+
+/** @class SourceAddressPool
+ * @brief Local addresses the connections to the servers get spread over
+ *
+ * Each local address has its own ephemeral ports for every server, the
+ * connections to a server aren't limited by the ephemeral port range of a
+ * single address. Connects take the addresses of the server's address
+ * family in turn.
+ */
+class SourceAddressPool {
+ public:
+  /**
+   * @param addresses numeric IPv4 or IPv6 addresses
+   * @throws std::invalid_argument if an address isn't numeric
+   */
+  explicit SourceAddressPool(const std::vector<std::string>& addresses);
+
+  /** @brief Returns the next address of the family, nullptr if there is none */
+  const mysql_harness::ResolverCache::Address* next(int family) const noexcept;
+
+  size_t size() const noexcept { return addresses_.size(); }
+
+ private:
+  mysql_harness::ResolverCache::Addresses addresses_;
+  mutable std::atomic<size_t> next_{0};
+};
+
+/** @brief Options applied to the sockets of a route
+ *
+ * 0 keeps the system default of the option.
+ */
+struct SocketOptions {
+  /** @brief TCP_FASTOPEN queue length of the listeners */
+  unsigned int tcp_fastopen{0};
+  /** @brief TCP_DEFER_ACCEPT timeout of the listeners, in seconds */
+  unsigned int tcp_defer_accept{0};
+  /** @brief SO_RCVBUF of the listeners and the server connections */
+  unsigned int rcvbuf{0};
+  /** @brief SO_SNDBUF of the listeners and the server connections */
+  unsigned int sndbuf{0};
+  /** @brief SO_KEEPALIVE of the listeners and the server connections */
+  bool keepalive{false};
+  /** @brief TCP_KEEPIDLE, idle time before the first keepalive probe, in seconds */
+  unsigned int keepalive_idle{0};
+  /** @brief TCP_KEEPINTVL, time between the keepalive probes, in seconds */
+  unsigned int keepalive_interval{0};
+  /** @brief TCP_KEEPCNT, unanswered keepalive probes before the connection is dropped */
+  unsigned int keepalive_count{0};
+  /** @brief TCP_USER_TIMEOUT, how long sent data may stay unacknowledged, in milliseconds */
+  unsigned int user_timeout{0};
+  /** @brief local addresses the server connections are bound to, nullptr for the system's choice */
+  std::shared_ptr<const SourceAddressPool> source_addresses;
+  /** @brief IP_LOCAL_PORT_RANGE of the server connections, lowest port */
+  uint16_t source_port_low{0};
+  /** @brief IP_LOCAL_PORT_RANGE of the server connections, highest port */
+  uint16_t source_port_high{0};
+};
+
+/** @brief A socket option to set with setsockopt() */
+struct SocketOption {
+  int level;
+  int option;
+  int value;
+  /** @brief name of the option, for logging */
+  const char* name;
+};
+
+/** @brief Returns the options detecting dead peers on TCP sockets
+ *
+ * SO_KEEPALIVE, the keepalive timings and TCP_USER_TIMEOUT, as far as the
+ * platform has them. Options that keep the system default are left out.
+ *
+ * @param options options of the route
+ * @return options to set on the socket, in order
+ */
+std::vector<SocketOption> get_dead_peer_socket_options(const SocketOptions& options);
+
+/** @brief Get comma separated list of all I/O engine names
+ *
+ */
+std::string get_io_engine_names();
+
+/** @brief Returns IOEngine for its literal representation
+ *
+ * If no IOEngine is found for given string,
+ * IOEngine::kUndefined is returned.
+ *
+ * @param value literal representation of the I/O engine
+ * @return IOEngine for the given string or IOEngine::kUndefined
+ */
+IOEngine get_io_engine(const std::string& value);
+
+/** @brief Returns literal name of given I/O engine
+ *
+ * @param io_engine I/O engine to look up
+ * @return Name of I/O engine as std::string
+ */
+std::string get_io_engine_name(IOEngine io_engine) noexcept;
+
 /** @brief Get comma separated list of all access mode names
  *
  */
@@ -192,6 +388,30 @@ std::string get_routing_strategy_name(RoutingStrategy routing_strategy) noexcept
  */
 void set_socket_blocking(int sock, bool blocking);
 
+/** @brief prefix of destinations connected through a unix socket */
+extern const char kUnixSocketPrefix[];
+
+/**
+ * Returns true if the destination is the path of a unix socket, like
+ * unix:///var/run/mysqld/mysqld.sock.
+ */
+bool is_unix_socket_destination(const std::string& destination) noexcept;
+
+/**
+ * Returns the address of a destination that is a unix socket.
+ *
+ * The address is the path of the socket, without port, see is_unix_socket().
+ *
+ * @throws std::runtime_error if the path isn't absolute or too long
+ */
+mysql_harness::TCPAddress get_unix_socket_address(const std::string& destination);
+
+/**
+ * Returns true if the address is the one of a unix socket, made by
+ * get_unix_socket_address().
+ */
+bool is_unix_socket(const mysql_harness::TCPAddress& address) noexcept;
+
 
 /** @class RoutingSockOpsInterface
  * @brief Interface class to allow multiple RoutingSockOps implementations
@@ -200,7 +420,14 @@ void set_socket_blocking(int sock, bool blocking);
 class RoutingSockOpsInterface {
  public:
   virtual ~RoutingSockOpsInterface() = default;
-  virtual int get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds connect_timeout_ms, bool log = true) noexcept = 0;
+  virtual int get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds connect_timeout_ms, bool log = true,
+                               const SocketOptions& options = SocketOptions()) noexcept = 0;
+  virtual std::vector<bool> probe_mysql_servers(const std::vector<mysql_harness::TCPAddress>& addrs,
+                                                std::chrono::milliseconds connect_timeout) noexcept = 0;
+  virtual int get_mysql_socket_hedged(const std::vector<mysql_harness::TCPAddress>& addrs,
+                                      std::chrono::milliseconds connect_timeout,
+                                      std::chrono::milliseconds hedge_delay, bool wait_for_greeting,
+                                      const SocketOptions& options, size_t& connected) noexcept = 0;
   virtual mysql_harness::SocketOperationsBase* so() const = 0;
 };
 
@@ -215,9 +442,8 @@ class RoutingSockOps : public RoutingSockOpsInterface {
 
   /** @brief Returns socket descriptor of connected MySQL server
    *
-   * Iterates through all available connections (until it succesfully connects)
-   * to the selected address as returned by getaddrinfo()
-   * (see its documentation for the details).
+   * Connects to the addresses the name resolves to, see connect_to_addresses(),
+   * or to the unix socket if the address is one, see is_unix_socket().
    * If it's not able to connect via any path, it returns value < 0.
    *
    * Returns a socket descriptor for the connection to the MySQL Server or
@@ -228,14 +454,82 @@ class RoutingSockOps : public RoutingSockOpsInterface {
    * @param addr information of the server we connect with
    * @param connect_timeout timeout waiting for connection
    * @param log whether to log errors or not
+   * @param options buffer sizes and keepalive options set before connecting, failures are logged
    * @return a socket descriptor
    */
-  int get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds connect_timeout, bool log = true) noexcept override;
+  int get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds connect_timeout, bool log = true,
+                       const SocketOptions& options = SocketOptions()) noexcept override;
+
+  /** @brief Checks which of the servers accept connections
+   *
+   * Connects to all servers at the same time using non-blocking connects
+   * and closes the connections again once established, waiting at most
+   * connect_timeout in total.
+   *
+   * @param addrs servers to check
+   * @param connect_timeout timeout waiting for the connections
+   * @return for each server whether it accepted the connection
+   */
+  std::vector<bool> probe_mysql_servers(const std::vector<mysql_harness::TCPAddress>& addrs,
+                                        std::chrono::milliseconds connect_timeout) noexcept override;
+
+  /** @brief Returns socket descriptor of the server that answers first
+   *
+   * Connects to the first server and, if it didn't answer after
+   * hedge_delay, to the next one too, and so on. A server that fails lets
+   * the next one start right away. The first server whose connect
+   * finishes, or that sends its greeting if wait_for_greeting is set,
+   * wins; the other connects get closed. Only the first address a server
+   * name resolves to is tried. Each connect gives up after
+   * connect_timeout.
+   *
+   * The greeting stays unread in the socket for the protocol handshake.
+   *
+   * @param addrs servers to connect, in order of preference
+   * @param connect_timeout timeout waiting for each connect
+   * @param hedge_delay head start of each server before the next one is tried
+   * @param wait_for_greeting true if the server speaks first, like with the classic protocol
+   * @param options buffer sizes and keepalive options set before connecting, failures are logged
+   * @param connected set to the index of the server connected to
+   * @return a socket descriptor or a negative value like get_mysql_socket()
+   */
+  int get_mysql_socket_hedged(const std::vector<mysql_harness::TCPAddress>& addrs,
+                              std::chrono::milliseconds connect_timeout,
+                              std::chrono::milliseconds hedge_delay, bool wait_for_greeting,
+                              const SocketOptions& options, size_t& connected) noexcept override;
+
+  /** @brief Returns socket descriptor connected to one of the addresses
+   *
+   * Connects the Happy Eyeballs way (RFC 8305): address families are
+   * interleaved and each address gets a head start of 250ms before the
+   * connect to the next address starts in parallel. The first connected
+   * socket wins, the other attempts are cancelled. Each attempt gives up
+   * after connect_timeout.
+   *
+   * @param addresses resolved addresses, in order of preference
+   * @param name server name used for logging
+   * @param connect_timeout timeout waiting for each connection attempt
+   * @param options buffer sizes and keepalive options set before connecting, failures are logged
+   * @param timeout_expired set to true if any of the attempts timed out
+   * @return a non-blocking socket descriptor or routing::kInvalidSocket
+   */
+  int connect_to_addresses(const mysql_harness::ResolverCache::Addresses& addresses, const std::string& name,
+                           std::chrono::milliseconds connect_timeout, const SocketOptions& options,
+                           bool& timeout_expired) noexcept;
 
   /** @brief Returns SocketOperations implementation used by this class */
   mysql_harness::SocketOperationsBase* so() const override { return so_; }
 
  private:
+  /** @brief sets a socket option unless value is 0, failures are logged */
+  void set_socket_option(int sock, int level, int option, unsigned int value, const char* name) noexcept;
+
+  /** @brief opens a non-blocking socket for the address with the options set, kInvalidSocket on failure */
+  int open_socket(const mysql_harness::ResolverCache::Address& address, const SocketOptions& options) noexcept;
+
+  /** @brief makes a connected socket blocking and disables Nagle, closes it on failure */
+  int prepare_connected_socket(int sock, const mysql_harness::TCPAddress& addr) noexcept;
+
   RoutingSockOps() = default;
   RoutingSockOps(const RoutingSockOps&) = delete;
   RoutingSockOps operator=(const RoutingSockOps&) = delete;
@@ -0,0 +1,182 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_ROUTING_CONTROL_INCLUDED
+#define MYSQLROUTER_ROUTING_CONTROL_INCLUDED
+
+#include "mysqlrouter/routing_export.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** @brief Settings of a route which can be changed while it runs */
+struct RouteSettings {
+  /** @brief maximum of active client connections */
+  int max_connections{0};
+  /** @brief size of the read buffers of new connections */
+  unsigned int net_buffer_length{0};
+  /** @brief destinations as host:port */
+  std::vector<std::string> destinations;
+  /** @brief false if the destinations come from the metadata cache and can't be changed */
+  bool static_destinations{false};
+};
+
+/** @brief Changes to the settings of a route, only the set ones are changed */
+struct RouteSettingsChange {
+  bool change_max_connections{false};
+  int max_connections{0};
+
+  bool change_net_buffer_length{false};
+  unsigned int net_buffer_length{0};
+
+  bool change_destinations{false};
+  std::vector<std::string> destinations;
+};
+
+/** @brief A client connection of a route, as listed by RouteControl::get_connections() */
+struct RouteConnectionInfo {
+  /** @brief address and port of the client, or the path of the named socket */
+  std::string client_address;
+  /** @brief server as host:port, empty while still connecting */
+  std::string server_address;
+  /** @brief when the client connection got accepted */
+  std::chrono::system_clock::time_point started;
+  /** @brief bytes forwarded from the client to the server */
+  uint64_t bytes_from_client{0};
+  /** @brief bytes forwarded from the server to the client */
+  uint64_t bytes_from_server{0};
+  /** @brief time since the last byte got forwarded either way */
+  std::chrono::milliseconds idle{0};
+};
+
+/** @brief A page of the connections of a route */
+struct RouteConnectionsPage {
+  std::vector<RouteConnectionInfo> connections;
+  /** @brief cursor of the next page, 0 once all connections got listed */
+  size_t next_cursor{0};
+};
+
+/** @brief Health and performance of a destination, as listed by RouteControl::get_destination_scores() */
+struct RouteDestinationScore {
+  /** @brief server as host:port */
+  std::string address;
+  uint64_t connects_succeeded{0};
+  uint64_t connects_failed{0};
+  /** @brief smoothed share of the connects that succeeded, 1 until one was tried */
+  double connect_success_rate{1.0};
+  /** @brief smoothed time the successful connects took, zero until one succeeded */
+  std::chrono::microseconds connect_latency{0};
+  /** @brief client connections routed to the server now */
+  uint64_t active_connections{0};
+  /** @brief bytes forwarded either way per second, since the previous listing a second or more ago */
+  double bytes_per_second{0};
+  /** @brief state of the circuit breaker: closed, open or half-open */
+  std::string circuit_state{"closed"};
+  /** @brief error code of the last failed connect, 0 if none failed */
+  int last_error{0};
+  /** @brief when the last connect failed */
+  std::chrono::system_clock::time_point last_error_time;
+};
+
+/** @class RouteControl
+ *
+ * Changes the settings of a running route. New connections get the new
+ * settings, established connections keep those they started with.
+ */
+class ROUTING_EXPORT RouteControl {
+ public:
+  virtual ~RouteControl() = default;
+
+  /** @brief Returns the current settings of the route */
+  virtual RouteSettings get_settings() = 0;
+
+  /** @brief Validates all changes and applies them if all are valid
+   *
+   * @throw std::invalid_argument if a change is not valid, nothing was
+   *        changed then
+   */
+  virtual void change_settings(const RouteSettingsChange &change) = 0;
+
+  /** @brief Lists the client connections of the route, a page at a time
+   *
+   * Pages don't give a consistent view: connections opened or closed
+   * while paging may be listed or not.
+   *
+   * @param cursor 0 for the first page, else next_cursor of the previous page
+   * @param limit pages stop once they have at least that many connections
+   */
+  virtual RouteConnectionsPage get_connections(size_t cursor, size_t limit) = 0;
+
+  /** @brief Lists the servers the route connected to, or tried to */
+  virtual std::vector<RouteDestinationScore> get_destination_scores() = 0;
+};
+
+/** @class RoutingControlComponent
+ *
+ * Controls of the running routes, to let other plugins like the REST API
+ * change them.
+ */
+class ROUTING_EXPORT RoutingControlComponent {
+ public:
+  static RoutingControlComponent &getInstance();
+
+  /** @brief makes the control of a route known */
+  void register_route(const std::string &name, RouteControl *control);
+
+  /** @brief forgets about the control of a route
+   *
+   * Waits for with_route() calls using it to finish.
+   */
+  void unregister_route(const std::string &name);
+
+  /** @brief names of the routes */
+  std::vector<std::string> get_route_names();
+
+  /** @brief Calls func with the control of a route
+   *
+   * The route can't get unregistered while func runs.
+   *
+   * @returns false if the route is not known
+   */
+  bool with_route(const std::string &name, const std::function<void(RouteControl &)> &func);
+
+ private:
+  // disable copy, as we are a single-instance
+  RoutingControlComponent(RoutingControlComponent const &) = delete;
+  void operator=(RoutingControlComponent const &) = delete;
+
+  RoutingControlComponent() = default;
+
+  std::mutex routes_mtx_;
+  std::map<std::string, RouteControl *> routes_;
+};
+
+#endif // MYSQLROUTER_ROUTING_CONTROL_INCLUDED
@@ -0,0 +1,233 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_ROUTING_METRICS_INCLUDED
+#define MYSQLROUTER_ROUTING_METRICS_INCLUDED
+
+#include "mysqlrouter/routing_export.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/** @class RoutingMetrics
+ *
+ * Counters of a route: connections, bytes and latency histograms, and which
+ * servers are quarantined.
+ *
+ * The counters are split into shards and each thread updates the shard it
+ * got assigned with relaxed atomic increments, so threads routing
+ * connections don't share cache lines with each other or with readers.
+ * get_snapshot() sums up the shards.
+ */
+class ROUTING_EXPORT RoutingMetrics {
+ public:
+  /** @brief number of shards the threads are spread over */
+  static constexpr size_t kShards = 16;
+
+  /** @brief what a latency histogram measures */
+  enum class Latency {
+    /** @brief successful connects to the servers */
+    kConnect,
+    /** @brief from accepting the client connection until the handshake is done */
+    kHandshake,
+    /** @brief from accepting the client connection until it got closed */
+    kLifetime,
+    /** @brief from the first byte of a client request until the first byte of the response */
+    kRoundTrip,
+  };
+
+  /** @brief number of latency histograms */
+  static constexpr size_t kLatencies = 4;
+
+  /** @brief why a client connection got closed by the router */
+  enum class Timeout {
+    /** @brief the handshake wasn't done within client_connect_timeout */
+    kHandshake,
+    /** @brief nothing forwarded for idle_timeout */
+    kIdle,
+    /** @brief open for max_connection_lifetime */
+    kLifetime,
+  };
+
+  /** @brief number of kinds of timeouts */
+  static constexpr size_t kTimeouts = 3;
+
+  /** @brief buckets of a latency histogram, bucket i counts latencies below 2^i * 64 microseconds */
+  static constexpr size_t kLatencyBuckets = 24;
+
+  /** @brief counters of the buffer pools of the route, summed up over the pools */
+  struct BufferPoolCounters {
+    /** @brief buffers lent from the idle buffers */
+    uint64_t hits;
+    /** @brief buffers that had to be allocated */
+    uint64_t misses;
+    /** @brief returned buffers freed as the pool kept enough idle ones */
+    uint64_t evictions;
+    /** @brief max number of buffers lent at the same time, per pool */
+    uint64_t high_water;
+  };
+
+  /** @brief sums of the counters, as returned by get_snapshot() */
+  struct Snapshot {
+    struct Histogram {
+      uint64_t count;
+      uint64_t sum_us;
+      /** @brief the last bucket counts all larger latencies too */
+      std::array<uint64_t, kLatencyBuckets> buckets;
+    };
+
+    uint64_t connections_total;
+    uint64_t connections_active;
+    uint64_t bytes_up;
+    uint64_t bytes_down;
+    uint64_t connect_errors;
+    /** @brief client connections closed for a failed read or write */
+    uint64_t connection_errors;
+    /** @brief client connections closed for a timeout, indexed by Timeout */
+    std::array<uint64_t, kTimeouts> timeouts;
+    /** @brief histograms, indexed by Latency */
+    std::array<Histogram, kLatencies> latencies;
+    /** @brief quarantine state by address of the servers that got quarantined once */
+    std::map<std::string, bool> quarantined;
+    /** @brief zero until set_buffer_pool_source() was called */
+    BufferPoolCounters buffer_pool;
+  };
+
+  RoutingMetrics();
+  ~RoutingMetrics();
+
+  RoutingMetrics(const RoutingMetrics &) = delete;
+  RoutingMetrics &operator=(const RoutingMetrics &) = delete;
+
+  /** @brief upper bound of latency bucket */
+  static std::chrono::microseconds latency_bucket_bound(size_t bucket) {
+    return std::chrono::microseconds(uint64_t{64} << bucket);
+  }
+
+  /** @brief counts a client connection that got accepted */
+  void connection_opened() noexcept;
+
+  /**
+   * @brief counts a client connection that got closed.
+   *
+   * @param bytes_up bytes sent from the client to the server
+   * @param bytes_down bytes sent from the server to the client
+   */
+  void connection_closed(uint64_t bytes_up, uint64_t bytes_down) noexcept;
+
+  /** @brief adds a latency to its histogram */
+  void add_latency(Latency what, std::chrono::microseconds latency) noexcept;
+
+  /** @brief counts a failed connect to a server */
+  void connect_failed() noexcept;
+
+  /** @brief counts a client connection closed for a failed read or write */
+  void connection_failed() noexcept;
+
+  /** @brief counts a client connection closed for a timeout */
+  void timed_out(Timeout what) noexcept;
+
+  /**
+   * @brief sets whether a server is quarantined.
+   *
+   * Takes a lock, only for the rare changes of the state.
+   */
+  void set_quarantined(const std::string &address, bool quarantined);
+
+  /**
+   * @brief sets where get_snapshot() takes the counters of the buffer pools from.
+   *
+   * The pools count under their own locks, the source is only called by
+   * get_snapshot(). Waits for a running call of the previous source.
+   *
+   * @param source returns the current counters, nullptr for none
+   */
+  void set_buffer_pool_source(std::function<BufferPoolCounters()> source);
+
+  /** @brief sums of the shards */
+  Snapshot get_snapshot() const;
+
+  /** @brief histogram in the snapshot */
+  static const Snapshot::Histogram &histogram(const Snapshot &snapshot, Latency what) {
+    return snapshot.latencies[static_cast<size_t>(what)];
+  }
+
+  /** @brief count of a timeout in the snapshot */
+  static uint64_t timeouts(const Snapshot &snapshot, Timeout what) {
+    return snapshot.timeouts[static_cast<size_t>(what)];
+  }
+
+ private:
+  struct Shard;
+
+  /** @brief shard of the calling thread */
+  Shard &shard() noexcept;
+
+  std::unique_ptr<Shard[]> shards_;
+
+  mutable std::mutex quarantined_mtx_;
+  std::map<std::string, bool> quarantined_;
+
+  mutable std::mutex buffer_pool_mtx_;
+  std::function<BufferPoolCounters()> buffer_pool_source_;
+};
+
+/** @class RoutingMetricsComponent
+ *
+ * Metrics of the routes, to expose them to other plugins like the REST API.
+ */
+class ROUTING_EXPORT RoutingMetricsComponent {
+ public:
+  static RoutingMetricsComponent &getInstance();
+
+  /** @brief makes the metrics of a route known */
+  void register_route(const std::string &name, std::shared_ptr<RoutingMetrics> metrics);
+
+  /** @brief forgets about the metrics of a route */
+  void unregister_route(const std::string &name);
+
+  /** @brief metrics of the routes, by name of the route */
+  std::map<std::string, std::shared_ptr<RoutingMetrics>> get_routes();
+
+ private:
+  // disable copy, as we are a single-instance
+  RoutingMetricsComponent(RoutingMetricsComponent const &) = delete;
+  void operator=(RoutingMetricsComponent const &) = delete;
+
+  RoutingMetricsComponent() = default;
+
+  std::mutex routes_mtx_;
+  std::map<std::string, std::shared_ptr<RoutingMetrics>> routes_;
+};
+
+#endif // MYSQLROUTER_ROUTING_METRICS_INCLUDED
@@ -0,0 +1,187 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_ROUTING_STATS_SEGMENT_INCLUDED
+#define MYSQLROUTER_ROUTING_STATS_SEGMENT_INCLUDED
+
+#include "mysqlrouter/routing_export.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief Layout of the statistics segment the routing_stats plugin
+ *        publishes to a memory mapped file.
+ *
+ * Monitoring agents on the same host map the file read-only and copy it
+ * with read_stats_segment() as often as they like, without calls into the
+ * router. The layout only gets extended at its end, readers check magic
+ * and version and ignore the size beyond what they know.
+ *
+ * The writer increments `sequence` to an odd number before it changes the
+ * segment and to the next even number after it (a seqlock): a copy taken
+ * while the sequence stayed the same and even is consistent.
+ */
+namespace routing_stats {
+
+/** @brief "MRST" */
+constexpr uint32_t kSegmentMagic = 0x5453524d;
+constexpr uint32_t kSegmentVersion = 1;
+
+/** @brief longest route name or server address, including the terminating NUL */
+constexpr size_t kNameSize = 64;
+/** @brief routes in the segment, the others are left out */
+constexpr size_t kMaxRoutes = 64;
+/** @brief servers of a route in the segment, the others are left out */
+constexpr size_t kMaxDestinations = 16;
+
+struct DestinationStats {
+  /** @brief server as host:port, NUL terminated */
+  char address[kNameSize];
+  uint64_t connects_succeeded;
+  uint64_t connects_failed;
+  uint64_t active_connections;
+  /** @brief smoothed time the successful connects took */
+  uint64_t connect_latency_us;
+  /** @brief 1 if the circuit breaker doesn't let connections through */
+  uint64_t circuit_open;
+};
+
+struct RouteStats {
+  /** @brief name of the route, NUL terminated */
+  char name[kNameSize];
+  uint64_t connections_total;
+  uint64_t connections_active;
+  uint64_t bytes_up;
+  uint64_t bytes_down;
+  uint64_t connect_errors;
+  uint64_t connection_errors;
+  uint64_t handshake_timeouts;
+  uint64_t idle_timeouts;
+  uint64_t lifetime_timeouts;
+  /** @brief valid entries of destinations */
+  uint64_t destinations_count;
+  DestinationStats destinations[kMaxDestinations];
+};
+
+struct MetadataCacheStats {
+  /** @brief 1 if a metadata cache is configured, the other fields are 0 otherwise */
+  uint64_t enabled;
+  uint64_t refreshes;
+  uint64_t refresh_failures;
+  uint64_t last_refresh_duration_us;
+};
+
+struct Segment {
+  uint32_t magic;
+  uint32_t version;
+  /** @brief size of the segment as written */
+  uint64_t size;
+  /** @brief odd while the writer changes the segment */
+  std::atomic<uint64_t> sequence;
+  /** @brief when the segment got written, microseconds since the epoch */
+  uint64_t updated_at_us;
+  MetadataCacheStats metadata_cache;
+  /** @brief valid entries of routes */
+  uint64_t routes_count;
+  RouteStats routes[kMaxRoutes];
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "the sequence needs to be a plain 64-bit word in the segment");
+
+/**
+ * @brief Copies a consistent state of a mapped segment.
+ *
+ * @param shared the segment as mapped from the file
+ * @param copy set to the state of the segment
+ * @param attempts copies tried while the writer changes the segment
+ *
+ * @return false if the segment isn't (yet) valid or no copy was consistent
+ */
+inline bool read_stats_segment(const Segment &shared, Segment &copy, size_t attempts = 100) noexcept {
+  for (size_t i = 0; i < attempts; ++i) {
+    const uint64_t before = shared.sequence.load(std::memory_order_acquire);
+    if (before % 2 != 0) continue;
+    std::memcpy(static_cast<void *>(&copy), static_cast<const void *>(&shared), sizeof(copy));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shared.sequence.load(std::memory_order_relaxed) != before) continue;
+
+    return copy.magic == kSegmentMagic && copy.version == kSegmentVersion;
+  }
+  return false;
+}
+
+/** @class SegmentWriter
+ *
+ * Creates the file of a segment, maps it and publishes new states to it.
+ *
+ * Only available on Unix.
+ */
+class ROUTING_EXPORT SegmentWriter {
+ public:
+  /**
+   * @brief Creates or truncates the file and maps it.
+   *
+   * @throw std::runtime_error if the file can't be created or mapped
+   */
+  explicit SegmentWriter(const std::string &path);
+
+  /** @brief unmaps and removes the file, agents see the router is gone */
+  ~SegmentWriter();
+
+  SegmentWriter(const SegmentWriter &) = delete;
+  SegmentWriter &operator=(const SegmentWriter &) = delete;
+
+  /**
+   * @brief Publishes a new state.
+   *
+   * Copies all but magic, version, size and sequence of state to the mapped
+   * segment within a write of the seqlock.
+   */
+  void publish(const Segment &state) noexcept;
+
+  /** @brief the mapped segment */
+  const Segment &get_segment() const noexcept { return *segment_; }
+
+  /** @brief copies a name to a field of kNameSize bytes, truncated if needed */
+  static void set_name(char (&field)[kNameSize], const std::string &name) noexcept {
+    const size_t size = name.size() < kNameSize - 1 ? name.size() : kNameSize - 1;
+    std::memcpy(field, name.data(), size);
+    std::memset(field + size, 0, kNameSize - size);
+  }
+
+ private:
+  std::string path_;
+  int fd_{-1};
+  Segment *segment_{nullptr};
+};
+
+}  // namespace routing_stats
+
+#endif // MYSQLROUTER_ROUTING_STATS_SEGMENT_INCLUDED
@@ -0,0 +1,120 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "admission_queue.h"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include "utils.h"
+
+AdmissionQueue::AdmissionQueue(size_t max_size, std::chrono::milliseconds timeout)
+    : max_size_(max_size), timeout_(timeout) {
+#ifndef _WIN32
+  if (pipe(wakeup_fds_) == -1) {
+    throw std::runtime_error("Failed to create wakeup pipe: " + get_message_error(errno));
+  }
+
+  for (int fd: wakeup_fds_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+}
+
+AdmissionQueue::~AdmissionQueue() {
+#ifndef _WIN32
+  ::close(wakeup_fds_[0]);
+  ::close(wakeup_fds_[1]);
+#endif
+}
+
+bool AdmissionQueue::push(int socket, const sockaddr_storage &client_addr,
+                          clock_type::time_point now) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (entries_.size() >= max_size_) return false;
+
+  entries_.push_back(Entry{socket, client_addr, now + timeout_});
+  size_.store(entries_.size(), std::memory_order_relaxed);
+  return true;
+}
+
+bool AdmissionQueue::pop(Entry &entry) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (entries_.empty()) return false;
+
+  entry = entries_.front();
+  entries_.pop_front();
+  size_.store(entries_.size(), std::memory_order_relaxed);
+  return true;
+}
+
+std::vector<AdmissionQueue::Entry> AdmissionQueue::pop_expired(clock_type::time_point now) {
+  std::vector<Entry> expired;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  // all wait for the same time, the oldest expire first
+  while (!entries_.empty() && entries_.front().deadline <= now) {
+    expired.push_back(entries_.front());
+    entries_.pop_front();
+  }
+  size_.store(entries_.size(), std::memory_order_relaxed);
+
+  return expired;
+}
+
+std::vector<AdmissionQueue::Entry> AdmissionQueue::pop_all() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::vector<Entry> all(entries_.begin(), entries_.end());
+  entries_.clear();
+  size_.store(0, std::memory_order_relaxed);
+
+  return all;
+}
+
+void AdmissionQueue::notify() noexcept {
+  if (empty()) return;
+
+#ifndef _WIN32
+  const char c = 0;
+  ssize_t res;
+  // a full pipe means the acceptor has a wakeup pending already
+  do {
+    res = ::write(wakeup_fds_[1], &c, 1);
+  } while (res == -1 && errno == EINTR);
+#endif
+}
+
+void AdmissionQueue::clear_wakeups() noexcept {
+#ifndef _WIN32
+  char buf[64];
+  while (::read(wakeup_fds_[0], buf, sizeof(buf)) > 0) {}
+#endif
+}
@@ -0,0 +1,132 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_ADMISSION_QUEUE_INCLUDED
+#define ROUTING_ADMISSION_QUEUE_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#else
+#  include <winsock2.h>
+#endif
+
+/**
+ * @brief AdmissionQueue holds client connections accepted while the route
+ *        is at max_connections until a connection closes.
+ *
+ * The acceptors push the accepted sockets instead of rejecting them. The
+ * waiting clients don't get a thread; the sockets sit in the queue, in the
+ * order they got accepted. Removed connections call notify(), which wakes up
+ * the main acceptor through a pipe, and the acceptor pops the oldest sockets
+ * into the free slots. Sockets still queued at their deadline are
+ * rejected, as they would have been without the queue.
+ *
+ * On Windows WSAPoll() doesn't take pipes. There is no wakeup and the
+ * acceptor admits when its poll() times out.
+ */
+class AdmissionQueue {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  struct Entry {
+    int socket;
+    sockaddr_storage client_addr;
+    /** @brief time at which the client is rejected if still waiting */
+    clock_type::time_point deadline;
+  };
+
+  /**
+   * @param max_size sockets that may wait, further ones get rejected
+   * @param timeout time a socket may wait
+   *
+   * @throws std::runtime_error if the wakeup pipe can't be created
+   */
+  AdmissionQueue(size_t max_size, std::chrono::milliseconds timeout);
+
+  /** @brief closes the wakeup pipe, the sockets are left to the owner */
+  ~AdmissionQueue();
+
+  AdmissionQueue(const AdmissionQueue&) = delete;
+  AdmissionQueue& operator=(const AdmissionQueue&) = delete;
+
+  /**
+   * @brief adds a socket at the end of the queue
+   *
+   * @return false if the queue is full, the socket is left to the caller
+   */
+  bool push(int socket, const sockaddr_storage &client_addr,
+            clock_type::time_point now = clock_type::now());
+
+  /** @brief takes the oldest socket, false if the queue is empty */
+  bool pop(Entry &entry);
+
+  /** @brief takes the sockets whose deadline passed */
+  std::vector<Entry> pop_expired(clock_type::time_point now = clock_type::now());
+
+  /** @brief takes all sockets */
+  std::vector<Entry> pop_all();
+
+  bool empty() const noexcept {
+    return size_.load(std::memory_order_relaxed) == 0;
+  }
+
+  size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief wakes up the acceptor if sockets are waiting
+   *
+   * Called by every connection that closes. It costs a relaxed load if
+   * nothing is queued.
+   */
+  void notify() noexcept;
+
+  /** @brief readable after notify(), -1 if there is no wakeup pipe */
+  int get_wakeup_fd() const noexcept { return wakeup_fds_[0]; }
+
+  /** @brief empties the wakeup pipe before the acceptor admits */
+  void clear_wakeups() noexcept;
+
+private:
+  const size_t max_size_;
+  const std::chrono::milliseconds timeout_;
+
+  mutable std::mutex mtx_;
+  std::deque<Entry> entries_;
+  /** @brief entries_.size(), readable without the lock */
+  std::atomic<size_t> size_{0};
+
+  int wakeup_fds_[2] = { -1, -1 };
+};
+
+#endif  // ROUTING_ADMISSION_QUEUE_INCLUDED
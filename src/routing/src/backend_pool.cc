@@ -0,0 +1,270 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "backend_pool.h"
+
+#include "mysql/harness/logging/logging.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/x_handshake.h"
+#include "socket_operations.h"
+#include "utils.h"
+
+#include <algorithm>
+
+IMPORT_LOG_FUNCTIONS()
+
+// required by C++11, deprecated in C++17
+constexpr std::chrono::milliseconds BackendConnectionPool::kResetTimeout;
+
+static const uint8_t kComQuit = 0x01;
+static const uint8_t kComResetConnection = 0x1f;
+
+BackendConnectionPool::BackendConnectionPool(mysql_harness::SocketOperationsBase *sock_ops,
+                                             size_t max_idle,
+                                             std::chrono::milliseconds idle_timeout,
+                                             BaseProtocol::Type protocol)
+    : sock_ops_(sock_ops), max_idle_(max_idle), idle_timeout_(idle_timeout), protocol_(protocol) {
+}
+
+BackendConnectionPool::~BackendConnectionPool() {
+  for (const Connection &connection: idle_) {
+    close_connection(connection);
+  }
+}
+
+void BackendConnectionPool::park(Connection connection) {
+  uint8_t reset[] = {0x01, 0x00, 0x00, 0x00, kComResetConnection};
+  // the response to CapabilitiesGet tells where the responses to the
+  // messages of the last client end
+  uint8_t x_reset[] = {0x01, 0x00, 0x00, 0x00, x_handshake::kSessionReset,
+                       0x01, 0x00, 0x00, 0x00, x_handshake::kCapabilitiesGet};
+  const bool x_protocol = protocol_ == BaseProtocol::Type::kXProtocol;
+  if (sock_ops_->write_all(connection.socket, x_protocol ? x_reset : reset,
+                           x_protocol ? sizeof(x_reset) : sizeof(reset)) < 0) {
+    log_debug("fd=%d failed to reset server connection: %s", connection.socket,
+        get_message_error(sock_ops_->get_errno()).c_str());
+    sock_ops_->close(connection.socket);
+    return;
+  }
+  connection.reset_pending = true;
+  // a reset session doesn't keep the character set of the client, nor prepared statements
+  connection.session_key.clear();
+  connection.statements.clear();
+
+  add_idle(std::move(connection), stats_.parked);
+}
+
+void BackendConnectionPool::release(Connection connection) {
+  connection.reset_pending = false;
+
+  add_idle(std::move(connection), stats_.released);
+}
+
+void BackendConnectionPool::add_idle(Connection connection, uint64_t &counter) {
+  connection.parked_at = std::chrono::steady_clock::now();
+
+  std::vector<Connection> to_close;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    take_expired(to_close);
+    if (idle_.size() >= max_idle_ && !idle_.empty()) {
+      to_close.push_back(idle_.front());
+      idle_.pop_front();
+    }
+    if (max_idle_ > 0) {
+      idle_.push_back(std::move(connection));
+      ++counter;
+    } else {
+      to_close.push_back(std::move(connection));
+    }
+  }
+
+  for (const Connection &c: to_close) {
+    close_connection(c);
+  }
+}
+
+bool BackendConnectionPool::take(const mysql_harness::TCPAddress &address, uint32_t capabilities,
+                                 Connection &connection) {
+  // COM_CHANGE_USER resets released sessions too
+  return take_if([&address, capabilities](const Connection &c) {
+                   return c.address == address && c.capabilities == capabilities;
+                 },
+                 connection, stats_.reused);
+}
+
+bool BackendConnectionPool::take_capabilities(const mysql_harness::TCPAddress &address,
+                                              const std::string &capabilities_key,
+                                              Connection &connection) {
+  return take_if([&address, &capabilities_key](const Connection &c) {
+                   return c.address == address && c.capabilities_key == capabilities_key;
+                 },
+                 connection, stats_.reused);
+}
+
+bool BackendConnectionPool::take_session(const mysql_harness::TCPAddress &address,
+                                         const std::string &session_key, Connection &connection) {
+  if (session_key.empty()) return false;
+
+  return take_if([&address, &session_key](const Connection &c) {
+                   return c.address == address && c.session_key == session_key;
+                 },
+                 connection, stats_.shared);
+}
+
+bool BackendConnectionPool::take_if(const std::function<bool(const Connection&)> &matches,
+                                    Connection &connection, uint64_t &counter) {
+  while (true) {
+    std::vector<Connection> to_close;
+    bool found = false;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      take_expired(to_close);
+      for (auto it = idle_.rbegin(); it != idle_.rend(); ++it) {
+        if (matches(*it)) {
+          connection = std::move(*it);
+          idle_.erase(std::next(it).base());
+          found = true;
+          break;
+        }
+      }
+    }
+
+    for (const Connection &c: to_close) {
+      close_connection(c);
+    }
+
+    if (!found) return false;
+
+    if (finish_reset(connection)) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      ++counter;
+      return true;
+    }
+
+    // server closed the connection or reset failed, try the next one
+    sock_ops_->close(connection.socket);
+  }
+}
+
+void BackendConnectionPool::remove_not_allowed(const std::vector<mysql_harness::TCPAddress> &nodes) {
+  std::vector<Connection> to_close;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = std::stable_partition(idle_.begin(), idle_.end(), [&nodes](const Connection &c) {
+      return std::find(nodes.begin(), nodes.end(), c.address) != nodes.end();
+    });
+    to_close.assign(it, idle_.end());
+    idle_.erase(it, idle_.end());
+  }
+
+  for (const Connection &c: to_close) {
+    close_connection(c);
+  }
+}
+
+void BackendConnectionPool::set_greeting(const RoutingProtocolBuffer &greeting) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  greeting_ = greeting;
+}
+
+bool BackendConnectionPool::get_greeting(RoutingProtocolBuffer &greeting) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (greeting_.empty()) return false;
+
+  greeting = greeting_;
+  return true;
+}
+
+BackendConnectionPool::Stats BackendConnectionPool::get_stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  Stats stats = stats_;
+  stats.idle = idle_.size();
+
+  return stats;
+}
+
+void BackendConnectionPool::take_expired(std::vector<Connection> &expired) {
+  const auto deadline = std::chrono::steady_clock::now() - idle_timeout_;
+  while (!idle_.empty() && idle_.front().parked_at <= deadline) {
+    expired.push_back(std::move(idle_.front()));
+    idle_.pop_front();
+  }
+}
+
+bool BackendConnectionPool::finish_reset(Connection &connection) {
+  if (protocol_ == BaseProtocol::Type::kXProtocol) {
+    if (!finish_x_reset(connection)) return false;
+  } else if (connection.reset_pending) {
+    RoutingProtocolBuffer response;
+    if (!classic_handshake::read_packet(sock_ops_, connection.socket, response, kResetTimeout) ||
+        response.size() <= mysql_protocol::Packet::kHeaderSize ||
+        response[mysql_protocol::Packet::kHeaderSize] != 0x00) {
+      log_debug("fd=%d resetting server connection failed", connection.socket);
+      return false;
+    }
+    connection.reset_pending = false;
+  }
+
+  // an idle session has nothing to say, unless the server is closing it
+  struct pollfd fds[] = {
+    { connection.socket, POLLIN, 0 },
+  };
+  return sock_ops_->poll(fds, 1, std::chrono::milliseconds(0)) == 0;
+}
+
+bool BackendConnectionPool::finish_x_reset(Connection &connection) {
+  if (!connection.reset_pending) return true;
+
+  // results of the last client may come first, Session.Reset gets the
+  // last response before the capabilities
+  RoutingProtocolBuffer response;
+  uint8_t reset_response = x_handshake::kError;
+  while (true) {
+    if (!x_handshake::read_response(sock_ops_, connection.socket, response, kResetTimeout)) {
+      log_debug("fd=%d resetting server connection failed", connection.socket);
+      return false;
+    }
+    if (x_handshake::get_type(response) == x_handshake::kCapabilities) break;
+    reset_response = x_handshake::get_type(response);
+  }
+  if (reset_response != x_handshake::kOk) {
+    log_debug("fd=%d server refused to reset the session", connection.socket);
+    return false;
+  }
+
+  connection.reset_pending = false;
+  set_greeting(response);
+  return true;
+}
+
+void BackendConnectionPool::close_connection(const Connection &connection) {
+  // let the server know, it would count the connection as aborted otherwise
+  uint8_t quit[] = {0x01, 0x00, 0x00, 0x00, kComQuit};
+  if (protocol_ == BaseProtocol::Type::kXProtocol) quit[4] = x_handshake::kConnectionClose;
+  sock_ops_->write_all(connection.socket, quit, sizeof(quit));
+  sock_ops_->shutdown(connection.socket);
+  sock_ops_->close(connection.socket);
+}
@@ -0,0 +1,238 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_BACKEND_POOL_INCLUDED
+#define ROUTING_BACKEND_POOL_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mysqlrouter/routing.h"
+#include "prepared_statements.h"
+#include "protocol/base_protocol.h"
+#include "tcp_address.h"
+
+namespace mysql_harness { class SocketOperationsBase; }
+
+/**
+ * @brief BackendConnectionPool keeps idle authenticated classic protocol
+ *        connections to the servers for reuse.
+ *
+ * When a client quits, its server connection is reset with
+ * COM_RESET_CONNECTION and parked. A new client whose capabilities match
+ * the ones the session was established with is authenticated on a parked
+ * connection with COM_CHANGE_USER, saving the TCP connect and the session
+ * setup on the server.
+ *
+ * With connection multiplexing, clients also hand their server connection
+ * back between transactions while the session is clean. Such a session is
+ * kept as it is and only taken again by a client of the same user, default
+ * schema, character set and capabilities.
+ *
+ * X protocol sessions are reset with Mysqlx.Session.Reset when their
+ * client closes them. A new client that negotiates the same capabilities
+ * gets the parked connection and authenticates on it with its own
+ * AuthenticateStart, saving the TCP connect and the capability negotiation.
+ *
+ * Connections are only taken for the server the routing strategy picked
+ * for the client, so reuse keeps the balancing, the per-destination limits
+ * and the quarantine of the strategy. See RouteDestination::SessionReuse.
+ *
+ * Connections idle for longer than the idle timeout are closed, so the
+ * timeout should be below the wait_timeout of the servers.
+ */
+class BackendConnectionPool {
+ public:
+  /** @brief idle server connection */
+  struct Connection {
+    int socket{routing::kInvalidSocket};
+    mysql_harness::TCPAddress address;
+    /** @brief capabilities negotiated for the session */
+    uint32_t capabilities{0};
+    /** @brief scramble of the session, COM_CHANGE_USER authenticates against it */
+    std::vector<uint8_t> scramble;
+    /** @brief true while the response to COM_RESET_CONNECTION is unread */
+    bool reset_pending{false};
+    /** @brief identity of the session if it was released without a reset, empty otherwise */
+    std::string session_key;
+    /** @brief statements prepared in the session by clients of its identity */
+    PreparedStatementCache statements;
+    /** @brief X protocol: CapabilitiesSet messages the session got set up with */
+    std::string capabilities_key;
+    std::chrono::steady_clock::time_point parked_at;
+  };
+
+  /** @brief counters describing the usage of the pool */
+  struct Stats {
+    /** @brief clients served by a parked connection */
+    uint64_t reused{0};
+    /** @brief connections parked */
+    uint64_t parked{0};
+    /** @brief sessions released by clients between transactions */
+    uint64_t released{0};
+    /** @brief released sessions taken again */
+    uint64_t shared{0};
+    /** @brief connections currently idle */
+    size_t idle{0};
+  };
+
+  /** @brief max time waiting for the response to COM_RESET_CONNECTION */
+  static constexpr std::chrono::milliseconds kResetTimeout{1000};
+
+  /**
+   * @param sock_ops socket operations
+   * @param max_idle max number of idle connections, further ones are closed
+   * @param idle_timeout time after which idle connections get closed
+   * @param protocol protocol of the connections
+   */
+  BackendConnectionPool(mysql_harness::SocketOperationsBase *sock_ops, size_t max_idle,
+                        std::chrono::milliseconds idle_timeout,
+                        BaseProtocol::Type protocol = BaseProtocol::Type::kClassicProtocol);
+
+  /**
+   * @brief Closes the idle connections.
+   */
+  ~BackendConnectionPool();
+
+  BackendConnectionPool(const BackendConnectionPool&) = delete;
+  BackendConnectionPool& operator=(const BackendConnectionPool&) = delete;
+
+  /**
+   * @brief Resets the session of the connection and keeps it for reuse.
+   *
+   * The connection must be idle, i.e. the client quit after reading all
+   * of the results. X protocol results still on their way are skipped
+   * when the connection gets taken.
+   */
+  void park(Connection connection);
+
+  /**
+   * @brief Keeps the clean session of a connection for clients of the same identity.
+   *
+   * The connection must be idle and its session must not be in a
+   * transaction or carry state of the client.
+   *
+   * @param connection connection with session_key set
+   */
+  void release(Connection connection);
+
+  /**
+   * @brief Takes most recently released session to the server having the identity.
+   *
+   * @param address server picked for the client
+   * @param session_key identity of the client session
+   * @param connection set to the connection taken
+   *
+   * @return true if a connection was taken, false if caller has to connect
+   */
+  bool take_session(const mysql_harness::TCPAddress &address, const std::string &session_key,
+                    Connection &connection);
+
+  /**
+   * @brief Takes most recently parked connection to the server having the capabilities.
+   *
+   * @param address server picked for the client
+   * @param capabilities capabilities requested by the client
+   * @param connection set to the connection taken
+   *
+   * @return true if a connection was taken, false if caller has to connect
+   */
+  bool take(const mysql_harness::TCPAddress &address, uint32_t capabilities, Connection &connection);
+
+  /**
+   * @brief Takes most recently parked X protocol connection to the server set up with the capabilities.
+   *
+   * The session waits for an AuthenticateStart.
+   *
+   * @param address server picked for the client
+   * @param capabilities_key CapabilitiesSet messages of the client, empty if it sent none
+   * @param connection set to the connection taken
+   *
+   * @return true if a connection was taken, false if caller has to connect
+   */
+  bool take_capabilities(const mysql_harness::TCPAddress &address, const std::string &capabilities_key,
+                         Connection &connection);
+
+  /**
+   * @brief Closes the idle connections to servers not in nodes.
+   */
+  void remove_not_allowed(const std::vector<mysql_harness::TCPAddress> &nodes);
+
+  /**
+   * @brief Stores greeting sent to the clients before a server is chosen.
+   *
+   * For the X protocol it is the response of the servers to CapabilitiesGet.
+   *
+   * @param greeting server greeting with SSL capability cleared
+   */
+  void set_greeting(const RoutingProtocolBuffer &greeting);
+
+  /**
+   * @brief Returns the stored greeting.
+   *
+   * @return false if no server greeting was stored yet
+   */
+  bool get_greeting(RoutingProtocolBuffer &greeting) const;
+
+  Stats get_stats() const;
+
+ private:
+  /** @brief adds connection to the idle ones, closing the oldest ones beyond max_idle_ */
+  void add_idle(Connection connection, uint64_t &counter);
+
+  /** @brief takes most recently added idle connection matching, skipping unusable ones */
+  bool take_if(const std::function<bool(const Connection&)> &matches, Connection &connection,
+               uint64_t &counter);
+
+  /** @brief moves idle connections older than idle timeout to expired, called with mtx_ held */
+  void take_expired(std::vector<Connection> &expired);
+
+  /** @brief reads the response to COM_RESET_CONNECTION, false if connection is unusable */
+  bool finish_reset(Connection &connection);
+
+  /** @brief reads the responses to Session.Reset and CapabilitiesGet, false if connection is unusable */
+  bool finish_x_reset(Connection &connection);
+
+  /** @brief sends COM_QUIT to the server and closes the socket */
+  void close_connection(const Connection &connection);
+
+  mysql_harness::SocketOperationsBase *sock_ops_;
+  const size_t max_idle_;
+  const std::chrono::milliseconds idle_timeout_;
+  const BaseProtocol::Type protocol_;
+
+  mutable std::mutex mtx_;
+  /** @brief idle connections, oldest first */
+  std::deque<Connection> idle_;
+  RoutingProtocolBuffer greeting_;
+  Stats stats_;
+};
+
+#endif /* ROUTING_BACKEND_POOL_INCLUDED */
@@ -0,0 +1,177 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "buffer_arena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#  include <sys/mman.h>
+#endif
+
+const size_t BufferArena::kSlabSize;
+const size_t BufferArena::kMinBufferSize;
+const size_t BufferArena::kSizeClasses;
+
+BufferArena::Stats& BufferArena::Stats::operator+=(const Stats& other) {
+  slabs += other.slabs;
+  explicit_huge_page_slabs += other.explicit_huge_page_slabs;
+  transparent_huge_page_slabs += other.transparent_huge_page_slabs;
+  bytes_reserved += other.bytes_reserved;
+
+  return *this;
+}
+
+BufferArena::BufferArena(HugePages huge_pages) : huge_pages_(huge_pages) {
+}
+
+BufferArena::~BufferArena() {
+  for (uint8_t* slab: slabs_) unmap(slab, kSlabSize);
+}
+
+/*static*/
+bool BufferArena::is_supported(HugePages huge_pages) noexcept {
+#ifdef __linux__
+  (void)huge_pages;
+  return true;
+#else
+  return huge_pages == HugePages::kNone;
+#endif
+}
+
+/*static*/
+size_t BufferArena::get_size_class(size_t size) noexcept {
+  size_t size_class = 0;
+  while (size_class + 1 < kSizeClasses && (kMinBufferSize << size_class) < size) ++size_class;
+  return size_class;
+}
+
+/*static*/
+size_t BufferArena::get_buffer_size(size_t size) noexcept {
+  if (size > kSlabSize) {
+    // mapped on its own, rounded to slabs to allow huge pages
+    return (size + kSlabSize - 1) / kSlabSize * kSlabSize;
+  }
+  return kMinBufferSize << get_size_class(size);
+}
+
+uint8_t* BufferArena::allocate(size_t size) {
+  const size_t buffer_size = get_buffer_size(size);
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (buffer_size > kSlabSize) return map(buffer_size, false);
+
+  std::vector<uint8_t*>& free_buffers = free_buffers_[get_size_class(size)];
+  if (free_buffers.empty()) {
+    uint8_t* slab = map(kSlabSize, true);
+    free_buffers.reserve(kSlabSize / buffer_size);
+    // handed out from the start of the slab
+    for (size_t offset = kSlabSize; offset > 0; offset -= buffer_size) {
+      free_buffers.push_back(slab + offset - buffer_size);
+    }
+  }
+
+  uint8_t* buffer = free_buffers.back();
+  free_buffers.pop_back();
+  return buffer;
+}
+
+void BufferArena::deallocate(uint8_t* buffer, size_t size) noexcept {
+  const size_t buffer_size = get_buffer_size(size);
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (buffer_size > kSlabSize) {
+    unmap(buffer, buffer_size);
+    stats_.bytes_reserved -= buffer_size;
+    return;
+  }
+
+  free_buffers_[get_size_class(size)].push_back(buffer);
+}
+
+uint8_t* BufferArena::map(size_t size, bool is_slab) {
+#ifdef __linux__
+  void* memory = MAP_FAILED;
+#  ifdef MAP_HUGETLB
+  if (huge_pages_ == HugePages::kExplicit) {
+    // fails if no huge pages are reserved or their size doesn't fit
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED && is_slab) ++stats_.explicit_huge_page_slabs;
+  }
+#  endif
+
+  bool advised = false;
+  if (memory == MAP_FAILED) {
+    // transparent huge pages need memory aligned to their size
+    const size_t mapped_size = size + kSlabSize;
+    void* mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) throw std::bad_alloc();
+
+    uint8_t* begin = static_cast<uint8_t*>(mapped);
+    uint8_t* aligned = reinterpret_cast<uint8_t*>(
+        (reinterpret_cast<uintptr_t>(begin) + kSlabSize - 1) / kSlabSize * kSlabSize);
+    if (aligned > begin) munmap(begin, static_cast<size_t>(aligned - begin));
+    uint8_t* end = begin + mapped_size;
+    if (end > aligned + size) munmap(aligned + size, static_cast<size_t>(end - (aligned + size)));
+    memory = aligned;
+
+#  ifdef MADV_HUGEPAGE
+    if (huge_pages_ != HugePages::kNone) {
+      advised = madvise(memory, size, MADV_HUGEPAGE) == 0;
+    }
+#  endif
+  }
+  if (advised && is_slab) ++stats_.transparent_huge_page_slabs;
+#else
+  void* memory = std::malloc(size);
+  if (memory == nullptr) throw std::bad_alloc();
+#endif
+
+  uint8_t* result = static_cast<uint8_t*>(memory);
+  if (is_slab) {
+    slabs_.push_back(result);
+    ++stats_.slabs;
+  }
+  stats_.bytes_reserved += size;
+  return result;
+}
+
+/*static*/
+void BufferArena::unmap(uint8_t* memory, size_t size) noexcept {
+#ifdef __linux__
+  munmap(memory, size);
+#else
+  (void)size;
+  std::free(memory);
+#endif
+}
+
+BufferArena::Stats BufferArena::get_stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
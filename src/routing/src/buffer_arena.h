@@ -0,0 +1,140 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_BUFFER_ARENA_INCLUDED
+#define ROUTING_BUFFER_ARENA_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief BufferArena hands out buffers carved from slabs of kSlabSize bytes,
+ *        optionally backed by huge pages.
+ *
+ * Buffers of thousands of connections spread over as many pages otherwise,
+ * forwarding misses the TLB all the time. A slab holds buffers of one size
+ * class, the sizes are rounded up to the next power of two from
+ * kMinBufferSize. Buffers larger than a slab get a mapping of their own.
+ *
+ * Explicit huge pages (MAP_HUGETLB) need to be reserved with
+ * vm.nr_hugepages, without them the slabs fall back to transparent huge
+ * pages (madvise(MADV_HUGEPAGE)), which fall back to normal pages if the
+ * kernel doesn't provide them. Only available on Linux.
+ *
+ * Slabs stay reserved until the arena is destroyed, returned buffers are
+ * kept for reuse.
+ */
+class BufferArena {
+public:
+  /** @brief size of the slabs, the size of a huge page on x86_64 */
+  static const size_t kSlabSize = 2 * 1024 * 1024;
+  /** @brief smallest size class */
+  static const size_t kMinBufferSize = 4 * 1024;
+
+  /** @brief pages backing the slabs */
+  enum class HugePages {
+    /** @brief normal pages */
+    kNone,
+    /** @brief transparent huge pages, normal pages if not available */
+    kTransparent,
+    /** @brief huge pages reserved by vm.nr_hugepages, transparent ones if not available */
+    kExplicit,
+  };
+
+  /** @brief counters describing the reserved memory */
+  struct Stats {
+    /** @brief slabs reserved */
+    size_t slabs{0};
+    /** @brief slabs backed by explicit huge pages */
+    size_t explicit_huge_page_slabs{0};
+    /** @brief slabs advised to be backed by transparent huge pages */
+    size_t transparent_huge_page_slabs{0};
+    /** @brief bytes reserved, including the buffers larger than a slab */
+    size_t bytes_reserved{0};
+
+    Stats& operator+=(const Stats& other);
+  };
+
+  explicit BufferArena(HugePages huge_pages);
+
+  /** @brief unmaps the slabs, all buffers must have been returned */
+  ~BufferArena();
+
+  BufferArena(const BufferArena&) = delete;
+  BufferArena& operator=(const BufferArena&) = delete;
+
+  /**
+   * @brief Returns a buffer of at least size bytes.
+   *
+   * @throw std::bad_alloc if no memory could be reserved
+   */
+  uint8_t* allocate(size_t size);
+
+  /**
+   * @brief Returns a buffer to the arena.
+   *
+   * @param buffer buffer returned by allocate()
+   * @param size size passed to allocate()
+   */
+  void deallocate(uint8_t* buffer, size_t size) noexcept;
+
+  HugePages get_huge_pages() const noexcept {
+    return huge_pages_;
+  }
+
+  Stats get_stats() const;
+
+  /** @brief Returns the size of the buffers allocate() returns for size bytes */
+  static size_t get_buffer_size(size_t size) noexcept;
+
+  /**
+   * @brief Returns true if the arena can use huge_pages on this platform.
+   */
+  static bool is_supported(HugePages huge_pages) noexcept;
+
+private:
+  /** @brief number of size classes, up to kSlabSize */
+  static const size_t kSizeClasses = 10;
+
+  /** @brief returns the size class of a buffer of size bytes, at most kSlabSize */
+  static size_t get_size_class(size_t size) noexcept;
+
+  /** @brief reserves size bytes of memory, counted in stats_ */
+  uint8_t* map(size_t size, bool is_slab);
+
+  static void unmap(uint8_t* memory, size_t size) noexcept;
+
+  const HugePages huge_pages_;
+
+  mutable std::mutex mtx_;
+  /** @brief unused buffers per size class */
+  std::vector<uint8_t*> free_buffers_[kSizeClasses];
+  /** @brief slabs reserved */
+  std::vector<uint8_t*> slabs_;
+  Stats stats_;
+};
+
+#endif /* ROUTING_BUFFER_ARENA_INCLUDED */
@@ -0,0 +1,177 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "buffer_pool.h"
+
+#include <algorithm>
+
+#include "mysql/harness/memory_accounting.h"
+
+using mysql_harness::MemoryAccounting;
+using mysql_harness::MemoryTag;
+
+RoutingBufferPool::Stats& RoutingBufferPool::Stats::operator+=(const Stats& other) {
+  hits += other.hits;
+  misses += other.misses;
+  evictions += other.evictions;
+  in_use += other.in_use;
+  high_water += other.high_water;
+  idle += other.idle;
+
+  return *this;
+}
+
+RoutingBufferPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), buffer_(other.buffer_) {
+  other.buffer_ = nullptr;
+}
+
+RoutingBufferPool::Lease& RoutingBufferPool::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    release();
+    pool_ = other.pool_;
+    buffer_ = other.buffer_;
+    other.buffer_ = nullptr;
+  }
+  return *this;
+}
+
+RoutingBufferPool::Lease::~Lease() {
+  release();
+}
+
+void RoutingBufferPool::Lease::release() noexcept {
+  if (buffer_) {
+    pool_->release(buffer_);
+    buffer_ = nullptr;
+  }
+}
+
+RoutingBufferPool::RoutingBufferPool(size_t buffer_size, size_t max_idle_buffers)
+    : buffer_size_(buffer_size), max_idle_buffers_(max_idle_buffers) {
+}
+
+RoutingBufferPool::~RoutingBufferPool() {
+  for (uint8_t* buffer: idle_buffers_) free_buffer(buffer);
+}
+
+RoutingBufferPool::Lease RoutingBufferPool::acquire() {
+  uint8_t* buffer = nullptr;
+  std::shared_ptr<BufferArena> arena;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!idle_buffers_.empty()) {
+      buffer = idle_buffers_.back();
+      idle_buffers_.pop_back();
+      ++stats_.hits;
+    } else {
+      ++stats_.misses;
+      arena = arena_;
+    }
+    stats_.high_water = std::max(stats_.high_water, ++stats_.in_use);
+  }
+
+  // allocate outside of the lock
+  if (buffer == nullptr) {
+    try {
+      buffer = arena ? arena->allocate(buffer_size_) : new uint8_t[buffer_size_];
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      --stats_.in_use;
+      throw;
+    }
+    MemoryAccounting::allocated(MemoryTag::kRoutingBuffers, buffer_size_);
+  }
+
+  return Lease(this, buffer);
+}
+
+void RoutingBufferPool::release(uint8_t* buffer) noexcept {
+  std::lock_guard<std::mutex> lock(mtx_);
+  --stats_.in_use;
+  if (idle_buffers_.size() < max_idle_buffers_) {
+    idle_buffers_.push_back(buffer);
+  } else {
+    free_buffer(buffer);
+    ++stats_.evictions;
+  }
+}
+
+void RoutingBufferPool::free_buffer(uint8_t* buffer) noexcept {
+  if (arena_) {
+    arena_->deallocate(buffer, buffer_size_);
+  } else {
+    delete[] buffer;
+  }
+  MemoryAccounting::freed(MemoryTag::kRoutingBuffers, buffer_size_);
+}
+
+void RoutingBufferPool::set_max_idle_buffers(size_t max_idle_buffers) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  max_idle_buffers_ = max_idle_buffers;
+  while (idle_buffers_.size() > max_idle_buffers_) {
+    free_buffer(idle_buffers_.back());
+    idle_buffers_.pop_back();
+    ++stats_.evictions;
+  }
+}
+
+void RoutingBufferPool::set_arena(std::shared_ptr<BufferArena> arena) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (uint8_t* buffer: idle_buffers_) free_buffer(buffer);
+  idle_buffers_.clear();
+  arena_ = std::move(arena);
+}
+
+RoutingBufferPool::Stats RoutingBufferPool::get_stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  Stats stats = stats_;
+  stats.idle = idle_buffers_.size();
+
+  return stats;
+}
+
+AdaptiveBufferSize::AdaptiveBufferSize(size_t min_size, size_t max_size)
+    : min_size_(min_size), max_size_(std::max(min_size, max_size)), size_(min_size) {
+}
+
+void AdaptiveBufferSize::update(size_t bytes_read) noexcept {
+  if (bytes_read >= size_) {
+    small_reads_ = 0;
+    if (++full_reads_ >= kGrowAfterReads && size_ < max_size_) {
+      size_ = std::min(size_ * 2, max_size_);
+      full_reads_ = 0;
+    }
+  } else if (bytes_read < size_ / 4) {
+    full_reads_ = 0;
+    if (++small_reads_ >= kShrinkAfterReads && size_ > min_size_) {
+      size_ = std::max(size_ / 2, min_size_);
+      small_reads_ = 0;
+    }
+  } else {
+    full_reads_ = 0;
+    small_reads_ = 0;
+  }
+}
@@ -0,0 +1,197 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_BUFFER_POOL_INCLUDED
+#define ROUTING_BUFFER_POOL_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer_arena.h"
+#include "protocol/base_protocol.h"
+
+/**
+ * @brief RoutingBufferPool lends buffers used to copy packets between
+ *        sockets.
+ *
+ * Connections borrow a buffer only while they forward data, so memory
+ * used for buffers scales with the number of connections being active at
+ * the same time rather than with the number of open connections. Up to
+ * max_idle_buffers returned buffers are kept for reuse, further ones are
+ * freed.
+ *
+ * The buffers are accounted to MemoryTag::kRoutingBuffers.
+ */
+class RoutingBufferPool {
+public:
+  /** @brief counters describing the usage of the pool */
+  struct Stats {
+    /** @brief buffers lent from the idle buffers */
+    uint64_t hits{0};
+    /** @brief buffers that had to be allocated */
+    uint64_t misses{0};
+    /** @brief returned buffers freed as max_idle_buffers were kept already */
+    uint64_t evictions{0};
+    /** @brief buffers currently lent */
+    size_t in_use{0};
+    /** @brief max number of buffers lent at the same time */
+    size_t high_water{0};
+    /** @brief buffers kept for reuse */
+    size_t idle{0};
+
+    Stats& operator+=(const Stats& other);
+  };
+
+  /**
+   * @brief Buffer lent from the pool, returned to it on destruction.
+   */
+  class Lease {
+  public:
+    /** @brief creates lease holding no buffer */
+    Lease() = default;
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+
+    explicit operator bool() const noexcept {
+      return buffer_ != nullptr;
+    }
+
+    RoutingBufferRef operator*() const noexcept {
+      return RoutingBufferRef(buffer_, pool_->buffer_size_);
+    }
+
+  private:
+    friend class RoutingBufferPool;
+
+    Lease(RoutingBufferPool* pool, uint8_t* buffer) noexcept
+        : pool_(pool), buffer_(buffer) {}
+
+    void release() noexcept;
+
+    RoutingBufferPool* pool_{nullptr};
+    uint8_t* buffer_{nullptr};
+  };
+
+  /**
+   * @param buffer_size size of the lent buffers
+   * @param max_idle_buffers max number of buffers kept for reuse
+   */
+  RoutingBufferPool(size_t buffer_size, size_t max_idle_buffers);
+
+  /** @brief frees the idle buffers, all lent ones must have been returned */
+  ~RoutingBufferPool();
+
+  /**
+   * @brief Lends a buffer of buffer_size bytes.
+   */
+  Lease acquire();
+
+  /**
+   * @brief Sets max number of buffers kept for reuse, frees the excess ones.
+   */
+  void set_max_idle_buffers(size_t max_idle_buffers);
+
+  /**
+   * @brief Takes the buffers from arena instead of the heap.
+   *
+   * Has to be called while no buffers are lent, frees the idle ones.
+   *
+   * @param arena arena to take the buffers from, nullptr for the heap
+   */
+  void set_arena(std::shared_ptr<BufferArena> arena);
+
+  size_t get_buffer_size() const noexcept {
+    return buffer_size_;
+  }
+
+  Stats get_stats() const;
+
+private:
+  void release(uint8_t* buffer) noexcept;
+
+  /** @brief frees a buffer not kept for reuse, called with mtx_ held */
+  void free_buffer(uint8_t* buffer) noexcept;
+
+  const size_t buffer_size_;
+  size_t max_idle_buffers_;
+
+  mutable std::mutex mtx_;
+  std::vector<uint8_t*> idle_buffers_;
+  /** @brief arena the buffers are taken from, nullptr for the heap */
+  std::shared_ptr<BufferArena> arena_;
+  Stats stats_;
+};
+
+/**
+ * @brief AdaptiveBufferSize picks the size of a connection's read buffer
+ *        from how much of it recent reads filled.
+ *
+ * The size doubles after kGrowAfterReads consecutive reads filling the
+ * whole buffer and halves after kShrinkAfterReads consecutive reads using
+ * less than a quarter of it, staying between min_size and max_size.
+ */
+class AdaptiveBufferSize {
+public:
+  /** @brief consecutive full reads doubling the size */
+  static const unsigned kGrowAfterReads = 4;
+  /** @brief consecutive reads below a quarter of the size halving it */
+  static const unsigned kShrinkAfterReads = 64;
+
+  /**
+   * @param min_size initial and smallest size
+   * @param max_size largest size, adapting is disabled if not above min_size
+   */
+  AdaptiveBufferSize(size_t min_size, size_t max_size);
+
+  /** @brief Returns the size the next read buffer should have */
+  size_t get() const noexcept {
+    return size_;
+  }
+
+  /**
+   * @brief Accounts a read into a buffer of get() bytes.
+   *
+   * @param bytes_read number of bytes the read returned
+   */
+  void update(size_t bytes_read) noexcept;
+
+private:
+  const size_t min_size_;
+  const size_t max_size_;
+  size_t size_;
+
+  /** @brief consecutive reads filling the buffer */
+  unsigned full_reads_{0};
+  /** @brief consecutive reads using less than a quarter of the buffer */
+  unsigned small_reads_{0};
+};
+
+#endif /* ROUTING_BUFFER_POOL_INCLUDED */
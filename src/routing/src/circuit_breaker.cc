@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "circuit_breaker.h"
+
+void CircuitBreaker::configure(unsigned int failures, std::chrono::milliseconds open_interval,
+                               unsigned int half_open_connections) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  open_interval_ = open_interval;
+  half_open_connections_ = half_open_connections > 0 ? half_open_connections : 1;
+  failures_threshold_.store(failures, std::memory_order_relaxed);
+}
+
+bool CircuitBreaker::allows(std::chrono::steady_clock::time_point now) const {
+  if (closed_.load(std::memory_order_relaxed)) return true;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  switch (state_) {
+  case State::kClosed:
+    return true;
+  case State::kOpen:
+    // the first connection after the interval makes it half-open
+    return now - opened_at_ >= open_interval_;
+  case State::kHalfOpen:
+    return probes_ + probes_succeeded_ < half_open_connections_;
+  }
+
+  return true;
+}
+
+void CircuitBreaker::admitted(std::chrono::steady_clock::time_point now) {
+  if (closed_.load(std::memory_order_relaxed)) return;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (state_ == State::kOpen && now - opened_at_ >= open_interval_) {
+    state_ = State::kHalfOpen;
+    probes_ = 0;
+    probes_succeeded_ = 0;
+  }
+  if (state_ == State::kHalfOpen) ++probes_;
+}
+
+bool CircuitBreaker::succeeded() {
+  if (closed_.load(std::memory_order_relaxed)) {
+    // the common case, don't write the shared counter for nothing
+    if (consecutive_failures_.load(std::memory_order_relaxed) != 0) {
+      consecutive_failures_.store(0, std::memory_order_relaxed);
+    }
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  // connections that got routed before the circuit opened don't count
+  if (state_ != State::kHalfOpen) return false;
+
+  if (probes_ > 0) --probes_;
+  if (++probes_succeeded_ < half_open_connections_) return false;
+
+  state_ = State::kClosed;
+  consecutive_failures_.store(0, std::memory_order_relaxed);
+  closed_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+bool CircuitBreaker::failed(std::chrono::steady_clock::time_point now) {
+  const unsigned int threshold = failures_threshold_.load(std::memory_order_relaxed);
+  if (threshold == 0) return false;
+
+  if (closed_.load(std::memory_order_relaxed) &&
+      consecutive_failures_.fetch_add(1, std::memory_order_relaxed) + 1 < threshold) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  // opened already by a concurrent failure, its interval stands
+  if (state_ == State::kOpen) return false;
+
+  state_ = State::kOpen;
+  opened_at_ = now;
+  closed_.store(false, std::memory_order_relaxed);
+  return true;
+}
+
+void CircuitBreaker::abandoned() {
+  if (closed_.load(std::memory_order_relaxed)) return;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (state_ == State::kHalfOpen && probes_ > 0) --probes_;
+}
+
+CircuitBreaker::State CircuitBreaker::get_state() const {
+  if (closed_.load(std::memory_order_relaxed)) return State::kClosed;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  return state_;
+}
+
+const char *CircuitBreaker::to_string(State state) {
+  switch (state) {
+  case State::kClosed:
+    return "closed";
+  case State::kOpen:
+    return "open";
+  case State::kHalfOpen:
+    return "half-open";
+  }
+
+  return "unknown";
+}
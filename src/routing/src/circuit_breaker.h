@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_CIRCUIT_BREAKER_INCLUDED
+#define ROUTING_CIRCUIT_BREAKER_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+/**
+ * @brief Keeps new connections off a server that fails its handshakes.
+ *
+ * A server may accept TCP connections while it fails or never finishes the
+ * handshakes, the quarantine's connect probes do not see that. After that
+ * many failed connects or handshakes in a row the circuit opens: the server
+ * gets no new connections until the open interval passed. Then the circuit
+ * is half-open, it lets a few client connections through and closes again
+ * once all of them finished their handshake. A failure opens it again.
+ *
+ * The half-open connections are counted once they got routed, concurrent
+ * picks may let a few more through.
+ */
+class CircuitBreaker {
+public:
+  enum class State { kClosed, kOpen, kHalfOpen };
+
+  /**
+   * @param failures failures in a row that open the circuit, 0 disables it
+   * @param open_interval time the circuit stays open
+   * @param half_open_connections connections let through by the half-open circuit
+   */
+  void configure(unsigned int failures, std::chrono::milliseconds open_interval,
+                 unsigned int half_open_connections);
+
+  /** @brief tells if a new connection may go to the server */
+  bool allows(std::chrono::steady_clock::time_point now) const;
+
+  /** @brief a connection got routed to the server */
+  void admitted(std::chrono::steady_clock::time_point now);
+
+  /**
+   * @brief the server finished a handshake.
+   *
+   * @return true if that closed the circuit
+   */
+  bool succeeded();
+
+  /**
+   * @brief the server failed a connect or handshake, or didn't answer in time.
+   *
+   * @return true if that opened the circuit
+   */
+  bool failed(std::chrono::steady_clock::time_point now);
+
+  /** @brief a connection got closed before the server's part of the handshake was done */
+  void abandoned();
+
+  State get_state() const;
+
+  static const char *to_string(State state);
+
+private:
+  std::atomic<unsigned int> failures_threshold_{0};
+  std::chrono::milliseconds open_interval_{0};
+  unsigned int half_open_connections_{1};
+
+  /** @brief failures since the last success, counted without the lock while closed */
+  std::atomic<unsigned int> consecutive_failures_{0};
+  /** @brief the lock is only taken while the circuit isn't closed */
+  std::atomic<bool> closed_{true};
+
+  mutable std::mutex mtx_;
+  State state_{State::kClosed};
+  std::chrono::steady_clock::time_point opened_at_;
+  /** @brief connections let through by the half-open circuit, not judged yet */
+  unsigned int probes_{0};
+  unsigned int probes_succeeded_{0};
+};
+
+#endif // ROUTING_CIRCUIT_BREAKER_INCLUDED
@@ -0,0 +1,180 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "client_limits.h"
+
+#include <algorithm>
+
+#include "mysql/harness/networking/socket_endpoint.h"
+
+const size_t ClientLimits::kDefaultCapacity;
+const size_t ClientLimits::kProbeWindow;
+const size_t ClientLimits::kShards;
+const uint64_t ClientLimits::kFreeKey;
+
+ClientLimits::ClientLimits(const Settings& settings, size_t capacity)
+    : settings_(settings),
+      slots_per_shard_(std::max(kProbeWindow, (capacity + kShards - 1) / kShards)),
+      shards_(new Shard[kShards]) {
+  for (size_t ndx = 0; ndx < kShards; ++ndx) {
+    shards_[ndx].slots.reset(new Slot[slots_per_shard_]);
+  }
+}
+
+bool ClientLimits::get_key(const sockaddr_storage& client_addr, Key& key) const noexcept {
+  const mysql_harness::SocketEndpoint endpoint(client_addr);
+  const ClientIpArray& bytes = endpoint.address_bytes();
+
+  uint8_t family;
+  unsigned int prefix;
+  key.address = ClientIpArray{{0}};
+  if (endpoint.is_ipv4()) {
+    family = 4;
+    prefix = settings_.ipv4_prefix;
+    std::copy(bytes.begin(), bytes.begin() + 4, key.address.begin());
+  } else if (endpoint.is_ipv6()) {
+    // clients of dual-stack listeners connecting with IPv4 appear as
+    // ::ffff:a.b.c.d, they get the IPv4 limits
+    const bool v4_mapped = std::all_of(bytes.begin(), bytes.begin() + 10, [](uint8_t b) { return b == 0; }) &&
+                           bytes[10] == 0xff && bytes[11] == 0xff;
+    if (v4_mapped) {
+      family = 4;
+      prefix = settings_.ipv4_prefix;
+      std::copy(bytes.begin() + 12, bytes.end(), key.address.begin());
+    } else {
+      family = 6;
+      prefix = settings_.ipv6_prefix;
+      key.address = bytes;
+    }
+  } else {
+    return false;
+  }
+
+  // keep the leading prefix bits
+  for (size_t ndx = 0; ndx < key.address.size(); ++ndx) {
+    const unsigned int bit = static_cast<unsigned int>(ndx) * 8;
+    if (bit >= prefix) {
+      key.address[ndx] = 0;
+    } else if (prefix - bit < 8) {
+      key.address[ndx] = static_cast<uint8_t>(key.address[ndx] & (0xff00 >> (prefix - bit)));
+    }
+  }
+
+  // FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+  h ^= family;
+  h *= 1099511628211ULL;
+  for (uint8_t byte : key.address) {
+    h ^= byte;
+    h *= 1099511628211ULL;
+  }
+  key.hash = h != kFreeKey ? h : h + 1;
+
+  return true;
+}
+
+ClientLimits::Slot* ClientLimits::find(Shard& shard, const Key& key) noexcept {
+  const size_t home = get_home_slot(key.hash);
+
+  for (size_t probe = 0; probe < kProbeWindow; ++probe) {
+    Slot& slot = shard.slots[(home + probe) % slots_per_shard_];
+
+    // slots are never freed, the client isn't behind a free slot
+    if (slot.key == kFreeKey) return nullptr;
+    if (slot.key == key.hash && slot.address == key.address) return &slot;
+  }
+
+  return nullptr;
+}
+
+void ClientLimits::refill(Slot& slot, clock_type::time_point now) const noexcept {
+  if (settings_.rate > 0 && now > slot.refilled_at) {
+    const double elapsed = std::chrono::duration<double>(now - slot.refilled_at).count();
+    slot.tokens = std::min(static_cast<double>(settings_.burst), slot.tokens + elapsed * settings_.rate);
+  }
+  // also tells how long ago the client connected the last time
+  slot.refilled_at = std::max(slot.refilled_at, now);
+}
+
+ClientLimits::Result ClientLimits::admit(const sockaddr_storage& client_addr,
+                                         clock_type::time_point now) {
+  Key key;
+  if (!get_key(client_addr, key)) return Result::kAdmitted;
+
+  Shard& shard = get_shard(key.hash);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  Slot* slot = find(shard, key);
+  if (slot == nullptr) {
+    const size_t home = get_home_slot(key.hash);
+    bool is_free = false;
+    for (size_t probe = 0; probe < kProbeWindow && !is_free; ++probe) {
+      Slot& candidate = shard.slots[(home + probe) % slots_per_shard_];
+
+      if (candidate.key == kFreeKey) {
+        slot = &candidate;
+        is_free = true;
+      } else if (candidate.active == 0 &&
+                 (slot == nullptr || candidate.refilled_at < slot->refilled_at)) {
+        slot = &candidate;
+      }
+    }
+
+    // all slots hold clients with open connections
+    if (slot == nullptr) return Result::kAdmitted;
+    if (is_free) ++size_;
+
+    slot->key = key.hash;
+    slot->address = key.address;
+    slot->active = 0;
+    slot->tokens = settings_.burst;
+    slot->refilled_at = now;
+  } else {
+    refill(*slot, now);
+  }
+
+  if (settings_.max_connections > 0 && slot->active >= settings_.max_connections) {
+    return Result::kTooManyConnections;
+  }
+  if (settings_.rate > 0) {
+    if (slot->tokens < 1) return Result::kRateExceeded;
+    slot->tokens -= 1;
+  }
+  ++slot->active;
+
+  return Result::kAdmitted;
+}
+
+void ClientLimits::release(const sockaddr_storage& client_addr) {
+  Key key;
+  if (!get_key(client_addr, key)) return;
+
+  Shard& shard = get_shard(key.hash);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  // untracked clients weren't counted
+  Slot* slot = find(shard, key);
+  if (slot != nullptr && slot->active > 0) --slot->active;
+}
@@ -0,0 +1,170 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_CLIENT_LIMITS_INCLUDED
+#define ROUTING_CLIENT_LIMITS_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "utils.h"
+
+/**
+ * @brief ClientLimits limits the connections of each client host or subnet.
+ *
+ * A client may open `rate` connections per second with bursts of up to
+ * `burst` connections (a token bucket), and may have up to
+ * `max_connections` connections open. Clients are grouped by the leading
+ * `ipv4_prefix` or `ipv6_prefix` bits of their address, so a whole subnet
+ * can share one limit. Clients of the named socket aren't limited.
+ *
+ * Clients are kept in a fixed number of slots split into shards, like in
+ * ConnectErrorCounters. Each shard has its own lock and slots, acceptors
+ * only contend on clients of the same shard. Once the probe window of a
+ * new client is full, the slot of the client without open connections
+ * seen last longest ago is recycled. If all slots of the window hold
+ * clients with open connections, the new client isn't limited.
+ */
+class ClientLimits {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  struct Settings {
+    /** @brief connections per second a client may open, 0 for no limit */
+    unsigned int rate{0};
+    /** @brief connections a client may open at once, at least 1 */
+    unsigned int burst{1};
+    /** @brief connections a client may have open, 0 for no limit */
+    unsigned int max_connections{0};
+    /** @brief leading bits of IPv4 addresses that make up a client */
+    unsigned int ipv4_prefix{32};
+    /** @brief leading bits of IPv6 addresses that make up a client */
+    unsigned int ipv6_prefix{128};
+  };
+
+  enum class Result {
+    kAdmitted,
+    /** @brief client opened connections faster than the rate */
+    kRateExceeded,
+    /** @brief client has max_connections open */
+    kTooManyConnections,
+  };
+
+  /** @brief default number of clients tracked */
+  static const size_t kDefaultCapacity = 16384;
+
+  /**
+   * @param settings limits of each client
+   * @param capacity max number of clients tracked, rounded up to a multiple
+   *        of the shards' probe window
+   */
+  explicit ClientLimits(const Settings& settings, size_t capacity = kDefaultCapacity);
+
+  /**
+   * @brief Checks the limits of a client that connected.
+   *
+   * An admitted client needs to be released() once its connection closes.
+   *
+   * @param client_addr address of the client
+   * @param now time of the connect
+   */
+  Result admit(const sockaddr_storage& client_addr,
+               clock_type::time_point now = clock_type::now());
+
+  /** @brief Counts a connection of an admitted client as closed */
+  void release(const sockaddr_storage& client_addr);
+
+  /** @brief Returns number of clients tracked */
+  size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /** @brief number of slots probed for a client */
+  static const size_t kProbeWindow = 16;
+  /** @brief number of shards, a power of 2 */
+  static const size_t kShards = 16;
+
+  /** @brief key of a slot not used yet */
+  static const uint64_t kFreeKey = 0;
+
+  struct Key {
+    uint64_t hash;
+    ClientIpArray address;
+  };
+
+  struct Slot {
+    /** @brief hash of the client or kFreeKey */
+    uint64_t key{kFreeKey};
+    /** @brief address of the client, masked to the prefix */
+    ClientIpArray address{{0}};
+    uint32_t active{0};
+    /** @brief connections the client may still open */
+    double tokens{0};
+    /** @brief when the bucket got refilled the last time */
+    clock_type::time_point refilled_at;
+  };
+
+  struct Shard {
+    std::mutex mtx;
+    std::unique_ptr<Slot[]> slots;
+
+    // keeps the lock of the next shard off our cache line, acceptors
+    // locking different shards don't slow each other down
+    char padding[64];
+  };
+
+  /**
+   * @brief Returns the key of the client.
+   *
+   * @return false for clients that aren't limited
+   */
+  bool get_key(const sockaddr_storage& client_addr, Key& key) const noexcept;
+
+  /** @brief Returns the slot of the client, nullptr if it isn't tracked */
+  Slot* find(Shard& shard, const Key& key) noexcept;
+
+  void refill(Slot& slot, clock_type::time_point now) const noexcept;
+
+  Shard& get_shard(uint64_t hash) noexcept {
+    return shards_[hash & (kShards - 1)];
+  }
+
+  /** @brief first slot of the client's probe window in its shard */
+  size_t get_home_slot(uint64_t hash) const noexcept {
+    return static_cast<size_t>((hash >> 4) % slots_per_shard_);
+  }
+
+  const Settings settings_;
+  size_t slots_per_shard_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<size_t> size_{0};
+};
+
+#endif  // ROUTING_CLIENT_LIMITS_INCLUDED
@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "client_networks.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#else
+#include <ws2tcpip.h>
+#endif
+
+#include "mysql/harness/networking/socket_endpoint.h"
+
+/** @brief keeps the leading prefix bits of the address */
+static void mask_address(ClientIpArray &address, unsigned int prefix) noexcept {
+  for (size_t ndx = 0; ndx < address.size(); ++ndx) {
+    const unsigned int bit = static_cast<unsigned int>(ndx) * 8;
+    if (bit >= prefix) {
+      address[ndx] = 0;
+    } else if (prefix - bit < 8) {
+      address[ndx] = static_cast<uint8_t>(address[ndx] & (0xff00 >> (prefix - bit)));
+    }
+  }
+}
+
+ClientNetworks::ClientNetworks(const std::vector<std::string> &networks) {
+  for (const auto &network : networks) {
+    const auto slash = network.find('/');
+    const std::string address = network.substr(0, slash);
+
+    Network entry;
+    entry.address = ClientIpArray{{0}};
+    if (inet_pton(AF_INET, address.c_str(), entry.address.data()) == 1) {
+      entry.ipv4 = true;
+    } else if (inet_pton(AF_INET6, address.c_str(), entry.address.data()) == 1) {
+      entry.ipv4 = false;
+    } else {
+      throw std::invalid_argument("invalid address '" + network + "'");
+    }
+
+    const unsigned long max_prefix = entry.ipv4 ? 32 : 128;
+    unsigned long prefix = max_prefix;
+    if (slash != std::string::npos) {
+      const std::string bits = network.substr(slash + 1);
+      char *rest = nullptr;
+      prefix = std::strtoul(bits.c_str(), &rest, 10);
+      if (bits.empty() || bits[0] == '-' || *rest != '\0' || prefix > max_prefix) {
+        throw std::invalid_argument("invalid prefix length of '" + network + "'");
+      }
+    }
+    entry.prefix = static_cast<unsigned int>(prefix);
+    mask_address(entry.address, entry.prefix);
+
+    networks_.push_back(entry);
+  }
+}
+
+bool ClientNetworks::matches(const sockaddr_storage &client_addr) const noexcept {
+  const mysql_harness::SocketEndpoint endpoint(client_addr);
+  if (!endpoint.is_ipv4() && !endpoint.is_ipv6()) return false;
+
+  ClientIpArray address = endpoint.address_bytes();
+  bool ipv4 = endpoint.is_ipv4();
+  // clients of dual-stack listeners connecting with IPv4 appear as ::ffff:a.b.c.d
+  if (!ipv4 && std::all_of(address.begin(), address.begin() + 10, [](uint8_t b) { return b == 0; }) &&
+      address[10] == 0xff && address[11] == 0xff) {
+    ipv4 = true;
+    std::copy(address.begin() + 12, address.end(), address.begin());
+    std::fill(address.begin() + 4, address.end(), 0);
+  }
+
+  for (const auto &network : networks_) {
+    if (network.ipv4 != ipv4) continue;
+
+    ClientIpArray masked = address;
+    mask_address(masked, network.prefix);
+    if (masked == network.address) return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,64 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_CLIENT_NETWORKS_INCLUDED
+#define ROUTING_CLIENT_NETWORKS_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+/**
+ * @brief ClientNetworks tells if a client address is in one of a list of
+ *        hosts and networks, like the ones of an option.
+ */
+class ClientNetworks {
+ public:
+  /**
+   * @param networks addresses of hosts or networks like '10.0.0.0/8' or
+   *        'fd00::/8', IPv4 networks also match clients connecting to a
+   *        dual-stack listener with IPv4
+   *
+   * @throws std::invalid_argument if a network is invalid
+   */
+  explicit ClientNetworks(const std::vector<std::string> &networks);
+
+  /** @brief true if the client is in one of the networks */
+  bool matches(const sockaddr_storage &client_addr) const noexcept;
+
+  bool empty() const noexcept { return networks_.empty(); }
+
+ private:
+  struct Network {
+    bool ipv4;
+    /** @brief the leading prefix bits of the address, the others are 0 */
+    ClientIpArray address;
+    unsigned int prefix;
+  };
+
+  std::vector<Network> networks_;
+};
+
+#endif  // ROUTING_CLIENT_NETWORKS_INCLUDED
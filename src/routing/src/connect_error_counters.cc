@@ -0,0 +1,213 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "connect_error_counters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <random>
+
+const std::chrono::seconds ConnectErrorCounters::kDefaultMaxAge{3600};
+
+const size_t ConnectErrorCounters::kDefaultCapacity;
+const size_t ConnectErrorCounters::kProbeWindow;
+const size_t ConnectErrorCounters::kShards;
+const uint64_t ConnectErrorCounters::kFreeKey;
+const uint64_t ConnectErrorCounters::kBusyKey;
+
+static uint64_t get_hash_seed() {
+  static const uint64_t seed = []() {
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+  }();
+
+  return seed;
+}
+
+ConnectErrorCounters::ConnectErrorCounters(unsigned long long max_connect_errors,
+                                           size_t capacity,
+                                           std::chrono::seconds max_age)
+    : seed_(get_hash_seed()),
+      max_connect_errors_(max_connect_errors),
+      max_age_(std::chrono::duration_cast<clock_type::duration>(max_age)),
+      slots_per_shard_(std::max(kProbeWindow, (capacity + kShards - 1) / kShards)),
+      shards_(new Shard[kShards]) {
+  for (size_t ndx = 0; ndx < kShards; ++ndx) {
+    shards_[ndx].slots.reset(new Slot[slots_per_shard_]);
+  }
+}
+
+std::shared_ptr<ConnectErrorCounters> ConnectErrorCounters::get_shared() {
+  static std::shared_ptr<ConnectErrorCounters> shared =
+      std::make_shared<ConnectErrorCounters>(std::numeric_limits<unsigned long long>::max());
+
+  return shared;
+}
+
+void ConnectErrorCounters::lower_max_connect_errors(unsigned long long max_connect_errors) noexcept {
+  unsigned long long current = max_connect_errors_.load(std::memory_order_relaxed);
+  while (max_connect_errors < current &&
+         !max_connect_errors_.compare_exchange_weak(current, max_connect_errors, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t ConnectErrorCounters::hash(const ClientIpArray& client_ip_array) const noexcept {
+  // FNV-1a, starting from the seed
+  uint64_t h = 14695981039346656037ULL ^ seed_;
+  for (uint8_t byte : client_ip_array) {
+    h ^= byte;
+    h *= 1099511628211ULL;
+  }
+  // the finalizer of MurmurHash3 spreads the seed over all bits
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  // keep clear of the reserved keys
+  return h > kBusyKey ? h : h + 2;
+}
+
+ConnectErrorCounters::Address ConnectErrorCounters::to_address(const ClientIpArray& client_ip_array) noexcept {
+  static_assert(sizeof(Address) == sizeof(ClientIpArray), "addresses are 16 bytes");
+
+  Address address;
+  std::memcpy(address.data(), client_ip_array.data(), sizeof(address));
+  return address;
+}
+
+size_t ConnectErrorCounters::get(const ClientIpArray& client_ip_array) const noexcept {
+  const uint64_t key = hash(client_ip_array);
+  const Address address = to_address(client_ip_array);
+  const Shard& shard = get_shard(key);
+  const size_t home = get_home_slot(key);
+
+  for (size_t probe = 0; probe < kProbeWindow; ++probe) {
+    const Slot& slot = shard.slots[(home + probe) % slots_per_shard_];
+    const uint64_t slot_key = slot.key.load(std::memory_order_acquire);
+
+    // slots are never freed, the host isn't behind a free slot
+    if (slot_key == kFreeKey) return 0;
+    if (slot_key != key) continue;
+
+    const size_t count = slot.count.load(std::memory_order_acquire);
+    const bool same_host = has_address(slot, address);
+    // slot got recycled while reading the count
+    if (slot.key.load(std::memory_order_acquire) != key) return 0;
+    // another host with the same hash
+    if (!same_host) continue;
+
+    return count;
+  }
+
+  return 0;
+}
+
+size_t ConnectErrorCounters::increment(const ClientIpArray& client_ip_array,
+                                       clock_type::time_point now) {
+  const uint64_t key = hash(client_ip_array);
+  const Address address = to_address(client_ip_array);
+  Shard& shard = shards_[key & (kShards - 1)];
+  const size_t home = get_home_slot(key);
+  const int64_t now_ticks = now.time_since_epoch().count();
+  const unsigned long long max_connect_errors = get_max_connect_errors();
+
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  Slot* victim = nullptr;
+  Slot* blocked_victim = nullptr;
+  for (size_t probe = 0; probe < kProbeWindow; ++probe) {
+    Slot& slot = shard.slots[(home + probe) % slots_per_shard_];
+    const uint64_t slot_key = slot.key.load(std::memory_order_relaxed);
+
+    if (slot_key == kFreeKey) {
+      slot.address[0].store(address[0], std::memory_order_relaxed);
+      slot.address[1].store(address[1], std::memory_order_relaxed);
+      slot.count.store(1, std::memory_order_relaxed);
+      slot.last_error.store(now_ticks, std::memory_order_relaxed);
+      slot.key.store(key, std::memory_order_release);
+      ++size_;
+      return 1;
+    }
+
+    const size_t count = slot.count.load(std::memory_order_relaxed);
+    if (slot_key == key && has_address(slot, address)) {
+      const bool aged = count < max_connect_errors &&
+          now_ticks - slot.last_error.load(std::memory_order_relaxed) > max_age_.count();
+      const size_t new_count = aged ? 1 : count + 1;
+
+      slot.count.store(new_count, std::memory_order_release);
+      slot.last_error.store(now_ticks, std::memory_order_relaxed);
+      return new_count;
+    }
+
+    Slot*& candidate = count < max_connect_errors ? victim : blocked_victim;
+    if (candidate == nullptr ||
+        slot.last_error.load(std::memory_order_relaxed) < candidate->last_error.load(std::memory_order_relaxed)) {
+      candidate = &slot;
+    }
+  }
+
+  // a window full of blocked hosts mustn't keep others from being counted
+  if (victim == nullptr) victim = blocked_victim;
+
+  // hide the slot from readers while it changes hands
+  victim->key.store(kBusyKey, std::memory_order_release);
+  victim->address[0].store(address[0], std::memory_order_relaxed);
+  victim->address[1].store(address[1], std::memory_order_relaxed);
+  victim->count.store(1, std::memory_order_release);
+  victim->last_error.store(now_ticks, std::memory_order_relaxed);
+  victim->key.store(key, std::memory_order_release);
+
+  return 1;
+}
+
+std::vector<ClientIpArray> ConnectErrorCounters::get_blocked(unsigned long long max_connect_errors) const {
+  std::vector<ClientIpArray> result;
+
+  for (size_t shard_ndx = 0; shard_ndx < kShards; ++shard_ndx) {
+    Shard& shard = shards_[shard_ndx];
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    for (size_t ndx = 0; ndx < slots_per_shard_; ++ndx) {
+      const Slot& slot = shard.slots[ndx];
+      if (slot.key.load(std::memory_order_relaxed) != kFreeKey &&
+          slot.count.load(std::memory_order_relaxed) >= max_connect_errors) {
+        const Address address{{slot.address[0].load(std::memory_order_relaxed),
+                               slot.address[1].load(std::memory_order_relaxed)}};
+        ClientIpArray client_ip_array;
+        std::memcpy(client_ip_array.data(), address.data(), sizeof(address));
+        result.push_back(client_ip_array);
+      }
+    }
+  }
+
+  // the slots are in hash order, which changes with the seed
+  std::sort(result.begin(), result.end());
+
+  return result;
+}
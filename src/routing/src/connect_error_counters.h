@@ -0,0 +1,220 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_CONNECT_ERROR_COUNTERS_INCLUDED
+#define ROUTING_CONNECT_ERROR_COUNTERS_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+/**
+ * @brief ConnectErrorCounters counts the connection errors per client host.
+ *
+ * Hosts are kept in a fixed number of slots split into shards. Each host
+ * is looked up in a short probe window of its shard, so lookups and
+ * updates take constant time with any number of distinct clients.
+ *
+ * Readers don't take locks: get() loads the atomic key and counter of the
+ * slots. Writers serialize per shard with a mutex.
+ *
+ * Hosts are hashed with a secret seed, so clients can't pick addresses
+ * which crowd the same probe window, and slots are matched by the full
+ * address, as different hosts may still share a hash.
+ *
+ * Counts of hosts that are not blocked age out: a count is restarted if
+ * the host had no error for max_age. Once the probe window of a new host
+ * is full, the slot with the oldest error of a host that is not blocked
+ * gets recycled. Blocked hosts never age out and are only evicted, the one
+ * with the oldest error first, if the whole window holds blocked hosts.
+ *
+ * Routes either have their own counters or use the shared ones, which
+ * block a host on all routes sharing them at once. The routes sharing the
+ * counters may block at different counts, the counters keep the hosts
+ * blocked by any of them.
+ */
+class ConnectErrorCounters {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief default number of hosts tracked */
+  static const size_t kDefaultCapacity = 16384;
+
+  /** @brief default time without error after which a count restarts */
+  static const std::chrono::seconds kDefaultMaxAge;
+
+  /**
+   * @param max_connect_errors count at which a host is blocked
+   * @param capacity max number of hosts tracked, rounded up to a multiple of
+   *        the shards' probe window
+   * @param max_age time without error after which a count restarts
+   */
+  ConnectErrorCounters(unsigned long long max_connect_errors,
+                       size_t capacity = kDefaultCapacity,
+                       std::chrono::seconds max_age = kDefaultMaxAge);
+
+  /**
+   * @brief Returns the counters shared by the routes.
+   *
+   * Created on first use with the default capacity, hosts are never
+   * blocked until lower_max_connect_errors() gets called.
+   */
+  static std::shared_ptr<ConnectErrorCounters> get_shared();
+
+  /**
+   * @brief Lowers the count at which hosts are blocked.
+   *
+   * Called by each route using the counters with its max_connect_errors.
+   * Does nothing if the count isn't lower than the current one.
+   */
+  void lower_max_connect_errors(unsigned long long max_connect_errors) noexcept;
+
+  /**
+   * @brief Counts a connection error of the host.
+   *
+   * @param client_ip_array IP address of the client host
+   * @param now time of the error
+   *
+   * @return count of the host including this error
+   */
+  size_t increment(const ClientIpArray& client_ip_array,
+                   clock_type::time_point now = clock_type::now());
+
+  /**
+   * @brief Returns the error count of the host, 0 if it has none.
+   *
+   * Doesn't lock, safe to call from any thread.
+   */
+  size_t get(const ClientIpArray& client_ip_array) const noexcept;
+
+  /**
+   * @brief Returns true if the host reached max_connect_errors.
+   */
+  bool is_blocked(const ClientIpArray& client_ip_array) const noexcept {
+    return is_blocked(client_ip_array, get_max_connect_errors());
+  }
+
+  /**
+   * @brief Returns true if the host reached the count.
+   */
+  bool is_blocked(const ClientIpArray& client_ip_array,
+                  unsigned long long max_connect_errors) const noexcept {
+    return get(client_ip_array) >= max_connect_errors;
+  }
+
+  /**
+   * @brief Returns the hosts having reached max_connect_errors, sorted by
+   *        address.
+   */
+  std::vector<ClientIpArray> get_blocked() const {
+    return get_blocked(get_max_connect_errors());
+  }
+
+  /**
+   * @brief Returns the hosts having reached the count, sorted by address.
+   */
+  std::vector<ClientIpArray> get_blocked(unsigned long long max_connect_errors) const;
+
+  unsigned long long get_max_connect_errors() const noexcept {
+    return max_connect_errors_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns number of hosts tracked.
+   */
+  size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /** @brief number of slots probed for a host */
+  static const size_t kProbeWindow = 16;
+  /** @brief number of shards, a power of 2 */
+  static const size_t kShards = 16;
+
+  /** @brief key of a slot not used yet */
+  static const uint64_t kFreeKey = 0;
+  /** @brief key of a slot being recycled */
+  static const uint64_t kBusyKey = 1;
+
+  /** @brief a ClientIpArray as words which can be loaded atomically */
+  using Address = std::array<uint64_t, 2>;
+
+  struct Slot {
+    /** @brief hash of the host, kFreeKey or kBusyKey */
+    std::atomic<uint64_t> key{kFreeKey};
+    std::atomic<size_t> count{0};
+    /** @brief time of the last error, in clock_type ticks */
+    std::atomic<int64_t> last_error{0};
+    /** @brief address of the host using the slot, set before the key */
+    std::atomic<uint64_t> address[2]{{0}, {0}};
+  };
+
+  struct Shard {
+    std::mutex mtx;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  uint64_t hash(const ClientIpArray& client_ip_array) const noexcept;
+
+  static Address to_address(const ClientIpArray& client_ip_array) noexcept;
+
+  /** @brief true if the host uses the slot, the key may have changed meanwhile */
+  static bool has_address(const Slot& slot, const Address& address) noexcept {
+    return slot.address[0].load(std::memory_order_acquire) == address[0] &&
+           slot.address[1].load(std::memory_order_acquire) == address[1];
+  }
+
+  const Shard& get_shard(uint64_t key) const noexcept {
+    return shards_[key & (kShards - 1)];
+  }
+
+  /** @brief first slot of the host's probe window in its shard */
+  size_t get_home_slot(uint64_t key) const noexcept {
+    return static_cast<size_t>((key >> 4) % slots_per_shard_);
+  }
+
+  /** @brief secret seed of hash(), random per process */
+  const uint64_t seed_;
+  std::atomic<unsigned long long> max_connect_errors_;
+  const clock_type::duration max_age_;
+  size_t slots_per_shard_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<size_t> size_{0};
+
+#ifdef FRIEND_TEST
+  FRIEND_TEST(TestConnectErrorCounters, SharedHashes);
+#endif
+};
+
+#endif  // ROUTING_CONNECT_ERROR_COUNTERS_INCLUDED
@@ -22,36 +22,84 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstring>
 #include <string>
 
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 #include "common.h"
 #include "connection.h"
+#include "destination.h"
+#include "io_engine.h"
+#include "protocol/classic_framer.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/x_handshake.h"
+#include "protocol/x_protocol.h"
 #include "mysql_router_thread.h"
 #include "mysql_routing_common.h"
 #include "mysql/harness/loader.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/logging/registry.h"
+#include "mysql/harness/tracepoints.h"
 #include "mysqlrouter/routing.h"
+#include "mysqlrouter/routing_metrics.h"
 #include "utils.h"
 IMPORT_LOG_FUNCTIONS()
 
+static const uint8_t kComQuit = 0x01;
+static const uint8_t kComQuery = 0x03;
+static const uint8_t kComChangeUser = 0x11;
+static const uint8_t kComStmtPrepare = 0x16;
+static const uint8_t kComStmtExecute = 0x17;
+static const uint8_t kComStmtClose = 0x19;
+static const uint8_t kComResetConnection = 0x1f;
+
+// a secondary not answering within this falls back to the primary, one
+// stalling in the middle of a response fails the connection
+static const std::chrono::seconds kSecondaryResponseTimeout{30};
+
+// how long a graceful close waits for the zero-copy sends in flight before
+// resetting the connection. An I/O thread serves other connections meanwhile
+static const std::chrono::milliseconds kZeroCopyCloseTimeout{1000};
+static const std::chrono::milliseconds kZeroCopyCloseTimeoutIOThread{10};
+
 MySQLRoutingConnection ::MySQLRoutingConnection(MySQLRoutingContext& context, int client_socket,
     const sockaddr_storage& client_addr, int server_socket,
     const mysql_harness::TCPAddress& server_address,
-    std::function<void(MySQLRoutingConnection*)> remove_callback) :
+    std::function<void(MySQLRoutingConnection*)> remove_callback,
+    ServerConnector server_connector) :
   context_(context),
   remove_callback_(remove_callback),
   client_socket_(client_socket),
-  client_addr_(client_addr),
+  client_endpoint_(client_addr),
   server_socket_(server_socket),
   server_address_(server_address),
-  client_address_(make_client_address(client_socket, context)){
+  server_connector_(server_connector),
+  read_buffer_size_(context.get_net_buffer_length(), context.get_max_net_buffer_length()),
+  backend_pool_(context.get_backend_pool()) {
+  if (context.is_connection_trace()) {
+    trace_id_ = ConnectionTrace::getInstance().next_connection_id();
+    trace(ConnectionTrace::Event::kAccepted);
+  }
 }
 
 void MySQLRoutingConnection::start(bool detached) {
+  if (context_.get_io_engine()) {
+    // decreased by complete() once the I/O engine is done with connection
+    context_.increase_active_thread_counter();
+    context_.get_io_engine()->add_connection(this);
+    return;
+  }
+
   try {
     // both lines can throw std::runtime_error
-    mysql_harness::MySQLRouterThread connect_thread(context_.get_thread_stack_size());
+    mysql_harness::MySQLRouterThread connect_thread(context_.get_connection_thread_stack_size());
     connect_thread.run(&run_thread, this, detached);
   } catch(std::runtime_error& err) {
     context_.get_protocol().send_error(client_socket_, 1040,
@@ -59,15 +107,12 @@ void MySQLRoutingConnection::start(bool detached) {
                           "HY000", context_.get_name());
     context_.get_socket_operations()->close(client_socket_); // no shutdown() before close()
 
-    // we only want to log this message once, because in a low-resource situation, this would
-    // lead do a DoS against ourselves (heavy I/O and disk full)
-    static bool logged_this_before = false;
-    if (!logged_this_before) {
-      logged_this_before = true;
-      log_error("Couldn't spawn a new thread to service new client connection from %s."
-                " This message will not be logged again until Router restarts, error=%s",
-                get_peer_name(client_socket_).first.c_str(), err.what());
-    }
+    // rate-limited, because in a low-resource situation, this would lead to a
+    // DoS against ourselves (heavy I/O and disk full)
+    static mysql_harness::logging::LogRateLimiter log_limiter;
+    log_error_limited(log_limiter,
+                      "Couldn't spawn a new thread to service new client connection from %s, error=%s",
+                      client_endpoint_.address_str().c_str(), err.what());
   }
 }
 
@@ -77,6 +122,10 @@ void* MySQLRoutingConnection::run_thread(void* context) {
   return nullptr;
 }
 
+void MySQLRoutingConnection::set_read_only_connector(ServerConnector read_only_connector) {
+  read_only_connector_ = read_only_connector;
+}
+
 bool MySQLRoutingConnection::check_sockets() {
   if ((server_socket_ == routing::kInvalidSocket) ||
       (client_socket_ == routing::kInvalidSocket)) {
@@ -98,6 +147,7 @@ bool MySQLRoutingConnection::check_sockets() {
     if (server_socket_ != routing::kInvalidSocket) {
       context_.get_socket_operations()->close(server_socket_);
     }
+    trace(ConnectionTrace::Event::kClosed);
     return false;
   }
 
@@ -105,68 +155,77 @@ bool MySQLRoutingConnection::check_sockets() {
 }
 
 void MySQLRoutingConnection::run() {
+#ifndef NDEBUG
+  // tells if the connection threads' stacks could be smaller or need to be larger
+  mysql_harness::StackUsageProbe stack_probe;
+#endif
   mysql_harness::rename_thread(get_routing_thread_name(context_.get_name(), "RtC").c_str());  // "Rt client thread" would be too long :(
+  // failures got reported by the acceptor thread already
+  if (!context_.get_cpu_affinity().empty()) {
+    mysql_harness::set_current_thread_cpu_affinity(context_.get_cpu_affinity());
+  }
 
   context_.increase_active_thread_counter();
   std::shared_ptr<void> thread_exit_guard(nullptr, [&](void *){
-    context_.decrease_active_thread_counter();
-
+#ifndef NDEBUG
+    log_debug("[%s] connection thread used %llu of %llu bytes of stack",
+        context_.get_name().c_str(),
+        static_cast<unsigned long long>(stack_probe.max_used()),
+        static_cast<unsigned long long>(stack_probe.size()));
+#endif
     // remove callback has to be executed as a last thing in connection
-    remove_callback_(this);
+    complete();
   });
 
-  std::size_t bytes_down = 0;
-  std::size_t bytes_up = 0;
-  std::size_t bytes_read = 0;
-  std::string extra_msg = "";
-  RoutingProtocolBuffer buffer(context_.get_net_buffer_length());
-  bool handshake_done = false;
+  connect_server();
 
-  if (!check_sockets()) {
+  if (!open()) {
     return;
   }
 
-  std::pair<std::string, int> c_ip = get_peer_name(client_socket_);
-  std::pair<std::string, int> s_ip = get_peer_name(server_socket_);
-
-  if (c_ip.second == 0) {
-    // Unix socket/Windows Named pipe
-    log_debug("[%s] fd=%d connected %s -> %s:%d as fd=%d",
-        context_.get_name().c_str(),
-        client_socket_,
-        context_.get_bind_named_socket().c_str(),
-        s_ip.first.c_str(), s_ip.second,
-        server_socket_);
-  } else {
-    log_debug("[%s] fd=%d connected %s:%d -> %s:%d as fd=%d",
-        context_.get_name().c_str(),
-        client_socket_,
-        c_ip.first.c_str(), c_ip.second,
-        s_ip.first.c_str(), s_ip.second,
-        server_socket_);
-  }
-
-  context_.increase_info_active_routes();
-  context_.increase_info_handled_routes();
+  // without the pipe disconnect_ gets checked once a second
+  const bool has_wakeup_pipe = open_wakeup_pipe();
+  std::shared_ptr<void> wakeup_pipe_guard(nullptr, [&](void *){
+    if (has_wakeup_pipe) close_wakeup_pipe();
+  });
 
-  int pktnr = 0;
+  auto get_poll_events = [this](int socket) {
+    return static_cast<short>((wants_to_read(socket) ? POLLIN : 0) |
+                              (wants_to_write(socket) ? POLLOUT : 0));
+  };
 
   bool connection_is_ok = true;
   while (connection_is_ok && !disconnect_) {
+    if (is_drained()) {
+      extra_msg_ = "closed to drain the route";
+      break;
+    }
+    if (migrating_ && !migrate_session()) break;
+
     const size_t kClientEventIndex = 0;
     const size_t kServerEventIndex = 1;
+    const size_t kWakeupEventIndex = 2;
 
     struct pollfd fds[] = {
-      { routing::kInvalidSocket, POLLIN, 0 },
+      { routing::kInvalidSocket, 0, 0 },
+      { routing::kInvalidSocket, 0, 0 },
       { routing::kInvalidSocket, POLLIN, 0 },
     };
 
     fds[kClientEventIndex].fd = client_socket_;
+    fds[kClientEventIndex].events = get_poll_events(client_socket_);
     fds[kServerEventIndex].fd = server_socket_;
+    fds[kServerEventIndex].events = get_poll_events(server_socket_);
+    // not written by anyone else, no lock needed
+    fds[kWakeupEventIndex].fd = wakeup_fds_[0];
 
+    // decrypted data buffered by TLS doesn't make the client socket readable
+    const bool client_tls_pending = client_tls_ && client_tls_->has_pending();
     const std::chrono::milliseconds poll_timeout_ms =
-        handshake_done ? std::chrono::milliseconds(1000)
-                       : context_.get_client_connect_timeout();
+        client_tls_pending ? std::chrono::milliseconds(0)
+                           : !handshake_done_ ? context_.get_client_connect_timeout()
+                                              : has_wakeup_pipe ? std::chrono::milliseconds(-1)
+                                                                : std::chrono::milliseconds(1000);
     int res = context_.get_socket_operations()->poll(fds, sizeof(fds) / sizeof(fds[0]), poll_timeout_ms);
 
     if (res < 0) {
@@ -179,17 +238,15 @@ void MySQLRoutingConnection::run() {
         default:
           // break the loop, something ugly happened
           connection_is_ok = false;
-          extra_msg = std::string("poll() failed: " + mysqlrouter::to_string(get_message_error(last_errno)));
+          extra_msg_ = std::string("poll() failed: " + mysqlrouter::to_string(get_message_error(last_errno)));
           break;
       }
 
       continue;
-    } else if (res == 0) {
+    } else if (res == 0 && !client_tls_pending) {
       // timeout
-      if (!handshake_done) {
-        connection_is_ok = false;
-        extra_msg = std::string("client auth timed out");
-
+      if (!handshake_done_) {
+        handshake_timed_out();
         break;
       } else {
         continue;
@@ -203,89 +260,2449 @@ void MySQLRoutingConnection::run() {
     // * Linux: POLLIN + read() == 0
     // * Windows: POLLHUP
 
-    const bool client_is_readable = (fds[kClientEventIndex].revents & (POLLIN|POLLHUP)) != 0;
-    const bool server_is_readable = (fds[kServerEventIndex].revents & (POLLIN|POLLHUP)) != 0;
+    //
+    // errors are reported as readable too, as a paused socket isn't polled for POLLIN
+
+    const bool client_is_readable = client_tls_pending ||
+                                    (fds[kClientEventIndex].revents & (POLLIN|POLLHUP|POLLERR)) != 0;
+    const bool server_is_readable = (fds[kServerEventIndex].revents & (POLLIN|POLLHUP|POLLERR)) != 0;
+    const bool client_is_writable = (fds[kClientEventIndex].revents & POLLOUT) != 0;
+    const bool server_is_writable = (fds[kServerEventIndex].revents & POLLOUT) != 0;
 
-    // Handle traffic from Server to Client
-    // Note: In classic protocol Server _always_ talks first
-    if (context_.get_protocol().copy_packets(server_socket_, client_socket_, server_is_readable,
-                                             buffer, &pktnr, handshake_done, &bytes_read, true) == -1) {
-      const int last_errno = context_.get_socket_operations()->get_errno();
-      if (last_errno > 0) {
-        // if read() against closed socket, errno will be 0. Don't log that.
-        extra_msg = std::string("Copy server->client failed: " + mysqlrouter::to_string(get_message_error(last_errno)));
+#ifndef _WIN32
+    // drain() leaves the connection running, don't get woken up again
+    if (fds[kWakeupEventIndex].revents != 0) {
+      char buf[16];
+      while (::read(wakeup_fds_[0], buf, sizeof(buf)) > 0) {}
+    }
+#endif
+
+    // woken up by disconnect() or drain()
+    if (fds[kWakeupEventIndex].revents != 0 && !client_is_readable && !server_is_readable &&
+        !client_is_writable && !server_is_writable) continue;
+
+    connection_is_ok = forward(client_is_readable, server_is_readable,
+                               client_is_writable, server_is_writable);
+  } // while (connection_is_ok && !disconnect_.load())
+
+  close();
+}
+
+void MySQLRoutingConnection::connect_server() {
+  if (!server_connector_) return;
+
+  // commands are inspected and answered synchronously, not through output queues
+  multiplexing_ = backend_pool_ && context_.is_connection_multiplexing();
+  if ((read_only_connector_ || multiplexing_ || context_.is_session_migration() || query_router_) &&
+      !context_.uses_output_queues() && !context_.get_client_tls_context() &&
+      !context_.is_server_compression() &&
+      context_.get_protocol().get_type() == BaseProtocol::Type::kClassicProtocol) {
+    splitter_.reset(new ReadWriteSplitter(static_cast<bool>(read_only_connector_)));
+    if (read_only_connector_ && read_your_writes_) splitter_->set_read_your_writes();
+    if (context_.is_session_migration()) splitter_->set_replays_session();
+    if (query_router_) splitter_->set_query_router(query_router_);
+    if (multiplexing_ && context_.get_prepared_statement_cache_size() > 0) {
+      statements_.reset(new PreparedStatementTranslator());
+      splitter_->set_translates_statements();
+    }
+  }
+  if (multiplexing_ || context_.is_session_migration()) backend_connector_ = server_connector_;
+
+  trace(ConnectionTrace::Event::kConnectStarted);
+
+  mysql_harness::TCPAddress server_address;
+  if (backend_pool_ && context_.get_protocol().get_type() == BaseProtocol::Type::kXProtocol) {
+    server_socket_ = connect_server_x_pooled(server_address);
+  } else if (backend_pool_) {
+    server_socket_ = connect_server_pooled(server_address);
+  } else if (handshake_router_) {
+    server_socket_ = connect_server_by_handshake(server_address);
+  } else {
+    server_socket_ = server_connector_(server_address);
+    if (server_socket_ >= 0 && context_.get_client_tls_context() && !offer_client_tls()) {
+      context_.get_socket_operations()->shutdown(server_socket_);
+      context_.get_socket_operations()->close(server_socket_);
+      server_socket_ = routing::kInvalidSocket;
+    }
+    if (server_socket_ >= 0 && context_.is_server_compression()) {
+      if (context_.get_protocol().get_type() == BaseProtocol::Type::kXProtocol) {
+        // the X protocol negotiates it before the client speaks
+        if (!negotiate_x_compression()) {
+          context_.get_socket_operations()->shutdown(server_socket_);
+          context_.get_socket_operations()->close(server_socket_);
+          server_socket_ = routing::kInvalidSocket;
+        }
+      } else {
+        // the handshake decides about compression
+        relaying_handshake_ = true;
       }
+    }
+  }
+  server_connector_ = nullptr;
 
-      connection_is_ok = false;
-    } else {
-      bytes_up += bytes_read;
+  trace(server_socket_ >= 0 ? ConnectionTrace::Event::kServerConnected
+                            : ConnectionTrace::Event::kServerConnectFailed);
+
+  set_server_address(server_address, server_socket_ >= 0);
+  if (server_score_) {
+    server_score_->get_circuit_breaker().admitted(std::chrono::steady_clock::now());
+  } else if (server_failed_handshake_ && scoreboard_) {
+    judge_server_handshake(*scoreboard_->get(server_address), false);
+  }
+
+  if (server_socket_ >= 0 && server_connected_callback_) {
+    server_connected_callback_(this, mysql_harness::TCPAddress());
+  }
+}
+
+int MySQLRoutingConnection::connect_server_pooled(mysql_harness::TCPAddress& server_address) {
+  using namespace mysql_protocol;
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const std::chrono::milliseconds timeout = context_.get_client_connect_timeout();
+
+  RoutingProtocolBuffer greeting;
+  if (!backend_pool_->get_greeting(greeting)) {
+    // no server greeting known yet, relay the handshake of a new connection
+    int server = server_connector_(server_address);
+    if (server == routing::kInvalidSocket) return server;
+
+    const bool greeting_ok = read_server_greeting(server, greeting);
+    // errors of the server are passed to the client as well
+    if (greeting.empty() || so->write_all(client_socket_, &greeting[0], greeting.size()) < 0 ||
+        !greeting_ok) {
+      so->close(server);
+      return routing::kInvalidSocket;
     }
 
-    // Handle traffic from Client to Server
-    if (context_.get_protocol().copy_packets(client_socket_, server_socket_, client_is_readable,
-                                             buffer, &pktnr, handshake_done, &bytes_read, false) == -1) {
-      const int last_errno = context_.get_socket_operations()->get_errno();
-      if (last_errno > 0) {
-        extra_msg = std::string("Copy client->server failed: " + mysqlrouter::to_string(get_message_error(last_errno)));
-      } else if (!handshake_done) {
-        extra_msg = std::string("Copy client->server failed: unexpected connection close");
+    relaying_handshake_ = true;
+    handshake_waits_for_server_ = false;
+    return server;
+  }
+
+  // the client decides about the server connection by its handshake response
+  RoutingProtocolBuffer response;
+  classic_handshake::ClientHandshake handshake;
+  if (so->write_all(client_socket_, &greeting[0], greeting.size()) < 0 ||
+      !classic_handshake::read_packet(so, client_socket_, response, timeout)) {
+    return routing::kInvalidSocket;
+  }
+  if (!classic_handshake::parse_handshake_response(response, handshake) ||
+      !handshake.capabilities.test(Capabilities::PLUGIN_AUTH | Capabilities::SECURE_CONNECTION) ||
+      handshake.capabilities.test(Capabilities::SSL)) {
+    log_warning("[%s] fd=%d client handshake not supported with pooled server connections",
+        context_.get_name().c_str(), client_socket_);
+    return routing::kInvalidSocket;
+  }
+  if (splitter_) take_client_handshake(response, response.size());
+
+  // the strategy picks the server, a connection to it parked with the
+  // same capabilities saves the connect
+  BackendConnectionPool::Connection parked;
+  int server;
+  {
+    RouteDestination::SessionReuse session_reuse(
+        [this, &handshake, &parked](const mysql_harness::TCPAddress& addr) {
+          return backend_pool_->take(addr, handshake.capabilities.bits(), parked) ? parked.socket
+                                                                                  : routing::kInvalidSocket;
+        });
+    server = server_connector_(server_address);
+  }
+  if (server == routing::kInvalidSocket) return server;
+
+  const bool reuse = server == parked.socket;
+  if (reuse) {
+    session_.scramble = parked.scramble;
+  } else {
+    RoutingProtocolBuffer server_greeting;
+    if (!read_server_greeting(server, server_greeting)) {
+      if (!server_greeting.empty()) {
+        // error of the server, the client expects the next packet
+        server_greeting[3] = 2;
+        so->write_all(client_socket_, &server_greeting[0], server_greeting.size());
       }
-      // client close on us.
-      connection_is_ok = false;
+      so->close(server);
+      return routing::kInvalidSocket;
+    }
+  }
+
+  // let the client authenticate against the scramble of the server
+  RoutingProtocolBuffer auth_response;
+  if (!switch_client_auth(handshake, auth_response)) {
+    if (reuse) {
+      backend_pool_->park(std::move(parked));
     } else {
-      bytes_down += bytes_read;
+      so->close(server);
     }
+    return routing::kInvalidSocket;
+  }
 
-  } // while (connection_is_ok && !disconnect_.load())
+  RoutingProtocolBuffer request;
+  try {
+    if (reuse) {
+      request = ChangeUserPacket(0, handshake.username, auth_response, handshake.database,
+                                 handshake.char_set, handshake.auth_plugin,
+                                 handshake.connection_attrs, handshake.capabilities);
+    } else {
+      request = classic_handshake::make_handshake_response(response, handshake, auth_response);
+    }
+  } catch (const packet_error& exc) {
+    log_debug("[%s] fd=%d %s", context_.get_name().c_str(), client_socket_, exc.what());
+  }
+  if (request.empty() || so->write_all(server, &request[0], request.size()) < 0) {
+    so->close(server);
+    return routing::kInvalidSocket;
+  }
 
-  if (!handshake_done) {
-    log_info("[%s] fd=%d Pre-auth socket failure %s: %s",
+  // server answers with sequence id 1 to COM_CHANGE_USER and 2 to the
+  // handshake response, the client expects 4 after the auth switch
+  relay_seq_offset_ = reuse ? 3 : 2;
+  relaying_handshake_ = true;
+  session_.capabilities = handshake.capabilities.bits();
+
+  return server;
+}
+
+int MySQLRoutingConnection::connect_server_x_pooled(mysql_harness::TCPAddress& server_address) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const std::chrono::milliseconds timeout = context_.get_client_connect_timeout();
+
+  // answered by the router, set on a new server connection before anything else
+  std::vector<RoutingProtocolBuffer> answered_sets;
+  std::string capabilities_key;
+  int server = routing::kInvalidSocket;
+  RoutingProtocolBuffer message;
+  RoutingProtocolBuffer response;
+  while (x_handshake::read_message(so, client_socket_, message, timeout)) {
+    const uint8_t type = x_handshake::get_type(message);
+    const uint8_t* payload = &message[0] + x_handshake::kHeaderSize;
+    const size_t payload_size = message.size() - x_handshake::kHeaderSize;
+    if (!XProtocol::is_valid_handshake_message(type, payload, payload_size)) {
+      log_warning("[%s] fd=%d invalid X protocol message from the client while handshaking: type(%u), size(%zu)",
+          context_.get_name().c_str(), client_socket_, static_cast<unsigned>(type), payload_size);
+      break;
+    }
+    if (type == x_handshake::kConnectionClose) break;
+
+    const bool tls = type == x_handshake::kCapabilitiesSet && XProtocol::requests_tls(payload, payload_size);
+    if (type == x_handshake::kAuthenticateStart || tls) {
+      if (server == routing::kInvalidSocket) {
+        server = connect_x_server(server_address, answered_sets, tls ? nullptr : &capabilities_key);
+      }
+      if (server == routing::kInvalidSocket) return server;
+      if (so->write_all(server, &message[0], message.size()) < 0) break;
+
+      // the rest is relayed, TLS hides the end of the session
+      handshake_done_ = true;
+      poolable_ = !tls;
+      session_.capabilities_key = std::move(capabilities_key);
+      return server;
+    }
+
+    if (type == x_handshake::kCapabilitiesSet) {
+      capabilities_key.append(message.begin(), message.end());
+      if (server == routing::kInvalidSocket) {
+        answered_sets.push_back(message);
+        response = x_handshake::make_message(x_handshake::kOk);
+      } else if (so->write_all(server, &message[0], message.size()) < 0 ||
+                 !x_handshake::read_response(so, server, response, timeout)) {
+        break;
+      }
+    } else if (!backend_pool_->get_greeting(response)) {
+      // CapabilitiesGet before the pooled servers got asked
+      if (server == routing::kInvalidSocket) server = connect_x_server(server_address, answered_sets);
+      if (server == routing::kInvalidSocket) return server;
+      if (so->write_all(server, &message[0], message.size()) < 0 ||
+          !x_handshake::read_response(so, server, response, timeout)) {
+        break;
+      }
+      if (x_handshake::get_type(response) == x_handshake::kCapabilities) backend_pool_->set_greeting(response);
+    }
+    if (so->write_all(client_socket_, &response[0], response.size()) < 0) break;
+  }
+
+  if (server != routing::kInvalidSocket) so->close(server);
+  return routing::kInvalidSocket;
+}
+
+int MySQLRoutingConnection::connect_x_server(mysql_harness::TCPAddress& server_address,
+                                             std::vector<RoutingProtocolBuffer>& answered_sets,
+                                             const std::string* capabilities_key) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  BackendConnectionPool::Connection parked;
+  int server;
+  {
+    RouteDestination::SessionReuse session_reuse(
+        [this, capabilities_key, &parked](const mysql_harness::TCPAddress& addr) {
+          return capabilities_key && backend_pool_->take_capabilities(addr, *capabilities_key, parked)
+                     ? parked.socket
+                     : routing::kInvalidSocket;
+        });
+    server = server_connector_(server_address);
+  }
+  if (server == routing::kInvalidSocket) return server;
+  // set up with the capabilities already
+  if (server == parked.socket) return server;
+
+  RoutingProtocolBuffer response;
+  for (RoutingProtocolBuffer& set: answered_sets) {
+    if (so->write_all(server, &set[0], set.size()) < 0 ||
+        !x_handshake::read_response(so, server, response, context_.get_client_connect_timeout())) {
+      so->close(server);
+      return routing::kInvalidSocket;
+    }
+    if (x_handshake::get_type(response) != x_handshake::kOk) {
+      // the client got the OK of the router, it learns about the error now
+      so->write_all(client_socket_, &response[0], response.size());
+      so->close(server);
+      return routing::kInvalidSocket;
+    }
+  }
+
+  return server;
+}
+
+int MySQLRoutingConnection::connect_server_by_handshake(mysql_harness::TCPAddress& server_address) {
+  using namespace mysql_protocol;
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const std::chrono::milliseconds timeout = context_.get_client_connect_timeout();
+
+  // no greeting known yet, the first client gets the one of a server of
+  // the route's destinations
+  RoutingProtocolBuffer greeting;
+  int server = routing::kInvalidSocket;
+  if (!handshake_router_->get_greeting(greeting)) {
+    server = server_connector_(server_address);
+    if (server == routing::kInvalidSocket) return server;
+
+    if (!read_server_greeting(server, greeting)) {
+      // errors of the server are passed to the client as well
+      if (!greeting.empty()) so->write_all(client_socket_, &greeting[0], greeting.size());
+      so->close(server);
+      return routing::kInvalidSocket;
+    }
+  }
+
+  RoutingProtocolBuffer response;
+  classic_handshake::ClientHandshake handshake;
+  if (so->write_all(client_socket_, &greeting[0], greeting.size()) < 0 ||
+      !classic_handshake::read_packet(so, client_socket_, response, timeout)) {
+    if (server != routing::kInvalidSocket) so->close(server);
+    return routing::kInvalidSocket;
+  }
+  if (!classic_handshake::parse_handshake_response(response, handshake) ||
+      !handshake.capabilities.test(Capabilities::PLUGIN_AUTH | Capabilities::SECURE_CONNECTION) ||
+      handshake.capabilities.test(Capabilities::SSL)) {
+    log_warning("[%s] fd=%d client handshake not supported with route_by",
+        context_.get_name().c_str(), client_socket_);
+    if (server != routing::kInvalidSocket) so->close(server);
+    return routing::kInvalidSocket;
+  }
+
+  std::shared_ptr<RouteDestination> pool = handshake_router_->get_pool(handshake);
+  if (pool) {
+    // the reads of the route's destinations aren't the pool's
+    splitter_.reset();
+    read_only_connector_ = nullptr;
+    scoreboard_ = pool->get_scoreboard();
+  }
+  if (splitter_) take_client_handshake(response, response.size());
+  session_.capabilities = handshake.capabilities.bits();
+
+  if (server != routing::kInvalidSocket) {
+    if (!pool) {
+      // the client answered the greeting of this server
+      if (so->write_all(server, &response[0], response.size()) < 0) {
+        so->close(server);
+        return routing::kInvalidSocket;
+      }
+      relaying_handshake_ = true;
+      return server;
+    }
+    so->close(server);
+    server_address = mysql_harness::TCPAddress();
+  }
+
+  server = pool ? pool_connector_(*pool, server_address) : server_connector_(server_address);
+  if (server == routing::kInvalidSocket) return server;
+
+  RoutingProtocolBuffer server_greeting;
+  if (!read_server_greeting(server, server_greeting)) {
+    if (!server_greeting.empty()) {
+      // error of the server, the client expects the next packet
+      server_greeting[3] = 2;
+      so->write_all(client_socket_, &server_greeting[0], server_greeting.size());
+    }
+    so->close(server);
+    return routing::kInvalidSocket;
+  }
+
+  RoutingProtocolBuffer auth_response;
+  if (!switch_client_auth(handshake, auth_response)) {
+    so->close(server);
+    return routing::kInvalidSocket;
+  }
+
+  RoutingProtocolBuffer request;
+  try {
+    request = classic_handshake::make_handshake_response(response, handshake, auth_response);
+  } catch (const packet_error& exc) {
+    log_debug("[%s] fd=%d %s", context_.get_name().c_str(), client_socket_, exc.what());
+  }
+  if (request.empty() || so->write_all(server, &request[0], request.size()) < 0) {
+    so->close(server);
+    return routing::kInvalidSocket;
+  }
+
+  // the server answers the handshake response with sequence id 2, the
+  // client expects 4 after the auth switch
+  relay_seq_offset_ = 2;
+  relaying_handshake_ = true;
+
+  return server;
+}
+
+bool MySQLRoutingConnection::switch_client_auth(const classic_handshake::ClientHandshake& handshake,
+                                                RoutingProtocolBuffer& auth_response) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  RoutingProtocolBuffer auth_switch = classic_handshake::make_auth_switch_request(
+      2, handshake.auth_plugin, session_.scramble);
+  if (so->write_all(client_socket_, &auth_switch[0], auth_switch.size()) < 0 ||
+      !classic_handshake::read_packet(so, client_socket_, auth_response,
+                                      context_.get_client_connect_timeout())) {
+    return false;
+  }
+  auth_response.erase(auth_response.begin(),
+                      auth_response.begin() + mysql_protocol::Packet::kHeaderSize);
+
+  return true;
+}
+
+bool MySQLRoutingConnection::read_server_greeting(int server, RoutingProtocolBuffer& greeting) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  if (!classic_handshake::read_packet(so, server, greeting, context_.get_destination_connect_timeout())) {
+    greeting.clear();
+    server_failed_handshake_ = true;
+    return false;
+  }
+
+  classic_handshake::ServerGreeting server_greeting;
+  if (!classic_handshake::parse_server_greeting(greeting, server_greeting, true)) {
+    // most likely an error like ER_HOST_IS_BLOCKED, to be passed to the client
+    server_failed_handshake_ = true;
+    return false;
+  }
+
+  session_.scramble = server_greeting.scramble;
+  if (backend_pool_) {
+    backend_pool_->set_greeting(greeting);
+  } else {
+    handshake_router_->set_greeting(greeting);
+  }
+
+  return true;
+}
+
+bool MySQLRoutingConnection::open() {
+  if (!check_sockets()) {
+    return false;
+  }
+
+  if (mysql_harness::logging::log_level_is_handled(mysql_harness::logging::LogLevel::kDebug)) {
+    // only turn the addresses into text if they get logged
+    const std::string client_address = get_client_address();
+    const std::string server_address = mysql_harness::SocketEndpoint::peer_of(server_socket_).str();
+
+    mysql_harness::logging::LogContext log_context;
+    log_context.add("route", context_.get_name())
+               .add("client_addr", client_address)
+               .add("server_addr", server_address);
+
+    log_debug("[%s] fd=%d connected %s -> %s as fd=%d",
         context_.get_name().c_str(),
         client_socket_,
-        c_ip.first.c_str(), extra_msg.c_str());
-     auto ip_array = in_addr_to_array(client_addr_);
-     context_.block_client_host(ip_array, c_ip.first.c_str(), server_socket_);
+        client_address.c_str(),
+        server_address.c_str(),
+        server_socket_);
   }
 
-  // Either client or server terminated
-  context_.get_socket_operations()->shutdown(client_socket_);
-  context_.get_socket_operations()->shutdown(server_socket_);
-  context_.get_socket_operations()->close(client_socket_);
-  context_.get_socket_operations()->close(server_socket_);
+  use_output_queues_ = context_.uses_output_queues();
+  // commands are inspected and answered synchronously by the secondary
+  if (use_output_queues_) splitter_.reset();
+  if (use_output_queues_ && context_.get_zero_copy_threshold() > 0) {
+    zero_copy_sender_.reset(new ZeroCopySender(context_.get_zero_copy_threshold()));
+    if (!zero_copy_sender_->enable(client_socket_)) {
+      log_debug("[%s] fd=%d MSG_ZEROCOPY not supported, copying: %s",
+          context_.get_name().c_str(), client_socket_, get_message_error(errno).c_str());
+      zero_copy_sender_.reset();
+    }
+  }
+  // sampled and mirrored statements need to be seen
+  if (context_.is_splice_enabled() && !use_output_queues_ && !splitter_ &&
+      !context_.get_query_digest_stats() && !context_.get_traffic_mirror() &&
+      context_.get_protocol().get_type() == BaseProtocol::Type::kClassicProtocol) {
+    splice_forwarder_.reset(new SpliceForwarder());
+  }
 
-  context_.decrease_info_active_routes();
-#ifndef _WIN32
-  log_debug("[%s] fd=%d connection closed (up: %zub; down: %zub) %s",
-      context_.get_name().c_str(),
-      client_socket_, bytes_up, bytes_down, extra_msg.c_str());
-#else
-  log_debug("[%s] fd=%d connection closed (up: %Iub; down: %Iub) %s",
-      context_.get_name().c_str(),
-      client_socket_, bytes_up, bytes_down, extra_msg.c_str());
-#endif
+  context_.increase_info_active_routes();
+  context_.increase_info_handled_routes();
+  if (context_.get_metrics()) context_.get_metrics()->connection_opened();
+
+  return true;
 }
 
-void MySQLRoutingConnection::disconnect() noexcept {
-  disconnect_ = true;
+bool MySQLRoutingConnection::forward(bool client_is_readable, bool server_is_readable,
+                                     bool client_is_writable, bool server_is_writable) {
+  const size_t bytes_up = bytes_up_;
+  const size_t bytes_down = bytes_down_;
+  const bool handshake_was_done = handshake_done_;
+  const bool connection_is_ok = forward_traffic(client_is_readable, server_is_readable,
+                                                client_is_writable, server_is_writable);
+  if (bytes_up_ != bytes_up || bytes_down_ != bytes_down || handshake_done_ != handshake_was_done) {
+    forwarded(bytes_up, bytes_down, handshake_was_done);
+  }
+
+  return connection_is_ok;
 }
 
-const mysql_harness::TCPAddress& MySQLRoutingConnection::get_server_address() const noexcept {
-  return server_address_;
+void MySQLRoutingConnection::forwarded(size_t bytes_up, size_t bytes_down,
+                                       bool handshake_was_done) noexcept {
+  const auto now = std::chrono::steady_clock::now();
+  forwarded_bytes_up_.store(bytes_up_, std::memory_order_relaxed);
+  forwarded_bytes_down_.store(bytes_down_, std::memory_order_relaxed);
+  last_forwarded_at_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+  if (server_score_) {
+    server_score_->forwarded((bytes_up_ - bytes_up) + (bytes_down_ - bytes_down));
+    if (handshake_done_ && !handshake_was_done) judge_server_handshake(*server_score_, true);
+  }
+  if (handshake_done_ && !handshake_was_done) {
+    MYSQL_ROUTER_TRACE(handshake__done, context_.get_name().c_str(), client_socket_,
+        std::chrono::duration_cast<std::chrono::microseconds>(now - accepted_at_).count());
+  }
+
+  if (context_.get_metrics()) measure_forwarded(bytes_up, bytes_down, handshake_was_done, now);
+  if (trace_id_) trace_forwarded(bytes_up, bytes_down, handshake_was_done);
+}
+
+void MySQLRoutingConnection::measure_forwarded(size_t bytes_up, size_t bytes_down,
+                                               bool handshake_was_done,
+                                               std::chrono::steady_clock::time_point now) noexcept {
+  RoutingMetrics &metrics = *context_.get_metrics();
+  if (handshake_done_ && !handshake_was_done) {
+    metrics.add_latency(RoutingMetrics::Latency::kHandshake,
+                        std::chrono::duration_cast<std::chrono::microseconds>(now - accepted_at_));
+    return;
+  }
+  if (!handshake_was_done) return;
+
+  // the client waits for the response before it sends the next request,
+  // bytes_up_ counts what the server sent
+  if (request_sent_at_ != std::chrono::steady_clock::time_point() && bytes_up_ != bytes_up) {
+    metrics.add_latency(RoutingMetrics::Latency::kRoundTrip,
+                        std::chrono::duration_cast<std::chrono::microseconds>(now - request_sent_at_));
+    request_sent_at_ = std::chrono::steady_clock::time_point();
+  } else if (request_sent_at_ == std::chrono::steady_clock::time_point() && bytes_down_ != bytes_down &&
+             bytes_up_ == bytes_up) {
+    request_sent_at_ = now;
+  }
 }
 
-const std::string& MySQLRoutingConnection::get_client_address() const {
-  return client_address_;
+void MySQLRoutingConnection::trace_forwarded(size_t bytes_up, size_t bytes_down,
+                                             bool handshake_was_done) noexcept {
+  ConnectionTrace& connection_trace = ConnectionTrace::getInstance();
+  const uint64_t now = ConnectionTrace::now();
+  // bytes_up_ counts what the server sent
+  if (bytes_up_ != bytes_up) {
+    if (last_byte_from_server_ == 0) {
+      connection_trace.record(trace_id_, ConnectionTrace::Event::kFirstByteFromServer, now);
+    }
+    last_byte_from_server_ = now;
+  }
+  if (bytes_down_ != bytes_down) {
+    if (last_byte_from_client_ == 0) {
+      connection_trace.record(trace_id_, ConnectionTrace::Event::kFirstByteFromClient, now);
+    }
+    last_byte_from_client_ = now;
+  }
+  if (handshake_done_ && !handshake_was_done) {
+    connection_trace.record(trace_id_, ConnectionTrace::Event::kHandshakeDone, now);
+  }
 }
 
-std::string MySQLRoutingConnection::make_client_address(int client_socket, const MySQLRoutingContext& context) {
-  std::pair<std::string, int> c_ip = get_peer_name(client_socket);
+bool MySQLRoutingConnection::forward_traffic(bool client_is_readable, bool server_is_readable,
+                                             bool client_is_writable, bool server_is_writable) {
+  if (relaying_handshake_) {
+    return relay_handshake(client_is_readable, server_is_readable);
+  }
 
-  if (c_ip.second == 0) {
-    // Unix socket/Windows Named pipe
-    return context.get_bind_named_socket().c_str();
+  if (zero_copy_sender_ && client_is_readable && zero_copy_sender_->reap(client_socket_) > 0) {
+    // completions report the socket readable too, read() would block if
+    // that was all
+    struct pollfd fds[] = {{client_socket_, POLLIN, 0}};
+    client_is_readable = context_.get_socket_operations()->poll(fds, 1, std::chrono::milliseconds(0)) > 0 &&
+                         (fds[0].revents & (POLLIN | POLLHUP)) != 0;
+  }
+
+  if (client_is_writable && !flush_output_queue(client_socket_, client_queue_, "server->client")) {
+    return false;
+  }
+  if (server_is_writable && !flush_output_queue(server_socket_, server_queue_, "client->server")) {
+    return false;
+  }
+
+  bool connection_is_ok = true;
+  std::size_t bytes_read = 0;
+  // borrowed on first use and returned at the end of the call
+  RoutingBufferPool::Lease buffer;
+
+  // Handle traffic from Server to Client
+  // Note: In classic protocol Server _always_ talks first
+  if (copy_packets(server_socket_, client_socket_, server_is_readable, buffer, &bytes_read, true) == -1) {
+    const int last_errno = context_.get_socket_operations()->get_errno();
+    if (last_errno > 0) {
+      // if read() against closed socket, errno will be 0. Don't log that.
+      extra_msg_ = std::string("Copy server->client failed: " + mysqlrouter::to_string(get_message_error(last_errno)));
+    }
+    if (!handshake_done_) server_failed_handshake_ = true;
+
+    connection_is_ok = false;
+  } else {
+    bytes_up_ += bytes_read;
+    if (bytes_read > 0) {
+      read_buffer_size_.update(bytes_read);
+      MYSQL_ROUTER_TRACE(forwarded, context_.get_name().c_str(), client_socket_, bytes_read, 1);
+    }
+    if (bytes_read > 0 && !handshake_done_) {
+      handshake_waits_for_server_ = false;
+      // the server sent an error instead of its greeting, like too many connections
+      if (pktnr_ == 2 && bytes_down_ == 0 && server_score_ &&
+          context_.get_protocol().get_type() == BaseProtocol::Type::kClassicProtocol) {
+        judge_server_handshake(*server_score_, false);
+      }
+    }
+  }
+
+  // Handle traffic from Client to Server
+  if (copy_packets(client_socket_, server_socket_, client_is_readable, buffer, &bytes_read, false) == -1) {
+    const int last_errno = context_.get_socket_operations()->get_errno();
+    // with kernel TLS, alerts like close_notify fail the read with EIO
+    if (last_errno > 0 && !(client_kernel_tls_ && last_errno == EIO)) {
+      extra_msg_ = std::string("Copy client->server failed: " + mysqlrouter::to_string(get_message_error(last_errno)));
+    } else if (!handshake_done_) {
+      extra_msg_ = std::string("Copy client->server failed: unexpected connection close");
+    }
+    // client close on us.
+    connection_is_ok = false;
   } else {
-    std::ostringstream oss;
-    oss << c_ip.first.c_str() << ":" << c_ip.second;
-    return oss.str();
+    bytes_down_ += bytes_read;
+    if (bytes_read > 0) {
+      read_buffer_size_.update(bytes_read);
+      MYSQL_ROUTER_TRACE(forwarded, context_.get_name().c_str(), client_socket_, bytes_read, 0);
+    }
+    if (bytes_read > 0 && !handshake_done_) handshake_waits_for_server_ = true;
+  }
+
+  update_read_pause(client_queue_, server_reads_paused_);
+  update_read_pause(server_queue_, client_reads_paused_);
+
+  return connection_is_ok;
+}
+
+bool MySQLRoutingConnection::wants_to_read(int socket) const noexcept {
+  return socket == client_socket_ ? !client_reads_paused_ : !server_reads_paused_;
+}
+
+bool MySQLRoutingConnection::wants_to_write(int socket) const noexcept {
+  return socket == client_socket_ ? !client_queue_.empty() : !server_queue_.empty();
+}
+
+bool MySQLRoutingConnection::flush_output_queue(int receiver, OutputQueue& queue,
+                                                const char* direction) {
+  if (queue.flush(receiver) < 0) {
+    extra_msg_ = std::string("Copy ") + direction + " failed: " +
+                 mysqlrouter::to_string(get_message_error(errno));
+    return false;
+  }
+
+  return true;
+}
+
+void MySQLRoutingConnection::update_read_pause(const OutputQueue& queue,
+                                               bool& reads_paused) noexcept {
+  if (queue.size() >= context_.get_output_queue_high_watermark() && !queue.empty()) {
+    reads_paused = true;
+  } else if (queue.size() <= context_.get_output_queue_low_watermark()) {
+    reads_paused = false;
+  }
+}
+
+int MySQLRoutingConnection::copy_packets_queued(int sender, int receiver, bool sender_is_readable,
+                                                RoutingBufferPool::Lease& buffer, OutputQueue& queue,
+                                                size_t *report_bytes_read) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+
+  // a paused sender is only reported readable when it got closed, read()
+  // tells about that
+  if (!sender_is_readable) return 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+
+  ssize_t res = so->read(sender, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
   }
+  *report_bytes_read = static_cast<size_t>(res);
+  sample_query_digests(read_buffer, *report_bytes_read, &queue == &client_queue_, true);
+  if (mirror_session_ && &queue == &server_queue_) {
+    mirror_session_->client_data(&read_buffer[0], *report_bytes_read);
+  }
+
+  size_t sent = 0;
+  // kernel TLS doesn't take MSG_ZEROCOPY
+  if (zero_copy_sender_ && &queue == &client_queue_ && !client_tls_ && queue.empty() &&
+      zero_copy_sender_->wants(*report_bytes_read)) {
+    // the buffer is kept until the kernel is done with it
+    const ssize_t zc_res = (buffer && (*buffer).data() == read_buffer.data())
+        ? zero_copy_sender_->send(receiver, &read_buffer[0], *report_bytes_read, buffer)
+        : zero_copy_sender_->send(receiver, &read_buffer[0], *report_bytes_read, large_buffer_);
+    if (zc_res < 0) return -1;
+    sent = static_cast<size_t>(zc_res);
+    if (sent == *report_bytes_read) return 0;
+  }
+
+  return queue.send(receiver, &read_buffer[sent], *report_bytes_read - sent) < 0 ? -1 : 0;
+}
+
+bool MySQLRoutingConnection::relay_handshake(bool client_is_readable, bool server_is_readable) {
+  using namespace mysql_protocol;
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const std::chrono::milliseconds timeout = context_.get_client_connect_timeout();
+  RoutingProtocolBuffer packet;
+
+  if (server_is_readable) {
+    if (!classic_handshake::read_packet(so, server_socket_, packet, timeout)) {
+      if (so->get_errno() > 0) {
+        extra_msg_ = std::string("Copy server->client failed: " + mysqlrouter::to_string(get_message_error(so->get_errno())));
+      }
+      server_failed_handshake_ = true;
+      return false;
+    }
+    handshake_waits_for_server_ = false;
+
+    classic_handshake::ServerGreeting greeting;
+    if (context_.is_server_compression() && packet[3] == 0 &&
+        classic_handshake::parse_server_greeting(packet, greeting, false) &&
+        greeting.capabilities.test(Capabilities::COMPRESS)) {
+      server_compression_.reset(new ClassicCompression());
+    }
+
+    packet[3] = static_cast<uint8_t>(packet[3] + relay_seq_offset_);
+    if (!write_to_client(&packet[0], packet.size())) {
+      extra_msg_ = std::string("Copy server->client failed: " + mysqlrouter::to_string(get_message_error(so->get_errno())));
+      return false;
+    }
+    bytes_up_ += packet.size();
+
+    // OK or error packet ends the handshake, error packets don't count as failed handshake
+    const uint8_t packet_type = packet.size() > Packet::kHeaderSize ? packet[Packet::kHeaderSize] : 0xfe;
+    // an error instead of the greeting is the server's failure, like too many connections
+    if (packet_type == 0xff && bytes_down_ == 0 && server_score_) {
+      judge_server_handshake(*server_score_, false);
+    }
+    if (packet_type == 0x00 || packet_type == 0xff) {
+      relaying_handshake_ = false;
+      handshake_done_ = true;
+      // the server compresses everything after the OK
+      server_compressed_ = packet_type == 0x00 && server_compression_;
+      if (server_compressed_) {
+        log_debug("[%s] fd=%d compressing traffic to the server", context_.get_name().c_str(), client_socket_);
+      }
+      poolable_ = packet_type == 0x00 && backend_pool_ != nullptr && session_.capabilities != 0 &&
+                  !session_.scramble.empty() &&
+                  !Capabilities::Flags(session_.capabilities).test(Capabilities::COMPRESS);
+      return true;
+    }
+  }
+
+  if (client_is_readable) {
+    const bool read_ok = client_tls_ ? client_tls_->read_packet(packet, timeout)
+                                     : classic_handshake::read_packet(so, client_socket_, packet, timeout);
+    if (!read_ok) {
+      if (client_tls_) {
+        extra_msg_ = std::string("Copy client->server failed: TLS read failed");
+      } else if (so->get_errno() > 0) {
+        extra_msg_ = std::string("Copy client->server failed: " + mysqlrouter::to_string(get_message_error(so->get_errno())));
+      } else {
+        extra_msg_ = std::string("Copy client->server failed: unexpected connection close");
+      }
+      return false;
+    }
+
+    if (client_tls_offered_ && !client_tls_ && packet[3] == 1 &&
+        classic_handshake::is_ssl_request(packet)) {
+      bytes_down_ += packet.size();
+      return accept_client_tls();
+    }
+    // the server sees the handshake response of a plain text client
+    if (client_tls_ && packet[3] == 2) classic_handshake::strip_ssl_request(packet);
+
+    if (server_compression_ && packet[3] == 1 && !request_server_compression(packet)) {
+      // TLS of the client passes through, the rest of the traffic is copied
+      relaying_handshake_ = false;
+      handshake_done_ = true;
+      if (so->write_all(server_socket_, &packet[0], packet.size()) < 0) {
+        extra_msg_ = std::string("Copy client->server failed: " + mysqlrouter::to_string(get_message_error(so->get_errno())));
+        return false;
+      }
+      bytes_down_ += packet.size();
+      return true;
+    }
+
+    if (relay_seq_offset_ == 0 && packet[3] == 1) {
+      // handshake response to the greeting of the server
+      classic_handshake::ClientHandshake handshake;
+      if (classic_handshake::parse_handshake_response(packet, handshake)) {
+        if (handshake.capabilities.test(Capabilities::SSL)) {
+          extra_msg_ = std::string("SSL is not supported with pooled server connections");
+          return false;
+        }
+        session_.capabilities = handshake.capabilities.bits();
+      }
+      if (splitter_) take_client_handshake(packet, packet.size());
+    }
+
+    packet[3] = static_cast<uint8_t>(packet[3] - relay_seq_offset_);
+    if (so->write_all(server_socket_, &packet[0], packet.size()) < 0) {
+      extra_msg_ = std::string("Copy client->server failed: " + mysqlrouter::to_string(get_message_error(so->get_errno())));
+      return false;
+    }
+    bytes_down_ += packet.size();
+    handshake_waits_for_server_ = true;
+  }
+
+  return true;
+}
+
+bool MySQLRoutingConnection::request_server_compression(RoutingProtocolBuffer& packet) {
+  using namespace mysql_protocol;
+
+  if (classic_handshake::is_ssl_request(packet)) {
+    server_compression_.reset();
+    return false;
+  }
+
+  classic_handshake::ClientHandshake handshake;
+  if (!classic_handshake::parse_handshake_response(packet, handshake) ||
+      handshake.capabilities.test(Capabilities::COMPRESS)) {
+    // clients compressing themselves are passed through
+    server_compression_.reset();
+    return true;
+  }
+
+  // COMPRESS is in the lowest byte of the capabilities
+  packet[Packet::kHeaderSize] = static_cast<uint8_t>(packet[Packet::kHeaderSize] | Capabilities::COMPRESS.bits());
+  return true;
+}
+
+int MySQLRoutingConnection::copy_compressed_packets(bool sender_is_readable, RoutingBufferPool::Lease& buffer,
+                                                    size_t *report_bytes_read, bool from_server) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+  if (!sender_is_readable) return 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+  const ssize_t res = so->read(from_server ? server_socket_ : client_socket_, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  if (!from_server) {
+    server_compression_->compress(&read_buffer[0], bytes_read, compression_buffer_);
+    return so->write_all(server_socket_, &compression_buffer_[0], compression_buffer_.size()) < 0 ? -1 : 0;
+  }
+
+  if (!server_compression_->decompress(&read_buffer[0], bytes_read, compression_buffer_)) {
+    extra_msg_ = "invalid compressed packet from server";
+    so->set_errno(0);
+    return -1;
+  }
+  if (compression_buffer_.empty()) return 0;
+  return so->write_all(client_socket_, &compression_buffer_[0], compression_buffer_.size()) < 0 ? -1 : 0;
+}
+
+bool MySQLRoutingConnection::negotiate_x_compression() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  RoutingProtocolBuffer request = XProtocol::make_compression_request(XCompression::kAlgorithm);
+  RoutingProtocolBuffer response;
+  if (so->write_all(server_socket_, &request[0], request.size()) < 0 ||
+      !x_handshake::read_response(so, server_socket_, response, context_.get_destination_connect_timeout())) {
+    log_warning("[%s] fd=%d failed asking the server for compression: %s", context_.get_name().c_str(),
+        server_socket_, get_message_error(so->get_errno()).c_str());
+    return false;
+  }
+
+  if (x_handshake::get_type(response) != x_handshake::kOk) {
+    log_debug("[%s] fd=%d server refused compression, the connection stays uncompressed",
+        context_.get_name().c_str(), server_socket_);
+    return true;
+  }
+  x_compression_.reset(new XCompression());
+
+  return true;
+}
+
+int MySQLRoutingConnection::copy_x_compressed_messages(bool sender_is_readable, RoutingBufferPool::Lease& buffer,
+                                                       size_t *report_bytes_read, bool from_server) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+  if (!sender_is_readable) return 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+  const ssize_t res = so->read(from_server ? server_socket_ : client_socket_, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  if (!from_server) {
+    x_compression_->frame_client(&read_buffer[0], bytes_read, x_messages_);
+    if (!x_authenticated_ && !filter_x_client_messages(x_messages_)) return -1;
+    if (x_messages_.empty()) return 0;
+
+    x_compression_->compress(&x_messages_[0], x_messages_.size(), compression_buffer_);
+    return so->write_all(server_socket_, &compression_buffer_[0], compression_buffer_.size()) < 0 ? -1 : 0;
+  }
+
+  if (!x_compression_->decompress(&read_buffer[0], bytes_read, compression_buffer_)) {
+    extra_msg_ = "invalid compressed message from server";
+    so->set_errno(0);
+    return -1;
+  }
+  if (!x_authenticated_) filter_x_server_messages(compression_buffer_);
+  if (compression_buffer_.empty()) return 0;
+  return so->write_all(client_socket_, &compression_buffer_[0], compression_buffer_.size()) < 0 ? -1 : 0;
+}
+
+bool MySQLRoutingConnection::filter_x_client_messages(RoutingProtocolBuffer& messages) {
+  RoutingProtocolBuffer passed;
+  for (size_t pos = 0; pos < messages.size();) {
+    const size_t frame_size = x_handshake::frame_size(&messages[pos]);
+    if (frame_size < x_handshake::kHeaderSize) {
+      log_warning("[%s] fd=%d X protocol message without type", context_.get_name().c_str(), client_socket_);
+      return false;
+    }
+    const uint8_t type = messages[pos + x_handshake::kHeaderSize - 1];
+    const uint8_t* payload = &messages[pos + x_handshake::kHeaderSize];
+    const size_t payload_size = frame_size - x_handshake::kHeaderSize;
+
+    // the first message is checked like XProtocol::copy_packets() does
+    if (!handshake_done_) {
+      if (!XProtocol::is_valid_handshake_message(type, payload, payload_size)) {
+        log_warning("[%s] fd=%d invalid X protocol message from the client while handshaking: type(%u), size(%zu)",
+            context_.get_name().c_str(), client_socket_, static_cast<unsigned>(type), payload_size);
+        return false;
+      }
+      handshake_done_ = true;
+    }
+
+    const char* refused = nullptr;
+    if (type == x_handshake::kCapabilitiesSet) {
+      if (XProtocol::sets_capability(payload, payload_size, "tls")) {
+        refused = "tls";
+      } else if (XProtocol::sets_capability(payload, payload_size, "compression")) {
+        refused = "compression";
+      }
+    }
+    if (refused) {
+      // ER_X_CAPABILITIES_PREPARE_FAILED
+      context_.get_protocol().send_error(client_socket_, 5001,
+          std::string("Capability prepare failed for '") + refused + "'", "HY000", context_.get_name());
+    } else {
+      passed.insert(passed.end(), messages.begin() + static_cast<std::ptrdiff_t>(pos),
+                    messages.begin() + static_cast<std::ptrdiff_t>(pos + frame_size));
+    }
+    pos += frame_size;
+  }
+  messages.swap(passed);
+
+  return true;
+}
+
+void MySQLRoutingConnection::filter_x_server_messages(RoutingProtocolBuffer& messages) {
+  static const std::vector<std::string> kHidden{"tls", "compression"};
+
+  RoutingProtocolBuffer passed;
+  RoutingProtocolBuffer message;
+  for (size_t pos = 0; pos < messages.size();) {
+    const size_t frame_size = x_handshake::frame_size(&messages[pos]);
+    message.assign(messages.begin() + static_cast<std::ptrdiff_t>(pos),
+                   messages.begin() + static_cast<std::ptrdiff_t>(pos + frame_size));
+    if (frame_size >= x_handshake::kHeaderSize) {
+      const uint8_t type = message[x_handshake::kHeaderSize - 1];
+      if (type == x_handshake::kCapabilities) XProtocol::remove_capabilities(message, kHidden);
+      if (type == x_handshake::kAuthenticateOk) x_authenticated_ = true;
+    }
+    passed.insert(passed.end(), message.begin(), message.end());
+    pos += frame_size;
+  }
+  messages.swap(passed);
+}
+
+bool MySQLRoutingConnection::offer_client_tls() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  RoutingProtocolBuffer greeting;
+  if (!classic_handshake::read_packet(so, server_socket_, greeting,
+                                      context_.get_destination_connect_timeout())) {
+    server_failed_handshake_ = true;
+    return false;
+  }
+
+  // errors of the server are passed to the client as they are
+  const bool greeting_ok = classic_handshake::offer_ssl(greeting);
+  if (!greeting_ok) server_failed_handshake_ = true;
+  if (so->write_all(client_socket_, &greeting[0], greeting.size()) < 0 || !greeting_ok) {
+    return false;
+  }
+  bytes_up_ += greeting.size();
+
+  relaying_handshake_ = true;
+  handshake_waits_for_server_ = false;
+  client_tls_offered_ = true;
+  return true;
+}
+
+bool MySQLRoutingConnection::accept_client_tls() {
+  client_tls_.reset(new TlsServerContext::Session(*context_.get_client_tls_context()));
+  if (!client_tls_->accept(client_socket_, context_.get_client_connect_timeout())) {
+    extra_msg_ = "TLS handshake with client failed";
+    client_tls_.reset();
+    return false;
+  }
+
+  client_kernel_tls_ = client_tls_->is_kernel_send() && client_tls_->is_kernel_recv();
+  log_debug("[%s] fd=%d TLS started%s%s", context_.get_name().c_str(), client_socket_,
+      client_tls_->is_resumed() ? ", session resumed" : "",
+      client_kernel_tls_ ? ", kernel TLS" : "");
+
+  // the client continues with sequence id 2, the server expects 1
+  relay_seq_offset_ = 1;
+  return true;
+}
+
+bool MySQLRoutingConnection::write_to_client(const uint8_t* data, size_t size) {
+  if (client_tls_) return client_tls_->write_all(data, size);
+
+  // write_all() doesn't modify the data
+  return context_.get_socket_operations()->write_all(client_socket_, const_cast<uint8_t*>(data), size) >= 0;
+}
+
+int MySQLRoutingConnection::copy_tls_packets(bool sender_is_readable, RoutingBufferPool::Lease& buffer,
+                                             size_t *report_bytes_read, bool from_server) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+  if (!sender_is_readable) return 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+
+  const ssize_t res = from_server ? so->read(server_socket_, &read_buffer[0], read_buffer.size())
+                                  : client_tls_->read(&read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes, TLS
+    // doesn't tell a close from a failed read
+    if (res == 0 || !from_server) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  if (!from_server) {
+    return so->write_all(server_socket_, &read_buffer[0], bytes_read) < 0 ? -1 : 0;
+  }
+
+  if (!client_tls_->write_all(&read_buffer[0], bytes_read)) {
+    extra_msg_ = "TLS write to client failed";
+    so->set_errno(0);
+    return -1;
+  }
+  return 0;
+}
+
+int MySQLRoutingConnection::copy_client_packets(RoutingBufferPool::Lease& buffer,
+                                                size_t *report_bytes_read) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+
+  ssize_t res = so->read(client_socket_, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  size_t forward_size = bytes_read;
+  const bool quit = track_client_packets(&read_buffer[0], bytes_read, forward_size) &&
+                    (forward_size == 0 || !use_output_queues_);
+  if (!quit) forward_size = bytes_read;
+
+  if (forward_size > 0) {
+    if (use_output_queues_) {
+      if (server_queue_.send(server_socket_, &read_buffer[0], forward_size) < 0) return -1;
+    } else if (so->write_all(server_socket_, &read_buffer[0], forward_size) < 0) {
+      return -1;
+    }
+  }
+
+  if (quit) {
+    // client quits, server connection stays open for the next client
+    park_server_ = true;
+    so->set_errno(0);
+    return -1;
+  }
+
+  return 0;
+}
+
+bool MySQLRoutingConnection::track_client_packets(const uint8_t* data, size_t size,
+                                                  size_t &quit_offset) {
+  const uint8_t* const begin = data;
+  bool quit = false;
+
+  ClassicPacketFramer::Frame frame;
+  while (client_framer_.next(data, size, frame)) {
+    // whole COM_QUIT packet, header included, in this read
+    quit = frame.starts_message && frame.is_first() && frame.is_complete() &&
+           frame.payload_size == 1 && frame.payload[0] == kComQuit &&
+           frame.payload - begin >= static_cast<std::ptrdiff_t>(mysql_protocol::Packet::kHeaderSize);
+    if (quit) {
+      quit_offset = static_cast<size_t>(frame.payload - begin) - mysql_protocol::Packet::kHeaderSize;
+    }
+  }
+
+  return quit && client_framer_.at_packet_boundary();
+}
+
+int MySQLRoutingConnection::copy_x_client_messages(RoutingBufferPool::Lease& buffer,
+                                                   size_t *report_bytes_read) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+
+  ssize_t res = so->read(client_socket_, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  size_t last_offset = bytes_read;
+  if (!x_handshake::follow_frames(&read_buffer[0], bytes_read, client_frame_skip_, last_offset)) {
+    // a frame header got cut off, the end of the session can't be told anymore
+    poolable_ = false;
+  }
+  // whole Session.Close at the end of the read
+  const bool close_session = poolable_ && client_frame_skip_ == 0 &&
+                             bytes_read - last_offset == x_handshake::kHeaderSize &&
+                             read_buffer[bytes_read - 1] == x_handshake::kSessionClose;
+  const size_t forward_size = close_session ? last_offset : bytes_read;
+
+  if (forward_size > 0) {
+    if (use_output_queues_) {
+      if (server_queue_.send(server_socket_, &read_buffer[0], forward_size) < 0) return -1;
+    } else if (so->write_all(server_socket_, &read_buffer[0], forward_size) < 0) {
+      return -1;
+    }
+  }
+
+  if (close_session) {
+    // answered like the server would before closing the connection, which
+    // stays open for the next client
+    RoutingProtocolBuffer ok = x_handshake::make_message(x_handshake::kOk);
+    so->write_all(client_socket_, &ok[0], ok.size());
+    park_server_ = true;
+    so->set_errno(0);
+    return -1;
+  }
+
+  return 0;
+}
+
+int MySQLRoutingConnection::copy_packets(int sender, int receiver, bool sender_is_readable,
+                                         RoutingBufferPool::Lease& buffer,
+                                         size_t *report_bytes_read, bool from_server) {
+  // with kernel TLS, what OpenSSL read ahead is taken first
+  if (client_tls_ && handshake_done_ && (!client_kernel_tls_ || client_tls_->has_pending())) {
+    return copy_tls_packets(sender_is_readable, buffer, report_bytes_read, from_server);
+  }
+
+  if (server_compressed_) {
+    return copy_compressed_packets(sender_is_readable, buffer, report_bytes_read, from_server);
+  }
+
+  if (x_compression_) {
+    return copy_x_compressed_messages(sender_is_readable, buffer, report_bytes_read, from_server);
+  }
+
+  if (splitter_ && handshake_done_ && sender_is_readable) {
+    return from_server ? copy_primary_packets(buffer, report_bytes_read)
+                       : copy_client_commands(buffer, report_bytes_read);
+  }
+
+  if (poolable_ && !from_server && sender_is_readable) {
+    // packets are inspected to detect COM_QUIT, messages to detect Session.Close
+    return context_.get_protocol().get_type() == BaseProtocol::Type::kXProtocol
+               ? copy_x_client_messages(buffer, report_bytes_read)
+               : copy_client_packets(buffer, report_bytes_read);
+  }
+
+  if (handshake_done_ && use_output_queues_) {
+    return copy_packets_queued(sender, receiver, sender_is_readable, buffer,
+                               from_server ? client_queue_ : server_queue_,
+                               report_bytes_read);
+  }
+
+  if (handshake_done_ && splice_forwarder_ && splice_forwarder_->is_usable() &&
+      !(poolable_ && !from_server)) {
+    *report_bytes_read = 0;
+    if (!sender_is_readable) return 0;
+
+    ssize_t res = splice_forwarder_->forward(sender, receiver, context_.get_net_buffer_length());
+    if (res > 0) {
+      *report_bytes_read = static_cast<size_t>(res);
+      return 0;
+    }
+    if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // readable, yet nothing to read, like 0 bytes read
+      return 0;
+    }
+    if (res == 0 || splice_forwarder_->is_usable()) {
+      return -1;
+    }
+
+    log_debug("[%s] fd=%d splice() not supported, falling back to copying: %s",
+        context_.get_name().c_str(), client_socket_,
+        get_message_error(context_.get_socket_operations()->get_errno()).c_str());
+  }
+
+  if (!sender_is_readable) {
+    // nothing is read, no need to borrow a buffer
+    return context_.get_protocol().copy_packets(sender, receiver, sender_is_readable,
+                                                empty_buffer_, &pktnr_, handshake_done_,
+                                                report_bytes_read, from_server);
+  }
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+  const bool handshake_was_done = handshake_done_;
+  const int res = context_.get_protocol().copy_packets_resumable(
+      sender, receiver, sender_is_readable, read_buffer, &pktnr_, handshake_done_,
+      report_bytes_read, from_server, from_server ? server_partial_packet_ : client_partial_packet_);
+  if (splitter_ && res == 0 && !from_server && !handshake_done_) {
+    take_client_handshake(read_buffer, *report_bytes_read);
+  }
+  if (res == 0 && context_.get_query_digest_stats()) {
+    sample_query_digests(read_buffer, *report_bytes_read, from_server, handshake_was_done);
+  }
+  if (res == 0 && !from_server && context_.get_traffic_mirror()) {
+    mirror_client_data(read_buffer, *report_bytes_read, handshake_was_done);
+  }
+
+  return res;
+}
+
+void MySQLRoutingConnection::sample_query_digests(RoutingBufferRef buffer, size_t size,
+                                                  bool from_server, bool handshake_was_done) {
+  using namespace mysql_protocol;
+
+  if (handshake_was_done) {
+    if (!digest_sampler_) return;
+    if (from_server) {
+      digest_sampler_->server_data(&buffer[0], size);
+    } else {
+      digest_sampler_->client_data(&buffer[0], size);
+    }
+    return;
+  }
+
+  // only the handshake response has sequence id 1
+  if (from_server || digest_sampler_ || splitter_ || !context_.get_query_digest_stats() ||
+      size <= Packet::kHeaderSize || buffer[3] != 1) {
+    return;
+  }
+
+  const size_t kHeaderSize = Packet::kHeaderSize;
+  const size_t packet_size = std::min(size, kHeaderSize + Packet::read_payload_size(&buffer[0]));
+  classic_handshake::ClientHandshake handshake;
+  if (classic_handshake::parse_handshake_response(
+          RoutingProtocolBuffer(buffer.begin(), buffer.begin() + static_cast<long>(packet_size)), handshake) &&
+      !handshake.capabilities.test(Capabilities::SSL) && !handshake.capabilities.test(Capabilities::COMPRESS)) {
+    digest_sampler_.reset(new QueryDigestSampler(context_.get_query_digest_stats(),
+                                                 context_.get_query_digest_sampling(),
+                                                 handshake.capabilities.test(Capabilities::DEPRECATE_EOF)));
+  }
+}
+
+void MySQLRoutingConnection::mirror_client_data(RoutingBufferRef buffer, size_t size,
+                                                bool handshake_was_done) {
+  if (handshake_was_done) {
+    if (mirror_session_) mirror_session_->client_data(&buffer[0], size);
+    return;
+  }
+
+  // only the handshake response has sequence id 1
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  if (mirror_session_ || splitter_ || size <= kHeaderSize || buffer[3] != 1) return;
+
+  const size_t packet_size = std::min(size, kHeaderSize + mysql_protocol::Packet::read_payload_size(&buffer[0]));
+  mirror_session_ = context_.get_traffic_mirror()->open_session(
+      RoutingProtocolBuffer(buffer.begin(), buffer.begin() + static_cast<long>(packet_size)));
+  if (!mirror_session_) {
+    log_debug("[%s] fd=%d not mirrored, client session not supported",
+        context_.get_name().c_str(), client_socket_);
+  }
+}
+
+void MySQLRoutingConnection::take_client_handshake(RoutingBufferRef buffer, size_t size) {
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  // only the handshake response has sequence id 1
+  if (size <= kHeaderSize || buffer[3] != 1) return;
+
+  const size_t packet_size = std::min(size, kHeaderSize + mysql_protocol::Packet::read_payload_size(&buffer[0]));
+  if (!splitter_->set_client_handshake(RoutingProtocolBuffer(buffer.begin(),
+                                                             buffer.begin() + static_cast<long>(packet_size)))) {
+    log_debug("[%s] fd=%d reads are not split, client session not supported",
+        context_.get_name().c_str(), client_socket_);
+    splitter_.reset();
+    statements_.reset();
+  }
+}
+
+int MySQLRoutingConnection::copy_primary_packets(RoutingBufferPool::Lease& buffer,
+                                                 size_t *report_bytes_read) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+
+  ssize_t res = so->read(server_socket_, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  splitter_->primary_data(&read_buffer[0], bytes_read);
+
+  if (so->write_all(client_socket_, &read_buffer[0], bytes_read) < 0) return -1;
+
+  if (multiplexing_ && poolable_ && splitter_->can_release_primary()) release_server();
+
+  return 0;
+}
+
+int MySQLRoutingConnection::copy_client_commands(RoutingBufferPool::Lease& buffer,
+                                                 size_t *report_bytes_read) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  *report_bytes_read = 0;
+
+  RoutingBufferRef read_buffer = get_read_buffer(buffer);
+
+  ssize_t res = so->read(client_socket_, &read_buffer[0], read_buffer.size());
+  if (res <= 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    if (res == 0) so->set_errno(0);
+    return -1;
+  }
+  const size_t bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+
+  size_t quit_offset = 0;
+  if (poolable_ && track_client_packets(&read_buffer[0], bytes_read, quit_offset) &&
+      quit_offset == 0) {
+    // client quits, server connection stays open for the next client
+    park_server_ = server_socket_ != routing::kInvalidSocket;
+    so->set_errno(0);
+    return -1;
+  }
+
+  if (statements_) return copy_client_statements(read_buffer, bytes_read, report_bytes_read);
+
+  return forward_commands(read_buffer, 0, bytes_read, bytes_read, nullptr);
+}
+
+int MySQLRoutingConnection::forward_commands(RoutingBufferRef buffer, size_t begin, size_t end,
+                                             size_t size, const std::string* statement) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  if (begin == end) return 0;
+
+  ReadWriteSplitter::Target target = splitter_->route(&buffer[begin], end - begin, statement);
+  if (target != ReadWriteSplitter::Target::kPrimary) {
+    RouteDestination* pool = target == ReadWriteSplitter::Target::kPool ? splitter_->get_pool() : nullptr;
+    if (pool != secondary_pool_) {
+      close_secondary();
+      secondary_pool_ = pool;
+    }
+  }
+  // a read after a write goes to the primary until the secondary applied the write
+  if (target == ReadWriteSplitter::Target::kSecondary && !splitter_->get_unapplied_gtids().empty()) {
+    if (secondary_applied_gtids()) {
+      splitter_->gtids_applied();
+    } else {
+      splitter_->secondary_behind();
+      target = ReadWriteSplitter::Target::kPrimary;
+    }
+  }
+
+  if (target != ReadWriteSplitter::Target::kPrimary) {
+    // the cache may hold results from before the session's writes
+    int result = target == ReadWriteSplitter::Target::kSecondary && context_.get_result_cache() &&
+                 !splitter_->has_written()
+                     ? query_result_cache(&buffer[begin], end - begin) : 1;
+    if (result <= 0) return result;
+
+    if (begin == 0 && end == size) {
+      result = query_secondary(buffer, end);
+    } else {
+      // the response is read into the buffer, which still holds further commands
+      RoutingProtocolBuffer command(buffer.begin() + static_cast<long>(begin),
+                                    buffer.begin() + static_cast<long>(end));
+      command.resize(buffer.size());
+      result = query_secondary(command, end - begin);
+    }
+    if (result <= 0) return result;
+
+    if (secondary_pool_) {
+      splitter_->pool_unavailable();
+    } else {
+      splitter_->secondary_unavailable();
+    }
+  }
+  if (splitter_->is_pinned()) close_secondary();
+
+  if (server_socket_ == routing::kInvalidSocket && !acquire_server()) {
+    so->set_errno(0);
+    return -1;
+  }
+
+  return so->write_all(server_socket_, &buffer[begin], end - begin) < 0 ? -1 : 0;
+}
+
+int MySQLRoutingConnection::copy_client_statements(RoutingBufferRef buffer, size_t size,
+                                                   size_t *report_bytes_read) {
+  using Translator = PreparedStatementTranslator;
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  ClassicPacketFramer& framer = statements_->client_framer();
+
+  size_t begin = 0;  // first byte not sent yet
+  size_t pos = 0;    // first byte not framed yet
+  const std::string* statement = nullptr;  // statement the command at begin refers to
+  std::string closed_sql;
+  while (pos < size) {
+    const ClassicPacketFramer framed = framer;
+    const size_t frame_begin = pos;
+    const uint8_t* data = &buffer[pos];
+    size_t left = size - pos;
+    ClassicPacketFramer::Frame frame;
+    const bool has_frame = framer.next(data, left, frame);
+    pos = size - left;
+
+    // sends the bytes before the packet at frame_begin and reads more of it
+    auto top_up = [&](size_t missing) {
+      if (forward_commands(buffer, begin, frame_begin, size, statement) != 0) return false;
+
+      std::memmove(&buffer[0], &buffer[frame_begin], size - frame_begin);
+      size -= frame_begin;
+      if (size + missing > buffer.size()) {
+        extra_msg_ = "Copy client->server failed: prepared statement command too large";
+        so->set_errno(0);
+        return false;
+      }
+      if (!classic_handshake::read_bytes(so, client_socket_, &buffer[size], missing,
+                                         context_.get_client_connect_timeout())) {
+        extra_msg_ = "Copy client->server failed: incomplete command";
+        return false;
+      }
+      // only part of a command, no COM_QUIT
+      size_t quit_offset;
+      track_client_packets(&buffer[size], missing, quit_offset);
+      size += missing;
+      *report_bytes_read += missing;
+      framer = framed;
+      begin = pos = 0;
+      statement = nullptr;
+      return true;
+    };
+
+    // a header at the end of the read: its payload is needed before anything of it is sent
+    if (!has_frame) {
+      if (!top_up(1)) return -1;
+      continue;
+    }
+
+    if (statements_->is_receiving_prepare()) {
+      statements_->prepare_sql().append(reinterpret_cast<const char*>(frame.payload), frame.length);
+      if (frame.is_complete() && !frame.is_continued()) {
+        if (forward_commands(buffer, begin, pos, size, statement) != 0) return -1;
+        begin = pos;
+        statement = nullptr;
+        statements_->set_receiving_prepare(false);
+        if (!finish_client_prepare()) return -1;
+      }
+      continue;
+    }
+
+    if (!frame.starts_message || !frame.is_first() || frame.sequence_id != 0 || frame.length == 0) continue;
+    const uint8_t cmd = frame.payload[0];
+    if (cmd != kComStmtPrepare && cmd != kComResetConnection && cmd != kComChangeUser &&
+        !Translator::refers_to_statement(cmd)) {
+      continue;
+    }
+
+    // command byte and statement id
+    const size_t head = std::min<size_t>(frame.payload_size, 5);
+    if (frame.length < head) {
+      if (!top_up(head - frame.length)) return -1;
+      continue;
+    }
+
+    if (forward_commands(buffer, begin, frame_begin, size, statement) != 0) return -1;
+    begin = frame_begin;
+    statement = nullptr;
+    if (server_socket_ == routing::kInvalidSocket && !acquire_server()) {
+      so->set_errno(0);
+      return -1;
+    }
+
+    uint8_t* const payload = &buffer[frame_begin + kHeaderSize];
+    if (cmd == kComResetConnection || cmd == kComChangeUser) {
+      // sessions without statements, the splitter pins the session
+      statements_->clear();
+      session_.statements.clear();
+      continue;
+    }
+
+    if (cmd == kComStmtPrepare) {
+      std::string& sql = statements_->prepare_sql();
+      sql.assign(reinterpret_cast<const char*>(payload) + 1, frame.length - 1);
+      statement = &sql;
+      if (!frame.is_complete() || frame.is_continued()) {
+        statements_->set_receiving_prepare(true);
+        continue;
+      }
+
+      const PreparedStatementCache::Statement* prepared = session_.statements.find(sql);
+      if (!prepared) {
+        if (forward_commands(buffer, begin, pos, size, statement) != 0) return -1;
+        begin = pos;
+        statement = nullptr;
+        if (!finish_client_prepare()) return -1;
+        continue;
+      }
+
+      // prepared in the session already, answered without the server
+      if (!forward_primary_responses()) return -1;
+      RoutingProtocolBuffer response = prepared->response;
+      Translator::write_id(&response[kHeaderSize + 1], statements_->add(sql, prepared->params));
+      if (!write_to_client(&response[0], response.size())) {
+        extra_msg_ = "Copy server->client failed: " +
+                     mysqlrouter::to_string(get_message_error(so->get_errno()));
+        so->set_errno(0);
+        return -1;
+      }
+      bytes_up_ += response.size();
+      begin = pos;
+      statement = nullptr;
+      continue;
+    }
+
+    Translator::Statement* client_statement = statements_->find(Translator::read_id(payload + 1));
+    if (!client_statement) {
+      // the server fails the command, or ignores it for COM_STMT_CLOSE
+      Translator::write_id(payload + 1, Translator::kInvalidId);
+      continue;
+    }
+
+    if (cmd == kComStmtClose) {
+      closed_sql = client_statement->sql;
+      statements_->erase(Translator::read_id(payload + 1));
+      // statements still used by the client stay prepared
+      uint32_t id = Translator::kInvalidId;
+      if (!statements_->uses(closed_sql)) session_.statements.erase(closed_sql, id);
+      Translator::write_id(payload + 1, id);
+      statement = &closed_sql;
+      continue;
+    }
+
+    const uint16_t params = client_statement->params;
+    const size_t flag = Translator::param_types_offset(params);
+    if (cmd == kComStmtExecute && params > 0) {
+      // new-params-bound flag and the parameter types following it
+      size_t needed = flag + 1;
+      if (frame.length > flag && payload[flag] == 1) needed += 2u * params;
+      needed = std::min(needed, frame.payload_size);
+      if (frame.length < needed) {
+        if (!top_up(needed - frame.length)) return -1;
+        continue;
+      }
+    }
+
+    PreparedStatementCache::Statement* prepared = session_.statements.find(client_statement->sql);
+    if (!prepared && !prepare_on_server(*client_statement, prepared)) return -1;
+
+    if (cmd == kComStmtExecute && params > 0 && frame.payload_size > flag) {
+      if (payload[flag] == 1 && frame.payload_size >= flag + 1 + 2u * params) {
+        client_statement->param_types.assign(payload + flag + 1, payload + flag + 1 + 2u * params);
+        prepared->param_types = client_statement->param_types;
+      } else if (payload[flag] == 0 && !client_statement->param_types.empty() &&
+                 prepared->param_types != client_statement->param_types) {
+        // the statement in the session was bound by someone else, or never
+        if (frame.is_continued() || kHeaderSize + frame.payload_size > buffer.size()) {
+          extra_msg_ = "Copy client->server failed: prepared statement command too large";
+          so->set_errno(0);
+          return -1;
+        }
+        if (!frame.is_complete()) {
+          if (!top_up(frame.payload_size - frame.length)) return -1;
+          continue;
+        }
+
+        Translator::write_id(payload + 1, prepared->id);
+        RoutingProtocolBuffer packet;
+        if (!Translator::add_param_types(&buffer[frame_begin], kHeaderSize + frame.payload_size, params,
+                                         client_statement->param_types, packet)) {
+          extra_msg_ = "Copy client->server failed: malformed COM_STMT_EXECUTE";
+          so->set_errno(0);
+          return -1;
+        }
+        prepared->param_types = client_statement->param_types;
+        if (forward_commands(packet, 0, packet.size(), packet.size(), &client_statement->sql) != 0) {
+          return -1;
+        }
+        begin = pos;
+        continue;
+      }
+    }
+
+    Translator::write_id(payload + 1, prepared->id);
+    statement = &client_statement->sql;
+  }
+
+  if (forward_commands(buffer, begin, size, size, statement) != 0) return -1;
+
+  // a COM_STMT_PREPARE answered by the router may leave the session clean
+  if (multiplexing_ && poolable_ && server_socket_ != routing::kInvalidSocket &&
+      splitter_->can_release_primary()) {
+    release_server();
+  }
+
+  return 0;
+}
+
+bool MySQLRoutingConnection::forward_primary_responses() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  if (splitter_->is_primary_idle()) return true;
+
+  RoutingProtocolBuffer buffer(context_.get_net_buffer_length());
+  while (!splitter_->is_primary_idle()) {
+    if (splitter_->is_primary_lost()) {
+      extra_msg_ = "Copy server->client failed: responses can't be followed for prepared statements";
+      so->set_errno(0);
+      return false;
+    }
+
+    struct pollfd fds[] = {
+      { server_socket_, POLLIN, 0 },
+    };
+    const int res = so->poll(fds, 1, std::chrono::milliseconds(1000));
+    if (res == 0 || (res < 0 && (so->get_errno() == EINTR || so->get_errno() == EAGAIN))) {
+      if (disconnect_) return false;
+      continue;
+    }
+
+    const ssize_t bytes_read = res < 0 ? -1 : so->read(server_socket_, &buffer[0], buffer.size());
+    if (bytes_read <= 0) {
+      extra_msg_ = "Copy server->client failed: " +
+                   (bytes_read < 0 ? mysqlrouter::to_string(get_message_error(so->get_errno()))
+                                   : std::string("unexpected connection close"));
+      so->set_errno(0);
+      return false;
+    }
+
+    splitter_->primary_data(&buffer[0], static_cast<size_t>(bytes_read));
+    if (!write_to_client(&buffer[0], static_cast<size_t>(bytes_read))) {
+      extra_msg_ = "Copy server->client failed: " +
+                   mysqlrouter::to_string(get_message_error(so->get_errno()));
+      so->set_errno(0);
+      return false;
+    }
+    bytes_up_ += static_cast<size_t>(bytes_read);
+  }
+
+  return true;
+}
+
+bool MySQLRoutingConnection::finish_client_prepare() {
+  using Translator = PreparedStatementTranslator;
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  if (!forward_primary_responses()) return false;
+
+  RoutingProtocolBuffer response;
+  if (!Translator::read_prepare_response(so, server_socket_, context_.get_destination_connect_timeout(),
+                                         splitter_->deprecates_eof(), response)) {
+    extra_msg_ = "Copy server->client failed: unexpected response to COM_STMT_PREPARE";
+    so->set_errno(0);
+    return false;
+  }
+
+  uint32_t id;
+  uint16_t params;
+  if (Translator::parse_prepare_ok(response, id, params)) {
+    const std::string& sql = statements_->prepare_sql();
+    if (session_.statements.find(sql)) {
+      // prepared twice, the session keeps one of them
+      RoutingProtocolBuffer close = Translator::make_close(id);
+      if (so->write_all(server_socket_, &close[0], close.size()) < 0) return false;
+    } else {
+      PreparedStatementCache::Statement prepared;
+      prepared.id = id;
+      prepared.params = params;
+      prepared.response = response;
+      cache_statement(sql, std::move(prepared));
+    }
+    Translator::write_id(&response[mysql_protocol::Packet::kHeaderSize + 1], statements_->add(sql, params));
+  }
+
+  if (!write_to_client(&response[0], response.size())) {
+    extra_msg_ = "Copy server->client failed: " +
+                 mysqlrouter::to_string(get_message_error(so->get_errno()));
+    so->set_errno(0);
+    return false;
+  }
+  bytes_up_ += response.size();
+
+  return true;
+}
+
+bool MySQLRoutingConnection::prepare_on_server(const PreparedStatementTranslator::Statement& statement,
+                                               PreparedStatementCache::Statement*& prepared) {
+  using Translator = PreparedStatementTranslator;
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  if (!forward_primary_responses()) return false;
+
+  RoutingProtocolBuffer response;
+  try {
+    RoutingProtocolBuffer packet = Translator::make_prepare(statement.sql);
+    if (so->write_all(server_socket_, &packet[0], packet.size()) < 0 ||
+        !Translator::read_prepare_response(so, server_socket_, context_.get_destination_connect_timeout(),
+                                           splitter_->deprecates_eof(), response)) {
+      extra_msg_ = "Preparing statement on server failed";
+      so->set_errno(0);
+      return false;
+    }
+  } catch (const mysql_protocol::packet_error &) {
+    extra_msg_ = "Preparing statement on server failed: statement too large";
+    so->set_errno(0);
+    return false;
+  }
+
+  uint32_t id;
+  uint16_t params;
+  if (!Translator::parse_prepare_ok(response, id, params) || params != statement.params) {
+    // the error answers the command of the client
+    if (response.size() > mysql_protocol::Packet::kHeaderSize &&
+        response[mysql_protocol::Packet::kHeaderSize] == 0xff) {
+      write_to_client(&response[0], response.size());
+    }
+    extra_msg_ = "Preparing statement on server failed";
+    so->set_errno(0);
+    return false;
+  }
+
+  PreparedStatementCache::Statement added;
+  added.id = id;
+  added.params = params;
+  added.response = std::move(response);
+  prepared = &cache_statement(statement.sql, std::move(added));
+  return true;
+}
+
+PreparedStatementCache::Statement& MySQLRoutingConnection::cache_statement(
+    const std::string& sql, PreparedStatementCache::Statement statement) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  uint32_t id;
+  while (session_.statements.size() >= context_.get_prepared_statement_cache_size() &&
+         session_.statements.evict([this](const std::string& used) { return statements_->uses(used); }, id)) {
+    // no response, the server just forgets about the statement
+    RoutingProtocolBuffer close = PreparedStatementTranslator::make_close(id);
+    so->write_all(server_socket_, &close[0], close.size());
+  }
+
+  return session_.statements.add(sql, std::move(statement));
+}
+
+int MySQLRoutingConnection::query_secondary(RoutingBufferRef buffer, size_t size) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  if (secondary_socket_ == routing::kInvalidSocket && !connect_secondary()) return 1;
+
+  if (so->write_all(secondary_socket_, &buffer[0], size) < 0) {
+    log_debug("[%s] fd=%d sending read to secondary failed: %s", context_.get_name().c_str(),
+        client_socket_, get_message_error(so->get_errno()).c_str());
+    close_secondary();
+    return 1;
+  }
+
+  // the client doesn't send anything before it got the response
+  bool forwarded = false;
+  auto deadline = std::chrono::steady_clock::now() + kSecondaryResponseTimeout;
+  while (!splitter_->is_secondary_idle()) {
+    if (splitter_->is_secondary_lost()) {
+      extra_msg_ = "Copy secondary->client failed: unexpected response";
+      so->set_errno(0);
+      return -1;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      close_secondary();
+      if (!forwarded) {
+        log_debug("[%s] fd=%d secondary didn't respond within %lds, using the primary",
+                  context_.get_name().c_str(), client_socket_,
+                  static_cast<long>(kSecondaryResponseTimeout.count()));
+        return 1;
+      }
+
+      extra_msg_ = "Copy secondary->client failed: response timed out";
+      so->set_errno(0);
+      return -1;
+    }
+
+    struct pollfd fds[] = {
+      { secondary_socket_, POLLIN, 0 },
+    };
+    const int res = so->poll(fds, 1, std::min(std::chrono::milliseconds(1000),
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1)));
+    if (res == 0 || (res < 0 && (so->get_errno() == EINTR || so->get_errno() == EAGAIN))) {
+      if (disconnect_) return -1;
+      continue;
+    }
+
+    const ssize_t bytes_read = res < 0 ? -1 : so->read(secondary_socket_, &buffer[0], buffer.size());
+    if (bytes_read <= 0) {
+      const int last_errno = bytes_read == 0 ? 0 : so->get_errno();
+      close_secondary();
+      if (!forwarded) return 1;
+
+      extra_msg_ = "Copy secondary->client failed: " +
+                   (last_errno > 0 ? mysqlrouter::to_string(get_message_error(last_errno))
+                                   : std::string("unexpected connection close"));
+      so->set_errno(0);
+      return -1;
+    }
+
+    splitter_->secondary_data(&buffer[0], static_cast<size_t>(bytes_read));
+    if (so->write_all(client_socket_, &buffer[0], static_cast<size_t>(bytes_read)) < 0) {
+      extra_msg_ = "Copy secondary->client failed: " +
+                   mysqlrouter::to_string(get_message_error(so->get_errno()));
+      so->set_errno(0);
+      return -1;
+    }
+    bytes_up_ += static_cast<size_t>(bytes_read);
+    forwarded = true;
+    deadline = std::chrono::steady_clock::now() + kSecondaryResponseTimeout;
+
+    if (!result_cache_key_.empty()) {
+      if (result_cache_response_.size() + static_cast<size_t>(bytes_read) >
+          context_.get_result_cache()->get_max_response_size()) {
+        result_cache_key_.clear();
+      } else {
+        result_cache_response_.insert(result_cache_response_.end(), buffer.begin(),
+                                      buffer.begin() + bytes_read);
+      }
+    }
+  }
+
+  // errors are not cached
+  if (!result_cache_key_.empty() && result_cache_response_[4] != 0xff) {
+    context_.get_result_cache()->add(result_cache_key_, std::move(result_cache_response_),
+                                     ResultCache::clock_type::now());
+  }
+  result_cache_key_.clear();
+
+  return 0;
+}
+
+int MySQLRoutingConnection::query_result_cache(const uint8_t* command, size_t size) {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  ResultCache& cache = *context_.get_result_cache();
+  result_cache_key_.clear();
+
+  // header and command byte, route() only sends complete COM_QUERYs to secondaries
+  const uint8_t* sql = command + 5;
+  const size_t sql_size = size - 5;
+  make_query_digest(sql, sql_size, result_cache_digest_);
+  if (!cache.is_allowed(result_cache_digest_)) return 1;
+
+  ResultCache::make_key(splitter_->get_session_key(), sql, sql_size, result_cache_key_);
+  std::shared_ptr<const ResultCache::Response> response =
+      cache.find(result_cache_key_, ResultCache::clock_type::now());
+  if (!response) {
+    result_cache_response_.clear();
+    return 1;
+  }
+  result_cache_key_.clear();
+
+  splitter_->secondary_data(response->data(), response->size());
+  // write_all() doesn't modify the buffer
+  if (so->write_all(client_socket_, const_cast<uint8_t*>(response->data()), response->size()) < 0) {
+    extra_msg_ = "Copy cache->client failed: " +
+                 mysqlrouter::to_string(get_message_error(so->get_errno()));
+    so->set_errno(0);
+    return -1;
+  }
+  bytes_up_ += response->size();
+
+  return 0;
+}
+
+bool MySQLRoutingConnection::secondary_applied_gtids() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  const std::string& gtids = splitter_->get_unapplied_gtids();
+
+  // ends up in a string literal: UUIDs, tags, numbers and separators only
+  for (const char c : gtids) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && !std::strchr("-_:,\n ", c)) return false;
+  }
+  if (secondary_socket_ == routing::kInvalidSocket && !connect_secondary()) return false;
+
+  const std::string sql = "SELECT GTID_SUBSET('" + gtids + "', @@GLOBAL.gtid_executed)";
+  const size_t payload_size = sql.size() + 1;
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload_size), static_cast<uint8_t>(payload_size >> 8),
+                               static_cast<uint8_t>(payload_size >> 16), 0, kComQuery};
+  packet.insert(packet.end(), sql.begin(), sql.end());
+  if (so->write_all(secondary_socket_, &packet[0], packet.size()) < 0) {
+    close_secondary();
+    return false;
+  }
+
+  // column count, column, EOF unless deprecated, the row and the end of the result set
+  const size_t packets = splitter_->deprecates_eof() ? 4 : 5;
+  bool applied = false;
+  for (size_t i = 0; i < packets; ++i) {
+    if (!classic_handshake::read_packet(so, secondary_socket_, packet,
+                                        context_.get_destination_connect_timeout())) {
+      close_secondary();
+      return false;
+    }
+    // an error ends the response
+    if (packet.size() <= kHeaderSize || packet[kHeaderSize] == 0xff) return false;
+
+    if (i == packets - 2) {
+      applied = packet.size() == kHeaderSize + 2 && packet[kHeaderSize] == 1 &&
+                packet[kHeaderSize + 1] == '1';
+    }
+  }
+
+  log_debug("[%s] fd=%d secondary fd=%d %s the writes of the session", context_.get_name().c_str(),
+      client_socket_, secondary_socket_, applied ? "applied" : "didn't apply yet");
+  return applied;
+}
+
+bool MySQLRoutingConnection::connect_secondary() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  mysql_harness::TCPAddress address;
+  const int sock = secondary_pool_ ? query_pool_connector_(*secondary_pool_, address)
+                                   : read_only_connector_(address);
+  if (sock < 0) return false;
+
+  if (!splitter_->authenticate(so, sock, context_.get_destination_connect_timeout())) {
+    log_debug("[%s] fd=%d reads are not split, authentication at %s failed",
+        context_.get_name().c_str(), client_socket_, address.str().c_str());
+    so->shutdown(sock);
+    so->close(sock);
+    return false;
+  }
+
+  log_debug("[%s] fd=%d reads go to %s as fd=%d", context_.get_name().c_str(),
+      client_socket_, address.str().c_str(), sock);
+  secondary_socket_ = sock;
+  return true;
+}
+
+void MySQLRoutingConnection::close_secondary() {
+  if (secondary_socket_ == routing::kInvalidSocket) return;
+
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  // best effort, lets the server end the session without complaining
+  uint8_t quit[] = {0x01, 0x00, 0x00, 0x00, kComQuit};
+  so->write_all(secondary_socket_, quit, sizeof(quit));
+  so->shutdown(secondary_socket_);
+  so->close(secondary_socket_);
+  secondary_socket_ = routing::kInvalidSocket;
+}
+
+void MySQLRoutingConnection::release_server() {
+  log_debug("[%s] fd=%d released server connection fd=%d", context_.get_name().c_str(),
+      client_socket_, server_socket_);
+
+  session_.socket = server_socket_;
+  session_.address = get_server_address();
+  session_.session_key = splitter_->get_session_key();
+  backend_pool_->release(session_);
+  session_.statements.clear();
+  server_socket_ = routing::kInvalidSocket;
+}
+
+bool MySQLRoutingConnection::acquire_server() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+
+  // the strategy picks the server, a session of the client's identity
+  // released to it saves the connect and the authentication
+  BackendConnectionPool::Connection connection;
+  BackendConnectionPool::Connection released;
+  {
+    RouteDestination::SessionReuse session_reuse([this, &released](const mysql_harness::TCPAddress& addr) {
+      return backend_pool_->take_session(addr, splitter_->get_session_key(), released) ? released.socket
+                                                                                      : routing::kInvalidSocket;
+    });
+    connection.socket = backend_connector_(connection.address);
+  }
+  if (connection.socket < 0) {
+    extra_msg_ = "Can't connect to remote MySQL server";
+    return false;
+  }
+
+  if (connection.socket == released.socket) {
+    connection.scramble = std::move(released.scramble);
+    connection.statements = std::move(released.statements);
+  } else {
+    if (!splitter_->authenticate(so, connection.socket, context_.get_destination_connect_timeout(),
+                                 &connection.scramble)) {
+      extra_msg_ = "Authentication at " + connection.address.str() + " failed";
+      so->shutdown(connection.socket);
+      so->close(connection.socket);
+      return false;
+    }
+  }
+
+  log_debug("[%s] fd=%d acquired server connection %s as fd=%d", context_.get_name().c_str(),
+      client_socket_, connection.address.str().c_str(), connection.socket);
+
+  session_.scramble = connection.scramble;
+  session_.statements = std::move(connection.statements);
+  server_changed(connection.socket, connection.address);
+
+  return true;
+}
+
+bool MySQLRoutingConnection::migrate_session() {
+  mysql_harness::SocketOperationsBase* const so = context_.get_socket_operations();
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+
+  std::vector<std::string> statements;
+  if (!handshake_done_ || !splitter_ || !backend_connector_ || !splitter_->can_replay_session() ||
+      !splitter_->get_replay_statements(statements)) {
+    extra_msg_ = "server left the destinations, the session can't be moved";
+    return false;
+  }
+  // the responses in flight are forwarded first
+  if (!splitter_->is_idle()) return true;
+  if (splitter_->is_in_transaction()) {
+    extra_msg_ = "server left the destinations during a transaction";
+    return false;
+  }
+  migrating_ = false;
+
+  // a released session takes a server connection once the client sends a command
+  if (server_socket_ == routing::kInvalidSocket) return true;
+
+  const mysql_harness::TCPAddress previous = get_server_address();
+  // best effort, lets the server end the session without complaining
+  uint8_t quit[] = {0x01, 0x00, 0x00, 0x00, kComQuit};
+  so->write_all(server_socket_, quit, sizeof(quit));
+  so->shutdown(server_socket_);
+  so->close(server_socket_);
+  server_socket_ = routing::kInvalidSocket;
+
+  mysql_harness::TCPAddress address;
+  const int sock = backend_connector_(address);
+  if (sock < 0) {
+    extra_msg_ = "server left the destinations, can't connect to another MySQL server";
+    return false;
+  }
+  bool moved = splitter_->authenticate(so, sock, context_.get_destination_connect_timeout(),
+                                       &session_.scramble);
+
+  RoutingProtocolBuffer packet;
+  for (auto it = statements.begin(); moved && it != statements.end(); ++it) {
+    const size_t payload_size = it->size() + 1;
+    packet = {static_cast<uint8_t>(payload_size), static_cast<uint8_t>(payload_size >> 8),
+              static_cast<uint8_t>(payload_size >> 16), 0, kComQuery};
+    packet.insert(packet.end(), it->begin(), it->end());
+    // SET and USE answer with OK or error
+    moved = so->write_all(sock, &packet[0], packet.size()) >= 0 &&
+            classic_handshake::read_packet(so, sock, packet, context_.get_destination_connect_timeout()) &&
+            packet.size() > kHeaderSize && packet[kHeaderSize] == 0x00;
+  }
+  if (!moved) {
+    extra_msg_ = "server left the destinations, the session can't be replayed at " + address.str();
+    so->shutdown(sock);
+    so->close(sock);
+    return false;
+  }
+
+  // statements prepared by the router get prepared again
+  session_.statements.clear();
+  server_changed(sock, address);
+  log_info("[%s] fd=%d moved session from %s to %s", context_.get_name().c_str(),
+      client_socket_, previous.str().c_str(), address.str().c_str());
+
+  return true;
+}
+
+void MySQLRoutingConnection::server_changed(int server_socket,
+                                            const mysql_harness::TCPAddress& server_address) {
+  const mysql_harness::TCPAddress previous = get_server_address();
+  server_socket_ = server_socket;
+  set_server_address(server_address, true);
+
+  if (server_connected_callback_ && !(previous == server_address)) {
+    server_connected_callback_(this, previous);
+  }
+}
+
+RoutingBufferRef MySQLRoutingConnection::get_read_buffer(RoutingBufferPool::Lease& lease) {
+  RoutingBufferPool& pool = buffer_pool_ ? *buffer_pool_ : context_.get_buffer_pool();
+  const size_t size = read_buffer_size_.get();
+
+  if (size <= pool.get_buffer_size()) {
+    if (large_buffer_) {
+      large_buffer_.reset();
+      large_buffer_memory_.set(0, 0);
+    }
+    if (!lease) lease = pool.acquire();
+    return *lease;
+  }
+
+  // kept while the connection is busy, dropped once it shrinks back
+  if ((!large_buffer_ || large_buffer_->size() != size) && zero_copy_sender_) {
+    large_buffer_ = zero_copy_sender_->take_spare(size);
+  }
+  if (!large_buffer_ || large_buffer_->size() != size) {
+    large_buffer_.reset(new RoutingProtocolBuffer(size));
+    large_buffer_memory_.set(size, 1);
+  }
+  return *large_buffer_;
+}
+
+void MySQLRoutingConnection::handshake_timed_out() {
+  extra_msg_ = std::string("client auth timed out");
+  handshake_expired_ = true;
+}
+
+void MySQLRoutingConnection::set_server_address(const mysql_harness::TCPAddress& server_address,
+                                                bool connected) {
+  {
+    std::lock_guard<std::mutex> lock(server_address_mtx_);
+    server_address_ = server_address;
+  }
+
+  if (!scoreboard_) return;
+  if (server_score_) server_score_->connection_closed();
+  server_score_ = connected ? scoreboard_->get(server_address) : nullptr;
+  if (server_score_) server_score_->connection_opened();
+}
+
+void MySQLRoutingConnection::judge_server_handshake(DestinationScore& score, bool succeeded) {
+  if (server_handshake_judged_) return;
+  server_handshake_judged_ = true;
+
+  CircuitBreaker& circuit_breaker = score.get_circuit_breaker();
+  if (succeeded) {
+    if (circuit_breaker.succeeded()) {
+      log_info("[%s] Circuit of destination server %s closed", context_.get_name().c_str(),
+               get_server_address().str().c_str());
+    }
+  } else if (circuit_breaker.failed(std::chrono::steady_clock::now())) {
+    log_warning("[%s] Circuit of destination server %s opened after failed connects or handshakes",
+                context_.get_name().c_str(), get_server_address().str().c_str());
+  }
+}
+
+void MySQLRoutingConnection::close() {
+  // the router gave up on the connection, not the client
+  const Timeout timed_out = timed_out_;
+  if (!handshake_done_ && timed_out == Timeout::kNone) {
+    log_info("[%s] fd=%d Pre-auth socket failure %s: %s",
+        context_.get_name().c_str(),
+        client_socket_,
+        client_endpoint_.address_str().c_str(), extra_msg_.c_str());
+     context_.block_client_host(client_endpoint_.address_bytes(), client_endpoint_.address_str(), server_socket_);
+  }
+
+  // best effort, the sockets are closed no matter what is left in the queues
+  if (!client_queue_.empty()) client_queue_.flush(client_socket_);
+  if (!server_queue_.empty() && !park_server_) server_queue_.flush(server_socket_);
+
+  if (timed_out != Timeout::kNone) {
+    const char* reason = timed_out == Timeout::kIdle ? "idle_timeout" : "max_connection_lifetime";
+    extra_msg_ = std::string("closed by router, reached ") + reason;
+    // the error can't be written next to the records of userspace TLS
+    if (handshake_done_ && (!client_tls_ || client_kernel_tls_)) {
+      context_.get_protocol().send_error(client_socket_, 4031,
+          std::string("The client was disconnected by the router, the connection reached ") + reason,
+          "HY000", context_.get_name());
+    }
+  }
+
+  if (zero_copy_sender_) {
+    // a killed connection drops what is in flight, anything else gets
+    // the chance to deliver it
+    std::chrono::milliseconds timeout{0};
+    if (!disconnect_ || timed_out != Timeout::kNone) {
+      timeout = context_.get_io_engine() ? kZeroCopyCloseTimeoutIOThread : kZeroCopyCloseTimeout;
+    }
+    if (zero_copy_sender_->prepare_close(client_socket_, timeout)) {
+      log_debug("[%s] fd=%d resetting connection, %zu zero-copy sends still in flight",
+          context_.get_name().c_str(), client_socket_, zero_copy_sender_->get_pending());
+    }
+    log_debug("[%s] fd=%d sent %llu bytes using MSG_ZEROCOPY", context_.get_name().c_str(), client_socket_,
+        static_cast<unsigned long long>(zero_copy_sender_->get_bytes_sent()));
+  }
+
+  // Either client or server terminated
+  if (client_tls_) client_tls_->shutdown();
+  context_.get_socket_operations()->shutdown(client_socket_);
+  context_.get_socket_operations()->close(client_socket_);
+  if (park_server_) {
+    session_.socket = server_socket_;
+    session_.address = get_server_address();
+    backend_pool_->park(std::move(session_));
+    extra_msg_ = "server connection parked";
+  } else if (server_socket_ != routing::kInvalidSocket) {
+    context_.get_socket_operations()->shutdown(server_socket_);
+    context_.get_socket_operations()->close(server_socket_);
+  }
+  splice_forwarder_.reset();
+  close_secondary();
+  // the shadow server gets the rest of the copied commands
+  mirror_session_.reset();
+  if (server_compressed_) {
+    log_debug("[%s] fd=%d compressed %llu bytes to %llu bytes", context_.get_name().c_str(), client_socket_,
+        static_cast<unsigned long long>(server_compression_->get_plain_bytes()),
+        static_cast<unsigned long long>(server_compression_->get_compressed_bytes()));
+  } else if (x_compression_) {
+    log_debug("[%s] fd=%d compressed %llu bytes to %llu bytes", context_.get_name().c_str(), client_socket_,
+        static_cast<unsigned long long>(x_compression_->get_plain_bytes()),
+        static_cast<unsigned long long>(x_compression_->get_compressed_bytes()));
+  }
+
+  context_.decrease_info_active_routes();
+  if (server_score_ && !server_handshake_judged_) {
+    // a client that gave up or timed out while the server waited for it isn't the server's failure
+    if (server_failed_handshake_ || (handshake_expired_ && handshake_waits_for_server_)) {
+      judge_server_handshake(*server_score_, false);
+    } else {
+      server_handshake_judged_ = true;
+      server_score_->get_circuit_breaker().abandoned();
+    }
+  }
+  if (server_score_) {
+    server_score_->connection_closed();
+    server_score_.reset();
+  }
+  const auto lifetime =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - accepted_at_);
+  MYSQL_ROUTER_TRACE(connection__closed, context_.get_name().c_str(), client_socket_,
+                     bytes_down_, bytes_up_, lifetime.count());
+  if (context_.get_metrics()) {
+    RoutingMetrics &metrics = *context_.get_metrics();
+    metrics.connection_closed(bytes_up_, bytes_down_);
+    metrics.add_latency(RoutingMetrics::Latency::kLifetime, lifetime);
+    if (handshake_expired_) {
+      metrics.timed_out(RoutingMetrics::Timeout::kHandshake);
+    } else if (timed_out == Timeout::kIdle) {
+      metrics.timed_out(RoutingMetrics::Timeout::kIdle);
+    } else if (timed_out == Timeout::kLifetime) {
+      metrics.timed_out(RoutingMetrics::Timeout::kLifetime);
+    } else if (!draining_ && !extra_msg_.empty()) {
+      // clients closing their connection leave no message
+      metrics.connection_failed();
+    }
+  }
+
+  if (trace_id_) {
+    ConnectionTrace& connection_trace = ConnectionTrace::getInstance();
+    if (last_byte_from_client_ != 0) {
+      connection_trace.record(trace_id_, ConnectionTrace::Event::kLastByteFromClient,
+                              last_byte_from_client_);
+    }
+    if (last_byte_from_server_ != 0) {
+      connection_trace.record(trace_id_, ConnectionTrace::Event::kLastByteFromServer,
+                              last_byte_from_server_);
+    }
+    connection_trace.record(trace_id_, ConnectionTrace::Event::kClosed);
+  }
+
+  if (!mysql_harness::logging::log_level_is_handled(mysql_harness::logging::LogLevel::kDebug)) {
+    return;
+  }
+
+  mysql_harness::logging::LogContext log_context;
+  log_context.add("route", context_.get_name())
+             .add("client_addr", get_client_address())
+             .add("server_addr", get_server_address().str())
+             .add("bytes_up", static_cast<long long>(bytes_up_))
+             .add("bytes_down", static_cast<long long>(bytes_down_))
+             .add("duration_ms", static_cast<long long>(
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - accepted_at_).count()));
+#ifndef _WIN32
+  log_debug("[%s] fd=%d connection closed (up: %zub; down: %zub) %s",
+      context_.get_name().c_str(),
+      client_socket_, bytes_up_, bytes_down_, extra_msg_.c_str());
+#else
+  log_debug("[%s] fd=%d connection closed (up: %Iub; down: %Iub) %s",
+      context_.get_name().c_str(),
+      client_socket_, bytes_up_, bytes_down_, extra_msg_.c_str());
+#endif
+}
+
+void MySQLRoutingConnection::complete() {
+  context_.decrease_active_thread_counter();
+
+  // remove callback has to be executed as a last thing in connection
+  remove_callback_(this);
+}
+
+void MySQLRoutingConnection::disconnect() noexcept {
+  disconnect_ = true;
+  wakeup();
+}
+
+void MySQLRoutingConnection::time_out(Timeout timeout) noexcept {
+  timed_out_ = timeout;
+  disconnect();
+}
+
+void MySQLRoutingConnection::migrate() noexcept {
+  migrating_ = true;
+  wakeup();
+}
+
+void MySQLRoutingConnection::drain() noexcept {
+  draining_ = true;
+  wakeup();
+}
+
+bool MySQLRoutingConnection::is_drained() const noexcept {
+  // data the client didn't take yet is a response still in flight
+  return draining_ && handshake_done_ && splitter_ && splitter_->is_between_transactions() &&
+         client_queue_.empty() && server_queue_.empty();
+}
+
+void MySQLRoutingConnection::wakeup() noexcept {
+  std::lock_guard<std::mutex> lock(wakeup_mtx_);
+  if (disconnect_notify_) disconnect_notify_();
+
+#ifndef _WIN32
+  if (wakeup_fds_[1] != routing::kInvalidSocket) {
+    const char c = 0;
+    // a full pipe means run() has a wakeup pending already
+    ssize_t res;
+    do {
+      res = ::write(wakeup_fds_[1], &c, 1);
+    } while (res == -1 && errno == EINTR);
+  }
+#endif
+}
+
+bool MySQLRoutingConnection::open_wakeup_pipe() {
+#ifndef _WIN32
+  int fds[2];
+  if (pipe(fds) == -1) {
+    log_debug("[%s] fd=%d failed to create wakeup pipe: %s", context_.get_name().c_str(),
+        client_socket_, get_message_error(errno).c_str());
+    return false;
+  }
+
+  for (int fd: fds) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  std::lock_guard<std::mutex> lock(wakeup_mtx_);
+  wakeup_fds_[0] = fds[0];
+  wakeup_fds_[1] = fds[1];
+  return true;
+#else
+  // WSAPoll() only takes sockets
+  return false;
+#endif
+}
+
+void MySQLRoutingConnection::close_wakeup_pipe() {
+#ifndef _WIN32
+  std::lock_guard<std::mutex> lock(wakeup_mtx_);
+  ::close(wakeup_fds_[0]);
+  ::close(wakeup_fds_[1]);
+  wakeup_fds_[0] = wakeup_fds_[1] = routing::kInvalidSocket;
+#endif
+}
+
+mysql_harness::TCPAddress MySQLRoutingConnection::get_server_address() const {
+  std::lock_guard<std::mutex> lock(server_address_mtx_);
+  return server_address_;
+}
+
+std::string MySQLRoutingConnection::get_client_address() const {
+  if (client_endpoint_.is_local()) {
+    // Unix socket/Windows Named pipe
+    return context_.get_bind_named_socket().str();
+  }
+
+  return client_endpoint_.str();
+}
+
+RouteConnectionInfo MySQLRoutingConnection::get_info() const {
+  const auto now = std::chrono::steady_clock::now();
+  const std::chrono::steady_clock::time_point last_forwarded_at{
+      std::chrono::steady_clock::duration(last_forwarded_at_.load(std::memory_order_relaxed))};
+
+  RouteConnectionInfo info;
+  info.client_address = get_client_address();
+  const auto server_address = get_server_address();
+  if (!server_address.addr.empty()) info.server_address = server_address.str();
+  info.started = std::chrono::system_clock::now() -
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(now - accepted_at_);
+  // bytes_up_ counts what the server sent
+  info.bytes_from_client = forwarded_bytes_down_.load(std::memory_order_relaxed);
+  info.bytes_from_server = forwarded_bytes_up_.load(std::memory_order_relaxed);
+  info.idle = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_forwarded_at);
+
+  return info;
 }
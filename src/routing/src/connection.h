@@ -28,16 +28,44 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "mysql/harness/memory_accounting.h"
+#include "mysql/harness/networking/socket_endpoint.h"
+#include "mysqlrouter/connection_trace.h"
+#include "mysqlrouter/routing_control.h"
+
+#include "backend_pool.h"
+#include "buffer_pool.h"
 #include "context.h"
+#include "destination_scoreboard.h"
+#include "handshake_router.h"
+#include "query_router.h"
 #include "mysql_router_thread.h"
+#include "output_queue.h"
+#include "prepared_statements.h"
 #include "protocol/base_protocol.h"
+#include "protocol/classic_compression.h"
+#include "protocol/x_compression.h"
+#include "protocol/classic_framer.h"
+#include "query_digest.h"
+#include "read_write_splitter.h"
+#include "result_cache.h"
+#include "splice_forwarder.h"
 #include "tcp_address.h"
+#include "tls_server_context.h"
+#include "traffic_mirror.h"
+#include "zero_copy_sender.h"
 
 
 class MySQLRouting;
 class MySQLRoutingContext;
+class RouteDestination;
 
 namespace mysql_harness { class PluginFuncEnv; }
 
@@ -53,6 +81,21 @@ namespace mysql_harness { class PluginFuncEnv; }
 class MySQLRoutingConnection {
 
 public:
+  /**
+   * @brief Function connecting to the server
+   *
+   * Sets address of the server connected to and returns the socket or
+   * routing::kInvalidSocket on failure.
+   */
+  using ServerConnector = std::function<int(mysql_harness::TCPAddress& server_address)>;
+
+  /**
+   * @brief Function connecting to a server of a pool picked by HandshakeRouter
+   *
+   * Like ServerConnector.
+   */
+  using PoolConnector = std::function<int(RouteDestination& pool,
+                                          mysql_harness::TCPAddress& server_address)>;
 
   /**
    * @brief Creates and initializes connection object. It doesn't create
@@ -67,13 +110,32 @@ public:
    * @param remove_callback called when thread finishes its execution to remove
    *        associated MySQLRoutingConnection from container. It must be called
    *        at the very end of thread execution
+   * @param server_connector if set, used by connect_server() to connect to
+   *        the server once the connection is started, server_socket is
+   *        ignored then
    */
   MySQLRoutingConnection(MySQLRoutingContext& context,
       int client_socket,
       const sockaddr_storage& client_addr,
       int server_socket,
       const mysql_harness::TCPAddress& server_address,
-      std::function<void(MySQLRoutingConnection*)> remove_callback);
+      std::function<void(MySQLRoutingConnection*)> remove_callback,
+      ServerConnector server_connector = nullptr);
+
+  /**
+   * @brief Returns true if connect_server() still needs to be called.
+   */
+  bool needs_server_connect() const noexcept {
+    return static_cast<bool>(server_connector_);
+  }
+
+  /**
+   * @brief Connects to the server using the server connector.
+   *
+   * Blocks up to the destination connect timeout(s). Does nothing if there
+   * is no server connector or it was called already.
+   */
+  void connect_server();
 
   /**
    * @brief Verify if client socket and server socket are valid.
@@ -100,27 +162,314 @@ public:
    */
   void run();
 
+  /**
+   * @brief prepares the connection for forwarding traffic
+   *
+   * Verifies the sockets and updates the route statistics. When false is
+   * returned the sockets are already closed and only complete() must be
+   * called.
+   *
+   * @return true if traffic can be forwarded, false otherwise
+   */
+  bool open();
+
+  /**
+   * @brief forwards the data available on the sockets
+   *
+   * Server to client traffic is always handled first, as the server talks
+   * first in the classic protocol.
+   *
+   * With output queues, queued data is flushed to the writable sockets
+   * before anything new is read.
+   *
+   * @param client_is_readable true if client socket has data or was closed
+   * @param server_is_readable true if server socket has data or was closed
+   * @param client_is_writable true if client socket can take data
+   * @param server_is_writable true if server socket can take data
+   *
+   * @return false if connection has to be closed, true otherwise
+   */
+  bool forward(bool client_is_readable, bool server_is_readable,
+               bool client_is_writable = false, bool server_is_writable = false);
+
+  /**
+   * @brief Returns true if the socket has to be watched for incoming data
+   *
+   * False while reading is paused because the output queue towards the
+   * other side is full.
+   *
+   * @param socket client or server socket of the connection
+   */
+  bool wants_to_read(int socket) const noexcept;
+
+  /**
+   * @brief Returns true if the socket has to be watched for being writable
+   *
+   * True while the output queue towards the socket is not empty.
+   *
+   * @param socket client or server socket of the connection
+   */
+  bool wants_to_write(int socket) const noexcept;
+
+  /**
+   * @brief marks handshake of the connection as timed out
+   */
+  void handshake_timed_out();
+
+  /**
+   * @brief opens the pipe letting disconnect() wake up run()
+   *
+   * @return false if the pipe could not be created
+   */
+  bool open_wakeup_pipe();
+
+  /**
+   * @brief closes the pipe opened by open_wakeup_pipe()
+   */
+  void close_wakeup_pipe();
+
+  /**
+   * @brief closes the sockets of the connection opened by open()
+   *
+   * Blocks the client host if the handshake was not completed.
+   */
+  void close();
+
+  /**
+   * @brief releases the connection
+   *
+   * Decreases the active thread counter and calls the remove callback. The
+   * connection object must not be used after this call.
+   */
+  void complete();
+
   /**
    * @brief mark connection to disconnect as soon as possible
    */
   void disconnect() noexcept;
 
+  /**
+   * @brief Moves the session to another server once it is between transactions.
+   *
+   * Called when the server of the connection left the destinations. With
+   * session migration the session authenticates at the server the route
+   * picks now and gets its schema and system variables replayed, without
+   * the client noticing. Sessions in a transaction or with state that can't
+   * be replayed get disconnected instead.
+   */
+  void migrate() noexcept;
+
+  /**
+   * @brief Returns true if connection has been marked to disconnect
+   */
+  bool is_disconnected() const noexcept {
+    return disconnect_;
+  }
+
+  /** @brief why the router closes a connection by itself */
+  enum class Timeout {
+    kNone,
+    /** @brief nothing forwarded for the idle timeout of the route */
+    kIdle,
+    /** @brief open for the max connection lifetime of the route */
+    kLifetime,
+  };
+
+  /**
+   * @brief mark connection to disconnect because it timed out
+   *
+   * The client gets an error telling why, unless TLS of the client is
+   * terminated by the router in userspace.
+   */
+  void time_out(Timeout timeout) noexcept;
+
+  /**
+   * @brief mark connection to close once it is between transactions
+   *
+   * Only connections following the transaction state of the session, that
+   * is splitting reads or multiplexing, get closed this way. Others have to
+   * end by themselves or get disconnected.
+   */
+  void drain() noexcept;
+
+  /**
+   * @brief Returns true if connection is draining and can be closed now
+   *
+   * Must be called by the thread serving the connection.
+   */
+  bool is_drained() const noexcept;
+
+  /**
+   * @brief Returns true if the handshake phase of the connection is done
+   */
+  bool is_handshake_done() const noexcept {
+    return handshake_done_;
+  }
+
+  /**
+   * @brief Sets function called when connection is marked to disconnect.
+   *
+   * Used by the I/O engine to wake up the thread serving the connection.
+   */
+  void set_disconnect_notify(std::function<void()> disconnect_notify) {
+    // other threads may wake up the connection already
+    std::lock_guard<std::mutex> lock(wakeup_mtx_);
+    disconnect_notify_ = std::move(disconnect_notify);
+  }
+
+  /**
+   * @brief Function called once the connection connected to a server.
+   *
+   * Gets the address of the server the connection was connected to
+   * before, empty on the first connect.
+   */
+  using ServerConnectedCallback =
+      std::function<void(MySQLRoutingConnection*, const mysql_harness::TCPAddress& previous)>;
+
+  /**
+   * @brief Sets function called once the connection connected to a server.
+   *
+   * Called by connect_server() and whenever the connection moves to
+   * another server. Used by the connection container to index the
+   * connections by server. Has to be set before the connection is started.
+   */
+  void set_server_connected_callback(ServerConnectedCallback callback) {
+    server_connected_callback_ = callback;
+  }
+
+  /**
+   * @brief Sets function connecting to a server the reads of the client can go to.
+   *
+   * Enables read/write splitting of the classic protocol, unless server
+   * connections are written through output queues. Has to be set before
+   * the connection is started.
+   */
+  void set_read_only_connector(ServerConnector read_only_connector);
+
+  /**
+   * @brief Reads after a write only go to the secondary once it applied the write.
+   *
+   * Needs set_read_only_connector(). Has to be set before the connection is
+   * started.
+   */
+  void set_read_your_writes(bool read_your_writes) { read_your_writes_ = read_your_writes; }
+
+  /**
+   * @brief Lets the handshake response of the client pick its destinations.
+   *
+   * The server connector is used for the clients without a pool of their
+   * own. Has to be set before the connection is started.
+   *
+   * @param handshake_router pools of the route, has to outlive the connection
+   * @param pool_connector connects to a server of the pool of the client
+   */
+  void set_handshake_router(HandshakeRouter* handshake_router, PoolConnector pool_connector) {
+    handshake_router_ = handshake_router;
+    pool_connector_ = std::move(pool_connector);
+  }
+
+  /**
+   * @brief Lets the leading comment of read-only statements pick a pool to run them.
+   *
+   * Only for connections whose commands get inspected, see ReadWriteSplitter.
+   * Has to be set before the connection is started.
+   *
+   * @param query_router pools of the route, has to outlive the connection
+   * @param pool_connector connects to a server of the pool of a statement
+   */
+  void set_query_router(QueryRouter* query_router, PoolConnector pool_connector) {
+    query_router_ = query_router;
+    query_pool_connector_ = std::move(pool_connector);
+  }
+
+  /**
+   * @brief Sets scoreboard of the destination the server connections come from.
+   *
+   * The server the connection is routed to counts it as active and gets
+   * the forwarded bytes scored. Has to be set before the connection is
+   * started.
+   */
+  void set_scoreboard(std::shared_ptr<DestinationScoreboard> scoreboard) {
+    scoreboard_ = std::move(scoreboard);
+  }
+
+  /**
+   * @brief Marks the connection as one of the priority lane of the route.
+   *
+   * The I/O engine connects it to the server ahead of the other
+   * connections waiting for a connect thread. Has to be set before the
+   * connection is started.
+   */
+  void set_priority(bool priority) noexcept { priority_ = priority; }
+
+  bool is_priority() const noexcept { return priority_; }
+
+  /** @brief bytes forwarded in both directions, only for the thread forwarding */
+  uint64_t get_bytes_forwarded() const noexcept { return bytes_up_ + bytes_down_; }
+
+  /**
+   * @brief Sets pool lending the buffers to forward the traffic.
+   *
+   * Used by the I/O engine to let the connections of an I/O thread share
+   * a pool. Connections use the pool of the context by default.
+   */
+  void set_buffer_pool(RoutingBufferPool* buffer_pool) noexcept {
+    buffer_pool_ = buffer_pool;
+  }
+
+  int get_client_socket() const noexcept {
+    return client_socket_;
+  }
+
+  int get_server_socket() const noexcept {
+    return server_socket_;
+  }
+
   /**
    * @brief Returns address of server to which connection is established.
    *
-   * @return address of server
+   * @return address of server, empty while still connecting to the server
    */
-  const mysql_harness::TCPAddress& get_server_address() const noexcept;
+  mysql_harness::TCPAddress get_server_address() const;
 
   /**
    * @brief Returns address of client which connected to router
    *
-   * @return address of client
+   * Formatted on each call, meant for log messages and status reports.
+   *
+   * @return address and port of the client, or the path of the named socket
    */
-  const std::string& get_client_address() const;
+  std::string get_client_address() const;
+
+  /** @brief Returns when the connection was accepted */
+  std::chrono::steady_clock::time_point get_accepted_at() const noexcept {
+    return accepted_at_;
+  }
+
+  /**
+   * @brief Returns when forward() moved bytes the last time.
+   *
+   * Can be called by any thread. Same as get_accepted_at() until the first
+   * bytes get forwarded.
+   */
+  std::chrono::steady_clock::time_point get_last_forwarded_at() const noexcept {
+    return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(
+        last_forwarded_at_.load(std::memory_order_relaxed)));
+  }
+
+  /**
+   * @brief Returns addresses, age, forwarded bytes and idle time of the connection.
+   *
+   * Can be called by any thread, the bytes are those seen by the last
+   * forward().
+   */
+  RouteConnectionInfo get_info() const;
 
 private:
 
+  /** @brief accounts the connection object itself */
+  mysql_harness::AccountedMemory memory_{mysql_harness::MemoryTag::kRoutingConnections,
+                                         sizeof(MySQLRoutingConnection), 1};
   /** @brief wrapper for common data used by all routing threads */
   MySQLRoutingContext& context_;
   /** @brief callback that is called when thread of execution completes */
@@ -128,18 +477,524 @@ private:
   /** @brief socket used to communicate with client */
   int client_socket_;
   /** @brief client's address */
-  const sockaddr_storage client_addr_;
+  const mysql_harness::SocketEndpoint client_endpoint_;
   /** @brief socket used to communicate with server */
   int server_socket_;
   mysql_harness::TCPAddress server_address_;
+  /** @brief protects server_address_ which is set by connect_server() */
+  mutable std::mutex server_address_mtx_;
+  /** @brief scores of the servers, nullptr if not scoring */
+  std::shared_ptr<DestinationScoreboard> scoreboard_;
+  /** @brief score of the server connected to, nullptr if none */
+  std::shared_ptr<DestinationScore> server_score_;
+  /** @brief connects to server, reset once used */
+  ServerConnector server_connector_;
   /** @brief true if connection should be disconnected */
   std::atomic<bool> disconnect_{false};
-  /** @brief address of the client */
-  std::string client_address_;
+  /** @brief true if connection should be closed once between transactions */
+  std::atomic<bool> draining_{false};
+  /** @brief true if the session should move to another server once between transactions */
+  std::atomic<bool> migrating_{false};
+  /** @brief set by time_out() before disconnect_ */
+  std::atomic<Timeout> timed_out_{Timeout::kNone};
+  /** @brief called from disconnect(), if set, guarded by wakeup_mtx_ */
+  std::function<void()> disconnect_notify_;
+
+  /** @brief pipe written by disconnect() to interrupt poll() in run(),
+   *         kInvalidSocket when not open */
+  int wakeup_fds_[2]{routing::kInvalidSocket, routing::kInvalidSocket};
+  /** @brief protects wakeup_fds_ which is opened and closed by run(), and disconnect_notify_ */
+  std::mutex wakeup_mtx_;
+
+  /** @brief called once connected to a server */
+  ServerConnectedCallback server_connected_callback_;
+
+  /** @brief pool lending buffers to copy packets, context's pool if not set */
+  RoutingBufferPool* buffer_pool_{nullptr};
+  /** @brief size of the buffer the next read goes to */
+  AdaptiveBufferSize read_buffer_size_;
+  /** @brief owned read buffer while read_buffer_size_ is above the size of pooled buffers */
+  std::unique_ptr<RoutingProtocolBuffer> large_buffer_;
+  /** @brief accounts large_buffer_ */
+  mysql_harness::AccountedMemory large_buffer_memory_{mysql_harness::MemoryTag::kRoutingBuffers};
+  /** @brief passed to copy_packets() when sender is not readable */
+  RoutingProtocolBuffer empty_buffer_;
+  /** @brief true if handshake phase is done */
+  bool handshake_done_{false};
+  /** @brief true while the handshake waits for a packet of the server */
+  bool handshake_waits_for_server_{true};
+  /** @brief true if handshake_timed_out() got called */
+  bool handshake_expired_{false};
+  /** @brief true if the server failed its part of the handshake: closed, read failed or sent an error greeting */
+  bool server_failed_handshake_{false};
+  /** @brief true once the server's part of the handshake got reported to its circuit breaker */
+  bool server_handshake_judged_{false};
+  /** @brief packet number of the handshake phase */
+  int pktnr_{0};
+  /** @brief start of a handshake packet from the client/server whose rest didn't arrive yet */
+  RoutingProtocolBuffer client_partial_packet_;
+  RoutingProtocolBuffer server_partial_packet_;
+  std::size_t bytes_up_{0};
+  std::size_t bytes_down_{0};
+  /** @brief when the connection was accepted, for the logged duration */
+  std::chrono::steady_clock::time_point accepted_at_{std::chrono::steady_clock::now()};
+  /** @brief bytes_up_ as of the last forward(), for other threads */
+  std::atomic<uint64_t> forwarded_bytes_up_{0};
+  /** @brief bytes_down_ as of the last forward(), for other threads */
+  std::atomic<uint64_t> forwarded_bytes_down_{0};
+  /** @brief steady clock ticks of the last forward() that moved bytes, accepted_at_ before */
+  std::atomic<std::chrono::steady_clock::rep> last_forwarded_at_{accepted_at_.time_since_epoch().count()};
+  /** @brief reason of closing the connection, logged when closed */
+  std::string extra_msg_;
+  /** @brief forwards traffic after the handshake if splicing is enabled */
+  std::unique_ptr<SpliceForwarder> splice_forwarder_;
+  /** @brief writes large chunks to the client using MSG_ZEROCOPY, if zero_copy_threshold is set */
+  std::unique_ptr<ZeroCopySender> zero_copy_sender_;
+
+  /** @brief true if the traffic after the handshake is written without blocking */
+  bool use_output_queues_{false};
+  /** @brief data not yet taken by the client socket */
+  OutputQueue client_queue_;
+  /** @brief data not yet taken by the server socket */
+  OutputQueue server_queue_;
+  /** @brief true while reading from the client is paused, server_queue_ is full */
+  bool client_reads_paused_{false};
+  /** @brief true while reading from the server is paused, client_queue_ is full */
+  bool server_reads_paused_{false};
+
+  /** @brief pool of idle server connections, nullptr if pooling is disabled */
+  BackendConnectionPool* backend_pool_;
+  /** @brief true while the handshake is relayed packet by packet */
+  bool relaying_handshake_{false};
+  /** @brief added to sequence ids of server packets relayed to the client */
+  uint8_t relay_seq_offset_{0};
+  /** @brief session of the server connection, parked when client quits */
+  BackendConnectionPool::Connection session_;
+  /** @brief true if server connection can be parked once the client quits */
+  bool poolable_{false};
+  /** @brief true if server connection is handed over to the pool on close */
+  bool park_server_{false};
+  /** @brief packet boundaries of what the client sent so far */
+  ClassicPacketFramer client_framer_;
+  /** @brief X protocol: bytes of the last frame of the client still to come */
+  uint64_t client_frame_skip_{0};
+
+  /** @brief picks the destinations by the client's handshake, nullptr if not routed by it */
+  HandshakeRouter* handshake_router_{nullptr};
+  /** @brief connects to a server of the pool handshake_router_ picked */
+  PoolConnector pool_connector_;
+
+  /** @brief picks a pool by the leading comment of statements, nullptr if not routed by it */
+  QueryRouter* query_router_{nullptr};
+  /** @brief connects to a server of the pool query_router_ picked */
+  PoolConnector query_pool_connector_;
+
+  /** @brief connects to a server for reads, set if reads are split from writes */
+  ServerConnector read_only_connector_;
+  /** @brief true if reads after a write wait for the secondary to apply it */
+  bool read_your_writes_{false};
+  /** @brief true if the connection is one of the priority lane */
+  bool priority_{false};
+  /** @brief decides where client commands go, nullptr if reads are not split */
+  std::unique_ptr<ReadWriteSplitter> splitter_;
+  /** @brief socket of the server reads go to, kInvalidSocket until the first read */
+  int secondary_socket_{routing::kInvalidSocket};
+  /** @brief pool of query_router_ secondary_socket_ connects to, nullptr for the read-only servers */
+  RouteDestination* secondary_pool_{nullptr};
+  /** @brief key of the statement sent to the secondary if its response is cached, else empty */
+  std::string result_cache_key_;
+  /** @brief digest of the last statement looked up in the result cache, kept to reuse the memory */
+  std::string result_cache_digest_;
+  /** @brief response of the secondary to the statement of result_cache_key_ */
+  ResultCache::Response result_cache_response_;
+  /** @brief true if the server connection is released between transactions */
+  bool multiplexing_{false};
+  /** @brief connects to a server again once a released server connection is needed */
+  ServerConnector backend_connector_;
+  /** @brief prepared statements of the client, set if their ids are translated */
+  std::unique_ptr<PreparedStatementTranslator> statements_;
+
+  /** @brief true if the client got a greeting offering TLS terminated at the router */
+  bool client_tls_offered_{false};
+  /** @brief TLS connection of the client, set once the client started TLS */
+  std::unique_ptr<TlsServerContext::Session> client_tls_;
+  /** @brief true if the kernel encrypts and decrypts the TLS traffic of the
+   *         client, which then gets forwarded like plain traffic */
+  bool client_kernel_tls_{false};
+
+  /** @brief translates to the compressed protocol of the server, set while
+   *         the handshake may still negotiate it */
+  std::unique_ptr<ClassicCompression> server_compression_;
+  /** @brief true once the server accepted the handshake asking for compression */
+  bool server_compressed_{false};
+  /** @brief translated bytes of the last read, kept to reuse the memory */
+  RoutingProtocolBuffer compression_buffer_;
+  /** @brief set once an X protocol server accepted the compression capability of the router */
+  std::unique_ptr<XCompression> x_compression_;
+  /** @brief complete messages of the last read of the client, kept to reuse the memory */
+  RoutingProtocolBuffer x_messages_;
+  /** @brief true once the X protocol server sent AuthenticateOk, the
+   *         capabilities can't change anymore then */
+  bool x_authenticated_{false};
+
+  /** @brief samples statements of the client, set by the handshake response if they can be seen */
+  std::unique_ptr<QueryDigestSampler> digest_sampler_;
+
+  /** @brief session to the shadow server, set by the handshake response if the client is mirrored */
+  std::unique_ptr<TrafficMirror::Session> mirror_session_;
+
+  /** @brief id of the connection in ConnectionTrace, 0 if not traced */
+  uint64_t trace_id_{0};
+  /** @brief ConnectionTrace::now() of the last byte read from the client, 0 if none yet */
+  uint64_t last_byte_from_client_{0};
+  /** @brief ConnectionTrace::now() of the last byte read from the server, 0 if none yet */
+  uint64_t last_byte_from_server_{0};
+
+  /** @brief when the client sent the request the server didn't respond to yet, zero if none */
+  std::chrono::steady_clock::time_point request_sent_at_;
+
+  /** @brief forward() without the bookkeeping of forwarded() */
+  bool forward_traffic(bool client_is_readable, bool server_is_readable,
+                       bool client_is_writable, bool server_is_writable);
+
+  /** @brief records event to ConnectionTrace if the connection is traced */
+  void trace(ConnectionTrace::Event event) noexcept {
+    if (trace_id_) ConnectionTrace::getInstance().record(trace_id_, event);
+  }
+
+  /** @brief publishes, measures and traces what forward_traffic() forwarded
+   *
+   * Called only if bytes got forwarded or the handshake got done.
+   *
+   * @param bytes_up bytes_up_ before forwarding
+   * @param bytes_down bytes_down_ before forwarding
+   * @param handshake_was_done handshake_done_ before forwarding
+   */
+  void forwarded(size_t bytes_up, size_t bytes_down, bool handshake_was_done) noexcept;
+
+  /**
+   * @brief Sets the server the connection is routed to.
+   *
+   * Moves the connection from the score of the previous server to the
+   * score of the new one if connected.
+   */
+  void set_server_address(const mysql_harness::TCPAddress& server_address, bool connected);
+
+  /**
+   * @brief Reports to the circuit breaker of the server how it did its part of the handshake.
+   *
+   * Only the first call of a connection counts.
+   */
+  void judge_server_handshake(DestinationScore& score, bool succeeded);
+
+  /** @brief records the first bytes and the end of the handshake seen by forward_traffic()
+   *
+   * @param bytes_up bytes_up_ before forwarding
+   * @param bytes_down bytes_down_ before forwarding
+   * @param handshake_was_done handshake_done_ before forwarding
+   */
+  void trace_forwarded(size_t bytes_up, size_t bytes_down, bool handshake_was_done) noexcept;
+
+  /** @brief adds the handshake duration and request round trips seen by forward_traffic() to the metrics
+   *
+   * @param bytes_up bytes_up_ before forwarding
+   * @param bytes_down bytes_down_ before forwarding
+   * @param handshake_was_done handshake_done_ before forwarding
+   * @param now time forward_traffic() returned
+   */
+  void measure_forwarded(size_t bytes_up, size_t bytes_down, bool handshake_was_done,
+                         std::chrono::steady_clock::time_point now) noexcept;
+
+  /** @brief connects to the server taking part in the handshake
+   *
+   * Sends the client a greeting of the pooled servers and its handshake
+   * response decides whether a parked server connection can be reused.
+   * The client authenticates against the scramble of the chosen server
+   * by replying to an auth switch request.
+   *
+   * @return server socket or routing::kInvalidSocket on failure
+   */
+  int connect_server_pooled(mysql_harness::TCPAddress& server_address);
+
+  /** @brief connects to the server for an X protocol client, taking part in the handshake
+   *
+   * Reads the messages of the client until its AuthenticateStart. Those
+   * setting capabilities (but TLS) are answered by the router and decide
+   * whether a parked server connection can be reused, CapabilitiesGet gets
+   * the response of the pooled servers. A new server connection gets the
+   * capabilities set before the authentication goes on.
+   *
+   * @return server socket or routing::kInvalidSocket on failure
+   */
+  int connect_server_x_pooled(mysql_harness::TCPAddress& server_address);
+
+  /** @brief connects a server for connect_server_x_pooled(), setting the capabilities answered so far
+   *
+   * With capabilities_key, a session parked with the capabilities to the
+   * server the strategy picks is taken instead, it is set up already.
+   */
+  int connect_x_server(mysql_harness::TCPAddress& server_address,
+                       std::vector<RoutingProtocolBuffer>& answered_sets,
+                       const std::string* capabilities_key = nullptr);
+
+  /** @brief connects to the server of the pool the client's handshake picks
+   *
+   * Sends the client the greeting known to handshake_router_, or the one
+   * of a server of the route's destinations for the first client. Unless
+   * the client stays with the server that greeted it, it authenticates
+   * against the scramble of the server of its pool by replying to an auth
+   * switch request.
+   *
+   * @return server socket or routing::kInvalidSocket on failure
+   */
+  int connect_server_by_handshake(mysql_harness::TCPAddress& server_address);
+
+  /** @brief asks the client to authenticate against session_.scramble
+   *
+   * @param handshake handshake response of the client
+   * @param auth_response set to the auth-response of the client, without header
+   *
+   * @return false if the client didn't answer
+   */
+  bool switch_client_auth(const classic_handshake::ClientHandshake& handshake,
+                          RoutingProtocolBuffer& auth_response);
+
+  /** @brief reads greeting of a new server connection
+   *
+   * @return false if greeting is not usable or server sent an error
+   */
+  bool read_server_greeting(int server, RoutingProtocolBuffer& greeting);
+
+  /** @brief relays the rest of a pooled handshake until the server sends OK or error */
+  bool relay_handshake(bool client_is_readable, bool server_is_readable);
+
+  /** @brief copies client packets after the handshake, parks server on COM_QUIT */
+  int copy_client_packets(RoutingBufferPool::Lease& buffer, size_t *report_bytes_read);
+
+  /** @brief tracks client packets, returns true if data ends with a COM_QUIT packet
+   *
+   * @param data bytes read from the client
+   * @param size number of bytes at data
+   * @param quit_offset set to the offset of the COM_QUIT packet in data
+   */
+  bool track_client_packets(const uint8_t* data, size_t size, size_t &quit_offset);
+
+  /** @brief copies X protocol client messages, parks server on Session.Close */
+  int copy_x_client_messages(RoutingBufferPool::Lease& buffer, size_t *report_bytes_read);
+
+  /** @brief copies client commands to the server chosen by splitter_ */
+  int copy_client_commands(RoutingBufferPool::Lease& buffer, size_t *report_bytes_read);
+
+  /** @brief copies client commands translating the ids of prepared statements
+   *
+   * Commands referring to a prepared statement get the id the statement
+   * has in the current server session, the statement is prepared there
+   * first if needed. COM_STMT_PREPARE is answered from the statements
+   * prepared in the session if possible, otherwise the response of the
+   * server gets an id assigned by the router.
+   *
+   * @param buffer bytes read from the client, may be topped up to complete
+   *        the start of a command
+   * @param size number of bytes in buffer
+   * @param report_bytes_read increased by the bytes topped up
+   */
+  int copy_client_statements(RoutingBufferRef buffer, size_t size, size_t *report_bytes_read);
+
+  /** @brief routes and sends commands of the client, bytes begin to end of buffer
+   *
+   * @param buffer bytes read from the client
+   * @param begin offset of the first byte to send
+   * @param end offset after the last byte to send
+   * @param size number of bytes in buffer
+   * @param statement text of the prepared statement the command at begin refers to
+   */
+  int forward_commands(RoutingBufferRef buffer, size_t begin, size_t end, size_t size,
+                       const std::string* statement);
+
+  /** @brief forwards responses of the primary until it answered all commands
+   *
+   * @return false if the responses can't be followed or forwarding failed
+   */
+  bool forward_primary_responses();
+
+  /** @brief reads response to the COM_STMT_PREPARE of the client and forwards
+   *         it with an id assigned by the router */
+  bool finish_client_prepare();
+
+  /** @brief prepares statement of the client in the current server session
+   *
+   * @param statement statement of the client
+   * @param prepared set to the statement prepared in the session
+   *
+   * @return false if preparing failed, the error is sent to the client then
+   */
+  bool prepare_on_server(const PreparedStatementTranslator::Statement& statement,
+                         PreparedStatementCache::Statement*& prepared);
+
+  /** @brief adds statement to the session, closing least recently used ones beyond the cache size */
+  PreparedStatementCache::Statement& cache_statement(const std::string& sql,
+                                                     PreparedStatementCache::Statement statement);
+
+  /** @brief copies responses of the primary to the client, following them with splitter_ */
+  int copy_primary_packets(RoutingBufferPool::Lease& buffer, size_t *report_bytes_read);
+
+  /** @brief sends command to the secondary and its response to the client
+   *
+   * A secondary which doesn't start responding within a bounded time is
+   * closed and the command goes to the primary instead.
+   *
+   * @return 0 once the response is forwarded, -1 on failure, 1 if the
+   *         command has to go to the primary
+   */
+  int query_secondary(RoutingBufferRef buffer, size_t size);
+
+  /** @brief answers the statement routed to the secondary from the result cache
+   *
+   * Sets result_cache_key_ if the response of the secondary is to be cached.
+   *
+   * @param command COM_QUERY of the client, including the header
+   * @param size number of bytes at command
+   *
+   * @return 0 once the cached response is sent, -1 on failure, 1 if the
+   *         statement has to be sent to the secondary
+   */
+  int query_result_cache(const uint8_t* command, size_t size);
+
+  /** @brief true if the secondary applied the GTIDs of the session's writes
+   *
+   * Asks the secondary, connecting to it first if needed.
+   */
+  bool secondary_applied_gtids();
+
+  /** @brief connects to the secondary and authenticates the client there */
+  bool connect_secondary();
+
+  /** @brief closes connection to the secondary, if open */
+  void close_secondary();
+
+  /** @brief passes the handshake response of the client to splitter_ */
+  void take_client_handshake(RoutingBufferRef buffer, size_t size);
+
+  /** @brief passes bytes copied between client and server to digest_sampler_
+   *
+   * @param handshake_was_done true if the handshake was done before the bytes were read
+   */
+  void sample_query_digests(RoutingBufferRef buffer, size_t size,
+                            bool from_server, bool handshake_was_done);
+
+  /** @brief passes bytes read from the client to mirror_session_
+   *
+   * @param handshake_was_done true if the handshake was done before the bytes were read
+   */
+  void mirror_client_data(RoutingBufferRef buffer, size_t size, bool handshake_was_done);
+
+  /** @brief reads greeting of the server and sends it to the client offering TLS
+   *
+   * @return false if greeting is not usable or server sent an error
+   */
+  bool offer_client_tls();
+
+  /** @brief does the TLS handshake with a client that sent an SSL request */
+  bool accept_client_tls();
+
+  /** @brief writes to the client, through TLS if the client started TLS */
+  bool write_to_client(const uint8_t* data, size_t size);
+
+  /** @brief copies data between the TLS connection of the client and the server */
+  int copy_tls_packets(bool sender_is_readable, RoutingBufferPool::Lease& buffer,
+                       size_t *report_bytes_read, bool from_server);
+
+  /** @brief asks a server offering compression for it in the handshake response of the client
+   *
+   * @return false if the client switches to TLS, which ends relaying the handshake
+   */
+  bool request_server_compression(RoutingProtocolBuffer& packet);
+
+  /** @brief copies data between the plain client and the compressing server */
+  int copy_compressed_packets(bool sender_is_readable, RoutingBufferPool::Lease& buffer,
+                              size_t *report_bytes_read, bool from_server);
+
+  /**
+   * @brief asks the X protocol server for compression before the client's messages
+   *
+   * A server refusing it, like those before MySQL 8.0.19, is used uncompressed.
+   *
+   * @return false if the server failed or timed out
+   */
+  bool negotiate_x_compression();
+
+  /** @brief copies messages between the plain X protocol client and the compressing server */
+  int copy_x_compressed_messages(bool sender_is_readable, RoutingBufferPool::Lease& buffer,
+                                 size_t *report_bytes_read, bool from_server);
+
+  /**
+   * @brief checks the handshake messages of an X protocol client of a compressing server
+   *
+   * CapabilitiesSet asking for TLS or compression gets refused by the
+   * router, the connection to the server is compressed already.
+   *
+   * @return false if the first message is not a valid handshake message
+   */
+  bool filter_x_client_messages(RoutingProtocolBuffer& messages);
+
+  /** @brief hides TLS and compression from the capabilities the X protocol server sends */
+  void filter_x_server_messages(RoutingProtocolBuffer& messages);
+
+  /** @brief wakes up the thread serving the connection, see disconnect() */
+  void wakeup() noexcept;
+
+  /** @brief hands the clean session of the server connection to the pool
+   *
+   * server_socket_ is kInvalidSocket until acquire_server() is called for
+   * the next command going to the server.
+   */
+  void release_server();
+
+  /** @brief takes a session released by a client of the same identity or
+   *         connects and authenticates with the credentials of the client
+   *
+   * @return false if no server connection could be set up
+   */
+  bool acquire_server();
+
+  /** @brief moves the session to the server the route picks now, see migrate()
+   *
+   * Waits for the responses in flight. Sessions that can't be moved, or
+   * fail to, get extra_msg_ set.
+   *
+   * @return false if the connection has to be closed
+   */
+  bool migrate_session();
+
+  /** @brief sets the server connected to now and tells server_connected_callback_ */
+  void server_changed(int server_socket, const mysql_harness::TCPAddress& server_address);
+
+  /** @brief returns buffer of read_buffer_size_ bytes, borrowed from the pool
+   *         into lease if the pooled buffers are large enough */
+  RoutingBufferRef get_read_buffer(RoutingBufferPool::Lease& lease);
+
+  /** @brief reads from sender and writes to receiver through its output queue */
+  int copy_packets_queued(int sender, int receiver, bool sender_is_readable,
+                          RoutingBufferPool::Lease& buffer, OutputQueue& queue,
+                          size_t *report_bytes_read);
+
+  /** @brief writes queued data to the receiver, sets extra_msg_ on failure */
+  bool flush_output_queue(int receiver, OutputQueue& queue, const char* direction);
+
+  /** @brief pauses or resumes reading from the sender depending on the size of its queue */
+  void update_read_pause(const OutputQueue& queue, bool& reads_paused) noexcept;
+
+  /** @brief copies packets from sender to receiver
+   *
+   * Uses splice_forwarder_ once the handshake is done and falls back to
+   * BaseProtocol::copy_packets() when splicing is not possible.
+   */
+  int copy_packets(int sender, int receiver, bool sender_is_readable,
+                   RoutingBufferPool::Lease& buffer,
+                   size_t *report_bytes_read, bool from_server);
+
   /** @brief run client thread which will service this new connection */
   static void* run_thread(void* context);
-  /** @brief make address of client */
-  static std::string make_client_address(int client_socket, const MySQLRoutingContext& context);
 };
 
 #endif /* ROUTING_CONNECTION_INCLUDED */
@@ -0,0 +1,152 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "connection_budget.h"
+
+#include <stdexcept>
+
+#include "mysqlrouter/utils.h"
+
+using mysqlrouter::to_string;
+
+const std::chrono::seconds ConnectionBudget::kDemandWindow{1};
+
+ConnectionBudget::Route::~Route() {
+  budget_.leave(this);
+}
+
+bool ConnectionBudget::Route::acquire() noexcept {
+  // the reservation is the route's own, no need to look at the others
+  size_t used = used_.load(std::memory_order_relaxed);
+  while (used < reserved_) {
+    if (used_.compare_exchange_weak(used, used + 1, std::memory_order_relaxed)) return true;
+  }
+
+  return budget_.borrow(*this);
+}
+
+void ConnectionBudget::Route::release() noexcept {
+  used_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::shared_ptr<ConnectionBudget> ConnectionBudget::get_shared() {
+  static std::shared_ptr<ConnectionBudget> shared = std::make_shared<ConnectionBudget>();
+
+  return shared;
+}
+
+void ConnectionBudget::lower_limit(size_t limit) noexcept {
+  if (limit == 0) return;
+
+  size_t current = limit_.load(std::memory_order_relaxed);
+  while ((current == 0 || limit < current) &&
+         !limit_.compare_exchange_weak(current, limit, std::memory_order_relaxed)) {
+  }
+}
+
+std::unique_ptr<ConnectionBudget::Route> ConnectionBudget::join(const std::string &name, size_t reserved,
+                                                                unsigned int weight) {
+  if (weight == 0) {
+    throw std::invalid_argument("[" + name + "] connection_budget_weight needs to be greater than 0");
+  }
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  size_t reservations = reserved;
+  for (const auto route : routes_) reservations += route->reserved_;
+
+  const size_t limit = get_limit();
+  if (limit > 0 && reservations > limit) {
+    throw std::invalid_argument("[" + name + "] connection_budget_reserved of all routes (" +
+                                to_string(reservations) + ") exceeds connection_budget (" +
+                                to_string(limit) + ")");
+  }
+
+  std::unique_ptr<Route> route(new Route(*this, name, reserved, weight));
+  routes_.push_back(route.get());
+  return route;
+}
+
+void ConnectionBudget::leave(Route *route) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto it = routes_.begin(); it != routes_.end(); ++it) {
+    if (*it == route) {
+      routes_.erase(it);
+      break;
+    }
+  }
+}
+
+size_t ConnectionBudget::get_used() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  size_t used = 0;
+  for (const auto route : routes_) used += route->get_used();
+  return used;
+}
+
+bool ConnectionBudget::borrow(Route &route) noexcept {
+  std::lock_guard<std::mutex> lock(mtx_);
+  const size_t limit = get_limit();
+  if (limit == 0) {
+    route.used_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // connections given back meanwhile only leave more room than counted
+  size_t reservations = 0;
+  size_t borrowed = 0;
+  uint64_t weights = 0;
+  for (const auto other : routes_) {
+    reservations += other->reserved_;
+    borrowed += other->get_borrowed();
+    weights += other->weight_;
+  }
+  const size_t pool = limit > reservations ? limit - reservations : 0;
+  auto share = [pool, weights](const Route &r) {
+    return static_cast<size_t>(static_cast<uint64_t>(pool) * r.weight_ / weights);
+  };
+
+  const auto now = std::chrono::steady_clock::now();
+  bool admitted = borrowed < pool;
+  if (admitted && route.get_borrowed() >= share(route)) {
+    // beyond its share only what the routes wanting theirs leave unused
+    size_t kept = 0;
+    for (const auto other : routes_) {
+      if (other == &route) continue;
+
+      const size_t other_borrowed = other->get_borrowed();
+      const bool wants = other_borrowed > 0 || now - other->refused_at_ < kDemandWindow;
+      if (wants && other_borrowed < share(*other)) kept += share(*other) - other_borrowed;
+    }
+    admitted = borrowed + kept < pool;
+  }
+
+  if (!admitted) {
+    route.refused_at_ = now;
+    return false;
+  }
+
+  route.used_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,156 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_CONNECTION_BUDGET_INCLUDED
+#define ROUTING_CONNECTION_BUDGET_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief ConnectionBudget limits the client connections of all routes together.
+ *
+ * Every route joining the budget reserves a number of connections only it
+ * may use. The rest of the limit is a pool the routes borrow from once
+ * their reservation is used up. A route gets its weighted share of the
+ * pool whenever connections of the pool are free. Beyond its share it
+ * may only borrow what the other routes that borrow, or got refused in
+ * the last kDemandWindow, leave unused of their shares, so a busy route
+ * can't starve the others, neither of their reservations nor of their
+ * shares.
+ *
+ * Routes within their reservation take a connection with an atomic
+ * increment of their count, only borrowing takes the budget's lock.
+ *
+ * Routes either have no budget or use the shared one, like the shared
+ * ConnectErrorCounters. The routes sharing it may set different limits,
+ * the lowest one applies.
+ */
+class ConnectionBudget {
+ public:
+  /** @brief a route taking connections from the budget */
+  class Route {
+   public:
+    Route(const Route &) = delete;
+    Route &operator=(const Route &) = delete;
+
+    /** @brief leaves the budget, the connections still taken are given back */
+    ~Route();
+
+    /**
+     * @brief Takes a connection.
+     *
+     * @return false if the route may not have another connection now
+     */
+    bool acquire() noexcept;
+
+    /** @brief Gives back a connection taken with acquire() */
+    void release() noexcept;
+
+    /** @brief connections the route has */
+    size_t get_used() const noexcept { return used_.load(std::memory_order_relaxed); }
+
+    const std::string &get_name() const noexcept { return name_; }
+
+   private:
+    friend class ConnectionBudget;
+
+    Route(ConnectionBudget &budget, const std::string &name, size_t reserved, unsigned int weight)
+        : budget_(budget), name_(name), reserved_(reserved), weight_(weight) {}
+
+    /** @brief connections taken beyond the reservation */
+    size_t get_borrowed() const noexcept {
+      const size_t used = get_used();
+      return used > reserved_ ? used - reserved_ : 0;
+    }
+
+    ConnectionBudget &budget_;
+    const std::string name_;
+    const size_t reserved_;
+    const unsigned int weight_;
+    std::atomic<size_t> used_{0};
+    /** @brief when borrowing got refused last, only accessed with the budget's lock */
+    std::chrono::steady_clock::time_point refused_at_{};
+  };
+
+  /** @brief time a route that got refused counts as wanting its share */
+  static const std::chrono::seconds kDemandWindow;
+
+  /** @param limit connections of all routes together, 0 for no limit */
+  explicit ConnectionBudget(size_t limit = 0) : limit_(limit) {}
+
+  ConnectionBudget(const ConnectionBudget &) = delete;
+  ConnectionBudget &operator=(const ConnectionBudget &) = delete;
+
+  /**
+   * @brief Returns the budget shared by the routes.
+   *
+   * Created on first use without limit, until lower_limit() gets called.
+   */
+  static std::shared_ptr<ConnectionBudget> get_shared();
+
+  /**
+   * @brief Lowers the limit.
+   *
+   * Called by each route using the budget with its limit. Does nothing if
+   * the limit isn't lower than the current one.
+   */
+  void lower_limit(size_t limit) noexcept;
+
+  size_t get_limit() const noexcept { return limit_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Lets a route take connections.
+   *
+   * @param name name of the route, for the errors
+   * @param reserved connections only the route may use
+   * @param weight share of the pool the route gets compared to the others, at least 1
+   *
+   * @throws std::invalid_argument if the reservations of the routes exceed the limit
+   */
+  std::unique_ptr<Route> join(const std::string &name, size_t reserved, unsigned int weight);
+
+  /** @brief connections of all routes */
+  size_t get_used() const;
+
+ private:
+  /** @brief takes a connection of the pool for the route, with the lock */
+  bool borrow(Route &route) noexcept;
+
+  void leave(Route *route);
+
+  std::atomic<size_t> limit_;
+
+  /** @brief protects routes_ and serializes the borrowing */
+  mutable std::mutex mtx_;
+  std::vector<Route *> routes_;
+};
+
+#endif  // ROUTING_CONNECTION_BUDGET_INCLUDED
@@ -27,29 +27,126 @@
 
 IMPORT_LOG_FUNCTIONS()
 
+constexpr std::chrono::milliseconds ConnectionContainer::kTimerTick;
+
+ConnectionContainer::ConnectionContainer(unsigned max_connections)
+    : connections_(get_number_of_buckets(max_connections),
+                   std::hash<MySQLRoutingConnection*>(),
+                   max_connections / get_number_of_buckets(max_connections) + 1) {
+}
+
+/*static*/ unsigned ConnectionContainer::get_number_of_buckets(unsigned max_connections) noexcept {
+  return std::min(std::max(max_connections / 64, 16u), 1024u);
+}
+
 void ConnectionContainer::add_connection(
     std::unique_ptr<MySQLRoutingConnection> connection) {
-  connections_.put(connection.get(), std::move(connection));
+  MySQLRoutingConnection* conn = connection.get();
+
+  if (conn->needs_server_connect()) {
+    conn->set_server_connected_callback([this](MySQLRoutingConnection* connected,
+                                               const mysql_harness::TCPAddress& previous) {
+      add_to_server_index(connected, previous);
+    });
+  }
+
+  connections_.put(conn, std::move(connection));
+
+  if (!conn->needs_server_connect()) {
+    add_to_server_index(conn, mysql_harness::TCPAddress());
+  }
+
+  if (idle_timeout_.count() > 0 || max_lifetime_.count() > 0) {
+    std::lock_guard<std::mutex> lock(timers_mtx_);
+    timers_.schedule(conn, get_deadline(conn));
+  }
+}
+
+void ConnectionContainer::set_timeouts(std::chrono::milliseconds idle_timeout,
+                                       std::chrono::milliseconds max_lifetime) {
+  idle_timeout_ = idle_timeout;
+  max_lifetime_ = max_lifetime;
+}
+
+std::chrono::steady_clock::time_point ConnectionContainer::get_deadline(
+    const MySQLRoutingConnection* connection) const {
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  if (idle_timeout_.count() > 0) {
+    deadline = connection->get_last_forwarded_at() + idle_timeout_;
+  }
+  if (max_lifetime_.count() > 0) {
+    deadline = std::min(deadline, connection->get_accepted_at() + max_lifetime_);
+  }
+  return deadline;
+}
+
+size_t ConnectionContainer::expire_connections(std::chrono::steady_clock::time_point now) {
+  if (idle_timeout_.count() == 0 && max_lifetime_.count() == 0) return 0;
+
+  size_t expired = 0;
+  std::lock_guard<std::mutex> lock(timers_mtx_);
+  for (MySQLRoutingConnection* connection : timers_.expire(now)) {
+    // removing the connection locks timers_mtx_, it stays valid
+    if (max_lifetime_.count() > 0 && now >= connection->get_accepted_at() + max_lifetime_) {
+      connection->time_out(MySQLRoutingConnection::Timeout::kLifetime);
+    } else if (idle_timeout_.count() > 0 && now >= connection->get_last_forwarded_at() + idle_timeout_) {
+      connection->time_out(MySQLRoutingConnection::Timeout::kIdle);
+    } else {
+      timers_.schedule(connection, get_deadline(connection));
+      continue;
+    }
+    ++expired;
+  }
+
+  return expired;
+}
+
+void ConnectionContainer::add_to_server_index(MySQLRoutingConnection* connection,
+                                              const mysql_harness::TCPAddress& previous) {
+  const auto server_address = connection->get_server_address();
+
+  std::lock_guard<std::mutex> lock(connections_by_server_mtx_);
+  if (!previous.addr.empty()) {
+    auto it = connections_by_server_.find(previous);
+    if (it != connections_by_server_.end()) {
+      it->second.erase(connection);
+      if (it->second.empty()) connections_by_server_.erase(it);
+    }
+  }
+  if (!server_address.addr.empty()) connections_by_server_[server_address].insert(connection);
 }
 
 void ConnectionContainer::disconnect(const AllowedNodes& nodes) {
   unsigned number_of_disconnected_connections = 0;
+  unsigned number_of_migrating_connections = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(connections_by_server_mtx_);
+
+    for (auto& server : connections_by_server_) {
+      if (std::find(nodes.begin(), nodes.end(), server.first) != nodes.end()) continue;
 
-  auto mark_to_diconnect_if_not_allowed =
-      [&nodes, &number_of_disconnected_connections](std::pair<MySQLRoutingConnection* const,
-                                                    std::unique_ptr<MySQLRoutingConnection>>& connection) {
-    const auto& server_address = connection.first->get_server_address();
-    const std::string& client_address = connection.first->get_client_address();
-    if (std::find(nodes.begin(), nodes.end(), server_address) == nodes.end()) {
-      log_info("Disconnecting client %s from server %s", client_address.c_str(), server_address.str().c_str());
-      connection.first->disconnect();
-      ++number_of_disconnected_connections;
+      for (MySQLRoutingConnection* connection : server.second) {
+        // removing the connection locks connections_by_server_mtx_, it stays valid
+        if (migrates_sessions_) {
+          log_debug("Moving client %s away from server %s", connection->get_client_address().c_str(),
+                    server.first.str().c_str());
+          connection->migrate();
+          ++number_of_migrating_connections;
+          continue;
+        }
+        log_info("Disconnecting client %s from server %s", connection->get_client_address().c_str(),
+                 server.first.str().c_str());
+        connection->disconnect();
+        ++number_of_disconnected_connections;
+      }
     }
-  };
+  }
 
-  connections_.for_each(mark_to_diconnect_if_not_allowed);
   if (number_of_disconnected_connections > 0)
     log_info("Disconnected %u connections", number_of_disconnected_connections);
+  if (number_of_migrating_connections > 0)
+    log_info("Moving %u connections to other servers", number_of_migrating_connections);
 }
 
 void ConnectionContainer::disconnect_all() {
@@ -61,7 +158,52 @@ void ConnectionContainer::disconnect_all() {
   connections_.for_each(mark_to_disconnect);
 }
 
+void ConnectionContainer::drain_all() {
+  auto mark_to_drain =
+      [](std::pair<MySQLRoutingConnection* const, std::unique_ptr<MySQLRoutingConnection>>& connection) {
+    connection.first->drain();
+  };
+
+  connections_.for_each(mark_to_drain);
+}
+
+RouteConnectionsPage ConnectionContainer::get_connections(size_t cursor, size_t limit) {
+  RouteConnectionsPage page;
+  page.connections.reserve(limit);
+
+  auto copy_info =
+      [&page](std::pair<MySQLRoutingConnection* const, std::unique_ptr<MySQLRoutingConnection>>& connection) {
+    page.connections.push_back(connection.first->get_info());
+  };
+
+  const size_t next_bucket = connections_.for_each_from(cursor, std::max(limit, size_t{1}), copy_info);
+  page.next_cursor = next_bucket < connections_.bucket_count() ? next_bucket : 0;
+
+  return page;
+}
+
+size_t ConnectionContainer::get_active_connections(const mysql_harness::TCPAddress& server_address) {
+  std::lock_guard<std::mutex> lock(connections_by_server_mtx_);
+  auto it = connections_by_server_.find(server_address);
+  return it == connections_by_server_.end() ? 0 : it->second.size();
+}
+
 void ConnectionContainer::remove_connection(
     MySQLRoutingConnection* connection) {
+  if (idle_timeout_.count() > 0 || max_lifetime_.count() > 0) {
+    std::lock_guard<std::mutex> lock(timers_mtx_);
+    timers_.cancel(connection);
+  }
+
+  const auto server_address = connection->get_server_address();
+  if (!server_address.addr.empty()) {
+    std::lock_guard<std::mutex> lock(connections_by_server_mtx_);
+    auto it = connections_by_server_.find(server_address);
+    if (it != connections_by_server_.end()) {
+      it->second.erase(connection);
+      if (it->second.empty()) connections_by_server_.erase(it);
+    }
+  }
+
   connections_.erase(connection);
 }
@@ -26,16 +26,25 @@
 #define ROUTING_CONNECTION_CONTAINER_INCLUDED
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "connection.h"
 #include "destination.h"
 #include "mysql_routing_common.h"
+#include "mysql/harness/timer_wheel.h"
 #include "mysqlrouter/datatypes.h"
+#include "mysqlrouter/routing.h"
+#include "mysqlrouter/routing_control.h"
 #include "tcp_address.h"
 
 class MySQLRoutingConnection;
@@ -45,7 +54,11 @@ class MySQLRoutingConnection;
  *
  * The concurrent_map is a hash-map, with fixed number of buckets.
  * The numer of buckets can be specified in constructor parameter
- * (num_buckets), by default is set to 23.
+ * (num_buckets), by default is set to 127.
+ *
+ * Each bucket is guarded by its own mutex and keeps its entries in an
+ * open-addressing table (linear probing, backward shift deletion), so
+ * adding and removing entries doesn't allocate unless the table grows.
  */
 template<typename Key, typename Value, typename Hash = std::hash<Key>>
 class concurrent_map {
@@ -54,9 +67,22 @@ public:
   using key_type = Key;
   using mapped_type = Value;
   using hash_type = Hash;
+  using value_type = std::pair<const Key, Value>;
 
-  concurrent_map(unsigned num_buckets = kDefaultNumberOfBucket, const Hash& hasher = Hash()) :
+  /**
+   * @param num_buckets number of buckets
+   * @param hasher hash function of the keys
+   * @param bucket_capacity number of entries each bucket has room for
+   *        before it grows
+   */
+  concurrent_map(unsigned num_buckets = kDefaultNumberOfBucket, const Hash& hasher = Hash(),
+                 std::size_t bucket_capacity = 0) :
       buckets_(num_buckets), hasher_(hasher) {
+    if (bucket_capacity > 0) {
+      for(auto& each_bucket : buckets_) {
+        each_bucket.reserve(bucket_capacity);
+      }
+    }
   }
 
   concurrent_map(const concurrent_map& other) = delete;
@@ -64,7 +90,8 @@ public:
 
   template<typename Predicate>
   void for_one(const Key& key, Predicate& p) {
-    get_bucket(key).for_one(key, p);
+    const std::uint64_t hash = get_hash(key);
+    get_bucket(hash).for_one(hash, key, p);
   }
 
   template<typename Predicate>
@@ -74,12 +101,34 @@ public:
     }
   }
 
+  /**
+   * @brief Calls p for the entries of the buckets from first_bucket on.
+   *
+   * Locks one bucket at a time, the entries of a bucket are visited
+   * together. Stops after the bucket with which p got called at least
+   * limit times.
+   *
+   * @returns index of the bucket to continue with, bucket_count() once
+   *          the last bucket got visited
+   */
+  template<typename Predicate>
+  std::size_t for_each_from(std::size_t first_bucket, std::size_t limit, Predicate& p) {
+    std::size_t visited = 0;
+    std::size_t ndx = first_bucket;
+    while (ndx < buckets_.size() && visited < limit) {
+      visited += buckets_[ndx++].for_each(p);
+    }
+    return ndx;
+  }
+
   void put(const Key& key, Value&& value) {
-    get_bucket(key).put(key, std::move(value));
+    const std::uint64_t hash = get_hash(key);
+    get_bucket(hash).put(hash, key, std::move(value));
   }
 
   void erase(const Key& key) {
-    get_bucket(key).erase(key);
+    const std::uint64_t hash = get_hash(key);
+    get_bucket(hash).erase(hash, key);
   }
 
   std::size_t size() const {
@@ -90,62 +139,167 @@ public:
     return result;
   }
 
+  std::size_t bucket_count() const noexcept {
+    return buckets_.size();
+  }
+
 private:
   static const unsigned kDefaultNumberOfBucket = 127;
 
   class Bucket {
 
   public:
-    void put(const Key& key, Value&& value) {
+    Bucket() = default;
+    Bucket(const Bucket&) = delete;
+    Bucket& operator=(const Bucket&) = delete;
+
+    ~Bucket() {
+      for (std::size_t ndx = 0; ndx < capacity_; ++ndx) {
+        if (slots_[ndx].used) slots_[ndx].destroy();
+      }
+    }
+
+    void reserve(std::size_t entries) {
+      std::lock_guard<std::mutex> lock(data_mutex_);
+      std::size_t capacity = kMinCapacity;
+      while (is_overloaded(entries, capacity)) capacity *= 2;
+      if (capacity > capacity_) rehash(capacity);
+    }
+
+    void put(std::uint64_t hash, const Key& key, Value&& value) {
       std::lock_guard<std::mutex> lock(data_mutex_);
-      data_.emplace(key, std::move(value));
+      if (is_overloaded(size_ + 1, capacity_)) {
+        rehash(capacity_ == 0 ? kMinCapacity : capacity_ * 2);
+      }
+
+      std::size_t ndx = hash & (capacity_ - 1);
+      for (; slots_[ndx].used; ndx = (ndx + 1) & (capacity_ - 1)) {
+        // like std::map::emplace() an existing entry is kept
+        if (slots_[ndx].hash == hash && slots_[ndx].value().first == key) return;
+      }
+
+      slots_[ndx].construct(hash, value_type(key, std::move(value)));
+      ++size_;
     }
 
-    void erase(const Key& key) {
+    void erase(std::uint64_t hash, const Key& key) {
       std::lock_guard<std::mutex> lock(data_mutex_);
-      data_.erase(key);
+      std::size_t hole;
+      if (!find(hash, key, hole)) return;
+
+      slots_[hole].destroy();
+      --size_;
+
+      // move entries up into the hole unless it isn't on their probe path
+      const std::size_t mask = capacity_ - 1;
+      for (std::size_t next = (hole + 1) & mask; slots_[next].used; next = (next + 1) & mask) {
+        const std::size_t home = slots_[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+          slots_[hole].construct(slots_[next].hash, std::move(slots_[next].value()));
+          slots_[next].destroy();
+          hole = next;
+        }
+      }
     }
 
     template<typename Predicate>
-    void for_one(const Key& key, Predicate& p) {
+    void for_one(std::uint64_t hash, const Key& key, Predicate& p) {
       std::lock_guard<std::mutex> lock(data_mutex_);
-      const ConstBucketIterator found = data_.find(key);
-      if (found != data_.end())
-        p(found->second);
+      std::size_t ndx;
+      if (find(hash, key, ndx))
+        p(slots_[ndx].value().second);
     }
 
+    /** @returns number of visited entries */
     template<typename Predicate>
-    void for_each(Predicate& p) {
+    std::size_t for_each(Predicate& p) {
       std::lock_guard<std::mutex> lock(data_mutex_);
-      std::for_each(data_.begin(), data_.end(), p);
+      for (std::size_t ndx = 0; ndx < capacity_; ++ndx) {
+        if (slots_[ndx].used) p(slots_[ndx].value());
+      }
+      return size_;
     }
 
     std::size_t size() const {
       std::lock_guard<std::mutex> lock(data_mutex_);
-      return data_.size();
+      return size_;
     }
 
   private:
+    static const std::size_t kMinCapacity = 8;
+
+    struct Slot {
+      std::uint64_t hash;
+      bool used{false};
+      typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+
+      value_type& value() {
+        return *reinterpret_cast<value_type*>(&storage);
+      }
+
+      void construct(std::uint64_t h, value_type&& v) {
+        new (&storage) value_type(std::move(v));
+        hash = h;
+        used = true;
+      }
+
+      void destroy() {
+        value().~value_type();
+        used = false;
+      }
+    };
+
+    /** @brief keeps the load factor at or below 3/4 */
+    static bool is_overloaded(std::size_t entries, std::size_t capacity) {
+      return entries * 4 > capacity * 3;
+    }
 
-    using BucketData = std::map<Key, Value>;
-    using BucketIterator = typename BucketData::iterator;
-    using ConstBucketIterator = typename BucketData::const_iterator;
+    bool find(std::uint64_t hash, const Key& key, std::size_t& ndx) {
+      if (capacity_ == 0) return false;
+      for (ndx = hash & (capacity_ - 1); slots_[ndx].used; ndx = (ndx + 1) & (capacity_ - 1)) {
+        if (slots_[ndx].hash == hash && slots_[ndx].value().first == key) return true;
+      }
+      return false;
+    }
+
+    void rehash(std::size_t capacity) {
+      std::unique_ptr<Slot[]> old_slots(new Slot[capacity]);
+      std::swap(old_slots, slots_);
+      const std::size_t old_capacity = capacity_;
+      capacity_ = capacity;
+
+      for (std::size_t old_ndx = 0; old_ndx < old_capacity; ++old_ndx) {
+        Slot& old_slot = old_slots[old_ndx];
+        if (!old_slot.used) continue;
+
+        std::size_t ndx = old_slot.hash & (capacity_ - 1);
+        while (slots_[ndx].used) ndx = (ndx + 1) & (capacity_ - 1);
+        slots_[ndx].construct(old_slot.hash, std::move(old_slot.value()));
+        old_slot.destroy();
+      }
+    }
 
-    BucketData data_;
+    /** @brief capacity_ slots, capacity_ is 0 or a power of 2 */
+    std::unique_ptr<Slot[]> slots_;
+    std::size_t capacity_{0};
+    std::size_t size_{0};
     mutable std::mutex data_mutex_;
   };
 
   std::vector<Bucket> buckets_;
   Hash hasher_;
 
-  Bucket& get_bucket(const Key& key) {
-    const std::size_t bucket_index = hasher_(key) % buckets_.size();
-    return buckets_[bucket_index];
+  /** @brief hash of the key, mixed as std::hash of pointers is the identity */
+  std::uint64_t get_hash(const Key& key) const {
+    std::uint64_t z = static_cast<std::uint64_t>(hasher_(key));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
   }
 
-  const Bucket& get_bucket(const Key& key) const {
-    const std::size_t bucket_index = hasher_(key) % buckets_.size();
-    return buckets_[bucket_index];
+  // the low bits pick the slot in the bucket, the high bits the bucket
+  Bucket& get_bucket(std::uint64_t hash) {
+    return buckets_[(hash >> 32) % buckets_.size()];
   }
 };
 
@@ -159,7 +313,82 @@ private:
 class ConnectionContainer {
   concurrent_map<MySQLRoutingConnection*, std::unique_ptr<MySQLRoutingConnection>> connections_;
 
+  /** @brief connections by the server they are connected to
+   *
+   * Lets disconnect() visit only the connections of servers that are not
+   * allowed any longer. Connections still connecting are added once they
+   * are connected.
+   */
+  std::map<mysql_harness::TCPAddress, std::unordered_set<MySQLRoutingConnection*>> connections_by_server_;
+  std::mutex connections_by_server_mtx_;
+
+  /** @brief adds connection connected to a server to connections_by_server_
+   *
+   * @param connection connection that connected to a server
+   * @param previous server the connection was connected to before, empty if none
+   */
+  void add_to_server_index(MySQLRoutingConnection* connection, const mysql_harness::TCPAddress& previous);
+
+  /** @brief true if disconnect() lets the sessions move to another server */
+  bool migrates_sessions_{false};
+
+  /** @brief time without forwarding after which connections get closed, 0 if never */
+  std::chrono::milliseconds idle_timeout_{0};
+  /** @brief time after which connections get closed, 0 if never */
+  std::chrono::milliseconds max_lifetime_{0};
+
+  /** @brief connections by when they may time out, empty if no timeouts are set
+   *
+   * Forwarding doesn't touch the timers. A connection whose timer expires
+   * while it forwarded since is scheduled again for its actual deadline.
+   */
+  mysql_harness::TimerWheel<MySQLRoutingConnection*> timers_{kTimerTick, kTimerSlots};
+  std::mutex timers_mtx_;
+
+  /** @brief returns when the connection times out, unless it forwards meanwhile */
+  std::chrono::steady_clock::time_point get_deadline(const MySQLRoutingConnection* connection) const;
+
 public:
+  /** @brief precision of the timeouts */
+  static constexpr std::chrono::milliseconds kTimerTick{100};
+  /** @brief slots of each level of the timer wheel, the first level turns in 25.6 seconds */
+  static const std::size_t kTimerSlots = 256;
+
+  /**
+   * @brief Sizes the container for the connections of a route.
+   *
+   * @param max_connections max number of connections of the route
+   */
+  explicit ConnectionContainer(unsigned max_connections = routing::kDefaultMaxConnections);
+
+  /**
+   * @brief Returns number of buckets used for max_connections connections.
+   *
+   * One bucket per 64 connections, at least 16 and at most 1024.
+   */
+  static unsigned get_number_of_buckets(unsigned max_connections) noexcept;
+
+  /**
+   * @brief Sets the timeouts of the connections added afterwards.
+   *
+   * @param idle_timeout time without forwarding anything after which
+   *        connections get closed, 0 to not close idle connections
+   * @param max_lifetime time after which connections get closed, 0 to not
+   *        limit the lifetime
+   */
+  void set_timeouts(std::chrono::milliseconds idle_timeout,
+                    std::chrono::milliseconds max_lifetime);
+
+  /**
+   * @brief Disconnects the connections that timed out.
+   *
+   * Meant to be called regularly, at least every kTimerTick.
+   *
+   * @param now current time
+   *
+   * @return number of connections disconnected
+   */
+  size_t expire_connections(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
 
   /**
    * @brief Adds new connection to container.
@@ -168,19 +397,58 @@ public:
    */
   void add_connection(std::unique_ptr<MySQLRoutingConnection> connection);
 
+  /**
+   * @brief Lets disconnect() move the sessions to another server instead.
+   *
+   * See MySQLRoutingConnection::migrate().
+   */
+  void set_migrates_sessions(bool migrates_sessions) noexcept {
+    migrates_sessions_ = migrates_sessions;
+  }
+
   /**
    * @brief Disconnects all connections to servers that are not allowed any longer.
    *
+   * Only the connections of the servers not in nodes are visited. With
+   * set_migrates_sessions() the connections are asked to move instead.
+   *
    * @param nodes Allowed servers. Connections to servers that are not in nodes
    *        are closed.
    */
   void disconnect(const AllowedNodes& nodes);
 
+  /**
+   * @brief Returns number of connections connected to the server.
+   *
+   * Connections still connecting are not counted.
+   *
+   * @param server_address server the connections are connected to
+   */
+  size_t get_active_connections(const mysql_harness::TCPAddress& server_address);
+
+  /**
+   * @brief Lists a page of the connections.
+   *
+   * Pages are made of whole buckets of the map, so the cursor stays valid
+   * however connections come and go. A bucket is only locked while its
+   * connections are copied, connections get added and removed meanwhile.
+   *
+   * @param cursor 0 for the first page, else next_cursor of the previous page
+   * @param limit the page stops once it has at least that many connections
+   */
+  RouteConnectionsPage get_connections(size_t cursor, size_t limit);
+
   /**
    * @brief Disconnects all connection in the ConnectionContainer.
    */
   void disconnect_all();
 
+  /**
+   * @brief Lets all connections in the ConnectionContainer close once
+   *        they are between transactions.
+   */
+  void drain_all();
+
   /**
    * @brief removes connection from container
    *
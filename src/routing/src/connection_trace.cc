@@ -0,0 +1,162 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/connection_trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+constexpr size_t ConnectionTrace::kEventsPerThread;
+
+struct ConnectionTrace::Buffer {
+  // a slot is a seqlock: seq is 0 while the slot is written, else 1 + the
+  // index of the event in it
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> timestamp{0};
+    std::atomic<uint64_t> connection_id{0};
+    std::atomic<uint16_t> event{0};
+  };
+
+  Slot slots[kEventsPerThread];
+  /** @brief events written so far, only written by the owning thread */
+  std::atomic<uint64_t> head{0};
+};
+
+/** @brief ring buffer of the calling thread, returned when the thread exits */
+class ConnectionTrace::ThreadBuffer {
+ public:
+  ~ThreadBuffer() {
+    if (buffer_) ConnectionTrace::getInstance().release_buffer(buffer_);
+  }
+
+  Buffer &get() {
+    if (!buffer_) buffer_ = ConnectionTrace::getInstance().acquire_buffer();
+
+    return *buffer_;
+  }
+
+ private:
+  Buffer *buffer_{nullptr};
+};
+
+ConnectionTrace::ConnectionTrace() = default;
+
+ConnectionTrace::~ConnectionTrace() = default;
+
+ConnectionTrace &ConnectionTrace::getInstance() {
+  static ConnectionTrace instance;
+
+  return instance;
+}
+
+uint64_t ConnectionTrace::now() noexcept {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+const char *ConnectionTrace::event_name(Event event) noexcept {
+  switch (event) {
+    case Event::kAccepted: return "accepted";
+    case Event::kConnectStarted: return "connect_started";
+    case Event::kServerConnected: return "server_connected";
+    case Event::kServerConnectFailed: return "server_connect_failed";
+    case Event::kHandshakeDone: return "handshake_done";
+    case Event::kFirstByteFromClient: return "first_byte_from_client";
+    case Event::kFirstByteFromServer: return "first_byte_from_server";
+    case Event::kLastByteFromClient: return "last_byte_from_client";
+    case Event::kLastByteFromServer: return "last_byte_from_server";
+    case Event::kClosed: return "closed";
+  }
+
+  return "unknown";
+}
+
+ConnectionTrace::Buffer *ConnectionTrace::acquire_buffer() {
+  std::lock_guard<std::mutex> lock(buffers_mtx_);
+  if (!free_buffers_.empty()) {
+    Buffer *buffer = free_buffers_.back();
+    free_buffers_.pop_back();
+    return buffer;
+  }
+
+  buffers_.emplace_back(new Buffer());
+  return buffers_.back().get();
+}
+
+void ConnectionTrace::release_buffer(Buffer *buffer) {
+  std::lock_guard<std::mutex> lock(buffers_mtx_);
+  free_buffers_.push_back(buffer);
+}
+
+void ConnectionTrace::record(uint64_t connection_id, Event event, uint64_t timestamp) noexcept {
+  static thread_local ThreadBuffer thread_buffer;
+  Buffer &buffer = thread_buffer.get();
+
+  const uint64_t ndx = buffer.head.load(std::memory_order_relaxed);
+  Buffer::Slot &slot = buffer.slots[ndx % kEventsPerThread];
+
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.timestamp.store(timestamp, std::memory_order_relaxed);
+  slot.connection_id.store(connection_id, std::memory_order_relaxed);
+  slot.event.store(static_cast<uint16_t>(event), std::memory_order_relaxed);
+  slot.seq.store(ndx + 1, std::memory_order_release);
+
+  buffer.head.store(ndx + 1, std::memory_order_release);
+}
+
+std::vector<ConnectionTrace::Record> ConnectionTrace::get_snapshot() const {
+  std::vector<Record> records;
+
+  {
+    std::lock_guard<std::mutex> lock(buffers_mtx_);
+    for (const auto &buffer: buffers_) {
+      const uint64_t head = buffer->head.load(std::memory_order_acquire);
+      const uint64_t first = head > kEventsPerThread ? head - kEventsPerThread : 0;
+
+      for (uint64_t ndx = first; ndx < head; ++ndx) {
+        const Buffer::Slot &slot = buffer->slots[ndx % kEventsPerThread];
+
+        if (slot.seq.load(std::memory_order_acquire) != ndx + 1) continue;
+        Record record{slot.timestamp.load(std::memory_order_relaxed),
+                      slot.connection_id.load(std::memory_order_relaxed),
+                      static_cast<Event>(slot.event.load(std::memory_order_relaxed))};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // overwritten while it got copied
+        if (slot.seq.load(std::memory_order_relaxed) != ndx + 1) continue;
+
+        records.push_back(record);
+      }
+    }
+  }
+
+  std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+    return a.connection_id < b.connection_id ||
+           (a.connection_id == b.connection_id && a.timestamp < b.timestamp);
+  });
+
+  return records;
+}
@@ -53,6 +53,8 @@ MySQLRoutingContext ::MySQLRoutingContext(BaseProtocol* protocol,
   bind_address_(bind_address),
   bind_named_socket_(bind_named_socket),
   thread_stack_size_(thread_stack_size),
+  buffer_pool_(net_buffer_length, routing::kDefaultBufferPoolSize),
+  conn_error_counters_(std::make_shared<ConnectErrorCounters>(max_connect_errors)),
   max_connect_errors_(max_connect_errors) {
 
 }
@@ -60,17 +62,15 @@ MySQLRoutingContext ::MySQLRoutingContext(BaseProtocol* protocol,
 bool MySQLRoutingContext::block_client_host(const ClientIpArray& client_ip_array,
     const std::string &client_ip_str, int server) {
   bool blocked = false;
-  {
-    std::lock_guard<std::mutex> lock(mutex_conn_errors_);
-
-    if (++conn_error_counters_[client_ip_array] >= max_connect_errors_) {
-      log_warning("[%s] blocking client host %s", name_.c_str(), client_ip_str.c_str());
-      blocked = true;
-    } else {
-      log_info("[%s] %lu connection errors for %s (max %llu)", name_.c_str(),
-               static_cast<unsigned long>(conn_error_counters_[client_ip_array]), // 32bit Linux requires cast
-               client_ip_str.c_str(), max_connect_errors_);
-    }
+  const size_t errors = conn_error_counters_->increment(client_ip_array);
+
+  if (errors >= max_connect_errors_) {
+    log_warning("[%s] blocking client host %s", name_.c_str(), client_ip_str.c_str());
+    blocked = true;
+  } else {
+    log_info("[%s] %lu connection errors for %s (max %llu)", name_.c_str(),
+             static_cast<unsigned long>(errors), // 32bit Linux requires cast
+             client_ip_str.c_str(), max_connect_errors_);
   }
 
   if (server >= 0) {
@@ -81,16 +81,16 @@ bool MySQLRoutingContext::block_client_host(const ClientIpArray& client_ip_array
 }
 
 const std::vector<ClientIpArray> MySQLRoutingContext::get_blocked_client_hosts() const {
-  std::lock_guard<std::mutex> lock(mutex_conn_errors_);
+  return conn_error_counters_->get_blocked(max_connect_errors_);
+}
 
-  std::vector<ClientIpArray> result;
-  for(const auto& client_ip: conn_error_counters_) {
-    if (client_ip.second >= max_connect_errors_) {
-      result.push_back(client_ip.first);
-    }
-  }
+bool MySQLRoutingContext::is_client_host_blocked(const ClientIpArray& client_ip_array) const {
+  return conn_error_counters_->is_blocked(client_ip_array, max_connect_errors_);
+}
 
-  return result;
+void MySQLRoutingContext::share_connect_errors() {
+  conn_error_counters_ = ConnectErrorCounters::get_shared();
+  conn_error_counters_->lower_max_connect_errors(max_connect_errors_);
 }
 
 void MySQLRoutingContext::increase_active_thread_counter() {
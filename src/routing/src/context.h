@@ -35,14 +35,24 @@
 #include <condition_variable>
 #include <atomic>
 
+#include "buffer_pool.h"
+#include "connect_error_counters.h"
 #include "mysqlrouter/routing.h"
 #include "mysqlrouter/datatypes.h"
 #include "mysql_router_thread.h"
+#include "sharded_counter.h"
 #include "tcp_address.h"
 #include "mysql/harness/filesystem.h"
 #include "utils.h"
 
 class BaseProtocol;
+class BackendConnectionPool;
+class TlsServerContext;
+class QueryDigestStats;
+class ResultCache;
+class TrafficMirror;
+class RoutingMetrics;
+class RoutingIOEngine;
 namespace routing { class RoutingSockOpsInterface; }
 namespace mysql_harness { class SocketOperationsBase; }
 
@@ -88,6 +98,23 @@ public:
    */
   const std::vector<ClientIpArray> get_blocked_client_hosts() const;
 
+  /** @brief Returns true if the client host reached max_connect_errors
+   *
+   * Doesn't lock, safe to call from several acceptor threads.
+   *
+   * @param client_ip_array IP address of the client host
+   */
+  bool is_client_host_blocked(const ClientIpArray& client_ip_array) const;
+
+  /** @brief Counts the connection errors in the counters shared by the routes
+   *
+   * Hosts blocked by one of the routes sharing the counters are blocked by
+   * the others once they reach their max_connect_errors too, the errors
+   * counted on any of them add up. Needs to be called before the route
+   * gets started.
+   */
+  void share_connect_errors();
+
   void increase_active_thread_counter();
   void decrease_active_thread_counter();
   void increase_info_active_routes();
@@ -107,7 +134,16 @@ public:
   }
 
   unsigned int get_net_buffer_length() const {
-    return net_buffer_length_;
+    return net_buffer_length_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Changes the read buffer size of new connections
+   *
+   * The buffer pools keep lending buffers of the size the route started
+   * with, larger sizes are read into buffers of the connection's own.
+   */
+  void set_net_buffer_length(unsigned int net_buffer_length) {
+    net_buffer_length_.store(net_buffer_length, std::memory_order_relaxed);
   }
 
   std::chrono::milliseconds get_destination_connect_timeout() const {
@@ -118,6 +154,14 @@ public:
     return client_connect_timeout_;
   }
 
+  std::chrono::milliseconds get_destination_connect_deadline() const {
+    return destination_connect_deadline_;
+  }
+
+  void set_destination_connect_deadline(std::chrono::milliseconds deadline) {
+    destination_connect_deadline_ = deadline;
+  }
+
   const mysql_harness::TCPAddress& get_bind_address() const {
     return bind_address_;
   }
@@ -130,6 +174,226 @@ public:
     return thread_stack_size_;
   }
 
+  /** @brief Returns kilobytes of stack of the threads serving a single connection */
+  size_t get_connection_thread_stack_size() const {
+    return connection_thread_stack_size_;
+  }
+
+  void set_connection_thread_stack_size(size_t connection_thread_stack_size) {
+    connection_thread_stack_size_ = connection_thread_stack_size;
+  }
+
+  /** @brief Returns I/O engine serving the connections
+   *
+   * @return I/O engine or nullptr if every connection runs in its own thread
+   */
+  RoutingIOEngine* get_io_engine() const {
+    return io_engine_;
+  }
+
+  void set_io_engine(RoutingIOEngine* io_engine) {
+    io_engine_ = io_engine;
+  }
+
+  /** @brief Returns pool of idle server connections
+   *
+   * @return pool or nullptr if server connections are not pooled
+   */
+  BackendConnectionPool* get_backend_pool() const {
+    return backend_pool_;
+  }
+
+  void set_backend_pool(BackendConnectionPool* backend_pool) {
+    backend_pool_ = backend_pool;
+  }
+
+  /** @brief Returns TLS context terminating client TLS at the router
+   *
+   * @return context or nullptr if TLS of the clients is passed to the servers
+   */
+  TlsServerContext* get_client_tls_context() const {
+    return client_tls_context_;
+  }
+
+  void set_client_tls_context(TlsServerContext* client_tls_context) {
+    client_tls_context_ = client_tls_context;
+  }
+
+  /** @brief Returns pool lending buffers to the connections not served by an I/O engine */
+  RoutingBufferPool& get_buffer_pool() {
+    return buffer_pool_;
+  }
+
+  /** @brief Returns max number of idle buffers kept by each buffer pool */
+  size_t get_buffer_pool_size() const {
+    return buffer_pool_size_;
+  }
+
+  void set_buffer_pool_size(size_t buffer_pool_size) {
+    buffer_pool_size_ = buffer_pool_size;
+    buffer_pool_.set_max_idle_buffers(buffer_pool_size);
+  }
+
+  /** @brief Returns true if traffic after the handshake is forwarded using splice() */
+  bool is_splice_enabled() const {
+    return splice_enabled_;
+  }
+
+  void set_splice_enabled(bool splice_enabled) {
+    splice_enabled_ = splice_enabled;
+  }
+
+  /** @brief Returns true if clients hand their pooled server connection back between transactions */
+  bool is_connection_multiplexing() const {
+    return connection_multiplexing_;
+  }
+
+  void set_connection_multiplexing(bool connection_multiplexing) {
+    connection_multiplexing_ = connection_multiplexing;
+  }
+
+  /** @brief Returns true if sessions move to another server when theirs leaves the destinations */
+  bool is_session_migration() const {
+    return session_migration_;
+  }
+
+  void set_session_migration(bool session_migration) {
+    session_migration_ = session_migration;
+  }
+
+  /** @brief Returns statements kept prepared per server session for multiplexed clients, 0 if not translated */
+  size_t get_prepared_statement_cache_size() const {
+    return prepared_statement_cache_size_;
+  }
+
+  void set_prepared_statement_cache_size(size_t prepared_statement_cache_size) {
+    prepared_statement_cache_size_ = prepared_statement_cache_size;
+  }
+
+  /** @brief Returns true if the router compresses the traffic to the servers for clients that don't */
+  bool is_server_compression() const {
+    return server_compression_;
+  }
+
+  void set_server_compression(bool server_compression) {
+    server_compression_ = server_compression;
+  }
+
+  /** @brief Returns true if the phases of the connections are recorded to ConnectionTrace */
+  bool is_connection_trace() const {
+    return connection_trace_;
+  }
+
+  void set_connection_trace(bool connection_trace) {
+    connection_trace_ = connection_trace;
+  }
+
+  /** @brief Returns the CPUs the threads of the route are pinned to, empty if not pinned */
+  const std::vector<unsigned>& get_cpu_affinity() const {
+    return cpu_affinity_;
+  }
+
+  void set_cpu_affinity(const std::vector<unsigned>& cpus) {
+    cpu_affinity_ = cpus;
+  }
+
+  /** @brief Returns statistics the sampled statements are added to, nullptr if not sampling */
+  const std::shared_ptr<QueryDigestStats>& get_query_digest_stats() const {
+    return query_digest_stats_;
+  }
+
+  /** @brief Returns statements per connection of which one gets sampled */
+  uint64_t get_query_digest_sampling() const {
+    return query_digest_sampling_;
+  }
+
+  void set_query_digest_sampling(uint64_t interval, std::shared_ptr<QueryDigestStats> stats) {
+    query_digest_sampling_ = interval;
+    query_digest_stats_ = stats;
+  }
+
+  /** @brief Returns cache for the responses of the secondaries, nullptr if not caching */
+  const std::shared_ptr<ResultCache>& get_result_cache() const {
+    return result_cache_;
+  }
+
+  void set_result_cache(std::shared_ptr<ResultCache> result_cache) {
+    result_cache_ = result_cache;
+  }
+
+  /** @brief Returns mirror sending the commands of the clients to a shadow server, nullptr if not mirroring */
+  const std::shared_ptr<TrafficMirror>& get_traffic_mirror() const {
+    return traffic_mirror_;
+  }
+
+  void set_traffic_mirror(std::shared_ptr<TrafficMirror> traffic_mirror) {
+    traffic_mirror_ = traffic_mirror;
+  }
+
+  /** @brief Returns counters of the route, nullptr if not counting */
+  const std::shared_ptr<RoutingMetrics>& get_metrics() const {
+    return metrics_;
+  }
+
+  void set_metrics(std::shared_ptr<RoutingMetrics> metrics) {
+    metrics_ = metrics;
+  }
+
+  /** @brief Returns options applied to the listeners and server connections */
+  const routing::SocketOptions& get_socket_options() const {
+    return socket_options_;
+  }
+
+  void set_socket_options(const routing::SocketOptions& socket_options) {
+    socket_options_ = socket_options;
+  }
+
+  /** @brief Returns size up to which the read buffer of busy connections
+   *         grows, not above get_net_buffer_length() if it doesn't grow */
+  size_t get_max_net_buffer_length() const {
+    return max_net_buffer_length_;
+  }
+
+  void set_max_net_buffer_length(size_t max_net_buffer_length) {
+    max_net_buffer_length_ = max_net_buffer_length;
+  }
+
+  /** @brief Returns size of an output queue at which reading from the other
+   *         side is paused, 0 if writes are blocking */
+  size_t get_output_queue_high_watermark() const {
+    return output_queue_high_watermark_;
+  }
+
+  /** @brief Returns size of an output queue at which paused reading resumes */
+  size_t get_output_queue_low_watermark() const {
+    return output_queue_low_watermark_;
+  }
+
+  void set_output_queue_watermarks(size_t high_watermark, size_t low_watermark) {
+    output_queue_high_watermark_ = high_watermark;
+    output_queue_low_watermark_ = low_watermark;
+  }
+
+  /** @brief Returns true if the forwarded data goes through output queues
+   *
+   * The I/O threads of the event engine never block on writes, they always
+   * queue what the sockets don't take. Without watermarks the reads from
+   * the other side pause while anything is queued.
+   */
+  bool uses_output_queues() const {
+    return output_queue_high_watermark_ > 0 || io_engine_ != nullptr;
+  }
+
+  /** @brief Returns size from which data for the clients is sent using
+   *         MSG_ZEROCOPY, 0 if it is always copied */
+  size_t get_zero_copy_threshold() const {
+    return zero_copy_threshold_;
+  }
+
+  void set_zero_copy_threshold(size_t threshold) {
+    zero_copy_threshold_ = threshold;
+  }
+
 private:
   /** @brief object to handle protocol specific stuff */
   std::unique_ptr<BaseProtocol> protocol_;
@@ -140,8 +404,8 @@ private:
   /** @brief Descriptive name of the connection routing */
   const std::string name_;
 
-  /** @brief Size of buffer to store receiving packets */
-  unsigned int net_buffer_length_;
+  /** @brief Size of buffer to store receiving packets, may change while the route runs */
+  std::atomic<unsigned int> net_buffer_length_;
 
   /** @brief Timeout connecting to destination
    *
@@ -152,6 +416,9 @@ private:
    */
   std::chrono::milliseconds destination_connect_timeout_;
 
+  /** @brief Time all attempts to connect a destination for a client may take, 0 for no limit */
+  std::chrono::milliseconds destination_connect_deadline_{0};
+
   /** @brief Timeout waiting for handshake response from client */
   std::chrono::milliseconds client_connect_timeout_;
 
@@ -164,11 +431,71 @@ private:
     /** @brief memory in kilobytes allocated for thread's stack */
   size_t thread_stack_size_ = mysql_harness::kDefaultStackSizeInKiloBytes;
 
-  mutable std::mutex mutex_conn_errors_;
+  /** @brief I/O engine serving the connections (not owned), nullptr for thread per connection */
+  RoutingIOEngine* io_engine_ = nullptr;
+
+  /** @brief pool of idle server connections (not owned), nullptr if not pooled */
+  BackendConnectionPool* backend_pool_ = nullptr;
+
+  /** @brief TLS context for the clients (not owned), nullptr if not terminated at the router */
+  TlsServerContext* client_tls_context_ = nullptr;
+
+  /** @brief forward classic protocol traffic after the handshake using splice() */
+  bool splice_enabled_ = false;
+
+  /** @brief release clean sessions of the server connections between transactions */
+  bool connection_multiplexing_ = false;
+
+  /** @brief move idle sessions to another server once theirs leaves the destinations */
+  bool session_migration_ = false;
+
+  /** @brief translate ids of prepared statements, keeping that many prepared per server session */
+  size_t prepared_statement_cache_size_ = 0;
+
+  /** @brief compress the traffic to the servers independent of the clients */
+  bool server_compression_ = false;
+
+  /** @brief record the phases of the connections to ConnectionTrace */
+  bool connection_trace_ = false;
+
+  /** @brief CPUs the threads of the route are pinned to, empty if not pinned */
+  std::vector<unsigned> cpu_affinity_;
+
+  /** @brief kilobytes of stack of the threads serving a single connection */
+  size_t connection_thread_stack_size_ = mysql_harness::kDefaultConnectionStackSizeInKiloBytes;
+
+  /** @brief sample one of query_digest_sampling_ statements, 0 if not sampling */
+  uint64_t query_digest_sampling_ = 0;
+  std::shared_ptr<QueryDigestStats> query_digest_stats_;
+  std::shared_ptr<ResultCache> result_cache_;
+  std::shared_ptr<TrafficMirror> traffic_mirror_;
+
+  /** @brief counters exported by the metrics endpoint */
+  std::shared_ptr<RoutingMetrics> metrics_;
+
+  /** @brief options applied to the listeners and server connections */
+  routing::SocketOptions socket_options_;
+
+  /** @brief size up to which read buffers of busy connections grow */
+  size_t max_net_buffer_length_ = 0;
+
+  /** @brief output queue size pausing reads from the other side, 0 for blocking writes */
+  size_t output_queue_high_watermark_ = 0;
+  /** @brief output queue size resuming paused reads */
+  size_t output_queue_low_watermark_ = 0;
+
+  /** @brief size of writes to the clients using MSG_ZEROCOPY, 0 to always copy */
+  size_t zero_copy_threshold_ = 0;
+
+  /** @brief max number of idle buffers kept by each buffer pool */
+  size_t buffer_pool_size_ = routing::kDefaultBufferPoolSize;
+
+  /** @brief buffers for connections running in their own thread */
+  RoutingBufferPool buffer_pool_;
 
 public:
-  /** @brief Connection error counters for IPv4 or IPv6 hosts */
-  std::map<ClientIpArray, size_t> conn_error_counters_;
+  /** @brief Connection error counters for IPv4 or IPv6 hosts, maybe shared with other routes */
+  std::shared_ptr<ConnectErrorCounters> conn_error_counters_;
 
   /** @brief Max connect errors blocking hosts when handshake not completed */
   unsigned long long max_connect_errors_;
@@ -178,9 +505,9 @@ public:
   std::condition_variable active_client_threads_cond_;
   std::mutex active_client_threads_cond_m_;
 
-  /** @brief Number of active routes */
-  std::atomic<uint16_t> info_active_routes_{0};
+  /** @brief Number of active routes, updated by every connection */
+  ShardedCounter info_active_routes_;
   /** @brief Number of handled routes, not used at the moment */
-  std::atomic<uint64_t> info_handled_routes_{0};
+  ShardedCounter info_handled_routes_;
 };
 #endif /* ROUTING_CONTEXT_INCLUDED */
@@ -0,0 +1,67 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "dest_consistent_hash.h"
+
+#include <cerrno>
+
+IMPORT_LOG_FUNCTIONS()
+
+int DestConsistentHash::get_server_socket_for_client(uint64_t client_key,
+                                                     std::chrono::milliseconds connect_timeout, int *error,
+                                                     mysql_harness::TCPAddress *address) noexcept {
+  std::vector<size_t> ranked;
+  try {
+    ranked = rank_by_rendezvous_hash(destinations_, client_key);
+  } catch (const std::bad_alloc&) {
+    *error = ENOMEM;
+    return -1;
+  }
+
+  for (size_t server_pos: ranked) {
+    // the next server of the ranking serves the client meanwhile
+    if (!is_usable(server_pos)) continue;
+
+    const mysql_harness::TCPAddress &server_addr = destinations_[server_pos];
+    log_debug("Trying server %s (index %lu)", server_addr.str().c_str(),
+              static_cast<long unsigned>(server_pos));
+    auto sock = get_mysql_socket(server_addr, connect_timeout);
+    if (sock >= 0) {
+      if (address) *address = server_addr;
+      return sock;
+    }
+
+#ifndef _WIN32
+    *error = errno;
+#else
+    *error = WSAGetLastError();
+#endif
+    if (errno == ENFILE || errno == EMFILE) break;
+
+    add_to_quarantine(server_pos);
+  }
+
+  return -1; // no destination is available
+}
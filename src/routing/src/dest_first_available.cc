@@ -25,6 +25,9 @@
 #include "dest_first_available.h"
 #include "mysql/harness/logging/logging.h"
 
+#include <cerrno>
+#include <vector>
+
 #ifdef _WIN32
 #  define WIN32_LEAN_AND_MEAN
 #  include <windows.h>
@@ -40,20 +43,49 @@ int DestFirstAvailable::get_server_socket(std::chrono::milliseconds connect_time
     return -1;
   }
 
+  // servers known to fail get tried once all others failed
+  std::vector<size_t> backing_off;
   for (size_t i = 0; i < destinations_.size(); ++i) {
     // We start at the currently available server
-    auto addr = destinations_.at(current_pos_);
+    const size_t pos = current_pos_;
+    auto addr = destinations_.at(pos);
+    // fails over as if the connect failed
+    if (is_circuit_open(addr)) {
+      if (++current_pos_ >= destinations_.size()) current_pos_ = 0;
+      continue;
+    }
+    if (is_backing_off(addr)) {
+      backing_off.push_back(pos);
+      if (++current_pos_ >= destinations_.size()) current_pos_ = 0;
+      continue;
+    }
     log_debug("Trying server %s (index %lu)", addr.str().c_str(),
               static_cast<long unsigned>(i)); // 32bit Linux requires cast
     auto sock = get_mysql_socket(addr, connect_timeout);
     if (sock >= 0) {
+      report_connect(addr, true);
       if (address) *address = addr;
       return sock;
     } else {
+      if (errno != ENFILE && errno != EMFILE) report_connect(addr, false);
       if (++current_pos_ >= destinations_.size()) current_pos_ = 0;
     }
   }
 
+  for (size_t pos : backing_off) {
+    auto addr = destinations_.at(pos);
+    log_debug("Trying server %s (index %lu) again", addr.str().c_str(),
+              static_cast<long unsigned>(pos)); // 32bit Linux requires cast
+    auto sock = get_mysql_socket(addr, connect_timeout);
+    if (sock >= 0) {
+      report_connect(addr, true);
+      current_pos_ = pos;
+      if (address) *address = addr;
+      return sock;
+    }
+    if (errno != ENFILE && errno != EMFILE) report_connect(addr, false);
+  }
+
 #ifndef _WIN32
   *error = errno;
 #else
@@ -32,6 +32,13 @@
 
 #include "mysql/harness/logging/logging.h"
 
+/**
+ * Connects to the first server that is available, starting at the one the
+ * last connection went to.
+ *
+ * Servers that failed lately or are quarantined by other routes are only
+ * tried once all the others failed, see RouteDestination::is_backing_off().
+ */
 class DestFirstAvailable final : public RouteDestination {
  public:
   using RouteDestination::RouteDestination;
@@ -0,0 +1,61 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "dest_least_connections.h"
+
+#include <limits>
+#include <stdexcept>
+
+size_t DestLeastConnections::select_server() {
+  const size_t num_servers = destinations_.size();
+  if (num_servers == 0) {
+    throw std::runtime_error("Destination servers list is empty");
+  }
+
+  // where the search starts rotates, it decides between equally busy servers
+  const size_t start = current_pos_.fetch_add(1, std::memory_order_relaxed);
+  size_t result = start % num_servers;
+  size_t result_connections = std::numeric_limits<size_t>::max();
+  const auto scores = scoreboard_->get_all();
+
+  for (size_t i = 0; i < num_servers; ++i) {
+    const size_t index = (start + i) % num_servers;
+    if (!is_usable(index)) continue;
+
+    size_t connections = 0;
+    if (connection_counter_) {
+      connections = connection_counter_(destinations_[index]);
+    } else {
+      auto it = scores->find(destinations_[index]);
+      if (it != scores->end()) connections = static_cast<size_t>(it->second->get_active_connections());
+    }
+    if (connections < result_connections) {
+      result = index;
+      result_connections = connections;
+    }
+  }
+
+  return result;
+}
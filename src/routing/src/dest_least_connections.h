@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_DEST_LEAST_CONNECTIONS_INCLUDED
+#define ROUTING_DEST_LEAST_CONNECTIONS_INCLUDED
+
+#include <functional>
+
+#include "dest_round_robin.h"
+
+/**
+ * @brief Routes new connections to the destination serving the fewest.
+ *
+ * Quarantines unreachable destinations like DestRoundRobin. Ties are
+ * broken round-robin, which also spreads the connections while their
+ * connects to the servers are still in progress and not counted yet.
+ */
+class DestLeastConnections final : public DestRoundRobin {
+ public:
+  /** @brief returns number of connections routed to the server */
+  using ConnectionCounter = std::function<size_t(const mysql_harness::TCPAddress&)>;
+
+  /** @brief Constructor
+   *
+   * @param connection_counter counts the connections routed to a server,
+   *        without one the active connections on the scoreboard are used
+   * @param protocol Protocol for the destination
+   * @param routing_sock_ops Socket operations implementation to use
+   * @param thread_stack_size memory in kilobytes allocated for thread's stack
+   */
+  DestLeastConnections(ConnectionCounter connection_counter = nullptr,
+                       Protocol::Type protocol = Protocol::get_default(),
+                       routing::RoutingSockOpsInterface *routing_sock_ops =
+                           routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance()),
+                       size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes)
+      : DestRoundRobin(protocol, routing_sock_ops, thread_stack_size),
+        connection_counter_(connection_counter) {}
+
+ protected:
+  /** @brief Picks the usable destination with the fewest connections
+   *
+   * Checks every destination with is_usable(), which may lock, and a
+   * connection counter may lock per destination too.
+   */
+  size_t select_server() override;
+
+ private:
+  ConnectionCounter connection_counter_;
+};
+
+#endif // ROUTING_DEST_LEAST_CONNECTIONS_INCLUDED
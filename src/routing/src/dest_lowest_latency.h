@@ -0,0 +1,48 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_DEST_LOWEST_LATENCY_INCLUDED
+#define ROUTING_DEST_LOWEST_LATENCY_INCLUDED
+
+#include "dest_round_robin.h"
+
+/**
+ * @brief Routes new connections to the servers closest to the router.
+ *
+ * Closeness is the smoothed round trip time of connecting to the server,
+ * measured passively on the connects of the routed connections, see
+ * RouteDestination::select_lowest_latency(). Quarantines unreachable
+ * destinations like DestRoundRobin.
+ */
+class DestLowestLatency final : public DestRoundRobin {
+ public:
+  using DestRoundRobin::DestRoundRobin;
+
+ protected:
+  /** @brief Picks a usable destination with the lowest latency */
+  size_t select_server() override;
+};
+
+#endif // ROUTING_DEST_LOWEST_LATENCY_INCLUDED
@@ -27,7 +27,9 @@
 #include "mysqlrouter/routing.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <set>
 #ifndef _WIN32
@@ -56,7 +58,10 @@ static const int kPrimaryFailoverTimeout = 10;
 
 static const std::set<std::string> supported_params{"role", "allow_primary_reads",
                                                     "disconnect_on_promoted_to_primary",
-                                                    "disconnect_on_metadata_unavailable"};
+                                                    "disconnect_on_metadata_unavailable",
+                                                    "read_write_splitting",
+                                                    "max_applier_queue_size",
+                                                    "read_your_writes"};
 
 namespace {
 
@@ -168,6 +173,58 @@ bool get_disconnect_on_metadata_unavailable(const mysqlrouter::URIQuery &uri) {
   return get_yes_no_option(uri, kOptionName, /*default=*/ false, check_option_allowed);
 }
 
+// throws runtime_error if the parameter has wrong value or is not allowed for given configuration
+bool get_read_write_splitting(const mysqlrouter::URIQuery &uri,
+                              const DestMetadataCacheGroup::ServerRole& role,
+                              const Protocol::Type protocol) {
+  const std::string kOptionName = "read_write_splitting";
+  auto check_option_allowed = [&]() {
+    if (role != DestMetadataCacheGroup::ServerRole::Primary) {
+      throw std::runtime_error("Option '" + kOptionName + "' is valid only for role=PRIMARY");
+    }
+    if (protocol != Protocol::Type::kClassicProtocol) {
+      throw std::runtime_error("Option '" + kOptionName + "' is valid only for the classic protocol");
+    }
+  };
+
+  return get_yes_no_option(uri, kOptionName, /*default=*/ false, check_option_allowed);
+}
+
+// throws runtime_error if the parameter has wrong value or is not allowed for given configuration
+bool get_read_your_writes(const mysqlrouter::URIQuery &uri, const bool read_write_splitting) {
+  const std::string kOptionName = "read_your_writes";
+  auto check_option_allowed = [&]() {
+    if (!read_write_splitting) {
+      throw std::runtime_error("Option '" + kOptionName + "' is valid only with read_write_splitting=yes");
+    }
+  };
+
+  return get_yes_no_option(uri, kOptionName, /*default=*/ false, check_option_allowed);
+}
+
+// throws runtime_error if the parameter has wrong value or is not allowed for given configuration
+uint64_t get_max_applier_queue_size(const mysqlrouter::URIQuery &uri,
+                                    const DestMetadataCacheGroup::ServerRole& role,
+                                    const bool read_write_splitting) {
+  const std::string kOptionName = "max_applier_queue_size";
+  if (uri.find(kOptionName) == uri.end())
+    return 0;
+
+  if (role == DestMetadataCacheGroup::ServerRole::Primary && !read_write_splitting) {
+    throw std::runtime_error("Option '" + kOptionName + "' is valid only for routes reading from secondaries");
+  }
+
+  const std::string &value = uri.at(kOptionName);
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long long result = std::strtoull(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || value[0] == '-' || errno == ERANGE) {
+    throw std::runtime_error("Invalid value for option '" + kOptionName + "'. Allowed is a number of transactions");
+  }
+
+  return result;
+}
+
 } // namespace {
 
 
@@ -192,7 +249,10 @@ DestMetadataCacheGroup::DestMetadataCacheGroup(const std::string &metadata_cache
     server_role_(get_server_role_from_uri(query)),
     cache_api_(cache_api),
     disconnect_on_promoted_to_primary_(get_disconnect_on_promoted_to_primary(query, server_role_)),
-    disconnect_on_metadata_unavailable_(get_disconnect_on_metadata_unavailable(query)) {
+    disconnect_on_metadata_unavailable_(get_disconnect_on_metadata_unavailable(query)),
+    read_write_splitting_(get_read_write_splitting(query, server_role_, protocol)),
+    read_your_writes_(get_read_your_writes(query, read_write_splitting_)),
+    max_applier_queue_size_(get_max_applier_queue_size(query, server_role_, read_write_splitting_)) {
 
   init();
 }
@@ -220,6 +280,24 @@ DestMetadataCacheGroup::AvailableDestinations DestMetadataCacheGroup::get_availa
     primary_fallback = secondary == managed_servers_vec.end();
   }
 
+  // secondaries lagging behind are left out as long as another server
+  // can take their reads
+  bool skip_lagging{false};
+  if (max_applier_queue_size_ > 0) {
+    skip_lagging = std::any_of(managed_servers_vec.begin(), managed_servers_vec.end(),
+            [this](const metadata_cache::ManagedInstance& i)
+            {
+              return i.role == metadata_cache::InstanceRole::HA &&
+                     ((i.mode == metadata_cache::ServerMode::ReadOnly && !is_lagging(i)) ||
+                      (i.mode == metadata_cache::ServerMode::ReadWrite &&
+                       server_role_ == ServerRole::PrimaryAndSecondary));
+            });
+    if (!skip_lagging && routing_strategy_ == routing::RoutingStrategy::kRoundRobinWithFallback) {
+      skip_lagging = true;
+      primary_fallback = true;
+    }
+  }
+
   // if we are gathering the nodes for the decision about keeping existing connections
   // we look also at the disconnect_on_promoted_to_primary_ setting
   // if set to 'no' we need to allow primaries for role=SECONDARY
@@ -228,7 +306,10 @@ DestMetadataCacheGroup::AvailableDestinations DestMetadataCacheGroup::get_availa
   }
 
   for (const auto &it: managed_servers_vec) {
-    if (!(it.role == "HA")) {
+    if (it.role != metadata_cache::InstanceRole::HA) {
+      continue;
+    }
+    if (skip_lagging && it.mode == metadata_cache::ServerMode::ReadOnly && is_lagging(it)) {
       continue;
     }
     auto port = (protocol_ == Protocol::Type::kXProtocol) ? static_cast<uint16_t>(it.xport) : static_cast<uint16_t>(it.port);
@@ -260,6 +341,38 @@ DestMetadataCacheGroup::AvailableDestinations DestMetadataCacheGroup::get_availa
   return result;
 }
 
+DestMetadataCacheGroup::AvailableDestinations
+DestMetadataCacheGroup::get_read_only_available(const metadata_cache::LookupResult& managed_servers) const {
+  AvailableDestinations result;
+  for (const auto &it: managed_servers.instance_vector) {
+    if (it.role == metadata_cache::InstanceRole::HA &&
+        it.mode == metadata_cache::ServerMode::ReadOnly && !is_lagging(it)) {
+      result.address.push_back(mysql_harness::TCPAddress(it.host, static_cast<uint16_t>(it.port)));
+      result.id.push_back(it.mysql_server_uuid);
+    }
+  }
+  return result;
+}
+
+bool DestMetadataCacheGroup::is_lagging(const metadata_cache::ManagedInstance& instance) const {
+  return max_applier_queue_size_ > 0 && instance.applier_queue_size > max_applier_queue_size_;
+}
+
+std::shared_ptr<const DestMetadataCacheGroup::CachedDestinations>
+DestMetadataCacheGroup::get_cached_available(const metadata_cache::LookupResult& managed_servers) {
+  auto cached = std::atomic_load(&cached_available_);
+  if (cached && cached->source == managed_servers.snapshot()) {
+    return cached;
+  }
+
+  std::shared_ptr<const CachedDestinations> result(
+      new CachedDestinations{managed_servers.snapshot(), get_available(managed_servers),
+                             read_write_splitting_ ? get_read_only_available(managed_servers)
+                                                   : AvailableDestinations()});
+  std::atomic_store(&cached_available_, result);
+  return result;
+}
+
 void DestMetadataCacheGroup::init() {
   // check if URI does not contain parameters that we don't understand
   for (const auto& uri_param: uri_query_) {
@@ -322,6 +435,8 @@ void DestMetadataCacheGroup::init() {
     break;
     case routing::RoutingStrategy::kFirstAvailable:
     case routing::RoutingStrategy::kRoundRobin:
+    case routing::RoutingStrategy::kLowestLatency:
+    case routing::RoutingStrategy::kConsistentHash:
       break;
     default:
       throw std::runtime_error("Unsupported routing strategy: "
@@ -345,7 +460,7 @@ DestMetadataCacheGroup::~DestMetadataCacheGroup() {
 }
 
 size_t DestMetadataCacheGroup::get_next_server(
-    const DestMetadataCacheGroup::AvailableDestinations& available) {
+    const DestMetadataCacheGroup::AvailableDestinations& available, const uint64_t *client_key) {
   std::lock_guard<std::mutex> lock(mutex_update_);
   size_t result = 0;
 
@@ -365,6 +480,14 @@ size_t DestMetadataCacheGroup::get_next_server(
       current_pos_ = 0;
     }
     break;
+  case routing::RoutingStrategy::kLowestLatency:
+    result = select_lowest_latency(available.address, current_pos_++);
+    break;
+  case routing::RoutingStrategy::kConsistentHash:
+    // the cluster's membership changes only move the keys of the servers that come or go
+    result = client_key ? rank_by_rendezvous_hash(available.address, *client_key).front()
+                        : current_pos_++ % available.address.size();
+    break;
   default:
     assert(0);
     // impossible we verify this in init()
@@ -374,11 +497,34 @@ size_t DestMetadataCacheGroup::get_next_server(
   return result;
 }
 
+bool DestMetadataCacheGroup::is_ready() {
+  try {
+    return !get_cached_available(cache_api_->lookup_replicaset(ha_replicaset_))->available.address.empty();
+  } catch (const std::exception&) {
+    // metadata cache not ready yet
+    return false;
+  }
+}
+
 int DestMetadataCacheGroup::get_server_socket(std::chrono::milliseconds connect_timeout, int *error,
                                               mysql_harness::TCPAddress *address) noexcept {
+  return connect_next_server(nullptr, connect_timeout, error, address);
+}
+
+int DestMetadataCacheGroup::get_server_socket_for_client(uint64_t client_key,
+                                                         std::chrono::milliseconds connect_timeout,
+                                                         int *error,
+                                                         mysql_harness::TCPAddress *address) noexcept {
+  return connect_next_server(&client_key, connect_timeout, error, address);
+}
+
+int DestMetadataCacheGroup::connect_next_server(const uint64_t *client_key,
+                                                std::chrono::milliseconds connect_timeout, int *error,
+                                                mysql_harness::TCPAddress *address) noexcept {
   while (true) {
     try {
-      auto available = get_available(cache_api_->lookup_replicaset(ha_replicaset_).instance_vector);
+      auto cached = get_cached_available(cache_api_->lookup_replicaset(ha_replicaset_));
+      const auto& available = cached->available;
       if (available.address.empty()) {
         log_warning("No available servers found for '%s' %s routing",
             ha_replicaset_.c_str(),
@@ -386,16 +532,78 @@ int DestMetadataCacheGroup::get_server_socket(std::chrono::milliseconds connect_
         return -1;
       }
 
-      size_t next_up = get_next_server(available);
-      int fd = get_mysql_socket(available.address.at(next_up), connect_timeout);
+      const bool first_available = routing_strategy_ == routing::RoutingStrategy::kFirstAvailable;
+      // the limits don't apply to first-available, which fails over in order
+      auto is_skipped = [&](size_t index) {
+        return is_circuit_open(available.address.at(index)) ||
+               (!first_available && is_throttled(available.address.at(index), available.address));
+      };
+
+      size_t next_up = get_next_server(available, client_key);
+      if (routing_strategy_ == routing::RoutingStrategy::kConsistentHash && client_key) {
+        // the client moves on to its next server, like it would if this one was gone
+        for (const size_t index: rank_by_rendezvous_hash(available.address, *client_key)) {
+          if (!is_skipped(index)) {
+            next_up = index;
+            break;
+          }
+        }
+      } else {
+        for (size_t i = 1; i < available.address.size() && is_skipped(next_up); ++i) {
+          next_up = first_available ? (next_up + 1) % available.address.size()
+                                    : get_next_server(available, client_key);
+        }
+      }
+      if (is_circuit_open(available.address.at(next_up))) {
+        log_warning("The circuits of all servers for '%s' are open", ha_replicaset_.c_str());
+        return -1;
+      }
+      if (!first_available && is_at_max_connections(available.address.at(next_up))) {
+        log_warning("All servers for '%s' have max_connections_per_destination connections",
+                    ha_replicaset_.c_str());
+        return -1;
+      }
+
+      // the next usable secondary gets raced with a slow one
+      size_t hedge_up = next_up;
+      if (hedges_connects() && server_role_ != ServerRole::Primary && !first_available &&
+          routing_strategy_ != routing::RoutingStrategy::kConsistentHash) {
+        for (size_t i = 1; i < available.address.size(); ++i) {
+          const size_t index = (next_up + i) % available.address.size();
+          if (!is_skipped(index) && !is_at_max_connections(available.address.at(index))) {
+            hedge_up = index;
+            break;
+          }
+        }
+      }
+
+      int fd;
+      if (hedge_up != next_up) {
+        bool second_won = false;
+        fd = get_mysql_socket_hedged(available.address.at(next_up), available.address.at(hedge_up),
+                                     connect_timeout, second_won);
+        if (fd < 0) {
+          cache_api_->mark_instance_reachability(available.id.at(hedge_up),
+              metadata_cache::InstanceStatus::Unreachable);
+        } else if (second_won) {
+          next_up = hedge_up;
+        }
+      } else {
+        fd = get_mysql_socket(available.address.at(next_up), connect_timeout);
+      }
       if (fd < 0) {
         // Signal that we can't connect to the instance
         cache_api_->mark_instance_reachability(available.id.at(next_up),
             metadata_cache::InstanceStatus::Unreachable);
-        // if we're looking for a primary member, wait for there to be at least one
+        // if we're looking for a primary member, wait for there to be at least one,
+        // but not longer than what is left of the connect deadline
+        std::chrono::milliseconds failover_timeout = std::chrono::seconds(kPrimaryFailoverTimeout);
         if (server_role_ == ServerRole::Primary &&
+            ConnectDeadline::limit(failover_timeout) &&
+            failover_timeout >= std::chrono::seconds(1) &&
             cache_api_->wait_primary_failover(ha_replicaset_,
-                kPrimaryFailoverTimeout)) {
+                static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(
+                    failover_timeout).count()))) {
           log_info("Retrying connection for '%s' after possible failover",
                    ha_replicaset_.c_str());
           continue; // retry
@@ -414,12 +622,53 @@ int DestMetadataCacheGroup::get_server_socket(std::chrono::milliseconds connect_
   return -1;
 }
 
+int DestMetadataCacheGroup::get_read_only_server_socket(std::chrono::milliseconds connect_timeout,
+                                                        int *error,
+                                                        mysql_harness::TCPAddress *address) noexcept {
+  *error = 0;
+  if (!read_write_splitting_) return -1;
+
+  try {
+    // computed once per snapshot along with the destinations of the writes
+    const auto cached = get_cached_available(cache_api_->lookup_replicaset(ha_replicaset_));
+    const AvailableDestinations &secondaries = cached->read_only;
+
+    // each secondary gets tried once, reads go to the primary if none is reachable
+    for (size_t i = 0; i < secondaries.address.size(); ++i) {
+      size_t next_up;
+      {
+        std::lock_guard<std::mutex> lock(mutex_update_);
+        next_up = secondary_pos_++ % secondaries.address.size();
+      }
+      if (is_circuit_open(secondaries.address.at(next_up))) continue;
+
+      int fd = get_mysql_socket(secondaries.address.at(next_up), connect_timeout);
+      if (fd >= 0) {
+        if (address) *address = secondaries.address.at(next_up);
+        return fd;
+      }
+      cache_api_->mark_instance_reachability(secondaries.id.at(next_up),
+          metadata_cache::InstanceStatus::Unreachable);
+    }
+  } catch (std::runtime_error & re) {
+    log_error("Failed getting managed servers from the Metadata server: %s",
+              re.what());
+  }
+
+  *error = errno;
+  return -1;
+}
+
 void DestMetadataCacheGroup::on_instances_change(const metadata_cache::LookupResult &instances, const bool md_servers_reachable) {
   // we got notified that the metadata has changed.
   // If instances is empty then (most like is empty)
   // the metadata-cache cannot connect to the metadata-servers
   // In that case we only trigger the callbacks (resulting in disconnects) if the user
   // configured that it should happen (disconnect_on_metadata_unavailable_ == true)
+
+  // prepare the destinations for new connections before they ask for them
+  get_cached_available(instances);
+
   if (!md_servers_reachable && !disconnect_on_metadata_unavailable_)
     return;
 
@@ -436,3 +685,59 @@ void DestMetadataCacheGroup::on_instances_change(const metadata_cache::LookupRes
 void DestMetadataCacheGroup::notify(const metadata_cache::LookupResult& instances, const bool md_servers_reachable) noexcept {
   on_instances_change(instances, md_servers_reachable);
 }
+
+bool DestMetadataCacheGroup::may_route_to(const metadata_cache::ManagedInstance& instance) const {
+  if (instance.role != metadata_cache::InstanceRole::HA) {
+    return false;
+  }
+
+  switch (server_role_) {
+   case ServerRole::Primary:
+     return instance.mode == metadata_cache::ServerMode::ReadWrite;
+   case ServerRole::Secondary:
+     // primaries matter too if we fall back to them or keep the connections
+     // to the secondaries that got promoted
+     if (routing_strategy_ == routing::RoutingStrategy::kRoundRobinWithFallback ||
+         !disconnect_on_promoted_to_primary_) {
+       return instance.mode == metadata_cache::ServerMode::ReadWrite ||
+              instance.mode == metadata_cache::ServerMode::ReadOnly;
+     }
+     return instance.mode == metadata_cache::ServerMode::ReadOnly;
+   case ServerRole::PrimaryAndSecondary:
+     return instance.mode == metadata_cache::ServerMode::ReadWrite ||
+            instance.mode == metadata_cache::ServerMode::ReadOnly;
+  }
+
+  return true;
+}
+
+void DestMetadataCacheGroup::notify(const metadata_cache::LookupResult& instances,
+                                    const metadata_cache::InstancesDiff& diff,
+                                    const bool md_servers_reachable) noexcept {
+  // members this route can't use came and went, nothing to recompute
+  if (md_servers_reachable) {
+    bool relevant = false;
+    for (const auto &it: diff.added) relevant = relevant || may_route_to(it);
+    for (const auto &it: diff.removed) relevant = relevant || may_route_to(it);
+    for (const auto &it: diff.changed) {
+      relevant = relevant || may_route_to(it.first) || may_route_to(it.second);
+    }
+    if (!relevant)
+      return;
+
+    // a member that rejoined has cold caches, unless the route only starts now
+    const auto cached = std::atomic_load(&cached_available_);
+    if (cached && !cached->available.address.empty()) {
+      for (const auto &it: diff.added) {
+        if (may_route_to(it))
+          start_slow_start(mysql_harness::TCPAddress(it.host, static_cast<uint16_t>(it.port)));
+      }
+      for (const auto &it: diff.changed) {
+        if (!may_route_to(it.first) && may_route_to(it.second))
+          start_slow_start(mysql_harness::TCPAddress(it.second.host, static_cast<uint16_t>(it.second.port)));
+      }
+    }
+  }
+
+  on_instances_change(instances, md_servers_reachable);
+}
@@ -30,6 +30,7 @@
 #include "mysqlrouter/uri.h"
 #include "mysqlrouter/metadata_cache.h"
 
+#include <memory>
 #include <thread>
 
 #include "mysqlrouter/datatypes.h"
@@ -69,6 +70,28 @@ public:
   int get_server_socket(std::chrono::milliseconds connect_timeout, int *error,
                         mysql_harness::TCPAddress *address = nullptr) noexcept override;
 
+  int get_server_socket_for_client(uint64_t client_key, std::chrono::milliseconds connect_timeout,
+                                   int *error, mysql_harness::TCPAddress *address = nullptr) noexcept override;
+
+  /** @brief true if role=PRIMARY routing sends reads to the secondaries
+   *
+   *     destination = metadata-cache://cluster_name/replicaset_name?role=PRIMARY&read_write_splitting=yes
+   */
+  bool splits_reads() const noexcept override {
+    return read_write_splitting_;
+  }
+
+  /** @brief true if reads after a write only go to secondaries that applied it
+   *
+   *     destination = metadata-cache://cluster_name/replicaset_name?role=PRIMARY&read_write_splitting=yes&read_your_writes=yes
+   */
+  bool reads_own_writes() const noexcept override {
+    return read_your_writes_;
+  }
+
+  int get_read_only_server_socket(std::chrono::milliseconds connect_timeout, int *error,
+                                  mysql_harness::TCPAddress *address = nullptr) noexcept override;
+
   ~DestMetadataCacheGroup();
 
   void add(const std::string &, uint16_t) override { }
@@ -87,6 +110,14 @@ public:
     return false;
   }
 
+  /** @brief Returns whether the Metadata Cache knows available servers
+   *
+   * Looks up the replicaset like a new connection would.
+   *
+   * @return true if there is at least one server to route to
+   */
+  bool is_ready() override;
+
   /** @brief empty implementation
    *
    * This method actually does something - it disables the RouteDestination::start(),
@@ -145,10 +176,41 @@ private:
   AvailableDestinations get_available(const metadata_cache::LookupResult& managed_servers,
                                       bool for_new_connections = true);
 
-  size_t get_next_server(const DestMetadataCacheGroup::AvailableDestinations& available);
+  /** @brief Gets the secondaries the reads of a read-write splitting route go to */
+  AvailableDestinations get_read_only_available(const metadata_cache::LookupResult& managed_servers) const;
+
+  /** @brief Available destinations for new connections, with the snapshot they were computed from */
+  struct CachedDestinations {
+    metadata_cache::InstancesSnapshot source;
+    AvailableDestinations available;
+    /** @brief get_read_only_available(), empty without read-write splitting */
+    AvailableDestinations read_only;
+  };
+
+  /** @brief Gets available destinations for new connections, computing them once per snapshot
+   *
+   * As long as the Metadata Cache keeps returning the same snapshot the
+   * destinations computed for it are shared, so routing a new connection
+   * neither filters the replicaset nor allocates.
+   */
+  std::shared_ptr<const CachedDestinations> get_cached_available(
+      const metadata_cache::LookupResult& managed_servers);
+
+  /** @brief Last result of get_cached_available(), accessed with std::atomic_load/store */
+  std::shared_ptr<const CachedDestinations> cached_available_;
+
+  size_t get_next_server(const DestMetadataCacheGroup::AvailableDestinations& available,
+                         const uint64_t *client_key = nullptr);
+
+  /** @brief connects to the next server, picked for the client if client_key is set */
+  int connect_next_server(const uint64_t *client_key, std::chrono::milliseconds connect_timeout,
+                          int *error, mysql_harness::TCPAddress *address) noexcept;
 
   size_t current_pos_;
 
+  /** @brief secondary the next read-only connection goes to */
+  size_t secondary_pos_{0};
+
   routing::RoutingStrategy routing_strategy_;
 
   routing::AccessMode access_mode_;
@@ -163,11 +225,24 @@ private:
 
   bool disconnect_on_promoted_to_primary_{false};
   bool disconnect_on_metadata_unavailable_{false};
+  bool read_write_splitting_{false};
+  bool read_your_writes_{false};
+
+  /** @brief secondaries with more transactions in their applier queue get no reads, 0 for no limit */
+  uint64_t max_applier_queue_size_{0};
+
+  /** @brief whether the secondary is further behind than max_applier_queue_size allows */
+  bool is_lagging(const metadata_cache::ManagedInstance& instance) const;
 
   void on_instances_change(const metadata_cache::LookupResult &instances, const bool md_servers_reachable);
   void subscribe_for_metadata_cache_changes();
 
+  // whether an instance in the given state could be one of our destinations
+  bool may_route_to(const metadata_cache::ManagedInstance& instance) const;
+
   void notify(const metadata_cache::LookupResult& instances, const bool md_servers_reachable) noexcept override;
+  void notify(const metadata_cache::LookupResult& instances, const metadata_cache::InstancesDiff& diff,
+              const bool md_servers_reachable) noexcept override;
 };
 
 
@@ -25,6 +25,9 @@
 #include "dest_next_available.h"
 #include "mysql/harness/logging/logging.h"
 
+#include <cerrno>
+#include <vector>
+
 #ifdef _WIN32
 #  define WIN32_LEAN_AND_MEAN
 #  include <windows.h>
@@ -47,17 +50,41 @@ int DestNextAvailable::get_server_socket(std::chrono::milliseconds connect_timeo
     return -1;
   }
 
+  // servers known to fail get tried once all others failed
+  std::vector<size_t> backing_off;
   // We start the list at the currently available server
   for (size_t i = current_pos_; i < destinations_.size(); ++i) {
     auto addr = destinations_.at(i);
+    // fails over as if the connect failed
+    if (is_circuit_open(addr)) continue;
+    if (is_backing_off(addr)) {
+      backing_off.push_back(i);
+      continue;
+    }
     log_debug("Trying server %s (index %lu)", addr.str().c_str(),
               static_cast<long unsigned>(i)); // 32bit Linux requires cast
     auto sock = get_mysql_socket(addr, connect_timeout);
     if (sock >= 0) {
+      report_connect(addr, true);
+      current_pos_ = i;
+      if (address) *address = addr;
+      return sock;
+    }
+    if (errno != ENFILE && errno != EMFILE) report_connect(addr, false);
+  }
+
+  for (size_t i : backing_off) {
+    auto addr = destinations_.at(i);
+    log_debug("Trying server %s (index %lu) again", addr.str().c_str(),
+              static_cast<long unsigned>(i)); // 32bit Linux requires cast
+    auto sock = get_mysql_socket(addr, connect_timeout);
+    if (sock >= 0) {
+      report_connect(addr, true);
       current_pos_ = i;
       if (address) *address = addr;
       return sock;
     }
+    if (errno != ENFILE && errno != EMFILE) report_connect(addr, false);
   }
 
 #ifndef _WIN32
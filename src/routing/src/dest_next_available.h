@@ -30,6 +30,12 @@
 
 #include "mysql/harness/logging/logging.h"
 
+/**
+ * Like DestFirstAvailable, but never goes back to a server it failed over from.
+ *
+ * Servers that failed lately or are quarantined by other routes are only
+ * tried once all the others failed, see RouteDestination::is_backing_off().
+ */
 class DestNextAvailable final : public RouteDestination {
  public:
   using RouteDestination::RouteDestination;
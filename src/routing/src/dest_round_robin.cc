@@ -21,11 +21,13 @@
   along with this program; if not, write to the Free Software
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
+#include <algorithm>
 #include <chrono>
 
 #include "common.h"
 #include "dest_round_robin.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysqlrouter/routing_metrics.h"
 
 #ifdef _WIN32
 #  define WIN32_LEAN_AND_MEAN
@@ -44,22 +46,11 @@ using mysql_harness::TCPAddress;
 
 // Timeout for trying to connect with quarantined servers
 static constexpr std::chrono::milliseconds kQuarantinedConnectTimeout(1 * 1000);
-// How long we pause before checking quarantined servers again (seconds)
-static const int kQuarantineCleanupInterval = 3;
-// Make sure Quarantine Manager Thread is run even with nothing in quarantine
-static const int kTimeoutQuarantineConditional = 2;
-
-void* DestRoundRobin::run_thread(void* context) {
-  DestRoundRobin* dest_round_robin = static_cast<DestRoundRobin*>(context);
-  dest_round_robin->quarantine_manager_thread();
-  return nullptr;
-}
 
 void DestRoundRobin::start() {
-  quarantine_thread_.run(&run_thread, this);
+  health_.start_probing(this, quarantine_interval_, quarantine_max_interval_, thread_stack_size_);
 }
 
-
 int DestRoundRobin::get_server_socket(std::chrono::milliseconds connect_timeout, int *error,
                                       mysql_harness::TCPAddress *address) noexcept {
   size_t server_pos;
@@ -68,18 +59,28 @@ int DestRoundRobin::get_server_socket(std::chrono::milliseconds connect_timeout,
   // Try at most num_servers times
   for (size_t i = 0; i < num_servers; i++) {
     try {
-      server_pos = get_next_server();
+      server_pos = select_server();
     }
     catch (const std::runtime_error&) {
-      log_warning("No destinations currently available for routing");
+      // logged for every client connection while all servers are down
+      static mysql_harness::logging::LogRateLimiter log_limiter;
+      log_warning_limited(log_limiter, "No destinations currently available for routing");
       return -1;
     }
 
-    // If server is quarantined, skip
-    {
-      std::lock_guard<std::mutex> lock(mutex_quarantine_);
-      if (is_quarantined(server_pos)) {
-        continue;
+    // If server is quarantined or has enough connections for now, skip
+    if (!is_usable(server_pos)) {
+      continue;
+    }
+
+    // the next usable server gets raced with a slow one
+    size_t hedge_pos = server_pos;
+    if (hedges_connects()) {
+      for (size_t k = 1; k < num_servers; ++k) {
+        if (is_usable((server_pos + k) % num_servers)) {
+          hedge_pos = (server_pos + k) % num_servers;
+          break;
+        }
       }
     }
 
@@ -87,7 +88,14 @@ int DestRoundRobin::get_server_socket(std::chrono::milliseconds connect_timeout,
     TCPAddress server_addr = destinations_[server_pos];
     log_debug("Trying server %s (index %lu)", server_addr.str().c_str(),
               static_cast<long unsigned>(server_pos));
-    auto sock = get_mysql_socket(server_addr, connect_timeout);
+    int sock;
+    if (hedge_pos != server_pos) {
+      bool second_won = false;
+      sock = get_mysql_socket_hedged(server_addr, destinations_[hedge_pos], connect_timeout, second_won);
+      if (second_won) server_addr = destinations_[hedge_pos];
+    } else {
+      sock = get_mysql_socket(server_addr, connect_timeout);
+    }
     if (sock >= 0) {
       // Server is available
       if (address) *address = server_addr;
@@ -100,9 +108,9 @@ int DestRoundRobin::get_server_socket(std::chrono::milliseconds connect_timeout,
 #endif
       if (errno != ENFILE && errno != EMFILE) {
         // We failed to get a connection to the server; we quarantine.
-        std::lock_guard<std::mutex> lock(mutex_quarantine_);
         add_to_quarantine(server_pos);
-        if (quarantined_.size() == destinations_.size()) {
+        if (hedge_pos != server_pos) add_to_quarantine(hedge_pos);
+        if (size_quarantine() == destinations_.size()) {
           log_debug("No more destinations: all quarantined");
           break;
         }
@@ -116,8 +124,8 @@ int DestRoundRobin::get_server_socket(std::chrono::milliseconds connect_timeout,
 }
 
 DestRoundRobin::~DestRoundRobin() {
-  stopping_ = true;
-  quarantine_thread_.join();
+  // waits for a probe of this route
+  health_.leave_all(this);
 }
 
 void DestRoundRobin::add_to_quarantine(const size_t index) noexcept {
@@ -127,67 +135,107 @@ void DestRoundRobin::add_to_quarantine(const size_t index) noexcept {
               static_cast<long unsigned>(index));  // 32bit Linux requires cast
     return;
   }
-  if (!is_quarantined(index)) {
-    log_debug("Quarantine destination server %s (index %lu)", destinations_.at(index).str().c_str(),
-              static_cast<long unsigned>(index));  // 32bit Linux requires cast
-    quarantined_.push_back(index);
-    condvar_quarantine_.notify_one();
+  // the other routes having the server skip it as well
+  health_.quarantine(destinations_.at(index));
+}
+
+void DestRoundRobin::on_quarantine_changed(const TCPAddress &addr, bool quarantined) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_quarantine_);
+  for (size_t index = 0; index < destinations_.size() && index < quarantined_.size(); ++index) {
+    if (!(destinations_[index] == addr) || quarantined_[index].exchange(quarantined) == quarantined) continue;
+
+    if (quarantined) {
+      log_debug("Quarantine destination server %s (index %lu)", addr.str().c_str(),
+                static_cast<long unsigned>(index));  // 32bit Linux requires cast
+      ++quarantined_count_;
+    } else {
+      log_debug("Unquarantine destination server %s (index %lu)", addr.str().c_str(),
+                static_cast<long unsigned>(index)); // 32bit Linux requires cast
+      --quarantined_count_;
+      // a cold server doesn't get its full share of the reconnecting clients at once
+      start_slow_start(addr);
+    }
+    if (metrics_) metrics_->set_quarantined(addr.str(), quarantined);
   }
 }
 
-void DestRoundRobin::cleanup_quarantine() noexcept {
+std::vector<bool> DestRoundRobin::probe(const std::vector<TCPAddress> &addrs) {
+  return probe_mysql_servers(addrs, kQuarantinedConnectTimeout);
+}
+
+bool DestRoundRobin::cleanup_quarantine() noexcept {
 
-  mutex_quarantine_.lock();
   // Nothing to do when nothing quarantined
-  if (quarantined_.empty()) {
-    mutex_quarantine_.unlock();
-    return;
+  if (size_quarantine() == 0) {
+    return false;
   }
-  // We work on a copy; updating the original
-  auto cpy_quarantined(quarantined_);
-  mutex_quarantine_.unlock();
 
-  for (auto it = cpy_quarantined.begin(); it != cpy_quarantined.end(); ++it) {
-    if (stopping_) {
-      return;
+  std::vector<TCPAddress> addrs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_quarantine_);
+    for (size_t index = 0; index < quarantined_.size(); ++index) {
+      if (quarantined_[index]) addrs.push_back(destinations_.at(index));
     }
+  }
+  auto reachable = probe_mysql_servers(addrs, kQuarantinedConnectTimeout);
 
-    auto addr = destinations_.at(*it);
-    auto sock = get_mysql_socket(addr, kQuarantinedConnectTimeout, false);
+  bool recovered = false;
+  for (size_t i = 0; i < addrs.size() && i < reachable.size(); ++i) {
+    if (!reachable[i]) continue;
 
-    if (sock >= 0) {
-#ifndef _WIN32
-      shutdown(sock, SHUT_RDWR);
-      close(sock);
-#else
-      shutdown(sock, SD_BOTH);
-      closesocket(sock);
-#endif
-      log_debug("Unquarantine destination server %s (index %lu)", addr.str().c_str(),
-                static_cast<long unsigned>(*it)); // 32bit Linux requires cast
-      std::lock_guard<std::mutex> lock(mutex_quarantine_);
-      quarantined_.erase(std::remove(quarantined_.begin(), quarantined_.end(), *it));
+    health_.unquarantine(addrs[i]);
+    recovered = true;
+  }
+
+  return recovered;
+}
+
+size_t DestRoundRobin::size_quarantine() {
+  return quarantined_count_.load();
+}
+
+void DestRoundRobin::add(const TCPAddress dest) {
+  bool added = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_quarantine_);
+    RouteDestination::add(dest);
+    while (quarantined_.size() < destinations_.size()) {
+      quarantined_.emplace_back(false);
+      added = true;
     }
   }
+  // tells if the server is quarantined by another route already
+  if (added) health_.join(this, dest);
 }
 
-void DestRoundRobin::quarantine_manager_thread() noexcept {
-  mysql_harness::rename_thread("RtQ:<unknown>");  //TODO change <unknown> to instance name
+void DestRoundRobin::remove(const std::string &address, uint16_t port) {
+  health_.leave(this, TCPAddress(address, port));
 
-  std::unique_lock<std::mutex> lock(mutex_quarantine_manager_);
-  while (!stopping_) {
-    condvar_quarantine_.wait_for(lock, std::chrono::seconds(kTimeoutQuarantineConditional),
-                                 [this] { return !quarantined_.empty(); });
+  std::lock_guard<std::mutex> lock(mutex_quarantine_);
+  // keep the flags of the destinations staying, their indexes may shift
+  std::vector<TCPAddress> quarantined_addrs;
+  for (size_t index = 0; index < quarantined_.size(); ++index) {
+    if (quarantined_[index]) quarantined_addrs.push_back(destinations_.at(index));
+  }
 
-    if (!stopping_) {
-      cleanup_quarantine();
-      // Temporize
-      std::this_thread::sleep_for(std::chrono::seconds(kQuarantineCleanupInterval));
-    }
+  RouteDestination::remove(address, port);
+
+  std::deque<std::atomic_bool> quarantined;
+  size_t quarantined_count = 0;
+  for (const auto& dest : destinations_) {
+    bool flag = std::find(quarantined_addrs.begin(), quarantined_addrs.end(), dest) != quarantined_addrs.end();
+    quarantined.emplace_back(flag);
+    if (flag) ++quarantined_count;
   }
+  quarantined_.swap(quarantined);
+  quarantined_count_ = quarantined_count;
 }
 
-size_t DestRoundRobin::size_quarantine() {
+void DestRoundRobin::clear() {
+  health_.leave_all(this);
+
   std::lock_guard<std::mutex> lock(mutex_quarantine_);
-  return quarantined_.size();
+  RouteDestination::clear();
+  quarantined_.clear();
+  quarantined_count_ = 0;
 }
@@ -25,13 +25,24 @@
 #ifndef ROUTING_DEST_ROUND_ROBIN_INCLUDED
 #define ROUTING_DEST_ROUND_ROBIN_INCLUDED
 
+#include <atomic>
+#include <deque>
+
 #include "destination.h"
+#include "destination_health.h"
 #include "mysqlrouter/routing.h"
 
 #include "mysql/harness/logging/logging.h"
 #include "mysql_router_thread.h"
 
-class DestRoundRobin : public RouteDestination {
+/**
+ * Round-robin over the destinations, skipping the quarantined ones.
+ *
+ * The quarantine is shared with the other routes through
+ * DestinationHealth: a server failing a connect is quarantined for all
+ * routes having it, and probed by one thread for all of them.
+ */
+class DestRoundRobin : public RouteDestination, public DestinationHealth::Member {
  public:
   using RouteDestination::RouteDestination;
 
@@ -47,86 +58,127 @@ class DestRoundRobin : public RouteDestination {
                  routing::RoutingSockOpsInterface *routing_sock_ops =
                      routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance()),
                  size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes)
-      : RouteDestination(protocol, routing_sock_ops), quarantine_thread_(thread_stack_size) {}
+      : RouteDestination(protocol, routing_sock_ops), thread_stack_size_(thread_stack_size) {}
 
   /** @brief Destructor */
   virtual ~DestRoundRobin();
 
-  /** @brief run Quarantine Manager Thread */
-  static void* run_thread(void* context);
-
+  /** @brief Lets the shared prober probe the quarantined destinations */
   virtual void start() override;
 
+  void set_quarantine_interval(std::chrono::milliseconds interval,
+                               std::chrono::milliseconds max_interval) override {
+    quarantine_interval_ = interval;
+    quarantine_max_interval_ = max_interval;
+  }
+
   int get_server_socket(std::chrono::milliseconds connect_timeout, int *error,
                         mysql_harness::TCPAddress *address = nullptr) noexcept override;
 
+  using RouteDestination::add;
+
+  /** @brief Adds a destination, initially not quarantined */
+  void add(const mysql_harness::TCPAddress dest) override;
+
+  /** @brief Removes a destination, the others keep their quarantine state */
+  void remove(const std::string &address, uint16_t port) override;
+
+  /** @brief Removes all destinations and their quarantine state */
+  void clear() override;
+
   /** @brief Returns number of quarantined servers
    *
    * @return size_t
    */
   size_t size_quarantine();
 
+  void on_quarantine_changed(const mysql_harness::TCPAddress &addr, bool quarantined) noexcept override;
+
+  std::vector<bool> probe(const std::vector<mysql_harness::TCPAddress> &addrs) override;
+
  protected:
   /** @brief Returns whether destination is quarantined
    *
    * Uses the given index to check whether the destination is
-   * quarantined.
+   * quarantined. Doesn't lock, the quarantine flags only get resized
+   * when destinations are added or removed.
    *
    * @param index index of the destination to check
    * @return True if destination is quarantined
    */
   virtual bool is_quarantined(const size_t index) {
-    return std::find(quarantined_.begin(), quarantined_.end(), index) != quarantined_.end();
+    return index < quarantined_.size() && quarantined_[index];
+  }
+
+  /** @brief Returns whether destination may get a new connection
+   *
+   * It may unless it is quarantined, its circuit is open or it is throttled
+   * by the limits of set_destination_limits(). Locks the circuit breaker
+   * of the destination unless its circuit is closed.
+   *
+   * @param index index of the destination to check
+   */
+  bool is_usable(const size_t index) {
+    return !is_quarantined(index) && !is_circuit_open(destinations_[index]) &&
+           !is_throttled(destinations_[index], destinations_,
+                         [this](size_t other) { return is_quarantined(other); });
   }
 
   /** @brief Adds server to quarantine
    *
-   * Adds the given server address to the quarantine list. The index argument
-   * is the index of the server in the destination list.
+   * Adds the given server address to the quarantine list of all routes
+   * having it. The index argument is the index of the server in the
+   * destination list.
    *
    * @param index Index of the destination
    */
   virtual void add_to_quarantine(size_t index) noexcept;
 
-  /** @brief Worker checking and removing servers from quarantine
-   *
-   * This method is meant to run in a thread and calling the
-   * `cleanup_quarantine()` method.
+  /** @brief Picks the destination get_server_socket() tries next
    *
-   * The caller is responsible for locking and unlocking the
-   * mutex `mutex_quarantine_`.
+   * Round-robin over all destinations, quarantined ones included;
+   * get_server_socket() skips those and the throttled ones.
    *
+   * @throws std::runtime_error if destinations list is empty
+   * @return index of the destination
    */
-  virtual void quarantine_manager_thread() noexcept;
+  virtual size_t select_server() {
+    return get_next_server();
+  }
 
   /** @brief Checks and removes servers from quarantine
    *
-   * This method removes servers from quarantine while trying to establish
-   * a connection. It is used in a seperate thread and will update the
-   * quarantine list, and will keep trying until the list is empty.
-   * A conditional variable is used to notify the thread servers were
-   * quarantined.
+   * Probes the quarantined destinations of this route and lifts the
+   * quarantine of those accepting connections again, for all routes. The
+   * shared prober of DestinationHealth does the same for all routes at
+   * once.
+   *
+   * All quarantined servers are probed at the same time.
    *
+   * @return true if any of the servers was removed from quarantine
    */
-  virtual void cleanup_quarantine() noexcept;
-
-  /** @brief List of destinations which are quarantined */
-  std::vector<size_t> quarantined_;
+  virtual bool cleanup_quarantine() noexcept;
 
-  /** @brief Conditional variable blocking quarantine manager thread */
-  std::condition_variable condvar_quarantine_;
+  /** @brief Quarantine flag of each destination, by index */
+  std::deque<std::atomic_bool> quarantined_;
 
-  /** @brief Mutex for quarantine manager thread */
-  std::mutex mutex_quarantine_manager_;
+  /** @brief Number of quarantined destinations */
+  std::atomic<size_t> quarantined_count_{0};
 
-  /** @brief Mutex for updating quarantine */
+  /** @brief Protects the quarantine flags from changes of the destinations */
   std::mutex mutex_quarantine_;
 
-  /** @brief refresh thread facade */
-  mysql_harness::MySQLRouterThread quarantine_thread_;
+  /** @brief Quarantine of the servers of all routes */
+  DestinationHealth &health_{DestinationHealth::instance()};
+
+  /** @brief stack of the shared prober's thread, if this route starts it */
+  size_t thread_stack_size_;
+
+  /** @brief pause after servers got quarantined, doubles while they don't recover */
+  std::chrono::milliseconds quarantine_interval_{routing::kDefaultQuarantineInterval};
 
-  /** @brief Whether we are stopping */
-  std::atomic_bool stopping_{false};
+  /** @brief longest pause between probing quarantined servers */
+  std::chrono::milliseconds quarantine_max_interval_{routing::kDefaultQuarantineMaxInterval};
 };
 
 
@@ -0,0 +1,121 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "dest_weighted_round_robin.h"
+
+#include <stdexcept>
+
+using mysql_harness::TCPAddress;
+
+namespace {
+
+unsigned int gcd(unsigned int a, unsigned int b) {
+  while (b != 0) {
+    unsigned int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+} // namespace
+
+void DestWeightedRoundRobin::add(const TCPAddress dest) {
+  const unsigned int weight = added_ < configured_weights_.size() ? configured_weights_[added_] : 1;
+  ++added_;
+
+  const size_t num_servers = destinations_.size();
+  DestRoundRobin::add(dest);
+  if (destinations_.size() > num_servers) {
+    weights_.push_back(weight);
+    update_schedule();
+  }
+}
+
+void DestWeightedRoundRobin::remove(const std::string &address, uint16_t port) {
+  TCPAddress to_remove(address, port);
+  for (size_t index = 0; index < destinations_.size(); ++index) {
+    if (destinations_[index] == to_remove) {
+      weights_.erase(weights_.begin() + static_cast<std::ptrdiff_t>(index));
+      break;
+    }
+  }
+
+  DestRoundRobin::remove(address, port);
+  update_schedule();
+}
+
+void DestWeightedRoundRobin::clear() {
+  DestRoundRobin::clear();
+  weights_.clear();
+  schedule_.clear();
+  added_ = 0;
+}
+
+void DestWeightedRoundRobin::update_schedule() {
+  schedule_.clear();
+  if (weights_.empty()) return;
+
+  // 4, 2 and 2 schedule the same as 2, 1 and 1 do, just longer
+  unsigned int divisor = 0;
+  for (auto weight : weights_) divisor = gcd(divisor, weight);
+
+  std::vector<unsigned int> weights;
+  unsigned long long total = 0;
+  for (auto weight : weights_) {
+    weights.push_back(weight / divisor);
+    total += weight / divisor;
+  }
+
+  // smooth weighted round-robin: every step each destination gains its
+  // weight, the one ahead gets picked and falls behind by the total
+  std::vector<long long> current(weights.size(), 0);
+  schedule_.reserve(static_cast<size_t>(total));
+  for (unsigned long long step = 0; step < total; ++step) {
+    size_t picked = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+      current[i] += weights[i];
+      if (current[i] > current[picked]) picked = i;
+    }
+    current[picked] -= static_cast<long long>(total);
+    schedule_.push_back(picked);
+  }
+}
+
+size_t DestWeightedRoundRobin::select_server() {
+  if (schedule_.empty()) {
+    throw std::runtime_error("Destination servers list is empty");
+  }
+
+  const size_t start = current_pos_.fetch_add(1, std::memory_order_relaxed);
+
+  // skip the unusable ones here, they would use up the attempts of get_server_socket()
+  for (size_t i = 0; i < schedule_.size(); ++i) {
+    const size_t index = schedule_[(start + i) % schedule_.size()];
+    if (is_usable(index)) return index;
+  }
+
+  return schedule_[start % schedule_.size()];
+}
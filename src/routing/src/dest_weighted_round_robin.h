@@ -0,0 +1,100 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_DEST_WEIGHTED_ROUND_ROBIN_INCLUDED
+#define ROUTING_DEST_WEIGHTED_ROUND_ROBIN_INCLUDED
+
+#include <vector>
+
+#include "dest_round_robin.h"
+
+/**
+ * @brief Routes new connections round-robin, each destination getting a
+ *        share of them proportional to its weight.
+ *
+ * The destinations are picked following a precomputed smooth weighted
+ * round-robin schedule: with weights 5, 1 and 1 the first destination
+ * gets 5 out of 7 connections, interleaved with the others rather than
+ * in one burst.
+ * Quarantined destinations are skipped, their share goes to the others.
+ */
+class DestWeightedRoundRobin final : public DestRoundRobin {
+ public:
+  /** @brief Constructor
+   *
+   * @param weights weight of each destination in the order they get added,
+   *        destinations without weight get 1
+   * @param protocol Protocol for the destination
+   * @param routing_sock_ops Socket operations implementation to use
+   * @param thread_stack_size memory in kilobytes allocated for thread's stack
+   */
+  DestWeightedRoundRobin(const std::vector<unsigned int>& weights,
+                         Protocol::Type protocol = Protocol::get_default(),
+                         routing::RoutingSockOpsInterface *routing_sock_ops =
+                             routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance()),
+                         size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes)
+      : DestRoundRobin(protocol, routing_sock_ops, thread_stack_size),
+        configured_weights_(weights) {}
+
+  using DestRoundRobin::add;
+
+  /** @brief Adds a destination with the next of the configured weights */
+  void add(const mysql_harness::TCPAddress dest) override;
+
+  void remove(const std::string &address, uint16_t port) override;
+
+  void clear() override;
+
+  /** @brief Returns weight of the destination at index */
+  unsigned int get_weight(size_t index) const {
+    return weights_.at(index);
+  }
+
+ protected:
+  /** @brief Picks the next not quarantined destination of the schedule
+   *
+   * Checks the destinations with is_usable(), which may lock, until one
+   * is usable.
+   */
+  size_t select_server() override;
+
+ private:
+  /** @brief computes schedule_ from weights_ */
+  void update_schedule();
+
+  /** @brief weights given to the constructor */
+  const std::vector<unsigned int> configured_weights_;
+
+  /** @brief number of add() calls, indexes configured_weights_ */
+  size_t added_{0};
+
+  /** @brief weight of each destination, by index */
+  std::vector<unsigned int> weights_;
+
+  /** @brief destination indexes in the order they get picked */
+  std::vector<size_t> schedule_;
+};
+
+#endif // ROUTING_DEST_WEIGHTED_ROUND_ROBIN_INCLUDED
@@ -24,14 +24,19 @@
 
 #include "common.h"
 #include "destination.h"
+#include "destination_health.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/tracepoints.h"
 #include "mysqlrouter/routing.h"
+#include "mysqlrouter/routing_metrics.h"
 #include "mysqlrouter/utils.h"
 #include "utils.h"
 #include "tcp_address.h"
+#include "warm_connection_pool.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <iostream>
 #ifndef _WIN32
 #  include <netdb.h>
@@ -103,6 +108,52 @@ TCPAddress RouteDestination::get(const std::string &address, uint16_t port) {
   throw out_of_range("Destination " + needle.str() + " not found");
 }
 
+namespace {
+
+// FNV-1a, stable across platforms and restarts
+uint64_t fnv1a(const uint8_t *data, size_t len, uint64_t hash = 14695981039346656037ULL) {
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// finalizer of splitmix64, spreads keys differing in a few bits
+uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+}  // namespace
+
+uint64_t RouteDestination::get_client_key(const sockaddr_storage &client_addr) {
+  const ClientIpArray ip = in_addr_to_array(client_addr);
+  return fnv1a(ip.data(), ip.size());
+}
+
+std::vector<size_t> RouteDestination::rank_by_rendezvous_hash(const AddrVector &addrs, uint64_t key) {
+  std::vector<std::pair<uint64_t, size_t>> scores;
+  scores.reserve(addrs.size());
+  for (size_t i = 0; i < addrs.size(); ++i) {
+    const std::string name = addrs[i].str();
+    const uint64_t server_hash = fnv1a(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+    scores.emplace_back(mix(server_hash ^ mix(key)), i);
+  }
+  // ties only if the same server is listed twice, the first one wins
+  std::stable_sort(scores.begin(), scores.end(),
+                   [](const std::pair<uint64_t, size_t> &a, const std::pair<uint64_t, size_t> &b) {
+                     return a.first > b.first;
+                   });
+
+  std::vector<size_t> result;
+  result.reserve(scores.size());
+  for (const auto &score: scores) result.push_back(score.second);
+  return result;
+}
+
 size_t RouteDestination::size() noexcept {
   return destinations_.size();
 }
@@ -116,19 +167,380 @@ void RouteDestination::clear() {
 }
 
 size_t RouteDestination::get_next_server() {
-  std::lock_guard<std::mutex> lock(mutex_update_);
-
-  if (destinations_.empty()) {
+  // no lock, destinations only change while configuring the route
+  const size_t num_servers = destinations_.size();
+  if (num_servers == 0) {
     throw std::runtime_error("Destination servers list is empty");
   }
 
-  auto result = current_pos_.load();
-  current_pos_++;
-  if (current_pos_ >= destinations_.size()) current_pos_ = 0;
+  return current_pos_.fetch_add(1, std::memory_order_relaxed) % num_servers;
+}
 
-  return result;
+namespace {
+
+// deadline of the connects of the thread, the epoch without deadline
+thread_local std::chrono::steady_clock::time_point connect_deadline;
+
+// innermost session reuse of the thread, nullptr without one
+thread_local RouteDestination::SessionReuse *session_reuse = nullptr;
+
+} // namespace
+
+RouteDestination::ConnectDeadline::ConnectDeadline(std::chrono::milliseconds budget) noexcept
+    : previous_(connect_deadline) {
+  if (budget.count() == 0) return;
+
+  const auto deadline = std::chrono::steady_clock::now() + budget;
+  if (previous_.time_since_epoch().count() == 0 || deadline < previous_) connect_deadline = deadline;
+}
+
+RouteDestination::ConnectDeadline::~ConnectDeadline() {
+  connect_deadline = previous_;
+}
+
+bool RouteDestination::ConnectDeadline::limit(std::chrono::milliseconds &timeout) noexcept {
+  if (connect_deadline.time_since_epoch().count() == 0) return true;
+
+  const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      connect_deadline - std::chrono::steady_clock::now());
+  if (left.count() <= 0) return false;
+
+  timeout = std::min(timeout, left);
+  return true;
+}
+
+RouteDestination::SessionReuse::SessionReuse(Take take)
+    : take_(std::move(take)), previous_(session_reuse) {
+  session_reuse = this;
+}
+
+RouteDestination::SessionReuse::~SessionReuse() {
+  session_reuse = previous_;
+}
+
+int RouteDestination::SessionReuse::take(const TCPAddress &addr) {
+  if (session_reuse == nullptr) return -1;
+
+  return session_reuse->take_(addr);
 }
 
 int RouteDestination::get_mysql_socket(const TCPAddress &addr, std::chrono::milliseconds connect_timeout, const bool log_errors) {
-  return routing_sock_ops_->get_mysql_socket(addr, connect_timeout, log_errors);
+  MYSQL_ROUTER_TRACE(destination__chosen, addr.addr.c_str(), addr.port);
+  {
+    // the client skips the connect and the session setup
+    int sock = SessionReuse::take(addr);
+    if (sock >= 0) {
+      MYSQL_ROUTER_TRACE(backend__connected, addr.addr.c_str(), addr.port, sock, 0);
+      return sock;
+    }
+  }
+  if (warm_pool_) {
+    // connected already, the client doesn't wait for the round trip
+    int sock = warm_pool_->take(addr);
+    if (sock >= 0) {
+      MYSQL_ROUTER_TRACE(backend__connected, addr.addr.c_str(), addr.port, sock, 0);
+      return sock;
+    }
+  }
+
+  if (!ConnectDeadline::limit(connect_timeout)) {
+    // not the server's fault, isn't scored
+#ifndef _WIN32
+    errno = ETIMEDOUT;
+#endif
+    return -1;
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  int sock = routing_sock_ops_->get_mysql_socket(get_connect_address(unix_sockets_.get(), addr),
+                                                 connect_timeout, log_errors, socket_options_);
+  if (sock >= 0) {
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started);
+    MYSQL_ROUTER_TRACE(backend__connected, addr.addr.c_str(), addr.port, sock, latency.count());
+    count_connect(addr, latency);
+  } else {
+#ifndef _WIN32
+    const int error = errno;
+#else
+    const int error = WSAGetLastError();
+#endif
+    count_failed_connect(addr, error);
+#ifndef _WIN32
+    // callers look at errno, the scoreboard may allocate
+    errno = error;
+#endif
+  }
+  return sock;
+}
+
+int RouteDestination::get_mysql_socket_hedged(const TCPAddress &first, const TCPAddress &second,
+                                              std::chrono::milliseconds connect_timeout, bool &second_won) {
+  second_won = false;
+  MYSQL_ROUTER_TRACE(destination__chosen, first.addr.c_str(), first.port);
+  MYSQL_ROUTER_TRACE(destination__chosen, second.addr.c_str(), second.port);
+  {
+    int sock = SessionReuse::take(first);
+    if (sock >= 0) {
+      MYSQL_ROUTER_TRACE(backend__connected, first.addr.c_str(), first.port, sock, 0);
+      return sock;
+    }
+    sock = SessionReuse::take(second);
+    if (sock >= 0) {
+      second_won = true;
+      MYSQL_ROUTER_TRACE(backend__connected, second.addr.c_str(), second.port, sock, 0);
+      return sock;
+    }
+  }
+  if (warm_pool_) {
+    int sock = warm_pool_->take(first);
+    if (sock >= 0) {
+      MYSQL_ROUTER_TRACE(backend__connected, first.addr.c_str(), first.port, sock, 0);
+      return sock;
+    }
+    sock = warm_pool_->take(second);
+    if (sock >= 0) {
+      second_won = true;
+      MYSQL_ROUTER_TRACE(backend__connected, second.addr.c_str(), second.port, sock, 0);
+      return sock;
+    }
+  }
+
+  if (!ConnectDeadline::limit(connect_timeout)) {
+#ifndef _WIN32
+    errno = ETIMEDOUT;
+#endif
+    return -1;
+  }
+
+  const std::vector<TCPAddress> addrs{get_connect_address(unix_sockets_.get(), first),
+                                      get_connect_address(unix_sockets_.get(), second)};
+  const auto hedge_delay = get_hedge_delay(connect_timeout);
+  const auto started = std::chrono::steady_clock::now();
+  size_t connected = 0;
+  int sock = routing_sock_ops_->get_mysql_socket_hedged(addrs, connect_timeout, hedge_delay,
+                                                        protocol_ == Protocol::Type::kClassicProtocol,
+                                                        socket_options_, connected);
+  if (sock >= 0) {
+    second_won = connected == 1;
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started);
+    // about the time of the second server, unless the first one failed early
+    if (second_won) latency = std::max(latency - hedge_delay, std::chrono::microseconds::zero());
+    const TCPAddress &winner = second_won ? second : first;
+    MYSQL_ROUTER_TRACE(backend__connected, winner.addr.c_str(), winner.port, sock, latency.count());
+    count_connect(winner, latency);
+  } else {
+#ifndef _WIN32
+    const int error = errno;
+#else
+    const int error = WSAGetLastError();
+#endif
+    count_failed_connect(first, error);
+    count_failed_connect(second, error);
+#ifndef _WIN32
+    errno = error;
+#endif
+  }
+  return sock;
+}
+
+void RouteDestination::count_connect(const TCPAddress &addr, std::chrono::microseconds latency) {
+  scoreboard_->get(addr)->connect_succeeded(latency);
+  if (metrics_) metrics_->add_latency(RoutingMetrics::Latency::kConnect, latency);
+
+  if (!hedges_connects()) return;
+
+  size_t bucket = 0;
+  while (bucket + 1 < kConnectTimeBuckets && latency.count() >= (int64_t{64} << bucket)) ++bucket;
+  connect_times_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  // the recent connects count more, races only blur the histogram a bit
+  if (connect_time_count_.fetch_add(1, std::memory_order_relaxed) + 1 == kConnectTimeWindow) {
+    uint32_t count = 0;
+    for (auto &times : connect_times_) {
+      const uint32_t halved = times.load(std::memory_order_relaxed) / 2;
+      times.store(halved, std::memory_order_relaxed);
+      count += halved;
+    }
+    connect_time_count_.store(count, std::memory_order_relaxed);
+  }
+}
+
+void RouteDestination::count_failed_connect(const TCPAddress &addr, int error) {
+  const auto score = scoreboard_->get(addr);
+  score->connect_failed(error);
+  if (score->get_circuit_breaker().failed(std::chrono::steady_clock::now())) {
+    log_warning("Circuit of destination server %s opened after failed connects or handshakes",
+                addr.str().c_str());
+  }
+  if (metrics_) metrics_->connect_failed();
+}
+
+std::chrono::milliseconds RouteDestination::get_hedge_delay(std::chrono::milliseconds connect_timeout) const noexcept {
+  std::array<uint32_t, kConnectTimeBuckets> times;
+  uint64_t count = 0;
+  for (size_t i = 0; i < kConnectTimeBuckets; ++i) {
+    times[i] = connect_times_[i].load(std::memory_order_relaxed);
+    count += times[i];
+  }
+
+  auto delay = routing::kDefaultHedgeDelay;
+  if (count >= kMinConnectTimes) {
+    // upper bound of the bucket holding the percentile, rounded up to milliseconds
+    const uint64_t rank = (count * hedge_percentile_ + 99) / 100;
+    uint64_t seen = 0;
+    size_t bucket = 0;
+    for (; bucket + 1 < kConnectTimeBuckets; ++bucket) {
+      seen += times[bucket];
+      if (seen >= rank) break;
+    }
+    delay = std::chrono::milliseconds(((int64_t{64} << bucket) + 999) / 1000);
+  }
+
+  return std::min(delay, connect_timeout);
+}
+
+std::chrono::microseconds RouteDestination::get_latency(const TCPAddress &addr) const {
+  auto score = scoreboard_->find(addr);
+  return score ? score->get_latency() : std::chrono::microseconds::zero();
+}
+
+void RouteDestination::update_latency(const TCPAddress &addr, std::chrono::microseconds rtt) {
+  scoreboard_->get(addr)->add_latency(rtt);
+}
+
+size_t RouteDestination::select_lowest_latency(const AddrVector &addrs, size_t start,
+                                               const std::function<bool(size_t)> &skip) const {
+  const size_t num_servers = addrs.size();
+  if (num_servers == 0) {
+    throw std::runtime_error("Destination servers list is empty");
+  }
+
+  std::vector<std::chrono::microseconds> latencies(num_servers, std::chrono::microseconds::max());
+  auto fastest = std::chrono::microseconds::max();
+  const auto scores = scoreboard_->get_all();
+  for (size_t i = 0; i < num_servers; ++i) {
+    if (skip && skip(i)) continue;
+
+    auto it = scores->find(addrs[i]);
+    latencies[i] = it == scores->end() ? std::chrono::microseconds::zero() : it->second->get_latency();
+    fastest = std::min(fastest, latencies[i]);
+  }
+
+  const bool explore = (start % kLatencyExplorationInterval) == kLatencyExplorationInterval - 1;
+  for (size_t i = 0; i < num_servers; ++i) {
+    const size_t index = (start + i) % num_servers;
+    if (latencies[index] == std::chrono::microseconds::max()) continue;  // skipped
+
+    if (explore || latencies[index] <= fastest + latency_tolerance_) return index;
+  }
+
+  return start % num_servers;
+}
+
+bool RouteDestination::is_throttled(const TCPAddress &addr, const AddrVector &servers,
+                                    const std::function<bool(size_t)> &skip) const noexcept {
+  const auto now = std::chrono::steady_clock::now();
+  const bool slow_starting = now.time_since_epoch().count() < slow_start_until_.load(std::memory_order_relaxed);
+  if (max_connections_per_server_ == 0 && !slow_starting) return false;
+
+  const auto scores = scoreboard_->get_all();
+  auto it = scores->find(addr);
+  // never connected to, nothing routed to it yet
+  if (it == scores->end()) return false;
+
+  const uint64_t active = it->second->get_active_connections();
+  if (max_connections_per_server_ > 0 && active >= max_connections_per_server_) return true;
+  if (!slow_starting) return false;
+
+  const double share = it->second->get_slow_start_share(now, slow_start_window_);
+  if (share >= 1) return false;
+
+  // the weight of the server is its share of what the others have
+  uint64_t total = 0;
+  size_t at_full_weight = 0;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    if (skip && skip(i)) continue;
+
+    auto score = scores->find(servers[i]);
+    if (score == scores->end()) {
+      ++at_full_weight;
+    } else if (score->second->get_slow_start_share(now, slow_start_window_) >= 1) {
+      total += score->second->get_active_connections();
+      ++at_full_weight;
+    }
+  }
+  // no other server can take the connection
+  if (at_full_weight == 0) return false;
+
+  return static_cast<double>(active) >= share * static_cast<double>(total) / static_cast<double>(at_full_weight);
+}
+
+bool RouteDestination::is_at_max_connections(const TCPAddress &addr) const noexcept {
+  if (max_connections_per_server_ == 0) return false;
+
+  auto score = scoreboard_->find(addr);
+  return score && score->get_active_connections() >= max_connections_per_server_;
+}
+
+bool RouteDestination::is_backing_off(const TCPAddress &addr) const {
+  if (DestinationHealth::instance().is_quarantined(addr)) return true;
+  if (backoff_count_.load(std::memory_order_relaxed) == 0) return false;
+
+  std::lock_guard<std::mutex> lock(backoff_mtx_);
+  auto it = backoffs_.find(addr);
+  return it != backoffs_.end() && std::chrono::steady_clock::now() < it->second.until;
+}
+
+void RouteDestination::report_connect(const TCPAddress &addr, bool connected) {
+  if (connected && backoff_count_.load(std::memory_order_relaxed) == 0) return;
+
+  std::lock_guard<std::mutex> lock(backoff_mtx_);
+  if (connected) {
+    backoffs_.erase(addr);
+  } else {
+    auto it = backoffs_.find(addr);
+    if (it == backoffs_.end()) {
+      it = backoffs_.emplace(addr, ConnectBackoff{{}, backoff_interval_}).first;
+    } else {
+      it->second.interval = std::min(it->second.interval * 2, backoff_max_interval_);
+    }
+    it->second.until = std::chrono::steady_clock::now() + it->second.interval;
+  }
+  backoff_count_.store(backoffs_.size(), std::memory_order_relaxed);
+}
+
+bool RouteDestination::is_circuit_open(const TCPAddress &addr) const {
+  if (!circuit_breaker_enabled_) return false;
+
+  auto score = scoreboard_->find(addr);
+  return score && !score->get_circuit_breaker().allows(std::chrono::steady_clock::now());
+}
+
+void RouteDestination::start_slow_start(const TCPAddress &addr) {
+  if (slow_start_window_.count() <= 0) return;
+
+  const auto now = std::chrono::steady_clock::now();
+  scoreboard_->get(addr)->start_slow_start(now);
+
+  const std::chrono::steady_clock::rep until = (now + slow_start_window_).time_since_epoch().count();
+  std::chrono::steady_clock::rep current = slow_start_until_.load(std::memory_order_relaxed);
+  while (current < until &&
+         !slow_start_until_.compare_exchange_weak(current, until, std::memory_order_relaxed)) {
+  }
+  log_debug("Slow start of destination server %s for %lldms", addr.str().c_str(),
+            static_cast<long long>(slow_start_window_.count()));
+}
+
+std::vector<bool> RouteDestination::probe_mysql_servers(const std::vector<TCPAddress> &addrs,
+                                                        std::chrono::milliseconds connect_timeout) {
+  if (!unix_sockets_) return routing_sock_ops_->probe_mysql_servers(addrs, connect_timeout);
+
+  std::vector<TCPAddress> connect_addrs;
+  connect_addrs.reserve(addrs.size());
+  for (const auto &addr : addrs) {
+    connect_addrs.push_back(get_connect_address(unix_sockets_.get(), addr));
+  }
+  return routing_sock_ops_->probe_mysql_servers(connect_addrs, connect_timeout);
 }
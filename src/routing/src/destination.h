@@ -28,21 +28,30 @@
 #include "router_config.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 #include <list>
 
+#include "destination_scoreboard.h"
 #include "mysqlrouter/routing.h"
 #include "mysql/harness/logging/logging.h"
 #include "protocol/protocol.h"
 #include "tcp_address.h"
 IMPORT_LOG_FUNCTIONS()
 
+class RoutingMetrics;
+class WarmConnectionPool;
+
 using AllowedNodes = std::vector<mysql_harness::TCPAddress>;
 // first argument is the new set of the allowed nodes
 // second argument is the description of the condition that triggered the change (like '
@@ -101,6 +110,67 @@ class RouteDestination: public DestinationNodesStateNotifier {
 
   using AddrVector = std::vector<mysql_harness::TCPAddress>;
 
+  /** @brief Shares a time budget between the connects of the calling thread
+   *
+   * While an instance lives, get_mysql_socket() waits at most for what is
+   * left of the budget, whatever the connect timeout, and fails right away
+   * with ETIMEDOUT once it is used up. Strategies waiting for the cluster,
+   * like the metadata cache waiting for a new primary, wait only for what
+   * is left as well. Nested instances can only shorten the budget.
+   */
+  class ConnectDeadline {
+   public:
+    /** @param budget time all connects may take together, 0 for no limit */
+    explicit ConnectDeadline(std::chrono::milliseconds budget) noexcept;
+    ~ConnectDeadline();
+
+    ConnectDeadline(const ConnectDeadline&) = delete;
+    ConnectDeadline& operator=(const ConnectDeadline&) = delete;
+
+    /**
+     * @brief Cuts the timeout to what is left of the budget.
+     *
+     * @param timeout timeout to cut, left as it is without budget
+     *
+     * @return false if the budget is used up
+     */
+    static bool limit(std::chrono::milliseconds &timeout) noexcept;
+
+   private:
+    /** @brief deadline of the enclosing instance, the epoch if there is none */
+    std::chrono::steady_clock::time_point previous_;
+  };
+
+  /** @brief Lets the connects of the calling thread reuse pooled server sessions
+   *
+   * While an instance lives, get_mysql_socket() asks it for a session to
+   * the server the strategy picked before connecting, so a reused session
+   * goes through the same balancing, limits and quarantine as a new
+   * connection. Nested instances hide the enclosing one.
+   */
+  class SessionReuse {
+   public:
+    /** @brief returns a socket with a session to the server, -1 if there is none */
+    using Take = std::function<int(const mysql_harness::TCPAddress &addr)>;
+
+    explicit SessionReuse(Take take);
+    ~SessionReuse();
+
+    SessionReuse(const SessionReuse&) = delete;
+    SessionReuse& operator=(const SessionReuse&) = delete;
+
+    /**
+     * @brief Takes a session to the server from the innermost instance.
+     *
+     * @return socket of the session, -1 if there is none or no instance lives
+     */
+    static int take(const mysql_harness::TCPAddress &addr);
+
+   private:
+    Take take_;
+    SessionReuse *previous_;
+  };
+
   /** @brief Default constructor
    *
    * @param protocol Protocol for the destination, defaults to value returned
@@ -116,6 +186,144 @@ class RouteDestination: public DestinationNodesStateNotifier {
   /** @brief Destructor */
   virtual ~RouteDestination() {}
 
+  /** @brief Sets options applied to the sockets connecting to the servers */
+  void set_socket_options(const routing::SocketOptions& socket_options) {
+    socket_options_ = socket_options;
+  }
+
+  /** @brief Sets the sockets connected ahead that get_mysql_socket() takes first
+   *
+   * @param warm_pool connected sockets, nullptr to always connect
+   */
+  void set_warm_pool(std::shared_ptr<WarmConnectionPool> warm_pool) {
+    warm_pool_ = warm_pool;
+  }
+
+  /** @brief Sets counters the connects and quarantined servers are reported to */
+  void set_metrics(std::shared_ptr<RoutingMetrics> metrics) {
+    metrics_ = metrics;
+  }
+
+  /** @brief Sets the pauses between probing quarantined servers
+   *
+   * Destinations not quarantining servers use them as the backoff of the
+   * servers failing a connect, see is_backing_off().
+   *
+   * @param interval pause after servers got quarantined
+   * @param max_interval longest pause, reached while servers don't recover
+   */
+  virtual void set_quarantine_interval(std::chrono::milliseconds interval,
+                                       std::chrono::milliseconds max_interval) {
+    backoff_interval_ = interval;
+    backoff_max_interval_ = max_interval;
+  }
+
+  /** @brief Returns smoothed round trip time of connecting to the server
+   *
+   * Exponentially weighted moving average of the time the connects to the
+   * server took, zero until a connect succeeded.
+   *
+   * @param addr server to look up
+   */
+  std::chrono::microseconds get_latency(const mysql_harness::TCPAddress &addr) const;
+
+  /** @brief Returns the scores of the servers connected to
+   *
+   * Connects are scored by get_mysql_socket(), the connections routed to
+   * the servers score what they forward.
+   */
+  const std::shared_ptr<DestinationScoreboard> &get_scoreboard() const noexcept {
+    return scoreboard_;
+  }
+
+  /** @brief Sets how much slower than the fastest server a server may be
+   *         to still get connections with the lowest-latency strategy */
+  void set_latency_tolerance(std::chrono::microseconds tolerance) {
+    latency_tolerance_ = tolerance;
+  }
+
+  /** @brief Sets limits keeping new connections off busy or recovering servers
+   *
+   * A server with max_connections routed to it gets no new ones. A server
+   * that recovered, by leaving the quarantine or rejoining the cluster,
+   * slow-starts: while the window passes, its weight ramps up from 0 to
+   * that of the other servers, it only takes new connections while it has
+   * fewer than its share of the average of the servers at full weight.
+   * Strategies failing over to the next server (first-available,
+   * next-available) ignore the limits.
+   *
+   * @param max_connections connections a server may have, 0 for no limit
+   * @param slow_start_window time a recovered server takes to get its full share, 0 for none
+   */
+  void set_destination_limits(unsigned int max_connections,
+                              std::chrono::milliseconds slow_start_window) {
+    max_connections_per_server_ = max_connections;
+    slow_start_window_ = slow_start_window;
+  }
+
+  /** @brief Sets when servers failing connects or handshakes get no new connections
+   *
+   * See CircuitBreaker, the connections report their handshakes to the
+   * scoreboard.
+   *
+   * @param failures failures in a row that open the circuit of a server, 0 disables it
+   * @param open_interval time the circuit stays open
+   * @param half_open_connections connections that need to succeed to close the circuit again
+   */
+  void set_circuit_breaker(unsigned int failures, std::chrono::milliseconds open_interval,
+                           unsigned int half_open_connections) {
+    circuit_breaker_enabled_ = failures > 0;
+    scoreboard_->set_circuit_breaker(failures, open_interval, half_open_connections);
+  }
+
+  /** @brief Sets when a connect tries a second server while the first one doesn't answer
+   *
+   * A server that doesn't answer within the percentile of the recent
+   * connect times of the route's servers, kDefaultHedgeDelay until enough
+   * connects were timed, gets raced with the next one, see
+   * get_mysql_socket_hedged(). Only the round-robin strategies of static
+   * and of metadata cache secondary destinations hedge.
+   *
+   * @param percentile 1 to 99, 0 to connect one server after the other
+   */
+  void set_connect_hedging(unsigned int percentile) noexcept {
+    hedge_percentile_ = percentile;
+  }
+
+  /** @brief Returns the delay before a hedged connect tries the next server
+   *
+   * @param connect_timeout timeout of the connect, the delay isn't longer
+   */
+  std::chrono::milliseconds get_hedge_delay(std::chrono::milliseconds connect_timeout) const noexcept;
+
+  /** @brief unix sockets servers get connected at, by their TCP address */
+  using UnixSockets = std::map<mysql_harness::TCPAddress, mysql_harness::TCPAddress>;
+
+  /** @brief Sets the servers that get connected at a unix socket
+   *
+   * For servers running on the host of the router, like the ones the
+   * metadata cache reports by their TCP address. The servers keep their TCP
+   * address everywhere else, only connects and probes go to the socket.
+   *
+   * @param unix_sockets sockets by TCP address, nullptr to connect all servers with TCP
+   */
+  void set_unix_sockets(std::shared_ptr<const UnixSockets> unix_sockets) {
+    unix_sockets_ = unix_sockets;
+  }
+
+  /** @brief Returns the address a server gets connected at
+   *
+   * @param unix_sockets sockets by TCP address, may be nullptr
+   * @param addr TCP address of the server
+   * @return the unix socket set for addr, or addr
+   */
+  static const mysql_harness::TCPAddress &get_connect_address(const UnixSockets *unix_sockets,
+                                                              const mysql_harness::TCPAddress &addr) {
+    if (unix_sockets == nullptr) return addr;
+    auto it = unix_sockets->find(addr);
+    return it == unix_sockets->end() ? addr : it->second;
+  }
+
   RouteDestination(const RouteDestination &other) = delete;
   RouteDestination(RouteDestination &&other) = delete;
   RouteDestination &operator=(const RouteDestination &other) = delete;
@@ -179,6 +387,62 @@ class RouteDestination: public DestinationNodesStateNotifier {
   virtual int get_server_socket(std::chrono::milliseconds connect_timeout, int *error,
                                 mysql_harness::TCPAddress *address = nullptr) noexcept = 0;
 
+  /** @brief Gets connection to destination for a client
+   *
+   * Strategies keeping the clients on the same server, like
+   * consistent-hash, pick the server by the key, the others call
+   * get_server_socket().
+   *
+   * @param client_key identifies the client, see get_client_key()
+   * @param connect_timeout timeout
+   * @param error Pointer to int for storing errno
+   * @param address Pointer to memory for storing destination address
+   * @return a socket descriptor or -1 if no server is available
+   */
+  virtual int get_server_socket_for_client(uint64_t client_key, std::chrono::milliseconds connect_timeout,
+                                           int *error, mysql_harness::TCPAddress *address = nullptr) noexcept {
+    (void)client_key;
+    return get_server_socket(connect_timeout, error, address);
+  }
+
+  /** @brief Returns the key of the client host for get_server_socket_for_client()
+   *
+   * Clients connecting from the same address get the same key, the port
+   * is left out. Clients connecting over the named socket all get the same.
+   */
+  static uint64_t get_client_key(const sockaddr_storage &client_addr);
+
+  /** @brief Returns true if reads of a client go to other servers than its writes */
+  virtual bool splits_reads() const noexcept {
+    return false;
+  }
+
+  /** @brief Returns true if reads after a write wait for a server that applied it
+   *
+   * Only used when splits_reads() is true.
+   */
+  virtual bool reads_own_writes() const noexcept {
+    return false;
+  }
+
+  /** @brief Gets connection to a server reads can be sent to
+   *
+   * Used by connections when splits_reads() is true, besides the
+   * connection to the server returned by get_server_socket().
+   *
+   * @param connect_timeout timeout
+   * @param error Pointer to int for storing errno
+   * @param address Pointer to memory for storing destination address
+   * @return a socket descriptor or -1 if no server is available
+   */
+  virtual int get_read_only_server_socket(std::chrono::milliseconds connect_timeout, int *error,
+                                          mysql_harness::TCPAddress *address = nullptr) noexcept {
+    (void)connect_timeout;
+    (void)address;
+    *error = 0;
+    return -1;
+  }
+
   /** @brief Gets the number of destinations
    *
    * Gets the number of destinations currently in the list.
@@ -195,6 +459,16 @@ class RouteDestination: public DestinationNodesStateNotifier {
     return destinations_.empty();
   }
 
+  /** @brief Returns whether the destination can route new connections
+   *
+   * Used to tell when the route is ready to serve traffic.
+   *
+   * @return true if there are destinations to route to
+   */
+  virtual bool is_ready() {
+    return !empty();
+  }
+
   /** @brief Start the destination threads (if any)
    *
    */
@@ -222,8 +496,9 @@ class RouteDestination: public DestinationNodesStateNotifier {
    * Returns a socket descriptor for the connection to the MySQL Server or
    * -1 when an error occurred.
    *
-   * This method normally calls SocketOperations::get_mysql_socket() (default
-   * "real" implementation), but can be configured to call another implementation
+   * Takes a socket connected ahead by the warm pool if there is one, else
+   * calls SocketOperations::get_mysql_socket() (default "real"
+   * implementation), but can be configured to call another implementation
    * (e.g. a mock counterpart).
    *
    * @param addr information of the server we connect with
@@ -233,7 +508,115 @@ class RouteDestination: public DestinationNodesStateNotifier {
    */
   virtual int get_mysql_socket(const mysql_harness::TCPAddress &addr, std::chrono::milliseconds connect_timeout, bool log_errors = true);
 
+  /** @brief true if set_connect_hedging() enabled hedged connects */
+  bool hedges_connects() const noexcept { return hedge_percentile_ != 0; }
+
+  /** @brief Returns socket descriptor of the first of two servers that answers
+   *
+   * Like get_mysql_socket(), but connects the second server too if the
+   * first one didn't answer after get_hedge_delay() or failed, the other
+   * connect gets closed, see RoutingSockOps::get_mysql_socket_hedged().
+   * With the classic protocol a server answers with its greeting. Only the
+   * winner is scored, or both if both fail.
+   *
+   * @param first server to connect first
+   * @param second server to connect if the first one is slow
+   * @param connect_timeout timeout waiting for each connection
+   * @param second_won set to true if the socket is connected to second
+   * @return a socket descriptor, -1 if neither server answered
+   */
+  int get_mysql_socket_hedged(const mysql_harness::TCPAddress &first, const mysql_harness::TCPAddress &second,
+                              std::chrono::milliseconds connect_timeout, bool &second_won);
+
+  /** @brief Checks which of the servers accept connections
+   *
+   * Like get_mysql_socket(), calls RoutingSockOps::probe_mysql_servers()
+   * unless configured to call another implementation.
+   *
+   * @param addrs servers to check
+   * @param connect_timeout timeout waiting for the connections
+   * @return for each server whether it accepted the connection
+   */
+  virtual std::vector<bool> probe_mysql_servers(const std::vector<mysql_harness::TCPAddress> &addrs,
+                                                std::chrono::milliseconds connect_timeout);
+
+  /** @brief Feeds a connect round trip time into the server's average */
+  void update_latency(const mysql_harness::TCPAddress &addr, std::chrono::microseconds rtt);
+
+  /** @brief Picks one of the servers with the lowest latency
+   *
+   * Servers whose latency is within the tolerance of the fastest one are
+   * taken round-robin, starting at start. Servers not measured yet count as
+   * fastest. Every kLatencyExplorationInterval-th pick ignores the latency,
+   * so the slower servers keep getting measured.
+   *
+   * @param addrs servers to choose from
+   * @param start round-robin position
+   * @param skip returns true for the indexes of servers not to pick
+   * @return index into addrs, start modulo number of servers if all get skipped
+   */
+  size_t select_lowest_latency(const AddrVector &addrs, size_t start,
+                               const std::function<bool(size_t)> &skip = nullptr) const;
+
+  /** @brief Orders the servers by their rendezvous hash for the key
+   *
+   * Each server scores a hash of the key and its address, the server with
+   * the highest score gets the key (rendezvous or highest random weight
+   * hashing). Servers added or removed only take or give up their own
+   * keys, all other keys stay on their servers. The scores only depend on
+   * the addresses, routers having the same servers agree on the order.
+   *
+   * @param addrs servers to order
+   * @param key identifies the client
+   * @return indexes into addrs, highest score first
+   */
+  static std::vector<size_t> rank_by_rendezvous_hash(const AddrVector &addrs, uint64_t key);
+
+  /** @brief Returns true if the server shouldn't get a new connection now
+   *
+   * See set_destination_limits().
+   *
+   * @param addr server to check
+   * @param servers servers the strategy picks from, their average decides
+   *        about the share of a slow-starting server
+   * @param skip returns true for the indexes of servers not to count, like
+   *        quarantined ones
+   */
+  bool is_throttled(const mysql_harness::TCPAddress &addr, const AddrVector &servers,
+                    const std::function<bool(size_t)> &skip = nullptr) const noexcept;
+
+  /** @brief Returns true if the server has the max connections set by set_destination_limits() */
+  bool is_at_max_connections(const mysql_harness::TCPAddress &addr) const noexcept;
+
+  /** @brief Returns true if the circuit breaker of the server lets no new connection through */
+  bool is_circuit_open(const mysql_harness::TCPAddress &addr) const;
+
+  /** @brief Returns true if the server is known to fail connects right now
+   *
+   * True while the server waits out the backoff after a failed connect,
+   * which starts at the quarantine interval and doubles with each further
+   * failure up to the max interval, or while the routes sharing the
+   * quarantine through DestinationHealth have it quarantined. For the
+   * strategies failing over to the next server, which try those servers
+   * only once all others failed. Doesn't lock while no server failed.
+   *
+   * @param addr server to check
+   */
+  bool is_backing_off(const mysql_harness::TCPAddress &addr) const;
+
+  /** @brief Tells is_backing_off() whether a connect to the server succeeded */
+  void report_connect(const mysql_harness::TCPAddress &addr, bool connected);
+
+  /** @brief Lets a server that recovered slow-start, if a slow start window is set */
+  void start_slow_start(const mysql_harness::TCPAddress &addr);
+
+  /** @brief one in that many lowest-latency picks ignores the latency */
+  static const size_t kLatencyExplorationInterval = 64;
+
   /** @brief Gets the id of the next server to connect to.
+   *
+   * Wait-free, destinations must not be changed while connections are
+   * routed.
    *
    * @throws std::logic_error if destinations list is empty
    */
@@ -248,9 +631,84 @@ class RouteDestination: public DestinationNodesStateNotifier {
   /** @brief Mutex for updating destinations and iterator */
   std::mutex mutex_update_;
 
+  /** @brief connects, latency and traffic per server */
+  std::shared_ptr<DestinationScoreboard> scoreboard_{std::make_shared<DestinationScoreboard>()};
+
+  /** @brief slowest a server may be compared to the fastest for lowest-latency */
+  std::chrono::microseconds latency_tolerance_{routing::kDefaultLatencyTolerance};
+
+  /** @brief connections a server may have, 0 for no limit */
+  unsigned int max_connections_per_server_{0};
+
+  /** @brief time a recovered server takes to get its full share of new connections */
+  std::chrono::milliseconds slow_start_window_{0};
+
+  /** @brief steady_clock ticks when the last slow start ends, limits aren't checked after */
+  std::atomic<std::chrono::steady_clock::rep> slow_start_until_{0};
+
+  /** @brief circuit breakers are checked only if set_circuit_breaker() enabled them */
+  bool circuit_breaker_enabled_{false};
+
+  /** @brief backoff of a server that failed its last connects */
+  struct ConnectBackoff {
+    std::chrono::steady_clock::time_point until;
+    std::chrono::milliseconds interval;
+  };
+
+  /** @brief protects backoffs_ */
+  mutable std::mutex backoff_mtx_;
+
+  /** @brief servers whose last connect failed */
+  std::map<mysql_harness::TCPAddress, ConnectBackoff> backoffs_;
+
+  /** @brief size of backoffs_, read without lock */
+  std::atomic<size_t> backoff_count_{0};
+
+  /** @brief backoff after the first failed connect of a server */
+  std::chrono::milliseconds backoff_interval_{routing::kDefaultQuarantineInterval};
+
+  /** @brief longest backoff, reached while the server keeps failing */
+  std::chrono::milliseconds backoff_max_interval_{routing::kDefaultQuarantineMaxInterval};
+
+  /** @brief scores a connect to the server that succeeded after latency */
+  void count_connect(const mysql_harness::TCPAddress &addr, std::chrono::microseconds latency);
+
+  /** @brief scores a connect to the server that failed with error */
+  void count_failed_connect(const mysql_harness::TCPAddress &addr, int error);
+
+  /** @brief buckets of connect_times_, bucket i counts times below 2^i * 64 microseconds */
+  static constexpr size_t kConnectTimeBuckets = 24;
+
+  /** @brief connect times after which the older ones count half */
+  static constexpr uint32_t kConnectTimeWindow = 1024;
+
+  /** @brief connect times needed before their percentile is used for hedging */
+  static constexpr uint32_t kMinConnectTimes = 16;
+
+  /** @brief percentile of the connect times after which connects get hedged, 0 if they don't */
+  unsigned int hedge_percentile_{0};
+
+  /** @brief histogram of the recent successful connect times, kept while hedging */
+  std::array<std::atomic<uint32_t>, kConnectTimeBuckets> connect_times_{};
+
+  /** @brief connect times in connect_times_ */
+  std::atomic<uint32_t> connect_time_count_{0};
+
   /** @brief socket operation methods (facilitates dependency injection)*/
   routing::RoutingSockOpsInterface *routing_sock_ops_;
 
+  /** @brief options applied to the sockets connecting to the servers */
+  routing::SocketOptions socket_options_;
+
+  /** @brief servers connected at a unix socket, nullptr if none */
+  std::shared_ptr<const UnixSockets> unix_sockets_;
+
+  /** @brief counters of the route, nullptr if not counting */
+  std::shared_ptr<RoutingMetrics> metrics_;
+
+  /** @brief sockets connected ahead, nullptr if the servers get connected on demand */
+  std::shared_ptr<WarmConnectionPool> warm_pool_;
+
   /** @brief Protocol for the destination */
   Protocol::Type protocol_;
 };
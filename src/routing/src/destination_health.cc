@@ -0,0 +1,227 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "destination_health.h"
+
+#include <algorithm>
+
+#include "common.h"
+#include "mysqlrouter/routing.h"
+
+using mysql_harness::TCPAddress;
+
+DestinationHealth &DestinationHealth::instance() {
+  static DestinationHealth instance;
+
+  return instance;
+}
+
+DestinationHealth::~DestinationHealth() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopping_ = true;
+  }
+  quarantined_cond_.notify_all();
+  stopping_cond_.notify_all();
+  if (thread_) thread_->join();
+}
+
+void DestinationHealth::join(Member *member, const TCPAddress &addr) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  Server &server = servers_[addr];
+  server.members.push_back(member);
+  if (server.quarantined) member->on_quarantine_changed(addr, true);
+}
+
+void DestinationHealth::leave(Member *member, const TCPAddress &addr) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = servers_.find(addr);
+  if (it == servers_.end()) return;
+
+  auto &members = it->second.members;
+  auto member_it = std::find(members.begin(), members.end(), member);
+  if (member_it != members.end()) members.erase(member_it);
+  if (members.empty()) {
+    if (it->second.quarantined) --quarantined_count_;
+    servers_.erase(it);
+  }
+}
+
+void DestinationHealth::leave_all(Member *member) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  probing_members_.erase(member);
+  probed_cond_.wait(lock, [this, member] { return probing_ != member; });
+
+  for (auto it = servers_.begin(); it != servers_.end();) {
+    auto &members = it->second.members;
+    members.erase(std::remove(members.begin(), members.end(), member), members.end());
+    if (members.empty()) {
+      if (it->second.quarantined) --quarantined_count_;
+      it = servers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void DestinationHealth::start_probing(Member *member, std::chrono::milliseconds interval,
+                                      std::chrono::milliseconds max_interval,
+                                      size_t thread_stack_size) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  probing_members_[member] = ProbeSettings{interval, max_interval};
+  if (!thread_) {
+    // idles once no member probes anymore, until the process exits
+    thread_.reset(new mysql_harness::MySQLRouterThread(thread_stack_size));
+    thread_->run(&run_thread, this);
+  }
+  // servers quarantined before are waiting
+  quarantined_cond_.notify_one();
+}
+
+void DestinationHealth::quarantine(const TCPAddress &addr) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = servers_.find(addr);
+  if (it == servers_.end() || it->second.quarantined) return;
+
+  set_quarantined(it, true);
+  quarantined_cond_.notify_one();
+}
+
+void DestinationHealth::unquarantine(const TCPAddress &addr) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = servers_.find(addr);
+  if (it == servers_.end() || !it->second.quarantined) return;
+
+  set_quarantined(it, false);
+}
+
+bool DestinationHealth::is_quarantined(const TCPAddress &addr) const {
+  if (quarantined_count_.load(std::memory_order_relaxed) == 0) return false;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = servers_.find(addr);
+  return it != servers_.end() && it->second.quarantined;
+}
+
+void DestinationHealth::set_quarantined(std::map<TCPAddress, Server>::iterator it, bool quarantined) {
+  it->second.quarantined = quarantined;
+  if (quarantined) {
+    ++quarantined_count_;
+  } else {
+    --quarantined_count_;
+  }
+  for (Member *member: it->second.members) {
+    member->on_quarantine_changed(it->first, quarantined);
+  }
+}
+
+void *DestinationHealth::run_thread(void *context) {
+  static_cast<DestinationHealth *>(context)->run();
+  return nullptr;
+}
+
+void DestinationHealth::run() {
+  mysql_harness::rename_thread("RtQ:health");
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  std::chrono::milliseconds interval = get_interval();
+  while (!stopping_) {
+    quarantined_cond_.wait(lock, [this] {
+      return stopping_ || (quarantined_count_ > 0 && !probing_members_.empty());
+    });
+    if (stopping_) break;
+
+    if (probe_quarantined(lock) || quarantined_count_ == 0) {
+      interval = get_interval();
+    }
+
+    // Temporize, the destructor wakes us up
+    stopping_cond_.wait_for(lock, interval, [this] { return stopping_; });
+
+    // back off while the servers stay unreachable
+    interval = std::min(interval * 2, get_max_interval());
+  }
+}
+
+bool DestinationHealth::probe_quarantined(std::unique_lock<std::mutex> &lock) {
+  // each server gets probed once, by the first of its members that probes
+  std::map<Member *, std::vector<TCPAddress>> probes;
+  for (const auto &server: servers_) {
+    if (!server.second.quarantined) continue;
+
+    for (Member *member: server.second.members) {
+      if (probing_members_.count(member) != 0) {
+        probes[member].push_back(server.first);
+        break;
+      }
+    }
+  }
+
+  bool recovered = false;
+  for (const auto &probe: probes) {
+    // the member may have left while another one probed
+    if (stopping_ || probing_members_.count(probe.first) == 0) continue;
+
+    probing_ = probe.first;
+    lock.unlock();
+    std::vector<bool> reachable;
+    try {
+      reachable = probe.first->probe(probe.second);
+    } catch (...) {
+      // unreachable then
+    }
+    lock.lock();
+    probing_ = nullptr;
+    probed_cond_.notify_all();
+
+    for (size_t i = 0; i < probe.second.size() && i < reachable.size(); ++i) {
+      if (!reachable[i]) continue;
+
+      auto it = servers_.find(probe.second[i]);
+      if (it != servers_.end() && it->second.quarantined) {
+        set_quarantined(it, false);
+        recovered = true;
+      }
+    }
+  }
+
+  return recovered;
+}
+
+std::chrono::milliseconds DestinationHealth::get_interval() const {
+  std::chrono::milliseconds interval = std::chrono::milliseconds::max();
+  for (const auto &member: probing_members_) {
+    interval = std::min(interval, member.second.interval);
+  }
+  return probing_members_.empty() ? routing::kDefaultQuarantineInterval : interval;
+}
+
+std::chrono::milliseconds DestinationHealth::get_max_interval() const {
+  std::chrono::milliseconds interval = std::chrono::milliseconds::max();
+  for (const auto &member: probing_members_) {
+    interval = std::min(interval, member.second.max_interval);
+  }
+  return probing_members_.empty() ? routing::kDefaultQuarantineMaxInterval : interval;
+}
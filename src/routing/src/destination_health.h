@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_DESTINATION_HEALTH_INCLUDED
+#define ROUTING_DESTINATION_HEALTH_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mysql_router_thread.h"
+#include "tcp_address.h"
+
+/**
+ * @brief Quarantine of the destination servers, shared by all routes.
+ *
+ * Routes pointing at the same servers see a server fail once: the first
+ * failed connect quarantines it for every route that has it. One thread
+ * probes the quarantined servers, each server once per round no matter how
+ * many routes have it, and lifts the quarantine for all of them together.
+ *
+ * The probes back off like DestRoundRobin's did: the pause starts at the
+ * shortest quarantine interval of the probing routes and doubles while no
+ * server recovers, up to the shortest max interval.
+ */
+class DestinationHealth {
+public:
+  /** @brief A route sharing the quarantine */
+  class Member {
+  public:
+    virtual ~Member() = default;
+
+    /**
+     * @brief the quarantine of one of the member's servers changed.
+     *
+     * Called with the registry locked, must not call back into it.
+     */
+    virtual void on_quarantine_changed(const mysql_harness::TCPAddress &addr, bool quarantined) noexcept = 0;
+
+    /** @brief tells which of the servers accept connections again, called by the probing thread */
+    virtual std::vector<bool> probe(const std::vector<mysql_harness::TCPAddress> &addrs) = 0;
+  };
+
+  /** @brief the registry of the process */
+  static DestinationHealth &instance();
+
+  DestinationHealth() = default;
+  ~DestinationHealth();
+
+  DestinationHealth(const DestinationHealth &) = delete;
+  DestinationHealth &operator=(const DestinationHealth &) = delete;
+
+  /**
+   * @brief member gets told about the quarantine of the server.
+   *
+   * Tells the member right away if the server is quarantined already.
+   */
+  void join(Member *member, const mysql_harness::TCPAddress &addr);
+
+  /** @brief member isn't told about the server anymore, the server is forgotten once no member has it */
+  void leave(Member *member, const mysql_harness::TCPAddress &addr);
+
+  /**
+   * @brief member leaves all its servers and stops probing.
+   *
+   * Waits for a probe the member runs, members call it before they get destroyed.
+   */
+  void leave_all(Member *member);
+
+  /**
+   * @brief member probes its quarantined servers.
+   *
+   * Starts the probing thread if it isn't running yet.
+   *
+   * @param member member to probe
+   * @param interval pause after servers got quarantined
+   * @param max_interval longest pause between the probes
+   * @param thread_stack_size stack of the probing thread, in kilobytes
+   */
+  void start_probing(Member *member, std::chrono::milliseconds interval,
+                     std::chrono::milliseconds max_interval, size_t thread_stack_size);
+
+  /** @brief quarantines the server for all its members */
+  void quarantine(const mysql_harness::TCPAddress &addr);
+
+  /** @brief lifts the quarantine of the server for all its members */
+  void unquarantine(const mysql_harness::TCPAddress &addr);
+
+  /** @brief true if the server is quarantined, doesn't lock while no server is */
+  bool is_quarantined(const mysql_harness::TCPAddress &addr) const;
+
+private:
+  struct Server {
+    bool quarantined{false};
+    std::vector<Member *> members;
+  };
+
+  struct ProbeSettings {
+    std::chrono::milliseconds interval;
+    std::chrono::milliseconds max_interval;
+  };
+
+  static void *run_thread(void *context);
+
+  void run();
+
+  /** @brief probes the quarantined servers once, the lock is released while probing */
+  bool probe_quarantined(std::unique_lock<std::mutex> &lock);
+
+  void set_quarantined(std::map<mysql_harness::TCPAddress, Server>::iterator it, bool quarantined);
+
+  std::chrono::milliseconds get_interval() const;
+  std::chrono::milliseconds get_max_interval() const;
+
+  mutable std::mutex mtx_;
+  /** @brief wakes the probing thread when servers get quarantined */
+  std::condition_variable quarantined_cond_;
+  /** @brief wakes the probing thread when stopping */
+  std::condition_variable stopping_cond_;
+  /** @brief tells leave_all() a probe finished */
+  std::condition_variable probed_cond_;
+
+  std::map<mysql_harness::TCPAddress, Server> servers_;
+  /** @brief changed with mtx_ held, read without by is_quarantined() */
+  std::atomic<size_t> quarantined_count_{0};
+  std::map<Member *, ProbeSettings> probing_members_;
+  /** @brief member running a probe with the lock released, nullptr if none */
+  Member *probing_{nullptr};
+
+  std::unique_ptr<mysql_harness::MySQLRouterThread> thread_;
+  bool stopping_{false};
+};
+
+#endif // ROUTING_DESTINATION_HEALTH_INCLUDED
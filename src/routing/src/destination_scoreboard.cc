@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "destination_scoreboard.h"
+
+#include <algorithm>
+
+using mysql_harness::TCPAddress;
+
+const int DestinationScore::kSmoothing;
+const uint32_t DestinationScore::kRateOne;
+
+void DestinationScore::connect_succeeded(std::chrono::microseconds latency) noexcept {
+  connects_succeeded_.fetch_add(1, std::memory_order_relaxed);
+  add_success(true);
+  add_latency(latency);
+}
+
+void DestinationScore::connect_failed(int error) noexcept {
+  connects_failed_.fetch_add(1, std::memory_order_relaxed);
+  add_success(false);
+  last_error_.store(error, std::memory_order_relaxed);
+  last_error_at_us_.store(std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now().time_since_epoch()).count(),
+                          std::memory_order_relaxed);
+}
+
+void DestinationScore::add_latency(std::chrono::microseconds latency) noexcept {
+  // at least 1us, zero means not measured
+  const int64_t sample = std::max<int64_t>(latency.count(), 1);
+
+  int64_t current = latency_us_.load(std::memory_order_relaxed);
+  int64_t next;
+  do {
+    // weight 1/8 for the new sample, as TCP smooths its RTT (RFC 6298)
+    next = current == 0 ? sample : current + (sample - current) / kSmoothing;
+  } while (!latency_us_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+void DestinationScore::add_success(bool succeeded) noexcept {
+  const int64_t sample = succeeded ? kRateOne : 0;
+
+  uint32_t current = success_rate_.load(std::memory_order_relaxed);
+  uint32_t next;
+  do {
+    next = static_cast<uint32_t>(current + (sample - static_cast<int64_t>(current)) / kSmoothing);
+  } while (!success_rate_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+double DestinationScore::get_slow_start_share(std::chrono::steady_clock::time_point now,
+                                              std::chrono::milliseconds window) const noexcept {
+  const std::chrono::steady_clock::rep started = slow_start_at_.load(std::memory_order_relaxed);
+  if (started == 0 || window.count() <= 0) return 1;
+
+  const auto elapsed = now - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(started));
+  if (elapsed >= window) return 1;
+  if (elapsed.count() <= 0) return 0;
+
+  return std::chrono::duration<double>(elapsed).count() / std::chrono::duration<double>(window).count();
+}
+
+DestinationScoreboard::DestinationScoreboard(): scores_(std::make_shared<const Scores>()) {}
+
+std::shared_ptr<DestinationScore> DestinationScoreboard::get(const TCPAddress &addr) {
+  {
+    auto scores = std::atomic_load(&scores_);
+    auto it = scores->find(addr);
+    if (it != scores->end()) return it->second;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto scores = std::make_shared<Scores>(*scores_);
+  // another thread may have added it meanwhile
+  auto &score = (*scores)[addr];
+  if (!score) {
+    score = std::make_shared<DestinationScore>();
+    score->circuit_breaker_.configure(circuit_failures_, circuit_open_interval_,
+                                      circuit_half_open_connections_);
+  }
+  auto result = score;
+  std::atomic_store(&scores_, std::shared_ptr<const Scores>(std::move(scores)));
+
+  return result;
+}
+
+std::shared_ptr<const DestinationScore> DestinationScoreboard::find(const TCPAddress &addr) const {
+  auto scores = std::atomic_load(&scores_);
+  auto it = scores->find(addr);
+  return it == scores->end() ? nullptr : it->second;
+}
+
+std::vector<RouteDestinationScore> DestinationScoreboard::get_scores() {
+  const auto now = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::vector<RouteDestinationScore> result;
+  result.reserve(scores_->size());
+  for (const auto &entry: *scores_) {
+    DestinationScore &score = *entry.second;
+
+    const uint64_t bytes = score.bytes_.load(std::memory_order_relaxed);
+    const auto elapsed = std::chrono::duration<double>(now - score.sampled_at_);
+    if (elapsed >= std::chrono::seconds(1)) {
+      score.bytes_per_second_ = static_cast<double>(bytes - score.sampled_bytes_) / elapsed.count();
+      score.sampled_bytes_ = bytes;
+      score.sampled_at_ = now;
+    }
+
+    RouteDestinationScore info;
+    info.address = entry.first.str();
+    info.connects_succeeded = score.connects_succeeded_.load(std::memory_order_relaxed);
+    info.connects_failed = score.connects_failed_.load(std::memory_order_relaxed);
+    info.connect_success_rate = score.get_connect_success_rate();
+    info.connect_latency = score.get_latency();
+    info.active_connections = score.get_active_connections();
+    info.bytes_per_second = score.bytes_per_second_;
+    info.circuit_state = CircuitBreaker::to_string(score.circuit_breaker_.get_state());
+    info.last_error = score.last_error_.load(std::memory_order_relaxed);
+    info.last_error_time = std::chrono::system_clock::time_point(std::chrono::duration_cast<
+        std::chrono::system_clock::duration>(std::chrono::microseconds(
+            score.last_error_at_us_.load(std::memory_order_relaxed))));
+    result.push_back(std::move(info));
+  }
+
+  return result;
+}
+
+void DestinationScoreboard::set_circuit_breaker(unsigned int failures,
+                                                std::chrono::milliseconds open_interval,
+                                                unsigned int half_open_connections) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  circuit_failures_ = failures;
+  circuit_open_interval_ = open_interval;
+  circuit_half_open_connections_ = half_open_connections;
+  for (const auto &entry: *scores_) {
+    entry.second->circuit_breaker_.configure(failures, open_interval, half_open_connections);
+  }
+}
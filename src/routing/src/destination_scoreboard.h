@@ -0,0 +1,185 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_DESTINATION_SCOREBOARD_INCLUDED
+#define ROUTING_DESTINATION_SCOREBOARD_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "circuit_breaker.h"
+#include "mysqlrouter/routing_control.h"
+#include "tcp_address.h"
+
+/**
+ * @brief Health and performance of a destination.
+ *
+ * Updated by the connects and the connections routed to the server with
+ * relaxed atomics, no locks.
+ */
+class DestinationScore {
+public:
+  /** @brief a new connect counts 1/kSmoothing into the smoothed values */
+  static const int kSmoothing = 8;
+
+  /** @brief counts a successful connect and feeds its time into the average latency */
+  void connect_succeeded(std::chrono::microseconds latency) noexcept;
+
+  /** @brief counts a failed connect and remembers its error code */
+  void connect_failed(int error) noexcept;
+
+  /** @brief feeds a connect time into the average latency, without counting a connect */
+  void add_latency(std::chrono::microseconds latency) noexcept;
+
+  /** @brief a client connection got routed to the server */
+  void connection_opened() noexcept {
+    active_connections_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /** @brief a client connection routed to the server got closed or left for another one */
+  void connection_closed() noexcept {
+    active_connections_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /** @brief counts bytes forwarded either way */
+  void forwarded(uint64_t bytes) noexcept {
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /** @brief smoothed connect time, zero until a connect succeeded */
+  std::chrono::microseconds get_latency() const noexcept {
+    return std::chrono::microseconds(latency_us_.load(std::memory_order_relaxed));
+  }
+
+  /** @brief smoothed share of the connects that succeeded, 1 until one was tried */
+  double get_connect_success_rate() const noexcept {
+    return static_cast<double>(success_rate_.load(std::memory_order_relaxed)) / kRateOne;
+  }
+
+  uint64_t get_active_connections() const noexcept {
+    const int64_t active = active_connections_.load(std::memory_order_relaxed);
+    return active > 0 ? static_cast<uint64_t>(active) : 0;
+  }
+
+  /** @brief the server recovered, its share of the new connections starts ramping up */
+  void start_slow_start(std::chrono::steady_clock::time_point now) noexcept {
+    slow_start_at_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief share of its new connections the server gets while it slow-starts.
+   *
+   * @param now current time
+   * @param window time the share takes to ramp up from 0 to 1
+   * @return 0 right after start_slow_start() up to 1 once the window passed
+   */
+  double get_slow_start_share(std::chrono::steady_clock::time_point now,
+                              std::chrono::milliseconds window) const noexcept;
+
+  /** @brief judges the connects and handshakes, configured by the scoreboard */
+  CircuitBreaker &get_circuit_breaker() noexcept { return circuit_breaker_; }
+  const CircuitBreaker &get_circuit_breaker() const noexcept { return circuit_breaker_; }
+
+private:
+  friend class DestinationScoreboard;
+
+  /** @brief fixed point of the success rate */
+  static const uint32_t kRateOne = 1 << 16;
+
+  void add_success(bool succeeded) noexcept;
+
+  std::atomic<uint64_t> connects_succeeded_{0};
+  std::atomic<uint64_t> connects_failed_{0};
+  std::atomic<int64_t> latency_us_{0};
+  std::atomic<uint32_t> success_rate_{kRateOne};
+  std::atomic<int64_t> active_connections_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<int> last_error_{0};
+  /** @brief system_clock microseconds of the last failed connect */
+  std::atomic<int64_t> last_error_at_us_{0};
+  /** @brief steady_clock ticks of start_slow_start(), 0 if never called */
+  std::atomic<std::chrono::steady_clock::rep> slow_start_at_{0};
+  CircuitBreaker circuit_breaker_;
+
+  // rate of the bytes, sampled by DestinationScoreboard::get_scores()
+  uint64_t sampled_bytes_{0};
+  std::chrono::steady_clock::time_point sampled_at_{std::chrono::steady_clock::now()};
+  double bytes_per_second_{0};
+};
+
+/**
+ * @brief Scores of the destinations of a route, by server address.
+ *
+ * Lookups load an immutable map without locking, adding a server copies
+ * it. Servers stay on the scoreboard once they got connected to, those are
+ * not many even if the metadata cache changes them.
+ */
+class DestinationScoreboard {
+public:
+  DestinationScoreboard();
+
+  DestinationScoreboard(const DestinationScoreboard &) = delete;
+  DestinationScoreboard &operator=(const DestinationScoreboard &) = delete;
+
+  /** @brief score of the server, added if it has none yet */
+  std::shared_ptr<DestinationScore> get(const mysql_harness::TCPAddress &addr);
+
+  /** @brief score of the server, nullptr if it has none */
+  std::shared_ptr<const DestinationScore> find(const mysql_harness::TCPAddress &addr) const;
+
+  /** @brief scores of all servers by address, for looking up many */
+  using Scores = std::map<mysql_harness::TCPAddress, std::shared_ptr<DestinationScore>>;
+  std::shared_ptr<const Scores> get_all() const {
+    return std::atomic_load(&scores_);
+  }
+
+  /**
+   * @brief lists the scores of all servers.
+   *
+   * Samples the byte rates if the last listing is a second or more ago.
+   */
+  std::vector<RouteDestinationScore> get_scores();
+
+  /** @brief configures the circuit breakers of all servers, see CircuitBreaker::configure() */
+  void set_circuit_breaker(unsigned int failures, std::chrono::milliseconds open_interval,
+                           unsigned int half_open_connections);
+
+private:
+  std::shared_ptr<const Scores> scores_;
+  /** @brief serializes adding servers and sampling the byte rates */
+  std::mutex mtx_;
+
+  // settings of the circuit breakers of the servers added later
+  unsigned int circuit_failures_{0};
+  std::chrono::milliseconds circuit_open_interval_{0};
+  unsigned int circuit_half_open_connections_{1};
+};
+
+#endif // ROUTING_DESTINATION_SCOREBOARD_INCLUDED
@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "fair_scheduler.h"
+
+#include <algorithm>
+
+FairScheduler::FairScheduler(size_t quantum, uint64_t bytes_per_second)
+    : quantum_(static_cast<int64_t>(quantum)),
+      bytes_per_second_(static_cast<int64_t>(bytes_per_second)),
+      bucket_size_(std::max<int64_t>({bytes_per_second_ / 10, quantum_, 1})),
+      tokens_(bucket_size_) {}
+
+void FairScheduler::begin_round(clock_type::time_point now) noexcept {
+  ++round_;
+  served_ = false;
+  rounds_needed_ = 0;
+  if (bytes_per_second_ > 0) refill(now);
+}
+
+void FairScheduler::refill(clock_type::time_point now) noexcept {
+  if (refilled_at_ == clock_type::time_point()) {
+    refilled_at_ = now;
+    return;
+  }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - refilled_at_).count();
+  const int64_t added = elapsed * bytes_per_second_ / 1000000;
+  // less than a byte isn't added, the time stays until it adds up
+  if (added > 0) {
+    tokens_ = std::min(bucket_size_, tokens_ + added);
+    refilled_at_ = now;
+  }
+}
+
+bool FairScheduler::may_read(Share &share) noexcept {
+  if (quantum_ > 0 && share.round != round_) {
+    // more rounds than it takes to get to a full quantum don't add anything
+    const uint64_t rounds = std::min<uint64_t>(round_ - share.round,
+                                               static_cast<uint64_t>((quantum_ - share.deficit) / quantum_ + 1));
+    share.deficit = std::min(quantum_, share.deficit + static_cast<int64_t>(rounds) * quantum_);
+    share.round = round_;
+  }
+
+  if (quantum_ > 0 && share.deficit <= 0) {
+    const uint64_t needed = static_cast<uint64_t>(-share.deficit / quantum_ + 1);
+    if (rounds_needed_ == 0 || needed < rounds_needed_) rounds_needed_ = needed;
+    return false;
+  }
+
+  return bytes_per_second_ == 0 || tokens_ > 0;
+}
+
+void FairScheduler::charge(Share &share, uint64_t bytes) noexcept {
+  if (bytes == 0) return;
+
+  served_ = true;
+  share.deficit -= static_cast<int64_t>(bytes);
+  if (bytes_per_second_ > 0) tokens_ -= static_cast<int64_t>(bytes);
+}
+
+void FairScheduler::end_round() noexcept {
+  // the next round credits one quantum, the ones nobody is served in are skipped
+  if (!served_ && rounds_needed_ > 1 && get_throttle_delay().count() == 0) {
+    round_ += rounds_needed_ - 1;
+  }
+}
+
+std::chrono::milliseconds FairScheduler::get_throttle_delay() const noexcept {
+  if (bytes_per_second_ == 0 || tokens_ > 0) return std::chrono::milliseconds(0);
+
+  // rounded up to not wake up right before the tokens are there
+  return std::chrono::milliseconds((1 - tokens_) * 1000 / bytes_per_second_ + 1);
+}
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_FAIR_SCHEDULER_INCLUDED
+#define ROUTING_FAIR_SCHEDULER_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief FairScheduler shares the bandwidth of an I/O thread between its
+ *        connections.
+ *
+ * Deficit round-robin: every wait of the I/O thread is a round in which
+ * each connection may read as long as it didn't forward more than its
+ * quantum per round. A connection that forwarded more, like one streaming
+ * a large result set, has its reads deferred for as many rounds as it is
+ * ahead, while the connections sending small requests get served every
+ * round. Credit isn't saved up beyond one quantum, idle connections can't
+ * burst later. Rounds in which only deferred connections are ready are
+ * skipped, a connection alone isn't slowed down.
+ *
+ * Optionally the bytes forwarded per second are limited by a token
+ * bucket, reads of all connections are deferred while it is empty.
+ *
+ * Only used by the I/O thread that owns it.
+ */
+class FairScheduler {
+ public:
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief state of a connection, kept by the I/O thread */
+  struct Share {
+    /** @brief bytes the connection may still forward, negative if it is ahead */
+    int64_t deficit{0};
+    /** @brief round the deficit was last credited in */
+    uint64_t round{0};
+  };
+
+  /**
+   * @param quantum bytes each connection may forward per round, 0 to not share
+   * @param bytes_per_second bytes forwarded per second, 0 for no limit
+   */
+  explicit FairScheduler(size_t quantum = 0, uint64_t bytes_per_second = 0);
+
+  /** @brief true if reads may get deferred */
+  bool is_enabled() const noexcept { return quantum_ > 0 || bytes_per_second_ > 0; }
+
+  /** @brief Starts the round of a wait of the I/O thread. */
+  void begin_round(clock_type::time_point now) noexcept;
+
+  /**
+   * @brief Tells if a connection may read in this round.
+   *
+   * @return false if its reads have to be deferred
+   */
+  bool may_read(Share &share) noexcept;
+
+  /** @brief Accounts the bytes a connection forwarded. */
+  void charge(Share &share, uint64_t bytes) noexcept;
+
+  /** @brief Ends the round, skips the rounds nobody would be served in. */
+  void end_round() noexcept;
+
+  /**
+   * @brief Returns how long reads stay deferred for the bandwidth limit.
+   *
+   * @return 0 if reads may go on
+   */
+  std::chrono::milliseconds get_throttle_delay() const noexcept;
+
+ private:
+  /** @brief adds the bytes per second since the last refill to the bucket */
+  void refill(clock_type::time_point now) noexcept;
+
+  int64_t quantum_;
+  int64_t bytes_per_second_;
+  /** @brief bytes the bucket holds at most, a tenth of a second */
+  int64_t bucket_size_;
+  /** @brief bytes left in the bucket, negative if a read took more */
+  int64_t tokens_;
+  clock_type::time_point refilled_at_{};
+
+  uint64_t round_{1};
+  /** @brief true if a connection forwarded bytes in this round */
+  bool served_{false};
+  /** @brief fewest rounds a deferred connection of this round needs to be credited */
+  uint64_t rounds_needed_{0};
+};
+
+#endif  // ROUTING_FAIR_SCHEDULER_INCLUDED
@@ -0,0 +1,115 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "handshake_router.h"
+
+#include <stdexcept>
+
+#include "destination.h"
+#include "mysqlrouter/utils.h"
+
+HandshakeRouter::HandshakeRouter(const std::string& route_by) {
+  static const std::string kAttributePrefix{"attribute:"};
+
+  if (route_by == "user") {
+    key_ = Key::kUser;
+  } else if (route_by == "schema") {
+    key_ = Key::kSchema;
+  } else if (route_by.compare(0, kAttributePrefix.size(), kAttributePrefix) == 0 &&
+             route_by.size() > kAttributePrefix.size()) {
+    key_ = Key::kAttribute;
+    attribute_ = route_by.substr(kAttributePrefix.size());
+  } else {
+    throw std::invalid_argument("route_by needs to be user, schema or attribute:<name>, was '" +
+                                route_by + "'");
+  }
+}
+
+std::vector<std::pair<std::string, std::string>> HandshakeRouter::parse_route_map(
+    const std::string& route_map, const std::string& option) {
+  std::vector<std::pair<std::string, std::string>> entries;
+
+  for (std::string entry : mysqlrouter::split_string(route_map, ';', false)) {
+    mysqlrouter::trim(entry);
+    if (entry.empty()) continue;
+
+    // destinations may be URIs with '=' in their query, the key can't
+    const size_t eq = entry.find('=');
+    std::string key = eq == std::string::npos ? entry : entry.substr(0, eq);
+    std::string destinations = eq == std::string::npos ? std::string() : entry.substr(eq + 1);
+    mysqlrouter::trim(key);
+    mysqlrouter::trim(destinations);
+    if (key.empty() || destinations.empty()) {
+      throw std::invalid_argument(option + " needs entries like <key>=<destinations>, was '" +
+                                  entry + "'");
+    }
+    entries.emplace_back(std::move(key), std::move(destinations));
+  }
+
+  return entries;
+}
+
+void HandshakeRouter::add_pool(const std::string& key, std::shared_ptr<RouteDestination> pool) {
+  if (!pools_.emplace(key, std::move(pool)).second) {
+    throw std::invalid_argument("route_map has more than one entry for '" + key + "'");
+  }
+}
+
+std::string HandshakeRouter::get_key(const classic_handshake::ClientHandshake& handshake) const {
+  switch (key_) {
+    case Key::kUser:
+      return handshake.username;
+    case Key::kSchema:
+      return handshake.database;
+    case Key::kAttribute: {
+      std::string value;
+      classic_handshake::get_connection_attribute(handshake, attribute_, value);
+      return value;
+    }
+  }
+
+  return std::string();
+}
+
+std::shared_ptr<RouteDestination> HandshakeRouter::get_pool(
+    const classic_handshake::ClientHandshake& handshake) const {
+  auto it = pools_.find(get_key(handshake));
+  if (it == pools_.end()) return nullptr;
+
+  return it->second;
+}
+
+void HandshakeRouter::set_greeting(const RoutingProtocolBuffer& greeting) {
+  std::lock_guard<std::mutex> lock(greeting_mtx_);
+  greeting_ = greeting;
+}
+
+bool HandshakeRouter::get_greeting(RoutingProtocolBuffer& greeting) const {
+  std::lock_guard<std::mutex> lock(greeting_mtx_);
+  if (greeting_.empty()) return false;
+
+  greeting = greeting_;
+  return true;
+}
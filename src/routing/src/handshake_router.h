@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_HANDSHAKE_ROUTER_INCLUDED
+#define ROUTING_HANDSHAKE_ROUTER_INCLUDED
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "protocol/classic_handshake.h"
+
+class RouteDestination;
+
+/**
+ * @brief HandshakeRouter picks the destinations of a client by its handshake.
+ *
+ * One listener serves several pools of destinations: the client gets a
+ * greeting before a server is chosen, and its handshake response decides
+ * about the pool by the username, the schema or a connection attribute.
+ * Clients without a pool of their own go to the destinations of the route.
+ *
+ * The greeting is the one of a server that got connected already, the
+ * clients authenticate against the server of their pool after an auth
+ * switch, as done for pooled server connections.
+ */
+class HandshakeRouter {
+public:
+  /** @brief what of the handshake response the pool is picked by */
+  enum class Key {
+    kUser,
+    kSchema,
+    kAttribute,
+  };
+
+  /**
+   * @param route_by `user`, `schema` or `attribute:<name>`
+   *
+   * @throws std::invalid_argument if route_by is none of them
+   */
+  explicit HandshakeRouter(const std::string& route_by);
+
+  /**
+   * @brief Splits `key=destinations` entries separated by ';'.
+   *
+   * @param route_map entries to split
+   * @param option name of the option in error messages
+   *
+   * @throws std::invalid_argument if an entry has no key or destinations
+   */
+  static std::vector<std::pair<std::string, std::string>> parse_route_map(
+      const std::string& route_map, const std::string& option = "route_map");
+
+  /**
+   * @brief Routes the clients with the given key to a pool.
+   *
+   * Pools have to be added before the route gets started.
+   *
+   * @throws std::invalid_argument if the key got a pool already
+   */
+  void add_pool(const std::string& key, std::shared_ptr<RouteDestination> pool);
+
+  /** @brief Returns the pools by key */
+  const std::map<std::string, std::shared_ptr<RouteDestination>>& get_pools() const noexcept {
+    return pools_;
+  }
+
+  /** @brief Returns the key of the client, empty if it didn't send it */
+  std::string get_key(const classic_handshake::ClientHandshake& handshake) const;
+
+  /** @brief Returns the pool of the client, nullptr for the destinations of the route */
+  std::shared_ptr<RouteDestination> get_pool(const classic_handshake::ClientHandshake& handshake) const;
+
+  /**
+   * @brief Stores greeting sent to the clients before their pool is known.
+   *
+   * @param greeting server greeting with SSL capability cleared
+   */
+  void set_greeting(const RoutingProtocolBuffer& greeting);
+
+  /**
+   * @brief Returns the stored greeting.
+   *
+   * @return false if no server greeting was stored yet
+   */
+  bool get_greeting(RoutingProtocolBuffer& greeting) const;
+
+private:
+  Key key_;
+  /** @brief name of the connection attribute if key_ is kAttribute */
+  std::string attribute_;
+  /** @brief not changed once the route runs, read without lock */
+  std::map<std::string, std::shared_ptr<RouteDestination>> pools_;
+
+  mutable std::mutex greeting_mtx_;
+  RoutingProtocolBuffer greeting_;
+};
+
+#endif  // ROUTING_HANDSHAKE_ROUTER_INCLUDED
@@ -0,0 +1,836 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "io_engine.h"
+
+#include "common.h"
+#include "connection.h"
+#include "fair_scheduler.h"
+#include "io_uring_poller.h"
+#include "mysql/harness/logging/logging.h"
+#include "mysql/harness/loop_monitor.h"
+#include "mysql/harness/ring_queue.h"
+#include "mysql_routing_common.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(__linux__)
+#  define ROUTING_IO_ENGINE_EPOLL
+#  include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#  define ROUTING_IO_ENGINE_KQUEUE
+#  include <sys/types.h>
+#  include <sys/event.h>
+#  include <sys/time.h>
+#endif
+
+#if defined(ROUTING_IO_ENGINE_EPOLL) || defined(ROUTING_IO_ENGINE_KQUEUE)
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <unistd.h>
+#endif
+IMPORT_LOG_FUNCTIONS()
+
+#if defined(ROUTING_IO_ENGINE_EPOLL) || defined(ROUTING_IO_ENGINE_KQUEUE)
+
+/** @brief max number of events fetched from the poller at once */
+static const int kMaxEventsPerWait = 256;
+
+/** @brief connections handed over to an I/O thread before handing over waits for it */
+static const size_t kMaxPendingConnections = 1024;
+
+/**
+ * @brief I/O thread multiplexing the sockets of its connections.
+ *
+ * Connections are handed over through a lock-free queue and get registered
+ * by the I/O thread itself between two waits. That way all
+ * the state of the served connections is only touched by the I/O thread and
+ * events of a closed socket can't be mixed up with a new connection reusing
+ * the same file descriptor.
+ */
+class RoutingIOEngine::IOThread {
+ public:
+  IOThread(const std::string& name, std::chrono::milliseconds client_connect_timeout,
+           size_t buffer_size, size_t max_idle_buffers, bool use_io_uring);
+  ~IOThread();
+
+  /** @brief true if the sockets are watched using io_uring */
+  bool is_using_io_uring() const noexcept {
+    return uring_ != nullptr;
+  }
+
+  RoutingBufferPool::Stats get_buffer_pool_stats() const {
+    return buffer_pool_.get_stats();
+  }
+
+  /** @brief CPUs to pin the thread to when it starts, all if empty */
+  void set_cpu_affinity(const std::vector<unsigned>& cpus) {
+    cpu_affinity_ = cpus;
+  }
+
+  /** @brief shares the bandwidth between the connections, before the thread starts */
+  void set_fair_share(size_t quantum, uint64_t bytes_per_second) {
+    scheduler_ = FairScheduler(quantum, bytes_per_second);
+  }
+
+  /** @brief takes the buffers from an arena of this thread, before the thread starts */
+  void set_buffer_huge_pages(BufferArena::HugePages huge_pages) {
+    buffer_arena_ = std::make_shared<BufferArena>(huge_pages);
+    buffer_pool_.set_arena(buffer_arena_);
+  }
+
+  BufferArena::Stats get_buffer_arena_stats() const {
+    return buffer_arena_ ? buffer_arena_->get_stats() : BufferArena::Stats();
+  }
+
+  void start(size_t thread_stack_size);
+  void stop();
+  void add_connection(MySQLRoutingConnection* connection);
+
+  /** @brief interrupts the wait of the I/O thread */
+  void wakeup() noexcept;
+
+  /** @brief runs the task in the I/O thread once it gets to it, callable from any thread */
+  void post(mysql_harness::LoopMonitor::Task task);
+
+ private:
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief events a socket is watched for */
+  enum Events : unsigned {
+    kReadEvent = 1,
+    kWriteEvent = 2,
+  };
+
+  /** @brief socket reported by poller_wait() */
+  using ReadyFd = IoUringPoller::ReadyFd;
+
+  static void* run_thread(void* context);
+  void run();
+
+  void register_pending_connections();
+  void run_posted_tasks();
+  void close_disconnected_connections();
+  void close_timed_out_handshakes();
+  void close_connection(MySQLRoutingConnection* connection);
+  void close_all_connections();
+  int get_wait_timeout_ms() const;
+
+  /** @brief waits for a wakeup while the bandwidth limit defers the reads */
+  void wait_for_bandwidth();
+
+  /** @brief watches the sockets of the connection for the events it wants */
+  void update_events(MySQLRoutingConnection* connection);
+
+  void poller_add(int fd);
+  void poller_modify(int fd, unsigned old_events, unsigned new_events);
+  void poller_remove(int fd);
+  int poller_wait(std::vector<ReadyFd>& ready_fds, int timeout_ms);
+
+  const std::string name_;
+  const std::chrono::milliseconds client_connect_timeout_;
+
+  /** @brief buffers shared by the connections served by this thread
+   *
+   * They get allocated by this thread once it is pinned, on the NUMA node
+   * of its CPU.
+   */
+  RoutingBufferPool buffer_pool_;
+  /** @brief arena of buffer_pool_, nullptr if its buffers come from the heap */
+  std::shared_ptr<BufferArena> buffer_arena_;
+
+  std::vector<unsigned> cpu_affinity_;
+
+  int poll_fd_{-1};
+  /** @brief used instead of poll_fd_ if set */
+  std::unique_ptr<IoUringPoller> uring_;
+  int wakeup_fds_[2]{-1, -1};
+
+  mysql_harness::mpmc_queue<MySQLRoutingConnection*> pending_connections_{kMaxPendingConnections};
+
+  std::mutex posted_tasks_mtx_;
+  std::vector<mysql_harness::LoopMonitor::Task> posted_tasks_;
+
+  /** @brief client and server sockets of served connections */
+  std::unordered_map<int, MySQLRoutingConnection*> sockets_;
+  /** @brief events the sockets of served connections are watched for */
+  std::unordered_map<int, unsigned> socket_events_;
+  std::unordered_set<MySQLRoutingConnection*> connections_;
+  /** @brief deadlines of the connections waiting for handshake to complete */
+  std::unordered_map<MySQLRoutingConnection*, clock_type::time_point> handshake_deadlines_;
+
+  /** @brief decides which connections may read in a round */
+  FairScheduler scheduler_;
+  /** @brief state of the connections in scheduler_, if it is enabled */
+  std::unordered_map<MySQLRoutingConnection*, FairScheduler::Share> shares_;
+
+  std::atomic<bool> stop_{false};
+  std::unique_ptr<mysql_harness::MySQLRouterThread> thread_;
+};
+
+RoutingIOEngine::IOThread::IOThread(const std::string& name,
+                                    std::chrono::milliseconds client_connect_timeout,
+                                    size_t buffer_size, size_t max_idle_buffers,
+                                    bool use_io_uring)
+    : name_(name), client_connect_timeout_(client_connect_timeout),
+      buffer_pool_(buffer_size, max_idle_buffers) {
+#if defined(ROUTING_IO_ENGINE_EPOLL)
+  // falls back to epoll if the kernel doesn't support io_uring
+  if (use_io_uring) {
+    uring_ = IoUringPoller::create();
+  }
+  if (!uring_) {
+    poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  }
+#else
+  (void)use_io_uring;
+  poll_fd_ = kqueue();
+#endif
+  if (!uring_ && poll_fd_ == -1) {
+    throw std::runtime_error("Failed to create poller: " + get_message_error(errno));
+  }
+
+  if (pipe(wakeup_fds_) == -1) {
+    const int last_errno = errno;
+    if (poll_fd_ != -1) ::close(poll_fd_);
+    throw std::runtime_error("Failed to create wakeup pipe: " + get_message_error(last_errno));
+  }
+
+  for (int fd: wakeup_fds_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  poller_add(wakeup_fds_[0]);
+}
+
+RoutingIOEngine::IOThread::~IOThread() {
+  stop();
+
+  ::close(wakeup_fds_[0]);
+  ::close(wakeup_fds_[1]);
+  if (poll_fd_ != -1) ::close(poll_fd_);
+}
+
+void RoutingIOEngine::IOThread::start(size_t thread_stack_size) {
+  // both lines can throw std::runtime_error
+  thread_.reset(new mysql_harness::MySQLRouterThread(thread_stack_size));
+  thread_->run(&run_thread, this);
+}
+
+void RoutingIOEngine::IOThread::stop() {
+  if (!thread_) return;
+
+  stop_ = true;
+  wakeup();
+  thread_->join();
+  thread_.reset();
+}
+
+void RoutingIOEngine::IOThread::add_connection(MySQLRoutingConnection* connection) {
+  connection->set_disconnect_notify([this]() { wakeup(); });
+
+  // waits if the I/O thread is that far behind, the wakeups sent with the
+  // connections ahead make it catch up
+  pending_connections_.push(connection);
+  wakeup();
+}
+
+void RoutingIOEngine::IOThread::wakeup() noexcept {
+  const char c = 0;
+  // a full pipe means the I/O thread has a wakeup pending already
+  ssize_t res;
+  do {
+    res = ::write(wakeup_fds_[1], &c, 1);
+  } while (res == -1 && errno == EINTR);
+}
+
+void RoutingIOEngine::IOThread::post(mysql_harness::LoopMonitor::Task task) {
+  {
+    std::lock_guard<std::mutex> lock(posted_tasks_mtx_);
+    posted_tasks_.push_back(std::move(task));
+  }
+  wakeup();
+}
+
+void RoutingIOEngine::IOThread::run_posted_tasks() {
+  std::vector<mysql_harness::LoopMonitor::Task> tasks;
+  {
+    std::lock_guard<std::mutex> lock(posted_tasks_mtx_);
+    tasks.swap(posted_tasks_);
+  }
+  for (auto& task: tasks) task();
+}
+
+void* RoutingIOEngine::IOThread::run_thread(void* context) {
+  static_cast<IOThread*>(context)->run();
+  return nullptr;
+}
+
+void RoutingIOEngine::IOThread::run() {
+  mysql_harness::rename_thread(get_routing_thread_name(name_, "RtI").c_str());  // "Rt I/O" would be too long :(
+  if (!cpu_affinity_.empty() && !mysql_harness::set_current_thread_cpu_affinity(cpu_affinity_)) {
+    log_warning("[%s] failed to pin I/O thread to CPU %u", name_.c_str(), cpu_affinity_.front());
+  }
+
+  // heartbeats of the stall watchdog wait behind the batch being forwarded
+  auto& loop_monitor = mysql_harness::LoopMonitor::instance();
+  const auto loop_id = loop_monitor.add(name_ + " I/O thread",
+      [this](mysql_harness::LoopMonitor::Task task) { post(std::move(task)); });
+
+  std::vector<ReadyFd> ready_fds;
+  ready_fds.reserve(kMaxEventsPerWait);
+
+  while (!stop_) {
+    if (scheduler_.is_enabled()) wait_for_bandwidth();
+
+    int res = poller_wait(ready_fds, get_wait_timeout_ms());
+    if (res < 0) {
+      const int last_errno = errno;
+      if (last_errno == EINTR) continue;
+
+      log_error("[%s] waiting for I/O events failed: %s", name_.c_str(),
+                get_message_error(last_errno).c_str());
+      break;
+    }
+
+    const bool scheduled = scheduler_.is_enabled();
+    if (scheduled) scheduler_.begin_round(clock_type::now());
+
+    bool woken_up = false;
+    for (const ReadyFd& ready: ready_fds) {
+      const int fd = ready.fd;
+      if (fd == wakeup_fds_[0]) {
+        char buf[256];
+        while (::read(wakeup_fds_[0], buf, sizeof(buf)) > 0) {}
+        woken_up = true;
+        continue;
+      }
+
+      // socket of a connection closed earlier in this batch
+      auto it = sockets_.find(fd);
+      if (it == sockets_.end()) continue;
+
+      MySQLRoutingConnection* connection = it->second;
+      const bool is_client = (fd == connection->get_client_socket());
+
+      // the handshake and the priority lane don't wait for their turn,
+      // writes never do
+      FairScheduler::Share* share = scheduled ? &shares_[connection] : nullptr;
+      const bool readable = ready.readable &&
+                            (share == nullptr || !connection->is_handshake_done() ||
+                             connection->is_priority() || scheduler_.may_read(*share));
+      if (!readable && !ready.writable) continue;
+
+      const uint64_t bytes_forwarded = connection->get_bytes_forwarded();
+      if (!connection->forward(is_client && readable, !is_client && readable,
+                               is_client && ready.writable, !is_client && ready.writable) ||
+          connection->is_disconnected() || connection->is_drained()) {
+        close_connection(connection);
+        continue;
+      }
+      if (share) scheduler_.charge(*share, connection->get_bytes_forwarded() - bytes_forwarded);
+
+      if (connection->is_handshake_done()) {
+        handshake_deadlines_.erase(connection);
+      } else {
+        handshake_deadlines_[connection] = clock_type::now() + client_connect_timeout_;
+      }
+      update_events(connection);
+    }
+
+    if (scheduled) scheduler_.end_round();
+
+    close_timed_out_handshakes();
+
+    if (woken_up) {
+      close_disconnected_connections();
+      // registered only after the whole batch is processed as a new connection
+      // may reuse file descriptor of a connection closed in this batch
+      register_pending_connections();
+      run_posted_tasks();
+    }
+  }
+
+  loop_monitor.remove(loop_id);
+  close_all_connections();
+}
+
+void RoutingIOEngine::IOThread::register_pending_connections() {
+  MySQLRoutingConnection* connection;
+  while (pending_connections_.try_pop(&connection)) {
+    if (!connection->open()) {
+      connection->complete();
+      continue;
+    }
+
+    connection->set_buffer_pool(&buffer_pool_);
+    connections_.insert(connection);
+    sockets_[connection->get_client_socket()] = connection;
+    sockets_[connection->get_server_socket()] = connection;
+    handshake_deadlines_[connection] = clock_type::now() + client_connect_timeout_;
+
+    poller_add(connection->get_client_socket());
+    poller_add(connection->get_server_socket());
+    socket_events_[connection->get_client_socket()] = kReadEvent;
+    socket_events_[connection->get_server_socket()] = kReadEvent;
+
+    // disconnect() may have been called before the connection got registered
+    if (connection->is_disconnected()) {
+      close_connection(connection);
+    }
+  }
+}
+
+void RoutingIOEngine::IOThread::close_disconnected_connections() {
+  std::vector<MySQLRoutingConnection*> disconnected;
+  for (MySQLRoutingConnection* connection: connections_) {
+    if (connection->is_disconnected() || connection->is_drained()) disconnected.push_back(connection);
+  }
+
+  for (MySQLRoutingConnection* connection: disconnected) {
+    close_connection(connection);
+  }
+}
+
+void RoutingIOEngine::IOThread::close_timed_out_handshakes() {
+  const auto now = clock_type::now();
+
+  std::vector<MySQLRoutingConnection*> timed_out;
+  for (const auto& deadline: handshake_deadlines_) {
+    if (deadline.second <= now) timed_out.push_back(deadline.first);
+  }
+
+  for (MySQLRoutingConnection* connection: timed_out) {
+    connection->handshake_timed_out();
+    close_connection(connection);
+  }
+}
+
+void RoutingIOEngine::IOThread::close_connection(MySQLRoutingConnection* connection) {
+  poller_remove(connection->get_client_socket());
+  poller_remove(connection->get_server_socket());
+
+  sockets_.erase(connection->get_client_socket());
+  sockets_.erase(connection->get_server_socket());
+  socket_events_.erase(connection->get_client_socket());
+  socket_events_.erase(connection->get_server_socket());
+  handshake_deadlines_.erase(connection);
+  shares_.erase(connection);
+  connections_.erase(connection);
+
+  connection->close();
+  connection->complete();
+}
+
+void RoutingIOEngine::IOThread::close_all_connections() {
+  std::vector<MySQLRoutingConnection*> connections(connections_.begin(), connections_.end());
+  for (MySQLRoutingConnection* connection: connections) {
+    close_connection(connection);
+  }
+
+  MySQLRoutingConnection* connection;
+  while (pending_connections_.try_pop(&connection)) {
+    if (connection->open()) connection->close();
+    connection->complete();
+  }
+}
+
+int RoutingIOEngine::IOThread::get_wait_timeout_ms() const {
+  if (handshake_deadlines_.empty()) return -1;
+
+  auto nearest = handshake_deadlines_.begin()->second;
+  for (const auto& deadline: handshake_deadlines_) {
+    if (deadline.second < nearest) nearest = deadline.second;
+  }
+
+  const auto now = clock_type::now();
+  if (nearest <= now) return 0;
+
+  // round up to not wake up right before the deadline
+  auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nearest - now) +
+                 std::chrono::milliseconds(1);
+  return static_cast<int>(timeout.count());
+}
+
+void RoutingIOEngine::IOThread::wait_for_bandwidth() {
+  int timeout_ms = static_cast<int>(scheduler_.get_throttle_delay().count());
+  if (timeout_ms == 0) return;
+
+  const int handshake_timeout_ms = get_wait_timeout_ms();
+  if (handshake_timeout_ms >= 0) timeout_ms = std::min(timeout_ms, handshake_timeout_ms);
+
+  // the sockets stay ready, only a wakeup ends the wait early; it is left
+  // in the pipe for poller_wait() to report
+  struct pollfd wakeup_fd{};
+  wakeup_fd.fd = wakeup_fds_[0];
+  wakeup_fd.events = POLLIN;
+  while (::poll(&wakeup_fd, 1, timeout_ms) == -1 && errno == EINTR) {
+  }
+}
+
+void RoutingIOEngine::IOThread::update_events(MySQLRoutingConnection* connection) {
+  for (int fd: {connection->get_client_socket(), connection->get_server_socket()}) {
+    const unsigned events = (connection->wants_to_read(fd) ? kReadEvent : 0u) |
+                            (connection->wants_to_write(fd) ? kWriteEvent : 0u);
+    unsigned& watched = socket_events_[fd];
+    if (events != watched) {
+      poller_modify(fd, watched, events);
+      watched = events;
+    }
+  }
+}
+
+#if defined(ROUTING_IO_ENGINE_EPOLL)
+
+void RoutingIOEngine::IOThread::poller_add(int fd) {
+  if (uring_) {
+    uring_->add(fd, IoUringPoller::kReadEvent);
+    return;
+  }
+
+  struct epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(poll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    log_error("[%s] fd=%d adding to epoll failed: %s", name_.c_str(), fd,
+              get_message_error(errno).c_str());
+  }
+}
+
+void RoutingIOEngine::IOThread::poller_modify(int fd, unsigned /*old_events*/, unsigned new_events) {
+  if (uring_) {
+    uring_->modify(fd, ((new_events & kReadEvent) ? IoUringPoller::kReadEvent : 0u) |
+                       ((new_events & kWriteEvent) ? IoUringPoller::kWriteEvent : 0u));
+    return;
+  }
+
+  struct epoll_event ev{};
+  ev.events = ((new_events & kReadEvent) ? EPOLLIN : 0u) |
+              ((new_events & kWriteEvent) ? EPOLLOUT : 0u);
+  ev.data.fd = fd;
+  if (epoll_ctl(poll_fd_, EPOLL_CTL_MOD, fd, &ev) == -1) {
+    log_error("[%s] fd=%d modifying epoll events failed: %s", name_.c_str(), fd,
+              get_message_error(errno).c_str());
+  }
+}
+
+void RoutingIOEngine::IOThread::poller_remove(int fd) {
+  if (uring_) {
+    uring_->remove(fd);
+    return;
+  }
+
+  struct epoll_event ev{};
+  epoll_ctl(poll_fd_, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int RoutingIOEngine::IOThread::poller_wait(std::vector<ReadyFd>& ready_fds, int timeout_ms) {
+  if (uring_) {
+    return uring_->wait(ready_fds, timeout_ms);
+  }
+
+  struct epoll_event events[kMaxEventsPerWait];
+
+  ready_fds.clear();
+  int res = epoll_wait(poll_fd_, events, kMaxEventsPerWait, timeout_ms);
+  for (int i = 0; i < res; ++i) {
+    // EPOLLHUP and EPOLLERR are reported as readable, read() will tell
+    const uint32_t ev = events[i].events;
+    ready_fds.push_back({events[i].data.fd,
+                         (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0,
+                         (ev & EPOLLOUT) != 0});
+  }
+
+  return res;
+}
+
+#else  // ROUTING_IO_ENGINE_KQUEUE
+
+void RoutingIOEngine::IOThread::poller_add(int fd) {
+  struct kevent ev;
+  EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+  if (kevent(poll_fd_, &ev, 1, nullptr, 0, nullptr) == -1) {
+    log_error("[%s] fd=%d adding to kqueue failed: %s", name_.c_str(), fd,
+              get_message_error(errno).c_str());
+  }
+}
+
+void RoutingIOEngine::IOThread::poller_modify(int fd, unsigned old_events, unsigned new_events) {
+  struct kevent evs[2];
+  int n = 0;
+  if ((old_events ^ new_events) & kReadEvent) {
+    EV_SET(&evs[n++], fd, EVFILT_READ, (new_events & kReadEvent) ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+  }
+  if ((old_events ^ new_events) & kWriteEvent) {
+    EV_SET(&evs[n++], fd, EVFILT_WRITE, (new_events & kWriteEvent) ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+  }
+  if (n > 0 && kevent(poll_fd_, evs, n, nullptr, 0, nullptr) == -1) {
+    log_error("[%s] fd=%d modifying kqueue events failed: %s", name_.c_str(), fd,
+              get_message_error(errno).c_str());
+  }
+}
+
+void RoutingIOEngine::IOThread::poller_remove(int fd) {
+  struct kevent ev;
+  // the filters not added fail with ENOENT
+  EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+  kevent(poll_fd_, &ev, 1, nullptr, 0, nullptr);
+  EV_SET(&ev, fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+  kevent(poll_fd_, &ev, 1, nullptr, 0, nullptr);
+}
+
+int RoutingIOEngine::IOThread::poller_wait(std::vector<ReadyFd>& ready_fds, int timeout_ms) {
+  struct kevent events[kMaxEventsPerWait];
+  struct timespec ts;
+  if (timeout_ms >= 0) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+  }
+
+  ready_fds.clear();
+  int res = kevent(poll_fd_, nullptr, 0, events, kMaxEventsPerWait,
+                   timeout_ms >= 0 ? &ts : nullptr);
+  for (int i = 0; i < res; ++i) {
+    // EV_EOF is reported as readable, read() will tell
+    const bool writable = events[i].filter == EVFILT_WRITE;
+    ready_fds.push_back({static_cast<int>(events[i].ident),
+                         !writable || (events[i].flags & EV_EOF) != 0, writable});
+  }
+
+  return res;
+}
+
+#endif
+
+#else  // no event engine on this platform
+
+class RoutingIOEngine::IOThread {
+ public:
+  void start(size_t) {}
+  void stop() {}
+  void add_connection(MySQLRoutingConnection*) {}
+  RoutingBufferPool::Stats get_buffer_pool_stats() const {
+    return RoutingBufferPool::Stats();
+  }
+  void set_buffer_huge_pages(BufferArena::HugePages) {}
+  BufferArena::Stats get_buffer_arena_stats() const {
+    return BufferArena::Stats();
+  }
+};
+
+#endif
+
+RoutingIOEngine::RoutingIOEngine(const std::string& name, size_t io_threads,
+                                 std::chrono::milliseconds client_connect_timeout,
+                                 size_t thread_stack_size,
+                                 size_t buffer_size, size_t max_idle_buffers,
+                                 bool use_io_uring)
+    : thread_stack_size_(thread_stack_size), name_(name) {
+#if defined(ROUTING_IO_ENGINE_EPOLL) || defined(ROUTING_IO_ENGINE_KQUEUE)
+  if (io_threads == 0) {
+    throw std::invalid_argument("number of I/O threads must be greater than 0");
+  }
+
+  for (size_t i = 0; i < io_threads; ++i) {
+    io_threads_.emplace_back(new IOThread(name, client_connect_timeout,
+                                          buffer_size, max_idle_buffers,
+                                          use_io_uring));
+  }
+#else
+  (void)name;
+  (void)io_threads;
+  (void)client_connect_timeout;
+  (void)buffer_size;
+  (void)max_idle_buffers;
+  (void)use_io_uring;
+  throw std::runtime_error("event I/O engine is not supported on this platform");
+#endif
+}
+
+bool RoutingIOEngine::is_using_io_uring() const noexcept {
+#if defined(ROUTING_IO_ENGINE_EPOLL) || defined(ROUTING_IO_ENGINE_KQUEUE)
+  // all threads use the same poller, they got set up the same way
+  return !io_threads_.empty() && io_threads_[0]->is_using_io_uring();
+#else
+  return false;
+#endif
+}
+
+RoutingBufferPool::Stats RoutingIOEngine::get_buffer_pool_stats() const {
+  RoutingBufferPool::Stats stats;
+  for (const auto& io_thread: io_threads_) {
+    stats += io_thread->get_buffer_pool_stats();
+  }
+  return stats;
+}
+
+void RoutingIOEngine::set_fair_share(size_t quantum, uint64_t bytes_per_second) {
+  // each thread gets its part of the limit, the connections are spread evenly
+  const uint64_t per_thread = bytes_per_second == 0 ? 0
+      : std::max<uint64_t>(bytes_per_second / io_threads_.size(), 1);
+  for (auto& io_thread: io_threads_) {
+    io_thread->set_fair_share(quantum, per_thread);
+  }
+}
+
+void RoutingIOEngine::set_buffer_huge_pages(BufferArena::HugePages huge_pages) {
+  // an arena per thread, its slabs get allocated on the NUMA node of the thread
+  for (auto& io_thread: io_threads_) {
+    io_thread->set_buffer_huge_pages(huge_pages);
+  }
+}
+
+BufferArena::Stats RoutingIOEngine::get_buffer_arena_stats() const {
+  BufferArena::Stats stats;
+  for (const auto& io_thread: io_threads_) {
+    stats += io_thread->get_buffer_arena_stats();
+  }
+  return stats;
+}
+
+void RoutingIOEngine::set_cpu_affinity(const std::vector<unsigned>& cpus) {
+  cpu_affinity_ = cpus;
+  for (size_t i = 0; i < io_threads_.size(); ++i) {
+    if (cpus.empty()) {
+      io_threads_[i]->set_cpu_affinity({});
+    } else {
+      io_threads_[i]->set_cpu_affinity({cpus[i % cpus.size()]});
+    }
+  }
+}
+
+RoutingIOEngine::~RoutingIOEngine() {
+  stop();
+}
+
+void RoutingIOEngine::start() {
+  // threads started before a failure are stopped by stop()
+  started_ = true;
+  connect_threads_stop_ = false;
+  for (auto& io_thread: io_threads_) {
+    io_thread->start(thread_stack_size_);
+  }
+
+  for (size_t i = 0; i < io_threads_.size() * kConnectThreadsPerIOThread; ++i) {
+    // both lines can throw std::runtime_error
+    connect_threads_.emplace_back(new mysql_harness::MySQLRouterThread(thread_stack_size_));
+    connect_threads_.back()->run(&run_connect_thread, this);
+  }
+}
+
+void RoutingIOEngine::stop() {
+  if (!started_) return;
+
+  {
+    std::lock_guard<std::mutex> lock(connect_queue_mtx_);
+    connect_threads_stop_ = true;
+  }
+  connect_queue_cond_.notify_all();
+  for (auto& connect_thread: connect_threads_) {
+    connect_thread->join();
+  }
+  connect_threads_.clear();
+
+  // not connected connections are closed and released by the I/O threads
+  for (MySQLRoutingConnection* connection: connect_queue_) {
+    dispatch(connection);
+  }
+  connect_queue_.clear();
+
+  for (auto& io_thread: io_threads_) {
+    io_thread->stop();
+  }
+  started_ = false;
+}
+
+void RoutingIOEngine::add_connection(MySQLRoutingConnection* connection) {
+  if (!connection->needs_server_connect()) {
+    dispatch(connection);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(connect_queue_mtx_);
+    // the priority lane doesn't wait behind a backlog of slow connects
+    if (connection->is_priority()) {
+      connect_queue_.push_front(connection);
+    } else {
+      connect_queue_.push_back(connection);
+    }
+  }
+  connect_queue_cond_.notify_one();
+}
+
+void RoutingIOEngine::dispatch(MySQLRoutingConnection* connection) {
+  const size_t ndx = next_io_thread_++ % io_threads_.size();
+  io_threads_[ndx]->add_connection(connection);
+}
+
+void* RoutingIOEngine::run_connect_thread(void* context) {
+  static_cast<RoutingIOEngine*>(context)->run_connect_thread();
+  return nullptr;
+}
+
+void RoutingIOEngine::run_connect_thread() {
+  mysql_harness::rename_thread(get_routing_thread_name(name_, "RtX").c_str());  // "Rt connect" would be too long :(
+  if (!cpu_affinity_.empty()) mysql_harness::set_current_thread_cpu_affinity(cpu_affinity_);
+
+  while (true) {
+    MySQLRoutingConnection* connection;
+    {
+      std::unique_lock<std::mutex> lock(connect_queue_mtx_);
+      connect_queue_cond_.wait(lock, [this] {
+        return connect_threads_stop_ || !connect_queue_.empty();
+      });
+      if (connect_threads_stop_) return;
+
+      connection = connect_queue_.front();
+      connect_queue_.pop_front();
+    }
+
+    connection->connect_server();
+    dispatch(connection);
+  }
+}
+
+/*static*/
+bool RoutingIOEngine::is_supported() noexcept {
+#if defined(ROUTING_IO_ENGINE_EPOLL) || defined(ROUTING_IO_ENGINE_KQUEUE)
+  return true;
+#else
+  return false;
+#endif
+}
+
+/*static*/
+bool RoutingIOEngine::is_io_uring_supported() noexcept {
+  return IoUringPoller::is_supported();
+}
@@ -0,0 +1,216 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_IO_ENGINE_INCLUDED
+#define ROUTING_IO_ENGINE_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "mysql_router_thread.h"
+#include "mysqlrouter/routing.h"
+
+class MySQLRoutingConnection;
+
+/**
+ * @brief RoutingIOEngine serves the connections of a route using a fixed
+ *        number of I/O threads.
+ *
+ * Each I/O thread multiplexes the sockets of many connections using epoll
+ * or io_uring (Linux) or kqueue (BSD, macOS) and forwards the traffic with
+ * MySQLRoutingConnection::forward(), the same way the thread per connection
+ * mode does. New connections are assigned to the I/O threads in a
+ * round-robin way.
+ */
+class RoutingIOEngine {
+ public:
+  /** @brief number of connect threads started per I/O thread */
+  static const size_t kConnectThreadsPerIOThread = 4;
+
+  /**
+   * @brief Creates the I/O threads, without starting them.
+   *
+   * @param name name of the route, used for thread names and logging
+   * @param io_threads number of I/O threads, must be > 0
+   * @param client_connect_timeout timeout waiting for handshake response
+   * @param thread_stack_size memory in kilobytes allocated for thread's stack
+   * @param buffer_size size of the buffers used to forward the traffic
+   * @param max_idle_buffers number of idle buffers kept by each I/O thread
+   * @param use_io_uring watch the sockets using io_uring instead of epoll,
+   *        falls back to epoll if the kernel doesn't support it
+   *
+   * @throw std::runtime_error if the platform is not supported or the
+   *        pollers could not be created
+   */
+  RoutingIOEngine(const std::string& name, size_t io_threads,
+                  std::chrono::milliseconds client_connect_timeout,
+                  size_t thread_stack_size = mysql_harness::kDefaultStackSizeInKiloBytes,
+                  size_t buffer_size = routing::kDefaultNetBufferLength,
+                  size_t max_idle_buffers = routing::kDefaultBufferPoolSize,
+                  bool use_io_uring = false);
+
+  /**
+   * @brief Stops the I/O threads if they are still running.
+   */
+  ~RoutingIOEngine();
+
+  /**
+   * @brief Pins the threads to CPUs, before start() is called.
+   *
+   * I/O threads get one of the CPUs each, round-robin, the connect threads
+   * may run on all of them.
+   *
+   * @param cpus CPUs to run on, empty to not pin the threads
+   */
+  void set_cpu_affinity(const std::vector<unsigned>& cpus);
+
+  /**
+   * @brief Shares the bandwidth of the I/O threads between the connections.
+   *
+   * See FairScheduler. Each I/O thread gets an equal part of the bytes per
+   * second. Has to be called before start().
+   *
+   * @param quantum bytes a connection may forward per round, 0 to not share
+   * @param bytes_per_second bytes the I/O threads forward per second together, 0 for no limit
+   */
+  void set_fair_share(size_t quantum, uint64_t bytes_per_second);
+
+  /**
+   * @brief Takes the buffers of each I/O thread from a BufferArena of its
+   *        own, backed by huge pages.
+   *
+   * Has to be called before start().
+   *
+   * @param huge_pages pages backing the arenas
+   */
+  void set_buffer_huge_pages(BufferArena::HugePages huge_pages);
+
+  /**
+   * @brief Starts the I/O threads.
+   *
+   * @throw std::runtime_error if a thread could not be spawned
+   */
+  void start();
+
+  /**
+   * @brief Stops the I/O threads and closes the connections still served.
+   */
+  void stop();
+
+  /**
+   * @brief Hands the connection over to one of the I/O threads.
+   *
+   * If the connection still needs to connect to the server it is queued
+   * for the connect threads first, connections of the priority lane ahead
+   * of the others.
+   *
+   * Connection is released with MySQLRoutingConnection::complete() once it
+   * gets closed.
+   *
+   * @param connection connection to serve
+   */
+  void add_connection(MySQLRoutingConnection* connection);
+
+  /**
+   * @brief Returns number of I/O threads.
+   */
+  size_t get_io_threads() const noexcept {
+    return io_threads_.size();
+  }
+
+  /**
+   * @brief Returns true if the I/O threads watch the sockets using io_uring.
+   */
+  bool is_using_io_uring() const noexcept;
+
+  /**
+   * @brief Returns buffer pool statistics summed over the I/O threads.
+   */
+  RoutingBufferPool::Stats get_buffer_pool_stats() const;
+
+  /**
+   * @brief Returns buffer arena statistics summed over the I/O threads.
+   */
+  BufferArena::Stats get_buffer_arena_stats() const;
+
+  /**
+   * @brief Returns true if the event engine is available on this platform.
+   *
+   * That is Linux (io_uring or epoll) and the BSDs and macOS (kqueue).
+   * There is no I/O completion port backend, on Windows io_engine=event
+   * is rejected and connections keep a thread each.
+   */
+  static bool is_supported() noexcept;
+
+  /**
+   * @brief Returns true if the kernel supports watching sockets using io_uring.
+   */
+  static bool is_io_uring_supported() noexcept;
+
+ private:
+  class IOThread;
+
+  static void* run_connect_thread(void* context);
+  void run_connect_thread();
+
+  /** @brief hands the connection over to the next I/O thread */
+  void dispatch(MySQLRoutingConnection* connection);
+
+  /** @brief I/O threads serving the connections */
+  std::vector<std::unique_ptr<IOThread>> io_threads_;
+
+  /** @brief I/O thread getting next new connection */
+  std::atomic<size_t> next_io_thread_{0};
+
+  /** @brief memory in kilobytes allocated for I/O thread's stack */
+  size_t thread_stack_size_;
+
+  /** @brief true if I/O threads are running */
+  bool started_{false};
+
+  /** @brief name of the route */
+  const std::string name_;
+
+  /** @brief CPUs the connect threads are pinned to, empty if not pinned */
+  std::vector<unsigned> cpu_affinity_;
+
+  /** @brief threads connecting to the servers */
+  std::vector<std::unique_ptr<mysql_harness::MySQLRouterThread>> connect_threads_;
+  std::mutex connect_queue_mtx_;
+  std::condition_variable connect_queue_cond_;
+  /** @brief connections waiting to connect to the server */
+  std::deque<MySQLRoutingConnection*> connect_queue_;
+  /** @brief true if connect threads have to exit */
+  bool connect_threads_stop_{false};
+};
+
+#endif /* ROUTING_IO_ENGINE_INCLUDED */
@@ -0,0 +1,341 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "io_uring_poller.h"
+
+#include <cerrno>
+
+#include "router_config.h"
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/** @brief user_data of the completions not reporting a socket */
+const uint64_t kIgnoreUserData = ~0ULL;
+
+uint64_t make_user_data(int fd, uint32_t generation) noexcept {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | generation;
+}
+
+int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) noexcept {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags, const void* arg, size_t arg_size) noexcept {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, arg, arg_size));
+}
+
+}  // namespace
+
+/**
+ * @brief submission and completion queues shared with the kernel
+ */
+struct IoUringPoller::Ring {
+  ~Ring() {
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+    if (rings != MAP_FAILED) munmap(rings, rings_size);
+    if (fd != -1) ::close(fd);
+  }
+
+  /**
+   * @brief Sets up the ring.
+   *
+   * @return false if the kernel doesn't support the features needed
+   */
+  bool setup(unsigned entries) noexcept {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    fd = sys_io_uring_setup(entries, &params);
+    if (fd == -1) return false;
+
+    // one mapping for both rings, completions never get dropped and
+    // waits take a timeout (Linux 5.11)
+    const unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & needed) != needed) return false;
+
+    const size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    rings_size = sq_size > cq_size ? sq_size : cq_size;
+    rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) return false;
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+
+    char* base = static_cast<char*>(rings);
+    sq_head = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    cq_head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // entry i always takes slot i, the array never changes
+    unsigned* array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries; ++i) {
+      array[i] = i;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Returns the next free submission entry, cleared.
+   *
+   * Submits the queued entries first if the queue is full.
+   */
+  struct io_uring_sqe* get_sqe() noexcept {
+    while (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+      if (submit(0, nullptr) == -1 && errno != EINTR && errno != EBUSY) {
+        return nullptr;
+      }
+    }
+
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes) + (sq_local_tail & sq_mask);
+    memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail;
+    return sqe;
+  }
+
+  /**
+   * @brief Submits the queued entries and waits for a completion if asked to.
+   *
+   * @param min_complete completions to wait for
+   * @param arg timeout of the wait, nullptr to wait without timeout
+   */
+  int submit(unsigned min_complete, const struct io_uring_getevents_arg* arg) noexcept {
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    // the kernel moves the head over the entries it consumed
+    const unsigned to_submit = sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0u;
+    if (arg != nullptr) flags |= IORING_ENTER_EXT_ARG;
+    return sys_io_uring_enter(fd, to_submit, min_complete, flags, arg,
+                              arg != nullptr ? sizeof(*arg) : 0);
+  }
+
+  int fd{-1};
+  void* rings{MAP_FAILED};
+  size_t rings_size{0};
+  void* sqes{MAP_FAILED};
+  size_t sqes_size{0};
+
+  unsigned* sq_head{nullptr};
+  unsigned* sq_tail{nullptr};
+  unsigned sq_mask{0};
+  unsigned sq_entries{0};
+  /** @brief tail of the entries queued, not published to the kernel yet */
+  unsigned sq_local_tail{0};
+
+  unsigned* cq_head{nullptr};
+  unsigned* cq_tail{nullptr};
+  unsigned cq_mask{0};
+  struct io_uring_cqe* cqes{nullptr};
+};
+
+/*static*/
+std::unique_ptr<IoUringPoller> IoUringPoller::create(unsigned entries) {
+  std::unique_ptr<Ring> ring(new Ring());
+  if (!ring->setup(entries)) return nullptr;
+
+  return std::unique_ptr<IoUringPoller>(new IoUringPoller(std::move(ring)));
+}
+
+/*static*/
+bool IoUringPoller::is_supported() noexcept {
+  Ring ring;
+  return ring.setup(1);
+}
+
+IoUringPoller::IoUringPoller(std::unique_ptr<Ring> ring) : ring_(std::move(ring)) {}
+
+IoUringPoller::~IoUringPoller() = default;
+
+void IoUringPoller::add(int fd, unsigned events) {
+  Watch& watch = watches_[fd];
+  watch.events = events;
+  watch.generation = ++next_generation_;
+  watch.armed = false;
+  to_arm_.push_back(fd);
+}
+
+void IoUringPoller::modify(int fd, unsigned events) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end()) {
+    add(fd, events);
+    return;
+  }
+
+  Watch& watch = it->second;
+  if (watch.events == events) return;
+  watch.events = events;
+  if (watch.armed) {
+    disarm(fd, watch);
+  }
+  to_arm_.push_back(fd);
+}
+
+void IoUringPoller::remove(int fd) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end()) return;
+
+  // the poll holds a reference to the socket until it is removed
+  if (it->second.armed) {
+    disarm(fd, it->second);
+  }
+  watches_.erase(it);
+}
+
+void IoUringPoller::arm(int fd, Watch& watch) {
+  struct io_uring_sqe* sqe = ring_->get_sqe();
+  if (sqe == nullptr) return;
+
+  // POLLERR and POLLHUP get reported in any case, like by epoll
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = ((watch.events & kReadEvent) ? static_cast<uint32_t>(POLLIN) : 0u) |
+                       ((watch.events & kWriteEvent) ? static_cast<uint32_t>(POLLOUT) : 0u);
+  sqe->user_data = make_user_data(fd, watch.generation);
+  watch.armed = true;
+}
+
+void IoUringPoller::disarm(int fd, Watch& watch) {
+  struct io_uring_sqe* sqe = ring_->get_sqe();
+  if (sqe != nullptr) {
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = make_user_data(fd, watch.generation);
+    sqe->user_data = kIgnoreUserData;
+  }
+
+  // completions of the old poll get dropped
+  watch.generation = ++next_generation_;
+  watch.armed = false;
+}
+
+int IoUringPoller::wait(std::vector<ReadyFd>& ready_fds, int timeout_ms) {
+  ready_fds.clear();
+
+  for (int fd: to_arm_) {
+    auto it = watches_.find(fd);
+    if (it != watches_.end() && !it->second.armed) {
+      arm(fd, it->second);
+    }
+  }
+  to_arm_.clear();
+
+  unsigned head = *ring_->cq_head;
+  if (head == __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_ms >= 0) {
+      ts.tv_sec = timeout_ms / 1000;
+      ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+      arg.ts = reinterpret_cast<uintptr_t>(&ts);
+    }
+
+    if (ring_->submit(1, &arg) == -1 && errno != ETIME) {
+      return -1;
+    }
+  } else if (ring_->sq_local_tail != __atomic_load_n(ring_->sq_head, __ATOMIC_ACQUIRE)) {
+    // completions are there already, just hand over the new polls
+    if (ring_->submit(0, nullptr) == -1 && errno != EINTR && errno != EBUSY) {
+      return -1;
+    }
+  }
+
+  const unsigned tail = __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    const struct io_uring_cqe& cqe = ring_->cqes[head & ring_->cq_mask];
+    if (cqe.user_data == kIgnoreUserData || cqe.res == -ECANCELED) continue;
+
+    const int fd = static_cast<int>(cqe.user_data >> 32);
+    auto it = watches_.find(fd);
+    if (it == watches_.end() || it->second.generation != static_cast<uint32_t>(cqe.user_data)) {
+      continue;
+    }
+
+    // errors are reported as readable, read() will tell
+    const uint32_t ev = cqe.res < 0 ? static_cast<uint32_t>(POLLERR) : static_cast<uint32_t>(cqe.res);
+    ready_fds.push_back({fd, (ev & (POLLIN | POLLHUP | POLLERR)) != 0, (ev & POLLOUT) != 0});
+
+    it->second.armed = false;
+    to_arm_.push_back(fd);
+  }
+  __atomic_store_n(ring_->cq_head, head, __ATOMIC_RELEASE);
+
+  return static_cast<int>(ready_fds.size());
+}
+
+#else  // no io_uring
+
+struct IoUringPoller::Ring {};
+
+/*static*/
+std::unique_ptr<IoUringPoller> IoUringPoller::create(unsigned /*entries*/) {
+  return nullptr;
+}
+
+/*static*/
+bool IoUringPoller::is_supported() noexcept {
+  return false;
+}
+
+IoUringPoller::IoUringPoller(std::unique_ptr<Ring> ring) : ring_(std::move(ring)) {}
+
+IoUringPoller::~IoUringPoller() = default;
+
+void IoUringPoller::add(int, unsigned) {}
+void IoUringPoller::modify(int, unsigned) {}
+void IoUringPoller::remove(int) {}
+void IoUringPoller::arm(int, Watch&) {}
+void IoUringPoller::disarm(int, Watch&) {}
+
+int IoUringPoller::wait(std::vector<ReadyFd>& ready_fds, int /*timeout_ms*/) {
+  ready_fds.clear();
+  errno = ENOSYS;
+  return -1;
+}
+
+#endif
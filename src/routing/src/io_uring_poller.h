@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_IO_URING_POLLER_INCLUDED
+#define ROUTING_IO_URING_POLLER_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief IoUringPoller watches sockets for readiness using io_uring.
+ *
+ * The I/O threads of RoutingIOEngine use it instead of epoll if asked to
+ * and if the kernel supports it (Linux 5.11 or later). Watching changes
+ * don't cost a syscall each like epoll_ctl(). They are queued as
+ * submissions and handed to the kernel together with the wait, one
+ * io_uring_enter() per wait however many sockets changed.
+ *
+ * Polls are one-shot. A socket that got reported is polled again by the
+ * next wait, with the events it is watched for by then. Completions of
+ * polls that got replaced or removed are dropped; the new poll reports the
+ * socket again if it is still ready.
+ *
+ * Only used by the thread that created it.
+ */
+class IoUringPoller {
+ public:
+  /** @brief events a socket is watched for */
+  enum Events : unsigned {
+    kReadEvent = 1,
+    kWriteEvent = 2,
+  };
+
+  /** @brief socket reported by wait() */
+  struct ReadyFd {
+    int fd;
+    bool readable;
+    bool writable;
+  };
+
+  /** @brief default number of submission queue entries */
+  static const unsigned kDefaultEntries = 1024;
+
+  /**
+   * @brief Sets up a ring.
+   *
+   * @return poller or nullptr if the kernel doesn't support what it needs
+   */
+  static std::unique_ptr<IoUringPoller> create(unsigned entries = kDefaultEntries);
+
+  /** @brief Returns true if a ring can be set up */
+  static bool is_supported() noexcept;
+
+  ~IoUringPoller();
+
+  IoUringPoller(const IoUringPoller&) = delete;
+  IoUringPoller& operator=(const IoUringPoller&) = delete;
+
+  /** @brief watches a socket not watched yet */
+  void add(int fd, unsigned events);
+
+  /** @brief changes the events a socket is watched for */
+  void modify(int fd, unsigned events);
+
+  /** @brief stops watching a socket, before it gets closed */
+  void remove(int fd);
+
+  /**
+   * @brief Submits the changes and waits for sockets to get ready.
+   *
+   * @param ready_fds sockets that got ready
+   * @param timeout_ms time to wait, -1 to wait until a socket gets ready
+   *
+   * @return number of ready sockets, -1 and errno on failure
+   */
+  int wait(std::vector<ReadyFd>& ready_fds, int timeout_ms);
+
+ private:
+  struct Watch {
+    unsigned events;
+    /** @brief tells the completions of the current poll from older ones */
+    uint32_t generation;
+    /** @brief true if a poll got queued or submitted and didn't complete */
+    bool armed;
+  };
+
+  struct Ring;
+
+  explicit IoUringPoller(std::unique_ptr<Ring> ring);
+
+  /** @brief queues a poll for the socket's events */
+  void arm(int fd, Watch& watch);
+
+  /** @brief queues the removal of the socket's poll */
+  void disarm(int fd, Watch& watch);
+
+  std::unique_ptr<Ring> ring_;
+  std::unordered_map<int, Watch> watches_;
+  /** @brief sockets to poll with the next wait */
+  std::vector<int> to_arm_;
+  uint32_t next_generation_{0};
+};
+
+#endif  // ROUTING_IO_URING_POLLER_INCLUDED
@@ -27,20 +27,37 @@
 
 #include "utils.h"
 #include "common.h"
+#include "dest_consistent_hash.h"
 #include "dest_first_available.h"
+#include "dest_least_connections.h"
+#include "dest_lowest_latency.h"
 #include "dest_next_available.h"
 #include "dest_round_robin.h"
+#include "dest_weighted_round_robin.h"
 #include "dest_metadata_cache.h"
 #include "mysql/harness/logging/logging.h"
 #include "mysql_routing.h"
 #include "mysqlrouter/metadata_cache.h"
+#include "mysqlrouter/query_digest_stats.h"
+#include "mysqlrouter/routing_control.h"
+#include "mysqlrouter/routing_metrics.h"
+#include "result_cache.h"
 #include "mysqlrouter/routing.h"
 #include "mysqlrouter/uri.h"
 #include "mysqlrouter/utils.h"
+#include "mysql/harness/loop_monitor.h"
 #include "mysql/harness/plugin.h"
+#include "mysql/harness/readiness.h"
+#include "mysql/harness/tracepoints.h"
 #include "plugin_config.h"
+#include "protocol/classic_compression.h"
+#include "protocol/x_compression.h"
+#include "protocol/proxy_protocol.h"
 #include "protocol/protocol.h"
 #include "connection.h"
+#include "output_queue.h"
+#include "splice_forwarder.h"
+#include "zero_copy_sender.h"
 #include "mysql_routing_common.h"
 
 #include "mysql_router_thread.h"
@@ -53,11 +70,13 @@
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <sys/types.h>
 
 #ifndef _WIN32
 #  include <netinet/in.h>
+#  include <netinet/tcp.h>
 #  include <fcntl.h>
 #  include <sys/un.h>
 #  include <sys/select.h>
@@ -94,6 +113,8 @@ static int kListenQueueSize = 1024;
 
 static const char *kDefaultReplicaSetName = "default";
 static const std::chrono::milliseconds kAcceptorStopPollInterval_ms { 100 };
+// connections accepted from a listener per wakeup before the acceptor polls again
+static const int kAcceptBatchSize = 64;
 
 MySQLRouting::MySQLRouting(routing::RoutingStrategy routing_strategy, uint16_t port,
                            const Protocol::Type protocol,
@@ -116,9 +137,10 @@ MySQLRouting::MySQLRouting(routing::RoutingStrategy routing_strategy, uint16_t p
       routing_sock_ops_(routing_sock_ops),
       routing_strategy_(routing_strategy),
       access_mode_(access_mode),
-      max_connections_(set_max_connections(max_connections)),
+      max_connections_((validate_max_connections(max_connections), max_connections)),
       service_tcp_(routing::kInvalidSocket),
-      service_named_socket_(routing::kInvalidSocket) {
+      service_named_socket_(routing::kInvalidSocket),
+      connection_container_(static_cast<unsigned>(max_connections_)) {
 
   validate_destination_connect_timeout(destination_connect_timeout);
 
@@ -135,20 +157,154 @@ MySQLRouting::MySQLRouting(routing::RoutingStrategy routing_strategy, uint16_t p
   if (!context_.get_bind_address().port && !named_socket.is_set()) {
     throw std::invalid_argument(string_format("No valid address:port (%s:%d) or socket (%s) to bind to", bind_address.c_str(), port, named_socket.c_str()));
   }
+
+  context_.set_metrics(std::make_shared<RoutingMetrics>());
+  RoutingMetricsComponent::getInstance().register_route(context_.get_name(), context_.get_metrics());
+  RoutingControlComponent::getInstance().register_route(context_.get_name(), this);
 }
 
 MySQLRouting::~MySQLRouting() {
+  // waits for a change_settings() in progress
+  RoutingControlComponent::getInstance().unregister_route(context_.get_name());
+  RoutingMetricsComponent::getInstance().unregister_route(context_.get_name());
+  // a snapshot taken right now may still hold the metrics
+  context_.get_metrics()->set_buffer_pool_source(nullptr);
+  if (query_digests_registered_) {
+    QueryDigestComponent::getInstance().unregister_route(context_.get_name());
+  }
+
+  close_tcp_listeners();
+}
 
+void MySQLRouting::close_tcp_listeners() {
+  // shutdown() would stop the listeners of the process they got handed to
+  const bool shared = handoff_ && handoff_->has_handed_over();
   if (service_tcp_ != routing::kInvalidSocket) {
-    context_.get_socket_operations()->shutdown(service_tcp_);
+    if (!shared) context_.get_socket_operations()->shutdown(service_tcp_);
     context_.get_socket_operations()->close(service_tcp_);
+    service_tcp_ = routing::kInvalidSocket;
+  }
+  for (int sock : service_tcp_reuseport_) {
+    if (!shared) context_.get_socket_operations()->shutdown(sock);
+    context_.get_socket_operations()->close(sock);
+  }
+  service_tcp_reuseport_.clear();
+}
+
+static RoutingMetrics::BufferPoolCounters to_buffer_pool_counters(const RoutingBufferPool::Stats& stats) {
+  RoutingMetrics::BufferPoolCounters counters;
+  counters.hits = stats.hits;
+  counters.misses = stats.misses;
+  counters.evictions = stats.evictions;
+  counters.high_water = stats.high_water;
+  return counters;
+}
+
+#ifndef _WIN32
+// true if sock is a listener bound to port
+static bool listens_on_port(int sock, uint16_t port) {
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  int accepting = 0;
+  socklen_t accepting_len = sizeof(accepting);
+  if (getsockname(sock, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) == -1 ||
+      getsockopt(sock, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &accepting_len) == -1 || !accepting) {
+    return false;
+  }
+
+  if (addr.ss_family == AF_INET)
+    return ntohs(reinterpret_cast<struct sockaddr_in*>(&addr)->sin_port) == port;
+  if (addr.ss_family == AF_INET6)
+    return ntohs(reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_port) == port;
+  return false;
+}
+
+// true if sock is a listener bound to socket_file
+static bool listens_on_file(int sock, const std::string& socket_file) {
+  struct sockaddr_un addr;
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(sock, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) == -1 ||
+      addr.sun_family != AF_UNIX) {
+    return false;
+  }
+  return socket_file == addr.sun_path;
+}
+#endif
+
+bool MySQLRouting::take_over_listeners() {
+#ifndef _WIN32
+  SocketHandoff::Listeners listeners;
+  try {
+    if (!handoff_->receive(listeners)) return false;
+  } catch (const runtime_error& exc) {
+    log_warning("[%s] taking over the listeners through %s failed, binding them: %s",
+        context_.get_name().c_str(), handoff_socket_.c_str(), exc.what());
+    return false;
+  }
+
+  // the other process may have been configured differently
+  auto so = context_.get_socket_operations();
+  const uint16_t port = context_.get_bind_address().port;
+  const bool tcp_ok = port == 0 ? listeners.tcp.empty()
+                                : !listeners.tcp.empty() &&
+                                  std::all_of(listeners.tcp.begin(), listeners.tcp.end(),
+                                              [port](int sock) { return listens_on_port(sock, port); });
+  const bool named_socket_ok = context_.get_bind_named_socket().is_set()
+      ? listeners.named_socket != routing::kInvalidSocket &&
+        listens_on_file(listeners.named_socket, context_.get_bind_named_socket().str())
+      : listeners.named_socket == routing::kInvalidSocket;
+  if (!tcp_ok || !named_socket_ok) {
+    log_warning("[%s] listeners handed over through %s don't match the configuration, binding them",
+        context_.get_name().c_str(), handoff_socket_.c_str());
+    for (int sock : listeners.tcp) so->close(sock);
+    if (listeners.named_socket != routing::kInvalidSocket) so->close(listeners.named_socket);
+    return false;
+  }
+
+  if (!listeners.tcp.empty()) {
+    service_tcp_ = listeners.tcp[0];
+    service_tcp_reuseport_.assign(listeners.tcp.begin() + 1, listeners.tcp.end());
+  }
+  service_named_socket_ = listeners.named_socket;
+
+  log_info("[%s] took over %u listeners through %s", context_.get_name().c_str(),
+      static_cast<unsigned>(listeners.tcp.size() + (listeners.named_socket != routing::kInvalidSocket ? 1 : 0)),
+      handoff_socket_.c_str());
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MySQLRouting::hand_over_listeners() {
+  SocketHandoff::Listeners listeners;
+  if (service_tcp_ != routing::kInvalidSocket) listeners.tcp.push_back(service_tcp_);
+  listeners.tcp.insert(listeners.tcp.end(), service_tcp_reuseport_.begin(), service_tcp_reuseport_.end());
+  listeners.named_socket = service_named_socket_;
+
+  if (handoff_->serve(listeners)) {
+    log_info("[%s] handed over the listeners through %s", context_.get_name().c_str(), handoff_socket_.c_str());
+  } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+    log_warning("[%s] handing over the listeners through %s failed: %s",
+        context_.get_name().c_str(), handoff_socket_.c_str(), get_message_error(errno).c_str());
   }
 }
 
 void MySQLRouting::start(mysql_harness::PluginFuncEnv* env) {
 
   mysql_harness::rename_thread(get_routing_thread_name(context_.get_name(), "RtM").c_str());  // "Rt main" would be too long :(
-  if (context_.get_bind_address().port > 0) {
+
+  bool took_over = false;
+  if (!handoff_socket_.empty()) {
+    if (SocketHandoff::is_supported()) {
+      handoff_.reset(new SocketHandoff(handoff_socket_));
+      took_over = take_over_listeners();
+    } else {
+      log_warning("[%s] handoff_socket is not supported on this platform", context_.get_name().c_str());
+    }
+  }
+
+  if (context_.get_bind_address().port > 0 && !took_over) {
     try {
       setup_tcp_service();
     } catch (const runtime_error &exc) {
@@ -159,7 +315,7 @@ void MySQLRouting::start(mysql_harness::PluginFuncEnv* env) {
     log_info("[%s] started: listening on %s", context_.get_name().c_str(), context_.get_bind_address().str().c_str());
   }
 #ifndef _WIN32
-  if (context_.get_bind_named_socket().is_set()) {
+  if (context_.get_bind_named_socket().is_set() && !took_over) {
     try {
       setup_named_socket_service();
     } catch (const runtime_error &exc) {
@@ -170,10 +326,23 @@ void MySQLRouting::start(mysql_harness::PluginFuncEnv* env) {
     log_info("[%s] started: listening using %s", context_.get_name().c_str(), context_.get_bind_named_socket().c_str());
   }
 #endif
+  if (handoff_) {
+    try {
+      handoff_->listen();
+    } catch (const runtime_error &exc) {
+      log_warning("[%s] can't hand over the listeners through %s: %s",
+          context_.get_name().c_str(), handoff_socket_.c_str(), exc.what());
+      handoff_.reset();
+    }
+  }
+
   if (context_.get_bind_address().port > 0 || context_.get_bind_named_socket().is_set()) {
     start_acceptor(env);
+    const bool handed_over = handoff_ && handoff_->has_handed_over();
+    if (handoff_) handoff_->close();
 #ifndef _WIN32
-    if (context_.get_bind_named_socket().is_set() && unlink(context_.get_bind_named_socket().str().c_str()) == -1) {
+    // the socket file belongs to the process the listeners got handed to
+    if (context_.get_bind_named_socket().is_set() && !handed_over && unlink(context_.get_bind_named_socket().str().c_str()) == -1) {
       if (errno != ENOENT)
         log_warning("%s", ("Failed removing socket file " + context_.get_bind_named_socket().str() + " (" + get_strerror(errno) + " (" + to_string(errno) + "))").c_str());
     }
@@ -223,10 +392,118 @@ static int unix_getpeercred(int sock, pid_t &peer_pid, uid_t &peer_uid) {
 #endif
 
 
+/*
+ * set TCP_NODELAY on the listening socket
+ *
+ * returns true if the accepted sockets inherit it
+ */
+static bool set_listener_nodelay(int sock) {
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+  int opt_nodelay = 1;
+  return setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&opt_nodelay),
+                    static_cast<socklen_t>(sizeof(int))) == 0;
+#else
+  (void)sock;
+  return false;
+#endif
+}
+
 void MySQLRouting::start_acceptor(mysql_harness::PluginFuncEnv* env) {
   mysql_harness::rename_thread(get_routing_thread_name(context_.get_name(), "RtA").c_str());  // "Rt Acceptor" would be too long :(
+  const std::vector<unsigned>& cpus = context_.get_cpu_affinity();
+  if (!cpus.empty() && !mysql_harness::set_current_thread_cpu_affinity(cpus)) {
+    log_warning("[%s] failed to pin the threads to the CPUs of cpu_affinity, they run on any CPU",
+                context_.get_name().c_str());
+  }
+
+  // the destination may get replaced by change_settings() while the route
+  // runs, the callbacks stay registered with this one
+  std::shared_ptr<WarmConnectionPool> warm_pool;
+  if (warm_connections_ > 0) {
+    auto routing_sock_ops = routing_sock_ops_;
+    auto unix_sockets = unix_sockets_;
+    const routing::SocketOptions socket_options = context_.get_socket_options();
+    const std::chrono::milliseconds connect_timeout = context_.get_destination_connect_timeout();
+    warm_pool = std::make_shared<WarmConnectionPool>(context_.get_socket_operations(),
+        [routing_sock_ops, unix_sockets, socket_options, connect_timeout](const mysql_harness::TCPAddress &addr) {
+          return routing_sock_ops->get_mysql_socket(RouteDestination::get_connect_address(unix_sockets.get(), addr),
+                                                    connect_timeout, false, socket_options);
+        },
+        warm_connections_, warm_connection_max_age_);
+    warm_pool->start(context_.get_name(), context_.get_thread_stack_size());
+  }
+
+  std::shared_ptr<RouteDestination> destination;
+  {
+    std::lock_guard<std::mutex> lock(settings_mtx_);
+    warm_pool_ = warm_pool;
+    destination = destination_;
+    setup_destination(*destination);
+    destination->start();
+    destination_started_ = true;
+    if (handshake_router_) {
+      for (const auto &pool : handshake_router_->get_pools()) {
+        setup_destination(*pool.second);
+        pool.second->start();
+      }
+    }
+    if (query_router_) {
+      for (const auto &pool : query_router_->get_pools()) {
+        setup_destination(*pool.second);
+        pool.second->start();
+      }
+    }
+  }
 
-  destination_->start();
+  if (io_engine_type_ == routing::IOEngine::kEvent) {
+    unsigned int io_threads = io_threads_;
+    if (io_threads == 0) {
+      // one per CPU the route may run on
+      io_threads = cpus.empty() ? std::max(std::thread::hardware_concurrency(), 1u)
+                                : static_cast<unsigned int>(cpus.size());
+    }
+
+    io_engine_.reset(new RoutingIOEngine(context_.get_name(), io_threads,
+        context_.get_client_connect_timeout(), context_.get_thread_stack_size(),
+        context_.get_net_buffer_length(), context_.get_buffer_pool_size(),
+        io_uring_));
+    io_engine_->set_cpu_affinity(cpus);
+    io_engine_->set_fair_share(fair_share_quantum_, max_bandwidth_);
+    if (buffer_huge_pages_ != BufferArena::HugePages::kNone) {
+      io_engine_->set_buffer_huge_pages(buffer_huge_pages_);
+    }
+    io_engine_->start();
+    context_.set_io_engine(io_engine_.get());
+
+    if (io_uring_ && !io_engine_->is_using_io_uring()) {
+      log_warning("[%s] io_uring is not supported by the kernel, using epoll",
+          context_.get_name().c_str());
+    }
+    log_info("[%s] serving connections using %u I/O threads%s",
+        context_.get_name().c_str(), io_threads,
+        io_engine_->is_using_io_uring() ? " with io_uring" : "");
+  }
+
+  context_.get_metrics()->set_buffer_pool_source([this]() {
+    RoutingBufferPool::Stats stats = context_.get_buffer_pool().get_stats();
+    if (io_engine_) stats += io_engine_->get_buffer_pool_stats();
+    return to_buffer_pool_counters(stats);
+  });
+
+  if (connection_pool_size_ > 0) {
+    backend_pool_.reset(new BackendConnectionPool(context_.get_socket_operations(),
+        connection_pool_size_, connection_pool_idle_timeout_, context_.get_protocol().get_type()));
+    context_.set_backend_pool(backend_pool_.get());
+  }
+
+  if (admission_queue_size_ > 0) {
+    admission_queue_.reset(new AdmissionQueue(admission_queue_size_, admission_queue_timeout_));
+  }
+
+  if (traffic_mirror_) {
+    traffic_mirror_->start(context_.get_name(), context_.get_thread_stack_size());
+    context_.set_traffic_mirror(traffic_mirror_);
+  }
 
   auto allowed_nodes_changed = [&](const AllowedNodes& nodes, const std::string& reason) {
 
@@ -246,34 +523,110 @@ void MySQLRouting::start_acceptor(mysql_harness::PluginFuncEnv* env) {
 
     // handle allowed nodes changed
     connection_container_.disconnect(nodes);
+    if (backend_pool_) backend_pool_->remove_not_allowed(nodes);
+    if (warm_pool) warm_pool->remove_not_allowed(nodes);
   };
 
   allowed_nodes_list_iterator_ =
-      destination_->register_allowed_nodes_change_callback(allowed_nodes_changed);
+      destination->register_allowed_nodes_change_callback(allowed_nodes_changed);
+  std::vector<std::pair<RouteDestination*, AllowedNodesChangeCallbacksListIterator>> pool_callbacks;
+  if (handshake_router_) {
+    for (const auto &pool : handshake_router_->get_pools()) {
+      pool_callbacks.emplace_back(pool.second.get(),
+          pool.second->register_allowed_nodes_change_callback(allowed_nodes_changed));
+    }
+  }
+  if (query_router_) {
+    for (const auto &pool : query_router_->get_pools()) {
+      pool_callbacks.emplace_back(pool.second.get(),
+          pool.second->register_allowed_nodes_change_callback(allowed_nodes_changed));
+    }
+  }
 
   std::shared_ptr<void> exit_guard(nullptr, [&](void *){
-    destination_->unregister_allowed_nodes_change_callback(allowed_nodes_list_iterator_);
+    destination->unregister_allowed_nodes_change_callback(allowed_nodes_list_iterator_);
+    for (const auto &pool_callback : pool_callbacks) {
+      pool_callback.first->unregister_allowed_nodes_change_callback(pool_callback.second);
+    }
   });
 
 
   if (service_tcp_ != routing::kInvalidSocket) {
     routing::set_socket_blocking(service_tcp_, false);
+    tcp_nodelay_inherited_ = set_listener_nodelay(service_tcp_);
   }
   if (service_named_socket_ != routing::kInvalidSocket) {
     routing::set_socket_blocking(service_named_socket_, false);
   }
 
+  // the additional acceptor threads drain their own SO_REUSEPORT listener,
+  // this thread keeps serving the first TCP listener and the named socket
+  std::vector<std::pair<MySQLRouting*, int>> acceptor_args;
+  std::vector<std::unique_ptr<mysql_harness::MySQLRouterThread>> acceptor_threads;
+  if (proxy_trusted_sources_) {
+    proxy_header_receiver_.reset(new ProxyHeaderReceiver(context_.get_socket_operations(), proxy_protocol_timeout_,
+        [this](int sock, const sockaddr_storage &client_addr) { admit_client(sock, client_addr, true); }));
+    proxy_header_receiver_->start(context_.get_name(), context_.get_thread_stack_size());
+  }
+  auto stop_acceptors = [&]() {
+    acceptors_running_ = false;
+    for (auto& thread : acceptor_threads) {
+      thread->join();
+    }
+    acceptor_threads.clear();
+    // nothing pushes anymore, it may still admit
+    if (proxy_header_receiver_) proxy_header_receiver_->stop();
+  };
+  std::shared_ptr<void> acceptors_guard(nullptr, [&](void*) { stop_acceptors(); });
+
+  acceptor_args.reserve(service_tcp_reuseport_.size());
+  acceptors_running_ = true;
+  for (int sock : service_tcp_reuseport_) {
+    routing::set_socket_blocking(sock, false);
+    tcp_nodelay_inherited_ = set_listener_nodelay(sock) && tcp_nodelay_inherited_;
+    acceptor_args.emplace_back(this, sock);
+    acceptor_threads.emplace_back(new mysql_harness::MySQLRouterThread(context_.get_thread_stack_size()));
+    acceptor_threads.back()->run(&run_acceptor_thread, &acceptor_args.back());
+  }
+  if (!acceptor_threads.empty()) {
+    log_info("[%s] accepting connections using %u acceptor threads",
+        context_.get_name().c_str(), static_cast<unsigned>(acceptor_threads.size() + 1));
+  }
+
   const int kAcceptUnixSocketNdx = 0;
   const int kAcceptTcpNdx = 1;
+  const int kHandoffNdx = 2;
+  const int kAdmissionNdx = 3;
   struct pollfd fds[] = {
     { routing::kInvalidSocket, POLLIN, 0 },
     { routing::kInvalidSocket, POLLIN, 0 },
+    { routing::kInvalidSocket, POLLIN, 0 },
+    { routing::kInvalidSocket, POLLIN, 0 },
   };
 
   fds[kAcceptTcpNdx].fd = service_tcp_;
   fds[kAcceptUnixSocketNdx].fd = service_named_socket_;
-
+  if (handoff_) fds[kHandoffNdx].fd = handoff_->get_socket();
+  if (admission_queue_) fds[kAdmissionNdx].fd = admission_queue_->get_wakeup_fd();
+
+  // the acceptor wakes up at least every kAcceptorStopPollInterval_ms, the
+  // heartbeats posted to it wait that long at most while it is idle
+  auto& loop_monitor = mysql_harness::LoopMonitor::instance();
+  const auto loop_id = loop_monitor.add(context_.get_name() + " acceptor",
+      [this](mysql_harness::LoopMonitor::Task task) {
+        std::lock_guard<std::mutex> lock(acceptor_tasks_mtx_);
+        acceptor_tasks_.push_back(std::move(task));
+      });
+
+  // the route listens right away, but only reports being ready once its
+  // destinations are known, which also warms the Metadata Cache lookup
+  bool reported_ready = false;
   while (is_running(env)) {
+    if (!reported_ready && std::atomic_load(&destination_)->is_ready()) {
+      mysql_harness::Readiness::instance().report(context_.get_name(), true);
+      reported_ready = true;
+    }
+
     // wait for the accept() sockets to become readable (POLLIN)
     int ready_fdnum = context_.get_socket_operations()->poll(fds, sizeof(fds) / sizeof(fds[0]), kAcceptorStopPollInterval_ms);
     // < 0 - failure
@@ -301,73 +654,63 @@ void MySQLRouting::start_acceptor(mysql_harness::PluginFuncEnv* env) {
 
       --ready_fdnum;
 
-      int sock_client;
-      struct sockaddr_storage client_addr;
-      socklen_t sin_size = static_cast<socklen_t>(sizeof client_addr);
-
-
-      if ((sock_client = accept(fds[ndx].fd, (struct sockaddr *) &client_addr, &sin_size)) < 0) {
-        log_error("[%s] Failed accepting connection: %s", context_.get_name().c_str(), get_message_error(context_.get_socket_operations()->get_errno()).c_str());
+      if (ndx == kHandoffNdx) {
+        hand_over_listeners();
         continue;
       }
 
-      bool is_tcp = (ndx == kAcceptTcpNdx);
+      // admitted below
+      if (ndx == kAdmissionNdx) continue;
 
-      if (is_tcp) {
-        log_debug("[%s] fd=%d connection accepted at %s", context_.get_name().c_str(), sock_client, context_.get_bind_address().str().c_str());
-      } else {
-#if !defined(_WIN32)
-        pid_t peer_pid;
-        uid_t peer_uid;
-
-        // try to be helpful of who tried to connect to use and failed.
-        // who == PID + UID
-        //
-        // if we can't get the PID, we'll just show a simpler errormsg
-
-        if (0 == unix_getpeercred(sock_client, peer_pid, peer_uid)) {
-          log_debug("[%s] fd=%d connection accepted at %s from (pid=%d, uid=%d)",
-              context_.get_name().c_str(), sock_client, context_.get_bind_named_socket().str().c_str(),
-              peer_pid, peer_uid);
-        } else
-          // fall through
-#endif
-        log_debug("[%s] fd=%d connection accepted at %s",
-            context_.get_name().c_str(), sock_client, context_.get_bind_named_socket().str().c_str());
-      }
+      accept_connections(fds[ndx].fd, ndx == kAcceptTcpNdx);
+    }
 
-      if (context_.conn_error_counters_[in_addr_to_array(client_addr)] >= context_.max_connect_errors_) {
-        std::stringstream os;
-        os << "Too many connection errors from " << get_peer_name(sock_client).first;
-        context_.get_protocol().send_error(sock_client, 1129, os.str(), "HY000", context_.get_name());
-        log_info("%s", os.str().c_str());
-        context_.get_socket_operations()->close(sock_client); // no shutdown() before close()
-        continue;
-      }
+    // also after timeouts, expired clients get rejected without a wakeup
+    if (admission_queue_) admit_queued_connections();
 
-      if (context_.info_active_routes_.load(std::memory_order_relaxed) >= max_connections_) {
-        context_.get_protocol().send_error(sock_client, 1040, "Too many connections to MySQL Router", "HY000", context_.get_name());
-        context_.get_socket_operations()->close(sock_client); // no shutdown() before close()
-        log_warning("[%s] reached max active connections (%d max=%d)", context_.get_name().c_str(),
-                   context_.info_active_routes_.load(), max_connections_);
-        continue;
-      }
+    // poll() returns at least once per tick of the timers
+    const size_t timed_out = connection_container_.expire_connections();
+    if (timed_out > 0) {
+      log_info("[%s] disconnecting %zu connections that timed out",
+          context_.get_name().c_str(), timed_out);
+    }
 
-      int opt_nodelay = 1;
-      if (is_tcp && setsockopt(sock_client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&opt_nodelay), static_cast<socklen_t>(sizeof(int))) == -1) {
-        log_info("[%s] fd=%d client setsockopt(TCP_NODELAY) failed: %s", context_.get_name().c_str(), sock_client, get_message_error(context_.get_socket_operations()->get_errno()).c_str());
+    std::vector<std::function<void()>> tasks;
+    {
+      std::lock_guard<std::mutex> lock(acceptor_tasks_mtx_);
+      tasks.swap(acceptor_tasks_);
+    }
+    for (auto &task: tasks) task();
+  } // while (is_running(env))
 
-        // if it fails, it will be slower, but cause no harm
-      }
+  loop_monitor.remove(loop_id);
+
+  mysql_harness::Readiness::instance().report(context_.get_name(), false);
 
-      // On some OS'es the socket will be non-blocking as a result of accept()
-      // on non-blocking socket. We need to make sure it's always blocking.
-      routing::set_socket_blocking(sock_client, true);
+  // no new connections once the connections get disconnected
+  stop_acceptors();
 
-      // launch client thread which will service this new connection
-      create_connection(sock_client, client_addr);
+  if (admission_queue_) {
+    for (const auto &entry: admission_queue_->pop_all()) {
+      reject_too_many_connections(entry.socket, entry.client_addr);
     }
-  } // while (is_running(env))
+  }
+
+  if (drain_timeout_.count() > 0) {
+    // refused clients go to the next router right away instead of waiting
+    // in the backlog
+    close_tcp_listeners();
+    connection_container_.drain_all();
+
+    std::unique_lock<std::mutex> lk(context_.active_client_threads_cond_m_);
+    if (!context_.active_client_threads_cond_.wait_for(lk, drain_timeout_,
+            [&]{ return context_.active_client_threads_ == 0;})) {
+      log_info("[%s] %llu connections still open after draining for %llds, disconnecting them",
+          context_.get_name().c_str(),
+          static_cast<unsigned long long>(context_.active_client_threads_),
+          static_cast<long long>(drain_timeout_.count()));
+    }
+  }
 
   // disconnect all connections
   connection_container_.disconnect_all();
@@ -378,25 +721,865 @@ void MySQLRouting::start_acceptor(mysql_harness::PluginFuncEnv* env) {
     context_.active_client_threads_cond_.wait(lk, [&]{ return context_.active_client_threads_ == 0;});
   }
 
+  RoutingBufferPool::Stats buffer_pool_stats = context_.get_buffer_pool().get_stats();
+  BufferArena::Stats buffer_arena_stats = buffer_arena_ ? buffer_arena_->get_stats() : BufferArena::Stats();
+  if (io_engine_) {
+    context_.set_io_engine(nullptr);
+    io_engine_->stop();
+    buffer_pool_stats += io_engine_->get_buffer_pool_stats();
+    buffer_arena_stats += io_engine_->get_buffer_arena_stats();
+  }
+  // the metrics keep the totals once the pools of the I/O threads are gone
+  const RoutingMetrics::BufferPoolCounters buffer_pool_counters = to_buffer_pool_counters(buffer_pool_stats);
+  context_.get_metrics()->set_buffer_pool_source([buffer_pool_counters]() { return buffer_pool_counters; });
+  io_engine_.reset();
+
+  log_info("[%s] buffer pool: %llu hits, %llu misses, %llu evictions, high water %llu",
+      context_.get_name().c_str(),
+      static_cast<unsigned long long>(buffer_pool_stats.hits),
+      static_cast<unsigned long long>(buffer_pool_stats.misses),
+      static_cast<unsigned long long>(buffer_pool_stats.evictions),
+      static_cast<unsigned long long>(buffer_pool_stats.high_water));
+  if (buffer_huge_pages_ != BufferArena::HugePages::kNone) {
+    log_debug("[%s] buffer arena: %zu slabs, %zu on explicit huge pages, %zu on transparent huge pages",
+        context_.get_name().c_str(), buffer_arena_stats.slabs,
+        buffer_arena_stats.explicit_huge_page_slabs, buffer_arena_stats.transparent_huge_page_slabs);
+    if (buffer_huge_pages_ == BufferArena::HugePages::kExplicit &&
+        buffer_arena_stats.explicit_huge_page_slabs < buffer_arena_stats.slabs) {
+      log_warning("[%s] %zu of %zu buffer slabs got no explicit huge pages, vm.nr_hugepages may be too low",
+          context_.get_name().c_str(),
+          buffer_arena_stats.slabs - buffer_arena_stats.explicit_huge_page_slabs, buffer_arena_stats.slabs);
+    }
+  }
+
+  if (admission_queue_) {
+    admission_queue_.reset();
+  }
+
+  proxy_header_receiver_.reset();
+
+  if (traffic_mirror_) {
+    context_.set_traffic_mirror(nullptr);
+    TrafficMirror::Stats stats = traffic_mirror_->get_stats();
+    log_info("[%s] mirrored %llu sessions to %s: %llu failed, %llu bytes sent, %llu bytes dropped",
+        context_.get_name().c_str(),
+        static_cast<unsigned long long>(stats.sessions),
+        traffic_mirror_->get_destination().str().c_str(),
+        static_cast<unsigned long long>(stats.failed),
+        static_cast<unsigned long long>(stats.bytes_sent),
+        static_cast<unsigned long long>(stats.bytes_dropped));
+    // the background thread stops with the last session
+    traffic_mirror_.reset();
+  }
+
+  if (warm_pool) {
+    {
+      std::lock_guard<std::mutex> lock(settings_mtx_);
+      warm_pool_.reset();
+    }
+    // the destinations share it, the background thread stops with the last of them
+    warm_pool->clear();
+    WarmConnectionPool::Stats stats = warm_pool->get_stats();
+    log_debug("[%s] warm connections: %llu hits, %llu misses, %llu expired",
+        context_.get_name().c_str(),
+        static_cast<unsigned long long>(stats.hits),
+        static_cast<unsigned long long>(stats.misses),
+        static_cast<unsigned long long>(stats.expired));
+  }
+
+  if (backend_pool_) {
+    context_.set_backend_pool(nullptr);
+    BackendConnectionPool::Stats stats = backend_pool_->get_stats();
+    log_debug("[%s] connection pool: %llu parked, %llu reused",
+        context_.get_name().c_str(),
+        static_cast<unsigned long long>(stats.parked),
+        static_cast<unsigned long long>(stats.reused));
+    backend_pool_.reset();
+  }
+
+  if (client_tls_context_) {
+    TlsServerContext::Stats stats = client_tls_context_->get_stats();
+    log_debug("[%s] client TLS: %llu handshakes, %llu resumed, %llu/%llu sent/received by the kernel",
+        context_.get_name().c_str(),
+        static_cast<unsigned long long>(stats.handshakes),
+        static_cast<unsigned long long>(stats.resumed),
+        static_cast<unsigned long long>(stats.kernel_send),
+        static_cast<unsigned long long>(stats.kernel_recv));
+  }
+
   log_info("[%s] stopped", context_.get_name().c_str());
 }
 
-void MySQLRouting::create_connection(int client_socket, const sockaddr_storage& client_addr) {
-  auto remove_callback = [this](MySQLRoutingConnection* connection) {
+/*static*/ void* MySQLRouting::run_acceptor_thread(void* context) {
+  auto args = static_cast<std::pair<MySQLRouting*, int>*>(context);
+  args->first->run_acceptor(args->second);
+  return nullptr;
+}
+
+void MySQLRouting::run_acceptor(int listen_sock) {
+  mysql_harness::rename_thread(get_routing_thread_name(context_.get_name(), "RtA").c_str());
+  if (!context_.get_cpu_affinity().empty()) {
+    mysql_harness::set_current_thread_cpu_affinity(context_.get_cpu_affinity());
+  }
+
+  struct pollfd fds[] = {
+    { listen_sock, POLLIN, 0 },
+  };
+
+  while (acceptors_running_) {
+    int ready_fdnum = context_.get_socket_operations()->poll(fds, 1, kAcceptorStopPollInterval_ms);
+    if (ready_fdnum < 0) {
+      const int last_errno = context_.get_socket_operations()->get_errno();
+      if (last_errno != EINTR && last_errno != EAGAIN) {
+        log_error("[%s] poll() failed with error: %s", context_.get_name().c_str(), get_message_error(last_errno).c_str());
+      }
+      continue;
+    }
+
+    if (ready_fdnum > 0 && (fds[0].revents & POLLIN) != 0) {
+      accept_connections(listen_sock, true);
+    }
+  }
+}
+
+void MySQLRouting::accept_connections(int listen_sock, bool is_tcp) {
+  for (int accepted = 0; accepted < kAcceptBatchSize; ++accepted) {
+    int sock_client;
+    struct sockaddr_storage client_addr;
+    socklen_t sin_size = static_cast<socklen_t>(sizeof client_addr);
+
+#if defined(__linux__) || defined(__FreeBSD__)
+    // without SOCK_NONBLOCK the accepted socket is blocking, whatever the
+    // listener is
+    sock_client = accept4(listen_sock, (struct sockaddr *) &client_addr, &sin_size, SOCK_CLOEXEC);
+#else
+    sock_client = accept(listen_sock, (struct sockaddr *) &client_addr, &sin_size);
+#endif
+    if (sock_client < 0) {
+      const int last_errno = context_.get_socket_operations()->get_errno();
+#ifdef _WIN32
+      if (last_errno == WSAEWOULDBLOCK) return;
+#else
+      if (last_errno == EAGAIN || last_errno == EWOULDBLOCK) return;
+      if (last_errno == EINTR) continue;
+#endif
+      log_error("[%s] Failed accepting connection: %s", context_.get_name().c_str(), get_message_error(last_errno).c_str());
+      return;
+    }
+
+    if (is_tcp) {
+      log_debug("[%s] fd=%d connection accepted at %s", context_.get_name().c_str(), sock_client, context_.get_bind_address().str().c_str());
+    } else {
+#if !defined(_WIN32)
+      pid_t peer_pid;
+      uid_t peer_uid;
+
+      // try to be helpful of who tried to connect to use and failed.
+      // who == PID + UID
+      //
+      // if we can't get the PID, we'll just show a simpler errormsg
+
+      if (0 == unix_getpeercred(sock_client, peer_pid, peer_uid)) {
+        log_debug("[%s] fd=%d connection accepted at %s from (pid=%d, uid=%d)",
+            context_.get_name().c_str(), sock_client, context_.get_bind_named_socket().str().c_str(),
+            peer_pid, peer_uid);
+      } else
+        // fall through
+#endif
+      log_debug("[%s] fd=%d connection accepted at %s",
+          context_.get_name().c_str(), sock_client, context_.get_bind_named_socket().str().c_str());
+    }
+
+    if (is_tcp && proxy_header_receiver_ && proxy_trusted_sources_->matches(client_addr)) {
+      // the header may be slow to arrive, it's read without holding up the acceptor
+      if (!proxy_header_receiver_->push(sock_client, client_addr)) {
+        context_.get_socket_operations()->close(sock_client); // no shutdown() before close()
+        static mysql_harness::logging::LogRateLimiter log_limiter;
+        log_info_limited(log_limiter, "[%s] closed connection of %s, too many connections wait for their PROXY header",
+                         context_.get_name().c_str(), mysql_harness::SocketEndpoint(client_addr).str().c_str());
+      }
+      continue;
+    }
+
+    admit_client(sock_client, client_addr, is_tcp);
+  }
+}
+
+void MySQLRouting::admit_client(int sock_client, const sockaddr_storage &client_addr, bool is_tcp) {
+  if (context_.is_client_host_blocked(in_addr_to_array(client_addr))) {
+    std::stringstream os;
+    os << "Too many connection errors from "
+       << mysql_harness::SocketEndpoint(client_addr).address_str();
+    context_.get_protocol().send_error(sock_client, 1129, os.str(), "HY000", context_.get_name());
+    log_info("%s", os.str().c_str());
+    context_.get_socket_operations()->close(sock_client); // no shutdown() before close()
+    return;
+  }
+
+  // the lane's clients get in while the route's limits refuse the others
+  const bool priority = priority_lane_ && priority_lane_->matches(client_addr) && priority_lane_->acquire();
+
+  const ClientLimits::Result limited = client_limits_ && !priority ? client_limits_->admit(client_addr)
+                                                                   : ClientLimits::Result::kAdmitted;
+  if (limited != ClientLimits::Result::kAdmitted) {
+    const std::string client = mysql_harness::SocketEndpoint(client_addr).address_str();
+    if (limited == ClientLimits::Result::kTooManyConnections) {
+      context_.get_protocol().send_error(sock_client, 1203, "Too many connections from " + client,
+                                         "42000", context_.get_name());
+    } else {
+      context_.get_protocol().send_error(sock_client, 1226, "Connection rate exceeded by " + client,
+                                         "42000", context_.get_name());
+    }
+    context_.get_socket_operations()->close(sock_client); // no shutdown() before close()
+    // a noisy client shouldn't flood the log too
+    static mysql_harness::logging::LogRateLimiter log_limiter;
+    log_info_limited(log_limiter, "[%s] refused connection of %s, it exceeds %s",
+                     context_.get_name().c_str(), client.c_str(),
+                     limited == ClientLimits::Result::kTooManyConnections ? "client_max_connections"
+                                                                          : "client_connection_rate");
+    return;
+  }
+
+  int opt_nodelay = 1;
+  if (is_tcp && !tcp_nodelay_inherited_ &&
+      setsockopt(sock_client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char *>(&opt_nodelay), static_cast<socklen_t>(sizeof(int))) == -1) {
+    log_info("[%s] fd=%d client setsockopt(TCP_NODELAY) failed: %s", context_.get_name().c_str(), sock_client, get_message_error(context_.get_socket_operations()->get_errno()).c_str());
+
+    // if it fails, it will be slower, but cause no harm
+  }
+
+#if !defined(__linux__) && !defined(__FreeBSD__)
+  // On some OS'es the socket will be non-blocking as a result of accept()
+  // on non-blocking socket. We need to make sure it's always blocking.
+  routing::set_socket_blocking(sock_client, true);
+#endif
+
+  if (priority) {
+    create_connection(sock_client, client_addr, true);
+    return;
+  }
+
+  const bool reserved = reserve_connection();
+  // while clients wait, new ones queue up behind them
+  if (admission_queue_ && (!reserved || !admission_queue_->empty()) &&
+      admission_queue_->push(sock_client, client_addr)) {
+    // the slot goes to the oldest waiting client, the main acceptor admits
+    if (reserved) release_connection();
+    return;
+  }
+
+  if (!reserved) {
+    reject_too_many_connections(sock_client, client_addr);
+    return;
+  }
+
+  // launch client thread which will service this new connection
+  create_connection(sock_client, client_addr);
+}
+
+bool MySQLRouting::reserve_connection() noexcept {
+  int reserved = reserved_connections_.load(std::memory_order_relaxed);
+  do {
+    if (reserved >= get_max_connections()) return false;
+  } while (!reserved_connections_.compare_exchange_weak(reserved, reserved + 1, std::memory_order_relaxed));
+
+  return true;
+}
+
+void MySQLRouting::release_connection() noexcept {
+  reserved_connections_.fetch_sub(1, std::memory_order_relaxed);
+  if (admission_queue_) admission_queue_->notify();
+}
+
+void MySQLRouting::reject_too_many_connections(int client_socket, const sockaddr_storage& client_addr) {
+  context_.get_protocol().send_error(client_socket, 1040, "Too many connections to MySQL Router", "HY000", context_.get_name());
+  context_.get_socket_operations()->close(client_socket); // no shutdown() before close()
+  if (client_limits_) client_limits_->release(client_addr);
+  log_warning("[%s] reached max active connections (%d max=%d)", context_.get_name().c_str(),
+             reserved_connections_.load(std::memory_order_relaxed), get_max_connections());
+}
+
+void MySQLRouting::admit_queued_connections() {
+  admission_queue_->clear_wakeups();
+
+  // only the main acceptor pops, a client left after empty() is there
+  // for pop() too, unless it expired meanwhile
+  AdmissionQueue::Entry entry;
+  while (!admission_queue_->empty() && reserve_connection()) {
+    if (!admission_queue_->pop(entry)) {
+      // no wakeup, it would only bring us back here
+      reserved_connections_.fetch_sub(1, std::memory_order_relaxed);
+      break;
+    }
+    create_connection(entry.socket, entry.client_addr);
+  }
+
+  for (const auto &expired: admission_queue_->pop_expired()) {
+    reject_too_many_connections(expired.socket, expired.client_addr);
+  }
+}
+
+void MySQLRouting::create_connection(int client_socket, const sockaddr_storage& client_addr, bool priority) {
+  MYSQL_ROUTER_TRACE(accept, context_.get_name().c_str(), client_socket, &client_addr);
+  if (!priority && budget_route_ && !budget_route_->acquire()) {
+    context_.get_protocol().send_error(client_socket, 1040, "Too many connections to MySQL Router", "HY000",
+                                       context_.get_name());
+    context_.get_socket_operations()->close(client_socket); // no shutdown() before close()
+    if (client_limits_) client_limits_->release(client_addr);
+    release_connection();
+    // a busy route may hit it for every client
+    static mysql_harness::logging::LogRateLimiter log_limiter;
+    log_warning_limited(log_limiter, "[%s] reached its share of connection_budget (%zu connections)",
+                        context_.get_name().c_str(), budget_route_->get_used());
+    return;
+  }
+
+  auto remove_callback = [this, client_addr, priority](MySQLRoutingConnection* connection) {
+    // the connection owns this lambda, removing it destroys the captures.
+    // Release everything first, remove last.
+    if (priority) {
+      priority_lane_->release();
+    } else {
+      if (client_limits_) client_limits_->release(client_addr);
+      if (budget_route_) budget_route_->release();
+      release_connection();
+    }
     connection_container_.remove_connection(connection);
   };
 
-  int error = 0;
-  mysql_harness::TCPAddress server_address;
-  int server_socket = destination_->get_server_socket(
-      context_.get_destination_connect_timeout(), &error, &server_address);
+  // connecting to the server is left to the connection's thread (or the
+  // connect threads of the I/O engine) to not stall the acceptor on
+  // slow or unreachable destinations
+  // the connection keeps the destination it got accepted with, even if
+  // change_settings() replaces it
+  std::shared_ptr<RouteDestination> destination = std::atomic_load(&destination_);
+
+  // the servers get told the address the client connected to the router at
+  std::shared_ptr<std::vector<uint8_t>> proxy_header;
+  if (server_proxy_protocol_) {
+    struct sockaddr_storage local_addr;
+    socklen_t local_addr_len = static_cast<socklen_t>(sizeof local_addr);
+    if (getsockname(client_socket, reinterpret_cast<struct sockaddr*>(&local_addr), &local_addr_len) != 0) {
+      local_addr.ss_family = AF_UNSPEC;
+    }
+    proxy_header = std::make_shared<std::vector<uint8_t>>(proxy_protocol::make_header(client_addr, local_addr));
+  }
+
+  const uint64_t client_key = RouteDestination::get_client_key(client_addr);
+  auto server_connector = [this, destination, client_key, proxy_header](mysql_harness::TCPAddress& server_address) {
+    int error = 0;
+    RouteDestination::ConnectDeadline deadline(context_.get_destination_connect_deadline());
+    return send_proxy_header(destination->get_server_socket_for_client(client_key,
+        context_.get_destination_connect_timeout(), &error, &server_address), proxy_header.get());
+  };
 
   std::unique_ptr<MySQLRoutingConnection> new_connection(
       new MySQLRoutingConnection(context_, client_socket, client_addr,
-          server_socket, server_address, remove_callback));
+          routing::kInvalidSocket, mysql_harness::TCPAddress(), remove_callback,
+          server_connector));
+
+  new_connection->set_scoreboard(destination->get_scoreboard());
+  new_connection->set_priority(priority);
+
+  // add to the container before starting, the connection removes itself
+  // from it when it completes
+  if (destination->splits_reads()) {
+    new_connection->set_read_only_connector([this, destination, proxy_header](mysql_harness::TCPAddress& server_address) {
+      int error = 0;
+      RouteDestination::ConnectDeadline deadline(context_.get_destination_connect_deadline());
+      return send_proxy_header(destination->get_read_only_server_socket(
+          context_.get_destination_connect_timeout(), &error, &server_address), proxy_header.get());
+    });
+    new_connection->set_read_your_writes(destination->reads_own_writes());
+  }
 
-  new_connection->start();
+  if (handshake_router_) {
+    new_connection->set_handshake_router(handshake_router_.get(),
+        [this, client_key, proxy_header](RouteDestination &pool, mysql_harness::TCPAddress &server_address) {
+          int error = 0;
+          RouteDestination::ConnectDeadline deadline(context_.get_destination_connect_deadline());
+          return send_proxy_header(pool.get_server_socket_for_client(client_key,
+              context_.get_destination_connect_timeout(), &error, &server_address), proxy_header.get());
+        });
+  }
+
+  if (query_router_) {
+    new_connection->set_query_router(query_router_.get(),
+        [this, client_key, proxy_header](RouteDestination &pool, mysql_harness::TCPAddress &server_address) {
+          int error = 0;
+          RouteDestination::ConnectDeadline deadline(context_.get_destination_connect_deadline());
+          return send_proxy_header(pool.get_server_socket_for_client(client_key,
+              context_.get_destination_connect_timeout(), &error, &server_address), proxy_header.get());
+        });
+  }
+
+  MySQLRoutingConnection* connection = new_connection.get();
   connection_container_.add_connection(std::move(new_connection));
+  connection->start();
+}
+
+int MySQLRouting::send_proxy_header(int server, const std::vector<uint8_t>* header) {
+  if (server < 0 || header == nullptr) return server;
+
+  mysql_harness::SocketOperationsBase* sock_ops = context_.get_socket_operations();
+  // the header is tiny, it fits into the send buffer of a new socket in one go
+  if (sock_ops->write_all(server, const_cast<uint8_t*>(header->data()), header->size()) !=
+      static_cast<ssize_t>(header->size())) {
+    log_warning("[%s] fd=%d failed sending the PROXY header to the server: %s", context_.get_name().c_str(),
+                server, get_message_error(sock_ops->get_errno()).c_str());
+    sock_ops->shutdown(server);
+    sock_ops->close(server);
+    return routing::kInvalidSocket;
+  }
+
+  return server;
+}
+
+void MySQLRouting::set_proxy_protocol(bool client, std::chrono::milliseconds timeout,
+                                      const std::vector<std::string>& trusted_sources, bool server) {
+  if (server && connection_pool_size_ > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] server_proxy_protocol is not supported with connection_pool_size");
+  }
+  if (server && warm_connections_ > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] server_proxy_protocol is not supported with warm_connections");
+  }
+
+  if (client && trusted_sources.empty()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] proxy_protocol needs proxy_protocol_trusted_sources");
+  }
+
+  try {
+    proxy_trusted_sources_.reset(client ? new ClientNetworks(trusted_sources) : nullptr);
+  } catch (const std::invalid_argument& e) {
+    throw std::invalid_argument("[" + context_.get_name() + "] proxy_protocol_trusted_sources: " + e.what());
+  }
+  proxy_protocol_timeout_ = timeout;
+  server_proxy_protocol_ = server;
+}
+
+void MySQLRouting::set_buffer_pool_size(unsigned int buffer_pool_size) {
+  context_.set_buffer_pool_size(buffer_pool_size);
+}
+
+void MySQLRouting::set_buffer_huge_pages(BufferArena::HugePages huge_pages) {
+  if (!BufferArena::is_supported(huge_pages)) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] buffer_huge_pages is not supported on this platform");
+  }
+
+  buffer_huge_pages_ = huge_pages;
+  buffer_arena_ = huge_pages == BufferArena::HugePages::kNone ? nullptr
+                                                             : std::make_shared<BufferArena>(huge_pages);
+  context_.get_buffer_pool().set_arena(buffer_arena_);
+}
+
+void MySQLRouting::set_connection_pool(unsigned int pool_size,
+                                       std::chrono::milliseconds idle_timeout) {
+  connection_pool_size_ = pool_size;
+  connection_pool_idle_timeout_ = idle_timeout;
+}
+
+void MySQLRouting::set_connection_multiplexing(bool multiplexing) {
+  if (multiplexing) {
+    if (connection_pool_size_ == 0) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] connection_multiplexing requires connection_pool_size greater than 0");
+    }
+    if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] connection_multiplexing is only supported for the classic protocol");
+    }
+    if (io_engine_type_ == routing::IOEngine::kEvent) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] connection_multiplexing is not supported with io_engine=event");
+    }
+    if (context_.get_output_queue_high_watermark() > 0) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] connection_multiplexing is not supported with output queues");
+    }
+  }
+
+  context_.set_connection_multiplexing(multiplexing);
+}
+
+void MySQLRouting::set_prepared_statement_cache_size(size_t cache_size) {
+  if (cache_size > 0 && !context_.is_connection_multiplexing()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] prepared_statement_cache_size requires connection_multiplexing");
+  }
+
+  context_.set_prepared_statement_cache_size(cache_size);
+}
+
+void MySQLRouting::set_session_migration(bool migration) {
+  if (migration) {
+    if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] session_migration is only supported for the classic protocol");
+    }
+    if (io_engine_type_ == routing::IOEngine::kEvent) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] session_migration is not supported with io_engine=event");
+    }
+    if (context_.get_output_queue_high_watermark() > 0) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] session_migration is not supported with output queues");
+    }
+  }
+
+  context_.set_session_migration(migration);
+  connection_container_.set_migrates_sessions(migration);
+}
+
+void MySQLRouting::set_client_tls(const std::string& cert_file, const std::string& key_file) {
+  if (cert_file.empty() && key_file.empty()) return;
+
+  if (cert_file.empty() || key_file.empty()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] client_ssl_cert and client_ssl_key need to be set together");
+  }
+  if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] client_ssl_cert is only supported for the classic protocol");
+  }
+  if (connection_pool_size_ > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] client_ssl_cert is not supported with connection_pool_size");
+  }
+  if (io_engine_type_ == routing::IOEngine::kEvent) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] client_ssl_cert is not supported with io_engine=event");
+  }
+
+  try {
+    client_tls_context_.reset(new TlsServerContext(cert_file, key_file));
+  } catch (const std::runtime_error& exc) {
+    throw std::invalid_argument("[" + context_.get_name() + "] " + exc.what());
+  }
+  context_.set_client_tls_context(client_tls_context_.get());
+}
+
+void MySQLRouting::set_client_kernel_tls(bool kernel_tls) {
+  if (!kernel_tls) {
+    if (client_tls_context_) client_tls_context_->set_kernel_tls(false);
+    return;
+  }
+
+  if (!client_tls_context_) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] client_ssl_kernel_tls requires client_ssl_cert");
+  }
+  if (!TlsServerContext::is_kernel_tls_supported()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] client_ssl_kernel_tls is not supported by this build");
+  }
+
+  client_tls_context_->set_kernel_tls(true);
+}
+
+void MySQLRouting::set_server_compression(bool compression) {
+  if (compression) {
+    const bool supported = context_.get_protocol().get_type() == BaseProtocol::Type::kXProtocol
+                               ? XCompression::is_supported()
+                               : ClassicCompression::is_supported();
+    if (!supported) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] server_compression is not supported by this build");
+    }
+    if (connection_pool_size_ > 0) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] server_compression is not supported with connection_pool_size");
+    }
+    if (io_engine_type_ == routing::IOEngine::kEvent) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] server_compression is not supported with io_engine=event");
+    }
+    if (context_.get_output_queue_high_watermark() > 0) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] server_compression is not supported with output queues");
+    }
+    if (client_tls_context_) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] server_compression is not supported with client_ssl_cert");
+    }
+  }
+
+  context_.set_server_compression(compression);
+}
+
+void MySQLRouting::set_query_digest_sampling(uint64_t interval) {
+  if (interval == 0) {
+    context_.set_query_digest_sampling(0, nullptr);
+    return;
+  }
+
+  if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_digest_sampling is only supported for the classic protocol");
+  }
+  if (connection_pool_size_ > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_digest_sampling is not supported with connection_pool_size");
+  }
+  if (client_tls_context_) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_digest_sampling is not supported with client_ssl_cert");
+  }
+  if (context_.is_server_compression()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_digest_sampling is not supported with server_compression");
+  }
+
+  std::shared_ptr<QueryDigestStats> stats = std::make_shared<QueryDigestStats>(routing::kDefaultMaxQueryDigests);
+  context_.set_query_digest_sampling(interval, stats);
+  QueryDigestComponent::getInstance().register_route(context_.get_name(), stats);
+  query_digests_registered_ = true;
+}
+
+void MySQLRouting::set_traffic_mirror(const mysql_harness::TCPAddress& destination, size_t buffer_size,
+                                      bool replay_timing) {
+  if (destination.addr.empty()) {
+    traffic_mirror_.reset();
+    return;
+  }
+
+  if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] mirror_destination is only supported for the classic protocol");
+  }
+  if (connection_pool_size_ > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] mirror_destination is not supported with connection_pool_size");
+  }
+  if (client_tls_context_) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] mirror_destination is not supported with client_ssl_cert");
+  }
+  if (context_.is_server_compression()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] mirror_destination is not supported with server_compression");
+  }
+
+  traffic_mirror_ = std::make_shared<TrafficMirror>(context_.get_socket_operations(), destination, buffer_size,
+                                                    replay_timing, context_.get_destination_connect_timeout());
+}
+
+void MySQLRouting::set_result_cache(size_t cache_size, std::chrono::milliseconds ttl,
+                                    const std::string& statements) {
+  if (cache_size == 0) {
+    if (!statements.empty()) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] result_cache_statements requires result_cache_size");
+    }
+    context_.set_result_cache(nullptr);
+    return;
+  }
+
+  if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] result_cache_size is only supported for the classic protocol");
+  }
+  if (statements.empty()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] result_cache_size requires result_cache_statements");
+  }
+
+  context_.set_result_cache(std::make_shared<ResultCache>(cache_size, ttl, statements));
+}
+
+void MySQLRouting::set_connection_budget(size_t limit, size_t reserved, unsigned int weight) {
+  budget_route_.reset();
+  connection_budget_.reset();
+  if (limit == 0) return;
+
+  auto budget = ConnectionBudget::get_shared();
+  budget->lower_limit(limit);
+  budget_route_ = budget->join(context_.get_name(), reserved, weight);
+  connection_budget_ = budget;
+}
+
+void MySQLRouting::set_priority_lane(const std::vector<std::string>& networks, size_t max_connections) {
+  if (networks.empty()) {
+    priority_lane_.reset();
+    return;
+  }
+
+  try {
+    priority_lane_.reset(new PriorityLane(networks, max_connections));
+  } catch (const std::invalid_argument& e) {
+    throw std::invalid_argument("[" + context_.get_name() + "] priority_clients: " + e.what());
+  }
+}
+
+void MySQLRouting::set_quarantine_interval(std::chrono::milliseconds interval,
+                                           std::chrono::milliseconds max_interval) {
+  if (max_interval < interval) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] quarantine_max_interval needs to be at least quarantine_interval (" +
+                                to_string(interval.count()) + ")");
+  }
+  quarantine_interval_ = interval;
+  quarantine_max_interval_ = max_interval;
+}
+
+void MySQLRouting::set_acceptor_threads(unsigned int acceptor_threads) {
+  if (acceptor_threads == 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] acceptor_threads needs to be greater than 0");
+  }
+#ifndef SO_REUSEPORT
+  if (acceptor_threads > 1) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] more than one acceptor thread requires SO_REUSEPORT which is not supported on this platform");
+  }
+#endif
+
+  acceptor_threads_ = acceptor_threads;
+}
+
+void MySQLRouting::set_splice(bool splice) {
+  if (splice && !SpliceForwarder::is_supported()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] splice is not supported on this platform");
+  }
+
+  context_.set_splice_enabled(splice);
+}
+
+void MySQLRouting::set_socket_options(const routing::SocketOptions& socket_options) {
+#ifndef TCP_FASTOPEN
+  if (socket_options.tcp_fastopen > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_fastopen is not supported on this platform");
+  }
+#endif
+#ifndef TCP_DEFER_ACCEPT
+  if (socket_options.tcp_defer_accept > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_defer_accept is not supported on this platform");
+  }
+#endif
+#if !defined(TCP_KEEPIDLE) && !defined(TCP_KEEPALIVE)
+  if (socket_options.keepalive_idle > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_keepalive_idle is not supported on this platform");
+  }
+#endif
+#ifndef TCP_KEEPINTVL
+  if (socket_options.keepalive_interval > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_keepalive_interval is not supported on this platform");
+  }
+#endif
+#ifndef TCP_KEEPCNT
+  if (socket_options.keepalive_count > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_keepalive_count is not supported on this platform");
+  }
+#endif
+#ifndef TCP_USER_TIMEOUT
+  if (socket_options.user_timeout > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_user_timeout is not supported on this platform");
+  }
+#endif
+#ifndef IP_LOCAL_PORT_RANGE
+  if (socket_options.source_port_low > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] source_port_range is not supported on this platform");
+  }
+#endif
+  if (!socket_options.keepalive &&
+      (socket_options.keepalive_idle > 0 || socket_options.keepalive_interval > 0 ||
+       socket_options.keepalive_count > 0)) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_keepalive_idle, tcp_keepalive_interval and tcp_keepalive_count require tcp_keepalive");
+  }
+  if (socket_options.tcp_defer_accept > 0 &&
+      context_.get_protocol().get_type() == BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] tcp_defer_accept can't be used with the classic protocol, clients wait for the server to talk first");
+  }
+
+  context_.set_socket_options(socket_options);
+}
+
+void MySQLRouting::set_max_net_buffer_length(unsigned int max_net_buffer_length) {
+  if (max_net_buffer_length != 0 && max_net_buffer_length < context_.get_net_buffer_length()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] max_net_buffer_length needs to be 0 or at least net_buffer_length (" +
+                                to_string(context_.get_net_buffer_length()) + ")");
+  }
+
+  context_.set_max_net_buffer_length(max_net_buffer_length);
+}
+
+void MySQLRouting::set_output_queue_watermarks(unsigned int high_watermark,
+                                               unsigned int low_watermark) {
+  if (high_watermark == 0) {
+    context_.set_output_queue_watermarks(0, 0);
+    return;
+  }
+  if (!OutputQueue::is_supported()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] output queues are not supported on this platform");
+  }
+  if (low_watermark > high_watermark) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] output_queue_low_watermark needs to be less than or equal to output_queue_high_watermark");
+  }
+
+  context_.set_output_queue_watermarks(high_watermark, low_watermark);
+}
+
+void MySQLRouting::set_zero_copy_threshold(unsigned int threshold) {
+  if (threshold > 0) {
+    if (!ZeroCopySender::is_supported()) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] zero_copy_threshold is not supported on this platform");
+    }
+    if (context_.get_output_queue_high_watermark() == 0) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] zero_copy_threshold requires output queues");
+    }
+  }
+
+  context_.set_zero_copy_threshold(threshold);
+}
+
+void MySQLRouting::set_io_engine(routing::IOEngine io_engine, unsigned int io_threads) {
+  if (io_engine == routing::IOEngine::kUndefined) {
+    throw std::invalid_argument("[" + context_.get_name() + "] I/O engine is not defined");
+  }
+  if (io_engine == routing::IOEngine::kEvent && !RoutingIOEngine::is_supported()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] event I/O engine is not supported on this platform");
+  }
+
+  io_engine_type_ = io_engine;
+  io_threads_ = io_threads;
+}
+
+void MySQLRouting::set_io_uring(bool io_uring) {
+  if (io_uring && io_engine_type_ != routing::IOEngine::kEvent) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] io_uring requires io_engine=event");
+  }
+
+  io_uring_ = io_uring;
+}
+
+void MySQLRouting::set_fair_share(size_t quantum, uint64_t max_bandwidth) {
+  if (max_bandwidth > 0 && io_engine_type_ != routing::IOEngine::kEvent) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] max_bandwidth requires io_engine=event");
+  }
+
+  fair_share_quantum_ = quantum;
+  max_bandwidth_ = max_bandwidth;
 }
 
 static int get_socket_errno() {
@@ -468,6 +1651,21 @@ void MySQLRouting::setup_tcp_service() {
     }
 #endif
 
+#ifdef SO_REUSEPORT
+    // the listeners of the other acceptor threads bind to the same address
+    if (acceptor_threads_ > 1 &&
+        context_.get_socket_operations()->setsockopt(service_tcp_, SOL_SOCKET, SO_REUSEPORT, &option_value,
+            static_cast<socklen_t>(sizeof(int))) == -1) {
+      error = get_message_error(get_socket_errno());
+      log_warning("[%s] setup_tcp_service() error from setsockopt(SO_REUSEPORT): %s", context_.get_name().c_str(), error.c_str());
+      context_.get_socket_operations()->close(service_tcp_);
+      service_tcp_ = routing::kInvalidSocket;
+      continue;
+    }
+#endif
+
+    set_listener_options(service_tcp_);
+
     if (context_.get_socket_operations()->bind(service_tcp_, info->ai_addr, info->ai_addrlen) == -1) {
       error = get_message_error(get_socket_errno());
       log_warning("[%s] setup_tcp_service() error from bind(): %s", context_.get_name().c_str(), error.c_str());
@@ -486,6 +1684,79 @@ void MySQLRouting::setup_tcp_service() {
   if (context_.get_socket_operations()->listen(service_tcp_, kListenQueueSize) < 0) {
     throw runtime_error(string_format("[%s] Failed to start listening for connections using TCP", context_.get_name().c_str()));
   }
+
+  if (acceptor_threads_ > 1) {
+    setup_reuseport_listeners(info);
+  }
+}
+
+void MySQLRouting::setup_reuseport_listeners(const struct addrinfo* info) {
+#ifdef SO_REUSEPORT
+  auto so = context_.get_socket_operations();
+
+  while (service_tcp_reuseport_.size() + 1 < acceptor_threads_) {
+    int sock = so->socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (sock == -1) {
+      throw runtime_error(string_format("[%s] Failed to create TCP listener: %s",
+          context_.get_name().c_str(), get_message_error(get_socket_errno()).c_str()));
+    }
+    // closed by the destructor on failures below
+    service_tcp_reuseport_.push_back(sock);
+
+    int option_value = 1;
+    if (so->setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &option_value, static_cast<socklen_t>(sizeof(int))) == -1 ||
+        so->setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &option_value, static_cast<socklen_t>(sizeof(int))) == -1) {
+      throw runtime_error(string_format("[%s] Failed to set SO_REUSEPORT on TCP listener: %s",
+          context_.get_name().c_str(), get_message_error(get_socket_errno()).c_str()));
+    }
+
+    set_listener_options(sock);
+
+    if (so->bind(sock, info->ai_addr, info->ai_addrlen) == -1) {
+      throw runtime_error(string_format("[%s] Failed to bind TCP listener: %s",
+          context_.get_name().c_str(), get_message_error(get_socket_errno()).c_str()));
+    }
+
+    if (so->listen(sock, kListenQueueSize) < 0) {
+      throw runtime_error(string_format("[%s] Failed to start listening for connections using TCP", context_.get_name().c_str()));
+    }
+  }
+#else
+  (void)info;
+#endif
+}
+
+void MySQLRouting::set_listener_options(int sock) {
+  auto so = context_.get_socket_operations();
+  const routing::SocketOptions& options = context_.get_socket_options();
+
+  auto set_option = [&](int level, int option, unsigned int value, const char* name) {
+    if (value == 0) return;
+
+    int option_value = static_cast<int>(value);
+    if (so->setsockopt(sock, level, option, &option_value, static_cast<socklen_t>(sizeof(int))) == -1) {
+      log_warning("[%s] setting %s on TCP listener failed, continuing without it: %s",
+          context_.get_name().c_str(), name, get_message_error(get_socket_errno()).c_str());
+    }
+  };
+
+  set_option(SOL_SOCKET, SO_RCVBUF, options.rcvbuf, "SO_RCVBUF");
+  set_option(SOL_SOCKET, SO_SNDBUF, options.sndbuf, "SO_SNDBUF");
+#ifdef TCP_FASTOPEN
+#  ifdef __linux__
+  // Linux takes the max number of pending Fast Open requests
+  set_option(IPPROTO_TCP, TCP_FASTOPEN, options.tcp_fastopen, "TCP_FASTOPEN");
+#  else
+  set_option(IPPROTO_TCP, TCP_FASTOPEN, options.tcp_fastopen > 0 ? 1 : 0, "TCP_FASTOPEN");
+#  endif
+#endif
+#ifdef TCP_DEFER_ACCEPT
+  set_option(IPPROTO_TCP, TCP_DEFER_ACCEPT, options.tcp_defer_accept, "TCP_DEFER_ACCEPT");
+#endif
+  // accepted sockets inherit them, like the buffer sizes
+  for (const auto& option : routing::get_dead_peer_socket_options(options)) {
+    set_option(option.level, option.option, static_cast<unsigned int>(option.value), option.name);
+  }
 }
 
 #ifndef _WIN32
@@ -551,21 +1822,163 @@ retry:
 #endif
 
 void MySQLRouting::set_destinations_from_uri(const URI &uri) {
-  if (uri.scheme == "metadata-cache") {
-    // Syntax: metadata_cache://[<metadata_cache_key(unused)>]/<replicaset_name>?role=PRIMARY|SECONDARY|PRIMARY_AND_SECONDARY
-    std::string replicaset_name = kDefaultReplicaSetName;
+  std::shared_ptr<RouteDestination> destination = create_destinations_from_uri(uri);
+  // the I/O threads can't wait for the responses of secondaries
+  if (destination->splits_reads() && io_engine_type_ == routing::IOEngine::kEvent) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] read_write_splitting is not supported with io_engine=event");
+  }
 
-    if (uri.path.size() > 0 && !uri.path[0].empty())
-      replicaset_name = uri.path[0];
+  std::lock_guard<std::mutex> lock(settings_mtx_);
+  destination_ = std::move(destination);
+  static_destinations_ = false;
+}
 
-    destination_.reset(new DestMetadataCacheGroup(uri.host, replicaset_name,
-                                                  routing_strategy_,
-                                                  uri.query, context_.get_protocol().get_type(),
-                                                  access_mode_));
-  } else {
+std::shared_ptr<RouteDestination> MySQLRouting::create_destinations_from_uri(const URI &uri) {
+  if (uri.scheme != "metadata-cache") {
     throw runtime_error(string_format("Invalid URI scheme; expecting: 'metadata-cache' is: '%s'",
                                       uri.scheme.c_str()));
   }
+
+  // Syntax: metadata_cache://[<metadata_cache_key(unused)>]/[<cluster_name>/]<replicaset_name>?role=PRIMARY|SECONDARY|PRIMARY_AND_SECONDARY
+  //
+  // the cluster name picks the replicaset of a metadata cache that serves
+  // several clusters
+  std::string replicaset_name = kDefaultReplicaSetName;
+
+  if (uri.path.size() > 1 && !uri.path[0].empty()) {
+    replicaset_name = metadata_cache::qualified_replicaset_name(
+        uri.path[0], uri.path[1].empty() ? kDefaultReplicaSetName : uri.path[1]);
+  } else if (uri.path.size() > 0 && !uri.path[0].empty()) {
+    replicaset_name = uri.path[0];
+  }
+
+  return std::make_shared<DestMetadataCacheGroup>(uri.host, replicaset_name,
+                                                  routing_strategy_,
+                                                  uri.query, context_.get_protocol().get_type(),
+                                                  access_mode_);
+}
+
+void MySQLRouting::set_destination_sockets(const std::string &sockets) {
+  if (sockets.empty()) {
+    unix_sockets_.reset();
+    return;
+  }
+
+  auto unix_sockets = std::make_shared<RouteDestination::UnixSockets>();
+  for (std::string entry : mysqlrouter::split_string(sockets, ',', false)) {
+    mysqlrouter::trim(entry);
+    const size_t eq = entry.find('=');
+    if (eq == std::string::npos || !routing::is_unix_socket_destination(entry.substr(eq + 1))) {
+      throw std::invalid_argument("[" + context_.get_name() + "] destination_sockets expects host:port=" +
+                                  routing::kUnixSocketPrefix + "/path entries, got '" + entry + "'");
+    }
+
+    try {
+      std::pair<std::string, uint16_t> info = mysqlrouter::split_addr_port(entry.substr(0, eq));
+      if (info.second == 0) {
+        info.second = Protocol::get_default_port(context_.get_protocol().get_type());
+      }
+      unix_sockets->emplace(TCPAddress(info.first, info.second),
+                            routing::get_unix_socket_address(entry.substr(eq + 1)));
+    } catch (const std::runtime_error &exc) {
+      throw std::invalid_argument("[" + context_.get_name() + "] destination_sockets entry '" + entry +
+                                  "' is invalid: " + exc.what());
+    }
+  }
+
+  unix_sockets_ = unix_sockets;
+}
+
+void MySQLRouting::set_route_by(const std::string &route_by, const std::string &route_map) {
+  if (route_by.empty()) {
+    if (!route_map.empty()) {
+      throw std::invalid_argument("[" + context_.get_name() + "] route_map requires route_by");
+    }
+    return;
+  }
+
+  if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] route_by is only supported for the classic protocol");
+  }
+  // the router takes part in the handshake like for pooled connections
+  if (connection_pool_size_ > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] route_by is not supported with connection_pool_size");
+  }
+  if (client_tls_context_) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] route_by is not supported with client_ssl_cert");
+  }
+  if (context_.is_server_compression()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] route_by is not supported with server_compression");
+  }
+
+  std::unique_ptr<HandshakeRouter> handshake_router;
+  try {
+    handshake_router.reset(new HandshakeRouter(route_by));
+    for (const auto &entry : HandshakeRouter::parse_route_map(route_map)) {
+      handshake_router->add_pool(entry.first, create_pool_destinations(entry.second));
+    }
+  } catch (const std::invalid_argument &exc) {
+    throw std::invalid_argument("[" + context_.get_name() + "] " + exc.what());
+  }
+
+  std::lock_guard<std::mutex> lock(settings_mtx_);
+  handshake_router_ = std::move(handshake_router);
+}
+
+void MySQLRouting::set_query_route_map(const std::string &query_route_map) {
+  if (query_route_map.empty()) return;
+
+  if (context_.get_protocol().get_type() != BaseProtocol::Type::kClassicProtocol) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_route_map is only supported for the classic protocol");
+  }
+  // the statements are only seen by connections that inspect them
+  if (client_tls_context_) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_route_map is not supported with client_ssl_cert");
+  }
+  if (context_.is_server_compression()) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_route_map is not supported with server_compression");
+  }
+  if (io_engine_type_ == routing::IOEngine::kEvent) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_route_map is not supported with io_engine=event");
+  }
+  if (context_.get_output_queue_high_watermark() > 0) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] query_route_map is not supported with output queues");
+  }
+
+  std::unique_ptr<QueryRouter> query_router(new QueryRouter());
+  try {
+    for (const auto &entry : HandshakeRouter::parse_route_map(query_route_map, "query_route_map")) {
+      query_router->add_pool(entry.first, create_pool_destinations(entry.second));
+    }
+  } catch (const std::invalid_argument &exc) {
+    throw std::invalid_argument("[" + context_.get_name() + "] " + exc.what());
+  }
+
+  std::lock_guard<std::mutex> lock(settings_mtx_);
+  query_router_ = std::move(query_router);
+}
+
+std::shared_ptr<RouteDestination> MySQLRouting::create_pool_destinations(const std::string &destinations) {
+  if (routing::is_unix_socket_destination(destinations)) {
+    // would parse as URI too
+    return create_destinations_from_csv(destinations);
+  }
+  try {
+    // don't allow rootless URIs, like for the destinations
+    return create_destinations_from_uri(URI(destinations, false));
+  } catch (URIError &) {
+    return create_destinations_from_csv(destinations);
+  }
 }
 
 namespace {
@@ -586,7 +1999,8 @@ routing::RoutingStrategy get_default_routing_strategy(const routing::AccessMode
 RouteDestination* create_standalone_destination(const routing::RoutingStrategy strategy,
                                                 const Protocol::Type protocol,
                                                 routing::RoutingSockOpsInterface *routing_sock_ops,
-                                                size_t thread_stack_size) {
+                                                size_t thread_stack_size,
+                                                const std::vector<unsigned int>& weights) {
   switch (strategy) {
     case RoutingStrategy::kFirstAvailable:
       return new DestFirstAvailable(protocol, routing_sock_ops);
@@ -594,6 +2008,15 @@ RouteDestination* create_standalone_destination(const routing::RoutingStrategy s
       return new DestNextAvailable(protocol, routing_sock_ops);
     case RoutingStrategy::kRoundRobin:
       return new DestRoundRobin(protocol, routing_sock_ops, thread_stack_size);
+    case RoutingStrategy::kLeastConnections:
+      // counts the connections on the scoreboard
+      return new DestLeastConnections(nullptr, protocol, routing_sock_ops, thread_stack_size);
+    case RoutingStrategy::kWeightedRoundRobin:
+      return new DestWeightedRoundRobin(weights, protocol, routing_sock_ops, thread_stack_size);
+    case RoutingStrategy::kLowestLatency:
+      return new DestLowestLatency(protocol, routing_sock_ops, thread_stack_size);
+    case RoutingStrategy::kConsistentHash:
+      return new DestConsistentHash(protocol, routing_sock_ops, thread_stack_size);
     case RoutingStrategy::kUndefined:
     case RoutingStrategy::kRoundRobinWithFallback:
       ; // unsupported, fall through
@@ -605,6 +2028,12 @@ RouteDestination* create_standalone_destination(const routing::RoutingStrategy s
 }
 
 void MySQLRouting::set_destinations_from_csv(const string &csv) {
+  std::lock_guard<std::mutex> lock(settings_mtx_);
+  destination_ = create_destinations_from_csv(csv);
+  static_destinations_ = true;
+}
+
+std::shared_ptr<RouteDestination> MySQLRouting::create_destinations_from_csv(const string &csv) {
   std::stringstream ss(csv);
   std::string part;
   std::pair<std::string, uint16_t> info;
@@ -615,34 +2044,167 @@ void MySQLRouting::set_destinations_from_csv(const string &csv) {
     routing_strategy_ = get_default_routing_strategy(access_mode_);
   }
 
-  destination_.reset(create_standalone_destination(routing_strategy_,
+  std::shared_ptr<RouteDestination> destination(create_standalone_destination(routing_strategy_,
                                                    context_.get_protocol().get_type(),
-                                                   routing_sock_ops_, context_.get_thread_stack_size()));
+                                                   routing_sock_ops_, context_.get_thread_stack_size(),
+                                                   destination_weights_));
 
   // Fall back to comma separated list of MySQL servers
+  size_t num_destinations = 0;
   while (std::getline(ss, part, ',')) {
+    ++num_destinations;
+    if (routing::is_unix_socket_destination(part)) {
+      destination->add(routing::get_unix_socket_address(part));
+      continue;
+    }
     info = mysqlrouter::split_addr_port(part);
     if (info.second == 0) {
       info.second = Protocol::get_default_port(context_.get_protocol().get_type());
     }
     TCPAddress addr(info.first, info.second);
     if (addr.is_valid()) {
-      destination_->add(addr);
+      destination->add(addr);
     } else {
       throw std::runtime_error(string_format("Destination address '%s' is invalid", addr.str().c_str()));
     }
   }
 
   // Check whether bind address is part of list of destinations
-  for (auto &it: *(destination_)) {
+  for (auto &it: *(destination)) {
     if (it == context_.get_bind_address()) {
       throw std::runtime_error("Bind Address can not be part of destinations");
     }
   }
 
-  if (destination_->size() == 0) {
+  if (destination->size() == 0) {
     throw std::runtime_error("No destinations available");
   }
+
+  if (!destination_weights_.empty() && destination_weights_.size() != num_destinations) {
+    throw std::invalid_argument("[" + context_.get_name() + "] destination_weights needs one weight per destination (" +
+                                to_string(num_destinations) + "), got " + to_string(destination_weights_.size()));
+  }
+
+  return destination;
+}
+
+void MySQLRouting::setup_destination(RouteDestination &destination) {
+  destination.set_socket_options(context_.get_socket_options());
+  destination.set_unix_sockets(unix_sockets_);
+  destination.set_metrics(context_.get_metrics());
+  destination.set_warm_pool(warm_pool_);
+  destination.set_quarantine_interval(quarantine_interval_, quarantine_max_interval_);
+  destination.set_latency_tolerance(latency_tolerance_);
+  destination.set_connect_hedging(connect_hedge_percentile_);
+  destination.set_destination_limits(max_connections_per_destination_, slow_start_window_);
+  destination.set_circuit_breaker(circuit_breaker_failures_, circuit_breaker_open_interval_,
+                                  circuit_breaker_half_open_connections_);
+}
+
+RouteSettings MySQLRouting::get_settings() {
+  std::lock_guard<std::mutex> lock(settings_mtx_);
+
+  RouteSettings settings;
+  settings.max_connections = get_max_connections();
+  settings.net_buffer_length = context_.get_net_buffer_length();
+  settings.static_destinations = static_destinations_;
+
+  // the static destinations don't change once created, the ones of the
+  // metadata cache may change any time
+  if (static_destinations_ && destination_) {
+    for (const auto &dest: *destination_) {
+      settings.destinations.push_back(dest.str());
+    }
+  }
+
+  return settings;
+}
+
+RouteConnectionsPage MySQLRouting::get_connections(size_t cursor, size_t limit) {
+  return connection_container_.get_connections(cursor, limit);
+}
+
+std::vector<RouteDestinationScore> MySQLRouting::get_destination_scores() {
+  std::shared_ptr<RouteDestination> destination = std::atomic_load(&destination_);
+  if (!destination) return {};
+
+  return destination->get_scoreboard()->get_scores();
+}
+
+void MySQLRouting::change_settings(const RouteSettingsChange &change) {
+  std::lock_guard<std::mutex> lock(settings_mtx_);
+
+  // validate all changes before applying one
+  if (change.change_max_connections) {
+    validate_max_connections(change.max_connections);
+  }
+
+  if (change.change_net_buffer_length) {
+    // same range as the net_buffer_length option
+    if (change.net_buffer_length < 1024 || change.net_buffer_length > 1048576) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] net_buffer_length needs to be between 1024 and 1048576, was " +
+                                  to_string(change.net_buffer_length));
+    }
+
+    const size_t max_net_buffer_length = context_.get_max_net_buffer_length();
+    if (max_net_buffer_length != 0 && change.net_buffer_length > max_net_buffer_length) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] net_buffer_length needs to be at most max_net_buffer_length (" +
+                                  to_string(max_net_buffer_length) + ")");
+    }
+  }
+
+  std::shared_ptr<RouteDestination> destination;
+  if (change.change_destinations) {
+    if (!static_destinations_) {
+      throw std::invalid_argument("[" + context_.get_name() +
+                                  "] destinations can only be changed if they are a list of servers");
+    }
+
+    std::string csv;
+    for (const auto &dest: change.destinations) {
+      if (!csv.empty()) csv += ",";
+      csv += dest;
+    }
+
+    try {
+      destination = create_destinations_from_csv(csv);
+    } catch (const std::runtime_error &e) {
+      throw std::invalid_argument("[" + context_.get_name() + "] " + e.what());
+    }
+
+    if (destination_started_) {
+      setup_destination(*destination);
+      destination->start();
+    }
+  }
+
+  if (change.change_max_connections) {
+    max_connections_.store(change.max_connections, std::memory_order_relaxed);
+    log_info("[%s] max_connections changed to %d", context_.get_name().c_str(), change.max_connections);
+  }
+
+  if (change.change_net_buffer_length) {
+    context_.set_net_buffer_length(change.net_buffer_length);
+    log_info("[%s] net_buffer_length changed to %u", context_.get_name().c_str(), change.net_buffer_length);
+  }
+
+  if (destination) {
+    // servers no longer routed to aren't warmed up anymore, the others get warmed up again
+    if (warm_pool_) warm_pool_->clear();
+    // connections accepted so far keep the previous destination
+    std::atomic_store(&destination_, destination);
+    log_info("[%s] destinations changed to %zu servers", context_.get_name().c_str(), destination->size());
+  }
+}
+
+void MySQLRouting::set_destination_weights(const std::vector<unsigned int>& weights) {
+  if (!weights.empty() && routing_strategy_ != RoutingStrategy::kWeightedRoundRobin) {
+    throw std::invalid_argument("[" + context_.get_name() +
+                                "] destination_weights requires routing_strategy=weighted-round-robin");
+  }
+  destination_weights_ = weights;
 }
 
 void MySQLRouting::validate_destination_connect_timeout(std::chrono::milliseconds timeout) {
@@ -652,12 +2214,16 @@ void MySQLRouting::validate_destination_connect_timeout(std::chrono::millisecond
   }
 }
 
-int MySQLRouting::set_max_connections(int maximum) {
+void MySQLRouting::validate_max_connections(int maximum) {
   if (maximum <= 0 || maximum > UINT16_MAX) {
     auto err = string_format("[%s] tried to set max_connections using invalid value, was '%d'", context_.get_name().c_str(),
                              maximum);
     throw std::invalid_argument(err);
   }
-  max_connections_ = maximum;
-  return max_connections_;
+}
+
+int MySQLRouting::set_max_connections(int maximum) {
+  validate_max_connections(maximum);
+  max_connections_.store(maximum, std::memory_order_relaxed);
+  return maximum;
 }
@@ -41,18 +41,36 @@
 #include "plugin_config.h"
 #include "utils.h"
 #include "mysqlrouter/routing.h"
+#include "mysqlrouter/routing_control.h"
 #include "mysql_router_thread.h"
 #include "tcp_address.h"
 #include "connection.h"
 #include "context.h"
 #include "connection_container.h"
+#include "io_engine.h"
+#include "backend_pool.h"
+#include "handshake_router.h"
+#include "query_router.h"
+#include "tls_server_context.h"
+#include "socket_handoff.h"
+#include "admission_queue.h"
+#include "client_limits.h"
+#include "connection_budget.h"
+#include "priority_lane.h"
+#include "proxy_header_receiver.h"
+#include "traffic_mirror.h"
+#include "warm_connection_pool.h"
 namespace mysql_harness { class PluginFuncEnv; }
 
 #include <array>
 #include <atomic>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #ifndef _WIN32
 #  include <arpa/inet.h>
@@ -116,8 +134,12 @@ using mysqlrouter::URI;
  *  The above example will, when MySQL running on 10.0.10.5 is not available,
  *  use 10.0.11.6 to setup the connection routing.
  *
+ *  max_connections, net_buffer_length and static destinations can be changed
+ *  while the route runs through RouteControl, which is registered with the
+ *  RoutingControlComponent.
+ *
  */
-class MySQLRouting {
+class MySQLRouting : public RouteControl {
 public:
   /** @brief Default constructor
    *
@@ -181,6 +203,55 @@ public:
 
   void set_destinations_from_uri(const mysqlrouter::URI &uri);
 
+  /** @brief Lets the handshake of the clients pick their destinations
+   *
+   * The clients get routed to the pools of route_map by their username,
+   * schema or a connection attribute, the others to the destinations of
+   * the route. Has to be called after the destinations got set, the pools
+   * use the routing strategy of the route. See HandshakeRouter.
+   *
+   * @throw std::invalid_argument if route_by or route_map are invalid or
+   *        other settings of the route don't allow it
+   * @throw std::runtime_error if destinations of route_map are invalid
+   *
+   * @param route_by `user`, `schema` or `attribute:<name>`, empty to not route by handshake
+   * @param route_map `<key>=<destinations>` entries separated by ';'
+   */
+  void set_route_by(const std::string &route_by, const std::string &route_map);
+
+  /** @brief Lets the leading comment of statements pick their destinations
+   *
+   * Read-only statements outside of a transaction starting with a comment
+   * like `route=<pool>` or the hint `route(<pool>)` are run by a server of
+   * the pool of that name instead of the servers of the route, e.g. a
+   * dedicated analytics secondary. Everything else stays with the session
+   * of the client. Only routes whose sessions get inspected, see
+   * set_connection_multiplexing(), read_write_splitting and
+   * set_session_migration(), look at the statements. Has to be called after
+   * the destinations got set, the pools use the routing strategy of the
+   * route. See QueryRouter.
+   *
+   * @throw std::invalid_argument if query_route_map is invalid or other
+   *        settings of the route don't allow it
+   * @throw std::runtime_error if destinations of query_route_map are invalid
+   *
+   * @param query_route_map `<pool>=<destinations>` entries separated by ';', empty to not route by comment
+   */
+  void set_query_route_map(const std::string &query_route_map);
+
+  /** @brief Sets the servers that get connected at a unix socket
+   *
+   * For servers on the host of the router that are known by their TCP
+   * address, like the ones of the metadata cache. Servers of a list of
+   * destinations can be given as unix:// sockets right away. See
+   * RouteDestination::set_unix_sockets(). Needs to be called before start().
+   *
+   * @param sockets comma separated host:port=unix:///path entries, empty for none
+   *
+   * @throws std::invalid_argument if an entry is invalid
+   */
+  void set_destination_sockets(const std::string &sockets);
+
   /** @brief Returns timeout when connecting to destination
    *
    * @return Timeout in seconds as int
@@ -216,20 +287,739 @@ public:
    * @return Maximum as int
    */
   int get_max_connections() const noexcept {
-    return max_connections_;
+    return max_connections_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Returns the settings which can be changed while the route runs */
+  RouteSettings get_settings() override;
+
+  /** @brief Changes settings while the route runs
+   *
+   * All changes are validated before any is applied. New connections get
+   * the new settings, established connections keep the destination and
+   * buffer size they started with. Destinations can only be changed if
+   * they were set by set_destinations_from_csv().
+   *
+   * @throw std::invalid_argument if a change is not valid
+   *
+   * @param change settings to change
+   */
+  void change_settings(const RouteSettingsChange &change) override;
+
+  /** @brief Lists the client connections of the route, a page at a time */
+  RouteConnectionsPage get_connections(size_t cursor, size_t limit) override;
+
+  /** @brief Lists the scores of the servers of the current destination
+   *
+   * Replacing the destinations with change_settings() starts a new
+   * scoreboard.
+   */
+  std::vector<RouteDestinationScore> get_destination_scores() override;
+
+  /** @brief Sets the I/O engine serving the connections
+   *
+   * With routing::IOEngine::kThread every connection runs in its own
+   * thread. With routing::IOEngine::kEvent the connections are multiplexed
+   * over io_threads I/O threads. Takes effect when start() is called.
+   *
+   * @throw std::invalid_argument when the I/O engine is not valid
+   *
+   * @param io_engine I/O engine to use
+   * @param io_threads number of I/O threads, 0 for one per CPU
+   */
+  void set_io_engine(routing::IOEngine io_engine, unsigned int io_threads);
+
+  /** @brief Returns the I/O engine serving the connections */
+  routing::IOEngine get_io_engine() const noexcept {
+    return io_engine_type_;
+  }
+
+  /** @brief Returns number of I/O threads used by the event engine */
+  unsigned int get_io_threads() const noexcept {
+    return io_threads_;
+  }
+
+  /** @brief Lets the event engine watch the sockets using io_uring
+   *
+   * Falls back to epoll if the kernel doesn't support io_uring. Takes
+   * effect when start() is called. Needs to be called after set_io_engine().
+   *
+   * @throw std::invalid_argument if enabled and the I/O engine is not
+   *        routing::IOEngine::kEvent
+   *
+   * @param io_uring true to use io_uring
+   */
+  void set_io_uring(bool io_uring);
+
+  /** @brief Shares the bandwidth of the event engine between the connections
+   *
+   * The I/O threads serve their connections by deficit round-robin, see
+   * FairScheduler: connections forwarding more than quantum bytes per
+   * round wait for their turn, so small requests keep their latency next
+   * to bulk transfers. Optionally the bytes the route forwards per second
+   * are limited. Takes effect when start() is called. Needs to be called
+   * after set_io_engine().
+   *
+   * @throw std::invalid_argument if a limit is set and the I/O engine is
+   *        not routing::IOEngine::kEvent
+   *
+   * @param quantum bytes per round, 0 to not share
+   * @param max_bandwidth bytes per second of the whole route, 0 for no limit
+   */
+  void set_fair_share(size_t quantum, uint64_t max_bandwidth);
+
+  /** @brief Enables forwarding classic protocol traffic using splice()
+   *
+   * Once the handshake is done, data is moved between the sockets through
+   * a pipe without being copied into the router's memory. Connections fall
+   * back to copying if splicing fails.
+   *
+   * @throw std::invalid_argument if splice() is not supported on this platform
+   *
+   * @param splice true to enable splicing
+   */
+  void set_splice(bool splice);
+
+  /** @brief Enables non-blocking forwarding with per direction output queues
+   *
+   * Once the handshake is done, data the receiving socket does not take
+   * right away is queued and written when the socket becomes writable
+   * again, leaving the traffic in the other direction unaffected. Reading
+   * from the sending side is paused once its queue reaches high_watermark
+   * bytes and resumed once it drained to low_watermark bytes.
+   *
+   * Takes precedence over splice.
+   *
+   * @throw std::invalid_argument if low_watermark is greater than
+   *        high_watermark or output queues are not supported on this platform
+   *
+   * @param high_watermark queue size pausing reads, 0 keeps blocking writes
+   * @param low_watermark queue size resuming reads
+   */
+  void set_output_queue_watermarks(unsigned int high_watermark, unsigned int low_watermark);
+
+  /** @brief Sends data of threshold bytes or more to the clients using MSG_ZEROCOPY
+   *
+   * Applies to the data the output queues write right away. The kernel
+   * sends from the read buffer itself instead of a copy, the buffer goes
+   * back to the pool once the kernel reports the send as completed.
+   * Clients on which the kernel copies the data anyway, like on loopback,
+   * fall back to copying.
+   *
+   * Needs to be called after set_output_queue_watermarks().
+   *
+   * @throw std::invalid_argument if MSG_ZEROCOPY is not supported on this
+   *        platform or output queues are not used
+   *
+   * @param threshold smallest write sent using MSG_ZEROCOPY, 0 to always copy
+   */
+  void set_zero_copy_threshold(unsigned int threshold);
+
+  /** @brief Sets max number of idle buffers kept by each buffer pool
+   *
+   * Connections borrow buffers from a pool only while forwarding data. The
+   * event I/O engine keeps a pool per I/O thread, connections running in
+   * their own thread share one pool.
+   *
+   * @param buffer_pool_size max number of idle buffers kept for reuse
+   */
+  void set_buffer_pool_size(unsigned int buffer_pool_size);
+
+  /** @brief Takes the buffers of the buffer pools from arenas backed by huge pages
+   *
+   * The buffers are carved from slabs of 2MB, see BufferArena, so that
+   * forwarding for many connections misses the TLB less. Each I/O thread of
+   * the event I/O engine gets an arena of its own. Slabs fall back to
+   * normal pages if the kernel provides no huge pages.
+   *
+   * @throw std::invalid_argument if huge pages are not supported on this
+   *        platform
+   *
+   * @param huge_pages pages backing the buffers, kNone for buffers from the heap
+   */
+  void set_buffer_huge_pages(BufferArena::HugePages huge_pages);
+
+  /** @brief Sets options of the TCP listeners and server connections
+   *
+   * TCP_FASTOPEN and TCP_DEFER_ACCEPT are set on the TCP listeners,
+   * SO_RCVBUF and SO_SNDBUF on the listeners, whose accepted sockets inherit
+   * them, and on the server connections before connecting. SO_KEEPALIVE,
+   * the keepalive timings and TCP_USER_TIMEOUT are set the same way, they
+   * let a peer that went away without a RST be noticed in seconds. Options
+   * the kernel refuses are logged and ignored. Takes effect when start() is
+   * called.
+   *
+   * @throw std::invalid_argument if an option is not supported on this
+   *        platform, keepalive timings are set without keepalive, or
+   *        TCP_DEFER_ACCEPT is set for the classic protocol, in which the
+   *        client waits for the server to talk first
+   *
+   * @param socket_options options to apply, 0 keeps the system defaults
+   */
+  void set_socket_options(const routing::SocketOptions& socket_options);
+
+  /** @brief Lets the read buffer of busy connections grow
+   *
+   * Connections start reading into net_buffer_length sized buffers of the
+   * pool. The buffer of a connection whose reads keep filling it doubles up
+   * to max_net_buffer_length bytes and shrinks back once the reads get
+   * small again.
+   *
+   * @throw std::invalid_argument if max_net_buffer_length is not 0 and less
+   *        than net_buffer_length
+   *
+   * @param max_net_buffer_length largest read buffer, 0 disables growing
+   */
+  void set_max_net_buffer_length(unsigned int max_net_buffer_length);
+
+  /** @brief Enables pooling of the server connections
+   *
+   * Connections to the servers are kept open once clients quit and get
+   * reused by new clients using COM_CHANGE_USER. With the X protocol the
+   * session gets closed with Session.Reset once the client sent
+   * Session.Close and the next client with the same capabilities
+   * authenticates on it.
+   *
+   * @param pool_size max number of idle server connections, 0 disables pooling
+   * @param idle_timeout time after which idle server connections are closed
+   */
+  void set_connection_pool(unsigned int pool_size, std::chrono::milliseconds idle_timeout);
+
+  /** @brief Lets clients share the pooled server connections between transactions
+   *
+   * Once a command outside of a transaction got its response, the clean
+   * session of the server connection goes back to the pool and the next
+   * command of the client takes a session of the same user, schema,
+   * character set and capabilities, or a new connection authenticated
+   * with the password of the user stored in the keyring. Sessions with
+   * state of the client (SET, USE, temporary tables, locks, ...) keep their
+   * server connection.
+   *
+   * Needs to be called after set_connection_pool(), set_io_engine() and
+   * set_output_queue_watermarks().
+   *
+   * @throw std::invalid_argument if enabled without connection pool, for
+   *        the X protocol, with the event I/O engine or with output queues
+   *
+   * @param multiplexing true to release server connections between transactions
+   */
+  void set_connection_multiplexing(bool multiplexing);
+
+  /** @brief Lets multiplexed clients use prepared statements
+   *
+   * Statement ids are only valid in the server session that prepared the
+   * statement. With a cache size greater than 0 clients get statement ids
+   * assigned by the router, which prepares the statements in whichever
+   * server session serves the next command and keeps up to cache_size of
+   * them prepared per session, by statement text. A client preparing a
+   * statement already prepared in its session gets the response without
+   * asking the server. With 0, prepared statements pin the session of the
+   * client to its server connection.
+   *
+   * Needs to be called after set_connection_multiplexing().
+   *
+   * @throw std::invalid_argument if enabled without connection multiplexing
+   *
+   * @param cache_size statements kept prepared per server session
+   */
+  void set_prepared_statement_cache_size(size_t cache_size);
+
+  /** @brief Moves idle sessions to another server when theirs leaves the destinations
+   *
+   * Instead of disconnecting the clients of a server that left the
+   * destinations, e.g. the old primary after a failover, their sessions
+   * move to the server the route picks now once they are between
+   * transactions, authenticated with the password of the user stored in
+   * the keyring. The default schema and the system variables the server
+   * reported via session tracking (session_track_schema,
+   * session_track_system_variables) are set again in the new session.
+   * Sessions in a transaction or with other state (user variables,
+   * temporary tables, locks, ...) are disconnected as before.
+   *
+   * Needs to be called after set_io_engine() and set_output_queue_watermarks().
+   *
+   * @throw std::invalid_argument if enabled for the X protocol, with the
+   *        event I/O engine or with output queues
+   *
+   * @param migration true to move sessions instead of disconnecting them
+   */
+  void set_session_migration(bool migration);
+
+  /** @brief Terminates TLS of classic protocol clients at the router
+   *
+   * Clients get the greeting of the server with the SSL capability set and
+   * do the TLS handshake with the router, resuming cached sessions when
+   * they reconnect. The traffic to the servers is plain text, meant for
+   * trusted networks. Clients not asking for TLS are routed as before.
+   *
+   * TLS connections are forwarded by copying, splice and output queues
+   * are not used for them unless the kernel took them over, see
+   * set_client_kernel_tls(). Needs to be called after set_connection_pool()
+   * and set_io_engine().
+   *
+   * @throw std::invalid_argument if only one of the files is given, the
+   *        route uses the X protocol, connection pooling or the event I/O
+   *        engine, or certificate or key can't be loaded
+   *
+   * @param cert_file PEM file of the certificate, empty to not terminate TLS
+   * @param key_file PEM file of the private key
+   */
+  void set_client_tls(const std::string& cert_file, const std::string& key_file);
+
+  /** @brief Lets the kernel encrypt and decrypt the TLS connections of the clients
+   *
+   * Connections the kernel took over in both directions get forwarded like
+   * plain connections, with splice() if enabled. Others keep encrypting in
+   * OpenSSL for the directions the kernel doesn't support. Needs to be
+   * called after set_client_tls().
+   *
+   * @throw std::invalid_argument if enabled and client_ssl_cert is not set
+   *        or the build doesn't support kernel TLS
+   *
+   * @param kernel_tls true to hand the connections to the kernel
+   */
+  void set_client_kernel_tls(bool kernel_tls);
+
+  /** @brief Compresses the traffic between router and servers
+   *
+   * Clients not using the compressed protocol themselves talk plain
+   * protocol to the router, which negotiates CLIENT_COMPRESS with servers
+   * supporting it and translates the packets after the handshake. Meant
+   * for servers behind a slow link, e.g. in another data center.
+   *
+   * X protocol servers get asked for the "compression" capability before
+   * the client's first message. If they accept it, the router hides TLS
+   * and compression from the capabilities the client sees and translates
+   * the messages to Mysqlx.Connection.Compression.
+   *
+   * Needs to be called after set_connection_pool(), set_io_engine(),
+   * set_output_queue_watermarks() and set_client_tls().
+   *
+   * @throw std::invalid_argument if enabled while not built with zlib, with
+   *        connection pooling, the event I/O engine, output queues or TLS
+   *        terminated at the router
+   *
+   * @param compression true to compress the traffic to the servers
+   */
+  void set_server_compression(bool compression);
+
+  /** @brief Samples statements for per-digest statistics
+   *
+   * One of interval COM_QUERY statements of each connection is normalized
+   * into its digest, its latency, rows and response size are added to the
+   * statistics of the route that QueryDigestComponent exposes, e.g. to the
+   * REST API. Up to routing::kDefaultMaxQueryDigests digests are kept.
+   * Connections of sampling routes are not forwarded with splice(), and
+   * those using read/write splitting or the compressed protocol or TLS
+   * towards the server are not sampled.
+   *
+   * Needs to be called after set_connection_pool(), set_client_tls() and
+   * set_server_compression().
+   *
+   * @throw std::invalid_argument if enabled for the X protocol, with
+   *        connection pooling, TLS terminated at the router or
+   *        server_compression
+   *
+   * @param interval statements per sample, 0 to not sample
+   */
+  void set_query_digest_sampling(uint64_t interval);
+
+  /** @brief Caches the responses to allowed read-only statements
+   *
+   * SELECTs the read/write splitting sends to a secondary are answered
+   * from the cache of the route if the digest of the statement is the
+   * digest of one of the allowed statements. Responses are cached by
+   * user, default schema, character set, capabilities and statement text
+   * for ttl; responses larger than an eighth of the cache size or errors
+   * are not cached. Only routes splitting reads from writes use the cache.
+   *
+   * @throw std::invalid_argument if enabled for the X protocol, or only
+   *        one of cache_size and statements is set
+   *
+   * @param cache_size bytes of statements and responses cached, 0 to not cache
+   * @param ttl time a response is served from the cache
+   * @param statements allowed statements, separated by ';'
+   */
+  void set_result_cache(size_t cache_size, std::chrono::milliseconds ttl, const std::string& statements);
+
+  /** @brief Mirrors the commands of the clients to a shadow server
+   *
+   * The commands each client sends after its handshake are copied into a
+   * ring of buffer_size bytes and sent to the shadow server by a background
+   * thread, in a session authenticated as the same user with the password
+   * stored in the keyring; the responses are discarded, see TrafficMirror.
+   * Forwarding never waits for the shadow server, commands that don't fit
+   * into the ring are dropped. Connections of mirroring routes are not
+   * forwarded with splice(), and those using read/write splitting or the
+   * compressed protocol or TLS towards the server are not mirrored.
+   *
+   * Needs to be called after set_connection_pool(), set_client_tls() and
+   * set_server_compression().
+   *
+   * @throw std::invalid_argument if enabled for the X protocol, with
+   *        connection pooling, TLS terminated at the router or
+   *        server_compression
+   *
+   * @param destination address of the shadow server, without addr to not mirror
+   * @param buffer_size bytes of the ring of each connection
+   * @param replay_timing true to send the commands with the gaps they were read with
+   */
+  void set_traffic_mirror(const mysql_harness::TCPAddress& destination, size_t buffer_size, bool replay_timing);
+
+  /** @brief Sets the weights of the destinations
+   *
+   * One weight per destination given to set_destinations_from_csv(), in the
+   * same order. Needs to be called before the destinations are set.
+   *
+   * @throw std::invalid_argument if weights are given and the routing
+   *        strategy is not weighted-round-robin
+   *
+   * @param weights weights of the destinations, empty gives all weight 1
+   */
+  void set_destination_weights(const std::vector<unsigned int>& weights);
+
+  /** @brief Sets how much slower than the fastest server a server may be
+   *         to still get connections with the lowest-latency strategy
+   *
+   * Takes effect when start() is called.
+   *
+   * @param tolerance tolerated connect round trip time above the fastest
+   */
+  void set_latency_tolerance(std::chrono::microseconds tolerance) {
+    latency_tolerance_ = tolerance;
+  }
+
+  /** @brief Sets when a connect races a slow server with the next one
+   *
+   * Meant for read-only routes over equivalent servers, see
+   * RouteDestination::set_connect_hedging(). Takes effect when start() is
+   * called.
+   *
+   * @param percentile percentile of the recent connect times a server
+   *        gets to answer alone, 0 to not hedge
+   */
+  void set_connect_hedging(unsigned int percentile) {
+    connect_hedge_percentile_ = percentile;
+  }
+
+  /** @brief Sets the limits of the new connections per destination server
+   *
+   * Takes effect when start() is called.
+   *
+   * @param max_connections connections a server gets at most, 0 for no limit
+   * @param slow_start_window time over which a recovered server gets its
+   *        full share of the new connections, 0 to disable
+   */
+  void set_destination_limits(unsigned int max_connections,
+                              std::chrono::milliseconds slow_start_window) {
+    max_connections_per_destination_ = max_connections;
+    slow_start_window_ = slow_start_window;
+  }
+
+  /** @brief Sets when destination servers failing their handshakes get no new connections
+   *
+   * Takes effect when start() is called.
+   *
+   * @param failures failed connects or handshakes in a row that open the circuit, 0 disables it
+   * @param open_interval time the circuit stays open
+   * @param half_open_connections connections that need to succeed to close the circuit again
+   */
+  void set_circuit_breaker(unsigned int failures, std::chrono::milliseconds open_interval,
+                           unsigned int half_open_connections) {
+    circuit_breaker_failures_ = failures;
+    circuit_breaker_open_interval_ = open_interval;
+    circuit_breaker_half_open_connections_ = half_open_connections;
+  }
+
+  /** @brief Records the phases of the client connections to ConnectionTrace
+   *
+   * Accept, connect to the server, handshake, first and last byte in each
+   * direction and close get timestamped per connection, e.g. to be fetched
+   * through the REST API.
+   *
+   * @param trace true to trace the connections accepted from now on
+   */
+  void set_connection_trace(bool trace) {
+    context_.set_connection_trace(trace);
+  }
+
+  /** @brief Sets the stack of the threads serving a single connection
+   *
+   * Used if the connections don't get served by the I/O engine. The other
+   * threads of the route keep the thread_stack_size given to the constructor.
+   *
+   * @param connection_thread_stack_size memory in kilobytes allocated for the stack
+   */
+  void set_connection_thread_stack_size(size_t connection_thread_stack_size) {
+    context_.set_connection_thread_stack_size(connection_thread_stack_size);
+  }
+
+  /** @brief Pins the threads of the route to CPUs
+   *
+   * Acceptor, connect and per-connection threads may run on any of the CPUs,
+   * each I/O thread of the event engine gets one of them. The buffers an I/O
+   * thread forwards with are allocated by itself, on the NUMA node of its CPU.
+   * Takes effect when start() is called.
+   *
+   * @param cpus CPUs to run on, empty to not pin the threads
+   */
+  void set_cpu_affinity(const std::vector<unsigned>& cpus) {
+    context_.set_cpu_affinity(cpus);
   }
 
+  /** @brief Sets the pauses between probing quarantined servers
+   *
+   * The pause starts at interval and doubles while none of the quarantined
+   * servers recovers, up to max_interval. Takes effect when start() is
+   * called, only destinations using round-robin quarantine servers.
+   *
+   * @throw std::invalid_argument if max_interval is less than interval
+   *
+   * @param interval pause after servers got quarantined
+   * @param max_interval longest pause between probing quarantined servers
+   */
+  void set_quarantine_interval(std::chrono::milliseconds interval, std::chrono::milliseconds max_interval);
+
+  /** @brief Sets number of threads accepting the TCP connections
+   *
+   * With more than one acceptor thread every thread gets its own listening
+   * socket bound with SO_REUSEPORT to the same address, letting the kernel
+   * spread the incoming connections over them. Takes effect when start()
+   * is called.
+   *
+   * @throw std::invalid_argument if acceptor_threads is 0 or more than one
+   *        thread is requested and SO_REUSEPORT is not supported
+   *
+   * @param acceptor_threads number of acceptor threads
+   */
+  void set_acceptor_threads(unsigned int acceptor_threads);
+
+  /** @brief Returns number of threads accepting the TCP connections */
+  unsigned int get_acceptor_threads() const noexcept {
+    return acceptor_threads_;
+  }
+
+  /** @brief Sets socket file to take over the listeners from a running router
+   *
+   * On start() the listeners get taken over from the router process serving
+   * the socket file instead of being bound, if there is one. The route then
+   * serves the socket file for the process replacing it. See SocketHandoff.
+   *
+   * @param socket_file socket file to meet at, empty to always bind
+   */
+  void set_handoff_socket(const std::string& socket_file) {
+    handoff_socket_ = socket_file;
+  }
+
+  /** @brief Sets how long stopping the route waits for the connections to end
+   *
+   * While draining, the route refuses new connections and closes those
+   * following the transaction state of their session once they are between
+   * transactions, see MySQLRoutingConnection::drain(). Connections still
+   * open at the deadline get disconnected.
+   *
+   * @param drain_timeout time to wait, 0 to disconnect all connections at once
+   */
+  void set_drain_timeout(std::chrono::seconds drain_timeout) {
+    drain_timeout_ = drain_timeout;
+  }
+
+  /** @brief Sets when the router closes connections by itself
+   *
+   * Connections not forwarding anything for the idle timeout, or open for
+   * the max lifetime, get disconnected. Clients get error 4031 telling why.
+   * Long running queries forward nothing either, the idle timeout has to
+   * be longer than them. Needs to be called before start().
+   *
+   * @param idle_timeout time without traffic, 0 to keep idle connections
+   * @param max_lifetime time since the connection got accepted, 0 for no limit
+   */
+  void set_connection_timeouts(std::chrono::seconds idle_timeout,
+                               std::chrono::seconds max_lifetime) {
+    connection_container_.set_timeouts(idle_timeout, max_lifetime);
+  }
+
+  /** @brief Sets how many clients beyond max_connections wait for a slot
+   *
+   * Instead of getting error 1040 right away, clients accepted at
+   * max_connections wait until a connection closes, see AdmissionQueue.
+   * Clients still waiting after the timeout, or not fitting into the queue,
+   * get the error.
+   *
+   * @param queue_size clients that may wait, 0 to reject them at once
+   * @param timeout time a client may wait
+   */
+  void set_admission_queue(size_t queue_size, std::chrono::milliseconds timeout) {
+    admission_queue_size_ = queue_size;
+    admission_queue_timeout_ = timeout;
+  }
+
+  /** @brief Sets how many sockets to each server get connected ahead
+   *
+   * A background thread keeps that many connected sockets to each server
+   * clients got routed to, new clients take one of them instead of waiting
+   * for the connect, see WarmConnectionPool. Sockets of servers removed from
+   * the destinations get closed. Needs to be called before start().
+   *
+   * A classic protocol server closes connections whose handshake didn't
+   * finish within its connect_timeout, max_age needs to leave enough of it
+   * for the client.
+   *
+   * @param size sockets per server, 0 to connect when a client comes
+   * @param max_age time after which unused sockets get closed
+   */
+  void set_warm_connections(unsigned int size, std::chrono::milliseconds max_age) {
+    warm_connections_ = size;
+    warm_connection_max_age_ = max_age;
+  }
+
+  /** @brief Counts the connection errors of the clients together with other routes
+   *
+   * Routes sharing the counters block a client host on all of them once it
+   * failed max_connect_errors times on any of them, see
+   * MySQLRoutingContext::share_connect_errors(). Needs to be called before
+   * start().
+   *
+   * @param share true to use the counters shared by the routes
+   */
+  void set_share_connect_errors(bool share) {
+    if (share) context_.share_connect_errors();
+  }
+
+  /** @brief Limits the time connecting a client to a server may take in total
+   *
+   * All attempts to connect a server for a client, including the waits for
+   * a new primary, share the deadline, each one only waits for what is left
+   * of it, see RouteDestination::ConnectDeadline. Needs to be called before
+   * start().
+   *
+   * @param deadline time for all attempts, 0 to only limit each attempt by
+   *        destination_connect_timeout
+   */
+  void set_connect_deadline(std::chrono::milliseconds deadline) {
+    context_.set_destination_connect_deadline(deadline);
+  }
+
+  /** @brief Sets the limits of the connections of each client host or subnet
+   *
+   * Checked when a client connects, before the connection gets queued or
+   * a server connected. Clients exceeding them get an error, see
+   * ClientLimits.
+   *
+   * @param settings limits, no limits if neither rate nor max_connections is set
+   */
+  void set_client_limits(const ClientLimits::Settings& settings) {
+    if (settings.rate == 0 && settings.max_connections == 0) {
+      client_limits_.reset();
+    } else {
+      client_limits_.reset(new ClientLimits(settings));
+    }
+  }
+
+  /** @brief Makes the route share a connection limit with the other routes
+   *
+   * The routes sharing the budget have at most limit client connections
+   * together, the lowest limit of the routes applies. Each route has its
+   * reserved connections and borrows the others from the pool the
+   * reservations leave, by weight, see ConnectionBudget. Checked once a
+   * client got admitted by max_connections, clients beyond the budget get
+   * an error. Needs to be called before start().
+   *
+   * @throws std::invalid_argument if the reservations exceed the limit or weight is 0
+   *
+   * @param limit connections of all routes sharing the budget, 0 for the route to not use it
+   * @param reserved connections only this route may use
+   * @param weight share of the pool compared to the other routes
+   */
+  void set_connection_budget(size_t limit, size_t reserved, unsigned int weight);
+
+  /** @brief Keeps connections of the route for the clients of some networks
+   *
+   * Clients of the networks, like monitoring agents and the DBAs' hosts,
+   * take one of max_connections connections of the lane before anything
+   * else gets checked. Those don't count for max_connections, the client
+   * limits and the connection budget, don't wait in the admission queue
+   * and connect to the servers ahead of the other clients of the I/O
+   * engine. Once the lane is full the clients get in like any other.
+   * Needs to be called before start().
+   *
+   * @throws std::invalid_argument if a network is invalid or max_connections is 0
+   *
+   * @param networks addresses like '10.0.0.5' or '10.1.0.0/16', empty for no lane
+   * @param max_connections connections of the lane
+   */
+  void set_priority_lane(const std::vector<std::string>& networks, size_t max_connections);
+
+  /** @brief Sets the use of the PROXY protocol (version 2)
+   *
+   * With client set, clients of the TCP listeners connecting from one of
+   * the trusted sources, like load balancers, have to start with a PROXY
+   * header. It is read in a thread of its own, the acceptors go on
+   * accepting meanwhile, and the client address it carries is used for
+   * max_connect_errors, the client limits, the routing and the logs.
+   * Their connections without a valid header in time get closed. Headers
+   * of other clients aren't read, they are served as direct clients with
+   * their own address.
+   *
+   * With server set, a PROXY header with the address of the client is
+   * sent to the servers once connected. Needs to be called after
+   * set_connection_pool() and set_warm_connections(), server connections
+   * shared by clients can't have one.
+   *
+   * @throws std::invalid_argument if client is set without trusted sources
+   *         or one of them is invalid
+   *
+   * @param client true if clients send a PROXY header
+   * @param timeout time the header of a client has to arrive in
+   * @param trusted_sources addresses like '10.0.0.5' or '10.1.0.0/16' of
+   *        the peers sending a PROXY header
+   * @param server true to send a PROXY header to the servers
+   */
+  void set_proxy_protocol(bool client, std::chrono::milliseconds timeout,
+                          const std::vector<std::string>& trusted_sources, bool server);
+
   /**
    * @brief create new connection to MySQL Server than can handle client's traffic
    *        and adds it to connection container. Every connection runs in it's own
    *        thread of execution.
    *
+   * Doesn't wait for the connection to the server to be established, it is
+   * set up by the started connection.
+   *
    * @param client_socket socket used to send/receive data to/from client
    * @param client_addr address of client
+   * @param priority true if the client got a connection of the priority lane
    */
-  void create_connection(int client_socket, const sockaddr_storage& client_addr);
+  void create_connection(int client_socket, const sockaddr_storage& client_addr, bool priority = false);
 
 private:
+  /** @brief Creates a destination of the routing strategy from a list of servers
+   *
+   * @throw std::runtime_error if an address is invalid or no address is given
+   * @throw std::invalid_argument if the number of destination weights doesn't match
+   *
+   * @param csv destinations as comma-separated-values
+   */
+  std::shared_ptr<RouteDestination> create_destinations_from_csv(const std::string &csv);
+
+  /** @brief Creates a destination of the Metadata Cache from a URI
+   *
+   * @throw std::runtime_error if the URI scheme isn't metadata-cache
+   */
+  std::shared_ptr<RouteDestination> create_destinations_from_uri(const mysqlrouter::URI &uri);
+
+  /** @brief Creates the destinations of a pool of route_map or query_route_map */
+  std::shared_ptr<RouteDestination> create_pool_destinations(const std::string &destinations);
+
+  /** @brief Applies the settings of the route to a destination before it gets started */
+  void setup_destination(RouteDestination &destination);
+
+  /** @brief Checks the value of max_connections
+   *
+   * @throw std::invalid_argument if not between 1 and 65535.
+   */
+  void validate_max_connections(int maximum);
+
   /** @brief Sets up the TCP service
    *
    * Sets up the TCP service binding to IP addresses and TCP port.
@@ -264,14 +1054,117 @@ private:
 
   void start_acceptor(mysql_harness::PluginFuncEnv* env);
 
+  /** @brief Accepts the pending connections of a readable listening socket
+   *
+   * Accepts until the backlog is drained or kAcceptBatchSize connections
+   * got accepted. Connections of blocked hosts or exceeding max_connections
+   * get an error and are closed, the others are handed over to
+   * create_connection(). With an admission queue, connections exceeding
+   * max_connections are queued instead while there is space, and so are all
+   * connections while others wait. Connections of trusted PROXY protocol
+   * sources are pushed to the proxy_header_receiver_ first.
+   *
+   * @param listen_sock non-blocking listening socket
+   * @param is_tcp true if listen_sock is a TCP socket
+   */
+  void accept_connections(int listen_sock, bool is_tcp);
+
+  /**
+   * @brief Admits an accepted connection, or refuses it.
+   *
+   * Called by the acceptors and, for connections with a PROXY header, by
+   * the proxy_header_receiver_ once it got the header.
+   *
+   * @param sock_client socket of the client
+   * @param client_addr address of the client
+   * @param is_tcp true if the client connected at a TCP listener
+   */
+  void admit_client(int sock_client, const sockaddr_storage &client_addr, bool is_tcp);
+
+  /** @brief Takes one of the max_connections slots
+   *
+   * Connections hold their slot from being admitted until they got
+   * removed, the ones of the priority lane don't take one.
+   *
+   * @return false if all slots are taken
+   */
+  bool reserve_connection() noexcept;
+
+  /** @brief Frees a slot taken by reserve_connection() and wakes up the admission of queued clients */
+  void release_connection() noexcept;
+
+  /** @brief Sends error 1040 to a client exceeding max_connections and closes it */
+  void reject_too_many_connections(int client_socket, const sockaddr_storage& client_addr);
+
+  /** @brief Sends the PROXY header to a server socket just connected
+   *
+   * @param server server socket, passed through if invalid already
+   * @param header header to send, nothing gets sent if nullptr
+   *
+   * @return server, or an invalid socket if sending failed and the socket got closed
+   */
+  int send_proxy_header(int server, const std::vector<uint8_t>* header);
+
+  /** @brief Admits the queued clients while there are free slots, rejects the expired ones */
+  void admit_queued_connections();
+
+  static void* run_acceptor_thread(void* context);
+
+  /** @brief Accept loop of the additional acceptor threads
+   *
+   * Runs until acceptors_running_ gets false.
+   *
+   * @param listen_sock SO_REUSEPORT listener served by the thread
+   */
+  void run_acceptor(int listen_sock);
+
+  /** @brief Opens the additional SO_REUSEPORT listeners
+   *
+   * @throw std::runtime_error on errors
+   *
+   * @param info address the first TCP listener is bound to
+   */
+  void setup_reuseport_listeners(const struct addrinfo* info);
+
+  /** @brief Sets the socket options of a TCP listener before it gets bound
+   *
+   * Failures are logged, the listener works without the option.
+   */
+  void set_listener_options(int sock);
+
+  /** @brief shuts down and closes the TCP listeners */
+  void close_tcp_listeners();
+
+  /** @brief takes the listeners from the process serving handoff_socket_
+   *
+   * @return true if the listeners of the route got taken over
+   */
+  bool take_over_listeners();
+
+  /** @brief passes the listeners on to a process connecting to handoff_ */
+  void hand_over_listeners();
+
   /** @brief wrapper for data used by all connections */
   MySQLRoutingContext context_;
 
   /** @brief object handling the operations on network sockets */
   routing::RoutingSockOpsInterface* routing_sock_ops_;
 
-  /** @brief Destination object to use when getting next connection */
-  std::unique_ptr<RouteDestination> destination_;
+  /** @brief Destination object to use when getting next connection
+   *
+   * Accessed with std::atomic_load/store once the route runs, each connection
+   * keeps the one it got accepted with.
+   */
+  std::shared_ptr<RouteDestination> destination_;
+
+  /** @brief true if the destinations were set from a list of servers and can be changed */
+  bool static_destinations_{false};
+
+  /** @brief true once destination_ is started, later destinations get started when set */
+  bool destination_started_{false};
+
+  /** @brief serializes change_settings() and the start of the destination */
+  std::mutex settings_mtx_;
 
   /** @brief Routing strategy to use when getting next destination */
   routing::RoutingStrategy routing_strategy_;
@@ -285,24 +1178,184 @@ private:
    * by this MySQLRouter instances. There is no maximum for outgoing
    * connections since it is one-to-one with incoming.
    */
-  int max_connections_;
+  std::atomic<int> max_connections_;
+
+  /** @brief slots of max_connections taken by admitted connections */
+  std::atomic<int> reserved_connections_{0};
 
   /** @brief Socket descriptor of the TCP service */
   int service_tcp_;
   /** @brief Socket descriptor of the named socket service */
   int service_named_socket_;
 
+  /** @brief number of threads accepting TCP connections */
+  unsigned int acceptor_threads_{routing::kDefaultAcceptorThreads};
+
+  /** @brief Additional SO_REUSEPORT listeners, one per additional acceptor thread */
+  std::vector<int> service_tcp_reuseport_;
+
+  /** @brief true if accepted TCP sockets inherit TCP_NODELAY from the listeners */
+  bool tcp_nodelay_inherited_{false};
+
+  /** @brief true while the additional acceptor threads have to accept */
+  std::atomic<bool> acceptors_running_{false};
+
   /** @brief used to unregister from subscription on allowed nodes changes */
   AllowedNodesChangeCallbacksListIterator allowed_nodes_list_iterator_;
 
   /** @brief container for connections */
   ConnectionContainer connection_container_;
 
+  /** @brief I/O engine serving the connections */
+  routing::IOEngine io_engine_type_{routing::kDefaultIOEngine};
+
+  /** @brief number of I/O threads of the event engine */
+  unsigned int io_threads_{routing::kDefaultIOThreads};
+
+  /** @brief true if the event engine should use io_uring */
+  bool io_uring_{false};
+
+  /** @brief bytes a connection of the event engine forwards per round, 0 to not share */
+  size_t fair_share_quantum_{routing::kDefaultFairShareQuantum};
+
+  /** @brief bytes per second the event engine forwards, 0 for no limit */
+  uint64_t max_bandwidth_{0};
+
+  /** @brief pages backing the buffers of the buffer pools */
+  BufferArena::HugePages buffer_huge_pages_{BufferArena::HugePages::kNone};
+
+  /** @brief arena of the buffer pool of the context, nullptr if its buffers come from the heap */
+  std::shared_ptr<BufferArena> buffer_arena_;
+
+  /** @brief max number of idle server connections, 0 if not pooled */
+  unsigned int connection_pool_size_{0};
+
+  /** @brief time after which idle server connections are closed */
+  std::chrono::milliseconds connection_pool_idle_timeout_{routing::kDefaultConnectionPoolIdleTimeout};
+
+  /** @brief weights of the destinations for weighted-round-robin */
+  std::vector<unsigned int> destination_weights_;
+
+  /** @brief tolerated latency above the fastest server for lowest-latency */
+  std::chrono::microseconds latency_tolerance_{routing::kDefaultLatencyTolerance};
+
+  /** @brief percentile of the connect times after which connects get hedged, 0 if they don't */
+  unsigned int connect_hedge_percentile_{0};
+
+  /** @brief max connections per destination server, 0 for no limit */
+  unsigned int max_connections_per_destination_{0};
+
+  /** @brief time a recovered destination server ramps up in */
+  std::chrono::milliseconds slow_start_window_{0};
+
+  /** @brief failures in a row that open the circuit of a server, 0 if disabled */
+  unsigned int circuit_breaker_failures_{0};
+  std::chrono::milliseconds circuit_breaker_open_interval_{routing::kDefaultCircuitBreakerOpenInterval};
+  unsigned int circuit_breaker_half_open_connections_{routing::kDefaultCircuitBreakerHalfOpenConnections};
+
+  /** @brief socket file to take over and hand over the listeners, empty if not used */
+  std::string handoff_socket_;
+
+  /** @brief serves handoff_socket_ while the acceptor runs */
+  std::unique_ptr<SocketHandoff> handoff_;
+
+  /** @brief picks the pool of a client by its handshake, nullptr if not routed by it */
+  std::unique_ptr<HandshakeRouter> handshake_router_;
+
+  /** @brief picks the pool of a statement by its leading comment, nullptr if not routed by it */
+  std::unique_ptr<QueryRouter> query_router_;
+
+  /** @brief time connections get to end when the route stops */
+  std::chrono::seconds drain_timeout_{0};
+
+  /** @brief pause after servers got quarantined */
+  std::chrono::milliseconds quarantine_interval_{routing::kDefaultQuarantineInterval};
+
+  /** @brief longest pause between probing quarantined servers */
+  std::chrono::milliseconds quarantine_max_interval_{routing::kDefaultQuarantineMaxInterval};
+
+  /** @brief limits of each client, nullptr if clients aren't limited */
+  std::unique_ptr<ClientLimits> client_limits_;
+
+  /** @brief connection limit shared with other routes, nullptr if the route doesn't use it */
+  std::shared_ptr<ConnectionBudget> connection_budget_;
+
+  /** @brief the route's part of connection_budget_, destroyed before it */
+  std::unique_ptr<ConnectionBudget::Route> budget_route_;
+
+  /** @brief connections kept for some clients, nullptr if there is no lane */
+  std::unique_ptr<PriorityLane> priority_lane_;
+
+  /** @brief clients that may wait for a slot at max_connections, 0 if none */
+  size_t admission_queue_size_{0};
+
+  /** @brief time clients may wait for a slot */
+  std::chrono::milliseconds admission_queue_timeout_{routing::kDefaultAdmissionQueueTimeout};
+
+  /** @brief clients waiting for a slot, only set while the acceptor runs with a queue */
+  std::unique_ptr<AdmissionQueue> admission_queue_;
+
+  /** @brief serializes the tasks posted to the acceptor */
+  std::mutex acceptor_tasks_mtx_;
+
+  /** @brief tasks the acceptor runs after its next poll(), like the heartbeats of the stall watchdog */
+  std::vector<std::function<void()>> acceptor_tasks_;
+
+  /** @brief servers connected at a unix socket, nullptr if none */
+  std::shared_ptr<const RouteDestination::UnixSockets> unix_sockets_;
+
+  /** @brief peers whose connections start with a PROXY header, nullptr if the clients send none */
+  std::unique_ptr<ClientNetworks> proxy_trusted_sources_;
+
+  /** @brief time the PROXY header of a client has to arrive in */
+  std::chrono::milliseconds proxy_protocol_timeout_{routing::kDefaultProxyProtocolTimeout};
+
+  /** @brief reads the PROXY headers, only set while the acceptor runs with proxy_trusted_sources_ */
+  std::unique_ptr<ProxyHeaderReceiver> proxy_header_receiver_;
+
+  /** @brief true if server connections start with a PROXY header */
+  bool server_proxy_protocol_{false};
+
+  /** @brief sockets connected ahead per server, 0 if servers get connected on demand */
+  unsigned int warm_connections_{0};
+
+  /** @brief time after which unused sockets connected ahead get closed */
+  std::chrono::milliseconds warm_connection_max_age_{routing::kDefaultWarmConnectionMaxAge};
+
+  /** @brief sockets connected ahead, only set while the acceptor runs with warm connections
+   *
+   * Guarded by settings_mtx_, destinations created by change_settings() get it too.
+   */
+  std::shared_ptr<WarmConnectionPool> warm_pool_;
+
+  /** @brief idle server connections, only set while the acceptor runs with pooling */
+  std::unique_ptr<BackendConnectionPool> backend_pool_;
+
+  /** @brief sends the commands of the clients to a shadow server, nullptr if not mirroring */
+  std::shared_ptr<TrafficMirror> traffic_mirror_;
+
+  /** @brief certificate and session cache for the clients, set if TLS is terminated */
+  std::unique_ptr<TlsServerContext> client_tls_context_;
+
+  /** @brief true if the statistics of the sampled statements are registered with QueryDigestComponent */
+  bool query_digests_registered_{false};
+
+  /** @brief event engine, only set while the acceptor runs with IOEngine::kEvent
+   *
+   * Declared after the connection container as connections still served get
+   * removed from the container when the engine is stopped.
+   */
+  std::unique_ptr<RoutingIOEngine> io_engine_;
+
 #ifdef FRIEND_TEST
   FRIEND_TEST(RoutingTests, bug_24841281);
   FRIEND_TEST(RoutingTests, get_routing_thread_name);
+  FRIEND_TEST(RoutingTests, ReservesConnectionSlots);
   FRIEND_TEST(ClassicProtocolRoutingTest, NoValidDestinations);
   FRIEND_TEST(TestSetupTcpService, single_addr_ok);
+  FRIEND_TEST(TestSetupTcpService, reuseport_listeners_ok);
+  FRIEND_TEST(TestSetupTcpService, listener_socket_options_ok);
+  FRIEND_TEST(TestSetupTcpService, listener_keepalive_options_ok);
   FRIEND_TEST(TestSetupTcpService, getaddrinfo_fails);
   FRIEND_TEST(TestSetupTcpService, socket_fails_for_all_addr);
   FRIEND_TEST(TestSetupTcpService, socket_fails);
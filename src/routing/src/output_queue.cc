@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "output_queue.h"
+
+#include <cerrno>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#endif
+
+/*static*/
+bool OutputQueue::is_supported() noexcept {
+#ifndef _WIN32
+  return true;
+#else
+  return false;
+#endif
+}
+
+/** @brief writes to fd without blocking, 0 if the socket buffer is full */
+static ssize_t send_nonblocking(int fd, const uint8_t* data, size_t size) {
+#ifndef _WIN32
+  int flags = MSG_DONTWAIT;
+#  ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#  endif
+
+  ssize_t res;
+  do {
+    res = ::send(fd, data, size, flags);
+  } while (res == -1 && errno == EINTR);
+
+  if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+  return res;
+#else
+  (void)fd; (void)data; (void)size;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+ssize_t OutputQueue::send(int fd, const uint8_t* data, size_t size) {
+  if (!empty()) {
+    // keep the order, flush() writes it once the socket is writable
+    append(data, size);
+    return 0;
+  }
+
+  ssize_t res = send_nonblocking(fd, data, size);
+  if (res < 0) return -1;
+
+  const size_t written = static_cast<size_t>(res);
+  if (written < size) append(data + written, size - written);
+
+  return res;
+}
+
+ssize_t OutputQueue::flush(int fd) {
+  if (empty()) return 0;
+
+  ssize_t res = send_nonblocking(fd, &data_[offset_], size());
+  if (res > 0) consume(static_cast<size_t>(res));
+
+  return res;
+}
+
+void OutputQueue::append(const uint8_t* data, size_t size) {
+  if (offset_ > 0 && offset_ >= this->size()) {
+    // more than half of the buffer is written already, move the rest up front
+    data_.erase(data_.begin(), data_.begin() + static_cast<std::ptrdiff_t>(offset_));
+    offset_ = 0;
+  }
+
+  data_.insert(data_.end(), data, data + size);
+}
+
+void OutputQueue::consume(size_t size) {
+  offset_ += size;
+  if (offset_ < data_.size()) return;
+
+  offset_ = 0;
+  if (data_.capacity() > kMaxRetainedCapacity) {
+    std::vector<uint8_t>().swap(data_);
+  } else {
+    data_.clear();
+  }
+}
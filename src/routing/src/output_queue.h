@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_OUTPUT_QUEUE_INCLUDED
+#define ROUTING_OUTPUT_QUEUE_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#else
+typedef long ssize_t;
+#endif
+
+/**
+ * @brief OutputQueue keeps the data a socket could not take without
+ *        blocking.
+ *
+ * Writes never block: whatever does not fit into the socket's send buffer
+ * is queued and written by flush() once the socket becomes writable again.
+ * Data is always written in the order it was passed to send().
+ *
+ * Not available on Windows.
+ */
+class OutputQueue {
+public:
+  /** @brief capacity kept for reuse once the queue is drained */
+  static const size_t kMaxRetainedCapacity = 64 * 1024;
+
+  OutputQueue() = default;
+
+  OutputQueue(const OutputQueue&) = delete;
+  OutputQueue& operator=(const OutputQueue&) = delete;
+
+  /**
+   * @brief Writes data to the socket without blocking.
+   *
+   * If the queue is not empty or the socket does not take all of the data,
+   * the rest is queued.
+   *
+   * @param fd socket to write to
+   * @param data data to write
+   * @param size number of bytes to write
+   *
+   * @return number of bytes written to the socket, -1 on error with errno set
+   */
+  ssize_t send(int fd, const uint8_t* data, size_t size);
+
+  /**
+   * @brief Writes as much of the queued data as the socket takes without
+   *        blocking.
+   *
+   * @param fd socket to write to
+   *
+   * @return number of bytes written to the socket, -1 on error with errno set
+   */
+  ssize_t flush(int fd);
+
+  /** @brief Returns number of bytes queued */
+  size_t size() const noexcept {
+    return data_.size() - offset_;
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  /**
+   * @brief Returns true if writing without blocking is available on this
+   *        platform.
+   */
+  static bool is_supported() noexcept;
+
+private:
+  /** @brief appends data to the queue */
+  void append(const uint8_t* data, size_t size);
+
+  /** @brief removes bytes written from the front of the queue */
+  void consume(size_t size);
+
+  /** @brief queued data, starting at offset_ */
+  std::vector<uint8_t> data_;
+  /** @brief bytes at the front of data_ already written */
+  size_t offset_{0};
+};
+
+#endif /* ROUTING_OUTPUT_QUEUE_INCLUDED */
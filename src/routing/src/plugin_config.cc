@@ -23,12 +23,18 @@
 */
 
 #include "plugin_config.h"
+#include "io_engine.h"
 #include "mysql_routing.h"
+#include "splice_forwarder.h"
 #include "mysqlrouter/routing.h"
 #include "mysqlrouter/metadata_cache.h"
 
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <exception>
+#include <sstream>
 #include <vector>
 
 #include "mysqlrouter/utils.h"
@@ -40,6 +46,8 @@ using mysqlrouter::URI;
 using mysqlrouter::URIError;
 using mysqlrouter::to_string;
 
+// largest weight of a destination
+static const unsigned long kMaxDestinationWeight = 1000;
 
 /** @brief Constructor
  *
@@ -54,13 +62,96 @@ RoutingPluginConfig::RoutingPluginConfig(const mysql_harness::ConfigSection *sec
       bind_address(get_option_tcp_address(section, "bind_address", false, bind_port)),
       named_socket(get_option_named_socket(section, "socket")),
       connect_timeout(get_uint_option<uint16_t>(section, "connect_timeout", 1)),
+      connect_deadline(get_uint_option<uint16_t>(section, "connect_deadline", 0)),
       mode(get_option_mode(section, "mode")),
       routing_strategy(get_option_routing_strategy(section, "routing_strategy")),
       max_connections(get_uint_option<uint16_t>(section, "max_connections", 1)),
       max_connect_errors(get_uint_option<uint32_t>(section, "max_connect_errors", 1, UINT32_MAX)),
+      share_connect_errors(get_uint_option<uint16_t>(section, "share_connect_errors", 0, 1) != 0),
       client_connect_timeout(get_uint_option<uint32_t>(section, "client_connect_timeout", 2, 31536000)),
       net_buffer_length(get_uint_option<uint32_t>(section, "net_buffer_length", 1024, 1048576)),
-      thread_stack_size(get_uint_option<uint32_t>(section, "thread_stack_size", 1, 65535)){
+      max_net_buffer_length(get_uint_option<uint32_t>(section, "max_net_buffer_length", 0, 16777216)),
+      thread_stack_size(get_uint_option<uint32_t>(section, "thread_stack_size", 1, 65535)),
+      connection_thread_stack_size(get_uint_option<uint32_t>(section, "connection_thread_stack_size", 64, 65535)),
+      io_engine(get_option_io_engine(section, "io_engine")),
+      io_threads(get_uint_option<uint16_t>(section, "io_threads", 0, 1024)),
+      io_uring(get_uint_option<uint16_t>(section, "io_uring", 0, 1) != 0),
+      fair_share_quantum(get_uint_option<uint32_t>(section, "fair_share_quantum", 0, 16 * 1024 * 1024)),
+      max_bandwidth(get_uint_option<uint32_t>(section, "max_bandwidth", 0, 100000000)),
+      splice(get_option_splice(section, "splice")),
+      buffer_pool_size(get_uint_option<uint16_t>(section, "buffer_pool_size", 0, 65535)),
+      connection_pool_size(get_uint_option<uint16_t>(section, "connection_pool_size", 0, 65535)),
+      connection_pool_idle_timeout(get_uint_option<uint32_t>(section, "connection_pool_idle_timeout", 1, 31536000)),
+      connection_multiplexing(get_uint_option<uint16_t>(section, "connection_multiplexing", 0, 1) != 0),
+      prepared_statement_cache_size(get_uint_option<uint16_t>(section, "prepared_statement_cache_size", 0, 1024)),
+      session_migration(get_uint_option<uint16_t>(section, "session_migration", 0, 1) != 0),
+      client_ssl_cert(get_option_string(section, "client_ssl_cert")),
+      client_ssl_key(get_option_string(section, "client_ssl_key")),
+      client_ssl_kernel_tls(get_uint_option<uint16_t>(section, "client_ssl_kernel_tls", 0, 1) != 0),
+      server_compression(get_uint_option<uint16_t>(section, "server_compression", 0, 1) != 0),
+      query_digest_sampling(get_uint_option<uint32_t>(section, "query_digest_sampling", 0, 1000000)),
+      result_cache_size(get_uint_option<uint32_t>(section, "result_cache_size", 0, 1073741824)),
+      result_cache_ttl(get_uint_option<uint32_t>(section, "result_cache_ttl", 1, 3600000)),
+      result_cache_statements(get_option_string(section, "result_cache_statements")),
+      acceptor_threads(get_uint_option<uint16_t>(section, "acceptor_threads", 1, 1024)),
+      tcp_fastopen(get_uint_option<uint16_t>(section, "tcp_fastopen", 0, 65535)),
+      tcp_defer_accept(get_uint_option<uint16_t>(section, "tcp_defer_accept", 0, 3600)),
+      socket_rcvbuf(get_uint_option<uint32_t>(section, "socket_rcvbuf", 0, 67108864)),
+      socket_sndbuf(get_uint_option<uint32_t>(section, "socket_sndbuf", 0, 67108864)),
+      tcp_keepalive(get_uint_option<uint16_t>(section, "tcp_keepalive", 0, 1) != 0),
+      tcp_keepalive_idle(get_uint_option<uint16_t>(section, "tcp_keepalive_idle", 0, 32767)),
+      tcp_keepalive_interval(get_uint_option<uint16_t>(section, "tcp_keepalive_interval", 0, 32767)),
+      tcp_keepalive_count(get_uint_option<uint16_t>(section, "tcp_keepalive_count", 0, 127)),
+      tcp_user_timeout(get_uint_option<uint32_t>(section, "tcp_user_timeout", 0, 86400000)),
+      source_addresses(get_option_source_addresses(section, "source_addresses")),
+      source_port_range(get_option_port_range(section, "source_port_range")),
+      output_queue_high_watermark(get_uint_option<uint32_t>(section, "output_queue_high_watermark", 0, 1073741824)),
+      output_queue_low_watermark(get_uint_option<uint32_t>(section, "output_queue_low_watermark", 0, 1073741824)),
+      zero_copy_threshold(get_uint_option<uint32_t>(section, "zero_copy_threshold", 0, 1073741824)),
+      buffer_huge_pages(get_option_huge_pages(section, "buffer_huge_pages")),
+      quarantine_interval(get_uint_option<uint32_t>(section, "quarantine_interval", 1, 3600000)),
+      quarantine_max_interval(get_uint_option<uint32_t>(section, "quarantine_max_interval", 1, 3600000)),
+      destination_weights(get_option_weights(section, "destination_weights")),
+      latency_tolerance(get_uint_option<uint32_t>(section, "latency_tolerance", 0, 60000)),
+      connect_hedge_percentile(get_uint_option<uint16_t>(section, "connect_hedge_percentile", 0, 99)),
+      max_connections_per_destination(get_uint_option<uint16_t>(section, "max_connections_per_destination", 0, 65535)),
+      slow_start_window(get_uint_option<uint32_t>(section, "slow_start_window", 0, 3600000)),
+      circuit_breaker_failures(get_uint_option<uint16_t>(section, "circuit_breaker_failures", 0, 65535)),
+      circuit_breaker_open_interval(get_uint_option<uint32_t>(section, "circuit_breaker_open_interval", 1, 3600000)),
+      circuit_breaker_half_open_connections(
+          get_uint_option<uint16_t>(section, "circuit_breaker_half_open_connections", 1, 65535)),
+      connection_trace(get_uint_option<uint16_t>(section, "connection_trace", 0, 1) != 0),
+      cpu_affinity(get_option_cpu_affinity(section, "cpu_affinity")),
+      drain_timeout(get_uint_option<uint32_t>(section, "drain_timeout", 0, 3600)),
+      admission_queue_size(get_uint_option<uint16_t>(section, "admission_queue_size", 0, 65535)),
+      admission_queue_timeout(get_uint_option<uint32_t>(section, "admission_queue_timeout", 1, 3600000)),
+      warm_connections(get_uint_option<uint16_t>(section, "warm_connections", 0, 1024)),
+      warm_connection_max_age(get_uint_option<uint32_t>(section, "warm_connection_max_age", 100, 3600000)),
+      client_connection_rate(get_uint_option<uint32_t>(section, "client_connection_rate", 0, 1000000)),
+      client_connection_burst(get_uint_option<uint32_t>(section, "client_connection_burst", 0, 1000000)),
+      client_max_connections(get_uint_option<uint16_t>(section, "client_max_connections", 0, 65535)),
+      client_limit_ipv4_prefix(get_uint_option<uint16_t>(section, "client_limit_ipv4_prefix", 1, 32)),
+      client_limit_ipv6_prefix(get_uint_option<uint16_t>(section, "client_limit_ipv6_prefix", 1, 128)),
+      connection_budget(get_uint_option<uint32_t>(section, "connection_budget", 0, 1000000)),
+      connection_budget_reserved(get_uint_option<uint32_t>(section, "connection_budget_reserved", 0, 1000000)),
+      connection_budget_weight(get_uint_option<uint16_t>(section, "connection_budget_weight", 1, 1000)),
+      priority_clients(get_option_list(section, "priority_clients")),
+      priority_connections(get_uint_option<uint16_t>(section, "priority_connections", 1, 1000)),
+      idle_timeout(get_uint_option<uint32_t>(section, "idle_timeout", 0, 31536000)),
+      max_connection_lifetime(get_uint_option<uint32_t>(section, "max_connection_lifetime", 0, 31536000)),
+      handoff_socket(get_option_string(section, "handoff_socket")),
+      route_by(get_option_string(section, "route_by")),
+      route_map(get_option_string(section, "route_map")),
+      query_route_map(get_option_string(section, "query_route_map")),
+      destination_sockets(get_option_string(section, "destination_sockets")),
+      proxy_protocol(get_uint_option<uint16_t>(section, "proxy_protocol", 0, 1) != 0),
+      proxy_protocol_timeout(get_uint_option<uint32_t>(section, "proxy_protocol_timeout", 1, 60000)),
+      proxy_protocol_trusted_sources(get_option_list(section, "proxy_protocol_trusted_sources")),
+      server_proxy_protocol(get_uint_option<uint16_t>(section, "server_proxy_protocol", 0, 1) != 0),
+      mirror_destination(get_option_tcp_address(section, "mirror_destination", false,
+                                                Protocol::get_default_port(Protocol::Type::kClassicProtocol))),
+      mirror_buffer_size(get_uint_option<uint32_t>(section, "mirror_buffer_size", 4096, 1073741824)),
+      mirror_timing(get_uint_option<uint16_t>(section, "mirror_timing", 0, 1) != 0) {
 
   // either bind_address or socket needs to be set, or both
   if (!bind_address.port && !named_socket.is_set()) {
@@ -74,11 +165,92 @@ string RoutingPluginConfig::get_default(const string &option) const {
   const std::map<string, string> defaults{
       {"bind_address", to_string(routing::kDefaultBindAddress)},
       {"connect_timeout", to_string(std::chrono::duration_cast<std::chrono::seconds>(routing::kDefaultDestinationConnectionTimeout).count())},
+      {"connect_deadline", "0"},
       {"max_connections", to_string(routing::kDefaultMaxConnections)},
       {"max_connect_errors", to_string(routing::kDefaultMaxConnectErrors)},
+      {"share_connect_errors", "0"},
       {"client_connect_timeout", to_string(std::chrono::duration_cast<std::chrono::seconds>(routing::kDefaultClientConnectTimeout).count())},
       {"net_buffer_length", to_string(routing::kDefaultNetBufferLength)},
+      {"max_net_buffer_length", "0"},
       {"thread_stack_size", to_string(mysql_harness::kDefaultStackSizeInKiloBytes)},
+      {"connection_thread_stack_size", to_string(mysql_harness::kDefaultConnectionStackSizeInKiloBytes)},
+      {"io_engine", routing::get_io_engine_name(routing::kDefaultIOEngine)},
+      {"io_threads", to_string(routing::kDefaultIOThreads)},
+      {"io_uring", "0"},
+      {"fair_share_quantum", to_string(routing::kDefaultFairShareQuantum)},
+      {"max_bandwidth", "0"},
+      {"splice", "0"},
+      {"buffer_pool_size", to_string(routing::kDefaultBufferPoolSize)},
+      {"connection_pool_size", "0"},
+      {"connection_pool_idle_timeout", to_string(routing::kDefaultConnectionPoolIdleTimeout.count())},
+      {"connection_multiplexing", "0"},
+      {"prepared_statement_cache_size", "0"},
+      {"session_migration", "0"},
+      {"client_ssl_cert", ""},
+      {"client_ssl_key", ""},
+      {"client_ssl_kernel_tls", "0"},
+      {"server_compression", "0"},
+      {"query_digest_sampling", "0"},
+      {"result_cache_size", "0"},
+      {"result_cache_ttl", to_string(routing::kDefaultResultCacheTtl.count())},
+      {"result_cache_statements", ""},
+      {"acceptor_threads", to_string(routing::kDefaultAcceptorThreads)},
+      {"tcp_fastopen", "0"},
+      {"tcp_defer_accept", "0"},
+      {"socket_rcvbuf", "0"},
+      {"socket_sndbuf", "0"},
+      {"tcp_keepalive", "0"},
+      {"tcp_keepalive_idle", "0"},
+      {"tcp_keepalive_interval", "0"},
+      {"tcp_keepalive_count", "0"},
+      {"tcp_user_timeout", "0"},
+      {"source_addresses", ""},
+      {"source_port_range", ""},
+      {"output_queue_high_watermark", "0"},
+      {"output_queue_low_watermark", "0"},
+      {"zero_copy_threshold", "0"},
+      {"buffer_huge_pages", "none"},
+      {"quarantine_interval", to_string(routing::kDefaultQuarantineInterval.count())},
+      {"quarantine_max_interval", to_string(routing::kDefaultQuarantineMaxInterval.count())},
+      {"destination_weights", ""},
+      {"latency_tolerance", to_string(routing::kDefaultLatencyTolerance.count())},
+      {"connect_hedge_percentile", "0"},
+      {"max_connections_per_destination", "0"},
+      {"slow_start_window", "0"},
+      {"circuit_breaker_failures", "0"},
+      {"circuit_breaker_open_interval", to_string(routing::kDefaultCircuitBreakerOpenInterval.count())},
+      {"circuit_breaker_half_open_connections", to_string(routing::kDefaultCircuitBreakerHalfOpenConnections)},
+      {"connection_trace", "0"},
+      {"cpu_affinity", ""},
+      {"drain_timeout", "0"},
+      {"admission_queue_size", "0"},
+      {"admission_queue_timeout", to_string(routing::kDefaultAdmissionQueueTimeout.count())},
+      {"warm_connections", "0"},
+      {"warm_connection_max_age", to_string(routing::kDefaultWarmConnectionMaxAge.count())},
+      {"client_connection_rate", "0"},
+      {"client_connection_burst", "0"},
+      {"client_max_connections", "0"},
+      {"client_limit_ipv4_prefix", "32"},
+      {"client_limit_ipv6_prefix", "128"},
+      {"connection_budget", "0"},
+      {"connection_budget_reserved", "0"},
+      {"connection_budget_weight", "1"},
+      {"priority_clients", ""},
+      {"priority_connections", "10"},
+      {"idle_timeout", "0"},
+      {"max_connection_lifetime", "0"},
+      {"handoff_socket", ""},
+      {"route_by", ""},
+      {"route_map", ""},
+      {"query_route_map", ""},
+      {"destination_sockets", ""},
+      {"proxy_protocol", "0"},
+      {"proxy_protocol_timeout", to_string(routing::kDefaultProxyProtocolTimeout.count())},
+      {"proxy_protocol_trusted_sources", ""},
+      {"server_proxy_protocol", "0"},
+      {"mirror_destination", ""},
+      {"mirror_buffer_size", to_string(routing::kDefaultMirrorBufferSize)},
+      {"mirror_timing", "0"},
   };
 
   auto it = defaults.find(option);
@@ -122,6 +294,148 @@ routing::AccessMode RoutingPluginConfig::get_option_mode(
   return result;
 }
 
+BufferArena::HugePages RoutingPluginConfig::get_option_huge_pages(
+    const mysql_harness::ConfigSection *section, const string &option) const {
+  string value = get_option_string(section, option);
+
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+  BufferArena::HugePages result;
+  if (value == "none") {
+    result = BufferArena::HugePages::kNone;
+  } else if (value == "transparent") {
+    result = BufferArena::HugePages::kTransparent;
+  } else if (value == "explicit") {
+    result = BufferArena::HugePages::kExplicit;
+  } else {
+    throw invalid_argument(get_log_prefix(option) + " is invalid; valid are none, transparent, explicit (was '" +
+                           value + "')");
+  }
+  if (!BufferArena::is_supported(result)) {
+    throw invalid_argument(get_log_prefix(option) + " '" + value +
+                           "' is not supported on this platform");
+  }
+  return result;
+}
+
+bool RoutingPluginConfig::get_option_splice(
+    const mysql_harness::ConfigSection *section, const string &option) {
+  bool result = get_uint_option<uint16_t>(section, option, 0, 1) == 1;
+
+  if (result && !SpliceForwarder::is_supported()) {
+    throw invalid_argument(get_log_prefix(option) + " is not supported on this platform");
+  }
+  return result;
+}
+
+std::vector<unsigned int> RoutingPluginConfig::get_option_weights(
+    const mysql_harness::ConfigSection *section, const string &option) const {
+  const string value = get_option_string(section, option);
+  std::vector<unsigned int> result;
+  if (value.empty()) return result;
+
+  std::stringstream ss(value);
+  string part;
+  while (std::getline(ss, part, ',')) {
+    part.erase(0, part.find_first_not_of(" \t"));
+    part.erase(part.find_last_not_of(" \t") + 1);
+
+    char *rest;
+    errno = 0;
+    unsigned long weight = std::strtoul(part.c_str(), &rest, 10);
+    if (part.empty() || errno > 0 || *rest != '\0' || part[0] == '-' ||
+        weight < 1 || weight > kMaxDestinationWeight) {
+      throw invalid_argument(get_log_prefix(option) + " needs weights between 1 and " +
+                             to_string(kMaxDestinationWeight) + " inclusive, was '" + part + "'");
+    }
+    result.push_back(static_cast<unsigned int>(weight));
+  }
+  return result;
+}
+
+std::vector<unsigned int> RoutingPluginConfig::get_option_cpu_affinity(
+    const mysql_harness::ConfigSection *section, const string &option) const {
+  const string value = get_option_string(section, option);
+  try {
+    return mysql_harness::parse_cpu_list(value);
+  } catch (const invalid_argument &e) {
+    throw invalid_argument(get_log_prefix(option) + " needs a list of CPUs like '0-3,8', was '" +
+                           value + "': " + e.what());
+  }
+}
+
+std::shared_ptr<const routing::SourceAddressPool> RoutingPluginConfig::get_option_source_addresses(
+    const mysql_harness::ConfigSection *section, const string &option) const {
+  const string value = get_option_string(section, option);
+  if (value.empty()) return nullptr;
+
+  const std::vector<string> addresses = get_option_list(section, option);
+  try {
+    return std::make_shared<routing::SourceAddressPool>(addresses);
+  } catch (const invalid_argument &e) {
+    throw invalid_argument(get_log_prefix(option) + " needs a list of IP addresses, " + e.what());
+  }
+}
+
+std::vector<string> RoutingPluginConfig::get_option_list(const mysql_harness::ConfigSection *section,
+                                                         const string &option) const {
+  std::vector<string> result;
+  std::stringstream ss(get_option_string(section, option));
+  string part;
+  while (std::getline(ss, part, ',')) {
+    part.erase(0, part.find_first_not_of(" \t"));
+    part.erase(part.find_last_not_of(" \t") + 1);
+    result.push_back(part);
+  }
+  return result;
+}
+
+std::pair<uint16_t, uint16_t> RoutingPluginConfig::get_option_port_range(
+    const mysql_harness::ConfigSection *section, const string &option) const {
+  const string value = get_option_string(section, option);
+  if (value.empty()) return std::make_pair(uint16_t{0}, uint16_t{0});
+
+  const auto dash = value.find('-');
+  unsigned long low = 0;
+  unsigned long high = 0;
+  char *rest = nullptr;
+  bool valid = dash != string::npos && dash > 0 && std::isdigit(static_cast<unsigned char>(value[0])) &&
+               dash + 1 < value.size() && std::isdigit(static_cast<unsigned char>(value[dash + 1]));
+  if (valid) {
+    errno = 0;
+    low = std::strtoul(value.c_str(), &rest, 10);
+    valid = errno == 0 && rest == value.c_str() + dash;
+  }
+  if (valid) {
+    high = std::strtoul(value.c_str() + dash + 1, &rest, 10);
+    valid = errno == 0 && *rest == '\0';
+  }
+  if (!valid || low < 1 || high > 65535 || low > high) {
+    throw invalid_argument(get_log_prefix(option) + " needs a port range like '10000-60000', was '" +
+                           value + "'");
+  }
+  return std::make_pair(static_cast<uint16_t>(low), static_cast<uint16_t>(high));
+}
+
+routing::IOEngine RoutingPluginConfig::get_option_io_engine(
+    const mysql_harness::ConfigSection *section, const string &option) const {
+  string value = get_option_string(section, option);
+
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+  routing::IOEngine result = routing::get_io_engine(value);
+  if (result == routing::IOEngine::kUndefined) {
+    const string valid = routing::get_io_engine_names();
+    throw invalid_argument(get_log_prefix(option) + " is invalid; valid are " +
+                           valid + " (was '" + value + "')");
+  }
+  if (result == routing::IOEngine::kEvent && !RoutingIOEngine::is_supported()) {
+    throw invalid_argument(get_log_prefix(option) + " '" + value +
+                           "' is not supported on this platform");
+  }
+  return result;
+}
+
 routing::RoutingStrategy RoutingPluginConfig::get_option_routing_strategy(
     const mysql_harness::ConfigSection *section, const string &option) const {
   string value;
@@ -145,7 +459,9 @@ routing::RoutingStrategy RoutingPluginConfig::get_option_routing_strategy(
 
   auto result = routing::get_routing_strategy(value);
   if (result == routing::RoutingStrategy::kUndefined ||
-      ((result == routing::RoutingStrategy::kRoundRobinWithFallback) && !metadata_cache_)) {
+      ((result == routing::RoutingStrategy::kRoundRobinWithFallback) && !metadata_cache_) ||
+      ((result == routing::RoutingStrategy::kLeastConnections ||
+        result == routing::RoutingStrategy::kWeightedRoundRobin) && metadata_cache_)) {
     const string valid = routing::get_routing_strategy_names(metadata_cache_);
     throw invalid_argument(get_log_prefix(option) + " is invalid; valid are " +
                            valid + " (was '" + value + "')");
@@ -188,59 +504,71 @@ string RoutingPluginConfig::get_option_destinations(const mysql_harness::ConfigS
     value = get_default(option);
   }
 
-  try {
-    // disable root-less paths like mailto:foo@example.org to stay
-    // backward compatible with
-    //
-    //   localhost:1234,localhost:1235
-    //
-    // which parse into:
-    //
-    //   scheme: localhost
-    //   path: 1234,localhost:1235
-    auto uri = URI(value, // raises URIError when URI is invalid
-        false  // allow_path_rootless
-        );
-    if (uri.scheme == "metadata-cache") {
-      metadata_cache_ = true;
-    } else {
-      throw invalid_argument(
-        get_log_prefix(option) + " has an invalid URI scheme '" + uri.scheme + "' for URI " + value);
+  // a list starting with a unix socket would parse as URI too
+  if (!routing::is_unix_socket_destination(value)) {
+    try {
+      // disable root-less paths like mailto:foo@example.org to stay
+      // backward compatible with
+      //
+      //   localhost:1234,localhost:1235
+      //
+      // which parse into:
+      //
+      //   scheme: localhost
+      //   path: 1234,localhost:1235
+      auto uri = URI(value, // raises URIError when URI is invalid
+          false  // allow_path_rootless
+          );
+      if (uri.scheme == "metadata-cache") {
+        metadata_cache_ = true;
+      } else {
+        throw invalid_argument(
+          get_log_prefix(option) + " has an invalid URI scheme '" + uri.scheme + "' for URI " + value);
+      }
+      return value;
+    } catch (URIError &) {
     }
-    return value;
-  } catch (URIError &) {
-    char delimiter = ',';
+  }
+
+  char delimiter = ',';
 
-    mysqlrouter::trim(value);
-    if (value.back() == delimiter || value.front() == delimiter) {
+  mysqlrouter::trim(value);
+  if (value.back() == delimiter || value.front() == delimiter) {
+    throw invalid_argument(get_log_prefix(option) +
+                               ": empty address found in destination list (was '" + value + "')");
+  }
+
+  std::stringstream ss(value);
+  std::string part;
+  std::pair<std::string, uint16_t> info;
+  while (std::getline(ss, part, delimiter)) {
+    mysqlrouter::trim(part);
+    if (part.empty()) {
       throw invalid_argument(get_log_prefix(option) +
                                  ": empty address found in destination list (was '" + value + "')");
     }
-
-    std::stringstream ss(value);
-    std::string part;
-    std::pair<std::string, uint16_t> info;
-    while (std::getline(ss, part, delimiter)) {
-      mysqlrouter::trim(part);
-      if (part.empty()) {
-        throw invalid_argument(get_log_prefix(option) +
-                                   ": empty address found in destination list (was '" + value + "')");
-      }
+    if (routing::is_unix_socket_destination(part)) {
       try {
-        info = mysqlrouter::split_addr_port(part);
+        routing::get_unix_socket_address(part);
       } catch (const std::runtime_error &e) {
         throw invalid_argument(get_log_prefix(option) +
                                    ": address in destination list '" + part + "' is invalid: " + e.what());
       }
-      if (info.second == 0) {
-       info.second = Protocol::get_default_port(protocol_type);
-      }
-      mysql_harness::TCPAddress addr(info.first, info.second);
-      if (!addr.is_valid()) {
-        throw invalid_argument(get_log_prefix(option) + " has an invalid destination address '" + addr.str() + "'");
-      }
+      continue;
+    }
+    try {
+      info = mysqlrouter::split_addr_port(part);
+    } catch (const std::runtime_error &e) {
+      throw invalid_argument(get_log_prefix(option) +
+                                 ": address in destination list '" + part + "' is invalid: " + e.what());
+    }
+    if (info.second == 0) {
+     info.second = Protocol::get_default_port(protocol_type);
+    }
+    mysql_harness::TCPAddress addr(info.first, info.second);
+    if (!addr.is_valid()) {
+      throw invalid_argument(get_log_prefix(option) + " has an invalid destination address '" + addr.str() + "'");
     }
-
   }
 
   return value;
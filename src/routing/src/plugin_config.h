@@ -32,13 +32,17 @@
 #include "mysqlrouter/routing.h"
 #include "mysqlrouter/uri.h"
 #include "mysqlrouter/utils.h"
+#include "buffer_arena.h"
 #include "protocol/protocol.h"
 #include "tcp_address.h"
 
 #include "utils.h"
 
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 using std::map;
 using std::string;
@@ -80,6 +84,8 @@ public:
   const mysql_harness::Path named_socket;
   /** @brief `connect_timeout` option read from configuration section */
   const int connect_timeout;
+  /** @brief `connect_deadline` option read from configuration section */
+  const unsigned int connect_deadline;
   /** @brief `mode` option read from configuration section */
   const routing::AccessMode mode;
   /** @brief `routing_strategy` option read from configuration section */
@@ -88,17 +94,189 @@ public:
   const int max_connections;
   /** @brief `max_connect_errors` option read from configuration section */
   const unsigned long long max_connect_errors;
+  /** @brief `share_connect_errors` option read from configuration section */
+  const bool share_connect_errors;
   /** @brief `client_connect_timeout` option read from configuration section */
   const unsigned int client_connect_timeout;
   /** @brief Size of buffer to receive packets */
   const unsigned int net_buffer_length;
+  /** @brief `max_net_buffer_length` option read from configuration section */
+  const unsigned int max_net_buffer_length;
   /** @brief memory in kilobytes allocated for thread's stack */
   const unsigned int thread_stack_size;
+  /** @brief memory in kilobytes allocated for the stack of per-connection threads */
+  const unsigned int connection_thread_stack_size;
+  /** @brief `io_engine` option read from configuration section */
+  const routing::IOEngine io_engine;
+  /** @brief `io_threads` option read from configuration section */
+  const unsigned int io_threads;
+  /** @brief `io_uring` option read from configuration section */
+  const bool io_uring;
+  /** @brief `fair_share_quantum` option read from configuration section (bytes) */
+  const unsigned int fair_share_quantum;
+  /** @brief `max_bandwidth` option read from configuration section (kilobytes per second) */
+  const unsigned int max_bandwidth;
+  /** @brief `splice` option read from configuration section */
+  const bool splice;
+  /** @brief `buffer_pool_size` option read from configuration section */
+  const unsigned int buffer_pool_size;
+  /** @brief `connection_pool_size` option read from configuration section */
+  const unsigned int connection_pool_size;
+  /** @brief `connection_pool_idle_timeout` option read from configuration section */
+  const unsigned int connection_pool_idle_timeout;
+  /** @brief `connection_multiplexing` option read from configuration section */
+  const bool connection_multiplexing;
+  /** @brief `prepared_statement_cache_size` option read from configuration section */
+  const unsigned int prepared_statement_cache_size;
+  /** @brief `session_migration` option read from configuration section */
+  const bool session_migration;
+  /** @brief `client_ssl_cert` option read from configuration section */
+  const std::string client_ssl_cert;
+  /** @brief `client_ssl_key` option read from configuration section */
+  const std::string client_ssl_key;
+  /** @brief `client_ssl_kernel_tls` option read from configuration section */
+  const bool client_ssl_kernel_tls;
+  /** @brief `server_compression` option read from configuration section */
+  const bool server_compression;
+  /** @brief `query_digest_sampling` option read from configuration section */
+  const unsigned int query_digest_sampling;
+  /** @brief `result_cache_size` option read from configuration section */
+  const unsigned int result_cache_size;
+  /** @brief `result_cache_ttl` option read from configuration section, in milliseconds */
+  const unsigned int result_cache_ttl;
+  /** @brief `result_cache_statements` option read from configuration section */
+  const std::string result_cache_statements;
+  /** @brief `acceptor_threads` option read from configuration section */
+  const unsigned int acceptor_threads;
+  /** @brief `tcp_fastopen` option read from configuration section */
+  const unsigned int tcp_fastopen;
+  /** @brief `tcp_defer_accept` option read from configuration section */
+  const unsigned int tcp_defer_accept;
+  /** @brief `socket_rcvbuf` option read from configuration section */
+  const unsigned int socket_rcvbuf;
+  /** @brief `socket_sndbuf` option read from configuration section */
+  const unsigned int socket_sndbuf;
+  /** @brief `tcp_keepalive` option read from configuration section */
+  const bool tcp_keepalive;
+  /** @brief `tcp_keepalive_idle` option read from configuration section (seconds) */
+  const unsigned int tcp_keepalive_idle;
+  /** @brief `tcp_keepalive_interval` option read from configuration section (seconds) */
+  const unsigned int tcp_keepalive_interval;
+  /** @brief `tcp_keepalive_count` option read from configuration section */
+  const unsigned int tcp_keepalive_count;
+  /** @brief `tcp_user_timeout` option read from configuration section (milliseconds) */
+  const unsigned int tcp_user_timeout;
+  /** @brief `source_addresses` option read from configuration section, nullptr if not set */
+  const std::shared_ptr<const routing::SourceAddressPool> source_addresses;
+  /** @brief `source_port_range` option read from configuration section, 0 to 0 if not set */
+  const std::pair<uint16_t, uint16_t> source_port_range;
+  /** @brief `output_queue_high_watermark` option read from configuration section */
+  const unsigned int output_queue_high_watermark;
+  /** @brief `output_queue_low_watermark` option read from configuration section */
+  const unsigned int output_queue_low_watermark;
+  /** @brief `zero_copy_threshold` option read from configuration section */
+  const unsigned int zero_copy_threshold;
+  /** @brief `buffer_huge_pages` option read from configuration section */
+  const BufferArena::HugePages buffer_huge_pages;
+  /** @brief `quarantine_interval` option read from configuration section (milliseconds) */
+  const unsigned int quarantine_interval;
+  /** @brief `quarantine_max_interval` option read from configuration section (milliseconds) */
+  const unsigned int quarantine_max_interval;
+  /** @brief `destination_weights` option read from configuration section */
+  const std::vector<unsigned int> destination_weights;
+  /** @brief `latency_tolerance` option read from configuration section (milliseconds) */
+  const unsigned int latency_tolerance;
+  /** @brief `connect_hedge_percentile` option read from configuration section */
+  const unsigned int connect_hedge_percentile;
+  /** @brief `max_connections_per_destination` option read from configuration section */
+  const unsigned int max_connections_per_destination;
+  /** @brief `slow_start_window` option read from configuration section (milliseconds) */
+  const unsigned int slow_start_window;
+  /** @brief `circuit_breaker_failures` option read from configuration section */
+  const unsigned int circuit_breaker_failures;
+  /** @brief `circuit_breaker_open_interval` option read from configuration section (milliseconds) */
+  const unsigned int circuit_breaker_open_interval;
+  /** @brief `circuit_breaker_half_open_connections` option read from configuration section */
+  const unsigned int circuit_breaker_half_open_connections;
+  /** @brief `connection_trace` option read from configuration section */
+  const bool connection_trace;
+  /** @brief `cpu_affinity` option read from configuration section */
+  const std::vector<unsigned int> cpu_affinity;
+  /** @brief `drain_timeout` option read from configuration section (seconds) */
+  const unsigned int drain_timeout;
+  /** @brief `admission_queue_size` option read from configuration section */
+  const unsigned int admission_queue_size;
+  /** @brief `admission_queue_timeout` option read from configuration section (milliseconds) */
+  const unsigned int admission_queue_timeout;
+  /** @brief `warm_connections` option read from configuration section */
+  const unsigned int warm_connections;
+  /** @brief `warm_connection_max_age` option read from configuration section (milliseconds) */
+  const unsigned int warm_connection_max_age;
+  /** @brief `client_connection_rate` option read from configuration section (per second) */
+  const unsigned int client_connection_rate;
+  /** @brief `client_connection_burst` option read from configuration section, 0 for the rate */
+  const unsigned int client_connection_burst;
+  /** @brief `client_max_connections` option read from configuration section */
+  const unsigned int client_max_connections;
+  /** @brief `client_limit_ipv4_prefix` option read from configuration section */
+  const unsigned int client_limit_ipv4_prefix;
+  /** @brief `client_limit_ipv6_prefix` option read from configuration section */
+  const unsigned int client_limit_ipv6_prefix;
+  /** @brief `connection_budget` option read from configuration section */
+  const unsigned int connection_budget;
+  /** @brief `connection_budget_reserved` option read from configuration section */
+  const unsigned int connection_budget_reserved;
+  /** @brief `connection_budget_weight` option read from configuration section */
+  const unsigned int connection_budget_weight;
+  /** @brief `priority_clients` option read from configuration section */
+  const std::vector<std::string> priority_clients;
+  /** @brief `priority_connections` option read from configuration section */
+  const unsigned int priority_connections;
+  /** @brief `idle_timeout` option read from configuration section (seconds) */
+  const unsigned int idle_timeout;
+  /** @brief `max_connection_lifetime` option read from configuration section (seconds) */
+  const unsigned int max_connection_lifetime;
+  /** @brief `handoff_socket` option read from configuration section */
+  const std::string handoff_socket;
+  /** @brief `route_by` option read from configuration section */
+  const std::string route_by;
+  /** @brief `route_map` option read from configuration section */
+  const std::string route_map;
+  /** @brief `query_route_map` option read from configuration section */
+  const std::string query_route_map;
+  /** @brief `destination_sockets` option read from configuration section */
+  const std::string destination_sockets;
+  /** @brief `proxy_protocol` option read from configuration section */
+  const bool proxy_protocol;
+  /** @brief `proxy_protocol_timeout` option read from configuration section (milliseconds) */
+  const unsigned int proxy_protocol_timeout;
+  /** @brief `proxy_protocol_trusted_sources` option read from configuration section */
+  const std::vector<std::string> proxy_protocol_trusted_sources;
+  /** @brief `server_proxy_protocol` option read from configuration section */
+  const bool server_proxy_protocol;
+  /** @brief `mirror_destination` option read from configuration section, without addr if not set */
+  const mysql_harness::TCPAddress mirror_destination;
+  /** @brief `mirror_buffer_size` option read from configuration section */
+  const unsigned int mirror_buffer_size;
+  /** @brief `mirror_timing` option read from configuration section */
+  const bool mirror_timing;
 protected:
 
 private:
 
   routing::AccessMode get_option_mode(const mysql_harness::ConfigSection *section, const std::string &option) const;
+  bool get_option_splice(const mysql_harness::ConfigSection *section, const std::string &option);
+  std::vector<unsigned int> get_option_weights(const mysql_harness::ConfigSection *section, const std::string &option) const;
+  std::vector<unsigned int> get_option_cpu_affinity(const mysql_harness::ConfigSection *section, const std::string &option) const;
+  std::shared_ptr<const routing::SourceAddressPool> get_option_source_addresses(
+      const mysql_harness::ConfigSection *section, const std::string &option) const;
+  std::vector<std::string> get_option_list(const mysql_harness::ConfigSection *section,
+                                           const std::string &option) const;
+  std::pair<uint16_t, uint16_t> get_option_port_range(const mysql_harness::ConfigSection *section,
+                                                      const std::string &option) const;
+  routing::IOEngine get_option_io_engine(const mysql_harness::ConfigSection *section, const std::string &option) const;
+  BufferArena::HugePages get_option_huge_pages(const mysql_harness::ConfigSection *section,
+                                               const std::string &option) const;
   routing::RoutingStrategy get_option_routing_strategy(const mysql_harness::ConfigSection *section, const std::string &option) const;
   std::string get_option_destinations(const mysql_harness::ConfigSection *section, const std::string &option,
                                       const Protocol::Type &protocol_type) const;
@@ -0,0 +1,190 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "prepared_statements.h"
+
+#include "mysqlrouter/mysql_protocol.h"
+#include "protocol/classic_handshake.h"
+
+constexpr uint32_t PreparedStatementTranslator::kInvalidId;
+
+static constexpr uint8_t kComStmtPrepare = 0x16;
+static constexpr uint8_t kComStmtExecute = 0x17;
+static constexpr uint8_t kComStmtSendLongData = 0x18;
+static constexpr uint8_t kComStmtClose = 0x19;
+static constexpr uint8_t kComStmtReset = 0x1a;
+static constexpr uint8_t kComStmtFetch = 0x1c;
+static constexpr uint8_t kOkHeader = 0x00;
+static constexpr uint8_t kErrorHeader = 0xff;
+
+static const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+
+PreparedStatementCache::Statement *PreparedStatementCache::find(const std::string &sql) noexcept {
+  auto it = statements_.find(sql);
+  if (it == statements_.end()) return nullptr;
+
+  it->second.last_used = ++uses_;
+  return &it->second;
+}
+
+PreparedStatementCache::Statement &PreparedStatementCache::add(const std::string &sql, Statement statement) {
+  statement.last_used = ++uses_;
+  Statement &added = statements_[sql];
+  added = std::move(statement);
+  return added;
+}
+
+bool PreparedStatementCache::erase(const std::string &sql, uint32_t &id) {
+  auto it = statements_.find(sql);
+  if (it == statements_.end()) return false;
+
+  id = it->second.id;
+  statements_.erase(it);
+  return true;
+}
+
+bool PreparedStatementCache::evict(const std::function<bool(const std::string&)> &in_use, uint32_t &id) {
+  auto oldest = statements_.end();
+  for (auto it = statements_.begin(); it != statements_.end(); ++it) {
+    if ((oldest == statements_.end() || it->second.last_used < oldest->second.last_used) &&
+        !in_use(it->first)) {
+      oldest = it;
+    }
+  }
+  if (oldest == statements_.end()) return false;
+
+  id = oldest->second.id;
+  statements_.erase(oldest);
+  return true;
+}
+
+bool PreparedStatementTranslator::refers_to_statement(uint8_t command) noexcept {
+  switch (command) {
+    case kComStmtExecute:
+    case kComStmtSendLongData:
+    case kComStmtClose:
+    case kComStmtReset:
+    case kComStmtFetch:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint32_t PreparedStatementTranslator::add(const std::string &sql, uint16_t params) {
+  // skip ids still in use once the counter wrapped around
+  while (next_id_ == kInvalidId || statements_.count(next_id_) > 0) ++next_id_;
+
+  const uint32_t id = next_id_++;
+  statements_[id] = Statement{sql, params, {}};
+  return id;
+}
+
+PreparedStatementTranslator::Statement *PreparedStatementTranslator::find(uint32_t id) noexcept {
+  auto it = statements_.find(id);
+  return it == statements_.end() ? nullptr : &it->second;
+}
+
+bool PreparedStatementTranslator::uses(const std::string &sql) const noexcept {
+  for (const auto &statement: statements_) {
+    if (statement.second.sql == sql) return true;
+  }
+  return false;
+}
+
+bool PreparedStatementTranslator::parse_prepare_ok(const RoutingProtocolBuffer &response,
+                                                   uint32_t &id, uint16_t &params) noexcept {
+  // status, statement id, columns, parameters, filler, warnings
+  if (response.size() < kHeaderSize + 12 || response[kHeaderSize] != kOkHeader) return false;
+
+  id = read_id(&response[kHeaderSize + 1]);
+  params = static_cast<uint16_t>(response[kHeaderSize + 7] | response[kHeaderSize + 8] << 8);
+  return true;
+}
+
+bool PreparedStatementTranslator::read_prepare_response(mysql_harness::SocketOperationsBase *sock_ops,
+                                                        int sock, std::chrono::milliseconds timeout,
+                                                        bool deprecate_eof,
+                                                        RoutingProtocolBuffer &response) {
+  RoutingProtocolBuffer packet;
+  if (!classic_handshake::read_packet(sock_ops, sock, packet, timeout)) return false;
+  response = packet;
+  if (packet.size() > kHeaderSize && packet[kHeaderSize] == kErrorHeader) return true;
+
+  uint32_t id;
+  uint16_t params;
+  if (!parse_prepare_ok(packet, id, params)) return false;
+  const uint16_t columns = static_cast<uint16_t>(packet[kHeaderSize + 5] | packet[kHeaderSize + 6] << 8);
+
+  // definitions of the parameters and of the columns, each followed by EOF
+  for (uint16_t definitions: {params, columns}) {
+    const size_t packets = definitions + (definitions > 0 && !deprecate_eof ? 1 : 0);
+    for (size_t i = 0; i < packets; ++i) {
+      if (!classic_handshake::read_packet(sock_ops, sock, packet, timeout)) return false;
+      response.insert(response.end(), packet.begin(), packet.end());
+    }
+  }
+
+  return true;
+}
+
+RoutingProtocolBuffer PreparedStatementTranslator::make_prepare(const std::string &sql) {
+  const size_t size = sql.size() + 1;
+  if (size >= ClassicPacketFramer::kMaxPayloadSize) {
+    throw mysql_protocol::packet_error("statement too large");
+  }
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                               static_cast<uint8_t>(size >> 16), 0, kComStmtPrepare};
+  packet.insert(packet.end(), sql.begin(), sql.end());
+  return packet;
+}
+
+RoutingProtocolBuffer PreparedStatementTranslator::make_close(uint32_t id) {
+  RoutingProtocolBuffer packet{0x05, 0x00, 0x00, 0x00, kComStmtClose, 0, 0, 0, 0};
+  write_id(&packet[kHeaderSize + 1], id);
+  return packet;
+}
+
+bool PreparedStatementTranslator::add_param_types(const uint8_t *packet, size_t size, uint16_t params,
+                                                  const std::vector<uint8_t> &types,
+                                                  RoutingProtocolBuffer &result) {
+  const size_t flag_offset = kHeaderSize + param_types_offset(params);
+  if (size <= flag_offset || size - kHeaderSize != mysql_protocol::Packet::read_payload_size(packet) ||
+      packet[flag_offset] != 0 || types.size() != 2u * params) {
+    return false;
+  }
+
+  const size_t payload_size = size - kHeaderSize + types.size();
+  if (payload_size >= ClassicPacketFramer::kMaxPayloadSize) return false;
+
+  result.assign(packet, packet + flag_offset);
+  result[0] = static_cast<uint8_t>(payload_size);
+  result[1] = static_cast<uint8_t>(payload_size >> 8);
+  result[2] = static_cast<uint8_t>(payload_size >> 16);
+  result.push_back(1);
+  result.insert(result.end(), types.begin(), types.end());
+  result.insert(result.end(), packet + flag_offset + 1, packet + size);
+  return true;
+}
@@ -0,0 +1,220 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_PREPARED_STATEMENTS_INCLUDED
+#define ROUTING_PREPARED_STATEMENTS_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "protocol/base_protocol.h"
+#include "protocol/classic_framer.h"
+
+namespace mysql_harness { class SocketOperationsBase; }
+
+/** @class PreparedStatementCache
+ *
+ * Statements prepared in the session of a server connection, by statement
+ * text.
+ *
+ * The cache travels with the session when it is released to the pool, so
+ * the next client taking the session finds the statements it prepares
+ * already there and doesn't need a round trip to the server.
+ */
+class PreparedStatementCache {
+ public:
+  /** @brief statement prepared in the session */
+  struct Statement {
+    /** @brief id of the statement in the session */
+    uint32_t id{0};
+    /** @brief number of parameters of the statement */
+    uint16_t params{0};
+    /** @brief response of the server to COM_STMT_PREPARE, including headers */
+    RoutingProtocolBuffer response;
+    /** @brief parameter types the statement was last bound with, empty if never */
+    std::vector<uint8_t> param_types;
+    uint64_t last_used{0};
+  };
+
+  /** @brief returns statement prepared for sql, nullptr if there is none */
+  Statement *find(const std::string &sql) noexcept;
+
+  /** @brief adds statement prepared for sql */
+  Statement &add(const std::string &sql, Statement statement);
+
+  /**
+   * @brief Removes statement prepared for sql.
+   *
+   * @param sql text of the statement
+   * @param id set to the id of the statement removed
+   *
+   * @return false if there was no statement for sql
+   */
+  bool erase(const std::string &sql, uint32_t &id);
+
+  /**
+   * @brief Removes least recently used statement.
+   *
+   * @param in_use tells statements that must be kept, by their text
+   * @param id set to the id of the statement removed
+   *
+   * @return false if all statements are in use
+   */
+  bool evict(const std::function<bool(const std::string&)> &in_use, uint32_t &id);
+
+  size_t size() const noexcept { return statements_.size(); }
+
+  /** @brief forgets about all statements, e.g. after the session was reset */
+  void clear() noexcept { statements_.clear(); }
+
+ private:
+  std::map<std::string, Statement> statements_;
+  uint64_t uses_{0};
+};
+
+/** @class PreparedStatementTranslator
+ *
+ * Prepared statements of a classic protocol client whose commands go to
+ * different server sessions.
+ *
+ * Statement ids are only valid in the server session that prepared the
+ * statement, so the client gets ids assigned by the router. The router
+ * replaces them with the id the statement has in the session of the
+ * current server connection and prepares the statement there first if it
+ * isn't yet.
+ */
+class PreparedStatementTranslator {
+ public:
+  /** @brief statement prepared by the client */
+  struct Statement {
+    std::string sql;
+    uint16_t params;
+    /** @brief parameter types the client last bound, empty if never */
+    std::vector<uint8_t> param_types;
+  };
+
+  /** @brief id the server never hands out, commands using it fail */
+  static constexpr uint32_t kInvalidId = 0;
+
+  /** @brief offset of the new-params-bound flag in the payload of COM_STMT_EXECUTE */
+  static size_t param_types_offset(uint16_t params) noexcept {
+    return 10 + (params + 7) / 8;
+  }
+
+  /** @brief true if the command refers to a prepared statement by its id */
+  static bool refers_to_statement(uint8_t command) noexcept;
+
+  /** @brief assigns an id to a statement the client prepared */
+  uint32_t add(const std::string &sql, uint16_t params);
+
+  /** @brief returns statement having the id, nullptr if there is none */
+  Statement *find(uint32_t id) noexcept;
+
+  void erase(uint32_t id) noexcept { statements_.erase(id); }
+
+  /** @brief true if a statement of the client has the text */
+  bool uses(const std::string &sql) const noexcept;
+
+  /** @brief forgets about all statements, e.g. after the session was reset */
+  void clear() noexcept { statements_.clear(); }
+
+  /** @brief packet boundaries of what the client sent so far */
+  ClassicPacketFramer &client_framer() noexcept { return client_framer_; }
+
+  /** @brief text of the COM_STMT_PREPARE being received, if is_receiving_prepare() */
+  std::string &prepare_sql() noexcept { return prepare_sql_; }
+
+  /** @brief true while a COM_STMT_PREPARE is split over several reads */
+  bool is_receiving_prepare() const noexcept { return receiving_prepare_; }
+  void set_receiving_prepare(bool receiving) noexcept { receiving_prepare_ = receiving; }
+
+  static uint32_t read_id(const uint8_t *data) noexcept {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+           static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+  }
+
+  static void write_id(uint8_t *data, uint32_t id) noexcept {
+    data[0] = static_cast<uint8_t>(id);
+    data[1] = static_cast<uint8_t>(id >> 8);
+    data[2] = static_cast<uint8_t>(id >> 16);
+    data[3] = static_cast<uint8_t>(id >> 24);
+  }
+
+  /**
+   * @brief Reads the statement id and number of parameters from a response to COM_STMT_PREPARE.
+   *
+   * @return false if the response is an error or malformed
+   */
+  static bool parse_prepare_ok(const RoutingProtocolBuffer &response, uint32_t &id, uint16_t &params) noexcept;
+
+  /**
+   * @brief Reads the complete response to COM_STMT_PREPARE.
+   *
+   * @param sock_ops socket operations
+   * @param sock socket connected to the server
+   * @param timeout max time to wait for each packet
+   * @param deprecate_eof true if the session has CLIENT_DEPRECATE_EOF set
+   * @param response set to the packets of the response
+   *
+   * @return false if the socket failed or the response is malformed
+   */
+  static bool read_prepare_response(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                                    std::chrono::milliseconds timeout, bool deprecate_eof,
+                                    RoutingProtocolBuffer &response);
+
+  /** @brief COM_STMT_PREPARE packet for sql */
+  static RoutingProtocolBuffer make_prepare(const std::string &sql);
+
+  /** @brief COM_STMT_CLOSE packet for the statement */
+  static RoutingProtocolBuffer make_close(uint32_t id);
+
+  /**
+   * @brief Adds parameter types to a COM_STMT_EXECUTE sent without them.
+   *
+   * @param packet complete COM_STMT_EXECUTE packet including the header
+   * @param size number of bytes at packet
+   * @param params number of parameters of the statement
+   * @param types parameter types to add
+   * @param result set to the packet with the types
+   *
+   * @return false if the packet is malformed or gets too large
+   */
+  static bool add_param_types(const uint8_t *packet, size_t size, uint16_t params,
+                              const std::vector<uint8_t> &types, RoutingProtocolBuffer &result);
+
+ private:
+  std::map<uint32_t, Statement> statements_;
+  uint32_t next_id_{1};
+
+  ClassicPacketFramer client_framer_;
+  std::string prepare_sql_;
+  bool receiving_prepare_{false};
+};
+
+#endif // ROUTING_PREPARED_STATEMENTS_INCLUDED
@@ -0,0 +1,87 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_PRIORITY_LANE_INCLUDED
+#define ROUTING_PRIORITY_LANE_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "client_networks.h"
+
+/**
+ * @brief PriorityLane keeps some connections of a route for known clients.
+ *
+ * Clients of the lane's networks, like monitoring agents or the DBAs'
+ * hosts, take one of its connections before the route's limits get
+ * checked, so they still get in when the route is saturated. Once the
+ * lane is full they are treated like any other client.
+ *
+ * Taking a connection of the lane is an atomic increment.
+ */
+class PriorityLane {
+ public:
+  /**
+   * @param networks addresses of hosts or networks like '10.0.0.0/8' or
+   *        'fd00::/8', IPv4 networks also match clients connecting to a
+   *        dual-stack listener with IPv4
+   * @param max_connections connections kept for the clients, at least 1
+   *
+   * @throws std::invalid_argument if a network is invalid
+   */
+  PriorityLane(const std::vector<std::string> &networks, size_t max_connections);
+
+  PriorityLane(const PriorityLane &) = delete;
+  PriorityLane &operator=(const PriorityLane &) = delete;
+
+  /** @brief true if the client is in one of the networks */
+  bool matches(const sockaddr_storage &client_addr) const noexcept {
+    return networks_.matches(client_addr);
+  }
+
+  /**
+   * @brief Takes a connection of the lane.
+   *
+   * @return false if the lane has no connection left
+   */
+  bool acquire() noexcept;
+
+  /** @brief Gives back a connection taken with acquire() */
+  void release() noexcept { used_.fetch_sub(1, std::memory_order_relaxed); }
+
+  /** @brief connections of the lane the clients have */
+  size_t get_used() const noexcept { return used_.load(std::memory_order_relaxed); }
+
+  size_t get_max_connections() const noexcept { return max_connections_; }
+
+ private:
+  const ClientNetworks networks_;
+  const size_t max_connections_;
+  std::atomic<size_t> used_{0};
+};
+
+#endif  // ROUTING_PRIORITY_LANE_INCLUDED
@@ -39,6 +39,34 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 using RoutingProtocolBuffer = mysql_protocol::Packet::vector_t;
 
+/**
+ * @brief Buffer data is read into, not owning its memory.
+ *
+ * Refers to a RoutingProtocolBuffer or to a buffer of a RoutingBufferPool.
+ */
+class RoutingBufferRef {
+public:
+  RoutingBufferRef(uint8_t *data, size_t size) noexcept : data_(data), size_(size) {}
+
+  /** @brief refers to the elements of buffer, which must not be resized meanwhile */
+  RoutingBufferRef(RoutingProtocolBuffer &buffer) noexcept  // NOLINT(runtime/explicit)
+      : data_(buffer.data()), size_(buffer.size()) {}
+
+  uint8_t *data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  uint8_t &operator[](size_t pos) const noexcept { return data_[pos]; }
+  uint8_t &front() const noexcept { return data_[0]; }
+
+  uint8_t *begin() const noexcept { return data_; }
+  uint8_t *end() const noexcept { return data_ + size_; }
+
+private:
+  uint8_t *data_;
+  size_t size_;
+};
+
 namespace routing {
   class RoutingSockOpsInterface;
 }
@@ -85,10 +113,34 @@ public:
    * @return 0 on success; -1 on error
    */
   virtual int copy_packets(int sender, int receiver, bool sender_is_readable,
-                           RoutingProtocolBuffer &buffer, int *curr_pktnr,
+                           RoutingBufferRef buffer, int *curr_pktnr,
                            bool &handshake_done, size_t *report_bytes_read,
                            bool from_server) = 0;
 
+  /** @brief Like copy_packets(), without waiting for the rest of a packet
+   *         of the handshake
+   *
+   * The part of a handshake packet which didn't arrive completely yet is
+   * kept in partial_packet instead of being read with a blocking read. The
+   * next call puts it in front of what it reads, once the sender is
+   * readable again. The threads of the event I/O engine must not block.
+   *
+   * Protocols which don't wait for packets call copy_packets().
+   *
+   * @param partial_packet part of a packet kept by the previous call for
+   *        the same sender, empty at first
+   *
+   * @return 0 on success; -1 on error
+   */
+  virtual int copy_packets_resumable(int sender, int receiver, bool sender_is_readable,
+                                     RoutingBufferRef buffer, int *curr_pktnr,
+                                     bool &handshake_done, size_t *report_bytes_read,
+                                     bool from_server, RoutingProtocolBuffer &partial_packet) {
+    (void)partial_packet;
+    return copy_packets(sender, receiver, sender_is_readable, buffer, curr_pktnr,
+                        handshake_done, report_bytes_read, from_server);
+  }
+
   /** @brief Sends error message to the provided receiver.
    *
    * This function sends protocol message containing MySQL error
@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "classic_compression.h"
+
+#include <algorithm>
+
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+constexpr size_t ClassicCompression::kHeaderSize;
+constexpr size_t ClassicCompression::kMinCompressLength;
+constexpr size_t ClassicCompression::kMaxPayloadSize;
+
+namespace {
+
+void store_int3(uint8_t *dst, size_t value) {
+  dst[0] = static_cast<uint8_t>(value);
+  dst[1] = static_cast<uint8_t>(value >> 8);
+  dst[2] = static_cast<uint8_t>(value >> 16);
+}
+
+size_t read_int3(const uint8_t *src) {
+  return static_cast<size_t>(src[0]) | static_cast<size_t>(src[1]) << 8 |
+         static_cast<size_t>(src[2]) << 16;
+}
+
+} // namespace
+
+#ifdef HAVE_ZLIB
+
+/*static*/
+bool ClassicCompression::is_supported() noexcept {
+  return true;
+}
+
+void ClassicCompression::add_packet(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  const size_t header_pos = out.size();
+  out.resize(header_pos + kHeaderSize);
+
+  size_t compressed_size = 0;
+  if (size >= kMinCompressLength) {
+    uLongf dest_size = compressBound(static_cast<uLong>(size));
+    out.resize(header_pos + kHeaderSize + dest_size);
+    if (::compress(&out[header_pos + kHeaderSize], &dest_size, data, static_cast<uLong>(size)) == Z_OK &&
+        dest_size < size) {
+      compressed_size = dest_size;
+    }
+  }
+
+  if (compressed_size > 0) {
+    out.resize(header_pos + kHeaderSize + compressed_size);
+    store_int3(&out[header_pos], compressed_size);
+    store_int3(&out[header_pos + 4], size);
+  } else {
+    // not worth it, the payload goes as it is
+    out.resize(header_pos + kHeaderSize);
+    out.insert(out.end(), data, data + size);
+    store_int3(&out[header_pos], size);
+    store_int3(&out[header_pos + 4], 0);
+  }
+  out[header_pos + 3] = sequence_id_++;
+}
+
+bool ClassicCompression::decompress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  out.clear();
+  compressed_bytes_ += size;
+
+  // compressed packets split over reads are joined first
+  const uint8_t *pos = data;
+  size_t left = size;
+  if (!partial_.empty()) {
+    partial_.insert(partial_.end(), data, data + size);
+    pos = partial_.data();
+    left = partial_.size();
+  }
+
+  while (left >= kHeaderSize) {
+    const size_t compressed_size = read_int3(pos);
+    const size_t plain_size = read_int3(pos + 4);
+    if (left < kHeaderSize + compressed_size) break;
+
+    const uint8_t *payload = pos + kHeaderSize;
+    if (plain_size == 0) {
+      out.insert(out.end(), payload, payload + compressed_size);
+    } else {
+      const size_t out_pos = out.size();
+      out.resize(out_pos + plain_size);
+      uLongf dest_size = static_cast<uLongf>(plain_size);
+      if (::uncompress(&out[out_pos], &dest_size, payload, static_cast<uLong>(compressed_size)) != Z_OK ||
+          dest_size != plain_size) {
+        return false;
+      }
+    }
+    // the next packet to the server continues after the server's
+    sequence_id_ = static_cast<uint8_t>(pos[3] + 1);
+
+    pos += kHeaderSize + compressed_size;
+    left -= kHeaderSize + compressed_size;
+  }
+
+  if (left == 0) {
+    partial_.clear();
+  } else if (partial_.empty()) {
+    partial_.assign(pos, pos + left);
+  } else {
+    partial_.erase(partial_.begin(), partial_.begin() + (pos - partial_.data()));
+  }
+  plain_bytes_ += out.size();
+
+  return true;
+}
+
+#else
+
+/*static*/
+bool ClassicCompression::is_supported() noexcept {
+  return false;
+}
+
+void ClassicCompression::add_packet(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  const size_t header_pos = out.size();
+  out.resize(header_pos + kHeaderSize);
+  out.insert(out.end(), data, data + size);
+  store_int3(&out[header_pos], size);
+  out[header_pos + 3] = sequence_id_++;
+  store_int3(&out[header_pos + 4], 0);
+}
+
+bool ClassicCompression::decompress(const uint8_t *, size_t, RoutingProtocolBuffer &out) {
+  out.clear();
+  return false;
+}
+
+#endif
+
+void ClassicCompression::compress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  out.clear();
+  plain_bytes_ += size;
+
+  // a command of the client starts a new sequence
+  const bool new_command = client_framer_.at_message_boundary();
+  const uint8_t *pos = data;
+  size_t left = size;
+  ClassicPacketFramer::Frame frame;
+  bool first = true;
+  while (client_framer_.next(pos, left, frame)) {
+    if (first && new_command && frame.is_first() && frame.sequence_id == 0) sequence_id_ = 0;
+    first = false;
+  }
+
+  for (size_t offset = 0; offset < size; offset += kMaxPayloadSize) {
+    add_packet(data + offset, std::min(kMaxPayloadSize, size - offset), out);
+  }
+  compressed_bytes_ += out.size();
+}
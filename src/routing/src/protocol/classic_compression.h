@@ -0,0 +1,106 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_CLASSIC_COMPRESSION_INCLUDED
+#define ROUTING_CLASSIC_COMPRESSION_INCLUDED
+
+#include "base_protocol.h"
+#include "classic_framer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/** @class ClassicCompression
+ *
+ * Translates between the plain classic protocol of a client and the
+ * compressed protocol (CLIENT_COMPRESS) spoken with the server.
+ *
+ * Each compressed packet has a 7 byte header: 3 bytes length of the
+ * compressed payload, 1 byte sequence id and 3 bytes length of the payload
+ * before compression, 0 if the payload is sent as it is. The payload holds
+ * plain classic protocol packets, compressed with zlib.
+ *
+ * The bytes of the client are compressed as they are read, one compressed
+ * packet per read. The sequence id of the compressed packets starts at 0
+ * with every command of the client and continues after the compressed
+ * packets of the server, which are turned back into the plain packets.
+ */
+class ClassicCompression {
+ public:
+  static constexpr size_t kHeaderSize = 7;
+
+  /** @brief payloads shorter than this are sent uncompressed, like the server does */
+  static constexpr size_t kMinCompressLength = 50;
+
+  /** @brief max. payload of one compressed packet */
+  static constexpr size_t kMaxPayloadSize = 0xffffff;
+
+  /** @brief Returns true if the router was built with zlib. */
+  static bool is_supported() noexcept;
+
+  /**
+   * @brief Compresses plain packets read from the client.
+   *
+   * @param data bytes read from the client
+   * @param size number of bytes at data
+   * @param out cleared and set to the compressed packets for the server
+   */
+  void compress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out);
+
+  /**
+   * @brief Decompresses compressed packets read from the server.
+   *
+   * Incomplete compressed packets are kept until the rest is fed.
+   *
+   * @param data bytes read from the server
+   * @param size number of bytes at data
+   * @param out cleared and set to the plain packets for the client
+   *
+   * @return false if the bytes aren't valid compressed packets
+   */
+  bool decompress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out);
+
+  /** @brief bytes read from the client and the server, before compression */
+  uint64_t get_plain_bytes() const noexcept { return plain_bytes_; }
+
+  /** @brief bytes sent to and read from the server */
+  uint64_t get_compressed_bytes() const noexcept { return compressed_bytes_; }
+
+ private:
+  void add_packet(const uint8_t *data, size_t size, RoutingProtocolBuffer &out);
+
+  /** @brief finds the commands in the packets of the client */
+  ClassicPacketFramer client_framer_;
+
+  /** @brief sequence id of the next compressed packet to the server */
+  uint8_t sequence_id_{0};
+
+  /** @brief start of a compressed packet of the server, not complete yet */
+  RoutingProtocolBuffer partial_;
+
+  uint64_t plain_bytes_{0};
+  uint64_t compressed_bytes_{0};
+};
+
+#endif // ROUTING_CLASSIC_COMPRESSION_INCLUDED
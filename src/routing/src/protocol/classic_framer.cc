@@ -0,0 +1,70 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "classic_framer.h"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr size_t ClassicPacketFramer::kMaxPayloadSize;
+constexpr size_t ClassicPacketFramer::kHeaderSize;
+
+bool ClassicPacketFramer::next(const uint8_t *&data, size_t &size, Frame &frame) noexcept {
+  if (!in_packet_) {
+    if (size == 0) return false;
+
+    const size_t n = std::min(kHeaderSize - header_size_, size);
+    std::memcpy(header_ + header_size_, data, n);
+    header_size_ += n;
+    data += n;
+    size -= n;
+    if (header_size_ < kHeaderSize) return false;
+
+    header_size_ = 0;
+    in_packet_ = true;
+    sequence_id_ = header_[3];
+    payload_size_ = mysql_protocol::Packet::read_payload_size(header_);
+    payload_left_ = payload_size_;
+    starts_message_ = !continues_message_;
+    continues_message_ = payload_size_ == kMaxPayloadSize;
+  }
+
+  const size_t n = std::min(payload_left_, size);
+  // wait for the payload instead of returning empty frames
+  if (n == 0 && payload_left_ > 0) return false;
+
+  frame.sequence_id = sequence_id_;
+  frame.payload_size = payload_size_;
+  frame.payload = data;
+  frame.length = n;
+  frame.offset = payload_size_ - payload_left_;
+  frame.starts_message = starts_message_;
+
+  data += n;
+  size -= n;
+  payload_left_ -= n;
+  if (payload_left_ == 0) in_packet_ = false;
+
+  return true;
+}
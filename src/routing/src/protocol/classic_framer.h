@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_CLASSIC_FRAMER_INCLUDED
+#define ROUTING_CLASSIC_FRAMER_INCLUDED
+
+#include "mysqlrouter/mysql_protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/** @class ClassicPacketFramer
+ *
+ * Incremental splitter of a classic protocol byte stream into packets.
+ *
+ * The bytes are fed as they are read from the socket, in chunks of any size.
+ * Only the state of the packet being received is kept (a partial header,
+ * the payload bytes still to come); payloads aren't copied but returned as
+ * views into the fed chunk. A packet split over several reads is returned as
+ * several frames, one per read. Messages of 16M or more, sent as a series of
+ * packets of kMaxPayloadSize, are recognized through Frame::starts_message.
+ *
+ * Usage:
+ *
+ *     const uint8_t *data = buffer; size_t size = bytes_read;
+ *     ClassicPacketFramer::Frame frame;
+ *     while (framer.next(data, size, frame)) { ... }
+ */
+class ClassicPacketFramer {
+ public:
+  /** @brief payload size of packets that are followed by another packet of the same message */
+  static constexpr size_t kMaxPayloadSize = 0xffffff;
+
+  /** @brief part of a packet found in the fed bytes */
+  struct Frame {
+    /** @brief sequence id of the packet */
+    uint8_t sequence_id;
+    /** @brief payload size announced in the header of the packet */
+    size_t payload_size;
+    /** @brief part of the payload in the fed bytes, points into them */
+    const uint8_t *payload;
+    /** @brief number of payload bytes at payload */
+    size_t length;
+    /** @brief offset of payload within the payload of the packet */
+    size_t offset;
+    /** @brief false if the packet continues a message of the previous packet */
+    bool starts_message;
+
+    /** @brief true if the payload starts in this frame */
+    bool is_first() const noexcept { return offset == 0; }
+    /** @brief true if the packet ends in this frame */
+    bool is_complete() const noexcept { return offset + length == payload_size; }
+    /** @brief true if the next packet belongs to the same message */
+    bool is_continued() const noexcept { return payload_size == kMaxPayloadSize; }
+  };
+
+  /**
+   * @brief Takes the next frame from the fed bytes.
+   *
+   * Consumes the header bytes and at most the remaining payload of one
+   * packet, data and size are advanced past the consumed bytes.
+   *
+   * @param data bytes read from the socket
+   * @param size number of bytes at data
+   * @param frame set to the frame found
+   *
+   * @return false if all bytes were consumed without completing a frame
+   */
+  bool next(const uint8_t *&data, size_t &size, Frame &frame) noexcept;
+
+  /** @brief true if the bytes fed so far end with a complete packet */
+  bool at_packet_boundary() const noexcept {
+    return !in_packet_ && header_size_ == 0;
+  }
+
+  /** @brief true if the bytes fed so far end with a complete message */
+  bool at_message_boundary() const noexcept {
+    return at_packet_boundary() && !continues_message_;
+  }
+
+  /** @brief bytes still missing to complete the header, or the payload, of the current packet */
+  size_t bytes_wanted() const noexcept {
+    return in_packet_ ? payload_left_ : kHeaderSize - header_size_;
+  }
+
+  /** @brief forgets about the current packet, e.g. after the stream switched to TLS */
+  void reset() noexcept {
+    header_size_ = 0;
+    in_packet_ = false;
+    continues_message_ = false;
+  }
+
+ private:
+  static constexpr size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+
+  uint8_t header_[kHeaderSize];
+  size_t header_size_{0};
+  bool in_packet_{false};
+  bool continues_message_{false};
+  bool starts_message_{true};
+  uint8_t sequence_id_{0};
+  size_t payload_size_{0};
+  size_t payload_left_{0};
+};
+
+#endif // ROUTING_CLASSIC_FRAMER_INCLUDED
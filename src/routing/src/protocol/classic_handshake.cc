@@ -0,0 +1,375 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "classic_handshake.h"
+
+#include "mysqlrouter/sha1.h"
+#include "socket_operations.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+using mysql_protocol::Capabilities::Flags;
+namespace Capabilities = mysql_protocol::Capabilities;
+
+namespace classic_handshake {
+
+static constexpr uint8_t kProtocolVersion = 10;
+static constexpr uint8_t kAuthSwitchRequest = 0xfe;
+static constexpr size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+
+bool parse_server_greeting(RoutingProtocolBuffer &packet, ServerGreeting &greeting,
+                           bool strip_ssl) {
+  if (packet.size() <= kHeaderSize || packet[kHeaderSize] != kProtocolVersion) {
+    return false;
+  }
+
+  // protocol version, server version
+  auto version_end = std::find(packet.begin() + kHeaderSize + 1, packet.end(), 0);
+  if (version_end == packet.end()) return false;
+  size_t pos = static_cast<size_t>(version_end - packet.begin()) + 1;
+
+  //   4  connection id
+  //   8  auth-plugin-data-part-1
+  //   1  filler
+  //   2  capability flags (lower 2 bytes)
+  //   1  character set
+  //   2  status flags
+  //   2  capability flags (upper 2 bytes)
+  //   1  length of auth-plugin-data
+  //  10  reserved
+  //   n  auth-plugin-data-part-2, at least 12 bytes and nul-terminator
+  const size_t kPart1Offset = 4;
+  const size_t kCapabilitiesLowOffset = kPart1Offset + 8 + 1;
+  const size_t kCapabilitiesHighOffset = kCapabilitiesLowOffset + 2 + 1 + 2;
+  const size_t kPart2Offset = kCapabilitiesHighOffset + 2 + 1 + 10;
+  const size_t kPart2Length = kScrambleLength - 8;
+  if (packet.size() < pos + kPart2Offset + kPart2Length) return false;
+
+  const size_t caps_low = pos + kCapabilitiesLowOffset;
+  const size_t caps_high = pos + kCapabilitiesHighOffset;
+  greeting.capabilities = Flags(static_cast<uint32_t>(
+      packet[caps_low] | packet[caps_low + 1] << 8 |
+      packet[caps_high] << 16 | packet[caps_high + 1] << 24));
+
+  greeting.scramble.assign(packet.begin() + static_cast<long>(pos + kPart1Offset),
+                           packet.begin() + static_cast<long>(pos + kPart1Offset + 8));
+  greeting.scramble.insert(greeting.scramble.end(),
+                           packet.begin() + static_cast<long>(pos + kPart2Offset),
+                           packet.begin() + static_cast<long>(pos + kPart2Offset + kPart2Length));
+
+  if (strip_ssl && greeting.capabilities.test(Capabilities::SSL)) {
+    greeting.capabilities.clear(Capabilities::SSL);
+    packet[caps_low + 1] = static_cast<uint8_t>(greeting.capabilities.bits() >> 8);
+  }
+
+  return true;
+}
+
+bool offer_ssl(RoutingProtocolBuffer &packet) {
+  ServerGreeting greeting;
+  if (!parse_server_greeting(packet, greeting, false)) return false;
+
+  // SSL is in the lower 2 bytes, which directly follow the filler
+  const auto version_end = std::find(packet.begin() + kHeaderSize + 1, packet.end(), 0);
+  const size_t caps_low = static_cast<size_t>(version_end - packet.begin()) + 1 + 4 + 8 + 1;
+  greeting.capabilities.set(Capabilities::SSL);
+  packet[caps_low + 1] = static_cast<uint8_t>(greeting.capabilities.bits() >> 8);
+
+  return true;
+}
+
+bool is_ssl_request(const RoutingProtocolBuffer &packet) {
+  // capabilities, max packet size, character set and 23 reserved bytes
+  const size_t kSslRequestSize = 4 + 4 + 1 + 23;
+  if (packet.size() != kHeaderSize + kSslRequestSize) return false;
+
+  const Flags capabilities(static_cast<uint32_t>(
+      packet[kHeaderSize] | packet[kHeaderSize + 1] << 8 |
+      packet[kHeaderSize + 2] << 16 | packet[kHeaderSize + 3] << 24));
+  return capabilities.test(Capabilities::PROTOCOL_41 | Capabilities::SSL);
+}
+
+void strip_ssl_request(RoutingProtocolBuffer &packet) {
+  if (packet.size() < kHeaderSize + 4) return;
+
+  Flags capabilities(static_cast<uint32_t>(packet[kHeaderSize] | packet[kHeaderSize + 1] << 8));
+  capabilities.clear(Capabilities::SSL);
+  packet[kHeaderSize + 1] = static_cast<uint8_t>(capabilities.bits() >> 8);
+}
+
+namespace {
+
+/** @brief capabilities known at runtime */
+struct AnyCapabilities {
+  bool test(Flags want) const noexcept { return flags.test(want); }
+  Flags flags;
+};
+
+/** @brief capabilities known at compile time, the tests get folded */
+template<Capabilities::AllFlags kFlags>
+struct FixedCapabilities {
+  constexpr bool test(Flags want) const noexcept { return (kFlags & want.bits()) == want.bits(); }
+};
+
+// the flags which decide about the fields following the reserved bytes
+constexpr Capabilities::AllFlags kFieldFlags =
+    (Capabilities::PLUGIN_AUTH_LENENC_CLIENT_DATA | Capabilities::SECURE_CONNECTION |
+     Capabilities::CONNECT_WITH_DB | Capabilities::PLUGIN_AUTH | Capabilities::CONNECT_ATTRS).bits();
+
+// what libmysqlclient sends, and connectors without connection attributes
+constexpr Capabilities::AllFlags kLibmysqlclient =
+    (Capabilities::PLUGIN_AUTH_LENENC_CLIENT_DATA | Capabilities::SECURE_CONNECTION |
+     Capabilities::PLUGIN_AUTH | Capabilities::CONNECT_ATTRS).bits();
+constexpr Capabilities::AllFlags kNoAttributes =
+    (Capabilities::SECURE_CONNECTION | Capabilities::PLUGIN_AUTH).bits();
+constexpr Capabilities::AllFlags kWithDb = Capabilities::CONNECT_WITH_DB.bits();
+
+template<class Caps>
+void parse_handshake_response_fields(const RoutingProtocolBuffer &packet,
+                                     mysql_protocol::PacketView &pkt, const Caps &caps,
+                                     ClientHandshake &handshake) {
+  handshake.username = pkt.read_string_nul().to_string();
+
+  handshake.auth_response_begin = pkt.tell();
+  if (caps.test(Capabilities::PLUGIN_AUTH_LENENC_CLIENT_DATA)) {
+    pkt.read_lenenc_bytes();
+  } else if (caps.test(Capabilities::SECURE_CONNECTION)) {
+    pkt.read_bytes(pkt.read_int<uint8_t>());
+  } else {
+    pkt.read_string_nul();
+  }
+  handshake.auth_response_end = pkt.tell();
+
+  if (caps.test(Capabilities::CONNECT_WITH_DB)) {
+    handshake.database = pkt.read_string_nul().to_string();
+  }
+  if (caps.test(Capabilities::PLUGIN_AUTH)) {
+    handshake.auth_plugin = pkt.read_string_nul().to_string();
+  }
+  if (caps.test(Capabilities::CONNECT_ATTRS)) {
+    handshake.connection_attrs.assign(packet.begin() + static_cast<long>(pkt.tell()), packet.end());
+  }
+}
+
+}  // namespace
+
+bool parse_handshake_response(const RoutingProtocolBuffer &packet, ClientHandshake &handshake) {
+  try {
+    // read in place, the packet is not copied
+    mysql_protocol::PacketView pkt(packet);
+    if (packet.size() != kHeaderSize + pkt.get_payload_size()) return false;
+
+    pkt.seek(kHeaderSize);
+    handshake.capabilities = Flags(pkt.read_int<uint32_t>());
+    if (!handshake.capabilities.test(Capabilities::PROTOCOL_41)) return false;
+
+    pkt.read_int<uint32_t>();  // max packet size
+    handshake.char_set = pkt.read_int<uint8_t>();
+    pkt.read_bytes(23);  // reserved
+
+    // the same few capability sets come again and again, they get dispatched
+    // once to a parser specialized for them
+    switch (handshake.capabilities.bits() & kFieldFlags) {
+      case kLibmysqlclient:
+        parse_handshake_response_fields(packet, pkt, FixedCapabilities<kLibmysqlclient>(), handshake);
+        break;
+      case kLibmysqlclient | kWithDb:
+        parse_handshake_response_fields(packet, pkt, FixedCapabilities<kLibmysqlclient | kWithDb>(), handshake);
+        break;
+      case kNoAttributes:
+        parse_handshake_response_fields(packet, pkt, FixedCapabilities<kNoAttributes>(), handshake);
+        break;
+      case kNoAttributes | kWithDb:
+        parse_handshake_response_fields(packet, pkt, FixedCapabilities<kNoAttributes | kWithDb>(), handshake);
+        break;
+      default:
+        parse_handshake_response_fields(packet, pkt, AnyCapabilities{handshake.capabilities}, handshake);
+    }
+  } catch (const std::exception &) {
+    // thrown when reading past the end of the packet
+    return false;
+  }
+
+  return true;
+}
+
+bool get_connection_attribute(const ClientHandshake &handshake, const std::string &name,
+                              std::string &value) {
+  if (handshake.connection_attrs.empty()) return false;
+
+  try {
+    // no packet header, the view is told not to look for one
+    mysql_protocol::PacketView attrs(handshake.connection_attrs.data(),
+                                     handshake.connection_attrs.size(), true);
+    attrs.seek(0);
+    const uint64_t total = attrs.read_lenenc_uint();
+    const size_t end = std::min(attrs.tell() + static_cast<size_t>(total), attrs.size());
+    while (attrs.tell() < end) {
+      const mysql_protocol::BytesView key = attrs.read_lenenc_bytes();
+      const mysql_protocol::BytesView val = attrs.read_lenenc_bytes();
+      if (key.to_string() == name) {
+        value = val.to_string();
+        return true;
+      }
+    }
+  } catch (const std::exception &) {
+    // attributes cut short
+  }
+
+  return false;
+}
+
+RoutingProtocolBuffer make_handshake_response(const RoutingProtocolBuffer &packet,
+                                              const ClientHandshake &handshake,
+                                              const std::vector<uint8_t> &auth_response) {
+  mysql_protocol::Packet response(1);
+  response.assign(packet.begin(), packet.begin() + static_cast<long>(handshake.auth_response_begin));
+  response.seek(response.size());
+
+  if (handshake.capabilities.test(Capabilities::PLUGIN_AUTH_LENENC_CLIENT_DATA)) {
+    response.write_lenenc_uint(auth_response.size());
+    response.write_bytes(auth_response);
+  } else if (handshake.capabilities.test(Capabilities::SECURE_CONNECTION)) {
+    response.write_int<uint8_t>(static_cast<uint8_t>(auth_response.size()));
+    response.write_bytes(auth_response);
+  } else {
+    response.write_bytes(auth_response);
+    response.write_int<uint8_t>(0);
+  }
+  response.insert(response.end(), packet.begin() + static_cast<long>(handshake.auth_response_end),
+                  packet.end());
+
+  const size_t payload_size = response.size() - kHeaderSize;
+  response[0] = static_cast<uint8_t>(payload_size);
+  response[1] = static_cast<uint8_t>(payload_size >> 8);
+  response[2] = static_cast<uint8_t>(payload_size >> 16);
+  response[3] = 1;
+
+  // Packet is a RoutingProtocolBuffer, its bytes get moved, not copied
+  return std::move(static_cast<RoutingProtocolBuffer&>(response));
+}
+
+RoutingProtocolBuffer make_auth_switch_request(uint8_t sequence_id,
+                                               const std::string &auth_plugin,
+                                               const std::vector<uint8_t> &scramble) {
+  const size_t payload_size = 1 + auth_plugin.size() + 1 + scramble.size() + 1;
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload_size),
+                               static_cast<uint8_t>(payload_size >> 8),
+                               static_cast<uint8_t>(payload_size >> 16),
+                               sequence_id, kAuthSwitchRequest};
+  packet.insert(packet.end(), auth_plugin.begin(), auth_plugin.end());
+  packet.push_back(0);
+  packet.insert(packet.end(), scramble.begin(), scramble.end());
+  packet.push_back(0);
+
+  return packet;
+}
+
+bool parse_auth_switch_request(const RoutingProtocolBuffer &packet, std::string &auth_plugin,
+                               std::vector<uint8_t> &scramble) {
+  if (packet.size() <= kHeaderSize || packet[kHeaderSize] != kAuthSwitchRequest) return false;
+
+  auto plugin_end = std::find(packet.begin() + kHeaderSize + 1, packet.end(), 0);
+  if (plugin_end == packet.end()) return false;
+  auth_plugin.assign(packet.begin() + kHeaderSize + 1, plugin_end);
+
+  auto data_end = packet.end();
+  if (data_end - plugin_end > 1 && *(data_end - 1) == 0) --data_end;
+  scramble.assign(plugin_end + 1, data_end);
+
+  return true;
+}
+
+std::vector<uint8_t> make_native_password_token(const std::string &password,
+                                                const std::vector<uint8_t> &scramble) {
+  if (password.empty()) return {};
+
+  uint8_t hash_stage1[SHA1_HASH_SIZE];
+  uint8_t hash_stage2[SHA1_HASH_SIZE];
+  my_sha1::compute_sha1_hash(hash_stage1, password.data(), password.size());
+  my_sha1::compute_sha1_hash(hash_stage2, reinterpret_cast<const char*>(hash_stage1), SHA1_HASH_SIZE);
+
+  uint8_t scrambled[SHA1_HASH_SIZE];
+  my_sha1::compute_sha1_hash_multi(scrambled, reinterpret_cast<const char*>(scramble.data()),
+                                   static_cast<int>(scramble.size()),
+                                   reinterpret_cast<const char*>(hash_stage2), SHA1_HASH_SIZE);
+
+  std::vector<uint8_t> token(SHA1_HASH_SIZE);
+  for (size_t i = 0; i < SHA1_HASH_SIZE; ++i) {
+    token[i] = static_cast<uint8_t>(hash_stage1[i] ^ scrambled[i]);
+  }
+  return token;
+}
+
+bool read_bytes(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                uint8_t *buffer, size_t length, std::chrono::milliseconds timeout) {
+  while (length > 0) {
+    struct pollfd fds[] = {
+      { sock, POLLIN, 0 },
+    };
+
+    int res = sock_ops->poll(fds, 1, timeout);
+    if (res == 0) {
+      sock_ops->set_errno(ETIMEDOUT);
+      return false;
+    } else if (res < 0) {
+      const int last_errno = sock_ops->get_errno();
+      if (last_errno == EINTR || last_errno == EAGAIN) continue;
+      return false;
+    }
+
+    ssize_t bytes_read = sock_ops->read(sock, buffer, length);
+    if (bytes_read <= 0) {
+      // the caller assumes that errno == 0 on plain connection closes.
+      if (bytes_read == 0) sock_ops->set_errno(0);
+      return false;
+    }
+    buffer += bytes_read;
+    length -= static_cast<size_t>(bytes_read);
+  }
+
+  return true;
+}
+
+bool read_packet(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                 RoutingProtocolBuffer &packet, std::chrono::milliseconds timeout) {
+  packet.resize(kHeaderSize);
+  if (!read_bytes(sock_ops, sock, &packet[0], kHeaderSize, timeout)) return false;
+
+  const size_t payload_size = mysql_protocol::Packet::read_payload_size(&packet[0]);
+  if (payload_size > kMaxPacketSize) {
+    sock_ops->set_errno(EMSGSIZE);
+    return false;
+  }
+
+  packet.resize(kHeaderSize + payload_size);
+  return payload_size == 0 ||
+         read_bytes(sock_ops, sock, &packet[kHeaderSize], payload_size, timeout);
+}
+
+} // namespace classic_handshake
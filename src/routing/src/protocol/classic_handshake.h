@@ -0,0 +1,194 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_CLASSIC_HANDSHAKE_INCLUDED
+#define ROUTING_CLASSIC_HANDSHAKE_INCLUDED
+
+#include "base_protocol.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mysql_harness { class SocketOperationsBase; }
+
+/**
+ * Helpers for the router taking part in the classic protocol handshake,
+ * as done when server connections are pooled.
+ */
+namespace classic_handshake {
+
+/** @brief length of the scramble sent in the server greeting */
+constexpr size_t kScrambleLength = 20;
+
+/** @brief max size of the handshake packets read by the router */
+constexpr size_t kMaxPacketSize = 65536;
+
+/** @brief fields of the Protocol::Handshake packet sent by the server */
+struct ServerGreeting {
+  /** @brief scramble the client has to authenticate with */
+  std::vector<uint8_t> scramble;
+  mysql_protocol::Capabilities::Flags capabilities;
+};
+
+/**
+ * @brief Parses server greeting, optionally clearing its SSL capability.
+ *
+ * @param packet greeting packet including the header
+ * @param greeting set to the parsed fields
+ * @param strip_ssl true to clear the SSL capability in packet
+ *
+ * @return false if packet is not a protocol version 10 greeting
+ */
+bool parse_server_greeting(RoutingProtocolBuffer &packet, ServerGreeting &greeting,
+                           bool strip_ssl);
+
+/**
+ * @brief Sets the SSL capability in a server greeting.
+ *
+ * Used when the router terminates TLS for a server that may not offer it.
+ *
+ * @return false if packet is not a protocol version 10 greeting
+ */
+bool offer_ssl(RoutingProtocolBuffer &packet);
+
+/**
+ * @brief Returns true if packet is the Protocol::SSLRequest a client sends
+ *        before starting the TLS handshake.
+ */
+bool is_ssl_request(const RoutingProtocolBuffer &packet);
+
+/**
+ * @brief Clears the SSL capability in a handshake response sent over TLS,
+ *        before it is forwarded to the server in plain text.
+ */
+void strip_ssl_request(RoutingProtocolBuffer &packet);
+
+/** @brief fields of the Protocol::HandshakeResponse41 packet sent by the client */
+struct ClientHandshake {
+  mysql_protocol::Capabilities::Flags capabilities;
+  uint8_t char_set{0};
+  std::string username;
+  std::string database;
+  std::string auth_plugin;
+  /** @brief connection attributes including their length-encoded total length */
+  std::vector<uint8_t> connection_attrs;
+  /** @brief position of the auth-response field, including its length */
+  size_t auth_response_begin{0};
+  size_t auth_response_end{0};
+};
+
+/**
+ * @brief Parses the handshake response of a client.
+ *
+ * @return false if packet is not a complete PROTOCOL_41 handshake response
+ */
+bool parse_handshake_response(const RoutingProtocolBuffer &packet, ClientHandshake &handshake);
+
+/**
+ * @brief Looks up a connection attribute sent with the handshake response.
+ *
+ * @param handshake fields parsed from the handshake response
+ * @param name name of the attribute
+ * @param value set to the value of the attribute
+ *
+ * @return false if the client didn't send the attribute
+ */
+bool get_connection_attribute(const ClientHandshake &handshake, const std::string &name,
+                              std::string &value);
+
+/**
+ * @brief Creates handshake response with another auth-response.
+ *
+ * @param packet handshake response as sent by the client
+ * @param handshake fields parsed from packet
+ * @param auth_response auth-response to put into the packet
+ */
+RoutingProtocolBuffer make_handshake_response(const RoutingProtocolBuffer &packet,
+                                              const ClientHandshake &handshake,
+                                              const std::vector<uint8_t> &auth_response);
+
+/**
+ * @brief Creates Protocol::AuthSwitchRequest asking the client to
+ *        authenticate with the given scramble.
+ */
+RoutingProtocolBuffer make_auth_switch_request(uint8_t sequence_id,
+                                               const std::string &auth_plugin,
+                                               const std::vector<uint8_t> &scramble);
+
+/**
+ * @brief Parses Protocol::AuthSwitchRequest sent by the server.
+ *
+ * @param packet packet including the header
+ * @param auth_plugin set to the plugin the server asks for
+ * @param scramble set to the auth-plugin-data without the nul-terminator
+ *
+ * @return false if packet is not an auth switch request
+ */
+bool parse_auth_switch_request(const RoutingProtocolBuffer &packet, std::string &auth_plugin,
+                               std::vector<uint8_t> &scramble);
+
+/**
+ * @brief Computes the mysql_native_password auth-response.
+ *
+ * SHA1(password) XOR SHA1(scramble + SHA1(SHA1(password))), empty for an
+ * empty password.
+ */
+std::vector<uint8_t> make_native_password_token(const std::string &password,
+                                                const std::vector<uint8_t> &scramble);
+
+/**
+ * @brief Reads exactly length bytes.
+ *
+ * @param sock_ops socket operations
+ * @param sock socket to read from
+ * @param buffer where to store the bytes
+ * @param length number of bytes to read
+ * @param timeout max time to wait for each read
+ *
+ * @return false if socket got closed, failed or timed out; errno is 0 if
+ *         socket was closed
+ */
+bool read_bytes(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                uint8_t *buffer, size_t length, std::chrono::milliseconds timeout);
+
+/**
+ * @brief Reads one complete packet.
+ *
+ * @param sock_ops socket operations
+ * @param sock socket to read from
+ * @param packet set to the packet including the header
+ * @param timeout max time to wait for each part of the packet
+ *
+ * @return false if socket got closed, failed, timed out or packet is
+ *         bigger than kMaxPacketSize; errno is 0 if socket was closed
+ */
+bool read_packet(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                 RoutingProtocolBuffer &packet, std::chrono::milliseconds timeout);
+
+} // namespace classic_handshake
+
+#endif // ROUTING_CLASSIC_HANDSHAKE_INCLUDED
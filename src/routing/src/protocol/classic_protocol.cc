@@ -24,17 +24,57 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "classic_protocol.h"
 
+#include "classic_framer.h"
+#include "classic_handshake.h"
+
 #include "common.h"
 #include "mysql/harness/logging/logging.h"
 #include "mysqlrouter/mysql_protocol.h"
 #include "mysqlrouter/routing.h"
 #include "../utils.h"
 
+#include <algorithm>
 #include <cstring>
 
 using mysql_harness::get_strerror;
 IMPORT_LOG_FUNCTIONS()
 
+namespace {
+
+// reads after the first one are limited, a sender that keeps the socket
+// readable does not delay the data read so far for too long
+constexpr int kMaxCoalescedReads = 8;
+
+/**
+ * Reads what already arrived on the socket, without waiting for more.
+ *
+ * Packets of a burst, like the column definitions, rows and EOF of a small
+ * result, often arrive in several reads. Forwarding them with one write
+ * saves the receiver a TCP segment and a wakeup per read.
+ *
+ * A failing read is not reported, the next poll() for the socket tells
+ * about it.
+ *
+ * @return number of bytes read into buffer
+ */
+size_t read_available(mysql_harness::SocketOperationsBase *so, int sender,
+                      uint8_t *buffer, size_t size) {
+  size_t bytes_read = 0;
+  for (int i = 0; i < kMaxCoalescedReads && bytes_read < size; ++i) {
+    struct pollfd fds[] = {
+      { sender, POLLIN, 0 },
+    };
+    if (so->poll(fds, 1, std::chrono::milliseconds(0)) <= 0 || !(fds[0].revents & POLLIN)) break;
+
+    const ssize_t res = so->read(sender, buffer + bytes_read, size - bytes_read);
+    if (res <= 0) break;
+    bytes_read += static_cast<size_t>(res);
+  }
+  return bytes_read;
+}
+
+}  // namespace
+
 bool ClassicProtocol::on_block_client_host(int server, const std::string &log_prefix) {
   auto fake_response = mysql_protocol::HandshakeResponsePacket(1, {}, "ROUTER", "", "fake_router_login");
   if (routing_sock_ops_->so()->write_all(server, fake_response.data(), fake_response.size()) < 0) {
@@ -48,9 +88,26 @@ bool ClassicProtocol::on_block_client_host(int server, const std::string &log_pr
 }
 
 int ClassicProtocol::copy_packets(int sender, int receiver, bool sender_is_readable,
-                                  RoutingProtocolBuffer &buffer, int *curr_pktnr,
+                                  RoutingBufferRef buffer, int *curr_pktnr,
                                   bool &handshake_done, size_t *report_bytes_read,
                                   bool /*from_server*/) {
+  return forward_packets(sender, receiver, sender_is_readable, buffer, curr_pktnr,
+                         handshake_done, report_bytes_read, nullptr);
+}
+
+int ClassicProtocol::copy_packets_resumable(int sender, int receiver, bool sender_is_readable,
+                                            RoutingBufferRef buffer, int *curr_pktnr,
+                                            bool &handshake_done, size_t *report_bytes_read,
+                                            bool /*from_server*/,
+                                            RoutingProtocolBuffer &partial_packet) {
+  return forward_packets(sender, receiver, sender_is_readable, buffer, curr_pktnr,
+                         handshake_done, report_bytes_read, &partial_packet);
+}
+
+int ClassicProtocol::forward_packets(int sender, int receiver, bool sender_is_readable,
+                                     RoutingBufferRef buffer, int *curr_pktnr,
+                                     bool &handshake_done, size_t *report_bytes_read,
+                                     RoutingProtocolBuffer *partial_packet) {
   assert(curr_pktnr);
   assert(report_bytes_read);
   ssize_t res = 0;
@@ -65,7 +122,22 @@ int ClassicProtocol::copy_packets(int sender, int receiver, bool sender_is_reada
 
   mysql_harness::SocketOperationsBase* const so = routing_sock_ops_->so();
   if (sender_is_readable) {
-    if ((res = so->read(sender, &buffer.front(), buffer_length)) <= 0) {
+    // the start of a packet kept by the previous call goes first
+    if (partial_packet && !partial_packet->empty()) {
+      if (partial_packet->size() < buffer_length) {
+        std::copy(partial_packet->begin(), partial_packet->end(), buffer.data());
+        bytes_read = partial_packet->size();
+      } else {
+        // the buffer got smaller, forwarded unchecked like packets bigger than it
+        if (so->write_all(receiver, partial_packet->data(), partial_packet->size()) < 0) {
+          log_debug("fd=%d write error: %s", receiver, get_message_error(so->get_errno()).c_str());
+          return -1;
+        }
+      }
+      partial_packet->clear();
+    }
+
+    if ((res = so->read(sender, buffer.data() + bytes_read, buffer_length - bytes_read)) <= 0) {
       if (res == -1) {
         const int last_errno = so->get_errno();
 
@@ -80,54 +152,102 @@ int ClassicProtocol::copy_packets(int sender, int receiver, bool sender_is_reada
     }
 
     bytes_read += static_cast<size_t>(res);
-    if (!handshake_done) {
+    if (handshake_done) {
+      bytes_read += read_available(so, sender, buffer.data() + bytes_read, buffer_length - bytes_read);
+    } else {
       // Check packet integrity when handshaking. When packet number is 2, then we assume
       // handshaking is satisfied. For secure connections, we stop when client asks to
       // switch to SSL.
       // The caller should set handshake_done to true when packet number is 2.
-      if (bytes_read < mysql_protocol::Packet::kHeaderSize) {
-        // We need packet which is at least 4 bytes
-        return -1;
-      }
-      pktnr = buffer[3];
-      if (*curr_pktnr > 0 && pktnr != *curr_pktnr + 1) {
-        log_debug("Received incorrect packet number; aborting (was %d)", pktnr);
-        return -1;
-      }
+      //
+      // read() may return part of a packet, or several packets: the packets
+      // are checked one by one and the rest of an incomplete one is read
+      // before anything is forwarded.
+      ClassicPacketFramer framer;
+      ClassicPacketFramer::Frame frame;
+      int prev_pktnr = *curr_pktnr;
+      size_t framed = 0;
+      // end of the last complete packet
+      size_t packets_end = 0;
+      bool switched_to_ssl = false;
+      while (true) {
+        const uint8_t *data = buffer.data() + framed;
+        size_t size = bytes_read - framed;
+        while (!switched_to_ssl && framer.next(data, size, frame)) {
+          if (!frame.is_complete()) continue;
+
+          pktnr = frame.sequence_id;
+          if (prev_pktnr > 0 && pktnr != prev_pktnr + 1) {
+            log_debug("Received incorrect packet number; aborting (was %d)", pktnr);
+            return -1;
+          }
+          prev_pktnr = pktnr;
+          packets_end = static_cast<size_t>(frame.payload + frame.length - buffer.data());
+
+          // the packet is contiguous in buffer as it was read by this call
+          const uint8_t *payload = frame.payload + frame.length - frame.payload_size;
+          if (frame.payload_size > 0 && payload[0] == 0xff) {
+            // We got error from MySQL Server while handshaking
+            // We do not consider this a failed handshake
 
-      if (buffer[4] == 0xff) {
-        // We got error from MySQL Server while handshaking
-        // We do not consider this a failed handshake
+            // copy part of the buffer containing serialized error
+            const auto packet_begin = payload - mysql_protocol::Packet::kHeaderSize;
+            RoutingProtocolBuffer buffer_err(packet_begin, payload + frame.payload_size);
 
-        // copy part of the buffer containing serialized error
-        RoutingProtocolBuffer buffer_err(buffer.begin(), buffer.begin() +
-                                         static_cast<RoutingProtocolBuffer::iterator::difference_type>(bytes_read));
+            auto server_error = mysql_protocol::ErrorPacket(buffer_err);
+            if (so->write_all(receiver, server_error.data(), server_error.size()) < 0) {
+              log_debug("fd=%d write error: %s",
+                  receiver, get_message_error(so->get_errno()).c_str());
+            }
+            // receiver socket closed by caller
+            *curr_pktnr = 2; // we assume handshaking is done though there was an error
+            *report_bytes_read = bytes_read;
+            return 0;
+          }
 
-        auto server_error = mysql_protocol::ErrorPacket(buffer_err);
-        if (so->write_all(receiver, server_error.data(), server_error.size()) < 0) {
-          log_debug("fd=%d write error: %s",
-              receiver, get_message_error(so->get_errno()).c_str());
+          // We are dealing with the handshake response from client
+          if (pktnr == 1) {
+            // if client is switching to SSL, we are not continuing any checks
+            if (frame.payload_size < sizeof(uint32_t)) {
+              log_debug("Handshake response packet too small (%zu bytes)", frame.payload_size);
+              return -1;
+            }
+            mysql_protocol::Capabilities::Flags capabilities(static_cast<uint32_t>(
+                payload[0] | payload[1] << 8 | payload[2] << 16 |
+                static_cast<uint32_t>(payload[3]) << 24));
+            if (capabilities.test(mysql_protocol::Capabilities::SSL)) {
+              pktnr = 2;  // Setting to 2, we tell the caller that handshaking is done
+              switched_to_ssl = true;
+            }
+          }
         }
-        // receiver socket closed by caller
-        *curr_pktnr = 2; // we assume handshaking is done though there was an error
-        *report_bytes_read = bytes_read;
-        return 0;
-      }
+        framed = bytes_read;
 
-      // We are dealing with the handshake response from client
-      if (pktnr == 1) {
-        // if client is switching to SSL, we are not continuing any checks
-        mysql_protocol::Capabilities::Flags capabilities;
-        try {
-          auto pkt = mysql_protocol::Packet(buffer);
-          capabilities = mysql_protocol::Capabilities::Flags(pkt.read_int_from<uint32_t>(4));
-        } catch (const mysql_protocol::packet_error &exc) {
-          log_debug("%s", exc.what());
-          return -1;
+        if (switched_to_ssl || framer.at_packet_boundary()) break;
+
+        if (partial_packet && (packets_end > 0 || bytes_read < buffer_length)) {
+          // the rest is checked by the next call, once it arrived
+          partial_packet->assign(buffer.data() + packets_end, buffer.data() + bytes_read);
+          bytes_read = packets_end;
+          if (bytes_read == 0) {
+            *report_bytes_read = 0;
+            return 0;
+          }
+          break;
         }
-        if (capabilities.test(mysql_protocol::Capabilities::SSL)) {
-          pktnr = 2;  // Setting to 2, we tell the caller that handshaking is done
+
+        // packets bigger than the buffer are forwarded unchecked
+        if (bytes_read == buffer_length) break;
+
+        const size_t wanted = std::min(framer.bytes_wanted(), buffer_length - bytes_read);
+        if (!classic_handshake::read_bytes(so, sender, buffer.data() + bytes_read, wanted,
+                                           routing::kDefaultClientConnectTimeout)) {
+          const int last_errno = so->get_errno();
+          log_debug("fd=%d read failed: (%d %s)",
+              sender, last_errno, get_message_error(last_errno).c_str());
+          return -1;
         }
+        bytes_read += wanted;
       }
     }
 
@@ -152,10 +272,22 @@ bool ClassicProtocol::send_error(int destination,
                                  const std::string &message,
                                  const std::string &sql_state,
                                  const std::string &log_prefix) {
-  auto server_error = mysql_protocol::ErrorPacket(0, code, message, sql_state);
+  using mysql_protocol::PacketWriter;
+
+  // router errors are short, they get written into a buffer on the stack
+  uint8_t stack_buffer[512];
+  std::vector<uint8_t> heap_buffer;
+  uint8_t *buffer = stack_buffer;
+  const size_t size = PacketWriter::framed_size(mysql_protocol::ErrorPacket::payload_size(message));
+  if (size > sizeof(stack_buffer)) {
+    heap_buffer.resize(size);
+    buffer = heap_buffer.data();
+  }
+  PacketWriter writer(buffer, size);
+  mysql_protocol::ErrorPacket::write(writer, 0, code, message, sql_state);
 
   mysql_harness::SocketOperationsBase* const so = routing_sock_ops_->so();
-  if (so->write_all(destination, server_error.data(), server_error.size()) < 0) {
+  if (so->write_all(destination, buffer, writer.size()) < 0) {
     log_debug("[%s] fd=%d write error: %s", log_prefix.c_str(),
         destination,
         get_message_error(so->get_errno()).c_str());
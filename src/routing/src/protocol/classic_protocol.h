@@ -59,6 +59,10 @@ public:
    * decrypt). When SSL switch is detected, this function will set pktnr
    * to 2, so we assume the handshaking was OK.
    *
+   * The rest of a handshake packet split over reads is waited for, up to
+   * kDefaultClientConnectTimeout, see copy_packets_resumable() for not
+   * waiting.
+   *
    * @param sender Descriptor of the sender
    * @param receiver Descriptor of the receiver
    * @param sender_is_readable true if the server socket has data
@@ -72,10 +76,15 @@ public:
    * @return 0 on success; -1 on error
    */
   virtual int copy_packets(int sender, int receiver, bool sender_is_readable,
-                           RoutingProtocolBuffer &buffer, int *curr_pktnr,
+                           RoutingBufferRef buffer, int *curr_pktnr,
                            bool &handshake_done, size_t *report_bytes_read,
                            bool from_server) override;
 
+  virtual int copy_packets_resumable(int sender, int receiver, bool sender_is_readable,
+                                     RoutingBufferRef buffer, int *curr_pktnr,
+                                     bool &handshake_done, size_t *report_bytes_read,
+                                     bool from_server, RoutingProtocolBuffer &partial_packet) override;
+
   /** @brief Sends error message to the provided receiver.
    *
    * This function sends protocol message containing MySQL error
@@ -98,6 +107,13 @@ public:
   virtual Type get_type() override {
     return Type::kClassicProtocol;
   }
+
+private:
+  /** @brief copy_packets() if partial_packet is nullptr, copy_packets_resumable() otherwise */
+  int forward_packets(int sender, int receiver, bool sender_is_readable,
+                      RoutingBufferRef buffer, int *curr_pktnr,
+                      bool &handshake_done, size_t *report_bytes_read,
+                      RoutingProtocolBuffer *partial_packet);
 };
 
 #endif // ROUTING_CLASSICPROTOCOL_INCLUDED
@@ -0,0 +1,314 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "classic_response_tracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+constexpr uint16_t ClassicResponseTracker::kStatusInTrans;
+constexpr uint16_t ClassicResponseTracker::kStatusAutocommit;
+constexpr uint16_t ClassicResponseTracker::kStatusMoreResultsExist;
+constexpr uint16_t ClassicResponseTracker::kStatusSessionStateChanged;
+constexpr size_t ClassicResponseTracker::kHeadSize;
+constexpr size_t ClassicResponseTracker::kGtidHeadSize;
+constexpr size_t ClassicResponseTracker::kMaxGtidsSize;
+
+static constexpr uint8_t kComQuit = 0x01;
+static constexpr uint8_t kComInitDb = 0x02;
+static constexpr uint8_t kComQuery = 0x03;
+static constexpr uint8_t kComPing = 0x0e;
+static constexpr uint8_t kComStmtExecute = 0x17;
+static constexpr uint8_t kComStmtSendLongData = 0x18;
+static constexpr uint8_t kComStmtClose = 0x19;
+static constexpr uint8_t kComStmtReset = 0x1a;
+static constexpr uint8_t kComResetConnection = 0x1f;
+
+static constexpr uint8_t kOkHeader = 0x00;
+static constexpr uint8_t kLocalInfileHeader = 0xfb;
+static constexpr uint8_t kEofHeader = 0xfe;
+static constexpr uint8_t kErrorHeader = 0xff;
+
+static constexpr uint8_t kSessionTrackSystemVariables = 0x00;
+static constexpr uint8_t kSessionTrackSchema = 0x01;
+static constexpr uint8_t kSessionTrackStateChange = 0x02;
+static constexpr uint8_t kSessionTrackGtids = 0x03;
+
+namespace {
+
+// reads a length-encoded integer, false if it doesn't fit into size
+bool read_lenenc_uint(const uint8_t* data, size_t size, size_t &pos, uint64_t &value) {
+  if (pos >= size) return false;
+
+  const uint8_t first = data[pos++];
+  size_t length = 0;
+  switch (first) {
+    case 0xfb: return false;  // NULL
+    case 0xfc: length = 2; break;
+    case 0xfd: length = 3; break;
+    case 0xfe: length = 8; break;
+    case 0xff: return false;
+    default:
+      value = first;
+      return true;
+  }
+  if (size - pos < length) return false;
+
+  value = 0;
+  for (size_t i = 0; i < length; ++i) {
+    value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+  }
+  pos += length;
+  return true;
+}
+
+// reads a length-encoded string, false if it doesn't fit into size
+bool read_lenenc_string(const uint8_t* data, size_t size, size_t &pos, std::string &value) {
+  uint64_t length;
+  if (!read_lenenc_uint(data, size, pos, length) || size - pos < length) return false;
+
+  value.assign(reinterpret_cast<const char*>(data + pos), static_cast<size_t>(length));
+  pos += static_cast<size_t>(length);
+  return true;
+}
+
+} // namespace
+
+bool ClassicResponseTracker::command_sent(uint8_t command) noexcept {
+  if (state_ == State::kLost) return false;
+  if (state_ != State::kIdle) {
+    // pipelined commands are not followed
+    state_ = State::kLost;
+    return false;
+  }
+
+  switch (command) {
+    case kComQuit:
+    case kComStmtSendLongData:
+    case kComStmtClose:
+      // no response
+      return true;
+    case kComQuery:
+    case kComPing:
+    case kComStmtExecute:  // rows of the binary protocol are framed like text rows
+    case kComStmtReset:
+    case kComResetConnection:
+    case kComInitDb:
+      state_ = State::kFirst;
+      rows_ = 0;
+      state_reported_ = false;
+      return true;
+    default:
+      state_ = State::kLost;
+      return false;
+  }
+}
+
+void ClassicResponseTracker::feed(const uint8_t* data, size_t size) noexcept {
+  ClassicPacketFramer::Frame frame;
+  while (state_ != State::kLost && framer_.next(data, size, frame)) {
+    if (frame.starts_message && frame.is_first()) {
+      head_size_ = 0;
+      message_size_ = 0;
+    }
+
+    const size_t head_size = tracks_gtids_ || tracks_state_ ? kGtidHeadSize : kHeadSize;
+    const size_t n = std::min(frame.length, head_size - head_size_);
+    std::memcpy(head_ + head_size_, frame.payload, n);
+    head_size_ += n;
+    message_size_ += frame.length;
+
+    if (frame.is_complete() && !frame.is_continued()) on_message(message_size_);
+  }
+}
+
+void ClassicResponseTracker::on_message(size_t size) noexcept {
+  const uint8_t header = size > 0 ? head_[0] : kErrorHeader;
+
+  switch (state_) {
+    case State::kIdle:
+      // not asked for
+      state_ = State::kLost;
+      break;
+    case State::kFirst: {
+      if (size == 0 || header == kLocalInfileHeader) {
+        state_ = State::kLost;
+      } else if (header == kOkHeader) {
+        state_ = read_ok_status() ? State::kFirst : State::kIdle;
+      } else if (header == kErrorHeader) {
+        state_ = State::kIdle;
+      } else {
+        size_t pos = 0;
+        if (!read_lenenc_uint(head_, head_size_, pos, columns_left_) || columns_left_ == 0) {
+          state_ = State::kLost;
+        } else {
+          state_ = State::kColumns;
+        }
+      }
+      break;
+    }
+    case State::kColumns:
+      if (--columns_left_ == 0) {
+        state_ = deprecate_eof_ ? State::kRows : State::kColumnsEof;
+      }
+      break;
+    case State::kColumnsEof:
+      state_ = header == kEofHeader ? State::kRows : State::kLost;
+      break;
+    case State::kRows:
+      if (header == kErrorHeader) {
+        state_ = State::kIdle;
+      } else if (header == kEofHeader &&
+                 size < (deprecate_eof_ ? ClassicPacketFramer::kMaxPayloadSize : 9)) {
+        const bool more = deprecate_eof_ ? read_ok_status() : read_eof_status();
+        state_ = more ? State::kFirst : State::kIdle;
+      } else {
+        ++rows_;
+      }
+      break;
+    case State::kLost:
+      break;
+  }
+}
+
+bool ClassicResponseTracker::read_ok_status() noexcept {
+  // header, affected rows, last insert id, status flags
+  size_t pos = 1;
+  uint64_t affected_rows;
+  uint64_t value;
+  if (!read_lenenc_uint(head_, head_size_, pos, affected_rows) ||
+      !read_lenenc_uint(head_, head_size_, pos, value) ||
+      head_size_ - pos < 2) {
+    return false;
+  }
+  // the OK ending a result set has no affected rows
+  if (state_ == State::kFirst) rows_ += affected_rows;
+
+  const uint16_t status = static_cast<uint16_t>(head_[pos] | head_[pos + 1] << 8);
+  if ((tracks_gtids_ || tracks_state_) && (status & kStatusSessionStateChanged)) {
+    // status flags and warnings
+    read_session_state(pos + 4);
+    return set_status(static_cast<uint16_t>(status & ~kStatusSessionStateChanged));
+  }
+
+  return set_status(status);
+}
+
+void ClassicResponseTracker::read_session_state(size_t pos) noexcept {
+  // info, session state
+  uint64_t info_size;
+  uint64_t state_size;
+  if (message_size_ > head_size_ ||
+      !read_lenenc_uint(head_, head_size_, pos, info_size) || head_size_ - pos < info_size ||
+      !read_lenenc_uint(head_, head_size_, pos += info_size, state_size) ||
+      head_size_ - pos < state_size) {
+    state_not_read();
+    return;
+  }
+
+  // type and data of each change
+  const size_t end = pos + state_size;
+  while (pos < end) {
+    const uint8_t type = head_[pos++];
+    uint64_t data_size;
+    if (!read_lenenc_uint(head_, end, pos, data_size) || end - pos < data_size) {
+      state_not_read();
+      return;
+    }
+    const size_t data_end = pos + data_size;
+
+    if (tracks_state_ && (type == kSessionTrackSystemVariables || type == kSessionTrackSchema)) {
+      if (!read_state_change(type, pos, data_size)) {
+        state_not_read();
+        return;
+      }
+      pos = data_end;
+      continue;
+    }
+    // comes along with the changes, which are reported by themselves
+    if (tracks_state_ && type == kSessionTrackStateChange) {
+      session_state_changed_ = true;
+      pos = data_end;
+      continue;
+    }
+    if (type == kSessionTrackGtids && !tracks_gtids_ && tracks_state_) {
+      pos = data_end;
+      continue;
+    }
+
+    // encoding specification, GTIDs as text
+    uint64_t gtids_size;
+    size_t gtids_pos = pos + 1;
+    if (type != kSessionTrackGtids || data_size == 0 || head_[pos] != 0 ||
+        !read_lenenc_uint(head_, data_end, gtids_pos, gtids_size) ||
+        data_end - gtids_pos < gtids_size || gtids_.size() + gtids_size >= kMaxGtidsSize) {
+      state_not_read();
+      return;
+    }
+    if (gtids_size > 0) {
+      if (!gtids_.empty()) gtids_ += ',';
+      gtids_.append(reinterpret_cast<const char*>(head_ + gtids_pos), gtids_size);
+    }
+    pos = data_end;
+  }
+}
+
+bool ClassicResponseTracker::read_state_change(uint8_t type, size_t pos, size_t size) noexcept {
+  const size_t end = pos + size;
+  try {
+    if (type == kSessionTrackSchema) {
+      if (!read_lenenc_string(head_, end, pos, schema_)) return false;
+    } else {
+      std::string name;
+      std::string value;
+      if (!read_lenenc_string(head_, end, pos, name) ||
+          !read_lenenc_string(head_, end, pos, value) || name.empty()) {
+        return false;
+      }
+      system_variables_[name] = value;
+    }
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+
+  session_state_changed_ = true;
+  state_reported_ = true;
+  return true;
+}
+
+bool ClassicResponseTracker::read_eof_status() noexcept {
+  // header, warnings, status flags
+  if (head_size_ < 5) return false;
+
+  return set_status(static_cast<uint16_t>(head_[3] | head_[4] << 8));
+}
+
+bool ClassicResponseTracker::set_status(uint16_t status) noexcept {
+  status_ = status;
+  has_status_ = true;
+  if (status & kStatusSessionStateChanged) session_state_changed_ = true;
+
+  return (status & kStatusMoreResultsExist) != 0;
+}
@@ -0,0 +1,211 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_CLASSIC_RESPONSE_TRACKER_INCLUDED
+#define ROUTING_CLASSIC_RESPONSE_TRACKER_INCLUDED
+
+#include "classic_framer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+/** @class ClassicResponseTracker
+ *
+ * Follows the responses of a server to the commands of a client.
+ *
+ * Tells when the response to the last command is complete and keeps the
+ * server status flags of the last OK or EOF packet, which tell about the
+ * transaction state of the session. Only responses to commands answered
+ * with OK, error or a result set (COM_QUERY, COM_PING, COM_STMT_EXECUTE
+ * without cursor, COM_STMT_RESET, COM_RESET_CONNECTION, COM_INIT_DB) and
+ * commands without response are followed, everything else makes the
+ * tracker lose track of the session.
+ *
+ * With track_gtids() the tracker also collects the GTIDs the server reports
+ * in the session state of OK packets (session_track_gtids), which don't
+ * count as a change of the session state.
+ *
+ * With track_session_state() it keeps the default schema and the values of
+ * the system variables the server reports (session_track_schema,
+ * session_track_system_variables), which let another server session be
+ * brought into the same state.
+ */
+class ClassicResponseTracker {
+ public:
+  /** @brief server status flags of OK and EOF packets */
+  static constexpr uint16_t kStatusInTrans = 0x0001;
+  static constexpr uint16_t kStatusAutocommit = 0x0002;
+  static constexpr uint16_t kStatusMoreResultsExist = 0x0008;
+  static constexpr uint16_t kStatusSessionStateChanged = 0x4000;
+
+  /**
+   * @param deprecate_eof true if the client set CLIENT_DEPRECATE_EOF, result
+   *        sets end with an OK packet then
+   */
+  explicit ClassicResponseTracker(bool deprecate_eof = false) noexcept
+      : deprecate_eof_(deprecate_eof) {}
+
+  /**
+   * @brief Tells about a command sent to the server.
+   *
+   * @param command first byte of the command packet
+   *
+   * @return false if the response can't be followed, the tracker is lost then
+   */
+  bool command_sent(uint8_t command) noexcept;
+
+  /** @brief Stops following the session, e.g. after a command the caller can't tell about */
+  void lose() noexcept { state_ = State::kLost; }
+
+  /** @brief Follows bytes received from the server. */
+  void feed(const uint8_t* data, size_t size) noexcept;
+
+  /** @brief true if the server answered all commands */
+  bool is_idle() const noexcept { return state_ == State::kIdle; }
+
+  /** @brief true if the tracker doesn't know anymore what the server sends */
+  bool is_lost() const noexcept { return state_ == State::kLost; }
+
+  /** @brief true once status flags were received */
+  bool has_status() const noexcept { return has_status_; }
+
+  /** @brief status flags of the last OK or EOF packet */
+  uint16_t get_status() const noexcept { return status_; }
+
+  /** @brief true if the session may be in a transaction, e.g. status is not known yet */
+  bool in_transaction() const noexcept {
+    return !has_status_ || (status_ & kStatusInTrans) != 0 || (status_ & kStatusAutocommit) == 0;
+  }
+
+  /** @brief rows of the result sets and affected rows of the OK packets since the last command */
+  uint64_t get_rows() const noexcept { return rows_; }
+
+  /** @brief true if any OK packet reported a change of the session state */
+  bool session_state_changed() const noexcept { return session_state_changed_; }
+
+  /**
+   * @brief Collects the GTIDs reported in the session state of OK packets.
+   *
+   * Only for clients that set CLIENT_SESSION_TRACK. A session state that
+   * can't be read completely counts as changed.
+   */
+  void track_gtids() noexcept { tracks_gtids_ = true; }
+
+  /** @brief true if track_gtids() was called */
+  bool tracks_gtids() const noexcept { return tracks_gtids_; }
+
+  /** @brief GTIDs reported since the last clear_gtids(), separated by commas */
+  const std::string& get_gtids() const noexcept { return gtids_; }
+
+  void clear_gtids() noexcept { gtids_.clear(); }
+
+  /**
+   * @brief Keeps the schema and system variables reported in the session state of OK packets.
+   *
+   * Only for clients that set CLIENT_SESSION_TRACK. They still count as a
+   * change of the session state.
+   */
+  void track_session_state() noexcept { tracks_state_ = true; }
+
+  /** @brief default schema last reported by the server, empty if none was reported */
+  const std::string& get_schema() const noexcept { return schema_; }
+
+  /** @brief system variables reported by the server, by name, with their last value */
+  const std::map<std::string, std::string>& get_system_variables() const noexcept {
+    return system_variables_;
+  }
+
+  /** @brief true if the response to the last command reported the schema or a system variable */
+  bool session_state_reported() const noexcept { return state_reported_; }
+
+  /**
+   * @brief true once the session state of an OK packet couldn't be read or
+   *        held changes that are not kept, with track_session_state()
+   */
+  bool session_state_unknown() const noexcept { return state_unknown_; }
+
+ private:
+  enum class State {
+    kIdle,        // no command pending
+    kFirst,       // OK, error or column count of a result set
+    kColumns,     // column definitions
+    kColumnsEof,  // EOF after column definitions
+    kRows,        // rows until EOF, OK or error
+    kLost,
+  };
+
+  /** @brief number of bytes of each message kept to inspect it */
+  static constexpr size_t kHeadSize = 32;
+  /** @brief number of bytes kept when tracking GTIDs, enough for the session state of an OK */
+  static constexpr size_t kGtidHeadSize = 512;
+  /** @brief GTIDs collected before the session state counts as changed */
+  static constexpr size_t kMaxGtidsSize = 64 * 1024;
+
+  /** @brief handles a complete message of size bytes starting with head */
+  void on_message(size_t size) noexcept;
+
+  /** @brief reads status of an OK packet, true if more results follow */
+  bool read_ok_status() noexcept;
+
+  /** @brief reads status of an EOF packet, true if more results follow */
+  bool read_eof_status() noexcept;
+
+  /** @brief sets status, true if more results follow */
+  bool set_status(uint16_t status) noexcept;
+
+  /** @brief reads the session state of an OK packet starting at pos, the info before it */
+  void read_session_state(size_t pos) noexcept;
+
+  /** @brief keeps a schema or system variable change of size bytes at pos, false if malformed */
+  bool read_state_change(uint8_t type, size_t pos, size_t size) noexcept;
+
+  /** @brief the session state can't be followed */
+  void state_not_read() noexcept {
+    session_state_changed_ = true;
+    if (tracks_state_) state_unknown_ = true;
+  }
+
+  bool deprecate_eof_;
+  State state_{State::kIdle};
+  ClassicPacketFramer framer_;
+  uint8_t head_[kGtidHeadSize];
+  size_t head_size_{0};
+  size_t message_size_{0};
+  uint64_t columns_left_{0};
+  uint64_t rows_{0};
+  uint16_t status_{0};
+  bool has_status_{false};
+  bool session_state_changed_{false};
+  bool tracks_gtids_{false};
+  std::string gtids_;
+  bool tracks_state_{false};
+  bool state_reported_{false};
+  bool state_unknown_{false};
+  std::string schema_;
+  std::map<std::string, std::string> system_variables_;
+};
+
+#endif // ROUTING_CLASSIC_RESPONSE_TRACKER_INCLUDED
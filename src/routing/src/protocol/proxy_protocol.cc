@@ -0,0 +1,190 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "proxy_protocol.h"
+
+#include "socket_operations.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#  include <netinet/in.h>
+#else
+#  include <ws2tcpip.h>
+#endif
+
+namespace proxy_protocol {
+
+static const uint8_t kSignature[12] = {
+  0x0d, 0x0a, 0x0d, 0x0a, 0x00, 0x0d, 0x0a, 0x51, 0x55, 0x49, 0x54, 0x0a
+};
+
+static constexpr uint8_t kVersion2 = 0x20;
+static constexpr uint8_t kCommandLocal = 0x00;
+static constexpr uint8_t kCommandProxy = 0x01;
+
+static constexpr uint8_t kFamilyUnspec = 0x00;
+static constexpr uint8_t kFamilyTCP4 = 0x11;
+static constexpr uint8_t kFamilyTCP6 = 0x21;
+
+/** @brief addresses and ports of TCP over IPv4 and IPv6 */
+static constexpr size_t kTCP4Size = 2 * 4 + 2 * 2;
+static constexpr size_t kTCP6Size = 2 * 16 + 2 * 2;
+
+long parse_prefix(const uint8_t *prefix) noexcept {
+  if (memcmp(prefix, kSignature, sizeof(kSignature)) != 0) return -1;
+
+  const uint8_t command = prefix[12];
+  if ((command & 0xf0) != kVersion2 ||
+      ((command & 0x0f) != kCommandLocal && (command & 0x0f) != kCommandProxy)) {
+    return -1;
+  }
+
+  const size_t length = static_cast<size_t>(prefix[14] << 8 | prefix[15]);
+  if (length > kMaxPayloadSize) return -1;
+
+  return static_cast<long>(length);
+}
+
+bool parse_payload(const uint8_t *prefix, const uint8_t *payload, size_t length,
+                   Header &header) noexcept {
+  memset(&header.source, 0, sizeof(header.source));
+  memset(&header.destination, 0, sizeof(header.destination));
+  header.proxied = false;
+
+  // the receiver of a LOCAL header looks at the connection itself
+  if ((prefix[12] & 0x0f) == kCommandLocal) return true;
+
+  const uint8_t family = prefix[13];
+  if (family == kFamilyTCP4) {
+    if (length < kTCP4Size) return false;
+
+    sockaddr_in *source = reinterpret_cast<sockaddr_in*>(&header.source);
+    sockaddr_in *destination = reinterpret_cast<sockaddr_in*>(&header.destination);
+    source->sin_family = destination->sin_family = AF_INET;
+    // all fields are in network byte order already
+    memcpy(&source->sin_addr, payload, 4);
+    memcpy(&destination->sin_addr, payload + 4, 4);
+    memcpy(&source->sin_port, payload + 8, 2);
+    memcpy(&destination->sin_port, payload + 10, 2);
+    header.proxied = true;
+  } else if (family == kFamilyTCP6) {
+    if (length < kTCP6Size) return false;
+
+    sockaddr_in6 *source = reinterpret_cast<sockaddr_in6*>(&header.source);
+    sockaddr_in6 *destination = reinterpret_cast<sockaddr_in6*>(&header.destination);
+    source->sin6_family = destination->sin6_family = AF_INET6;
+    memcpy(&source->sin6_addr, payload, 16);
+    memcpy(&destination->sin6_addr, payload + 16, 16);
+    memcpy(&source->sin6_port, payload + 32, 2);
+    memcpy(&destination->sin6_port, payload + 34, 2);
+    header.proxied = true;
+  }
+  // UDP and unix sockets aren't proxied, their addresses are ignored
+
+  return true;
+}
+
+HeaderReader::Result HeaderReader::read(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                                        Header &header) {
+  // a readable socket returns the bytes it has without blocking
+  const ssize_t bytes_read = sock_ops->read(sock, buffer_ + have_, need_ - have_);
+  if (bytes_read < 0) {
+    const int last_errno = sock_ops->get_errno();
+    // nothing arrived after all, the caller polls again
+#ifdef _WIN32
+    if (last_errno == WSAEWOULDBLOCK) return Result::kNeedMore;
+#endif
+    if (last_errno == EINTR || last_errno == EAGAIN || last_errno == EWOULDBLOCK) return Result::kNeedMore;
+    return Result::kFailed;
+  }
+  if (bytes_read == 0) {
+    sock_ops->set_errno(0);
+    return Result::kFailed;
+  }
+  have_ += static_cast<size_t>(bytes_read);
+  if (have_ < need_) return Result::kNeedMore;
+
+  if (need_ == kPrefixSize) {
+    const long length = parse_prefix(buffer_);
+    if (length < 0) {
+      sock_ops->set_errno(EPROTO);
+      return Result::kFailed;
+    }
+    need_ += static_cast<size_t>(length);
+    if (have_ < need_) return Result::kNeedMore;
+  }
+
+  if (!parse_payload(buffer_, buffer_ + kPrefixSize, need_ - kPrefixSize, header)) {
+    sock_ops->set_errno(EPROTO);
+    return Result::kFailed;
+  }
+
+  return Result::kDone;
+}
+
+std::vector<uint8_t> make_header(const sockaddr_storage &source,
+                                 const sockaddr_storage &destination) {
+  std::vector<uint8_t> header(kSignature, kSignature + sizeof(kSignature));
+
+  if (source.ss_family == AF_INET && destination.ss_family == AF_INET) {
+    const sockaddr_in *src = reinterpret_cast<const sockaddr_in*>(&source);
+    const sockaddr_in *dst = reinterpret_cast<const sockaddr_in*>(&destination);
+    const uint8_t fields[] = { kVersion2 | kCommandProxy, kFamilyTCP4, 0, kTCP4Size };
+    header.insert(header.end(), fields, fields + sizeof(fields));
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&src->sin_addr);
+    header.insert(header.end(), bytes, bytes + 4);
+    bytes = reinterpret_cast<const uint8_t*>(&dst->sin_addr);
+    header.insert(header.end(), bytes, bytes + 4);
+    bytes = reinterpret_cast<const uint8_t*>(&src->sin_port);
+    header.insert(header.end(), bytes, bytes + 2);
+    bytes = reinterpret_cast<const uint8_t*>(&dst->sin_port);
+    header.insert(header.end(), bytes, bytes + 2);
+  } else if (source.ss_family == AF_INET6 && destination.ss_family == AF_INET6) {
+    const sockaddr_in6 *src = reinterpret_cast<const sockaddr_in6*>(&source);
+    const sockaddr_in6 *dst = reinterpret_cast<const sockaddr_in6*>(&destination);
+    const uint8_t fields[] = { kVersion2 | kCommandProxy, kFamilyTCP6, 0, kTCP6Size };
+    header.insert(header.end(), fields, fields + sizeof(fields));
+
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&src->sin6_addr);
+    header.insert(header.end(), bytes, bytes + 16);
+    bytes = reinterpret_cast<const uint8_t*>(&dst->sin6_addr);
+    header.insert(header.end(), bytes, bytes + 16);
+    bytes = reinterpret_cast<const uint8_t*>(&src->sin6_port);
+    header.insert(header.end(), bytes, bytes + 2);
+    bytes = reinterpret_cast<const uint8_t*>(&dst->sin6_port);
+    header.insert(header.end(), bytes, bytes + 2);
+  } else {
+    const uint8_t fields[] = { kVersion2 | kCommandLocal, kFamilyUnspec, 0, 0 };
+    header.insert(header.end(), fields, fields + sizeof(fields));
+  }
+
+  return header;
+}
+
+} // namespace proxy_protocol
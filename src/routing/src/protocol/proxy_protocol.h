@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_PROXY_PROTOCOL_INCLUDED
+#define ROUTING_PROXY_PROTOCOL_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#else
+#  include <winsock2.h>
+#endif
+
+namespace mysql_harness { class SocketOperationsBase; }
+
+/**
+ * Version 2 of the PROXY protocol of HAProxy, which passes the addresses
+ * of the client through TCP proxies and load balancers.
+ *
+ * A binary header precedes the traffic of the connection: a 16 byte prefix
+ * with the signature, command and address family, followed by the
+ * addresses and optional TLVs. Only TCP over IPv4 and IPv6 is proxied,
+ * headers of other families and the LOCAL command (health checks of the
+ * load balancers) are accepted but leave the addresses of the connection
+ * as they are.
+ */
+namespace proxy_protocol {
+
+/** @brief size of the prefix of the header, up to the length of the addresses */
+constexpr size_t kPrefixSize = 16;
+
+/** @brief max length of the addresses and TLVs accepted after the prefix */
+constexpr size_t kMaxPayloadSize = 1024;
+
+struct Header {
+  /** @brief false for headers not carrying addresses, like the LOCAL command */
+  bool proxied{false};
+  /** @brief address of the client */
+  sockaddr_storage source;
+  /** @brief address the client connected to */
+  sockaddr_storage destination;
+};
+
+/**
+ * @brief Parses the prefix of a header.
+ *
+ * @param prefix kPrefixSize bytes
+ *
+ * @return length of the payload following the prefix, -1 if prefix isn't
+ *         the one of a version 2 header or the payload is too long
+ */
+long parse_prefix(const uint8_t *prefix) noexcept;
+
+/**
+ * @brief Parses the addresses following the prefix, skipping the TLVs.
+ *
+ * @param prefix prefix accepted by parse_prefix()
+ * @param payload length bytes following the prefix
+ * @param length length returned by parse_prefix()
+ * @param header set to the parsed addresses
+ *
+ * @return false if the payload is too short for the address family
+ */
+bool parse_payload(const uint8_t *prefix, const uint8_t *payload, size_t length,
+                   Header &header) noexcept;
+
+/**
+ * @brief Reads the header a connection starts with as its bytes arrive.
+ *
+ * Reads exactly the header, the traffic following it is left in the
+ * socket. Meant for callers which poll many sockets, read() is called
+ * whenever the socket is readable until the header is complete.
+ */
+class HeaderReader {
+ public:
+  enum class Result {
+    /** @brief more bytes of the header need to arrive */
+    kNeedMore,
+    /** @brief the header is complete */
+    kDone,
+    /** @brief the header is invalid or the socket failed or got closed, errno tells */
+    kFailed,
+  };
+
+  /**
+   * @brief Reads the bytes of the header available, without waiting.
+   *
+   * @param sock_ops socket operations
+   * @param sock connected socket, readable
+   * @param header set to the parsed header once complete
+   *
+   * @return kDone once the header is complete, errno is EPROTO for invalid
+   *         headers and 0 for closed sockets if kFailed
+   */
+  Result read(mysql_harness::SocketOperationsBase *sock_ops, int sock, Header &header);
+
+ private:
+  uint8_t buffer_[kPrefixSize + kMaxPayloadSize];
+  /** @brief bytes of the header read so far */
+  size_t have_{0};
+  /** @brief bytes of the header known so far, the prefix until it got parsed */
+  size_t need_{kPrefixSize};
+};
+
+/**
+ * @brief Encodes the header of a proxied TCP connection.
+ *
+ * Results in a LOCAL header if the addresses aren't both IPv4 or both
+ * IPv6, like for clients of a named socket.
+ */
+std::vector<uint8_t> make_header(const sockaddr_storage &source,
+                                 const sockaddr_storage &destination);
+
+} // namespace proxy_protocol
+
+#endif // ROUTING_PROXY_PROTOCOL_INCLUDED
@@ -0,0 +1,332 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "x_compression.h"
+
+#include "x_handshake.h"
+
+#ifdef HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+constexpr const char *XCompression::kAlgorithm;
+constexpr uint8_t XCompression::kClientCompression;
+constexpr uint8_t XCompression::kServerCompression;
+constexpr size_t XCompression::kMinCompressLength;
+constexpr uint64_t XCompression::kMaxUncompressedSize;
+
+namespace {
+
+// fields of Mysqlx.Connection.Compression
+constexpr uint64_t kFieldUncompressedSize = 1;
+constexpr uint64_t kFieldServerMessages = 2;
+constexpr uint64_t kFieldClientMessages = 3;
+constexpr uint64_t kFieldPayload = 4;
+
+constexpr uint64_t kWireVarint = 0;
+constexpr uint64_t kWireFixed64 = 1;
+constexpr uint64_t kWireLengthDelimited = 2;
+constexpr uint64_t kWireFixed32 = 5;
+
+void store_size(uint8_t *dst, size_t value) {
+  dst[0] = static_cast<uint8_t>(value);
+  dst[1] = static_cast<uint8_t>(value >> 8);
+  dst[2] = static_cast<uint8_t>(value >> 16);
+  dst[3] = static_cast<uint8_t>(value >> 24);
+}
+
+void add_varint(RoutingProtocolBuffer &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+bool read_varint(const uint8_t *&pos, const uint8_t *end, uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64 && pos < end; shift += 7) {
+    const uint8_t byte = *pos++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+/** @brief number of bytes of the complete messages at data */
+size_t complete_size(const uint8_t *data, size_t size) {
+  size_t pos = 0;
+  while (size - pos >= x_handshake::kHeaderSize - 1) {
+    const size_t frame_size = x_handshake::frame_size(data + pos);
+    if (size - pos < frame_size) break;
+    pos += frame_size;
+  }
+  return pos;
+}
+
+/** @brief appends the complete messages of data to out, keeps the rest in partial */
+void take_complete(const uint8_t *data, size_t size, RoutingProtocolBuffer &partial,
+                   RoutingProtocolBuffer &out) {
+  if (!partial.empty()) {
+    partial.insert(partial.end(), data, data + size);
+    data = partial.data();
+    size = partial.size();
+  }
+  const size_t complete = complete_size(data, size);
+  out.insert(out.end(), data, data + complete);
+
+  if (complete == size) {
+    partial.clear();
+  } else if (partial.empty()) {
+    partial.assign(data + complete, data + size);
+  } else {
+    partial.erase(partial.begin(), partial.begin() + static_cast<std::ptrdiff_t>(complete));
+  }
+}
+
+} // namespace
+
+void XCompression::frame_client(const uint8_t *data, size_t size, RoutingProtocolBuffer &messages) {
+  messages.clear();
+  take_complete(data, size, client_partial_, messages);
+}
+
+#ifdef HAVE_ZLIB
+
+struct XCompression::Streams {
+  Streams() {
+    deflater.zalloc = Z_NULL;
+    deflater.zfree = Z_NULL;
+    deflater.opaque = Z_NULL;
+    deflate_ok = deflateInit(&deflater, Z_DEFAULT_COMPRESSION) == Z_OK;
+    inflater.zalloc = Z_NULL;
+    inflater.zfree = Z_NULL;
+    inflater.opaque = Z_NULL;
+    inflater.next_in = Z_NULL;
+    inflater.avail_in = 0;
+    inflate_ok = inflateInit(&inflater) == Z_OK;
+  }
+
+  ~Streams() {
+    if (deflate_ok) deflateEnd(&deflater);
+    if (inflate_ok) inflateEnd(&inflater);
+  }
+
+  z_stream deflater;
+  z_stream inflater;
+  bool deflate_ok;
+  bool inflate_ok;
+};
+
+/*static*/
+bool XCompression::is_supported() noexcept {
+  return true;
+}
+
+void XCompression::compress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  out.clear();
+  plain_bytes_ += size;
+
+  z_stream &deflater = streams_->deflater;
+  if (size < kMinCompressLength || !streams_->deflate_ok) {
+    // not worth it, the messages go as they are
+    out.assign(data, data + size);
+    compressed_bytes_ += out.size();
+    return;
+  }
+
+  // the stream is flushed to let the server inflate all of it
+  scratch_.resize(deflateBound(&deflater, static_cast<uLong>(size)) + 16);
+  deflater.next_in = const_cast<Bytef *>(data);
+  deflater.avail_in = static_cast<uInt>(size);
+  size_t produced = 0;
+  do {
+    if (produced == scratch_.size()) scratch_.resize(scratch_.size() * 2);
+    deflater.next_out = &scratch_[produced];
+    deflater.avail_out = static_cast<uInt>(scratch_.size() - produced);
+    deflate(&deflater, Z_SYNC_FLUSH);
+    produced = scratch_.size() - deflater.avail_out;
+  } while (deflater.avail_out == 0);
+
+  out.resize(x_handshake::kHeaderSize);
+  out.back() = kClientCompression;
+  add_varint(out, kFieldUncompressedSize << 3 | kWireVarint);
+  add_varint(out, size);
+  add_varint(out, kFieldPayload << 3 | kWireLengthDelimited);
+  add_varint(out, produced);
+  out.insert(out.end(), scratch_.begin(), scratch_.begin() + static_cast<std::ptrdiff_t>(produced));
+  store_size(&out[0], out.size() - (x_handshake::kHeaderSize - 1));
+  compressed_bytes_ += out.size();
+}
+
+bool XCompression::add_compressed(const uint8_t *message, size_t size, RoutingProtocolBuffer &out) {
+  if (!streams_->inflate_ok) return false;
+
+  uint64_t uncompressed_size = 0;
+  uint64_t type = 0;
+  bool typed = false;
+  const uint8_t *payload = nullptr;
+  uint64_t payload_size = 0;
+  const uint8_t *pos = message;
+  const uint8_t *const end = message + size;
+  while (pos < end) {
+    uint64_t key;
+    uint64_t value;
+    if (!read_varint(pos, end, key)) return false;
+    switch (key & 0x07) {
+    case kWireVarint:
+      if (!read_varint(pos, end, value)) return false;
+      if ((key >> 3) == kFieldUncompressedSize) uncompressed_size = value;
+      if ((key >> 3) == kFieldServerMessages || (key >> 3) == kFieldClientMessages) {
+        typed = true;
+        type = value;
+      }
+      break;
+    case kWireLengthDelimited:
+      if (!read_varint(pos, end, value) || value > static_cast<uint64_t>(end - pos)) return false;
+      if ((key >> 3) == kFieldPayload) {
+        payload = pos;
+        payload_size = value;
+      }
+      pos += value;
+      break;
+    case kWireFixed64:
+      if (end - pos < 8) return false;
+      pos += 8;
+      break;
+    case kWireFixed32:
+      if (end - pos < 4) return false;
+      pos += 4;
+      break;
+    default:
+      return false;
+    }
+  }
+  if (payload == nullptr || uncompressed_size == 0 || uncompressed_size > kMaxUncompressedSize ||
+      type > 0xff) {
+    return false;
+  }
+
+  z_stream &inflater = streams_->inflater;
+  scratch_.resize(static_cast<size_t>(uncompressed_size));
+  inflater.next_in = const_cast<Bytef *>(payload);
+  inflater.avail_in = static_cast<uInt>(payload_size);
+  inflater.next_out = &scratch_[0];
+  inflater.avail_out = static_cast<uInt>(scratch_.size());
+  const int res = inflate(&inflater, Z_SYNC_FLUSH);
+  if ((res != Z_OK && res != Z_STREAM_END) || inflater.avail_out != 0 || inflater.avail_in != 0) {
+    return false;
+  }
+
+  if (!typed) {
+    if (complete_size(scratch_.data(), scratch_.size()) != scratch_.size()) return false;
+    out.insert(out.end(), scratch_.begin(), scratch_.end());
+    return true;
+  }
+
+  // messages of one type, the header gets its type back
+  size_t offset = 0;
+  while (offset < scratch_.size()) {
+    if (scratch_.size() - offset < x_handshake::kHeaderSize - 1) return false;
+    const size_t message_size = x_handshake::frame_size(&scratch_[offset]) - (x_handshake::kHeaderSize - 1);
+    offset += x_handshake::kHeaderSize - 1;
+    if (scratch_.size() - offset < message_size) return false;
+
+    const size_t header_pos = out.size();
+    out.resize(header_pos + x_handshake::kHeaderSize);
+    store_size(&out[header_pos], message_size + 1);
+    out.back() = static_cast<uint8_t>(type);
+    out.insert(out.end(), scratch_.begin() + static_cast<std::ptrdiff_t>(offset),
+               scratch_.begin() + static_cast<std::ptrdiff_t>(offset + message_size));
+    offset += message_size;
+  }
+
+  return true;
+}
+
+#else
+
+struct XCompression::Streams {};
+
+/*static*/
+bool XCompression::is_supported() noexcept {
+  return false;
+}
+
+void XCompression::compress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  out.assign(data, data + size);
+}
+
+bool XCompression::add_compressed(const uint8_t *, size_t, RoutingProtocolBuffer &) {
+  return false;
+}
+
+#endif
+
+XCompression::XCompression() : streams_(new Streams()) {}
+
+XCompression::~XCompression() {}
+
+bool XCompression::decompress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out) {
+  out.clear();
+  compressed_bytes_ += size;
+
+  // messages split over reads are joined first
+  const uint8_t *pos = data;
+  size_t left = size;
+  if (!server_partial_.empty()) {
+    server_partial_.insert(server_partial_.end(), data, data + size);
+    pos = server_partial_.data();
+    left = server_partial_.size();
+  }
+
+  while (left >= x_handshake::kHeaderSize - 1) {
+    const size_t frame_size = x_handshake::frame_size(pos);
+    if (left < frame_size) break;
+
+    if (frame_size > x_handshake::kHeaderSize - 1 &&
+        pos[x_handshake::kHeaderSize - 1] == kServerCompression) {
+      if (!add_compressed(pos + x_handshake::kHeaderSize, frame_size - x_handshake::kHeaderSize, out)) {
+        return false;
+      }
+    } else {
+      out.insert(out.end(), pos, pos + frame_size);
+    }
+
+    pos += frame_size;
+    left -= frame_size;
+  }
+
+  if (left == 0) {
+    server_partial_.clear();
+  } else if (server_partial_.empty()) {
+    server_partial_.assign(pos, pos + left);
+  } else {
+    server_partial_.erase(server_partial_.begin(), server_partial_.begin() + (pos - server_partial_.data()));
+  }
+  plain_bytes_ += out.size();
+
+  return true;
+}
@@ -0,0 +1,130 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_X_COMPRESSION_INCLUDED
+#define ROUTING_X_COMPRESSION_INCLUDED
+
+#include "base_protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/** @class XCompression
+ *
+ * Translates between the plain X protocol messages of a client and the
+ * compressed messages (Mysqlx.Connection.Compression) exchanged with a
+ * server that accepted the "compression" capability of the router.
+ *
+ * The router compresses with the deflate_stream algorithm: one zlib stream
+ * per direction, flushed at the end of every Compression message. Each read
+ * of the client becomes one Compression message holding its complete
+ * messages with their headers. Messages of the server may come plain or
+ * compressed; compressed ones either hold messages with their headers or,
+ * if server_messages is set, messages of that type with a header of 4
+ * bytes of payload size only.
+ */
+class XCompression {
+ public:
+  /** @brief algorithm asked for in the "compression" capability */
+  static constexpr const char *kAlgorithm = "deflate_stream";
+
+  /** @brief type of Compression messages of the client and the server */
+  static constexpr uint8_t kClientCompression = 46;
+  static constexpr uint8_t kServerCompression = 19;
+
+  /** @brief messages shorter than this are sent uncompressed */
+  static constexpr size_t kMinCompressLength = 50;
+
+  /** @brief max. size of the messages of a Compression message of the server */
+  static constexpr uint64_t kMaxUncompressedSize = 1024 * 1024 * 1024;
+
+  /** @brief Returns true if the router was built with zlib. */
+  static bool is_supported() noexcept;
+
+  XCompression();
+  ~XCompression();
+
+  /**
+   * @brief Takes the complete messages of the bytes read from the client.
+   *
+   * The start of a message that isn't complete yet is kept until the rest is fed.
+   *
+   * @param data bytes read from the client
+   * @param size number of bytes at data
+   * @param messages cleared and set to the complete messages
+   */
+  void frame_client(const uint8_t *data, size_t size, RoutingProtocolBuffer &messages);
+
+  /**
+   * @brief Compresses complete messages of the client.
+   *
+   * @param data messages taken with frame_client()
+   * @param size number of bytes at data
+   * @param out cleared and set to the Compression message for the server,
+   *        or the messages as they are if they are too short
+   */
+  void compress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out);
+
+  /**
+   * @brief Decompresses the messages read from the server.
+   *
+   * Incomplete messages are kept until the rest is fed.
+   *
+   * @param data bytes read from the server
+   * @param size number of bytes at data
+   * @param out cleared and set to the complete plain messages for the client
+   *
+   * @return false if a Compression message isn't valid
+   */
+  bool decompress(const uint8_t *data, size_t size, RoutingProtocolBuffer &out);
+
+  /** @brief bytes read from the client and the server, before compression */
+  uint64_t get_plain_bytes() const noexcept { return plain_bytes_; }
+
+  /** @brief bytes sent to and read from the server */
+  uint64_t get_compressed_bytes() const noexcept { return compressed_bytes_; }
+
+ private:
+  struct Streams;
+
+  /** @brief adds the messages of the payload of a Compression message to out */
+  bool add_compressed(const uint8_t *message, size_t size, RoutingProtocolBuffer &out);
+
+  std::unique_ptr<Streams> streams_;
+
+  /** @brief start of a message of the client, not complete yet */
+  RoutingProtocolBuffer client_partial_;
+  /** @brief start of a message of the server, not complete yet */
+  RoutingProtocolBuffer server_partial_;
+  /** @brief payload of the last Compression message, inflated or deflated */
+  RoutingProtocolBuffer scratch_;
+
+  uint64_t plain_bytes_{0};
+  uint64_t compressed_bytes_{0};
+};
+
+#endif // ROUTING_X_COMPRESSION_INCLUDED
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "x_handshake.h"
+
+#include "classic_handshake.h"
+#include "socket_operations.h"
+
+#include <cerrno>
+
+namespace x_handshake {
+
+static uint32_t read_size(const uint8_t *data) {
+  return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+RoutingProtocolBuffer make_message(uint8_t type) {
+  return RoutingProtocolBuffer{0x01, 0x00, 0x00, 0x00, type};
+}
+
+bool read_message(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                  RoutingProtocolBuffer &message, std::chrono::milliseconds timeout) {
+  message.resize(kHeaderSize - 1);
+  if (!classic_handshake::read_bytes(sock_ops, sock, &message[0], kHeaderSize - 1, timeout)) return false;
+
+  // the size counts the type
+  const uint32_t size = read_size(&message[0]);
+  if (size == 0 || size > kMaxMessageSize) {
+    sock_ops->set_errno(EMSGSIZE);
+    return false;
+  }
+
+  message.resize(kHeaderSize - 1 + size);
+  return classic_handshake::read_bytes(sock_ops, sock, &message[kHeaderSize - 1], size, timeout);
+}
+
+bool read_response(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                   RoutingProtocolBuffer &response, std::chrono::milliseconds timeout) {
+  do {
+    if (!read_message(sock_ops, sock, response, timeout)) return false;
+  } while (get_type(response) == kNotice);
+
+  return true;
+}
+
+bool follow_frames(const uint8_t *data, size_t size, uint64_t &skip, size_t &last_offset) {
+  last_offset = size;
+
+  uint64_t pos = skip;
+  while (pos < size) {
+    if (size - pos < kHeaderSize - 1) return false;
+    last_offset = static_cast<size_t>(pos);
+    pos += kHeaderSize - 1 + static_cast<uint64_t>(read_size(data + pos));
+  }
+  skip = pos - size;
+
+  return true;
+}
+
+} // namespace x_handshake
@@ -0,0 +1,120 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_X_HANDSHAKE_INCLUDED
+#define ROUTING_X_HANDSHAKE_INCLUDED
+
+#include "base_protocol.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace mysql_harness { class SocketOperationsBase; }
+
+/**
+ * Helpers for the router taking part in the X protocol handshake, as done
+ * when server connections are pooled.
+ *
+ * Messages are kept with their header: 4 bytes of size, counting the type
+ * byte and the payload, followed by the type.
+ */
+namespace x_handshake {
+
+/** @brief size and type of a message */
+constexpr size_t kHeaderSize = 5;
+
+/** @brief max size of the messages read by the router */
+constexpr size_t kMaxMessageSize = 65536;
+
+/** @brief types of client messages, see Mysqlx.ClientMessages */
+constexpr uint8_t kCapabilitiesGet = 1;
+constexpr uint8_t kCapabilitiesSet = 2;
+constexpr uint8_t kConnectionClose = 3;
+constexpr uint8_t kAuthenticateStart = 4;
+constexpr uint8_t kSessionReset = 6;
+constexpr uint8_t kSessionClose = 7;
+
+/** @brief types of server messages, see Mysqlx.ServerMessages */
+constexpr uint8_t kOk = 0;
+constexpr uint8_t kError = 1;
+constexpr uint8_t kCapabilities = 2;
+constexpr uint8_t kAuthenticateOk = 4;
+constexpr uint8_t kNotice = 11;
+
+/** @brief size of the message starting with header, including the 4 bytes of its size */
+inline size_t frame_size(const uint8_t *header) {
+  return kHeaderSize - 1 + (static_cast<size_t>(header[0]) | static_cast<size_t>(header[1]) << 8 |
+                            static_cast<size_t>(header[2]) << 16 | static_cast<size_t>(header[3]) << 24);
+}
+
+/** @brief message without fields, like CapabilitiesGet or Ok */
+RoutingProtocolBuffer make_message(uint8_t type);
+
+/** @brief type of a message read with read_message() */
+inline uint8_t get_type(const RoutingProtocolBuffer &message) {
+  return message[kHeaderSize - 1];
+}
+
+/**
+ * @brief Reads a message.
+ *
+ * @param sock_ops socket operations
+ * @param sock socket to read from
+ * @param message set to the message including the header
+ * @param timeout max time to wait for each part of the message
+ *
+ * @return false if socket got closed, failed, timed out or message is
+ *         empty or bigger than kMaxMessageSize; errno is 0 if socket was closed
+ */
+bool read_message(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                  RoutingProtocolBuffer &message, std::chrono::milliseconds timeout);
+
+/**
+ * @brief Reads the response of the server to a message, skipping notices.
+ *
+ * @return false if reading failed, see read_message()
+ */
+bool read_response(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                   RoutingProtocolBuffer &response, std::chrono::milliseconds timeout);
+
+/**
+ * @brief Follows the frames of a stream read in pieces.
+ *
+ * @param data piece of the stream
+ * @param size bytes in data
+ * @param skip bytes of the frame before data that are not in data, set to
+ *        those of the last frame that are not in data
+ * @param last_offset set to the offset of the last frame starting in data,
+ *        size if none starts in it
+ *
+ * @return false if data ends inside a frame header, the frames can't be
+ *         followed anymore then
+ */
+bool follow_frames(const uint8_t *data, size_t size, uint64_t &skip, size_t &last_offset);
+
+} // namespace x_handshake
+
+#endif // ROUTING_X_HANDSHAKE_INCLUDED
@@ -38,18 +38,61 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "mysqlx_session.pb.h"
 #include "mysqlx_connection.pb.h"
 #include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
 
 #include <algorithm>
 #include <cassert>
+#include <limits>
 
 using ProtobufMessage = google::protobuf::Message;
 IMPORT_LOG_FUNCTIONS()
 
 constexpr size_t kMessageHeaderSize = 5;
 
+// true if the buffer holds well-formed fields only
+static bool skip_fields(const void* message_buffer, const uint32_t message_size) {
+  using google::protobuf::internal::WireFormatLite;
+
+  google::protobuf::io::CodedInputStream input(static_cast<const uint8_t*>(message_buffer),
+                                               static_cast<int>(message_size));
+  while (uint32_t tag = input.ReadTag()) {
+    if (!WireFormatLite::SkipField(&input, tag)) return false;
+  }
+
+  // a tag of 0 is only fine at the end of the message
+  return input.ConsumedEntireMessage();
+}
+
+// value of curr_pktnr once the frame boundaries of the client are unknown
+constexpr int kUntrackedFrames = -1;
+
+/** @brief bytes the last frame in data is missing, -1 if data ends inside a frame header
+ *
+ * @param skip bytes of the frame before data that are not in data yet
+ */
+static int64_t frame_bytes_missing(const uint8_t *data, size_t size, uint64_t skip) {
+  using google::protobuf::io::CodedInputStream;
+
+  uint64_t pos = skip;
+  while (pos < size) {
+    if (size - pos < 4) return -1;
+    uint32_t frame_size;
+    CodedInputStream::ReadLittleEndian32FromArray(data + pos, &frame_size);
+    pos += 4 + static_cast<uint64_t>(frame_size);
+  }
+
+  return static_cast<int64_t>(pos - size);
+}
+
+/** @brief frame boundary state to keep for the next read of the client */
+static int tracked_frames_state(int64_t missing) {
+  return missing < 0 || missing > std::numeric_limits<int>::max() ? kUntrackedFrames
+                                                                   : static_cast<int>(missing);
+}
+
 static bool send_message(const std::string &log_prefix,
                          int destination,
                          const int8_t type,
@@ -83,7 +126,12 @@ static bool send_message(const std::string &log_prefix,
 }
 
 static bool message_valid(const void* message_buffer, const int8_t message_type, const uint32_t message_size) {
-  std::unique_ptr<google::protobuf::Message> msg;
+  // messages without fields need no parsing, the rest is parsed into
+  // per-thread instances. Clear() keeps the memory of the fields, so once
+  // the first connections of a thread went through the checks don't allocate
+  thread_local Mysqlx::Session::AuthenticateStart authenticate_start;
+  thread_local Mysqlx::Connection::CapabilitiesSet capabilities_set;
+  ProtobufMessage *msg = nullptr;
 
   assert(message_type == Mysqlx::ClientMessages::SESS_AUTHENTICATE_START
          || message_type == Mysqlx::ClientMessages::CON_CAPABILITIES_GET
@@ -92,30 +140,25 @@ static bool message_valid(const void* message_buffer, const int8_t message_type,
 
   switch (message_type) {
   case Mysqlx::ClientMessages::SESS_AUTHENTICATE_START:
-    msg.reset(new Mysqlx::Session::AuthenticateStart());
-    break;
-  case Mysqlx::ClientMessages::CON_CAPABILITIES_GET:
-    msg.reset(new Mysqlx::Connection::CapabilitiesGet());
+    msg = &authenticate_start;
     break;
   case Mysqlx::ClientMessages::CON_CAPABILITIES_SET:
-    msg.reset(new Mysqlx::Connection::CapabilitiesSet());
+    msg = &capabilities_set;
     break;
-  default: /* Mysqlx::ClientMessages::CON_CLOSE */
-    msg.reset(new Mysqlx::Connection::Close());
+  default: /* Mysqlx::ClientMessages::CON_CAPABILITIES_GET, Mysqlx::ClientMessages::CON_CLOSE */
+    // no required fields, only the wire format is checked
+    return skip_fields(message_buffer, message_size);
   }
 
-  assert(msg.get() != nullptr);
-
   // sanity check deserializing the message
-  if (!msg->ParseFromArray(message_buffer, static_cast<int>(message_size))) {
-    return false;
-  }
+  const bool valid = msg->ParseFromArray(message_buffer, static_cast<int>(message_size));
+  msg->Clear();
 
-  return true;
+  return valid;
 }
 
 static bool get_next_message(int sender,
-                             RoutingProtocolBuffer &buffer,
+                             RoutingBufferRef buffer,
                              size_t   &buffer_contents_size,
                              size_t   &message_offset,
                              int8_t   &message_type,
@@ -134,9 +177,16 @@ static bool get_next_message(int sender,
     return false;
   }
 
-  // we need at least 4 bytes to know the message size
+  // we need at least 4 bytes to know the message size. Whatever else the
+  // sender has for us goes into the buffer too, to save further reads
   while (bytes_left < 4) {
-    read_res = sock_ops->read(sender, &buffer[message_offset + bytes_left], 4 - bytes_left);
+    if (buffer_contents_size == buffer.size()) {
+      log_error("X protocol message header does not fit the buffer: (%lu)",
+                static_cast<long unsigned>(message_offset));
+      error = true;
+      return false;
+    }
+    read_res = sock_ops->read(sender, &buffer[buffer_contents_size], buffer.size() - buffer_contents_size);
     if (read_res < 0) {
       const int last_errno = sock_ops->get_errno();
       log_error("fd=%d failed reading size of the message: (%d %s %ld)",
@@ -157,6 +207,12 @@ static bool get_next_message(int sender,
 
   // we got the message size, we can decode it
   CodedInputStream::ReadLittleEndian32FromArray(&buffer[message_offset], &message_size);
+  // the size includes the type byte
+  if (message_size == 0) {
+    log_error("fd=%d X protocol message without type", sender);
+    error = true;
+    return false;
+  }
 
   // If not the whole message is in the buffer we need to read the remaining part to be able to decode it.
   // First let's check if the message will fit the buffer.
@@ -173,7 +229,7 @@ static bool get_next_message(int sender,
   }
   // next read the remaining part of the message if needed
   while (message_size + 4 > bytes_left) {
-    read_res = sock_ops->read(sender, &buffer[message_offset+bytes_left], message_size + 4 - bytes_left);
+    read_res = sock_ops->read(sender, &buffer[buffer_contents_size], buffer.size() - buffer_contents_size);
     if (read_res < 0) {
       const int last_errno = sock_ops->get_errno();
 
@@ -199,7 +255,7 @@ static bool get_next_message(int sender,
 }
 
 int XProtocol::copy_packets(int sender, int receiver, bool sender_is_readable,
-                            RoutingProtocolBuffer &buffer, int * /*curr_pktnr*/,
+                            RoutingBufferRef buffer, int *curr_pktnr,
                             bool &handshake_done, size_t *report_bytes_read,
                             bool from_server) {
   assert(report_bytes_read != nullptr);
@@ -207,6 +263,9 @@ int XProtocol::copy_packets(int sender, int receiver, bool sender_is_readable,
   ssize_t res = 0;
   auto buffer_length = buffer.size();
   size_t bytes_read = 0;
+  // bytes of the current client frame still to come, see frame_bytes_missing()
+  int unused_frames_state = kUntrackedFrames;
+  int &frames_state = curr_pktnr ? *curr_pktnr : unused_frames_state;
 
   mysql_harness::SocketOperationsBase* const so = routing_sock_ops_->so();
   if (sender_is_readable) {
@@ -253,6 +312,7 @@ int XProtocol::copy_packets(int sender, int receiver, bool sender_is_readable,
               return -1;
             }
             handshake_done = true;
+            frames_state = tracked_frames_state(frame_bytes_missing(&buffer[0], bytes_read, 0));
             break;
           }
           else {
@@ -279,6 +339,24 @@ int XProtocol::copy_packets(int sender, int receiver, bool sender_is_readable,
       if (msg_read_error) {
         return -1;
       }
+    } else if (!from_server && frames_state != kUntrackedFrames) {
+      // pipelined frames of the client are written together: a frame that got
+      // cut off by the read is completed from the socket if it fits the buffer
+      int64_t missing = frame_bytes_missing(&buffer[0], bytes_read, static_cast<uint64_t>(frames_state));
+      while (missing != 0 && bytes_read < buffer_length &&
+             (missing < 0 || static_cast<uint64_t>(missing) <= buffer_length - bytes_read)) {
+        struct pollfd fds[] = {
+          { sender, POLLIN, 0 },
+        };
+        if (so->poll(fds, 1, std::chrono::milliseconds(0)) <= 0 || (fds[0].revents & POLLIN) == 0 ||
+            (res = so->read(sender, &buffer[bytes_read], buffer_length - bytes_read)) <= 0) {
+          // errors and closed connections are reported by the next read
+          break;
+        }
+        bytes_read += static_cast<size_t>(res);
+        missing = frame_bytes_missing(&buffer[0], bytes_read, static_cast<uint64_t>(frames_state));
+      }
+      frames_state = tracked_frames_state(missing);
     }
 
     if (so->write_all(receiver, &buffer[0], bytes_read) < 0) {
@@ -294,6 +372,97 @@ int XProtocol::copy_packets(int sender, int receiver, bool sender_is_readable,
   return 0;
 }
 
+bool XProtocol::is_valid_handshake_message(uint8_t type, const uint8_t *payload, size_t size) {
+  const int8_t message_type = static_cast<int8_t>(type);
+  if (size > std::numeric_limits<uint32_t>::max() ||
+      (message_type != Mysqlx::ClientMessages::SESS_AUTHENTICATE_START &&
+       message_type != Mysqlx::ClientMessages::CON_CAPABILITIES_GET &&
+       message_type != Mysqlx::ClientMessages::CON_CAPABILITIES_SET &&
+       message_type != Mysqlx::ClientMessages::CON_CLOSE)) {
+    return false;
+  }
+
+  return message_valid(payload, message_type, static_cast<uint32_t>(size));
+}
+
+bool XProtocol::requests_tls(const uint8_t *payload, size_t size) {
+  return sets_capability(payload, size, "tls");
+}
+
+bool XProtocol::sets_capability(const uint8_t *payload, size_t size, const std::string &name) {
+  thread_local Mysqlx::Connection::CapabilitiesSet capabilities_set;
+
+  bool found = false;
+  if (capabilities_set.ParseFromArray(payload, static_cast<int>(size))) {
+    for (const auto &capability: capabilities_set.capabilities().capabilities()) {
+      if (capability.name() == name) found = true;
+    }
+  }
+  capabilities_set.Clear();
+
+  return found;
+}
+
+static void add_field(Mysqlx::Datatypes::Object *object, const std::string &key,
+                      Mysqlx::Datatypes::Scalar::Type type) {
+  using Mysqlx::Datatypes::Any;
+
+  Mysqlx::Datatypes::Object::ObjectField *field = object->add_fld();
+  field->set_key(key);
+  field->mutable_value()->set_type(Any::SCALAR);
+  field->mutable_value()->mutable_scalar()->set_type(type);
+}
+
+RoutingProtocolBuffer XProtocol::make_compression_request(const std::string &algorithm) {
+  using google::protobuf::io::CodedOutputStream;
+  using Mysqlx::Datatypes::Scalar;
+
+  Mysqlx::Connection::CapabilitiesSet capabilities_set;
+  Mysqlx::Connection::Capability *capability = capabilities_set.mutable_capabilities()->add_capabilities();
+  capability->set_name("compression");
+  capability->mutable_value()->set_type(Mysqlx::Datatypes::Any::OBJECT);
+  Mysqlx::Datatypes::Object *object = capability->mutable_value()->mutable_obj();
+  add_field(object, "algorithm", Scalar::V_STRING);
+  object->mutable_fld(0)->mutable_value()->mutable_scalar()->mutable_v_string()->set_value(algorithm);
+  add_field(object, "server_combine_mixed_messages", Scalar::V_BOOL);
+  object->mutable_fld(1)->mutable_value()->mutable_scalar()->set_v_bool(true);
+
+  const size_t msg_size = capabilities_set.ByteSize();
+  RoutingProtocolBuffer buffer(kMessageHeaderSize + msg_size);
+  CodedOutputStream::WriteLittleEndian32ToArray(static_cast<uint32_t>(msg_size + 1), &buffer[0]);
+  buffer[kMessageHeaderSize - 1] = static_cast<uint8_t>(Mysqlx::ClientMessages::CON_CAPABILITIES_SET);
+  capabilities_set.SerializeToArray(&buffer[kMessageHeaderSize], static_cast<int>(msg_size));
+
+  return buffer;
+}
+
+bool XProtocol::remove_capabilities(RoutingProtocolBuffer &message, const std::vector<std::string> &names) {
+  using google::protobuf::io::CodedOutputStream;
+
+  Mysqlx::Connection::Capabilities capabilities;
+  if (message.size() < kMessageHeaderSize ||
+      !capabilities.ParseFromArray(&message[kMessageHeaderSize],
+                                   static_cast<int>(message.size() - kMessageHeaderSize))) {
+    return false;
+  }
+
+  auto *list = capabilities.mutable_capabilities();
+  const int size_before = list->size();
+  for (int i = list->size() - 1; i >= 0; --i) {
+    if (std::find(names.begin(), names.end(), list->Get(i).name()) != names.end()) {
+      list->DeleteSubrange(i, 1);
+    }
+  }
+  if (list->size() == size_before) return true;
+
+  const size_t msg_size = capabilities.ByteSize();
+  message.resize(kMessageHeaderSize + msg_size);
+  CodedOutputStream::WriteLittleEndian32ToArray(static_cast<uint32_t>(msg_size + 1), &message[0]);
+  if (msg_size > 0) capabilities.SerializeToArray(&message[kMessageHeaderSize], static_cast<int>(msg_size));
+
+  return true;
+}
+
 bool XProtocol::send_error(int destination,
                            unsigned short code,
                            const std::string &message,
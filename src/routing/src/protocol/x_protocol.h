@@ -27,6 +27,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "base_protocol.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 class XProtocol: public BaseProtocol {
 public:
@@ -55,7 +57,9 @@ public:
    * @param receiver Descriptor of the receiver
    * @param sender_is_readable true if sender socket has data
    * @param buffer Buffer to use for storage
-   * @param curr_pktnr Pointer to storage for sequence id of packet
+   * @param curr_pktnr Pointer to storage for the bytes of the current frame
+   *                   of the client still to come, used to write pipelined
+   *                   frames together
    * @param handshake_done Whether handshake phase is finished or not
    * @param report_bytes_read Pointer to storage to report bytes read
    * @param from_server true if the message sender is the server, false
@@ -64,7 +68,7 @@ public:
    * @return 0 on success; -1 on error
    */
   virtual int copy_packets(int sender, int receiver, bool sender_is_readable,
-                           RoutingProtocolBuffer &buffer, int *curr_pktnr,
+                           RoutingBufferRef buffer, int *curr_pktnr,
                            bool &handshake_done, size_t *report_bytes_read,
                            bool from_server) override;
 
@@ -86,6 +90,41 @@ public:
                           const std::string &sql_state,
                           const std::string &log_prefix) override;
 
+  /**
+   * @brief Checks a client message of the handshake, like the protocol does on the first one.
+   *
+   * @param type CapabilitiesGet, CapabilitiesSet, Close or AuthenticateStart
+   * @param payload message without its header
+   * @param size bytes of the payload
+   */
+  static bool is_valid_handshake_message(uint8_t type, const uint8_t *payload, size_t size);
+
+  /** @brief true if a well-formed CapabilitiesSet payload asks for TLS */
+  static bool requests_tls(const uint8_t *payload, size_t size);
+
+  /** @brief true if a well-formed CapabilitiesSet payload sets the capability */
+  static bool sets_capability(const uint8_t *payload, size_t size, const std::string &name);
+
+  /**
+   * @brief Returns the CapabilitiesSet message the router asks a server for compression with.
+   *
+   * The server is asked to combine messages of different types, so one
+   * Compression message covers a whole result set.
+   *
+   * @param algorithm compression algorithm, like "deflate_stream"
+   */
+  static RoutingProtocolBuffer make_compression_request(const std::string &algorithm);
+
+  /**
+   * @brief Removes capabilities from a Capabilities message of a server.
+   *
+   * @param message message including its header, rewritten if it held one of names
+   * @param names names of the capabilities to hide from the client
+   *
+   * @return false if the message can't be parsed, it is kept as it is then
+   */
+  static bool remove_capabilities(RoutingProtocolBuffer &message, const std::vector<std::string> &names);
+
   /** @brief Gets protocol type. */
   virtual Type get_type() override {
     return Type::kXProtocol;
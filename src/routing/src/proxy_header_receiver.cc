@@ -0,0 +1,228 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "proxy_header_receiver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <unistd.h>
+#endif
+
+#include "common.h"
+#include "mysql/harness/logging/logging.h"
+#include "mysql/harness/networking/socket_endpoint.h"
+#include "mysql_routing_common.h"
+#include "utils.h"
+
+IMPORT_LOG_FUNCTIONS()
+
+// required by C++11, deprecated in C++17
+constexpr size_t ProxyHeaderReceiver::kMaxPending;
+constexpr std::chrono::milliseconds ProxyHeaderReceiver::kPollInterval;
+
+ProxyHeaderReceiver::ProxyHeaderReceiver(mysql_harness::SocketOperationsBase *sock_ops,
+                                         std::chrono::milliseconds timeout, Handler handler)
+    : sock_ops_(sock_ops), timeout_(timeout), handler_(std::move(handler)) {
+#ifndef _WIN32
+  if (pipe(wakeup_fds_) == -1) {
+    throw std::runtime_error("Failed to create wakeup pipe: " + get_message_error(errno));
+  }
+
+  for (int fd: wakeup_fds_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+}
+
+ProxyHeaderReceiver::~ProxyHeaderReceiver() {
+  stop();
+
+#ifndef _WIN32
+  ::close(wakeup_fds_[0]);
+  ::close(wakeup_fds_[1]);
+#endif
+}
+
+void ProxyHeaderReceiver::start(const std::string &name, size_t thread_stack_size) {
+  name_ = name;
+  thread_.reset(new mysql_harness::MySQLRouterThread(thread_stack_size));
+  thread_->run(&run_thread, this);
+}
+
+void ProxyHeaderReceiver::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopping_ = true;
+  }
+#ifndef _WIN32
+  const char c = 0;
+  ssize_t res;
+  do {
+    res = ::write(wakeup_fds_[1], &c, 1);
+  } while (res == -1 && errno == EINTR);
+#endif
+  if (thread_) thread_->join();
+  thread_.reset();
+
+  // pushed after the thread stopped, or never started
+  std::vector<Pending> incoming;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    incoming.swap(incoming_);
+  }
+  for (const auto &pending: incoming) {
+    sock_ops_->close(pending.sock);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+bool ProxyHeaderReceiver::push(int sock, const sockaddr_storage &peer_addr, clock_type::time_point now) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (stopping_ || size_.load(std::memory_order_relaxed) >= kMaxPending) return false;
+
+    incoming_.push_back(Pending{sock, peer_addr, now + timeout_,
+                                std::unique_ptr<proxy_protocol::HeaderReader>(new proxy_protocol::HeaderReader)});
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+#ifndef _WIN32
+  // a full pipe means the thread has a wakeup pending already
+  const char c = 0;
+  ssize_t res;
+  do {
+    res = ::write(wakeup_fds_[1], &c, 1);
+  } while (res == -1 && errno == EINTR);
+#endif
+  return true;
+}
+
+void* ProxyHeaderReceiver::run_thread(void *context) {
+  static_cast<ProxyHeaderReceiver*>(context)->run();
+  return nullptr;
+}
+
+void ProxyHeaderReceiver::close_pending(const Pending &pending, int last_errno) {
+  size_.fetch_sub(1, std::memory_order_relaxed);
+  sock_ops_->close(pending.sock); // no shutdown() before close()
+
+  static mysql_harness::logging::LogRateLimiter log_limiter;
+  log_info_limited(log_limiter, "[%s] closed connection of %s without PROXY header: %s",
+                   name_.c_str(), mysql_harness::SocketEndpoint(pending.peer_addr).str().c_str(),
+                   last_errno == 0 ? "connection closed" : get_message_error(last_errno).c_str());
+}
+
+void ProxyHeaderReceiver::run() {
+  mysql_harness::rename_thread(get_routing_thread_name(name_, "RtP").c_str());  // "Rt proxy" would be too long :(
+
+  std::vector<Pending> pending;
+  std::vector<struct pollfd> fds;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (stopping_) break;
+      for (auto &entry: incoming_) pending.push_back(std::move(entry));
+      incoming_.clear();
+    }
+
+    auto now = clock_type::now();
+    auto wait = kPollInterval;
+#ifdef _WIN32
+    // new sockets aren't noticed before the wait ends
+    wait = std::chrono::milliseconds(10);
+#endif
+    fds.clear();
+    fds.push_back({wakeup_fds_[0], POLLIN, 0});
+    for (const auto &entry: pending) {
+      fds.push_back({entry.sock, POLLIN, 0});
+      // rounded up, a wait of 0 would spin until the deadline
+      wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(entry.deadline - now) +
+                            std::chrono::milliseconds(1));
+    }
+    wait = std::max(wait, std::chrono::milliseconds(0));
+
+    const int res = sock_ops_->poll(fds.data(), static_cast<nfds_t>(fds.size()), wait);
+    if (res < 0) {
+      const int last_errno = sock_ops_->get_errno();
+      if (last_errno != EINTR && last_errno != EAGAIN) {
+        log_error("[%s] poll() failed with error: %s", name_.c_str(), get_message_error(last_errno).c_str());
+      }
+      continue;
+    }
+
+#ifndef _WIN32
+    if (fds[0].revents & POLLIN) {
+      char buf[256];
+      while (::read(wakeup_fds_[0], buf, sizeof(buf)) > 0) {}
+    }
+#endif
+
+    now = clock_type::now();
+    // fds[ndx + 1] belongs to pending[ndx], both keep their order
+    size_t kept = 0;
+    for (size_t ndx = 0; ndx < pending.size(); ++ndx) {
+      Pending &entry = pending[ndx];
+
+      if (fds[ndx + 1].revents != 0) {
+        proxy_protocol::Header header;
+        const auto result = entry.reader->read(sock_ops_, entry.sock, header);
+        if (result == proxy_protocol::HeaderReader::Result::kFailed) {
+          close_pending(entry, sock_ops_->get_errno());
+          continue;
+        }
+        if (result == proxy_protocol::HeaderReader::Result::kDone) {
+          sockaddr_storage client_addr = entry.peer_addr;
+          if (header.proxied) {
+            log_debug("[%s] fd=%d connection of %s proxied by %s", name_.c_str(), entry.sock,
+                      mysql_harness::SocketEndpoint(header.source).str().c_str(),
+                      mysql_harness::SocketEndpoint(entry.peer_addr).str().c_str());
+            client_addr = header.source;
+          }
+          size_.fetch_sub(1, std::memory_order_relaxed);
+          handler_(entry.sock, client_addr);
+          continue;
+        }
+      }
+
+      if (now >= entry.deadline) {
+        close_pending(entry, ETIMEDOUT);
+        continue;
+      }
+
+      if (kept != ndx) pending[kept] = std::move(entry);
+      ++kept;
+    }
+    pending.resize(kept);
+  }
+
+  for (const auto &entry: pending) {
+    sock_ops_->close(entry.sock);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
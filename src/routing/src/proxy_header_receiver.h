@@ -0,0 +1,155 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_PROXY_HEADER_RECEIVER_INCLUDED
+#define ROUTING_PROXY_HEADER_RECEIVER_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#else
+#  include <winsock2.h>
+#endif
+
+#include "mysql_router_thread.h"
+#include "protocol/proxy_protocol.h"
+#include "socket_operations.h"
+
+/**
+ * @brief ProxyHeaderReceiver reads the PROXY headers of accepted clients in
+ *        a thread of its own.
+ *
+ * The acceptors push the sockets of the clients and go on accepting. The
+ * thread polls all sockets waiting for their header and reads the bytes as
+ * they arrive, so a client which is slow or silent only delays itself.
+ * Once the header is complete the socket is passed to the handler with the
+ * address of the client it carries, the peer address for LOCAL headers.
+ * Sockets with an invalid header, closed or still incomplete at their
+ * deadline are closed.
+ *
+ * Pushing wakes the thread through a pipe. On Windows WSAPoll() doesn't take
+ * pipes, the thread picks new sockets up after kPollInterval there.
+ */
+class ProxyHeaderReceiver {
+ public:
+  using clock_type = std::chrono::steady_clock;
+
+  /**
+   * @brief called in the thread of the receiver for each complete header
+   *
+   * Takes over the socket, which is blocking and has the traffic following
+   * the header left to read.
+   */
+  using Handler = std::function<void(int sock, const sockaddr_storage &client_addr)>;
+
+  /** @brief sockets which may wait for their header, further ones get closed */
+  static constexpr size_t kMaxPending = 1024;
+
+  /** @brief longest wait of the thread, for stopping and, on Windows, for new sockets */
+  static constexpr std::chrono::milliseconds kPollInterval{100};
+
+  /**
+   * @param sock_ops socket operations
+   * @param timeout time the header of a client has to arrive in
+   * @param handler called with the sockets whose header is complete
+   *
+   * @throws std::runtime_error if the wakeup pipe can't be created
+   */
+  ProxyHeaderReceiver(mysql_harness::SocketOperationsBase *sock_ops,
+                      std::chrono::milliseconds timeout, Handler handler);
+
+  /** @brief stops the thread and closes the sockets still waiting */
+  ~ProxyHeaderReceiver();
+
+  ProxyHeaderReceiver(const ProxyHeaderReceiver&) = delete;
+  ProxyHeaderReceiver& operator=(const ProxyHeaderReceiver&) = delete;
+
+  /**
+   * @brief Starts the thread reading the headers.
+   *
+   * @param name name of the route, for the name of the thread and the logs
+   * @param thread_stack_size stack size of the thread, in kilobytes
+   */
+  void start(const std::string &name, size_t thread_stack_size);
+
+  /**
+   * @brief Stops the thread and closes the sockets still waiting.
+   *
+   * The handler isn't called anymore once it returns.
+   */
+  void stop();
+
+  /**
+   * @brief Hands an accepted socket over to read its header, never blocks.
+   *
+   * @return false if kMaxPending sockets wait already, the socket is left
+   *         to the caller
+   */
+  bool push(int sock, const sockaddr_storage &peer_addr,
+            clock_type::time_point now = clock_type::now());
+
+  /** @brief sockets waiting for their header */
+  size_t size() const noexcept { return size_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Pending {
+    int sock;
+    sockaddr_storage peer_addr;
+    clock_type::time_point deadline;
+    // large, kept out of the vector
+    std::unique_ptr<proxy_protocol::HeaderReader> reader;
+  };
+
+  static void* run_thread(void *context);
+  void run();
+
+  /** @brief closes a socket whose header didn't arrive, errno tells why */
+  void close_pending(const Pending &pending, int last_errno);
+
+  mysql_harness::SocketOperationsBase *sock_ops_;
+  const std::chrono::milliseconds timeout_;
+  const Handler handler_;
+  std::string name_;
+
+  std::mutex mtx_;
+  /** @brief pushed sockets the thread didn't take yet */
+  std::vector<Pending> incoming_;
+  bool stopping_{false};
+  /** @brief sockets pushed and not passed to the handler or closed yet */
+  std::atomic<size_t> size_{0};
+
+  int wakeup_fds_[2] = { -1, -1 };
+
+  std::unique_ptr<mysql_harness::MySQLRouterThread> thread_;
+};
+
+#endif  // ROUTING_PROXY_HEADER_RECEIVER_INCLUDED
@@ -0,0 +1,195 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "query_digest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+static constexpr uint8_t kComQuery = 0x03;
+
+namespace {
+
+bool is_word_char(uint8_t c) {
+  return std::isalnum(c) || c == '_' || c == '$' || c >= 0x80;
+}
+
+bool is_operator_char(uint8_t c) {
+  return c != '\0' && std::strchr("<>=!:|&+-*/%^~", c) != nullptr;
+}
+
+// no blank between the previous token and c
+bool joins_previous(char prev, char c) {
+  return prev == '(' || prev == '.' || prev == '@' ||
+         c == ')' || c == ',' || c == '.' || c == ';' || c == '(';
+}
+
+} // namespace
+
+void make_query_digest(const uint8_t *sql, size_t size, std::string &digest) {
+  const size_t kMaxLength = QueryDigestStats::kMaxDigestLength;
+  digest.clear();
+
+  auto append_token = [&digest](const uint8_t *token, size_t length, char first) {
+    if (!digest.empty() && !joins_previous(digest.back(), first)) digest.push_back(' ');
+    digest.append(reinterpret_cast<const char*>(token), length);
+  };
+  auto append_literal = [&digest, &append_token]() {
+    // lists of literals share the digest, whatever their length
+    const size_t n = digest.size();
+    if (n >= 2 && digest.compare(n - 2, 2, "?,") == 0) {
+      digest.pop_back();
+      return;
+    }
+    const uint8_t literal = '?';
+    append_token(&literal, 1, '?');
+  };
+
+  size_t pos = 0;
+  while (pos < size && digest.size() < kMaxLength) {
+    const uint8_t c = sql[pos];
+
+    if (std::isspace(c)) {
+      ++pos;
+    } else if (c == '/' && pos + 1 < size && sql[pos + 1] == '*' &&
+               !(pos + 2 < size && sql[pos + 2] == '!')) {
+      const uint8_t *end = static_cast<const uint8_t*>(std::memchr(sql + pos + 2, '/', size - pos - 2));
+      while (end && end[-1] != '*') {
+        end = static_cast<const uint8_t*>(std::memchr(end + 1, '/', static_cast<size_t>(sql + size - end - 1)));
+      }
+      pos = end ? static_cast<size_t>(end - sql) + 1 : size;
+    } else if (c == '#' || (c == '-' && pos + 2 < size && sql[pos + 1] == '-' && std::isspace(sql[pos + 2]))) {
+      while (pos < size && sql[pos] != '\n') ++pos;
+    } else if (c == '\'' || c == '"') {
+      ++pos;
+      while (pos < size) {
+        if (sql[pos] == '\\') {
+          pos += 2;
+        } else if (sql[pos] == c) {
+          // a doubled quote is part of the string
+          if (pos + 1 < size && sql[pos + 1] == c) {
+            pos += 2;
+          } else {
+            break;
+          }
+        } else {
+          ++pos;
+        }
+      }
+      pos = std::min(pos + 1, size);
+      // x'..', b'..' and N'..' are literals as a whole
+      const size_t n = digest.size();
+      if (n >= 1 && std::strchr("XBN", digest[n - 1]) && (n == 1 || !is_word_char(static_cast<uint8_t>(digest[n - 2])))) {
+        digest.pop_back();
+        if (!digest.empty() && digest.back() == ' ') digest.pop_back();
+      }
+      append_literal();
+    } else if (c == '`') {
+      const uint8_t *end = static_cast<const uint8_t*>(std::memchr(sql + pos + 1, '`', size - pos - 1));
+      const size_t length = end ? static_cast<size_t>(end - sql) + 1 - pos : size - pos;
+      append_token(sql + pos, length, '`');
+      pos += length;
+    } else if (std::isdigit(c)) {
+      // integers, decimals, hex and exponents
+      while (pos < size && (is_word_char(sql[pos]) || sql[pos] == '.')) ++pos;
+      append_literal();
+    } else if (is_word_char(c)) {
+      const size_t start = pos;
+      while (pos < size && is_word_char(sql[pos])) ++pos;
+      append_token(sql + start, pos - start, static_cast<char>(c));
+      for (size_t i = digest.size() - (pos - start); i < digest.size(); ++i) {
+        digest[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(digest[i])));
+      }
+    } else if (is_operator_char(c)) {
+      const size_t start = pos;
+      while (pos < size && is_operator_char(sql[pos])) ++pos;
+      append_token(sql + start, pos - start, static_cast<char>(c));
+    } else {
+      append_token(sql + pos, 1, static_cast<char>(c));
+      ++pos;
+    }
+  }
+
+  if (digest.size() > kMaxLength) digest.resize(kMaxLength);
+}
+
+QueryDigestSampler::QueryDigestSampler(std::shared_ptr<QueryDigestStats> stats, uint64_t interval,
+                                       bool deprecate_eof)
+    : stats_(stats),
+      interval_(interval),
+      deprecate_eof_(deprecate_eof),
+      tracker_(deprecate_eof) {
+  // connections start at different points of the interval, short ones get sampled too
+  static std::atomic<uint64_t> connections{0};
+  statements_left_ = connections.fetch_add(1, std::memory_order_relaxed) % interval_ + 1;
+}
+
+void QueryDigestSampler::client_data(const uint8_t *data, size_t size) noexcept {
+  ClassicPacketFramer::Frame frame;
+  while (client_framer_.next(data, size, frame)) {
+    if (!frame.starts_message || !frame.is_first() || frame.sequence_id != 0 || frame.length == 0) continue;
+
+    // pipelined commands make the response unknown
+    if (sampling_) {
+      sampling_ = false;
+      continue;
+    }
+
+    if (frame.payload[0] != kComQuery || --statements_left_ > 0) continue;
+    statements_left_ = interval_;
+
+    // only statements that were read at once are sampled
+    if (frame.is_complete() && !frame.is_continued()) start_sample(frame.payload + 1, frame.length - 1);
+  }
+}
+
+void QueryDigestSampler::start_sample(const uint8_t *sql, size_t size) noexcept {
+  try {
+    make_query_digest(sql, size, digest_);
+  } catch (const std::bad_alloc &) {
+    return;
+  }
+
+  tracker_ = ClassicResponseTracker(deprecate_eof_);
+  tracker_.command_sent(kComQuery);
+  bytes_ = 0;
+  start_ = std::chrono::steady_clock::now();
+  sampling_ = true;
+}
+
+void QueryDigestSampler::server_data(const uint8_t *data, size_t size) noexcept {
+  if (!sampling_) return;
+
+  bytes_ += size;
+  tracker_.feed(data, size);
+  if (tracker_.is_lost()) {
+    sampling_ = false;
+  } else if (tracker_.is_idle()) {
+    sampling_ = false;
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_);
+    stats_->add(digest_, static_cast<uint64_t>(latency.count()), tracker_.get_rows(), bytes_);
+  }
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_QUERY_DIGEST_INCLUDED
+#define ROUTING_QUERY_DIGEST_INCLUDED
+
+#include "mysqlrouter/query_digest_stats.h"
+#include "protocol/classic_framer.h"
+#include "protocol/classic_response_tracker.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/** @class QueryDigestSampler
+ *
+ * Samples the COM_QUERY statements of a classic protocol connection.
+ *
+ * Every interval-th statement is normalized into its digest and its
+ * response followed until it is complete, which gives its latency, rows
+ * and size. Traffic between samples only goes through the packet framer
+ * of the client: nothing is copied or allocated then.
+ */
+class QueryDigestSampler {
+ public:
+  /**
+   * @param stats statistics the samples are added to
+   * @param interval statements of the connection per sample
+   * @param deprecate_eof true if the client set CLIENT_DEPRECATE_EOF
+   */
+  QueryDigestSampler(std::shared_ptr<QueryDigestStats> stats, uint64_t interval,
+                     bool deprecate_eof);
+
+  /** @brief follows bytes the client sent to the server */
+  void client_data(const uint8_t *data, size_t size) noexcept;
+
+  /** @brief follows bytes the server sent to the client */
+  void server_data(const uint8_t *data, size_t size) noexcept;
+
+  /** @brief true while the response to a sampled statement is followed */
+  bool is_sampling() const noexcept { return sampling_; }
+
+ private:
+  /** @brief starts following the response to the statement */
+  void start_sample(const uint8_t *sql, size_t size) noexcept;
+
+  std::shared_ptr<QueryDigestStats> stats_;
+  const uint64_t interval_;
+  const bool deprecate_eof_;
+  uint64_t statements_left_;
+
+  ClassicPacketFramer client_framer_;
+  ClassicResponseTracker tracker_;
+  bool sampling_{false};
+  std::string digest_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t bytes_{0};
+};
+
+#endif // ROUTING_QUERY_DIGEST_INCLUDED
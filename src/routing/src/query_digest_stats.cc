@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysqlrouter/query_digest_stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+constexpr size_t QueryDigestStats::kLatencyBuckets;
+constexpr size_t QueryDigestStats::kMaxDigestLength;
+
+struct QueryDigestStats::Entry {
+  /** @brief hash of the digest, 0 while the entry is free */
+  std::atomic<uint64_t> hash{0};
+  /** @brief true once digest is written */
+  std::atomic<bool> ready{false};
+  char digest[kMaxDigestLength];
+  size_t digest_length{0};
+
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> latency_sum_us{0};
+  std::atomic<uint64_t> latency_max_us{0};
+  std::atomic<uint64_t> rows{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> latency_histogram[kLatencyBuckets];
+
+  Entry() {
+    for (auto &bucket: latency_histogram) bucket.store(0, std::memory_order_relaxed);
+  }
+};
+
+QueryDigestStats::QueryDigestStats(size_t max_digests)
+    : max_digests_(max_digests), entries_(new Entry[max_digests]) {}
+
+QueryDigestStats::~QueryDigestStats() = default;
+
+QueryDigestStats::Entry *QueryDigestStats::find_or_claim(const std::string &digest) noexcept {
+  if (max_digests_ == 0) return nullptr;
+
+  const size_t length = std::min(digest.size(), kMaxDigestLength);
+  // 0 marks free entries
+  const uint64_t hash = static_cast<uint64_t>(std::hash<std::string>()(digest)) | 1;
+
+  // open addressing, linear probing
+  for (size_t i = 0; i < max_digests_; ++i) {
+    Entry &entry = entries_[(hash + i) % max_digests_];
+    uint64_t entry_hash = entry.hash.load(std::memory_order_acquire);
+
+    if (entry_hash == 0) {
+      if (entry.hash.compare_exchange_strong(entry_hash, hash, std::memory_order_acq_rel)) {
+        std::memcpy(entry.digest, digest.data(), length);
+        entry.digest_length = length;
+        entry.ready.store(true, std::memory_order_release);
+        return &entry;
+      }
+      // claimed by someone else meanwhile, entry_hash is theirs
+    }
+
+    if (entry_hash != hash) continue;
+
+    // the claiming thread only has the digest to copy
+    while (!entry.ready.load(std::memory_order_acquire)) std::this_thread::yield();
+    if (entry.digest_length == length && std::memcmp(entry.digest, digest.data(), length) == 0) {
+      return &entry;
+    }
+  }
+
+  return nullptr;
+}
+
+void QueryDigestStats::add(const std::string &digest, uint64_t latency_us, uint64_t rows,
+                           uint64_t bytes) noexcept {
+  Entry *entry = find_or_claim(digest);
+  if (!entry) {
+    lost_samples_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  entry->count.fetch_add(1, std::memory_order_relaxed);
+  entry->latency_sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+  entry->rows.fetch_add(rows, std::memory_order_relaxed);
+  entry->bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+  uint64_t max = entry->latency_max_us.load(std::memory_order_relaxed);
+  while (latency_us > max &&
+         !entry->latency_max_us.compare_exchange_weak(max, latency_us, std::memory_order_relaxed)) {
+  }
+
+  size_t bucket = 0;
+  while (bucket + 1 < kLatencyBuckets && latency_us >= (uint64_t{1} << bucket)) ++bucket;
+  entry->latency_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<QueryDigestStats::Digest> QueryDigestStats::get_snapshot() const {
+  std::vector<Digest> result;
+
+  for (size_t i = 0; i < max_digests_; ++i) {
+    const Entry &entry = entries_[i];
+    if (!entry.ready.load(std::memory_order_acquire)) continue;
+
+    Digest digest;
+    digest.digest.assign(entry.digest, entry.digest_length);
+    digest.count = entry.count.load(std::memory_order_relaxed);
+    digest.latency_sum_us = entry.latency_sum_us.load(std::memory_order_relaxed);
+    digest.latency_max_us = entry.latency_max_us.load(std::memory_order_relaxed);
+    digest.rows = entry.rows.load(std::memory_order_relaxed);
+    digest.bytes = entry.bytes.load(std::memory_order_relaxed);
+    for (size_t b = 0; b < kLatencyBuckets; ++b) {
+      digest.latency_histogram[b] = entry.latency_histogram[b].load(std::memory_order_relaxed);
+    }
+    result.push_back(digest);
+  }
+
+  return result;
+}
+
+QueryDigestComponent &QueryDigestComponent::getInstance() {
+  static QueryDigestComponent instance;
+
+  return instance;
+}
+
+void QueryDigestComponent::register_route(const std::string &name, std::shared_ptr<QueryDigestStats> stats) {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+  routes_[name] = stats;
+}
+
+void QueryDigestComponent::unregister_route(const std::string &name) {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+  routes_.erase(name);
+}
+
+std::map<std::string, std::shared_ptr<QueryDigestStats>> QueryDigestComponent::get_routes() {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+
+  return routes_;
+}
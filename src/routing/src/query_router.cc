@@ -0,0 +1,113 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "query_router.h"
+
+#include <cctype>
+#include <stdexcept>
+
+#include "destination.h"
+
+namespace {
+
+bool is_name_char(uint8_t c) {
+  return std::isalnum(c) || c == '_' || c == '-';
+}
+
+void skip_spaces(const uint8_t* sql, size_t size, size_t& pos) {
+  while (pos < size && std::isspace(sql[pos])) ++pos;
+}
+
+// case-insensitive, keyword is lower-case
+bool skip_keyword(const uint8_t* sql, size_t size, size_t& pos, const char* keyword) {
+  size_t end = pos;
+  for (; *keyword != '\0'; ++keyword, ++end) {
+    if (end >= size || std::tolower(sql[end]) != *keyword) return false;
+  }
+  pos = end;
+  return true;
+}
+
+bool skip_char(const uint8_t* sql, size_t size, size_t& pos, char c) {
+  if (pos >= size || sql[pos] != static_cast<uint8_t>(c)) return false;
+  ++pos;
+  return true;
+}
+
+} // namespace
+
+void QueryRouter::add_pool(const std::string& name, std::shared_ptr<RouteDestination> pool) {
+  if (name.empty()) {
+    throw std::invalid_argument("query_route_map needs pool names, was empty");
+  }
+  for (const char c : name) {
+    if (!is_name_char(static_cast<uint8_t>(c))) {
+      throw std::invalid_argument("query_route_map pool names are made of letters, digits, '_' and '-', was '" +
+                                  name + "'");
+    }
+  }
+  if (!pools_.emplace(name, std::move(pool)).second) {
+    throw std::invalid_argument("query_route_map has more than one entry for '" + name + "'");
+  }
+}
+
+bool QueryRouter::read_pool_name(const uint8_t* sql, size_t size, std::string& name) {
+  size_t pos = 0;
+  skip_spaces(sql, size, pos);
+  if (!skip_char(sql, size, pos, '/') || !skip_char(sql, size, pos, '*')) return false;
+
+  // a hint names the pool like a function, a comment like an option
+  const bool hint = skip_char(sql, size, pos, '+');
+  skip_spaces(sql, size, pos);
+  if (!skip_keyword(sql, size, pos, "route")) return false;
+  skip_spaces(sql, size, pos);
+  if (!skip_char(sql, size, pos, hint ? '(' : '=')) return false;
+  skip_spaces(sql, size, pos);
+
+  const size_t begin = pos;
+  while (pos < size && is_name_char(sql[pos])) ++pos;
+  const size_t end = pos;
+  if (begin == end) return false;
+
+  skip_spaces(sql, size, pos);
+  if (hint) {
+    if (!skip_char(sql, size, pos, ')')) return false;
+    skip_spaces(sql, size, pos);
+  }
+  if (!skip_char(sql, size, pos, '*') || !skip_char(sql, size, pos, '/')) return false;
+
+  name.assign(reinterpret_cast<const char*>(sql) + begin, end - begin);
+  return true;
+}
+
+RouteDestination* QueryRouter::get_pool(const uint8_t* sql, size_t size) const {
+  std::string name;
+  if (!read_pool_name(sql, size, name)) return nullptr;
+
+  auto it = pools_.find(name);
+  if (it == pools_.end()) return nullptr;
+
+  return it->second.get();
+}
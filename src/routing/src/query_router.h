@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_QUERY_ROUTER_INCLUDED
+#define ROUTING_QUERY_ROUTER_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+class RouteDestination;
+
+/**
+ * @brief QueryRouter picks a pool of destinations for a statement by its leading comment.
+ *
+ * Statements starting with a comment naming a pool, `route=<name>` in a
+ * plain comment or `route(<name>)` in an optimizer hint comment,
+ * are run by a server of that pool instead of the servers of the route.
+ * Statements not starting with a comment are told apart by their first two
+ * bytes, the rest of the traffic doesn't pay for the matching.
+ */
+class QueryRouter {
+public:
+  /**
+   * @brief Routes the statements naming the pool to it.
+   *
+   * Pools have to be added before the route gets started.
+   *
+   * @throws std::invalid_argument if the name is not made of letters,
+   *         digits, '_' and '-' or got a pool already
+   */
+  void add_pool(const std::string& name, std::shared_ptr<RouteDestination> pool);
+
+  /** @brief Returns the pools by name */
+  const std::map<std::string, std::shared_ptr<RouteDestination>>& get_pools() const noexcept {
+    return pools_;
+  }
+
+  /**
+   * @brief Returns the pool the leading comment of the statement names.
+   *
+   * @param sql text of the statement, after the command byte
+   * @param size number of bytes at sql
+   *
+   * @return nullptr if the statement doesn't start with a comment naming a pool
+   */
+  RouteDestination* get_pool(const uint8_t* sql, size_t size) const;
+
+  /**
+   * @brief Reads the pool name of the leading comment of a statement.
+   *
+   * @return false if the statement doesn't start with a routing comment
+   */
+  static bool read_pool_name(const uint8_t* sql, size_t size, std::string& name);
+
+private:
+  /** @brief not changed once the route runs, read without lock */
+  std::map<std::string, std::shared_ptr<RouteDestination>> pools_;
+};
+
+#endif  // ROUTING_QUERY_ROUTER_INCLUDED
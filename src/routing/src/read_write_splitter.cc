@@ -0,0 +1,449 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "read_write_splitter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "keyring/keyring_manager.h"
+#include "mysqlrouter/mysql_protocol.h"
+#include "query_router.h"
+#include "socket_operations.h"
+
+namespace Capabilities = mysql_protocol::Capabilities;
+
+static constexpr uint8_t kComInitDb = 0x02;
+static constexpr uint8_t kComQuery = 0x03;
+static constexpr uint8_t kComPing = 0x0e;
+static constexpr uint8_t kComStmtPrepare = 0x16;
+static constexpr uint8_t kComStmtExecute = 0x17;
+static constexpr uint8_t kComStmtSendLongData = 0x18;
+static constexpr uint8_t kComStmtClose = 0x19;
+static constexpr uint8_t kComStmtReset = 0x1a;
+static constexpr uint8_t kComStmtFetch = 0x1c;
+static constexpr uint8_t kComResetConnection = 0x1f;
+static constexpr uint8_t kOkHeader = 0x00;
+static const char *kKeyringAttributePassword = "password";
+static const char *kNativePasswordPlugin = "mysql_native_password";
+
+namespace {
+
+// upper-cased statement with whitespace turned into blanks
+std::string normalize(const uint8_t *sql, size_t size) {
+  std::string result(reinterpret_cast<const char*>(sql), size);
+  for (auto &c: result) {
+    c = std::isspace(static_cast<unsigned char>(c)) ? ' '
+                                                    : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+  return result;
+}
+
+// first keyword of the statement, empty if it starts with something else
+// like an executable comment
+std::string first_keyword(const std::string &sql) {
+  size_t pos = 0;
+  while (pos < sql.size()) {
+    if (sql[pos] == ' ' || sql[pos] == '(') {
+      ++pos;
+    } else if (sql.compare(pos, 2, "/*") == 0 && sql.compare(pos, 3, "/*!") != 0) {
+      const size_t end = sql.find("*/", pos + 2);
+      if (end == std::string::npos) return "";
+      pos = end + 2;
+    } else if (sql.compare(pos, 3, "-- ") == 0 || sql[pos] == '#') {
+      // the line break became a blank too, comment reaches the end
+      return "";
+    } else {
+      break;
+    }
+  }
+
+  size_t end = pos;
+  while (end < sql.size() && std::isalpha(static_cast<unsigned char>(sql[end]))) ++end;
+  return sql.substr(pos, end - pos);
+}
+
+bool is_statement_command(uint8_t cmd) {
+  return (cmd >= kComStmtPrepare && cmd <= kComStmtReset) || cmd == kComStmtFetch;
+}
+
+bool contains_any(const std::string &sql, std::initializer_list<const char*> needles) {
+  for (const char *needle: needles) {
+    if (sql.find(needle) != std::string::npos) return true;
+  }
+  return false;
+}
+
+// true if the statement refers to a user variable, @@ are system variables
+bool has_user_variables(const std::string &sql) {
+  for (size_t pos = sql.find('@'); pos != std::string::npos; pos = sql.find('@', pos)) {
+    if (pos + 1 >= sql.size() || sql[pos + 1] != '@') return true;
+    pos += 2;
+  }
+  return false;
+}
+
+// numbers are written as they are, system variables don't take them as strings
+bool is_number(const std::string &value) {
+  size_t pos = value.compare(0, 1, "-") == 0 ? 1 : 0;
+  const size_t digits = pos;
+  while (pos < value.size() && std::isdigit(static_cast<unsigned char>(value[pos]))) ++pos;
+  if (pos == digits) return false;
+  if (pos < value.size() && value[pos] == '.') {
+    const size_t fraction = ++pos;
+    while (pos < value.size() && std::isdigit(static_cast<unsigned char>(value[pos]))) ++pos;
+    if (pos == fraction) return false;
+  }
+  return pos == value.size();
+}
+
+} // namespace
+
+bool ReadWriteSplitter::set_client_handshake(const RoutingProtocolBuffer &packet) {
+  if (!classic_handshake::parse_handshake_response(packet, handshake_)) return false;
+
+  // the router has to see the traffic and forward it unchanged
+  if (handshake_.capabilities.test(Capabilities::SSL) ||
+      handshake_.capabilities.test(Capabilities::COMPRESS) ||
+      !handshake_.capabilities.test(Capabilities::PLUGIN_AUTH | Capabilities::SECURE_CONNECTION)) {
+    return false;
+  }
+
+  mysql_harness::Keyring *keyring = mysql_harness::get_keyring();
+  if (!keyring) return false;
+  try {
+    password_ = keyring->fetch(handshake_.username, kKeyringAttributePassword);
+  } catch (const std::out_of_range &) {
+    return false;
+  }
+
+  handshake_packet_ = packet;
+  const bool deprecate_eof = handshake_.capabilities.test(Capabilities::DEPRECATE_EOF);
+  primary_ = ClassicResponseTracker(deprecate_eof);
+  secondary_ = ClassicResponseTracker(deprecate_eof);
+  if (read_your_writes_ && handshake_.capabilities.test(Capabilities::SESSION_TRACK)) {
+    primary_.track_gtids();
+  }
+  if (replays_session_ && handshake_.capabilities.test(Capabilities::SESSION_TRACK)) {
+    primary_.track_session_state();
+  }
+
+  return true;
+}
+
+bool ReadWriteSplitter::can_read_elsewhere() const noexcept {
+  return primary_.is_idle() && !primary_.in_transaction() && secondary_.is_idle();
+}
+
+bool ReadWriteSplitter::can_use_secondary() const noexcept {
+  return !secondary_failed_ && can_read_elsewhere();
+}
+
+bool ReadWriteSplitter::can_release_primary() const noexcept {
+  return !pinned_ && releasable_ && !handshake_packet_.empty() &&
+         client_framer_.at_message_boundary() && primary_.is_idle() &&
+         !primary_.in_transaction() && secondary_.is_idle();
+}
+
+bool ReadWriteSplitter::is_between_transactions() const noexcept {
+  return client_framer_.at_message_boundary() && primary_.is_idle() &&
+         !primary_.in_transaction() && secondary_.is_idle();
+}
+
+std::string ReadWriteSplitter::get_session_key() const {
+  if (handshake_packet_.empty()) return "";
+
+  return handshake_.username + '\0' + handshake_.database + '\0' +
+         std::to_string(handshake_.char_set) + '\0' +
+         std::to_string(handshake_.capabilities.bits());
+}
+
+ReadWriteSplitter::Target ReadWriteSplitter::route(const uint8_t *data, size_t size,
+                                                  const std::string *statement) noexcept {
+  const bool new_command = client_framer_.at_message_boundary();
+
+  ClassicPacketFramer::Frame frame;
+  ClassicPacketFramer::Frame command;
+  size_t commands = 0;
+  while (client_framer_.next(data, size, frame)) {
+    if (frame.starts_message && frame.is_first() && commands++ == 0) command = frame;
+  }
+
+  // rest of a command, which never went to a secondary
+  if (!new_command && commands == 0) return Target::kPrimary;
+
+  // pipelined commands, or not even the command byte was read
+  if (!new_command || commands != 1 || command.length == 0 || command.sequence_id != 0) {
+    pinned_ = true;
+    primary_.lose();
+    return Target::kPrimary;
+  }
+
+  const uint8_t cmd = command.payload[0];
+  if (statement && is_statement_command(cmd)) {
+    route_statement(cmd, command, *statement);
+    return Target::kPrimary;
+  }
+
+  const uint8_t *sql = command.payload + 1;
+  const size_t sql_size = command.length - 1;
+  if (pinned_) {
+    // followed for the transaction state, the statements of the client and the replay of the session
+    primary_.command_sent(cmd);
+    follow_session_change(cmd, sql, sql_size);
+    return Target::kPrimary;
+  }
+
+  const bool complete = command.is_complete() && client_framer_.at_message_boundary();
+
+  // no cost for statements not starting with a comment
+  if (cmd == kComQuery && complete && query_router_ && can_read_elsewhere() &&
+      (pool_ = query_router_->get_pool(sql, sql_size)) != nullptr &&
+      is_read_only_query(sql, sql_size)) {
+    secondary_.command_sent(cmd);
+    return Target::kPool;
+  }
+
+  if (cmd == kComQuery && complete && can_use_secondary() && is_read_only_query(sql, sql_size)) {
+    secondary_.command_sent(cmd);
+    return Target::kSecondary;
+  }
+
+  if (!primary_.command_sent(cmd) || cmd == kComResetConnection || cmd == kComInitDb ||
+      (cmd == kComQuery && changes_session(sql, sql_size))) {
+    pinned_ = true;
+  }
+  follow_session_change(cmd, sql, sql_size);
+  // LAST_INSERT_ID(), ROW_COUNT() and warnings of writes stay with the session
+  releasable_ = cmd == kComPing ||
+                (cmd == kComQuery && complete && is_read_only_query(sql, sql_size));
+  if (!releasable_) may_write();
+
+  return Target::kPrimary;
+}
+
+void ReadWriteSplitter::follow_session_change(uint8_t cmd, const uint8_t *sql, size_t size) noexcept {
+  if (!replays_session_) return;
+
+  if (cmd == kComInitDb) {
+    replay_pending_ = true;
+  } else if (cmd == kComResetConnection) {
+    replayable_ = false;
+  } else if (cmd == kComQuery && changes_session(sql, size)) {
+    const std::string statement = normalize(sql, size);
+    const std::string keyword = first_keyword(statement);
+    // whether SET changed what the primary reports is told by its response
+    if ((keyword == "SET" || keyword == "USE") && !has_user_variables(statement) &&
+        !contains_any(statement, {"TEMPORARY", "GET_LOCK"})) {
+      replay_pending_ = true;
+    } else {
+      replayable_ = false;
+    }
+  }
+}
+
+void ReadWriteSplitter::route_statement(uint8_t cmd, const ClassicPacketFramer::Frame &command,
+                                        const std::string &statement) noexcept {
+  switch (cmd) {
+    case kComStmtPrepare:
+      // answered by the router
+      break;
+    case kComStmtExecute:
+      // cursors keep the statement busy beyond the response
+      if (command.length < 6 || command.payload[5] != 0) {
+        pinned_ = true;
+        primary_.lose();
+        break;
+      }
+      if (!primary_.command_sent(cmd)) pinned_ = true;
+      releasable_ = is_read_only_query(reinterpret_cast<const uint8_t*>(statement.data()),
+                                       statement.size());
+      if (!releasable_) may_write();
+      break;
+    case kComStmtReset:
+      if (!primary_.command_sent(cmd)) pinned_ = true;
+      break;
+    case kComStmtSendLongData:
+      // the data stays with the statement until it is executed
+      releasable_ = false;
+      break;
+    case kComStmtClose:
+      break;
+    default:
+      // COM_STMT_FETCH reads from a cursor
+      pinned_ = true;
+      primary_.lose();
+      break;
+  }
+}
+
+void ReadWriteSplitter::secondary_unavailable() noexcept {
+  secondary_failed_ = true;
+  secondary_behind();
+}
+
+void ReadWriteSplitter::secondary_behind() noexcept {
+  secondary_ = ClassicResponseTracker(handshake_.capabilities.test(Capabilities::DEPRECATE_EOF));
+  if (!primary_.command_sent(kComQuery)) pinned_ = true;
+  releasable_ = true;
+}
+
+void ReadWriteSplitter::may_write() noexcept {
+  if (!read_your_writes_) return;
+
+  written_ = true;
+  // the writes can't be told apart from the reads on the secondaries
+  if (!primary_.tracks_gtids()) secondary_failed_ = true;
+}
+
+void ReadWriteSplitter::primary_data(const uint8_t *data, size_t size) noexcept {
+  // pinned sessions are followed too, is_between_transactions() relies on it
+  primary_.feed(data, size);
+  if (primary_.is_lost() || primary_.session_state_changed()) pinned_ = true;
+  if (replay_pending_ && primary_.is_idle()) {
+    if (!primary_.session_state_reported()) replayable_ = false;
+    replay_pending_ = false;
+  }
+}
+
+bool ReadWriteSplitter::can_replay_session() const noexcept {
+  return replays_session_ && replayable_ && !replay_pending_ && !handshake_packet_.empty() &&
+         !primary_.is_lost() && !primary_.session_state_unknown();
+}
+
+bool ReadWriteSplitter::get_replay_statements(std::vector<std::string> &statements) const {
+  statements.clear();
+
+  const std::string &schema = primary_.get_schema();
+  if (!schema.empty() && schema != handshake_.database) {
+    std::string quoted;
+    for (const char c : schema) {
+      quoted += c;
+      if (c == '`') quoted += c;
+    }
+    statements.push_back("USE `" + quoted + "`");
+  }
+
+  for (const auto &variable : primary_.get_system_variables()) {
+    const std::string &name = variable.first;
+    const std::string &value = variable.second;
+    for (const char c : name) {
+      if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+    }
+    // the sql_mode of the new session decides if backslashes escape
+    if (value.find('\\') != std::string::npos) return false;
+
+    std::string statement = "SET @@SESSION." + name + " = ";
+    if (is_number(value)) {
+      statement += value;
+    } else {
+      statement += '\'';
+      for (const char c : value) {
+        statement += c;
+        if (c == '\'') statement += c;
+      }
+      statement += '\'';
+    }
+    statements.push_back(statement);
+  }
+
+  return true;
+}
+
+bool ReadWriteSplitter::authenticate(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                                     std::chrono::milliseconds timeout,
+                                     std::vector<uint8_t> *scramble) {
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  RoutingProtocolBuffer packet;
+  classic_handshake::ServerGreeting greeting;
+
+  if (handshake_packet_.empty() ||
+      !classic_handshake::read_packet(sock_ops, sock, packet, timeout) ||
+      !classic_handshake::parse_server_greeting(packet, greeting, false)) {
+    return false;
+  }
+
+  RoutingProtocolBuffer response;
+  try {
+    response = classic_handshake::make_handshake_response(
+        handshake_packet_, handshake_,
+        classic_handshake::make_native_password_token(password_, greeting.scramble));
+  } catch (const mysql_protocol::packet_error &) {
+    return false;
+  }
+  if (sock_ops->write_all(sock, &response[0], response.size()) < 0 ||
+      !classic_handshake::read_packet(sock_ops, sock, packet, timeout)) {
+    return false;
+  }
+
+  std::string auth_plugin;
+  std::vector<uint8_t> switch_scramble;
+  if (classic_handshake::parse_auth_switch_request(packet, auth_plugin, switch_scramble)) {
+    if (auth_plugin != kNativePasswordPlugin) return false;
+
+    const std::vector<uint8_t> token = classic_handshake::make_native_password_token(password_, switch_scramble);
+    RoutingProtocolBuffer auth_response{static_cast<uint8_t>(token.size()), 0, 0,
+                                        static_cast<uint8_t>(packet[3] + 1)};
+    auth_response.insert(auth_response.end(), token.begin(), token.end());
+    if (sock_ops->write_all(sock, &auth_response[0], auth_response.size()) < 0 ||
+        !classic_handshake::read_packet(sock_ops, sock, packet, timeout)) {
+      return false;
+    }
+    greeting.scramble = switch_scramble;
+  }
+
+  if (scramble) *scramble = greeting.scramble;
+
+  return packet.size() > kHeaderSize && packet[kHeaderSize] == kOkHeader;
+}
+
+bool ReadWriteSplitter::is_read_only_query(const uint8_t *sql, size_t size) {
+  const std::string statement = normalize(sql, size);
+  if (first_keyword(statement) != "SELECT") return false;
+
+  // multi-statements
+  const size_t semicolon = statement.find(';');
+  if (semicolon != std::string::npos &&
+      statement.find_first_not_of(" ;", semicolon) != std::string::npos) {
+    return false;
+  }
+
+  // locking reads, results stored in the session and functions reading
+  // the state of the session
+  return !contains_any(statement, {" FOR UPDATE", " FOR SHARE", " LOCK IN SHARE MODE", " INTO ",
+                                   "@", "GET_LOCK", "RELEASE_LOCK", "IS_USED_LOCK", "IS_FREE_LOCK",
+                                   "LAST_INSERT_ID", "FOUND_ROWS", "ROW_COUNT", "CONNECTION_ID"});
+}
+
+bool ReadWriteSplitter::changes_session(const uint8_t *sql, size_t size) {
+  const std::string statement = normalize(sql, size);
+  const std::string keyword = first_keyword(statement);
+
+  return keyword.empty() || keyword == "SET" || keyword == "USE" || keyword == "LOCK" ||
+         keyword == "PREPARE" || keyword == "EXECUTE" || keyword == "HANDLER" ||
+         keyword == "CALL" ||
+         contains_any(statement, {"@", "TEMPORARY", "GET_LOCK"});
+}
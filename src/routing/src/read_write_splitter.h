@@ -0,0 +1,339 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_READ_WRITE_SPLITTER_INCLUDED
+#define ROUTING_READ_WRITE_SPLITTER_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "protocol/base_protocol.h"
+#include "protocol/classic_framer.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/classic_response_tracker.h"
+
+namespace mysql_harness { class SocketOperationsBase; }
+class QueryRouter;
+class RouteDestination;
+
+/** @class ReadWriteSplitter
+ *
+ * Decides which server the commands of a classic protocol client go to
+ * when the route splits reads from writes.
+ *
+ * Statements are sent to the primary, except SELECTs run outside of a
+ * transaction which go to a secondary. The transaction state is taken
+ * from the status flags of the OK and EOF packets of the primary; until
+ * the primary sent one the session is assumed to be in a transaction.
+ *
+ * Once the session has state the secondary doesn't know about (user
+ * variables, SET, USE, temporary tables, locks, prepared statements, ...)
+ * or the responses of the primary can't be followed anymore, the session
+ * is pinned to the primary for good.
+ *
+ * The secondary session is authenticated by the router as the same user,
+ * with the password stored in the keyring and mysql_native_password.
+ *
+ * The same tracking tells when the primary session can be handed to
+ * another client with connection multiplexing: after a read-only
+ * statement or a ping outside of a transaction, as long as the session
+ * isn't pinned.
+ *
+ * With read-your-writes, reads after a write only go to a secondary that
+ * applied the GTIDs the primary reported for the session's transactions,
+ * which needs session_track_gtids=OWN_GTID on the primary and a client
+ * setting CLIENT_SESSION_TRACK. Without the capability the first command
+ * that may write keeps all further reads on the primary.
+ *
+ * When the router translates the ids of the client's prepared statements
+ * the responses of the primary are followed even after pinning, so the
+ * router knows when it can talk to the primary itself.
+ *
+ * With set_replays_session() the session can be moved to another primary
+ * between transactions, as long as its state is known: the default schema
+ * and the system variables the primary reported in the session state of
+ * its OK packets, which needs session_track_schema and
+ * session_track_system_variables on the primary and a client setting
+ * CLIENT_SESSION_TRACK. Anything else left in the session (user variables,
+ * temporary tables, locks, ...) or a SET the primary didn't report keeps
+ * the session where it is.
+
+ *
+ * With set_query_router() read-only statements outside of a transaction
+ * starting with a comment naming a pool go to a server of that pool as
+ * long as the session isn't pinned, even if the route doesn't split reads. They don't wait for the pool to apply
+ * the writes of the session.
+ */
+class ReadWriteSplitter {
+ public:
+  enum class Target {
+    kPrimary,
+    kSecondary,
+    /** @brief a server of get_pool() */
+    kPool,
+  };
+
+  /**
+   * @param split_reads false if all commands go to the primary and only
+   *        the session state is followed
+   */
+  explicit ReadWriteSplitter(bool split_reads = true) : secondary_failed_(!split_reads) {}
+
+  /** @brief the router translates the ids of prepared statements, see route() */
+  void set_translates_statements() noexcept { translates_statements_ = true; }
+
+  /** @brief reads after a write need a secondary that applied it, has to be set before the handshake */
+  void set_read_your_writes() noexcept { read_your_writes_ = true; }
+
+  /**
+   * @brief GTIDs of the session's writes a secondary has to apply before it gets reads.
+   *
+   * Empty unless read-your-writes is set. The connection checks them on the
+   * secondary before sending it a read, see gtids_applied() and
+   * secondary_behind().
+   */
+  const std::string& get_unapplied_gtids() const noexcept { return primary_.get_gtids(); }
+
+  /** @brief The secondary applied get_unapplied_gtids(). */
+  void gtids_applied() noexcept { primary_.clear_gtids(); }
+
+  /** @brief statements naming a pool in their leading comment go to it, see route() */
+  void set_query_router(const QueryRouter *query_router) noexcept { query_router_ = query_router; }
+
+  /** @brief pool of the last command routed to Target::kPool */
+  RouteDestination* get_pool() const noexcept { return pool_; }
+
+  /** @brief The command routed to the pool is sent to the primary instead. */
+  void pool_unavailable() noexcept { secondary_behind(); }
+
+  /** @brief the state of the session is followed to replay it on another server, has to be set before the handshake */
+  void set_replays_session() noexcept { replays_session_ = true; }
+
+  /**
+   * @brief true if the state of the session can be replayed on another server.
+   *
+   * Doesn't tell whether the session is between transactions, see
+   * is_between_transactions().
+   */
+  bool can_replay_session() const noexcept;
+
+  /**
+   * @brief Statements bringing a new server session into the state of the session.
+   *
+   * The new session has to be authenticated with authenticate(), which
+   * starts it with the schema of the handshake response.
+   *
+   * @param statements set to the statements to execute in order
+   *
+   * @return false if a value can't be written into a statement
+   */
+  bool get_replay_statements(std::vector<std::string> &statements) const;
+
+  /** @brief true if all commands of the client got their response */
+  bool is_idle() const noexcept {
+    return client_framer_.at_message_boundary() && primary_.is_idle() && secondary_.is_idle();
+  }
+
+  /**
+   * @brief true if the last status of the primary tells about a transaction.
+   *
+   * Autocommit being off counts as a transaction. False as long as the
+   * primary didn't answer a command.
+   */
+  bool is_in_transaction() const noexcept { return primary_.has_status() && primary_.in_transaction(); }
+
+  /** @brief true if the session wrote since it started, with read-your-writes */
+  bool has_written() const noexcept { return written_; }
+
+  /**
+   * @brief Takes the handshake response the client sent to the primary.
+   *
+   * @param packet handshake response including the header
+   *
+   * @return false if the session of the client can't be split, e.g. the
+   *         client uses SSL or its password is not in the keyring
+   */
+  bool set_client_handshake(const RoutingProtocolBuffer &packet);
+
+  /**
+   * @brief Routes bytes read from the client.
+   *
+   * Only a read that holds exactly one complete command can go to a
+   * secondary or a pool, everything else goes to the primary. The pool's
+   * responses are followed like the secondary's.
+   *
+   * Prepared statement commands pin the session, unless the router
+   * translates the statement ids and passes the text of the statement:
+   * a read-only statement executed outside of a transaction leaves the
+   * session releasable then.
+   *
+   * @param data bytes read from the client
+   * @param size number of bytes at data
+   * @param statement text of the prepared statement the command in data
+   *        refers to, nullptr if the command doesn't refer to one
+   */
+  Target route(const uint8_t *data, size_t size, const std::string *statement = nullptr) noexcept;
+
+  /** @brief The command routed to the secondary is sent to the primary instead.
+   *
+   * Further commands are not sent to a secondary anymore.
+   */
+  void secondary_unavailable() noexcept;
+
+  /** @brief The command routed to the secondary is sent to the primary instead.
+   *
+   * The secondary didn't apply the writes of the session yet, the next
+   * read can go to it again.
+   */
+  void secondary_behind() noexcept;
+
+  /** @brief Follows bytes the primary sent to the client */
+  void primary_data(const uint8_t *data, size_t size) noexcept;
+
+  /** @brief Follows bytes the secondary sent to the client */
+  void secondary_data(const uint8_t *data, size_t size) noexcept {
+    secondary_.feed(data, size);
+  }
+
+  /** @brief true if secondary answered its command */
+  bool is_secondary_idle() const noexcept { return secondary_.is_idle(); }
+
+  /** @brief true if primary answered all commands */
+  bool is_primary_idle() const noexcept { return primary_.is_idle(); }
+
+  /** @brief true if the responses of the primary can't be followed */
+  bool is_primary_lost() const noexcept { return primary_.is_lost(); }
+
+  /** @brief true if the client set CLIENT_DEPRECATE_EOF */
+  bool deprecates_eof() const noexcept {
+    return handshake_.capabilities.test(mysql_protocol::Capabilities::DEPRECATE_EOF);
+  }
+
+  /** @brief true if the response of the secondary can't be followed */
+  bool is_secondary_lost() const noexcept { return secondary_.is_lost(); }
+
+  /** @brief true if all commands go to the primary for the rest of the session */
+  bool is_pinned() const noexcept { return pinned_; }
+
+  /**
+   * @brief true if the primary session can be released between commands.
+   *
+   * The session has to be clean: not pinned, not in a transaction, the
+   * last command only read and all responses were forwarded.
+   */
+  bool can_release_primary() const noexcept;
+
+  /**
+   * @brief true if closing the connection doesn't cut off a transaction.
+   *
+   * All responses were forwarded and the primary session is not in a
+   * transaction, the session may still hold other state.
+   */
+  bool is_between_transactions() const noexcept;
+
+  /**
+   * @brief Identity of the session of the client.
+   *
+   * Sessions released by one client are only taken by clients of the same
+   * identity: user, default schema, character set and capabilities.
+   */
+  std::string get_session_key() const;
+
+  /**
+   * @brief Authenticates a new connection to a secondary.
+   *
+   * @param sock_ops socket operations
+   * @param sock socket connected to the secondary
+   * @param timeout max time to wait for each packet of the server
+   * @param scramble set to the scramble of the server greeting if not nullptr
+   *
+   * @return true if the server accepted the credentials of the client
+   */
+  bool authenticate(mysql_harness::SocketOperationsBase *sock_ops, int sock,
+                    std::chrono::milliseconds timeout,
+                    std::vector<uint8_t> *scramble = nullptr);
+
+  /** @brief true if statement only reads and can run on any member */
+  static bool is_read_only_query(const uint8_t *sql, size_t size);
+
+  /** @brief true if statement may leave state in the session */
+  static bool changes_session(const uint8_t *sql, size_t size);
+
+ private:
+  /** @brief true if the next read can go to another server than the primary */
+  bool can_read_elsewhere() const noexcept;
+
+  /** @brief true if the next read can go to a secondary */
+  bool can_use_secondary() const noexcept;
+
+  /** @brief a command that may write goes to the primary */
+  void may_write() noexcept;
+
+  /** @brief notes a command that may change state get_replay_statements() has to bring along */
+  void follow_session_change(uint8_t cmd, const uint8_t *sql, size_t size) noexcept;
+
+  /** @brief follows a command referring to a prepared statement */
+  void route_statement(uint8_t cmd, const ClassicPacketFramer::Frame &command,
+                       const std::string &statement) noexcept;
+
+  /** @brief packet boundaries of what the client sent so far */
+  ClassicPacketFramer client_framer_;
+  /** @brief responses of the primary */
+  ClassicResponseTracker primary_;
+  /** @brief responses of the secondary */
+  ClassicResponseTracker secondary_;
+  /** @brief true if all commands go to the primary */
+  bool pinned_{false};
+  /** @brief true if there is no secondary to send reads to */
+  bool secondary_failed_{false};
+  /** @brief true if the last command sent to the primary left nothing in the session */
+  bool releasable_{false};
+  /** @brief true if the primary is followed after pinning */
+  bool translates_statements_{false};
+  /** @brief picks a pool by the leading comment of a statement, nullptr if not routed by it */
+  const QueryRouter *query_router_{nullptr};
+  /** @brief pool of the last command routed to Target::kPool */
+  RouteDestination *pool_{nullptr};
+  /** @brief true if reads after a write need a secondary that applied it */
+  bool read_your_writes_{false};
+  /** @brief true once a command that may write went to the primary */
+  bool written_{false};
+  /** @brief true if the state of the session is followed to replay it */
+  bool replays_session_{false};
+  /** @brief false once the session got state that can't be replayed */
+  bool replayable_{true};
+  /** @brief true while the primary didn't answer a command changing the schema or system variables */
+  bool replay_pending_{false};
+
+  /** @brief handshake response the client sent to the primary */
+  RoutingProtocolBuffer handshake_packet_;
+  classic_handshake::ClientHandshake handshake_;
+  /** @brief password of the client, from the keyring */
+  std::string password_;
+};
+
+#endif // ROUTING_READ_WRITE_SPLITTER_INCLUDED
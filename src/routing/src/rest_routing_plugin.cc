@@ -0,0 +1,1339 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+
+// Harness interface include files
+#include "mysql/harness/config_parser.h"
+#include "mysql/harness/memory_accounting.h"
+#include "mysql/harness/plugin.h"
+#include "mysql/harness/readiness.h"
+#include "mysql/harness/sampling_profiler.h"
+#include "socket_operations.h"
+
+#include "mysqlrouter/connection_trace.h"
+#include "mysqlrouter/http_server_component.h"
+#include "mysqlrouter/metadata_cache.h"
+#include "mysqlrouter/query_digest_stats.h"
+#include "mysqlrouter/routing_control.h"
+#include "mysqlrouter/routing_metrics.h"
+
+static constexpr const char kRestQueryDigestsUri[] { "^/api/v1/routing/query_digests/$" };
+static constexpr const char kMetricsUri[] { "^/metrics$" };
+static constexpr const char kRestRouteConfigUri[] { "^/api/v1/routing/routes/[^/]+/config$" };
+static constexpr const char kRestRouteConnectionsUri[] { "^/api/v1/routing/routes/[^/?]+/connections(\\?.*)?$" };
+static constexpr const char kRestRouteDestinationsUri[] { "^/api/v1/routing/routes/[^/]+/destinations$" };
+static constexpr const char kRestConnectionTraceUri[] { "^/api/v1/routing/connection_trace/$" };
+static constexpr const char kRestRouterReadyUri[] { "^/api/v1/router/ready$" };
+static constexpr const char kRestRouterProfileUri[] { "^/api/v1/router/profile(\\?.*)?$" };
+static constexpr const char kRestRouterMemoryUri[] { "^/api/v1/router/memory$" };
+static constexpr const char kRestMetadataCacheTopologyUri[] { "^/api/v1/metadata_cache/topology(\\?.*)?$" };
+
+using mysql_harness::ARCHITECTURE_DESCRIPTOR;
+using mysql_harness::PluginFuncEnv;
+using mysql_harness::PLUGIN_ABI_VERSION;
+using mysql_harness::Plugin;
+
+class RestApiV1RoutingQueryDigests: public BaseRequestHandler {
+public:
+  // allow methods: GET
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!(HttpMethod::Get & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    auto out_hdrs = req.get_output_headers();
+    out_hdrs.add("Content-Type", "application/json");
+
+    // routes may sample many digests, stream them instead of building the
+    // whole document first
+    req.send_reply_start(HttpStatusCode::Ok, "Ok");
+    {
+      HttpChunkedStream out(req);
+      rapidjson::Writer<HttpChunkedStream> json_writer(out);
+
+      json_writer.StartObject();
+      json_writer.Key("routes");
+      json_writer.StartArray();
+      for (const auto &route: QueryDigestComponent::getInstance().get_routes()) {
+        json_writer.StartObject();
+        json_writer.Key("name");
+        json_writer.String(route.first.c_str(), static_cast<rapidjson::SizeType>(route.first.size()));
+        json_writer.Key("lostSamples");
+        json_writer.Uint64(route.second->get_lost_samples());
+        json_writer.Key("digests");
+        json_writer.StartArray();
+        for (const auto &digest: route.second->get_snapshot()) {
+          json_writer.StartObject();
+          json_writer.Key("digest");
+          json_writer.String(digest.digest.c_str(), static_cast<rapidjson::SizeType>(digest.digest.size()));
+          json_writer.Key("count");
+          json_writer.Uint64(digest.count);
+          json_writer.Key("latencySumUs");
+          json_writer.Uint64(digest.latency_sum_us);
+          json_writer.Key("latencyMaxUs");
+          json_writer.Uint64(digest.latency_max_us);
+          json_writer.Key("rows");
+          json_writer.Uint64(digest.rows);
+          json_writer.Key("bytes");
+          json_writer.Uint64(digest.bytes);
+          json_writer.Key("latencyHistogram");
+          json_writer.StartArray();
+          for (uint64_t bucket: digest.latency_histogram) json_writer.Uint64(bucket);
+          json_writer.EndArray();
+          json_writer.EndObject();
+        }
+        json_writer.EndArray();
+        json_writer.EndObject();
+      }
+      json_writer.EndArray();
+      json_writer.EndObject();
+
+      out.Flush();
+    }
+    req.send_reply_end();
+  }
+};
+
+/**
+ * events of the traced connections, grouped by connection.
+ *
+ * timestamps are microseconds of a steady clock, only their differences
+ * are meaningful.
+ */
+class RestApiV1RoutingConnectionTrace: public BaseRequestHandler {
+public:
+  // allow methods: GET
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!(HttpMethod::Get & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    auto out_hdrs = req.get_output_headers();
+    out_hdrs.add("Content-Type", "application/json");
+
+    req.send_reply_start(HttpStatusCode::Ok, "Ok");
+    {
+      HttpChunkedStream out(req);
+      rapidjson::Writer<HttpChunkedStream> json_writer(out);
+
+      json_writer.StartObject();
+      json_writer.Key("events");
+      json_writer.StartArray();
+      for (const auto &record: ConnectionTrace::getInstance().get_snapshot()) {
+        json_writer.StartObject();
+        json_writer.Key("connectionId");
+        json_writer.Uint64(record.connection_id);
+        json_writer.Key("timestampUs");
+        json_writer.Uint64(record.timestamp / 1000);
+        json_writer.Key("event");
+        json_writer.String(ConnectionTrace::event_name(record.event));
+        json_writer.EndObject();
+      }
+      json_writer.EndArray();
+      json_writer.EndObject();
+
+      out.Flush();
+    }
+    req.send_reply_end();
+  }
+};
+
+/**
+ * readiness of the router for load balancers and orchestrators.
+ *
+ * 200 once all routes can route to their destinations, 503 before and while
+ * shutting down:
+ *
+ *     {"ready": false, "components": {"harness": true, "routing:rw": false}}
+ */
+class RestApiV1RouterReady: public BaseRequestHandler {
+public:
+  // allow methods: GET, HEAD
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!((HttpMethod::Get | HttpMethod::Head) & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET, HEAD");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    const auto components = mysql_harness::Readiness::instance().get_components();
+    bool ready = true;
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      json_writer.Key("components");
+      json_writer.StartObject();
+      for (const auto &component: components) {
+        json_writer.Key(component.first.c_str(), static_cast<rapidjson::SizeType>(component.first.size()));
+        json_writer.Bool(component.second);
+        ready = ready && component.second;
+      }
+      json_writer.EndObject();
+      json_writer.Key("ready");
+      json_writer.Bool(ready);
+      json_writer.EndObject();
+    }
+
+    const int status_code = ready ? HttpStatusCode::Ok : HttpStatusCode::ServiceUnavailable;
+
+    req.get_output_headers().add("Content-Type", "application/json");
+    req.get_output_headers().add("Cache-Control", "no-cache");
+    auto chunk = req.get_output_buffer();
+    chunk.add(json_buf.GetString(), json_buf.GetSize());
+    req.send_reply(status_code, HttpStatusCode::get_default_status_text(status_code), chunk);
+  }
+};
+
+/**
+ * memory held by the subsystems, as accounted by them.
+ */
+class RestApiV1RouterMemory: public BaseRequestHandler {
+public:
+  // allow methods: GET, HEAD
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!((HttpMethod::Get | HttpMethod::Head) & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET, HEAD");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    uint64_t total_bytes = 0;
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      json_writer.Key("subsystems");
+      json_writer.StartObject();
+      for (size_t i = 0; i < mysql_harness::MemoryAccounting::kTags; ++i) {
+        const auto tag = static_cast<mysql_harness::MemoryTag>(i);
+        const auto usage = mysql_harness::MemoryAccounting::get_usage(tag);
+
+        json_writer.Key(mysql_harness::MemoryAccounting::tag_name(tag));
+        json_writer.StartObject();
+        json_writer.Key("bytes");
+        json_writer.Uint64(usage.bytes);
+        json_writer.Key("objects");
+        json_writer.Uint64(usage.objects);
+        json_writer.EndObject();
+
+        total_bytes += usage.bytes;
+      }
+      json_writer.EndObject();
+      json_writer.Key("bytes");
+      json_writer.Uint64(total_bytes);
+      json_writer.EndObject();
+    }
+
+    req.get_output_headers().add("Content-Type", "application/json");
+    req.get_output_headers().add("Cache-Control", "no-cache");
+    auto chunk = req.get_output_buffer();
+    chunk.add(json_buf.GetString(), json_buf.GetSize());
+    req.send_reply(HttpStatusCode::Ok, "Ok", chunk);
+  }
+};
+
+/**
+ * metrics of the routes, the metadata cache and the memory of the subsystems
+ * in the Prometheus text format.
+ *
+ * the counters are summed up per scrape, the routing threads don't wait for it.
+ */
+class MetricsRequestHandler: public BaseRequestHandler {
+public:
+  // allow methods: GET
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!(HttpMethod::Get & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    std::map<std::string, RoutingMetrics::Snapshot> routes;
+    for (const auto &route: RoutingMetricsComponent::getInstance().get_routes()) {
+      routes.emplace(route.first, route.second->get_snapshot());
+    }
+
+    std::ostringstream os;
+    // seconds down to the microsecond
+    os << std::fixed << std::setprecision(6);
+    write_counter(os, routes, "mysqlrouter_route_connections_total", "counter",
+                  "Client connections accepted by the route.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.connections_total; });
+    write_counter(os, routes, "mysqlrouter_route_active_connections", "gauge",
+                  "Client connections currently open.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.connections_active; });
+    write_counter(os, routes, "mysqlrouter_route_bytes_up_total", "counter",
+                  "Bytes sent from the clients to the servers by closed connections.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.bytes_up; });
+    write_counter(os, routes, "mysqlrouter_route_bytes_down_total", "counter",
+                  "Bytes sent from the servers to the clients by closed connections.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.bytes_down; });
+    write_counter(os, routes, "mysqlrouter_route_connect_errors_total", "counter",
+                  "Failed connects to the servers.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.connect_errors; });
+    write_counter(os, routes, "mysqlrouter_route_connection_errors_total", "counter",
+                  "Client connections closed for a failed read or write.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.connection_errors; });
+    write_counter(os, routes, "mysqlrouter_route_handshake_timeouts_total", "counter",
+                  "Client connections closed as their handshake took longer than client_connect_timeout.",
+                  [](const RoutingMetrics::Snapshot &s) {
+                    return RoutingMetrics::timeouts(s, RoutingMetrics::Timeout::kHandshake);
+                  });
+    write_counter(os, routes, "mysqlrouter_route_idle_timeouts_total", "counter",
+                  "Client connections closed after idle_timeout.",
+                  [](const RoutingMetrics::Snapshot &s) {
+                    return RoutingMetrics::timeouts(s, RoutingMetrics::Timeout::kIdle);
+                  });
+    write_counter(os, routes, "mysqlrouter_route_lifetime_timeouts_total", "counter",
+                  "Client connections closed after max_connection_lifetime.",
+                  [](const RoutingMetrics::Snapshot &s) {
+                    return RoutingMetrics::timeouts(s, RoutingMetrics::Timeout::kLifetime);
+                  });
+
+    write_counter(os, routes, "mysqlrouter_route_buffer_pool_hits_total", "counter",
+                  "Connection buffers lent from the idle buffers of the buffer pools.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.buffer_pool.hits; });
+    write_counter(os, routes, "mysqlrouter_route_buffer_pool_misses_total", "counter",
+                  "Connection buffers the buffer pools had to allocate.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.buffer_pool.misses; });
+    write_counter(os, routes, "mysqlrouter_route_buffer_pool_evictions_total", "counter",
+                  "Returned connection buffers freed as the pools kept buffer_pool_size idle ones already.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.buffer_pool.evictions; });
+    write_counter(os, routes, "mysqlrouter_route_buffer_pool_high_water", "gauge",
+                  "Max connection buffers lent at the same time, summed up over the buffer pools.",
+                  [](const RoutingMetrics::Snapshot &s) { return s.buffer_pool.high_water; });
+
+    write_histogram(os, routes, RoutingMetrics::Latency::kConnect,
+                    "mysqlrouter_route_connect_latency_seconds",
+                    "Time successful connects to the servers took.");
+    write_histogram(os, routes, RoutingMetrics::Latency::kHandshake,
+                    "mysqlrouter_route_handshake_duration_seconds",
+                    "Time from accepting a client connection until its handshake was done.");
+    write_histogram(os, routes, RoutingMetrics::Latency::kLifetime,
+                    "mysqlrouter_route_connection_lifetime_seconds",
+                    "Time client connections were open, counted when they got closed.");
+    write_histogram(os, routes, RoutingMetrics::Latency::kRoundTrip,
+                    "mysqlrouter_route_round_trip_seconds",
+                    "Time from the first byte of a client request until the first byte of the response.");
+
+    os << "# HELP mysqlrouter_route_destination_quarantined 1 if the route doesn't send connections to the server.\n"
+       << "# TYPE mysqlrouter_route_destination_quarantined gauge\n";
+    for (const auto &route: routes) {
+      for (const auto &dest: route.second.quarantined) {
+        os << "mysqlrouter_route_destination_quarantined{route=\"" << escape_label(route.first)
+           << "\",destination=\"" << escape_label(dest.first) << "\"} " << (dest.second ? 1 : 0) << "\n";
+      }
+    }
+
+    write_metadata_cache(os);
+    write_memory(os);
+    write_socket_stats(os);
+
+    auto chunk = req.get_output_buffer();
+    const std::string body = os.str();
+    chunk.add(body.data(), body.size());
+
+    auto out_hdrs = req.get_output_headers();
+    out_hdrs.add("Content-Type", "text/plain; version=0.0.4");
+
+    req.send_reply(HttpStatusCode::Ok, "Ok", chunk);
+  }
+
+private:
+  // backslash, double-quote and line feed need to be escaped in label values
+  static std::string escape_label(const std::string &value) {
+    std::string escaped;
+    for (char c: value) {
+      switch (c) {
+      case '\\': escaped += "\\\\"; break;
+      case '"': escaped += "\\\""; break;
+      case '\n': escaped += "\\n"; break;
+      default: escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  static double seconds(uint64_t us) {
+    return static_cast<double>(us) / 1000000.0;
+  }
+
+  template<class Getter>
+  static void write_counter(std::ostream &os, const std::map<std::string, RoutingMetrics::Snapshot> &routes,
+                            const char *name, const char *type, const char *help, Getter get) {
+    os << "# HELP " << name << " " << help << "\n"
+       << "# TYPE " << name << " " << type << "\n";
+    for (const auto &route: routes) {
+      os << name << "{route=\"" << escape_label(route.first) << "\"} " << get(route.second) << "\n";
+    }
+  }
+
+  static void write_memory(std::ostream &os) {
+    using mysql_harness::MemoryAccounting;
+
+    os << "# HELP mysqlrouter_memory_bytes Bytes held by the subsystem, as accounted by it.\n"
+       << "# TYPE mysqlrouter_memory_bytes gauge\n";
+    for (size_t i = 0; i < MemoryAccounting::kTags; ++i) {
+      const auto tag = static_cast<mysql_harness::MemoryTag>(i);
+      os << "mysqlrouter_memory_bytes{subsystem=\"" << MemoryAccounting::tag_name(tag) << "\"} "
+         << MemoryAccounting::get_usage(tag).bytes << "\n";
+    }
+    os << "# HELP mysqlrouter_memory_objects Objects held by the subsystem, as accounted by it.\n"
+       << "# TYPE mysqlrouter_memory_objects gauge\n";
+    for (size_t i = 0; i < MemoryAccounting::kTags; ++i) {
+      const auto tag = static_cast<mysql_harness::MemoryTag>(i);
+      os << "mysqlrouter_memory_objects{subsystem=\"" << MemoryAccounting::tag_name(tag) << "\"} "
+         << MemoryAccounting::get_usage(tag).objects << "\n";
+    }
+  }
+
+  // only once enabled with socket_stats, the calls of all threads
+  static void write_socket_stats(std::ostream &os) {
+    using mysql_harness::SocketOperations;
+    using mysql_harness::SocketOperationsStats;
+
+    if (!SocketOperations::is_stats_enabled()) return;
+
+    const SocketOperationsStats stats = SocketOperations::get_stats();
+    // the transfers first, then the waits
+    const std::pair<const char *, const SocketOperationsStats::Counters *> ops[] {
+      {"read", &stats.read},
+      {"write", &stats.write},
+      {"poll", &stats.poll},
+      {"connect_wait", &stats.connect_wait},
+    };
+    const size_t kAll = 4, kTransfers = 2;
+
+    auto write_op_counter = [&](const char *name, const char *help, size_t first, size_t last,
+                                uint64_t SocketOperationsStats::Counters::*counter) {
+      os << "# HELP " << name << " " << help << "\n"
+         << "# TYPE " << name << " counter\n";
+      for (size_t i = first; i < last; ++i) {
+        os << name << "{op=\"" << ops[i].first << "\"} " << ops[i].second->*counter << "\n";
+      }
+    };
+
+    write_op_counter("mysqlrouter_socket_calls_total", "Socket calls, successful or not.",
+                     0, kAll, &SocketOperationsStats::Counters::calls);
+    write_op_counter("mysqlrouter_socket_bytes_total", "Bytes read and written by the socket calls.",
+                     0, kTransfers, &SocketOperationsStats::Counters::bytes);
+    write_op_counter("mysqlrouter_socket_would_block_total", "Socket calls failing with EAGAIN.",
+                     0, kAll, &SocketOperationsStats::Counters::would_block);
+    write_op_counter("mysqlrouter_socket_interrupted_total", "Socket calls failing with EINTR.",
+                     0, kAll, &SocketOperationsStats::Counters::interrupted);
+    write_op_counter("mysqlrouter_socket_errors_total", "Socket calls failing with other errors.",
+                     0, kAll, &SocketOperationsStats::Counters::errors);
+    write_op_counter("mysqlrouter_socket_timeouts_total", "Waits for sockets running into their timeout.",
+                     kTransfers, kAll, &SocketOperationsStats::Counters::timeouts);
+  }
+
+  static void write_histogram(std::ostream &os, const std::map<std::string, RoutingMetrics::Snapshot> &routes,
+                              RoutingMetrics::Latency what, const char *name, const char *help) {
+    os << "# HELP " << name << " " << help << "\n"
+       << "# TYPE " << name << " histogram\n";
+    for (const auto &route: routes) {
+      const RoutingMetrics::Snapshot::Histogram &histogram = RoutingMetrics::histogram(route.second, what);
+      const std::string label = "route=\"" + escape_label(route.first) + "\"";
+      uint64_t cumulative = 0;
+      // the last bucket also counts the larger latencies, it is left to +Inf
+      for (size_t b = 0; b + 1 < RoutingMetrics::kLatencyBuckets; ++b) {
+        cumulative += histogram.buckets[b];
+        os << name << "_bucket{" << label << ",le=\""
+           << seconds(static_cast<uint64_t>(RoutingMetrics::latency_bucket_bound(b).count())) << "\"} "
+           << cumulative << "\n";
+      }
+      os << name << "_bucket{" << label << ",le=\"+Inf\"} " << histogram.count << "\n"
+         << name << "_sum{" << label << "} " << seconds(histogram.sum_us) << "\n"
+         << name << "_count{" << label << "} " << histogram.count << "\n";
+    }
+  }
+
+  static void write_metadata_cache(std::ostream &os) {
+    metadata_cache::RefreshStats stats;
+    try {
+      stats = metadata_cache::MetadataCacheAPI::instance()->get_refresh_stats();
+    } catch (const std::exception &) {
+      // no metadata cache configured
+      return;
+    }
+
+    os << "# HELP mysqlrouter_metadata_refreshes_total Refreshes of the metadata.\n"
+       << "# TYPE mysqlrouter_metadata_refreshes_total counter\n"
+       << "mysqlrouter_metadata_refreshes_total " << stats.refreshes << "\n"
+       << "# HELP mysqlrouter_metadata_refresh_failures_total Refreshes that reached none of the metadata servers.\n"
+       << "# TYPE mysqlrouter_metadata_refresh_failures_total counter\n"
+       << "mysqlrouter_metadata_refresh_failures_total " << stats.refresh_failures << "\n"
+       << "# HELP mysqlrouter_metadata_last_refresh_duration_seconds Time the last refresh took.\n"
+       << "# TYPE mysqlrouter_metadata_last_refresh_duration_seconds gauge\n"
+       << "mysqlrouter_metadata_last_refresh_duration_seconds "
+       << seconds(static_cast<uint64_t>(stats.last_refresh_duration.count())) << "\n"
+       << "# HELP mysqlrouter_metadata_refresh_duration_seconds Time the refreshes took.\n"
+       << "# TYPE mysqlrouter_metadata_refresh_duration_seconds summary\n"
+       << "mysqlrouter_metadata_refresh_duration_seconds_sum "
+       << seconds(static_cast<uint64_t>(stats.refresh_duration_sum.count())) << "\n"
+       << "mysqlrouter_metadata_refresh_duration_seconds_count " << stats.refreshes << "\n";
+  }
+};
+
+// "/api/v1/routing/routes/{name}{suffix}"
+static std::string get_route_name(const std::string &path, const std::string &suffix) {
+  static const std::string prefix { "/api/v1/routing/routes/" };
+
+  if (path.size() <= prefix.size() + suffix.size()) return {};
+
+  return path.substr(prefix.size(), path.size() - prefix.size() - suffix.size());
+}
+
+static void send_json(HttpRequest &req, int status_code, const rapidjson::StringBuffer &json_buf) {
+  req.get_output_headers().add("Content-Type", "application/json");
+  auto chunk = req.get_output_buffer();
+  chunk.add(json_buf.GetString(), json_buf.GetSize());
+  req.send_reply(status_code, HttpStatusCode::get_default_status_text(status_code), chunk);
+}
+
+static void send_json_error(HttpRequest &req, int status_code, const std::string &err_msg) {
+  rapidjson::StringBuffer json_buf;
+  {
+    rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+    json_writer.StartObject();
+    json_writer.Key("error");
+    json_writer.String(err_msg.c_str(), static_cast<rapidjson::SizeType>(err_msg.size()));
+    json_writer.EndObject();
+  }
+
+  send_json(req, status_code, json_buf);
+}
+
+// [rest_routing] allow_route_changes=1 enables PATCH of the route config
+static std::atomic<bool> g_allow_route_changes{false};
+// [rest_routing] allow_profiling=1 enables POST of the router profile
+static std::atomic<bool> g_allow_profiling{false};
+
+/**
+ * check that a request changing the router may be served.
+ *
+ * the http_server has no authentication and listens on all addresses by
+ * default, hence requests changing the router need to be enabled by their
+ * option and come from a loopback address.
+ *
+ * @param req request to check, answered with 403 if refused
+ * @param enabled value of the option enabling the request
+ * @param option_name name of the option in [rest_routing]
+ * @return true if the request may be served
+ */
+static bool check_change_allowed(HttpRequest &req, bool enabled, const char *option_name) {
+  if (!enabled) {
+    send_json_error(req, HttpStatusCode::Forbidden,
+        std::string("disabled, set ") + option_name + "=1 in [rest_routing] to enable it");
+    return false;
+  }
+  if (!is_loopback_address(req.get_peer_address())) {
+    send_json_error(req, HttpStatusCode::Forbidden, "only allowed from a loopback address");
+    return false;
+  }
+  return true;
+}
+
+// "key=value&key=value" of the known keys, all optional, values are positive integers
+static bool parse_query_numbers(const std::string &query, const std::map<std::string, size_t *> &params,
+                                std::string &err_msg) {
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t end = query.find('&', pos);
+    if (end == std::string::npos) end = query.size();
+    const std::string param = query.substr(pos, end - pos);
+    pos = end + 1;
+    if (param.empty()) continue;
+
+    const size_t eq = param.find('=');
+    const std::string key = param.substr(0, eq);
+    const std::string value = eq == std::string::npos ? std::string() : param.substr(eq + 1);
+
+    const auto it = params.find(key);
+    if (it == params.end()) {
+      err_msg = "unknown parameter: " + key;
+      return false;
+    }
+
+    char *value_end = nullptr;
+    errno = 0;
+    const unsigned long long number = std::strtoull(value.c_str(), &value_end, 10);
+    if (value.empty() || value[0] == '-' || *value_end != '\0' || errno == ERANGE ||
+        number > std::numeric_limits<size_t>::max()) {
+      err_msg = key + " needs to be a positive integer";
+      return false;
+    }
+    *it->second = static_cast<size_t>(number);
+  }
+
+  return true;
+}
+
+/**
+ * settings of a route which can be changed while it runs.
+ *
+ * GET returns them, PATCH changes the ones in the JSON object of the
+ * request-body:
+ *
+ *     {"maxConnections": 1024, "netBufferLength": 32768,
+ *      "destinations": ["127.0.0.1:3306", "127.0.0.1:3307"]}
+ *
+ * new connections get the new settings, established ones keep theirs.
+ *
+ * PATCH is refused unless enabled with allow_route_changes=1 and sent
+ * from a loopback address, see check_change_allowed().
+ */
+class RestApiV1RoutingRouteConfig: public BaseRequestHandler {
+public:
+  // larger bodies are refused
+  static constexpr size_t kMaxRequestBodySize = 64 * 1024;
+
+  // allow methods: GET, PATCH
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!((HttpMethod::Get | HttpMethod::Patch) & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET, PATCH");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    const std::string route_name = get_route_name(HttpUri::parse(req.get_uri()).get_path(), "/config");
+
+    if (HttpMethod::Patch & req.get_method()) {
+      if (!check_change_allowed(req, g_allow_route_changes, "allow_route_changes")) return;
+
+      RouteSettingsChange change;
+      std::string err_msg;
+      if (!parse_change(req, change, err_msg)) {
+        send_json_error(req, HttpStatusCode::BadRequest, err_msg);
+        return;
+      }
+
+      bool invalid = false;
+      bool found = RoutingControlComponent::getInstance().with_route(route_name, [&](RouteControl &control) {
+        try {
+          control.change_settings(change);
+        } catch (const std::invalid_argument &e) {
+          invalid = true;
+          err_msg = e.what();
+        }
+      });
+      if (!found) {
+        send_json_error(req, HttpStatusCode::NotFound, "route not found");
+        return;
+      }
+      if (invalid) {
+        send_json_error(req, HttpStatusCode::BadRequest, err_msg);
+        return;
+      }
+    }
+
+    RouteSettings settings;
+    if (!RoutingControlComponent::getInstance().with_route(route_name, [&](RouteControl &control) {
+          settings = control.get_settings();
+        })) {
+      send_json_error(req, HttpStatusCode::NotFound, "route not found");
+      return;
+    }
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      json_writer.Key("maxConnections");
+      json_writer.Int(settings.max_connections);
+      json_writer.Key("netBufferLength");
+      json_writer.Uint(settings.net_buffer_length);
+      json_writer.Key("staticDestinations");
+      json_writer.Bool(settings.static_destinations);
+      json_writer.Key("destinations");
+      json_writer.StartArray();
+      for (const auto &dest: settings.destinations) {
+        json_writer.String(dest.c_str(), static_cast<rapidjson::SizeType>(dest.size()));
+      }
+      json_writer.EndArray();
+      json_writer.EndObject();
+    }
+
+    send_json(req, HttpStatusCode::Ok, json_buf);
+  }
+private:
+  static bool parse_change(HttpRequest &req, RouteSettingsChange &change, std::string &err_msg) {
+    auto in_buf = req.get_input_buffer();
+    if (in_buf.length() > kMaxRequestBodySize) {
+      err_msg = "request-body too large";
+      return false;
+    }
+    auto body = in_buf.pop_front(in_buf.length());
+
+    rapidjson::Document doc;
+    doc.Parse(reinterpret_cast<const char *>(body.data()), body.size());
+    if (doc.HasParseError() || !doc.IsObject()) {
+      err_msg = "expected a JSON object as request-body";
+      return false;
+    }
+
+    for (auto it = doc.MemberBegin(); it != doc.MemberEnd(); ++it) {
+      const std::string key { it->name.GetString(), it->name.GetStringLength() };
+      const auto &value = it->value;
+
+      if (key == "maxConnections") {
+        if (!value.IsInt()) {
+          err_msg = "maxConnections needs to be an integer";
+          return false;
+        }
+        change.change_max_connections = true;
+        change.max_connections = value.GetInt();
+      } else if (key == "netBufferLength") {
+        if (!value.IsUint()) {
+          err_msg = "netBufferLength needs to be a positive integer";
+          return false;
+        }
+        change.change_net_buffer_length = true;
+        change.net_buffer_length = value.GetUint();
+      } else if (key == "destinations") {
+        if (!value.IsArray()) {
+          err_msg = "destinations needs to be an array of strings";
+          return false;
+        }
+        for (const auto &dest: value.GetArray()) {
+          if (!dest.IsString()) {
+            err_msg = "destinations needs to be an array of strings";
+            return false;
+          }
+          change.destinations.emplace_back(dest.GetString(), dest.GetStringLength());
+        }
+        change.change_destinations = true;
+      } else {
+        err_msg = "unknown setting: " + key;
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+constexpr size_t RestApiV1RoutingRouteConfig::kMaxRequestBodySize;
+
+// ISO 8601 in UTC, down to the millisecond
+static std::string format_time(std::chrono::system_clock::time_point tp) {
+  const std::time_t secs = std::chrono::system_clock::to_time_t(tp);
+  const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+      tp.time_since_epoch()).count() % 1000;
+  std::tm tm;
+#ifdef _WIN32
+  gmtime_s(&tm, &secs);
+#else
+  gmtime_r(&secs, &tm);
+#endif
+  char buf[32];
+  const size_t len = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  std::snprintf(buf + len, sizeof(buf) - len, ".%03dZ", static_cast<int>(millis < 0 ? 0 : millis));
+
+  return buf;
+}
+
+/**
+ * client connections of a route, a page at a time.
+ *
+ * GET /api/v1/routing/routes/{name}/connections?cursor=0&limit=100
+ *
+ *     {"connections": [{"clientAddress": "127.0.0.1:52314",
+ *                       "serverAddress": "127.0.0.1:3306",
+ *                       "timeStarted": "2018-05-14T09:12:01.123Z",
+ *                       "bytesFromClient": 1024, "bytesFromServer": 65536,
+ *                       "idleMs": 250}],
+ *      "nextCursor": 12}
+ *
+ * the next page is asked for with the nextCursor, 0 once all connections got
+ * listed. only a part of the route's connections is locked at a time, the
+ * pages don't show the connections of a single moment.
+ */
+class RestApiV1RoutingRouteConnections: public BaseRequestHandler {
+public:
+  static constexpr size_t kDefaultLimit = 100;
+  static constexpr size_t kMaxLimit = 1000;
+
+  // allow methods: GET
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!(HttpMethod::Get & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    const HttpUri uri = HttpUri::parse(req.get_uri());
+    const std::string route_name = get_route_name(uri.get_path(), "/connections");
+
+    size_t cursor = 0;
+    size_t limit = kDefaultLimit;
+    std::string err_msg;
+    if (!parse_query_numbers(uri.get_query(), {{"cursor", &cursor}, {"limit", &limit}}, err_msg)) {
+      send_json_error(req, HttpStatusCode::BadRequest, err_msg);
+      return;
+    }
+    if (limit == 0 || limit > kMaxLimit) {
+      send_json_error(req, HttpStatusCode::BadRequest,
+                      "limit needs to be between 1 and " + std::to_string(kMaxLimit));
+      return;
+    }
+
+    RouteConnectionsPage page;
+    if (!RoutingControlComponent::getInstance().with_route(route_name, [&](RouteControl &control) {
+          page = control.get_connections(cursor, limit);
+        })) {
+      send_json_error(req, HttpStatusCode::NotFound, "route not found");
+      return;
+    }
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      json_writer.Key("connections");
+      json_writer.StartArray();
+      for (const auto &conn: page.connections) {
+        json_writer.StartObject();
+        json_writer.Key("clientAddress");
+        json_writer.String(conn.client_address.c_str(), static_cast<rapidjson::SizeType>(conn.client_address.size()));
+        json_writer.Key("serverAddress");
+        json_writer.String(conn.server_address.c_str(), static_cast<rapidjson::SizeType>(conn.server_address.size()));
+        json_writer.Key("timeStarted");
+        const std::string started = format_time(conn.started);
+        json_writer.String(started.c_str(), static_cast<rapidjson::SizeType>(started.size()));
+        json_writer.Key("bytesFromClient");
+        json_writer.Uint64(conn.bytes_from_client);
+        json_writer.Key("bytesFromServer");
+        json_writer.Uint64(conn.bytes_from_server);
+        json_writer.Key("idleMs");
+        json_writer.Int64(conn.idle.count());
+        json_writer.EndObject();
+      }
+      json_writer.EndArray();
+      json_writer.Key("nextCursor");
+      json_writer.Uint64(page.next_cursor);
+      json_writer.EndObject();
+    }
+
+    send_json(req, HttpStatusCode::Ok, json_buf);
+  }
+};
+
+constexpr size_t RestApiV1RoutingRouteConnections::kDefaultLimit;
+constexpr size_t RestApiV1RoutingRouteConnections::kMaxLimit;
+
+/**
+ * scoreboard of the servers of a route.
+ *
+ * GET /api/v1/routing/routes/{name}/destinations
+ *
+ *     {"destinations": [{"address": "127.0.0.1:3306",
+ *                        "connectsSucceeded": 120, "connectsFailed": 2,
+ *                        "connectSuccessRate": 0.98, "connectLatencyUs": 450,
+ *                        "activeConnections": 12, "bytesPerSecond": 81920.5,
+ *                        "circuit": "closed",
+ *                        "lastError": {"code": 111, "message": "Connection refused",
+ *                                      "time": "2018-05-14T09:12:01.123Z"}}]}
+ *
+ * rates and latencies are smoothed over the recent connects, lastError is
+ * null if no connect failed. bytesPerSecond is measured since the previous
+ * request a second or more ago. circuit is closed, open or half-open, see
+ * the circuit_breaker_failures option.
+ */
+class RestApiV1RoutingRouteDestinations: public BaseRequestHandler {
+public:
+  // allow methods: GET
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!(HttpMethod::Get & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    const std::string route_name = get_route_name(HttpUri::parse(req.get_uri()).get_path(), "/destinations");
+
+    std::vector<RouteDestinationScore> scores;
+    if (!RoutingControlComponent::getInstance().with_route(route_name, [&](RouteControl &control) {
+          scores = control.get_destination_scores();
+        })) {
+      send_json_error(req, HttpStatusCode::NotFound, "route not found");
+      return;
+    }
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      json_writer.Key("destinations");
+      json_writer.StartArray();
+      for (const auto &score: scores) {
+        json_writer.StartObject();
+        json_writer.Key("address");
+        json_writer.String(score.address.c_str(), static_cast<rapidjson::SizeType>(score.address.size()));
+        json_writer.Key("connectsSucceeded");
+        json_writer.Uint64(score.connects_succeeded);
+        json_writer.Key("connectsFailed");
+        json_writer.Uint64(score.connects_failed);
+        json_writer.Key("connectSuccessRate");
+        json_writer.Double(score.connect_success_rate);
+        json_writer.Key("connectLatencyUs");
+        json_writer.Int64(score.connect_latency.count());
+        json_writer.Key("activeConnections");
+        json_writer.Uint64(score.active_connections);
+        json_writer.Key("bytesPerSecond");
+        json_writer.Double(score.bytes_per_second);
+        json_writer.Key("circuit");
+        json_writer.String(score.circuit_state.c_str(), static_cast<rapidjson::SizeType>(score.circuit_state.size()));
+        json_writer.Key("lastError");
+        if (score.last_error == 0) {
+          json_writer.Null();
+        } else {
+          json_writer.StartObject();
+          json_writer.Key("code");
+          json_writer.Int(score.last_error);
+          json_writer.Key("message");
+          const std::string message = std::strerror(score.last_error);
+          json_writer.String(message.c_str(), static_cast<rapidjson::SizeType>(message.size()));
+          json_writer.Key("time");
+          const std::string time = format_time(score.last_error_time);
+          json_writer.String(time.c_str(), static_cast<rapidjson::SizeType>(time.size()));
+          json_writer.EndObject();
+        }
+        json_writer.EndObject();
+      }
+      json_writer.EndArray();
+      json_writer.EndObject();
+    }
+
+    send_json(req, HttpStatusCode::Ok, json_buf);
+  }
+};
+
+/**
+ * CPU profile of the router, taken by sampling the stacks.
+ *
+ * POST /api/v1/router/profile?seconds=30&frequency=99 starts profiling,
+ * GET returns the folded stacks of the last finished profile, one
+ * `outer;inner count` per line as taken by flamegraph.pl:
+ *
+ *     curl -s -X POST 'http://127.0.0.1:8081/api/v1/router/profile?seconds=30'
+ *     sleep 30
+ *     curl -s http://127.0.0.1:8081/api/v1/router/profile | flamegraph.pl > router.svg
+ *
+ * GET answers 409 while profiling runs, 404 if no profile was taken yet.
+ * POST is refused unless enabled with allow_profiling=1 and sent from a
+ * loopback address, see check_change_allowed().
+ */
+class RestApiV1RouterProfile: public BaseRequestHandler {
+public:
+  static constexpr size_t kDefaultSeconds = 30;
+  static constexpr size_t kDefaultFrequency = 99;
+
+  // allow methods: GET, POST
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!((HttpMethod::Get | HttpMethod::Post) & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET, POST");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    if ((HttpMethod::Post & req.get_method()) &&
+        !check_change_allowed(req, g_allow_profiling, "allow_profiling")) {
+      return;
+    }
+
+    auto &profiler = mysql_harness::SamplingProfiler::instance();
+    if (!profiler.is_supported()) {
+      send_json_error(req, HttpStatusCode::NotImplemented, "profiling is not supported on this platform");
+      return;
+    }
+
+    if (HttpMethod::Post & req.get_method()) {
+      size_t seconds = kDefaultSeconds;
+      size_t frequency = kDefaultFrequency;
+      std::string err_msg;
+      if (!parse_query_numbers(HttpUri::parse(req.get_uri()).get_query(),
+                               {{"seconds", &seconds}, {"frequency", &frequency}}, err_msg)) {
+        send_json_error(req, HttpStatusCode::BadRequest, err_msg);
+        return;
+      }
+      if (seconds == 0 || seconds > static_cast<size_t>(mysql_harness::SamplingProfiler::kMaxDuration.count())) {
+        send_json_error(req, HttpStatusCode::BadRequest, "seconds needs to be between 1 and " +
+            std::to_string(mysql_harness::SamplingProfiler::kMaxDuration.count()));
+        return;
+      }
+      if (frequency == 0 || frequency > mysql_harness::SamplingProfiler::kMaxFrequency) {
+        send_json_error(req, HttpStatusCode::BadRequest, "frequency needs to be between 1 and " +
+            std::to_string(mysql_harness::SamplingProfiler::kMaxFrequency));
+        return;
+      }
+
+      try {
+        profiler.start(std::chrono::seconds(seconds), static_cast<unsigned>(frequency));
+      } catch (const std::invalid_argument &e) {
+        send_json_error(req, HttpStatusCode::BadRequest, e.what());
+        return;
+      } catch (const std::logic_error &e) {
+        send_json_error(req, HttpStatusCode::Conflicts, e.what());
+        return;
+      } catch (const std::exception &e) {
+        send_json_error(req, HttpStatusCode::InternalError, e.what());
+        return;
+      }
+
+      rapidjson::StringBuffer json_buf;
+      {
+        rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+        json_writer.StartObject();
+        json_writer.Key("seconds");
+        json_writer.Uint64(seconds);
+        json_writer.Key("frequency");
+        json_writer.Uint64(frequency);
+        json_writer.EndObject();
+      }
+      send_json(req, HttpStatusCode::Accepted, json_buf);
+      return;
+    }
+
+    if (profiler.is_running()) {
+      send_json_error(req, HttpStatusCode::Conflicts, "profiling still runs");
+      return;
+    }
+    if (!profiler.has_profile()) {
+      send_json_error(req, HttpStatusCode::NotFound, "no profile taken yet");
+      return;
+    }
+
+    const std::string folded = profiler.get_folded_stacks();
+    req.get_output_headers().add("Content-Type", "text/plain");
+    req.get_output_headers().add("Cache-Control", "no-cache");
+    auto chunk = req.get_output_buffer();
+    chunk.add(folded.data(), folded.size());
+    req.send_reply(HttpStatusCode::Ok, "Ok", chunk);
+  }
+};
+
+constexpr size_t RestApiV1RouterProfile::kDefaultSeconds;
+constexpr size_t RestApiV1RouterProfile::kDefaultFrequency;
+
+/**
+ * members of the replicasets as the metadata cache sees them, to let clients
+ * connect to them directly.
+ *
+ *     {"version": 12,
+ *      "replicasets": [{"name": "default",
+ *                       "members": [{"uuid": "...", "host": "db1", "port": 3306,
+ *                                    "xport": 33060, "role": "HA",
+ *                                    "mode": "read_write", "weight": 1,
+ *                                    "location": "", "applierQueueSize": 0}]}]}
+ *
+ * version changes with every change of the members. With ?version=12 the
+ * request waits until the topology has another version, for up to
+ * ?timeout=30 seconds, and returns the topology it has then:
+ *
+ *     curl -s 'http://router:8081/api/v1/metadata_cache/topology?version=12&timeout=30'
+ *
+ * each waiting request occupies a thread of the HTTP server, at most
+ * kMaxWaiting wait at a time, more get a 503. Answers 404 if no metadata
+ * cache is configured.
+ */
+class RestApiV1MetadataCacheTopology: public BaseRequestHandler {
+public:
+  static constexpr size_t kDefaultTimeout = 30;
+  static constexpr size_t kMaxTimeout = 60;
+  // half of the threads of the HTTP server
+  static constexpr size_t kMaxWaiting = 4;
+
+  // allow methods: GET
+  //
+  void handle_request(HttpRequest &req) override {
+    if (!(HttpMethod::Get & req.get_method())) {
+      req.get_output_headers().add("Allow", "GET");
+      req.send_reply(HttpStatusCode::MethodNotAllowed);
+      return;
+    }
+
+    const size_t kNoVersion = std::numeric_limits<size_t>::max();
+    size_t version = kNoVersion;
+    size_t timeout = kDefaultTimeout;
+    std::string err_msg;
+    if (!parse_query_numbers(HttpUri::parse(req.get_uri()).get_query(),
+                             {{"version", &version}, {"timeout", &timeout}}, err_msg)) {
+      send_json_error(req, HttpStatusCode::BadRequest, err_msg);
+      return;
+    }
+    if (timeout > kMaxTimeout) {
+      send_json_error(req, HttpStatusCode::BadRequest, "timeout needs to be at most " +
+          std::to_string(kMaxTimeout));
+      return;
+    }
+
+    auto *cache = metadata_cache::MetadataCacheAPI::instance();
+    metadata_cache::TopologySnapshot topology;
+    try {
+      if (version == kNoVersion || timeout == 0) {
+        topology = cache->get_topology();
+      } else {
+        if (waiting_.fetch_add(1) >= kMaxWaiting) {
+          waiting_.fetch_sub(1);
+          send_json_error(req, HttpStatusCode::ServiceUnavailable, "too many requests waiting");
+          return;
+        }
+        try {
+          topology = cache->wait_topology_change(version, std::chrono::seconds(timeout));
+        } catch (...) {
+          waiting_.fetch_sub(1);
+          throw;
+        }
+        waiting_.fetch_sub(1);
+      }
+    } catch (const std::exception &) {
+      send_json_error(req, HttpStatusCode::NotFound, "no metadata cache configured");
+      return;
+    }
+
+    rapidjson::StringBuffer json_buf;
+    {
+      rapidjson::Writer<rapidjson::StringBuffer> json_writer(json_buf);
+
+      json_writer.StartObject();
+      json_writer.Key("version");
+      json_writer.Uint64(topology.version);
+      json_writer.Key("replicasets");
+      json_writer.StartArray();
+      for (const auto &rs: topology.replicasets) {
+        json_writer.StartObject();
+        json_writer.Key("name");
+        json_writer.String(rs.first.c_str(), static_cast<rapidjson::SizeType>(rs.first.size()));
+        json_writer.Key("members");
+        json_writer.StartArray();
+        for (const auto &member: *rs.second) {
+          json_writer.StartObject();
+          json_writer.Key("uuid");
+          json_writer.String(member.mysql_server_uuid.c_str(),
+                             static_cast<rapidjson::SizeType>(member.mysql_server_uuid.size()));
+          json_writer.Key("host");
+          json_writer.String(member.host.c_str(), static_cast<rapidjson::SizeType>(member.host.size()));
+          json_writer.Key("port");
+          json_writer.Uint(member.port);
+          json_writer.Key("xport");
+          json_writer.Uint(member.xport);
+          json_writer.Key("role");
+          json_writer.String(metadata_cache::role_to_string(member.role));
+          json_writer.Key("mode");
+          json_writer.String(mode_name(member.mode));
+          json_writer.Key("weight");
+          json_writer.Double(member.weight);
+          json_writer.Key("location");
+          json_writer.String(member.location.c_str(), static_cast<rapidjson::SizeType>(member.location.size()));
+          json_writer.Key("applierQueueSize");
+          json_writer.Uint64(member.applier_queue_size);
+          json_writer.EndObject();
+        }
+        json_writer.EndArray();
+        json_writer.EndObject();
+      }
+      json_writer.EndArray();
+      json_writer.EndObject();
+    }
+
+    req.get_output_headers().add("Cache-Control", "no-cache");
+    send_json(req, HttpStatusCode::Ok, json_buf);
+  }
+
+  // the generation of the topology, if the request doesn't wait for a change.
+  // The generation restarts with the router, the start time keeps the
+  // entity-tags of one run from matching another.
+  bool get_etag(HttpRequest &req, std::string &etag) override {
+    if (!(HttpMethod::Get & req.get_method())) return false;
+
+    const size_t kNoVersion = std::numeric_limits<size_t>::max();
+    size_t version = kNoVersion;
+    size_t timeout = kDefaultTimeout;
+    std::string err_msg;
+    if (!parse_query_numbers(HttpUri::parse(req.get_uri()).get_query(),
+                             {{"version", &version}, {"timeout", &timeout}}, err_msg) ||
+        version != kNoVersion) {
+      return false;
+    }
+
+    try {
+      etag = std::to_string(started_) + "-" +
+          std::to_string(metadata_cache::MetadataCacheAPI::instance()->get_topology_generation());
+    } catch (const std::exception &) {
+      return false;
+    }
+    return true;
+  }
+private:
+  static const char *mode_name(metadata_cache::ServerMode mode) {
+    switch (mode) {
+      case metadata_cache::ServerMode::ReadWrite: return "read_write";
+      case metadata_cache::ServerMode::ReadOnly: return "read_only";
+      case metadata_cache::ServerMode::Unavailable: break;
+    }
+    return "unavailable";
+  }
+
+  std::atomic<size_t> waiting_{0};
+
+  const int64_t started_{std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count()};
+};
+
+constexpr size_t RestApiV1MetadataCacheTopology::kDefaultTimeout;
+constexpr size_t RestApiV1MetadataCacheTopology::kMaxTimeout;
+constexpr size_t RestApiV1MetadataCacheTopology::kMaxWaiting;
+
+// [rest_routing]
+//   socket_stats=1 counts the socket calls for /metrics
+//   allow_route_changes=1 allows changing the settings of routes
+//   allow_profiling=1 allows starting the CPU profiler
+static void init(PluginFuncEnv* env) {
+  const mysql_harness::AppInfo* info = get_app_info(env);
+
+  g_allow_route_changes = false;
+  g_allow_profiling = false;
+
+  if (nullptr == info->config) return;
+
+  for (const mysql_harness::ConfigSection* section: info->config->sections()) {
+    if (section->name != "rest_routing") continue;
+
+    for (const char *option: {"socket_stats", "allow_route_changes", "allow_profiling"}) {
+      if (!section->has(option)) continue;
+
+      const std::string value = section->get(option);
+      if (value != "0" && value != "1") {
+        set_error(env, mysql_harness::kConfigInvalidArgument,
+                  "option %s in [rest_routing] needs to be 0 or 1, got '%s'", option, value.c_str());
+        return;
+      }
+    }
+
+    if (section->has("socket_stats")) {
+      mysql_harness::SocketOperations::set_stats_enabled(section->get("socket_stats") == "1");
+    }
+    if (section->has("allow_route_changes")) {
+      g_allow_route_changes = section->get("allow_route_changes") == "1";
+    }
+    if (section->has("allow_profiling")) {
+      g_allow_profiling = section->get("allow_profiling") == "1";
+    }
+  }
+}
+
+static void start(PluginFuncEnv*) {
+  auto &srv = HttpServerComponent::getInstance();
+
+  srv.add_route(kRestQueryDigestsUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RoutingQueryDigests()));
+  srv.add_route(kMetricsUri, std::unique_ptr<BaseRequestHandler>(new MetricsRequestHandler()));
+  srv.add_route(kRestRouteConfigUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RoutingRouteConfig()));
+  srv.add_route(kRestRouteConnectionsUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RoutingRouteConnections()));
+  srv.add_route(kRestRouteDestinationsUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RoutingRouteDestinations()));
+  srv.add_route(kRestConnectionTraceUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RoutingConnectionTrace()));
+  srv.add_route(kRestRouterReadyUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RouterReady()));
+  srv.add_route(kRestRouterProfileUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RouterProfile()));
+  srv.add_route(kRestRouterMemoryUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1RouterMemory()));
+  srv.add_route(kRestMetadataCacheTopologyUri, std::unique_ptr<BaseRequestHandler>(new RestApiV1MetadataCacheTopology()));
+}
+
+static void stop(PluginFuncEnv*) {
+  auto &srv = HttpServerComponent::getInstance();
+
+  srv.remove_route(kRestQueryDigestsUri);
+  srv.remove_route(kMetricsUri);
+  srv.remove_route(kRestRouteConfigUri);
+  srv.remove_route(kRestRouteConnectionsUri);
+  srv.remove_route(kRestRouteDestinationsUri);
+  srv.remove_route(kRestConnectionTraceUri);
+  srv.remove_route(kRestRouterReadyUri);
+  srv.remove_route(kRestRouterProfileUri);
+  srv.remove_route(kRestRouterMemoryUri);
+  srv.remove_route(kRestMetadataCacheTopologyUri);
+}
+
+
+#if defined(_MSC_VER) && defined(rest_routing_EXPORTS)
+/* We are building this library */
+#  define DLLEXPORT __declspec(dllexport)
+#else
+#  define DLLEXPORT
+#endif
+
+static const char *plugin_requires[] = {
+  "routing",
+  "http_server",
+};
+
+extern "C" {
+Plugin DLLEXPORT harness_plugin_rest_routing = {
+  PLUGIN_ABI_VERSION,
+  ARCHITECTURE_DESCRIPTOR,
+  "REST_ROUTING",
+  VERSION_NUMBER(0, 0, 1),
+  sizeof(plugin_requires)/sizeof(plugin_requires[0]), plugin_requires,  // requires
+  0, nullptr,  // conflicts
+  init,        // init
+  nullptr,     // deinit
+  start,       // start
+  stop,        // stop
+};
+}
@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "result_cache.h"
+#include "query_digest.h"
+
+constexpr size_t ResultCache::kMaxResponseShare;
+
+ResultCache::ResultCache(size_t max_bytes, std::chrono::milliseconds ttl, const std::string &statements)
+    : max_bytes_(max_bytes), ttl_(ttl) {
+  std::string digest;
+  size_t begin = 0;
+  while (begin < statements.size()) {
+    size_t end = statements.find(';', begin);
+    if (end == std::string::npos) end = statements.size();
+
+    make_query_digest(reinterpret_cast<const uint8_t *>(statements.data()) + begin, end - begin, digest);
+    if (!digest.empty()) allowed_digests_.insert(digest);
+    begin = end + 1;
+  }
+}
+
+void ResultCache::make_key(const std::string &session_key, const uint8_t *sql, size_t size,
+                           std::string &key) {
+  key.assign(session_key);
+  key.push_back('\0');
+  key.append(reinterpret_cast<const char *>(sql), size);
+}
+
+std::shared_ptr<const ResultCache::Response> ResultCache::find(const std::string &key,
+                                                               clock_type::time_point now) {
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return nullptr;
+
+  if (it->second.expires <= now) {
+    erase(it);
+    return nullptr;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+  return it->second.response;
+}
+
+void ResultCache::add(const std::string &key, Response response, clock_type::time_point now) {
+  const size_t entry_bytes = key.size() + response.size();
+  if (response.size() > get_max_response_size() || entry_bytes > max_bytes_) return;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  auto it = entries_.find(key);
+  if (it != entries_.end()) erase(it);
+
+  while (bytes_ + entry_bytes > max_bytes_ && !lru_.empty()) {
+    erase(entries_.find(*lru_.back()));
+  }
+
+  it = entries_.emplace(key, Entry()).first;
+  it->second.response = std::make_shared<const Response>(std::move(response));
+  it->second.expires = now + ttl_;
+  it->second.lru = lru_.insert(lru_.begin(), &it->first);
+  bytes_ += entry_bytes;
+}
+
+void ResultCache::erase(Entries::iterator it) {
+  bytes_ -= it->first.size() + it->second.response->size();
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+size_t ResultCache::size() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return entries_.size();
+}
+
+size_t ResultCache::get_bytes() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return bytes_;
+}
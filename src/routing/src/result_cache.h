@@ -0,0 +1,126 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_RESULT_CACHE_INCLUDED
+#define ROUTING_RESULT_CACHE_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/** @class ResultCache
+ *
+ * Responses of the secondaries to read-only statements of a route, shared
+ * by all its connections.
+ *
+ * Only statements whose digest (see make_query_digest()) is one of the
+ * digests of the allowed statements are cached. Responses are kept by
+ * session identity and statement text, as the packets the server sent,
+ * until they are older than the time to live or the least recently used
+ * ones make room for new ones.
+ */
+class ResultCache {
+ public:
+  using clock_type = std::chrono::steady_clock;
+  using Response = std::vector<uint8_t>;
+
+  /** @brief share of max_bytes a single response may take */
+  static constexpr size_t kMaxResponseShare = 8;
+
+  /**
+   * @param max_bytes size of keys and responses the cache holds at most
+   * @param ttl time a response is served from the cache
+   * @param statements allowed statements, separated by ';'
+   */
+  ResultCache(size_t max_bytes, std::chrono::milliseconds ttl, const std::string &statements);
+
+  /** @brief true if statements with the digest may be cached */
+  bool is_allowed(const std::string &digest) const {
+    return allowed_digests_.count(digest) != 0;
+  }
+
+  /** @brief largest response that is cached */
+  size_t get_max_response_size() const noexcept { return max_bytes_ / kMaxResponseShare; }
+
+  /**
+   * @brief Builds the key of a statement.
+   *
+   * @param session_key identity of the session, see ReadWriteSplitter::get_session_key()
+   * @param sql statement
+   * @param size number of bytes at sql
+   * @param key set to the key, its memory is reused
+   */
+  static void make_key(const std::string &session_key, const uint8_t *sql, size_t size,
+                       std::string &key);
+
+  /**
+   * @brief Gets the response cached for the key.
+   *
+   * @return response, nullptr if none or expired
+   */
+  std::shared_ptr<const Response> find(const std::string &key, clock_type::time_point now);
+
+  /**
+   * @brief Caches a response.
+   *
+   * Responses larger than get_max_response_size() are not cached.
+   */
+  void add(const std::string &key, Response response, clock_type::time_point now);
+
+  /** @brief number of cached responses */
+  size_t size() const;
+
+  /** @brief size of the cached keys and responses */
+  size_t get_bytes() const;
+
+ private:
+  struct Entry {
+    std::shared_ptr<const Response> response;
+    clock_type::time_point expires;
+    /** @brief position in lru_ */
+    std::list<const std::string *>::iterator lru;
+  };
+  using Entries = std::unordered_map<std::string, Entry>;
+
+  void erase(Entries::iterator it);
+
+  const size_t max_bytes_;
+  const std::chrono::milliseconds ttl_;
+  std::unordered_set<std::string> allowed_digests_;
+
+  mutable std::mutex mtx_;
+  Entries entries_;
+  /** @brief keys of entries_, most recently used first */
+  std::list<const std::string *> lru_;
+  size_t bytes_{0};
+};
+
+#endif // ROUTING_RESULT_CACHE_INCLUDED
@@ -26,17 +26,22 @@
 #include "mysqlrouter/utils.h"
 #include "router_config.h"
 #include "mysql/harness/logging/logging.h"
+#include "mysql/harness/networking/resolver_cache.h"
 #include "common.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cstring>
 #include <climits>
+#include <stdexcept>
+#include <vector>
 
 #ifndef _WIN32
 # include <fcntl.h>
 # include <netdb.h>
 # include <netinet/tcp.h>
 # include <sys/socket.h>
+# include <sys/un.h>
 # include <poll.h>
 #else
 # define WIN32_LEAN_AND_MEAN
@@ -57,13 +62,114 @@ const int kDefaultMaxConnections = 512;
 const std::chrono::seconds kDefaultDestinationConnectionTimeout { 1 };
 const std::string kDefaultBindAddress = "127.0.0.1";
 const unsigned int kDefaultNetBufferLength = 16384;  // Default defined in latest MySQL Server
+const unsigned int kDefaultBufferPoolSize = 64;
+const unsigned int kDefaultFairShareQuantum = 64 * 1024;
+const std::chrono::seconds kDefaultConnectionPoolIdleTimeout { 60 };
+const unsigned int kDefaultMaxQueryDigests = 1000;
+const std::chrono::milliseconds kDefaultResultCacheTtl { 1000 };
+const std::chrono::milliseconds kDefaultQuarantineInterval { 500 };
+const std::chrono::milliseconds kDefaultQuarantineMaxInterval { 3000 };
+const std::chrono::milliseconds kDefaultAdmissionQueueTimeout { 2000 };
+const std::chrono::milliseconds kDefaultWarmConnectionMaxAge { 2000 };
+const std::chrono::milliseconds kDefaultLatencyTolerance { 1 };
+const std::chrono::milliseconds kDefaultHedgeDelay { 50 };
+const std::chrono::milliseconds kDefaultCircuitBreakerOpenInterval { 5000 };
+const unsigned int kDefaultCircuitBreakerHalfOpenConnections = 3;
+const std::chrono::milliseconds kDefaultProxyProtocolTimeout { 1000 };
+const unsigned int kDefaultMirrorBufferSize = 1024 * 1024;
 const unsigned long long kDefaultMaxConnectErrors = 100;  // Similar to MySQL Server
 const std::chrono::seconds kDefaultClientConnectTimeout { 9 }; // Default connect_timeout MySQL Server minus 1
 
+const IOEngine kDefaultIOEngine = IOEngine::kThread;
+const unsigned int kDefaultIOThreads = 0;  // one per CPU
+const unsigned int kDefaultAcceptorThreads = 1;
+
 // unused constant
 // const int kMaxConnectTimeout = INT_MAX / 1000;
 
 
+// keep in-sync with enum IOEngine
+const std::vector<const char*> kIOEngineNames {
+  nullptr, "thread", "event"
+};
+
+IOEngine get_io_engine(const std::string& value) {
+  for (unsigned int i = 1 ; i < kIOEngineNames.size() ; ++i)
+    if (strcmp(kIOEngineNames[i], value.c_str()) == 0)
+      return static_cast<IOEngine>(i);
+  return IOEngine::kUndefined;
+}
+
+std::vector<SocketOption> get_dead_peer_socket_options(const SocketOptions& options) {
+  std::vector<SocketOption> result;
+  auto add = [&result](int level, int option, unsigned int value, const char* name) {
+    if (value > 0) result.push_back({level, option, static_cast<int>(value), name});
+  };
+
+  add(SOL_SOCKET, SO_KEEPALIVE, options.keepalive ? 1 : 0, "SO_KEEPALIVE");
+#if defined(TCP_KEEPIDLE)
+  add(IPPROTO_TCP, TCP_KEEPIDLE, options.keepalive_idle, "TCP_KEEPIDLE");
+#elif defined(TCP_KEEPALIVE)
+  // macOS names it after the option
+  add(IPPROTO_TCP, TCP_KEEPALIVE, options.keepalive_idle, "TCP_KEEPALIVE");
+#endif
+#ifdef TCP_KEEPINTVL
+  add(IPPROTO_TCP, TCP_KEEPINTVL, options.keepalive_interval, "TCP_KEEPINTVL");
+#endif
+#ifdef TCP_KEEPCNT
+  add(IPPROTO_TCP, TCP_KEEPCNT, options.keepalive_count, "TCP_KEEPCNT");
+#endif
+#ifdef TCP_USER_TIMEOUT
+  add(IPPROTO_TCP, TCP_USER_TIMEOUT, options.user_timeout, "TCP_USER_TIMEOUT");
+#endif
+
+  return result;
+}
+
+SourceAddressPool::SourceAddressPool(const std::vector<std::string>& addresses) {
+  for (const auto& address : addresses) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_PASSIVE;
+
+    struct addrinfo* info = nullptr;
+    if (getaddrinfo(address.c_str(), "0", &hints, &info) != 0 || info == nullptr) {
+      throw std::invalid_argument("'" + address + "' is not an IPv4 or IPv6 address");
+    }
+
+    mysql_harness::ResolverCache::Address resolved;
+    memset(&resolved, 0, sizeof(resolved));
+    resolved.family = info->ai_family;
+    resolved.socktype = info->ai_socktype;
+    resolved.protocol = info->ai_protocol;
+    memcpy(&resolved.addr, info->ai_addr, info->ai_addrlen);
+    resolved.addrlen = static_cast<socklen_t>(info->ai_addrlen);
+    freeaddrinfo(info);
+
+    addresses_.push_back(resolved);
+  }
+}
+
+const mysql_harness::ResolverCache::Address* SourceAddressPool::next(int family) const noexcept {
+  const size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < addresses_.size(); ++i) {
+    const auto& address = addresses_[(start + i) % addresses_.size()];
+    if (address.family == family) return &address;
+  }
+  return nullptr;
+}
+
+std::string get_io_engine_names() {
+  // +1 to skip undefined
+  return mysql_harness::serial_comma(kIOEngineNames.begin()+1, kIOEngineNames.end());
+}
+
+std::string get_io_engine_name(IOEngine io_engine) noexcept {
+  return kIOEngineNames[static_cast<int>(io_engine)];
+}
+
 // keep in-sync with enum AccessMode
 const std::vector<const char*> kAccessModeNames {
   nullptr, "read-write", "read-only"
@@ -87,7 +193,8 @@ std::string get_access_mode_name(AccessMode access_mode) noexcept {
 
 // keep in-sync with enum RoutingStrategy
 const std::vector<const char*> kRoutingStrategyNames {
-  nullptr, "first-available", "next-available", "round-robin", "round-robin-with-fallback"
+  nullptr, "first-available", "next-available", "round-robin", "round-robin-with-fallback",
+  "least-connections", "weighted-round-robin", "lowest-latency", "consistent-hash"
 };
 
 
@@ -101,12 +208,14 @@ RoutingStrategy get_routing_strategy(const std::string& value) {
 std::string get_routing_strategy_names(bool metadata_cache) {
   // round-robin-with-fallback is not supported for static routing
   const std::vector<const char*> kRoutingStrategyNamesStatic {
-    "first-available", "next-available", "round-robin"
+    "first-available", "next-available", "round-robin", "least-connections", "weighted-round-robin",
+    "lowest-latency", "consistent-hash"
   };
 
-  // next-available is not supported for metadata-cache routing
+  // next-available, least-connections and weighted-round-robin are not
+  // supported for metadata-cache routing
   const std::vector<const char*> kRoutingStrategyNamesMetadataCache {
-    "first-available", "round-robin", "round-robin-with-fallback"
+    "first-available", "round-robin", "round-robin-with-fallback", "lowest-latency", "consistent-hash"
   };
 
   const auto& v = metadata_cache ? kRoutingStrategyNamesMetadataCache: kRoutingStrategyNamesStatic;
@@ -135,96 +244,377 @@ void set_socket_blocking(int sock, bool blocking) {
 #endif
 }
 
+const char kUnixSocketPrefix[] = "unix://";
+
+bool is_unix_socket_destination(const std::string& destination) noexcept {
+  return destination.compare(0, sizeof(kUnixSocketPrefix) - 1, kUnixSocketPrefix) == 0;
+}
+
+mysql_harness::TCPAddress get_unix_socket_address(const std::string& destination) {
+  const std::string path = destination.substr(sizeof(kUnixSocketPrefix) - 1);
+#ifndef _WIN32
+  if (path.empty() || path[0] != '/') {
+    throw std::runtime_error("path of unix socket '" + path + "' is not absolute");
+  }
+  if (path.size() >= sizeof(sockaddr_un::sun_path)) {
+    throw std::runtime_error("path of unix socket '" + path + "' is too long");
+  }
+
+  return mysql_harness::TCPAddress(path, 0);
+#else
+  throw std::runtime_error("unix socket '" + path + "' is not supported on Windows");
+#endif
+}
+
+bool is_unix_socket(const mysql_harness::TCPAddress& address) noexcept {
+  // TCP addresses always have a port
+  return address.port == 0 && !address.addr.empty() && address.addr[0] == '/';
+}
+
+void RoutingSockOps::set_socket_option(int sock, int level, int option, unsigned int value,
+                                       const char* name) noexcept {
+  if (value == 0) return;
+
+  int option_value = static_cast<int>(value);
+  if (so_->setsockopt(sock, level, option, &option_value, static_cast<socklen_t>(sizeof(int))) == -1) {
+    log_debug("Failed setting %s on server socket: %s", name, get_message_error(so_->get_errno()).c_str());
+  }
+}
+
+namespace {
+
+// RFC 8305 recommends 250ms as head start of an attempt before the next one
+const std::chrono::milliseconds kConnectionAttemptDelay{250};
+
+using ResolvedAddress = mysql_harness::ResolverCache::Address;
+
+// unix sockets aren't resolved, their path is the address
+int resolve_destination(const mysql_harness::TCPAddress& addr, mysql_harness::ResolverCache::Addresses& addresses) {
+#ifndef _WIN32
+  if (is_unix_socket(addr)) {
+    ResolvedAddress address;
+    memset(&address, 0, sizeof(address));
+    sockaddr_un* sun = reinterpret_cast<sockaddr_un*>(&address.addr);
+    if (addr.addr.size() >= sizeof(sun->sun_path)) return EAI_FAIL;
+    sun->sun_family = AF_UNIX;
+    memcpy(sun->sun_path, addr.addr.c_str(), addr.addr.size() + 1);
+    address.family = AF_UNIX;
+    address.socktype = SOCK_STREAM;
+    address.protocol = 0;
+    address.addrlen = static_cast<socklen_t>(sizeof(sockaddr_un));
+    addresses.assign(1, address);
+    return 0;
+  }
+#endif
+  return mysql_harness::ResolverCache::instance().resolve(addr.addr, addr.port, addresses);
+}
+
+// alternates the address families, starting with the one the resolver put first
+std::vector<const ResolvedAddress*> interleave_address_families(const mysql_harness::ResolverCache::Addresses& addresses) {
+  std::vector<const ResolvedAddress*> preferred, others;
+  for (const auto& address : addresses) {
+    (address.family == addresses.front().family ? preferred : others).push_back(&address);
+  }
+
+  std::vector<const ResolvedAddress*> result;
+  result.reserve(addresses.size());
+  for (size_t i = 0; i < preferred.size() || i < others.size(); ++i) {
+    if (i < preferred.size()) result.push_back(preferred[i]);
+    if (i < others.size()) result.push_back(others[i]);
+  }
+
+  return result;
+}
+
+} // namespace
+
 RoutingSockOps* RoutingSockOps::instance(mysql_harness::SocketOperationsBase* sock_ops) {
   static RoutingSockOps routing_sock_ops(sock_ops);
   return &routing_sock_ops;
 }
 
-int RoutingSockOps::get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds connect_timeout_ms, bool log) noexcept {
-  struct addrinfo *servinfo, *info, hints;
+std::vector<bool> RoutingSockOps::probe_mysql_servers(const std::vector<mysql_harness::TCPAddress>& addrs,
+                                                      std::chrono::milliseconds connect_timeout) noexcept {
+  using clock = std::chrono::steady_clock;
 
-  memset(&hints, 0, sizeof hints);
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  bool timeout_expired = false;
+  std::vector<bool> reachable(addrs.size(), false);
+  // pending connects and the index of the server each of them probes
+  std::vector<struct pollfd> fds;
+  std::vector<size_t> servers;
 
-  int err;
-  if ((err = ::getaddrinfo(addr.addr.c_str(), to_string(addr.port).c_str(), &hints, &servinfo)) != 0) {
-    if (log) {
-#ifndef _WIN32
-      std::string errstr{(err == EAI_SYSTEM) ? get_message_error(so_->get_errno()) : gai_strerror(err)};
+  for (size_t i = 0; i < addrs.size(); ++i) {
+    mysql_harness::ResolverCache::Addresses addresses;
+    if (resolve_destination(addrs[i], addresses) != 0) {
+      continue;
+    }
+
+    for (const auto& address : addresses) {
+      int sock;
+      if ((sock = ::socket(address.family, address.socktype, address.protocol)) == -1) {
+        log_error("Failed opening socket: %s", get_message_error(so_->get_errno()).c_str());
+        continue;
+      }
+
+      set_socket_blocking(sock, false);
+
+      if (::connect(sock, reinterpret_cast<const struct sockaddr*>(&address.addr), address.addrlen) == 0) {
+        reachable[i] = true;
+        so_->shutdown(sock);
+        so_->close(sock);
+        break;
+      }
+
+      switch (so_->get_errno()) {
+#ifdef _WIN32
+        case WSAEINPROGRESS:
+        case WSAEWOULDBLOCK:
 #else
-      std::string errstr = get_message_error(err);
+        case EINPROGRESS:
 #endif
-      log_debug("Failed getting address information for '%s' (%s)", addr.addr.c_str(), errstr.c_str());
+          fds.push_back({sock, POLLOUT, 0});
+          servers.push_back(i);
+          break;
+        default:
+          so_->close(sock);
+          break;
+      }
     }
-    return -1;
   }
 
-  std::shared_ptr<void> exit_guard(nullptr, [&](void*){if (servinfo) freeaddrinfo(servinfo);});
+  const auto deadline = clock::now() + connect_timeout;
+  while (!fds.empty()) {
+    auto now = clock::now();
+    if (now >= deadline) break;
 
+    // rounded up, waking up before the deadline would only poll again
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+    if (now + wait < deadline) wait += std::chrono::milliseconds(1);
+    int res = so_->poll(fds.data(), static_cast<nfds_t>(fds.size()), wait);
+    if (res < 0) {
+      if (so_->get_errno() == EINTR) continue;
+
+      log_error("poll() failed while probing servers: %s", get_message_error(so_->get_errno()).c_str());
+      break;
+    }
+
+    for (size_t i = fds.size(); i-- > 0; ) {
+      if (fds[i].revents == 0) continue;
+
+      int so_error = 0;
+      if (so_->connect_non_blocking_status(fds[i].fd, so_error) == 0) {
+        reachable[servers[i]] = true;
+        so_->shutdown(fds[i].fd);
+      }
+      so_->close(fds[i].fd);
+      fds.erase(fds.begin() + static_cast<std::ptrdiff_t>(i));
+      servers.erase(servers.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+  }
+
+  // servers that did not answer in time stay unreachable
+  for (const auto& fd : fds) {
+    so_->close(fd.fd);
+  }
+
+  return reachable;
+}
+
+int RoutingSockOps::connect_to_addresses(const mysql_harness::ResolverCache::Addresses& addresses,
+                                         const std::string& name, std::chrono::milliseconds connect_timeout,
+                                         const SocketOptions& options, bool& timeout_expired) noexcept {
+  using clock = std::chrono::steady_clock;
+  struct Attempt {
+    int sock;
+    clock::time_point deadline;
+  };
+
+  timeout_expired = false;
+
+  const auto candidates = interleave_address_families(addresses);
+  auto next_candidate = candidates.cbegin();
+  std::vector<Attempt> attempts;
+  clock::time_point next_attempt_at = clock::now();
   int sock = routing::kInvalidSocket;
 
-  for (info = servinfo; info != nullptr; info = info->ai_next) {
-    if ((sock = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol)) == -1) {
-      log_error("Failed opening socket: %s", get_message_error(so_->get_errno()).c_str());
-    } else {
-      bool connection_is_good = true;
+  while (sock == routing::kInvalidSocket && (next_candidate != candidates.cend() || !attempts.empty())) {
+    auto now = clock::now();
 
-      set_socket_blocking(sock, false);
+    // the next address gets its chance once the pending attempts had their head start
+    if (next_candidate != candidates.cend() && (attempts.empty() || now >= next_attempt_at)) {
+      const ResolvedAddress* address = *next_candidate++;
 
-      if (::connect(sock, info->ai_addr, info->ai_addrlen) < 0) {
-        switch (so_->get_errno()) {
+      int attempt_sock = open_socket(*address, options);
+      if (attempt_sock == routing::kInvalidSocket) continue;
+
+      if (::connect(attempt_sock, reinterpret_cast<const struct sockaddr*>(&address->addr), address->addrlen) == 0) {
+        // everything is fine, we are connected
+        sock = attempt_sock;
+        break;
+      }
+
+      switch (so_->get_errno()) {
 #ifdef _WIN32
-          case WSAEINPROGRESS:
-          case WSAEWOULDBLOCK:
+        case WSAEINPROGRESS:
+        case WSAEWOULDBLOCK:
 #else
-          case EINPROGRESS:
+        case EINPROGRESS:
 #endif
-            if (0 != so_->connect_non_blocking_wait(sock, connect_timeout_ms)) {
-              log_warning("Timeout reached trying to connect to MySQL Server %s: %s", addr.str().c_str(), get_message_error(so_->get_errno()).c_str());
-              connection_is_good = false;
-              timeout_expired = (so_->get_errno() == ETIMEDOUT);
-              break;
-            }
-
-            {
-              int so_error = 0;
-              if (0 != so_->connect_non_blocking_status(sock, so_error)) {
-                connection_is_good = false;
-                break;
-              }
-            }
-
-            // success, we can continue
-            break;
-          default:
-            log_debug("Failed connect() to %s: %s", addr.str().c_str(), get_message_error(so_->get_errno()).c_str());
-            connection_is_good = false;
-            break;
+          attempts.push_back({attempt_sock, now + connect_timeout});
+          next_attempt_at = now + kConnectionAttemptDelay;
+          break;
+        default:
+          log_debug("Failed connect() to %s: %s", name.c_str(), get_message_error(so_->get_errno()).c_str());
+          so_->close(attempt_sock);
+          continue;
+      }
+    }
+
+    // wait for any of the pending attempts, at most until the next one is due
+    clock::time_point wait_until = attempts.front().deadline;
+    for (const auto& attempt : attempts) {
+      wait_until = std::min(wait_until, attempt.deadline);
+    }
+    if (next_candidate != candidates.cend()) {
+      wait_until = std::min(wait_until, next_attempt_at);
+    }
+
+    std::vector<struct pollfd> fds;
+    fds.reserve(attempts.size());
+    for (const auto& attempt : attempts) {
+      fds.push_back({attempt.sock, POLLOUT, 0});
+    }
+
+    // rounded up, waking up before the deadline would only poll again
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wait_until - now);
+    if (now + wait < wait_until) wait += std::chrono::milliseconds(1);
+    if (so_->poll(fds.data(), static_cast<nfds_t>(fds.size()), std::max(wait, std::chrono::milliseconds(0))) < 0) {
+      if (so_->get_errno() == EINTR) continue;
+
+      log_error("poll() failed while connecting to %s: %s", name.c_str(), get_message_error(so_->get_errno()).c_str());
+      break;
+    }
+
+    now = clock::now();
+    for (size_t i = fds.size(); i-- > 0; ) {
+      if (fds[i].revents != 0) {
+        int so_error = 0;
+        if (so_->connect_non_blocking_status(fds[i].fd, so_error) == 0) {
+          if (sock == routing::kInvalidSocket) {
+            sock = fds[i].fd;
+          } else {
+            // another attempt won already
+            so_->close(fds[i].fd);
+          }
+        } else {
+          log_debug("Failed connect() to %s: %s", name.c_str(), get_message_error(so_error).c_str());
+          so_->close(fds[i].fd);
         }
+      } else if (now >= attempts[i].deadline) {
+        // logged for every client connection while a server is unreachable
+        static mysql_harness::logging::LogRateLimiter log_limiter;
+        log_warning_limited(log_limiter, "Timeout reached trying to connect to MySQL Server %s", name.c_str());
+        timeout_expired = true;
+        so_->close(fds[i].fd);
       } else {
-        // everything is fine, we are connected
+        continue;
       }
+      attempts.erase(attempts.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+  }
 
-      if (connection_is_good) {
-        break;
-      }
+  // cancel the attempts that lost the race
+  for (const auto& attempt : attempts) {
+    so_->close(attempt.sock);
+  }
 
-      // some error, close the socket again and try the next one
-      so_->close(sock);
+  return sock;
+}
+
+int RoutingSockOps::get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds connect_timeout_ms, bool log,
+                                     const SocketOptions& options) noexcept {
+  bool timeout_expired = false;
+
+  // cached, connecting doesn't wait for the resolver once the name is known
+  mysql_harness::ResolverCache::Addresses addresses;
+  int err;
+  if ((err = resolve_destination(addr, addresses)) != 0) {
+    if (log) {
+#ifndef _WIN32
+      std::string errstr{(err == EAI_SYSTEM) ? get_message_error(so_->get_errno()) : gai_strerror(err)};
+#else
+      std::string errstr = get_message_error(err);
+#endif
+      log_debug("Failed getting address information for '%s' (%s)", addr.addr.c_str(), errstr.c_str());
     }
+    return -1;
   }
 
-  if (info == nullptr) {
+  int sock = connect_to_addresses(addresses, addr.str(), connect_timeout_ms, options, timeout_expired);
+  if (sock == routing::kInvalidSocket) {
     // all connects failed.
     return timeout_expired ? -2 : -1;
   }
 
+  return prepare_connected_socket(sock, addr);
+}
+
+int RoutingSockOps::open_socket(const ResolvedAddress& address, const SocketOptions& options) noexcept {
+  int sock;
+  if ((sock = ::socket(address.family, address.socktype, address.protocol)) == -1) {
+    log_error("Failed opening socket: %s", get_message_error(so_->get_errno()).c_str());
+    return routing::kInvalidSocket;
+  }
+
+  // set before connecting, the window scaling is negotiated with the SYN
+  set_socket_option(sock, SOL_SOCKET, SO_RCVBUF, options.rcvbuf, "SO_RCVBUF");
+  set_socket_option(sock, SOL_SOCKET, SO_SNDBUF, options.sndbuf, "SO_SNDBUF");
+  // a server that dies without a RST gets noticed in seconds, not hours
+  if (address.family != AF_UNIX) {
+    for (const auto& option : get_dead_peer_socket_options(options)) {
+      set_socket_option(sock, option.level, option.option,
+                        static_cast<unsigned int>(option.value), option.name);
+    }
+  }
+
+#ifdef IP_LOCAL_PORT_RANGE
+  if (address.family != AF_UNIX && options.source_port_low > 0) {
+    set_socket_option(sock, IPPROTO_IP, IP_LOCAL_PORT_RANGE,
+                      (static_cast<unsigned int>(options.source_port_high) << 16) | options.source_port_low,
+                      "IP_LOCAL_PORT_RANGE");
+  }
+#endif
+
+  const mysql_harness::ResolverCache::Address* source =
+      options.source_addresses ? options.source_addresses->next(address.family) : nullptr;
+  if (source != nullptr) {
+#ifdef IP_BIND_ADDRESS_NO_PORT
+    // the port gets picked by connect(), for the server's address: every
+    // server has all ephemeral ports of the source address
+    set_socket_option(sock, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, 1, "IP_BIND_ADDRESS_NO_PORT");
+#endif
+    if (::bind(sock, reinterpret_cast<const struct sockaddr*>(&source->addr), source->addrlen) == -1) {
+      // logged for every client connection while the address can't be used
+      static mysql_harness::logging::LogRateLimiter log_limiter;
+      log_error_limited(log_limiter, "Failed binding to source address: %s",
+                        get_message_error(so_->get_errno()).c_str());
+      so_->close(sock);
+      return routing::kInvalidSocket;
+    }
+  }
+
+  set_socket_blocking(sock, false);
+
+  return sock;
+}
+
+int RoutingSockOps::prepare_connected_socket(int sock, const mysql_harness::TCPAddress& addr) noexcept {
   // set blocking; MySQL protocol is blocking and we do not take advantage of
   // any non-blocking possibilities
   set_socket_blocking(sock, true);
 
+  // no Nagle on unix sockets
+  if (is_unix_socket(addr)) return sock;
+
   int opt_nodelay = 1;
   if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
                  reinterpret_cast<const char*>(&opt_nodelay), // cast keeps Windows happy (const void* on Unix)
@@ -238,4 +628,148 @@ int RoutingSockOps::get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono
   return sock;
 }
 
+int RoutingSockOps::get_mysql_socket_hedged(const std::vector<mysql_harness::TCPAddress>& addrs,
+                                            std::chrono::milliseconds connect_timeout,
+                                            std::chrono::milliseconds hedge_delay, bool wait_for_greeting,
+                                            const SocketOptions& options, size_t& connected) noexcept {
+  using clock = std::chrono::steady_clock;
+  struct Attempt {
+    int sock;
+    size_t server;
+    // connected, waiting for the greeting
+    bool greeting;
+    clock::time_point deadline;
+  };
+
+  bool timeout_expired = false;
+  size_t next_server = 0;
+  std::vector<Attempt> attempts;
+  clock::time_point next_attempt_at = clock::now();
+  int sock = routing::kInvalidSocket;
+
+  while (sock == routing::kInvalidSocket && (next_server < addrs.size() || !attempts.empty())) {
+    auto now = clock::now();
+
+    // the next server gets its chance once the pending connects had their head start
+    if (next_server < addrs.size() && (attempts.empty() || now >= next_attempt_at)) {
+      const size_t server = next_server++;
+
+      mysql_harness::ResolverCache::Addresses addresses;
+      if (resolve_destination(addrs[server], addresses) != 0 || addresses.empty()) {
+        log_debug("Failed getting address information for '%s'", addrs[server].addr.c_str());
+        continue;
+      }
+      const ResolvedAddress* address = interleave_address_families(addresses).front();
+
+      int attempt_sock = open_socket(*address, options);
+      if (attempt_sock == routing::kInvalidSocket) continue;
+
+      // connected right away, the poll() below tells about it nevertheless
+      if (::connect(attempt_sock, reinterpret_cast<const struct sockaddr*>(&address->addr), address->addrlen) != 0) {
+        switch (so_->get_errno()) {
+#ifdef _WIN32
+          case WSAEINPROGRESS:
+          case WSAEWOULDBLOCK:
+#else
+          case EINPROGRESS:
+#endif
+            break;
+          default:
+            log_debug("Failed connect() to %s: %s", addrs[server].str().c_str(),
+                      get_message_error(so_->get_errno()).c_str());
+            so_->close(attempt_sock);
+            continue;
+        }
+      }
+      attempts.push_back({attempt_sock, server, false, now + connect_timeout});
+      next_attempt_at = now + hedge_delay;
+    }
+
+    // wait for any of the pending connects, at most until the next one is due
+    clock::time_point wait_until = attempts.front().deadline;
+    for (const auto& attempt : attempts) {
+      wait_until = std::min(wait_until, attempt.deadline);
+    }
+    if (next_server < addrs.size()) {
+      wait_until = std::min(wait_until, next_attempt_at);
+    }
+
+    std::vector<struct pollfd> fds;
+    fds.reserve(attempts.size());
+    for (const auto& attempt : attempts) {
+      fds.push_back({attempt.sock, static_cast<short>(attempt.greeting ? POLLIN : POLLOUT), 0});
+    }
+
+    // rounded up, waking up before the deadline would only poll again
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wait_until - now);
+    if (now + wait < wait_until) wait += std::chrono::milliseconds(1);
+    if (so_->poll(fds.data(), static_cast<nfds_t>(fds.size()), std::max(wait, std::chrono::milliseconds(0))) < 0) {
+      if (so_->get_errno() == EINTR) continue;
+
+      log_error("poll() failed while connecting to %s: %s", addrs.front().str().c_str(),
+                get_message_error(so_->get_errno()).c_str());
+      break;
+    }
+
+    now = clock::now();
+    for (size_t i = fds.size(); i-- > 0; ) {
+      Attempt& attempt = attempts[i];
+      const std::string name = addrs[attempt.server].str();
+      if (fds[i].revents != 0 && !attempt.greeting) {
+        int so_error = 0;
+        if (so_->connect_non_blocking_status(fds[i].fd, so_error) == 0) {
+          if (wait_for_greeting) {
+            attempt.greeting = true;
+            continue;
+          }
+          if (sock == routing::kInvalidSocket) {
+            sock = fds[i].fd;
+            connected = attempt.server;
+          } else {
+            // another server won already
+            so_->close(fds[i].fd);
+          }
+        } else {
+          log_debug("Failed connect() to %s: %s", name.c_str(), get_message_error(so_error).c_str());
+          so_->close(fds[i].fd);
+          // no need to wait for the head start of a server that failed
+          next_attempt_at = now;
+        }
+      } else if (fds[i].revents != 0) {
+        // a server closing the connection lost, even if it sent an error first
+        if ((fds[i].revents & (POLLERR | POLLHUP)) == 0 && sock == routing::kInvalidSocket) {
+          sock = fds[i].fd;
+          connected = attempt.server;
+        } else {
+          if ((fds[i].revents & (POLLERR | POLLHUP)) != 0) {
+            log_debug("%s closed the connection before sending the greeting", name.c_str());
+            next_attempt_at = now;
+          }
+          so_->close(fds[i].fd);
+        }
+      } else if (now >= attempt.deadline) {
+        // logged for every client connection while a server is unreachable
+        static mysql_harness::logging::LogRateLimiter log_limiter;
+        log_warning_limited(log_limiter, "Timeout reached trying to connect to MySQL Server %s", name.c_str());
+        timeout_expired = true;
+        so_->close(fds[i].fd);
+      } else {
+        continue;
+      }
+      attempts.erase(attempts.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+  }
+
+  // cancel the connects that lost the race
+  for (const auto& attempt : attempts) {
+    so_->close(attempt.sock);
+  }
+
+  if (sock == routing::kInvalidSocket) {
+    return timeout_expired ? -2 : -1;
+  }
+
+  return prepare_connected_socket(sock, addrs[connected]);
+}
+
 } // routing
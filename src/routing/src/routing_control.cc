@@ -0,0 +1,66 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysqlrouter/routing_control.h"
+
+RoutingControlComponent &RoutingControlComponent::getInstance() {
+  static RoutingControlComponent instance;
+
+  return instance;
+}
+
+void RoutingControlComponent::register_route(const std::string &name, RouteControl *control) {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+  routes_[name] = control;
+}
+
+void RoutingControlComponent::unregister_route(const std::string &name) {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+  routes_.erase(name);
+}
+
+std::vector<std::string> RoutingControlComponent::get_route_names() {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+
+  std::vector<std::string> names;
+  for (const auto &route: routes_) {
+    names.push_back(route.first);
+  }
+
+  return names;
+}
+
+bool RoutingControlComponent::with_route(const std::string &name, const std::function<void(RouteControl &)> &func) {
+  // held while func runs, unregister_route() waits for it
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+
+  auto it = routes_.find(name);
+  if (it == routes_.end()) {
+    return false;
+  }
+
+  func(*it->second);
+
+  return true;
+}
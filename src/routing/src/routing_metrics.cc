@@ -0,0 +1,176 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/routing_metrics.h"
+
+#include <algorithm>
+#include <utility>
+
+constexpr size_t RoutingMetrics::kShards;
+constexpr size_t RoutingMetrics::kLatencies;
+constexpr size_t RoutingMetrics::kTimeouts;
+constexpr size_t RoutingMetrics::kLatencyBuckets;
+
+struct RoutingMetrics::Shard {
+  std::atomic<uint64_t> connections_opened{0};
+  std::atomic<uint64_t> connections_closed{0};
+  std::atomic<uint64_t> bytes_up{0};
+  std::atomic<uint64_t> bytes_down{0};
+  std::atomic<uint64_t> connect_errors{0};
+  std::atomic<uint64_t> connection_errors{0};
+  std::atomic<uint64_t> timeouts[kTimeouts];
+  std::atomic<uint64_t> latency_sum_us[kLatencies];
+  std::atomic<uint64_t> latency_histogram[kLatencies][kLatencyBuckets];
+
+  // keeps the counters of the next shard off our cache lines
+  char padding[64];
+
+  Shard() {
+    for (auto &count: timeouts) count.store(0, std::memory_order_relaxed);
+    for (auto &sum: latency_sum_us) sum.store(0, std::memory_order_relaxed);
+    for (auto &histogram: latency_histogram) {
+      for (auto &bucket: histogram) bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+RoutingMetrics::RoutingMetrics(): shards_(new Shard[kShards]) {}
+
+RoutingMetrics::~RoutingMetrics() = default;
+
+RoutingMetrics::Shard &RoutingMetrics::shard() noexcept {
+  static std::atomic<size_t> next_shard{0};
+  // threads take the shards round-robin, in the order they first use one
+  thread_local const size_t ndx = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+
+  return shards_[ndx];
+}
+
+void RoutingMetrics::connection_opened() noexcept {
+  shard().connections_opened.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoutingMetrics::connection_closed(uint64_t bytes_up, uint64_t bytes_down) noexcept {
+  Shard &s = shard();
+  s.connections_closed.fetch_add(1, std::memory_order_relaxed);
+  s.bytes_up.fetch_add(bytes_up, std::memory_order_relaxed);
+  s.bytes_down.fetch_add(bytes_down, std::memory_order_relaxed);
+}
+
+void RoutingMetrics::add_latency(Latency what, std::chrono::microseconds latency) noexcept {
+  const uint64_t latency_us = static_cast<uint64_t>(std::max(latency.count(),
+                                                             std::chrono::microseconds::rep{0}));
+  const size_t ndx = static_cast<size_t>(what);
+  Shard &s = shard();
+  s.latency_sum_us[ndx].fetch_add(latency_us, std::memory_order_relaxed);
+
+  size_t bucket = 0;
+  while (bucket + 1 < kLatencyBuckets &&
+         latency_us >= static_cast<uint64_t>(latency_bucket_bound(bucket).count())) ++bucket;
+  s.latency_histogram[ndx][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoutingMetrics::connect_failed() noexcept {
+  shard().connect_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoutingMetrics::connection_failed() noexcept {
+  shard().connection_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoutingMetrics::timed_out(Timeout what) noexcept {
+  shard().timeouts[static_cast<size_t>(what)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoutingMetrics::set_quarantined(const std::string &address, bool quarantined) {
+  std::lock_guard<std::mutex> lock(quarantined_mtx_);
+  quarantined_[address] = quarantined;
+}
+
+void RoutingMetrics::set_buffer_pool_source(std::function<BufferPoolCounters()> source) {
+  std::lock_guard<std::mutex> lock(buffer_pool_mtx_);
+  buffer_pool_source_ = std::move(source);
+}
+
+RoutingMetrics::Snapshot RoutingMetrics::get_snapshot() const {
+  Snapshot snapshot{};
+  uint64_t closed = 0;
+
+  for (size_t i = 0; i < kShards; ++i) {
+    const Shard &s = shards_[i];
+    snapshot.connections_total += s.connections_opened.load(std::memory_order_relaxed);
+    closed += s.connections_closed.load(std::memory_order_relaxed);
+    snapshot.bytes_up += s.bytes_up.load(std::memory_order_relaxed);
+    snapshot.bytes_down += s.bytes_down.load(std::memory_order_relaxed);
+    snapshot.connect_errors += s.connect_errors.load(std::memory_order_relaxed);
+    snapshot.connection_errors += s.connection_errors.load(std::memory_order_relaxed);
+    for (size_t t = 0; t < kTimeouts; ++t) {
+      snapshot.timeouts[t] += s.timeouts[t].load(std::memory_order_relaxed);
+    }
+    for (size_t l = 0; l < kLatencies; ++l) {
+      Snapshot::Histogram &histogram = snapshot.latencies[l];
+      histogram.sum_us += s.latency_sum_us[l].load(std::memory_order_relaxed);
+      for (size_t b = 0; b < kLatencyBuckets; ++b) {
+        const uint64_t count = s.latency_histogram[l][b].load(std::memory_order_relaxed);
+        histogram.buckets[b] += count;
+        histogram.count += count;
+      }
+    }
+  }
+  // a close may be summed up before the open of its connection
+  snapshot.connections_active = snapshot.connections_total > closed ? snapshot.connections_total - closed : 0;
+
+  {
+    std::lock_guard<std::mutex> lock(quarantined_mtx_);
+    snapshot.quarantined = quarantined_;
+  }
+
+  std::lock_guard<std::mutex> lock(buffer_pool_mtx_);
+  if (buffer_pool_source_) snapshot.buffer_pool = buffer_pool_source_();
+
+  return snapshot;
+}
+
+RoutingMetricsComponent &RoutingMetricsComponent::getInstance() {
+  static RoutingMetricsComponent instance;
+
+  return instance;
+}
+
+void RoutingMetricsComponent::register_route(const std::string &name, std::shared_ptr<RoutingMetrics> metrics) {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+  routes_[name] = metrics;
+}
+
+void RoutingMetricsComponent::unregister_route(const std::string &name) {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+  routes_.erase(name);
+}
+
+std::map<std::string, std::shared_ptr<RoutingMetrics>> RoutingMetricsComponent::get_routes() {
+  std::lock_guard<std::mutex> lock(routes_mtx_);
+
+  return routes_;
+}
@@ -31,10 +31,14 @@
 
 #include "mysql/harness/logging/logging.h"
 #include "mysql/harness/config_parser.h"
+#include "mysql/harness/readiness.h"
+#include "mysql/harness/reconfiguration.h"
 
+#include <algorithm>
 #include <atomic>
 #include <iostream>
 #include <mutex>
+#include <set>
 #include <vector>
 
 using mysql_harness::AppInfo;
@@ -42,6 +46,7 @@ using mysql_harness::ConfigSection;
 using mysql_harness::TCPAddress;
 using mysqlrouter::URI;
 using mysqlrouter::URIError;
+using mysqlrouter::URIParser;
 using std::string;
 IMPORT_LOG_FUNCTIONS()
 
@@ -106,6 +111,15 @@ void validate_socket_info_test_proxy(const std::string& err_prefix, const mysql_
   validate_socket_info(err_prefix, section, config);
 }
 
+// checks a reloaded section like init() checks the configured ones
+static void validate_section(const mysql_harness::ConfigSection &section) {
+  string err_prefix = mysqlrouter::string_format("in [%s%s%s]: ", section.name.c_str(),
+                                                 section.key.empty() ? "" : ":",
+                                                 section.key.c_str());
+  RoutingPluginConfig config(&section);                // throws std::invalid_argument
+  validate_socket_info(err_prefix, &section, config);  // throws std::invalid_argument
+}
+
 static void init(mysql_harness::PluginFuncEnv* env) {
   const mysql_harness::AppInfo* info = get_app_info(env);
 
@@ -148,15 +162,36 @@ static void init(mysql_harness::PluginFuncEnv* env) {
           }
 
 
+          // the route reports being ready once it got started
+          mysql_harness::Readiness::instance().expect(
+              section->key.empty() ? section->name : section->name + ":" + section->key);
+
           // We check if we need special plugins based on URI
           try {
-            auto uri = URI(config.destinations, false);
-            if (uri.scheme == "metadata-cache") {
+            auto uri = URIParser::parse_view(config.destinations, false);
+            if (uri.has_scheme("metadata-cache")) {
               need_metadata_cache = true;
             }
           } catch (URIError&) {
             // No URI, no extra plugin needed
           }
+          for (const auto &entry : HandshakeRouter::parse_route_map(config.route_map)) {
+            try {
+              if (URIParser::parse_view(entry.second, false).has_scheme("metadata-cache")) {
+                need_metadata_cache = true;
+              }
+            } catch (URIError&) {
+            }
+          }
+          for (const auto &entry : HandshakeRouter::parse_route_map(config.query_route_map,
+                                                                    "query_route_map")) {
+            try {
+              if (URIParser::parse_view(entry.second, false).has_scheme("metadata-cache")) {
+                need_metadata_cache = true;
+              }
+            } catch (URIError&) {
+            }
+          }
         } else if (section->name == "metadata_cache") {
           have_metadata_cache = true;
         }
@@ -168,6 +203,8 @@ static void init(mysql_harness::PluginFuncEnv* env) {
       }
     }
     g_app_info = info;
+    // a reload keeps the running route if its changed section is invalid
+    mysql_harness::Reconfiguration::instance().set_validator(kSectionName, validate_section);
   } catch (const std::invalid_argument& exc) {
     log_error("%s", exc.what());  // TODO remove after Loader starts logging
     set_error(env, mysql_harness::kConfigInvalidArgument, "%s", exc.what());
@@ -180,6 +217,78 @@ static void init(mysql_harness::PluginFuncEnv* env) {
   }
 }
 
+// applies a reloaded section to the running route, if only options changed
+// that the route can take while running
+static bool reconfigure_route(const std::string &name,
+                              const mysql_harness::ConfigSection *running,
+                              const mysql_harness::ConfigSection &fresh) {
+  static const std::set<std::string> kRuntimeOptions{
+      "max_connections", "net_buffer_length", "destinations"};
+
+  std::set<std::string> changed;
+  for (const auto &option : running->get_options()) {
+    if (!fresh.has(option.first) || fresh.get(option.first) != option.second)
+      changed.insert(option.first);
+  }
+  for (const auto &option : fresh.get_options()) {
+    if (!running->has(option.first))
+      changed.insert(option.first);
+  }
+  for (const std::string &option : changed) {
+    if (kRuntimeOptions.count(option) == 0) {
+      log_info("%s: option '%s' changed, restarting the route", name.c_str(), option.c_str());
+      return false;
+    }
+  }
+
+  RouteSettingsChange change;
+  try {
+    RoutingPluginConfig config(&fresh);
+
+    change.change_max_connections = changed.count("max_connections") != 0;
+    change.max_connections = config.max_connections;
+    change.change_net_buffer_length = changed.count("net_buffer_length") != 0;
+    change.net_buffer_length = config.net_buffer_length;
+
+    if (changed.count("destinations")) {
+      // the metadata-cache keeps the destinations of its routes up to date
+      if (!routing::is_unix_socket_destination(config.destinations)) {
+        try {
+          URIParser::parse_view(config.destinations, false);
+          return false;
+        } catch (URIError &) {
+        }
+      }
+      change.change_destinations = true;
+      for (std::string destination : mysqlrouter::split_string(config.destinations, ',', false)) {
+        mysqlrouter::trim(destination);
+        change.destinations.push_back(destination);
+      }
+    }
+  } catch (const std::invalid_argument &exc) {
+    log_warning("%s", exc.what());
+    return false;
+  }
+
+  bool applied = false;
+  if (!RoutingControlComponent::getInstance().with_route(name, [&](RouteControl &control) {
+        try {
+          control.change_settings(change);
+          applied = true;
+        } catch (const std::invalid_argument &exc) {
+          log_warning("%s: %s", name.c_str(), exc.what());
+        }
+      })) {
+    return false;
+  }
+
+  return applied;
+}
+
+static void deinit(mysql_harness::PluginFuncEnv*) {
+  mysql_harness::Reconfiguration::instance().remove_validator(kSectionName);
+}
+
 static void start(mysql_harness::PluginFuncEnv* env) {
   const mysql_harness::ConfigSection* section = get_config_section(env);
 
@@ -213,13 +322,104 @@ static void start(mysql_harness::PluginFuncEnv* env) {
                    routing::kDefaultNetBufferLength,
                    routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance()),
                    config.thread_stack_size);
-
-    try {
-      // don't allow rootless URIs as we did already in the get_option_destinations()
-      r.set_destinations_from_uri(URI(config.destinations, false));
-    } catch (URIError&) {
+    r.set_share_connect_errors(config.share_connect_errors);
+    r.set_connect_deadline(std::chrono::seconds(config.connect_deadline));
+    r.set_io_engine(config.io_engine, config.io_threads);
+    r.set_io_uring(config.io_uring);
+    r.set_fair_share(config.fair_share_quantum, uint64_t{config.max_bandwidth} * 1024);
+    r.set_splice(config.splice);
+    r.set_buffer_pool_size(config.buffer_pool_size);
+    r.set_max_net_buffer_length(config.max_net_buffer_length);
+    r.set_connection_pool(config.connection_pool_size,
+                          std::chrono::seconds(config.connection_pool_idle_timeout));
+    r.set_acceptor_threads(config.acceptor_threads);
+    routing::SocketOptions socket_options;
+    socket_options.tcp_fastopen = config.tcp_fastopen;
+    socket_options.tcp_defer_accept = config.tcp_defer_accept;
+    socket_options.rcvbuf = config.socket_rcvbuf;
+    socket_options.sndbuf = config.socket_sndbuf;
+    socket_options.keepalive = config.tcp_keepalive;
+    socket_options.keepalive_idle = config.tcp_keepalive_idle;
+    socket_options.keepalive_interval = config.tcp_keepalive_interval;
+    socket_options.keepalive_count = config.tcp_keepalive_count;
+    socket_options.user_timeout = config.tcp_user_timeout;
+    socket_options.source_addresses = config.source_addresses;
+    socket_options.source_port_low = config.source_port_range.first;
+    socket_options.source_port_high = config.source_port_range.second;
+    r.set_socket_options(socket_options);
+    r.set_output_queue_watermarks(config.output_queue_high_watermark,
+                                  config.output_queue_low_watermark);
+    r.set_zero_copy_threshold(config.zero_copy_threshold);
+    r.set_buffer_huge_pages(config.buffer_huge_pages);
+    r.set_connection_multiplexing(config.connection_multiplexing);
+    r.set_prepared_statement_cache_size(config.prepared_statement_cache_size);
+    r.set_session_migration(config.session_migration);
+    r.set_client_tls(config.client_ssl_cert, config.client_ssl_key);
+    r.set_client_kernel_tls(config.client_ssl_kernel_tls);
+    r.set_server_compression(config.server_compression);
+    r.set_query_digest_sampling(config.query_digest_sampling);
+    r.set_traffic_mirror(config.mirror_destination, config.mirror_buffer_size, config.mirror_timing);
+    r.set_result_cache(config.result_cache_size, std::chrono::milliseconds(config.result_cache_ttl),
+                       config.result_cache_statements);
+    r.set_destination_weights(config.destination_weights);
+    r.set_latency_tolerance(std::chrono::milliseconds(config.latency_tolerance));
+    r.set_connect_hedging(config.connect_hedge_percentile);
+    r.set_destination_limits(config.max_connections_per_destination,
+                             std::chrono::milliseconds(config.slow_start_window));
+    r.set_circuit_breaker(config.circuit_breaker_failures,
+                          std::chrono::milliseconds(config.circuit_breaker_open_interval),
+                          config.circuit_breaker_half_open_connections);
+    r.set_connection_trace(config.connection_trace);
+    r.set_cpu_affinity(config.cpu_affinity);
+    r.set_connection_thread_stack_size(config.connection_thread_stack_size);
+    r.set_quarantine_interval(std::chrono::milliseconds(config.quarantine_interval),
+                              std::chrono::milliseconds(config.quarantine_max_interval));
+    r.set_drain_timeout(std::chrono::seconds(config.drain_timeout));
+    r.set_admission_queue(config.admission_queue_size,
+                          std::chrono::milliseconds(config.admission_queue_timeout));
+    r.set_warm_connections(config.warm_connections,
+                           std::chrono::milliseconds(config.warm_connection_max_age));
+    ClientLimits::Settings client_limits;
+    client_limits.rate = config.client_connection_rate;
+    client_limits.burst = std::max(config.client_connection_burst > 0 ? config.client_connection_burst
+                                                                      : config.client_connection_rate, 1u);
+    client_limits.max_connections = config.client_max_connections;
+    client_limits.ipv4_prefix = config.client_limit_ipv4_prefix;
+    client_limits.ipv6_prefix = config.client_limit_ipv6_prefix;
+    r.set_client_limits(client_limits);
+    r.set_connection_budget(config.connection_budget, config.connection_budget_reserved,
+                            config.connection_budget_weight);
+    r.set_priority_lane(config.priority_clients, config.priority_connections);
+    r.set_connection_timeouts(std::chrono::seconds(config.idle_timeout),
+                              std::chrono::seconds(config.max_connection_lifetime));
+    r.set_handoff_socket(config.handoff_socket);
+    r.set_destination_sockets(config.destination_sockets);
+    r.set_proxy_protocol(config.proxy_protocol, std::chrono::milliseconds(config.proxy_protocol_timeout),
+                         config.proxy_protocol_trusted_sources, config.server_proxy_protocol);
+
+    if (routing::is_unix_socket_destination(config.destinations)) {
+      // would parse as URI too
       r.set_destinations_from_csv(config.destinations);
+    } else {
+      try {
+        // don't allow rootless URIs as we did already in the get_option_destinations()
+        r.set_destinations_from_uri(URI(config.destinations, false));
+      } catch (URIError&) {
+        r.set_destinations_from_csv(config.destinations);
+      }
     }
+    r.set_route_by(config.route_by, config.route_map);
+    r.set_query_route_map(config.query_route_map);
+
+    // changes the route itself while it runs, the loader restarts it otherwise
+    mysql_harness::Reconfiguration::instance().set_handler(
+        section->name, section->key, [name, section](const mysql_harness::ConfigSection &fresh) {
+          return reconfigure_route(name, section, fresh);
+        });
+    std::shared_ptr<void> exit_guard(nullptr, [section](void *) {
+      mysql_harness::Reconfiguration::instance().remove_handler(section->name, section->key);
+    });
+
     r.start(env);
   } catch (const std::invalid_argument &exc) {
     log_error("%s", exc.what());  // TODO remove after Loader starts logging
@@ -242,7 +442,7 @@ extern "C" {
       0, nullptr, // requires
       0, nullptr, // Conflicts
       init,       // init
-      nullptr,    // deinit
+      deinit,     // deinit
       start,      // start
       nullptr     // stop
   };
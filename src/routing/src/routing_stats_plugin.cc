@@ -0,0 +1,210 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * routing_stats Plugin
+ *
+ * Publishes the counters of the routes, their destinations and the metadata
+ * cache to a memory mapped file, see mysqlrouter/routing_stats_segment.h.
+ *
+ * [routing_stats]
+ * file = /run/mysqlrouter/stats
+ * interval = 100
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Harness interface include files
+#include "mysql/harness/config_parser.h"
+#include "mysql/harness/logging/logging.h"
+#include "mysql/harness/plugin.h"
+
+#include "mysqlrouter/metadata_cache.h"
+#include "mysqlrouter/routing_control.h"
+#include "mysqlrouter/routing_metrics.h"
+#include "mysqlrouter/routing_stats_segment.h"
+
+using mysql_harness::ARCHITECTURE_DESCRIPTOR;
+using mysql_harness::ConfigSection;
+using mysql_harness::PluginFuncEnv;
+using mysql_harness::PLUGIN_ABI_VERSION;
+using mysql_harness::Plugin;
+using mysql_harness::logging::log_error;
+using mysql_harness::logging::log_info;
+
+namespace {
+
+/** @brief milliseconds between two updates of the segment */
+const unsigned long kDefaultInterval = 100;
+const unsigned long kMinInterval = 10;
+const unsigned long kMaxInterval = 60000;
+
+/** @brief interval option of the section, throws std::invalid_argument if it is out of range */
+unsigned long get_interval(const ConfigSection *section) {
+  if (!section->has("interval")) return kDefaultInterval;
+
+  const std::string value = section->get("interval");
+  char *end = nullptr;
+  const unsigned long interval = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || value[0] == '-' || interval < kMinInterval || interval > kMaxInterval) {
+    throw std::invalid_argument("option interval in [routing_stats] needs to be between " +
+                                std::to_string(kMinInterval) + " and " + std::to_string(kMaxInterval) +
+                                ", got '" + value + "'");
+  }
+  return interval;
+}
+
+void collect_routes(routing_stats::Segment &state) {
+  using routing_stats::RouteStats;
+  using routing_stats::SegmentWriter;
+
+  state.routes_count = 0;
+  for (const auto &route: RoutingMetricsComponent::getInstance().get_routes()) {
+    if (state.routes_count == routing_stats::kMaxRoutes) break;
+
+    const RoutingMetrics::Snapshot s = route.second->get_snapshot();
+    RouteStats &stats = state.routes[state.routes_count++];
+    SegmentWriter::set_name(stats.name, route.first);
+    stats.connections_total = s.connections_total;
+    stats.connections_active = s.connections_active;
+    stats.bytes_up = s.bytes_up;
+    stats.bytes_down = s.bytes_down;
+    stats.connect_errors = s.connect_errors;
+    stats.connection_errors = s.connection_errors;
+    stats.handshake_timeouts = RoutingMetrics::timeouts(s, RoutingMetrics::Timeout::kHandshake);
+    stats.idle_timeouts = RoutingMetrics::timeouts(s, RoutingMetrics::Timeout::kIdle);
+    stats.lifetime_timeouts = RoutingMetrics::timeouts(s, RoutingMetrics::Timeout::kLifetime);
+
+    stats.destinations_count = 0;
+    RoutingControlComponent::getInstance().with_route(route.first, [&stats](RouteControl &control) {
+      for (const auto &score: control.get_destination_scores()) {
+        if (stats.destinations_count == routing_stats::kMaxDestinations) break;
+
+        routing_stats::DestinationStats &dest = stats.destinations[stats.destinations_count++];
+        SegmentWriter::set_name(dest.address, score.address);
+        dest.connects_succeeded = score.connects_succeeded;
+        dest.connects_failed = score.connects_failed;
+        dest.active_connections = score.active_connections;
+        dest.connect_latency_us = static_cast<uint64_t>(score.connect_latency.count());
+        dest.circuit_open = score.circuit_state == "open" ? 1 : 0;
+      }
+    });
+  }
+}
+
+void collect_metadata_cache(routing_stats::MetadataCacheStats &stats) {
+  metadata_cache::RefreshStats refresh;
+  try {
+    refresh = metadata_cache::MetadataCacheAPI::instance()->get_refresh_stats();
+  } catch (const std::exception &) {
+    // no metadata cache configured
+    stats = routing_stats::MetadataCacheStats();
+    return;
+  }
+
+  stats.enabled = 1;
+  stats.refreshes = refresh.refreshes;
+  stats.refresh_failures = refresh.refresh_failures;
+  stats.last_refresh_duration_us =
+      static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+          refresh.last_refresh_duration).count());
+}
+
+}  // namespace
+
+static void init(PluginFuncEnv* env) {
+  const mysql_harness::AppInfo* info = get_app_info(env);
+
+  if (nullptr == info->config) return;
+
+  for (const ConfigSection* section: info->config->sections()) {
+    if (section->name != "routing_stats") continue;
+
+    try {
+      if (!section->has("file") || section->get("file").empty()) {
+        throw std::invalid_argument("option file in [routing_stats] is required");
+      }
+      get_interval(section);
+    } catch (const std::invalid_argument &exc) {
+      set_error(env, mysql_harness::kConfigInvalidArgument, "%s", exc.what());
+      return;
+    }
+  }
+}
+
+static void start(PluginFuncEnv* env) {
+  const ConfigSection* section = get_config_section(env);
+
+  try {
+    const std::string file = section->get("file");
+    const unsigned long interval = get_interval(section);
+
+    routing_stats::SegmentWriter writer(file);
+    log_info("routing_stats: publishing to '%s' every %lu ms", file.c_str(), interval);
+
+    // written in place and published as a whole, the segment is too large for the stack
+    std::unique_ptr<routing_stats::Segment> state(new routing_stats::Segment());
+    do {
+      collect_routes(*state);
+      collect_metadata_cache(state->metadata_cache);
+      state->updated_at_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count());
+      writer.publish(*state);
+    } while (!wait_for_stop(env, static_cast<uint32_t>(interval)));
+  } catch (const std::exception &exc) {
+    log_error("routing_stats: %s", exc.what());
+    set_error(env, mysql_harness::kRuntimeError, "%s", exc.what());
+  }
+}
+
+#if defined(_MSC_VER) && defined(routing_stats_EXPORTS)
+/* We are building this library */
+#  define DLLEXPORT __declspec(dllexport)
+#else
+#  define DLLEXPORT
+#endif
+
+static const char *plugin_requires[] = {
+  "routing",
+};
+
+extern "C" {
+Plugin DLLEXPORT harness_plugin_routing_stats = {
+  PLUGIN_ABI_VERSION,
+  ARCHITECTURE_DESCRIPTOR,
+  "ROUTING_STATS",
+  VERSION_NUMBER(0, 0, 1),
+  sizeof(plugin_requires)/sizeof(plugin_requires[0]), plugin_requires,  // requires
+  0, nullptr,  // conflicts
+  init,        // init
+  nullptr,     // deinit
+  start,       // start
+  nullptr,     // stop
+};
+}
@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/routing_stats_segment.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+namespace routing_stats {
+
+SegmentWriter::SegmentWriter(const std::string &path) : path_(path) {
+#ifndef _WIN32
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    throw std::runtime_error("open(" + path + "): " + std::strerror(errno));
+  }
+  if (::ftruncate(fd_, static_cast<off_t>(sizeof(Segment))) == -1) {
+    const int err = errno;
+    ::close(fd_);
+    throw std::runtime_error("ftruncate(" + path + "): " + std::strerror(err));
+  }
+  void *mapped = ::mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mapped == MAP_FAILED) {
+    const int err = errno;
+    ::close(fd_);
+    throw std::runtime_error("mmap(" + path + "): " + std::strerror(err));
+  }
+  segment_ = static_cast<Segment *>(mapped);
+
+  // the file is zeroed, magic and version last tell readers it is valid
+  segment_->size = sizeof(Segment);
+  segment_->version = kSegmentVersion;
+  std::atomic_thread_fence(std::memory_order_release);
+  segment_->magic = kSegmentMagic;
+#else
+  throw std::runtime_error("statistics segments are not supported on this platform");
+#endif
+}
+
+SegmentWriter::~SegmentWriter() {
+#ifndef _WIN32
+  ::munmap(segment_, sizeof(Segment));
+  ::close(fd_);
+  ::unlink(path_.c_str());
+#endif
+}
+
+void SegmentWriter::publish(const Segment &state) noexcept {
+  const size_t offset = offsetof(Segment, updated_at_us);
+  const uint64_t seq = segment_->sequence.load(std::memory_order_relaxed);
+
+  segment_->sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(reinterpret_cast<char *>(segment_) + offset, reinterpret_cast<const char *>(&state) + offset,
+              sizeof(Segment) - offset);
+  segment_->sequence.store(seq + 2, std::memory_order_release);
+}
+
+}  // namespace routing_stats
@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_SHARDED_COUNTER_INCLUDED
+#define ROUTING_SHARDED_COUNTER_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief ShardedCounter is a 64-bit counter many threads update.
+ *
+ * Like the shards of RoutingMetrics, each thread updates the shard it got
+ * assigned with relaxed atomic adds, threads don't share cache lines with
+ * each other or with the members next to the counter. load() sums up the
+ * shards, it is meant for the readers that are rarer than the updates.
+ *
+ * A thread may decrement what another one incremented: the value is the
+ * sum only, a single shard may go negative. As the shards aren't read at
+ * once, a sum taken while other threads update may be a few off, down to
+ * below 0 for a count that never is.
+ */
+class ShardedCounter {
+ public:
+  /** @brief number of shards the threads are spread over */
+  static constexpr size_t kShards = 16;
+
+  ShardedCounter() = default;
+
+  ShardedCounter(const ShardedCounter &) = delete;
+  ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+  void add(int64_t value) noexcept { shard().fetch_add(value, std::memory_order_relaxed); }
+
+  ShardedCounter &operator++() noexcept {
+    add(1);
+    return *this;
+  }
+
+  ShardedCounter &operator--() noexcept {
+    add(-1);
+    return *this;
+  }
+
+  /** @brief sum of the shards */
+  int64_t load() const noexcept {
+    int64_t sum = 0;
+    for (const auto &s : shards_.shard) sum += s.value.load(std::memory_order_relaxed);
+    return sum;
+  }
+
+ private:
+  // the values of two shards are never on the same cache line, however
+  // the counter is aligned
+  struct Shard {
+    std::atomic<int64_t> value{0};
+    char padding[64 - sizeof(std::atomic<int64_t>)];
+  };
+
+  std::atomic<int64_t> &shard() noexcept {
+    static std::atomic<size_t> next_shard{0};
+    // threads take the shards round-robin, in the order they first use one,
+    // the same one in all counters
+    thread_local const size_t ndx = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+
+    return shards_.shard[ndx].value;
+  }
+
+  struct Shards {
+    // keeps the first shard off the cache line of the members in front
+    char padding[64];
+    Shard shard[kShards];
+  };
+
+  Shards shards_;
+};
+
+#endif  // ROUTING_SHARDED_COUNTER_INCLUDED
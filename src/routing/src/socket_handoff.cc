@@ -0,0 +1,276 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "socket_handoff.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#  ifndef SOCK_CLOEXEC
+#    define SOCK_CLOEXEC 0
+#  endif
+#  ifndef MSG_CMSG_CLOEXEC
+#    define MSG_CMSG_CLOEXEC 0
+#  endif
+#  ifndef MSG_NOSIGNAL
+#    define MSG_NOSIGNAL 0
+#  endif
+#endif
+
+namespace {
+
+#ifndef _WIN32
+/** @brief most listeners handed over at once, one per acceptor thread and the named socket */
+const size_t kMaxHandedOverSockets = 257;
+
+/** @brief tells the kind of each socket passed */
+const char kTcpListener = 'T';
+const char kNamedSocketListener = 'N';
+
+std::string errno_message(const std::string &what) {
+  return what + ": " + std::strerror(errno);
+}
+
+bool make_address(const std::string &path, struct sockaddr_un &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+  memcpy(addr.sun_path, path.c_str(), path.size());
+  return true;
+}
+#endif
+
+}  // namespace
+
+SocketHandoff::~SocketHandoff() {
+  close();
+}
+
+/*static*/
+bool SocketHandoff::is_supported() noexcept {
+#ifndef _WIN32
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool SocketHandoff::receive(Listeners &listeners) {
+#ifndef _WIN32
+  struct sockaddr_un addr;
+  if (!make_address(path_, addr)) {
+    throw std::runtime_error("invalid socket file '" + path_ + "'");
+  }
+
+  int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock == -1) throw std::runtime_error(errno_message("socket()"));
+
+  if (::connect(sock, reinterpret_cast<struct sockaddr *>(&addr), static_cast<socklen_t>(sizeof(addr))) == -1) {
+    const int connect_errno = errno;
+    ::close(sock);
+    // nobody to take over from
+    if (connect_errno == ENOENT || connect_errno == ECONNREFUSED) return false;
+    errno = connect_errno;
+    throw std::runtime_error(errno_message("connect(" + path_ + ")"));
+  }
+
+  char kinds[kMaxHandedOverSockets];
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * kMaxHandedOverSockets)];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov = { kinds, sizeof(kinds) };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  ssize_t received;
+  do {
+    received = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (received == -1 && errno == EINTR);
+  const int recv_errno = errno;
+  ::close(sock);
+  if (received <= 0) {
+    errno = recv_errno;
+    throw std::runtime_error(received == 0 ? "closed before handing over" : errno_message("recvmsg()"));
+  }
+
+  std::vector<int> fds;
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+    const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const int *data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+    fds.insert(fds.end(), data, data + count);
+  }
+
+  if ((msg.msg_flags & MSG_CTRUNC) || fds.size() != static_cast<size_t>(received)) {
+    for (int fd : fds) ::close(fd);
+    throw std::runtime_error("handed over sockets don't match their description");
+  }
+
+  listeners = Listeners();
+  for (size_t i = 0; i < fds.size(); ++i) {
+    if (kinds[i] == kNamedSocketListener && listeners.named_socket == -1) {
+      listeners.named_socket = fds[i];
+    } else if (kinds[i] == kTcpListener) {
+      listeners.tcp.push_back(fds[i]);
+    } else {
+      ::close(fds[i]);
+    }
+  }
+
+  return true;
+#else
+  (void)listeners;
+  return false;
+#endif
+}
+
+void SocketHandoff::listen() {
+#ifndef _WIN32
+  struct sockaddr_un addr;
+  if (!make_address(path_, addr)) {
+    throw std::runtime_error("invalid socket file '" + path_ + "'");
+  }
+
+  sock_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock_ == -1) throw std::runtime_error(errno_message("socket()"));
+
+  // an earlier process keeps its socket, but can't be reached anymore
+  if (::unlink(path_.c_str()) == -1 && errno != ENOENT) {
+    const std::string error = errno_message("unlink(" + path_ + ")");
+    close();
+    throw std::runtime_error(error);
+  }
+
+  // only processes of the same user may take the listeners
+  const mode_t old_umask = ::umask(0077);
+  const int res = ::bind(sock_, reinterpret_cast<struct sockaddr *>(&addr), static_cast<socklen_t>(sizeof(addr)));
+  ::umask(old_umask);
+
+  struct stat st;
+  if (res == -1 || ::stat(path_.c_str(), &st) == -1 || ::listen(sock_, 4) == -1) {
+    const std::string error = errno_message("binding " + path_);
+    ::close(sock_);
+    sock_ = -1;
+    throw std::runtime_error(error);
+  }
+  file_dev_ = static_cast<unsigned long long>(st.st_dev);
+  file_ino_ = static_cast<unsigned long long>(st.st_ino);
+
+  fcntl(sock_, F_SETFL, fcntl(sock_, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+bool SocketHandoff::serve(const Listeners &listeners) {
+#ifndef _WIN32
+  int client;
+  do {
+    client = ::accept(sock_, nullptr, nullptr);
+  } while (client == -1 && errno == EINTR);
+  if (client == -1) return false;
+
+  std::vector<int> fds(listeners.tcp);
+  std::string kinds(fds.size(), kTcpListener);
+  if (listeners.named_socket != -1) {
+    fds.push_back(listeners.named_socket);
+    kinds += kNamedSocketListener;
+  }
+  if (fds.empty() || fds.size() > kMaxHandedOverSockets) {
+    ::close(client);
+    errno = EINVAL;
+    return false;
+  }
+
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * kMaxHandedOverSockets)];
+    struct cmsghdr align;
+  } control;
+  memset(control.buf, 0, sizeof(control.buf));
+  struct iovec iov = { &kinds[0], kinds.size() };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+  // a blocking send of a few bytes to a fresh connection
+  fcntl(client, F_SETFL, fcntl(client, F_GETFL) & ~O_NONBLOCK);
+  ssize_t sent;
+  do {
+    sent = ::sendmsg(client, &msg, MSG_NOSIGNAL);
+  } while (sent == -1 && errno == EINTR);
+  const int send_errno = errno;
+  ::close(client);
+
+  if (sent != static_cast<ssize_t>(kinds.size())) {
+    errno = sent == -1 ? send_errno : EIO;
+    return false;
+  }
+
+  handed_over_ = true;
+  return true;
+#else
+  (void)listeners;
+  return false;
+#endif
+}
+
+void SocketHandoff::close() {
+#ifndef _WIN32
+  if (sock_ == -1) return;
+
+  ::close(sock_);
+  sock_ = -1;
+
+  // the process that took over may have bound the socket file by now
+  struct stat st;
+  if (::stat(path_.c_str(), &st) == 0 &&
+      static_cast<unsigned long long>(st.st_dev) == file_dev_ &&
+      static_cast<unsigned long long>(st.st_ino) == file_ino_) {
+    ::unlink(path_.c_str());
+  }
+#endif
+}
@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_SOCKET_HANDOFF_INCLUDED
+#define ROUTING_SOCKET_HANDOFF_INCLUDED
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief SocketHandoff passes the listening sockets of a route to the
+ *        router process taking it over.
+ *
+ * The running process serves a unix socket. A new process connects to it
+ * on startup and gets duplicates of the listeners with SCM_RIGHTS instead
+ * of binding them itself, so both processes accept from the same sockets
+ * and no connection attempt gets refused. The new process then serves the
+ * unix socket for the next one, the old one can be stopped.
+ *
+ * Only available on Unix.
+ */
+class SocketHandoff {
+public:
+  /** @brief listening sockets of a route */
+  struct Listeners {
+    /** @brief TCP listeners, the first one followed by the SO_REUSEPORT ones */
+    std::vector<int> tcp;
+    /** @brief listener of the named socket, -1 if none */
+    int named_socket{-1};
+  };
+
+  /**
+   * @param path socket file the processes meet at
+   */
+  explicit SocketHandoff(const std::string &path) : path_(path) {}
+
+  /** @brief closes the socket, see close() */
+  ~SocketHandoff();
+
+  SocketHandoff(const SocketHandoff&) = delete;
+  SocketHandoff& operator=(const SocketHandoff&) = delete;
+
+  /**
+   * @brief Takes over the listeners of the process serving the socket file.
+   *
+   * @param listeners set to the received listeners, owned by the caller
+   *
+   * @return false if no process serves the socket file
+   *
+   * @throw std::runtime_error if the process serving it failed to hand over
+   */
+  bool receive(Listeners &listeners);
+
+  /**
+   * @brief Binds the socket file for the next process.
+   *
+   * A socket file left by an earlier process is replaced, that process
+   * can't hand over anymore.
+   *
+   * @throw std::runtime_error if the socket can't be bound
+   */
+  void listen();
+
+  /** @brief Returns socket to wait for processes on, -1 if not listening */
+  int get_socket() const noexcept {
+    return sock_;
+  }
+
+  /**
+   * @brief Hands over the listeners to a connecting process.
+   *
+   * Called once the socket is readable.
+   *
+   * @return false if the listeners couldn't be handed over, with errno set
+   */
+  bool serve(const Listeners &listeners);
+
+  /** @brief Returns true once listeners got handed over to another process */
+  bool has_handed_over() const noexcept {
+    return handed_over_;
+  }
+
+  /**
+   * @brief Stops listening.
+   *
+   * Removes the socket file unless another process bound it meanwhile.
+   */
+  void close();
+
+  /** @brief Returns true if handing over sockets is available on this platform */
+  static bool is_supported() noexcept;
+
+private:
+  /** @brief socket file */
+  std::string path_;
+  /** @brief listening socket, -1 if not listening */
+  int sock_{-1};
+  /** @brief device and inode of the bound socket file, to tell if it's still ours */
+  unsigned long long file_dev_{0};
+  unsigned long long file_ino_{0};
+  /** @brief true once the listeners were passed on */
+  bool handed_over_{false};
+};
+
+#endif /* ROUTING_SOCKET_HANDOFF_INCLUDED */
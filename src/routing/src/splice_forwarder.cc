@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "splice_forwarder.h"
+
+#include <cerrno>
+
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <unistd.h>
+#endif
+
+SpliceForwarder::~SpliceForwarder() {
+#ifdef __linux__
+  if (pipe_[0] != -1) ::close(pipe_[0]);
+  if (pipe_[1] != -1) ::close(pipe_[1]);
+#endif
+}
+
+/*static*/
+bool SpliceForwarder::is_supported() noexcept {
+#ifdef __linux__
+  return true;
+#else
+  return false;
+#endif
+}
+
+ssize_t SpliceForwarder::forward(int sender, int receiver, size_t max_bytes) {
+#ifdef __linux__
+  if (!usable_) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  if (pipe_[0] == -1) {
+    if (pipe2(pipe_, O_CLOEXEC | O_NONBLOCK) == -1) {
+      usable_ = false;
+      return -1;
+    }
+  }
+
+  ssize_t in_pipe;
+  do {
+    in_pipe = splice(sender, nullptr, pipe_[1], nullptr, max_bytes,
+                     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  } while (in_pipe == -1 && errno == EINTR);
+
+  if (in_pipe == -1) {
+    // EAGAIN: nothing to read after all, the caller retries once readable.
+    // socket types not supporting splice() report EINVAL
+    if (errno == EINVAL || errno == ENOSYS) usable_ = false;
+    return -1;
+  }
+  if (in_pipe == 0) {
+    // the caller assumes that errno == 0 on plain connection closes.
+    errno = 0;
+    return 0;
+  }
+
+  // the pipe was empty before, so everything in it has to go out now
+  ssize_t left = in_pipe;
+  while (left > 0) {
+    ssize_t res = splice(pipe_[0], nullptr, receiver, nullptr, static_cast<size_t>(left),
+                         SPLICE_F_MOVE);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // a non-blocking receiver with a full buffer, the data is in the
+        // pipe already and has to go out before returning
+        struct pollfd pfd = { receiver, POLLOUT, 0 };
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR) return -1;
+        continue;
+      }
+      return -1;
+    }
+    left -= res;
+  }
+
+  return in_pipe;
+#else
+  (void)sender;
+  (void)receiver;
+  (void)max_bytes;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
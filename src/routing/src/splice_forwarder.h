@@ -0,0 +1,93 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_SPLICE_FORWARDER_INCLUDED
+#define ROUTING_SPLICE_FORWARDER_INCLUDED
+
+#include <cstddef>
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#else
+typedef long ssize_t;
+#endif
+
+/**
+ * @brief SpliceForwarder moves data from one socket to another through a
+ *        pipe using splice(), without copying it into user space.
+ *
+ * Only available on Linux. The pipe is created on first use. When the
+ * sockets or the kernel don't support splicing, forward() fails with
+ * is_usable() returning false and the caller is expected to fall back to
+ * copying through a buffer.
+ */
+class SpliceForwarder {
+public:
+  SpliceForwarder() = default;
+  ~SpliceForwarder();
+
+  SpliceForwarder(const SpliceForwarder&) = delete;
+  SpliceForwarder& operator=(const SpliceForwarder&) = delete;
+
+  /**
+   * @brief Forwards data available on sender to receiver.
+   *
+   * Reads at most max_bytes from sender without waiting and blocks until
+   * all of it is written to receiver, also if receiver is non-blocking.
+   *
+   * @param sender socket to read from
+   * @param receiver socket to write to
+   * @param max_bytes max number of bytes to move
+   *
+   * @return number of bytes moved, 0 if sender was closed, -1 on error
+   *         with errno set. errno EAGAIN or EWOULDBLOCK means that sender
+   *         had nothing to read, nothing was moved and the connection is
+   *         fine.
+   */
+  ssize_t forward(int sender, int receiver, size_t max_bytes);
+
+  /**
+   * @brief Returns false once splicing turned out to be unsupported.
+   *
+   * Nothing was read from the sender in that case.
+   */
+  bool is_usable() const noexcept {
+    return usable_;
+  }
+
+  /**
+   * @brief Returns true if splice() is available on this platform.
+   */
+  static bool is_supported() noexcept;
+
+private:
+  /** @brief read and write end of the pipe */
+  int pipe_[2]{-1, -1};
+
+  /** @brief false if splicing is not possible */
+  bool usable_{is_supported()};
+};
+
+#endif /* ROUTING_SPLICE_FORWARDER_INCLUDED */
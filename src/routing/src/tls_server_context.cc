@@ -0,0 +1,378 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "tls_server_context.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef HAVE_OPENSSL
+#  include <openssl/ssl.h>
+#  ifdef HAVE_YASSL
+using namespace yaSSL;
+#  endif
+#endif
+
+// OpenSSL sets up kernel TLS itself, on Linux since 3.0
+#if defined(HAVE_OPENSSL) && !defined(HAVE_YASSL) && defined(__linux__) && defined(SSL_OP_ENABLE_KTLS)
+#  define ROUTING_KERNEL_TLS
+#  include <openssl/bio.h>
+#endif
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#endif
+
+#include "mysqlrouter/mysql_protocol.h"
+#include "protocol/classic_handshake.h"
+
+#ifdef HAVE_OPENSSL
+
+#ifdef HAVE_YASSL
+// yaSSL asks the terminal for the pass phrase of encrypted keys. The router
+// runs without one, encrypted keys fail to load instead.
+char *yassl_mysql_get_tty_password_ext(const char *, char *(*)(const char *, int)) {
+  return nullptr;
+}
+#endif
+
+namespace {
+
+// ties cached sessions to the router, any value will do
+const unsigned char kSessionIdContext[] = "mysqlrouter";
+
+// max. plain text one SSL_read() returns
+const size_t kMaxRecordSize = 16384;
+
+void set_receive_timeout(int sock, std::chrono::milliseconds timeout) {
+#ifndef _WIN32
+  struct timeval tv;
+  tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+  tv.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#else
+  DWORD ms = static_cast<DWORD>(timeout.count());
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#endif
+}
+
+} // namespace
+
+struct TlsServerContext::Impl {
+  SSL_CTX *ctx{nullptr};
+};
+
+struct TlsServerContext::Session::Impl {
+  SSL *ssl{nullptr};
+  int sock{-1};
+  /** @brief receive timeout set on sock, 0 for none */
+  std::chrono::milliseconds read_timeout{0};
+
+  void set_read_timeout(std::chrono::milliseconds timeout) {
+    set_receive_timeout(sock, timeout);
+    read_timeout = timeout;
+  }
+#if defined(HAVE_YASSL) && !defined(_WIN32)
+  // SSL_pending() and SSL_peek() of yaSSL lose track of decrypted data,
+  // which is read ahead here instead
+  std::vector<uint8_t> read_ahead;
+
+  // takes decrypted data left by a full read, without blocking
+  void fill_read_ahead() {
+    uint8_t buffer[kMaxRecordSize];
+    const int flags = fcntl(sock, F_GETFL);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    const int res = SSL_read(ssl, buffer, sizeof(buffer));
+    fcntl(sock, F_SETFL, flags);
+    if (res > 0) read_ahead.insert(read_ahead.end(), buffer, buffer + res);
+  }
+#endif
+};
+
+TlsServerContext::TlsServerContext(const std::string &cert_file, const std::string &key_file,
+                                   std::chrono::seconds session_timeout)
+    : impl_(new Impl) {
+  static std::once_flag init_flag;
+  std::call_once(init_flag, [] { SSL_library_init(); });
+
+#ifdef HAVE_YASSL
+  // yaSSL ignores the options, its SSLv23 method goes down to SSLv3
+  impl_->ctx = SSL_CTX_new(TLSv1_1_server_method());
+#else
+  impl_->ctx = SSL_CTX_new(SSLv23_server_method());
+#endif
+  if (!impl_->ctx) throw std::runtime_error("creating TLS context failed");
+
+#if defined(HAVE_YASSL)
+  SSL_CTX_set_options(impl_->ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L
+  SSL_CTX_set_options(impl_->ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_TLSv1 | SSL_OP_NO_TLSv1_1);
+#else
+  SSL_CTX_set_min_proto_version(impl_->ctx, TLS1_2_VERSION);
+#endif
+#ifdef HAVE_YASSL
+  // yaSSL doesn't implement loading a chain
+  const bool cert_loaded = SSL_CTX_use_certificate_file(impl_->ctx, cert_file.c_str(),
+                                                        SSL_FILETYPE_PEM) == 1;
+#else
+  const bool cert_loaded = SSL_CTX_use_certificate_chain_file(impl_->ctx, cert_file.c_str()) == 1;
+#endif
+  if (!cert_loaded) {
+    SSL_CTX_free(impl_->ctx);
+    throw std::runtime_error("loading certificate '" + cert_file + "' failed");
+  }
+#ifdef HAVE_YASSL
+  // yaSSL doesn't implement SSL_CTX_check_private_key()
+  const bool key_loaded = SSL_CTX_use_PrivateKey_file(impl_->ctx, key_file.c_str(), SSL_FILETYPE_PEM) == 1;
+#else
+  const bool key_loaded = SSL_CTX_use_PrivateKey_file(impl_->ctx, key_file.c_str(), SSL_FILETYPE_PEM) == 1 &&
+                          SSL_CTX_check_private_key(impl_->ctx) == 1;
+#endif
+  if (!key_loaded) {
+    SSL_CTX_free(impl_->ctx);
+    throw std::runtime_error("loading private key '" + key_file + "' failed");
+  }
+
+  SSL_CTX_set_session_cache_mode(impl_->ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context(impl_->ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+  SSL_CTX_set_timeout(impl_->ctx, static_cast<long>(session_timeout.count()));
+}
+
+TlsServerContext::~TlsServerContext() {
+  SSL_CTX_free(impl_->ctx);
+}
+
+/*static*/
+bool TlsServerContext::is_supported() noexcept {
+  return true;
+}
+
+/*static*/
+bool TlsServerContext::is_kernel_tls_supported() noexcept {
+#ifdef ROUTING_KERNEL_TLS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TlsServerContext::set_kernel_tls(bool enable) {
+#ifdef ROUTING_KERNEL_TLS
+  if (enable) {
+    SSL_CTX_set_options(impl_->ctx, SSL_OP_ENABLE_KTLS);
+  } else {
+    SSL_CTX_clear_options(impl_->ctx, SSL_OP_ENABLE_KTLS);
+  }
+#else
+  if (enable) throw std::runtime_error("kernel TLS is not supported by this build");
+#endif
+}
+
+TlsServerContext::Session::Session(TlsServerContext &context)
+    : impl_(new Impl), context_(context) {}
+
+TlsServerContext::Session::~Session() {
+  if (impl_->ssl) SSL_free(impl_->ssl);
+}
+
+bool TlsServerContext::Session::accept(int sock, std::chrono::milliseconds timeout) {
+  impl_->ssl = SSL_new(context_.impl_->ctx);
+  if (!impl_->ssl || SSL_set_fd(impl_->ssl, sock) != 1) return false;
+  impl_->sock = sock;
+
+  // a client stalling in the handshake doesn't block the thread for good
+  impl_->set_read_timeout(timeout);
+  const bool ok = SSL_accept(impl_->ssl) == 1;
+  impl_->set_read_timeout(std::chrono::milliseconds(0));
+  if (!ok) return false;
+
+  ++context_.handshakes_;
+  if (is_resumed()) ++context_.resumed_;
+  if (is_kernel_send()) ++context_.kernel_send_;
+  if (is_kernel_recv()) ++context_.kernel_recv_;
+
+  return true;
+}
+
+ssize_t TlsServerContext::Session::read(uint8_t *buffer, size_t size) {
+#if defined(HAVE_YASSL) && !defined(_WIN32)
+  if (!impl_->read_ahead.empty()) {
+    const size_t bytes = std::min(size, impl_->read_ahead.size());
+    std::memcpy(buffer, impl_->read_ahead.data(), bytes);
+    impl_->read_ahead.erase(impl_->read_ahead.begin(), impl_->read_ahead.begin() + bytes);
+    if (impl_->read_ahead.empty()) impl_->fill_read_ahead();
+    return static_cast<ssize_t>(bytes);
+  }
+#endif
+
+  while (true) {
+    const int res = SSL_read(impl_->ssl, buffer, static_cast<int>(size));
+    if (res > 0) {
+#if defined(HAVE_YASSL) && !defined(_WIN32)
+      if (static_cast<size_t>(res) == std::min(size, kMaxRecordSize)) impl_->fill_read_ahead();
+#endif
+      return res;
+    }
+
+    const int error = SSL_get_error(impl_->ssl, res);
+    if (error == SSL_ERROR_ZERO_RETURN) return 0;
+    if (error == SSL_ERROR_SYSCALL && res == 0) return 0;
+    if (error == SSL_ERROR_SYSCALL && errno == EINTR) continue;
+#ifndef _WIN32
+    if (error == SSL_ERROR_WANT_READ) {
+      // fill_read_ahead() left part of a record, or the receive timeout hit
+      struct pollfd fds = {impl_->sock, POLLIN, 0};
+      const int ready = ::poll(&fds, 1, impl_->read_timeout.count() > 0
+                                            ? static_cast<int>(impl_->read_timeout.count()) : -1);
+      if (ready > 0 || (ready < 0 && errno == EINTR)) continue;
+    }
+#endif
+    return -1;
+  }
+}
+
+bool TlsServerContext::Session::read_packet(RoutingProtocolBuffer &packet,
+                                            std::chrono::milliseconds timeout) {
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+
+  auto read_exactly = [this](uint8_t *buffer, size_t size) {
+    while (size > 0) {
+      const ssize_t res = read(buffer, size);
+      if (res <= 0) return false;
+      buffer += res;
+      size -= static_cast<size_t>(res);
+    }
+    return true;
+  };
+
+  auto read_all = [&]() {
+    packet.resize(kHeaderSize);
+    if (!read_exactly(&packet[0], kHeaderSize)) return false;
+
+    const size_t payload_size = mysql_protocol::Packet::read_payload_size(&packet[0]);
+    if (kHeaderSize + payload_size > classic_handshake::kMaxPacketSize) return false;
+
+    packet.resize(kHeaderSize + payload_size);
+    return payload_size == 0 || read_exactly(&packet[kHeaderSize], payload_size);
+  };
+
+  // the handshake response follows the TLS handshake, a client stalling
+  // in between doesn't block the thread either
+  impl_->set_read_timeout(timeout);
+  const bool ok = read_all();
+  impl_->set_read_timeout(std::chrono::milliseconds(0));
+  return ok;
+}
+
+bool TlsServerContext::Session::write_all(const uint8_t *data, size_t size) {
+  while (size > 0) {
+    const int res = SSL_write(impl_->ssl, data, static_cast<int>(size));
+    if (res <= 0) {
+      if (SSL_get_error(impl_->ssl, res) == SSL_ERROR_SYSCALL && errno == EINTR) continue;
+      return false;
+    }
+    data += res;
+    size -= static_cast<size_t>(res);
+  }
+  return true;
+}
+
+bool TlsServerContext::Session::has_pending() const {
+  if (!impl_->ssl) return false;
+#if defined(HAVE_YASSL) && !defined(_WIN32)
+  return !impl_->read_ahead.empty();
+#else
+  return SSL_pending(impl_->ssl) > 0;
+#endif
+}
+
+bool TlsServerContext::Session::is_resumed() const {
+  return impl_->ssl && SSL_session_reused(impl_->ssl) == 1;
+}
+
+bool TlsServerContext::Session::is_kernel_send() const {
+#ifdef ROUTING_KERNEL_TLS
+  return impl_->ssl && BIO_get_ktls_send(SSL_get_wbio(impl_->ssl)) != 0;
+#else
+  return false;
+#endif
+}
+
+bool TlsServerContext::Session::is_kernel_recv() const {
+#ifdef ROUTING_KERNEL_TLS
+  return impl_->ssl && BIO_get_ktls_recv(SSL_get_rbio(impl_->ssl)) != 0;
+#else
+  return false;
+#endif
+}
+
+void TlsServerContext::Session::shutdown() {
+  if (impl_->ssl) SSL_shutdown(impl_->ssl);
+}
+
+#else
+
+struct TlsServerContext::Impl {};
+struct TlsServerContext::Session::Impl {};
+
+TlsServerContext::TlsServerContext(const std::string &, const std::string &, std::chrono::seconds) {
+  throw std::runtime_error("TLS is not supported by this build");
+}
+
+TlsServerContext::~TlsServerContext() = default;
+
+/*static*/
+bool TlsServerContext::is_supported() noexcept {
+  return false;
+}
+
+/*static*/
+bool TlsServerContext::is_kernel_tls_supported() noexcept {
+  return false;
+}
+
+void TlsServerContext::set_kernel_tls(bool enable) {
+  if (enable) throw std::runtime_error("kernel TLS is not supported by this build");
+}
+
+TlsServerContext::Session::Session(TlsServerContext &context) : context_(context) {}
+TlsServerContext::Session::~Session() = default;
+bool TlsServerContext::Session::accept(int, std::chrono::milliseconds) { return false; }
+ssize_t TlsServerContext::Session::read(uint8_t *, size_t) { return -1; }
+bool TlsServerContext::Session::read_packet(RoutingProtocolBuffer &, std::chrono::milliseconds) { return false; }
+bool TlsServerContext::Session::write_all(const uint8_t *, size_t) { return false; }
+bool TlsServerContext::Session::has_pending() const { return false; }
+bool TlsServerContext::Session::is_resumed() const { return false; }
+bool TlsServerContext::Session::is_kernel_send() const { return false; }
+bool TlsServerContext::Session::is_kernel_recv() const { return false; }
+void TlsServerContext::Session::shutdown() {}
+
+#endif // HAVE_OPENSSL
@@ -0,0 +1,210 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_TLS_SERVER_CONTEXT_INCLUDED
+#define ROUTING_TLS_SERVER_CONTEXT_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "protocol/base_protocol.h"
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#else
+typedef long ssize_t;
+#endif
+
+/**
+ * @brief TlsServerContext terminates the TLS connections of classic
+ *        protocol clients at the router.
+ *
+ * Holds the certificate and key the router presents to the clients. TLS
+ * sessions are cached, clients reconnecting within the session timeout
+ * resume their session and skip the full handshake. With OpenSSL, session
+ * tickets are issued as well.
+ *
+ * Clients need TLSv1.2 or later. yaSSL only implements up to TLSv1.1,
+ * builds with it accept TLSv1.1 only.
+ *
+ * One context is shared by all connections of a route, each client
+ * connection has its own Session.
+ *
+ * With kernel TLS enabled, the keys negotiated by the handshake are handed
+ * to the kernel (Linux, OpenSSL 3.0 or later), which then encrypts and
+ * decrypts the records of the socket. Connections fall back to encrypting
+ * in OpenSSL if the kernel doesn't support the cipher or the TLS version
+ * for a direction.
+ */
+class TlsServerContext {
+public:
+  /**
+   * @brief Loads certificate and key.
+   *
+   * @throw std::runtime_error if TLS is not supported or certificate or
+   *        key can't be loaded
+   *
+   * @param cert_file PEM file of the certificate, may include the chain
+   * @param key_file PEM file of the private key
+   * @param session_timeout time cached sessions can be resumed
+   */
+  TlsServerContext(const std::string &cert_file, const std::string &key_file,
+                   std::chrono::seconds session_timeout = std::chrono::seconds(300));
+  ~TlsServerContext();
+
+  TlsServerContext(const TlsServerContext&) = delete;
+  TlsServerContext& operator=(const TlsServerContext&) = delete;
+
+  struct Stats {
+    /** @brief TLS handshakes done with clients */
+    uint64_t handshakes{0};
+    /** @brief handshakes resuming a cached session */
+    uint64_t resumed{0};
+    /** @brief handshakes after which the kernel encrypts what is sent */
+    uint64_t kernel_send{0};
+    /** @brief handshakes after which the kernel decrypts what is received */
+    uint64_t kernel_recv{0};
+  };
+
+  Stats get_stats() const noexcept {
+    Stats stats;
+    stats.handshakes = handshakes_;
+    stats.resumed = resumed_;
+    stats.kernel_send = kernel_send_;
+    stats.kernel_recv = kernel_recv_;
+    return stats;
+  }
+
+  /**
+   * @brief Returns true if the router was built with TLS support.
+   */
+  static bool is_supported() noexcept;
+
+  /**
+   * @brief Returns true if the build can hand TLS connections to the kernel.
+   *
+   * The kernel may still lack the tls module or the cipher negotiated.
+   */
+  static bool is_kernel_tls_supported() noexcept;
+
+  /**
+   * @brief Hands the TLS connections to the kernel once the handshake is done.
+   *
+   * Affects the sessions accepted afterwards.
+   *
+   * @throw std::runtime_error if enabled and the build doesn't support it
+   */
+  void set_kernel_tls(bool enable);
+
+  /**
+   * @brief TLS connection of one client.
+   *
+   * Reads and writes block, like the plain socket operations of the
+   * connection do.
+   */
+  class Session {
+  public:
+    explicit Session(TlsServerContext &context);
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /**
+     * @brief Does the server side of the TLS handshake.
+     *
+     * @param sock connected client socket
+     * @param timeout max time to wait for each read of the handshake
+     *
+     * @return false if the handshake failed
+     */
+    bool accept(int sock, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Reads decrypted data.
+     *
+     * @return number of bytes read, 0 if the client closed the connection,
+     *         -1 on error
+     */
+    ssize_t read(uint8_t *buffer, size_t size);
+
+    /**
+     * @brief Reads one complete classic protocol packet.
+     *
+     * @param packet set to the packet including the header
+     * @param timeout max time to wait for each read of the packet
+     *
+     * @return false if connection got closed, failed, timed out or packet
+     *         is bigger than classic_handshake::kMaxPacketSize
+     */
+    bool read_packet(RoutingProtocolBuffer &packet, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Encrypts and writes all of data.
+     *
+     * @return false on error
+     */
+    bool write_all(const uint8_t *data, size_t size);
+
+    /** @brief true if decrypted data is buffered, which poll() doesn't report */
+    bool has_pending() const;
+
+    /** @brief true if the handshake resumed a cached session */
+    bool is_resumed() const;
+
+    /** @brief true if the kernel encrypts the records written */
+    bool is_kernel_send() const;
+
+    /**
+     * @brief true if the kernel decrypts the records read
+     *
+     * read() of the socket then returns the plain text. It fails with EIO
+     * on records other than application data, like the close_notify alert.
+     */
+    bool is_kernel_recv() const;
+
+    /** @brief sends close_notify, best effort */
+    void shutdown();
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    TlsServerContext &context_;
+  };
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+  std::atomic<uint64_t> handshakes_{0};
+  std::atomic<uint64_t> resumed_{0};
+  std::atomic<uint64_t> kernel_send_{0};
+  std::atomic<uint64_t> kernel_recv_{0};
+};
+
+#endif /* ROUTING_TLS_SERVER_CONTEXT_INCLUDED */
@@ -0,0 +1,483 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "traffic_mirror.h"
+
+#include "common.h"
+#include "keyring/keyring_manager.h"
+#include "mysql/harness/logging/logging.h"
+#include "mysql/harness/networking/resolver_cache.h"
+#include "mysql_routing_common.h"
+#include "mysqlrouter/mysql_protocol.h"
+#include "protocol/classic_framer.h"
+#include "protocol/classic_handshake.h"
+#include "socket_operations.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <sys/socket.h>
+#else
+#  include <winsock2.h>
+#endif
+
+using mysql_harness::AsyncSocket;
+using mysql_harness::Task;
+using mysql_harness::Unit;
+namespace Capabilities = mysql_protocol::Capabilities;
+
+IMPORT_LOG_FUNCTIONS()
+
+static constexpr uint8_t kOkHeader = 0x00;
+static const char *kKeyringAttributePassword = "password";
+static const char *kNativePasswordPlugin = "mysql_native_password";
+
+struct TrafficMirror::SessionState {
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief bytes copied with one read of the client, for replay_timing */
+  struct Segment {
+    size_t size;
+    clock_type::time_point read_at;
+  };
+
+  explicit SessionState(size_t buffer_size) : ring(buffer_size) {}
+
+  /** @brief appends to the ring, which has room for size more bytes */
+  void append(const uint8_t *data, size_t size) {
+    size_t tail = (head + used) % ring.size();
+    while (size > 0) {
+      const size_t n = std::min(size, ring.size() - tail);
+      std::memcpy(&ring[tail], data, n);
+      tail = (tail + n) % ring.size();
+      data += n;
+      size -= n;
+      used += n;
+    }
+  }
+
+  /** @brief moves size bytes from the front of the ring to dest */
+  void take(size_t size, std::vector<uint8_t> &dest) {
+    dest.resize(size);
+    size_t offset = 0;
+    while (offset < size) {
+      const size_t n = std::min(size - offset, ring.size() - head);
+      std::memcpy(&dest[offset], &ring[head], n);
+      head = (head + n) % ring.size();
+      offset += n;
+      used -= n;
+    }
+  }
+
+  /** @brief guards the ring and the flags shared with the connection */
+  std::mutex mtx;
+  std::vector<uint8_t> ring;
+  size_t head{0};
+  size_t used{0};
+  /** @brief reads of the bytes in the ring, empty without replay_timing */
+  std::deque<Segment> segments;
+  /** @brief true if pump() isn't pending, the connection wakes it up then */
+  bool idle{false};
+  /** @brief set once the connection is done */
+  bool closed{false};
+  /** @brief set once nothing gets mirrored anymore */
+  bool stopped{false};
+
+  // used by the connection only
+  ClassicPacketFramer framer;
+  /** @brief true if the current command is copied */
+  bool keep_command{false};
+  /** @brief true if the current packet is copied */
+  bool keep_packet{false};
+
+  // used by the background thread only
+  RoutingProtocolBuffer handshake_packet;
+  classic_handshake::ClientHandshake handshake;
+  std::string password;
+  std::unique_ptr<AsyncSocket> sock;
+  RoutingProtocolBuffer packet;
+  bool authenticated{false};
+  bool finished{false};
+  /** @brief bytes being written to the shadow server */
+  std::vector<uint8_t> out;
+  /** @brief responses of the shadow server, overwritten by each read */
+  std::vector<uint8_t> discarded;
+  /** @brief time the first command was read from the client, and got due at the shadow server */
+  clock_type::time_point client_origin;
+  clock_type::time_point shadow_origin;
+  bool has_origin{false};
+};
+
+/** @brief reads one packet of the handshake, the socket and packet have to outlive the task */
+static Task<Unit> read_handshake_packet(AsyncSocket &sock, RoutingProtocolBuffer &packet,
+                                        std::chrono::milliseconds timeout) {
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  packet.resize(kHeaderSize);
+  return sock.read_exact(&packet[0], kHeaderSize, timeout)
+      .then([&sock, &packet, timeout](size_t) {
+        const size_t payload_size = mysql_protocol::Packet::read_payload_size(&packet[0]);
+        if (payload_size + kHeaderSize > classic_handshake::kMaxPacketSize) {
+          return Task<size_t>::failed(std::make_error_code(std::errc::message_size));
+        }
+        packet.resize(kHeaderSize + payload_size);
+        if (payload_size == 0) return Task<size_t>::ready(0);
+        return sock.read_exact(&packet[kHeaderSize], payload_size, timeout);
+      })
+      .then([](size_t) { return Task<Unit>::ready(Unit()); });
+}
+
+TrafficMirror::Session::~Session() {
+  std::lock_guard<std::mutex> lock(state_->mtx);
+  state_->closed = true;
+  mirror_->wake(state_);
+}
+
+void TrafficMirror::Session::client_data(const uint8_t *data, size_t size) {
+  const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+  SessionState &state = *state_;
+  size_t copied = 0;
+  size_t dropped = 0;
+
+  std::lock_guard<std::mutex> lock(state.mtx);
+  ClassicPacketFramer::Frame frame;
+  while (!state.stopped && state.framer.next(data, size, frame)) {
+    if (frame.is_first()) {
+      const size_t packet_size = kHeaderSize + frame.payload_size;
+      const bool fits = packet_size <= state.ring.size() - state.used;
+      if (frame.starts_message && frame.sequence_id == 0) {
+        // a new command, sent whole or not at all
+        state.keep_command = fits;
+      } else if (state.keep_command && !fits) {
+        // the shadow server waits for the rest of the command
+        state.stopped = true;
+        dropped += kHeaderSize + frame.length;
+        break;
+      }
+      state.keep_packet = state.keep_command;
+
+      if (state.keep_packet) {
+        const uint8_t header[kHeaderSize]{static_cast<uint8_t>(frame.payload_size),
+                                          static_cast<uint8_t>(frame.payload_size >> 8),
+                                          static_cast<uint8_t>(frame.payload_size >> 16),
+                                          frame.sequence_id};
+        state.append(header, kHeaderSize);
+        copied += kHeaderSize;
+      } else {
+        dropped += kHeaderSize;
+      }
+    }
+
+    if (state.keep_packet) {
+      state.append(frame.payload, frame.length);
+      copied += frame.length;
+    } else {
+      dropped += frame.length;
+    }
+  }
+  // bytes after the session stopped
+  dropped += size;
+
+  if (copied > 0 && mirror_->replay_timing_) {
+    state.segments.push_back(SessionState::Segment{copied, SessionState::clock_type::now()});
+  }
+  if (dropped > 0) mirror_->bytes_dropped_ += dropped;
+  if (copied > 0 || state.stopped) mirror_->wake(state_);
+}
+
+TrafficMirror::TrafficMirror(mysql_harness::SocketOperationsBase *sock_ops,
+                             const mysql_harness::TCPAddress &destination, size_t buffer_size,
+                             bool replay_timing, std::chrono::milliseconds connect_timeout)
+    : sock_ops_(sock_ops), destination_(destination), buffer_size_(buffer_size),
+      replay_timing_(replay_timing), connect_timeout_(connect_timeout), io_ctx_("TrafficMirror") {
+}
+
+TrafficMirror::~TrafficMirror() {
+  io_ctx_.stop();
+  if (thread_) thread_->join();
+}
+
+void TrafficMirror::start(const std::string &name, size_t thread_stack_size) {
+  name_ = name;
+  thread_.reset(new mysql_harness::MySQLRouterThread(thread_stack_size));
+  thread_->run(&run_thread, this);
+}
+
+void* TrafficMirror::run_thread(void *context) {
+  static_cast<TrafficMirror*>(context)->run();
+  return nullptr;
+}
+
+void TrafficMirror::run() {
+  mysql_harness::rename_thread(get_routing_thread_name(name_, "RtM").c_str());  // "Rt mirror" would be too long :(
+
+  try {
+    io_ctx_.run();
+  } catch (const std::system_error &e) {
+    log_error("[%s] mirroring to %s stopped: %s", name_.c_str(), destination_.str().c_str(), e.what());
+  }
+
+  // the sessions get destroyed with the handlers of the IoContext, which
+  // they must not be waiting in anymore
+  for (const auto &state : sessions_) state->sock->close();
+  sessions_.clear();
+}
+
+std::unique_ptr<TrafficMirror::Session> TrafficMirror::open_session(const RoutingProtocolBuffer &handshake_response) {
+  std::shared_ptr<SessionState> state = std::make_shared<SessionState>(buffer_size_);
+  if (!classic_handshake::parse_handshake_response(handshake_response, state->handshake)) return nullptr;
+
+  // the router has to see the commands as the server gets them
+  const Capabilities::Flags &capabilities = state->handshake.capabilities;
+  if (capabilities.test(Capabilities::SSL) || capabilities.test(Capabilities::COMPRESS) ||
+      !capabilities.test(Capabilities::PLUGIN_AUTH | Capabilities::SECURE_CONNECTION)) {
+    return nullptr;
+  }
+
+  mysql_harness::Keyring *keyring = mysql_harness::get_keyring();
+  if (!keyring) return nullptr;
+  try {
+    state->password = keyring->fetch(state->handshake.username, kKeyringAttributePassword);
+  } catch (const std::out_of_range &) {
+    return nullptr;
+  }
+  state->handshake_packet = handshake_response;
+
+  io_ctx_.post([this, state] { connect_session(state); });
+
+  return std::unique_ptr<Session>(new Session(shared_from_this(), state));
+}
+
+TrafficMirror::Stats TrafficMirror::get_stats() const {
+  Stats stats;
+  stats.sessions = sessions_count_;
+  stats.failed = failed_count_;
+  stats.bytes_sent = bytes_sent_;
+  stats.bytes_dropped = bytes_dropped_;
+  return stats;
+}
+
+void TrafficMirror::connect_session(std::shared_ptr<SessionState> state) {
+  const std::chrono::milliseconds timeout = connect_timeout_;
+
+  // cached, only the first session waits for the resolver
+  mysql_harness::ResolverCache::Addresses addresses;
+  if (mysql_harness::ResolverCache::instance().resolve(destination_.addr, destination_.port, addresses) != 0 ||
+      addresses.empty()) {
+    log_debug("[%s] failed resolving mirror destination %s", name_.c_str(), destination_.str().c_str());
+    finish(state, true);
+    return;
+  }
+  const mysql_harness::ResolverCache::Address &address = addresses.front();
+
+  const int sock = sock_ops_->socket(address.family, address.socktype, address.protocol);
+  if (sock < 0) {
+    log_debug("[%s] failed opening socket to mirror destination: %s", name_.c_str(),
+              get_message_error(sock_ops_->get_errno()).c_str());
+    finish(state, true);
+    return;
+  }
+  // commands are small and sent as they come
+  int nodelay = 1;
+  sock_ops_->setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, static_cast<socklen_t>(sizeof(nodelay)));
+  state->sock.reset(new AsyncSocket(io_ctx_, sock, sock_ops_));
+  sessions_.insert(state);
+
+  AsyncSocket &async_sock = *state->sock;
+  async_sock.connect(reinterpret_cast<const struct sockaddr *>(&address.addr), address.addrlen, timeout)
+      .then([state, timeout](Unit) {
+        return read_handshake_packet(*state->sock, state->packet, timeout);
+      })
+      .then([state, timeout](Unit) {
+        classic_handshake::ServerGreeting greeting;
+        if (!classic_handshake::parse_server_greeting(state->packet, greeting, false)) {
+          return Task<size_t>::failed(std::make_error_code(std::errc::protocol_error));
+        }
+        try {
+          state->out = classic_handshake::make_handshake_response(
+              state->handshake_packet, state->handshake,
+              classic_handshake::make_native_password_token(state->password, greeting.scramble));
+        } catch (const mysql_protocol::packet_error &) {
+          return Task<size_t>::failed(std::make_error_code(std::errc::protocol_error));
+        }
+        return state->sock->write(&state->out[0], state->out.size(), timeout);
+      })
+      .then([state, timeout](size_t) {
+        return read_handshake_packet(*state->sock, state->packet, timeout);
+      })
+      .then([state, timeout](Unit) {
+        std::string auth_plugin;
+        std::vector<uint8_t> scramble;
+        if (!classic_handshake::parse_auth_switch_request(state->packet, auth_plugin, scramble)) {
+          return Task<Unit>::ready(Unit());
+        }
+        if (auth_plugin != kNativePasswordPlugin) {
+          return Task<Unit>::failed(std::make_error_code(std::errc::operation_not_supported));
+        }
+
+        const std::vector<uint8_t> token = classic_handshake::make_native_password_token(state->password, scramble);
+        state->out = {static_cast<uint8_t>(token.size()), 0, 0, static_cast<uint8_t>(state->packet[3] + 1)};
+        state->out.insert(state->out.end(), token.begin(), token.end());
+        return state->sock->write(&state->out[0], state->out.size(), timeout)
+            .then([state, timeout](size_t) {
+              return read_handshake_packet(*state->sock, state->packet, timeout);
+            });
+      })
+      .then([state](Unit) {
+        const size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+        if (state->packet.size() <= kHeaderSize || state->packet[kHeaderSize] != kOkHeader) {
+          return Task<Unit>::failed(std::make_error_code(std::errc::permission_denied));
+        }
+        return Task<Unit>::ready(Unit());
+      })
+      .start([this, state](std::error_code ec, Unit) {
+        if (state->finished) return;
+        if (ec) {
+          log_debug("[%s] failed connecting to mirror destination %s as '%s': %s", name_.c_str(),
+                    destination_.str().c_str(), state->handshake.username.c_str(), ec.message().c_str());
+          finish(state, true);
+          return;
+        }
+
+        ++sessions_count_;
+        state->authenticated = true;
+        discard_responses(state);
+        pump(state);
+      });
+}
+
+void TrafficMirror::discard_responses(std::shared_ptr<SessionState> state) {
+  state->discarded.resize(16 * 1024);
+  mysql_harness::repeat_while<size_t>(
+      [state]() {
+        return state->sock->read(&state->discarded[0], state->discarded.size(), std::chrono::milliseconds(-1));
+      },
+      [](const size_t &bytes_read) { return bytes_read > 0; })
+      .start([this, state](std::error_code ec, size_t) {
+        // closed by the shadow server, e.g. after the COM_QUIT of the client
+        finish(state, ec && ec != std::errc::operation_canceled);
+      });
+}
+
+void TrafficMirror::pump(std::shared_ptr<SessionState> state) {
+  if (state->finished) return;
+
+  std::unique_lock<std::mutex> lock(state->mtx);
+  if (state->stopped) {
+    lock.unlock();
+    finish(state, true);
+    return;
+  }
+  if (state->used == 0) {
+    if (state->closed) {
+      lock.unlock();
+      // closing with unread responses would reset the connection, the
+      // shadow server closes it once it read the end of the commands
+#ifndef _WIN32
+      ::shutdown(state->sock->fd(), SHUT_WR);
+#else
+      ::shutdown(state->sock->fd(), SD_SEND);
+#endif
+      io_ctx_.schedule(connect_timeout_, [this, state] { finish(state, false); });
+      return;
+    }
+    state->idle = true;
+    return;
+  }
+
+  size_t size = state->used;
+  if (replay_timing_) {
+    // the gaps between the reads of the client are kept, counted from the
+    // first command sent
+    const SessionState::clock_type::time_point now = SessionState::clock_type::now();
+    if (!state->has_origin) {
+      state->client_origin = state->segments.front().read_at;
+      state->shadow_origin = now;
+      state->has_origin = true;
+    }
+    size = 0;
+    while (!state->segments.empty()) {
+      const SessionState::Segment &segment = state->segments.front();
+      const SessionState::clock_type::time_point due =
+          state->shadow_origin + (segment.read_at - state->client_origin);
+      if (due > now) {
+        if (size == 0) {
+          const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(due - now);
+          io_ctx_.schedule(std::max(delay, std::chrono::milliseconds(1)), [this, state] { pump(state); });
+          return;
+        }
+        break;
+      }
+      size += segment.size;
+      state->segments.pop_front();
+    }
+  }
+  state->take(size, state->out);
+  lock.unlock();
+
+  state->sock->write(&state->out[0], size, std::chrono::milliseconds(-1))
+      .start([this, state](std::error_code ec, size_t bytes_written) {
+        if (state->finished) return;
+        if (ec) {
+          log_debug("[%s] failed sending to mirror destination %s: %s", name_.c_str(),
+                    destination_.str().c_str(), ec.message().c_str());
+          finish(state, true);
+          return;
+        }
+        bytes_sent_ += bytes_written;
+        pump(state);
+      });
+}
+
+void TrafficMirror::finish(std::shared_ptr<SessionState> state, bool failed) {
+  if (state->finished) return;
+  state->finished = true;
+
+  {
+    std::lock_guard<std::mutex> lock(state->mtx);
+    state->stopped = true;
+    state->idle = false;
+    bytes_dropped_ += state->used;
+    state->used = 0;
+    state->segments.clear();
+  }
+
+  if (failed) ++failed_count_;
+  if (state->sock) state->sock->close();
+  sessions_.erase(state);
+}
+
+void TrafficMirror::wake(const std::shared_ptr<SessionState> &state) {
+  if (!state->idle) return;
+
+  state->idle = false;
+  io_ctx_.post([this, state] { pump(state); });
+}
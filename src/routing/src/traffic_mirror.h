@@ -0,0 +1,189 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_TRAFFIC_MIRROR_INCLUDED
+#define ROUTING_TRAFFIC_MIRROR_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "mysql/harness/async_socket.h"
+#include "mysql_router_thread.h"
+#include "protocol/base_protocol.h"
+#include "tcp_address.h"
+
+/**
+ * @brief TrafficMirror replays the classic protocol commands of the clients
+ *        of a route against a shadow server, e.g. to try a new server
+ *        version with production traffic.
+ *
+ * Each mirrored client connection gets a session to the shadow server,
+ * which authenticates as the same user with the password stored in the
+ * keyring, using mysql_native_password. The commands the client sends
+ * after its handshake are copied into a ring of buffer_size bytes of the
+ * session and sent by the background thread of the mirror, which serves
+ * all sessions in an IoContext. Responses of the shadow server are read
+ * and discarded.
+ *
+ * Copying never waits: a command that doesn't fit into the ring is dropped
+ * as a whole, the packets that follow it in the same command phase too. If
+ * a packet of a command already copied doesn't fit, the session stops
+ * mirroring. With replay_timing, the commands are sent with the gaps they
+ * were read with from the client, so the ring fills up more easily.
+ */
+class TrafficMirror : public std::enable_shared_from_this<TrafficMirror> {
+  struct SessionState;
+
+ public:
+  /** @brief counters describing the mirrored traffic */
+  struct Stats {
+    /** @brief sessions authenticated at the shadow server */
+    uint64_t sessions{0};
+    /** @brief sessions whose connect or authentication failed, or that stopped mirroring */
+    uint64_t failed{0};
+    /** @brief bytes sent to the shadow server */
+    uint64_t bytes_sent{0};
+    /** @brief bytes of the clients not sent as the rings were full */
+    uint64_t bytes_dropped{0};
+  };
+
+  /**
+   * @brief Mirrored client connection, the bytes of the client are passed to it.
+   *
+   * Destroying it ends the session once the copied bytes are sent.
+   */
+  class Session {
+   public:
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /**
+     * @brief Copies bytes the client sent after the handshake.
+     *
+     * Never blocks, drops the bytes that don't fit into the ring.
+     */
+    void client_data(const uint8_t *data, size_t size);
+
+   private:
+    friend class TrafficMirror;
+
+    Session(std::shared_ptr<TrafficMirror> mirror, std::shared_ptr<SessionState> state)
+        : mirror_(std::move(mirror)), state_(std::move(state)) {}
+
+    std::shared_ptr<TrafficMirror> mirror_;
+    std::shared_ptr<SessionState> state_;
+  };
+
+  /**
+   * @param sock_ops socket operations the sessions use
+   * @param destination address of the shadow server
+   * @param buffer_size bytes of the ring of each session
+   * @param replay_timing true to keep the gaps between the commands
+   * @param connect_timeout time connecting to and authenticating at the shadow server may take
+   *
+   * @throws std::system_error if the IoContext can't be created
+   */
+  TrafficMirror(mysql_harness::SocketOperationsBase *sock_ops,
+                const mysql_harness::TCPAddress &destination, size_t buffer_size,
+                bool replay_timing, std::chrono::milliseconds connect_timeout);
+
+  /**
+   * @brief Stops the background thread and closes the sessions.
+   */
+  ~TrafficMirror();
+
+  TrafficMirror(const TrafficMirror&) = delete;
+  TrafficMirror& operator=(const TrafficMirror&) = delete;
+
+  /**
+   * @brief Starts the background thread sending the traffic.
+   *
+   * @param name name of the route, for the name of the thread
+   * @param thread_stack_size stack size of the thread, in kilobytes
+   */
+  void start(const std::string &name, size_t thread_stack_size);
+
+  /**
+   * @brief Opens a session to the shadow server for a client.
+   *
+   * @param handshake_response Protocol::HandshakeResponse41 of the client
+   *
+   * @return the session or nullptr if the client is not mirrored, as it
+   *         uses TLS or compression or its password is not in the keyring
+   */
+  std::unique_ptr<Session> open_session(const RoutingProtocolBuffer &handshake_response);
+
+  /** @brief Returns the address of the shadow server */
+  const mysql_harness::TCPAddress& get_destination() const {
+    return destination_;
+  }
+
+  Stats get_stats() const;
+
+ private:
+  static void* run_thread(void *context);
+  void run();
+
+  /** @brief connects and authenticates the session, runs in the background thread */
+  void connect_session(std::shared_ptr<SessionState> state);
+
+  /** @brief sends the bytes copied into the ring, runs in the background thread */
+  void pump(std::shared_ptr<SessionState> state);
+
+  /** @brief reads and discards the responses of the shadow server */
+  void discard_responses(std::shared_ptr<SessionState> state);
+
+  /** @brief closes the session to the shadow server, runs in the background thread */
+  void finish(std::shared_ptr<SessionState> state, bool failed);
+
+  /** @brief runs pump() in the background thread unless it runs already, called with the lock of state held */
+  void wake(const std::shared_ptr<SessionState> &state);
+
+  mysql_harness::SocketOperationsBase *sock_ops_;
+  const mysql_harness::TCPAddress destination_;
+  const size_t buffer_size_;
+  const bool replay_timing_;
+  const std::chrono::milliseconds connect_timeout_;
+  std::string name_;
+
+  mysql_harness::IoContext io_ctx_;
+  std::unique_ptr<mysql_harness::MySQLRouterThread> thread_;
+
+  /** @brief sessions connected to the shadow server, only used by the background thread */
+  std::unordered_set<std::shared_ptr<SessionState>> sessions_;
+
+  std::atomic<uint64_t> sessions_count_{0};
+  std::atomic<uint64_t> failed_count_{0};
+  std::atomic<uint64_t> bytes_sent_{0};
+  std::atomic<uint64_t> bytes_dropped_{0};
+};
+
+#endif // ROUTING_TRAFFIC_MIRROR_INCLUDED
@@ -24,6 +24,8 @@
 
 #include "utils.h"
 
+#include "mysql/harness/networking/socket_endpoint.h"
+
 #include <algorithm>
 #include <assert.h>
 #include <cstring>
@@ -52,30 +54,9 @@ void *get_in_addr(struct sockaddr *addr) {
 }
 
 std::pair<std::string, int > get_peer_name(int sock) {
-  socklen_t sock_len;
-  struct sockaddr_storage addr;
-  char result_addr[105];  // For IPv4, IPv6 and Unix socket
-  int port;
-
-  sock_len = static_cast<socklen_t>(sizeof addr);
-  getpeername(sock, (struct sockaddr*)&addr, &sock_len);
-
-  if (addr.ss_family == AF_INET6) {
-    // IPv6
-    auto *sin6 = (struct sockaddr_in6 *)&addr;
-    port = ntohs(sin6->sin6_port);
-    inet_ntop(AF_INET6, &sin6->sin6_addr, result_addr, static_cast<socklen_t>(sizeof result_addr));
-  } else if (addr.ss_family == AF_INET) {
-    // IPv4
-    auto *sin4 = (struct sockaddr_in *)&addr;
-    port = ntohs(sin4->sin_port);
-    inet_ntop(AF_INET, &sin4->sin_addr, result_addr, static_cast<socklen_t>(sizeof result_addr));
-  } else if (addr.ss_family == AF_UNIX) {
-    // Unix socket, no good way to find peer
-    return std::make_pair(std::string("unix socket"), 0);
-  }
+  const mysql_harness::SocketEndpoint peer = mysql_harness::SocketEndpoint::peer_of(sock);
 
-  return std::make_pair(std::string(result_addr), port);
+  return std::make_pair(peer.address_str(), static_cast<int>(peer.port()));
 }
 
 std::vector<std::string> split_string(const std::string& data, const char delimiter, bool allow_empty) {
@@ -108,23 +89,7 @@ std::vector<std::string> split_string(const std::string& data, const char delimi
 }
 
 ClientIpArray in_addr_to_array(const sockaddr_storage &addr) {
-  ClientIpArray result{{0}};
-
-  switch (addr.ss_family) {
-  case AF_INET6:
-    {
-      const sockaddr_in6 *addr_intet6 = reinterpret_cast<const sockaddr_in6*>(&addr);
-      std::memcpy(result.data(), &addr_intet6->sin6_addr, sizeof(addr_intet6->sin6_addr));
-      break;
-    }
-  default:
-    {
-      const sockaddr_in *addr_intet = reinterpret_cast<const sockaddr_in*>(&addr);
-      std::memcpy(result.data(), &addr_intet->sin_addr, sizeof(addr_intet->sin_addr));
-    }
-  }
-
-  return result;
+  return mysql_harness::SocketEndpoint(addr).address_bytes();
 }
 
 
@@ -0,0 +1,225 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "warm_connection_pool.h"
+
+#include "common.h"
+#include "mysql/harness/logging/logging.h"
+#include "mysql_routing_common.h"
+#include "socket_operations.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#  include <poll.h>
+#endif
+
+IMPORT_LOG_FUNCTIONS()
+
+// required by C++11, deprecated in C++17
+constexpr std::chrono::milliseconds WarmConnectionPool::kRefillInterval;
+constexpr std::chrono::milliseconds WarmConnectionPool::kRetryInterval;
+
+WarmConnectionPool::WarmConnectionPool(mysql_harness::SocketOperationsBase *sock_ops,
+                                       ConnectFunction connect, size_t size,
+                                       std::chrono::milliseconds max_age)
+    : sock_ops_(sock_ops), connect_(std::move(connect)), size_(size), max_age_(max_age) {
+}
+
+WarmConnectionPool::~WarmConnectionPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopping_ = true;
+  }
+  refill_cond_.notify_all();
+  if (thread_) thread_->join();
+
+  clear();
+}
+
+void WarmConnectionPool::start(const std::string &name, size_t thread_stack_size) {
+  name_ = name;
+  thread_.reset(new mysql_harness::MySQLRouterThread(thread_stack_size));
+  thread_->run(&run_thread, this);
+}
+
+int WarmConnectionPool::take(const mysql_harness::TCPAddress &address) {
+  const auto now = std::chrono::steady_clock::now();
+  std::vector<int> to_close;
+  int sock = -1;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // the first client warms the server up
+    std::deque<Socket> &sockets = servers_[address].sockets;
+    take_expired(sockets, to_close, now);
+    while (!sockets.empty()) {
+      const int candidate = sockets.front().socket;
+      sockets.pop_front();
+      if (!is_closed(candidate)) {
+        sock = candidate;
+        break;
+      }
+      // the server went away meanwhile
+      to_close.push_back(candidate);
+    }
+
+    if (sock >= 0) {
+      ++stats_.hits;
+    } else {
+      ++stats_.misses;
+    }
+    refill_requested_ = true;
+  }
+  refill_cond_.notify_one();
+
+  close_all(to_close);
+  return sock;
+}
+
+void WarmConnectionPool::remove_not_allowed(const std::vector<mysql_harness::TCPAddress> &nodes) {
+  std::vector<int> to_close;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto it = servers_.begin(); it != servers_.end();) {
+      if (std::find(nodes.begin(), nodes.end(), it->first) != nodes.end()) {
+        ++it;
+        continue;
+      }
+      for (const Socket &s: it->second.sockets) to_close.push_back(s.socket);
+      it = servers_.erase(it);
+    }
+    ++generation_;
+  }
+
+  close_all(to_close);
+}
+
+void WarmConnectionPool::clear() {
+  std::vector<int> to_close;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &server: servers_) {
+      for (const Socket &s: server.second.sockets) to_close.push_back(s.socket);
+    }
+    servers_.clear();
+    ++generation_;
+  }
+
+  close_all(to_close);
+}
+
+WarmConnectionPool::Stats WarmConnectionPool::get_stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
+
+void* WarmConnectionPool::run_thread(void *context) {
+  static_cast<WarmConnectionPool*>(context)->run();
+  return nullptr;
+}
+
+void WarmConnectionPool::run() {
+  mysql_harness::rename_thread(get_routing_thread_name(name_, "RtW").c_str());  // "Rt warm" would be too long :(
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!stopping_) {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> expired;
+    std::vector<mysql_harness::TCPAddress> to_connect;
+    for (auto &server: servers_) {
+      take_expired(server.second.sockets, expired, now);
+      if (now < server.second.retry_at) continue;
+      for (size_t i = server.second.sockets.size(); i < size_; ++i) {
+        to_connect.push_back(server.first);
+      }
+    }
+    const uint64_t generation = generation_;
+    lock.unlock();
+
+    close_all(expired);
+
+    for (const auto &address: to_connect) {
+      // connects one by one, a server that doesn't answer only delays the others
+      const int sock = connect_(address);
+      now = std::chrono::steady_clock::now();
+
+      lock.lock();
+      auto it = servers_.find(address);
+      bool stored = false;
+      if (it != servers_.end() && generation == generation_ && !stopping_) {
+        if (sock < 0) {
+          it->second.retry_at = now + kRetryInterval;
+        } else if (it->second.sockets.size() < size_) {
+          it->second.sockets.push_back({sock, now});
+          stored = true;
+        }
+      }
+      const bool stop = stopping_ || generation != generation_;
+      lock.unlock();
+
+      if (sock >= 0 && !stored) sock_ops_->close(sock);
+      if (sock < 0) {
+        log_debug("[%s] failed connecting ahead to %s", name_.c_str(), address.str().c_str());
+      }
+      if (stop) break;
+    }
+
+    lock.lock();
+    refill_cond_.wait_for(lock, kRefillInterval, [this] { return stopping_ || refill_requested_; });
+    refill_requested_ = false;
+  }
+}
+
+bool WarmConnectionPool::is_closed(int sock) {
+  struct pollfd fds[] = {
+    {sock, POLLIN, 0},
+  };
+#ifdef POLLRDHUP
+  // the greeting of the server makes the socket readable already
+  fds[0].events |= POLLRDHUP;
+#endif
+  if (sock_ops_->poll(fds, 1, std::chrono::milliseconds(0)) < 0) return true;
+
+  short closed = POLLERR | POLLHUP | POLLNVAL;
+#ifdef POLLRDHUP
+  closed |= POLLRDHUP;
+#endif
+  return (fds[0].revents & closed) != 0;
+}
+
+void WarmConnectionPool::take_expired(std::deque<Socket> &sockets, std::vector<int> &expired,
+                                      std::chrono::steady_clock::time_point now) {
+  while (!sockets.empty() && now - sockets.front().connected_at >= max_age_) {
+    expired.push_back(sockets.front().socket);
+    sockets.pop_front();
+    ++stats_.expired;
+  }
+}
+
+void WarmConnectionPool::close_all(const std::vector<int> &sockets) {
+  for (int sock: sockets) {
+    sock_ops_->close(sock);
+  }
+}
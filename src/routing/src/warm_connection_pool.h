@@ -0,0 +1,171 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef ROUTING_WARM_CONNECTION_POOL_INCLUDED
+#define ROUTING_WARM_CONNECTION_POOL_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mysql_router_thread.h"
+#include "tcp_address.h"
+
+namespace mysql_harness { class SocketOperationsBase; }
+
+/**
+ * @brief WarmConnectionPool keeps connected TCP sockets to the servers, so
+ *        that new clients don't wait for the connect.
+ *
+ * The sockets are connected ahead by a background thread, before any data
+ * is exchanged: the greeting of a classic protocol server waits in the
+ * socket buffer until the client connection reads it. A server is warmed up
+ * once a client got a connection to it, connections taken are replaced in
+ * the background.
+ *
+ * A server that does not see the handshake finish within its connect_timeout
+ * closes the connection and counts it as a handshake error of the router
+ * host, max_age needs to leave enough of connect_timeout for the client.
+ * Sockets older than max_age are closed unused; as long as clients
+ * authenticate in between, the servers reset their error counts.
+ */
+class WarmConnectionPool {
+ public:
+  /** @brief connects to the server, returns the socket or -1 */
+  using ConnectFunction = std::function<int(const mysql_harness::TCPAddress&)>;
+
+  /** @brief counters describing the usage of the pool */
+  struct Stats {
+    /** @brief clients served by a connected socket */
+    uint64_t hits{0};
+    /** @brief clients that had to connect */
+    uint64_t misses{0};
+    /** @brief sockets closed unused as they got older than max_age */
+    uint64_t expired{0};
+  };
+
+  /** @brief interval the background thread checks the ages of the sockets at */
+  static constexpr std::chrono::milliseconds kRefillInterval{100};
+
+  /** @brief pause before connecting to a server again after a connect failed */
+  static constexpr std::chrono::milliseconds kRetryInterval{1000};
+
+  /**
+   * @param sock_ops socket operations closing and checking the sockets
+   * @param connect connects to a server, called by the background thread
+   * @param size connected sockets kept per server
+   * @param max_age time after which unused sockets get closed
+   */
+  WarmConnectionPool(mysql_harness::SocketOperationsBase *sock_ops, ConnectFunction connect,
+                     size_t size, std::chrono::milliseconds max_age);
+
+  /**
+   * @brief Stops the background thread and closes the sockets.
+   */
+  ~WarmConnectionPool();
+
+  WarmConnectionPool(const WarmConnectionPool&) = delete;
+  WarmConnectionPool& operator=(const WarmConnectionPool&) = delete;
+
+  /**
+   * @brief Starts the background thread connecting the sockets.
+   *
+   * @param name name of the route, for the name of the thread
+   * @param thread_stack_size stack size of the thread, in kilobytes
+   */
+  void start(const std::string &name, size_t thread_stack_size);
+
+  /**
+   * @brief Takes the oldest connected socket to the server.
+   *
+   * Warms the server up if it isn't yet and wakes the background thread to
+   * replace the socket taken.
+   *
+   * @return the socket or -1 if the caller has to connect
+   */
+  int take(const mysql_harness::TCPAddress &address);
+
+  /**
+   * @brief Closes the sockets of servers not in nodes, and stops warming them up.
+   */
+  void remove_not_allowed(const std::vector<mysql_harness::TCPAddress> &nodes);
+
+  /**
+   * @brief Closes all sockets and stops warming the servers up.
+   */
+  void clear();
+
+  Stats get_stats() const;
+
+ private:
+  struct Socket {
+    int socket;
+    std::chrono::steady_clock::time_point connected_at;
+  };
+  struct Server {
+    /** @brief connected sockets, oldest first */
+    std::deque<Socket> sockets;
+    /** @brief no connects before, set when a connect failed */
+    std::chrono::steady_clock::time_point retry_at;
+  };
+
+  static void* run_thread(void *context);
+  void run();
+
+  /** @brief true if the peer closed the socket or it has an error pending */
+  bool is_closed(int sock);
+
+  /** @brief moves sockets older than max_age to expired, called with mtx_ held */
+  void take_expired(std::deque<Socket> &sockets, std::vector<int> &expired,
+                    std::chrono::steady_clock::time_point now);
+
+  void close_all(const std::vector<int> &sockets);
+
+  mysql_harness::SocketOperationsBase *sock_ops_;
+  const ConnectFunction connect_;
+  const size_t size_;
+  const std::chrono::milliseconds max_age_;
+  std::string name_;
+
+  mutable std::mutex mtx_;
+  std::condition_variable refill_cond_;
+  std::map<mysql_harness::TCPAddress, Server> servers_;
+  /** @brief incremented by clear() and remove_not_allowed(), connects started before are dropped */
+  uint64_t generation_{0};
+  bool refill_requested_{false};
+  bool stopping_{false};
+  Stats stats_;
+
+  std::unique_ptr<mysql_harness::MySQLRouterThread> thread_;
+};
+
+#endif /* ROUTING_WARM_CONNECTION_POOL_INCLUDED */
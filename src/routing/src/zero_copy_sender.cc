@@ -0,0 +1,199 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "zero_copy_sender.h"
+
+#include <cerrno>
+
+#ifdef __linux__
+#  include <netinet/in.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <linux/errqueue.h>
+#  if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#    define ROUTING_ZERO_COPY 1
+#  endif
+#endif
+
+/*static*/
+bool ZeroCopySender::is_supported() noexcept {
+#ifdef ROUTING_ZERO_COPY
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ZeroCopySender::enable(int fd) {
+#ifdef ROUTING_ZERO_COPY
+  int one = 1;
+  if (usable_ && ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+    return true;
+  }
+#else
+  (void)fd;
+#endif
+  usable_ = false;
+  return false;
+}
+
+ssize_t ZeroCopySender::send_zero_copy(int fd, const uint8_t* data, size_t size) {
+#ifdef ROUTING_ZERO_COPY
+  if (!usable_) return 0;
+
+  ssize_t res;
+  do {
+    res = ::send(fd, data, size, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+  } while (res == -1 && errno == EINTR);
+
+  if (res == -1) {
+    switch (errno) {
+      case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+      case EWOULDBLOCK:
+#endif
+      // too many sends in flight for the optmem limit, copying still works
+      case ENOBUFS:
+        return 0;
+      case EOPNOTSUPP:
+      case EINVAL:
+        usable_ = false;
+        return 0;
+      default:
+        return -1;
+    }
+  }
+
+  // each send writing something gets an id, a partial one too
+  ++next_id_;
+  bytes_sent_ += static_cast<uint64_t>(res);
+  return res;
+#else
+  (void)fd;
+  (void)data;
+  (void)size;
+  return 0;
+#endif
+}
+
+ssize_t ZeroCopySender::send(int fd, const uint8_t* data, size_t size,
+                             RoutingBufferPool::Lease& buffer) {
+  const ssize_t res = send_zero_copy(fd, data, size);
+  if (res > 0) {
+    pending_.push_back(Pending{next_id_ - 1, std::move(buffer), nullptr});
+  }
+  return res;
+}
+
+ssize_t ZeroCopySender::send(int fd, const uint8_t* data, size_t size,
+                             std::unique_ptr<RoutingProtocolBuffer>& buffer) {
+  const ssize_t res = send_zero_copy(fd, data, size);
+  if (res > 0) {
+    pending_.push_back(Pending{next_id_ - 1, RoutingBufferPool::Lease(), std::move(buffer)});
+  }
+  return res;
+}
+
+size_t ZeroCopySender::reap(int fd) {
+  size_t completions = 0;
+#ifdef ROUTING_ZERO_COPY
+  while (!pending_.empty()) {
+    char control[128];
+    struct msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t res;
+    do {
+      res = ::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+    } while (res == -1 && errno == EINTR);
+    // EAGAIN once the error queue is empty
+    if (res == -1) break;
+
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      const struct sock_extended_err* serr =
+          reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) continue;
+
+      // copying in the kernel costs more than copying into the socket buffer
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) usable_ = false;
+      complete(serr->ee_info, serr->ee_data);
+      ++completions;
+    }
+  }
+#else
+  (void)fd;
+#endif
+  return completions;
+}
+
+void ZeroCopySender::complete(uint32_t first_id, uint32_t last_id) {
+  // ids wrap around, compare the distances
+  const uint32_t range = last_id - first_id;
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    if (static_cast<uint32_t>(it->id - first_id) > range) {
+      ++it;
+      continue;
+    }
+
+    if (it->buffer) spare_ = std::move(it->buffer);
+    it = pending_.erase(it);
+  }
+}
+
+bool ZeroCopySender::prepare_close(int fd, std::chrono::milliseconds timeout) {
+  reap(fd);
+  if (pending_.empty()) return false;
+
+#ifdef ROUTING_ZERO_COPY
+  using clock = std::chrono::steady_clock;
+  const auto deadline = clock::now() + timeout;
+  while (!pending_.empty()) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+    if (left.count() <= 0) break;
+
+    // completions are reported as an error event
+    struct pollfd fds[] = {{fd, 0, 0}};
+    if (::poll(fds, 1, static_cast<int>(left.count())) <= 0) break;
+    // an event without completions is a connection error, what is in
+    // flight can't be delivered anymore
+    if (reap(fd) == 0) break;
+  }
+  if (pending_.empty()) return false;
+
+  struct linger abort_on_close{1, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort_on_close, sizeof(abort_on_close));
+#endif
+  return true;
+}
+
+std::unique_ptr<RoutingProtocolBuffer> ZeroCopySender::take_spare(size_t size) {
+  if (!spare_ || spare_->size() != size) return nullptr;
+
+  return std::move(spare_);
+}
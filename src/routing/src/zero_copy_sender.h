@@ -0,0 +1,189 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_ZERO_COPY_SENDER_INCLUDED
+#define ROUTING_ZERO_COPY_SENDER_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#else
+typedef long ssize_t;
+#endif
+
+#include "buffer_pool.h"
+
+/**
+ * @brief ZeroCopySender writes to a socket using MSG_ZEROCOPY, so that the
+ *        kernel sends from the buffer itself instead of copying it.
+ *
+ * Only available on Linux. The kernel references the buffer until it
+ * reports the send as completed on the error queue of the socket, the
+ * buffer is kept until reap() reads that report. As completions make the
+ * socket report an error event, reap() has to be called whenever the
+ * socket is reported readable.
+ *
+ * Once the kernel reports that it copied the data anyway, like it does on
+ * loopback, is_usable() returns false and the caller is expected to copy.
+ */
+class ZeroCopySender {
+public:
+  /**
+   * @param threshold smallest write worth sending with MSG_ZEROCOPY
+   */
+  explicit ZeroCopySender(size_t threshold) : threshold_(threshold) {}
+
+  ZeroCopySender(const ZeroCopySender&) = delete;
+  ZeroCopySender& operator=(const ZeroCopySender&) = delete;
+
+  /**
+   * @brief Enables SO_ZEROCOPY on the socket.
+   *
+   * @return false if the socket or the kernel doesn't support it, the
+   *         sender is not usable then
+   */
+  bool enable(int fd);
+
+  /**
+   * @brief Returns true if a write of size bytes is to be sent using send().
+   */
+  bool wants(size_t size) const noexcept {
+    return usable_ && size >= threshold_;
+  }
+
+  /**
+   * @brief Writes data to the socket without blocking.
+   *
+   * If anything was written, buffer is taken and kept until the kernel is
+   * done with it, the rest of the data has to be copied by the caller.
+   *
+   * @param fd socket to write to
+   * @param data data to write, inside of buffer
+   * @param size number of bytes to write
+   * @param buffer buffer holding the data
+   *
+   * @return number of bytes written, 0 if nothing was written because the
+   *         socket buffer is full or the kernel refused MSG_ZEROCOPY, -1 on
+   *         error with errno set
+   */
+  ssize_t send(int fd, const uint8_t* data, size_t size, RoutingBufferPool::Lease& buffer);
+
+  /** @overload */
+  ssize_t send(int fd, const uint8_t* data, size_t size,
+               std::unique_ptr<RoutingProtocolBuffer>& buffer);
+
+  /**
+   * @brief Reads the completions from the error queue of the socket and
+   *        releases the buffers of the completed sends.
+   *
+   * @return number of completions read
+   */
+  size_t reap(int fd);
+
+  /**
+   * @brief Prepares the socket for getting closed.
+   *
+   * Waits up to timeout for the completions of the sends still in flight.
+   * If some are still pending then, the socket is set to be reset on close,
+   * dropping the data the kernel didn't send yet. The buffers are released
+   * on destruction and may be reused while the kernel still sends from them
+   * otherwise.
+   *
+   * A connection that is aborted passes a zero timeout and gets reset right
+   * away if anything is in flight.
+   *
+   * @param fd socket the sends were made on
+   * @param timeout how long to wait for the completions
+   * @return true if data in flight is dropped
+   */
+  bool prepare_close(int fd, std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Returns a buffer of size bytes the kernel is done with, if any.
+   *
+   * Buffers not borrowed from a pool are kept for reuse this way.
+   */
+  std::unique_ptr<RoutingProtocolBuffer> take_spare(size_t size);
+
+  /**
+   * @brief Returns false once MSG_ZEROCOPY turned out to be unsupported or
+   *        not worth it.
+   */
+  bool is_usable() const noexcept {
+    return usable_;
+  }
+
+  /** @brief Returns number of sends the kernel didn't report completed yet */
+  size_t get_pending() const noexcept {
+    return pending_.size();
+  }
+
+  /** @brief Returns number of bytes written using MSG_ZEROCOPY */
+  uint64_t get_bytes_sent() const noexcept {
+    return bytes_sent_;
+  }
+
+  /**
+   * @brief Returns true if MSG_ZEROCOPY is available on this platform.
+   */
+  static bool is_supported() noexcept;
+
+private:
+  /** @brief buffer of a send the kernel didn't report completed yet */
+  struct Pending {
+    /** @brief number of the send, counted by the kernel per socket */
+    uint32_t id;
+    RoutingBufferPool::Lease lease;
+    std::unique_ptr<RoutingProtocolBuffer> buffer;
+  };
+
+  /** @brief writes using MSG_ZEROCOPY, 0 if nothing was written */
+  ssize_t send_zero_copy(int fd, const uint8_t* data, size_t size);
+
+  /** @brief releases the buffers of the sends first_id to last_id */
+  void complete(uint32_t first_id, uint32_t last_id);
+
+  const size_t threshold_;
+
+  /** @brief false if MSG_ZEROCOPY is not used */
+  bool usable_{is_supported()};
+
+  /** @brief id the kernel gives the next send */
+  uint32_t next_id_{0};
+
+  /** @brief sends in flight, in the order they were written */
+  std::deque<Pending> pending_;
+
+  /** @brief completed buffer not borrowed from a pool */
+  std::unique_ptr<RoutingProtocolBuffer> spare_;
+
+  uint64_t bytes_sent_{0};
+};
+
+#endif /* ROUTING_ZERO_COPY_SENDER_INCLUDED */
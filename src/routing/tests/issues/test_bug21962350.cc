@@ -58,7 +58,9 @@ using mysql_harness::TCPAddress;
 using mysqlrouter::to_string;
 using ::testing::HasSubstr;
 using ::testing::Return;
+using ::testing::ElementsAre;
 using ::testing::Eq;
+using ::testing::SizeIs;
 using ::testing::_;
 
 class MockRouteDestination : public DestRoundRobin {
@@ -67,11 +69,13 @@ public:
     DestRoundRobin::add_to_quarantine(index);
   }
 
-  void cleanup_quarantine() noexcept {
-    DestRoundRobin::cleanup_quarantine();
+  bool cleanup_quarantine() noexcept {
+    return DestRoundRobin::cleanup_quarantine();
   }
 
   MOCK_METHOD3(get_mysql_socket, int(const TCPAddress &addr, std::chrono::milliseconds connect_timeout, bool log_errors));
+  MOCK_METHOD2(probe_mysql_servers, std::vector<bool>(const std::vector<TCPAddress> &addrs,
+                                                      std::chrono::milliseconds connect_timeout));
 };
 
 class Bug21962350 : public ::testing::Test {
@@ -136,11 +140,11 @@ TEST_F(Bug21962350, CleanupQuarantine) {
   exp = 3;
   ASSERT_EQ(exp, d.size_quarantine());
 
-  EXPECT_CALL(d, get_mysql_socket(_, _, _)).Times(4)
-    .WillOnce(Return(100))
-    .WillOnce(Return(-1))
-    .WillOnce(Return(300))
-    .WillOnce(Return(200));
+  // all quarantined servers get probed at once
+  EXPECT_CALL(d, probe_mysql_servers(SizeIs(3), _))
+    .WillOnce(Return(std::vector<bool>{true, false, true}));
+  EXPECT_CALL(d, probe_mysql_servers(ElementsAre(servers[1]), _))
+    .WillOnce(Return(std::vector<bool>{true}));
   d.cleanup_quarantine();
   // Second is still failing
   exp = 1;
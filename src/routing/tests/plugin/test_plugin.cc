@@ -174,7 +174,8 @@ TEST_F(RoutingPluginTests, PluginObject) {
   ASSERT_EQ(harness_plugin_routing.plugin_version, static_cast<uint32_t>(VERSION_NUMBER(0, 0, 1)));
   ASSERT_EQ(harness_plugin_routing.conflicts_length, 0U);
   ASSERT_THAT(harness_plugin_routing.conflicts, IsNull());
-  ASSERT_THAT(harness_plugin_routing.deinit, IsNull());
+  // removes the validator of reloaded sections
+  ASSERT_THAT(harness_plugin_routing.deinit, NotNull());
   ASSERT_THAT(harness_plugin_routing.brief,
               StrEq("Routing MySQL connections between MySQL clients/connectors and servers"));
 }
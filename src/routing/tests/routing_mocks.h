@@ -91,7 +91,8 @@ class MockRoutingSockOps : public routing::RoutingSockOpsInterface {
 
   MockSocketOperations* so() const override { return so_.get(); }
 
-  int get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds, bool = true) noexcept override {
+  int get_mysql_socket(mysql_harness::TCPAddress addr, std::chrono::milliseconds, bool = true,
+                       const routing::SocketOptions& = routing::SocketOptions()) noexcept override {
     get_mysql_socket_call_cnt_++;
     if (get_mysql_socket_fails_todo_) {
       so()->set_errno(ECONNREFUSED);
@@ -106,6 +107,29 @@ class MockRoutingSockOps : public routing::RoutingSockOpsInterface {
     }
   }
 
+  std::vector<bool> probe_mysql_servers(const std::vector<mysql_harness::TCPAddress>& addrs,
+                                        std::chrono::milliseconds connect_timeout) noexcept override {
+    std::vector<bool> reachable;
+    for (const auto& addr : addrs) {
+      reachable.push_back(get_mysql_socket(addr, connect_timeout, false) >= 0);
+    }
+    return reachable;
+  }
+
+  // one server after the other, the first one that doesn't fail wins
+  int get_mysql_socket_hedged(const std::vector<mysql_harness::TCPAddress>& addrs,
+                              std::chrono::milliseconds connect_timeout, std::chrono::milliseconds, bool,
+                              const routing::SocketOptions& options, size_t& connected) noexcept override {
+    for (size_t i = 0; i < addrs.size(); ++i) {
+      int sock = get_mysql_socket(addrs[i], connect_timeout, true, options);
+      if (sock >= 0) {
+        connected = i;
+        return sock;
+      }
+    }
+    return -1;
+  }
+
   int get_mysql_socket_call_cnt() {
     int cc = get_mysql_socket_call_cnt_;
     get_mysql_socket_call_cnt_ = 0;
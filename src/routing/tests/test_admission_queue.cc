@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "admission_queue.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using clock_type = AdmissionQueue::clock_type;
+
+/**
+ * @test
+ *       Verify that sockets are taken in the order they got pushed and
+ *       pushes fail once the queue is full.
+ */
+TEST(TestAdmissionQueue, FifoAndBounded) {
+  AdmissionQueue queue(2, milliseconds(100));
+  sockaddr_storage addr{};
+
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.push(10, addr));
+  EXPECT_TRUE(queue.push(11, addr));
+  EXPECT_FALSE(queue.push(12, addr));
+  EXPECT_EQ(2u, queue.size());
+
+  AdmissionQueue::Entry entry;
+  ASSERT_TRUE(queue.pop(entry));
+  EXPECT_EQ(10, entry.socket);
+  ASSERT_TRUE(queue.pop(entry));
+  EXPECT_EQ(11, entry.socket);
+  EXPECT_FALSE(queue.pop(entry));
+  EXPECT_TRUE(queue.empty());
+}
+
+/**
+ * @test
+ *       Verify that only the sockets that waited for the timeout expire.
+ */
+TEST(TestAdmissionQueue, Expires) {
+  AdmissionQueue queue(10, milliseconds(100));
+  sockaddr_storage addr{};
+  const auto now = clock_type::now();
+
+  queue.push(10, addr, now);
+  queue.push(11, addr, now + milliseconds(50));
+
+  EXPECT_TRUE(queue.pop_expired(now + milliseconds(99)).empty());
+
+  auto expired = queue.pop_expired(now + milliseconds(100));
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(10, expired[0].socket);
+  EXPECT_EQ(1u, queue.size());
+
+  EXPECT_EQ(1u, queue.pop_all().size());
+  EXPECT_TRUE(queue.empty());
+}
+
+#ifndef _WIN32
+/**
+ * @test
+ *       Verify that notify() only wakes up the acceptor if sockets wait.
+ */
+TEST(TestAdmissionQueue, NotifyWakesUpIfWaiting) {
+  AdmissionQueue queue(10, milliseconds(100));
+  sockaddr_storage addr{};
+  struct pollfd fds[] = {
+    { queue.get_wakeup_fd(), POLLIN, 0 },
+  };
+
+  queue.notify();
+  EXPECT_EQ(0, ::poll(fds, 1, 0));
+
+  queue.push(10, addr);
+  queue.notify();
+  queue.notify();
+  EXPECT_EQ(1, ::poll(fds, 1, 0));
+
+  queue.clear_wakeups();
+  EXPECT_EQ(0, ::poll(fds, 1, 0));
+}
+#endif
@@ -0,0 +1,698 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "backend_pool.h"
+#include "connection.h"
+#include "context.h"
+#include "destination.h"
+#include "keyring/keyring_manager.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/classic_protocol.h"
+#include "protocol/x_handshake.h"
+#include "protocol/x_protocol.h"
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+using mysql_protocol::Capabilities::Flags;
+using namespace mysql_protocol::Capabilities;
+
+static const std::chrono::milliseconds kTimeout(5000);
+
+static const uint32_t kClientCapabilities =
+    (PROTOCOL_41 | SECURE_CONNECTION | PLUGIN_AUTH).bits();
+
+static const RoutingProtocolBuffer kOkPacket = {0x07, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+
+/** @brief returns server greeting offering SSL with the given scramble */
+static RoutingProtocolBuffer make_greeting(uint8_t scramble_byte) {
+  const uint32_t caps = (PROTOCOL_41 | SECURE_CONNECTION | PLUGIN_AUTH | SSL).bits();
+  RoutingProtocolBuffer payload{10, '8', '.', '0', 0, 0x01, 0x00, 0x00, 0x00};
+  payload.insert(payload.end(), 8, scramble_byte);
+  payload.push_back(0);
+  payload.push_back(static_cast<uint8_t>(caps));
+  payload.push_back(static_cast<uint8_t>(caps >> 8));
+  payload.push_back(0x21);
+  payload.push_back(0x02);
+  payload.push_back(0x00);
+  payload.push_back(static_cast<uint8_t>(caps >> 16));
+  payload.push_back(static_cast<uint8_t>(caps >> 24));
+  payload.push_back(21);
+  payload.insert(payload.end(), 10, 0);
+  payload.insert(payload.end(), 12, scramble_byte);
+  payload.push_back(0);
+  const std::string plugin("mysql_native_password");
+  payload.insert(payload.end(), plugin.begin(), plugin.end());
+  payload.push_back(0);
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload.size()), 0, 0, 0};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+/** @brief returns handshake response of user "u" with 20 bytes auth-response */
+static RoutingProtocolBuffer make_handshake_response(uint8_t auth_byte) {
+  RoutingProtocolBuffer payload{
+      static_cast<uint8_t>(kClientCapabilities), static_cast<uint8_t>(kClientCapabilities >> 8),
+      static_cast<uint8_t>(kClientCapabilities >> 16), static_cast<uint8_t>(kClientCapabilities >> 24),
+      0x00, 0x00, 0x00, 0x01, 0x21};
+  payload.insert(payload.end(), 23, 0);
+  payload.push_back('u');
+  payload.push_back(0);
+  payload.push_back(20);
+  payload.insert(payload.end(), 20, auth_byte);
+  const std::string plugin("mysql_native_password");
+  payload.insert(payload.end(), plugin.begin(), plugin.end());
+  payload.push_back(0);
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload.size()), 0, 0, 1};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+static const mysql_harness::TCPAddress kServerAddress("127.0.0.1", 3306);
+static const mysql_harness::TCPAddress kOtherServerAddress("127.0.0.1", 3307);
+
+class TestBackendConnectionPool : public testing::Test {
+public:
+  void SetUp() override {
+    so_ = mysql_harness::SocketOperations::instance();
+    context_.reset(new MySQLRoutingContext(
+        new ClassicProtocol(routing::RoutingSockOps::instance(so_)),
+        so_, "routing_name",
+        routing::kDefaultNetBufferLength, kTimeout, kTimeout,
+        mysql_harness::TCPAddress(), mysql_harness::Path(), 100,
+        mysql_harness::kDefaultStackSizeInKiloBytes));
+    pool_.reset(new BackendConnectionPool(so_, 4, std::chrono::seconds(60)));
+    context_->set_backend_pool(pool_.get());
+  }
+
+  void TearDown() override {
+    pool_.reset();
+  }
+
+  /** @brief pools X protocol connections instead */
+  void use_x_protocol() {
+    context_.reset(new MySQLRoutingContext(
+        new XProtocol(routing::RoutingSockOps::instance(so_)),
+        so_, "routing_name",
+        routing::kDefaultNetBufferLength, kTimeout, kTimeout,
+        mysql_harness::TCPAddress(), mysql_harness::Path(), 100,
+        mysql_harness::kDefaultStackSizeInKiloBytes));
+    pool_.reset(new BackendConnectionPool(so_, 4, std::chrono::seconds(60),
+                                          BaseProtocol::Type::kXProtocol));
+    context_->set_backend_pool(pool_.get());
+  }
+
+  bool read_message(int sock, RoutingProtocolBuffer& message) {
+    return x_handshake::read_message(so_, sock, message, kTimeout);
+  }
+
+  bool read_packet(int sock, RoutingProtocolBuffer& packet) {
+    return classic_handshake::read_packet(so_, sock, packet, kTimeout);
+  }
+
+  void write_packet(int sock, const RoutingProtocolBuffer& packet) {
+    ASSERT_EQ(static_cast<ssize_t>(packet.size()), ::write(sock, packet.data(), packet.size()));
+  }
+
+  /** @brief runs connection of a client in its own thread
+   *
+   * fds[0] is the client end of the client socket pair, server is handed
+   * out by the server connector.
+   */
+  void run_connection(int client_fds[2], int server) {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds));
+    sockaddr_storage client_addr;
+    memset(&client_addr, 0, sizeof(client_addr));
+    client_addr.ss_family = AF_INET;
+
+    connection_.reset(new MySQLRoutingConnection(
+        *context_, client_fds[1], client_addr, routing::kInvalidSocket,
+        mysql_harness::TCPAddress(),
+        [](MySQLRoutingConnection*) {},
+        [this, server](mysql_harness::TCPAddress& address) {
+          // picks the server like a destination, asking for a pooled session to it first
+          address = kServerAddress;
+          const int pooled = RouteDestination::SessionReuse::take(address);
+          if (pooled >= 0) return pooled;
+
+          ++connector_calls_;
+          return next_server_ >= 0 ? next_server_.load() : server;
+        }));
+    thread_ = std::thread([this] { connection_->run(); });
+  }
+
+  void join_connection() {
+    thread_.join();
+    connection_.reset();
+  }
+
+  mysql_harness::SocketOperationsBase* so_;
+  std::unique_ptr<MySQLRoutingContext> context_;
+  std::unique_ptr<BackendConnectionPool> pool_;
+  std::unique_ptr<MySQLRoutingConnection> connection_;
+  std::thread thread_;
+  std::atomic<int> connector_calls_{0};
+  /** @brief server handed out by the connector instead of the one of run_connection() if set */
+  std::atomic<int> next_server_{-1};
+};
+
+/**
+ * @test
+ *       Verify that the server connection of a quitting client is reset and
+ *       reused for the next client with COM_CHANGE_USER.
+ */
+TEST_F(TestBackendConnectionPool, ReusesParkedConnection) {
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  RoutingProtocolBuffer packet;
+
+  // first client: handshake with the server is relayed
+  int client_fds[2];
+  run_connection(client_fds, server_fds[1]);
+  write_packet(server_fds[0], make_greeting(0x41));
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  classic_handshake::ServerGreeting greeting;
+  ASSERT_TRUE(classic_handshake::parse_server_greeting(packet, greeting, false));
+  EXPECT_FALSE(greeting.capabilities.test(SSL));
+
+  write_packet(client_fds[0], make_handshake_response(0x61));
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  EXPECT_EQ(make_handshake_response(0x61), packet);
+  write_packet(server_fds[0], kOkPacket);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(kOkPacket, packet);
+
+  // COM_QUIT parks the server connection
+  write_packet(client_fds[0], {0x01, 0x00, 0x00, 0x00, 0x01});
+  join_connection();
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  EXPECT_EQ(RoutingProtocolBuffer({0x01, 0x00, 0x00, 0x00, 0x1f}), packet);
+  write_packet(server_fds[0], {0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00});
+  EXPECT_EQ(1u, pool_->get_stats().idle);
+  ::close(client_fds[0]);
+
+  // second client: authenticates on the parked connection
+  run_connection(client_fds, routing::kInvalidSocket);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  write_packet(client_fds[0], make_handshake_response(0x62));
+
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(classic_handshake::make_auth_switch_request(2, "mysql_native_password",
+                                                        std::vector<uint8_t>(20, 0x41)),
+            packet);
+  RoutingProtocolBuffer auth_response{20, 0, 0, 3};
+  auth_response.insert(auth_response.end(), 20, 0x63);
+  write_packet(client_fds[0], auth_response);
+
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  RoutingProtocolBuffer change_user = mysql_protocol::ChangeUserPacket(
+      0, "u", std::vector<uint8_t>(20, 0x63), "", 0x21, "mysql_native_password", {},
+      Flags(kClientCapabilities));
+  EXPECT_EQ(change_user, packet);
+
+  write_packet(server_fds[0], {0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00});
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(4, packet[3]);
+  EXPECT_EQ(0x00, packet[4]);
+
+  // commands are forwarded as usual
+  const RoutingProtocolBuffer query{0x02, 0x00, 0x00, 0x00, 0x03, '1'};
+  write_packet(client_fds[0], query);
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  EXPECT_EQ(query, packet);
+
+  ::shutdown(client_fds[0], SHUT_RDWR);
+  join_connection();
+  ::close(client_fds[0]);
+  ::close(server_fds[0]);
+
+  EXPECT_EQ(1, connector_calls_);
+  EXPECT_EQ(1u, pool_->get_stats().reused);
+  EXPECT_EQ(0u, pool_->get_stats().idle);
+}
+
+/**
+ * @test
+ *       Verify that a new server connection is made if no parked connection
+ *       to the picked server matches and the client authenticates against
+ *       its scramble.
+ */
+TEST_F(TestBackendConnectionPool, ConnectsWithoutMatchingConnection) {
+  pool_->set_greeting(make_greeting(0x41));
+
+  // matches the client, but the strategy picks another server
+  int other_server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, other_server_fds));
+  BackendConnectionPool::Connection other;
+  other.socket = other_server_fds[1];
+  other.address = kOtherServerAddress;
+  other.capabilities = kClientCapabilities;
+  pool_->park(other);
+
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  RoutingProtocolBuffer packet;
+
+  int client_fds[2];
+  run_connection(client_fds, server_fds[1]);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(make_greeting(0x41), packet);
+  write_packet(client_fds[0], make_handshake_response(0x61));
+
+  write_packet(server_fds[0], make_greeting(0x42));
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(classic_handshake::make_auth_switch_request(2, "mysql_native_password",
+                                                        std::vector<uint8_t>(20, 0x42)),
+            packet);
+  RoutingProtocolBuffer auth_response{20, 0, 0, 3};
+  auth_response.insert(auth_response.end(), 20, 0x63);
+  write_packet(client_fds[0], auth_response);
+
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  EXPECT_EQ(make_handshake_response(0x63), packet);
+
+  write_packet(server_fds[0], {0x07, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00});
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(4, packet[3]);
+
+  ::shutdown(client_fds[0], SHUT_RDWR);
+  join_connection();
+  ::close(client_fds[0]);
+  ::close(server_fds[0]);
+  EXPECT_EQ(1, connector_calls_);
+  EXPECT_EQ(1u, pool_->get_stats().parked);
+  EXPECT_EQ(0u, pool_->get_stats().reused);
+  EXPECT_EQ(1u, pool_->get_stats().idle);
+
+  pool_.reset();
+  ::close(other_server_fds[0]);
+}
+
+/**
+ * @test
+ *       Verify that parked connections are only taken for clients with the
+ *       same capabilities to the same server and not after the idle timeout.
+ */
+TEST_F(TestBackendConnectionPool, TakeMatchesCapabilitiesAndIdleTimeout) {
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+
+  BackendConnectionPool::Connection connection;
+  connection.socket = server_fds[1];
+  connection.address = kServerAddress;
+  connection.capabilities = kClientCapabilities;
+  pool_->park(connection);
+  write_packet(server_fds[0], {0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00});
+
+  BackendConnectionPool::Connection taken;
+  EXPECT_FALSE(pool_->take(kServerAddress, kClientCapabilities | DEPRECATE_EOF.bits(), taken));
+  EXPECT_FALSE(pool_->take(kOtherServerAddress, kClientCapabilities, taken));
+  ASSERT_TRUE(pool_->take(kServerAddress, kClientCapabilities, taken));
+  EXPECT_EQ(server_fds[1], taken.socket);
+  EXPECT_FALSE(taken.reset_pending);
+
+  BackendConnectionPool short_pool(so_, 4, std::chrono::milliseconds(0));
+  short_pool.park(taken);
+  EXPECT_FALSE(short_pool.take(kServerAddress, kClientCapabilities, taken));
+  EXPECT_EQ(0u, short_pool.get_stats().idle);
+
+  ::close(server_fds[0]);
+}
+
+/**
+ * @test
+ *       Verify that with connection multiplexing the clean session of the
+ *       server connection is released after a read and taken again for the
+ *       next command of the client.
+ */
+TEST_F(TestBackendConnectionPool, MultiplexesCleanSessions) {
+  mysql_harness::init_keyring_with_key("test_backend_pool.keyring", "secret", true);
+  mysql_harness::get_keyring()->store("u", "password", "secret");
+  context_->set_connection_multiplexing(true);
+
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  RoutingProtocolBuffer packet;
+
+  int client_fds[2];
+  run_connection(client_fds, server_fds[1]);
+  write_packet(server_fds[0], make_greeting(0x41));
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  write_packet(client_fds[0], make_handshake_response(0x61));
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  write_packet(server_fds[0], kOkPacket);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+
+  const RoutingProtocolBuffer query{0x09, 0x00, 0x00, 0x00, 0x03, 'S', 'E', 'L', 'E', 'C', 'T', ' ', '1'};
+  const RoutingProtocolBuffer ok{0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+  for (int i = 0; i < 2; ++i) {
+    write_packet(client_fds[0], query);
+    ASSERT_TRUE(read_packet(server_fds[0], packet));
+    EXPECT_EQ(query, packet);
+    write_packet(server_fds[0], ok);
+    ASSERT_TRUE(read_packet(client_fds[0], packet));
+    EXPECT_EQ(ok, packet);
+  }
+
+  ::shutdown(client_fds[0], SHUT_RDWR);
+  join_connection();
+  ::close(client_fds[0]);
+
+  // the second command took the released session, no new connection
+  EXPECT_EQ(1, connector_calls_);
+  EXPECT_EQ(2u, pool_->get_stats().released);
+  EXPECT_EQ(1u, pool_->get_stats().shared);
+  EXPECT_EQ(1u, pool_->get_stats().idle);
+
+  pool_.reset();
+  ::close(server_fds[0]);
+  mysql_harness::reset_keyring();
+  std::remove("test_backend_pool.keyring");
+}
+
+/**
+ * @test
+ *       Verify that multiplexed clients get statement ids assigned by the
+ *       router, statements prepared in the session are reused and prepared
+ *       again, with their parameter types, in a new session.
+ */
+TEST_F(TestBackendConnectionPool, TranslatesPreparedStatements) {
+  mysql_harness::init_keyring_with_key("test_backend_pool.keyring", "secret", true);
+  mysql_harness::get_keyring()->store("u", "password", "secret");
+  context_->set_connection_multiplexing(true);
+  context_->set_prepared_statement_cache_size(16);
+
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  RoutingProtocolBuffer packet;
+
+  int client_fds[2];
+  run_connection(client_fds, server_fds[1]);
+  write_packet(server_fds[0], make_greeting(0x41));
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  write_packet(client_fds[0], make_handshake_response(0x61));
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  write_packet(server_fds[0], kOkPacket);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+
+  const RoutingProtocolBuffer prepare{0x09, 0x00, 0x00, 0x00, 0x16, 'S', 'E', 'L', 'E', 'C', 'T', ' ', '?'};
+  // statement id 7, no columns, one parameter
+  const RoutingProtocolBuffer prepare_ok{0x0c, 0x00, 0x00, 0x01, 0x00, 0x07, 0x00, 0x00, 0x00,
+                                         0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00};
+  const RoutingProtocolBuffer param{0x16, 0x00, 0x00, 0x02, 0x03, 'd', 'e', 'f', 0x00, 0x00, 0x00, 0x01,
+                                    'a', 0x00, 0x0c, 0x3f, 0x00, 0x01, 0x00, 0x00, 0x00, 0x08, 0x81,
+                                    0x00, 0x00, 0x00};
+  const RoutingProtocolBuffer eof{0x05, 0x00, 0x00, 0x03, 0xfe, 0x00, 0x00, 0x02, 0x00};
+  auto make_execute = [](uint8_t id, bool with_types) {
+    RoutingProtocolBuffer execute{0x00, 0x00, 0x00, 0x00, 0x17, id, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+                                  0x00, 0x00, 0x00};
+    execute.push_back(with_types ? 0x01 : 0x00);
+    if (with_types) {
+      execute.push_back(0x08);
+      execute.push_back(0x00);
+    }
+    execute.insert(execute.end(), {0x2a, 0, 0, 0, 0, 0, 0, 0});
+    execute[0] = static_cast<uint8_t>(execute.size() - 4);
+    return execute;
+  };
+  const RoutingProtocolBuffer ok{0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+
+  // the client gets the statement id 1 assigned by the router
+  write_packet(client_fds[0], prepare);
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  EXPECT_EQ(prepare, packet);
+  write_packet(server_fds[0], prepare_ok);
+  write_packet(server_fds[0], param);
+  write_packet(server_fds[0], eof);
+  RoutingProtocolBuffer expected = prepare_ok;
+  expected[5] = 0x01;
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(expected, packet);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(param, packet);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(eof, packet);
+
+  // and the server sees its own id
+  write_packet(client_fds[0], make_execute(1, true));
+  ASSERT_TRUE(read_packet(server_fds[0], packet));
+  EXPECT_EQ(make_execute(7, true), packet);
+  write_packet(server_fds[0], ok);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(ok, packet);
+
+  // a read-only statement leaves the session clean
+  for (int i = 0; i < 1000 && pool_->get_stats().released == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(1u, pool_->get_stats().released);
+
+  // the statement is prepared in the session already, the server isn't asked
+  write_packet(client_fds[0], prepare);
+  expected[5] = 0x02;
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(expected, packet);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(param, packet);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(eof, packet);
+  struct pollfd fds[] = {{server_fds[0], POLLIN, 0}};
+  EXPECT_EQ(0, ::poll(fds, 1, 0));
+
+  for (int i = 0; i < 1000 && pool_->get_stats().released < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(2u, pool_->get_stats().released);
+
+  // the next command gets a new session, which doesn't know the statement
+  int new_server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, new_server_fds));
+  next_server_ = new_server_fds[1];
+  pool_->remove_not_allowed({});
+
+  write_packet(client_fds[0], make_execute(1, false));
+  write_packet(new_server_fds[0], make_greeting(0x42));
+  ASSERT_TRUE(read_packet(new_server_fds[0], packet));
+  write_packet(new_server_fds[0], kOkPacket);
+
+  ASSERT_TRUE(read_packet(new_server_fds[0], packet));
+  EXPECT_EQ(prepare, packet);
+  RoutingProtocolBuffer new_prepare_ok = prepare_ok;
+  new_prepare_ok[5] = 0x03;
+  write_packet(new_server_fds[0], new_prepare_ok);
+  write_packet(new_server_fds[0], param);
+  write_packet(new_server_fds[0], eof);
+
+  // the parameter types are sent to the new statement
+  ASSERT_TRUE(read_packet(new_server_fds[0], packet));
+  EXPECT_EQ(make_execute(3, true), packet);
+  write_packet(new_server_fds[0], ok);
+  ASSERT_TRUE(read_packet(client_fds[0], packet));
+  EXPECT_EQ(ok, packet);
+
+  ::shutdown(client_fds[0], SHUT_RDWR);
+  join_connection();
+  ::close(client_fds[0]);
+  EXPECT_EQ(2, connector_calls_);
+
+  pool_.reset();
+  ::close(server_fds[0]);
+  ::close(new_server_fds[0]);
+  mysql_harness::reset_keyring();
+  std::remove("test_backend_pool.keyring");
+}
+
+/**
+ * @test
+ *       Verify that released sessions are kept without a reset and only
+ *       taken again for the same session identity.
+ */
+TEST_F(TestBackendConnectionPool, TakeSessionMatchesSessionKey) {
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+
+  BackendConnectionPool::Connection connection;
+  connection.socket = server_fds[1];
+  connection.address = kServerAddress;
+  connection.capabilities = kClientCapabilities;
+  connection.session_key = "u/db/33";
+  pool_->release(connection);
+  EXPECT_EQ(1u, pool_->get_stats().released);
+
+  BackendConnectionPool::Connection taken;
+  EXPECT_FALSE(pool_->take_session(kServerAddress, "", taken));
+  EXPECT_FALSE(pool_->take_session(kServerAddress, "v/db/33", taken));
+  EXPECT_FALSE(pool_->take_session(kOtherServerAddress, "u/db/33", taken));
+  ASSERT_TRUE(pool_->take_session(kServerAddress, "u/db/33", taken));
+  EXPECT_EQ(server_fds[1], taken.socket);
+  EXPECT_EQ(1u, pool_->get_stats().shared);
+
+  // nothing was sent to the server, the session is kept as it is
+  struct pollfd fds[] = {{server_fds[0], POLLIN, 0}};
+  EXPECT_EQ(0, ::poll(fds, 1, 0));
+
+  // parking resets the session, it is no longer taken by identity
+  pool_->park(taken);
+  EXPECT_FALSE(pool_->take_session(kServerAddress, "u/db/33", taken));
+  EXPECT_EQ(1u, pool_->get_stats().idle);
+
+  // closes the parked connection while the server end is still open
+  pool_.reset();
+  ::close(server_fds[0]);
+}
+
+static const RoutingProtocolBuffer kXCapabilitiesGet = {0x01, 0x00, 0x00, 0x00, 0x01};
+static const RoutingProtocolBuffer kXCapabilities = {0x03, 0x00, 0x00, 0x00, 0x02, 0x0a, 0x00};
+static const RoutingProtocolBuffer kXAuthenticateStart = {0x08, 0x00, 0x00, 0x00, 0x04,
+                                                          0x0a, 0x05, 'P', 'L', 'A', 'I', 'N'};
+static const RoutingProtocolBuffer kXOk = {0x01, 0x00, 0x00, 0x00, 0x00};
+
+/**
+ * @test
+ *       Verify that the X protocol server connection of a client closing
+ *       its session is reset and the next client authenticates on it.
+ */
+TEST_F(TestBackendConnectionPool, ReusesParkedXConnection) {
+  use_x_protocol();
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  RoutingProtocolBuffer message;
+
+  // first client: asking for the capabilities connects the server
+  int client_fds[2];
+  run_connection(client_fds, server_fds[1]);
+  write_packet(client_fds[0], kXCapabilitiesGet);
+  ASSERT_TRUE(read_message(server_fds[0], message));
+  EXPECT_EQ(kXCapabilitiesGet, message);
+  write_packet(server_fds[0], kXCapabilities);
+  ASSERT_TRUE(read_message(client_fds[0], message));
+  EXPECT_EQ(kXCapabilities, message);
+
+  write_packet(client_fds[0], kXAuthenticateStart);
+  ASSERT_TRUE(read_message(server_fds[0], message));
+  EXPECT_EQ(kXAuthenticateStart, message);
+  // AuthenticateOk
+  write_packet(server_fds[0], {0x01, 0x00, 0x00, 0x00, 0x04});
+  ASSERT_TRUE(read_message(client_fds[0], message));
+  EXPECT_EQ(0x04, x_handshake::get_type(message));
+
+  // Session.Close is answered by the router and parks the server connection
+  write_packet(client_fds[0], {0x01, 0x00, 0x00, 0x00, 0x07});
+  ASSERT_TRUE(read_message(client_fds[0], message));
+  EXPECT_EQ(kXOk, message);
+  join_connection();
+  ASSERT_TRUE(read_message(server_fds[0], message));
+  EXPECT_EQ(RoutingProtocolBuffer({0x01, 0x00, 0x00, 0x00, 0x06}), message);
+  ASSERT_TRUE(read_message(server_fds[0], message));
+  EXPECT_EQ(kXCapabilitiesGet, message);
+  write_packet(server_fds[0], kXOk);
+  write_packet(server_fds[0], kXCapabilities);
+  EXPECT_EQ(1u, pool_->get_stats().idle);
+  ::close(client_fds[0]);
+
+  // second client: capabilities come from the router, authentication from
+  // the parked connection
+  run_connection(client_fds, routing::kInvalidSocket);
+  write_packet(client_fds[0], kXCapabilitiesGet);
+  ASSERT_TRUE(read_message(client_fds[0], message));
+  EXPECT_EQ(kXCapabilities, message);
+  write_packet(client_fds[0], kXAuthenticateStart);
+  ASSERT_TRUE(read_message(server_fds[0], message));
+  EXPECT_EQ(kXAuthenticateStart, message);
+
+  ::shutdown(client_fds[0], SHUT_RDWR);
+  join_connection();
+  ::close(client_fds[0]);
+  ::close(server_fds[0]);
+
+  EXPECT_EQ(1, connector_calls_);
+  EXPECT_EQ(1u, pool_->get_stats().reused);
+  EXPECT_EQ(0u, pool_->get_stats().idle);
+}
+
+/**
+ * @test
+ *       Verify that results of the last client are skipped and a refused
+ *       Session.Reset closes the parked X protocol connection.
+ */
+TEST_F(TestBackendConnectionPool, TakeCapabilitiesFinishesXReset) {
+  use_x_protocol();
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+
+  BackendConnectionPool::Connection connection;
+  connection.socket = server_fds[1];
+  connection.address = kServerAddress;
+  pool_->park(connection);
+  // a notice and a row of the last client come before the responses
+  write_packet(server_fds[0], {0x01, 0x00, 0x00, 0x00, 0x0b});
+  write_packet(server_fds[0], {0x01, 0x00, 0x00, 0x00, 0x0d});
+  write_packet(server_fds[0], kXOk);
+  write_packet(server_fds[0], kXCapabilities);
+
+  BackendConnectionPool::Connection taken;
+  EXPECT_FALSE(pool_->take_capabilities(kServerAddress, "other", taken));
+  EXPECT_FALSE(pool_->take_capabilities(kOtherServerAddress, "", taken));
+  ASSERT_TRUE(pool_->take_capabilities(kServerAddress, "", taken));
+  EXPECT_EQ(server_fds[1], taken.socket);
+  EXPECT_FALSE(taken.reset_pending);
+  RoutingProtocolBuffer capabilities;
+  ASSERT_TRUE(pool_->get_greeting(capabilities));
+  EXPECT_EQ(kXCapabilities, capabilities);
+
+  // Error instead of Ok
+  pool_->park(taken);
+  write_packet(server_fds[0], {0x01, 0x00, 0x00, 0x00, 0x01});
+  write_packet(server_fds[0], kXCapabilities);
+  EXPECT_FALSE(pool_->take_capabilities(kServerAddress, "", taken));
+  EXPECT_EQ(0u, pool_->get_stats().idle);
+
+  ::close(server_fds[0]);
+}
+
+#endif  // _WIN32
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "buffer_arena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+/**
+ * @test
+ *       Verify that sizes are rounded up to their size class, and to whole
+ *       slabs above the slab size.
+ */
+TEST(TestBufferArena, BufferSize) {
+  EXPECT_EQ(BufferArena::kMinBufferSize, BufferArena::get_buffer_size(1));
+  EXPECT_EQ(BufferArena::kMinBufferSize, BufferArena::get_buffer_size(4096));
+  EXPECT_EQ(8192u, BufferArena::get_buffer_size(4097));
+  EXPECT_EQ(16384u, BufferArena::get_buffer_size(16384));
+  EXPECT_EQ(BufferArena::kSlabSize, BufferArena::get_buffer_size(BufferArena::kSlabSize));
+  EXPECT_EQ(2 * BufferArena::kSlabSize, BufferArena::get_buffer_size(BufferArena::kSlabSize + 1));
+}
+
+/**
+ * @test
+ *       Verify that buffers of a size class are carved from one slab aligned
+ *       to the slab size and that released buffers are handed out again.
+ */
+TEST(TestBufferArena, CarvesBuffersFromSlabs) {
+  BufferArena arena(BufferArena::HugePages::kNone);
+
+  uint8_t* first = arena.allocate(16384);
+  uint8_t* second = arena.allocate(16384);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(first) % BufferArena::kSlabSize);
+  EXPECT_EQ(first + 16384, second);
+  std::memset(first, 0xa5, 16384);
+  std::memset(second, 0x5a, 16384);
+
+  BufferArena::Stats stats = arena.get_stats();
+  EXPECT_EQ(1u, stats.slabs);
+  EXPECT_EQ(BufferArena::kSlabSize, stats.bytes_reserved);
+  EXPECT_EQ(0u, stats.transparent_huge_page_slabs);
+  EXPECT_EQ(0u, stats.explicit_huge_page_slabs);
+
+  arena.deallocate(first, 16384);
+  EXPECT_EQ(first, arena.allocate(16384));
+
+  // another size class takes another slab
+  uint8_t* small = arena.allocate(100);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(small) % BufferArena::kSlabSize);
+  EXPECT_EQ(2u, arena.get_stats().slabs);
+
+  arena.deallocate(small, 100);
+  arena.deallocate(second, 16384);
+  arena.deallocate(first, 16384);
+  EXPECT_EQ(2u, arena.get_stats().slabs);
+}
+
+/**
+ * @test
+ *       Verify that all buffers of a slab are handed out before the next
+ *       slab is reserved.
+ */
+TEST(TestBufferArena, FillsSlabBeforeReservingNext) {
+  BufferArena arena(BufferArena::HugePages::kNone);
+  const size_t buffers_per_slab = BufferArena::kSlabSize / 65536;
+
+  std::vector<uint8_t*> buffers;
+  for (size_t i = 0; i < buffers_per_slab; ++i) buffers.push_back(arena.allocate(65536));
+  EXPECT_EQ(1u, arena.get_stats().slabs);
+
+  buffers.push_back(arena.allocate(65536));
+  EXPECT_EQ(2u, arena.get_stats().slabs);
+
+  for (uint8_t* buffer: buffers) arena.deallocate(buffer, 65536);
+}
+
+/**
+ * @test
+ *       Verify that buffers larger than a slab get a mapping of their own
+ *       that is returned on deallocate().
+ */
+TEST(TestBufferArena, LargeBuffersAreMappedOnTheirOwn) {
+  BufferArena arena(BufferArena::HugePages::kNone);
+
+  const size_t size = BufferArena::kSlabSize + 1;
+  uint8_t* buffer = arena.allocate(size);
+  std::memset(buffer, 0, size);
+
+  BufferArena::Stats stats = arena.get_stats();
+  EXPECT_EQ(0u, stats.slabs);
+  EXPECT_EQ(2 * BufferArena::kSlabSize, stats.bytes_reserved);
+
+  arena.deallocate(buffer, size);
+  EXPECT_EQ(0u, arena.get_stats().bytes_reserved);
+}
+
+#ifdef __linux__
+/**
+ * @test
+ *       Verify that a slab is reserved even if no explicit huge pages are
+ *       available, falling back to transparent or normal pages.
+ */
+TEST(TestBufferArena, ExplicitHugePagesFallBack) {
+  BufferArena arena(BufferArena::HugePages::kExplicit);
+
+  uint8_t* buffer = arena.allocate(16384);
+  std::memset(buffer, 0, 16384);
+
+  BufferArena::Stats stats = arena.get_stats();
+  EXPECT_EQ(1u, stats.slabs);
+  // either explicit ones were reserved, or the fallback took over
+  EXPECT_LE(stats.explicit_huge_page_slabs + stats.transparent_huge_page_slabs, 1u);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer) % BufferArena::kSlabSize);
+
+  arena.deallocate(buffer, 16384);
+}
+#endif
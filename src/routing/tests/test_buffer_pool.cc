@@ -0,0 +1,221 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "buffer_pool.h"
+#include "test/helpers.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+/**
+ * @test
+ *       Verify that returned buffers are reused and counted as hits.
+ */
+TEST(TestRoutingBufferPool, ReusesReturnedBuffers) {
+  RoutingBufferPool pool(1024, 4);
+
+  uint8_t* first;
+  {
+    RoutingBufferPool::Lease lease = pool.acquire();
+    ASSERT_TRUE(static_cast<bool>(lease));
+    EXPECT_EQ(1024u, (*lease).size());
+    first = (*lease).data();
+    EXPECT_EQ(1u, pool.get_stats().in_use);
+  }
+
+  RoutingBufferPool::Lease lease = pool.acquire();
+  EXPECT_EQ(first, (*lease).data());
+
+  RoutingBufferPool::Stats stats = pool.get_stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(1u, stats.in_use);
+  EXPECT_EQ(1u, stats.high_water);
+  EXPECT_EQ(0u, stats.idle);
+}
+
+/**
+ * @test
+ *       Verify that high water mark tracks the buffers lent at the same time
+ *       and only max_idle_buffers buffers are kept once returned.
+ */
+TEST(TestRoutingBufferPool, HighWaterAndIdleLimit) {
+  RoutingBufferPool pool(16, 2);
+  {
+    RoutingBufferPool::Lease a = pool.acquire();
+    RoutingBufferPool::Lease b = pool.acquire();
+    RoutingBufferPool::Lease c = pool.acquire();
+  }
+
+  RoutingBufferPool::Stats stats = pool.get_stats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(3u, stats.misses);
+  EXPECT_EQ(1u, stats.evictions);
+  EXPECT_EQ(0u, stats.in_use);
+  EXPECT_EQ(3u, stats.high_water);
+  EXPECT_EQ(2u, stats.idle);
+
+  pool.set_max_idle_buffers(1);
+  stats = pool.get_stats();
+  EXPECT_EQ(1u, stats.idle);
+  EXPECT_EQ(2u, stats.evictions);
+}
+
+/**
+ * @test
+ *       Verify that the counters of several pools add up, as they are
+ *       summed up over the I/O threads.
+ */
+TEST(TestRoutingBufferPool, StatsAddUp) {
+  RoutingBufferPool first(16, 0);
+  RoutingBufferPool second(16, 1);
+  {
+    RoutingBufferPool::Lease a = first.acquire();
+  }
+  for (int i = 0; i < 3; ++i) {
+    RoutingBufferPool::Lease b = second.acquire();
+  }
+
+  RoutingBufferPool::Stats stats = first.get_stats();
+  stats += second.get_stats();
+  EXPECT_EQ(2u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(1u, stats.evictions);
+  EXPECT_EQ(2u, stats.high_water);
+  EXPECT_EQ(1u, stats.idle);
+}
+
+/**
+ * @test
+ *       Verify that a moved lease returns its buffer only once.
+ */
+TEST(TestRoutingBufferPool, MovedLease) {
+  RoutingBufferPool pool(16, 4);
+  {
+    RoutingBufferPool::Lease lease;
+    EXPECT_FALSE(static_cast<bool>(lease));
+
+    lease = pool.acquire();
+    RoutingBufferPool::Lease other(std::move(lease));
+    EXPECT_FALSE(static_cast<bool>(lease));
+    EXPECT_TRUE(static_cast<bool>(other));
+  }
+
+  RoutingBufferPool::Stats stats = pool.get_stats();
+  EXPECT_EQ(0u, stats.in_use);
+  EXPECT_EQ(1u, stats.idle);
+}
+
+/**
+ * @test
+ *       Verify that buffers are taken from the arena once one is set and
+ *       returned to it once not kept for reuse.
+ */
+TEST(TestRoutingBufferPool, TakesBuffersFromArena) {
+  RoutingBufferPool pool(16384, 1);
+  auto arena = std::make_shared<BufferArena>(BufferArena::HugePages::kNone);
+  pool.set_arena(arena);
+
+  uint8_t* first;
+  uint8_t* second;
+  {
+    RoutingBufferPool::Lease a = pool.acquire();
+    RoutingBufferPool::Lease b = pool.acquire();
+    EXPECT_EQ(16384u, (*a).size());
+    first = (*a).data();
+    second = (*b).data();
+    // neighbours in the same slab
+    EXPECT_EQ(first + 16384, second);
+  }
+  EXPECT_EQ(1u, arena->get_stats().slabs);
+  EXPECT_EQ(1u, pool.get_stats().idle);
+
+  // b was kept for reuse, a went back to the arena and is handed out again
+  RoutingBufferPool::Lease a = pool.acquire();
+  RoutingBufferPool::Lease b = pool.acquire();
+  RoutingBufferPool::Lease c = pool.acquire();
+  EXPECT_EQ(1u, arena->get_stats().slabs);
+  EXPECT_EQ(second, (*a).data());
+  EXPECT_EQ(first, (*b).data());
+  EXPECT_EQ(1u, pool.get_stats().hits);
+  EXPECT_EQ(4u, pool.get_stats().misses);
+}
+
+/**
+ * @test
+ *       Verify that consecutive full reads double the size up to the max.
+ */
+TEST(TestAdaptiveBufferSize, GrowsOnFullReads) {
+  AdaptiveBufferSize size(1024, 3000);
+  EXPECT_EQ(1024u, size.get());
+
+  for (unsigned i = 0; i < AdaptiveBufferSize::kGrowAfterReads - 1; ++i) size.update(1024);
+  EXPECT_EQ(1024u, size.get());
+
+  // a partial read restarts the counting
+  size.update(600);
+  for (unsigned i = 0; i < AdaptiveBufferSize::kGrowAfterReads - 1; ++i) size.update(1024);
+  EXPECT_EQ(1024u, size.get());
+  size.update(1024);
+  EXPECT_EQ(2048u, size.get());
+
+  for (unsigned i = 0; i < AdaptiveBufferSize::kGrowAfterReads * 4; ++i) size.update(size.get());
+  EXPECT_EQ(3000u, size.get());
+}
+
+/**
+ * @test
+ *       Verify that consecutive small reads halve the size down to the min.
+ */
+TEST(TestAdaptiveBufferSize, ShrinksOnSmallReads) {
+  AdaptiveBufferSize size(1024, 4096);
+  for (unsigned i = 0; i < AdaptiveBufferSize::kGrowAfterReads * 2; ++i) size.update(size.get());
+  ASSERT_EQ(4096u, size.get());
+
+  for (unsigned i = 0; i < AdaptiveBufferSize::kShrinkAfterReads - 1; ++i) size.update(100);
+  EXPECT_EQ(4096u, size.get());
+  size.update(100);
+  EXPECT_EQ(2048u, size.get());
+
+  for (unsigned i = 0; i < AdaptiveBufferSize::kShrinkAfterReads * 4; ++i) size.update(100);
+  EXPECT_EQ(1024u, size.get());
+}
+
+/**
+ * @test
+ *       Verify that the size stays fixed if max is not above min.
+ */
+TEST(TestAdaptiveBufferSize, Disabled) {
+  AdaptiveBufferSize size(1024, 0);
+  for (unsigned i = 0; i < AdaptiveBufferSize::kGrowAfterReads * 2; ++i) size.update(1024);
+  EXPECT_EQ(1024u, size.get());
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <chrono>
+
+#include "circuit_breaker.h"
+#include "destination_scoreboard.h"
+#include "tcp_address.h"
+
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using State = CircuitBreaker::State;
+
+class CircuitBreakerTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    breaker_.configure(3, milliseconds(100), 2);
+  }
+
+  CircuitBreaker breaker_;
+  const std::chrono::steady_clock::time_point start_{std::chrono::steady_clock::now()};
+};
+
+TEST_F(CircuitBreakerTest, DisabledNeverOpens)
+{
+  CircuitBreaker breaker;
+  for (int i = 0; i < 100; ++i) EXPECT_FALSE(breaker.failed(start_));
+  EXPECT_EQ(State::kClosed, breaker.get_state());
+  EXPECT_TRUE(breaker.allows(start_));
+}
+
+TEST_F(CircuitBreakerTest, OpensAfterFailuresInARow)
+{
+  EXPECT_FALSE(breaker_.failed(start_));
+  EXPECT_FALSE(breaker_.failed(start_));
+  // a success starts the count again
+  EXPECT_FALSE(breaker_.succeeded());
+  EXPECT_FALSE(breaker_.failed(start_));
+  EXPECT_FALSE(breaker_.failed(start_));
+  EXPECT_EQ(State::kClosed, breaker_.get_state());
+
+  EXPECT_TRUE(breaker_.failed(start_));
+  EXPECT_EQ(State::kOpen, breaker_.get_state());
+  EXPECT_FALSE(breaker_.allows(start_ + milliseconds(99)));
+  EXPECT_TRUE(breaker_.allows(start_ + milliseconds(100)));
+}
+
+TEST_F(CircuitBreakerTest, HalfOpenClosesOnceProbesSucceeded)
+{
+  for (int i = 0; i < 3; ++i) breaker_.failed(start_);
+
+  const auto later = start_ + milliseconds(100);
+  breaker_.admitted(later);
+  EXPECT_EQ(State::kHalfOpen, breaker_.get_state());
+  breaker_.admitted(later);
+  // both probes are taken
+  EXPECT_FALSE(breaker_.allows(later));
+
+  // a client that gave up frees its probe
+  breaker_.abandoned();
+  EXPECT_TRUE(breaker_.allows(later));
+  breaker_.admitted(later);
+
+  EXPECT_FALSE(breaker_.succeeded());
+  EXPECT_EQ(State::kHalfOpen, breaker_.get_state());
+  EXPECT_TRUE(breaker_.succeeded());
+  EXPECT_EQ(State::kClosed, breaker_.get_state());
+  EXPECT_TRUE(breaker_.allows(later));
+}
+
+TEST_F(CircuitBreakerTest, HalfOpenReopensOnFailure)
+{
+  for (int i = 0; i < 3; ++i) breaker_.failed(start_);
+
+  const auto later = start_ + milliseconds(100);
+  breaker_.admitted(later);
+  EXPECT_TRUE(breaker_.failed(later));
+  EXPECT_EQ(State::kOpen, breaker_.get_state());
+  // the interval starts again
+  EXPECT_FALSE(breaker_.allows(later + milliseconds(99)));
+  EXPECT_TRUE(breaker_.allows(later + milliseconds(100)));
+}
+
+TEST(DestinationScoreboardCircuitTest, ConfiguresAllScores)
+{
+  DestinationScoreboard scoreboard;
+  auto before = scoreboard.get(mysql_harness::TCPAddress("11", 1));
+  scoreboard.set_circuit_breaker(1, milliseconds(100), 1);
+  auto after = scoreboard.get(mysql_harness::TCPAddress("12", 1));
+
+  const auto now = std::chrono::steady_clock::now();
+  EXPECT_TRUE(before->get_circuit_breaker().failed(now));
+  EXPECT_TRUE(after->get_circuit_breaker().failed(now));
+  for (const auto &score: scoreboard.get_scores()) {
+    EXPECT_EQ("open", score.circuit_state);
+  }
+}
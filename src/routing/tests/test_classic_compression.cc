@@ -0,0 +1,284 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "protocol/classic_compression.h"
+#include "connection.h"
+#include "context.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/classic_protocol.h"
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifdef HAVE_ZLIB
+
+namespace Capabilities = mysql_protocol::Capabilities;
+
+static const std::chrono::milliseconds kTimeout(5000);
+
+static const RoutingProtocolBuffer kPing{0x01, 0x00, 0x00, 0x00, 0x0e};
+
+/** @brief returns COM_QUERY packet with a statement of the given size */
+static RoutingProtocolBuffer make_query(size_t size, uint8_t seq_id = 0) {
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(size + 1), static_cast<uint8_t>((size + 1) >> 8),
+                               static_cast<uint8_t>((size + 1) >> 16), seq_id, 0x03};
+  const std::string sql = "SELECT * FROM t WHERE c = 'a'";
+  for (size_t i = 0; i < size; ++i) packet.push_back(static_cast<uint8_t>(sql[i % sql.size()]));
+  return packet;
+}
+
+TEST(ClassicCompression, SmallPacketsUncompressed) {
+  ClassicCompression compression;
+  RoutingProtocolBuffer out;
+
+  compression.compress(kPing.data(), kPing.size(), out);
+  RoutingProtocolBuffer expected{0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  expected.insert(expected.end(), kPing.begin(), kPing.end());
+  EXPECT_EQ(expected, out);
+}
+
+TEST(ClassicCompression, RoundTrip) {
+  ClassicCompression client_side;
+  ClassicCompression server_side;
+  RoutingProtocolBuffer compressed;
+  RoutingProtocolBuffer plain;
+
+  const RoutingProtocolBuffer query = make_query(1000);
+  client_side.compress(query.data(), query.size(), compressed);
+  ASSERT_LT(compressed.size(), query.size());
+  EXPECT_EQ(0, compressed[3]);
+  EXPECT_EQ(query.size(), static_cast<size_t>(compressed[4] | compressed[5] << 8 | compressed[6] << 16));
+
+  ASSERT_TRUE(server_side.decompress(compressed.data(), compressed.size(), plain));
+  EXPECT_EQ(query, plain);
+  EXPECT_EQ(query.size(), server_side.get_plain_bytes());
+  EXPECT_EQ(compressed.size(), server_side.get_compressed_bytes());
+}
+
+TEST(ClassicCompression, SplitCompressedPacket) {
+  ClassicCompression client_side;
+  ClassicCompression server_side;
+  RoutingProtocolBuffer compressed;
+  RoutingProtocolBuffer plain;
+
+  const RoutingProtocolBuffer query = make_query(1000);
+  client_side.compress(query.data(), query.size(), compressed);
+
+  // compressed packets as they are read in pieces
+  RoutingProtocolBuffer result;
+  for (uint8_t byte: compressed) {
+    ASSERT_TRUE(server_side.decompress(&byte, 1, plain));
+    result.insert(result.end(), plain.begin(), plain.end());
+  }
+  EXPECT_EQ(query, result);
+}
+
+TEST(ClassicCompression, SequenceIds) {
+  ClassicCompression compression;
+  RoutingProtocolBuffer out;
+
+  compression.compress(kPing.data(), kPing.size(), out);
+  EXPECT_EQ(0, out[3]);
+
+  // the reply of the client continues after the compressed packet of the server
+  const RoutingProtocolBuffer server_packet{0x05, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+                                            0x01, 0x00, 0x00, 0x01, 0xfb};
+  RoutingProtocolBuffer plain;
+  ASSERT_TRUE(compression.decompress(server_packet.data(), server_packet.size(), plain));
+  EXPECT_EQ(RoutingProtocolBuffer({0x01, 0x00, 0x00, 0x01, 0xfb}), plain);
+
+  const RoutingProtocolBuffer file_data{0x01, 0x00, 0x00, 0x02, 'x'};
+  compression.compress(file_data.data(), file_data.size(), out);
+  EXPECT_EQ(4, out[3]);
+
+  // the next command starts over
+  compression.compress(kPing.data(), kPing.size(), out);
+  EXPECT_EQ(0, out[3]);
+}
+
+TEST(ClassicCompression, InvalidPayload) {
+  ClassicCompression compression;
+  RoutingProtocolBuffer plain;
+
+  const RoutingProtocolBuffer server_packet{0x04, 0x00, 0x00, 0x00, 0x64, 0x00, 0x00,
+                                            'x', 'y', 'z', 'w'};
+  EXPECT_FALSE(compression.decompress(server_packet.data(), server_packet.size(), plain));
+}
+
+#ifndef _WIN32
+
+/** @brief returns server greeting with the given capabilities */
+static RoutingProtocolBuffer make_greeting(uint32_t caps) {
+  RoutingProtocolBuffer payload{10, '8', '.', '0', 0, 0x01, 0x00, 0x00, 0x00};
+  payload.insert(payload.end(), 8, 'a');
+  payload.push_back(0);
+  payload.push_back(static_cast<uint8_t>(caps));
+  payload.push_back(static_cast<uint8_t>(caps >> 8));
+  payload.push_back(0x21);
+  payload.push_back(0x02);
+  payload.push_back(0x00);
+  payload.push_back(static_cast<uint8_t>(caps >> 16));
+  payload.push_back(static_cast<uint8_t>(caps >> 24));
+  payload.push_back(21);
+  payload.insert(payload.end(), 10, 0);
+  payload.insert(payload.end(), 12, 'b');
+  payload.push_back(0);
+  const std::string plugin("mysql_native_password");
+  payload.insert(payload.end(), plugin.begin(), plugin.end());
+  payload.push_back(0);
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload.size()), 0, 0, 0};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+/** @brief returns handshake response of user "u" with an empty auth-response */
+static RoutingProtocolBuffer make_handshake_response(uint32_t caps) {
+  RoutingProtocolBuffer packet{0, 0, 0, 1,
+      static_cast<uint8_t>(caps), static_cast<uint8_t>(caps >> 8),
+      static_cast<uint8_t>(caps >> 16), static_cast<uint8_t>(caps >> 24),
+      0x00, 0x00, 0x00, 0x01, 0x21};
+  packet.insert(packet.end(), 23, 0);
+  packet.push_back('u');
+  packet.push_back(0);
+  packet.push_back(0);
+  const std::string plugin("mysql_native_password");
+  packet.insert(packet.end(), plugin.begin(), plugin.end());
+  packet.push_back(0);
+  packet[0] = static_cast<uint8_t>(packet.size() - 4);
+  return packet;
+}
+
+static void write_packet(int sock, const RoutingProtocolBuffer &packet) {
+  ASSERT_EQ(static_cast<ssize_t>(packet.size()), ::write(sock, packet.data(), packet.size()));
+}
+
+static void read_bytes(int sock, RoutingProtocolBuffer &buffer, size_t size) {
+  buffer.resize(size);
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t res = ::read(sock, &buffer[done], size - done);
+    ASSERT_GT(res, 0);
+    done += static_cast<size_t>(res);
+  }
+}
+
+/**
+ * @test
+ *       Verify that the router asks a server offering compression for it
+ *       and translates the traffic of a client not compressing.
+ */
+TEST(ClassicCompression, CompressesServerConnection) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  MySQLRoutingContext context(
+      new ClassicProtocol(routing::RoutingSockOps::instance(so)),
+      so, "routing_name",
+      routing::kDefaultNetBufferLength, kTimeout, kTimeout,
+      mysql_harness::TCPAddress(), mysql_harness::Path(), 100,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  context.set_server_compression(true);
+
+  int client_fds[2];
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  sockaddr_storage client_addr;
+  memset(&client_addr, 0, sizeof(client_addr));
+  client_addr.ss_family = AF_INET;
+
+  const int server = server_fds[1];
+  MySQLRoutingConnection connection(
+      context, client_fds[1], client_addr, routing::kInvalidSocket,
+      mysql_harness::TCPAddress(),
+      [](MySQLRoutingConnection*) {},
+      [server](mysql_harness::TCPAddress& address) {
+        address = mysql_harness::TCPAddress("127.0.0.1", 3306);
+        return server;
+      });
+  std::thread thread([&connection] { connection.run(); });
+
+  const uint32_t caps = (Capabilities::PROTOCOL_41 | Capabilities::SECURE_CONNECTION |
+                         Capabilities::PLUGIN_AUTH).bits();
+  RoutingProtocolBuffer packet;
+  write_packet(server_fds[0], make_greeting(caps | Capabilities::COMPRESS.bits()));
+  ASSERT_TRUE(classic_handshake::read_packet(so, client_fds[0], packet, kTimeout));
+  EXPECT_EQ(make_greeting(caps | Capabilities::COMPRESS.bits()), packet);
+
+  // the server is asked for compression
+  write_packet(client_fds[0], make_handshake_response(caps));
+  ASSERT_TRUE(classic_handshake::read_packet(so, server_fds[0], packet, kTimeout));
+  EXPECT_EQ(make_handshake_response(caps | Capabilities::COMPRESS.bits()), packet);
+
+  const RoutingProtocolBuffer ok{0x07, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+  write_packet(server_fds[0], ok);
+  ASSERT_TRUE(classic_handshake::read_packet(so, client_fds[0], packet, kTimeout));
+  EXPECT_EQ(ok, packet);
+
+  // commands get compressed, results decompressed
+  const RoutingProtocolBuffer query = make_query(1000);
+  write_packet(client_fds[0], query);
+  RoutingProtocolBuffer header;
+  read_bytes(server_fds[0], header, ClassicCompression::kHeaderSize);
+  const size_t compressed_size = static_cast<size_t>(header[0] | header[1] << 8 | header[2] << 16);
+  EXPECT_LT(compressed_size, query.size());
+  RoutingProtocolBuffer payload;
+  read_bytes(server_fds[0], payload, compressed_size);
+  header.insert(header.end(), payload.begin(), payload.end());
+  ClassicCompression server_side;
+  RoutingProtocolBuffer plain;
+  ASSERT_TRUE(server_side.decompress(header.data(), header.size(), plain));
+  EXPECT_EQ(query, plain);
+
+  RoutingProtocolBuffer result = ok;
+  result[3] = 1;
+  RoutingProtocolBuffer compressed_result{static_cast<uint8_t>(result.size()), 0x00, 0x00, 0x01, 0x00, 0x00, 0x00};
+  compressed_result.insert(compressed_result.end(), result.begin(), result.end());
+  write_packet(server_fds[0], compressed_result);
+  ASSERT_TRUE(classic_handshake::read_packet(so, client_fds[0], packet, kTimeout));
+  EXPECT_EQ(result, packet);
+
+  ::close(client_fds[0]);
+  thread.join();
+  ::close(server_fds[0]);
+}
+
+#endif  // _WIN32
+
+#endif  // HAVE_ZLIB
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
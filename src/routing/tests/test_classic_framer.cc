@@ -0,0 +1,151 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "protocol/classic_framer.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using Frame = ClassicPacketFramer::Frame;
+
+// header and payload of one packet
+static std::vector<uint8_t> make_packet(uint8_t sequence_id, const std::string &payload) {
+  const size_t size = payload.size();
+  std::vector<uint8_t> packet{static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                              static_cast<uint8_t>(size >> 16), sequence_id};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+// feeds data in one chunk, returns the frames found
+static std::vector<Frame> feed(ClassicPacketFramer &framer, const std::vector<uint8_t> &data,
+                               size_t begin, size_t end) {
+  std::vector<Frame> frames;
+  const uint8_t *p = data.data() + begin;
+  size_t size = end - begin;
+  Frame frame;
+  while (framer.next(p, size, frame)) frames.push_back(frame);
+  EXPECT_EQ(0u, size);
+  return frames;
+}
+
+/**
+ * @test
+ *       Verify that a packet split at any byte is put back together.
+ */
+TEST(TestClassicPacketFramer, SplitAtEveryOffset) {
+  const std::vector<uint8_t> packet = make_packet(3, "select 1");
+
+  for (size_t split = 0; split <= packet.size(); ++split) {
+    ClassicPacketFramer framer;
+    std::vector<Frame> frames = feed(framer, packet, 0, split);
+    const std::vector<Frame> rest = feed(framer, packet, split, packet.size());
+    frames.insert(frames.end(), rest.begin(), rest.end());
+
+    std::string payload;
+    for (const Frame &frame : frames) {
+      EXPECT_EQ(3u, frame.sequence_id);
+      EXPECT_EQ(8u, frame.payload_size);
+      EXPECT_EQ(payload.size(), frame.offset);
+      payload.append(reinterpret_cast<const char*>(frame.payload), frame.length);
+    }
+    EXPECT_EQ("select 1", payload) << "split at " << split;
+    ASSERT_FALSE(frames.empty());
+    EXPECT_TRUE(frames.front().is_first());
+    EXPECT_TRUE(frames.back().is_complete());
+    EXPECT_TRUE(framer.at_message_boundary());
+  }
+}
+
+/**
+ * @test
+ *       Verify that payloads are returned as views into the fed bytes.
+ */
+TEST(TestClassicPacketFramer, SeveralPacketsInOneRead) {
+  std::vector<uint8_t> data = make_packet(0, "\x03" "abc");
+  const std::vector<uint8_t> empty = make_packet(1, "");
+  const std::vector<uint8_t> last = make_packet(2, "\x01");
+  data.insert(data.end(), empty.begin(), empty.end());
+  data.insert(data.end(), last.begin(), last.end());
+
+  ClassicPacketFramer framer;
+  const std::vector<Frame> frames = feed(framer, data, 0, data.size());
+
+  ASSERT_EQ(3u, frames.size());
+  EXPECT_EQ(data.data() + 4, frames[0].payload);
+  EXPECT_EQ(4u, frames[0].length);
+  EXPECT_EQ(1u, frames[1].sequence_id);
+  EXPECT_EQ(0u, frames[1].payload_size);
+  EXPECT_TRUE(frames[1].is_first());
+  EXPECT_TRUE(frames[1].is_complete());
+  EXPECT_EQ(data.data() + data.size() - 1, frames[2].payload);
+  EXPECT_TRUE(framer.at_packet_boundary());
+}
+
+/**
+ * @test
+ *       Verify that a partial header is kept and reported as wanted bytes.
+ */
+TEST(TestClassicPacketFramer, PartialHeader) {
+  const std::vector<uint8_t> packet = make_packet(0, "abcde");
+
+  ClassicPacketFramer framer;
+  EXPECT_TRUE(feed(framer, packet, 0, 2).empty());
+  EXPECT_FALSE(framer.at_packet_boundary());
+  EXPECT_EQ(2u, framer.bytes_wanted());
+
+  EXPECT_EQ(1u, feed(framer, packet, 2, 6).size());
+  EXPECT_EQ(3u, framer.bytes_wanted());
+
+  framer.reset();
+  EXPECT_TRUE(framer.at_message_boundary());
+}
+
+/**
+ * @test
+ *       Verify that a message of 16M is recognized as a series of packets.
+ */
+TEST(TestClassicPacketFramer, ContinuedMessage) {
+  std::vector<uint8_t> data = make_packet(0, std::string(ClassicPacketFramer::kMaxPayloadSize, 'x'));
+  const std::vector<uint8_t> tail = make_packet(1, "");
+  data.insert(data.end(), tail.begin(), tail.end());
+  const size_t first_end = ClassicPacketFramer::kMaxPayloadSize + 4;
+
+  ClassicPacketFramer framer;
+  std::vector<Frame> frames = feed(framer, data, 0, first_end);
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_TRUE(frames[0].starts_message);
+  EXPECT_TRUE(frames[0].is_complete());
+  EXPECT_TRUE(frames[0].is_continued());
+  EXPECT_TRUE(framer.at_packet_boundary());
+  EXPECT_FALSE(framer.at_message_boundary());
+
+  frames = feed(framer, data, first_end, data.size());
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_FALSE(frames[0].starts_message);
+  EXPECT_FALSE(frames[0].is_continued());
+  EXPECT_TRUE(framer.at_message_boundary());
+}
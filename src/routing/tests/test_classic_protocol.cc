@@ -226,6 +226,76 @@ TEST_F(ClassicProtocolTest, CopyPacketsHandshakeServerSendsError)
   ASSERT_EQ(0, result);
 }
 
+TEST_F(ClassicProtocolTest, CopyPacketsHandshakeServerErrorSplitRead)
+{
+  size_t report_bytes_read = 0xff;
+  curr_pktnr_ = 1;
+
+  auto error_packet = mysql_protocol::ErrorPacket(2, 0xaabb, "Access denied", "HY004", Capabilities::PROTOCOL_41);
+  serialize_classic_packet_to_buffer(network_buffer_, network_buffer_offset_, error_packet);
+  constexpr ssize_t first_read = 6;
+
+  // the rest of the packet arrives with a separate read
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                                  WillOnce(Return(first_read));
+  EXPECT_CALL(*mock_socket_operations_, poll(_, 1, _)).WillOnce(Return(1));
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[first_read],
+                                             network_buffer_offset_ - first_read)).
+                                      WillOnce(Return((ssize_t)network_buffer_offset_ - first_read));
+
+  EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, _, network_buffer_offset_)).
+                                                       WillOnce(Return((ssize_t)network_buffer_offset_));
+
+  int result = sut_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                       handshake_done_, &report_bytes_read, true);
+
+  ASSERT_EQ(2, curr_pktnr_);
+  ASSERT_EQ(0, result);
+}
+
+TEST_F(ClassicProtocolTest, CopyPacketsResumableHandshakeSplitRead)
+{
+  size_t report_bytes_read = 0xff;
+  curr_pktnr_ = 1;
+  RoutingProtocolBuffer partial_packet;
+
+  auto error_packet = mysql_protocol::ErrorPacket(2, 0xaabb, "Access denied", "HY004", Capabilities::PROTOCOL_41);
+  serialize_classic_packet_to_buffer(network_buffer_, network_buffer_offset_, error_packet);
+  constexpr ssize_t first_read = 6;
+
+  // the start of the packet is kept, nothing waits for the rest
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                                  WillOnce(Return(first_read));
+  EXPECT_CALL(*mock_socket_operations_, poll(_, _, _)).Times(0);
+  EXPECT_CALL(*mock_socket_operations_, write(_, _, _)).Times(0);
+
+  int result = sut_protocol_->copy_packets_resumable(sender_socket_, receiver_socket_, true, network_buffer_,
+                                                     &curr_pktnr_, handshake_done_, &report_bytes_read, true,
+                                                     partial_packet);
+
+  ASSERT_EQ(0, result);
+  EXPECT_EQ(0u, report_bytes_read);
+  EXPECT_EQ(1, curr_pktnr_);
+  EXPECT_EQ(static_cast<size_t>(first_read), partial_packet.size());
+  testing::Mock::VerifyAndClearExpectations(mock_socket_operations_);
+
+  // the next call reads the rest behind it
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[first_read],
+                                             network_buffer_.size() - first_read)).
+                                      WillOnce(Return((ssize_t)network_buffer_offset_ - first_read));
+  EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, _, network_buffer_offset_)).
+                                                       WillOnce(Return((ssize_t)network_buffer_offset_));
+
+  result = sut_protocol_->copy_packets_resumable(sender_socket_, receiver_socket_, true, network_buffer_,
+                                                 &curr_pktnr_, handshake_done_, &report_bytes_read, true,
+                                                 partial_packet);
+
+  ASSERT_EQ(0, result);
+  EXPECT_EQ(2, curr_pktnr_);
+  EXPECT_EQ(network_buffer_offset_, report_bytes_read);
+  EXPECT_TRUE(partial_packet.empty());
+}
+
 TEST_F(ClassicProtocolTest, SendErrorOKMultipleWrites)
 {
   EXPECT_CALL(*mock_socket_operations_, write(1, _, _)).Times(2).
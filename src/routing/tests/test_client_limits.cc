@@ -0,0 +1,151 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "client_limits.h"
+
+#include <cstring>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#else
+#include <ws2tcpip.h>
+#endif
+
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using Result = ClientLimits::Result;
+
+static sockaddr_storage make_ipv4(const char *address) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(&ss);
+  sin->sin_family = AF_INET;
+  inet_pton(AF_INET, address, &sin->sin_addr);
+  return ss;
+}
+
+static sockaddr_storage make_ipv6(const char *address) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(&ss);
+  sin6->sin6_family = AF_INET6;
+  inet_pton(AF_INET6, address, &sin6->sin6_addr);
+  return ss;
+}
+
+/**
+ * @test
+ *       Verify that a client gets its burst, then the rate.
+ */
+TEST(TestClientLimits, TokenBucket) {
+  ClientLimits::Settings settings;
+  settings.rate = 10;
+  settings.burst = 2;
+  ClientLimits limits(settings);
+  const auto now = ClientLimits::clock_type::now();
+  const auto client = make_ipv4("10.0.0.1");
+
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client, now));
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client, now));
+  EXPECT_EQ(Result::kRateExceeded, limits.admit(client, now));
+  // other clients have their own bucket
+  EXPECT_EQ(Result::kAdmitted, limits.admit(make_ipv4("10.0.0.2"), now));
+
+  // a token every 100ms
+  EXPECT_EQ(Result::kRateExceeded, limits.admit(client, now + milliseconds(50)));
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client, now + milliseconds(100)));
+  EXPECT_EQ(Result::kRateExceeded, limits.admit(client, now + milliseconds(100)));
+
+  // refills up to the burst only
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client, now + milliseconds(10000)));
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client, now + milliseconds(10000)));
+  EXPECT_EQ(Result::kRateExceeded, limits.admit(client, now + milliseconds(10000)));
+}
+
+/**
+ * @test
+ *       Verify that closed connections make room for new ones.
+ */
+TEST(TestClientLimits, MaxConnections) {
+  ClientLimits::Settings settings;
+  settings.max_connections = 2;
+  ClientLimits limits(settings);
+  const auto client = make_ipv6("2001:db8::1");
+
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client));
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client));
+  EXPECT_EQ(Result::kTooManyConnections, limits.admit(client));
+
+  limits.release(client);
+  EXPECT_EQ(Result::kAdmitted, limits.admit(client));
+  EXPECT_EQ(1u, limits.size());
+}
+
+/**
+ * @test
+ *       Verify that clients of a subnet share their limits.
+ */
+TEST(TestClientLimits, Subnets) {
+  ClientLimits::Settings settings;
+  settings.max_connections = 1;
+  settings.ipv4_prefix = 24;
+  settings.ipv6_prefix = 64;
+  ClientLimits limits(settings);
+
+  EXPECT_EQ(Result::kAdmitted, limits.admit(make_ipv4("192.168.1.10")));
+  EXPECT_EQ(Result::kTooManyConnections, limits.admit(make_ipv4("192.168.1.20")));
+  // IPv4 clients of a dual-stack listener
+  EXPECT_EQ(Result::kTooManyConnections, limits.admit(make_ipv6("::ffff:192.168.1.30")));
+  EXPECT_EQ(Result::kAdmitted, limits.admit(make_ipv4("192.168.2.10")));
+
+  EXPECT_EQ(Result::kAdmitted, limits.admit(make_ipv6("2001:db8:0:1::1")));
+  EXPECT_EQ(Result::kTooManyConnections, limits.admit(make_ipv6("2001:db8:0:1::2")));
+  EXPECT_EQ(Result::kAdmitted, limits.admit(make_ipv6("2001:db8:0:2::1")));
+}
+
+/**
+ * @test
+ *       Verify that idle clients make room for new ones once the table is
+ *       full, clients with open connections are kept.
+ */
+TEST(TestClientLimits, RecyclesIdleClients) {
+  ClientLimits::Settings settings;
+  settings.max_connections = 1;
+  // a single probe window per shard
+  ClientLimits limits(settings, 1);
+  const auto now = ClientLimits::clock_type::now();
+
+  char address[32];
+  for (int n = 0; n < 1000; ++n) {
+    snprintf(address, sizeof(address), "10.1.%d.%d", n / 256, n % 256);
+    EXPECT_EQ(Result::kAdmitted, limits.admit(make_ipv4(address), now + milliseconds(n)));
+    // all but the first one close their connection
+    if (n > 0) limits.release(make_ipv4(address));
+  }
+  EXPECT_GE(256u, limits.size());
+
+  EXPECT_EQ(Result::kTooManyConnections, limits.admit(make_ipv4("10.1.0.0"), now + milliseconds(1000)));
+}
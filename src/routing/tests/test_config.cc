@@ -155,7 +155,7 @@ TEST_F(TestConfig, InvalidStrategyOption) {
   MySQLRouter r(g_origin, {"-c", config_path->str()});
   ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
       "option routing_strategy in [routing] is invalid; valid are first-available, "
-      "next-available, and round-robin (was 'invalid')");
+      "next-available, round-robin, least-connections, weighted-round-robin, lowest-latency, and consistent-hash (was 'invalid')");
 }
 
 TEST_F(TestConfig, EmptyStrategyOption) {
@@ -204,7 +204,295 @@ TEST_F(TestConfig, UnsupportedStrategyOption) {
   MySQLRouter r(g_origin, {"-c", config_path->str()});
   ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
       "option routing_strategy in [routing] is invalid; valid are first-available, "
-      "next-available, and round-robin (was 'round-robin-with-fallback')");
+      "next-available, round-robin, least-connections, weighted-round-robin, lowest-latency, and consistent-hash (was 'round-robin-with-fallback')");
+}
+
+TEST_F(TestConfig, InvalidDestinationWeight) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=weighted-round-robin\ndestination_weights=3,0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option destination_weights in [routing] needs weights between 1 and 1000 inclusive, was '0'");
+}
+
+TEST_F(TestConfig, InvalidIOEngine) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nio_engine=fibers";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option io_engine in [routing] is invalid; valid are thread and event (was 'fibers')");
+}
+
+TEST_F(TestConfig, InvalidIOThreads) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nio_engine=event\nio_threads=1025";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option io_threads in [routing] needs value between 0 and 1024 inclusive, was '1025'");
+}
+
+TEST_F(TestConfig, InvalidIOUring) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nio_engine=event\nio_uring=2";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option io_uring in [routing] needs value between 0 and 1 inclusive, was '2'");
+}
+
+TEST_F(TestConfig, InvalidIdleTimeout) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nidle_timeout=-1";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option idle_timeout in [routing] needs value between 0 and 31536000 inclusive, was '-1'");
+}
+
+TEST_F(TestConfig, InvalidTcpKeepaliveCount) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\ntcp_keepalive_count=128";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option tcp_keepalive_count in [routing] needs value between 0 and 127 inclusive, was '128'");
+}
+
+TEST_F(TestConfig, InvalidWarmConnectionMaxAge) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nwarm_connection_max_age=0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option warm_connection_max_age in [routing] needs value between 100 and 3600000 inclusive, was '0'");
+}
+
+TEST_F(TestConfig, InvalidSplice) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nsplice=2";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option splice in [routing] needs value between 0 and 1 inclusive, was '2'");
+}
+
+TEST_F(TestConfig, InvalidBufferPoolSize) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nbuffer_pool_size=65536";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option buffer_pool_size in [routing] needs value between 0 and 65535 inclusive, was '65536'");
+}
+
+TEST_F(TestConfig, InvalidConnectionPoolSize) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nconnection_pool_size=-1";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option connection_pool_size in [routing] needs value between 0 and 65535 inclusive, was '-1'");
+}
+
+TEST_F(TestConfig, InvalidConnectionPoolIdleTimeout) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nconnection_pool_idle_timeout=0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option connection_pool_idle_timeout in [routing] needs value between 1 and 31536000 inclusive, was '0'");
+}
+
+TEST_F(TestConfig, InvalidConnectionMultiplexing) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nconnection_multiplexing=2";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option connection_multiplexing in [routing] needs value between 0 and 1 inclusive, was '2'");
+}
+
+TEST_F(TestConfig, InvalidServerCompression) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nserver_compression=2";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option server_compression in [routing] needs value between 0 and 1 inclusive, was '2'");
+}
+
+TEST_F(TestConfig, InvalidQueryDigestSampling) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nquery_digest_sampling=1000001";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option query_digest_sampling in [routing] needs value between 0 and 1000000 inclusive, was '1000001'");
+}
+
+TEST_F(TestConfig, InvalidResultCacheTtl) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nresult_cache_ttl=0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option result_cache_ttl in [routing] needs value between 1 and 3600000 inclusive, was '0'");
+}
+
+TEST_F(TestConfig, InvalidPreparedStatementCacheSize) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nprepared_statement_cache_size=1025";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option prepared_statement_cache_size in [routing] needs value between 0 and 1024 inclusive, was '1025'");
+}
+
+TEST_F(TestConfig, InvalidAcceptorThreads) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nacceptor_threads=0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option acceptor_threads in [routing] needs value between 1 and 1024 inclusive, was '0'");
+}
+
+TEST_F(TestConfig, InvalidOutputQueueHighWatermark) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\noutput_queue_high_watermark=1073741825";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option output_queue_high_watermark in [routing] needs value between 0 and 1073741824 inclusive, was '1073741825'");
+}
+
+TEST_F(TestConfig, InvalidQuarantineInterval) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nquarantine_interval=0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option quarantine_interval in [routing] needs value between 1 and 3600000 inclusive, was '0'");
+}
+
+TEST_F(TestConfig, InvalidConnectionTrace) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nconnection_trace=2";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option connection_trace in [routing] needs value between 0 and 1 inclusive, was '2'");
+}
+
+TEST_F(TestConfig, InvalidCpuAffinity) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\ncpu_affinity=3-1";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option cpu_affinity in [routing] needs a list of CPUs like '0-3,8', was '3-1'");
+}
+
+TEST_F(TestConfig, InvalidConnectionThreadStackSize) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nconnection_thread_stack_size=32";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option connection_thread_stack_size in [routing] needs value between 64 and 65535 inclusive, was '32'");
+}
+
+TEST_F(TestConfig, InvalidDrainTimeout) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\ndrain_timeout=3601";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option drain_timeout in [routing] needs value between 0 and 3600 inclusive, was '3601'");
+}
+
+TEST_F(TestConfig, InvalidAdmissionQueueTimeout) {
+  reset_config();
+  std::ofstream c(config_path->str(), std::fstream::app | std::fstream::out);
+  c << "[routing]\nrouting_strategy=round-robin\nadmission_queue_size=10\nadmission_queue_timeout=0";
+  c << kDefaultRoutingConfigStrategy;
+  c.close();
+
+  MySQLRouter r(g_origin, {"-c", config_path->str()});
+  ASSERT_THROW_LIKE(r.start(), std::invalid_argument,
+      "option admission_queue_timeout in [routing] needs value between 1 and 3600000 inclusive, was '0'");
 }
 
 struct ThreadStackSizeInfo {
@@ -0,0 +1,175 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <gtest/gtest_prod.h> // must be the first header
+
+#include "connect_error_counters.h"
+#include "test/helpers.h"
+
+#include "gtest/gtest.h"
+
+using std::chrono::seconds;
+
+static ClientIpArray make_ip(size_t n) {
+  ClientIpArray ip{{0}};
+  ip[0] = 10;
+  ip[1] = static_cast<uint8_t>(n >> 16);
+  ip[2] = static_cast<uint8_t>(n >> 8);
+  ip[3] = static_cast<uint8_t>(n);
+  return ip;
+}
+
+/**
+ * @test
+ *       Verify that errors are counted per host and hosts get blocked at
+ *       max_connect_errors.
+ */
+TEST(TestConnectErrorCounters, CountsAndBlocks) {
+  ConnectErrorCounters counters(3);
+
+  EXPECT_EQ(0u, counters.get(make_ip(1)));
+  EXPECT_EQ(1u, counters.increment(make_ip(1)));
+  EXPECT_EQ(2u, counters.increment(make_ip(1)));
+  EXPECT_EQ(1u, counters.increment(make_ip(2)));
+  EXPECT_FALSE(counters.is_blocked(make_ip(1)));
+
+  EXPECT_EQ(3u, counters.increment(make_ip(1)));
+  EXPECT_TRUE(counters.is_blocked(make_ip(1)));
+  EXPECT_FALSE(counters.is_blocked(make_ip(2)));
+  EXPECT_EQ(2u, counters.size());
+
+  std::vector<ClientIpArray> blocked = counters.get_blocked();
+  ASSERT_EQ(1u, blocked.size());
+  EXPECT_EQ(make_ip(1), blocked[0]);
+}
+
+/**
+ * @test
+ *       Verify that counts restart after max_age without error unless the
+ *       host is blocked.
+ */
+TEST(TestConnectErrorCounters, AgesOutCounts) {
+  ConnectErrorCounters counters(2, ConnectErrorCounters::kDefaultCapacity, seconds(10));
+  const auto start = ConnectErrorCounters::clock_type::now();
+
+  EXPECT_EQ(1u, counters.increment(make_ip(1), start));
+  EXPECT_EQ(1u, counters.increment(make_ip(1), start + seconds(11)));
+
+  EXPECT_EQ(2u, counters.increment(make_ip(1), start + seconds(12)));
+  EXPECT_EQ(3u, counters.increment(make_ip(1), start + seconds(60)));
+  EXPECT_TRUE(counters.is_blocked(make_ip(1)));
+}
+
+/**
+ * @test
+ *       Verify that the number of hosts is bounded and hosts with the
+ *       oldest errors get evicted.
+ */
+TEST(TestConnectErrorCounters, BoundedCapacity) {
+  // 16 shards of 16 slots
+  ConnectErrorCounters counters(100, 256);
+  const auto start = ConnectErrorCounters::clock_type::now();
+
+  for (size_t n = 0; n < 1000; ++n) {
+    EXPECT_EQ(1u, counters.increment(make_ip(n), start + seconds(n)));
+  }
+  EXPECT_EQ(256u, counters.size());
+  EXPECT_EQ(0u, counters.get(make_ip(0)));
+  EXPECT_EQ(1u, counters.get(make_ip(999)));
+}
+
+/**
+ * @test
+ *       Verify that hosts are still counted once all slots hold blocked
+ *       hosts, evicting the host blocked by the oldest error.
+ */
+TEST(TestConnectErrorCounters, EvictsBlockedHosts) {
+  ConnectErrorCounters counters(1, 256);
+  const auto start = ConnectErrorCounters::clock_type::now();
+
+  for (size_t n = 0; n < 1000; ++n) {
+    EXPECT_EQ(1u, counters.increment(make_ip(n), start + seconds(n)));
+    EXPECT_TRUE(counters.is_blocked(make_ip(n)));
+  }
+  EXPECT_EQ(256u, counters.size());
+  EXPECT_EQ(256u, counters.get_blocked().size());
+  EXPECT_FALSE(counters.is_blocked(make_ip(0)));
+}
+
+/**
+ * @test
+ *       Verify that hosts sharing a hash don't share their count.
+ */
+TEST(TestConnectErrorCounters, SharedHashes) {
+  ConnectErrorCounters counters(3);
+  const ClientIpArray host = make_ip(1);
+  const ClientIpArray other = make_ip(2);
+
+  // let the other host take the slot the host hashes to, with its hash
+  const uint64_t key = counters.hash(host);
+  ConnectErrorCounters::Slot& slot =
+      counters.shards_[key & (ConnectErrorCounters::kShards - 1)].slots[counters.get_home_slot(key)];
+  const ConnectErrorCounters::Address other_address = ConnectErrorCounters::to_address(other);
+  slot.address[0].store(other_address[0]);
+  slot.address[1].store(other_address[1]);
+  slot.count.store(5);
+  slot.key.store(key);
+
+  EXPECT_EQ(0u, counters.get(host));
+  EXPECT_FALSE(counters.is_blocked(host));
+  EXPECT_EQ(1u, counters.increment(host));
+  EXPECT_EQ(1u, counters.get(host));
+  EXPECT_EQ(5u, slot.count.load());
+}
+
+/**
+ * @test
+ *       Verify that the shared counters keep the hosts of the route blocking
+ *       at the lowest count, and routes block at their own count.
+ */
+TEST(TestConnectErrorCounters, SharedCounters) {
+  std::shared_ptr<ConnectErrorCounters> shared = ConnectErrorCounters::get_shared();
+  EXPECT_EQ(shared, ConnectErrorCounters::get_shared());
+
+  shared->lower_max_connect_errors(3);
+  shared->lower_max_connect_errors(5);
+  EXPECT_EQ(3u, shared->get_max_connect_errors());
+
+  const ClientIpArray host = make_ip(4242);
+  for (size_t n = 0; n < 3; ++n) {
+    shared->increment(host);
+  }
+  EXPECT_TRUE(shared->is_blocked(host));
+  EXPECT_TRUE(shared->is_blocked(host, 3));
+  EXPECT_FALSE(shared->is_blocked(host, 5));
+  EXPECT_EQ(1u, shared->get_blocked(3).size());
+  EXPECT_TRUE(shared->get_blocked(5).empty());
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
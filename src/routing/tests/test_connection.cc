@@ -23,6 +23,7 @@
 */
 
 #include "connection.h"
+#include "connection_container.h"
 #include "context.h"
 #include "protocol/base_protocol.h"
 #include "protocol/classic_protocol.h"
@@ -35,6 +36,14 @@
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
 class MockProtocol : public BaseProtocol {
 public:
 
@@ -42,7 +51,7 @@ public:
 
   MOCK_METHOD2(on_block_client_host, bool(int, const std::string&));
   MOCK_METHOD8(copy_packets, int(int, int, bool,
-      RoutingProtocolBuffer&, int* , bool&, size_t*, bool));
+      RoutingBufferRef, int* , bool&, size_t*, bool));
   MOCK_METHOD5(send_error, bool(int, unsigned short, const std::string&,
       const std::string&, const std::string&));
   MOCK_METHOD0(get_type, BaseProtocol::Type());
@@ -126,6 +135,58 @@ TEST_F(TestRoutingConnection, IsCallbackCalledAtRunExit) {
   ASSERT_TRUE(is_called);
 }
 
+/**
+ * @test
+ *       Verify that the server connector is used by run() to connect to the
+ *       server.
+ */
+TEST_F(TestRoutingConnection, ServerConnectorCalledAtRun) {
+  EXPECT_CALL(socket_operations_, shutdown(server_socket_));
+  EXPECT_CALL(socket_operations_, shutdown(client_socket_));
+  EXPECT_CALL(socket_operations_, close(testing::_)).Times(2);
+
+  EXPECT_CALL(*protocol_, on_block_client_host(testing::_, testing::_))
+      .Times(testing::AtLeast(0)).WillRepeatedly(testing::Return(false));
+
+  MySQLRoutingContext context(protocol_.release(),
+      &socket_operations_,
+      name_,
+      net_buffer_length_,
+      destination_connect_timeout_,
+      client_connect_timeout_,
+      bind_address_,
+      bind_named_socket_,
+      max_connect_errors_,
+      thread_stack_size_);
+
+  int connector_calls = 0;
+
+  MySQLRoutingConnection connection(context,
+      client_socket_,
+      client_addr_,
+      routing::kInvalidSocket,
+      mysql_harness::TCPAddress(),
+      [](MySQLRoutingConnection* /* connection */) {},
+      [&](mysql_harness::TCPAddress& server_address) {
+        ++connector_calls;
+        server_address = mysql_harness::TCPAddress("127.0.0.1", 3306);
+        return server_socket_;
+  });
+
+  ASSERT_TRUE(connection.needs_server_connect());
+  ASSERT_TRUE(connection.get_server_address().addr.empty());
+
+  // disconnect the connection
+  connection.disconnect();
+
+  // run connection in current thread
+  connection.run();
+
+  ASSERT_EQ(1, connector_calls);
+  ASSERT_FALSE(connection.needs_server_connect());
+  ASSERT_EQ(mysql_harness::TCPAddress("127.0.0.1", 3306), connection.get_server_address());
+}
+
 /**
  * @test
  *       Verify if callback is called when connection is closed.
@@ -234,6 +295,113 @@ TEST_F(TestRoutingConnection, IsConnectionThreadStopOnDisconnect) {
   ASSERT_TRUE(is_called);
 }
 
+#ifndef _WIN32
+/**
+ * @test
+ *       Verify that disconnect() interrupts the wait for traffic once the
+ *       handshake is done.
+ */
+TEST_F(TestRoutingConnection, DisconnectWakesUpIdleConnection) {
+  int client_fds[2];
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+
+  // forward whatever is read, handshake is done after first packet
+  EXPECT_CALL(*protocol_, copy_packets(testing::_, testing::_, testing::_, testing::_,
+                                       testing::_, testing::_, testing::_, testing::_))
+      .WillRepeatedly(testing::Invoke([](int sender, int receiver, bool sender_is_readable,
+                                         RoutingBufferRef buffer, int*, bool& handshake_done,
+                                         size_t* report_bytes_read, bool) {
+        *report_bytes_read = 0;
+        if (!sender_is_readable) return 0;
+        ssize_t res = ::read(sender, &buffer.front(), buffer.size());
+        if (res <= 0) return -1;
+        // done before the client can read the data, the test checks it
+        // right after reading
+        handshake_done = true;
+        if (::write(receiver, &buffer.front(), static_cast<size_t>(res)) != res) return -1;
+        *report_bytes_read = static_cast<size_t>(res);
+        return 0;
+      }));
+
+  MySQLRoutingContext context(protocol_.release(),
+      mysql_harness::SocketOperations::instance(),
+      name_, net_buffer_length_, destination_connect_timeout_,
+      std::chrono::seconds(10), bind_address_, bind_named_socket_,
+      max_connect_errors_, mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  memset(&client_addr_, 0, sizeof(client_addr_));
+  MySQLRoutingConnection connection(context, client_fds[1], client_addr_,
+      server_fds[1], mysql_harness::TCPAddress("127.0.0.1", 3306),
+      [](MySQLRoutingConnection* /* connection */) {});
+  std::thread thread([&connection] { connection.run(); });
+
+  char buf[4];
+  ASSERT_EQ(4, ::write(server_fds[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds[0], buf, sizeof(buf)));
+  ASSERT_TRUE(connection.is_handshake_done());
+
+  const auto started = std::chrono::steady_clock::now();
+  connection.disconnect();
+  thread.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(500));
+
+  ::close(client_fds[0]);
+  ::close(server_fds[0]);
+}
+#endif
+
+/**
+ * @test
+ *       Verify that only connections of servers that are not allowed any
+ *       longer are disconnected, including connections connected after
+ *       they were added to the container.
+ */
+TEST_F(TestRoutingConnection, DisconnectsConnectionsOfRemovedServers) {
+  MySQLRoutingContext context(protocol_.release(), &socket_operations_,
+      name_, net_buffer_length_, destination_connect_timeout_,
+      client_connect_timeout_, bind_address_, bind_named_socket_,
+      max_connect_errors_, thread_stack_size_);
+  ConnectionContainer container;
+  memset(&client_addr_, 0, sizeof(client_addr_));
+  const mysql_harness::TCPAddress server_1("10.0.0.1", 3306);
+  const mysql_harness::TCPAddress server_2("10.0.0.2", 3306);
+
+  auto make_connection = [&](const mysql_harness::TCPAddress& server_address,
+                             MySQLRoutingConnection::ServerConnector server_connector) {
+    std::unique_ptr<MySQLRoutingConnection> connection(new MySQLRoutingConnection(
+        context, client_socket_, client_addr_,
+        server_connector ? routing::kInvalidSocket : server_socket_, server_address,
+        [](MySQLRoutingConnection*) {}, server_connector));
+    MySQLRoutingConnection* result = connection.get();
+    container.add_connection(std::move(connection));
+    return result;
+  };
+
+  MySQLRoutingConnection* connection_1 = make_connection(server_1, nullptr);
+  MySQLRoutingConnection* connection_2 = make_connection(server_2, nullptr);
+  MySQLRoutingConnection* connection_3 = make_connection(mysql_harness::TCPAddress(),
+      [&](mysql_harness::TCPAddress& server_address) {
+        server_address = server_1;
+        return server_socket_;
+      });
+
+  container.disconnect({server_1});
+  EXPECT_FALSE(connection_1->is_disconnected());
+  EXPECT_TRUE(connection_2->is_disconnected());
+  EXPECT_FALSE(connection_3->is_disconnected());
+
+  connection_3->connect_server();
+  container.remove_connection(connection_2);
+  container.disconnect({server_2});
+  EXPECT_TRUE(connection_1->is_disconnected());
+  EXPECT_TRUE(connection_3->is_disconnected());
+
+  container.remove_connection(connection_1);
+  container.remove_connection(connection_3);
+}
+
 int main(int argc, char *argv[]) {
   init_test_logger();
   ::testing::InitGoogleTest(&argc, argv);
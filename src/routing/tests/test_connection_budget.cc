@@ -0,0 +1,138 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "connection_budget.h"
+
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+/**
+ * @test
+ *       Verify that a route gets the whole pool while no other route wants it.
+ */
+TEST(TestConnectionBudget, BorrowsUpToLimit) {
+  ConnectionBudget budget(4);
+  auto a = budget.join("a", 0, 1);
+  auto b = budget.join("b", 0, 1);
+
+  for (int n = 0; n < 4; ++n) EXPECT_TRUE(a->acquire());
+  EXPECT_FALSE(a->acquire());
+  EXPECT_EQ(4u, a->get_used());
+  EXPECT_EQ(4u, budget.get_used());
+
+  a->release();
+  EXPECT_EQ(3u, budget.get_used());
+  EXPECT_TRUE(a->acquire());
+}
+
+/**
+ * @test
+ *       Verify that a reservation stays available when the pool is used up.
+ */
+TEST(TestConnectionBudget, ReservationIsKept) {
+  ConnectionBudget budget(10);
+  auto a = budget.join("a", 4, 1);
+  auto b = budget.join("b", 0, 1);
+
+  for (int n = 0; n < 6; ++n) EXPECT_TRUE(b->acquire());
+  EXPECT_FALSE(b->acquire());
+
+  for (int n = 0; n < 4; ++n) EXPECT_TRUE(a->acquire());
+  EXPECT_FALSE(a->acquire());
+  EXPECT_EQ(10u, budget.get_used());
+}
+
+/**
+ * @test
+ *       Verify that a route beyond its share gets refused while another
+ *       route wants its share.
+ */
+TEST(TestConnectionBudget, ShareOfOtherRouteIsKept) {
+  ConnectionBudget budget(6);
+  auto a = budget.join("a", 0, 1);
+  auto b = budget.join("b", 0, 2);
+
+  for (int n = 0; n < 6; ++n) EXPECT_TRUE(a->acquire());
+  // b gets refused, it wants its share from now on
+  EXPECT_FALSE(b->acquire());
+
+  // a is beyond its share of 2, what it gives back is kept for b
+  a->release();
+  EXPECT_FALSE(a->acquire());
+  EXPECT_TRUE(b->acquire());
+
+  a->release();
+  a->release();
+  EXPECT_TRUE(b->acquire());
+  EXPECT_TRUE(b->acquire());
+  EXPECT_FALSE(b->acquire());
+
+  // a within its share again
+  a->release();
+  a->release();
+  EXPECT_TRUE(a->acquire());
+  EXPECT_EQ(2u, a->get_used());
+  EXPECT_EQ(3u, b->get_used());
+}
+
+/**
+ * @test
+ *       Verify that the reservations can't exceed the limit.
+ */
+TEST(TestConnectionBudget, ReservationsExceedingLimit) {
+  ConnectionBudget budget(10);
+  auto a = budget.join("a", 6, 1);
+  EXPECT_THROW(budget.join("b", 5, 1), std::invalid_argument);
+  EXPECT_THROW(budget.join("b", 0, 0), std::invalid_argument);
+
+  // a route leaving gives back its reservation
+  a.reset();
+  EXPECT_NO_THROW(budget.join("b", 10, 1));
+}
+
+/**
+ * @test
+ *       Verify that the lowest limit applies and that without a limit every
+ *       connection is admitted.
+ */
+TEST(TestConnectionBudget, LowestLimitApplies) {
+  ConnectionBudget budget;
+  auto a = budget.join("a", 0, 1);
+  for (int n = 0; n < 100; ++n) EXPECT_TRUE(a->acquire());
+  for (int n = 0; n < 100; ++n) a->release();
+
+  budget.lower_limit(0);
+  EXPECT_EQ(0u, budget.get_limit());
+  budget.lower_limit(20);
+  budget.lower_limit(30);
+  EXPECT_EQ(20u, budget.get_limit());
+  budget.lower_limit(2);
+  EXPECT_EQ(2u, budget.get_limit());
+
+  EXPECT_TRUE(a->acquire());
+  EXPECT_TRUE(a->acquire());
+  EXPECT_FALSE(a->acquire());
+}
@@ -27,6 +27,7 @@
 #include "connection.h"
 #include "context.h"
 #include "connection_container.h"
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <thread>
@@ -217,6 +218,87 @@ TEST_F(TestConcurrentMap, IsMultipleAccessCorrect) {
   ASSERT_THAT(a_map.size(), testing::Eq(100000u));
 }
 
+/**
+ * @test
+ *      Verify that entries stay reachable when the buckets grow and other
+ *      entries get erased.
+ */
+TEST_F(TestConcurrentMap, IsEraseKeepingOtherEntriesReachable) {
+  // a single bucket to get long probe sequences
+  concurrent_map<A*, std::unique_ptr<A>> a_map(1);
+  std::vector<A*> keys;
+
+  for(int i=0; i<1000; ++i) {
+    std::unique_ptr<A> a(new A(i));
+    keys.push_back(a.get());
+    a_map.put(a.get(), std::move(a));
+  }
+
+  for(int i=0; i<1000; i += 2) a_map.erase(keys[i]);
+  ASSERT_THAT(a_map.size(), testing::Eq(500u));
+
+  for(int i=0; i<1000; ++i) {
+    int element_value = -1;
+    auto get_value = [&element_value] (const std::unique_ptr<A>& a) {
+      element_value = a->get();
+    };
+    a_map.for_one(keys[i], get_value);
+    ASSERT_THAT(element_value, testing::Eq(i % 2 ? i : -1));
+  }
+}
+
+/**
+ * @test
+ *      Verify that for_each_from visits whole buckets, and all entries
+ *      once when continued with the returned bucket.
+ */
+TEST_F(TestConcurrentMap, IsForEachFromVisitingEveryEntryOnce) {
+  concurrent_map<A*, std::unique_ptr<A>> a_map(16);
+
+  for(int i=0; i<100; ++i) {
+    std::unique_ptr<A> a(new A(i));
+    A* p = a.get();
+    a_map.put(p, std::move(a));
+  }
+
+  std::vector<int> visited;
+  auto collect =
+      [&visited](std::pair<A* const, std::unique_ptr<A>>& entry) {
+    visited.push_back(entry.first->get());
+  };
+
+  size_t pages = 0;
+  size_t bucket = 0;
+  while (bucket < a_map.bucket_count()) {
+    const size_t page_start = visited.size();
+    const size_t next = a_map.for_each_from(bucket, 10, collect);
+    ASSERT_GT(next, bucket);
+    // a page stops after the bucket reaching the limit
+    if (next < a_map.bucket_count()) {
+      ASSERT_GE(visited.size() - page_start, 10u);
+    }
+    bucket = next;
+    ++pages;
+  }
+
+  std::sort(visited.begin(), visited.end());
+  ASSERT_THAT(visited.size(), testing::Eq(100u));
+  for(int i=0; i<100; ++i) ASSERT_THAT(visited[static_cast<size_t>(i)], testing::Eq(i));
+  ASSERT_THAT(pages, testing::Le(10u));
+}
+
+/**
+ * @test
+ *      Verify that number of buckets follows max_connections.
+ */
+TEST(TestConnectionContainer, NumberOfBuckets) {
+  EXPECT_EQ(16u, ConnectionContainer::get_number_of_buckets(1));
+  EXPECT_EQ(16u, ConnectionContainer::get_number_of_buckets(512));
+  EXPECT_EQ(160u, ConnectionContainer::get_number_of_buckets(10240));
+  EXPECT_EQ(1023u, ConnectionContainer::get_number_of_buckets(65535));
+  EXPECT_EQ(1024u, ConnectionContainer::get_number_of_buckets(1000000));
+}
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/connection_trace.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using Event = ConnectionTrace::Event;
+
+// events of one connection, the trace is shared by all tests
+static std::vector<ConnectionTrace::Record> events_of(uint64_t connection_id) {
+  std::vector<ConnectionTrace::Record> events;
+  for (const auto &record: ConnectionTrace::getInstance().get_snapshot()) {
+    if (record.connection_id == connection_id) events.push_back(record);
+  }
+
+  return events;
+}
+
+TEST(TestConnectionTrace, TimelineAcrossThreads) {
+  ConnectionTrace &trace = ConnectionTrace::getInstance();
+  const uint64_t id = trace.next_connection_id();
+  EXPECT_NE(0u, id);
+
+  trace.record(id, Event::kAccepted, 100);
+  std::thread connection_thread([&trace, id]() {
+    trace.record(id, Event::kServerConnected, 300);
+    trace.record(id, Event::kClosed, 400);
+  });
+  connection_thread.join();
+  trace.record(id, Event::kConnectStarted, 200);
+
+  std::vector<ConnectionTrace::Record> events = events_of(id);
+  ASSERT_EQ(4u, events.size());
+  EXPECT_EQ(Event::kAccepted, events[0].event);
+  EXPECT_EQ(Event::kConnectStarted, events[1].event);
+  EXPECT_EQ(Event::kServerConnected, events[2].event);
+  EXPECT_EQ(Event::kClosed, events[3].event);
+  EXPECT_EQ(400u, events[3].timestamp);
+}
+
+TEST(TestConnectionTrace, OverwritesOldestEvents) {
+  ConnectionTrace &trace = ConnectionTrace::getInstance();
+  const uint64_t id = trace.next_connection_id();
+
+  std::thread connection_thread([&trace, id]() {
+    for (uint64_t ts = 0; ts < ConnectionTrace::kEventsPerThread + 10; ++ts) {
+      trace.record(id, Event::kFirstByteFromClient, ts);
+    }
+  });
+  connection_thread.join();
+
+  std::vector<ConnectionTrace::Record> events = events_of(id);
+  ASSERT_EQ(ConnectionTrace::kEventsPerThread, events.size());
+  EXPECT_EQ(10u, events.front().timestamp);
+  EXPECT_EQ(ConnectionTrace::kEventsPerThread + 9, events.back().timestamp);
+}
+
+TEST(TestConnectionTrace, ReusesBuffersOfExitedThreads) {
+  ConnectionTrace &trace = ConnectionTrace::getInstance();
+  const uint64_t first = trace.next_connection_id();
+  const uint64_t second = trace.next_connection_id();
+
+  std::thread([&trace, first]() {
+    for (uint64_t ts = 0; ts < ConnectionTrace::kEventsPerThread; ++ts) {
+      trace.record(first, Event::kFirstByteFromServer, ts);
+    }
+  }).join();
+  std::thread([&trace, second]() { trace.record(second, Event::kAccepted, 1); }).join();
+
+  // the second thread got the full buffer of the first one
+  EXPECT_EQ(ConnectionTrace::kEventsPerThread - 1, events_of(first).size());
+  EXPECT_EQ(1u, events_of(second).size());
+}
+
+TEST(TestConnectionTrace, EventNames) {
+  EXPECT_STREQ("accepted", ConnectionTrace::event_name(Event::kAccepted));
+  EXPECT_STREQ("last_byte_from_server", ConnectionTrace::event_name(Event::kLastByteFromServer));
+}
@@ -0,0 +1,136 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <chrono>
+#include <map>
+
+#include "dest_consistent_hash.h"
+#include "test/helpers.h"
+
+#include "tcp_address.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+using mysql_harness::TCPAddress;
+
+// exposes the ranking RouteDestination keeps for all strategies
+class HashDestination : public DestRoundRobin {
+ public:
+  using DestRoundRobin::rank_by_rendezvous_hash;
+};
+
+class ConsistentHashDestinationTest : public ::testing::Test {
+protected:
+  MockRoutingSockOps mock_routing_sock_ops_;
+};
+
+TEST_F(ConsistentHashDestinationTest, SameClientSameServer)
+{
+  int error;
+  DestConsistentHash dest(Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  std::map<int, int> picked;
+  for (uint64_t key = 0; key < 300; ++key) {
+    const int sock = dest.get_server_socket_for_client(key, std::chrono::milliseconds::zero(), &error);
+    EXPECT_EQ(sock, dest.get_server_socket_for_client(key, std::chrono::milliseconds::zero(), &error));
+    ++picked[sock];
+  }
+
+  // the clients spread over all servers
+  ASSERT_EQ(3u, picked.size());
+  for (const auto &server: picked) {
+    EXPECT_GT(server.second, 50) << server.first;
+  }
+}
+
+TEST_F(ConsistentHashDestinationTest, RemovingServerMovesOnlyItsKeys)
+{
+  const HashDestination::AddrVector before{
+      TCPAddress("s1", 3306), TCPAddress("s2", 3306), TCPAddress("s3", 3306), TCPAddress("s4", 3306)};
+  const HashDestination::AddrVector after{
+      TCPAddress("s1", 3306), TCPAddress("s2", 3306), TCPAddress("s4", 3306)};
+
+  size_t moved = 0;
+  for (uint64_t key = 0; key < 1000; ++key) {
+    const TCPAddress &old_server = before[HashDestination::rank_by_rendezvous_hash(before, key).front()];
+    const TCPAddress &new_server = after[HashDestination::rank_by_rendezvous_hash(after, key).front()];
+    if (old_server == before[2]) {
+      ++moved;
+      // goes to the server ranked second before
+      EXPECT_EQ(before[HashDestination::rank_by_rendezvous_hash(before, key).at(1)], new_server);
+    } else {
+      EXPECT_EQ(old_server, new_server);
+    }
+  }
+  EXPECT_GT(moved, 150u);
+  EXPECT_LT(moved, 350u);
+}
+
+TEST_F(ConsistentHashDestinationTest, FailoverToNextRanked)
+{
+  int error;
+  DestConsistentHash dest(Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  const uint64_t key = 42;
+  const auto ranked = HashDestination::rank_by_rendezvous_hash(
+      {TCPAddress("11", 1), TCPAddress("12", 1), TCPAddress("13", 1)}, key);
+
+  // the server of the client fails and gets quarantined, the next ranked one takes over
+  mock_routing_sock_ops_.get_mysql_socket_fail(1);
+  EXPECT_EQ(11 + static_cast<int>(ranked[1]),
+            dest.get_server_socket_for_client(key, std::chrono::milliseconds::zero(), &error));
+  EXPECT_EQ(1u, dest.size_quarantine());
+  EXPECT_EQ(11 + static_cast<int>(ranked[1]),
+            dest.get_server_socket_for_client(key, std::chrono::milliseconds::zero(), &error));
+}
+
+TEST_F(ConsistentHashDestinationTest, ClientKeyIgnoresPort)
+{
+  sockaddr_storage a{}, b{};
+  auto *a4 = reinterpret_cast<sockaddr_in*>(&a);
+  auto *b4 = reinterpret_cast<sockaddr_in*>(&b);
+  a4->sin_family = b4->sin_family = AF_INET;
+  a4->sin_addr.s_addr = b4->sin_addr.s_addr = htonl(0x0a000001);
+  a4->sin_port = htons(40000);
+  b4->sin_port = htons(40001);
+  EXPECT_EQ(RouteDestination::get_client_key(a), RouteDestination::get_client_key(b));
+
+  b4->sin_addr.s_addr = htonl(0x0a000002);
+  EXPECT_NE(RouteDestination::get_client_key(a), RouteDestination::get_client_key(b));
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,177 @@
+/*
+  Copyright (c) 2017, 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "dest_round_robin.h"
+#include "destination_health.h"
+#include "routing_mocks.h"
+#include "tcp_address.h"
+#include "test/helpers.h"
+
+#include "gtest/gtest.h"
+
+using mysql_harness::TCPAddress;
+
+namespace {
+
+class FakeMember : public DestinationHealth::Member {
+public:
+  void on_quarantine_changed(const TCPAddress &, bool quarantined) noexcept override {
+    quarantined_ = quarantined;
+  }
+
+  std::vector<bool> probe(const std::vector<TCPAddress> &addrs) override {
+    probes_ += addrs.size();
+    return std::vector<bool>(addrs.size(), reachable_.load());
+  }
+
+  std::atomic<bool> quarantined_{false};
+  std::atomic<bool> reachable_{true};
+  std::atomic<size_t> probes_{0};
+};
+
+bool wait_for(const std::function<bool()> &predicate) {
+  for (int i = 0; i < 200 && !predicate(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return predicate();
+}
+
+}  // namespace
+
+TEST(DestinationHealthTest, MembersShareQuarantine)
+{
+  DestinationHealth health;
+  FakeMember first, second, other;
+  const TCPAddress addr("11", 1);
+  health.join(&first, addr);
+  health.join(&second, addr);
+  health.join(&other, TCPAddress("12", 1));
+
+  health.quarantine(addr);
+  EXPECT_TRUE(first.quarantined_);
+  EXPECT_TRUE(second.quarantined_);
+  EXPECT_FALSE(other.quarantined_);
+
+  // joining later, the member learns about the quarantine
+  FakeMember late;
+  health.join(&late, addr);
+  EXPECT_TRUE(late.quarantined_);
+
+  health.unquarantine(addr);
+  EXPECT_FALSE(first.quarantined_);
+  EXPECT_FALSE(second.quarantined_);
+  EXPECT_FALSE(late.quarantined_);
+
+  health.leave_all(&first);
+  health.leave_all(&second);
+  health.leave_all(&late);
+  health.leave_all(&other);
+}
+
+TEST(DestinationHealthTest, ServerForgottenWithoutMembers)
+{
+  DestinationHealth health;
+  FakeMember member;
+  const TCPAddress addr("11", 1);
+  health.join(&member, addr);
+  health.quarantine(addr);
+  EXPECT_TRUE(health.is_quarantined(addr));
+
+  health.leave(&member, addr);
+  EXPECT_FALSE(health.is_quarantined(addr));
+
+  // a server nobody has isn't quarantined
+  health.quarantine(addr);
+  EXPECT_FALSE(health.is_quarantined(addr));
+}
+
+TEST(DestinationHealthTest, ProbesEachServerOnce)
+{
+  DestinationHealth health;
+  FakeMember first, second;
+  const TCPAddress addr("11", 1);
+  health.join(&first, addr);
+  health.join(&second, addr);
+  first.reachable_ = false;
+  second.reachable_ = false;
+  health.start_probing(&first, std::chrono::milliseconds(1), std::chrono::milliseconds(1),
+                       mysql_harness::kDefaultStackSizeInKiloBytes);
+  health.start_probing(&second, std::chrono::milliseconds(1), std::chrono::milliseconds(1),
+                       mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  health.quarantine(addr);
+  ASSERT_TRUE(wait_for([&] { return first.probes_ >= 3; }));
+  EXPECT_EQ(0u, second.probes_.load());
+
+  // the other member probes once the first left
+  health.leave_all(&first);
+  ASSERT_TRUE(wait_for([&] { return second.probes_ > 0; }));
+  second.reachable_ = true;
+  EXPECT_TRUE(wait_for([&] { return !second.quarantined_; }));
+
+  health.leave_all(&second);
+}
+
+TEST(DestinationHealthTest, RoutesShareQuarantine)
+{
+  MockRoutingSockOps sock_ops;
+  DestRoundRobin first(Protocol::get_default(), &sock_ops, mysql_harness::kDefaultStackSizeInKiloBytes);
+  DestRoundRobin second(Protocol::get_default(), &sock_ops, mysql_harness::kDefaultStackSizeInKiloBytes);
+  first.add("11", 1);
+  first.add("12", 1);
+  second.add("11", 1);
+  second.add("13", 1);
+
+  int error;
+  // the failed connect of the first route quarantines the server for the second
+  sock_ops.get_mysql_socket_fail(1);
+  EXPECT_EQ(12, first.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  EXPECT_EQ(1u, first.size_quarantine());
+  EXPECT_EQ(1u, second.size_quarantine());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(13, second.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+
+  // a route created later knows about the quarantine too
+  DestRoundRobin third(Protocol::get_default(), &sock_ops, mysql_harness::kDefaultStackSizeInKiloBytes);
+  third.add("11", 1);
+  EXPECT_EQ(1u, third.size_quarantine());
+
+  first.start();
+  second.start();
+  EXPECT_TRUE(wait_for([&] { return first.size_quarantine() == 0 && second.size_quarantine() == 0 &&
+                               third.size_quarantine() == 0; }));
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
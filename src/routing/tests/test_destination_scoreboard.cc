@@ -0,0 +1,108 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "destination_scoreboard.h"
+#include "tcp_address.h"
+
+#include "gtest/gtest.h"
+
+using mysql_harness::TCPAddress;
+using std::chrono::microseconds;
+
+TEST(DestinationScoreboardTest, GetAddsOnce)
+{
+  DestinationScoreboard scoreboard;
+  TCPAddress addr("11", 1);
+
+  EXPECT_EQ(nullptr, scoreboard.find(addr));
+  auto score = scoreboard.get(addr);
+  ASSERT_NE(nullptr, score);
+  EXPECT_EQ(score, scoreboard.get(addr));
+  EXPECT_EQ(score, scoreboard.find(addr));
+  EXPECT_EQ(1u, scoreboard.get_all()->size());
+}
+
+TEST(DestinationScoreboardTest, ScoresConnects)
+{
+  DestinationScoreboard scoreboard;
+  auto score = scoreboard.get(TCPAddress("11", 1));
+
+  EXPECT_EQ(1.0, score->get_connect_success_rate());
+  EXPECT_EQ(microseconds::zero(), score->get_latency());
+
+  score->connect_succeeded(microseconds(1000));
+  score->connect_succeeded(microseconds(9000));
+  EXPECT_EQ(microseconds(2000), score->get_latency());
+  EXPECT_EQ(1.0, score->get_connect_success_rate());
+
+  score->connect_failed(111);
+  EXPECT_DOUBLE_EQ(1.0 - 1.0 / DestinationScore::kSmoothing, score->get_connect_success_rate());
+
+  const auto scores = scoreboard.get_scores();
+  ASSERT_EQ(1u, scores.size());
+  EXPECT_EQ("11:1", scores[0].address);
+  EXPECT_EQ(2u, scores[0].connects_succeeded);
+  EXPECT_EQ(1u, scores[0].connects_failed);
+  EXPECT_EQ(111, scores[0].last_error);
+  EXPECT_NE(std::chrono::system_clock::time_point(), scores[0].last_error_time);
+  EXPECT_EQ(microseconds(2000), scores[0].connect_latency);
+}
+
+TEST(DestinationScoreboardTest, CountsActiveConnections)
+{
+  DestinationScoreboard scoreboard;
+  auto score = scoreboard.get(TCPAddress("11", 1));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([score] {
+      for (int i = 0; i < 1000; ++i) score->connection_opened();
+      for (int i = 0; i < 500; ++i) score->connection_closed();
+    });
+  }
+  for (auto &thread: threads) thread.join();
+
+  EXPECT_EQ(2000u, score->get_active_connections());
+  EXPECT_EQ(2000u, scoreboard.get_scores()[0].active_connections);
+}
+
+TEST(DestinationScoreboardTest, SamplesByteRate)
+{
+  DestinationScoreboard scoreboard;
+  auto score = scoreboard.get(TCPAddress("11", 1));
+
+  score->forwarded(1000);
+  // not sampled before a second passed
+  EXPECT_EQ(0.0, scoreboard.get_scores()[0].bytes_per_second);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  const double rate = scoreboard.get_scores()[0].bytes_per_second;
+  EXPECT_GT(rate, 0.0);
+  EXPECT_LT(rate, 1000.0);
+}
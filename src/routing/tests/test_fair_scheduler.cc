@@ -0,0 +1,155 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "fair_scheduler.h"
+
+#include "gtest/gtest.h"
+
+using Share = FairScheduler::Share;
+using std::chrono::milliseconds;
+
+/**
+ * @test
+ *       Verify that a connection ahead of its quantum waits while a small
+ *       one gets served every round.
+ */
+TEST(TestFairScheduler, BulkWaitsForItsTurn) {
+  FairScheduler scheduler(1000);
+  const auto now = FairScheduler::clock_type::now();
+  Share bulk;
+  Share small;
+
+  scheduler.begin_round(now);
+  ASSERT_TRUE(scheduler.may_read(bulk));
+  scheduler.charge(bulk, 3500);
+  ASSERT_TRUE(scheduler.may_read(small));
+  scheduler.charge(small, 10);
+  scheduler.end_round();
+
+  // bulk took three and a half quanta, it skips the next two rounds
+  for (int round = 0; round < 2; ++round) {
+    scheduler.begin_round(now);
+    EXPECT_FALSE(scheduler.may_read(bulk));
+    EXPECT_TRUE(scheduler.may_read(small));
+    scheduler.charge(small, 10);
+    scheduler.end_round();
+  }
+
+  scheduler.begin_round(now);
+  EXPECT_TRUE(scheduler.may_read(bulk));
+}
+
+/**
+ * @test
+ *       Verify that rounds with only deferred connections are skipped.
+ */
+TEST(TestFairScheduler, AloneNotSlowedDown) {
+  FairScheduler scheduler(1000);
+  const auto now = FairScheduler::clock_type::now();
+  Share bulk;
+
+  scheduler.begin_round(now);
+  ASSERT_TRUE(scheduler.may_read(bulk));
+  scheduler.charge(bulk, 10000);
+  scheduler.end_round();
+
+  scheduler.begin_round(now);
+  EXPECT_FALSE(scheduler.may_read(bulk));
+  scheduler.end_round();
+
+  scheduler.begin_round(now);
+  EXPECT_TRUE(scheduler.may_read(bulk));
+}
+
+/**
+ * @test
+ *       Verify that idle connections don't save up more than a quantum.
+ */
+TEST(TestFairScheduler, CreditLimitedToQuantum) {
+  FairScheduler scheduler(1000);
+  const auto now = FairScheduler::clock_type::now();
+  Share idle;
+  Share busy;
+
+  for (int round = 0; round < 10; ++round) {
+    scheduler.begin_round(now);
+    EXPECT_TRUE(scheduler.may_read(busy));
+    scheduler.charge(busy, 500);
+    scheduler.end_round();
+  }
+
+  scheduler.begin_round(now);
+  EXPECT_TRUE(scheduler.may_read(idle));
+  scheduler.charge(idle, 2500);
+  EXPECT_TRUE(scheduler.may_read(busy));
+  scheduler.charge(busy, 500);
+  scheduler.end_round();
+
+  scheduler.begin_round(now);
+  EXPECT_FALSE(scheduler.may_read(idle));
+}
+
+/**
+ * @test
+ *       Verify that the bandwidth limit defers the reads until the bucket
+ *       got refilled.
+ */
+TEST(TestFairScheduler, BandwidthLimit) {
+  FairScheduler scheduler(0, 10000);
+  auto now = FairScheduler::clock_type::now();
+  Share share;
+  EXPECT_TRUE(scheduler.is_enabled());
+
+  // the bucket holds a tenth of a second
+  scheduler.begin_round(now);
+  ASSERT_TRUE(scheduler.may_read(share));
+  scheduler.charge(share, 1500);
+  scheduler.end_round();
+  EXPECT_EQ(milliseconds(51), scheduler.get_throttle_delay());
+
+  now += milliseconds(20);
+  scheduler.begin_round(now);
+  EXPECT_FALSE(scheduler.may_read(share));
+  scheduler.end_round();
+
+  now += milliseconds(40);
+  scheduler.begin_round(now);
+  EXPECT_TRUE(scheduler.may_read(share));
+  EXPECT_EQ(milliseconds(0), scheduler.get_throttle_delay());
+}
+
+/**
+ * @test
+ *       Verify that nothing gets deferred without quantum and limit.
+ */
+TEST(TestFairScheduler, Disabled) {
+  FairScheduler scheduler;
+  Share share;
+  EXPECT_FALSE(scheduler.is_enabled());
+
+  scheduler.begin_round(FairScheduler::clock_type::now());
+  scheduler.charge(share, 1000000);
+  EXPECT_TRUE(scheduler.may_read(share));
+}
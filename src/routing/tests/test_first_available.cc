@@ -23,9 +23,14 @@
 */
 
 #include "dest_first_available.h"
+#include "dest_round_robin.h"
+#include "destination_health.h"
 #include "routing_mocks.h"
 #include "test/helpers.h"
 
+#include <chrono>
+#include <thread>
+
 class FirstAvailableTest : public ::testing::Test {
 
  public:
@@ -172,6 +177,39 @@ TEST_F(FirstAvailableTest, StartWithAllDown) {
   ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 3); // 3 more good conns
 }
 
+TEST_F(FirstAvailableTest, SkipsServersQuarantinedByOtherRoutes) {
+  int dummy;
+
+  // another route having the 1st server found it down
+  DestRoundRobin other(Protocol::Type::kClassicProtocol, routing_sock_ops_.get());
+  other.add("41", 1);
+  DestinationHealth::instance().quarantine(mysql_harness::TCPAddress("41", 1));
+
+  ASSERT_EQ(dest().get_server_socket(std::chrono::seconds::zero(), &dummy), 42);
+  ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 1); // 1st server not tried
+
+  // the others failing, the quarantined server is tried last
+  routing_sock_ops_->get_mysql_socket_fail(2);
+  ASSERT_EQ(dest().get_server_socket(std::chrono::seconds::zero(), &dummy), 41);
+  ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 3); // 2 failed + 1 good conn
+}
+
+TEST_F(FirstAvailableTest, StopsOnceConnectDeadlineIsUsedUp) {
+  int dummy;
+
+  {
+    RouteDestination::ConnectDeadline deadline(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    ASSERT_EQ(dest().get_server_socket(std::chrono::seconds(1), &dummy), -1);
+    ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 0); // no server tried
+  }
+
+  // the deadline is gone with its scope, all servers are still up
+  ASSERT_EQ(dest().get_server_socket(std::chrono::seconds::zero(), &dummy), 41);
+  ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 1);
+}
+
 int main(int argc, char *argv[]) {
   init_test_logger();
   ::testing::InitGoogleTest(&argc, argv);
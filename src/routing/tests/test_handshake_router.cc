@@ -0,0 +1,135 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "dest_first_available.h"
+#include "handshake_router.h"
+#include "protocol/classic_handshake.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+
+using classic_handshake::ClientHandshake;
+
+namespace {
+
+// connection attributes with their length-encoded total length
+std::vector<uint8_t> make_attributes(const std::vector<std::pair<std::string, std::string>> &attrs) {
+  std::vector<uint8_t> pairs;
+  for (const auto &attr : attrs) {
+    pairs.push_back(static_cast<uint8_t>(attr.first.size()));
+    pairs.insert(pairs.end(), attr.first.begin(), attr.first.end());
+    pairs.push_back(static_cast<uint8_t>(attr.second.size()));
+    pairs.insert(pairs.end(), attr.second.begin(), attr.second.end());
+  }
+  pairs.insert(pairs.begin(), static_cast<uint8_t>(pairs.size()));
+  return pairs;
+}
+
+} // namespace
+
+class HandshakeRouterTest : public ::testing::Test {
+protected:
+  std::shared_ptr<RouteDestination> make_pool() {
+    return std::make_shared<DestFirstAvailable>(Protocol::get_default(), &mock_routing_sock_ops_);
+  }
+
+  MockRoutingSockOps mock_routing_sock_ops_;
+};
+
+TEST_F(HandshakeRouterTest, RouteByUser) {
+  HandshakeRouter router("user");
+  std::shared_ptr<RouteDestination> reports = make_pool();
+  router.add_pool("reports", reports);
+
+  ClientHandshake handshake;
+  handshake.username = "reports";
+  handshake.database = "app";
+  EXPECT_EQ(reports, router.get_pool(handshake));
+
+  // the others stay with the destinations of the route
+  handshake.username = "app";
+  EXPECT_EQ(nullptr, router.get_pool(handshake));
+}
+
+TEST_F(HandshakeRouterTest, RouteBySchema) {
+  HandshakeRouter router("schema");
+  std::shared_ptr<RouteDestination> shop = make_pool();
+  router.add_pool("shop", shop);
+
+  ClientHandshake handshake;
+  handshake.username = "shop";
+  EXPECT_EQ(nullptr, router.get_pool(handshake));
+
+  handshake.database = "shop";
+  EXPECT_EQ(shop, router.get_pool(handshake));
+}
+
+TEST_F(HandshakeRouterTest, RouteByAttribute) {
+  HandshakeRouter router("attribute:cluster");
+  std::shared_ptr<RouteDestination> eu = make_pool();
+  router.add_pool("eu", eu);
+
+  ClientHandshake handshake;
+  EXPECT_EQ(nullptr, router.get_pool(handshake));
+
+  handshake.connection_attrs = make_attributes({{"_client_name", "libmysql"}, {"cluster", "eu"}});
+  EXPECT_EQ("eu", router.get_key(handshake));
+  EXPECT_EQ(eu, router.get_pool(handshake));
+
+  handshake.connection_attrs = make_attributes({{"cluster", "us"}});
+  EXPECT_EQ(nullptr, router.get_pool(handshake));
+
+  // cut short, nothing is found
+  handshake.connection_attrs = make_attributes({{"cluster", "eu"}});
+  handshake.connection_attrs.pop_back();
+  EXPECT_EQ(nullptr, router.get_pool(handshake));
+}
+
+TEST_F(HandshakeRouterTest, InvalidSettings) {
+  EXPECT_THROW(HandshakeRouter("host"), std::invalid_argument);
+  EXPECT_THROW(HandshakeRouter("attribute:"), std::invalid_argument);
+
+  HandshakeRouter router("user");
+  router.add_pool("a", make_pool());
+  EXPECT_THROW(router.add_pool("a", make_pool()), std::invalid_argument);
+}
+
+TEST(HandshakeRouterRouteMap, Parse) {
+  auto entries = HandshakeRouter::parse_route_map(
+      "reports = 10.0.0.1:3306,10.0.0.2 ; app=metadata-cache://c1/default?role=PRIMARY;");
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("reports", entries[0].first);
+  EXPECT_EQ("10.0.0.1:3306,10.0.0.2", entries[0].second);
+  EXPECT_EQ("app", entries[1].first);
+  EXPECT_EQ("metadata-cache://c1/default?role=PRIMARY", entries[1].second);
+
+  EXPECT_TRUE(HandshakeRouter::parse_route_map("").empty());
+  EXPECT_THROW(HandshakeRouter::parse_route_map("reports"), std::invalid_argument);
+  EXPECT_THROW(HandshakeRouter::parse_route_map("=10.0.0.1"), std::invalid_argument);
+}
@@ -0,0 +1,407 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "connection.h"
+#include "context.h"
+#include "io_engine.h"
+#include "protocol/base_protocol.h"
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+/**
+ * Protocol forwarding whatever it reads; handshake is reported done after
+ * the first packet from the server.
+ */
+class ForwardingProtocol : public BaseProtocol {
+public:
+  ForwardingProtocol() : BaseProtocol(nullptr) {}
+
+  bool on_block_client_host(int, const std::string&) override {
+    ++blocked_;
+    return true;
+  }
+
+  int copy_packets(int sender, int receiver, bool sender_is_readable,
+                   RoutingBufferRef buffer, int *,
+                   bool &handshake_done, size_t *report_bytes_read,
+                   bool from_server) override {
+    *report_bytes_read = 0;
+    if (!sender_is_readable) return 0;
+
+    ssize_t res = ::read(sender, &buffer.front(), buffer.size());
+    if (res == 0) errno = 0;  // the caller assumes errno == 0 on plain connection closes
+    if (res <= 0) return -1;
+
+    if (from_server) handshake_done = true;
+    if (::write(receiver, &buffer.front(), static_cast<size_t>(res)) != res) return -1;
+
+    *report_bytes_read = static_cast<size_t>(res);
+    return 0;
+  }
+
+  bool send_error(int, unsigned short, const std::string&,
+                  const std::string&, const std::string&) override {
+    return true;
+  }
+
+  BaseProtocol::Type get_type() override {
+    return BaseProtocol::Type::kClassicProtocol;
+  }
+
+  std::atomic<int> blocked_{0};
+};
+
+class TestRoutingIOEngine : public testing::Test {
+public:
+  void SetUp() override {
+    protocol_ = new ForwardingProtocol;
+    context_.reset(new MySQLRoutingContext(protocol_,
+        mysql_harness::SocketOperations::instance(), "routing_name",
+        routing::kDefaultNetBufferLength, std::chrono::milliseconds(100),
+        std::chrono::milliseconds(100), mysql_harness::TCPAddress(),
+        mysql_harness::Path(), 100, mysql_harness::kDefaultStackSizeInKiloBytes));
+
+    engine_.reset(new RoutingIOEngine("routing_name", 2, std::chrono::milliseconds(100)));
+    engine_->start();
+    context_->set_io_engine(engine_.get());
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds_));
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds_));
+
+    memset(&client_addr_, 0, sizeof(client_addr_));
+    client_addr_.ss_family = AF_INET;
+  }
+
+  void TearDown() override {
+    engine_->stop();
+    ::close(client_fds_[0]);
+    ::close(server_fds_[0]);
+  }
+
+  std::unique_ptr<MySQLRoutingConnection> make_connection() {
+    // [1] ends are served by the router, [0] ends act as client and server
+    return std::unique_ptr<MySQLRoutingConnection>(new MySQLRoutingConnection(
+        *context_, client_fds_[1], client_addr_, server_fds_[1],
+        mysql_harness::TCPAddress("127.0.0.1", 3306),
+        [this](MySQLRoutingConnection*) {
+          std::lock_guard<std::mutex> lock(completed_mtx_);
+          completed_ = true;
+          completed_cond_.notify_all();
+        }));
+  }
+
+  void check_slow_client();
+
+  bool wait_completed() {
+    std::unique_lock<std::mutex> lock(completed_mtx_);
+    return completed_cond_.wait_for(lock, std::chrono::seconds(5), [this] { return completed_; });
+  }
+
+  ForwardingProtocol* protocol_;
+  std::unique_ptr<MySQLRoutingContext> context_;
+  std::unique_ptr<RoutingIOEngine> engine_;
+  int client_fds_[2];
+  int server_fds_[2];
+  sockaddr_storage client_addr_;
+
+  std::mutex completed_mtx_;
+  std::condition_variable completed_cond_;
+  bool completed_{false};
+};
+
+/**
+ * @test
+ *       Verify that data is forwarded in both directions and connection is
+ *       released when the client closes its socket.
+ */
+TEST_F(TestRoutingIOEngine, ForwardsUntilClientCloses) {
+  auto connection = make_connection();
+  connection->start();
+
+  char buf[4];
+  ASSERT_EQ(4, ::write(server_fds_[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "srv!", 4));
+
+  ASSERT_EQ(4, ::write(client_fds_[0], "cli!", 4));
+  ASSERT_EQ(4, ::read(server_fds_[0], buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "cli!", 4));
+  EXPECT_TRUE(connection->is_handshake_done());
+
+  ::shutdown(client_fds_[0], SHUT_RDWR);
+  ASSERT_TRUE(wait_completed());
+  EXPECT_EQ(0u, context_->active_client_threads_);
+  EXPECT_EQ(0, protocol_->blocked_);
+
+  // buffers are borrowed from the pool of the I/O thread
+  RoutingBufferPool::Stats stats = engine_->get_buffer_pool_stats();
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(0u, stats.in_use);
+  EXPECT_EQ(0u, context_->get_buffer_pool().get_stats().misses);
+}
+
+#ifdef __linux__
+/**
+ * @test
+ *       Verify that traffic after the handshake is forwarded when splicing
+ *       is enabled, the I/O threads queue it instead as splice() would block
+ *       them on a full socket.
+ */
+TEST_F(TestRoutingIOEngine, ForwardsWithSplice) {
+  context_->set_splice_enabled(true);
+  auto connection = make_connection();
+  connection->start();
+
+  char buf[4];
+  ASSERT_EQ(4, ::write(server_fds_[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, sizeof(buf)));
+  ASSERT_TRUE(connection->is_handshake_done());
+
+  ASSERT_EQ(4, ::write(client_fds_[0], "cli!", 4));
+  ASSERT_EQ(4, ::read(server_fds_[0], buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "cli!", 4));
+
+  ASSERT_EQ(4, ::write(server_fds_[0], "res!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "res!", 4));
+
+  ::shutdown(client_fds_[0], SHUT_RDWR);
+  ASSERT_TRUE(wait_completed());
+}
+#endif
+
+/**
+ * Checks that a client not reading doesn't block the traffic from client to
+ * server and all data queued for the client gets delivered once it reads
+ * again.
+ */
+void TestRoutingIOEngine::check_slow_client() {
+  auto connection = make_connection();
+  connection->start();
+
+  char buf[16384];
+  ASSERT_EQ(4, ::write(server_fds_[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, 4));
+  ASSERT_TRUE(connection->is_handshake_done());
+
+  // server sends until reading from it gets paused and its socket fills up
+  ASSERT_EQ(0, fcntl(server_fds_[0], F_SETFL, fcntl(server_fds_[0], F_GETFL) | O_NONBLOCK));
+  const std::string chunk(sizeof(buf), 'r');
+  size_t sent = 0;
+  for (;;) {
+    ssize_t res = ::write(server_fds_[0], chunk.data(), chunk.size());
+    if (res > 0) {
+      sent += static_cast<size_t>(res);
+      continue;
+    }
+    ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+
+    struct pollfd pfd = { server_fds_[0], POLLOUT, 0 };
+    if (::poll(&pfd, 1, 200) == 0) break;
+  }
+
+  ASSERT_EQ(4, ::write(client_fds_[0], "cli!", 4));
+  struct pollfd pfd = { server_fds_[0], POLLIN, 0 };
+  ASSERT_EQ(1, ::poll(&pfd, 1, 5000));
+  ASSERT_EQ(4, ::read(server_fds_[0], buf, 4));
+  EXPECT_EQ(0, memcmp(buf, "cli!", 4));
+
+  size_t received = 0;
+  while (received < sent) {
+    struct pollfd cpfd = { client_fds_[0], POLLIN, 0 };
+    ASSERT_EQ(1, ::poll(&cpfd, 1, 5000));
+    ssize_t res = ::read(client_fds_[0], buf, sizeof(buf));
+    ASSERT_GT(res, 0);
+    EXPECT_EQ(0, memcmp(buf, chunk.data(), static_cast<size_t>(res)));
+    received += static_cast<size_t>(res);
+  }
+  EXPECT_EQ(sent, received);
+
+  ::shutdown(client_fds_[0], SHUT_RDWR);
+  ASSERT_TRUE(wait_completed());
+}
+
+/**
+ * @test
+ *       Verify that with output queues a slow client doesn't block the
+ *       other direction.
+ */
+TEST_F(TestRoutingIOEngine, SlowClientDoesNotBlockOtherDirection) {
+  context_->set_output_queue_watermarks(64 * 1024, 16 * 1024);
+  check_slow_client();
+}
+
+/**
+ * @test
+ *       Verify that without output_queue_high_watermark the I/O threads
+ *       still queue what a slow client doesn't take, instead of blocking.
+ */
+TEST_F(TestRoutingIOEngine, SlowClientDoesNotBlockWithoutWatermarks) {
+  check_slow_client();
+}
+
+/**
+ * @test
+ *       Verify that disconnect() wakes up the I/O thread which closes the
+ *       connection.
+ */
+TEST_F(TestRoutingIOEngine, DisconnectClosesConnection) {
+  auto connection = make_connection();
+  connection->start();
+
+  char buf[4];
+  ASSERT_EQ(4, ::write(server_fds_[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, sizeof(buf)));
+
+  connection->disconnect();
+  ASSERT_TRUE(wait_completed());
+
+  // server side sees the connection closed
+  EXPECT_EQ(0, ::read(server_fds_[0], buf, sizeof(buf)));
+}
+
+/**
+ * @test
+ *       Verify that a connection still needing to connect to the server gets
+ *       connected by the connect threads before it is served.
+ */
+TEST_F(TestRoutingIOEngine, ConnectsBeforeServing) {
+  std::atomic<int> connector_calls{0};
+  MySQLRoutingConnection* connection = new MySQLRoutingConnection(
+      *context_, client_fds_[1], client_addr_, routing::kInvalidSocket,
+      mysql_harness::TCPAddress(),
+      [this](MySQLRoutingConnection* conn) {
+        // this lambda is destroyed together with the connection
+        TestRoutingIOEngine* test = this;
+        delete conn;
+        std::lock_guard<std::mutex> lock(test->completed_mtx_);
+        test->completed_ = true;
+        test->completed_cond_.notify_all();
+      },
+      [&](mysql_harness::TCPAddress& server_address) {
+        ++connector_calls;
+        server_address = mysql_harness::TCPAddress("127.0.0.1", 3306);
+        return server_fds_[1];
+      });
+  connection->start();
+
+  char buf[4];
+  ASSERT_EQ(4, ::write(server_fds_[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "srv!", 4));
+  EXPECT_EQ(1, connector_calls);
+
+  ::shutdown(client_fds_[0], SHUT_RDWR);
+  ASSERT_TRUE(wait_completed());
+}
+
+/**
+ * @test
+ *       Verify that connection not completing the handshake within
+ *       client_connect_timeout is closed and counted as connection error.
+ */
+TEST_F(TestRoutingIOEngine, HandshakeTimeout) {
+  auto connection = make_connection();
+  connection->start();
+
+  ASSERT_TRUE(wait_completed());
+  EXPECT_FALSE(connection->is_handshake_done());
+  EXPECT_EQ(1, protocol_->blocked_);
+  EXPECT_EQ(1u, context_->conn_error_counters_->size());
+}
+
+/**
+ * @test
+ *       Verify that max_bandwidth limits the bytes forwarded per second.
+ */
+TEST_F(TestRoutingIOEngine, BandwidthLimit) {
+  engine_->stop();
+  engine_.reset(new RoutingIOEngine("routing_name", 1, std::chrono::milliseconds(100)));
+  engine_->set_fair_share(1024, 1000000);
+  engine_->start();
+  context_->set_io_engine(engine_.get());
+
+  auto connection = make_connection();
+  connection->start();
+
+  char buf[4];
+  ASSERT_EQ(4, ::write(server_fds_[0], "srv!", 4));
+  ASSERT_EQ(4, ::read(client_fds_[0], buf, sizeof(buf)));
+
+  // a tenth of a second goes at once, the rest at 1MB/s
+  const size_t kBytes = 500000;
+  const auto started = std::chrono::steady_clock::now();
+  std::thread writer([this, kBytes]() {
+    std::vector<char> data(kBytes, 'x');
+    size_t written = 0;
+    while (written < kBytes) {
+      const ssize_t res = ::write(client_fds_[0], data.data() + written, kBytes - written);
+      if (res <= 0) break;
+      written += static_cast<size_t>(res);
+    }
+  });
+
+  std::vector<char> received(64 * 1024);
+  size_t total = 0;
+  while (total < kBytes) {
+    const ssize_t res = ::read(server_fds_[0], received.data(), received.size());
+    if (res <= 0) break;
+    total += static_cast<size_t>(res);
+  }
+  writer.join();
+
+  EXPECT_EQ(kBytes, total);
+  EXPECT_GE(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(300));
+
+  ::shutdown(client_fds_[0], SHUT_RDWR);
+  ASSERT_TRUE(wait_completed());
+}
+
+#endif  // _WIN32
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
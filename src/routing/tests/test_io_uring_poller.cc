@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "io_uring_poller.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+class TestIoUringPoller : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    poller_ = IoUringPoller::create();
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+  }
+
+  void TearDown() override {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+  std::unique_ptr<IoUringPoller> poller_;
+  int fds_[2]{-1, -1};
+  std::vector<IoUringPoller::ReadyFd> ready_;
+};
+
+/**
+ * @test
+ *       Verify that a socket is reported as long as it has data to read,
+ *       and not after it stopped being watched for reads.
+ */
+TEST_F(TestIoUringPoller, ReportsReadable) {
+  if (!poller_) return;  // kernel without io_uring
+
+  poller_->add(fds_[0], IoUringPoller::kReadEvent);
+  EXPECT_EQ(0, poller_->wait(ready_, 10));
+
+  ASSERT_EQ(1, ::write(fds_[1], "x", 1));
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(1, poller_->wait(ready_, 1000));
+    EXPECT_EQ(fds_[0], ready_[0].fd);
+    EXPECT_TRUE(ready_[0].readable);
+    EXPECT_FALSE(ready_[0].writable);
+  }
+
+  poller_->modify(fds_[0], 0);
+  EXPECT_EQ(0, poller_->wait(ready_, 10));
+}
+
+/**
+ * @test
+ *       Verify that a change of the watched events replaces the pending
+ *       poll and a removed socket isn't reported anymore.
+ */
+TEST_F(TestIoUringPoller, ModifyAndRemove) {
+  if (!poller_) return;  // kernel without io_uring
+
+  poller_->add(fds_[0], IoUringPoller::kReadEvent);
+  EXPECT_EQ(0, poller_->wait(ready_, 10));
+
+  poller_->modify(fds_[0], IoUringPoller::kReadEvent | IoUringPoller::kWriteEvent);
+  ASSERT_EQ(1, poller_->wait(ready_, 1000));
+  EXPECT_FALSE(ready_[0].readable);
+  EXPECT_TRUE(ready_[0].writable);
+
+  poller_->remove(fds_[0]);
+  EXPECT_EQ(0, poller_->wait(ready_, 10));
+}
+
+/**
+ * @test
+ *       Verify that a closed peer is reported as readable.
+ */
+TEST_F(TestIoUringPoller, ReportsHangup) {
+  if (!poller_) return;  // kernel without io_uring
+
+  poller_->add(fds_[0], 0);
+  ::close(fds_[1]);
+  fds_[1] = -1;
+
+  ASSERT_EQ(1, poller_->wait(ready_, 1000));
+  EXPECT_TRUE(ready_[0].readable);
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <map>
+
+#include "dest_least_connections.h"
+#include "test/helpers.h"
+
+#include "tcp_address.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+
+using mysql_harness::TCPAddress;
+
+class LeastConnectionsDestinationTest : public ::testing::Test {
+protected:
+  MockRoutingSockOps mock_routing_sock_ops_;
+
+  // connections per server, by the number the server address starts with
+  std::map<int, size_t> connections_;
+
+  DestLeastConnections::ConnectionCounter counter() {
+    return [this](const TCPAddress& addr) { return connections_[atoi(addr.addr.c_str())]; };
+  }
+};
+
+
+TEST_F(LeastConnectionsDestinationTest, PicksLeastBusy)
+{
+  int error;
+  DestLeastConnections dest(counter(), Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  connections_ = {{11, 5}, {12, 2}, {13, 7}};
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+
+  connections_[12] = 9;
+  EXPECT_EQ(11, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+}
+
+TEST_F(LeastConnectionsDestinationTest, TiesAreRoundRobin)
+{
+  int error;
+  DestLeastConnections dest(counter(), Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  // nothing counted yet, like a burst of connections still connecting
+  std::map<int, size_t> picked;
+  for (int i = 0; i < 9; ++i) {
+    ++picked[dest.get_server_socket(std::chrono::milliseconds::zero(), &error)];
+  }
+  EXPECT_EQ(3u, picked[11]);
+  EXPECT_EQ(3u, picked[12]);
+  EXPECT_EQ(3u, picked[13]);
+}
+
+TEST_F(LeastConnectionsDestinationTest, SkipsQuarantined)
+{
+  int error;
+  DestLeastConnections dest(counter(), Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+
+  connections_ = {{11, 0}, {12, 3}};
+
+  // least busy server fails, gets quarantined and the other one is used
+  mock_routing_sock_ops_.get_mysql_socket_fail(1);
+  EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  EXPECT_EQ(1u, dest.size_quarantine());
+
+  EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+}
+
+TEST_F(LeastConnectionsDestinationTest, CountsOnScoreboard)
+{
+  int error;
+  DestLeastConnections dest(nullptr, Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+
+  // without a counter the connections routed to the servers are counted
+  dest.get_scoreboard()->get(TCPAddress("11", 1))->connection_opened();
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,139 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <chrono>
+
+#include "dest_lowest_latency.h"
+#include "test/helpers.h"
+
+#include "tcp_address.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+
+using mysql_harness::TCPAddress;
+using std::chrono::microseconds;
+
+// exposes the latency bookkeeping RouteDestination keeps for all strategies
+class LatencyDestination : public DestRoundRobin {
+ public:
+  using DestRoundRobin::DestRoundRobin;
+  using DestRoundRobin::update_latency;
+  using DestRoundRobin::select_lowest_latency;
+  using DestRoundRobin::kLatencyExplorationInterval;
+
+  const AddrVector& get_destinations() const { return destinations_; }
+};
+
+class LowestLatencyDestinationTest : public ::testing::Test {
+protected:
+  MockRoutingSockOps mock_routing_sock_ops_;
+};
+
+
+TEST_F(LowestLatencyDestinationTest, MovingAverage)
+{
+  LatencyDestination d;
+  TCPAddress addr("11", 1);
+
+  EXPECT_EQ(microseconds::zero(), d.get_latency(addr));
+  d.update_latency(addr, microseconds(1000));
+  EXPECT_EQ(microseconds(1000), d.get_latency(addr));
+  d.update_latency(addr, microseconds(9000));
+  EXPECT_EQ(microseconds(2000), d.get_latency(addr));
+}
+
+TEST_F(LowestLatencyDestinationTest, PicksWithinTolerance)
+{
+  LatencyDestination d;
+  d.add("11", 1);
+  d.add("12", 1);
+  d.add("13", 1);
+  d.set_latency_tolerance(microseconds(500));
+
+  d.update_latency(TCPAddress("11", 1), microseconds(5000));
+  d.update_latency(TCPAddress("12", 1), microseconds(1200));
+  d.update_latency(TCPAddress("13", 1), microseconds(1500));
+
+  // both close servers take turns, the far one is left alone
+  EXPECT_EQ(1u, d.select_lowest_latency(d.get_destinations(), 0));
+  EXPECT_EQ(1u, d.select_lowest_latency(d.get_destinations(), 1));
+  EXPECT_EQ(2u, d.select_lowest_latency(d.get_destinations(), 2));
+  EXPECT_EQ(1u, d.select_lowest_latency(d.get_destinations(), 3));
+
+  // skipped, like a quarantined server
+  EXPECT_EQ(2u, d.select_lowest_latency(d.get_destinations(), 1,
+                                        [](size_t index) { return index == 1; }));
+}
+
+TEST_F(LowestLatencyDestinationTest, UnmeasuredFirst)
+{
+  LatencyDestination d;
+  d.add("11", 1);
+  d.add("12", 1);
+  d.set_latency_tolerance(microseconds::zero());
+
+  d.update_latency(TCPAddress("11", 1), microseconds(100));
+  EXPECT_EQ(1u, d.select_lowest_latency(d.get_destinations(), 0));
+}
+
+TEST_F(LowestLatencyDestinationTest, Exploration)
+{
+  LatencyDestination d;
+  d.add("11", 1);
+  d.add("12", 1);
+  d.set_latency_tolerance(microseconds::zero());
+
+  d.update_latency(TCPAddress("11", 1), microseconds(5000));
+  d.update_latency(TCPAddress("12", 1), microseconds(100));
+
+  // the slow server still gets measured now and then
+  const size_t start = 2 * LatencyDestination::kLatencyExplorationInterval - 1;
+  EXPECT_EQ(1u, d.select_lowest_latency(d.get_destinations(), start - 1));
+  EXPECT_EQ(start % 2, d.select_lowest_latency(d.get_destinations(), start));
+}
+
+TEST_F(LowestLatencyDestinationTest, MeasuresConnects)
+{
+  int error;
+  DestLowestLatency dest(Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+
+  // not measured yet, both get tried
+  EXPECT_EQ(11, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+
+  EXPECT_GT(dest.get_latency(TCPAddress("11", 1)), microseconds::zero());
+  EXPECT_GT(dest.get_latency(TCPAddress("12", 1)), microseconds::zero());
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
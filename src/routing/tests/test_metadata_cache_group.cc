@@ -66,12 +66,26 @@ class MetadataCacheAPIStub: public metadata_cache::MetadataCacheAPIBase {
 
   MOCK_METHOD2(mark_instance_reachability, void(const std::string&, InstanceStatus));
   MOCK_METHOD2(wait_primary_failover, bool(const std::string&, int));
-  MOCK_METHOD9(cache_init, void(const std::vector<mysql_harness::TCPAddress>&, const std::string&,
-                                const std::string&, std::chrono::milliseconds, const mysqlrouter::SSLOptions&,
-                                const std::string&, int, int, size_t));
+  // gmock can't mock methods with more than 10 arguments
+  void cache_init(const std::vector<mysql_harness::TCPAddress>&, const std::string&,
+                  const std::string&, std::chrono::milliseconds, const mysqlrouter::SSLOptions&,
+                  const std::string&, int, int, size_t, std::chrono::milliseconds,
+                  const std::string&, bool, std::chrono::milliseconds, unsigned int,
+                  bool) override {}
 
   void cache_stop() noexcept override {} // no easy way to mock noexcept method
 
+  metadata_cache::RefreshStats get_refresh_stats() override { return {}; }
+
+  metadata_cache::TopologySnapshot get_topology() override { return {}; }
+
+  uint64_t get_topology_generation() override { return 0; }
+
+  metadata_cache::TopologySnapshot wait_topology_change(uint64_t,
+                                                        std::chrono::milliseconds) override {
+    return {};
+  }
+
  public:
   void fill_instance_vector(const InstanceVector& iv) {
     instance_vector_ = iv;
@@ -82,6 +96,14 @@ class MetadataCacheAPIStub: public metadata_cache::MetadataCacheAPIBase {
     instances_change_listener_->notify(instance_vector_, md_servers_reachable);
   }
 
+  void trigger_instances_change_callback(const InstanceVector& previous,
+                                         const bool md_servers_reachable) {
+    if (!instances_change_listener_) return;
+    instances_change_listener_->notify(instance_vector_,
+                                       metadata_cache::diff_instances(previous, instance_vector_),
+                                       md_servers_reachable);
+  }
+
   std::vector<metadata_cache::ManagedInstance> instance_vector_;
   metadata_cache::ReplicasetStateListenerInterface* instances_change_listener_{nullptr};
 
@@ -118,9 +140,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailableOnPrimaries) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
@@ -137,9 +159,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailableOnSinglePrimary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
@@ -156,9 +178,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailableOnNoPrimary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), -1);
@@ -175,9 +197,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailableOnSecondaries) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -194,9 +216,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailableOnSingleSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3308);
@@ -213,9 +235,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailableOnNoSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), -1);
@@ -232,9 +254,9 @@ TEST_F(DestMetadataCacheTest, StrategyFirstAvailablePrimaryAndSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
@@ -251,9 +273,9 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinWithFallbackUnavailableServer) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::Unavailable, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::Unavailable, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -275,10 +297,10 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinOnPrimaries) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062},
-    {kReplicasetName, "uuid4", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062, 0},
+    {kReplicasetName, "uuid4", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
@@ -297,9 +319,9 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinOnSinglePrimary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
@@ -316,8 +338,8 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinPrimaryMissing) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), -1);
@@ -334,10 +356,10 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinOnSecondaries) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
-    {kReplicasetName, "uuid4", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
+    {kReplicasetName, "uuid4", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -356,9 +378,9 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinOnSingleSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3308);
@@ -375,8 +397,8 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinSecondaryMissing) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), -1);
@@ -393,9 +415,9 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinPrimaryAndSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
-    {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063, 0},
   });
 
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -404,6 +426,31 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinPrimaryAndSecondary) {
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
 }
 
+/*****************************************/
+/*STRATEGY LOWEST LATENCY                */
+/*****************************************/
+TEST_F(DestMetadataCacheTest, StrategyLowestLatencyOnSecondaries) {
+
+  DestMetadataCacheGroup dest_mc_group("cache-name", kReplicasetName,
+                         routing::RoutingStrategy::kLowestLatency,
+                         mysqlrouter::URI("metadata-cache://cache-name/default?role=SECONDARY").query,
+                         BaseProtocol::Type::kClassicProtocol,
+                         routing::AccessMode::kUndefined,
+                         &metadata_cache_api_, &routing_sock_ops_);
+
+  fill_instance_vector({
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3309", 3309, 33063, 0},
+  });
+
+  // the mocked connects are all equally fast, within the tolerance they take turns
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3308);
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3309);
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3308);
+  EXPECT_GT(dest_mc_group.get_latency(mysql_harness::TCPAddress("3308", 3308)), std::chrono::microseconds::zero());
+}
+
 /*****************************************/
 /*STRATEGY ROUND ROBIN_WITH_FALLBACK     */
 /*****************************************/
@@ -417,9 +464,9 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinWithFallbackBasicScenario) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   // we have 2 SECONDARIES up so we expect round robin on them
@@ -438,9 +485,9 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinWithFallbackSingleSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   // we do not fallback to PRIMARIES as long as there is at least single SECONDARY available
@@ -458,8 +505,8 @@ TEST_F(DestMetadataCacheTest, StrategyRoundRobinWithFallbackNoSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
   });
 
   // no SECONDARY available so we expect round-robin on PRIAMRIES
@@ -494,9 +541,9 @@ TEST_F(DestMetadataCacheTest, AllowPrimaryReadsBasic) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-    {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   // we expect round-robin on all the servers (PRIMARY and SECONDARY)
@@ -516,7 +563,7 @@ TEST_F(DestMetadataCacheTest, AllowPrimaryReadsNoSecondary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-    {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
   });
 
   // we expect the PRIMARY being used
@@ -538,8 +585,8 @@ TEST_F(DestMetadataCacheTest, PrimaryDefault) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33061, 0},
   });
 
   // default for PRIMARY should be round-robin on ReadWrite servers
@@ -558,9 +605,9 @@ TEST_F(DestMetadataCacheTest, SecondaryDefault) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-     {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+     {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   // default for SECONDARY should be round-robin on ReadOnly servers
@@ -579,9 +626,9 @@ TEST_F(DestMetadataCacheTest, PrimaryAndSecondaryDefault) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061},
-     {kReplicasetName, "uuid3", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+     {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
   });
 
   // default for PRIMARY_AND_SECONDARY should be round-robin on ReadOnly and ReadWrite servers
@@ -610,16 +657,16 @@ TEST_F(DestMetadataCacheTest, AllowedNodesNoPrimary) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
 
   // new metadata - no primary
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
 
   bool callback_called{false};
@@ -635,6 +682,55 @@ TEST_F(DestMetadataCacheTest, AllowedNodesNoPrimary) {
   ASSERT_TRUE(callback_called);
 }
 
+/**
+ * @test verifies that the change of a member the role=PRIMARY destination
+ *       never routes to doesn't trigger the allowed nodes recalculation
+ */
+TEST_F(DestMetadataCacheTest, AllowedNodesIrrelevantDiff) {
+
+  DestMetadataCacheGroup dest_mc_group("cache-name", kReplicasetName,
+                         routing::RoutingStrategy::kUndefined,
+                         mysqlrouter::URI("metadata-cache://cache-name/default?role=PRIMARY").query,
+                         BaseProtocol::Type::kClassicProtocol,
+                         routing::AccessMode::kReadWrite,
+                         &metadata_cache_api_, &routing_sock_ops_);
+
+  const InstanceVector previous{
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
+  };
+  fill_instance_vector(previous);
+  // need at least one connection to force dest to register for md changes
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
+
+  // new metadata - the secondary went offline, the primary is untouched
+  fill_instance_vector({
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::Unavailable, 1.0, 1, "location", "3307", 3307, 33070, 0},
+  });
+
+  bool callback_called{false};
+  auto check_nodes = [&](const AllowedNodes& nodes, const std::string& reason) -> void {
+    // only called once the primary is gone
+    ASSERT_EQ(0u, nodes.size());
+    ASSERT_STREQ("metadata change", reason.c_str());
+    callback_called = true;
+  };
+  dest_mc_group.register_allowed_nodes_change_callback(check_nodes);
+  metadata_cache_api_.trigger_instances_change_callback(previous, /*md_servers_reachable=*/ true);
+
+  ASSERT_FALSE(callback_called);
+
+  // the primary is gone, that one matters
+  const InstanceVector previous2 = metadata_cache_api_.instance_vector_;
+  fill_instance_vector({
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::Unavailable, 1.0, 1, "location", "3307", 3307, 33070, 0},
+  });
+  metadata_cache_api_.trigger_instances_change_callback(previous2, /*md_servers_reachable=*/ true);
+
+  ASSERT_TRUE(callback_called);
+}
+
 /**
  * @test verifies that when the metadata changes and there are 2 r/w nodes,
  *       then allowed_nodes that gets passed to read-write destination has both
@@ -650,16 +746,16 @@ TEST_F(DestMetadataCacheTest, AllowedNodes2Primaries) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
 
   // new metadata - no primary
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
 
   bool callback_called{false};
@@ -693,15 +789,15 @@ TEST_F(DestMetadataCacheTest, AllowedNodesNoSecondaries) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
 
   // new metadata - no primary
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
   });
 
   bool callback_called{false};
@@ -734,8 +830,8 @@ TEST_F(DestMetadataCacheTest, AllowedNodesSecondaryDisconnectToPromoted) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -779,8 +875,8 @@ TEST_F(DestMetadataCacheTest, AllowedNodesSecondaryDisconnectToPromotedTwice) {
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -816,8 +912,8 @@ TEST_F(DestMetadataCacheTest, AllowedNodesEmptyKeepConnectionsIfMetadataUnavaila
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -856,8 +952,8 @@ TEST_F(DestMetadataCacheTest, AllowedNodesEmptyDisconnectConnectionsIfMetadataUn
                          &metadata_cache_api_, &routing_sock_ops_);
 
   fill_instance_vector({
-     {kReplicasetName, "uuid1", "HA", metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060},
-     {kReplicasetName, "uuid2", "HA", metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070},
+     {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+     {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33070, 0},
   });
   // need at least one connection to force dest to register for md changes
   ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
@@ -1145,6 +1241,114 @@ TEST_F(DestMetadataCacheTest, MetadataCacheDisconnectOnMetadataUnavailable)
   }
 }
 
+/**
+ * @test
+ *      Verify that read_write_splitting=yes hands out the secondaries
+ *      round-robin for reads and is only allowed for role=PRIMARY.
+ */
+TEST_F(DestMetadataCacheTest, ReadWriteSplitting) {
+  DestMetadataCacheGroup dest_mc_group("cache-name", kReplicasetName,
+                         routing::RoutingStrategy::kUndefined,
+                         mysqlrouter::URI("metadata-cache://cache-name/default?role=PRIMARY&read_write_splitting=yes").query,
+                         BaseProtocol::Type::kClassicProtocol,
+                         routing::AccessMode::kUndefined,
+                         &metadata_cache_api_, &routing_sock_ops_);
+
+  fill_instance_vector({
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 0},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 0},
+  });
+
+  ASSERT_TRUE(dest_mc_group.splits_reads());
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
+  ASSERT_EQ(dest_mc_group.get_read_only_server_socket(std::chrono::milliseconds(0), &err_), 3307);
+  ASSERT_EQ(dest_mc_group.get_read_only_server_socket(std::chrono::milliseconds(0), &err_), 3308);
+  ASSERT_EQ(dest_mc_group.get_read_only_server_socket(std::chrono::milliseconds(0), &err_), 3307);
+
+  ASSERT_THROW_LIKE(
+    DestMetadataCacheGroup dest("cache-name", kReplicasetName,
+                                routing::RoutingStrategy::kUndefined,
+                                mysqlrouter::URI("metadata-cache://cache-name/default?role=SECONDARY&read_write_splitting=yes").query,
+                                BaseProtocol::Type::kClassicProtocol),
+    std::runtime_error,
+    "Option 'read_write_splitting' is valid only for role=PRIMARY"
+  );
+
+  DestMetadataCacheGroup dest_ryw("cache-name", kReplicasetName,
+                                  routing::RoutingStrategy::kUndefined,
+                                  mysqlrouter::URI("metadata-cache://cache-name/default?role=PRIMARY&read_write_splitting=yes&read_your_writes=yes").query,
+                                  BaseProtocol::Type::kClassicProtocol,
+                                  routing::AccessMode::kUndefined,
+                                  &metadata_cache_api_, &routing_sock_ops_);
+  ASSERT_TRUE(dest_ryw.reads_own_writes());
+  ASSERT_FALSE(dest_mc_group.reads_own_writes());
+
+  ASSERT_THROW_LIKE(
+    DestMetadataCacheGroup dest("cache-name", kReplicasetName,
+                                routing::RoutingStrategy::kUndefined,
+                                mysqlrouter::URI("metadata-cache://cache-name/default?role=PRIMARY&read_your_writes=yes").query,
+                                BaseProtocol::Type::kClassicProtocol),
+    std::runtime_error,
+    "Option 'read_your_writes' is valid only with read_write_splitting=yes"
+  );
+}
+
+TEST_F(DestMetadataCacheTest, MaxApplierQueueSize) {
+  DestMetadataCacheGroup dest_mc_group("cache-name", kReplicasetName,
+                         routing::RoutingStrategy::kRoundRobinWithFallback,
+                         mysqlrouter::URI("metadata-cache://cache-name/default?role=SECONDARY&max_applier_queue_size=100").query,
+                         BaseProtocol::Type::kClassicProtocol,
+                         routing::AccessMode::kUndefined,
+                         &metadata_cache_api_, &routing_sock_ops_);
+
+  // the secondary 3307 is too far behind
+  fill_instance_vector({
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 101},
+    {kReplicasetName, "uuid3", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3308", 3308, 33062, 100},
+  });
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3308);
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3308);
+
+  // all secondaries lag, the reads fall back to the primary
+  metadata_cache_api_.instance_vector_.at(2).applier_queue_size = 500;
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3306);
+
+  ASSERT_THROW_LIKE(
+    DestMetadataCacheGroup dest("cache-name", kReplicasetName,
+                                routing::RoutingStrategy::kUndefined,
+                                mysqlrouter::URI("metadata-cache://cache-name/default?role=SECONDARY&max_applier_queue_size=-1").query,
+                                BaseProtocol::Type::kClassicProtocol),
+    std::runtime_error,
+    "Invalid value for option 'max_applier_queue_size'. Allowed is a number of transactions"
+  );
+  ASSERT_THROW_LIKE(
+    DestMetadataCacheGroup dest("cache-name", kReplicasetName,
+                                routing::RoutingStrategy::kUndefined,
+                                mysqlrouter::URI("metadata-cache://cache-name/default?role=PRIMARY&max_applier_queue_size=10").query,
+                                BaseProtocol::Type::kClassicProtocol),
+    std::runtime_error,
+    "Option 'max_applier_queue_size' is valid only for routes reading from secondaries"
+  );
+}
+
+TEST_F(DestMetadataCacheTest, MaxApplierQueueSizeKeepsLaggingSecondaries) {
+  DestMetadataCacheGroup dest_mc_group("cache-name", kReplicasetName,
+                         routing::RoutingStrategy::kRoundRobin,
+                         mysqlrouter::URI("metadata-cache://cache-name/default?role=SECONDARY&max_applier_queue_size=100").query,
+                         BaseProtocol::Type::kClassicProtocol,
+                         routing::AccessMode::kUndefined,
+                         &metadata_cache_api_, &routing_sock_ops_);
+
+  // without fallback to the primary, stale reads beat no reads
+  fill_instance_vector({
+    {kReplicasetName, "uuid1", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadWrite, 1.0, 1, "location", "3306", 3306, 33060, 0},
+    {kReplicasetName, "uuid2", metadata_cache::InstanceRole::HA, metadata_cache::ServerMode::ReadOnly, 1.0, 1, "location", "3307", 3307, 33061, 101},
+  });
+  ASSERT_EQ(dest_mc_group.get_server_socket(std::chrono::milliseconds(0), &err_), 3307);
+}
+
 TEST_F(DestMetadataCacheTest, MetadataCacheGroupUnknownParam)
 {
   {
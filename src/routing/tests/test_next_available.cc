@@ -23,6 +23,8 @@
 */
 
 #include "dest_next_available.h"
+#include "dest_round_robin.h"
+#include "destination_health.h"
 #include "routing_mocks.h"
 #include "test/helpers.h"
 
@@ -171,6 +173,23 @@ TEST_F(NextAvailableTest, StartWithAllDown) {
   ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 0); // no more servers
 }
 
+TEST_F(NextAvailableTest, SkipsServersQuarantinedByOtherRoutes) {
+  int dummy;
+
+  // another route having the 1st server found it down
+  DestRoundRobin other(Protocol::Type::kClassicProtocol, routing_sock_ops_.get());
+  other.add("41", 1);
+  DestinationHealth::instance().quarantine(mysql_harness::TCPAddress("41", 1));
+
+  ASSERT_EQ(dest().get_server_socket(std::chrono::milliseconds(0), &dummy), 42);
+  ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 1); // 1st server not tried
+
+  // tried last, like the server failing over from
+  routing_sock_ops_->get_mysql_socket_fail(2);
+  ASSERT_EQ(dest().get_server_socket(std::chrono::milliseconds(0), &dummy), -1);
+  ASSERT_EQ(routing_sock_ops_->get_mysql_socket_call_cnt(), 2); // 2 failed, 1st is behind
+}
+
 int main(int argc, char *argv[]) {
   init_test_logger();
   ::testing::InitGoogleTest(&argc, argv);
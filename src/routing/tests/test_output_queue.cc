@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "output_queue.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+class TestOutputQueue : public testing::Test {
+public:
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+
+    // keep the socket buffer small to make it fill up quickly
+    int size = 4096;
+    setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  }
+
+  void TearDown() override {
+    for (int fd: fds_) {
+      if (fd != -1) ::close(fd);
+    }
+  }
+
+  // read everything available on fds_[1]
+  std::string read_available() {
+    std::string result;
+    char buf[4096];
+    ssize_t res;
+    while ((res = ::recv(fds_[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+      result.append(buf, static_cast<size_t>(res));
+    }
+    return result;
+  }
+
+  // data is written to fds_[0] and read from fds_[1]
+  int fds_[2];
+};
+
+/**
+ * @test
+ *       Verify that data the socket does not take is queued and flushed in
+ *       order once the peer reads.
+ */
+TEST_F(TestOutputQueue, QueuesWhatSocketDoesNotTake) {
+  OutputQueue queue;
+
+  std::string data;
+  for (size_t i = 0; i < 1024 * 1024; ++i) data.push_back(static_cast<char>('a' + i % 26));
+
+  ssize_t res = queue.send(fds_[0], reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  ASSERT_GE(res, 0);
+  ASSERT_LT(static_cast<size_t>(res), data.size());
+  EXPECT_EQ(data.size() - static_cast<size_t>(res), queue.size());
+
+  std::string received;
+  while (!queue.empty()) {
+    received += read_available();
+    ASSERT_GE(queue.flush(fds_[0]), 0);
+  }
+  received += read_available();
+
+  EXPECT_EQ(data, received);
+}
+
+/**
+ * @test
+ *       Verify that data sent while the queue is not empty is queued behind
+ *       the data already queued.
+ */
+TEST_F(TestOutputQueue, KeepsOrder) {
+  OutputQueue queue;
+
+  const std::string first(256 * 1024, 'x');
+  ASSERT_GE(queue.send(fds_[0], reinterpret_cast<const uint8_t*>(first.data()), first.size()), 0);
+  ASSERT_FALSE(queue.empty());
+  const size_t queued = queue.size();
+
+  const std::string second("last");
+  EXPECT_EQ(0, queue.send(fds_[0], reinterpret_cast<const uint8_t*>(second.data()), second.size()));
+  EXPECT_EQ(queued + second.size(), queue.size());
+
+  std::string received;
+  while (!queue.empty()) {
+    received += read_available();
+    ASSERT_GE(queue.flush(fds_[0]), 0);
+  }
+  received += read_available();
+
+  EXPECT_EQ(first + second, received);
+}
+
+/**
+ * @test
+ *       Verify that writing to a closed peer fails with errno set.
+ */
+TEST_F(TestOutputQueue, PeerClosed) {
+  OutputQueue queue;
+
+  ::close(fds_[1]);
+  fds_[1] = -1;
+
+  const uint8_t data[] = {1, 2, 3};
+  errno = 0;
+  EXPECT_EQ(-1, queue.send(fds_[0], data, sizeof(data)));
+  EXPECT_EQ(EPIPE, errno);
+  EXPECT_TRUE(queue.empty());
+}
+
+#endif  // _WIN32
@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "prepared_statements.h"
+#include "test/helpers.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using Translator = PreparedStatementTranslator;
+
+TEST(TestPreparedStatementTranslator, AssignsIds) {
+  Translator translator;
+
+  const uint32_t first = translator.add("SELECT ?", 1);
+  const uint32_t second = translator.add("SELECT ?", 1);
+  EXPECT_NE(Translator::kInvalidId, first);
+  EXPECT_NE(first, second);
+
+  ASSERT_NE(nullptr, translator.find(first));
+  EXPECT_EQ("SELECT ?", translator.find(first)->sql);
+  EXPECT_EQ(1u, translator.find(first)->params);
+  EXPECT_TRUE(translator.uses("SELECT ?"));
+  EXPECT_FALSE(translator.uses("SELECT 1"));
+
+  translator.erase(first);
+  EXPECT_EQ(nullptr, translator.find(first));
+  EXPECT_TRUE(translator.uses("SELECT ?"));
+  translator.erase(second);
+  EXPECT_FALSE(translator.uses("SELECT ?"));
+}
+
+TEST(TestPreparedStatementCache, EvictsLeastRecentlyUsed) {
+  PreparedStatementCache cache;
+  for (uint32_t id = 1; id <= 3; ++id) {
+    PreparedStatementCache::Statement statement;
+    statement.id = id;
+    cache.add("SELECT " + std::to_string(id), statement);
+  }
+  ASSERT_NE(nullptr, cache.find("SELECT 1"));
+
+  uint32_t id;
+  // SELECT 2 is the oldest, but used
+  ASSERT_TRUE(cache.evict([](const std::string &sql) { return sql == "SELECT 2"; }, id));
+  EXPECT_EQ(3u, id);
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_FALSE(cache.evict([](const std::string &) { return true; }, id));
+
+  ASSERT_TRUE(cache.erase("SELECT 1", id));
+  EXPECT_EQ(1u, id);
+  EXPECT_FALSE(cache.erase("SELECT 1", id));
+  EXPECT_EQ(nullptr, cache.find("SELECT 1"));
+}
+
+TEST(TestPreparedStatementTranslator, ParsePrepareOk) {
+  uint32_t id;
+  uint16_t params;
+  const RoutingProtocolBuffer ok{0x0c, 0x00, 0x00, 0x01, 0x00, 0x07, 0x01, 0x00, 0x00,
+                                 0x02, 0x00, 0x03, 0x01, 0x00, 0x00, 0x00};
+  ASSERT_TRUE(Translator::parse_prepare_ok(ok, id, params));
+  EXPECT_EQ(0x107u, id);
+  EXPECT_EQ(0x103u, params);
+
+  const RoutingProtocolBuffer error{0x05, 0x00, 0x00, 0x01, 0xff, 0x28, 0x04, '#', 'H'};
+  EXPECT_FALSE(Translator::parse_prepare_ok(error, id, params));
+  EXPECT_FALSE(Translator::parse_prepare_ok(RoutingProtocolBuffer(ok.begin(), ok.end() - 1), id, params));
+}
+
+TEST(TestPreparedStatementTranslator, MakePackets) {
+  EXPECT_EQ(RoutingProtocolBuffer({0x09, 0x00, 0x00, 0x00, 0x16, 'S', 'E', 'L', 'E', 'C', 'T', ' ', '?'}),
+            Translator::make_prepare("SELECT ?"));
+  EXPECT_EQ(RoutingProtocolBuffer({0x05, 0x00, 0x00, 0x00, 0x19, 0x04, 0x03, 0x02, 0x01}),
+            Translator::make_close(0x01020304));
+}
+
+TEST(TestPreparedStatementTranslator, AddParamTypes) {
+  // two parameters, the second NULL
+  const RoutingProtocolBuffer execute{0x10, 0x00, 0x00, 0x00, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+                                      0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x03, 'a', 'b', 'c'};
+  const std::vector<uint8_t> types{0xfe, 0x00, 0x06, 0x00};
+
+  RoutingProtocolBuffer result;
+  ASSERT_TRUE(Translator::add_param_types(execute.data(), execute.size(), 2, types, result));
+  EXPECT_EQ(RoutingProtocolBuffer({0x14, 0x00, 0x00, 0x00, 0x17, 0x01, 0x00, 0x00, 0x00, 0x00,
+                                   0x01, 0x00, 0x00, 0x00, 0x02, 0x01, 0xfe, 0x00, 0x06, 0x00,
+                                   0x03, 'a', 'b', 'c'}),
+            result);
+
+  // types sent already, wrong number of types, incomplete packet
+  EXPECT_FALSE(Translator::add_param_types(result.data(), result.size(), 2, types, result));
+  EXPECT_FALSE(Translator::add_param_types(execute.data(), execute.size(), 1, types, result));
+  EXPECT_FALSE(Translator::add_param_types(execute.data(), execute.size() - 1, 2, types, result));
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "priority_lane.h"
+
+#include <cstring>
+#include <stdexcept>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#else
+#include <ws2tcpip.h>
+#endif
+
+#include "gtest/gtest.h"
+
+static sockaddr_storage make_ipv4(const char *address) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  sockaddr_in *sin = reinterpret_cast<sockaddr_in *>(&ss);
+  sin->sin_family = AF_INET;
+  inet_pton(AF_INET, address, &sin->sin_addr);
+  return ss;
+}
+
+static sockaddr_storage make_ipv6(const char *address) {
+  sockaddr_storage ss;
+  memset(&ss, 0, sizeof(ss));
+  sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6 *>(&ss);
+  sin6->sin6_family = AF_INET6;
+  inet_pton(AF_INET6, address, &sin6->sin6_addr);
+  return ss;
+}
+
+/**
+ * @test
+ *       Verify that clients match hosts and networks of their family.
+ */
+TEST(TestPriorityLane, Matches) {
+  PriorityLane lane({"10.0.0.5", "192.168.0.0/22", "fd00::/8"}, 1);
+
+  EXPECT_TRUE(lane.matches(make_ipv4("10.0.0.5")));
+  EXPECT_FALSE(lane.matches(make_ipv4("10.0.0.6")));
+  EXPECT_TRUE(lane.matches(make_ipv4("192.168.3.255")));
+  EXPECT_FALSE(lane.matches(make_ipv4("192.168.4.0")));
+  EXPECT_TRUE(lane.matches(make_ipv6("fd12::1")));
+  EXPECT_FALSE(lane.matches(make_ipv6("fe80::1")));
+  // IPv4 clients of a dual-stack listener
+  EXPECT_TRUE(lane.matches(make_ipv6("::ffff:10.0.0.5")));
+  EXPECT_FALSE(lane.matches(make_ipv6("::10.0.0.5")));
+}
+
+/**
+ * @test
+ *       Verify that the lane has max_connections connections.
+ */
+TEST(TestPriorityLane, AcquireRelease) {
+  PriorityLane lane({"0.0.0.0/0"}, 2);
+
+  EXPECT_TRUE(lane.acquire());
+  EXPECT_TRUE(lane.acquire());
+  EXPECT_FALSE(lane.acquire());
+  EXPECT_EQ(2u, lane.get_used());
+
+  lane.release();
+  EXPECT_TRUE(lane.acquire());
+}
+
+/**
+ * @test
+ *       Verify that invalid networks are refused.
+ */
+TEST(TestPriorityLane, InvalidNetworks) {
+  EXPECT_THROW(PriorityLane({"10.0.0"}, 1), std::invalid_argument);
+  EXPECT_THROW(PriorityLane({"10.0.0.0/33"}, 1), std::invalid_argument);
+  EXPECT_THROW(PriorityLane({"10.0.0.0/"}, 1), std::invalid_argument);
+  EXPECT_THROW(PriorityLane({"fd00::/8x"}, 1), std::invalid_argument);
+  EXPECT_THROW(PriorityLane({"example.com"}, 1), std::invalid_argument);
+  EXPECT_THROW(PriorityLane({"10.0.0.1"}, 0), std::invalid_argument);
+  EXPECT_NO_THROW(PriorityLane({"::/0"}, 1));
+}
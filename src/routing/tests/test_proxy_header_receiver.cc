@@ -0,0 +1,154 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "proxy_header_receiver.h"
+#include "test/helpers.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using clock_type = ProxyHeaderReceiver::clock_type;
+
+static sockaddr_storage make_ipv4(const char *address, uint16_t port) {
+  sockaddr_storage addr{};
+  sockaddr_in *sin = reinterpret_cast<sockaddr_in*>(&addr);
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(port);
+  inet_pton(AF_INET, address, &sin->sin_addr);
+  return addr;
+}
+
+struct Received {
+  std::mutex mtx;
+  std::condition_variable cond;
+  std::vector<std::pair<int, sockaddr_storage>> sockets;
+
+  bool wait_for(size_t count, milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mtx);
+    return cond.wait_for(lock, timeout, [&] { return sockets.size() >= count; });
+  }
+};
+
+/**
+ * @test
+ *       Verify that a complete header is passed on with the address it
+ *       carries while a silent client waits, and the silent client gets
+ *       closed at its deadline.
+ */
+TEST(TestProxyHeaderReceiver, SilentClientDoesNotBlock) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  Received received;
+  ProxyHeaderReceiver receiver(so, milliseconds(500), [&](int sock, const sockaddr_storage &client_addr) {
+    std::lock_guard<std::mutex> lock(received.mtx);
+    received.sockets.emplace_back(sock, client_addr);
+    received.cond.notify_all();
+  });
+  receiver.start("test", mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  int silent[2];
+  int sending[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, silent));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sending));
+
+  const sockaddr_storage balancer = make_ipv4("10.0.0.9", 40000);
+  const auto start = clock_type::now();
+  ASSERT_TRUE(receiver.push(silent[0], balancer));
+  ASSERT_TRUE(receiver.push(sending[0], balancer));
+  EXPECT_EQ(2u, receiver.size());
+
+  const std::vector<uint8_t> header = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000),
+                                                                  make_ipv4("10.0.0.2", 6446));
+  // split, the receiver has to wait for the rest
+  ASSERT_EQ(7, write(sending[1], header.data(), 7));
+  ASSERT_EQ(static_cast<ssize_t>(header.size() - 7), write(sending[1], header.data() + 7, header.size() - 7));
+
+  ASSERT_TRUE(received.wait_for(1, milliseconds(5000)));
+  EXPECT_LT(clock_type::now() - start, milliseconds(400));
+  {
+    std::lock_guard<std::mutex> lock(received.mtx);
+    EXPECT_EQ(sending[0], received.sockets[0].first);
+    const sockaddr_in *client = reinterpret_cast<const sockaddr_in*>(&received.sockets[0].second);
+    EXPECT_EQ(51000, ntohs(client->sin_port));
+  }
+
+  // the receiver closes its end at the deadline
+  struct pollfd pfd = { silent[1], POLLIN, 0 };
+  ASSERT_EQ(1, poll(&pfd, 1, 5000));
+  char c;
+  EXPECT_EQ(0, read(silent[1], &c, 1));
+  EXPECT_GE(clock_type::now() - start, milliseconds(500));
+  EXPECT_EQ(0u, receiver.size());
+
+  receiver.stop();
+  EXPECT_EQ(1u, received.sockets.size());
+
+  close(silent[1]);
+  close(sending[0]);
+  close(sending[1]);
+}
+
+/**
+ * @test
+ *       Verify that pushes fail once kMaxPending sockets wait, and stop()
+ *       closes the waiting sockets.
+ */
+TEST(TestProxyHeaderReceiver, BoundedAndClosedOnStop) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  ProxyHeaderReceiver receiver(so, milliseconds(60000), [](int, const sockaddr_storage &) { FAIL(); });
+
+  // not started, the sockets stay pushed
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT_TRUE(receiver.push(fds[0], sockaddr_storage{}));
+  // closing -1 fails harmlessly
+  for (size_t i = 1; i < ProxyHeaderReceiver::kMaxPending; ++i) {
+    ASSERT_TRUE(receiver.push(-1, sockaddr_storage{}));
+  }
+  EXPECT_FALSE(receiver.push(-1, sockaddr_storage{}));
+  EXPECT_EQ(ProxyHeaderReceiver::kMaxPending, receiver.size());
+
+  receiver.stop();
+  EXPECT_EQ(0u, receiver.size());
+  char c;
+  EXPECT_EQ(0, read(fds[1], &c, 1));
+  close(fds[1]);
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
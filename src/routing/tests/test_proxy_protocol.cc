@@ -0,0 +1,208 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "protocol/proxy_protocol.h"
+#include "socket_operations.h"
+
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+static sockaddr_storage make_ipv4(const char *address, uint16_t port) {
+  sockaddr_storage addr;
+  memset(&addr, 0, sizeof(addr));
+  sockaddr_in *sin = reinterpret_cast<sockaddr_in*>(&addr);
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(port);
+  inet_pton(AF_INET, address, &sin->sin_addr);
+  return addr;
+}
+
+static sockaddr_storage make_ipv6(const char *address, uint16_t port) {
+  sockaddr_storage addr;
+  memset(&addr, 0, sizeof(addr));
+  sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6*>(&addr);
+  sin6->sin6_family = AF_INET6;
+  sin6->sin6_port = htons(port);
+  inet_pton(AF_INET6, address, &sin6->sin6_addr);
+  return addr;
+}
+
+static bool parse(const std::vector<uint8_t> &data, proxy_protocol::Header &header) {
+  if (data.size() < proxy_protocol::kPrefixSize) return false;
+  const long length = proxy_protocol::parse_prefix(data.data());
+  if (length < 0 || data.size() != proxy_protocol::kPrefixSize + static_cast<size_t>(length)) return false;
+  return proxy_protocol::parse_payload(data.data(), data.data() + proxy_protocol::kPrefixSize,
+                                       static_cast<size_t>(length), header);
+}
+
+/**
+ * @test
+ *       Verify that the addresses of IPv4 and IPv6 connections survive
+ *       encoding and parsing.
+ */
+TEST(TestProxyProtocol, RoundTrip) {
+  proxy_protocol::Header header;
+  std::vector<uint8_t> data = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000),
+                                                          make_ipv4("10.0.0.2", 6446));
+  EXPECT_EQ(28u, data.size());
+  ASSERT_TRUE(parse(data, header));
+  EXPECT_TRUE(header.proxied);
+  const sockaddr_in *source = reinterpret_cast<const sockaddr_in*>(&header.source);
+  const sockaddr_in *destination = reinterpret_cast<const sockaddr_in*>(&header.destination);
+  const sockaddr_storage expected_v4 = make_ipv4("10.0.0.1", 51000);
+  EXPECT_EQ(AF_INET, source->sin_family);
+  EXPECT_EQ(0, memcmp(&source->sin_addr, &reinterpret_cast<const sockaddr_in*>(&expected_v4)->sin_addr, 4));
+  EXPECT_EQ(51000, ntohs(source->sin_port));
+  EXPECT_EQ(6446, ntohs(destination->sin_port));
+
+  data = proxy_protocol::make_header(make_ipv6("2001:db8::1", 51000), make_ipv6("2001:db8::2", 6446));
+  EXPECT_EQ(52u, data.size());
+  ASSERT_TRUE(parse(data, header));
+  EXPECT_TRUE(header.proxied);
+  const sockaddr_storage expected = make_ipv6("2001:db8::1", 51000);
+  EXPECT_EQ(0, memcmp(&reinterpret_cast<const sockaddr_in6*>(&header.source)->sin6_addr,
+                      &reinterpret_cast<const sockaddr_in6*>(&expected)->sin6_addr, 16));
+  EXPECT_EQ(51000, ntohs(reinterpret_cast<const sockaddr_in6*>(&header.source)->sin6_port));
+}
+
+/**
+ * @test
+ *       Verify that mixed or unknown families result in LOCAL headers, and
+ *       TLVs following the addresses are skipped.
+ */
+TEST(TestProxyProtocol, LocalAndTLVs) {
+  proxy_protocol::Header header;
+  std::vector<uint8_t> data = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000),
+                                                          make_ipv6("::1", 6446));
+  EXPECT_EQ(16u, data.size());
+  ASSERT_TRUE(parse(data, header));
+  EXPECT_FALSE(header.proxied);
+
+  data = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000), make_ipv4("10.0.0.2", 6446));
+  // a PP2_TYPE_NOOP TLV of 3 bytes
+  const uint8_t tlv[] = { 0x04, 0x00, 0x03, 0x00, 0x00, 0x00 };
+  data.insert(data.end(), tlv, tlv + sizeof(tlv));
+  data[15] = static_cast<uint8_t>(data[15] + sizeof(tlv));
+  ASSERT_TRUE(parse(data, header));
+  EXPECT_TRUE(header.proxied);
+  EXPECT_EQ(51000, ntohs(reinterpret_cast<const sockaddr_in*>(&header.source)->sin_port));
+}
+
+/**
+ * @test
+ *       Verify that version 1 headers, unknown commands and truncated
+ *       addresses are refused.
+ */
+TEST(TestProxyProtocol, Invalid) {
+  const std::string v1("PROXY TCP4 10.0.0.1 10.0.0.2 51000 6446\r\n");
+  EXPECT_EQ(-1, proxy_protocol::parse_prefix(reinterpret_cast<const uint8_t*>(v1.data())));
+
+  std::vector<uint8_t> data = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000),
+                                                          make_ipv4("10.0.0.2", 6446));
+  data[12] = 0x22;
+  EXPECT_EQ(-1, proxy_protocol::parse_prefix(data.data()));
+  data[12] = 0x21;
+
+  // longer than accepted
+  data[14] = 0xff;
+  EXPECT_EQ(-1, proxy_protocol::parse_prefix(data.data()));
+  data[14] = 0;
+
+  proxy_protocol::Header header;
+  data[15] = 8;
+  data.resize(proxy_protocol::kPrefixSize + 8);
+  EXPECT_FALSE(parse(data, header));
+}
+
+/**
+ * @test
+ *       Verify that exactly the header is read from a socket as it
+ *       arrives, leaving the traffic following it.
+ */
+TEST(TestProxyProtocol, ReadHeader) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+
+  std::vector<uint8_t> data = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000),
+                                                          make_ipv4("10.0.0.2", 6446));
+  data.push_back('x');
+
+  proxy_protocol::HeaderReader reader;
+  proxy_protocol::Header header;
+  // nothing arrived yet
+  EXPECT_EQ(proxy_protocol::HeaderReader::Result::kNeedMore, reader.read(so, fds[0], header));
+
+  // part of the prefix, then the rest of it and part of the payload
+  ASSERT_EQ(5, write(fds[1], data.data(), 5));
+  EXPECT_EQ(proxy_protocol::HeaderReader::Result::kNeedMore, reader.read(so, fds[0], header));
+  ASSERT_EQ(15, write(fds[1], data.data() + 5, 15));
+  EXPECT_EQ(proxy_protocol::HeaderReader::Result::kNeedMore, reader.read(so, fds[0], header));
+
+  const ssize_t rest_size = static_cast<ssize_t>(data.size()) - 20;
+  ASSERT_EQ(rest_size, write(fds[1], data.data() + 20, data.size() - 20));
+  ASSERT_EQ(proxy_protocol::HeaderReader::Result::kDone, reader.read(so, fds[0], header));
+  EXPECT_TRUE(header.proxied);
+  EXPECT_EQ(51000, ntohs(reinterpret_cast<const sockaddr_in*>(&header.source)->sin_port));
+
+  char rest = 0;
+  EXPECT_EQ(1, read(fds[0], &rest, 1));
+  EXPECT_EQ('x', rest);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/**
+ * @test
+ *       Verify that a connection closed before its header is complete
+ *       fails with errno 0.
+ */
+TEST(TestProxyProtocol, ReadHeaderClosed) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+
+  const std::vector<uint8_t> data = proxy_protocol::make_header(make_ipv4("10.0.0.1", 51000),
+                                                                make_ipv4("10.0.0.2", 6446));
+  ASSERT_EQ(10, write(fds[1], data.data(), 10));
+  close(fds[1]);
+
+  proxy_protocol::HeaderReader reader;
+  proxy_protocol::Header header;
+  EXPECT_EQ(proxy_protocol::HeaderReader::Result::kNeedMore, reader.read(so, fds[0], header));
+  EXPECT_EQ(proxy_protocol::HeaderReader::Result::kFailed, reader.read(so, fds[0], header));
+  EXPECT_EQ(0, so->get_errno());
+
+  close(fds[0]);
+}
@@ -0,0 +1,200 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "query_digest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+std::string digest_of(const std::string &sql) {
+  std::string digest;
+  make_query_digest(reinterpret_cast<const uint8_t*>(sql.data()), sql.size(), digest);
+  return digest;
+}
+
+std::vector<uint8_t> make_packet(uint8_t sequence_id, const std::string &payload) {
+  const size_t size = payload.size();
+  std::vector<uint8_t> packet{static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                              static_cast<uint8_t>(size >> 16), sequence_id};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+std::vector<uint8_t> make_query(const std::string &sql) {
+  return make_packet(0, "\x03" + sql);
+}
+
+// result set of one column and the given number of rows
+std::vector<uint8_t> make_result_set(size_t rows) {
+  std::vector<uint8_t> result = make_packet(1, "\x01");
+  uint8_t seq = 2;
+  auto append = [&](const std::vector<uint8_t> &packet) {
+    result.insert(result.end(), packet.begin(), packet.end());
+  };
+
+  append(make_packet(seq++, std::string("\x03" "def\x00\x00\x00\x01" "a\x00\x0c\x3f\x00\x01\x00\x00\x00\x08\x81\x00\x00\x00\x00", 22)));
+  append(make_packet(seq++, std::string("\xfe\x00\x00\x02\x00", 5)));
+  for (size_t i = 0; i < rows; ++i) append(make_packet(seq++, "\x01" "1"));
+  append(make_packet(seq++, std::string("\xfe\x00\x00\x02\x00", 5)));
+
+  return result;
+}
+
+} // namespace
+
+TEST(TestQueryDigest, ReplacesLiterals) {
+  EXPECT_EQ("SELECT * FROM `t` WHERE `id` = ?", digest_of("select * from `t` where `id` = 42"));
+  EXPECT_EQ("SELECT * FROM T WHERE NAME = ?", digest_of("SELECT *  FROM t\n WHERE name='it''s'"));
+  EXPECT_EQ("SELECT ?", digest_of("SELECT \"a\""));
+  EXPECT_EQ("SELECT ?", digest_of("SELECT 1.5e3"));
+  EXPECT_EQ("SELECT ?", digest_of("SELECT x'cafe'"));
+  EXPECT_EQ(digest_of("SELECT * FROM t WHERE id = 12345"), digest_of("SELECT * FROM t WHERE id = 7"));
+}
+
+TEST(TestQueryDigest, FoldsLists) {
+  EXPECT_EQ(digest_of("SELECT * FROM t WHERE id IN (1)"),
+            digest_of("SELECT * FROM t WHERE id IN (1, 2, 3)"));
+  EXPECT_EQ(digest_of("INSERT INTO t VALUES (1, 'a')"),
+            digest_of("INSERT INTO t VALUES (2,'bb')"));
+}
+
+TEST(TestQueryDigest, DropsComments) {
+  EXPECT_EQ(digest_of("SELECT a FROM t"), digest_of("/* app */ SELECT a -- trailing\n FROM t # more"));
+}
+
+TEST(TestQueryDigest, Truncates) {
+  const std::string sql = "SELECT " + std::string(2 * QueryDigestStats::kMaxDigestLength, 'a');
+  EXPECT_EQ(QueryDigestStats::kMaxDigestLength, digest_of(sql).size());
+}
+
+TEST(TestQueryDigestStats, AddsSamples) {
+  QueryDigestStats stats(10);
+
+  stats.add("SELECT ?", 3, 1, 100);
+  stats.add("SELECT ?", 1000, 2, 200);
+  stats.add("DELETE FROM t", 0, 5, 11);
+
+  std::vector<QueryDigestStats::Digest> snapshot = stats.get_snapshot();
+  ASSERT_EQ(2u, snapshot.size());
+  const auto &select = snapshot[0].digest == "SELECT ?" ? snapshot[0] : snapshot[1];
+  const auto &del = snapshot[0].digest == "SELECT ?" ? snapshot[1] : snapshot[0];
+
+  EXPECT_EQ("SELECT ?", select.digest);
+  EXPECT_EQ(2u, select.count);
+  EXPECT_EQ(1003u, select.latency_sum_us);
+  EXPECT_EQ(1000u, select.latency_max_us);
+  EXPECT_EQ(3u, select.rows);
+  EXPECT_EQ(300u, select.bytes);
+  EXPECT_EQ(1u, select.latency_histogram[2]);  // 3us < 4us
+  EXPECT_EQ(1u, select.latency_histogram[10]); // 1000us < 1024us
+
+  EXPECT_EQ("DELETE FROM t", del.digest);
+  EXPECT_EQ(1u, del.count);
+  EXPECT_EQ(1u, del.latency_histogram[0]);
+
+  EXPECT_EQ(0u, stats.get_lost_samples());
+}
+
+TEST(TestQueryDigestStats, LargeLatencyInLastBucket) {
+  QueryDigestStats stats(1);
+
+  stats.add("SELECT ?", uint64_t(1) << 40, 0, 0);
+
+  std::vector<QueryDigestStats::Digest> snapshot = stats.get_snapshot();
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ(1u, snapshot[0].latency_histogram[QueryDigestStats::kLatencyBuckets - 1]);
+}
+
+TEST(TestQueryDigestStats, CountsLostSamples) {
+  QueryDigestStats stats(2);
+
+  stats.add("SELECT 1", 1, 0, 0);
+  stats.add("SELECT 2", 1, 0, 0);
+  stats.add("SELECT 3", 1, 0, 0);
+  stats.add("SELECT 1", 1, 0, 0);
+
+  EXPECT_EQ(2u, stats.get_snapshot().size());
+  EXPECT_EQ(1u, stats.get_lost_samples());
+}
+
+TEST(TestQueryDigestSampler, SamplesResultSet) {
+  auto stats = std::make_shared<QueryDigestStats>(10);
+  QueryDigestSampler sampler(stats, 1, false);
+
+  const std::vector<uint8_t> query = make_query("SELECT a FROM t WHERE id > 10");
+  const std::vector<uint8_t> response = make_result_set(3);
+
+  sampler.client_data(query.data(), query.size());
+  EXPECT_TRUE(sampler.is_sampling());
+  // response arrives in two parts
+  sampler.server_data(response.data(), 7);
+  EXPECT_TRUE(sampler.is_sampling());
+  sampler.server_data(response.data() + 7, response.size() - 7);
+  EXPECT_FALSE(sampler.is_sampling());
+
+  std::vector<QueryDigestStats::Digest> snapshot = stats->get_snapshot();
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ("SELECT A FROM T WHERE ID > ?", snapshot[0].digest);
+  EXPECT_EQ(1u, snapshot[0].count);
+  EXPECT_EQ(3u, snapshot[0].rows);
+  EXPECT_EQ(response.size(), snapshot[0].bytes);
+}
+
+TEST(TestQueryDigestSampler, SkipsPipelinedCommands) {
+  auto stats = std::make_shared<QueryDigestStats>(10);
+  QueryDigestSampler sampler(stats, 1, false);
+
+  std::vector<uint8_t> queries = make_query("SELECT 1");
+  const std::vector<uint8_t> second = make_query("SELECT 2");
+  queries.insert(queries.end(), second.begin(), second.end());
+  const std::vector<uint8_t> response = make_result_set(1);
+
+  sampler.client_data(queries.data(), queries.size());
+  EXPECT_FALSE(sampler.is_sampling());
+  sampler.server_data(response.data(), response.size());
+  sampler.server_data(response.data(), response.size());
+
+  EXPECT_TRUE(stats->get_snapshot().empty());
+}
+
+TEST(TestQueryDigestSampler, SamplesEveryIntervalthStatement) {
+  auto stats = std::make_shared<QueryDigestStats>(10);
+  QueryDigestSampler sampler(stats, 4, false);
+
+  const std::vector<uint8_t> query = make_query("SELECT 1");
+  const std::vector<uint8_t> response = make_result_set(1);
+  for (int i = 0; i < 12; ++i) {
+    sampler.client_data(query.data(), query.size());
+    sampler.server_data(response.data(), response.size());
+  }
+
+  std::vector<QueryDigestStats::Digest> snapshot = stats->get_snapshot();
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ(3u, snapshot[0].count);
+}
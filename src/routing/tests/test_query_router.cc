@@ -0,0 +1,86 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "dest_first_available.h"
+#include "query_router.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+
+class QueryRouterTest : public ::testing::Test {
+protected:
+  std::shared_ptr<RouteDestination> make_pool() {
+    return std::make_shared<DestFirstAvailable>(Protocol::get_default(), &mock_routing_sock_ops_);
+  }
+
+  RouteDestination* get_pool(const QueryRouter& router, const std::string& sql) {
+    return router.get_pool(reinterpret_cast<const uint8_t*>(sql.data()), sql.size());
+  }
+
+  MockRoutingSockOps mock_routing_sock_ops_;
+};
+
+TEST_F(QueryRouterTest, RouteByComment) {
+  QueryRouter router;
+  std::shared_ptr<RouteDestination> analytics = make_pool();
+  router.add_pool("analytics", analytics);
+
+  EXPECT_EQ(analytics.get(), get_pool(router, "/* route=analytics */ SELECT 1"));
+  EXPECT_EQ(analytics.get(), get_pool(router, "  /*ROUTE = analytics*/SELECT 1"));
+  EXPECT_EQ(analytics.get(), get_pool(router, "/*+ route(analytics) */ SELECT 1"));
+  EXPECT_EQ(analytics.get(), get_pool(router, "\n/*+route( analytics )*/ SELECT 1"));
+
+  // the others stay with the servers of the route
+  EXPECT_EQ(nullptr, get_pool(router, "SELECT /* route=analytics */ 1"));
+  EXPECT_EQ(nullptr, get_pool(router, "/* route=reports */ SELECT 1"));
+  EXPECT_EQ(nullptr, get_pool(router, "/* route=analytics2 */ SELECT 1"));
+  EXPECT_EQ(nullptr, get_pool(router, "/* route=analytics, hot */ SELECT 1"));
+  EXPECT_EQ(nullptr, get_pool(router, "/*+ route=analytics */ SELECT 1"));
+  EXPECT_EQ(nullptr, get_pool(router, "/* route(analytics) */ SELECT 1"));
+  EXPECT_EQ(nullptr, get_pool(router, "/* route=analytics"));
+  EXPECT_EQ(nullptr, get_pool(router, "/*"));
+  EXPECT_EQ(nullptr, get_pool(router, ""));
+}
+
+TEST_F(QueryRouterTest, ReadPoolName) {
+  const std::string sql = "/* route=a_b-1 */ SELECT 1";
+  std::string name;
+  EXPECT_TRUE(QueryRouter::read_pool_name(reinterpret_cast<const uint8_t*>(sql.data()),
+                                          sql.size(), name));
+  EXPECT_EQ("a_b-1", name);
+}
+
+TEST_F(QueryRouterTest, InvalidSettings) {
+  QueryRouter router;
+  router.add_pool("a", make_pool());
+  EXPECT_THROW(router.add_pool("a", make_pool()), std::invalid_argument);
+  EXPECT_THROW(router.add_pool("", make_pool()), std::invalid_argument);
+  EXPECT_THROW(router.add_pool("a b", make_pool()), std::invalid_argument);
+  EXPECT_THROW(router.add_pool("a*/", make_pool()), std::invalid_argument);
+}
@@ -0,0 +1,617 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "read_write_splitter.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dest_first_available.h"
+#include "keyring/keyring_manager.h"
+#include "mysqlrouter/sha1.h"
+#include "query_router.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+
+using Target = ReadWriteSplitter::Target;
+
+namespace {
+
+std::vector<uint8_t> make_packet(uint8_t sequence_id, const std::string &payload) {
+  const size_t size = payload.size();
+  std::vector<uint8_t> packet{static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                              static_cast<uint8_t>(size >> 16), sequence_id};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+std::vector<uint8_t> make_query(const std::string &sql) {
+  return make_packet(0, "\x03" + sql);
+}
+
+// OK packet with the given status flags
+std::vector<uint8_t> make_ok(uint8_t sequence_id, uint16_t status) {
+  return make_packet(sequence_id, std::string("\x00\x00\x00", 3) +
+                                  static_cast<char>(status & 0xff) + static_cast<char>(status >> 8) +
+                                  std::string("\x00\x00", 2));
+}
+
+// OK packet with the given status flags and session state changes
+std::vector<uint8_t> make_ok_with_state(uint8_t sequence_id, uint16_t status, const std::string &state) {
+  status |= ClassicResponseTracker::kStatusSessionStateChanged;
+  return make_packet(sequence_id, std::string("\x00\x00\x00", 3) +
+                                  static_cast<char>(status & 0xff) + static_cast<char>(status >> 8) +
+                                  std::string("\x00\x00\x00", 3) +
+                                  static_cast<char>(state.size()) + state);
+}
+
+// session state change reporting the GTIDs of a commit
+std::string make_gtids_state(const std::string &gtids) {
+  return std::string("\x03", 1) + static_cast<char>(gtids.size() + 2) + std::string("\x00", 1) +
+         static_cast<char>(gtids.size()) + gtids;
+}
+
+// session state change reporting a system variable, or the default schema if name is empty
+std::string make_session_state(const std::string &name, const std::string &value) {
+  const std::string data = name.empty()
+      ? static_cast<char>(value.size()) + value
+      : static_cast<char>(name.size()) + name + static_cast<char>(value.size()) + value;
+  return std::string(name.empty() ? "\x01" : "\x00", 1) + static_cast<char>(data.size()) + data;
+}
+
+// EOF packet with the given status flags
+std::vector<uint8_t> make_eof(uint8_t sequence_id, uint16_t status) {
+  return make_packet(sequence_id, std::string("\xfe\x00\x00", 3) +
+                                  static_cast<char>(status & 0xff) + static_cast<char>(status >> 8));
+}
+
+// result set of one column and one row
+std::vector<uint8_t> make_result_set(uint16_t status, bool deprecate_eof = false) {
+  std::vector<uint8_t> result = make_packet(1, "\x01");
+  uint8_t seq = 2;
+  auto append = [&](const std::vector<uint8_t> &packet) {
+    result.insert(result.end(), packet.begin(), packet.end());
+  };
+
+  append(make_packet(seq++, std::string("\x03" "def\x00\x00\x00\x01" "a\x00\x0c\x3f\x00\x01\x00\x00\x00\x08\x81\x00\x00\x00\x00", 22)));
+  if (!deprecate_eof) append(make_eof(seq++, 0));
+  append(make_packet(seq++, "\x01" "1"));
+  if (deprecate_eof) {
+    std::vector<uint8_t> ok = make_ok(seq++, status);
+    ok[4] = 0xfe;
+    append(ok);
+  } else {
+    append(make_eof(seq++, status));
+  }
+  return result;
+}
+
+const uint32_t kClientCapabilities = (mysql_protocol::Capabilities::PROTOCOL_41 |
+                                      mysql_protocol::Capabilities::SECURE_CONNECTION |
+                                      mysql_protocol::Capabilities::PLUGIN_AUTH).bits();
+
+// handshake response of user "u" without default schema
+std::vector<uint8_t> make_handshake_response(uint32_t extra_capabilities = 0) {
+  const uint32_t caps = kClientCapabilities | extra_capabilities;
+  std::string payload{static_cast<char>(caps), static_cast<char>(caps >> 8),
+                      static_cast<char>(caps >> 16), static_cast<char>(caps >> 24),
+                      0x00, 0x00, 0x00, 0x01, 0x21};
+  payload.append(23, '\0');
+  payload.append("u", 2);
+  payload.push_back(20);
+  payload.append(20, 'a');
+  payload.append("mysql_native_password", 22);
+  return make_packet(1, payload);
+}
+
+const uint16_t kAutocommit = ClassicResponseTracker::kStatusAutocommit;
+const uint16_t kInTrans = ClassicResponseTracker::kStatusInTrans;
+
+} // namespace
+
+TEST(TestReadWriteSplitter, ReadOnlyQueries) {
+  auto is_read_only = [](const std::string &sql) {
+    return ReadWriteSplitter::is_read_only_query(reinterpret_cast<const uint8_t*>(sql.data()), sql.size());
+  };
+
+  EXPECT_TRUE(is_read_only("SELECT 1"));
+  EXPECT_TRUE(is_read_only("  select *\nfrom t where id = 1;"));
+  EXPECT_TRUE(is_read_only("/* app */ (SELECT a FROM t)"));
+
+  EXPECT_FALSE(is_read_only("INSERT INTO t VALUES (1)"));
+  EXPECT_FALSE(is_read_only("SELECT * FROM t FOR UPDATE"));
+  EXPECT_FALSE(is_read_only("SELECT * FROM t\nLOCK IN SHARE MODE"));
+  EXPECT_FALSE(is_read_only("SELECT a INTO @a FROM t"));
+  EXPECT_FALSE(is_read_only("SELECT @@session.sql_mode"));
+  EXPECT_FALSE(is_read_only("SELECT LAST_INSERT_ID()"));
+  EXPECT_FALSE(is_read_only("SELECT 1; DELETE FROM t"));
+  EXPECT_FALSE(is_read_only("/*!50000 SELECT 1 */"));
+}
+
+TEST(TestReadWriteSplitter, SessionChanges) {
+  auto changes_session = [](const std::string &sql) {
+    return ReadWriteSplitter::changes_session(reinterpret_cast<const uint8_t*>(sql.data()), sql.size());
+  };
+
+  EXPECT_TRUE(changes_session("SET NAMES utf8mb4"));
+  EXPECT_TRUE(changes_session("use test"));
+  EXPECT_TRUE(changes_session("CREATE TEMPORARY TABLE t (a INT)"));
+  EXPECT_TRUE(changes_session("INSERT INTO t VALUES (@a)"));
+  EXPECT_TRUE(changes_session("LOCK TABLES t READ"));
+
+  EXPECT_FALSE(changes_session("INSERT INTO t VALUES (1)"));
+  EXPECT_FALSE(changes_session("BEGIN"));
+  EXPECT_FALSE(changes_session("COMMIT"));
+}
+
+TEST(TestClassicResponseTracker, ResultSet) {
+  for (bool deprecate_eof: {false, true}) {
+    ClassicResponseTracker tracker(deprecate_eof);
+    ASSERT_TRUE(tracker.command_sent(0x03));
+    EXPECT_FALSE(tracker.is_idle());
+
+    const std::vector<uint8_t> response = make_result_set(kAutocommit | kInTrans, deprecate_eof);
+    // byte by byte, the end is only known with the last byte
+    for (size_t i = 0; i < response.size(); ++i) {
+      EXPECT_FALSE(tracker.is_idle()) << i;
+      tracker.feed(&response[i], 1);
+    }
+    EXPECT_TRUE(tracker.is_idle());
+    EXPECT_TRUE(tracker.has_status());
+    EXPECT_TRUE(tracker.in_transaction());
+  }
+}
+
+TEST(TestClassicResponseTracker, OkAndError) {
+  ClassicResponseTracker tracker;
+  EXPECT_TRUE(tracker.in_transaction());  // nothing known yet
+
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  std::vector<uint8_t> ok = make_ok(1, kAutocommit);
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_FALSE(tracker.in_transaction());
+
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  std::vector<uint8_t> error = make_packet(1, "\xff\x15\x04#28000denied");
+  tracker.feed(error.data(), error.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_FALSE(tracker.in_transaction());
+
+  // more results follow the first OK
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  ok = make_ok(1, kAutocommit | ClassicResponseTracker::kStatusMoreResultsExist);
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_FALSE(tracker.is_idle());
+  ok = make_ok(2, kAutocommit);
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+
+  // prepared statements are not followed
+  EXPECT_FALSE(tracker.command_sent(0x16));
+  EXPECT_TRUE(tracker.is_lost());
+}
+
+TEST(TestClassicResponseTracker, CollectsGtids) {
+  const std::string kUuid = "3e11fa47-71ca-11e1-9e33-c80aa9429562";
+  ClassicResponseTracker tracker;
+  tracker.track_gtids();
+
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  std::vector<uint8_t> ok = make_ok_with_state(1, kAutocommit, make_gtids_state(kUuid + ":23"));
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_FALSE(tracker.in_transaction());
+  EXPECT_FALSE(tracker.session_state_changed());
+  EXPECT_EQ(kUuid + ":23", tracker.get_gtids());
+
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  ok = make_ok_with_state(1, kAutocommit, make_gtids_state(kUuid + ":24"));
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_EQ(kUuid + ":23," + kUuid + ":24", tracker.get_gtids());
+  tracker.clear_gtids();
+  EXPECT_EQ("", tracker.get_gtids());
+
+  // a new default schema is state of the session
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  ok = make_ok_with_state(1, kAutocommit, std::string("\x01\x05\x04test", 7));
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_TRUE(tracker.session_state_changed());
+  EXPECT_EQ("", tracker.get_gtids());
+}
+
+TEST(TestClassicResponseTracker, KeepsSessionState) {
+  ClassicResponseTracker tracker;
+  tracker.track_session_state();
+
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  std::vector<uint8_t> ok = make_ok_with_state(1, kAutocommit, make_session_state("", "test") +
+                                                               make_session_state("sql_mode", "ANSI"));
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_TRUE(tracker.session_state_changed());
+  EXPECT_TRUE(tracker.session_state_reported());
+  EXPECT_FALSE(tracker.session_state_unknown());
+  EXPECT_EQ("test", tracker.get_schema());
+  ASSERT_EQ(1u, tracker.get_system_variables().size());
+  EXPECT_EQ("ANSI", tracker.get_system_variables().at("sql_mode"));
+
+  // COM_INIT_DB is answered with OK
+  ASSERT_TRUE(tracker.command_sent(0x02));
+  EXPECT_FALSE(tracker.session_state_reported());
+  ok = make_ok(1, kAutocommit);
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_FALSE(tracker.session_state_reported());
+
+  // a session state that can't be read
+  ASSERT_TRUE(tracker.command_sent(0x03));
+  ok = make_ok_with_state(1, kAutocommit, std::string("\x00\x05\x08", 3));
+  tracker.feed(ok.data(), ok.size());
+  EXPECT_TRUE(tracker.is_idle());
+  EXPECT_TRUE(tracker.session_state_unknown());
+}
+
+TEST(TestReadWriteSplitter, RoutesReadsOutsideOfTransactions) {
+  ReadWriteSplitter splitter;
+  auto route = [&](const std::string &sql) {
+    const std::vector<uint8_t> query = make_query(sql);
+    return splitter.route(query.data(), query.size());
+  };
+  auto primary_answers = [&](uint16_t status) {
+    const std::vector<uint8_t> ok = make_ok(1, status);
+    splitter.primary_data(ok.data(), ok.size());
+  };
+
+  // transaction state not known yet
+  EXPECT_EQ(Target::kPrimary, route("SELECT 1"));
+  const std::vector<uint8_t> result = make_result_set(kAutocommit);
+  splitter.primary_data(result.data(), result.size());
+
+  EXPECT_EQ(Target::kSecondary, route("SELECT 1"));
+  EXPECT_FALSE(splitter.is_secondary_idle());
+  splitter.secondary_data(result.data(), result.size());
+  EXPECT_TRUE(splitter.is_secondary_idle());
+
+  EXPECT_EQ(Target::kPrimary, route("BEGIN"));
+  primary_answers(kAutocommit | kInTrans);
+  EXPECT_EQ(Target::kPrimary, route("SELECT 1"));
+  splitter.primary_data(result.data(), result.size());
+  EXPECT_EQ(Target::kPrimary, route("COMMIT"));
+  primary_answers(kAutocommit);
+
+  EXPECT_EQ(Target::kSecondary, route("SELECT 2"));
+  splitter.secondary_unavailable();
+  primary_answers(kAutocommit);
+  EXPECT_EQ(Target::kPrimary, route("SELECT 3"));
+  EXPECT_FALSE(splitter.is_pinned());
+}
+
+TEST(TestReadWriteSplitter, PinsSessionState) {
+  ReadWriteSplitter splitter;
+  const std::vector<uint8_t> set = make_query("SET @a = 1");
+  EXPECT_EQ(Target::kPrimary, splitter.route(set.data(), set.size()));
+  EXPECT_TRUE(splitter.is_pinned());
+
+  const std::vector<uint8_t> ok = make_ok(1, kAutocommit);
+  splitter.primary_data(ok.data(), ok.size());
+  const std::vector<uint8_t> select = make_query("SELECT 1");
+  EXPECT_EQ(Target::kPrimary, splitter.route(select.data(), select.size()));
+}
+
+TEST(TestReadWriteSplitter, TellsTransactionBoundaries) {
+  ReadWriteSplitter splitter(false);
+  auto query = [&](const std::string &sql, const std::vector<uint8_t> &response) {
+    const std::vector<uint8_t> packet = make_query(sql);
+    splitter.route(packet.data(), packet.size());
+    EXPECT_FALSE(splitter.is_between_transactions());
+    splitter.primary_data(response.data(), response.size());
+  };
+
+  // the transaction state is not known before the first response
+  EXPECT_FALSE(splitter.is_between_transactions());
+
+  query("SET @a = 1", make_ok(1, kAutocommit));
+  EXPECT_TRUE(splitter.is_between_transactions());
+
+  query("BEGIN", make_ok(1, kAutocommit | kInTrans));
+  EXPECT_FALSE(splitter.is_between_transactions());
+  query("COMMIT", make_ok(1, kAutocommit));
+  EXPECT_TRUE(splitter.is_between_transactions());
+
+  query("SET autocommit = 0", make_ok(1, 0));
+  EXPECT_FALSE(splitter.is_between_transactions());
+}
+
+TEST(TestReadWriteSplitter, ReleasesCleanSessions) {
+  mysql_harness::init_keyring_with_key("test_read_write_splitter.keyring", "secret", true);
+  mysql_harness::get_keyring()->store("u", "password", "secret");
+
+  ReadWriteSplitter splitter(false);
+  auto query = [&](const std::string &sql, const std::vector<uint8_t> &response) {
+    const std::vector<uint8_t> packet = make_query(sql);
+    EXPECT_EQ(Target::kPrimary, splitter.route(packet.data(), packet.size()));
+    EXPECT_FALSE(splitter.can_release_primary());
+    splitter.primary_data(response.data(), response.size());
+  };
+
+  // no credentials for new server connections
+  query("SELECT 1", make_result_set(kAutocommit));
+  EXPECT_FALSE(splitter.can_release_primary());
+  EXPECT_EQ("", splitter.get_session_key());
+
+  ASSERT_TRUE(splitter.set_client_handshake(make_handshake_response()));
+  EXPECT_EQ(std::string("u\0\0" "33\0", 6) + std::to_string(kClientCapabilities), splitter.get_session_key());
+
+  // reads don't go to a secondary, but leave a clean session
+  query("SELECT 1", make_result_set(kAutocommit));
+  EXPECT_TRUE(splitter.can_release_primary());
+
+  // LAST_INSERT_ID() is still asked for after writes
+  query("INSERT INTO t VALUES (1)", make_ok(1, kAutocommit));
+  EXPECT_FALSE(splitter.can_release_primary());
+  query("SELECT 1", make_result_set(kAutocommit));
+  EXPECT_TRUE(splitter.can_release_primary());
+
+  query("BEGIN", make_ok(1, kAutocommit | kInTrans));
+  query("SELECT 1", make_result_set(kAutocommit | kInTrans));
+  EXPECT_FALSE(splitter.can_release_primary());
+  query("COMMIT", make_ok(1, kAutocommit));
+  query("SELECT 1", make_result_set(kAutocommit));
+  EXPECT_TRUE(splitter.can_release_primary());
+
+  query("SET @a = 1", make_ok(1, kAutocommit));
+  query("SELECT 1", make_result_set(kAutocommit));
+  EXPECT_FALSE(splitter.can_release_primary());
+
+  mysql_harness::reset_keyring();
+  std::remove("test_read_write_splitter.keyring");
+}
+
+TEST(TestReadWriteSplitter, ReadYourWrites) {
+  mysql_harness::init_keyring_with_key("test_read_write_splitter.keyring", "secret", true);
+  mysql_harness::get_keyring()->store("u", "password", "secret");
+
+  {
+    ReadWriteSplitter splitter;
+    splitter.set_read_your_writes();
+    ASSERT_TRUE(splitter.set_client_handshake(
+        make_handshake_response(mysql_protocol::Capabilities::SESSION_TRACK.bits())));
+    auto route = [&](const std::string &sql) {
+      const std::vector<uint8_t> query = make_query(sql);
+      return splitter.route(query.data(), query.size());
+    };
+    const std::vector<uint8_t> result = make_result_set(kAutocommit);
+
+    EXPECT_EQ(Target::kPrimary, route("SELECT 1"));
+    splitter.primary_data(result.data(), result.size());
+    EXPECT_EQ(Target::kSecondary, route("SELECT 1"));
+    splitter.secondary_data(result.data(), result.size());
+    EXPECT_FALSE(splitter.has_written());
+
+    EXPECT_EQ(Target::kPrimary, route("INSERT INTO t VALUES (1)"));
+    const std::vector<uint8_t> ok = make_ok_with_state(1, kAutocommit, make_gtids_state("uuid:5"));
+    splitter.primary_data(ok.data(), ok.size());
+    EXPECT_TRUE(splitter.has_written());
+    EXPECT_FALSE(splitter.is_pinned());
+    EXPECT_EQ("uuid:5", splitter.get_unapplied_gtids());
+
+    // the secondary didn't apply the insert yet
+    EXPECT_EQ(Target::kSecondary, route("SELECT 2"));
+    splitter.secondary_behind();
+    splitter.primary_data(result.data(), result.size());
+    EXPECT_TRUE(splitter.is_primary_idle());
+
+    EXPECT_EQ(Target::kSecondary, route("SELECT 3"));
+    splitter.gtids_applied();
+    splitter.secondary_data(result.data(), result.size());
+    EXPECT_EQ("", splitter.get_unapplied_gtids());
+    EXPECT_FALSE(splitter.is_pinned());
+  }
+
+  {
+    // without session tracking the writes can't be followed
+    ReadWriteSplitter splitter;
+    splitter.set_read_your_writes();
+    ASSERT_TRUE(splitter.set_client_handshake(make_handshake_response()));
+    const std::vector<uint8_t> insert = make_query("INSERT INTO t VALUES (1)");
+    EXPECT_EQ(Target::kPrimary, splitter.route(insert.data(), insert.size()));
+    const std::vector<uint8_t> ok = make_ok(1, kAutocommit);
+    splitter.primary_data(ok.data(), ok.size());
+    const std::vector<uint8_t> select = make_query("SELECT 1");
+    EXPECT_EQ(Target::kPrimary, splitter.route(select.data(), select.size()));
+  }
+
+  mysql_harness::reset_keyring();
+  std::remove("test_read_write_splitter.keyring");
+}
+
+TEST(TestReadWriteSplitter, ReplaysSessionState) {
+  mysql_harness::init_keyring_with_key("test_read_write_splitter.keyring", "secret", true);
+  mysql_harness::get_keyring()->store("u", "password", "secret");
+
+  ReadWriteSplitter splitter(false);
+  splitter.set_replays_session();
+  ASSERT_TRUE(splitter.set_client_handshake(
+      make_handshake_response(mysql_protocol::Capabilities::SESSION_TRACK.bits())));
+  auto query = [&](const std::string &sql, const std::vector<uint8_t> &response) {
+    const std::vector<uint8_t> packet = make_query(sql);
+    splitter.route(packet.data(), packet.size());
+    EXPECT_FALSE(splitter.is_idle());
+    splitter.primary_data(response.data(), response.size());
+    EXPECT_TRUE(splitter.is_idle());
+  };
+  std::vector<std::string> statements;
+
+  // nothing to replay before the first command
+  EXPECT_TRUE(splitter.can_replay_session());
+  EXPECT_FALSE(splitter.is_in_transaction());
+  ASSERT_TRUE(splitter.get_replay_statements(statements));
+  EXPECT_TRUE(statements.empty());
+
+  query("USE te`st", make_ok_with_state(1, kAutocommit, make_session_state("", "te`st")));
+  query("SET sql_mode = 'ANSI', @@SESSION.wait_timeout = 60",
+        make_ok_with_state(1, kAutocommit, make_session_state("sql_mode", "ANSI") +
+                                           make_session_state("wait_timeout", "60")));
+  query("SET time_zone = 'O''Brien'",
+        make_ok_with_state(1, kAutocommit, make_session_state("time_zone", "O'Brien")));
+  EXPECT_TRUE(splitter.is_pinned());
+  EXPECT_TRUE(splitter.can_replay_session());
+  ASSERT_TRUE(splitter.get_replay_statements(statements));
+  EXPECT_EQ((std::vector<std::string>{"USE `te``st`",
+                                      "SET @@SESSION.sql_mode = 'ANSI'",
+                                      "SET @@SESSION.time_zone = 'O''Brien'",
+                                      "SET @@SESSION.wait_timeout = 60"}),
+            statements);
+
+  // the transaction state is still followed
+  query("BEGIN", make_ok(1, kAutocommit | kInTrans));
+  EXPECT_TRUE(splitter.is_in_transaction());
+  query("COMMIT", make_ok(1, kAutocommit));
+  EXPECT_FALSE(splitter.is_in_transaction());
+  EXPECT_TRUE(splitter.can_replay_session());
+
+  // the primary didn't report what changed
+  query("SET NAMES utf8mb4", make_ok(1, kAutocommit));
+  EXPECT_FALSE(splitter.can_replay_session());
+
+  {
+    ReadWriteSplitter user_variables(false);
+    user_variables.set_replays_session();
+    ASSERT_TRUE(user_variables.set_client_handshake(
+        make_handshake_response(mysql_protocol::Capabilities::SESSION_TRACK.bits())));
+    const std::vector<uint8_t> set = make_query("SET @a = 1");
+    user_variables.route(set.data(), set.size());
+    EXPECT_FALSE(user_variables.can_replay_session());
+  }
+
+  mysql_harness::reset_keyring();
+  std::remove("test_read_write_splitter.keyring");
+}
+
+TEST(TestReadWriteSplitter, RoutesByComment) {
+  mysql_harness::init_keyring_with_key("test_read_write_splitter.keyring", "secret", true);
+  mysql_harness::get_keyring()->store("u", "password", "secret");
+
+  MockRoutingSockOps routing_sock_ops;
+  std::shared_ptr<RouteDestination> analytics =
+      std::make_shared<DestFirstAvailable>(Protocol::get_default(), &routing_sock_ops);
+  QueryRouter router;
+  router.add_pool("analytics", analytics);
+
+  // reads are not split otherwise
+  ReadWriteSplitter splitter(false);
+  splitter.set_query_router(&router);
+  ASSERT_TRUE(splitter.set_client_handshake(make_handshake_response()));
+  auto route = [&](const std::string &sql) {
+    const std::vector<uint8_t> query = make_query(sql);
+    return splitter.route(query.data(), query.size());
+  };
+  const std::vector<uint8_t> result = make_result_set(kAutocommit);
+
+  // the transaction state is not known yet
+  EXPECT_EQ(Target::kPrimary, route("/* route=analytics */ SELECT 1"));
+  splitter.primary_data(result.data(), result.size());
+
+  EXPECT_EQ(Target::kPool, route("/* route=analytics */ SELECT 1"));
+  EXPECT_EQ(analytics.get(), splitter.get_pool());
+  splitter.secondary_data(result.data(), result.size());
+  EXPECT_TRUE(splitter.is_idle());
+
+  EXPECT_EQ(Target::kPrimary, route("SELECT 1"));
+  splitter.primary_data(result.data(), result.size());
+  EXPECT_EQ(Target::kPrimary, route("/* route=analytics */ DELETE FROM t"));
+  const std::vector<uint8_t> ok = make_ok(1, kAutocommit);
+  splitter.primary_data(ok.data(), ok.size());
+
+  // the pool failed, the primary answers
+  EXPECT_EQ(Target::kPool, route("/*+ route(analytics) */ SELECT 2"));
+  splitter.pool_unavailable();
+  EXPECT_FALSE(splitter.is_primary_idle());
+  splitter.primary_data(result.data(), result.size());
+  EXPECT_TRUE(splitter.is_idle());
+
+  // inside a transaction
+  EXPECT_EQ(Target::kPrimary, route("BEGIN"));
+  const std::vector<uint8_t> begin = make_ok(1, kAutocommit | kInTrans);
+  splitter.primary_data(begin.data(), begin.size());
+  EXPECT_EQ(Target::kPrimary, route("/* route=analytics */ SELECT 3"));
+
+  mysql_harness::reset_keyring();
+  std::remove("test_read_write_splitter.keyring");
+}
+
+TEST(TestReadWriteSplitter, ParsesHandshakeResponses) {
+  namespace Capabilities = mysql_protocol::Capabilities;
+
+  // the specialized capability sets and one parsed by the generic parser
+  for (const Capabilities::Flags extra : {Capabilities::ALL_ZEROS, Capabilities::CONNECT_WITH_DB,
+                                          Capabilities::PLUGIN_AUTH_LENENC_CLIENT_DATA |
+                                          Capabilities::CONNECT_ATTRS | Capabilities::CONNECT_WITH_DB,
+                                          Capabilities::CONNECT_ATTRS}) {
+    const uint32_t caps = kClientCapabilities | extra.bits();
+    std::string payload{static_cast<char>(caps), static_cast<char>(caps >> 8),
+                        static_cast<char>(caps >> 16), static_cast<char>(caps >> 24),
+                        0x00, 0x00, 0x00, 0x01, 0x21};
+    payload.append(23, '\0');
+    payload.append("u", 2);
+    payload.push_back(20);  // fits both a lenenc and a 1-byte length
+    payload.append(20, 'a');
+    if (extra.bits() & Capabilities::CONNECT_WITH_DB.bits()) payload.append("db", 3);
+    payload.append("mysql_native_password", 22);
+    if (extra.bits() & Capabilities::CONNECT_ATTRS.bits()) payload.append("\x03" "\x01k" "v", 4);
+
+    classic_handshake::ClientHandshake handshake;
+    ASSERT_TRUE(classic_handshake::parse_handshake_response(make_packet(1, payload), handshake));
+    EXPECT_EQ("u", handshake.username);
+    EXPECT_EQ(38u, handshake.auth_response_begin);
+    EXPECT_EQ(59u, handshake.auth_response_end);
+    EXPECT_EQ(extra.bits() & Capabilities::CONNECT_WITH_DB.bits() ? "db" : "", handshake.database);
+    EXPECT_EQ("mysql_native_password", handshake.auth_plugin);
+    EXPECT_EQ(extra.bits() & Capabilities::CONNECT_ATTRS.bits() ? 4u : 0u, handshake.connection_attrs.size());
+  }
+}
+
+TEST(TestReadWriteSplitter, NativePasswordToken) {
+  const std::string password = "secret";
+  const std::vector<uint8_t> scramble(20, 'x');
+  const std::vector<uint8_t> token = classic_handshake::make_native_password_token(password, scramble);
+  ASSERT_EQ(static_cast<size_t>(SHA1_HASH_SIZE), token.size());
+
+  // check it the way the server does
+  uint8_t stage1[SHA1_HASH_SIZE], stage2[SHA1_HASH_SIZE], mask[SHA1_HASH_SIZE];
+  my_sha1::compute_sha1_hash(stage1, password.data(), password.size());
+  my_sha1::compute_sha1_hash(stage2, reinterpret_cast<const char*>(stage1), SHA1_HASH_SIZE);
+  my_sha1::compute_sha1_hash_multi(mask, reinterpret_cast<const char*>(scramble.data()), 20,
+                                   reinterpret_cast<const char*>(stage2), SHA1_HASH_SIZE);
+  for (size_t i = 0; i < SHA1_HASH_SIZE; ++i) {
+    EXPECT_EQ(stage1[i], static_cast<uint8_t>(token[i] ^ mask[i]));
+  }
+
+  EXPECT_TRUE(classic_handshake::make_native_password_token("", scramble).empty());
+}
@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "query_digest.h"
+#include "result_cache.h"
+#include "test/helpers.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using clock_type = ResultCache::clock_type;
+
+static std::string key(const std::string &sql) {
+  std::string result;
+  ResultCache::make_key("user", reinterpret_cast<const uint8_t *>(sql.data()), sql.size(), result);
+  return result;
+}
+
+static std::string digest(const std::string &sql) {
+  std::string result;
+  make_query_digest(reinterpret_cast<const uint8_t *>(sql.data()), sql.size(), result);
+  return result;
+}
+
+TEST(TestResultCache, AllowsStatementsByDigest) {
+  ResultCache cache(1024, std::chrono::seconds(1),
+                    "SELECT name FROM stats WHERE id = 1; select count(*) from hits");
+
+  EXPECT_TRUE(cache.is_allowed(digest("SELECT name FROM stats WHERE id = 42")));
+  EXPECT_TRUE(cache.is_allowed(digest("SELECT COUNT(*) FROM hits")));
+  EXPECT_FALSE(cache.is_allowed(digest("SELECT name FROM stats")));
+  EXPECT_FALSE(cache.is_allowed(digest("")));
+}
+
+TEST(TestResultCache, KeysBySessionAndText) {
+  const std::string sql = "SELECT 1";
+  std::string first, second;
+  ResultCache::make_key("alice", reinterpret_cast<const uint8_t *>(sql.data()), sql.size(), first);
+  ResultCache::make_key("bob", reinterpret_cast<const uint8_t *>(sql.data()), sql.size(), second);
+  EXPECT_NE(first, second);
+  EXPECT_NE(key("SELECT 1"), key("SELECT 2"));
+}
+
+TEST(TestResultCache, ExpiresResponses) {
+  ResultCache cache(1024, std::chrono::milliseconds(100), "SELECT 1");
+  const clock_type::time_point now = clock_type::now();
+
+  cache.add(key("SELECT 1"), {1, 0, 0, 1, 0}, now);
+  auto response = cache.find(key("SELECT 1"), now + std::chrono::milliseconds(99));
+  ASSERT_NE(nullptr, response);
+  EXPECT_EQ(ResultCache::Response({1, 0, 0, 1, 0}), *response);
+  EXPECT_EQ(nullptr, cache.find(key("SELECT 2"), now));
+
+  EXPECT_EQ(nullptr, cache.find(key("SELECT 1"), now + std::chrono::milliseconds(100)));
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0u, cache.get_bytes());
+}
+
+TEST(TestResultCache, EvictsLeastRecentlyUsed) {
+  // keys of 13 bytes and responses of 10 bytes, room for 4 entries
+  ResultCache cache(100, std::chrono::seconds(1), "SELECT 1");
+  const clock_type::time_point now = clock_type::now();
+  const ResultCache::Response response(10, 0);
+
+  for (int i = 0; i < 4; ++i) cache.add(key("SELECT " + std::to_string(i)), response, now);
+  EXPECT_EQ(4u, cache.size());
+  EXPECT_EQ(92u, cache.get_bytes());
+
+  EXPECT_NE(nullptr, cache.find(key("SELECT 0"), now));
+  cache.add(key("SELECT 4"), response, now);
+  EXPECT_EQ(4u, cache.size());
+  EXPECT_NE(nullptr, cache.find(key("SELECT 0"), now));
+  EXPECT_EQ(nullptr, cache.find(key("SELECT 1"), now));
+  EXPECT_NE(nullptr, cache.find(key("SELECT 4"), now));
+
+  // replacing an entry keeps the bytes accounted once
+  cache.add(key("SELECT 4"), response, now);
+  EXPECT_EQ(4u, cache.size());
+  EXPECT_EQ(92u, cache.get_bytes());
+}
+
+TEST(TestResultCache, SkipsLargeResponses) {
+  ResultCache cache(800, std::chrono::seconds(1), "SELECT 1");
+  const clock_type::time_point now = clock_type::now();
+  EXPECT_EQ(100u, cache.get_max_response_size());
+
+  cache.add(key("SELECT 1"), ResultCache::Response(101, 0), now);
+  EXPECT_EQ(nullptr, cache.find(key("SELECT 1"), now));
+  cache.add(key("SELECT 1"), ResultCache::Response(100, 0), now);
+  EXPECT_NE(nullptr, cache.find(key("SELECT 1"), now));
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
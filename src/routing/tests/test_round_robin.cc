@@ -200,6 +200,142 @@ TEST_F(RoundRobinDestinationTest, get_server_socket)
   }
 }
 
+TEST_F(RoundRobinDestinationTest, RemoveKeepsQuarantine)
+{
+  int error;
+
+  DestRoundRobin dest(Protocol::get_default(), &mock_routing_sock_ops_,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  EXPECT_EQ(11, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  // second server fails and gets quarantined, the next one is used instead
+  mock_routing_sock_ops_.get_mysql_socket_fail(1);
+  EXPECT_EQ(13, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  EXPECT_EQ(1u, dest.size_quarantine());
+
+  // the quarantined server moves to another index, but stays quarantined
+  dest.remove("11", 1);
+  EXPECT_EQ(1u, dest.size_quarantine());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(13, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+
+  dest.clear();
+  EXPECT_EQ(0u, dest.size_quarantine());
+}
+
+TEST_F(RoundRobinDestinationTest, MaxConnectionsSkipsBusyServer)
+{
+  int error;
+
+  DestRoundRobin dest(Protocol::get_default(), &mock_routing_sock_ops_,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+  dest.set_destination_limits(2, std::chrono::milliseconds::zero());
+
+  dest.get_scoreboard()->get(mysql_harness::TCPAddress("11", 1))->connection_opened();
+  dest.get_scoreboard()->get(mysql_harness::TCPAddress("11", 1))->connection_opened();
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_NE(11, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+  EXPECT_EQ(0u, dest.size_quarantine());
+
+  // none may get more, the clients get no server
+  for (const char *server: {"12", "13"}) {
+    dest.get_scoreboard()->get(mysql_harness::TCPAddress(server, 1))->connection_opened();
+    dest.get_scoreboard()->get(mysql_harness::TCPAddress(server, 1))->connection_opened();
+  }
+  EXPECT_EQ(-1, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+}
+
+TEST_F(RoundRobinDestinationTest, SlowStartRampsUpRecoveredServer)
+{
+  class SlowStartingRoundRobin : public DestRoundRobin {
+   public:
+    using DestRoundRobin::DestRoundRobin;
+    using DestRoundRobin::start_slow_start;
+  };
+
+  int error;
+
+  SlowStartingRoundRobin dest(Protocol::get_default(), &mock_routing_sock_ops_,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.set_destination_limits(0, std::chrono::hours(1));
+
+  // at the start of its window the server gets a tiny share of the connections
+  dest.start_slow_start(mysql_harness::TCPAddress("11", 1));
+  dest.get_scoreboard()->get(mysql_harness::TCPAddress("11", 1))->connection_opened();
+  for (int i = 0; i < 10; ++i) {
+    dest.get_scoreboard()->get(mysql_harness::TCPAddress("12", 1))->connection_opened();
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+
+  // unless no other server can take the connection
+  mock_routing_sock_ops_.get_mysql_socket_fail(1);
+  EXPECT_EQ(-1, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  EXPECT_EQ(1u, dest.size_quarantine());
+  EXPECT_EQ(11, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+}
+
+TEST_F(RoundRobinDestinationTest, OpenCircuitSkipsServer)
+{
+  int error;
+
+  DestRoundRobin dest(Protocol::get_default(), &mock_routing_sock_ops_,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.set_circuit_breaker(1, std::chrono::hours(1), 1);
+
+  // the server accepts connects, but failed a handshake
+  dest.get_scoreboard()->get(mysql_harness::TCPAddress("11", 1))->get_circuit_breaker().failed(
+      std::chrono::steady_clock::now());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(12, dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+  }
+  EXPECT_EQ(0u, dest.size_quarantine());
+}
+
+TEST_F(RoundRobinDestinationTest, HedgedConnectTakesNextServer)
+{
+  int error;
+  mysql_harness::TCPAddress address;
+
+  DestRoundRobin dest(Protocol::get_default(), &mock_routing_sock_ops_,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+  dest.set_connect_hedging(90);
+
+  // until enough connects were timed the default delay is used, never above the timeout
+  EXPECT_EQ(routing::kDefaultHedgeDelay, dest.get_hedge_delay(std::chrono::seconds(1)));
+  EXPECT_EQ(std::chrono::milliseconds(5), dest.get_hedge_delay(std::chrono::milliseconds(5)));
+
+  // the first server fails, the one raced with it wins in the same call
+  mock_routing_sock_ops_.get_mysql_socket_fail(1);
+  EXPECT_EQ(12, dest.get_server_socket(std::chrono::seconds(1), &error, &address));
+  EXPECT_EQ("12", address.addr);
+  EXPECT_EQ(2, mock_routing_sock_ops_.get_mysql_socket_call_cnt());
+  // a server losing the race isn't known to be down
+  EXPECT_EQ(0u, dest.size_quarantine());
+
+  // the mock connects at once, their percentile is below a millisecond
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_NE(-1, dest.get_server_socket(std::chrono::seconds(1), &error));
+  }
+  EXPECT_EQ(std::chrono::milliseconds(1), dest.get_hedge_delay(std::chrono::seconds(1)));
+}
+
 int main(int argc, char *argv[]) {
   init_test_logger();
   ::testing::InitGoogleTest(&argc, argv);
@@ -29,20 +29,30 @@
 #include "common.h"
 #include "mysql/harness/loader.h"
 #include "routing_mocks.h"
+#include "protocol/classic_compression.h"
+#include "protocol/x_compression.h"
 #include "protocol/classic_protocol.h"
 #include "test/helpers.h"
 #include "tcp_port_pool.h"
 #include "mysql_routing_common.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #ifdef _WIN32
 #  define WIN32_LEAN_AND_MEAN
 #  include <windows.h>
 #  include <winsock2.h>
 #  include <ws2tcpip.h>
 #else
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
 #  include <sys/un.h>
 #  include <sys/socket.h>
 #  include <fcntl.h>
+#  include <unistd.h>
 #endif
 
 
@@ -55,6 +65,7 @@ using ::testing::Eq;
 using ::testing::Gt;
 using ::testing::Ne;
 using ::testing::InSequence;
+using ::testing::Invoke;
 using ::testing::Return;
 using ::testing::StrEq;
 using ::testing::_;
@@ -137,6 +148,36 @@ TEST_F(RoutingTests, CopyPacketsSingleWrite) {
   ASSERT_EQ(200u, report_bytes_read);
 }
 
+TEST_F(RoutingTests, CopyPacketsCoalescesReads) {
+  int sender_socket = 1, receiver_socket = 2;
+  RoutingProtocolBuffer buffer(500);
+  int curr_pktnr = 100;
+  bool handshake_done = true;
+  size_t report_bytes_read = 0u;
+
+  auto readable = [](struct pollfd *fds, nfds_t, std::chrono::milliseconds) {
+    fds[0].revents = POLLIN;
+    return 1;
+  };
+
+  InSequence seq;
+
+  EXPECT_CALL(socket_op, read(sender_socket, &buffer[0], buffer.size())).WillOnce(Return(200));
+  // the rest of the burst arrived meanwhile, it is forwarded with one write
+  EXPECT_CALL(socket_op, poll(_, 1, std::chrono::milliseconds(0))).WillOnce(Invoke(readable));
+  EXPECT_CALL(socket_op, read(sender_socket, &buffer[200], 300)).WillOnce(Return(100));
+  EXPECT_CALL(socket_op, poll(_, 1, std::chrono::milliseconds(0))).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, write(receiver_socket, &buffer[0], 300)).WillOnce(Return(300));
+
+  ClassicProtocol cp(&routing_sock_ops);
+  int res = cp.copy_packets(sender_socket, receiver_socket, true,
+                            buffer, &curr_pktnr,
+                            handshake_done, &report_bytes_read, false);
+
+  ASSERT_EQ(0, res);
+  ASSERT_EQ(300u, report_bytes_read);
+}
+
 TEST_F(RoutingTests, CopyPacketsMultipleWrites) {
   int sender_socket = 1, receiver_socket = 2;
   RoutingProtocolBuffer buffer(500);
@@ -495,6 +536,379 @@ TEST_F(RoutingTests, set_destinations_from_uri) {
   }
 }
 
+TEST_F(RoutingTests, set_output_queue_watermarks) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+#ifndef _WIN32
+  EXPECT_NO_THROW(routing.set_output_queue_watermarks(65536, 16384));
+  EXPECT_NO_THROW(routing.set_output_queue_watermarks(65536, 65536));
+  try {
+    routing.set_output_queue_watermarks(16384, 65536);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] output_queue_low_watermark needs to be less than or equal to output_queue_high_watermark"));
+  }
+#endif
+
+  // 0 keeps writes blocking, whatever the low watermark is
+  EXPECT_NO_THROW(routing.set_output_queue_watermarks(0, 16384));
+}
+
+/*
+ * @test
+ *       Verify that the max_connections slots are taken atomically, racing
+ *       acceptors don't admit more connections than that.
+ */
+TEST_F(RoutingTests, ReservesConnectionSlots) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name", 8);
+
+  std::atomic<int> reserved{0};
+  std::vector<std::thread> acceptors;
+  for (int i = 0; i < 4; ++i) {
+    acceptors.emplace_back([&routing, &reserved]() {
+      for (int j = 0; j < 100; ++j) {
+        if (routing.reserve_connection()) ++reserved;
+      }
+    });
+  }
+  for (auto &acceptor: acceptors) acceptor.join();
+  EXPECT_EQ(8, reserved.load());
+  EXPECT_FALSE(routing.reserve_connection());
+
+  SCOPED_TRACE("// a released slot can be taken again");
+  routing.release_connection();
+  EXPECT_TRUE(routing.reserve_connection());
+  EXPECT_FALSE(routing.reserve_connection());
+}
+
+TEST_F(RoutingTests, set_connection_multiplexing) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_connection_multiplexing(false));
+  try {
+    routing.set_connection_multiplexing(true);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] connection_multiplexing requires connection_pool_size greater than 0"));
+  }
+
+  routing.set_connection_pool(4, std::chrono::seconds(60));
+  EXPECT_NO_THROW(routing.set_connection_multiplexing(true));
+
+  // X protocol connections get pooled, but not multiplexed
+  MySQLRouting x_routing(routing::RoutingStrategy::kFirstAvailable, 7002, Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                         "127.0.0.1", mysql_harness::Path(), "x_routing_name");
+  EXPECT_NO_THROW(x_routing.set_connection_pool(4, std::chrono::seconds(60)));
+  try {
+    x_routing.set_connection_multiplexing(true);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[x_routing_name] connection_multiplexing is only supported for the classic protocol"));
+  }
+}
+
+TEST_F(RoutingTests, set_client_tls) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_client_tls("", ""));
+  EXPECT_NO_THROW(routing.set_client_kernel_tls(false));
+  try {
+    routing.set_client_kernel_tls(true);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] client_ssl_kernel_tls requires client_ssl_cert"));
+  }
+  try {
+    routing.set_client_tls("cert.pem", "");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] client_ssl_cert and client_ssl_key need to be set together"));
+  }
+  try {
+    routing.set_client_tls("does-not-exist.pem", "does-not-exist.pem");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    // message depends on whether the build supports TLS
+    EXPECT_EQ(0u, std::string(err.what()).find("[routing_name] "));
+  }
+
+  routing.set_connection_pool(4, std::chrono::seconds(60));
+  try {
+    routing.set_client_tls("cert.pem", "key.pem");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] client_ssl_cert is not supported with connection_pool_size"));
+  }
+
+  MySQLRouting x_routing(routing::RoutingStrategy::kFirstAvailable, 7002, Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                         "127.0.0.1", mysql_harness::Path(), "routing_name");
+  try {
+    x_routing.set_client_tls("cert.pem", "key.pem");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] client_ssl_cert is only supported for the classic protocol"));
+  }
+}
+
+TEST_F(RoutingTests, set_prepared_statement_cache_size) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_prepared_statement_cache_size(0));
+  try {
+    routing.set_prepared_statement_cache_size(64);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] prepared_statement_cache_size requires connection_multiplexing"));
+  }
+
+  routing.set_connection_pool(4, std::chrono::seconds(60));
+  routing.set_connection_multiplexing(true);
+  EXPECT_NO_THROW(routing.set_prepared_statement_cache_size(64));
+}
+
+TEST_F(RoutingTests, set_session_migration) {
+  {
+    MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                         "127.0.0.1", mysql_harness::Path(), "routing_name");
+    EXPECT_NO_THROW(routing.set_session_migration(true));
+    EXPECT_NO_THROW(routing.set_session_migration(false));
+  }
+
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+  EXPECT_NO_THROW(routing.set_session_migration(false));
+  try {
+    routing.set_session_migration(true);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] session_migration is only supported for the classic protocol"));
+  }
+}
+
+TEST_F(RoutingTests, set_server_compression) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_server_compression(false));
+  if (ClassicCompression::is_supported()) {
+    EXPECT_NO_THROW(routing.set_server_compression(true));
+  }
+
+  routing.set_connection_pool(4, std::chrono::seconds(60));
+  try {
+    routing.set_server_compression(true);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    if (ClassicCompression::is_supported()) {
+      EXPECT_EQ(err.what(), std::string("[routing_name] server_compression is not supported with connection_pool_size"));
+    }
+  }
+
+  MySQLRouting x_routing(routing::RoutingStrategy::kFirstAvailable, 7002, Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                         "127.0.0.1", mysql_harness::Path(), "routing_name");
+  if (XCompression::is_supported()) {
+    EXPECT_NO_THROW(x_routing.set_server_compression(true));
+  } else {
+    EXPECT_THROW(x_routing.set_server_compression(true), std::invalid_argument);
+  }
+}
+
+TEST_F(RoutingTests, set_query_digest_sampling) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_query_digest_sampling(0));
+  EXPECT_NO_THROW(routing.set_query_digest_sampling(100));
+
+  MySQLRouting pooled_routing(routing::RoutingStrategy::kFirstAvailable, 7002, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                              "127.0.0.1", mysql_harness::Path(), "pooled_routing_name");
+  pooled_routing.set_connection_pool(4, std::chrono::seconds(60));
+  try {
+    pooled_routing.set_query_digest_sampling(100);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[pooled_routing_name] query_digest_sampling is not supported with connection_pool_size"));
+  }
+
+  MySQLRouting x_routing(routing::RoutingStrategy::kFirstAvailable, 7003, Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                         "127.0.0.1", mysql_harness::Path(), "x_routing_name");
+  try {
+    x_routing.set_query_digest_sampling(100);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[x_routing_name] query_digest_sampling is only supported for the classic protocol"));
+  }
+}
+
+TEST_F(RoutingTests, set_result_cache) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_result_cache(0, std::chrono::seconds(1), ""));
+  EXPECT_NO_THROW(routing.set_result_cache(1048576, std::chrono::seconds(1), "SELECT 1; SELECT 2"));
+  try {
+    routing.set_result_cache(1048576, std::chrono::seconds(1), "");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] result_cache_size requires result_cache_statements"));
+  }
+  try {
+    routing.set_result_cache(0, std::chrono::seconds(1), "SELECT 1");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] result_cache_statements requires result_cache_size"));
+  }
+
+  MySQLRouting x_routing(routing::RoutingStrategy::kFirstAvailable, 7003, Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                         "127.0.0.1", mysql_harness::Path(), "x_routing_name");
+  try {
+    x_routing.set_result_cache(1048576, std::chrono::seconds(1), "SELECT 1");
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[x_routing_name] result_cache_size is only supported for the classic protocol"));
+  }
+}
+
+TEST_F(RoutingTests, set_max_net_buffer_length) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_max_net_buffer_length(0));
+  EXPECT_NO_THROW(routing.set_max_net_buffer_length(routing::kDefaultNetBufferLength));
+  EXPECT_NO_THROW(routing.set_max_net_buffer_length(1048576));
+  try {
+    routing.set_max_net_buffer_length(routing::kDefaultNetBufferLength - 1);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] max_net_buffer_length needs to be 0 or at least net_buffer_length (16384)"));
+  }
+}
+
+TEST_F(RoutingTests, set_quarantine_interval) {
+  MySQLRouting routing(routing::RoutingStrategy::kRoundRobin, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+
+  EXPECT_NO_THROW(routing.set_quarantine_interval(std::chrono::milliseconds(500), std::chrono::milliseconds(500)));
+  EXPECT_NO_THROW(routing.set_quarantine_interval(std::chrono::milliseconds(100), std::chrono::seconds(60)));
+  try {
+    routing.set_quarantine_interval(std::chrono::milliseconds(500), std::chrono::milliseconds(499));
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] quarantine_max_interval needs to be at least quarantine_interval (500)"));
+  }
+}
+
+TEST_F(RoutingTests, set_destination_weights) {
+  {
+    MySQLRouting routing(routing::RoutingStrategy::kRoundRobin, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadOnly,
+                         "127.0.0.1", mysql_harness::Path(), "routing_name");
+    EXPECT_NO_THROW(routing.set_destination_weights({}));
+    try {
+      routing.set_destination_weights({1, 2});
+      FAIL() << "Expected std::invalid_argument exception";
+    }
+    catch (const std::invalid_argument &err) {
+      EXPECT_EQ(err.what(), std::string("[routing_name] destination_weights requires routing_strategy=weighted-round-robin"));
+    }
+  }
+
+  {
+    MySQLRouting routing(routing::RoutingStrategy::kWeightedRoundRobin, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadOnly,
+                         "127.0.0.1", mysql_harness::Path(), "routing_name");
+    routing.set_destination_weights({1, 2});
+    EXPECT_NO_THROW(routing.set_destinations_from_csv("127.0.0.1:2002,127.0.0.1:2004"));
+    try {
+      routing.set_destinations_from_csv("127.0.0.1:2002,127.0.0.1:2004,127.0.0.1:2006");
+      FAIL() << "Expected std::invalid_argument exception";
+    }
+    catch (const std::invalid_argument &err) {
+      EXPECT_EQ(err.what(), std::string("[routing_name] destination_weights needs one weight per destination (3), got 2"));
+    }
+  }
+}
+
+TEST_F(RoutingTests, change_settings) {
+  MySQLRouting routing(routing::RoutingStrategy::kRoundRobin, 7001, Protocol::Type::kClassicProtocol, routing::AccessMode::kReadOnly,
+                       "127.0.0.1", mysql_harness::Path(), "routing_name");
+  routing.set_destinations_from_csv("127.0.0.1:2002");
+
+  RouteSettingsChange change;
+  change.change_max_connections = true;
+  change.max_connections = 100;
+  change.change_net_buffer_length = true;
+  change.net_buffer_length = 32768;
+  change.change_destinations = true;
+  change.destinations = {"127.0.0.1:2004", "127.0.0.1:2006"};
+  ASSERT_NO_THROW(routing.change_settings(change));
+
+  RouteSettings settings = routing.get_settings();
+  EXPECT_EQ(100, settings.max_connections);
+  EXPECT_EQ(32768u, settings.net_buffer_length);
+  EXPECT_TRUE(settings.static_destinations);
+  EXPECT_THAT(settings.destinations, ::testing::ElementsAre("127.0.0.1:2004", "127.0.0.1:2006"));
+
+  // an invalid change leaves the others unapplied
+  RouteSettingsChange invalid;
+  invalid.change_max_connections = true;
+  invalid.max_connections = 200;
+  invalid.change_net_buffer_length = true;
+  invalid.net_buffer_length = 10;
+  try {
+    routing.change_settings(invalid);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] net_buffer_length needs to be between 1024 and 1048576, was 10"));
+  }
+  EXPECT_EQ(100, routing.get_max_connections());
+
+  RouteSettingsChange no_destinations;
+  no_destinations.change_destinations = true;
+  try {
+    routing.change_settings(no_destinations);
+    FAIL() << "Expected std::invalid_argument exception";
+  }
+  catch (const std::invalid_argument &err) {
+    EXPECT_EQ(err.what(), std::string("[routing_name] No destinations available"));
+  }
+  EXPECT_EQ(2u, routing.get_settings().destinations.size());
+}
+
+TEST_F(RoutingTests, change_settings_metadata_cache_destinations) {
+  MySQLRouting routing(routing::RoutingStrategy::kFirstAvailable, 7001, Protocol::Type::kXProtocol);
+  routing.set_destinations_from_uri(URI("metadata-cache://test/default?role=PRIMARY"));
+
+  EXPECT_FALSE(routing.get_settings().static_destinations);
+
+  RouteSettingsChange change;
+  change.change_destinations = true;
+  change.destinations = {"127.0.0.1:2004"};
+  EXPECT_THROW(routing.change_settings(change), std::invalid_argument);
+}
+
 TEST_F(RoutingTests, set_destinations_from_cvs) {
 
   MySQLRouting routing(routing::RoutingStrategy::kNextAvailable, 7001, Protocol::Type::kXProtocol);
@@ -546,6 +960,22 @@ TEST_F(RoutingTests, set_destinations_from_cvs) {
     EXPECT_THROW(routing_x.set_destinations_from_csv("127.0.0.1:33060"), std::runtime_error);
     EXPECT_NO_THROW(routing_x.set_destinations_from_csv("127.0.0.1:3306"));
   }
+
+  // unix sockets, their path needs to be absolute
+  {
+    EXPECT_NO_THROW(routing.set_destinations_from_csv("unix:///tmp/mysqlx.sock,127.0.0.1:2002"));
+    EXPECT_THROW(routing.set_destinations_from_csv("unix://tmp/mysqlx.sock"), std::runtime_error);
+  }
+}
+
+TEST_F(RoutingTests, set_destination_sockets) {
+  MySQLRouting routing(routing::RoutingStrategy::kNextAvailable, 7001, Protocol::Type::kClassicProtocol);
+
+  EXPECT_NO_THROW(routing.set_destination_sockets(""));
+  EXPECT_NO_THROW(routing.set_destination_sockets("127.0.0.1:3306=unix:///tmp/mysql.sock, 127.0.0.1=unix:///tmp/b.sock"));
+  EXPECT_THROW(routing.set_destination_sockets("127.0.0.1:3306"), std::invalid_argument);
+  EXPECT_THROW(routing.set_destination_sockets("127.0.0.1:3306=/tmp/mysql.sock"), std::invalid_argument);
+  EXPECT_THROW(routing.set_destination_sockets("127.0.0.1:3306=unix://tmp/mysql.sock"), std::invalid_argument);
 }
 
 #endif // #ifndef _WIN32 [_HERE_]
@@ -611,6 +1041,245 @@ TEST_F(RoutingTests, DISABLED_ConnectToServerWrongPort) {
 #endif
 }
 
+#ifndef _WIN32
+// listens on an ephemeral port of 127.0.0.1, address is set to where it listens
+static int listen_local(int backlog, mysql_harness::ResolverCache::Address& address) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in* addr = reinterpret_cast<struct sockaddr_in*>(&address.addr);
+  memset(&address, 0, sizeof(address));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.addrlen = static_cast<socklen_t>(sizeof(*addr));
+  if (sock == -1 || bind(sock, reinterpret_cast<struct sockaddr*>(addr), address.addrlen) == -1 ||
+      listen(sock, backlog) == -1 ||
+      getsockname(sock, reinterpret_cast<struct sockaddr*>(addr), &address.addrlen) == -1) {
+    throw std::runtime_error(mysql_harness::get_strerror(errno));
+  }
+  address.family = AF_INET;
+  address.socktype = SOCK_STREAM;
+  address.protocol = IPPROTO_TCP;
+
+  return sock;
+}
+
+/*
+ * @test The connect to the next address starts while the connect to an unresponsive address is
+ *       still pending, and the one that connects wins.
+ */
+TEST_F(RoutingTests, ConnectToAddressesStaggered) {
+  auto sock_ops = routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance());
+  mysql_harness::ResolverCache::Addresses addresses(2);
+
+  // the SYNs to a listener with a full accept queue get dropped
+  int unresponsive = listen_local(0, addresses[0]);
+  int filler = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, connect(filler, reinterpret_cast<struct sockaddr*>(&addresses[0].addr), addresses[0].addrlen));
+  int responsive = listen_local(16, addresses[1]);
+
+  bool timeout_expired = true;
+  auto started = std::chrono::steady_clock::now();
+  int sock = sock_ops->connect_to_addresses(addresses, "localhost", std::chrono::seconds(5),
+                                            routing::SocketOptions(), timeout_expired);
+  auto elapsed = std::chrono::steady_clock::now() - started;
+
+  ASSERT_NE(routing::kInvalidSocket, sock);
+  EXPECT_FALSE(timeout_expired);
+  EXPECT_LT(elapsed, std::chrono::seconds(2));
+
+  struct sockaddr_in peer;
+  socklen_t peer_len = static_cast<socklen_t>(sizeof(peer));
+  ASSERT_EQ(0, getpeername(sock, reinterpret_cast<struct sockaddr*>(&peer), &peer_len));
+  EXPECT_EQ(reinterpret_cast<struct sockaddr_in*>(&addresses[1].addr)->sin_port, peer.sin_port);
+
+  close(sock);
+  close(filler);
+  close(responsive);
+  close(unresponsive);
+}
+
+/*
+ * @test Connecting reports the timeout if none of the addresses answers in time.
+ */
+TEST_F(RoutingTests, ConnectToAddressesTimeout) {
+  auto sock_ops = routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance());
+  mysql_harness::ResolverCache::Addresses addresses(1);
+
+  int unresponsive = listen_local(0, addresses[0]);
+  int filler = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, connect(filler, reinterpret_cast<struct sockaddr*>(&addresses[0].addr), addresses[0].addrlen));
+
+  bool timeout_expired = false;
+  int sock = sock_ops->connect_to_addresses(addresses, "localhost", std::chrono::milliseconds(100),
+                                            routing::SocketOptions(), timeout_expired);
+
+  EXPECT_EQ(routing::kInvalidSocket, sock);
+  EXPECT_TRUE(timeout_expired);
+
+  close(filler);
+  close(unresponsive);
+}
+
+/*
+ * @test A hedged connect waiting for the greeting takes the server that sends it, not the
+ *       one that only accepted the connect, and leaves the greeting unread.
+ */
+TEST_F(RoutingTests, HedgedConnectWaitsForGreeting) {
+  auto sock_ops = routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance());
+  mysql_harness::ResolverCache::Addresses addresses(2);
+
+  int silent = listen_local(16, addresses[0]);
+  int greeting = listen_local(16, addresses[1]);
+  std::vector<mysql_harness::TCPAddress> servers;
+  for (const auto& address : addresses) {
+    servers.emplace_back("127.0.0.1",
+                         ntohs(reinterpret_cast<const struct sockaddr_in*>(&address.addr)->sin_port));
+  }
+
+  std::thread server([greeting]() {
+    int client = accept(greeting, nullptr, nullptr);
+    if (client < 0) return;
+    const char hello = 'x';
+    char buf;
+    // stays connected until the router side closes
+    if (send(client, &hello, 1, 0) == 1) recv(client, &buf, 1, 0);
+    close(client);
+  });
+
+  size_t connected = servers.size();
+  int sock = sock_ops->get_mysql_socket_hedged(servers, std::chrono::seconds(5), std::chrono::milliseconds(10),
+                                               true, routing::SocketOptions(), connected);
+
+  EXPECT_GE(sock, 0);
+  EXPECT_EQ(1u, connected);
+  if (sock >= 0) {
+    char buf = 0;
+    EXPECT_EQ(1, recv(sock, &buf, 1, 0));
+    EXPECT_EQ('x', buf);
+    close(sock);
+  }
+
+  server.join();
+  close(greeting);
+  close(silent);
+}
+
+/*
+ * @test Server connections get bound to the source addresses in turn, addresses that aren't
+ *       numeric are rejected.
+ */
+TEST_F(RoutingTests, SourceAddressesTakenInTurn) {
+  EXPECT_THROW(routing::SourceAddressPool({"localhost"}), std::invalid_argument);
+
+  auto sock_ops = routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance());
+  mysql_harness::ResolverCache::Address address;
+  int listener = listen_local(16, address);
+  const uint16_t port = ntohs(reinterpret_cast<const struct sockaddr_in*>(&address.addr)->sin_port);
+
+  routing::SocketOptions options;
+  // all of 127.0.0.0/8 is local, no IPv6 address gets used for an IPv4 server
+  options.source_addresses = std::make_shared<routing::SourceAddressPool>(
+      std::vector<std::string>{"127.0.0.2", "::1", "127.0.0.3"});
+
+  std::vector<std::string> sources;
+  for (int i = 0; i < 2; ++i) {
+    int sock = sock_ops->get_mysql_socket(TCPAddress("127.0.0.1", port), std::chrono::seconds(1), true, options);
+    ASSERT_GE(sock, 0);
+
+    struct sockaddr_in local;
+    socklen_t local_len = static_cast<socklen_t>(sizeof(local));
+    ASSERT_EQ(0, getsockname(sock, reinterpret_cast<struct sockaddr*>(&local), &local_len));
+    char buf[INET_ADDRSTRLEN];
+    sources.push_back(inet_ntop(AF_INET, &local.sin_addr, buf, sizeof(buf)));
+    close(sock);
+  }
+  std::sort(sources.begin(), sources.end());
+  EXPECT_EQ(std::vector<std::string>({"127.0.0.2", "127.0.0.3"}), sources);
+
+  close(listener);
+}
+
+/*
+ * @test All servers are probed at the same time, an unresponsive server does not delay the others.
+ */
+TEST_F(RoutingTests, ProbeMySQLServers) {
+  auto sock_ops = routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance());
+  mysql_harness::ResolverCache::Addresses addresses(3);
+
+  int unresponsive = listen_local(0, addresses[0]);
+  int filler = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, connect(filler, reinterpret_cast<struct sockaddr*>(&addresses[0].addr), addresses[0].addrlen));
+  int responsive = listen_local(16, addresses[1]);
+  // nobody listens on a closed socket's port
+  close(listen_local(16, addresses[2]));
+
+  std::vector<TCPAddress> servers;
+  for (const auto& address : addresses) {
+    servers.emplace_back("127.0.0.1", ntohs(reinterpret_cast<const struct sockaddr_in*>(&address.addr)->sin_port));
+  }
+  // the responsive one twice, it may not be probed one after the other
+  servers.push_back(servers[1]);
+
+  auto started = std::chrono::steady_clock::now();
+  auto reachable = sock_ops->probe_mysql_servers(servers, std::chrono::milliseconds(500));
+  auto elapsed = std::chrono::steady_clock::now() - started;
+
+  EXPECT_THAT(reachable, ContainerEq(std::vector<bool>{false, true, false, true}));
+  EXPECT_LT(elapsed, std::chrono::seconds(1));
+
+  close(filler);
+  close(responsive);
+  close(unresponsive);
+}
+
+/*
+ * @test Destinations given as unix socket get connected and probed at their path.
+ */
+TEST_F(RoutingTests, ConnectToUnixSocket) {
+  auto sock_ops = routing::RoutingSockOps::instance(mysql_harness::SocketOperations::instance());
+  const std::string path = "/tmp/routing_test_" + std::to_string(getpid()) + ".sock";
+  const std::string destination = "unix://" + path;
+
+  ASSERT_TRUE(routing::is_unix_socket_destination(destination));
+  EXPECT_FALSE(routing::is_unix_socket_destination("127.0.0.1:3306"));
+  const TCPAddress address = routing::get_unix_socket_address(destination);
+  EXPECT_TRUE(routing::is_unix_socket(address));
+  EXPECT_EQ(path, address.str());
+  EXPECT_FALSE(routing::is_unix_socket(TCPAddress("127.0.0.1", 3306)));
+  EXPECT_THROW(routing::get_unix_socket_address("unix://tmp/relative.sock"), std::runtime_error);
+  EXPECT_THROW(routing::get_unix_socket_address("unix:///" + std::string(200, 'x')), std::runtime_error);
+
+  // nobody listens yet
+  EXPECT_GT(0, sock_ops->get_mysql_socket(address, std::chrono::milliseconds(100), false));
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_NE(-1, listener);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  ASSERT_EQ(0, bind(listener, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)));
+  ASSERT_EQ(0, listen(listener, 16));
+
+  int sock = sock_ops->get_mysql_socket(address, std::chrono::milliseconds(100), false);
+  ASSERT_LE(0, sock);
+  int server = accept(listener, nullptr, nullptr);
+  EXPECT_LE(0, server);
+  EXPECT_EQ(1, write(sock, "x", 1));
+  char c = 0;
+  EXPECT_EQ(1, read(server, &c, 1));
+  EXPECT_EQ('x', c);
+
+  EXPECT_THAT(sock_ops->probe_mysql_servers({address}, std::chrono::milliseconds(100)),
+              ContainerEq(std::vector<bool>{true}));
+
+  close(server);
+  close(sock);
+  close(listener);
+  unlink(path.c_str());
+}
+#endif
+
 
 int main(int argc, char *argv[]) {
   init_test_logger();
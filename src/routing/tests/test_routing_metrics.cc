@@ -0,0 +1,180 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/routing_metrics.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(TestRoutingMetrics, CountsConnections) {
+  RoutingMetrics metrics;
+
+  metrics.connection_opened();
+  metrics.connection_opened();
+  metrics.connection_closed(10, 200);
+
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  EXPECT_EQ(2u, snapshot.connections_total);
+  EXPECT_EQ(1u, snapshot.connections_active);
+  EXPECT_EQ(10u, snapshot.bytes_up);
+  EXPECT_EQ(200u, snapshot.bytes_down);
+}
+
+TEST(TestRoutingMetrics, ConnectLatencyHistogram) {
+  RoutingMetrics metrics;
+
+  metrics.add_latency(RoutingMetrics::Latency::kConnect, std::chrono::microseconds(10));    // below 64us
+  metrics.add_latency(RoutingMetrics::Latency::kConnect, std::chrono::microseconds(100));   // below 128us
+  metrics.add_latency(RoutingMetrics::Latency::kConnect, std::chrono::hours(1));            // last bucket
+  metrics.connect_failed();
+
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  const auto &connect = RoutingMetrics::histogram(snapshot, RoutingMetrics::Latency::kConnect);
+  EXPECT_EQ(3u, connect.count);
+  EXPECT_EQ(110u + 3600000000u, connect.sum_us);
+  EXPECT_EQ(1u, connect.buckets[0]);
+  EXPECT_EQ(1u, connect.buckets[1]);
+  EXPECT_EQ(1u, connect.buckets[RoutingMetrics::kLatencyBuckets - 1]);
+  EXPECT_EQ(1u, snapshot.connect_errors);
+}
+
+TEST(TestRoutingMetrics, LatencyHistogramsAreSeparate) {
+  RoutingMetrics metrics;
+
+  metrics.add_latency(RoutingMetrics::Latency::kHandshake, std::chrono::milliseconds(1));
+  metrics.add_latency(RoutingMetrics::Latency::kRoundTrip, std::chrono::microseconds(200));
+  metrics.add_latency(RoutingMetrics::Latency::kRoundTrip, std::chrono::microseconds(300));
+  metrics.add_latency(RoutingMetrics::Latency::kLifetime, std::chrono::seconds(-1));  // clamped to 0
+
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  EXPECT_EQ(0u, RoutingMetrics::histogram(snapshot, RoutingMetrics::Latency::kConnect).count);
+
+  const auto &handshake = RoutingMetrics::histogram(snapshot, RoutingMetrics::Latency::kHandshake);
+  EXPECT_EQ(1u, handshake.count);
+  EXPECT_EQ(1000u, handshake.sum_us);
+  EXPECT_EQ(1u, handshake.buckets[4]);  // below 1024us
+
+  const auto &round_trip = RoutingMetrics::histogram(snapshot, RoutingMetrics::Latency::kRoundTrip);
+  EXPECT_EQ(2u, round_trip.count);
+  EXPECT_EQ(500u, round_trip.sum_us);
+  EXPECT_EQ(1u, round_trip.buckets[2]);  // below 256us
+  EXPECT_EQ(1u, round_trip.buckets[3]);  // below 512us
+
+  const auto &lifetime = RoutingMetrics::histogram(snapshot, RoutingMetrics::Latency::kLifetime);
+  EXPECT_EQ(1u, lifetime.count);
+  EXPECT_EQ(0u, lifetime.sum_us);
+  EXPECT_EQ(1u, lifetime.buckets[0]);
+}
+
+TEST(TestRoutingMetrics, Quarantined) {
+  RoutingMetrics metrics;
+
+  metrics.set_quarantined("127.0.0.1:3306", true);
+  metrics.set_quarantined("127.0.0.1:3307", true);
+  metrics.set_quarantined("127.0.0.1:3306", false);
+
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  ASSERT_EQ(2u, snapshot.quarantined.size());
+  EXPECT_FALSE(snapshot.quarantined["127.0.0.1:3306"]);
+  EXPECT_TRUE(snapshot.quarantined["127.0.0.1:3307"]);
+}
+
+TEST(TestRoutingMetrics, SumsUpTheThreads) {
+  RoutingMetrics metrics;
+  const size_t kThreads = RoutingMetrics::kShards + 3;
+  const uint64_t kConnections = 1000;
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&metrics, kConnections]() {
+      for (uint64_t c = 0; c < kConnections; ++c) {
+        metrics.connection_opened();
+        metrics.connection_closed(1, 2);
+      }
+    });
+  }
+  for (auto &thr: threads) thr.join();
+
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  EXPECT_EQ(kThreads * kConnections, snapshot.connections_total);
+  EXPECT_EQ(0u, snapshot.connections_active);
+  EXPECT_EQ(kThreads * kConnections, snapshot.bytes_up);
+  EXPECT_EQ(2 * kThreads * kConnections, snapshot.bytes_down);
+}
+
+TEST(TestRoutingMetrics, CountsErrorsAndTimeouts) {
+  RoutingMetrics metrics;
+
+  metrics.connection_failed();
+  metrics.timed_out(RoutingMetrics::Timeout::kHandshake);
+  metrics.timed_out(RoutingMetrics::Timeout::kIdle);
+  metrics.timed_out(RoutingMetrics::Timeout::kIdle);
+
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  EXPECT_EQ(1u, snapshot.connection_errors);
+  EXPECT_EQ(1u, RoutingMetrics::timeouts(snapshot, RoutingMetrics::Timeout::kHandshake));
+  EXPECT_EQ(2u, RoutingMetrics::timeouts(snapshot, RoutingMetrics::Timeout::kIdle));
+  EXPECT_EQ(0u, RoutingMetrics::timeouts(snapshot, RoutingMetrics::Timeout::kLifetime));
+}
+
+TEST(TestRoutingMetrics, BufferPool) {
+  RoutingMetrics metrics;
+  EXPECT_EQ(0u, metrics.get_snapshot().buffer_pool.hits);
+
+  uint64_t hits = 0;
+  metrics.set_buffer_pool_source([&hits]() {
+    RoutingMetrics::BufferPoolCounters counters;
+    counters.hits = ++hits;
+    counters.misses = 2;
+    counters.evictions = 3;
+    counters.high_water = 4;
+    return counters;
+  });
+
+  // read at each snapshot
+  EXPECT_EQ(1u, metrics.get_snapshot().buffer_pool.hits);
+  RoutingMetrics::Snapshot snapshot = metrics.get_snapshot();
+  EXPECT_EQ(2u, snapshot.buffer_pool.hits);
+  EXPECT_EQ(2u, snapshot.buffer_pool.misses);
+  EXPECT_EQ(3u, snapshot.buffer_pool.evictions);
+  EXPECT_EQ(4u, snapshot.buffer_pool.high_water);
+
+  metrics.set_buffer_pool_source(nullptr);
+  EXPECT_EQ(0u, metrics.get_snapshot().buffer_pool.hits);
+}
+
+TEST(TestRoutingMetrics, Component) {
+  auto metrics = std::make_shared<RoutingMetrics>();
+
+  RoutingMetricsComponent::getInstance().register_route("test_route", metrics);
+  EXPECT_EQ(metrics, RoutingMetricsComponent::getInstance().get_routes()["test_route"]);
+
+  RoutingMetricsComponent::getInstance().unregister_route("test_route");
+  EXPECT_EQ(0u, RoutingMetricsComponent::getInstance().get_routes().count("test_route"));
+}
@@ -0,0 +1,147 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mysqlrouter/routing_stats_segment.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using routing_stats::Segment;
+using routing_stats::SegmentWriter;
+
+class TestRoutingStatsSegment : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = "test_routing_stats_segment." + std::to_string(getpid());
+  }
+
+  void TearDown() override {
+    ::unlink(path_.c_str());
+  }
+
+  // maps the file read-only, like a monitoring agent
+  const Segment *map_reader() {
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd == -1) return nullptr;
+    void *mapped = ::mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    return mapped == MAP_FAILED ? nullptr : static_cast<const Segment *>(mapped);
+  }
+
+  std::string path_;
+};
+
+TEST_F(TestRoutingStatsSegment, PublishedStateIsRead) {
+  SegmentWriter writer(path_);
+  const Segment *shared = map_reader();
+  ASSERT_NE(nullptr, shared);
+
+  std::unique_ptr<Segment> state(new Segment());
+  state->routes_count = 1;
+  SegmentWriter::set_name(state->routes[0].name, "routing:rw");
+  state->routes[0].connections_total = 42;
+  state->routes[0].destinations_count = 1;
+  SegmentWriter::set_name(state->routes[0].destinations[0].address, "127.0.0.1:3306");
+  state->metadata_cache.refreshes = 7;
+  writer.publish(*state);
+
+  std::unique_ptr<Segment> copy(new Segment());
+  ASSERT_TRUE(routing_stats::read_stats_segment(*shared, *copy));
+  EXPECT_EQ(sizeof(Segment), copy->size);
+  EXPECT_EQ(2u, copy->sequence.load());
+  EXPECT_EQ(1u, copy->routes_count);
+  EXPECT_STREQ("routing:rw", copy->routes[0].name);
+  EXPECT_EQ(42u, copy->routes[0].connections_total);
+  EXPECT_STREQ("127.0.0.1:3306", copy->routes[0].destinations[0].address);
+  EXPECT_EQ(7u, copy->metadata_cache.refreshes);
+
+  ::munmap(const_cast<Segment *>(shared), sizeof(Segment));
+}
+
+TEST_F(TestRoutingStatsSegment, NamesAreTruncated) {
+  char field[routing_stats::kNameSize];
+
+  SegmentWriter::set_name(field, std::string(200, 'x'));
+  EXPECT_EQ(std::string(routing_stats::kNameSize - 1, 'x'), field);
+}
+
+TEST_F(TestRoutingStatsSegment, FileIsRemovedWithWriter) {
+  {
+    SegmentWriter writer(path_);
+    struct stat st;
+    ASSERT_EQ(0, ::stat(path_.c_str(), &st));
+    EXPECT_EQ(static_cast<off_t>(sizeof(Segment)), st.st_size);
+  }
+  struct stat st;
+  EXPECT_EQ(-1, ::stat(path_.c_str(), &st));
+}
+
+TEST_F(TestRoutingStatsSegment, ReadersSeeNoTornState) {
+  SegmentWriter writer(path_);
+  const Segment *shared = map_reader();
+  ASSERT_NE(nullptr, shared);
+
+  std::atomic<bool> done{false};
+  std::thread publisher([&writer, &done]() {
+    std::unique_ptr<Segment> state(new Segment());
+    for (uint64_t n = 1; n <= 20000; ++n) {
+      // all counters the same in every state
+      state->routes_count = routing_stats::kMaxRoutes;
+      for (auto &route: state->routes) {
+        route.connections_total = n;
+        route.bytes_up = n;
+      }
+      writer.publish(*state);
+    }
+    done = true;
+  });
+
+  std::unique_ptr<Segment> copy(new Segment());
+  while (!done) {
+    if (!routing_stats::read_stats_segment(*shared, *copy)) continue;
+    const uint64_t n = copy->routes[0].connections_total;
+    for (const auto &route: copy->routes) {
+      ASSERT_EQ(n, route.connections_total);
+      ASSERT_EQ(n, route.bytes_up);
+    }
+  }
+  publisher.join();
+
+  ASSERT_TRUE(routing_stats::read_stats_segment(*shared, *copy));
+  EXPECT_EQ(20000u, copy->routes[routing_stats::kMaxRoutes - 1].connections_total);
+
+  ::munmap(const_cast<Segment *>(shared), sizeof(Segment));
+}
+#endif
@@ -34,6 +34,7 @@
 #include <string>
 #ifndef _WIN32
 # include <netinet/in.h>
+# include <netinet/tcp.h>
 #else
 # include <WinSock2.h>
 #endif
@@ -106,6 +107,139 @@ TEST_F(TestSetupTcpService, single_addr_ok) {
   ASSERT_NO_THROW(r.setup_tcp_service());
 }
 
+#ifdef SO_REUSEPORT
+TEST_F(TestSetupTcpService, reuseport_listeners_ok) {
+  MySQLRouting r(routing::RoutingStrategy::kFirstAvailable, 7001,
+                 Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                 "127.0.0.1", mysql_harness::Path(), "routing-name",
+                 1, std::chrono::seconds(1), 1, std::chrono::seconds(1), routing::kDefaultNetBufferLength,
+                 &routing_sock_ops);
+  r.set_acceptor_threads(3);
+
+  const auto addr_list = get_test_addresses_list(1);
+  EXPECT_CALL(socket_op, getaddrinfo(_, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>( addr_list ), Return(0)));
+
+  // one listener per acceptor thread, all bound with SO_REUSEPORT
+  EXPECT_CALL(socket_op, socket(_, _, _)).WillOnce(Return(1)).WillOnce(Return(2)).WillOnce(Return(3));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_REUSEADDR, _, _)).Times(3).WillRepeatedly(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_REUSEPORT, _, _)).Times(3).WillRepeatedly(Return(0));
+  EXPECT_CALL(socket_op, bind(_, _, _)).Times(3).WillRepeatedly(Return(0));
+  EXPECT_CALL(socket_op, listen(_, _)).Times(3).WillRepeatedly(Return(0));
+
+  EXPECT_CALL(socket_op, freeaddrinfo(_));
+
+  // those are called in the MySQLRouting destructor
+  EXPECT_CALL(socket_op, close(_)).Times(3);
+  EXPECT_CALL(socket_op, shutdown(_)).Times(3);
+
+  ASSERT_NO_THROW(r.setup_tcp_service());
+}
+#endif
+
+#ifdef __linux__
+TEST_F(TestSetupTcpService, listener_socket_options_ok) {
+  MySQLRouting r(routing::RoutingStrategy::kFirstAvailable, 7001,
+                 Protocol::Type::kXProtocol, routing::AccessMode::kReadWrite,
+                 "127.0.0.1", mysql_harness::Path(), "routing-name",
+                 1, std::chrono::seconds(1), 1, std::chrono::seconds(1), routing::kDefaultNetBufferLength,
+                 &routing_sock_ops);
+  routing::SocketOptions socket_options;
+  socket_options.tcp_fastopen = 16;
+  socket_options.tcp_defer_accept = 5;
+  socket_options.rcvbuf = 65536;
+  socket_options.sndbuf = 131072;
+  r.set_socket_options(socket_options);
+
+  const auto addr_list = get_test_addresses_list(1);
+  EXPECT_CALL(socket_op, getaddrinfo(_, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>( addr_list ), Return(0)));
+
+  EXPECT_CALL(socket_op, socket(_, _, _)).WillOnce(Return(1));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_REUSEADDR, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_RCVBUF, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_SNDBUF, _, _)).WillOnce(Return(0));
+  // a refused option doesn't stop the listener from being set up
+  EXPECT_CALL(socket_op, setsockopt(_, IPPROTO_TCP, TCP_FASTOPEN, _, _)).WillOnce(Return(-1));
+  EXPECT_CALL(socket_op, setsockopt(_, IPPROTO_TCP, TCP_DEFER_ACCEPT, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, bind(_, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, listen(_, _)).WillOnce(Return(0));
+
+  EXPECT_CALL(socket_op, freeaddrinfo(_));
+
+  // those are called in the MySQLRouting destructor
+  EXPECT_CALL(socket_op, close(_));
+  EXPECT_CALL(socket_op, shutdown(_));
+
+  ASSERT_NO_THROW(r.setup_tcp_service());
+}
+
+TEST_F(TestSetupTcpService, listener_keepalive_options_ok) {
+  MySQLRouting r(routing::RoutingStrategy::kFirstAvailable, 7001,
+                 Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                 "127.0.0.1", mysql_harness::Path(), "routing-name",
+                 1, std::chrono::seconds(1), 1, std::chrono::seconds(1), routing::kDefaultNetBufferLength,
+                 &routing_sock_ops);
+  routing::SocketOptions socket_options;
+  socket_options.keepalive = true;
+  socket_options.keepalive_idle = 10;
+  socket_options.keepalive_interval = 2;
+  socket_options.keepalive_count = 3;
+  socket_options.user_timeout = 15000;
+  r.set_socket_options(socket_options);
+
+  const auto addr_list = get_test_addresses_list(1);
+  EXPECT_CALL(socket_op, getaddrinfo(_, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>( addr_list ), Return(0)));
+
+  EXPECT_CALL(socket_op, socket(_, _, _)).WillOnce(Return(1));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_REUSEADDR, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, SOL_SOCKET, SO_KEEPALIVE, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, IPPROTO_TCP, TCP_KEEPIDLE, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, IPPROTO_TCP, TCP_KEEPINTVL, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, IPPROTO_TCP, TCP_KEEPCNT, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, setsockopt(_, IPPROTO_TCP, TCP_USER_TIMEOUT, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, bind(_, _, _)).WillOnce(Return(0));
+  EXPECT_CALL(socket_op, listen(_, _)).WillOnce(Return(0));
+
+  EXPECT_CALL(socket_op, freeaddrinfo(_));
+
+  // those are called in the MySQLRouting destructor
+  EXPECT_CALL(socket_op, close(_));
+  EXPECT_CALL(socket_op, shutdown(_));
+
+  ASSERT_NO_THROW(r.setup_tcp_service());
+}
+
+TEST_F(TestSetupTcpService, keepalive_timings_without_keepalive) {
+  MySQLRouting r(routing::RoutingStrategy::kFirstAvailable, 7001,
+                 Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                 "127.0.0.1", mysql_harness::Path(), "routing-name",
+                 1, std::chrono::seconds(1), 1, std::chrono::seconds(1), routing::kDefaultNetBufferLength,
+                 &routing_sock_ops);
+  routing::SocketOptions socket_options;
+  socket_options.keepalive_idle = 10;
+
+  ASSERT_THROW_LIKE(r.set_socket_options(socket_options),
+      std::invalid_argument,
+      "[routing-name] tcp_keepalive_idle, tcp_keepalive_interval and tcp_keepalive_count require tcp_keepalive");
+}
+
+TEST_F(TestSetupTcpService, defer_accept_classic_protocol) {
+  MySQLRouting r(routing::RoutingStrategy::kFirstAvailable, 7001,
+                 Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
+                 "127.0.0.1", mysql_harness::Path(), "routing-name",
+                 1, std::chrono::seconds(1), 1, std::chrono::seconds(1), routing::kDefaultNetBufferLength,
+                 &routing_sock_ops);
+  routing::SocketOptions socket_options;
+  socket_options.tcp_defer_accept = 5;
+
+  ASSERT_THROW_LIKE(r.set_socket_options(socket_options),
+      std::invalid_argument,
+      "[routing-name] tcp_defer_accept can't be used with the classic protocol");
+}
+#endif
+
 TEST_F(TestSetupTcpService, getaddrinfo_fails) {
   MySQLRouting r(routing::RoutingStrategy::kFirstAvailable, 7001,
                  Protocol::Type::kClassicProtocol, routing::AccessMode::kReadWrite,
@@ -0,0 +1,58 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "sharded_counter.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(TestShardedCounter, SumsAllThreads) {
+  ShardedCounter counter;
+  const int kThreads = static_cast<int>(ShardedCounter::kShards) + 3;
+  const int kIncrements = 1000;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&counter, kIncrements]() {
+      for (int c = 0; c < kIncrements; ++c) ++counter;
+    });
+  }
+  for (auto &thr: threads) thr.join();
+
+  EXPECT_EQ(kThreads * kIncrements, counter.load());
+}
+
+TEST(TestShardedCounter, DecrementOnOtherThread) {
+  ShardedCounter counter;
+
+  ++counter;
+  std::thread([&counter]() { --counter; }).join();
+  EXPECT_EQ(0, counter.load());
+
+  counter.add(1LL << 40);
+  EXPECT_EQ(1LL << 40, counter.load());
+}
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "socket_handoff.h"
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class TestSocketHandoff : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = "test_socket_handoff." + std::to_string(getpid()) + ".sock";
+  }
+
+  void TearDown() override {
+    ::unlink(path_.c_str());
+  }
+
+  static bool file_exists(const std::string &path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+  }
+
+  // TCP listener on a port of the loopback interface
+  static int make_listener(uint16_t &port) {
+    int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (sock == -1 || ::bind(sock, reinterpret_cast<struct sockaddr *>(&addr), addr_len) == -1 ||
+        ::listen(sock, 4) == -1 ||
+        ::getsockname(sock, reinterpret_cast<struct sockaddr *>(&addr), &addr_len) == -1) {
+      return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return sock;
+  }
+
+  static uint16_t get_port(int sock) {
+    struct sockaddr_in addr{};
+    socklen_t addr_len = sizeof(addr);
+    if (::getsockname(sock, reinterpret_cast<struct sockaddr *>(&addr), &addr_len) == -1) return 0;
+    return ntohs(addr.sin_port);
+  }
+
+  std::string path_;
+};
+
+TEST_F(TestSocketHandoff, NothingToTakeOver) {
+  SocketHandoff handoff(path_);
+  SocketHandoff::Listeners listeners;
+  EXPECT_FALSE(handoff.receive(listeners));
+  EXPECT_TRUE(listeners.tcp.empty());
+}
+
+TEST_F(TestSocketHandoff, HandsOverListeners) {
+  uint16_t port = 0;
+  int listener = make_listener(port);
+  ASSERT_NE(-1, listener);
+
+  SocketHandoff old_process(path_);
+  old_process.listen();
+  ASSERT_NE(-1, old_process.get_socket());
+
+  SocketHandoff::Listeners handed;
+  handed.tcp.push_back(listener);
+  std::thread server([&]() {
+    struct pollfd fds[] = {{old_process.get_socket(), POLLIN, 0}};
+    ASSERT_EQ(1, ::poll(fds, 1, 10000));
+    EXPECT_TRUE(old_process.serve(handed));
+  });
+
+  SocketHandoff new_process(path_);
+  SocketHandoff::Listeners taken;
+  ASSERT_TRUE(new_process.receive(taken));
+  server.join();
+  EXPECT_TRUE(old_process.has_handed_over());
+
+  ASSERT_EQ(1u, taken.tcp.size());
+  EXPECT_NE(listener, taken.tcp[0]);
+  EXPECT_EQ(port, get_port(taken.tcp[0]));
+  EXPECT_EQ(-1, taken.named_socket);
+
+  // still listening once the old process closed its copy
+  ::close(listener);
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  EXPECT_EQ(0, ::connect(client, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+  ::close(client);
+  ::close(taken.tcp[0]);
+}
+
+TEST_F(TestSocketHandoff, KeepsSocketFileOfNextProcess) {
+  SocketHandoff old_process(path_);
+  old_process.listen();
+
+  SocketHandoff new_process(path_);
+  new_process.listen();
+
+  old_process.close();
+  EXPECT_TRUE(file_exists(path_));
+
+  new_process.close();
+  EXPECT_FALSE(file_exists(path_));
+}
+#endif
@@ -0,0 +1,187 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "splice_forwarder.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <sys/eventfd.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifdef __linux__
+
+class TestSpliceForwarder : public testing::Test {
+public:
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, from_));
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, to_));
+  }
+
+  void TearDown() override {
+    for (int fd: {from_[0], from_[1], to_[0], to_[1]}) ::close(fd);
+  }
+
+  // data is written to from_[0] and forwarded from from_[1] to to_[1]
+  int from_[2];
+  int to_[2];
+};
+
+/**
+ * @test
+ *       Verify that data is moved from one socket to the other.
+ */
+TEST_F(TestSpliceForwarder, ForwardsData) {
+  SpliceForwarder forwarder;
+
+  const std::string data(10000, 'x');
+  ASSERT_EQ(static_cast<ssize_t>(data.size()), ::write(from_[0], data.data(), data.size()));
+
+  ssize_t forwarded = 0;
+  while (forwarded < static_cast<ssize_t>(data.size())) {
+    ssize_t res = forwarder.forward(from_[1], to_[1], 16384);
+    ASSERT_GT(res, 0);
+    forwarded += res;
+  }
+
+  std::string received(data.size(), '\0');
+  size_t got = 0;
+  while (got < received.size()) {
+    ssize_t res = ::read(to_[0], &received[got], received.size() - got);
+    ASSERT_GT(res, 0);
+    got += static_cast<size_t>(res);
+  }
+  EXPECT_EQ(data, received);
+  EXPECT_TRUE(forwarder.is_usable());
+}
+
+/**
+ * @test
+ *       Verify that a closed sender is reported with 0 and errno 0.
+ */
+TEST_F(TestSpliceForwarder, SenderClosed) {
+  SpliceForwarder forwarder;
+
+  ::shutdown(from_[0], SHUT_WR);
+  errno = EAGAIN;
+  EXPECT_EQ(0, forwarder.forward(from_[1], to_[1], 16384));
+  EXPECT_EQ(0, errno);
+  EXPECT_TRUE(forwarder.is_usable());
+}
+
+/**
+ * @test
+ *       Verify that a sender without anything to read is reported with
+ *       EAGAIN, and forwarding works once data arrives.
+ */
+TEST_F(TestSpliceForwarder, NothingToRead) {
+  SpliceForwarder forwarder;
+
+  EXPECT_EQ(-1, forwarder.forward(from_[1], to_[1], 16384));
+  EXPECT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+  EXPECT_TRUE(forwarder.is_usable());
+
+  ASSERT_EQ(3, ::write(from_[0], "abc", 3));
+  EXPECT_EQ(3, forwarder.forward(from_[1], to_[1], 16384));
+
+  char received[3];
+  ASSERT_EQ(3, ::read(to_[0], received, sizeof(received)));
+  EXPECT_EQ(0, std::memcmp("abc", received, sizeof(received)));
+}
+
+/**
+ * @test
+ *       Verify that forwarding to a receiver whose buffer is full waits
+ *       until it drains instead of failing, also if it is non-blocking.
+ */
+TEST_F(TestSpliceForwarder, FullReceiver) {
+  SpliceForwarder forwarder;
+
+  ASSERT_EQ(0, fcntl(to_[1], F_SETFL, fcntl(to_[1], F_GETFL) | O_NONBLOCK));
+  const std::string filler(4096, 'f');
+  size_t filled = 0;
+  while (true) {
+    ssize_t res = ::write(to_[1], filler.data(), filler.size());
+    if (res == -1) {
+      ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+      break;
+    }
+    filled += static_cast<size_t>(res);
+  }
+
+  const std::string data(10000, 'x');
+  ASSERT_EQ(static_cast<ssize_t>(data.size()), ::write(from_[0], data.data(), data.size()));
+
+  ssize_t forwarded = 0;
+  std::thread forwarding([&] {
+    while (forwarded < static_cast<ssize_t>(data.size())) {
+      ssize_t res = forwarder.forward(from_[1], to_[1], 16384);
+      if (res <= 0) break;
+      forwarded += res;
+    }
+  });
+
+  std::string received(filled + data.size(), '\0');
+  size_t got = 0;
+  while (got < received.size()) {
+    ssize_t res = ::read(to_[0], &received[got], received.size() - got);
+    ASSERT_GT(res, 0);
+    got += static_cast<size_t>(res);
+  }
+  forwarding.join();
+
+  EXPECT_EQ(static_cast<ssize_t>(data.size()), forwarded);
+  EXPECT_EQ(data, received.substr(filled));
+}
+
+/**
+ * @test
+ *       Verify that a sender not supporting splice() marks the forwarder as
+ *       not usable, so the caller falls back to copying.
+ */
+TEST_F(TestSpliceForwarder, UnsupportedSender) {
+  SpliceForwarder forwarder;
+
+  int efd = eventfd(1, 0);
+  ASSERT_NE(-1, efd);
+  EXPECT_EQ(-1, forwarder.forward(efd, to_[1], 16384));
+  EXPECT_FALSE(forwarder.is_usable());
+
+  // nothing was consumed from the sender
+  uint64_t value = 0;
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(value)), ::read(efd, &value, sizeof(value)));
+  EXPECT_EQ(1u, value);
+  ::close(efd);
+}
+
+#endif  // __linux__
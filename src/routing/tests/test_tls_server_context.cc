@@ -0,0 +1,467 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "tls_server_context.h"
+#include "connection.h"
+#include "context.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/classic_protocol.h"
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#ifdef HAVE_OPENSSL
+#  include <openssl/ssl.h>
+#  ifdef HAVE_YASSL
+using namespace yaSSL;
+#  endif
+#endif
+
+#ifndef _WIN32
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+namespace Capabilities = mysql_protocol::Capabilities;
+
+static const std::chrono::milliseconds kTimeout(5000);
+static const std::string kCertFile = std::string(ROUTING_TEST_CERT_DIR) + "server-cert.pem";
+static const std::string kKeyFile = std::string(ROUTING_TEST_CERT_DIR) + "server-key.pem";
+
+static const RoutingProtocolBuffer kOkPacket = {0x07, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+
+/** @brief returns server greeting with the given capabilities */
+static RoutingProtocolBuffer make_greeting(uint32_t caps) {
+  RoutingProtocolBuffer payload{10, '8', '.', '0', 0, 0x01, 0x00, 0x00, 0x00};
+  payload.insert(payload.end(), 8, 'a');
+  payload.push_back(0);
+  payload.push_back(static_cast<uint8_t>(caps));
+  payload.push_back(static_cast<uint8_t>(caps >> 8));
+  payload.push_back(0x21);
+  payload.push_back(0x02);
+  payload.push_back(0x00);
+  payload.push_back(static_cast<uint8_t>(caps >> 16));
+  payload.push_back(static_cast<uint8_t>(caps >> 24));
+  payload.push_back(21);
+  payload.insert(payload.end(), 10, 0);
+  payload.insert(payload.end(), 12, 'b');
+  payload.push_back(0);
+  const std::string plugin("mysql_native_password");
+  payload.insert(payload.end(), plugin.begin(), plugin.end());
+  payload.push_back(0);
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload.size()), 0, 0, 0};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+/** @brief returns SSL request or the start of a handshake response with the given sequence id */
+static RoutingProtocolBuffer make_ssl_request(uint32_t caps, uint8_t seq_id) {
+  RoutingProtocolBuffer packet{32, 0, 0, seq_id,
+      static_cast<uint8_t>(caps), static_cast<uint8_t>(caps >> 8),
+      static_cast<uint8_t>(caps >> 16), static_cast<uint8_t>(caps >> 24),
+      0x00, 0x00, 0x00, 0x01, 0x21};
+  packet.insert(packet.end(), 23, 0);
+  return packet;
+}
+
+TEST(ClassicHandshakeTls, OfferSsl) {
+  const uint32_t caps = (Capabilities::PROTOCOL_41 | Capabilities::SECURE_CONNECTION | Capabilities::PLUGIN_AUTH).bits();
+  RoutingProtocolBuffer packet = make_greeting(caps);
+  ASSERT_TRUE(classic_handshake::offer_ssl(packet));
+  EXPECT_EQ(make_greeting(caps | Capabilities::SSL.bits()), packet);
+
+  RoutingProtocolBuffer error{0x05, 0x00, 0x00, 0x00, 0xff, 0x10, 0x04, 'x', 'y'};
+  EXPECT_FALSE(classic_handshake::offer_ssl(error));
+}
+
+TEST(ClassicHandshakeTls, SslRequest) {
+  const uint32_t caps = (Capabilities::PROTOCOL_41 | Capabilities::SECURE_CONNECTION | Capabilities::PLUGIN_AUTH).bits();
+  EXPECT_TRUE(classic_handshake::is_ssl_request(make_ssl_request(caps | Capabilities::SSL.bits(), 1)));
+  EXPECT_FALSE(classic_handshake::is_ssl_request(make_ssl_request(caps, 1)));
+
+  // a handshake response is longer
+  RoutingProtocolBuffer response = make_ssl_request(caps | Capabilities::SSL.bits(), 2);
+  response.push_back('u');
+  response.push_back(0);
+  response[0] = static_cast<uint8_t>(response.size() - 4);
+  EXPECT_FALSE(classic_handshake::is_ssl_request(response));
+
+  classic_handshake::strip_ssl_request(response);
+  RoutingProtocolBuffer expected = make_ssl_request(caps, 2);
+  expected.push_back('u');
+  expected.push_back(0);
+  expected[0] = static_cast<uint8_t>(expected.size() - 4);
+  EXPECT_EQ(expected, response);
+}
+
+TEST(TlsServerContext, MissingCertificate) {
+  ASSERT_THROW(TlsServerContext("does-not-exist.pem", kKeyFile), std::runtime_error);
+}
+
+#if defined(HAVE_OPENSSL) && !defined(_WIN32)
+
+/** @brief client side of a TLS connection, without verifying the server */
+class TlsClient {
+public:
+  /**
+   * @param old_versions_only offer only the TLS versions below the one the
+   *        router requires, TLSv1.2 or TLSv1.1 with yaSSL
+   */
+  explicit TlsClient(bool old_versions_only = false): ctx_(new_context(old_versions_only)) {
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, nullptr);
+  }
+
+  ~TlsClient() {
+    if (ssl_) SSL_free(ssl_);
+    SSL_CTX_free(ctx_);
+  }
+
+  /**
+   * @param resume resume the session of the previous connection
+   */
+  bool connect(int sock, bool resume = false) {
+    // the session is gone with its connection unless referenced
+    SSL_SESSION *session = resume && ssl_ ? SSL_get1_session(ssl_) : nullptr;
+    if (ssl_) SSL_free(ssl_);
+    ssl_ = SSL_new(ctx_);
+    SSL_set_fd(ssl_, sock);
+    if (session) {
+      SSL_set_session(ssl_, session);
+      SSL_SESSION_free(session);
+    }
+    return SSL_connect(ssl_) == 1;
+  }
+
+  bool write(const RoutingProtocolBuffer &packet) {
+    return SSL_write(ssl_, packet.data(), static_cast<int>(packet.size())) == static_cast<int>(packet.size());
+  }
+
+  bool read(RoutingProtocolBuffer &packet, size_t size) {
+    packet.resize(size);
+    size_t done = 0;
+    while (done < size) {
+      const int res = SSL_read(ssl_, &packet[done], static_cast<int>(size - done));
+      if (res <= 0) return false;
+      done += static_cast<size_t>(res);
+    }
+    return true;
+  }
+
+  void shutdown() { SSL_shutdown(ssl_); }
+
+  bool is_resumed() { return SSL_session_reused(ssl_) == 1; }
+
+private:
+  static SSL_CTX *new_context(bool old_versions_only) {
+    if (!old_versions_only) return SSL_CTX_new(SSLv23_client_method());
+
+#if defined(HAVE_YASSL)
+    return SSL_CTX_new(TLSv1_client_method());
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L
+    return SSL_CTX_new(TLSv1_1_client_method());
+#else
+    SSL_CTX *ctx = SSL_CTX_new(SSLv23_client_method());
+    SSL_CTX_set_max_proto_version(ctx, TLS1_1_VERSION);
+    // newer OpenSSL refuses TLSv1.1 itself at the default security level
+    SSL_CTX_set_security_level(ctx, 0);
+    return ctx;
+#endif
+  }
+
+  SSL_CTX *ctx_;
+  SSL *ssl_{nullptr};
+};
+
+/**
+ * @test
+ *       Verify that a client reconnecting with its session skips the full
+ *       handshake.
+ */
+TEST(TlsServerContext, ResumesSession) {
+#ifdef HAVE_YASSL
+  // yaSSL keeps the sessions of clients and servers in one cache per
+  // process, the client and the server of the test share their entries
+  const bool resumes = false;
+#else
+  const bool resumes = true;
+#endif
+  TlsServerContext context(kCertFile, kKeyFile);
+  TlsClient client;
+
+  for (int i = 0; i < 2; ++i) {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+    bool server_resumed = false;
+    std::thread server([&context, &fds, &server_resumed] {
+      TlsServerContext::Session tls(context);
+      if (tls.accept(fds[1], kTimeout)) {
+        server_resumed = tls.is_resumed();
+        RoutingProtocolBuffer packet;
+        if (tls.read_packet(packet, kTimeout)) tls.write_all(packet.data(), packet.size());
+        tls.shutdown();
+      }
+      // the client doesn't hang in the handshake if it failed
+      ::shutdown(fds[1], SHUT_RDWR);
+    });
+
+    const RoutingProtocolBuffer ping{0x01, 0x00, 0x00, 0x00, 0x0e};
+    RoutingProtocolBuffer packet;
+    const bool connected = client.connect(fds[0], resumes && i == 1);
+    const bool echoed = connected && client.write(ping) && client.read(packet, ping.size());
+    server.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    ASSERT_TRUE(connected);
+    ASSERT_TRUE(echoed);
+    EXPECT_EQ(ping, packet);
+    EXPECT_EQ(resumes && i == 1, client.is_resumed());
+    EXPECT_EQ(resumes && i == 1, server_resumed);
+  }
+
+  EXPECT_EQ(2u, context.get_stats().handshakes);
+  EXPECT_EQ(resumes ? 1u : 0u, context.get_stats().resumed);
+}
+
+/**
+ * @test
+ *       Verify that clients only offering TLS versions before TLSv1.2 are
+ *       refused.
+ */
+TEST(TlsServerContext, RefusesOldTlsVersions) {
+  TlsServerContext context(kCertFile, kKeyFile);
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  bool accepted = true;
+  std::thread server([&context, &fds, &accepted] {
+    TlsServerContext::Session tls(context);
+    accepted = tls.accept(fds[1], kTimeout);
+    // the client doesn't wait for an alert the server may not send
+    ::shutdown(fds[1], SHUT_RDWR);
+  });
+
+  TlsClient client(true);
+  EXPECT_FALSE(client.connect(fds[0]));
+  server.join();
+  EXPECT_FALSE(accepted);
+  EXPECT_EQ(0u, context.get_stats().handshakes);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+/**
+ * @test
+ *       Verify that reading the packet following the TLS handshake times
+ *       out on a client that doesn't send it.
+ */
+TEST(TlsServerContext, ReadPacketTimesOut) {
+  TlsServerContext context(kCertFile, kKeyFile);
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  bool accepted = false;
+  bool read_ok = true;
+  std::thread server([&context, &fds, &accepted, &read_ok] {
+    TlsServerContext::Session tls(context);
+    accepted = tls.accept(fds[1], kTimeout);
+    if (!accepted) return;
+    RoutingProtocolBuffer packet;
+    read_ok = tls.read_packet(packet, std::chrono::milliseconds(100));
+  });
+
+  TlsClient client;
+  ASSERT_TRUE(client.connect(fds[0]));
+  const auto start = std::chrono::steady_clock::now();
+  server.join();
+  EXPECT_TRUE(accepted);
+  EXPECT_FALSE(read_ok);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, kTimeout);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+/** @brief connects a pair of TCP sockets over loopback, kernel TLS needs TCP */
+static bool tcp_socketpair(int fds[2]) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  const bool ok = listener >= 0 &&
+      bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+      listen(listener, 1) == 0 &&
+      getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_len) == 0 &&
+      (fds[0] = socket(AF_INET, SOCK_STREAM, 0)) >= 0 &&
+      connect(fds[0], reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+      (fds[1] = accept(listener, nullptr, nullptr)) >= 0;
+  if (listener >= 0) ::close(listener);
+  return ok;
+}
+
+/**
+ * @test
+ *       Verify that sessions work with kernel TLS enabled, whether or not
+ *       the kernel takes them over, and the ones the kernel decrypts can
+ *       be read from the socket.
+ */
+TEST(TlsServerContext, KernelTls) {
+  TlsServerContext context(kCertFile, kKeyFile);
+  if (!TlsServerContext::is_kernel_tls_supported()) {
+    ASSERT_THROW(context.set_kernel_tls(true), std::runtime_error);
+    return;
+  }
+  context.set_kernel_tls(true);
+
+  int fds[2];
+  ASSERT_TRUE(tcp_socketpair(fds));
+
+  bool kernel_send = false;
+  bool kernel_recv = false;
+  RoutingProtocolBuffer received;
+  std::thread server([&context, &fds, &kernel_send, &kernel_recv, &received] {
+    TlsServerContext::Session tls(context);
+    if (!tls.accept(fds[1], kTimeout)) return;
+    kernel_send = tls.is_kernel_send();
+    kernel_recv = tls.is_kernel_recv();
+    if (kernel_recv && !tls.has_pending()) {
+      received.resize(5);
+      if (::read(fds[1], &received[0], received.size()) != 5) return;
+    } else if (!tls.read_packet(received, kTimeout)) {
+      return;
+    }
+    tls.write_all(received.data(), received.size());
+  });
+
+  TlsClient client;
+  ASSERT_TRUE(client.connect(fds[0]));
+  const RoutingProtocolBuffer ping{0x01, 0x00, 0x00, 0x00, 0x0e};
+  ASSERT_TRUE(client.write(ping));
+  RoutingProtocolBuffer packet;
+  ASSERT_TRUE(client.read(packet, ping.size()));
+  EXPECT_EQ(ping, packet);
+  server.join();
+  EXPECT_EQ(ping, received);
+
+  EXPECT_EQ(kernel_send ? 1u : 0u, context.get_stats().kernel_send);
+  EXPECT_EQ(kernel_recv ? 1u : 0u, context.get_stats().kernel_recv);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+/**
+ * @test
+ *       Verify that the router offers TLS in the greeting of the server,
+ *       terminates TLS of the client and talks plain text to the server.
+ */
+TEST(TlsServerContext, TerminatesClientTls) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  TlsServerContext tls_context(kCertFile, kKeyFile);
+  MySQLRoutingContext context(
+      new ClassicProtocol(routing::RoutingSockOps::instance(so)),
+      so, "routing_name",
+      routing::kDefaultNetBufferLength, kTimeout, kTimeout,
+      mysql_harness::TCPAddress(), mysql_harness::Path(), 100,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  context.set_client_tls_context(&tls_context);
+
+  int client_fds[2];
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  sockaddr_storage client_addr;
+  memset(&client_addr, 0, sizeof(client_addr));
+  client_addr.ss_family = AF_INET;
+
+  const int server = server_fds[1];
+  MySQLRoutingConnection connection(
+      context, client_fds[1], client_addr, routing::kInvalidSocket,
+      mysql_harness::TCPAddress(),
+      [](MySQLRoutingConnection*) {},
+      [server](mysql_harness::TCPAddress& address) {
+        address = mysql_harness::TCPAddress("127.0.0.1", 3306);
+        return server;
+      });
+  std::thread thread([&connection] { connection.run(); });
+
+  const uint32_t caps = (Capabilities::PROTOCOL_41 | Capabilities::SECURE_CONNECTION | Capabilities::PLUGIN_AUTH).bits();
+  RoutingProtocolBuffer packet;
+  ASSERT_EQ(static_cast<ssize_t>(make_greeting(caps).size()),
+            ::write(server_fds[0], make_greeting(caps).data(), make_greeting(caps).size()));
+  ASSERT_TRUE(classic_handshake::read_packet(so, client_fds[0], packet, kTimeout));
+  EXPECT_EQ(make_greeting(caps | Capabilities::SSL.bits()), packet);
+
+  const RoutingProtocolBuffer ssl_request = make_ssl_request(caps | Capabilities::SSL.bits(), 1);
+  ASSERT_EQ(static_cast<ssize_t>(ssl_request.size()),
+            ::write(client_fds[0], ssl_request.data(), ssl_request.size()));
+  TlsClient client;
+  ASSERT_TRUE(client.connect(client_fds[0]));
+
+  // the server sees the handshake response without SSL, one sequence id lower
+  ASSERT_TRUE(client.write(make_ssl_request(caps | Capabilities::SSL.bits(), 2)));
+  ASSERT_TRUE(classic_handshake::read_packet(so, server_fds[0], packet, kTimeout));
+  EXPECT_EQ(make_ssl_request(caps, 1), packet);
+
+  ASSERT_EQ(static_cast<ssize_t>(kOkPacket.size()), ::write(server_fds[0], kOkPacket.data(), kOkPacket.size()));
+  ASSERT_TRUE(client.read(packet, kOkPacket.size()));
+  RoutingProtocolBuffer ok = kOkPacket;
+  ok[3] = 3;
+  EXPECT_EQ(ok, packet);
+
+  // commands and results pass unchanged
+  const RoutingProtocolBuffer ping{0x01, 0x00, 0x00, 0x00, 0x0e};
+  ASSERT_TRUE(client.write(ping));
+  ASSERT_TRUE(classic_handshake::read_packet(so, server_fds[0], packet, kTimeout));
+  EXPECT_EQ(ping, packet);
+  RoutingProtocolBuffer pong = kOkPacket;
+  pong[3] = 1;
+  ASSERT_EQ(static_cast<ssize_t>(pong.size()), ::write(server_fds[0], pong.data(), pong.size()));
+  ASSERT_TRUE(client.read(packet, pong.size()));
+  EXPECT_EQ(pong, packet);
+
+  // the router answers the close_notify of the client
+  client.shutdown();
+  thread.join();
+  ::close(client_fds[0]);
+  ::close(server_fds[0]);
+  EXPECT_EQ(1u, tls_context.get_stats().handshakes);
+}
+
+#endif  // HAVE_OPENSSL && !_WIN32
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
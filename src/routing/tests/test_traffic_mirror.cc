@@ -0,0 +1,331 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "traffic_mirror.h"
+
+#include "keyring/keyring_manager.h"
+#include "mysqlrouter/mysql_protocol.h"
+#include "protocol/classic_handshake.h"
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+using namespace mysql_protocol::Capabilities;
+
+static const std::chrono::milliseconds kTimeout(5000);
+static const size_t kBufferSize = 1024 * 1024;
+
+static const RoutingProtocolBuffer kOkPacket = {0x07, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00};
+
+/** @brief returns server greeting with the given scramble */
+static RoutingProtocolBuffer make_greeting(uint8_t scramble_byte) {
+  const uint32_t caps = (PROTOCOL_41 | SECURE_CONNECTION | PLUGIN_AUTH).bits();
+  RoutingProtocolBuffer payload{10, '8', '.', '0', 0, 0x01, 0x00, 0x00, 0x00};
+  payload.insert(payload.end(), 8, scramble_byte);
+  payload.push_back(0);
+  payload.push_back(static_cast<uint8_t>(caps));
+  payload.push_back(static_cast<uint8_t>(caps >> 8));
+  payload.push_back(0x21);
+  payload.push_back(0x02);
+  payload.push_back(0x00);
+  payload.push_back(static_cast<uint8_t>(caps >> 16));
+  payload.push_back(static_cast<uint8_t>(caps >> 24));
+  payload.push_back(21);
+  payload.insert(payload.end(), 10, 0);
+  payload.insert(payload.end(), 12, scramble_byte);
+  payload.push_back(0);
+  const std::string plugin("mysql_native_password");
+  payload.insert(payload.end(), plugin.begin(), plugin.end());
+  payload.push_back(0);
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload.size()), 0, 0, 0};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+/** @brief returns handshake response of user with 20 bytes auth-response */
+static RoutingProtocolBuffer make_handshake_response(const std::string &user, uint32_t capabilities) {
+  RoutingProtocolBuffer payload{
+      static_cast<uint8_t>(capabilities), static_cast<uint8_t>(capabilities >> 8),
+      static_cast<uint8_t>(capabilities >> 16), static_cast<uint8_t>(capabilities >> 24),
+      0x00, 0x00, 0x00, 0x01, 0x21};
+  payload.insert(payload.end(), 23, 0);
+  payload.insert(payload.end(), user.begin(), user.end());
+  payload.push_back(0);
+  payload.push_back(20);
+  payload.insert(payload.end(), 20, 0x61);
+  const std::string plugin("mysql_native_password");
+  payload.insert(payload.end(), plugin.begin(), plugin.end());
+  payload.push_back(0);
+
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload.size()), 0, 0, 1};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+/** @brief returns COM_QUERY packet of the statement */
+static RoutingProtocolBuffer make_query(const std::string &statement) {
+  const size_t payload_size = statement.size() + 1;
+  RoutingProtocolBuffer packet{static_cast<uint8_t>(payload_size), static_cast<uint8_t>(payload_size >> 8),
+                               static_cast<uint8_t>(payload_size >> 16), 0, 0x03};
+  packet.insert(packet.end(), statement.begin(), statement.end());
+  return packet;
+}
+
+static const uint32_t kClientCapabilities = (PROTOCOL_41 | SECURE_CONNECTION | PLUGIN_AUTH).bits();
+
+/**
+ * @brief listens for the mirror on a port of 127.0.0.1, as the shadow server
+ */
+class TestTrafficMirror : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    so_ = mysql_harness::SocketOperations::instance();
+    mysql_harness::init_keyring_with_key("test_traffic_mirror.keyring", "secret", true);
+    mysql_harness::get_keyring()->store("u", "password", "secret");
+
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listener_, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, ::bind(listener_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listener_, 4));
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0, ::getsockname(listener_, reinterpret_cast<sockaddr*>(&addr), &addr_len));
+    port_ = ntohs(addr.sin_port);
+  }
+
+  void TearDown() override {
+    if (shadow_ >= 0) ::close(shadow_);
+    ::close(listener_);
+    mysql_harness::reset_keyring();
+    std::remove("test_traffic_mirror.keyring");
+  }
+
+  std::shared_ptr<TrafficMirror> make_mirror(size_t buffer_size, bool replay_timing = false) {
+    std::shared_ptr<TrafficMirror> mirror = std::make_shared<TrafficMirror>(
+        so_, mysql_harness::TCPAddress("127.0.0.1", port_), buffer_size, replay_timing, kTimeout);
+    mirror->start("routing_name", mysql_harness::kDefaultStackSizeInKiloBytes);
+    return mirror;
+  }
+
+  /** @brief accepts the session of the mirror and lets it authenticate */
+  void accept_session() {
+    shadow_ = ::accept(listener_, nullptr, nullptr);
+    ASSERT_GE(shadow_, 0);
+
+    const RoutingProtocolBuffer greeting = make_greeting(0x41);
+    write_packet(greeting);
+    RoutingProtocolBuffer packet;
+    ASSERT_TRUE(read_packet(packet));
+    classic_handshake::ClientHandshake handshake;
+    ASSERT_TRUE(classic_handshake::parse_handshake_response(packet, handshake));
+    EXPECT_EQ("u", handshake.username);
+    const std::vector<uint8_t> token =
+        classic_handshake::make_native_password_token("secret", std::vector<uint8_t>(20, 0x41));
+    // the auth-response starts with its length
+    EXPECT_EQ(token, std::vector<uint8_t>(packet.begin() + static_cast<long>(handshake.auth_response_begin) + 1,
+                                          packet.begin() + static_cast<long>(handshake.auth_response_end)));
+    write_packet(kOkPacket);
+  }
+
+  bool read_packet(RoutingProtocolBuffer &packet) {
+    return classic_handshake::read_packet(so_, shadow_, packet, kTimeout);
+  }
+
+  void write_packet(const RoutingProtocolBuffer &packet) {
+    ASSERT_EQ(static_cast<ssize_t>(packet.size()), ::write(shadow_, packet.data(), packet.size()));
+  }
+
+  /** @brief true once the mirror closed the session */
+  bool wait_for_close() {
+    uint8_t byte;
+    return classic_handshake::read_bytes(so_, shadow_, &byte, 1, kTimeout) == false && errno == 0;
+  }
+
+  mysql_harness::SocketOperationsBase *so_;
+  int listener_{-1};
+  int shadow_{-1};
+  uint16_t port_{0};
+};
+
+/**
+ * @test
+ *       Verify that the commands of the client are sent to the shadow
+ *       server once it authenticated as the same user, that its responses
+ *       are discarded and that the session ends with the connection.
+ */
+TEST_F(TestTrafficMirror, MirrorsCommandsAfterAuthenticating) {
+  std::shared_ptr<TrafficMirror> mirror = make_mirror(kBufferSize);
+  std::unique_ptr<TrafficMirror::Session> session =
+      mirror->open_session(make_handshake_response("u", kClientCapabilities));
+  ASSERT_NE(nullptr, session);
+
+  const RoutingProtocolBuffer query = make_query("SELECT 1");
+  // copied before the session got authenticated, one split across two reads
+  session->client_data(query.data(), query.size());
+  session->client_data(query.data(), 6);
+  session->client_data(query.data() + 6, query.size() - 6);
+
+  accept_session();
+  RoutingProtocolBuffer packet;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(read_packet(packet));
+    EXPECT_EQ(query, packet);
+    write_packet({0x07, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00});
+  }
+
+  session.reset();
+  EXPECT_TRUE(wait_for_close());
+
+  TrafficMirror::Stats stats = mirror->get_stats();
+  EXPECT_EQ(1u, stats.sessions);
+  EXPECT_EQ(0u, stats.failed);
+  EXPECT_EQ(2 * query.size(), stats.bytes_sent);
+  EXPECT_EQ(0u, stats.bytes_dropped);
+}
+
+/**
+ * @test
+ *       Verify that commands that don't fit into the ring are dropped as a
+ *       whole, without blocking, while the shadow server doesn't read.
+ */
+TEST_F(TestTrafficMirror, DropsCommandsThatDontFit) {
+  std::shared_ptr<TrafficMirror> mirror = make_mirror(4096);
+  std::unique_ptr<TrafficMirror::Session> session =
+      mirror->open_session(make_handshake_response("u", kClientCapabilities));
+  ASSERT_NE(nullptr, session);
+
+  const RoutingProtocolBuffer large = make_query("SELECT '" + std::string(4000, 'x') + "'");
+  const RoutingProtocolBuffer small = make_query("SELECT 1");
+  session->client_data(large.data(), large.size());
+  // split, its header comes with the first read
+  session->client_data(large.data(), 10);
+  session->client_data(large.data() + 10, large.size() - 10);
+  session->client_data(small.data(), small.size());
+
+  accept_session();
+  RoutingProtocolBuffer packet;
+  ASSERT_TRUE(read_packet(packet));
+  EXPECT_EQ(large, packet);
+  ASSERT_TRUE(read_packet(packet));
+  EXPECT_EQ(small, packet);
+
+  session.reset();
+  EXPECT_TRUE(wait_for_close());
+
+  TrafficMirror::Stats stats = mirror->get_stats();
+  EXPECT_EQ(large.size() + small.size(), stats.bytes_sent);
+  EXPECT_EQ(large.size(), stats.bytes_dropped);
+}
+
+/**
+ * @test
+ *       Verify that the gaps between the reads of the client are kept
+ *       with replay_timing.
+ */
+TEST_F(TestTrafficMirror, ReplaysTiming) {
+  std::shared_ptr<TrafficMirror> mirror = make_mirror(kBufferSize, true);
+  std::unique_ptr<TrafficMirror::Session> session =
+      mirror->open_session(make_handshake_response("u", kClientCapabilities));
+  ASSERT_NE(nullptr, session);
+
+  const RoutingProtocolBuffer query = make_query("SELECT 1");
+  session->client_data(query.data(), query.size());
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  session->client_data(query.data(), query.size());
+
+  accept_session();
+  RoutingProtocolBuffer packet;
+  ASSERT_TRUE(read_packet(packet));
+  const auto first = std::chrono::steady_clock::now();
+  ASSERT_TRUE(read_packet(packet));
+  EXPECT_GE(std::chrono::steady_clock::now() - first, std::chrono::milliseconds(150));
+}
+
+/**
+ * @test
+ *       Verify that clients using TLS or whose password is not in the
+ *       keyring are not mirrored.
+ */
+TEST_F(TestTrafficMirror, SkipsUnsupportedClients) {
+  std::shared_ptr<TrafficMirror> mirror = make_mirror(kBufferSize);
+
+  EXPECT_EQ(nullptr, mirror->open_session(make_handshake_response("other", kClientCapabilities)));
+  EXPECT_EQ(nullptr, mirror->open_session(make_handshake_response("u", kClientCapabilities | SSL.bits())));
+  EXPECT_EQ(nullptr, mirror->open_session(RoutingProtocolBuffer{0x01, 0x00, 0x00, 0x01, 0x00}));
+}
+
+/**
+ * @test
+ *       Verify that a session whose shadow server refuses the user is
+ *       counted as failed and its commands as dropped.
+ */
+TEST_F(TestTrafficMirror, CountsFailedSessions) {
+  std::shared_ptr<TrafficMirror> mirror = make_mirror(kBufferSize);
+  std::unique_ptr<TrafficMirror::Session> session =
+      mirror->open_session(make_handshake_response("u", kClientCapabilities));
+  ASSERT_NE(nullptr, session);
+
+  shadow_ = ::accept(listener_, nullptr, nullptr);
+  ASSERT_GE(shadow_, 0);
+  write_packet(make_greeting(0x41));
+  RoutingProtocolBuffer packet;
+  ASSERT_TRUE(read_packet(packet));
+  write_packet({0x09, 0x00, 0x00, 0x02, 0xff, 0x15, 0x04, '#', '2', '8', '0', '0', '0'});
+  EXPECT_TRUE(wait_for_close());
+
+  const RoutingProtocolBuffer query = make_query("SELECT 1");
+  session->client_data(query.data(), query.size());
+
+  TrafficMirror::Stats stats = mirror->get_stats();
+  EXPECT_EQ(0u, stats.sessions);
+  EXPECT_EQ(1u, stats.failed);
+  EXPECT_EQ(query.size(), stats.bytes_dropped);
+}
+
+#endif // _WIN32
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
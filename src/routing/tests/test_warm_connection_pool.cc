@@ -0,0 +1,188 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "warm_connection_pool.h"
+
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+using std::chrono::milliseconds;
+
+/**
+ * @brief connects to "servers" by creating socket pairs, keeping the peer ends
+ */
+class TestWarmConnectionPool : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    for (int sock: peers_) close(sock);
+  }
+
+  WarmConnectionPool::ConnectFunction connect_function() {
+    return [this](const mysql_harness::TCPAddress &) {
+      if (refuse_) return -1;
+      int fds[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return -1;
+      std::lock_guard<std::mutex> lock(mtx_);
+      peers_.push_back(fds[1]);
+      return fds[0];
+    };
+  }
+
+  size_t connects() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return peers_.size();
+  }
+
+  int peer(size_t ndx) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return peers_.at(ndx);
+  }
+
+  /** @brief waits until the pool connected that many sockets */
+  bool wait_for_connects(size_t count) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (connects() < count) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::sleep_for(milliseconds(5));
+    }
+    // stored right after connecting, let the pool thread get there
+    std::this_thread::sleep_for(milliseconds(20));
+    return true;
+  }
+
+  /** @brief true if the pool closed the socket of the peer */
+  static bool is_closed_by_pool(int peer_sock) {
+    struct pollfd fds[] = {{peer_sock, POLLIN, 0}};
+    if (poll(fds, 1, 1000) != 1) return false;
+    char c;
+    return read(peer_sock, &c, 1) == 0;
+  }
+
+  mysql_harness::SocketOperationsBase *sock_ops_ = mysql_harness::SocketOperations::instance();
+  const mysql_harness::TCPAddress server_{"127.0.0.1", 3306};
+  std::atomic<bool> refuse_{false};
+
+ private:
+  std::mutex mtx_;
+  std::vector<int> peers_;
+};
+
+/**
+ * @test
+ *       Verify that the first client warms the server up and the following
+ *       ones take the connected sockets, which get replaced.
+ */
+TEST_F(TestWarmConnectionPool, TakeWarmsUpServer) {
+  WarmConnectionPool pool(sock_ops_, connect_function(), 2, milliseconds(60000));
+  pool.start("test", mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  EXPECT_EQ(-1, pool.take(server_));
+  ASSERT_TRUE(wait_for_connects(2));
+
+  int sock = pool.take(server_);
+  ASSERT_GE(sock, 0);
+  sock_ops_->close(sock);
+  EXPECT_TRUE(wait_for_connects(3));
+
+  WarmConnectionPool::Stats stats = pool.get_stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+}
+
+/**
+ * @test
+ *       Verify that sockets older than max_age get closed unused and replaced.
+ */
+TEST_F(TestWarmConnectionPool, ClosesExpired) {
+  WarmConnectionPool pool(sock_ops_, connect_function(), 1, milliseconds(100));
+  pool.start("test", mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  EXPECT_EQ(-1, pool.take(server_));
+  ASSERT_TRUE(wait_for_connects(1));
+  EXPECT_TRUE(is_closed_by_pool(peer(0)));
+  EXPECT_TRUE(wait_for_connects(2));
+  EXPECT_GE(pool.get_stats().expired, 1u);
+}
+
+/**
+ * @test
+ *       Verify that sockets the server closed meanwhile are not handed out.
+ */
+TEST_F(TestWarmConnectionPool, SkipsClosedByServer) {
+  WarmConnectionPool pool(sock_ops_, connect_function(), 1, milliseconds(60000));
+  pool.start("test", mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  EXPECT_EQ(-1, pool.take(server_));
+  ASSERT_TRUE(wait_for_connects(1));
+
+  // no more connects, the pool is empty once the closed socket is skipped
+  refuse_ = true;
+  shutdown(peer(0), SHUT_RDWR);
+  EXPECT_EQ(-1, pool.take(server_));
+  EXPECT_EQ(2u, pool.get_stats().misses);
+}
+
+/**
+ * @test
+ *       Verify that sockets of servers no longer allowed get closed.
+ */
+TEST_F(TestWarmConnectionPool, RemoveNotAllowed) {
+  WarmConnectionPool pool(sock_ops_, connect_function(), 1, milliseconds(60000));
+  pool.start("test", mysql_harness::kDefaultStackSizeInKiloBytes);
+
+  EXPECT_EQ(-1, pool.take(server_));
+  ASSERT_TRUE(wait_for_connects(1));
+
+  pool.remove_not_allowed({mysql_harness::TCPAddress("127.0.0.1", 3307)});
+  EXPECT_TRUE(is_closed_by_pool(peer(0)));
+
+  // not warmed up anymore
+  std::this_thread::sleep_for(WarmConnectionPool::kRefillInterval * 2);
+  EXPECT_EQ(1u, connects());
+}
+
+#endif
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <map>
+#include <vector>
+
+#include "dest_weighted_round_robin.h"
+#include "test/helpers.h"
+
+#include "tcp_address.h"
+#include "routing_mocks.h"
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+
+using mysql_harness::TCPAddress;
+using ::testing::ElementsAre;
+
+class WeightedRoundRobinDestinationTest : public ::testing::Test {
+protected:
+  MockRoutingSockOps mock_routing_sock_ops_;
+
+  std::vector<int> pick(DestWeightedRoundRobin& dest, size_t count) {
+    int error;
+    std::vector<int> result;
+    for (size_t i = 0; i < count; ++i) {
+      result.push_back(dest.get_server_socket(std::chrono::milliseconds::zero(), &error));
+    }
+    return result;
+  }
+};
+
+
+TEST_F(WeightedRoundRobinDestinationTest, SmoothSchedule)
+{
+  DestWeightedRoundRobin dest({5, 1, 1}, Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  EXPECT_THAT(pick(dest, 7), ElementsAre(11, 11, 12, 11, 13, 11, 11));
+}
+
+TEST_F(WeightedRoundRobinDestinationTest, SharesFollowWeights)
+{
+  DestWeightedRoundRobin dest({4, 2, 2}, Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  std::map<int, size_t> picked;
+  for (auto server : pick(dest, 400)) ++picked[server];
+
+  EXPECT_EQ(200u, picked[11]);
+  EXPECT_EQ(100u, picked[12]);
+  EXPECT_EQ(100u, picked[13]);
+}
+
+TEST_F(WeightedRoundRobinDestinationTest, MissingWeightsAreOne)
+{
+  DestWeightedRoundRobin dest({2}, Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+
+  EXPECT_EQ(2u, dest.get_weight(0));
+  EXPECT_EQ(1u, dest.get_weight(1));
+}
+
+TEST_F(WeightedRoundRobinDestinationTest, RemoveKeepsWeights)
+{
+  DestWeightedRoundRobin dest({3, 1, 2}, Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+  dest.add("13", 1);
+
+  dest.remove("12", 1);
+  EXPECT_EQ(3u, dest.get_weight(0));
+  EXPECT_EQ(2u, dest.get_weight(1));
+
+  std::map<int, size_t> picked;
+  for (auto server : pick(dest, 50)) ++picked[server];
+  EXPECT_EQ(30u, picked[11]);
+  EXPECT_EQ(20u, picked[13]);
+}
+
+TEST_F(WeightedRoundRobinDestinationTest, SkipsQuarantined)
+{
+  DestWeightedRoundRobin dest({10, 1}, Protocol::get_default(), &mock_routing_sock_ops_);
+  dest.add("11", 1);
+  dest.add("12", 1);
+
+  // the heavy server fails, all connections go to the other one
+  mock_routing_sock_ops_.get_mysql_socket_fail(1);
+  EXPECT_THAT(pick(dest, 3), ElementsAre(12, 12, 12));
+  EXPECT_EQ(1u, dest.size_quarantine());
+}
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
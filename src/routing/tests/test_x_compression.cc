@@ -0,0 +1,312 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "protocol/x_compression.h"
+#include "connection.h"
+#include "context.h"
+#include "protocol/x_handshake.h"
+#include "protocol/x_protocol.h"
+#include "socket_operations.h"
+#include "test/helpers.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifdef HAVE_ZLIB
+
+#include <zlib.h>
+
+static const std::chrono::milliseconds kTimeout(5000);
+
+static const RoutingProtocolBuffer kOk{0x01, 0x00, 0x00, 0x00, 0x00};
+
+/** @brief returns message of the type with a payload of the given size */
+static RoutingProtocolBuffer make_message(uint8_t type, size_t size) {
+  RoutingProtocolBuffer message{static_cast<uint8_t>(size + 1), static_cast<uint8_t>((size + 1) >> 8),
+                                static_cast<uint8_t>((size + 1) >> 16), 0x00, type};
+  const std::string sql = "SELECT * FROM t WHERE c = 'a'";
+  for (size_t i = 0; i < size; ++i) message.push_back(static_cast<uint8_t>(sql[i % sql.size()]));
+  return message;
+}
+
+static void add_varint(RoutingProtocolBuffer &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t read_varint(const RoutingProtocolBuffer &in, size_t &pos) {
+  uint64_t value = 0;
+  unsigned shift = 0;
+  for (; in[pos] & 0x80; shift += 7) value |= static_cast<uint64_t>(in[pos++] & 0x7f) << shift;
+  return value | static_cast<uint64_t>(in[pos++]) << shift;
+}
+
+static void write_message(int sock, const RoutingProtocolBuffer &message) {
+  ASSERT_EQ(static_cast<ssize_t>(message.size()), ::write(sock, message.data(), message.size()));
+}
+
+/** @brief what the server does with the Compression messages of the router */
+class ServerSide {
+ public:
+  ServerSide() {
+    memset(&deflater_, 0, sizeof(deflater_));
+    memset(&inflater_, 0, sizeof(inflater_));
+    deflateInit(&deflater_, Z_DEFAULT_COMPRESSION);
+    inflateInit(&inflater_);
+  }
+
+  ~ServerSide() {
+    deflateEnd(&deflater_);
+    inflateEnd(&inflater_);
+  }
+
+  /** @brief returns Compression message of the server holding plain, of one type if type > 0 */
+  RoutingProtocolBuffer compress(const RoutingProtocolBuffer &plain, uint8_t type = 0) {
+    RoutingProtocolBuffer deflated(plain.size() + 64);
+    deflater_.next_in = const_cast<Bytef *>(plain.data());
+    deflater_.avail_in = static_cast<uInt>(plain.size());
+    deflater_.next_out = &deflated[0];
+    deflater_.avail_out = static_cast<uInt>(deflated.size());
+    EXPECT_EQ(Z_OK, deflate(&deflater_, Z_SYNC_FLUSH));
+    deflated.resize(deflated.size() - deflater_.avail_out);
+
+    RoutingProtocolBuffer message{0, 0, 0, 0, XCompression::kServerCompression, 0x08};
+    add_varint(message, plain.size());
+    if (type > 0) {
+      message.push_back(0x10);
+      message.push_back(type);
+    }
+    message.push_back(0x22);
+    add_varint(message, deflated.size());
+    message.insert(message.end(), deflated.begin(), deflated.end());
+    message[0] = static_cast<uint8_t>(message.size() - 4);
+    message[1] = static_cast<uint8_t>((message.size() - 4) >> 8);
+    return message;
+  }
+
+  /** @brief returns the plain messages of a Compression message of the router */
+  RoutingProtocolBuffer decompress(const RoutingProtocolBuffer &message) {
+    EXPECT_EQ(XCompression::kClientCompression, message[4]);
+    size_t pos = 5;
+    EXPECT_EQ(0x08, message[pos++]);
+    const uint64_t uncompressed_size = read_varint(message, pos);
+    EXPECT_EQ(0x22, message[pos++]);
+    const uint64_t payload_size = read_varint(message, pos);
+    EXPECT_EQ(message.size(), pos + payload_size);
+
+    RoutingProtocolBuffer plain(static_cast<size_t>(uncompressed_size));
+    inflater_.next_in = const_cast<Bytef *>(&message[pos]);
+    inflater_.avail_in = static_cast<uInt>(payload_size);
+    inflater_.next_out = &plain[0];
+    inflater_.avail_out = static_cast<uInt>(plain.size());
+    EXPECT_EQ(Z_OK, inflate(&inflater_, Z_SYNC_FLUSH));
+    EXPECT_EQ(0u, inflater_.avail_out);
+    return plain;
+  }
+
+ private:
+  z_stream deflater_;
+  z_stream inflater_;
+};
+
+TEST(XCompression, FrameClientKeepsPartialMessages) {
+  XCompression compression;
+  RoutingProtocolBuffer messages;
+
+  RoutingProtocolBuffer data = kOk;
+  const RoutingProtocolBuffer query = make_message(12, 20);
+  data.insert(data.end(), query.begin(), query.begin() + 10);
+  compression.frame_client(data.data(), data.size(), messages);
+  EXPECT_EQ(kOk, messages);
+
+  compression.frame_client(query.data() + 10, query.size() - 10, messages);
+  EXPECT_EQ(query, messages);
+}
+
+TEST(XCompression, SmallMessagesUncompressed) {
+  XCompression compression;
+  RoutingProtocolBuffer out;
+
+  compression.compress(kOk.data(), kOk.size(), out);
+  EXPECT_EQ(kOk, out);
+}
+
+TEST(XCompression, CompressesClientMessages) {
+  XCompression compression;
+  ServerSide server_side;
+  RoutingProtocolBuffer out;
+
+  // the stream goes on over the messages
+  for (size_t size: {1000, 2000}) {
+    const RoutingProtocolBuffer query = make_message(12, size);
+    compression.compress(query.data(), query.size(), out);
+    ASSERT_LT(out.size(), query.size());
+    EXPECT_EQ(out.size(), x_handshake::frame_size(out.data()));
+    EXPECT_EQ(query, server_side.decompress(out));
+  }
+}
+
+TEST(XCompression, DecompressesServerMessages) {
+  XCompression compression;
+  ServerSide server_side;
+  RoutingProtocolBuffer plain;
+
+  // messages of different types with their headers
+  RoutingProtocolBuffer rows = make_message(13, 100);
+  const RoutingProtocolBuffer row = make_message(13, 200);
+  rows.insert(rows.end(), row.begin(), row.end());
+  RoutingProtocolBuffer data = server_side.compress(rows);
+  // plain message in between
+  data.insert(data.end(), kOk.begin(), kOk.end());
+  ASSERT_TRUE(compression.decompress(data.data(), data.size(), plain));
+  RoutingProtocolBuffer expected = rows;
+  expected.insert(expected.end(), kOk.begin(), kOk.end());
+  EXPECT_EQ(expected, plain);
+
+  // messages of one type, read in pieces
+  const RoutingProtocolBuffer typed_rows{0x03, 0x00, 0x00, 0x00, 'a', 'b', 'c',
+                                         0x01, 0x00, 0x00, 0x00, 'd'};
+  data = server_side.compress(typed_rows, 13);
+  RoutingProtocolBuffer result;
+  for (uint8_t byte: data) {
+    ASSERT_TRUE(compression.decompress(&byte, 1, plain));
+    result.insert(result.end(), plain.begin(), plain.end());
+  }
+  EXPECT_EQ(RoutingProtocolBuffer({0x04, 0x00, 0x00, 0x00, 13, 'a', 'b', 'c',
+                                   0x02, 0x00, 0x00, 0x00, 13, 'd'}),
+            result);
+}
+
+TEST(XCompression, InvalidPayload) {
+  XCompression compression;
+  RoutingProtocolBuffer plain;
+
+  const RoutingProtocolBuffer message{0x08, 0x00, 0x00, 0x00, XCompression::kServerCompression,
+                                      0x08, 0x64, 0x22, 0x03, 'x', 'y', 'z'};
+  EXPECT_FALSE(compression.decompress(message.data(), message.size(), plain));
+}
+
+#ifndef _WIN32
+
+/** @brief CapabilitiesSet of tls = true */
+static const RoutingProtocolBuffer kSetTls{0x14, 0x00, 0x00, 0x00, 0x02, 0x0a, 0x11, 0x0a, 0x0f,
+                                           0x0a, 0x03, 't', 'l', 's', 0x12, 0x08,
+                                           0x08, 0x01, 0x12, 0x04, 0x08, 0x07, 0x40, 0x01};
+
+/**
+ * @test
+ *       Verify that the router asks an X protocol server for compression
+ *       and translates the messages of a client not compressing.
+ */
+TEST(XCompression, CompressesServerConnection) {
+  mysql_harness::SocketOperationsBase *so = mysql_harness::SocketOperations::instance();
+  MySQLRoutingContext context(
+      new XProtocol(routing::RoutingSockOps::instance(so)),
+      so, "routing_name",
+      routing::kDefaultNetBufferLength, kTimeout, kTimeout,
+      mysql_harness::TCPAddress(), mysql_harness::Path(), 100,
+      mysql_harness::kDefaultStackSizeInKiloBytes);
+  context.set_server_compression(true);
+
+  int client_fds[2];
+  int server_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds));
+  sockaddr_storage client_addr;
+  memset(&client_addr, 0, sizeof(client_addr));
+  client_addr.ss_family = AF_INET;
+
+  const int server = server_fds[1];
+  MySQLRoutingConnection connection(
+      context, client_fds[1], client_addr, routing::kInvalidSocket,
+      mysql_harness::TCPAddress(),
+      [](MySQLRoutingConnection*) {},
+      [server](mysql_harness::TCPAddress& address) {
+        address = mysql_harness::TCPAddress("127.0.0.1", 33060);
+        return server;
+      });
+  std::thread thread([&connection] { connection.run(); });
+
+  // the server is asked for compression first
+  RoutingProtocolBuffer message;
+  ASSERT_TRUE(x_handshake::read_message(so, server_fds[0], message, kTimeout));
+  ASSERT_EQ(x_handshake::kCapabilitiesSet, x_handshake::get_type(message));
+  EXPECT_TRUE(XProtocol::sets_capability(&message[5], message.size() - 5, "compression"));
+  write_message(server_fds[0], kOk);
+
+  // TLS would have to go inside the compressed connection
+  write_message(client_fds[0], kSetTls);
+  ASSERT_TRUE(x_handshake::read_message(so, client_fds[0], message, kTimeout));
+  EXPECT_EQ(x_handshake::kError, x_handshake::get_type(message));
+
+  const RoutingProtocolBuffer authenticate_start{0x08, 0x00, 0x00, 0x00, 0x04,
+                                                 0x0a, 0x05, 'P', 'L', 'A', 'I', 'N'};
+  write_message(client_fds[0], authenticate_start);
+  ASSERT_TRUE(x_handshake::read_message(so, server_fds[0], message, kTimeout));
+  EXPECT_EQ(authenticate_start, message);
+  const RoutingProtocolBuffer authenticate_ok{0x01, 0x00, 0x00, 0x00, x_handshake::kAuthenticateOk};
+  write_message(server_fds[0], authenticate_ok);
+  ASSERT_TRUE(x_handshake::read_message(so, client_fds[0], message, kTimeout));
+  EXPECT_EQ(authenticate_ok, message);
+
+  // statements get compressed, results decompressed
+  ServerSide server_side;
+  const RoutingProtocolBuffer query = make_message(12, 1000);
+  write_message(client_fds[0], query);
+  ASSERT_TRUE(x_handshake::read_message(so, server_fds[0], message, kTimeout));
+  EXPECT_LT(message.size(), query.size());
+  EXPECT_EQ(query, server_side.decompress(message));
+
+  const RoutingProtocolBuffer row = make_message(13, 500);
+  const RoutingProtocolBuffer compressed_row = server_side.compress(row);
+  write_message(server_fds[0], compressed_row);
+  ASSERT_TRUE(x_handshake::read_message(so, client_fds[0], message, kTimeout));
+  EXPECT_EQ(row, message);
+
+  ::close(client_fds[0]);
+  thread.join();
+  ::close(server_fds[0]);
+}
+
+#endif  // _WIN32
+
+#endif  // HAVE_ZLIB
+
+int main(int argc, char *argv[]) {
+  init_test_logger();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -46,6 +46,7 @@
 #include "test/helpers.h"
 
 using ::testing::_;
+using ::testing::Invoke;
 using ::testing::Return;
 
 
@@ -198,6 +199,79 @@ TEST_F(XProtocolTest, CopyPacketsHandshakeDoneOK)
   ASSERT_EQ(static_cast<size_t>(MSG_SIZE), report_bytes_read);
 }
 
+TEST_F(XProtocolTest, CopyPacketsPipelinedFramesWrittenTogether)
+{
+  handshake_done_ = true;
+  size_t report_bytes_read = 0xff;
+
+  Mysqlx::Connection::CapabilitiesGet capab_msg{};
+  Mysqlx::Connection::Close close_msg{};
+  serialize_protobuf_msg_to_buffer(network_buffer_, network_buffer_offset_, capab_msg,
+                                   Mysqlx::ClientMessages::CON_CAPABILITIES_GET);
+  serialize_protobuf_msg_to_buffer(network_buffer_, network_buffer_offset_, close_msg,
+                                   Mysqlx::ClientMessages::CON_CLOSE);
+
+  // the read ends inside the header of the second frame, the rest is waiting in the socket
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                     WillOnce(Return(7));
+  EXPECT_CALL(*mock_socket_operations_, poll(_, 1, std::chrono::milliseconds(0))).
+      WillOnce(Invoke([](struct pollfd *fds, nfds_t, std::chrono::milliseconds) {
+        fds[0].revents = POLLIN;
+        return 1;
+      }));
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[7], network_buffer_.size() - 7)).
+                                                     WillOnce(Return(network_buffer_offset_ - 7));
+  EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, &network_buffer_[0], network_buffer_offset_)).
+                                                     WillOnce(Return(network_buffer_offset_));
+
+  int result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                         handshake_done_, &report_bytes_read, false);
+
+  ASSERT_EQ(0, result);
+  ASSERT_EQ(network_buffer_offset_, report_bytes_read);
+  ASSERT_EQ(0, curr_pktnr_);
+}
+
+TEST_F(XProtocolTest, CopyPacketsFrameBiggerThanBufferNotCompleted)
+{
+  handshake_done_ = true;
+  size_t report_bytes_read = 0xff;
+
+  // the frame can't be completed in the buffer anyway, it's written right away
+  const std::vector<uint8_t> header{0x00, 0x00, 0x10, 0x00, Mysqlx::ClientMessages::CRUD_INSERT};
+  std::copy(header.begin(), header.end(), network_buffer_.begin());
+
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                     WillOnce(Return(100));
+  EXPECT_CALL(*mock_socket_operations_, poll(_, _, _)).Times(0);
+  EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, &network_buffer_[0], 100)).
+                                                     WillOnce(Return(100));
+
+  int result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                         handshake_done_, &report_bytes_read, false);
+
+  ASSERT_EQ(0, result);
+  ASSERT_EQ(0x100000 + 4 - 100, curr_pktnr_);
+
+  // the next read continues the frame, then a complete one follows
+  curr_pktnr_ = 3;
+  network_buffer_offset_ = 3;
+  Mysqlx::Connection::Close close_msg{};
+  serialize_protobuf_msg_to_buffer(network_buffer_, network_buffer_offset_, close_msg,
+                                   Mysqlx::ClientMessages::CON_CLOSE);
+
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                     WillOnce(Return(network_buffer_offset_));
+  EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, &network_buffer_[0], network_buffer_offset_)).
+                                                     WillOnce(Return(network_buffer_offset_));
+
+  result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                     handshake_done_, &report_bytes_read, false);
+
+  ASSERT_EQ(0, result);
+  ASSERT_EQ(0, curr_pktnr_);
+}
+
 TEST_F(XProtocolTest, CopyPacketsHandshakeDoneWriteError)
 {
   handshake_done_ = true;
@@ -356,6 +430,81 @@ TEST_F(XProtocolTest, CopyPacketsHandshakeClientSendsBrokenMessage)
   ASSERT_EQ(-1, result);
 }
 
+TEST_F(XProtocolTest, CopyPacketsHandshakeClientSendsBrokenCapabilitiesGet)
+{
+  size_t report_bytes_read = 0xff;
+  Mysqlx::Connection::CapabilitiesGet capab_msg{};
+
+  serialize_protobuf_msg_to_buffer(network_buffer_, network_buffer_offset_, capab_msg,
+                                   Mysqlx::ClientMessages::CON_CAPABILITIES_GET);
+
+  // field 1 of type length-delimited, with a length beyond the message
+  network_buffer_[0] = 3;
+  network_buffer_[5] = 0x0a;
+  network_buffer_[6] = 0x05;
+  network_buffer_offset_ = 7;
+
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                     WillOnce(Return(network_buffer_offset_));
+
+  int result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                         handshake_done_, &report_bytes_read, false);
+
+  ASSERT_FALSE(handshake_done_);
+  ASSERT_EQ(-1, result);
+}
+
+TEST_F(XProtocolTest, CopyPacketsHandshakeClientSendsMessageWithoutType)
+{
+  size_t report_bytes_read = 0xff;
+  const RoutingProtocolBuffer empty_msg{0x00, 0x00, 0x00, 0x00};
+  std::copy(empty_msg.begin(), empty_msg.end(), network_buffer_.begin());
+
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                     WillOnce(Return(empty_msg.size()));
+
+  int result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                         handshake_done_, &report_bytes_read, false);
+
+  ASSERT_FALSE(handshake_done_);
+  ASSERT_EQ(-1, result);
+}
+
+TEST_F(XProtocolTest, CopyPacketsHandshakeClientSendsAuthStartTwice)
+{
+  // the validation reuses the parsed message, the second client must not see the first
+  Mysqlx::Session::AuthenticateStart authenticate_start;
+  authenticate_start.set_mech_name("PLAIN");
+  authenticate_start.set_auth_data("user");
+  Mysqlx::Session::AuthenticateStart incomplete;
+  incomplete.set_auth_data("user");
+
+  for (const auto &msg: {authenticate_start, incomplete}) {
+    size_t report_bytes_read = 0xff;
+    bool handshake_done = false;
+    std::string serialized;
+    ASSERT_TRUE(msg.SerializePartialToString(&serialized));
+    network_buffer_[0] = static_cast<uint8_t>(serialized.size() + 1);
+    network_buffer_[1] = network_buffer_[2] = network_buffer_[3] = 0;
+    network_buffer_[4] = Mysqlx::ClientMessages::SESS_AUTHENTICATE_START;
+    std::copy(serialized.begin(), serialized.end(), network_buffer_.begin() + 5);
+    network_buffer_offset_ = serialized.size() + 5;
+
+    EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                                       WillOnce(Return(network_buffer_offset_));
+    if (msg.IsInitialized()) {
+      EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, &network_buffer_[0], network_buffer_offset_)).
+                                                       WillOnce(Return(network_buffer_offset_));
+    }
+
+    int result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                           handshake_done, &report_bytes_read, false);
+
+    ASSERT_EQ(msg.IsInitialized(), handshake_done);
+    ASSERT_EQ(msg.IsInitialized() ? 0 : -1, result);
+  }
+}
+
 TEST_F(XProtocolTest, CopyPacketsHandshakeServerSendsError)
 {
   size_t report_bytes_read = 0xff;
@@ -447,6 +596,31 @@ TEST_F(XProtocolTest, CopyPacketsHandshakeReadPartialHeader)
   ASSERT_EQ(network_buffer_offset_, report_bytes_read);
 }
 
+TEST_F(XProtocolTest, CopyPacketsHandshakeReadRestOfHeaderAtOnce)
+{
+  size_t report_bytes_read = 0xff;
+
+  auto warn_msg = create_warning_msg(100, "Warning message");
+
+  serialize_protobuf_msg_to_buffer(network_buffer_, network_buffer_offset_, warn_msg,
+                                   Mysqlx::ServerMessages::NOTICE);
+
+  // the rest of the header is read together with the message
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[0], network_buffer_.size())).
+                                               WillOnce(Return(2));
+  EXPECT_CALL(*mock_socket_operations_, read(sender_socket_, &network_buffer_[2], network_buffer_.size() - 2)).
+                                               WillOnce(Return(network_buffer_offset_ - 2));
+  EXPECT_CALL(*mock_socket_operations_, write(receiver_socket_, &network_buffer_[0], network_buffer_offset_)).
+                                                WillOnce(Return(network_buffer_offset_));
+
+  int result = x_protocol_->copy_packets(sender_socket_, receiver_socket_, true, network_buffer_, &curr_pktnr_,
+                                         handshake_done_, &report_bytes_read, true);
+
+  ASSERT_FALSE(handshake_done_);
+  ASSERT_EQ(0, result);
+  ASSERT_EQ(network_buffer_offset_, report_bytes_read);
+}
+
 TEST_F(XProtocolTest, CopyPacketsHandshakeReadPartialMessage)
 {
   size_t report_bytes_read = 0xff;
@@ -549,6 +723,50 @@ TEST_F(XProtocolTest, SendErrorWriteFail)
   ASSERT_FALSE(res);
 }
 
+TEST_F(XProtocolTest, MakeCompressionRequest)
+{
+  RoutingProtocolBuffer request = XProtocol::make_compression_request("deflate_stream");
+  ASSERT_GT(request.size(), 5u);
+  ASSERT_EQ(Mysqlx::ClientMessages::CON_CAPABILITIES_SET, request[4]);
+
+  Mysqlx::Connection::CapabilitiesSet capabilities_set;
+  ASSERT_TRUE(capabilities_set.ParseFromArray(&request[5], static_cast<int>(request.size() - 5)));
+  ASSERT_EQ(1, capabilities_set.capabilities().capabilities_size());
+  const Mysqlx::Connection::Capability &capability = capabilities_set.capabilities().capabilities(0);
+  ASSERT_EQ("compression", capability.name());
+  ASSERT_EQ("algorithm", capability.value().obj().fld(0).key());
+  ASSERT_EQ("deflate_stream", capability.value().obj().fld(0).value().scalar().v_string().value());
+
+  ASSERT_TRUE(XProtocol::sets_capability(&request[5], request.size() - 5, "compression"));
+  ASSERT_FALSE(XProtocol::requests_tls(&request[5], request.size() - 5));
+}
+
+TEST_F(XProtocolTest, RemoveCapabilities)
+{
+  Mysqlx::Connection::Capabilities capabilities;
+  for (const char *name: {"tls", "authentication.mechanisms", "compression"}) {
+    Mysqlx::Connection::Capability *capability = capabilities.add_capabilities();
+    capability->set_name(name);
+    capability->mutable_value()->set_type(Mysqlx::Datatypes::Any::SCALAR);
+    capability->mutable_value()->mutable_scalar()->set_type(Mysqlx::Datatypes::Scalar::V_BOOL);
+    capability->mutable_value()->mutable_scalar()->set_v_bool(true);
+  }
+  RoutingProtocolBuffer message(5 + capabilities.ByteSize());
+  size_t offset = 0;
+  serialize_protobuf_msg_to_buffer(message, offset, capabilities, Mysqlx::ServerMessages::CONN_CAPABILITIES);
+
+  ASSERT_TRUE(XProtocol::remove_capabilities(message, {"tls", "compression"}));
+  ASSERT_EQ(Mysqlx::ServerMessages::CONN_CAPABILITIES, message[4]);
+  ASSERT_EQ(message.size() - 4, static_cast<size_t>(message[0]));
+  Mysqlx::Connection::Capabilities left;
+  ASSERT_TRUE(left.ParseFromArray(&message[5], static_cast<int>(message.size() - 5)));
+  ASSERT_EQ(1, left.capabilities_size());
+  ASSERT_EQ("authentication.mechanisms", left.capabilities(0).name());
+
+  RoutingProtocolBuffer broken{0x02, 0x00, 0x00, 0x00, 0x02, 0xff};
+  ASSERT_FALSE(XProtocol::remove_capabilities(broken, {"tls"}));
+}
+
 int main(int argc, char *argv[]) {
   init_test_logger();
   ::testing::InitGoogleTest(&argc, argv);
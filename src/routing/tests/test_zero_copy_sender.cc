@@ -0,0 +1,270 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "zero_copy_sender.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#ifdef __linux__
+
+class TestZeroCopySender : public testing::Test {
+public:
+  void SetUp() override {
+    if (!ZeroCopySender::is_supported()) return;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, listener);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0, bind(listener, reinterpret_cast<struct sockaddr*>(&addr), addr_len));
+    ASSERT_EQ(0, listen(listener, 1));
+    ASSERT_EQ(0, getsockname(listener, reinterpret_cast<struct sockaddr*>(&addr), &addr_len));
+
+    sender_ = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, sender_);
+    ASSERT_EQ(0, connect(sender_, reinterpret_cast<struct sockaddr*>(&addr), addr_len));
+    receiver_ = accept(listener, nullptr, nullptr);
+    ::close(listener);
+    ASSERT_NE(-1, receiver_);
+  }
+
+  void TearDown() override {
+    for (int fd: {sender_, receiver_}) {
+      if (fd != -1) ::close(fd);
+    }
+  }
+
+  /** @brief reaps until the pending sends completed */
+  void reap_all(ZeroCopySender& sender) {
+    for (int i = 0; i < 100 && sender.get_pending() > 0; ++i) {
+      struct pollfd fds[] = {{sender_, 0, 0}};
+      // completions are reported as an error event
+      ::poll(fds, 1, 100);
+      sender.reap(sender_);
+    }
+  }
+
+  std::string receive(size_t size) {
+    std::string received(size, '\0');
+    size_t got = 0;
+    while (got < size) {
+      ssize_t res = ::read(receiver_, &received[got], size - got);
+      if (res <= 0) break;
+      got += static_cast<size_t>(res);
+    }
+    received.resize(got);
+    return received;
+  }
+
+  int sender_{-1};
+  int receiver_{-1};
+};
+
+/**
+ * @test
+ *       Verify that the pooled buffer is kept until the kernel reports the
+ *       send as completed and returned to the pool afterwards.
+ */
+TEST_F(TestZeroCopySender, ReturnsBufferToPoolOnCompletion) {
+  if (!ZeroCopySender::is_supported()) return;
+
+  RoutingBufferPool pool(65536, 4);
+  ZeroCopySender sender(16384);
+  ASSERT_TRUE(sender.enable(sender_));
+
+  RoutingBufferPool::Lease lease = pool.acquire();
+  RoutingBufferRef buffer = *lease;
+  for (size_t i = 0; i < buffer.size(); ++i) buffer[i] = static_cast<uint8_t>(i % 251);
+  const std::string expected(buffer.begin(), buffer.end());
+
+  ASSERT_TRUE(sender.wants(buffer.size()));
+  ssize_t res = sender.send(sender_, &buffer[0], buffer.size(), lease);
+  ASSERT_GT(res, 0);
+  EXPECT_FALSE(static_cast<bool>(lease));
+  EXPECT_EQ(1u, sender.get_pending());
+  EXPECT_EQ(1u, pool.get_stats().in_use);
+  EXPECT_EQ(static_cast<uint64_t>(res), sender.get_bytes_sent());
+
+  EXPECT_EQ(expected.substr(0, static_cast<size_t>(res)), receive(static_cast<size_t>(res)));
+
+  reap_all(sender);
+  EXPECT_EQ(0u, sender.get_pending());
+  EXPECT_EQ(0u, pool.get_stats().in_use);
+  // the kernel copies on loopback, which isn't worth it
+  EXPECT_FALSE(sender.is_usable());
+  EXPECT_FALSE(sender.wants(65536));
+}
+
+/**
+ * @test
+ *       Verify that a buffer not borrowed from a pool is kept for reuse
+ *       once the send completed.
+ */
+TEST_F(TestZeroCopySender, KeepsOwnedBufferAsSpare) {
+  if (!ZeroCopySender::is_supported()) return;
+
+  ZeroCopySender sender(16384);
+  ASSERT_TRUE(sender.enable(sender_));
+
+  std::unique_ptr<RoutingProtocolBuffer> buffer(new RoutingProtocolBuffer(32768, 'x'));
+  ssize_t res = sender.send(sender_, &(*buffer)[0], buffer->size(), buffer);
+  ASSERT_GT(res, 0);
+  EXPECT_FALSE(static_cast<bool>(buffer));
+  EXPECT_EQ(nullptr, sender.take_spare(32768));
+
+  EXPECT_EQ(std::string(static_cast<size_t>(res), 'x'), receive(static_cast<size_t>(res)));
+  reap_all(sender);
+
+  EXPECT_EQ(nullptr, sender.take_spare(16384));
+  std::unique_ptr<RoutingProtocolBuffer> spare = sender.take_spare(32768);
+  ASSERT_NE(nullptr, spare);
+  EXPECT_EQ(32768u, spare->size());
+  EXPECT_EQ(nullptr, sender.take_spare(32768));
+}
+
+/**
+ * @test
+ *       Verify that writes below the threshold are left to be copied.
+ */
+TEST_F(TestZeroCopySender, Threshold) {
+  ZeroCopySender sender(16384);
+
+  EXPECT_EQ(ZeroCopySender::is_supported(), sender.wants(16384));
+  EXPECT_FALSE(sender.wants(16383));
+}
+
+/**
+ * @test
+ *       Verify that sockets not supporting MSG_ZEROCOPY make the sender not
+ *       usable, nothing gets written then.
+ */
+TEST_F(TestZeroCopySender, UnsupportedSocket) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  ZeroCopySender sender(1);
+  EXPECT_FALSE(sender.enable(fds[0]));
+  EXPECT_FALSE(sender.is_usable());
+
+  RoutingBufferPool pool(1024, 1);
+  RoutingBufferPool::Lease lease = pool.acquire();
+  EXPECT_EQ(0, sender.send(fds[0], &(*lease)[0], 1024, lease));
+  EXPECT_TRUE(static_cast<bool>(lease));
+  EXPECT_EQ(0u, sender.get_pending());
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+/**
+ * @test
+ *       Verify that sends in flight on an aborting close make the socket
+ *       get reset.
+ */
+TEST_F(TestZeroCopySender, PrepareCloseWithSendsInFlight) {
+  if (!ZeroCopySender::is_supported()) return;
+
+  ZeroCopySender sender(1);
+  ASSERT_TRUE(sender.enable(sender_));
+  EXPECT_FALSE(sender.prepare_close(sender_, std::chrono::milliseconds(0)));
+
+  // more than the receive buffer takes while nothing is read
+  std::unique_ptr<RoutingProtocolBuffer> buffer(new RoutingProtocolBuffer(4 * 1024 * 1024, 'x'));
+  ASSERT_GT(sender.send(sender_, &(*buffer)[0], buffer->size(), buffer), 0);
+  EXPECT_TRUE(sender.prepare_close(sender_, std::chrono::milliseconds(0)));
+  EXPECT_EQ(1u, sender.get_pending());
+
+  struct linger lg{};
+  socklen_t lg_len = sizeof(lg);
+  ASSERT_EQ(0, getsockopt(sender_, SOL_SOCKET, SO_LINGER, &lg, &lg_len));
+  EXPECT_EQ(1, lg.l_onoff);
+  EXPECT_EQ(0, lg.l_linger);
+}
+
+/**
+ * @test
+ *       Verify that a graceful close waits for the sends in flight and
+ *       doesn't reset the socket once they completed.
+ */
+TEST_F(TestZeroCopySender, PrepareCloseWaitsForSendsInFlight) {
+  if (!ZeroCopySender::is_supported()) return;
+
+  ZeroCopySender sender(1);
+  ASSERT_TRUE(sender.enable(sender_));
+
+  const size_t size = 4 * 1024 * 1024;
+  std::unique_ptr<RoutingProtocolBuffer> buffer(new RoutingProtocolBuffer(size, 'x'));
+  ssize_t sent = sender.send(sender_, &(*buffer)[0], buffer->size(), buffer);
+  ASSERT_GT(sent, 0);
+
+  std::thread reader([&] { receive(static_cast<size_t>(sent)); });
+  EXPECT_FALSE(sender.prepare_close(sender_, std::chrono::milliseconds(10000)));
+  reader.join();
+  EXPECT_EQ(0u, sender.get_pending());
+
+  struct linger lg{};
+  socklen_t lg_len = sizeof(lg);
+  ASSERT_EQ(0, getsockopt(sender_, SOL_SOCKET, SO_LINGER, &lg, &lg_len));
+  EXPECT_EQ(0, lg.l_onoff);
+}
+
+/**
+ * @test
+ *       Verify that a graceful close resets the socket if the sends in
+ *       flight don't complete in time.
+ */
+TEST_F(TestZeroCopySender, PrepareCloseTimesOutWithSendsInFlight) {
+  if (!ZeroCopySender::is_supported()) return;
+
+  ZeroCopySender sender(1);
+  ASSERT_TRUE(sender.enable(sender_));
+
+  std::unique_ptr<RoutingProtocolBuffer> buffer(new RoutingProtocolBuffer(4 * 1024 * 1024, 'x'));
+  ASSERT_GT(sender.send(sender_, &(*buffer)[0], buffer->size(), buffer), 0);
+  EXPECT_TRUE(sender.prepare_close(sender_, std::chrono::milliseconds(100)));
+  EXPECT_EQ(1u, sender.get_pending());
+
+  struct linger lg{};
+  socklen_t lg_len = sizeof(lg);
+  ASSERT_EQ(0, getsockopt(sender_, SOL_SOCKET, SO_LINGER, &lg, &lg_len));
+  EXPECT_EQ(1, lg.l_onoff);
+  EXPECT_EQ(0, lg.l_linger);
+}
+
+#endif  // __linux__
@@ -27,6 +27,7 @@
 #include "mysql/harness/plugin.h"
 
 #include <cstdarg>
+#include <string>
 
 #include <syslog.h>
 
@@ -36,26 +37,43 @@ using mysql_harness::PLUGIN_ABI_VERSION;
 using mysql_harness::Plugin;
 using mysql_harness::logging::LogLevel;
 
-class SyslogHandler final : public mysql_harness::logging::Handler {
+/*
+ * syslog() blocks while the socket to the syslog daemon is full, so the
+ * records are handed to the writer thread of AsyncHandler, which submits
+ * them in batches. Records are dropped (and counted) if the daemon can't
+ * keep up.
+ */
+class SyslogHandler final : public mysql_harness::logging::AsyncHandler {
  public:
   static constexpr const char* kDefaultName = "syslog";
 
-  SyslogHandler(bool format_messages = true, LogLevel level = LogLevel::kNotSet)
-      : mysql_harness::logging::Handler(format_messages, level) {}
+  // syslog adds timestamp and ident itself
+  SyslogHandler(bool format_messages = false, LogLevel level = LogLevel::kNotSet)
+      : mysql_harness::logging::AsyncHandler(format_messages, level,
+                                             OverflowPolicy::kDrop,
+                                             kDefaultCapacity,
+                                             kDefaultFlushInterval) {}
   ~SyslogHandler() { close(); }
 
   void open(const std::string& ident) {
-    openlog(ident.c_str(), LOG_CONS | LOG_NDELAY, LOG_DAEMON);
+    ident_ = ident;
+    openlog(ident_.c_str(), LOG_CONS | LOG_NDELAY, LOG_DAEMON);
+    start();
   }
 
   void close() {
+    // submits the queued records
+    stop();
     closelog();
   }
 
  private:
-  void do_log(const mysql_harness::logging::Record& record) override {
-    syslog(static_cast<int>(record.level), "%s", record.message.c_str());
+  void write(LogLevel level, const std::string& msg) override {
+    syslog(static_cast<int>(level), "%s", msg.c_str());
   }
+
+  // openlog() keeps the pointer
+  std::string ident_;
 };
 
 std::shared_ptr<SyslogHandler> g_syslog_handler =
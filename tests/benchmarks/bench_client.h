@@ -0,0 +1,435 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MYSQLROUTER_TESTS_BENCH_CLIENT_INCLUDED
+#define MYSQLROUTER_TESTS_BENCH_CLIENT_INCLUDED
+
+#ifndef _WIN32
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <arpa/inet.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#else
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "mysqlrouter/mysql_protocol.h"
+
+// client side of the benchmarks that connect through the router
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+constexpr socket_t kInvalidSocket = INVALID_SOCKET;
+#else
+using socket_t = int;
+constexpr socket_t kInvalidSocket = -1;
+#endif
+
+constexpr size_t kHeaderSize = mysql_protocol::Packet::kHeaderSize;
+constexpr mysql_protocol::Capabilities::Flags kClientCapabilities =
+    mysql_protocol::Capabilities::LONG_PASSWORD |
+    mysql_protocol::Capabilities::PROTOCOL_41 |
+    mysql_protocol::Capabilities::TRANSACTIONS |
+    mysql_protocol::Capabilities::SECURE_CONNECTION |
+    mysql_protocol::Capabilities::PLUGIN_AUTH;
+constexpr uint8_t kCharsetUtf8 = 33;
+constexpr uint8_t kComQuit = 0x01;
+constexpr uint8_t kComQuery = 0x03;
+
+// a closed connection shouldn't raise SIGPIPE, it's a failure to count
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// clients waiting longer than that for a response count as timed out
+constexpr unsigned kReadTimeoutSeconds = 10;
+
+inline int last_socket_error() {
+#ifdef _WIN32
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
+
+inline void close_socket(socket_t sock) {
+#ifdef _WIN32
+  closesocket(sock);
+#else
+  close(sock);
+#endif
+}
+
+inline bool is_timeout(int err) {
+#ifdef _WIN32
+  return err == WSAETIMEDOUT;
+#else
+  return err == EAGAIN || err == EWOULDBLOCK;
+#endif
+}
+
+/**
+ * Failure of a client operation, classified to tell refused connections from
+ * ones the router or the server closed or answered with an error.
+ */
+class BenchError : public std::runtime_error {
+ public:
+  enum class Kind { kConnect, kClosed, kErrorPacket, kTimeout, kOther };
+
+  BenchError(Kind kind, const std::string &what): std::runtime_error(what), kind_(kind) {}
+
+  Kind kind() const { return kind_; }
+
+  static const char *kind_name(Kind kind) {
+    switch (kind) {
+      case Kind::kConnect: return "connect";
+      case Kind::kClosed: return "closed";
+      case Kind::kErrorPacket: return "error_packet";
+      case Kind::kTimeout: return "timeout";
+      case Kind::kOther: break;
+    }
+    return "other";
+  }
+
+ private:
+  Kind kind_;
+};
+
+/** @brief a BenchError from the last socket error */
+inline BenchError socket_error(const std::string &what) {
+  const int err = last_socket_error();
+  const std::string msg = what + ": " + std::system_category().message(err);
+  if (is_timeout(err)) return BenchError(BenchError::Kind::kTimeout, msg);
+#ifdef _WIN32
+  if (err == WSAECONNRESET || err == WSAECONNABORTED)
+#else
+  if (err == ECONNRESET || err == EPIPE)
+#endif
+    return BenchError(BenchError::Kind::kClosed, msg);
+  return BenchError(BenchError::Kind::kOther, msg);
+}
+
+/**
+ * Minimal client of the classic protocol.
+ *
+ * Speaks just enough of the protocol to authenticate against the mock and to
+ * read the responses of text queries, without buffering the results or
+ * decoding the rows like libmysqlclient, the client side shouldn't be what
+ * gets measured.
+ */
+class BenchClient {
+ public:
+  BenchClient(): buf_(64 * 1024) {}
+  ~BenchClient() { close(); }
+
+  BenchClient(const BenchClient&) = delete;
+  BenchClient& operator=(const BenchClient&) = delete;
+
+  /**
+   * Connects and authenticates.
+   *
+   * @throws BenchError if the connection failed or the server sent an error
+   */
+  void connect(uint16_t port) {
+    open(port);
+    authenticate();
+  }
+
+  /**
+   * Connects and reads the server greeting.
+   *
+   * The time from connect() until the greeting arrived is kept for
+   * take_time_to_first_byte().
+   *
+   * @throws BenchError if the connection failed or the server sent an error
+   */
+  void open(uint16_t port) {
+    close();
+
+    sock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock_ == kInvalidSocket) throw socket_error("socket() failed");
+
+    int one = 1;
+    setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+#ifdef _WIN32
+    DWORD timeout = static_cast<DWORD>(kReadTimeoutSeconds * 1000);
+#else
+    struct timeval timeout;
+    timeout.tv_sec = kReadTimeoutSeconds;
+    timeout.tv_usec = 0;
+#endif
+    setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout),
+               sizeof(timeout));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const auto connect_start = Clock::now();
+    if (::connect(sock_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+      const auto e = socket_error("connect() failed");
+      throw BenchError(BenchError::Kind::kConnect, e.what());
+    }
+
+    // server greeting
+    read_packet();
+    time_to_first_byte_us_ = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - connect_start).count());
+    has_time_to_first_byte_ = true;
+    if (payload_[0] == 0xff) throw error_packet("greeting");
+  }
+
+  /**
+   * Authenticates on a connection opened by open().
+   *
+   * @throws BenchError if the server sent an error
+   */
+  void authenticate() {
+    write_handshake_response();
+
+    read_packet();
+    if (payload_[0] == 0xff) throw error_packet("authentication");
+    if (payload_[0] != 0x00)
+      throw BenchError(BenchError::Kind::kOther, "authentication: unexpected response");
+  }
+
+  /**
+   * Gets the time to the greeting of the last open(), once.
+   *
+   * @returns false if no connection got opened since the last call
+   */
+  bool take_time_to_first_byte(uint32_t *us) {
+    if (!has_time_to_first_byte_) return false;
+    has_time_to_first_byte_ = false;
+    if (us) *us = time_to_first_byte_us_;
+    return true;
+  }
+
+  /**
+   * Sends a text query and reads its response.
+   *
+   * @returns number of rows of the result
+   * @throws BenchError if the server sent an error
+   */
+  uint64_t query(const std::string &stmt) {
+    write_command(kComQuery, stmt);
+
+    read_packet();
+    if (payload_[0] == 0x00) return 0;
+    if (payload_[0] == 0xff) throw error_packet("query");
+
+    // column definitions, EOF
+    do {
+      read_packet();
+    } while (!is_eof());
+
+    // rows, EOF or error
+    uint64_t rows = 0;
+    for (;;) {
+      read_packet();
+      if (is_eof()) break;
+      if (payload_[0] == 0xff) throw error_packet("query");
+      ++rows;
+    }
+    return rows;
+  }
+
+  /** @brief sends COM_QUIT and closes the connection */
+  void close() noexcept {
+    if (sock_ == kInvalidSocket) return;
+
+    try {
+      write_command(kComQuit, "");
+    } catch (...) {
+      // the connection is gone already
+    }
+    abort();
+  }
+
+  /** @brief closes the connection without saying goodbye, like a crashing client */
+  void abort() noexcept {
+    if (sock_ == kInvalidSocket) return;
+
+    close_socket(sock_);
+    sock_ = kInvalidSocket;
+    buf_pos_ = buf_end_ = 0;
+  }
+
+  /**
+   * Waits until the other side closes the connection, without sending anything.
+   *
+   * @returns false if it stayed open for the read timeout or the connection failed
+   */
+  bool wait_closed() noexcept {
+    try {
+      for (;;) {
+        buf_pos_ = buf_end_ = 0;
+        fill();
+      }
+    } catch (const BenchError &e) {
+      abort();
+      return e.kind() == BenchError::Kind::kClosed;
+    }
+  }
+
+  bool is_connected() const { return sock_ != kInvalidSocket; }
+
+  /** @brief bytes sent and received since the client got created */
+  uint64_t bytes() const { return bytes_sent_ + bytes_received_; }
+
+ private:
+  bool is_eof() const { return payload_[0] == 0xfe && payload_.size() < 9; }
+
+  std::string error_message() const {
+    // 0xff, 2 bytes error-code, '#' and 5 bytes sql-state, message
+    if (payload_.size() < 9) return "malformed error packet";
+    const unsigned code = payload_[1] | (payload_[2] << 8);
+    return std::string(payload_.begin() + 9, payload_.end()) + " (" + std::to_string(code) + ")";
+  }
+
+  BenchError error_packet(const std::string &what) const {
+    return BenchError(BenchError::Kind::kErrorPacket, what + ": " + error_message());
+  }
+
+  /** @brief sends a handshake response for mysql_native_password, the mock takes any password */
+  void write_handshake_response() {
+    std::vector<uint8_t> packet(kHeaderSize);
+    const auto capabilities = kClientCapabilities.bits();
+    for (unsigned shift = 0; shift < 32; shift += 8)
+      packet.push_back(static_cast<uint8_t>(capabilities >> shift));
+    const uint8_t max_packet_size[] = {0x00, 0x00, 0x00, 0x01};  // 16M
+    packet.insert(packet.end(), std::begin(max_packet_size), std::end(max_packet_size));
+    packet.push_back(kCharsetUtf8);
+    packet.insert(packet.end(), 23, 0);  // filler
+
+    const std::string username("root");
+    packet.insert(packet.end(), username.begin(), username.end());
+    packet.push_back(0);
+    packet.push_back(20);
+    packet.insert(packet.end(), 20, 0x71);  // scrambled password
+
+    const std::string auth_plugin("mysql_native_password");
+    packet.insert(packet.end(), auth_plugin.begin(), auth_plugin.end());
+    packet.push_back(0);
+
+    const size_t len = packet.size() - kHeaderSize;
+    packet[0] = static_cast<uint8_t>(len);
+    packet[1] = static_cast<uint8_t>(len >> 8);
+    packet[2] = static_cast<uint8_t>(len >> 16);
+    packet[3] = 1;  // sequence-id
+    write_all(packet.data(), packet.size());
+  }
+
+  void write_command(uint8_t command, const std::string &arg) {
+    const size_t len = 1 + arg.size();
+    std::vector<uint8_t> packet{static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8),
+                                static_cast<uint8_t>(len >> 16), 0, command};
+    packet.insert(packet.end(), arg.begin(), arg.end());
+    write_all(packet.data(), packet.size());
+  }
+
+  void write_all(const uint8_t *data, size_t size) {
+    while (size > 0) {
+      const auto sent = send(sock_, reinterpret_cast<const char*>(data), static_cast<int>(size),
+                             kSendFlags);
+      if (sent <= 0) throw socket_error("send() failed");
+      data += sent;
+      size -= static_cast<size_t>(sent);
+      bytes_sent_ += static_cast<uint64_t>(sent);
+    }
+  }
+
+  /** @brief reads more bytes into the buffer, moving the unread ones to its start */
+  void fill() {
+    if (buf_pos_ > 0) {
+      std::copy(buf_.begin() + static_cast<std::ptrdiff_t>(buf_pos_),
+                buf_.begin() + static_cast<std::ptrdiff_t>(buf_end_), buf_.begin());
+      buf_end_ -= buf_pos_;
+      buf_pos_ = 0;
+    }
+
+    const auto received = recv(sock_, reinterpret_cast<char*>(buf_.data() + buf_end_),
+                               static_cast<int>(buf_.size() - buf_end_), 0);
+    if (received == 0) throw BenchError(BenchError::Kind::kClosed, "connection closed by server");
+    if (received < 0) throw socket_error("recv() failed");
+    buf_end_ += static_cast<size_t>(received);
+    bytes_received_ += static_cast<uint64_t>(received);
+  }
+
+  /** @brief reads the next packet into payload_ */
+  void read_packet() {
+    while (buf_end_ - buf_pos_ < kHeaderSize) fill();
+
+    const size_t len = buf_[buf_pos_] | (buf_[buf_pos_ + 1] << 8) | (buf_[buf_pos_ + 2] << 16);
+    buf_pos_ += kHeaderSize;
+
+    payload_.clear();
+    while (payload_.size() < len) {
+      if (buf_pos_ == buf_end_) fill();
+      const size_t chunk = std::min(len - payload_.size(), buf_end_ - buf_pos_);
+      payload_.insert(payload_.end(), buf_.begin() + static_cast<std::ptrdiff_t>(buf_pos_),
+                      buf_.begin() + static_cast<std::ptrdiff_t>(buf_pos_ + chunk));
+      buf_pos_ += chunk;
+    }
+    if (payload_.empty()) throw BenchError(BenchError::Kind::kOther, "empty packet");
+  }
+
+  socket_t sock_{kInvalidSocket};
+  std::vector<uint8_t> buf_;
+  size_t buf_pos_{0};
+  size_t buf_end_{0};
+  std::vector<uint8_t> payload_;
+  uint64_t bytes_sent_{0};
+  uint64_t bytes_received_{0};
+  uint32_t time_to_first_byte_us_{0};
+  bool has_time_to_first_byte_{false};
+};
+
+}  // namespace bench
+
+#endif  // MYSQLROUTER_TESTS_BENCH_CLIENT_INCLUDED
@@ -0,0 +1,294 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * Compares benchmark results against a baseline, for the perf_check target.
+ *
+ * The thresholds file tells per results file which metrics to compare, if
+ * higher or lower is better and by how much they may get worse:
+ *
+ *     {"routing_bench.json": {
+ *        "/workloads/oltp/operations_per_sec": {"better": "higher", "tolerance": 0.15},
+ *        "/workloads/oltp/latency_us/p99": {"better": "lower", "tolerance": 0.3,
+ *                                         "min_delta": 200}}}
+ *
+ * Metrics are JSON pointers. A '*' as part of the pointer matches all
+ * members of an object, or all elements of an array by their "name", see
+ * data/perf_check.json. A metric gets worse if it changed into the wrong
+ * direction by more than the tolerance, relative to the baseline, and by
+ * more than min_delta.
+ *
+ * Results files without baseline become the baseline, --update replaces
+ * the baseline by the results:
+ *
+ *     bench_compare --thresholds=perf_check.json --baseline=dir --results=dir [--update]
+ *
+ * Exits with 1 if a metric got worse or went missing, 2 on errors.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+#include "mysql/harness/filesystem.h"
+
+namespace {
+
+using mysql_harness::Path;
+
+struct Threshold {
+  bool higher_is_better{true};
+  double tolerance{0};
+  double min_delta{0};
+};
+
+struct Options {
+  std::string thresholds;
+  std::string baseline_dir;
+  std::string results_dir;
+  bool update{false};
+};
+
+std::string read_file(const std::string &filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) throw std::runtime_error("can't open " + filename);
+  std::ostringstream content;
+  content << in.rdbuf();
+  return content.str();
+}
+
+void write_file(const std::string &filename, const std::string &content) {
+  std::ofstream out(filename, std::ios::binary);
+  out << content;
+  if (!out.good()) throw std::runtime_error("writing " + filename + " failed");
+}
+
+void parse_json(const std::string &filename, const std::string &content, rapidjson::Document &doc) {
+  doc.Parse(content.c_str());
+  if (doc.HasParseError())
+    throw std::runtime_error(filename + " is no valid JSON, error at offset " +
+                             std::to_string(doc.GetErrorOffset()));
+}
+
+std::vector<std::string> split_pointer(const std::string &pointer) {
+  if (pointer.empty() || pointer[0] != '/')
+    throw std::invalid_argument("metric '" + pointer + "' needs to start with '/'");
+
+  std::vector<std::string> parts;
+  size_t begin = 1;
+  for (size_t end; (end = pointer.find('/', begin)) != std::string::npos; begin = end + 1)
+    parts.push_back(pointer.substr(begin, end - begin));
+  parts.push_back(pointer.substr(begin));
+  return parts;
+}
+
+/**
+ * numbers matching a metric, by the pointer with the '*' resolved.
+ */
+void collect(const rapidjson::Value &value, const std::vector<std::string> &parts, size_t ndx,
+             const std::string &path, std::map<std::string, double> &numbers) {
+  if (ndx == parts.size()) {
+    if (value.IsNumber()) numbers[path] = value.GetDouble();
+    return;
+  }
+
+  const std::string &part = parts[ndx];
+  if (value.IsObject()) {
+    for (auto it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
+      const std::string key(it->name.GetString(), it->name.GetStringLength());
+      if (part == "*" || part == key) collect(it->value, parts, ndx + 1, path + "/" + key, numbers);
+    }
+  } else if (value.IsArray()) {
+    for (rapidjson::SizeType i = 0; i < value.Size(); ++i) {
+      const rapidjson::Value &element = value[i];
+      // benchmarks may come in any order, they are matched by name
+      std::string key = std::to_string(i);
+      if (element.IsObject() && element.HasMember("name") && element["name"].IsString())
+        key = element["name"].GetString();
+      if (part == "*" || part == key) collect(element, parts, ndx + 1, path + "/" + key, numbers);
+    }
+  }
+}
+
+Threshold parse_threshold(const std::string &metric, const rapidjson::Value &value) {
+  Threshold threshold;
+  if (!value.IsObject()) throw std::invalid_argument(metric + ": expected an object");
+
+  if (value.HasMember("better")) {
+    const std::string better = value["better"].IsString() ? value["better"].GetString() : "";
+    if (better != "higher" && better != "lower")
+      throw std::invalid_argument(metric + ": better needs to be 'higher' or 'lower'");
+    threshold.higher_is_better = better == "higher";
+  }
+  if (value.HasMember("tolerance")) {
+    if (!value["tolerance"].IsNumber() || value["tolerance"].GetDouble() < 0)
+      throw std::invalid_argument(metric + ": tolerance needs to be a positive number");
+    threshold.tolerance = value["tolerance"].GetDouble();
+  }
+  if (value.HasMember("min_delta")) {
+    if (!value["min_delta"].IsNumber() || value["min_delta"].GetDouble() < 0)
+      throw std::invalid_argument(metric + ": min_delta needs to be a positive number");
+    threshold.min_delta = value["min_delta"].GetDouble();
+  }
+  return threshold;
+}
+
+/** @returns number of metrics that got worse or went missing */
+size_t compare(const std::string &name, const rapidjson::Value &metrics,
+               const rapidjson::Document &baseline, const rapidjson::Document &results) {
+  size_t failed = 0;
+
+  for (auto it = metrics.MemberBegin(); it != metrics.MemberEnd(); ++it) {
+    const std::string metric(it->name.GetString(), it->name.GetStringLength());
+    const Threshold threshold = parse_threshold(metric, it->value);
+    const auto parts = split_pointer(metric);
+
+    std::map<std::string, double> before;
+    std::map<std::string, double> after;
+    collect(baseline, parts, 0, "", before);
+    collect(results, parts, 0, "", after);
+
+    for (const auto &base : before) {
+      auto found = after.find(base.first);
+      if (found == after.end()) {
+        std::cout << "MISSING  " << name << " " << base.first << std::endl;
+        ++failed;
+        continue;
+      }
+
+      const double delta = found->second - base.second;
+      const double worse_by = threshold.higher_is_better ? -delta : delta;
+      const bool regressed = worse_by > threshold.min_delta &&
+                             worse_by > std::fabs(base.second) * threshold.tolerance;
+      const double percent = base.second == 0 ? 0.0 : delta * 100.0 / std::fabs(base.second);
+
+      std::ostringstream change;
+      change << std::showpos << std::fixed << std::setprecision(1) << percent << "%";
+
+      std::cout << (regressed ? "WORSE    " : "ok       ") << name << " " << base.first << ": "
+                << base.second << " -> " << found->second << " (" << change.str() << ", "
+                << (threshold.higher_is_better ? "higher" : "lower") << " is better, tolerance "
+                << threshold.tolerance * 100 << "%)" << std::endl;
+      if (regressed) ++failed;
+    }
+    for (const auto &result : after) {
+      if (before.find(result.first) == before.end())
+        std::cout << "new      " << name << " " << result.first << ": " << result.second << std::endl;
+    }
+  }
+
+  return failed;
+}
+
+Options parse_options(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    const auto eq = arg.find('=');
+    const std::string name = arg.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+    if (name == "--thresholds") {
+      options.thresholds = value;
+    } else if (name == "--baseline") {
+      options.baseline_dir = value;
+    } else if (name == "--results") {
+      options.results_dir = value;
+    } else if (name == "--update" && eq == std::string::npos) {
+      options.update = true;
+    } else {
+      throw std::invalid_argument("unknown option '" + arg + "'");
+    }
+  }
+  if (options.thresholds.empty() || options.baseline_dir.empty() || options.results_dir.empty())
+    throw std::invalid_argument("--thresholds, --baseline and --results are needed");
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl
+              << "usage: " << argv[0]
+              << " --thresholds=file --baseline=dir --results=dir [--update]" << std::endl;
+    return 2;
+  }
+
+  try {
+    rapidjson::Document thresholds;
+    parse_json(options.thresholds, read_file(options.thresholds), thresholds);
+    if (!thresholds.IsObject()) throw std::runtime_error(options.thresholds + ": expected an object");
+
+    if (!Path(options.baseline_dir).is_directory())
+      throw std::runtime_error("baseline directory " + options.baseline_dir + " doesn't exist");
+
+    size_t failed = 0;
+    for (auto it = thresholds.MemberBegin(); it != thresholds.MemberEnd(); ++it) {
+      const std::string name(it->name.GetString(), it->name.GetStringLength());
+      const std::string results_file = Path(options.results_dir).join(name).str();
+      const std::string baseline_file = Path(options.baseline_dir).join(name).str();
+
+      const std::string results_content = read_file(results_file);
+      rapidjson::Document results;
+      parse_json(results_file, results_content, results);
+
+      if (options.update || !Path(baseline_file).exists()) {
+        write_file(baseline_file, results_content);
+        std::cout << "recorded " << name << " as baseline in " << baseline_file << std::endl;
+        continue;
+      }
+
+      rapidjson::Document baseline;
+      parse_json(baseline_file, read_file(baseline_file), baseline);
+      if (!it->value.IsObject()) throw std::runtime_error(name + ": expected an object of metrics");
+      failed += compare(name, it->value, baseline, results);
+    }
+
+    if (failed > 0) {
+      std::cout << failed << " metric(s) got worse than the baseline in " << options.baseline_dir
+                << std::endl;
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "bench_compare failed: " << e.what() << std::endl;
+    return 2;
+  }
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+// a synthetic cluster for the metadata_cache_bench
+//
+// Each mock serves one replicaset: the metadata of the whole cluster and the
+// group replication status of its own replicaset. Only the first member of a
+// replicaset is the mock itself, the others aren't listening, the metadata
+// cache connects to the first one it reaches.
+//
+// - CHURN_MS: if set, the last member of each replicaset toggles between
+//   ONLINE and RECOVERING every CHURN_MS milliseconds
+// - mysqld.global.primary_offline: if true, the first member goes OFFLINE
+//   and the second becomes the primary
+
+var replicasets = parseInt(process.env.REPLICASETS, 10);
+var instances = parseInt(process.env.INSTANCES, 10);
+var my_replicaset = parseInt(process.env.MY_REPLICASET, 10);
+var mock_ports = process.env.MOCK_PORTS.split(",");
+var unused_port_base = parseInt(process.env.UNUSED_PORT_BASE, 10);
+var churn_ms = parseInt(process.env.CHURN_MS, 10);
+
+function pad(n, len) {
+  var s = "" + n;
+  while (s.length < len) s = "0" + s;
+
+  return s;
+}
+
+function replicaset_name(rs) {
+  return rs === 0 ? "default" : "rs" + rs;
+}
+
+function member_id(rs, ndx) {
+  return "00000000-0000-0000-" + pad(rs, 4) + "-" + pad(ndx, 12);
+}
+
+function member_port(rs, ndx) {
+  return ndx === 0 ? mock_ports[rs] : "" + (unused_port_base + rs * instances + ndx);
+}
+
+function primary_ndx() {
+  return mysqld.global.primary_offline ? 1 : 0;
+}
+
+function member_state(ndx) {
+  if (ndx === 0 && mysqld.global.primary_offline) return "OFFLINE";
+  if (ndx === instances - 1 && churn_ms > 0 &&
+      Math.floor(Date.now() / churn_ms) % 2 === 1) return "RECOVERING";
+
+  return "ONLINE";
+}
+
+function cluster_instances() {
+  var rows = [];
+  for (var rs = 0; rs < replicasets; ++rs) {
+    for (var ndx = 0; ndx < instances; ++ndx) {
+      rows.push([ replicaset_name(rs), member_id(rs, ndx), "HA", null, null, "",
+                  "127.0.0.1:" + member_port(rs, ndx), "127.0.0.1:33060" ]);
+    }
+  }
+
+  return rows;
+}
+
+function group_members(with_primary_member) {
+  var rows = [];
+  for (var ndx = 0; ndx < instances; ++ndx) {
+    var row = [ member_id(my_replicaset, ndx), "127.0.0.1",
+                member_port(my_replicaset, ndx), member_state(ndx), "1" ];
+    if (with_primary_member) row.push(member_id(my_replicaset, primary_ndx()));
+    rows.push(row);
+  }
+
+  return rows;
+}
+
+({
+  stmts: function(stmt) {
+    if (stmt.indexOf("FROM mysql_innodb_cluster_metadata.clusters") !== -1) {
+      return {
+        result: {
+          columns: [ { name: "replicaset_name", type: "VAR_STRING" },
+                     { name: "mysql_server_uuid", type: "VAR_STRING" },
+                     { name: "role", type: "STRING" },
+                     { name: "weight", type: "FLOAT" },
+                     { name: "version_token", type: "LONG" },
+                     { name: "location", type: "VAR_STRING" },
+                     { name: "I.addresses->>'$.mysqlClassic'", type: "LONGBLOB" },
+                     { name: "I.addresses->>'$.mysqlX'", type: "LONGBLOB" } ],
+          rows: cluster_instances()
+        }
+      }
+    } else if (stmt.indexOf("SELECT member_id, member_host") === 0) {
+      var with_primary_member = stmt.indexOf("global_status") !== -1;
+      var columns = [ { name: "member_id", type: "STRING" },
+                      { name: "member_host", type: "STRING" },
+                      { name: "member_port", type: "LONG" },
+                      { name: "member_state", type: "STRING" },
+                      { name: "@@group_replication_single_primary_mode", type: "LONGLONG" } ];
+      if (with_primary_member) columns.push({ name: "variable_value", type: "STRING" });
+
+      return {
+        result: {
+          columns: columns,
+          rows: group_members(with_primary_member)
+        }
+      }
+    } else if (stmt === "show status like 'group_replication_primary_member'") {
+      return {
+        result: {
+          columns: [ { name: "Variable_name", type: "VAR_STRING" },
+                     { name: "Value", type: "VAR_STRING" } ],
+          rows: [ [ "group_replication_primary_member", member_id(my_replicaset, primary_ndx()) ] ]
+        }
+      }
+    }
+
+    return {
+      error: {
+        code: 1273,
+        sql_state: "HY001",
+        message: "Syntax Error at: " + stmt
+      }
+    }
+  }
+})
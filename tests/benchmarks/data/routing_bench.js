@@ -0,0 +1,108 @@
+// statements of the routing_bench workloads
+//
+// - oltp: point-selects returning a single row like sysbench's
+// - large: a result of the requested number of generated rows
+//
+// and the metadata of a cluster made of all the launched servers, for routes
+// to metadata-cache destinations. process.env.CLUSTER_PORTS gets replaced by
+// the ports of the servers when routing_bench writes the file.
+
+var cluster_ports = process.env.CLUSTER_PORTS.split(",");
+
+var point_select = "SELECT c FROM sbtest1 WHERE id=";
+var large_select = "SELECT * FROM bench_large LIMIT ";
+
+var c = "68487932199-96439406143-93774651418-41631865787-96406072701-" +
+        "20604855487-25459966574-28203206787-41238978918-19503783441";
+
+function member_id(ndx) {
+  var id = "" + ndx;
+  while (id.length < 12) id = "0" + id;
+
+  return "00000000-0000-0000-0000-" + id;
+}
+
+function cluster_instances() {
+  return cluster_ports.map(function(port, ndx) {
+    return [ "default", member_id(ndx), "HA", null, null, "",
+             "127.0.0.1:" + port, "127.0.0.1:33060" ];
+  });
+}
+
+function group_members(with_primary_member) {
+  return cluster_ports.map(function(port, ndx) {
+    var row = [ member_id(ndx), "127.0.0.1", port, "ONLINE", "1" ];
+    if (with_primary_member) row.push(member_id(0));
+
+    return row;
+  });
+}
+
+({
+  stmts: function(stmt) {
+    if (stmt.indexOf(point_select) === 0) {
+      return {
+        result: {
+          columns: [ { name: "c", type: "STRING" } ],
+          rows: [ [ c ] ]
+        }
+      }
+    } else if (stmt.indexOf(large_select) === 0) {
+      return {
+        result: {
+          columns: [ { name: "id", type: "LONG" },
+                     { name: "c", type: "STRING" } ],
+          generate: {
+            rows: parseInt(stmt.substr(large_select.length), 10),
+            template: [ [ 1, c ] ]
+          }
+        }
+      }
+    } else if (stmt.indexOf("FROM mysql_innodb_cluster_metadata.clusters") !== -1) {
+      return {
+        result: {
+          columns: [ { name: "replicaset_name", type: "VAR_STRING" },
+                     { name: "mysql_server_uuid", type: "VAR_STRING" },
+                     { name: "role", type: "STRING" },
+                     { name: "weight", type: "FLOAT" },
+                     { name: "version_token", type: "LONG" },
+                     { name: "location", type: "VAR_STRING" },
+                     { name: "I.addresses->>'$.mysqlClassic'", type: "LONGBLOB" },
+                     { name: "I.addresses->>'$.mysqlX'", type: "LONGBLOB" } ],
+          rows: cluster_instances()
+        }
+      }
+    } else if (stmt.indexOf("SELECT member_id, member_host") === 0) {
+      var with_primary_member = stmt.indexOf("global_status") !== -1;
+      var columns = [ { name: "member_id", type: "STRING" },
+                      { name: "member_host", type: "STRING" },
+                      { name: "member_port", type: "LONG" },
+                      { name: "member_state", type: "STRING" },
+                      { name: "@@group_replication_single_primary_mode", type: "LONGLONG" } ];
+      if (with_primary_member) columns.push({ name: "variable_value", type: "STRING" });
+
+      return {
+        result: {
+          columns: columns,
+          rows: group_members(with_primary_member)
+        }
+      }
+    } else if (stmt === "show status like 'group_replication_primary_member'") {
+      return {
+        result: {
+          columns: [ { name: "Variable_name", type: "VAR_STRING" },
+                     { name: "Value", type: "VAR_STRING" } ],
+          rows: [ [ "group_replication_primary_member", member_id(0) ] ]
+        }
+      }
+    }
+
+    return {
+      error: {
+        code: 1273,
+        sql_state: "HY001",
+        message: "Syntax Error at: " + stmt
+      }
+    }
+  }
+})
@@ -0,0 +1,522 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * Refreshes of the metadata cache on large clusters.
+ *
+ * Launches a mysql_server_mock per replicaset of a synthetic cluster of
+ * --replicasets replicasets with --instances members each, and runs the
+ * phases:
+ *
+ * - refresh: runs a MetadataCache in-process for a while, refreshing every
+ *   --ttl milliseconds with --listeners listeners per replicaset and
+ *   --lookup-threads threads looking up the servers all the time. Reports the
+ *   wall time of the refreshes, how long they held the lock the lookups wait
+ *   for, the time notifying the listeners took and the latency of the lookups.
+ *   With --churn, a member of each replicaset changes its state every that
+ *   many milliseconds, to have the listeners notified.
+ * - failover: launches a mysqlrouter with a metadata-cache route to the
+ *   primary of the first replicaset, opens --connections connections, takes
+ *   the primary offline and measures the time until the router closed them,
+ *   --rounds times. The router refreshes every --router-ttl milliseconds.
+ *
+ * The results get written as JSON:
+ *
+ *     metadata_cache_bench [--replicasets=8] [--instances=3] [--listeners=16]
+ *                          [--lookup-threads=4] [--ttl=10] [--churn=0]
+ *                          [--duration=10] [--connections=16] [--rounds=5]
+ *                          [--router-ttl=100] [--phase=refresh,failover]
+ *                          [--output=metadata_cache_bench.json]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "bench_client.h"
+#include "cluster_metadata.h"
+#include "dim.h"
+#include "keyring/keyring_manager.h"
+#include "metadata_cache.h"
+#include "mysqlrouter/mysql_session.h"
+#include "mysqlrouter/rest_client.h"
+#include "router_component_test.h"
+#include "tcp_port_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using JsonWriter = rapidjson::PrettyWriter<rapidjson::StringBuffer>;
+using bench::BenchClient;
+
+const std::string kMockServerGlobalsRestUri = "/api/v1/mock_server/globals/";
+
+// members of the replicasets besides the first one are announced on ports
+// counting up from here, nothing listens there
+constexpr unsigned kUnusedPortBase = 40000;
+
+struct BenchOptions {
+  unsigned replicasets{8};
+  unsigned instances{3};
+  unsigned listeners{16};
+  unsigned lookup_threads{4};
+  unsigned ttl_ms{10};
+  unsigned churn_ms{0};
+  unsigned duration_s{10};
+  unsigned connections{16};
+  unsigned rounds{5};
+  unsigned router_ttl_ms{100};
+  std::vector<std::string> phases{"refresh", "failover"};
+  std::string output;
+};
+
+/** @brief counts the notifications of a replicaset */
+class CountingListener : public metadata_cache::ReplicasetStateListenerInterface {
+ public:
+  void notify(const metadata_cache::LookupResult &, const bool) noexcept override {
+    ++notifications_;
+  }
+
+  uint64_t notifications() const { return notifications_; }
+
+ private:
+  std::atomic<uint64_t> notifications_{0};
+};
+
+double to_ms(std::chrono::microseconds us) {
+  return static_cast<double>(us.count()) / 1000.0;
+}
+
+void write_percentiles(JsonWriter &writer, std::vector<uint32_t> values) {
+  std::sort(values.begin(), values.end());
+  auto percentile = [&values](double p) -> unsigned {
+    if (values.empty()) return 0;
+    const auto ndx = static_cast<size_t>(p * static_cast<double>(values.size()));
+    return values[std::min(ndx, values.size() - 1)];
+  };
+
+  writer.StartObject();
+  writer.Key("p50");
+  writer.Uint(percentile(0.5));
+  writer.Key("p99");
+  writer.Uint(percentile(0.99));
+  writer.Key("max");
+  writer.Uint(values.empty() ? 0 : values.back());
+  writer.EndObject();
+}
+
+class MetadataCacheBench : public RouterComponentTest {
+ public:
+  MetadataCacheBench(const BenchOptions &options, const Path &origin): options_(options) {
+    set_origin(origin);
+  }
+
+  /** @brief launches the cluster, runs the phases, writes the results */
+  void run() {
+    RouterComponentTest::SetUp();
+
+    std::string mock_ports;
+    for (unsigned rs = 0; rs < options_.replicasets; ++rs) {
+      mock_ports_.push_back(static_cast<uint16_t>(port_pool_.get_next_available()));
+      mock_ports += (rs == 0 ? "" : ",") + std::to_string(mock_ports_.back());
+    }
+    http_port_ = static_cast<uint16_t>(port_pool_.get_next_available());
+
+    tmp_dir_ = get_tmp_dir();
+    std::shared_ptr<void> exit_guard(nullptr, [&](void*) { purge_dir(tmp_dir_); });
+
+    std::vector<CommandHandle> servers;
+    for (unsigned rs = 0; rs < options_.replicasets; ++rs) {
+      const std::string trace_file =
+          Path(tmp_dir_).join("metadata_cache_bench_" + std::to_string(rs) + ".js").str();
+      rewrite_js_to_tracefile(METADATA_CACHE_BENCH_DATA_DIR "metadata_cache_bench.js", trace_file,
+                              {{"REPLICASETS", std::to_string(options_.replicasets)},
+                               {"INSTANCES", std::to_string(options_.instances)},
+                               {"MY_REPLICASET", std::to_string(rs)},
+                               {"MOCK_PORTS", mock_ports},
+                               {"UNUSED_PORT_BASE", std::to_string(kUnusedPortBase)},
+                               {"CHURN_MS", std::to_string(options_.churn_ms)}});
+
+      // the globals of the first one take its primary offline
+      servers.push_back(launch_mysql_server_mock(trace_file, mock_ports_[rs], false,
+                                                 rs == 0 ? http_port_ : 0));
+      if (!wait_for_port_ready(mock_ports_[rs], 5000))
+        throw std::runtime_error("mysql_server_mock didn't start: " +
+                                 servers.back().get_full_output());
+    }
+    if (!wait_for_port_ready(http_port_, 5000))
+      throw std::runtime_error("REST interface of mysql_server_mock didn't start: " +
+                               servers.front().get_full_output());
+
+    rapidjson::StringBuffer json;
+    JsonWriter writer(json);
+    writer.StartObject();
+    writer.Key("replicasets");
+    writer.Uint(options_.replicasets);
+    writer.Key("instances");
+    writer.Uint(options_.instances);
+    for (const auto &phase : options_.phases) {
+      std::cerr << "running " << phase << " ..." << std::endl;
+      writer.Key(phase.c_str());
+      if (phase == "refresh")
+        run_refresh(writer);
+      else
+        run_failover(writer);
+    }
+    writer.EndObject();
+
+    if (options_.output.empty()) {
+      std::cout << json.GetString() << std::endl;
+    } else {
+      std::ofstream out(options_.output);
+      out << json.GetString() << std::endl;
+      if (!out.good()) throw std::runtime_error("writing " + options_.output + " failed");
+    }
+  }
+
+ private:
+  static std::string replicaset_name(unsigned rs) {
+    return rs == 0 ? "default" : "rs" + std::to_string(rs);
+  }
+
+  void run_refresh(JsonWriter &writer) {
+    mysql_harness::DIM::instance().set_MySQLSession(
+        []() { return new mysqlrouter::MySQLSession(); },
+        std::default_delete<mysqlrouter::MySQLSession>());
+
+    const std::chrono::milliseconds ttl(options_.ttl_ms);
+    auto metadata = std::make_shared<ClusterMetadata>("mysql_router1_user", "password",
+                                                      1, 1, 1, ttl, mysqlrouter::SSLOptions());
+    MetadataCache cache({mysql_harness::TCPAddress("127.0.0.1", mock_ports_[0])}, metadata, ttl,
+                        mysqlrouter::SSLOptions(), "test");
+
+    std::vector<std::unique_ptr<CountingListener>> listeners;
+    for (unsigned rs = 0; rs < options_.replicasets; ++rs) {
+      for (unsigned i = 0; i < options_.listeners; ++i) {
+        listeners.emplace_back(new CountingListener());
+        cache.add_listener(replicaset_name(rs), listeners.back().get());
+      }
+    }
+
+    // lookups take the lock the refreshes hold while replacing the cache
+    std::atomic<bool> stopped{false};
+    std::vector<std::vector<uint32_t>> lookup_latencies(options_.lookup_threads);
+    std::vector<std::thread> lookup_threads;
+    for (unsigned i = 0; i < options_.lookup_threads; ++i) {
+      lookup_latencies[i].reserve(1 << 20);
+      lookup_threads.emplace_back([&, i]() {
+        for (unsigned rs = 0; !stopped; rs = (rs + 1) % options_.replicasets) {
+          const auto started = Clock::now();
+          cache.replicaset_lookup(replicaset_name(rs));
+          if (lookup_latencies[i].size() < lookup_latencies[i].capacity())
+            lookup_latencies[i].push_back(static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - started).count()));
+        }
+      });
+    }
+
+    const auto before = cache.get_refresh_stats();
+    cache.start();
+    std::this_thread::sleep_for(std::chrono::seconds(options_.duration_s));
+    cache.stop();
+    const auto after = cache.get_refresh_stats();
+
+    stopped = true;
+    for (auto &thread : lookup_threads) thread.join();
+
+    for (unsigned rs = 0; rs < options_.replicasets; ++rs) {
+      for (const auto &listener : listeners)
+        cache.remove_listener(replicaset_name(rs), listener.get());
+    }
+    uint64_t listener_notifications = 0;
+    for (const auto &listener : listeners) listener_notifications += listener->notifications();
+
+    std::vector<uint32_t> lookups;
+    for (const auto &latencies : lookup_latencies)
+      lookups.insert(lookups.end(), latencies.begin(), latencies.end());
+
+    const uint64_t refreshes = after.refreshes - before.refreshes;
+    const uint64_t lock_holds = after.lock_holds - before.lock_holds;
+    const uint64_t notifications = after.notifications - before.notifications;
+    auto avg_ms = [](std::chrono::microseconds sum, uint64_t count) {
+      return count == 0 ? 0.0 : to_ms(sum) / static_cast<double>(count);
+    };
+
+    writer.StartObject();
+    writer.Key("refreshes");
+    writer.Uint64(refreshes);
+    writer.Key("refresh_failures");
+    writer.Uint64(after.refresh_failures - before.refresh_failures);
+    writer.Key("refresh_avg_ms");
+    writer.Double(avg_ms(after.refresh_duration_sum - before.refresh_duration_sum, refreshes));
+    writer.Key("lock_holds");
+    writer.Uint64(lock_holds);
+    writer.Key("lock_hold_avg_ms");
+    writer.Double(avg_ms(after.lock_hold_sum - before.lock_hold_sum, lock_holds));
+    writer.Key("lock_hold_max_ms");
+    writer.Double(to_ms(after.max_lock_hold));
+    writer.Key("notifications");
+    writer.Uint64(notifications);
+    writer.Key("notify_avg_ms");
+    writer.Double(avg_ms(after.notify_duration_sum - before.notify_duration_sum, notifications));
+    writer.Key("listener_notifications");
+    writer.Uint64(listener_notifications);
+    writer.Key("lookups");
+    writer.Uint64(lookups.size());
+    writer.Key("lookup_latency_us");
+    write_percentiles(writer, std::move(lookups));
+    writer.EndObject();
+  }
+
+  void run_failover(JsonWriter &writer) {
+    const uint16_t router_port = static_cast<uint16_t>(port_pool_.get_next_available());
+    const std::string conf_dir = get_tmp_dir("conf");
+    std::shared_ptr<void> exit_guard(nullptr, [&](void*) { purge_dir(conf_dir); });
+
+    const std::string masterkey_file = Path(tmp_dir_).join("master.key").str();
+    const std::string keyring_file = Path(tmp_dir_).join("keyring").str();
+    mysql_harness::init_keyring(keyring_file, masterkey_file, true);
+    mysql_harness::get_keyring()->store("mysql_router1_user", "password", "root");
+    mysql_harness::flush_keyring();
+    mysql_harness::reset_keyring();
+    auto defaults = get_DEFAULT_defaults();
+    defaults["keyring_path"] = keyring_file;
+    defaults["master_key_path"] = masterkey_file;
+
+    const std::string config =
+        "[metadata_cache:test]\n"
+        "router_id=1\n"
+        "bootstrap_server_addresses=mysql://127.0.0.1:" + std::to_string(mock_ports_[0]) + "\n"
+        "user=mysql_router1_user\n"
+        "metadata_cluster=test\n"
+        "ttl=" + std::to_string(options_.router_ttl_ms / 1000.0) + "\n\n"
+        "[routing:bench]\n"
+        "bind_port=" + std::to_string(router_port) + "\n"
+        "destinations=metadata-cache://test/default?role=PRIMARY\n"
+        "routing_strategy=first-available\n";
+
+    auto router = launch_router("-c " + create_config_file(config, &defaults, conf_dir));
+    if (!wait_for_port_ready(router_port, 5000))
+      throw std::runtime_error("mysqlrouter didn't start: " + router.get_full_output());
+
+    std::vector<uint32_t> disconnects_ms;
+    uint64_t not_disconnected = 0;
+    for (unsigned round = 0; round < options_.rounds; ++round) {
+      set_primary_offline(false);
+      if (!wait_for_route(router_port, 10000))
+        throw std::runtime_error("route didn't become available: " + router.get_full_output());
+
+      std::vector<std::unique_ptr<BenchClient>> clients;
+      for (unsigned i = 0; i < options_.connections; ++i) {
+        clients.emplace_back(new BenchClient());
+        clients.back()->connect(router_port);
+      }
+
+      // -1 for the ones that stayed open
+      std::vector<int64_t> round_ms(options_.connections, -1);
+      std::vector<std::thread> threads;
+      set_primary_offline(true);
+      const auto changed = Clock::now();
+      for (unsigned i = 0; i < options_.connections; ++i) {
+        threads.emplace_back([&, i]() {
+          if (clients[i]->wait_closed())
+            round_ms[i] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                Clock::now() - changed).count();
+        });
+      }
+      for (auto &thread : threads) thread.join();
+
+      for (const auto ms : round_ms) {
+        if (ms < 0)
+          ++not_disconnected;
+        else
+          disconnects_ms.push_back(static_cast<uint32_t>(ms));
+      }
+    }
+    set_primary_offline(false);
+
+    writer.StartObject();
+    writer.Key("router_ttl_ms");
+    writer.Uint(options_.router_ttl_ms);
+    writer.Key("disconnects");
+    writer.Uint64(disconnects_ms.size());
+    writer.Key("not_disconnected");
+    writer.Uint64(not_disconnected);
+    writer.Key("time_to_disconnect_ms");
+    write_percentiles(writer, std::move(disconnects_ms));
+    writer.EndObject();
+  }
+
+  /** @brief waits until the route connects to the primary */
+  bool wait_for_route(uint16_t router_port, unsigned timeout_ms) {
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+      try {
+        BenchClient client;
+        client.connect(router_port);
+        return true;
+      } catch (const std::exception &) {
+        if (Clock::now() > deadline) return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  void set_primary_offline(bool offline) {
+    IOContext io_ctx;
+    RestClient rest_client(io_ctx, "127.0.0.1", http_port_);
+    auto req = rest_client.request_sync(HttpMethod::Put, kMockServerGlobalsRestUri,
+                                        offline ? "{\"primary_offline\": true}"
+                                                : "{\"primary_offline\": false}");
+    if (!req || req.get_response_code() != 204)
+      throw std::runtime_error("setting the globals of mysql_server_mock failed: " +
+                               req.error_msg());
+  }
+
+  BenchOptions options_;
+  TcpPortPool port_pool_;
+  std::vector<uint16_t> mock_ports_;
+  uint16_t http_port_{0};
+  std::string tmp_dir_;
+};
+
+std::vector<std::string> split(const std::string &s, char delim) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  for (size_t end; (end = s.find(delim, begin)) != std::string::npos; begin = end + 1)
+    parts.push_back(s.substr(begin, end - begin));
+  parts.push_back(s.substr(begin));
+  return parts;
+}
+
+unsigned parse_number(const std::string &name, const std::string &value, bool allow_zero = false) {
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long number = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || errno != 0 || number > UINT32_MAX ||
+      (number == 0 && !allow_zero))
+    throw std::invalid_argument(name + " needs a positive number, got '" + value + "'");
+  return static_cast<unsigned>(number);
+}
+
+BenchOptions parse_options(int argc, char *argv[]) {
+  BenchOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    const auto eq = arg.find('=');
+    const std::string name = arg.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+    if (name == "--replicasets") {
+      options.replicasets = parse_number(name, value);
+    } else if (name == "--instances") {
+      options.instances = parse_number(name, value);
+      // the failover phase takes the first member offline, the group keeps
+      // its quorum with the others
+      if (options.instances < 3) throw std::invalid_argument("--instances needs at least 3");
+    } else if (name == "--listeners") {
+      options.listeners = parse_number(name, value, true);
+    } else if (name == "--lookup-threads") {
+      options.lookup_threads = parse_number(name, value, true);
+    } else if (name == "--ttl") {
+      options.ttl_ms = parse_number(name, value, true);
+    } else if (name == "--churn") {
+      options.churn_ms = parse_number(name, value, true);
+    } else if (name == "--duration") {
+      options.duration_s = parse_number(name, value);
+    } else if (name == "--connections") {
+      options.connections = parse_number(name, value);
+    } else if (name == "--rounds") {
+      options.rounds = parse_number(name, value);
+    } else if (name == "--router-ttl") {
+      options.router_ttl_ms = parse_number(name, value, true);
+    } else if (name == "--phase") {
+      options.phases = split(value, ',');
+      for (const auto &phase : options.phases) {
+        if (phase != "refresh" && phase != "failover")
+          throw std::invalid_argument("unknown phase '" + phase + "'");
+      }
+    } else if (name == "--output") {
+      options.output = value;
+    } else {
+      throw std::invalid_argument("unknown option '" + arg + "'");
+    }
+  }
+
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  init_windows_sockets();
+
+  // the stage-dir of the build unless told otherwise
+  if (std::getenv("STAGE_DIR") == nullptr) {
+#ifdef _WIN32
+    _putenv_s("STAGE_DIR", METADATA_CACHE_BENCH_STAGE_DIR);
+#else
+    setenv("STAGE_DIR", METADATA_CACHE_BENCH_STAGE_DIR, 0);
+#endif
+  }
+
+  BenchOptions options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::invalid_argument &e) {
+    std::cerr << e.what() << "\n\n"
+              << "usage: " << argv[0] << " [--replicasets=8] [--instances=3]"
+              << " [--listeners=16] [--lookup-threads=4] [--ttl=10] [--churn=0]"
+              << " [--duration=10] [--connections=16] [--rounds=5] [--router-ttl=100]"
+              << " [--phase=refresh,failover] [--output=file]" << std::endl;
+    return 1;
+  }
+
+  try {
+    MetadataCacheBench bench(options, Path(argv[0]).dirname());
+    bench.run();
+  } catch (const std::exception &e) {
+    std::cerr << "metadata_cache_bench failed: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,518 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * Microbenchmarks of the protocol handling on the connect path.
+ *
+ * Each benchmark runs its loop often enough to take --min-time seconds and
+ * reports the time per iteration. The results get written as JSON in the
+ * layout of Google Benchmark's JSON output, to compare them with its tools:
+ *
+ *     mysql_protocol_bench [--filter=substring] [--min-time=0.5] [--output=file]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "mysqlrouter/mysql_protocol.h"
+#include "mysqlrouter/routing.h"
+#include "protocol/classic_handshake.h"
+#include "protocol/x_protocol.h"
+#include "socket_operations.h"
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic warning "-Wconversion"
+#endif
+#include <google/protobuf/io/coded_stream.h>
+#include "mysqlx.pb.h"
+#include "mysqlx_connection.pb.h"
+#include "mysqlx_notice.pb.h"
+#include "mysqlx_session.pb.h"
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using mysql_protocol::Capabilities::Flags;
+namespace Capabilities = mysql_protocol::Capabilities;
+
+/** @brief keeps the compiler from optimizing away the computation of value */
+template <class T>
+inline void do_not_optimize(const T &value) {
+#ifdef __GNUC__
+  asm volatile("" : : "g"(&value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+/** @brief the loop of a benchmark: `while (state.keep_running()) { ... }` */
+class BenchState {
+ public:
+  explicit BenchState(uint64_t iterations): remaining_(iterations) {}
+
+  bool keep_running() {
+    if (remaining_ == 0) return false;
+    --remaining_;
+    return true;
+  }
+
+ private:
+  uint64_t remaining_;
+};
+
+struct Benchmark {
+  std::string name;
+  std::function<void(BenchState &state)> run;
+};
+
+struct BenchResult {
+  uint64_t iterations;
+  double seconds;
+};
+
+/**
+ * Runs a benchmark with growing iteration counts until a run takes min_time.
+ */
+BenchResult run_benchmark(const Benchmark &benchmark, double min_time) {
+  uint64_t iterations = 1;
+  for (;;) {
+    BenchState state(iterations);
+    const auto start = Clock::now();
+    benchmark.run(state);
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (seconds >= min_time || iterations >= (1ull << 40)) return {iterations, seconds};
+
+    // aim 40% beyond min_time, but grow by 10x at most per round
+    const double factor = seconds > 0 ? std::min(10.0, min_time * 1.4 / seconds) : 10.0;
+    iterations = std::max(iterations + 1, static_cast<uint64_t>(static_cast<double>(iterations) * factor));
+  }
+}
+
+/** @brief socket operations handing out the same bytes on each read, dropping the writes */
+class ReplaySocketOperations : public mysql_harness::SocketOperationsBase {
+ public:
+  void set_read_data(const std::vector<uint8_t> &data) { data_ = data; }
+
+  ssize_t read(int, void *buffer, size_t nbyte) override {
+    const size_t size = std::min(nbyte, data_.size());
+    std::copy(data_.begin(), data_.begin() + static_cast<std::ptrdiff_t>(size),
+              static_cast<uint8_t*>(buffer));
+    return static_cast<ssize_t>(size);
+  }
+  ssize_t write(int, void *, size_t nbyte) override { return static_cast<ssize_t>(nbyte); }
+  void close(int) override {}
+  void shutdown(int) override {}
+  void freeaddrinfo(addrinfo *) override {}
+  int getaddrinfo(const char *, const char *, const addrinfo *, addrinfo **) override { return -1; }
+  int bind(int, const struct sockaddr *, socklen_t) override { return -1; }
+  int socket(int, int, int) override { return -1; }
+  int setsockopt(int, int, int, const void *, socklen_t) override { return -1; }
+  int listen(int, int) override { return -1; }
+  int get_errno() override { return 0; }
+  void set_errno(int) override {}
+  int poll(struct pollfd *, nfds_t, std::chrono::milliseconds) override { return 0; }
+  int connect_non_blocking_wait(int, std::chrono::milliseconds) override { return -1; }
+  int connect_non_blocking_status(int, int &) override { return -1; }
+  std::string get_local_hostname() override { return "localhost"; }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+class ReplayRoutingSockOps : public routing::RoutingSockOpsInterface {
+ public:
+  int get_mysql_socket(mysql_harness::TCPAddress, std::chrono::milliseconds, bool,
+                       const routing::SocketOptions&) noexcept override {
+    return -1;
+  }
+  std::vector<bool> probe_mysql_servers(const std::vector<mysql_harness::TCPAddress> &addrs,
+                                        std::chrono::milliseconds) noexcept override {
+    return std::vector<bool>(addrs.size(), false);
+  }
+  int get_mysql_socket_hedged(const std::vector<mysql_harness::TCPAddress> &, std::chrono::milliseconds,
+                              std::chrono::milliseconds, bool, const routing::SocketOptions &,
+                              size_t &) noexcept override {
+    return -1;
+  }
+  ReplaySocketOperations *so() const override { return &so_; }
+
+ private:
+  mutable ReplaySocketOperations so_;
+};
+
+constexpr Flags kServerCapabilities =
+    Capabilities::LONG_PASSWORD | Capabilities::LONG_FLAG | Capabilities::CONNECT_WITH_DB |
+    Capabilities::PROTOCOL_41 | Capabilities::TRANSACTIONS | Capabilities::SECURE_CONNECTION |
+    Capabilities::PLUGIN_AUTH;
+
+void append_int(std::vector<uint8_t> &buffer, uint64_t value, size_t length) {
+  for (size_t i = 0; i < length; ++i) buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void append_string_nul(std::vector<uint8_t> &buffer, const std::string &s) {
+  buffer.insert(buffer.end(), s.begin(), s.end());
+  buffer.push_back(0);
+}
+
+/** @brief fills in the header of a packet of sequence_id that starts with 4 bytes space */
+std::vector<uint8_t> &set_header(std::vector<uint8_t> &packet, uint8_t sequence_id) {
+  const size_t len = packet.size() - mysql_protocol::Packet::kHeaderSize;
+  packet[0] = static_cast<uint8_t>(len);
+  packet[1] = static_cast<uint8_t>(len >> 8);
+  packet[2] = static_cast<uint8_t>(len >> 16);
+  packet[3] = sequence_id;
+  return packet;
+}
+
+/** @brief Protocol::HandshakeV10 as sent by a 8.0 server */
+std::vector<uint8_t> make_server_greeting() {
+  std::vector<uint8_t> packet(mysql_protocol::Packet::kHeaderSize);
+  const std::string scramble("123456789|ABCDEFGHI|");
+
+  packet.push_back(10);  // protocol version
+  append_string_nul(packet, "8.0.12");
+  append_int(packet, 42, 4);  // connection id
+  packet.insert(packet.end(), scramble.begin(), scramble.begin() + 8);
+  packet.push_back(0);
+  append_int(packet, kServerCapabilities.low_16_bits(), 2);
+  packet.push_back(0xff);  // utf8mb4_0900_ai_ci
+  append_int(packet, 0x0002, 2);  // autocommit
+  append_int(packet, kServerCapabilities.high_16_bits(), 2);
+  packet.push_back(static_cast<uint8_t>(scramble.size() + 1));
+  packet.insert(packet.end(), 10, 0);
+  append_string_nul(packet, scramble.substr(8));
+  append_string_nul(packet, "mysql_native_password");
+
+  return set_header(packet, 0);
+}
+
+/** @brief Protocol::HandshakeResponse41 with a database */
+std::vector<uint8_t> make_client_handshake() {
+  std::vector<uint8_t> packet(mysql_protocol::Packet::kHeaderSize);
+
+  append_int(packet, kServerCapabilities.bits(), 4);
+  append_int(packet, 1 << 24, 4);  // max packet size
+  packet.push_back(0xff);
+  packet.insert(packet.end(), 23, 0);
+  append_string_nul(packet, "root");
+  packet.push_back(20);
+  packet.insert(packet.end(), 20, 0x71);
+  append_string_nul(packet, "test");
+  append_string_nul(packet, "mysql_native_password");
+
+  return set_header(packet, 1);
+}
+
+/** @brief packet with length-encoded integers of the 4 sizes: 1, 3, 4 and 9 bytes */
+std::vector<uint8_t> make_lenenc_packet() {
+  std::vector<uint8_t> packet(mysql_protocol::Packet::kHeaderSize);
+
+  packet.push_back(250);
+  packet.push_back(0xfc);
+  append_int(packet, 0x1234, 2);
+  packet.push_back(0xfd);
+  append_int(packet, 0x123456, 3);
+  packet.push_back(0xfe);
+  append_int(packet, 0x123456789abcdef0, 8);
+
+  return set_header(packet, 0);
+}
+
+std::vector<uint8_t> make_x_frame(const google::protobuf::Message &msg, uint8_t type) {
+  const auto msg_size = static_cast<size_t>(msg.ByteSize());
+  std::vector<uint8_t> frame(5 + msg_size);
+
+  google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(
+      static_cast<uint32_t>(msg_size + 1), frame.data());
+  frame[4] = type;
+  msg.SerializeToArray(frame.data() + 5, static_cast<int>(msg_size));
+
+  return frame;
+}
+
+std::vector<uint8_t> make_authenticate_start() {
+  Mysqlx::Session::AuthenticateStart msg;
+  msg.set_mech_name("PLAIN");
+  msg.set_auth_data(std::string("test\0root\0secret", 16));
+
+  return make_x_frame(msg, Mysqlx::ClientMessages::SESS_AUTHENTICATE_START);
+}
+
+std::vector<uint8_t> make_capabilities_set() {
+  Mysqlx::Connection::CapabilitiesSet msg;
+  auto *capability = msg.mutable_capabilities()->add_capabilities();
+  capability->set_name("tls");
+  capability->mutable_value()->set_type(Mysqlx::Datatypes::Any::SCALAR);
+  capability->mutable_value()->mutable_scalar()->set_type(Mysqlx::Datatypes::Scalar::V_BOOL);
+  capability->mutable_value()->mutable_scalar()->set_v_bool(true);
+
+  return make_x_frame(msg, Mysqlx::ClientMessages::CON_CAPABILITIES_SET);
+}
+
+/** @brief what the server sends until the authentication is done: notices, AuthenticateOk */
+std::vector<uint8_t> make_server_frames() {
+  Mysqlx::Notice::Frame notice;
+  notice.set_type(3);  // SessionStateChanged
+  notice.set_payload(std::string(16, 'x'));
+  Mysqlx::Session::AuthenticateOk ok;
+
+  std::vector<uint8_t> frames;
+  for (int i = 0; i < 2; ++i) {
+    const auto frame = make_x_frame(notice, Mysqlx::ServerMessages::NOTICE);
+    frames.insert(frames.end(), frame.begin(), frame.end());
+  }
+  const auto frame = make_x_frame(ok, Mysqlx::ServerMessages::SESS_AUTHENTICATE_OK);
+  frames.insert(frames.end(), frame.begin(), frame.end());
+
+  return frames;
+}
+
+/** @brief copy_packets() of the X protocol with data as read from the sender */
+std::function<void(BenchState &)> x_copy_packets(std::vector<uint8_t> data, bool from_server,
+                                                 bool handshake_done) {
+  return [data, from_server, handshake_done](BenchState &state) {
+    ReplayRoutingSockOps sock_ops;
+    sock_ops.so()->set_read_data(data);
+    XProtocol protocol(&sock_ops);
+    RoutingProtocolBuffer buffer(routing::kDefaultNetBufferLength);
+
+    while (state.keep_running()) {
+      bool done = handshake_done;
+      int frames_state = 0;
+      size_t bytes_read = 0;
+      if (protocol.copy_packets(1, 2, true, buffer, &frames_state, done, &bytes_read,
+                                from_server) != 0)
+        throw std::runtime_error("copy_packets() failed");
+      do_not_optimize(bytes_read);
+    }
+  };
+}
+
+std::vector<Benchmark> make_benchmarks() {
+  std::vector<Benchmark> benchmarks;
+  const std::string error_message("Access denied for user 'root'@'localhost' (using password: YES)");
+
+  benchmarks.push_back({"Packet/read_lenenc_uint", [](BenchState &state) {
+    const mysql_protocol::Packet packet(make_lenenc_packet());
+    while (state.keep_running()) {
+      size_t pos = mysql_protocol::Packet::kHeaderSize;
+      uint64_t sum = 0;
+      for (int i = 0; i < 4; ++i) {
+        const auto res = packet.read_lenenc_uint_from(pos);
+        sum += res.first;
+        pos += res.second;
+      }
+      do_not_optimize(sum);
+    }
+  }});
+
+  benchmarks.push_back({"PacketView/read_lenenc_uint", [](BenchState &state) {
+    const std::vector<uint8_t> buffer(make_lenenc_packet());
+    while (state.keep_running()) {
+      mysql_protocol::PacketView view(buffer);
+      view.seek(mysql_protocol::Packet::kHeaderSize);
+      uint64_t sum = 0;
+      for (int i = 0; i < 4; ++i) sum += view.read_lenenc_uint();
+      do_not_optimize(sum);
+    }
+  }});
+
+  benchmarks.push_back({"HandshakeResponsePacket/build", [](BenchState &state) {
+    const std::vector<unsigned char> auth_response(20, 0x71);
+    while (state.keep_running()) {
+      mysql_protocol::HandshakeResponsePacket packet(1, auth_response, "root", "", "test");
+      do_not_optimize(packet);
+    }
+  }});
+
+  benchmarks.push_back({"HandshakeResponsePacket/parse", [](BenchState &state) {
+    const std::vector<uint8_t> buffer(make_client_handshake());
+    while (state.keep_running()) {
+      mysql_protocol::HandshakeResponsePacket packet(buffer, true, kServerCapabilities);
+      do_not_optimize(packet);
+    }
+  }});
+
+  benchmarks.push_back({"classic_handshake/parse_server_greeting", [](BenchState &state) {
+    RoutingProtocolBuffer buffer(make_server_greeting());
+    while (state.keep_running()) {
+      classic_handshake::ServerGreeting greeting;
+      if (!classic_handshake::parse_server_greeting(buffer, greeting, false))
+        throw std::runtime_error("parse_server_greeting() failed");
+      do_not_optimize(greeting);
+    }
+  }});
+
+  benchmarks.push_back({"classic_handshake/parse_handshake_response", [](BenchState &state) {
+    const RoutingProtocolBuffer buffer(make_client_handshake());
+    while (state.keep_running()) {
+      classic_handshake::ClientHandshake handshake;
+      if (!classic_handshake::parse_handshake_response(buffer, handshake))
+        throw std::runtime_error("parse_handshake_response() failed");
+      do_not_optimize(handshake);
+    }
+  }});
+
+  benchmarks.push_back({"classic_handshake/make_handshake_response", [](BenchState &state) {
+    const RoutingProtocolBuffer buffer(make_client_handshake());
+    classic_handshake::ClientHandshake handshake;
+    if (!classic_handshake::parse_handshake_response(buffer, handshake))
+      throw std::runtime_error("parse_handshake_response() failed");
+    const std::vector<uint8_t> auth_response(20, 0x42);
+    while (state.keep_running()) {
+      auto packet = classic_handshake::make_handshake_response(buffer, handshake, auth_response);
+      do_not_optimize(packet);
+    }
+  }});
+
+  benchmarks.push_back({"ErrorPacket/construct", [error_message](BenchState &state) {
+    while (state.keep_running()) {
+      mysql_protocol::ErrorPacket packet(2, 1045, error_message, "28000", Capabilities::PROTOCOL_41);
+      do_not_optimize(packet);
+    }
+  }});
+
+  benchmarks.push_back({"ErrorPacket/write", [error_message](BenchState &state) {
+    using mysql_protocol::PacketWriter;
+    uint8_t buffer[512];
+    const size_t size = PacketWriter::framed_size(
+        mysql_protocol::ErrorPacket::payload_size(error_message, Capabilities::PROTOCOL_41));
+    while (state.keep_running()) {
+      PacketWriter writer(buffer, size);
+      mysql_protocol::ErrorPacket::write(writer, 2, 1045, error_message, "28000",
+                                         Capabilities::PROTOCOL_41);
+      do_not_optimize(buffer);
+    }
+  }});
+
+  benchmarks.push_back({"ErrorPacket/parse", [error_message](BenchState &state) {
+    const mysql_protocol::ErrorPacket error(2, 1045, error_message, "28000", Capabilities::PROTOCOL_41);
+    const std::vector<uint8_t> buffer(error.begin(), error.end());
+    while (state.keep_running()) {
+      mysql_protocol::ErrorPacket packet(buffer, Capabilities::PROTOCOL_41);
+      do_not_optimize(packet);
+    }
+  }});
+
+  benchmarks.push_back({"XProtocol/copy_packets/authenticate_start",
+                        x_copy_packets(make_authenticate_start(), false, false)});
+  benchmarks.push_back({"XProtocol/copy_packets/capabilities_set",
+                        x_copy_packets(make_capabilities_set(), false, false)});
+  benchmarks.push_back({"XProtocol/copy_packets/server_handshake",
+                        x_copy_packets(make_server_frames(), true, false)});
+  benchmarks.push_back({"XProtocol/copy_packets/after_handshake",
+                        x_copy_packets(make_authenticate_start(), false, true)});
+
+  return benchmarks;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string filter;
+  std::string output;
+  double min_time = 0.5;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg.compare(0, 9, "--filter=") == 0) {
+      filter = arg.substr(9);
+    } else if (arg.compare(0, 11, "--min-time=") == 0) {
+      min_time = std::atof(arg.c_str() + 11);
+    } else if (arg.compare(0, 9, "--output=") == 0) {
+      output = arg.substr(9);
+    } else {
+      min_time = 0;
+    }
+    if (min_time <= 0) {
+      std::cerr << "usage: " << argv[0] << " [--filter=substring] [--min-time=0.5] [--output=file]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  rapidjson::StringBuffer json;
+  rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+  writer.StartObject();
+  writer.Key("benchmarks");
+  writer.StartArray();
+
+  try {
+    for (const auto &benchmark : make_benchmarks()) {
+      if (benchmark.name.find(filter) == std::string::npos) continue;
+
+      const BenchResult result = run_benchmark(benchmark, min_time);
+      const double ns_per_iteration = result.seconds * 1e9 / static_cast<double>(result.iterations);
+      std::cerr << benchmark.name << ": " << ns_per_iteration << " ns ("
+                << result.iterations << " iterations)" << std::endl;
+
+      writer.StartObject();
+      writer.Key("name");
+      writer.String(benchmark.name.c_str());
+      writer.Key("iterations");
+      writer.Uint64(result.iterations);
+      writer.Key("real_time");
+      writer.Double(ns_per_iteration);
+      writer.Key("time_unit");
+      writer.String("ns");
+      writer.EndObject();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "mysql_protocol_bench failed: " << e.what() << std::endl;
+    return 1;
+  }
+
+  writer.EndArray();
+  writer.EndObject();
+
+  if (output.empty()) {
+    std::cout << json.GetString() << std::endl;
+  } else {
+    std::ofstream out(output);
+    out << json.GetString() << std::endl;
+    if (!out.good()) {
+      std::cerr << "writing " << output << " failed" << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
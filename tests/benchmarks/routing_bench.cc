@@ -0,0 +1,759 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/**
+ * Throughput and latency of the routing.
+ *
+ * Launches mysql_server_mocks and a mysqlrouter routing to them, and runs the
+ * workloads with many concurrent clients for a while each:
+ *
+ * - connect: connects, authenticates and quits
+ * - oltp: point-selects returning a small row, one connection per client
+ * - large: selects returning large results, one connection per client
+ * - storm: connects, authenticates and drops the connection without quitting,
+ *   to load the acceptor and the destination selection. Not run by default.
+ *
+ * The route goes to --destinations servers, either listed statically or as
+ * metadata-cache destinations of a cluster made of them. Besides the
+ * throughput and latencies, the failures by kind, the time until the
+ * greeting arrived for the workloads that connect and, on Linux, the depth of
+ * the accept queue of the router and its resident memory after each workload
+ * get reported.
+ *
+ * The results get written as JSON, to diff them across versions:
+ *
+ *     routing_bench [--clients=64] [--duration=10] [--workload=connect,oltp,large]
+ *                   [--rows=10000] [--rate=0] [--destinations=1]
+ *                   [--destination-type=static|metadata-cache]
+ *                   [--routing-strategy=round-robin]
+ *                   [--routing-option=io_threads=4 ...]
+ *                   [--output=routing_bench.json]
+ */
+
+#ifdef __linux__
+#  include <linux/inet_diag.h>
+#  include <linux/netlink.h>
+#  include <linux/sock_diag.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "bench_client.h"
+#include "keyring/keyring_manager.h"
+#include "router_component_test.h"
+#include "tcp_port_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using bench::BenchClient;
+using bench::BenchError;
+
+struct AcceptQueueStats {
+  uint64_t samples{0};
+  uint64_t depth_sum{0};
+  uint32_t depth_max{0};
+  uint32_t backlog{0};
+};
+
+/**
+ * Samples the depth of the accept queue of a listening socket while running.
+ *
+ * Asks the kernel through sock_diag every millisecond for the connections
+ * waiting to be accepted, which tells if the acceptor keeps up with the
+ * clients. Only supported on Linux, elsewhere nothing gets sampled.
+ */
+class AcceptQueueMonitor {
+ public:
+  static bool is_supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  explicit AcceptQueueMonitor(uint16_t port) {
+#ifdef __linux__
+    sock_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (sock_ == -1) return;
+
+    thread_ = std::thread([this, port]() {
+      while (!stopped_) {
+        uint32_t depth, backlog;
+        if (sample(port, &depth, &backlog)) {
+          ++stats_.samples;
+          stats_.depth_sum += depth;
+          stats_.depth_max = std::max(stats_.depth_max, depth);
+          stats_.backlog = backlog;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+#else
+    (void)port;
+#endif
+  }
+
+  ~AcceptQueueMonitor() { stop(); }
+
+  AcceptQueueMonitor(const AcceptQueueMonitor&) = delete;
+  AcceptQueueMonitor& operator=(const AcceptQueueMonitor&) = delete;
+
+  /** @brief stops sampling and returns what got sampled */
+  AcceptQueueStats stop() {
+    stopped_ = true;
+    if (thread_.joinable()) thread_.join();
+#ifdef __linux__
+    if (sock_ != -1) {
+      close(sock_);
+      sock_ = -1;
+    }
+#endif
+    return stats_;
+  }
+
+ private:
+#ifdef __linux__
+  /**
+   * Gets the accept queue of the IPv4 TCP socket listening on a port.
+   *
+   * For listening sockets the kernel reports the connections waiting in the
+   * accept queue as rqueue and the backlog as wqueue.
+   */
+  bool sample(uint16_t port, uint32_t *depth, uint32_t *backlog) {
+    struct {
+      struct nlmsghdr nlh;
+      struct inet_diag_req_v2 req;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = sizeof(request);
+    request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.req.sdiag_family = AF_INET;
+    request.req.sdiag_protocol = IPPROTO_TCP;
+    request.req.idiag_states = 1 << 10;  // TCP_LISTEN
+
+    if (send(sock_, &request, sizeof(request), 0) < 0) return false;
+
+    bool found = false;
+    alignas(struct nlmsghdr) char buf[8192];
+    for (;;) {
+      const auto received = recv(sock_, buf, sizeof(buf), 0);
+      if (received <= 0) return false;
+
+      auto len = static_cast<int>(received);
+      for (auto nlh = reinterpret_cast<const struct nlmsghdr*>(buf); NLMSG_OK(nlh, len);
+           nlh = NLMSG_NEXT(nlh, len)) {
+        if (nlh->nlmsg_type == NLMSG_DONE) return found;
+        if (nlh->nlmsg_type == NLMSG_ERROR) return false;
+
+        auto msg = reinterpret_cast<const struct inet_diag_msg*>(NLMSG_DATA(nlh));
+        if (ntohs(msg->id.idiag_sport) == port) {
+          *depth = msg->idiag_rqueue;
+          *backlog = msg->idiag_wqueue;
+          found = true;
+        }
+      }
+    }
+  }
+
+  int sock_{-1};
+#endif
+  std::atomic<bool> stopped_{false};
+  std::thread thread_;
+  AcceptQueueStats stats_;
+};
+
+/**
+ * Resident memory of a process in kilobytes, 0 where unknown.
+ *
+ * Read from /proc/<pid>/status, only supported on Linux.
+ */
+struct ProcessMemory {
+  uint64_t rss_kb{0};
+  uint64_t peak_rss_kb{0};
+
+  static bool is_supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static ProcessMemory of(uint64_t pid) {
+    ProcessMemory memory;
+#ifdef __linux__
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+      // "VmRSS:      1234 kB"
+      if (line.compare(0, 6, "VmRSS:") == 0) {
+        memory.rss_kb = std::strtoull(line.c_str() + 6, nullptr, 10);
+      } else if (line.compare(0, 6, "VmHWM:") == 0) {
+        memory.peak_rss_kb = std::strtoull(line.c_str() + 6, nullptr, 10);
+      }
+    }
+#else
+    (void)pid;
+#endif
+    return memory;
+  }
+};
+
+enum class DestinationType { kStatic, kMetadataCache };
+
+struct BenchOptions {
+  unsigned clients{64};
+  unsigned duration_s{10};
+  uint64_t rows{10000};
+  uint64_t rate{0};  // operations per second of all clients, 0 for as fast as possible
+  unsigned destinations{1};
+  DestinationType destination_type{DestinationType::kStatic};
+  std::string routing_strategy;
+  std::vector<std::string> workloads{"connect", "oltp", "large"};
+  std::vector<std::pair<std::string, std::string>> routing_options;
+  std::string output;
+};
+
+struct WorkloadResult {
+  uint64_t operations{0};
+  uint64_t errors{0};
+  uint64_t bytes{0};
+  double seconds{0};
+  std::map<std::string, uint64_t> failures;
+  std::vector<uint32_t> latencies_us;
+  std::vector<uint32_t> time_to_first_byte_us;
+  AcceptQueueStats accept_queue;
+  /** @brief of the router, once the workload is done */
+  ProcessMemory router_memory;
+};
+
+/**
+ * One operation of a workload, run by a client thread.
+ *
+ * @param client connection of the thread, connected unless the workload
+ *               connects itself
+ * @param ndx number of the operation in the thread
+ */
+using Operation = std::function<void(BenchClient &client, uint64_t ndx)>;
+
+class RoutingBench : public RouterComponentTest {
+ public:
+  RoutingBench(const BenchOptions &options, const Path &origin): options_(options) {
+    set_origin(origin);
+  }
+
+  /** @brief launches the server and the router, runs the workloads, writes the results */
+  void run() {
+    RouterComponentTest::SetUp();
+
+    std::vector<uint16_t> server_ports;
+    std::string cluster_ports;
+    for (unsigned i = 0; i < options_.destinations; ++i) {
+      server_ports.push_back(static_cast<uint16_t>(port_pool_.get_next_available()));
+      cluster_ports += (i == 0 ? "" : ",") + std::to_string(server_ports.back());
+    }
+    router_port_ = static_cast<uint16_t>(port_pool_.get_next_available());
+
+    const std::string tmp_dir = get_tmp_dir();
+    const std::string conf_dir = get_tmp_dir("conf");
+    std::shared_ptr<void> exit_guard(nullptr, [&](void*) {
+      purge_dir(tmp_dir);
+      purge_dir(conf_dir);
+    });
+
+    // all servers know the cluster for metadata-cache routes
+    const std::string trace_file = Path(tmp_dir).join("routing_bench.js").str();
+    rewrite_js_to_tracefile(ROUTING_BENCH_DATA_DIR "routing_bench.js", trace_file,
+                            {{"CLUSTER_PORTS", cluster_ports}});
+
+    std::vector<CommandHandle> servers;
+    for (const auto server_port : server_ports) {
+      servers.push_back(launch_command(get_mysqlserver_mock_exec().str(),
+                                       "--filename=" + trace_file +
+                                       " --port=" + std::to_string(server_port) +
+                                       " --io-mode=event",
+                                       true));
+      if (!wait_for_port_ready(server_port, 5000))
+        throw std::runtime_error("mysql_server_mock didn't start: " +
+                                 servers.back().get_full_output());
+    }
+
+    auto defaults = get_DEFAULT_defaults();
+    std::string config;
+    std::string destinations;
+    std::string routing_strategy = options_.routing_strategy;
+    if (options_.destination_type == DestinationType::kMetadataCache) {
+      config =
+          "[metadata_cache:test]\n"
+          "router_id=1\n"
+          "bootstrap_server_addresses=mysql://127.0.0.1:" + std::to_string(server_ports[0]) + "\n"
+          "user=mysql_router1_user\n"
+          "metadata_cluster=test\n"
+          "ttl=300\n\n";
+      destinations = "metadata-cache://test/default?role=PRIMARY_AND_SECONDARY";
+      if (routing_strategy.empty()) routing_strategy = "round-robin";
+
+      const std::string masterkey_file = Path(tmp_dir).join("master.key").str();
+      const std::string keyring_file = Path(tmp_dir).join("keyring").str();
+      mysql_harness::init_keyring(keyring_file, masterkey_file, true);
+      mysql_harness::get_keyring()->store("mysql_router1_user", "password", "root");
+      mysql_harness::flush_keyring();
+      mysql_harness::reset_keyring();
+      defaults["keyring_path"] = keyring_file;
+      defaults["master_key_path"] = masterkey_file;
+    } else {
+      for (const auto server_port : server_ports)
+        destinations += (destinations.empty() ? "" : ",") + std::string("127.0.0.1:") +
+                        std::to_string(server_port);
+    }
+
+    config +=
+        "[routing:bench]\n"
+        "bind_port=" + std::to_string(router_port_) + "\n"
+        "destinations=" + destinations + "\n";
+    // mode picks the strategy unless one is set
+    config += routing_strategy.empty()
+        ? std::string("mode=read-write\n")
+        : "routing_strategy=" + routing_strategy + "\n";
+    for (const auto &option : options_.routing_options)
+      config += option.first + "=" + option.second + "\n";
+
+    auto router = launch_router("-c " + create_config_file(config, &defaults, conf_dir));
+    if (!wait_for_port_ready(router_port_, 5000) || !wait_for_route(10000))
+      throw std::runtime_error("mysqlrouter didn't start: " + router.get_full_output());
+
+    rapidjson::StringBuffer json;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+    writer.StartObject();
+    writer.Key("clients");
+    writer.Uint(options_.clients);
+    writer.Key("duration_s");
+    writer.Uint(options_.duration_s);
+    writer.Key("rate");
+    writer.Uint64(options_.rate);
+    writer.Key("destinations");
+    writer.Uint(options_.destinations);
+    writer.Key("destination_type");
+    writer.String(options_.destination_type == DestinationType::kMetadataCache
+                      ? "metadata-cache" : "static");
+    writer.Key("routing_strategy");
+    writer.String(routing_strategy.empty() ? "" : routing_strategy.c_str());
+    writer.Key("routing_options");
+    writer.StartObject();
+    for (const auto &option : options_.routing_options) {
+      writer.Key(option.first.c_str());
+      writer.String(option.second.c_str());
+    }
+    writer.EndObject();
+
+    writer.Key("workloads");
+    writer.StartObject();
+    for (const auto &workload : options_.workloads) {
+      std::cerr << "running " << workload << " ..." << std::endl;
+      WorkloadResult result = run_workload(workload);
+      result.router_memory = ProcessMemory::of(router.get_pid());
+
+      writer.Key(workload.c_str());
+      write_result(writer, result);
+    }
+    writer.EndObject();
+    writer.EndObject();
+
+    if (options_.output.empty()) {
+      std::cout << json.GetString() << std::endl;
+    } else {
+      std::ofstream out(options_.output);
+      out << json.GetString() << std::endl;
+      if (!out.good()) throw std::runtime_error("writing " + options_.output + " failed");
+    }
+  }
+
+ private:
+  /**
+   * Waits until the route connects to a destination.
+   *
+   * The port of a metadata-cache route is open before the metadata got
+   * fetched, connections fail until then.
+   */
+  bool wait_for_route(unsigned timeout_ms) {
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+      try {
+        BenchClient client;
+        client.connect(router_port_);
+        return true;
+      } catch (const std::exception &) {
+        if (Clock::now() > deadline) return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+
+  WorkloadResult run_workload(const std::string &workload) {
+    if (workload == "connect") {
+      // connects by itself, the latency is the one of connect and authentication
+      return run_clients(false, [this](BenchClient &client, uint64_t) {
+        client.connect(router_port_);
+        client.close();
+      });
+    } else if (workload == "storm") {
+      // no COM_QUIT, the connections get dropped as soon as they are established
+      return run_clients(false, [this](BenchClient &client, uint64_t) {
+        client.connect(router_port_);
+        client.abort();
+      });
+    } else if (workload == "oltp") {
+      return run_clients(true, [](BenchClient &client, uint64_t ndx) {
+        client.query("SELECT c FROM sbtest1 WHERE id=" + std::to_string(ndx % 100000 + 1));
+      });
+    } else if (workload == "large") {
+      const std::string stmt = "SELECT * FROM bench_large LIMIT " + std::to_string(options_.rows);
+      const uint64_t rows = options_.rows;
+      return run_clients(true, [stmt, rows](BenchClient &client, uint64_t) {
+        if (client.query(stmt) != rows) throw std::runtime_error("short result");
+      });
+    }
+
+    throw std::invalid_argument("unknown workload: " + workload);
+  }
+
+  /**
+   * Runs an operation in a loop in all clients until the duration is over.
+   *
+   * @param keep_connected if true, the clients connect before the clock starts
+   *                       and reconnect after errors
+   *
+   * With a --rate the clients space out their operations to run that many
+   * per second in total, as far as they keep up.
+   */
+  WorkloadResult run_clients(bool keep_connected, const Operation &operation) {
+    std::vector<WorkloadResult> results(options_.clients);
+    std::atomic<unsigned> ready{0};
+    std::promise<void> start_promise;
+    std::shared_future<void> start = start_promise.get_future().share();
+    Clock::time_point started;
+    Clock::time_point deadline;
+    const auto interval = options_.rate == 0
+        ? Clock::duration::zero()
+        : std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(static_cast<double>(options_.clients) /
+                                            static_cast<double>(options_.rate)));
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < options_.clients; ++i) {
+      // reserve for a few seconds of 10k ops/s up front, growing the vector
+      // while measuring shows up in the latencies
+      results[i].latencies_us.reserve(1 << 16);
+      if (!keep_connected) results[i].time_to_first_byte_us.reserve(1 << 16);
+
+      threads.emplace_back([&, i]() {
+        WorkloadResult &result = results[i];
+        BenchClient client;
+        auto fail = [&result, &client](const std::exception &e) {
+          const auto *bench_error = dynamic_cast<const BenchError*>(&e);
+          ++result.errors;
+          ++result.failures[BenchError::kind_name(bench_error ? bench_error->kind()
+                                                             : BenchError::Kind::kOther)];
+          client.close();
+        };
+
+        if (keep_connected) {
+          try {
+            client.connect(router_port_);
+          } catch (const std::exception &e) {
+            fail(e);
+          }
+        }
+        ++ready;
+        start.wait();
+
+        // spread the clients over the interval
+        auto next_op = started + interval * i / options_.clients;
+        for (uint64_t ndx = 0; Clock::now() < deadline; ++ndx) {
+          if (interval != Clock::duration::zero()) {
+            std::this_thread::sleep_until(next_op);
+            next_op += interval;
+          }
+
+          try {
+            if (keep_connected && !client.is_connected()) client.connect(router_port_);
+
+            const uint64_t bytes_before = client.bytes();
+            client.take_time_to_first_byte(nullptr);
+            const auto op_start = Clock::now();
+            operation(client, ndx);
+            const auto op_end = Clock::now();
+
+            result.bytes += client.bytes() - bytes_before;
+            result.latencies_us.push_back(static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(op_end - op_start).count()));
+            uint32_t time_to_first_byte_us;
+            if (client.take_time_to_first_byte(&time_to_first_byte_us))
+              result.time_to_first_byte_us.push_back(time_to_first_byte_us);
+            ++result.operations;
+          } catch (const std::exception &e) {
+            fail(e);
+          }
+        }
+      });
+    }
+
+    while (ready < options_.clients) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    AcceptQueueMonitor accept_queue(router_port_);
+    started = Clock::now();
+    deadline = started + std::chrono::seconds(options_.duration_s);
+    start_promise.set_value();
+    for (auto &thread : threads) thread.join();
+
+    WorkloadResult total;
+    total.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    total.accept_queue = accept_queue.stop();
+    for (auto &result : results) {
+      total.operations += result.operations;
+      total.errors += result.errors;
+      total.bytes += result.bytes;
+      for (const auto &failure : result.failures) total.failures[failure.first] += failure.second;
+      total.latencies_us.insert(total.latencies_us.end(), result.latencies_us.begin(),
+                                result.latencies_us.end());
+      total.time_to_first_byte_us.insert(total.time_to_first_byte_us.end(),
+                                         result.time_to_first_byte_us.begin(),
+                                         result.time_to_first_byte_us.end());
+    }
+    std::sort(total.latencies_us.begin(), total.latencies_us.end());
+    std::sort(total.time_to_first_byte_us.begin(), total.time_to_first_byte_us.end());
+
+    return total;
+  }
+
+  /** @brief writes p50, p99, p999 and max of sorted latencies */
+  static void write_percentiles(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writer,
+                                const std::vector<uint32_t> &latencies) {
+    auto percentile = [&latencies](double p) -> unsigned {
+      if (latencies.empty()) return 0;
+      const auto ndx = static_cast<size_t>(p * static_cast<double>(latencies.size()));
+      return latencies[std::min(ndx, latencies.size() - 1)];
+    };
+
+    writer.StartObject();
+    writer.Key("p50");
+    writer.Uint(percentile(0.5));
+    writer.Key("p99");
+    writer.Uint(percentile(0.99));
+    writer.Key("p999");
+    writer.Uint(percentile(0.999));
+    writer.Key("max");
+    writer.Uint(latencies.empty() ? 0 : latencies.back());
+    writer.EndObject();
+  }
+
+  static void write_result(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writer,
+                           const WorkloadResult &result) {
+    writer.StartObject();
+    writer.Key("operations");
+    writer.Uint64(result.operations);
+    writer.Key("errors");
+    writer.Uint64(result.errors);
+    writer.Key("seconds");
+    writer.Double(result.seconds);
+    writer.Key("operations_per_sec");
+    writer.Double(static_cast<double>(result.operations) / result.seconds);
+    writer.Key("bytes_per_sec");
+    writer.Double(static_cast<double>(result.bytes) / result.seconds);
+    writer.Key("failures");
+    writer.StartObject();
+    for (const auto &failure : result.failures) {
+      writer.Key(failure.first.c_str());
+      writer.Uint64(failure.second);
+    }
+    writer.EndObject();
+    writer.Key("latency_us");
+    write_percentiles(writer, result.latencies_us);
+    if (!result.time_to_first_byte_us.empty()) {
+      writer.Key("time_to_first_byte_us");
+      write_percentiles(writer, result.time_to_first_byte_us);
+    }
+    if (AcceptQueueMonitor::is_supported()) {
+      const auto &accept_queue = result.accept_queue;
+      writer.Key("accept_queue");
+      writer.StartObject();
+      writer.Key("samples");
+      writer.Uint64(accept_queue.samples);
+      writer.Key("avg");
+      writer.Double(accept_queue.samples == 0 ? 0.0
+                    : static_cast<double>(accept_queue.depth_sum) /
+                      static_cast<double>(accept_queue.samples));
+      writer.Key("max");
+      writer.Uint(accept_queue.depth_max);
+      writer.Key("backlog");
+      writer.Uint(accept_queue.backlog);
+      writer.EndObject();
+    }
+    if (ProcessMemory::is_supported()) {
+      writer.Key("router_memory");
+      writer.StartObject();
+      writer.Key("rss_kb");
+      writer.Uint64(result.router_memory.rss_kb);
+      writer.Key("peak_rss_kb");
+      writer.Uint64(result.router_memory.peak_rss_kb);
+      writer.EndObject();
+    }
+    writer.EndObject();
+  }
+
+  BenchOptions options_;
+  TcpPortPool port_pool_;
+  uint16_t router_port_{0};
+};
+
+std::vector<std::string> split(const std::string &s, char delim) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  for (size_t end; (end = s.find(delim, begin)) != std::string::npos; begin = end + 1)
+    parts.push_back(s.substr(begin, end - begin));
+  parts.push_back(s.substr(begin));
+  return parts;
+}
+
+unsigned long long parse_number(const std::string &name, const std::string &value) {
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long long number = std::strtoull(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || errno != 0 || number == 0)
+    throw std::invalid_argument(name + " needs a positive number, got '" + value + "'");
+  return number;
+}
+
+BenchOptions parse_options(int argc, char *argv[]) {
+  BenchOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    const auto eq = arg.find('=');
+    const std::string name = arg.substr(0, eq);
+    const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+    if (name == "--clients") {
+      options.clients = static_cast<unsigned>(parse_number(name, value));
+    } else if (name == "--duration") {
+      options.duration_s = static_cast<unsigned>(parse_number(name, value));
+    } else if (name == "--rows") {
+      options.rows = parse_number(name, value);
+    } else if (name == "--rate") {
+      options.rate = value == "0" ? 0 : parse_number(name, value);
+    } else if (name == "--destinations") {
+      options.destinations = static_cast<unsigned>(parse_number(name, value));
+    } else if (name == "--destination-type") {
+      if (value == "static")
+        options.destination_type = DestinationType::kStatic;
+      else if (value == "metadata-cache")
+        options.destination_type = DestinationType::kMetadataCache;
+      else
+        throw std::invalid_argument("unknown destination type '" + value + "'");
+    } else if (name == "--routing-strategy") {
+      options.routing_strategy = value;
+    } else if (name == "--workload") {
+      options.workloads = split(value, ',');
+      for (const auto &workload : options.workloads) {
+        if (workload != "connect" && workload != "oltp" && workload != "large" &&
+            workload != "storm")
+          throw std::invalid_argument("unknown workload '" + workload + "'");
+      }
+    } else if (name == "--routing-option") {
+      const auto option_eq = value.find('=');
+      if (option_eq == std::string::npos || option_eq == 0)
+        throw std::invalid_argument("--routing-option needs key=value, got '" + value + "'");
+      options.routing_options.emplace_back(value.substr(0, option_eq), value.substr(option_eq + 1));
+    } else if (name == "--output") {
+      options.output = value;
+    } else {
+      throw std::invalid_argument("unknown option '" + arg + "'");
+    }
+  }
+
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  init_windows_sockets();
+
+  // the stage-dir of the build unless told otherwise
+  if (std::getenv("STAGE_DIR") == nullptr) {
+#ifdef _WIN32
+    _putenv_s("STAGE_DIR", ROUTING_BENCH_STAGE_DIR);
+#else
+    setenv("STAGE_DIR", ROUTING_BENCH_STAGE_DIR, 0);
+#endif
+  }
+
+  BenchOptions options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::invalid_argument &e) {
+    std::cerr << e.what() << "\n\n"
+              << "usage: " << argv[0] << " [--clients=64] [--duration=10]"
+              << " [--workload=connect,oltp,large,storm] [--rows=10000] [--rate=0]"
+              << " [--destinations=1] [--destination-type=static|metadata-cache]"
+              << " [--routing-strategy=name] [--routing-option=key=value ...]"
+              << " [--output=file]" << std::endl;
+    return 1;
+  }
+
+  try {
+    RoutingBench bench(options, Path(argv[0]).dirname());
+    bench.run();
+  } catch (const std::exception &e) {
+    std::cerr << "routing_bench failed: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -711,20 +711,20 @@ TEST_F(RouterAccountHostTest, multiple_host_patterns) {
   test_it("--bootstrap=127.0.0.1:" + std::to_string(server_port)
           + " --report-host " + my_hostname
           + " -d " + bootstrap_directory
-          + " --account-host host1"     // 2nd CREATE USER
+          + " --account-host host1"     // 2nd CREATE USER, together with host3%
           + " --account-host %"         // 1st CREATE USER
           + " --account-host host1"     // \_ redundant, ignored
           + " --account-host host1"     // /
-          + " --account-host host3%");  // 3rd CREATE USER
+          + " --account-host host3%");  // 2nd CREATE USER
 
   // --bootstrap after --account-host
   test_it("-d " + bootstrap_directory
           + " --report-host " + my_hostname
-          + " --account-host host1"     // 2nd CREATE USER
+          + " --account-host host1"     // 2nd CREATE USER, together with host3%
           + " --account-host %"         // 1st CREATE USER
           + " --account-host host1"     // \_ redundant, ignored
           + " --account-host host1"     // /
-          + " --account-host host3%"    // 3rd CREATE USER
+          + " --account-host host3%"    // 2nd CREATE USER
           + " --bootstrap=127.0.0.1:" + std::to_string(server_port));
 }
 
@@ -44,6 +44,7 @@ Path g_origin_path;
 static constexpr const char kMockServerGlobalsRestUri[] = "/api/v1/mock_server/globals/";
 static constexpr const char kMockServerConnectionsRestUri[] = "/api/v1/mock_server/connections/";
 static constexpr const char kMockServerInvalidRestUri[] = "/api/v1/mock_server/global/";
+static constexpr const char kMockServerFaultsRestUri[] = "/api/v1/mock_server/faults/";
 static constexpr std::chrono::milliseconds kMockServerMaxRestEndpointWaitTime{1000};
 static constexpr std::chrono::milliseconds kMockServerMaxRestEndpointStepTime{50};
 
@@ -865,6 +866,69 @@ TEST_F(RestMockServerRestServerMockTest, delete_all_connections) {
 }
 
 
+/**
+ * ensure injected faults drop the connections of the port.
+ *
+ * - start the mock-server
+ * - make a client connect to the mock-server
+ * - set faults that drop the connection at the next statement
+ */
+TEST_F(RestMockServerRestServerMockTest, put_faults_drops_connection) {
+  std::string http_hostname = "127.0.0.1";
+  std::string http_uri = kMockServerFaultsRestUri + std::to_string(server_port_);
+
+  IOContext io_ctx;
+  RestClient rest_client(io_ctx, http_hostname, http_port_);
+
+  SCOPED_TRACE("// wait for REST endpoint");
+  ASSERT_TRUE(wait_for_rest_endpoint_ready(rest_client, http_uri, kMockServerMaxRestEndpointWaitTime)) << server_mock_.get_full_output();
+
+  mysqlrouter::MySQLSession client;
+
+  SCOPED_TRACE("// connecting via mysql protocol");
+  ASSERT_NO_THROW(
+      client.connect("127.0.0.1", server_port_, "username", "password", "", "")) << server_mock_.get_full_output();
+
+  SCOPED_TRACE("// faults of an unknown port");
+  auto unknown_req = rest_client.request_sync(HttpMethod::Get,
+      kMockServerFaultsRestUri + std::to_string(http_port_));
+  ASSERT_TRUE(unknown_req) << unknown_req.error_msg();
+  EXPECT_EQ(unknown_req.get_response_code(), 404u);
+
+  SCOPED_TRACE("// probabilities out of range");
+  auto invalid_req = rest_client.request_sync(HttpMethod::Put, http_uri, "{\"dropProbability\": 2}");
+  ASSERT_TRUE(invalid_req) << invalid_req.error_msg();
+  EXPECT_EQ(invalid_req.get_response_code(), 422u);
+
+  SCOPED_TRACE("// drop all connections at their next statement");
+  auto put_req = rest_client.request_sync(HttpMethod::Put, http_uri, "{\"dropProbability\": 1}");
+  ASSERT_TRUE(put_req) << put_req.error_msg();
+  EXPECT_EQ(put_req.get_response_code(), 204u);
+
+  auto get_req = rest_client.request_sync(HttpMethod::Get, http_uri);
+  ASSERT_TRUE(get_req) << get_req.error_msg();
+  EXPECT_EQ(get_req.get_response_code(), 200u);
+  auto get_resp_body = get_req.get_input_buffer();
+  auto get_resp_data = get_resp_body.pop_front(get_resp_body.length());
+  std::string json_payload(get_resp_data.begin(), get_resp_data.end());
+  EXPECT_THAT(json_payload, ::testing::HasSubstr("\"active\":true"));
+
+  EXPECT_THROW_LIKE(client.query_one("select @@port"), mysqlrouter::MySQLSession::Error,
+      "Lost connection to MySQL server during query");
+
+  SCOPED_TRACE("// new connections work again once the faults got removed");
+  auto delete_req = rest_client.request_sync(HttpMethod::Delete, http_uri);
+  ASSERT_TRUE(delete_req) << delete_req.error_msg();
+  EXPECT_EQ(delete_req.get_response_code(), 200u);
+
+  mysqlrouter::MySQLSession new_client;
+  ASSERT_NO_THROW(
+      new_client.connect("127.0.0.1", server_port_, "username", "password", "", "")) << server_mock_.get_full_output();
+  std::unique_ptr<mysqlrouter::MySQLSession::ResultRow> result{
+    new_client.query_one("select @@port")};
+  ASSERT_NE(nullptr, result.get());
+}
+
 
 /**
  * ensure @@port reported by mock is real port.
@@ -31,7 +31,9 @@
 #include "tcp_port_pool.h"
 #include "router_test_helpers.h"
 #include "mysql_session.h"
+#include "mysqlrouter/rest_client.h"
 
+#include <algorithm>
 #include <thread>
 #include <chrono>
 
@@ -45,6 +47,29 @@ class RouterRoutingTest : public RouterComponentTest, public ::testing::Test {
     RouterComponentTest::SetUp();
   }
 
+  /**
+   * the http port listens before rest_routing registered its handlers and
+   * the routes registered themselves, they answer 404 until then.
+   *
+   * @returns true once uri doesn't return 404 anymore
+   */
+  bool wait_for_rest_endpoint_ready(RestClient &rest_client, const std::string &uri,
+                                    std::chrono::milliseconds max_wait_time) const noexcept {
+    const std::chrono::milliseconds step_time(50);
+    while (max_wait_time.count() > 0) {
+      auto req = rest_client.request_sync(HttpMethod::Get, uri);
+
+      if (req && req.get_response_code() != 0 && req.get_response_code() != 404) return true;
+
+      auto wait_time = std::min(step_time, max_wait_time);
+      std::this_thread::sleep_for(wait_time);
+
+      max_wait_time -= wait_time;
+    }
+
+    return false;
+  }
+
   TcpPortPool port_pool_;
 };
 
@@ -296,6 +321,91 @@ TEST_F(RouterRoutingTest, RoutingMaxConnectErrors) {
                     std::exception, "Too many connection errors");
 }
 
+/**
+ * @test the settings of a route can't be changed over REST unless enabled
+ *       with allow_route_changes=1, reading them works nevertheless.
+ */
+TEST_F(RouterRoutingTest, RouteConfigChangeRefusedByDefault) {
+  const auto server_port = port_pool_.get_next_available();
+  const auto router_port = port_pool_.get_next_available();
+  const auto http_port = port_pool_.get_next_available();
+
+  const std::string config_sections =
+                      "[routing:basic]\n"
+                      "bind_port = " + std::to_string(router_port) + "\n"
+                      "mode = read-write\n"
+                      "destinations = 127.0.0.1:" + std::to_string(server_port) + "\n"
+                      "\n"
+                      "[http_server]\n"
+                      "port = " + std::to_string(http_port) + "\n"
+                      "\n"
+                      "[rest_routing]\n";
+
+  std::string conf_file = create_config_file(config_sections);
+  auto router_static = launch_router("-c " + conf_file);
+
+  ASSERT_TRUE(wait_for_port_ready(http_port, 5000))
+    << get_router_log_output();
+
+  IOContext io_ctx;
+  RestClient rest_client(io_ctx, "127.0.0.1", static_cast<uint16_t>(http_port));
+  ASSERT_TRUE(wait_for_rest_endpoint_ready(rest_client, "/api/v1/routing/routes/routing:basic/config",
+                                           std::chrono::milliseconds(5000)))
+    << get_router_log_output();
+
+  auto patch_req = rest_client.request_sync(HttpMethod::Patch, "/api/v1/routing/routes/routing:basic/config",
+                                            "{\"destinations\": [\"127.0.0.1:1\"]}");
+  ASSERT_GT(patch_req.get_response_code(), 0u) << patch_req.error_msg();
+  EXPECT_EQ(403u, patch_req.get_response_code());
+
+  auto get_req = rest_client.request_sync(HttpMethod::Get, "/api/v1/routing/routes/routing:basic/config");
+  ASSERT_EQ(200u, get_req.get_response_code());
+  auto resp_body = get_req.get_input_buffer();
+  auto resp_body_content = resp_body.pop_front(resp_body.length());
+  const std::string json_payload(resp_body_content.begin(), resp_body_content.end());
+  EXPECT_NE(std::string::npos, json_payload.find("127.0.0.1:" + std::to_string(server_port)))
+    << json_payload;
+}
+
+/**
+ * @test the CPU profiler can't be started over REST unless enabled with
+ *       allow_profiling=1.
+ */
+TEST_F(RouterRoutingTest, ProfileRefusedByDefault) {
+  const auto server_port = port_pool_.get_next_available();
+  const auto router_port = port_pool_.get_next_available();
+  const auto http_port = port_pool_.get_next_available();
+
+  const std::string config_sections =
+                      "[routing:basic]\n"
+                      "bind_port = " + std::to_string(router_port) + "\n"
+                      "mode = read-write\n"
+                      "destinations = 127.0.0.1:" + std::to_string(server_port) + "\n"
+                      "\n"
+                      "[http_server]\n"
+                      "port = " + std::to_string(http_port) + "\n"
+                      "\n"
+                      "[rest_routing]\n";
+
+  std::string conf_file = create_config_file(config_sections);
+  auto router_static = launch_router("-c " + conf_file);
+
+  ASSERT_TRUE(wait_for_port_ready(http_port, 5000))
+    << get_router_log_output();
+
+  IOContext io_ctx;
+  RestClient rest_client(io_ctx, "127.0.0.1", static_cast<uint16_t>(http_port));
+  // GET of the profile is 404 until one was taken, the memory handler gets
+  // registered after it
+  ASSERT_TRUE(wait_for_rest_endpoint_ready(rest_client, "/api/v1/router/memory",
+                                           std::chrono::milliseconds(5000)))
+    << get_router_log_output();
+
+  auto post_req = rest_client.request_sync(HttpMethod::Post, "/api/v1/router/profile?seconds=1");
+  ASSERT_GT(post_req.get_response_code(), 0u) << post_req.error_msg();
+  EXPECT_EQ(403u, post_req.get_response_code());
+}
+
 int main(int argc, char *argv[]) {
   init_windows_sockets();
   g_origin_path = Path(argv[0]).dirname();
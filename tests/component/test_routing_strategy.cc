@@ -622,7 +622,7 @@ TEST_F(RouterRoutingStrategyStatic, InvalidStrategyName) {
 
   EXPECT_EQ(router.wait_for_exit(wait_for_process_exit_timeout), 1);
   EXPECT_TRUE(router.expect_output("Configuration error: option routing_strategy in [routing:test_default] is invalid; "
-                                    "valid are first-available, next-available, and round-robin (was 'round-robin-with-fallback'"))
+                                    "valid are first-available, next-available, round-robin, least-connections, weighted-round-robin, lowest-latency, and consistent-hash (was 'round-robin-with-fallback'"))
                                     << get_router_log_output();
 }
 
@@ -637,7 +637,7 @@ TEST_F(RouterRoutingStrategyStatic, InvalidMode) {
   auto router = launch_router_static(router_port, routing_section, /*expect_error=*/true);
 
   EXPECT_EQ(router.wait_for_exit(wait_for_process_exit_timeout), 1);
-  EXPECT_TRUE(router.expect_output("option routing_strategy in [routing:test_default] is invalid; valid are first-available, next-available, and round-robin (was 'invalid')"))
+  EXPECT_TRUE(router.expect_output("option routing_strategy in [routing:test_default] is invalid; valid are first-available, next-available, round-robin, least-connections, weighted-round-robin, lowest-latency, and consistent-hash (was 'invalid')"))
                                     << get_router_log_output();
 }
 
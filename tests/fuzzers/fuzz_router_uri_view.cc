@@ -0,0 +1,77 @@
+/*
+  Copyright (c) 2018, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License, version 2.0,
+  as published by the Free Software Foundation.
+
+  This program is also distributed with certain software (including
+  but not limited to OpenSSL) that is licensed under separate terms,
+  as designated in a particular file or component or in included license
+  documentation.  The authors of MySQL hereby grant you an additional
+  permission to link the program and your derivative works with the
+  separately licensed software that they have included with MySQL.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+
+#include "mysqlrouter/uri.h"
+
+using mysqlrouter::URI;
+using mysqlrouter::URIError;
+using mysqlrouter::URIParser;
+using mysqlrouter::URIView;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  const std::string s(Data, Data + Size);
+
+  URI u;
+  bool parsed = true;
+  try {
+    u = URIParser::parse(s);
+  } catch(URIError &e) {
+    parsed = false;
+  }
+
+  // parse_view() has to accept the same URIs as parse() and agree on
+  // the parts
+  try {
+    URIView v = URIParser::parse_view(s);
+
+    if (!parsed ||
+        !v.has_scheme(u.scheme) ||
+        URIParser::pct_decode(v.host) != u.host ||
+        v.port != u.port ||
+        URIParser::pct_decode(v.username) != u.username ||
+        URIParser::pct_decode(v.password) != u.password ||
+        URIParser::pct_decode(v.fragment) != u.fragment) {
+      abort();
+    }
+
+    for (const auto &k_v : u.query) {
+      mysqlrouter::string_view value;
+
+      if (!v.query_params().find(k_v.first, value) ||
+          URIParser::pct_decode(value) != k_v.second) {
+        abort();
+      }
+    }
+  } catch(URIError &e) {
+    if (parsed) {
+      abort();
+    }
+  }
+
+  return 0;
+}
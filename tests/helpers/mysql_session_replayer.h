@@ -42,6 +42,8 @@ public:
                        int read_timeout = kDefaultReadTimeout) override;
   virtual void disconnect() override;
   virtual bool is_connected() noexcept override { return connected_; }
+  // no server to ask, the queries of the oldest supported version get replayed
+  virtual unsigned long server_version() noexcept override { return 0; }
 
   virtual void execute(const std::string &sql) override;
   virtual void query(const std::string &sql, const RowProcessor &processor) override;
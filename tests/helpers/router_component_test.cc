@@ -413,7 +413,11 @@ int RouterComponentTest::CommandHandle::wait_for_exit_while_reading_and_autoresp
       eptr = std::current_exception();
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // sleeps until there is output to autorespond to or the child exited
+    const auto left = ch::duration_cast<ch::milliseconds>(timeout - ch::steady_clock::now());
+    if (left.count() > 0) {
+      launcher_.wait_for_output_or_exit(static_cast<unsigned>(left.count()));
+    }
   }
 
   if (exit_code_set_) {